@@ -0,0 +1,50 @@
+/** @file
+    AES-128 decryption, e.g. for the encrypted payloads of M-Bus meters.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_AES_H_
+#define INCLUDE_AES_H_
+
+#include <stdint.h>
+
+/*
+The blocks are decrypted with the AES instructions of the CPU if available,
+AES-NI on x86 (checked at runtime) or the ARMv8 Cryptography Extension (if
+enabled at compile time), otherwise with a compact table based software AES.
+All variants give the same result, the choice is made when the key is set.
+*/
+
+#define AES_BLOCK_SIZE 16 ///< size of an AES block in bytes
+
+/// An expanded AES-128 key.
+typedef struct aes128_key {
+    uint8_t rk[11 * AES_BLOCK_SIZE]; ///< round keys of the cipher
+    int hw;                          ///< use the AES instructions of the CPU
+} aes128_key_t;
+
+/** Expand a key for decryption.
+
+    @param key the expanded key
+    @param user_key the 16 byte key
+    @param use_hw 1 to use the AES instructions of the CPU if supported, 0 for the software AES
+*/
+void aes128_set_key(aes128_key_t *key, uint8_t const user_key[AES_BLOCK_SIZE], int use_hw);
+
+/** Decrypt blocks in Cipher Block Chaining mode.
+
+    @param key the expanded key
+    @param iv the 16 byte initialization vector
+    @param in the cipher text
+    @param[out] out the plain text, may be the same as @p in
+    @param len the length of the data, a multiple of AES_BLOCK_SIZE
+*/
+void aes128_cbc_decrypt(aes128_key_t const *key, uint8_t const iv[AES_BLOCK_SIZE], uint8_t const *in, uint8_t *out, unsigned len);
+
+#endif /* INCLUDE_AES_H_ */
@@ -0,0 +1,100 @@
+/** @file
+    Band scan, a scanning input assigns the further inputs to the busy channels.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_BAND_SCHED_H_
+#define INCLUDE_BAND_SCHED_H_
+
+#include <stdint.h>
+
+/*
+The first input is the scanner, it hops over its frequency list with short
+dwells. A dwell is active if any frame rose above the noise level of its
+frequency, the pre-squelch level estimate of a squelched frame counts, or
+if an event was decoded. The score of a channel is a moving average of
+its active dwells, BAND_SCHED_ALPHA for each dwell; a channel scoring at
+least BAND_SCHED_HOT, i.e. active on consecutive visits, has sustained
+traffic.
+
+The further inputs are listeners. An idle listener takes the busy channel
+with the highest score no other listener covers, and stays on it while it
+or the scanner sees activity there. A channel quiet for the hold time is
+released and has to score again before a listener returns to it. The
+scanner skips the channels a listener covers, the band is covered by the
+scanner and as many fixed listeners as there are further inputs.
+
+The scanner and the listeners run on their own DSP threads, all calls are
+locked. All times are wall clock seconds.
+*/
+
+#define BAND_SCHED_ALPHA   0.5  ///< weight of the last dwell in the score of a channel
+#define BAND_SCHED_HOT     0.7  ///< least score of a channel with sustained traffic
+#define BAND_SCHED_HOLD_S  30   ///< default time a listener stays on a quiet channel
+#define BAND_SCHED_DWELL_MS 500 ///< default dwell of the scanner
+
+typedef struct band_sched band_sched_t;
+
+/// Statistics of a channel.
+typedef struct band_sched_stats {
+    uint32_t frequency;     ///< the frequency of the channel
+    double score;           ///< moving average of the active dwells
+    double idle;            ///< time since the last activity in s, 0 if never active
+    int listener;           ///< the listener covering the channel, -1 if none
+    unsigned dwells;        ///< dwells of the scanner
+    unsigned active_dwells; ///< active dwells of the scanner
+    unsigned assigns;       ///< times a listener took the channel
+} band_sched_stats_t;
+
+/** Create a scheduler.
+
+    @param frequencies the channels to scan
+    @param channels the number of channels
+    @param listeners the number of listeners
+    @param hold the time a listener stays on a quiet channel, in s
+    @return the scheduler or NULL on failure
+*/
+band_sched_t *band_sched_create(uint32_t const *frequencies, unsigned channels, unsigned listeners, double hold);
+
+/** Free a scheduler.
+
+    @param sched the scheduler, may be NULL
+*/
+void band_sched_free(band_sched_t *sched);
+
+/** End a dwell of the scanner and choose the next channel.
+
+    @param sched the scheduler
+    @param index the channel of the dwell
+    @param active 1 if the dwell saw activity
+    @param now the time in s
+    @return the next channel not covered by a listener, the next one if all are covered
+*/
+unsigned band_sched_scan(band_sched_t *sched, unsigned index, int active, double now);
+
+/** Update a listener, releases a quiet channel and takes a busy one.
+
+    @param sched the scheduler
+    @param listener the listener, less than the number of listeners
+    @param active 1 if the listener saw activity since the last call
+    @param now the time in s
+    @return the channel to tune to, -1 to stay
+*/
+int band_sched_listen(band_sched_t *sched, unsigned listener, int active, double now);
+
+/** Get the statistics of a channel.
+
+    @param sched the scheduler
+    @param index the channel
+    @param now the time in s
+    @param[out] stats the statistics
+*/
+void band_sched_get_stats(band_sched_t *sched, unsigned index, double now, band_sched_stats_t *stats);
+
+#endif /* INCLUDE_BAND_SCHED_H_ */
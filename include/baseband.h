@@ -16,6 +16,72 @@
 #include <stdint.h>
 #include <math.h>
 
+/// SIMD implementations of the envelope and magnitude kernels.
+typedef enum baseband_simd {
+    BASEBAND_SIMD_NONE, ///< scalar code only
+    BASEBAND_SIMD_SSE2,
+    BASEBAND_SIMD_AVX2,
+    BASEBAND_SIMD_NEON,
+} baseband_simd_t;
+
+/** Select the SIMD implementation, all implementations give bit-exact results.
+
+    `baseband_init()` selects the best implementation supported by the CPU.
+
+    @param simd the implementation to use
+    @return 0 on success, -1 if not supported by the build or the CPU
+*/
+int baseband_set_simd(baseband_simd_t simd);
+
+/** Run the scalar code on the calling thread, the reference for the SIMD kernels.
+
+    Other threads keep the SIMD implementation.
+
+    @param scalar 1 for the scalar code only, 0 for the SIMD implementation
+    @return the previous setting of the thread
+*/
+int baseband_set_scalar(int scalar);
+
+/// Get the current SIMD implementation.
+baseband_simd_t baseband_get_simd(void);
+
+/// Get the name of a SIMD implementation.
+char const *baseband_simd_name(baseband_simd_t simd);
+
+#define BASEBAND_FUSED_BLOCK_MAX 8192 ///< most samples per block of the fused demodulators
+
+/** Set the samples per block of the fused demodulators, the results are the same for any block length.
+
+    Set before the demodulators run, e.g. from the startup calibration.
+
+    @param len the samples per block, clamped to 64 .. BASEBAND_FUSED_BLOCK_MAX
+*/
+void baseband_set_fused_block(uint32_t len);
+
+/// Get the samples per block of the fused demodulators.
+uint32_t baseband_get_fused_block(void);
+
+/*
+A fixed point build (FIXED_POINT, for targets without FPU) keeps the signal
+levels in 1/256 dB steps, the default build in float dB. Use DB_LEVEL() for
+constants and DB_LEVEL_FLOAT() to print or output a level.
+*/
+#ifdef FIXED_POINT
+typedef int32_t db_level_t;
+#define DB_LEVEL(x)       ((db_level_t)((x) * 256))
+#define DB_LEVEL_FLOAT(x) ((float)(x) / 256.0f)
+#else
+typedef float db_level_t;
+#define DB_LEVEL(x)       ((db_level_t)(x))
+#define DB_LEVEL_FLOAT(x) (x)
+#endif
+
+/// The level of an average envelope @p sum / @p n in dB, averages below 1 count as 1.
+db_level_t baseband_amp_sum_db(uint32_t sum, uint32_t n);
+
+/// The level of an average magnitude @p sum / @p n in dB, averages below 1 count as 1.
+db_level_t baseband_mag_sum_db(uint32_t sum, uint32_t n);
+
 /** This will give a noisy envelope of OOK/ASK signals.
 
     Subtract the bias (-128) and get an envelope estimation (absolute squared).
@@ -24,14 +90,62 @@
     @param len number of samples to process
     @return the average level in dB
 */
-float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+db_level_t envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 
 // for evaluation
-float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
-float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
-float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
-float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
-float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+db_level_t envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+db_level_t magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+db_level_t magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+db_level_t magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+db_level_t magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+
+/** Estimate the average level of a CU8 buffer from a strided subsample, writes no envelope.
+
+    @param iq_buf input samples (I/Q samples in interleaved uint8)
+    @param len number of samples
+    @param use_mag_est estimate the level of magnitude_est_cu8(), otherwise of envelope_detect()
+    @param stride use every stride-th sample
+    @return the estimated average level in dB
+*/
+db_level_t baseband_level_estimate_cu8(uint8_t const *iq_buf, uint32_t len, int use_mag_est, unsigned stride);
+
+/** Estimate the average level of a CS16 buffer from a strided subsample, writes no envelope.
+
+    @param iq_buf input samples (I/Q samples in interleaved int16)
+    @param len number of samples
+    @param stride use every stride-th sample
+    @return the estimated average level of magnitude_est_cs16() in dB
+*/
+db_level_t baseband_level_estimate_cs16(int16_t const *iq_buf, uint32_t len, unsigned stride);
+
+#define IQ_STATS_BINS 8 ///< histogram bins of the peak amplitude, 6 dB each below full scale
+
+/// Amplitude statistics of raw I/Q samples, e.g. for a gain control.
+typedef struct iq_stats {
+    uint32_t samples;             ///< samples counted
+    uint32_t clipped;             ///< samples with I or Q at full scale
+    uint32_t bins[IQ_STATS_BINS]; ///< samples by peak amplitude max(|I|, |Q|), bin 0 is within 6 dB of full scale
+} iq_stats_t;
+
+/** Add the amplitude statistics of a CU8 buffer from a strided subsample.
+
+    @param iq_buf input samples (I/Q samples in interleaved uint8)
+    @param len number of samples
+    @param stride use every stride-th sample
+    @param[in,out] stats the statistics to add to
+*/
+void baseband_iq_stats_cu8(uint8_t const *iq_buf, uint32_t len, unsigned stride, iq_stats_t *stats);
+
+/** Add the amplitude statistics of a CS16 buffer from a strided subsample.
+
+    Samples from 0x7ff0 count as clipped, the ADC of most SDRs has 12 bits or fewer.
+
+    @param iq_buf input samples (I/Q samples in interleaved int16)
+    @param len number of samples
+    @param stride use every stride-th sample
+    @param[in,out] stats the statistics to add to
+*/
+void baseband_iq_stats_cs16(int16_t const *iq_buf, uint32_t len, unsigned stride, iq_stats_t *stats);
 
 #define AMP_TO_DB(x) (10.0f * ((x) > 0 ? log10f(x) : 0) - 42.1442f)  // 10*log10f(16384.0f)
 #define MAG_TO_DB(x) (20.0f * ((x) > 0 ? log10f(x) : 0) - 84.2884f)  // 20*log10f(16384.0f)
@@ -93,6 +207,24 @@ typedef struct filter_state {
     int16_t x[FILTER_ORDER];
 } filter_state_t;
 
+/// Largest decimation factor supported.
+#define DECIM_MAX_FACTOR 16
+/// Filter taps per polyphase branch.
+#define DECIM_TAPS_PER_PHASE 16
+#define DECIM_MAX_TAPS (DECIM_MAX_FACTOR * DECIM_TAPS_PER_PHASE)
+
+/// Decimator state buffer.
+typedef struct decimator_state {
+    unsigned factor;                ///< Decimation factor, 0 if not set up
+    unsigned num_taps;              ///< Filter length, DECIM_TAPS_PER_PHASE per phase
+    unsigned skip;                  ///< Input samples to skip until the next output
+    uint32_t nco_phase;             ///< Mixer phase, full turn is 2^32
+    uint32_t nco_step;              ///< Mixer phase increment per input sample, 0 to not shift
+    int16_t taps[DECIM_MAX_TAPS];   ///< Low pass filter coeffs, Q15
+    int16_t hist_i[DECIM_MAX_TAPS]; ///< Previous input samples, real part
+    int16_t hist_q[DECIM_MAX_TAPS]; ///< Previous input samples, imag part
+} decimator_state_t;
+
 /// FM_Demod state buffer.
 typedef struct demodfm_state {
     int32_t xr;        ///< Last I/Q sample, real part
@@ -104,13 +236,14 @@ typedef struct demodfm_state {
     int32_t blp_16[2]; ///< Current low pass filter B coeffs, 16 bit
     int64_t alp_32[2]; ///< Current low pass filter A coeffs, 32 bit
     int64_t blp_32[2]; ///< Current low pass filter B coeffs, 32 bit
+    int poly;          ///< Use the branchless polynomial discriminator instead of the atan2 approximation
 } demodfm_state_t;
 
 /** Lowpass filter.
 
-    Function is stateful.
+    Function is stateful. The output may be the input buffer to filter in place.
     @param x_buf input samples to be filtered
-    @param[out] y_buf output from filter
+    @param[out] y_buf output from filter, may be the same as @p x_buf
     @param len number of samples to process
     @param[in,out] state State to store between chunk processing
 */
@@ -131,6 +264,138 @@ void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_s
 /// For evaluation.
 void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state);
 
+/** Set up a decimator, resets the state.
+
+    @param[out] state the decimator state
+    @param factor decimation factor, 2 to DECIM_MAX_FACTOR
+*/
+void baseband_decimator_init(decimator_state_t *state, unsigned factor);
+
+/** Shift the input down in frequency ahead of the decimator, i.e. select a channel.
+
+    Keeps the mixer phase, so this can be set on every buffer.
+    @param[in,out] state the decimator state
+    @param freq_offset the channel frequency relative to the input center frequency in Hz
+    @param samp_rate sample rate of the input
+*/
+void baseband_decimator_set_shift(decimator_state_t *state, int32_t freq_offset, uint32_t samp_rate);
+
+/** Low pass filter and decimate CU8 samples.
+
+    Function is stateful, input lengths need not be a multiple of the factor.
+    @param x_buf input samples (I/Q samples in interleaved uint8)
+    @param[out] y_buf output samples (I/Q samples in interleaved uint8), may be the input buffer
+    @param len number of input samples
+    @param[in,out] state State to store between chunk processing
+    @return number of output samples
+*/
+uint32_t baseband_decimate_cu8(uint8_t const *x_buf, uint8_t *y_buf, uint32_t len, decimator_state_t *state);
+
+/** Low pass filter and decimate CS16 samples.
+
+    Function is stateful, input lengths need not be a multiple of the factor.
+    @param x_buf input samples (I/Q samples in interleaved int16)
+    @param[out] y_buf output samples (I/Q samples in interleaved int16), may be the input buffer
+    @param len number of input samples
+    @param[in,out] state State to store between chunk processing
+    @return number of output samples
+*/
+uint32_t baseband_decimate_cs16(int16_t const *x_buf, int16_t *y_buf, uint32_t len, decimator_state_t *state);
+
+/// On demand FM demodulation of one buffer.
+typedef struct demodfm_lazy {
+    void const *iq_buf;      ///< input samples, CU8 or CS16
+    int cs16;                ///< input samples are CS16
+    int16_t *fm_buf;         ///< FM demodulated output
+    uint32_t len;            ///< number of samples in the buffer
+    uint32_t pos;            ///< samples up to here are valid in fm_buf
+    uint32_t samp_rate;      ///< sample rate of samples to process
+    float low_pass;          ///< Low-pass filter frequency or ratio
+    demodfm_state_t *state;  ///< FM demodulator state
+} demodfm_lazy_t;
+
+/** Start on demand FM demodulation of a buffer.
+
+    @param[out] lazy the lazy demodulator
+    @param iq_buf input samples (I/Q samples in interleaved uint8 or int16)
+    @param cs16 input samples are CS16 instead of CU8
+    @param[out] fm_buf output from FM demodulator, filled on demand
+    @param len number of samples in the buffer
+    @param samp_rate sample rate of samples to process
+    @param low_pass Low-pass filter frequency or ratio
+    @param[in,out] state FM demodulator state, kept across buffers
+*/
+void baseband_demod_FM_lazy_start(demodfm_lazy_t *lazy, void const *iq_buf, int cs16, int16_t *fm_buf, uint32_t len,
+        uint32_t samp_rate, float low_pass, demodfm_state_t *state);
+
+/** Demodulate FM up to and including sample @p end.
+
+    Demodulates at least a chunk ahead, skipped spans are bridged with a short
+    warm-up so the low pass output matches a full demodulation.
+
+    @param lazy the lazy demodulator
+    @param end the sample index needed
+    @return the number of valid samples in fm_buf
+*/
+uint32_t baseband_demod_FM_lazy(demodfm_lazy_t *lazy, uint32_t end);
+
+/** Finish a buffer, demodulates the tail to keep the FM state consistent for the next buffer.
+
+    @param lazy the lazy demodulator
+*/
+void baseband_demod_FM_lazy_finish(demodfm_lazy_t *lazy);
+
+/** Fused AM and FM demodulator for CU8.
+
+    Runs the envelope (or magnitude) estimator, the AM low pass filter and the FM demodulator
+    in cache-sized blocks, so each IQ sample is read from memory once.
+    The output matches the separate functions (the block low pass may differ by 1 LSB).
+
+    @param iq_buf input samples (I/Q samples in interleaved uint8)
+    @param[out] am_buf AM demodulated and low pass filtered output
+    @param[out] fm_buf FM demodulated output, NULL to skip FM demodulation
+    @param len number of samples to process
+    @param use_mag_est use the magnitude estimator instead of the envelope
+    @param[in,out] lp_state AM low pass state
+    @param samp_rate sample rate of samples to process
+    @param low_pass FM low-pass filter frequency or ratio
+    @param[in,out] fm_state FM demodulator state
+    @return the average level in dB
+*/
+db_level_t baseband_demod_fused_cu8(uint8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, uint32_t len, int use_mag_est,
+        filter_state_t *lp_state, uint32_t samp_rate, float low_pass, demodfm_state_t *fm_state);
+
+/// Fused AM and FM demodulator for CS16, see baseband_demod_fused_cu8().
+db_level_t baseband_demod_fused_cs16(int16_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, uint32_t len,
+        filter_state_t *lp_state, uint32_t samp_rate, float low_pass, demodfm_state_t *fm_state);
+
+/// Convert CU8 to CS16 values, i.e. scale Q0.7 to Q0.15, @p n is twice the number of I/Q samples.
+void baseband_convert_cu8_cs16(uint8_t const *src, int16_t *dst, unsigned long n);
+
+/// Convert CS16 to CU8 values, i.e. scale Q0.15 to Q0.7 rounding toward zero.
+void baseband_convert_cs16_cu8(int16_t const *src, uint8_t *dst, unsigned long n);
+
+/// Convert CU8 to CS8 values.
+void baseband_convert_cu8_cs8(uint8_t const *src, int8_t *dst, unsigned long n);
+
+/// Convert CS16 to CS8 values, keeping the high byte.
+void baseband_convert_cs16_cs8(int16_t const *src, int8_t *dst, unsigned long n);
+
+/** Convert CU8 values to float, scaled from Q0.7 to [-1, 1).
+
+    SIMD kernels convert with a @p stride of 1, e.g. all of CF32,
+    a stride of 2 picks the I or Q values.
+
+    @param src the CU8 values
+    @param[out] dst the float values
+    @param n number of values to output
+    @param stride distance of the input values, 1 for all
+*/
+void baseband_convert_cu8_f32(uint8_t const *src, float *dst, unsigned long n, unsigned stride);
+
+/// Convert S16 or CS16 values to float, scaled from Q0.15, see baseband_convert_cu8_f32().
+void baseband_convert_s16_f32(int16_t const *src, float *dst, unsigned long n, unsigned stride);
+
 /** Initialize tables and constants.
     Should be called once at startup.
 */
@@ -12,6 +12,7 @@
 #ifndef INCLUDE_BIT_UTIL_H_
 #define INCLUDE_BIT_UTIL_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 /// Reverse (reflect) the bits in an 32 bit byte.
@@ -27,6 +28,18 @@ uint32_t reverse32(uint32_t x);
 /// @return bit reversed byte
 uint8_t reverse8(uint8_t x);
 
+/// Reverse (reflect) the bits in each of the 8 bytes of a word, the bytes keep their order.
+///
+/// @param x input bytes
+/// @return bit reversed bytes
+static inline uint64_t reverse8_u64(uint64_t x)
+{
+    x = (x & 0xF0F0F0F0F0F0F0F0ULL) >> 4 | (x & 0x0F0F0F0F0F0F0F0FULL) << 4;
+    x = (x & 0xCCCCCCCCCCCCCCCCULL) >> 2 | (x & 0x3333333333333333ULL) << 2;
+    x = (x & 0xAAAAAAAAAAAAAAAAULL) >> 1 | (x & 0x5555555555555555ULL) << 1;
+    return x;
+}
+
 /// Reflect (reverse LSB to MSB) each byte of a number of bytes.
 ///
 /// @param message bytes of message data
@@ -39,12 +52,47 @@ void reflect_bytes(uint8_t message[], unsigned num_bytes);
 /// @return reflected nibbles
 uint8_t reflect4(uint8_t x);
 
+/// Reflect (reverse LSB to MSB) each of the 16 nibbles of a word, preserves nibble order.
+///
+/// @param x input nibbles
+/// @return reflected nibbles
+static inline uint64_t reflect4_u64(uint64_t x)
+{
+    x = (x & 0xCCCCCCCCCCCCCCCCULL) >> 2 | (x & 0x3333333333333333ULL) << 2;
+    x = (x & 0xAAAAAAAAAAAAAAAAULL) >> 1 | (x & 0x5555555555555555ULL) << 1;
+    return x;
+}
+
 /// Reflect (reverse LSB to MSB) each nibble in a number of bytes.
 ///
 /// @param message bytes of nibble message data
 /// @param num_bytes number of bytes to reflect
 void reflect_nibbles(uint8_t message[], unsigned num_bytes);
 
+/// Read 64 bits of a message at a bit position, MSB first, bytes past the message read as zero.
+///
+/// At least the first 57 bits are valid, a decoder shifts through the word
+/// instead of reading a bit at a time.
+///
+/// @param message bytes of message data
+/// @param num_bytes length of the message in bytes
+/// @param offset_bits position of the first bit
+/// @return the bits from the position in the MSBs
+static inline uint64_t peek_bits64(uint8_t const *message, unsigned num_bytes, unsigned offset_bits)
+{
+    unsigned pos  = offset_bits / 8;
+    uint64_t word = 0;
+    if (pos + 8 <= num_bytes) {
+        for (unsigned i = 0; i < 8; ++i)
+            word = word << 8 | message[pos + i];
+    }
+    else {
+        for (unsigned i = 0; i < 8; ++i)
+            word = word << 8 | (pos + i < num_bytes ? message[pos + i] : 0);
+    }
+    return word << (offset_bits % 8);
+}
+
 /// Unstuff nibbles with 1-bit separator (4B1S) to bytes, returns number of successfully unstuffed nibbles.
 ///
 /// @param message bytes of message data
@@ -196,4 +244,35 @@ int add_bytes(uint8_t const message[], unsigned num_bytes);
 /// @return summation value
 int add_nibbles(uint8_t const message[], unsigned num_bytes);
 
+#define FNV1A_INIT   2166136261u          ///< the offset basis of fnv1a()
+#define FNV1A64_INIT 14695981039346656037u ///< the offset basis of fnv1a64()
+
+/// Add bytes to a 32 bit FNV-1a hash, e.g. for a hash table, not for a check.
+///
+/// @param hash the hash so far, FNV1A_INIT to start
+/// @param buf the bytes to add
+/// @param len number of bytes
+/// @return the hash with the bytes added
+static inline uint32_t fnv1a(uint32_t hash, void const *buf, size_t len)
+{
+    uint8_t const *p = buf;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ p[i]) * 16777619u;
+    return hash;
+}
+
+/// Add bytes to a 64 bit FNV-1a hash.
+///
+/// @param hash the hash so far, FNV1A64_INIT to start
+/// @param buf the bytes to add
+/// @param len number of bytes
+/// @return the hash with the bytes added
+static inline uint64_t fnv1a64(uint64_t hash, void const *buf, size_t len)
+{
+    uint8_t const *p = buf;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ p[i]) * 1099511628211u;
+    return hash;
+}
+
 #endif /* INCLUDE_BIT_UTIL_H_ */
@@ -0,0 +1,116 @@
+/** @file
+    A bit arena, rows of any length in one contiguous buffer.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_BITARENA_H_
+#define INCLUDE_BITARENA_H_
+
+#include "bitbuffer.h"
+
+#include <stdint.h>
+
+/*
+The arena holds the bits of all rows back to back in one heap buffer, each
+row starts on a byte boundary. A table of row offsets, lengths, and sync
+counts grows with the rows, there is no row or column limit. Short rows only
+use the bytes they need, long rows need no spilling.
+
+The rows are added like in a bitbuffer_t: the first bit adds the first row
+automatically, add_row() and add_sync() start a new row.
+
+Decoders take a bitbuffer_t, bitarena_to_bitbuffer() copies a window of rows
+into one. A row longer than a bitbuffer row spills into the following
+bitbuffer rows, as with bitbuffer_add_bit().
+*/
+
+/// A row of the arena.
+typedef struct bitarena_row {
+    uint32_t offset; ///< byte offset of the row in the arena
+    uint32_t len;    ///< number of bits in the row
+    uint32_t syncs;  ///< number of sync pulses before the row
+} bitarena_row_t;
+
+/// Rows of bits in one buffer, zero-initialize to start empty.
+typedef struct bitarena {
+    uint8_t *bits;        ///< the row bytes, unused bytes are zero
+    uint32_t bits_size;   ///< allocated bytes
+    bitarena_row_t *rows; ///< the row table
+    unsigned num_rows;    ///< number of active rows
+    unsigned rows_size;   ///< allocated rows
+} bitarena_t;
+
+/// Free the arena buffers, the arena is empty after.
+void bitarena_free(bitarena_t *arena);
+
+/// Remove all rows, keeps the buffers for reuse.
+void bitarena_clear(bitarena_t *arena);
+
+/** Add a single bit at the end of the last row (MSB first).
+
+    @return 0 on success, -1 on alloc failure, the bit is dropped
+*/
+int bitarena_add_bit(bitarena_t *arena, int bit);
+
+/** Add a run of @p count equal bits at the end of the last row.
+
+    @return 0 on success, -1 on alloc failure, the bits are dropped
+*/
+int bitarena_add_bits_run(bitarena_t *arena, int bit, unsigned count);
+
+/** Add the low @p nbits bits of @p word at the end of the last row (MSB first), @p nbits at most 64.
+
+    @return 0 on success, -1 on alloc failure, the bits are dropped
+*/
+int bitarena_add_bits(bitarena_t *arena, uint64_t word, unsigned nbits);
+
+/** Add a new row, the first row is added on the first bit.
+
+    @return 0 on success, -1 on alloc failure
+*/
+int bitarena_add_row(bitarena_t *arena);
+
+/** Increment the sync count of the last row, a new row is added if the last row has bits.
+
+    @return 0 on success, -1 on alloc failure
+*/
+int bitarena_add_sync(bitarena_t *arena);
+
+/// The bytes of a row.
+static inline uint8_t *bitarena_row_bits(bitarena_t const *arena, unsigned row)
+{
+    return arena->bits + arena->rows[row].offset;
+}
+
+/// The number of bits in a row.
+static inline unsigned bitarena_row_len(bitarena_t const *arena, unsigned row)
+{
+    return arena->rows[row].len;
+}
+
+/** Copy rows of the arena into a bitbuffer for the decoders.
+
+    The bitbuffer is cleared, then rows are copied from @p first_row while they fit.
+    A row that does not fit into the remaining bitbuffer rows is truncated
+    only if it is the first row copied, call again with the next row to copy the rest.
+
+    @param arena the arena
+    @param first_row the first row to copy
+    @param[out] bits the bitbuffer
+    @return the number of arena rows copied
+*/
+unsigned bitarena_to_bitbuffer(bitarena_t const *arena, unsigned first_row, bitbuffer_t *bits);
+
+/** Append the rows of a bitbuffer to the arena.
+
+    @return 0 on success, -1 on alloc failure
+*/
+int bitarena_add_bitbuffer(bitarena_t *arena, bitbuffer_t const *bits);
+
+#endif /* INCLUDE_BITARENA_H_ */
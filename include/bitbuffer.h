@@ -41,9 +41,20 @@ typedef struct bitbuffer {
 /// Clear the content of the bitbuffer.
 void bitbuffer_clear(bitbuffer_t *bits);
 
+/// Clear the content of the bitbuffer, only touches the rows in use.
+///
+/// The rows past the rows in use must already be clear, e.g. from bitbuffer_clear().
+void bitbuffer_clear_used(bitbuffer_t *bits);
+
 /// Add a single bit at the end of the bitbuffer (MSB first).
 void bitbuffer_add_bit(bitbuffer_t *bits, int bit);
 
+/// Add a run of @p count equal bits at the end of the bitbuffer, whole bytes at a time.
+void bitbuffer_add_bits_run(bitbuffer_t *bits, int bit, unsigned count);
+
+/// Add the low @p nbits bits of @p word at the end of the bitbuffer (MSB first), @p nbits at most 64.
+void bitbuffer_add_bits(bitbuffer_t *bits, uint64_t word, unsigned nbits);
+
 /// Add a new row to the bitbuffer.
 void bitbuffer_add_row(bitbuffer_t *bits);
 
@@ -65,6 +76,23 @@ void bitbuffer_nrzs_decode(bitbuffer_t *bits);
 /// "One" is represented by change in level, "Zero" is represented by no change in level.
 void bitbuffer_nrzm_decode(bitbuffer_t *bits);
 
+/// Reflect (reverse LSB to MSB) each byte of all rows in the bitbuffer.
+void bitbuffer_reflect(bitbuffer_t *bits);
+
+/// Invert all bits into a scratch bitbuffer, @p bits is unchanged.
+///
+/// Only the rows in use are copied, @p out may be a reused buffer or @p bits itself.
+void bitbuffer_invert_to(bitbuffer_t const *bits, bitbuffer_t *out);
+
+/// NRZ-S decode into a scratch bitbuffer, @p bits is unchanged, see bitbuffer_invert_to().
+void bitbuffer_nrzs_decode_to(bitbuffer_t const *bits, bitbuffer_t *out);
+
+/// NRZ-M decode into a scratch bitbuffer, @p bits is unchanged, see bitbuffer_invert_to().
+void bitbuffer_nrzm_decode_to(bitbuffer_t const *bits, bitbuffer_t *out);
+
+/// Reflect each byte into a scratch bitbuffer, @p bits is unchanged, see bitbuffer_invert_to().
+void bitbuffer_reflect_to(bitbuffer_t const *bits, bitbuffer_t *out);
+
 /// Print the content of the bitbuffer.
 /// @deprecated For debug only, use decoder_log_bitbuffer otherwise
 void bitbuffer_print(const bitbuffer_t *bits);
@@ -111,6 +139,42 @@ void bitbuffer_parse(bitbuffer_t *bits, const char *code);
 unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
         const uint8_t *pattern, unsigned pattern_bits_len);
 
+/// A search pattern prepared for bitbuffer_search_pattern().
+typedef struct bitbuffer_pattern {
+    uint64_t mask;          ///< first up to 56 bits of the pattern, from the high bit
+    uint64_t value;         ///< pattern bits under the mask
+    const uint8_t *pattern; ///< the remaining bits are compared one at a time
+    unsigned bits;
+} bitbuffer_pattern_t;
+
+/// Prepare a pattern for repeated searches, see bitbuffer_search().
+///
+/// The pattern is not copied and needs to outlive the prepared pattern.
+bitbuffer_pattern_t bitbuffer_search_prepare(const uint8_t *pattern, unsigned pattern_bits_len);
+
+/// Search the specified row of the bitbuffer, starting from bit 'start', for
+/// a prepared pattern. Compares a word at a time, for a match of the first
+/// 56 bits of the pattern at each position.
+///
+/// @return the location of the first match, or the end of the row if no match is found.
+unsigned bitbuffer_search_pattern(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        bitbuffer_pattern_t const *pattern);
+
+/// A summary of the 16 bit windows in the rows of a bitbuffer, rules out patterns without a search.
+///
+/// Built once for bits shared by many decoders, e.g. the flex decoders of a timing.
+typedef struct bitbuffer_windows {
+    uint64_t bloom[64]; ///< a bit for each hashed 16 bit window found in any row
+} bitbuffer_windows_t;
+
+/// Build the window summary of all rows of a bitbuffer.
+void bitbuffer_windows_build(bitbuffer_t *bits, bitbuffer_windows_t *windows);
+
+/// Check if any row of the summarized bitbuffer may contain a prepared pattern.
+///
+/// @return 0 if no row contains the pattern, 1 if a search is needed
+int bitbuffer_windows_may_match(bitbuffer_windows_t const *windows, bitbuffer_pattern_t const *pattern);
+
 /// Manchester decoding from one bitbuffer into another, starting at the
 /// specified row and start bit.
 ///
@@ -143,6 +207,23 @@ int bitbuffer_compare_rows(bitbuffer_t *bits, unsigned row_a, unsigned row_b, un
 /// The returned count will include the given row and will be at least 1.
 unsigned bitbuffer_count_repeats(bitbuffer_t *bits, unsigned row, unsigned max_bits);
 
+/// A row of a bitbuffer and the number of rows equal to it, see bitbuffer_unique_rows().
+typedef struct bitbuffer_row_repeats {
+    uint16_t row;     ///< index of the first of the equal rows
+    uint16_t repeats; ///< number of equal rows, at least 1
+} bitbuffer_row_repeats_t;
+
+/// Group the equal rows of a bitbuffer, rows are compared as with bitbuffer_compare_rows().
+///
+/// Decoders with often repeated rows can check each distinct row once.
+/// The rows are hashed, this is linear in the number of rows for rows that differ.
+///
+/// @param bits the bitbuffer
+/// @param max_bits if greater than 0 then only up that many bits are compared
+/// @param[out] unique at least `bits->num_rows` entries, filled in order of the first of the equal rows
+/// @return the number of distinct rows
+unsigned bitbuffer_unique_rows(bitbuffer_t *bits, unsigned max_bits, bitbuffer_row_repeats_t *unique);
+
 /// Find a row repeated at least @p min_repeats times and with at least @p min_bits bits length,
 /// all bits in the repeats need to match.
 /// @return the row index or -1.
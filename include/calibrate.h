@@ -0,0 +1,102 @@
+/** @file
+    Startup calibration, pick the fastest baseband kernels and block length on this machine.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CALIBRATE_H_
+#define INCLUDE_CALIBRATE_H_
+
+#include "baseband.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+All SIMD kernels give bit-exact results and the fused demodulators give the
+same results for any block length, but which is fastest depends on the CPU,
+its caches, and the buffer length: a wider vector unit may clock down, a
+smaller block may stay in a smaller cache. The calibration runs the fused
+AM/FM demodulator on a synthetic signal of the buffer length, with each
+kernel set the CPU supports and each block length, and keeps the fastest.
+
+The choice is cached in a file, a line for each key of the CPU model, the
+build, the sample rate, and the buffer length. A live SDR input calibrates
+if there is no cached choice, other inputs only use a cached choice. -Y
+calibrate measures again and replaces the cached choice.
+*/
+
+#define CALIBRATE_RUNS    3 ///< runs of each candidate, the fastest run counts
+#define CALIBRATE_SAMPLES (1 << 18) ///< most samples of the synthetic signal
+#define CALIBRATE_KEY_MAX 512 ///< longest key of a cached choice
+
+/// Where a choice comes from.
+enum calibration_source {
+    CALIBRATION_DEFAULT,  ///< the defaults of baseband_init(), not calibrated
+    CALIBRATION_CACHED,   ///< read from the cache file
+    CALIBRATION_MEASURED, ///< measured on this run
+};
+
+/// The kernels and block length chosen.
+typedef struct calibration {
+    baseband_simd_t simd;  ///< the kernels
+    uint32_t fused_block;  ///< samples per block of the fused demodulators
+    int source;            ///< one of calibration_source
+    double msps;           ///< speed of the choice in mega samples per second, 0 if not measured
+    double msps_default;   ///< speed of the defaults, 0 if not measured
+} calibration_t;
+
+/** Get the key of a cached choice, the CPU model, the build, the sample rate, and the buffer length.
+
+    @param[out] key the key
+    @param key_len the size of @p key, e.g. CALIBRATE_KEY_MAX
+    @param build the build, e.g. the version string
+    @param samp_rate the sample rate
+    @param n_samples the samples per buffer
+*/
+void calibrate_key(char *key, size_t key_len, char const *build, uint32_t samp_rate, uint32_t n_samples);
+
+/** Measure the kernels and block lengths on a synthetic CU8 signal, the current choice is restored.
+
+    @param samp_rate the sample rate
+    @param n_samples the samples per buffer, at most CALIBRATE_SAMPLES are measured
+    @param[out] cal the fastest choice
+    @return 0 on success, -1 on alloc failure
+*/
+int calibrate_measure(uint32_t samp_rate, uint32_t n_samples, calibration_t *cal);
+
+/** Read a cached choice.
+
+    @param path the cache file
+    @param key the key of the choice
+    @param[out] cal the choice
+    @return 0 if found, -1 if there is no choice for the key or it is not supported
+*/
+int calibrate_load(char const *path, char const *key, calibration_t *cal);
+
+/** Write a choice to the cache, the other keys are kept.
+
+    @param path the cache file, the directories are created as needed
+    @param key the key of the choice
+    @param cal the choice
+    @return 0 on success, -1 on error
+*/
+int calibrate_save(char const *path, char const *key, calibration_t const *cal);
+
+/// Use a choice, see baseband_set_simd() and baseband_set_fused_block().
+void calibrate_apply(calibration_t const *cal);
+
+/** Get the default cache file, e.g. "$HOME/.cache/rtl_433/calibration".
+
+    @param[out] path the path
+    @param path_len the size of @p path
+    @return 0 on success, -1 if there is no home or cache directory
+*/
+int calibrate_default_path(char *path, size_t path_len);
+
+#endif /* INCLUDE_CALIBRATE_H_ */
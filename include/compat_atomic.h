@@ -0,0 +1,191 @@
+/** @file
+    compat_atomic addresses compatibility atomic operations and thread local storage.
+
+    topic: lock free counters, flags, and ring positions shared by threads
+    issue: C99 has neither, the compilers have builtins of their own
+    solution: wrap the GCC/Clang __atomic builtins and the MSVC intrinsics
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_COMPAT_ATOMIC_H_
+#define INCLUDE_COMPAT_ATOMIC_H_
+
+#include <stdint.h>
+
+/*
+The operations take a pointer to a naturally aligned 32 or 64 bit integer,
+or to a pointer with atomic_cas_ptr(). Loads acquire, stores release, the
+read-modify-write operations are sequenced as noted. Other compilers get
+plain accesses, as if there was a single thread.
+
+A 64 bit integer is lock free if ATOMIC_64_LOCK_FREE is 1, i.e. on the 64
+bit targets, 32 bit x86, and 32 bit ARM from v7. Elsewhere the generic
+operations on it need libatomic, use atomic_get64(), atomic_set64(), and
+atomic_add64() instead, these fall back to a process wide lock. Memory
+shared with other processes must use lock free integers.
+*/
+
+#if defined(_MSC_VER)
+#define COMPAT_TLS __declspec(thread)
+#else
+#define COMPAT_TLS __thread
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#if __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#define ATOMIC_64_LOCK_FREE 1
+#else
+#define ATOMIC_64_LOCK_FREE 0
+#endif
+
+/// Load with acquire.
+#define atomic_get(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+/// Load without ordering, e.g. a counter.
+#define atomic_get_relaxed(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+/// Store with release.
+#define atomic_set(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+/// Store without ordering.
+#define atomic_set_relaxed(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+/// Add without ordering, returns the new value.
+#define atomic_add(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+/// Exchange with acquire and release, returns the previous value.
+#define atomic_xchg(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+/// Set to @p v if it is @p e, with acquire and release, returns 1 on success.
+#define atomic_cas(p, e, v) atomic_cas_impl_((p), (e), (v))
+#define atomic_cas_impl_(p, e, v) \
+    __extension__({ \
+        __typeof__(*(p)) atomic_expected_ = (e); \
+        __atomic_compare_exchange_n((p), &atomic_expected_, (v), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); \
+    })
+#define atomic_fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define atomic_fence_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+/// Set a pointer to @p v if it is @p e, returns the previous pointer.
+static inline void *atomic_cas_ptr(void **p, void *e, void *v)
+{
+    __atomic_compare_exchange_n(p, &e, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return e;
+}
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define ATOMIC_64_LOCK_FREE 1
+
+// cmpxchg8b makes the 64 bit operations lock free on 32 bit x86 too
+static inline int64_t atomic_add64_impl_(int64_t volatile *p, int64_t v)
+{
+    int64_t old;
+    do
+        old = *p;
+    while (_InterlockedCompareExchange64(p, old + v, old) != old);
+    return old + v;
+}
+
+static inline int64_t atomic_xchg64_impl_(int64_t volatile *p, int64_t v)
+{
+    int64_t old;
+    do
+        old = *p;
+    while (_InterlockedCompareExchange64(p, v, old) != old);
+    return old;
+}
+
+#define atomic_get(p) (sizeof(*(p)) == 8 \
+        ? _InterlockedCompareExchange64((int64_t volatile *)(p), 0, 0) \
+        : (int64_t)_InterlockedOr((long volatile *)(p), 0))
+#define atomic_get_relaxed(p) atomic_get(p)
+#define atomic_xchg(p, v) (sizeof(*(p)) == 8 \
+        ? atomic_xchg64_impl_((int64_t volatile *)(p), (int64_t)(v)) \
+        : (int64_t)_InterlockedExchange((long volatile *)(p), (long)(v)))
+#define atomic_set(p, v) ((void)atomic_xchg((p), (v)))
+#define atomic_set_relaxed(p, v) atomic_set((p), (v))
+#define atomic_add(p, v) (sizeof(*(p)) == 8 \
+        ? atomic_add64_impl_((int64_t volatile *)(p), (int64_t)(v)) \
+        : (int64_t)(_InterlockedExchangeAdd((long volatile *)(p), (long)(v)) + (long)(v)))
+#define atomic_cas(p, e, v) (sizeof(*(p)) == 8 \
+        ? _InterlockedCompareExchange64((int64_t volatile *)(p), (int64_t)(v), (int64_t)(e)) == (int64_t)(e) \
+        : _InterlockedCompareExchange((long volatile *)(p), (long)(v), (long)(e)) == (long)(e))
+// the interlocked operations are full barriers, the plain accesses are ordered on x86
+#define atomic_fence_acquire() _ReadWriteBarrier()
+#define atomic_fence_release() _ReadWriteBarrier()
+
+static inline void *atomic_cas_ptr(void **p, void *e, void *v)
+{
+    return _InterlockedCompareExchangePointer((void *volatile *)p, v, e);
+}
+
+#else
+
+#define ATOMIC_64_LOCK_FREE 0
+
+// no threads assumed
+#define atomic_get(p) (*(p))
+#define atomic_get_relaxed(p) (*(p))
+#define atomic_set(p, v) ((void)(*(p) = (v)))
+#define atomic_set_relaxed(p, v) ((void)(*(p) = (v)))
+#define atomic_add(p, v) (*(p) += (v))
+#define atomic_fence_acquire()
+#define atomic_fence_release()
+
+static inline long atomic_xchg_impl_(long *p, long v)
+{
+    long old = *p;
+    *p = v;
+    return old;
+}
+#define atomic_xchg(p, v) atomic_xchg_impl_((long *)(p), (long)(v))
+#define atomic_cas(p, e, v) (*(p) == (e) ? (*(p) = (v), 1) : 0)
+
+static inline void *atomic_cas_ptr(void **p, void *e, void *v)
+{
+    void *old = *p;
+    if (old == e)
+        *p = v;
+    return old;
+}
+
+#endif
+
+#if ATOMIC_64_LOCK_FREE
+
+/// Load a 64 bit integer with acquire, lock free.
+static inline uint64_t atomic_get64(uint64_t const *p)
+{
+    return (uint64_t)atomic_get(p);
+}
+
+/// Store a 64 bit integer with release, lock free.
+static inline void atomic_set64(uint64_t *p, uint64_t v)
+{
+    atomic_set(p, v);
+}
+
+/// Add to a 64 bit integer without ordering, lock free, returns the new value.
+static inline uint64_t atomic_add64(uint64_t *p, uint64_t v)
+{
+    return (uint64_t)atomic_add(p, v);
+}
+
+#else
+
+/// Load a 64 bit integer under the process wide lock.
+uint64_t atomic_get64(uint64_t const *p);
+
+/// Store a 64 bit integer under the process wide lock.
+void atomic_set64(uint64_t *p, uint64_t v);
+
+/// Add to a 64 bit integer under the process wide lock, returns the new value.
+uint64_t atomic_add64(uint64_t *p, uint64_t v);
+
+#endif
+
+#endif /* INCLUDE_COMPAT_ATOMIC_H_ */
@@ -0,0 +1,68 @@
+/** @file
+    CPU time profile of the processing stages, decoders, and outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CPU_PROFILE_H_
+#define INCLUDE_CPU_PROFILE_H_
+
+#include "cpu_stats.h"
+
+#include <stdint.h>
+#include <time.h>
+
+struct r_cfg;
+struct r_device;
+
+/// The counters of a decoder at the start of a profile.
+typedef struct cpu_profile_decoder {
+    struct r_device const *r_dev; ///< only compared, the decoder may be gone
+    uint64_t slice_ns;
+    uint64_t decode_ns;
+} cpu_profile_decoder_t;
+
+/** A profile of the CPU time counters over some time.
+
+    Keeps the counters at the start and reports the time spent since then,
+    the timing is turned on for the profile if it is not already on with -M cputime.
+*/
+typedef struct cpu_profile {
+    int running;     ///< counting, until cpu_profile_stop()
+    int was_enabled; ///< the timing was on before the profile started
+    time_t start_time;
+    time_t stop_time;
+    uint64_t stages[CPU_STAGE_COUNT];
+    cpu_profile_decoder_t *decoders;
+    unsigned num_decoders;
+    uint64_t *outputs;
+    unsigned num_outputs;
+    char *folded; ///< the result of a stopped profile, NULL if none
+} cpu_profile_t;
+
+/// Start or restart a profile of the first input and the outputs.
+void cpu_profile_start(cpu_profile_t *prof, struct r_cfg *cfg);
+
+/// Stop a running profile and keep the result, does nothing if not running.
+void cpu_profile_stop(cpu_profile_t *prof, struct r_cfg *cfg);
+
+/** Render a profile as folded stacks, the input of flamegraph.pl.
+
+    One line per stack, e.g. "sdr_callback;run_ook_demods;pulse_slicer_pwm;Acurite 986 1234",
+    the value is the CPU time in microseconds.
+
+    @param prof the profile, a running one is reported up to now
+    @param cfg the config
+    @return the text to free(), NULL if there is no profile
+*/
+char *cpu_profile_folded(cpu_profile_t const *prof, struct r_cfg *cfg);
+
+/// Free the data of a profile, stops it first.
+void cpu_profile_free(cpu_profile_t *prof, struct r_cfg *cfg);
+
+#endif /* INCLUDE_CPU_PROFILE_H_ */
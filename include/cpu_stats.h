@@ -0,0 +1,52 @@
+/** @file
+    CPU time accounting of the processing stages, decoders, and outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CPU_STATS_H_
+#define INCLUDE_CPU_STATS_H_
+
+#include <stdint.h>
+
+/// Processing stages of a demodulated buffer.
+enum cpu_stage {
+    CPU_STAGE_DECIMATE, ///< decimation and channel mixing
+    CPU_STAGE_ENVELOPE, ///< AM envelope, includes the low pass (and FM) when fused
+    CPU_STAGE_LOWPASS,  ///< low pass of the envelope
+    CPU_STAGE_FM,       ///< FM demodulation of the whole buffer, on demand FM counts as detect
+    CPU_STAGE_DETECT,   ///< pulse detection
+    CPU_STAGE_DECODE,   ///< decoding of the packages, includes the slicers and decoders
+    CPU_STAGE_COUNT,
+};
+
+/// Cumulative time of a timed section.
+typedef struct cpu_stat {
+    uint64_t ns;    ///< cumulative monotonic clock time in ns
+    unsigned calls; ///< number of timed calls
+} cpu_stat_t;
+
+/// Enable the timing, off by default. Sections started while disabled are not counted.
+void cpu_stats_enable(int enable);
+
+/// Check if the timing is enabled.
+int cpu_stats_enabled(void);
+
+/// Monotonic clock in ns, never 0.
+uint64_t cpu_stats_now(void);
+
+/// Start a timed section, returns 0 if the timing is disabled.
+uint64_t cpu_stats_start(void);
+
+/// End a timed section, does nothing if @p start is 0.
+void cpu_stats_end(cpu_stat_t *stat, uint64_t start);
+
+/// Name of a processing stage.
+char const *cpu_stage_name(enum cpu_stage stage);
+
+#endif /* INCLUDE_CPU_STATS_H_ */
@@ -41,6 +41,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "cpu_stats.h"
 
 typedef enum {
     DATA_DATA,   /**< pointer to data is stored */
@@ -75,8 +76,63 @@ typedef struct data {
     data_value_t value;
     data_type_t type;
     unsigned    retain; /**< incremented on data_retain, data_free only frees if this is zero */
+    unsigned    inline_strs; /**< flags of the strings stored with the element, see data_replace_key() */
+    unsigned    key_id; /**< id of the key, see data_key_id() */
 } data_t;
 
+/// Ids of the well-known keys, sorted by key name. Other keys are 0 unless interned.
+enum data_key_ids {
+    DATA_KEY_OTHER = 0,
+    DATA_KEY_CHANNEL,
+    DATA_KEY_CODES,
+    DATA_KEY_FREQ,
+    DATA_KEY_FREQ1,
+    DATA_KEY_FREQ2,
+    DATA_KEY_ID,
+    DATA_KEY_LVL,
+    DATA_KEY_MIC,
+    DATA_KEY_MOD,
+    DATA_KEY_MODEL,
+    DATA_KEY_MSG,
+    DATA_KEY_NOISE,
+    DATA_KEY_NUM_ROWS,
+    DATA_KEY_PROTOCOL,
+    DATA_KEY_RSSI,
+    DATA_KEY_SNR,
+    DATA_KEY_SRC,
+    DATA_KEY_SUBTYPE,
+    DATA_KEY_TAG,
+    DATA_KEY_TIME,
+    DATA_KEY_TYPE,
+    DATA_KEY_COUNT, ///< the first id of interned keys
+};
+
+/// Strings of a data element not owned by it, allocated with the element or interned.
+enum data_inline_flags {
+    DATA_INLINE_KEY        = 1,
+    DATA_INLINE_PRETTY_KEY = 2,
+    DATA_INLINE_FORMAT     = 4,
+    DATA_INLINE_VALUE      = 8, ///< the string of a DATA_STRING element
+    DATA_CACHE_ELEMENT     = 16, ///< the element is a block of DATA_CACHE_BLOCK bytes, see data_cache_use()
+};
+
+#define DATA_CACHE_BLOCK 128 ///< bytes of a cached element with its strings
+#define DATA_CACHE_MAX   256 ///< most elements a cache keeps
+
+/** Freed data elements kept for reuse, zero-initialize to start empty.
+
+    While a thread uses a cache, the elements whose strings fit into
+    DATA_CACHE_BLOCK bytes are taken from it and the elements it frees are
+    kept in it, up to DATA_CACHE_MAX. A cache must only be used by one
+    thread at a time, the elements may be freed on any thread.
+*/
+typedef struct data_cache {
+    struct data *free_list; ///< the kept elements, chained by next
+    unsigned len;           ///< number of kept elements
+    unsigned hits;          ///< elements taken from the cache
+    unsigned misses;        ///< elements allocated while the cache was empty
+} data_cache_t;
+
 /** Constructs a structured data object.
 
     Example:
@@ -168,12 +224,156 @@ R_API data_array_t *data_array(int num_values, data_type_t type, void const *ptr
 /** Releases a data array. */
 R_API void data_array_free(data_array_t *array);
 
-/** Retain a structure object, returns the structure object passed in. */
+/** Retain a structure object, returns the structure object passed in.
+
+    Retain and release are atomic, a record may be shared with other threads.
+*/
 R_API data_t *data_retain(data_t *data);
 
+/** Copy a structure object deeply, the copy is not retained.
+
+    @return the copy or NULL if there was a memory allocation error.
+*/
+R_API data_t *data_copy(data_t const *data);
+
 /** Releases a structure object if retain is zero, decrement retain otherwise. */
 R_API void data_free(data_t *data);
 
+/** Use a cache for the elements made and freed on the calling thread.
+
+    @param cache the cache, NULL to allocate and free each element
+    @return the cache used before, to restore it
+*/
+R_API data_cache_t *data_cache_use(data_cache_t *cache);
+
+/** Free the elements kept in a cache, the cache must not be in use. */
+R_API void data_cache_clear(data_cache_t *cache);
+
+/** Replaces the key of a data element, takes ownership of the allocated @p key.
+
+    The key, pretty key, format and string value are usually stored with the element,
+    never free() them directly.
+*/
+R_API void data_replace_key(data_t *data, char *key);
+
+/** Replaces the key of a data element with a well-known or interned key, no copy is made. */
+R_API void data_use_key(data_t *data, unsigned key_id);
+
+/** Replaces the format of a data element, takes ownership of the allocated @p format. */
+R_API void data_replace_format(data_t *data, char *format);
+
+/** Returns the id of a key, one of data_key_ids, an interned id, or 0 for other keys.
+
+    Every data element gets the id of its key on construction.
+*/
+R_API unsigned data_key_id(char const *key);
+
+/** Returns the id of a key, adds the key to the interned keys if needed.
+
+    Interning is not thread-safe, intern all keys before decoding starts.
+    Returns 0 on alloc failure.
+*/
+R_API unsigned data_key_intern(char const *key);
+
+/// Returns the name of a well-known or interned key id, NULL for other ids.
+R_API char const *data_key_name(unsigned key_id);
+
+/// Returns the number of key ids, all ids are less than this.
+R_API unsigned data_key_count(void);
+
+/// Returns a hash of the model, id, and channel of an event to tell the sensors apart, 0 if there is no model.
+R_API uint32_t data_sensor_key(data_t const *data);
+
+/// Frees all interned keys, existing ids of interned keys are invalid afterwards.
+R_API void data_key_free_all(void);
+
+/// The top level fields of a record to skip, a flag by key id, the ids 0 and past the end use the flag of id 0.
+typedef struct data_skip {
+    unsigned len;
+    unsigned char flags[];
+} data_skip_t;
+
+/// Returns 1 if a projection skips the top level field @p data, 0 if @p skip is NULL or the field prints.
+R_API int data_skip(data_skip_t const *skip, data_t const *data);
+
+/** Fields an output prints, see data_projection_add().
+
+    The fields are skipped while printing, the record is not copied or changed.
+*/
+typedef struct data_projection data_projection_t;
+
+/// Returns a new projection that prints all fields, NULL on alloc failure.
+R_API data_projection_t *data_projection_create(void);
+
+/** Adds a list of top level fields to print or to skip.
+
+    A field prints if there is no include list for the model or it is in one,
+    and it is not in an exclude list for the model. The lists without a model
+    apply to all models, of the lists with a model those of the first model
+    added that matches.
+    Interns the keys, call before decoding starts.
+
+    @param projection the projection
+    @param rule the fields as "[<model>/]<key>[+<key>...]", a trailing "*" on
+                the model matches all models with that prefix
+    @param exclude 0 to only print the fields, 1 to skip the fields
+    @return 0 on success, -1 on a syntax error or alloc failure
+*/
+R_API int data_projection_add(data_projection_t *projection, char const *rule, int exclude);
+
+/// Returns the fields to skip in an event, NULL to print all, the records without a model always print all.
+R_API data_skip_t const *data_projection_skip(data_projection_t const *projection, data_t const *data);
+
+R_API void data_projection_free(data_projection_t *projection);
+
+/// Formats of a record that can be shared between outputs.
+enum data_render_format {
+    DATA_RENDER_JSONS, ///< compact JSON, see data_print_jsons()
+    DATA_RENDER_CBOR,  ///< CBOR, see data_print_cbor()
+    DATA_RENDER_FORMATS,
+};
+
+/** Renderings of a record shared by the outputs, each format is produced at most once per record.
+
+    The file outputs for JSON, kv and CSV, and the influx line format carry output
+    specific options and are not shared.
+*/
+typedef struct data_render {
+    data_t *data; ///< the record to render
+    data_skip_t const *skip; ///< the fields not rendered, NULL for all fields
+    struct data_render_buf {
+        void *buf;   ///< the rendering of the record, reused between records
+        size_t size;
+        size_t len;
+        int ready;   ///< buf holds the record
+    } formats[DATA_RENDER_FORMATS];
+} data_render_t;
+
+/** Starts rendering a new record with all fields, the buffers are kept. */
+R_API void data_render_start(data_render_t *render, data_t *data);
+
+/** Frees the buffers of a render. */
+R_API void data_render_free(data_render_t *render);
+
+/** Returns the shared compact JSON of a record, see data_print_jsons().
+
+    @param render the shared renderings, may be NULL
+    @param data the data to format
+    @param[out] len the length of the JSON, may be NULL
+    @return the JSON string, NULL if @p data is not the record of @p render,
+            the caller then needs to format on its own
+*/
+R_API char const *data_render_jsons(data_render_t *render, data_t *data, size_t *len);
+
+/** Returns the shared CBOR encoding of a record, see data_print_cbor().
+
+    @param render the shared renderings, may be NULL
+    @param data the data to encode
+    @param[out] len the length of the encoding
+    @return the encoding, NULL if @p data is not the record of @p render
+*/
+R_API uint8_t const *data_render_cbor(data_render_t *render, data_t *data, size_t *len);
+
 struct data_output;
 
 typedef struct data_output {
@@ -184,8 +384,13 @@ typedef struct data_output {
     void (R_API_CALLCONV *print_int)(struct data_output *output, int data, char const *format);
     void (R_API_CALLCONV *output_start)(struct data_output *output, char const *const *fields, int num_fields);
     void (R_API_CALLCONV *output_print)(struct data_output *output, data_t *data);
+    data_t *(R_API_CALLCONV *output_stats)(struct data_output *output); ///< output specific stats for the report, may be NULL
     void (R_API_CALLCONV *output_free)(struct data_output *output);
     int log_level; ///< the maximum log level (verbosity) allowed, more verbose messages must be ignored.
+    cpu_stat_t cpu_stat; ///< time spent in this output
+    data_render_t *render; ///< renderings of the record shared with the other outputs, NULL if none
+    data_projection_t *projection; ///< the fields to print, NULL for all, set before the output starts
+    data_skip_t const *skip; ///< the top level fields of the record printed to skip, NULL for none
 } data_output_t;
 
 /** Setup known field keys and start output, used by CSV only.
@@ -200,6 +405,9 @@ R_API void data_output_start(struct data_output *output, char const *const *fiel
 /** Prints a structured data object, flushes the output if applicable. */
 R_API void data_output_print(struct data_output *output, data_t *data);
 
+/** Prints a structured data object with renderings shared between outputs, flushes the output if applicable. */
+R_API void data_output_print_shared(struct data_output *output, data_t *data, data_render_t *render);
+
 R_API void data_output_free(struct data_output *output);
 
 /* data output helpers */
@@ -210,4 +418,82 @@ R_API void print_array_value(data_output_t *output, data_array_t *array, char co
 
 R_API size_t data_print_jsons(data_t *data, char *dst, size_t len);
 
+/** Encodes a structured data object as CBOR (RFC 8949).
+
+    Objects are maps with text keys, arrays are arrays, ints are integers,
+    doubles are 64-bit floats and strings are text strings. Formats are ignored.
+
+    @return the length of the encoding, 0 if it does not fit @p len
+*/
+R_API size_t data_print_cbor(data_t *data, uint8_t *dst, size_t len);
+
+/** Static schemas, the top level fields of a decoder with their types and formats.
+
+    A decoder with a schema fills a flat record, the values by field index,
+    instead of making data elements one by one. The schema interns the keys
+    and prepares the JSON and CBOR keys when it is created, a record then
+    formats with a pass over the fields set and no key lookup, or makes the
+    data elements for the outputs in one pass with the keys interned.
+*/
+typedef struct data_schema_field {
+    char const *key;
+    char const *pretty_key; ///< NULL for the key
+    data_type_t type;       ///< DATA_INT, DATA_DOUBLE, or DATA_STRING
+    char const *format;     ///< NULL for none
+} data_schema_field_t;
+
+#define DATA_SCHEMA_FIELDS 64 ///< most fields of a schema
+
+typedef struct data_schema data_schema_t;
+
+/// The values of a schema by field index, a bit in set for each value given.
+typedef struct data_record {
+    uint64_t set;
+    data_value_t values[DATA_SCHEMA_FIELDS];
+} data_record_t;
+
+/** Creates a schema, interns the keys, call before decoding starts.
+
+    @param fields the fields in output order, terminated by a NULL key
+    @return the schema, NULL on alloc failure, too many fields, or a type not supported
+*/
+R_API data_schema_t *data_schema_create(data_schema_field_t const *fields);
+
+R_API void data_schema_free(data_schema_t *schema);
+
+/// Sets an int value of a record.
+static inline void data_record_int(data_record_t *record, unsigned idx, int val)
+{
+    record->values[idx].v_int = val;
+    record->set |= (uint64_t)1 << idx;
+}
+
+/// Sets a double value of a record.
+static inline void data_record_dbl(data_record_t *record, unsigned idx, double val)
+{
+    record->values[idx].v_dbl = val;
+    record->set |= (uint64_t)1 << idx;
+}
+
+/// Sets a string value of a record, the string is not copied.
+static inline void data_record_str(data_record_t *record, unsigned idx, char const *val)
+{
+    record->values[idx].v_ptr = (void *)val;
+    record->set |= (uint64_t)1 << idx;
+}
+
+/** Makes the data elements of a record, the fields set in schema order.
+
+    The same as data_make() with the fields set, the elements use the interned keys.
+
+    @return the data, NULL on alloc failure or no field set
+*/
+R_API data_t *data_schema_make(data_schema_t const *schema, data_record_t const *record);
+
+/// Formats a record as compact JSON, the same as data_print_jsons() of data_schema_make().
+R_API size_t data_schema_print_jsons(data_schema_t const *schema, data_record_t const *record, char *dst, size_t len);
+
+/// Encodes a record as CBOR, the same as data_print_cbor() of data_schema_make().
+R_API size_t data_schema_print_cbor(data_schema_t const *schema, data_record_t const *record, uint8_t *dst, size_t len);
+
 #endif // INCLUDE_DATA_H_
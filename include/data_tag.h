@@ -13,6 +13,7 @@
 #define INCLUDE_TAGS_H_
 
 struct gpsd_client;
+struct tag_map;
 struct mg_mgr;
 struct data;
 
@@ -21,6 +22,7 @@ typedef struct data_tag {
     char const *val;
     char const **includes;
     struct gpsd_client *gpsd_client;
+    struct tag_map *tag_map;
 } data_tag_t;
 
 /// Create a data tag. Might fail and return NULL.
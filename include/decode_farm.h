@@ -0,0 +1,190 @@
+/** @file
+    Decode farm, shard the pulse packages of remote receivers over decode workers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECODE_FARM_H_
+#define INCLUDE_DECODE_FARM_H_
+
+#include "pulse_data.h"
+
+#include <stdint.h>
+
+struct data;
+
+/*
+A coordinator reads the pulse packages of the remote receivers (-r udp://)
+and forwards each to one of the workers given with -Y farm=<host>:<port>,
+each a process reading -r farm://[<host>]:<port>. The workers run the
+decoders and the output conversions, tags, and -M options as usual, but
+send the output back instead of printing it. The coordinator prints it
+with its outputs.
+
+The worker of a package is found on a consistent hash ring with
+DECODE_FARM_VNODES points per worker. The key is the fingerprint bucket,
+the width bins of the pulses and gaps without the trailing gap: repeats
+of a sensor and its copies heard by other receivers go to the same worker,
+which keeps its slice caches, decode memos, and -M merge/dedup windows
+warm. Adding or losing a worker only moves the keys of its points.
+
+Each package takes a slot until its result arrives, the result of a
+package without events included. A worker with DECODE_FARM_WINDOW packages
+in flight, or without a result or a reply to the ping sent each
+DECODE_FARM_PING_S for DECODE_FARM_HEALTH_S, is skipped and the package
+goes to the next worker on the ring. With no worker left the package is
+dropped and counted, the UDP input can't push back on the receivers.
+
+The results are output in the order the coordinator received the packages
+of each receiver. A package without a result after DECODE_FARM_RESULT_S is
+counted lost and no longer holds back the later results of its receiver.
+Events a worker outputs later, e.g. -M merge, are output as they arrive.
+*/
+
+#define DECODE_FARM_PORT      "1436" ///< default port of the workers
+#define DECODE_FARM_WORKERS   64   ///< most workers of a coordinator
+#define DECODE_FARM_VNODES    64   ///< ring points of each worker
+#define DECODE_FARM_WINDOW    64   ///< most packages in flight to a worker
+#define DECODE_FARM_PENDING   4096 ///< most packages awaiting their result
+#define DECODE_FARM_PING_S    1.0  ///< interval of the pings to each worker
+#define DECODE_FARM_HEALTH_S  3.0  ///< a worker without a reply for this long is skipped
+#define DECODE_FARM_RESULT_S  2.0  ///< a package without a result for this long is lost
+
+typedef struct decode_farm decode_farm_t;
+
+/// Statistics of a worker.
+typedef struct decode_farm_worker_stats {
+    char const *spec;   ///< the "host:port" of the worker
+    int healthy;        ///< 1 if the worker replied recently
+    unsigned in_flight; ///< packages awaiting their result
+    unsigned sent;      ///< packages sent
+    unsigned spilled;   ///< packages sent to this worker as the next on the ring
+    unsigned results;   ///< results received
+    unsigned events;    ///< events received
+} decode_farm_worker_stats_t;
+
+/// Statistics of the coordinator.
+typedef struct decode_farm_stats {
+    unsigned workers;   ///< number of workers
+    unsigned healthy;   ///< workers that replied recently
+    unsigned pending;   ///< packages awaiting their result
+    unsigned sent;      ///< packages sent
+    unsigned dropped;   ///< packages dropped without a worker or a free slot
+    unsigned lost;      ///< packages without a result
+    unsigned late;      ///< events received after their package was lost, or output later by a worker
+} decode_farm_stats_t;
+
+/** Create a coordinator without workers.
+
+    @return the coordinator or NULL on failure
+*/
+decode_farm_t *decode_farm_create(void);
+
+/** Add a worker.
+
+    @param farm the coordinator
+    @param host the host of the worker
+    @param port the port of the worker
+    @param now the time in s
+    @return 0 on success, -1 on error
+*/
+int decode_farm_add_worker(decode_farm_t *farm, char const *host, char const *port, double now);
+
+/** Free a coordinator, the results not output are dropped.
+
+    @param farm the coordinator, may be NULL
+*/
+void decode_farm_free(decode_farm_t *farm);
+
+/** Send a package to its worker.
+
+    @param farm the coordinator
+    @param pulses the package
+    @param source the name of the receiver, the results are ordered for each
+    @param now the receive time in s
+    @return 0 if sent, -1 if dropped
+*/
+int decode_farm_submit(decode_farm_t *farm, pulse_data_t const *pulses, char const *source, double now);
+
+/** Receive the results, ping the workers, and output the results in order.
+
+    @param farm the coordinator
+    @param timeout_ms the time to wait for a result, 0 to only take the results received
+    @param now the time in s
+    @param output_fn called with each event or log message and its level, takes the data
+    @param ctx the context of @p output_fn
+*/
+void decode_farm_poll(decode_farm_t *farm, int timeout_ms, double now,
+        void (*output_fn)(void *ctx, struct data *data, int level), void *ctx);
+
+/// The number of packages awaiting their result.
+unsigned decode_farm_pending(decode_farm_t const *farm);
+
+/** Get the statistics.
+
+    @param farm the coordinator
+    @param now the time in s
+    @param[out] stats the statistics
+*/
+void decode_farm_get_stats(decode_farm_t const *farm, double now, decode_farm_stats_t *stats);
+
+/** Get the statistics of a worker.
+
+    @param farm the coordinator
+    @param index the worker, less than decode_farm_stats_t.workers
+    @param now the time in s
+    @param[out] stats the statistics
+*/
+void decode_farm_get_worker_stats(decode_farm_t const *farm, unsigned index, double now, decode_farm_worker_stats_t *stats);
+
+typedef struct decode_worker decode_worker_t;
+
+/** Open a worker.
+
+    @param host the address to bind, e.g. "0.0.0.0"
+    @param port the port to bind
+    @return the worker, NULL on error
+*/
+decode_worker_t *decode_worker_create(char const *host, char const *port);
+
+/** Receive the next package, pings are answered.
+
+    @param worker the worker
+    @param[out] pulses the package
+    @param timeout_ms the time to wait for a datagram
+    @return 1 on a package, 0 on a timeout or a ping, -1 on a socket error
+*/
+int decode_worker_next(decode_worker_t *worker, pulse_data_t *pulses, int timeout_ms);
+
+/// The name of the receiver of the last package.
+char const *decode_worker_source(decode_worker_t const *worker);
+
+/// The time the coordinator received the last package, in s.
+double decode_worker_time(decode_worker_t const *worker);
+
+/** Add an output to the result of the last package.
+
+    @param worker the worker
+    @param data the event or log message, taken
+    @param level 0 for an event, the log level of a log message
+*/
+void decode_worker_add(decode_worker_t *worker, struct data *data, int level);
+
+/** Send the result of the last package, or the outputs added since as late events.
+
+    @param worker the worker
+*/
+void decode_worker_reply(decode_worker_t *worker);
+
+/// The number of outputs that did not fit into a result datagram.
+unsigned decode_worker_truncated(decode_worker_t const *worker);
+
+/// Close a worker.
+void decode_worker_free(decode_worker_t *worker);
+
+#endif /* INCLUDE_DECODE_FARM_H_ */
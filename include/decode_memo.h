@@ -0,0 +1,94 @@
+/** @file
+    Decode memo, reuse the decode of a package that repeats the bits of a recent one.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECODE_MEMO_H_
+#define INCLUDE_DECODE_MEMO_H_
+
+#include <stdint.h>
+
+struct bitbuffer;
+struct data;
+
+/*
+Remotes and sensors send each message several times within a second, every
+repeat slices to the same bits and the decoder makes the same events. With
+-Y memo each decoder keeps its last few decodes: a hash of the sliced rows,
+the return code, and copies of the events. The slicer of a decoder and its
+timing are fixed, the hash of the rows is the key. A package whose bits
+hash the same as a decode within the window skips the decoder, copies of
+the remembered events are output instead and go through -M dedup as usual.
+
+Decoders that combine several packages (r_device.keeps_state) are never
+memoized, neither is a decoder while it logs the details (-vv). A memo is
+used by the thread running its decoder, as the decoder is.
+*/
+
+#define DECODE_MEMO_MS_DEFAULT 300 ///< default window
+#define DECODE_MEMO_ENTRIES    4   ///< decodes remembered by a decoder
+#define DECODE_MEMO_EVENTS     4   ///< decodes with more events are not remembered
+
+typedef struct decode_memo decode_memo_t;
+
+/** Create a memo.
+
+    @param window the time a decode is reused, in s
+    @return the memo or NULL on failure
+*/
+decode_memo_t *decode_memo_create(double window);
+
+/** Free a memo and the remembered events.
+
+    @param memo the memo, may be NULL
+*/
+void decode_memo_free(decode_memo_t *memo);
+
+/** Set the time of the package the decoder runs on next.
+
+    @param memo the memo
+    @param now the time of the package in s, an earlier time than a decode makes it stale
+*/
+void decode_memo_set_time(decode_memo_t *memo, double now);
+
+/** Look up the bits of a decoder run, start remembering the run otherwise.
+
+    On a miss the events passed to decode_memo_record() are remembered until
+    decode_memo_end().
+
+    @param memo the memo
+    @param bits the bits as the slicer gives them to the decoder
+    @return 1 to use decode_memo_replay() instead of the decoder, 0 to run the decoder
+*/
+int decode_memo_begin(decode_memo_t *memo, struct bitbuffer const *bits);
+
+/** Remember a copy of an event of the decoder run, no-op unless remembering.
+
+    @param memo the memo
+    @param data the event before the output changes it
+*/
+void decode_memo_record(decode_memo_t *memo, struct data const *data);
+
+/** End the decoder run.
+
+    @param memo the memo
+    @param ret the return code of the decoder
+*/
+void decode_memo_end(decode_memo_t *memo, int ret);
+
+/** Replay the decode found by decode_memo_begin().
+
+    @param memo the memo
+    @param output_fn called with a copy of each event, which it takes
+    @param ctx the context of @p output_fn
+    @return the return code of the decoder
+*/
+int decode_memo_replay(decode_memo_t *memo, void (*output_fn)(void *ctx, struct data *data), void *ctx);
+
+#endif /* INCLUDE_DECODE_MEMO_H_ */
@@ -0,0 +1,115 @@
+/** @file
+    Decoder pinning, run the decoder that decoded a package fingerprint before, alone and first.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECODE_PIN_H_
+#define INCLUDE_DECODE_PIN_H_
+
+#include <stdint.h>
+
+struct data;
+
+/*
+A fixed installation hears the same few sensors all day, each package of a
+sensor has the same fingerprint, the width bins of its pulses and gaps.
+With -Y pin the fingerprint of a package that a decoder decoded is pinned
+to that decoder. A later package with the fingerprint runs the pinned
+decoder alone, the priority cascade of all decoders runs only if it
+decodes nothing, and then pins the decoder that decoded it instead.
+
+Given the sensors as <model>:<id>, only a decoder reporting one of them is
+pinned, and with -Y pin_only the events of other sensors are dropped
+before the conversions and outputs. Without sensors any decoder is pinned.
+
+The table holds DECODE_PIN_SLOTS fingerprints, probing DECODE_PIN_PROBE
+slots, a full probe replaces the least used one. The decoders are opaque
+pointers valid for a generation of the decoder list, a new generation
+clears the table. The decode thread and the streaming decoders on the DSP
+thread report events, all calls are locked.
+*/
+
+#define DECODE_PIN_SLOTS 256 ///< fingerprints in the table, a power of 2
+#define DECODE_PIN_PROBE 8   ///< slots probed for a fingerprint
+
+typedef struct decode_pin decode_pin_t;
+
+/// Statistics of the pinning.
+typedef struct decode_pin_stats {
+    unsigned sensors;  ///< the pinned sensors, 0 for any
+    unsigned entries;  ///< fingerprints in the table
+    unsigned packages; ///< packages looked up
+    unsigned hits;     ///< packages the pinned decoder decoded alone
+    unsigned misses;   ///< packages the pinned decoder failed on, the cascade ran
+    unsigned learned;  ///< fingerprints pinned by the cascade
+    unsigned dropped;  ///< events of other sensors
+} decode_pin_stats_t;
+
+/** Check a sensor given as "<model>:<id>".
+
+    @param spec the sensor
+    @return 1 if valid, 0 otherwise
+*/
+int decode_pin_valid_sensor(char const *spec);
+
+/** Create a table.
+
+    @param sensors the valid "<model>:<id>" of the pinned sensors
+    @param num_sensors the number of sensors, 0 to pin any decoder
+    @return the table or NULL on failure
+*/
+decode_pin_t *decode_pin_create(char const *const *sensors, unsigned num_sensors);
+
+/** Free a table.
+
+    @param pin the table, may be NULL
+*/
+void decode_pin_free(decode_pin_t *pin);
+
+/** Look up the decoder of a package, starts noting the decoders of its events.
+
+    @param pin the table
+    @param key the fingerprint of the package, 0 is never pinned
+    @param generation the generation of the decoder list
+    @return the pinned decoder to run alone, NULL to run the cascade
+*/
+void *decode_pin_begin(decode_pin_t *pin, uint64_t key, unsigned generation);
+
+/** Note the decoder of an event.
+
+    @param pin the table
+    @param decoder the decoder
+    @param data the event
+    @return 1 if the event is of a pinned sensor or no sensors are given, 0 otherwise
+*/
+int decode_pin_event(decode_pin_t *pin, void *decoder, struct data const *data);
+
+/** Count a dropped event of another sensor.
+
+    @param pin the table
+*/
+void decode_pin_drop(decode_pin_t *pin);
+
+/** End a package, pins the first noted decoder unless the pinned decoder decoded it.
+
+    @param pin the table
+    @param key the fingerprint of the package
+    @param tried 1 if the pinned decoder ran
+    @param hit 1 if the pinned decoder decoded the package
+*/
+void decode_pin_end(decode_pin_t *pin, uint64_t key, int tried, int hit);
+
+/** Get the statistics.
+
+    @param pin the table
+    @param[out] stats the statistics
+*/
+void decode_pin_get_stats(decode_pin_t *pin, decode_pin_stats_t *stats);
+
+#endif /* INCLUDE_DECODE_PIN_H_ */
@@ -0,0 +1,62 @@
+/** @file
+    Scratch buffers of a decoder thread, reused for every package.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECODE_SCRATCH_H_
+#define INCLUDE_DECODE_SCRATCH_H_
+
+#include "bitbuffer.h"
+#include "data.h"
+
+/*
+Each thread that runs decoders, the DSP thread and every task of the decode
+pool, holds a scratch of its own. The slicers slice into its bits instead of
+bits of each decoder, a few more bits and a text buffer replace the large
+stack buffers of the decoders, and the data elements of the events are
+taken from its data cache. After the first packages the decode path then
+needs no heap allocations and little stack, and the buffers stay in the
+cache of the thread.
+
+The scratch of a run is set as r_device.scratch and passed to decode_fn2.
+*/
+
+#define DECODE_SCRATCH_BITS 4 ///< bitbuffers a decoder may take at a time
+#define DECODE_SCRATCH_TEXT (BITBUF_ROWS * BITBUF_COLS * 2 + 1) ///< bytes of the text buffer, a row in hex
+
+typedef struct decode_scratch {
+    bitbuffer_t slice_bits;                ///< bits of the slicers, kept all zero between slicer runs
+    bitbuffer_t bits[DECODE_SCRATCH_BITS]; ///< bits for the decoders, all zero while not taken
+    unsigned bits_taken;                   ///< bitbuffers taken
+    char text[DECODE_SCRATCH_TEXT];        ///< text buffer for the decoders, e.g. a row in hex
+    data_cache_t data_cache;               ///< data elements of the events
+} decode_scratch_t;
+
+/// Allocate a scratch, returns NULL on alloc failure.
+decode_scratch_t *decode_scratch_create(void);
+
+/// Free a scratch and the data elements it keeps, may be NULL.
+void decode_scratch_free(decode_scratch_t *scratch);
+
+/** Take all-zero bits, give them back with decode_scratch_give_bits() in reverse order.
+
+    @return the bits or NULL if all DECODE_SCRATCH_BITS bitbuffers are taken
+*/
+bitbuffer_t *decode_scratch_take_bits(decode_scratch_t *scratch);
+
+/// Give back the last bits taken, the used rows and the first row are cleared.
+void decode_scratch_give_bits(decode_scratch_t *scratch, bitbuffer_t *bits);
+
+/** Use the data cache of a scratch on the calling thread.
+
+    @return the data cache used before, restore it with data_cache_use()
+*/
+data_cache_t *decode_scratch_use(decode_scratch_t *scratch);
+
+#endif /* INCLUDE_DECODE_SCRATCH_H_ */
@@ -13,6 +13,8 @@
 #define INCLUDE_DECODER_UTIL_H_
 
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "bitbuffer.h"
 #include "data.h"
 #include "r_device.h"
@@ -38,9 +40,50 @@ r_device *decoder_create(r_device const *dev_template, unsigned user_data_size);
 /// The memory can be freely used by a decoder and is of the size given to `decoder_create()`.
 void *decoder_user_data(r_device *decoder);
 
+/// A fixed capacity table of states by transmitter, e.g. to reassemble messages sent in parts.
+///
+/// The table is flat, allocate `decoder_state_table_size()` bytes, e.g. as the
+/// user data of `decoder_create()`. A key hashes to a set of 4 slots, a new
+/// state replaces an empty or expired slot, otherwise the least recently stored.
+typedef struct decoder_state_table {
+    unsigned num_sets;   ///< sets of slots, a power of two
+    unsigned slot_size;  ///< bytes of a slot header and state
+    uint64_t max_age;    ///< states older than this are expired, in the unit of the times given
+    unsigned char slots[]; ///< num_sets * 4 slots of slot_size bytes
+} decoder_state_table_t;
+
+/// Get the size in bytes of a state table for this many states of the given size.
+size_t decoder_state_table_size(unsigned capacity, unsigned state_size);
+
+/// Initialize an allocated state table, the capacity and state size need to match the allocation.
+///
+/// @param table the state table of `decoder_state_table_size()` bytes
+/// @param capacity the maximum number of states
+/// @param state_size the size of a state in bytes
+/// @param max_age states older than this are expired, in the unit of the times given, e.g. ms
+void decoder_state_table_init(decoder_state_table_t *table, unsigned capacity, unsigned state_size, uint64_t max_age);
+
+/// Find the state of a key, NULL if there is none or it expired.
+void *decoder_state_find(decoder_state_table_t *table, uint64_t key, uint64_t now);
+
+/// Find the state of a key or add a new all zero state, the state is then marked as stored now.
+///
+/// @param table the state table
+/// @param key the transmitter key, e.g. the id
+/// @param now the current time, e.g. in ms
+/// @param[out] created set to 1 if the state is new, otherwise 0, may be NULL
+/// @return the state
+void *decoder_state_get(decoder_state_table_t *table, uint64_t key, uint64_t now, int *created);
+
+/// Remove the state of a key.
+void decoder_state_remove(decoder_state_table_t *table, uint64_t key);
+
 /// Output data.
 void decoder_output_data(r_device *decoder, data_t *data);
 
+/// Output the data of a record of the decoder schema, see r_device.schema.
+void decoder_output_record(r_device *decoder, data_record_t const *record);
+
 /// Output log.
 void decoder_output_log(r_device *decoder, int level, data_t *data);
 
@@ -0,0 +1,126 @@
+/** @file
+    Demodulation worker thread between the SDR acquire thread and the event loop.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DSP_THREAD_H_
+#define INCLUDE_DSP_THREAD_H_
+
+#include "sdr.h"
+#include "ring_queue.h"
+
+struct data;
+struct thread_sched;
+
+#define DSP_THREAD_BATCH 16 ///< most SDR events taken from the queue per wakeup
+
+/// Called on the DSP thread for a batch of queued SDR events, in order, released afterwards.
+typedef void (*dsp_process_fn)(sdr_event_t *evs, unsigned n, void *ctx);
+
+/// Called on any producer thread when output events become available for the event loop.
+typedef void (*dsp_wakeup_fn)(void *ctx);
+
+typedef struct dsp_thread dsp_thread_t;
+
+/** Start the DSP thread.
+
+    The calling thread is taken to be the event loop thread which owns the outputs.
+
+    @param iq_queue_size maximum number of SDR buffers to queue, must be less than the SDR buffer count
+    @param event_queue_size maximum number of output events to queue
+    @param process_cb the handler for SDR events, runs on the DSP thread
+    @param wakeup_cb the handler to wake the event loop, runs on a producer thread
+    @param ctx user context passed to the handlers
+    @return the DSP thread or NULL on failure
+*/
+dsp_thread_t *dsp_thread_start(unsigned iq_queue_size, unsigned event_queue_size, dsp_process_fn process_cb, dsp_wakeup_fn wakeup_cb, void *ctx);
+
+/** Stop and join the DSP thread, discard queued SDR buffers, and free all resources.
+
+    Pending output events are freed, pop them first to deliver them.
+
+    @param dsp the DSP thread, may be NULL
+*/
+void dsp_thread_stop(dsp_thread_t *dsp);
+
+/** Set the CPU affinity and priority of the DSP thread, failures only log a warning.
+
+    @param dsp the DSP thread, may be NULL
+    @param sched the scheduling settings
+*/
+void dsp_thread_set_sched(dsp_thread_t *dsp, struct thread_sched const *sched);
+
+/** Queue an SDR event for the DSP thread, never blocks.
+
+    @param dsp the DSP thread
+    @param ev the event to copy, the buffer must stay valid until processed,
+              a buffer lease is released once processed or dropped
+    @return 0 on success, -1 if the queue was full and the buffer was dropped
+*/
+int dsp_thread_push(dsp_thread_t *dsp, sdr_event_t const *ev);
+
+/** Discard all queued SDR buffers and wait for the current batch to finish.
+
+    Call this before the SDR buffers are released, e.g. on SDR restart.
+
+    @param dsp the DSP thread
+*/
+void dsp_thread_flush(dsp_thread_t *dsp);
+
+/** Hold the DSP thread between batches and wait for the current one to finish.
+
+    The SDR buffers keep queueing and are processed after dsp_thread_resume(),
+    nothing is dropped as long as the pause is shorter than the queue.
+
+    @param dsp the DSP thread
+*/
+void dsp_thread_pause(dsp_thread_t *dsp);
+
+/** Continue processing the queued SDR buffers after dsp_thread_pause().
+
+    @param dsp the DSP thread
+*/
+void dsp_thread_resume(dsp_thread_t *dsp);
+
+/** Check if the caller runs on the event loop thread.
+
+    @param dsp the DSP thread
+    @return 1 if called from the event loop thread, 0 otherwise
+*/
+int dsp_thread_is_loop(dsp_thread_t *dsp);
+
+/** Queue an output event for the event loop thread, never blocks.
+
+    Takes ownership of @p data, which is freed if the queue is full.
+
+    @param dsp the DSP thread
+    @param data the output data
+    @param level the log level of the data, 0 for decoded events
+    @return 0 on success, -1 if the event was dropped
+*/
+int dsp_thread_post_event(dsp_thread_t *dsp, struct data *data, int level);
+
+/** Dequeue an output event on the event loop thread.
+
+    @param dsp the DSP thread
+    @param[out] data the output data, ownership is passed to the caller
+    @param[out] level the log level of the data
+    @return 0 on success, -1 if no event is queued
+*/
+int dsp_thread_pop_event(dsp_thread_t *dsp, struct data **data, int *level);
+
+/** Get a snapshot of the queue counters.
+
+    @param dsp the DSP thread
+    @param[out] iq_stats the SDR buffer queue counters
+    @param[out] event_stats the output event queue counters
+*/
+void dsp_thread_get_stats(dsp_thread_t *dsp, ring_queue_stats_t *iq_stats, ring_queue_stats_t *event_stats);
+
+#endif /* INCLUDE_DSP_THREAD_H_ */
@@ -0,0 +1,104 @@
+/** @file
+    Asynchronous writer of the sample dumpers, writes from a worker thread.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DUMP_WRITER_H_
+#define INCLUDE_DUMP_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+The dumpers copy their data into blocks of DUMP_WRITER_BLOCK bytes taken from
+a fixed pool, full blocks are queued to the writer thread. A stalled write
+only delays the writer, the demod keeps running until the pool is used up.
+*/
+
+#define DUMP_WRITER_BLOCK (1024 * 1024) ///< size of the write blocks in bytes, a multiple of DUMP_WRITER_ALIGN
+#define DUMP_WRITER_ALIGN 4096          ///< alignment of the blocks and file offsets for direct I/O
+
+#define DUMP_WRITER_WAIT     1 ///< wait for a free block if the writer is behind, drop the data otherwise
+#define DUMP_WRITER_DIRECT   2 ///< write with O_DIRECT, bypassing the page cache
+#define DUMP_WRITER_DONTNEED 4 ///< drop the written data from the page cache with posix_fadvise()
+
+typedef struct dump_writer dump_writer_t;
+
+/// Writer counters, cumulative since the start.
+typedef struct dump_writer_stats {
+    unsigned blocks;         ///< number of blocks in the pool
+    unsigned queued;         ///< current number of blocks waiting to be written
+    unsigned queued_max;     ///< high water mark of blocks waiting to be written
+    unsigned writes;         ///< total number of blocks written
+    uint64_t bytes;          ///< total bytes written
+    uint64_t dropped;        ///< total bytes dropped because no block was free
+    unsigned waits;          ///< number of times the dumpers waited for a free block
+    unsigned stall_max_ms;   ///< longest time of a single write
+    unsigned backlog_max_ms; ///< longest time from queuing a block to the end of its write
+} dump_writer_stats_t;
+
+/** Create a writer and start its thread.
+
+    @param buf_size the size of the block pool in bytes, at least a few blocks are used
+    @param flags DUMP_WRITER_WAIT, DUMP_WRITER_DIRECT, DUMP_WRITER_DONTNEED
+    @return the writer, NULL if built without threads or on failure
+*/
+dump_writer_t *dump_writer_create(size_t buf_size, int flags);
+
+/** Write the queued data of all files and free the writer.
+
+    The files are not closed.
+
+    @param w the writer, may be NULL
+*/
+void dump_writer_free(dump_writer_t *w);
+
+/** Write a file from the writer thread.
+
+    Flushes the file, all further writes must go through dump_writer_write().
+    Each file needs a block of the pool, fails if less than two would be left.
+
+    @param w the writer
+    @param file the file, opened for writing
+    @param name the file name for the log
+    @return 0 on success, -1 on error
+*/
+int dump_writer_add(dump_writer_t *w, FILE *file, char const *name);
+
+/** Write the queued data of a file and stop writing it from the writer thread.
+
+    Call this before closing the file.
+
+    @param w the writer, may be NULL
+    @param file the file
+    @return 0 on success, -1 if the file was not added
+*/
+int dump_writer_remove(dump_writer_t *w, FILE *file);
+
+/** Queue data to write to a file, falls back to fwrite() for files not added.
+
+    Data that does not fit the free blocks is dropped unless DUMP_WRITER_WAIT is set.
+
+    @param w the writer, may be NULL
+    @param file the file
+    @param buf the data
+    @param len the length of the data in bytes
+    @return @p len, less if an earlier write to the file failed
+*/
+size_t dump_writer_write(dump_writer_t *w, FILE *file, void const *buf, size_t len);
+
+/** Get a snapshot of the writer counters.
+
+    @param w the writer
+    @param[out] stats the counters
+*/
+void dump_writer_get_stats(dump_writer_t *w, dump_writer_stats_t *stats);
+
+#endif /* INCLUDE_DUMP_WRITER_H_ */
@@ -0,0 +1,89 @@
+/** @file
+    Duty cycled reception, sleep between the expected reports of periodic sensors.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DUTY_SCHED_H_
+#define INCLUDE_DUTY_SCHED_H_
+
+#include <stdint.h>
+
+/*
+The scheduler first listens for the learn time and estimates the report
+interval and phase of each sensor with repeated events, as the hop
+scheduler does. It then only wakes for a window around each expected
+report: the margin (at least a fraction of the interval) before and after,
+plus the wake-up time of the receiver before. A missed report widens the
+window of its sensor, a sensor missed DUTY_SCHED_MISSES times in a row is
+forgotten and the scheduler listens for the learn time again to find it.
+Without any periodic sensor it stays awake. All times are wall clock
+seconds, the events are counted from any thread.
+*/
+
+#define DUTY_SCHED_LEARN_S 600.0 ///< default learn time
+#define DUTY_SCHED_SENSORS 64   ///< sensors tracked
+#define DUTY_SCHED_MISSES  4    ///< forget a sensor after this many missed reports in a row
+#define DUTY_SCHED_WAKE_S  1.5  ///< time to restart the receiver before a window
+#define DUTY_SCHED_SLEEP_MIN_S 3.0 ///< shorter gaps between windows are spent awake
+
+typedef struct duty_sched duty_sched_t;
+
+/// Statistics of the duty cycle.
+typedef struct duty_sched_stats {
+    double awake;        ///< total time awake in s
+    double asleep;       ///< total time asleep in s
+    unsigned sensors;    ///< sensors with a known report interval
+    unsigned learning;   ///< 1 while learning
+    unsigned sleeps;     ///< times the receiver was stopped
+    unsigned reports;    ///< expected reports received
+    unsigned missed;     ///< expected reports missed
+} duty_sched_stats_t;
+
+/** Create a scheduler.
+
+    @param learn the time to listen before the first sleep and after losing a sensor, in s
+    @param margin the least time to listen before and after an expected report, in s
+    @return the scheduler or NULL on failure
+*/
+duty_sched_t *duty_sched_create(double learn, double margin);
+
+/** Free a scheduler.
+
+    @param sched the scheduler, may be NULL
+*/
+void duty_sched_free(duty_sched_t *sched);
+
+/** Count an event.
+
+    Repeats of the same sensor within a few seconds count as one report.
+
+    @param sched the scheduler
+    @param key a hash identifying the sensor, 0 if unknown
+    @param now the time of the event in s
+*/
+void duty_sched_event(duty_sched_t *sched, uint32_t key, double now);
+
+/** Decide if the receiver should be awake.
+
+    @param sched the scheduler
+    @param now the time in s
+    @param[out] next the time of the next decision in s
+    @return 1 to be awake, 0 to sleep until @p next
+*/
+int duty_sched_next(duty_sched_t *sched, double now, double *next);
+
+/** Get the statistics.
+
+    @param sched the scheduler
+    @param now the time in s
+    @param[out] stats the statistics
+*/
+void duty_sched_get_stats(duty_sched_t *sched, double now, duty_sched_stats_t *stats);
+
+#endif /* INCLUDE_DUTY_SCHED_H_ */
@@ -0,0 +1,120 @@
+/** @file
+    Append-only log of records in memory-mapped segment files, one writer and any number of readers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_EVENT_LOG_H_
+#define INCLUDE_EVENT_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+The log is a directory of segment files named by the sequence number of
+their first record in hex, e.g. "0000000000000001.evlog". A segment holds a
+header, an index of the record offsets, and a data area, it is preallocated
+and mapped. A record is a 16 byte record header (sequence number, length)
+and the payload, padded to 8 bytes. The first record of the log is 1, the
+sequence numbers have no gaps, and a record is found with the index entry of
+its sequence number less the first of the segment.
+
+The writer appends to the last segment, stores the record and its index
+entry, and then moves `count`. A full segment is marked closed and trimmed,
+the writer continues with a new segment and removes the oldest segments
+above the limit. A writer opening an existing log continues after its last
+record, a record that was not complete when the previous writer stopped is
+not in the log.
+
+The readers map the segments and return the records in place until a
+segment is removed, no locks are taken. The readers poll, there is no wake
+up. event_log.c only needs libc, copy it with this header to read a log in
+other programs.
+*/
+
+#define EVENT_LOG_MAGIC   0x33333445 ///< "E433" in little endian
+#define EVENT_LOG_VERSION 1
+
+#define EVENT_LOG_SEGMENT_DEFAULT (16 * 1024 * 1024) ///< segment size if not given
+#define EVENT_LOG_SEGMENTS_DEFAULT 8                 ///< segments kept if not given
+
+/// The header at the start of each segment.
+typedef struct event_log_header {
+    uint32_t magic;       ///< EVENT_LOG_MAGIC once the segment is ready
+    uint32_t version;     ///< EVENT_LOG_VERSION
+    uint32_t header_size; ///< offset of the index
+    uint32_t index_len;   ///< most records in the segment
+    uint64_t first_seq;   ///< sequence number of the first record
+    uint64_t data_size;   ///< size of the data area, after the index
+    uint64_t count;       ///< records complete in the segment
+    uint64_t end;         ///< data bytes used by the complete records
+    uint32_t closed;      ///< nonzero once the writer moved on to the next segment
+    uint32_t pad;
+    uint64_t pad2;        ///< to 64 bytes
+} event_log_header_t;
+
+/// Reader results besides a record length.
+enum event_log_result {
+    EVENT_LOG_EMPTY = 0,  ///< the record is not written yet
+    EVENT_LOG_GONE  = -1, ///< the record was removed with its segment, continue at event_log_first()
+};
+
+typedef struct event_log event_log_t;
+
+/** Open a log for appending, creates the directory if needed.
+
+    @param dir the directory of the segments
+    @param segment_size the size of a segment file in bytes
+    @param segments_max the most segments kept, at least 2
+    @return the writer, NULL on error
+*/
+event_log_t *event_log_open(char const *dir, size_t segment_size, unsigned segments_max);
+
+/** Append a record.
+
+    @param log the writer
+    @param buf the payload
+    @param len the payload length, at most a quarter of the segment data size
+    @return the sequence number of the record, 0 if it is too long or a segment failed
+*/
+uint64_t event_log_append(event_log_t *log, void const *buf, size_t len);
+
+/// The sequence number of the last record, 0 if none.
+uint64_t event_log_last(event_log_t const *log);
+
+/// The number of segment files of the log.
+unsigned event_log_segments(event_log_t const *log);
+
+/// Flush and close the last segment, it stays open for appending by the next writer.
+void event_log_close(event_log_t *log);
+
+typedef struct event_log_reader event_log_reader_t;
+
+/** Open a log for reading.
+
+    @param dir the directory of the segments, it may not exist yet
+    @return the reader, NULL on alloc failure
+*/
+event_log_reader_t *event_log_reader_open(char const *dir);
+
+/** Get a record in place.
+
+    @param reader the reader
+    @param seq the sequence number of the record
+    @param[out] buf the payload in the mapped segment, valid until the next call
+    @return the payload length, or one of event_log_result
+*/
+long event_log_get(event_log_reader_t *reader, uint64_t seq, void const **buf);
+
+/// The sequence number of the oldest record in the log, the next record to be written if none.
+uint64_t event_log_first(event_log_reader_t *reader);
+
+/// Close a reader.
+void event_log_reader_close(event_log_reader_t *reader);
+
+#endif /* INCLUDE_EVENT_LOG_H_ */
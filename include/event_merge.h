@@ -0,0 +1,74 @@
+/** @file
+    Merge the copies of an event heard by several receivers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_EVENT_MERGE_H_
+#define INCLUDE_EVENT_MERGE_H_
+
+#include "data.h"
+
+#include <stdint.h>
+
+/*
+An event is held for the merge window from its first copy. Further copies
+with the same content hash only add their receiver to the list, a copy with
+a better RSSI replaces the held event. Once the window ends the held event
+is emitted once with a "receivers" array of the receivers that heard it.
+
+The entries are found in a hash table and expire in the order they were
+first heard, adding and expiring an event takes constant time.
+*/
+
+#define EVENT_MERGE_RECEIVERS 16 ///< receivers listed per event
+
+typedef struct event_merge event_merge_t;
+
+/// Called with each merged event, the handler takes ownership of the event.
+typedef void (*event_merge_emit_fn)(void *ctx, data_t *data);
+
+/** Create a merge table.
+
+    @param window_ms the time to wait for further copies of an event
+    @return the table or NULL on alloc failure
+*/
+event_merge_t *event_merge_create(unsigned window_ms);
+
+/** Free a merge table, the held events are dropped.
+
+    @param merge the table, may be NULL
+*/
+void event_merge_free(event_merge_t *merge);
+
+/** Add a copy of an event, the table takes ownership of the event.
+
+    @param merge the table
+    @param hash the content hash of the event, without the receiver dependent fields
+    @param data the event
+    @param receiver the name of the receiver that heard the copy, may be NULL
+    @param rssi_db the RSSI of the copy
+    @param now the time in s
+    @return 1 if the event is a copy of a held event, 0 for a new event
+*/
+int event_merge_add(event_merge_t *merge, uint32_t hash, data_t *data, char const *receiver, float rssi_db, double now);
+
+/** Emit the events whose window ended.
+
+    @param merge the table
+    @param now the time in s, or a negative time to emit all held events
+    @param emit the handler of the merged events
+    @param ctx user context passed to the handler
+    @return the number of events emitted
+*/
+unsigned event_merge_expire(event_merge_t *merge, double now, event_merge_emit_fn emit, void *ctx);
+
+/// The number of held events.
+unsigned event_merge_held(event_merge_t const *merge);
+
+#endif /* INCLUDE_EVENT_MERGE_H_ */
@@ -0,0 +1,95 @@
+/** @file
+    Sample file reader, memory-mapped with zero-copy blocks where possible.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_FILE_INPUT_H_
+#define INCLUDE_FILE_INPUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Regular files are mapped in windows of FILE_INPUT_WINDOW bytes, which keeps
+the address space small on 32-bit systems. Formats the demodulator takes as is
+are handed out as pointers into the mapping, CS8 and CF32 are converted from
+the mapping into a buffer in one pass. Pipes, stdin, and systems without
+mmap() are read with stdio.
+*/
+
+#define FILE_INPUT_WINDOW (64 * 1024 * 1024) ///< size of the mapped window in bytes
+
+typedef struct file_input file_input_t;
+
+/** Open a sample file.
+
+    @param path the file path, "-" for stdin
+    @param format the file format, one of the sample file_type values
+    @param block_len maximum length of the blocks read in bytes, after conversion
+    @return the reader or NULL on error, see errno
+*/
+file_input_t *file_input_open(char const *path, int format, size_t block_len);
+
+/** Read the next block of samples.
+
+    CF32 is converted to CS16, CS8 to CU8, other formats are passed as is.
+    The block may point into the mapping, the data can be changed but
+    only stays valid until the next read.
+
+    @param in the reader
+    @param[out] buf the block
+    @return the length of the block in bytes, 0 at the end of the file
+*/
+size_t file_input_read(file_input_t *in, uint8_t **buf);
+
+/** Get the number of blocks of a mapped file, the last block may be short.
+
+    @param in the reader
+    @return the number of blocks, 0 if the file is read with stdio
+*/
+uint64_t file_input_blocks(file_input_t const *in);
+
+/** Seek to a block of a mapped file, the next read returns this block.
+
+    @param in the reader
+    @param block the block index
+    @return 0 on success, -1 if the file is read with stdio or the block is past the end
+*/
+int file_input_seek_block(file_input_t *in, uint64_t block);
+
+/** Check if the file is memory-mapped.
+
+    @param in the reader
+    @return 1 if mapped, 0 if read with stdio
+*/
+int file_input_is_mapped(file_input_t const *in);
+
+/** Close the file and free the reader.
+
+    @param in the reader, may be NULL
+*/
+void file_input_close(file_input_t *in);
+
+/** Convert CS8 to CU8 samples, may be in place.
+
+    @param src the CS8 data
+    @param[out] dst the CU8 data
+    @param len the length in bytes
+*/
+void file_input_cs8_to_cu8(uint8_t const *src, uint8_t *dst, size_t len);
+
+/** Convert CF32 to CS16 samples, clamped to [-1,1] and scaled to Q0.15.
+
+    @param src the CF32 data
+    @param[out] dst the CS16 data
+    @param n the number of values, i.e. twice the number of I/Q samples
+*/
+void file_input_cf32_to_cs16(float const *src, int16_t *dst, size_t n);
+
+#endif /* INCLUDE_FILE_INPUT_H_ */
@@ -0,0 +1,97 @@
+/** @file
+    Flush, sync, and rotation policy of the file outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_FILE_SINK_H_
+#define INCLUDE_FILE_SINK_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+A file output writes its records to a stream and commits each record with
+file_sink_commit(). Without a policy that is a fflush() per record, as
+before. With a policy the stream gets a buffer and records are grouped:
+the stream is flushed when the buffer is full or the flush interval ran
+out, the event loop calls file_sink_poll() to flush idle streams.
+Rotation renames the file and reopens the path on the same stream, so the
+outputs keep their FILE pointer.
+
+A terminal can be written without blocking, e.g. a slow SSH session or a
+serial console: the records written with file_sink_write() are queued up
+to FILE_SINK_PENDING_MAX and written as the terminal takes them, the
+queued records go out together. Records that don't fit are dropped and a
+summary line tells how many.
+*/
+
+#define FILE_SINK_PENDING_MAX (64 * 1024) ///< records queued for a busy terminal
+
+/// The policy of a file output, all zero is a flush per record.
+typedef struct file_sink_opts {
+    size_t flush_bytes;     ///< buffer size, the stream is flushed when full
+    unsigned flush_ms;      ///< flush at least this often, 0 for none
+    unsigned sync_ms;       ///< fdatasync() at least this often, 0 for none
+    size_t rotate_bytes;    ///< rotate when the file reaches this size, 0 for none
+    int rotate_daily;       ///< rotate when a record is committed on a new day (local time)
+    int nonblock;           ///< write a terminal without blocking, ignored for other files
+} file_sink_opts_t;
+
+/** Parse a file output option, "flush=", "sync=", or "rotate=".
+
+    The flush option takes a size ("64k", "1M") or a time ("500ms", "1s") and may be given twice,
+    the sync option takes a time, the rotate option takes "daily" or a size.
+
+    @param opts the policy to update
+    @param arg the option text, advanced past the option on success
+    @return 1 if the option was parsed, 0 if this is not a sink option, -1 on an invalid value
+*/
+int file_sink_parse_opt(file_sink_opts_t *opts, char **arg);
+
+/// Check if a policy is set, i.e. the options differ from a flush per record.
+int file_sink_opts_set(file_sink_opts_t const *opts);
+
+/** Open a file output with a policy.
+
+    @param path the file path, NULL for stdout
+    @param mode the fopen() mode, should append
+    @param opts the policy, NULL or all zero for a flush per record
+    @return the stream, NULL on failure
+*/
+FILE *file_sink_open(char const *path, char const *mode, file_sink_opts_t const *opts);
+
+/** Commit a record written to a stream, flushes, syncs, or rotates as the policy requires.
+
+    @param file the stream, a stream without policy is flushed
+    @return 1 if the file was rotated after this record, e.g. to write a header, 0 otherwise
+*/
+int file_sink_commit(FILE *file);
+
+/** Write a rendered record with one call and commit it.
+
+    A terminal opened with the nonblock option is written without blocking,
+    the record is queued or dropped if the terminal is busy.
+
+    @param file the stream
+    @param buf the record text
+    @param len the length of the record text
+    @return 1 if the file was rotated after this record, see file_sink_commit(), 0 otherwise
+*/
+int file_sink_write(FILE *file, char const *buf, size_t len);
+
+/// The number of records dropped on a busy terminal, 0 for other streams.
+unsigned file_sink_dropped(FILE *file);
+
+/// Flush and sync the streams whose interval ran out, write to the terminals, call periodically e.g. from the event loop.
+void file_sink_poll(void);
+
+/// Flush, sync, and close all streams with a policy.
+void file_sink_close_all(void);
+
+#endif /* INCLUDE_FILE_SINK_H_ */
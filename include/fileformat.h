@@ -41,6 +41,9 @@ enum file_type {
     F_LOGIC    = 5 << 16,
     F_VCD      = 6 << 16,
     F_OOK      = 7 << 16,
+    F_GIQ      = 8 << 16,
+    F_PLS      = 9 << 16,
+    F_SIGMF    = 10 << 16,
     // format types
     F_U8       = F_1CH | F_UNSIGNED | F_INT | F_W8,
     F_S8       = F_1CH | F_SIGNED   | F_INT | F_W8,
@@ -70,6 +73,13 @@ enum file_type {
     U8_LOGIC   = F_LOGIC | F_U8,
     VCD_LOGIC  = F_VCD,
     PULSE_OOK  = F_OOK,
+    PULSE_BIN  = F_PLS,
+    GIQ_CU8    = F_GIQ | F_CU8,
+    GIQ_CS16   = F_GIQ | F_CS16,
+    SIGMF_CU8  = F_SIGMF | F_CU8,
+    SIGMF_CS8  = F_SIGMF | F_CS8,
+    SIGMF_CS16 = F_SIGMF | F_CS16,
+    SIGMF_CF32 = F_SIGMF | F_CF32,
 };
 
 typedef struct {
@@ -100,6 +110,7 @@ void file_info_clear(file_info_t *info);
 /// - 2ch formats: "cu8", "cs8", "cs16", "cs32", "cf32"
 /// - 1ch formats: "u8", "s8", "s16", "u16", "s32", "u32", "f32"
 /// - text formats: "vcd", "ook"
+/// - container formats: "giq"
 /// - content types: "iq", "i", "q", "am", "fm", "logic"
 ///
 /// Parses left to right, with the exception of a prefix up to the last colon ":"
@@ -0,0 +1,58 @@
+/** @file
+    Frequency offset tracking of the FSK packages on a channel.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_FSK_TRACK_H_
+#define INCLUDE_FSK_TRACK_H_
+
+#include <stdint.h>
+
+/*
+The tracker keeps the F1 and F2 estimates of the last FSK_TRACK_LEN decoded
+packages of a channel. If most of them agree with the median, within a quarter
+of the deviation, the medians seed the FSK detector for the next package. It
+then doesn't need to converge from the first samples of the package again.
+
+Packages of senders on other offsets break the agreement and the detector
+starts unseeded, a seed can't lock the detector onto the wrong frequencies.
+*/
+
+#define FSK_TRACK_LEN 8 ///< number of recent packages tracked
+#define FSK_TRACK_MIN 3 ///< number of agreeing packages needed for a seed
+
+/// Recent FSK estimates of a channel, zero-initialize to start empty.
+typedef struct fsk_track {
+    int16_t hi[FSK_TRACK_LEN]; ///< estimates of the higher frequency
+    int16_t lo[FSK_TRACK_LEN]; ///< estimates of the lower frequency
+    unsigned count;            ///< number of tracked packages, at most FSK_TRACK_LEN
+    unsigned next;             ///< slot for the next package
+    int seeded;                ///< nonzero if the seed is valid
+    int seed_hi;               ///< median of the higher frequency
+    int seed_lo;               ///< median of the lower frequency
+} fsk_track_t;
+
+/** Add the estimates of a decoded package and update the seed.
+
+    @param track the tracker
+    @param f1_est FM estimate of one frequency of the package
+    @param f2_est FM estimate of the other frequency of the package, in any order
+*/
+void fsk_track_add(fsk_track_t *track, int f1_est, int f2_est);
+
+/** Get the seed for the next package.
+
+    @param track the tracker
+    @param[out] hi_est the FM estimate of the higher frequency
+    @param[out] lo_est the FM estimate of the lower frequency
+    @return 1 if there is a seed, 0 otherwise
+*/
+int fsk_track_seed(fsk_track_t const *track, int *hi_est, int *lo_est);
+
+#endif /* INCLUDE_FSK_TRACK_H_ */
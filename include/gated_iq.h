@@ -0,0 +1,151 @@
+/** @file
+    Squelch-gated I/Q recordings, only the buffers with a signal are kept.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_GATED_IQ_H_
+#define INCLUDE_GATED_IQ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+A gated recording has a file header, the records of the buffers kept, and an
+index of the segments at the end. A segment is a run of records contiguous in
+the input at one frequency and sample rate. All values are little-endian.
+
+    header:  "RTL433GI", u32 version, u32 format (CU8_IQ or CS16_IQ)
+    record:  "GSEG", u32 length, u64 sample offset, s64 time in us,
+             u32 center frequency, u32 sample rate, then the samples
+    index:   "GIDX", u32 count, then for each segment: u64 file offset,
+             u64 sample offset, s64 time in us, u64 samples,
+             u32 center frequency, u32 sample rate
+    trailer: u64 index offset, u32 count, "GEND"
+
+The sample offsets count the samples of the input at the sample rate of the
+record, the gaps between the records are the squelched samples. A recording
+that was not finished has no index but can still be read from the start.
+*/
+
+#define GATED_IQ_HANGOVER 1 ///< squelched buffers recorded after a signal, one is recorded before
+
+/// A segment of the index or a single record.
+typedef struct gated_iq_segment {
+    uint64_t file_offset;      ///< offset of the first record in the file
+    uint64_t sample_offset;    ///< position of the first sample in the input
+    int64_t time_us;           ///< time of the first sample in us since the epoch, 0 if unknown
+    uint64_t n_samples;        ///< number of samples
+    uint32_t center_frequency; ///< center frequency in Hz
+    uint32_t sample_rate;      ///< sample rate in Hz
+} gated_iq_segment_t;
+
+typedef struct gated_iq_writer gated_iq_writer_t;
+typedef struct gated_iq_reader gated_iq_reader_t;
+
+/// Write data to the file of a recording, returns the length written.
+typedef size_t (*gated_iq_write_fn)(void *ctx, FILE *file, void const *buf, size_t len);
+
+/** Start a gated recording, writes the file header.
+
+    @param file the file, opened for writing
+    @param format the sample format, CU8_IQ or CS16_IQ
+    @param write_fn the function to write the records and the index with, NULL for fwrite()
+    @param ctx the context of @p write_fn
+    @return the writer or NULL on error
+*/
+gated_iq_writer_t *gated_iq_writer_create(FILE *file, int format, gated_iq_write_fn write_fn, void *ctx);
+
+/** Record a buffer if it has a signal or is next to one.
+
+    The last squelched buffer is kept and recorded before a signal,
+    GATED_IQ_HANGOVER squelched buffers are recorded after a signal.
+
+    @param w the writer
+    @param rec the position, time, frequency, and sample rate of the buffer
+    @param signal the buffer is not squelched
+    @param buf the samples
+    @param len the length of the samples in bytes
+    @return 0 on success, -1 if a write failed
+*/
+int gated_iq_writer_write(gated_iq_writer_t *w, gated_iq_segment_t const *rec, int signal, void const *buf, size_t len);
+
+/** Finish a gated recording, writes the index.
+
+    @param w the writer
+    @return 0 on success, -1 if a write failed
+*/
+int gated_iq_writer_finish(gated_iq_writer_t *w);
+
+/** Get the file of a gated recording.
+
+    @param w the writer
+    @return the file
+*/
+FILE *gated_iq_writer_file(gated_iq_writer_t const *w);
+
+/** Free a writer, the file is not closed.
+
+    @param w the writer, may be NULL
+*/
+void gated_iq_writer_free(gated_iq_writer_t *w);
+
+/** Open a gated recording, reads the index if the file is seekable.
+
+    @param path the file path, "-" for stdin
+    @return the reader or NULL on error
+*/
+gated_iq_reader_t *gated_iq_reader_open(char const *path);
+
+/** Get the sample format of a gated recording.
+
+    @param r the reader
+    @return CU8_IQ or CS16_IQ
+*/
+int gated_iq_reader_format(gated_iq_reader_t const *r);
+
+/** Read the next record.
+
+    @param r the reader
+    @param[out] buf the samples, valid until the next read
+    @param[out] rec the position, time, frequency, and sample rate of the record
+    @return the length of the samples in bytes, 0 at the end of the records
+*/
+size_t gated_iq_reader_read(gated_iq_reader_t *r, uint8_t **buf, gated_iq_segment_t *rec);
+
+/** Get the number of segments in the index.
+
+    @param r the reader
+    @return the number of segments, 0 if there is no index
+*/
+unsigned gated_iq_reader_segments(gated_iq_reader_t const *r);
+
+/** Get a segment of the index.
+
+    @param r the reader
+    @param index the segment index
+    @return the segment, NULL if out of range
+*/
+gated_iq_segment_t const *gated_iq_reader_segment(gated_iq_reader_t const *r, unsigned index);
+
+/** Seek to a segment of the index, the next read returns its first record.
+
+    @param r the reader
+    @param index the segment index
+    @return 0 on success, -1 if out of range or the seek failed
+*/
+int gated_iq_reader_seek(gated_iq_reader_t *r, unsigned index);
+
+/** Close the file and free the reader.
+
+    @param r the reader, may be NULL
+*/
+void gated_iq_reader_close(gated_iq_reader_t *r);
+
+#endif /* INCLUDE_GATED_IQ_H_ */
@@ -0,0 +1,92 @@
+/** @file
+    Adaptive frequency hop scheduler.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_HOP_SCHED_H_
+#define INCLUDE_HOP_SCHED_H_
+
+#include <stdint.h>
+
+/*
+The scheduler learns the activity of each frequency while listening to it:
+the rate of packages and of events, and the report interval of each sensor
+seen with repeated events. On each hop it picks the frequency with the most
+expected events in its dwell, stays longer if a sensor is due shortly after
+the dwell, and still visits every frequency from time to time to keep
+learning. All times are in seconds of signal, not wall clock time.
+*/
+
+#define HOP_SCHED_SENSORS 32 ///< sensors tracked per frequency
+
+typedef struct hop_sched hop_sched_t;
+
+/// Statistics of one frequency.
+typedef struct hop_sched_stats {
+    double listen;        ///< total dwell time in s
+    double event_rate;    ///< moving average of events per s of dwell, not counting the periodic sensors
+    double package_rate;  ///< moving average of packages per s of dwell
+    double next_due;      ///< time of the next expected sensor report in s, 0 if none
+    unsigned dwells;      ///< number of dwells
+    unsigned packages;    ///< number of packages
+    unsigned events;      ///< number of events
+    unsigned sensors;     ///< number of sensors with a known report interval
+} hop_sched_stats_t;
+
+/** Create a scheduler.
+
+    @param frequencies number of frequencies to schedule
+    @return the scheduler or NULL on failure
+*/
+hop_sched_t *hop_sched_create(unsigned frequencies);
+
+/** Free a scheduler.
+
+    @param sched the scheduler, may be NULL
+*/
+void hop_sched_free(hop_sched_t *sched);
+
+/** Count a package received on a frequency.
+
+    @param sched the scheduler
+    @param index the frequency index
+*/
+void hop_sched_package(hop_sched_t *sched, unsigned index);
+
+/** Count an event received on a frequency.
+
+    Repeats of the same sensor within a few seconds count as one report.
+
+    @param sched the scheduler
+    @param index the frequency index
+    @param key a hash identifying the sensor, 0 if unknown
+    @param now the time of the event in s
+*/
+void hop_sched_event(hop_sched_t *sched, unsigned index, uint32_t key, double now);
+
+/** End the current dwell and choose the next frequency.
+
+    @param sched the scheduler
+    @param now the time in s
+    @param dwell the base dwell of each frequency in s
+    @param[out] next_dwell the dwell on the chosen frequency in s
+    @return the index of the chosen frequency, may be the current one
+*/
+unsigned hop_sched_next(hop_sched_t *sched, double now, double const *dwell, double *next_dwell);
+
+/** Get the statistics of a frequency.
+
+    @param sched the scheduler
+    @param index the frequency index
+    @param now the time in s
+    @param[out] stats the statistics
+*/
+void hop_sched_get_stats(hop_sched_t const *sched, unsigned index, double now, hop_sched_stats_t *stats);
+
+#endif /* INCLUDE_HOP_SCHED_H_ */
@@ -17,6 +17,7 @@
 struct mg_mgr;
 struct r_cfg;
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, const char *host, const char *port, struct r_cfg *cfg);
+/// Create the HTTP server output, @p opts are comma separated "history=<n>", "history_size=<bytes>", "sensors=<n>", "eventlog=<dir>", and "thread".
+struct data_output *data_output_http_create(struct mg_mgr *mgr, const char *host, const char *port, char *opts, struct r_cfg *cfg);
 
 #endif /* INCLUDE_HTTP_SERVER_H_ */
@@ -0,0 +1,50 @@
+/** @file
+    Lossless compression of CU8 I/Q data for network transport.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_IQ_CODEC_H_
+#define INCLUDE_IQ_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Number of I/Q samples coded with one set of parameters.
+#define IQ_CODEC_BLOCK 1024
+
+/** Get the maximum size of the coded data.
+
+    @param len the length of the CU8 data in bytes
+    @return the size the coded data will never exceed
+*/
+size_t iq_codec_bound(size_t len);
+
+/** Compress CU8 I/Q data.
+
+    Each block of samples is Rice coded either as values or as the difference
+    to the previous sample, whichever is smaller, or stored if neither helps.
+
+    @param src the CU8 data, interleaved I and Q
+    @param len the length of the data in bytes, must be even
+    @param[out] dst the coded data, at least iq_codec_bound() bytes
+    @return the length of the coded data in bytes
+*/
+size_t iq_codec_encode(uint8_t const *src, size_t len, uint8_t *dst);
+
+/** Decompress CU8 I/Q data.
+
+    @param src the coded data
+    @param src_len the length of the coded data in bytes
+    @param[out] dst the CU8 data
+    @param len the length of the CU8 data in bytes, as given to iq_codec_encode()
+    @return 0 on success, -1 if the coded data is corrupt
+*/
+int iq_codec_decode(uint8_t const *src, size_t src_len, uint8_t *dst, size_t len);
+
+#endif /* INCLUDE_IQ_CODEC_H_ */
@@ -0,0 +1,90 @@
+/** @file
+    IQ snippets, the exact samples of each package in a size-capped log on disk.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_IQ_SNIPPET_H_
+#define INCLUDE_IQ_SNIPPET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+The SDR buffers are pushed into a ring in memory. For a package the samples
+from its first to its last pulse, with a margin on either side, are copied
+from the ring into a record of an event log (see event_log.h) in a
+directory of its own. The log keeps EVENT_LOG_SEGMENTS_DEFAULT segments
+which share the size limit, the oldest snippets are removed first. The
+record sequence number is the reference an event carries.
+
+A record is an iq_snippet_header_t and the samples in the input format.
+Unlike a grab (-S) a snippet is not rounded to blocks and costs one copy of
+the package samples, it is cheap enough to save each package.
+
+A snippet never spans a gap in the samples: the ring is emptied on a reset,
+and on a change of the sample size, rate, or center frequency.
+
+The state is not locked, one thread pushes and saves.
+*/
+
+#define IQ_SNIPPET_MAGIC        0x33333449 ///< "I433" in little endian
+#define IQ_SNIPPET_DEFAULT_DIR  "rtl_433_iq"
+#define IQ_SNIPPET_SIZE_DEFAULT 64  ///< disk space in MB if not given
+#define IQ_SNIPPET_MARGIN_MS    10  ///< samples before and after the pulses if not given
+
+/// The header of a snippet record, the samples follow.
+typedef struct iq_snippet_header {
+    uint32_t magic;            ///< IQ_SNIPPET_MAGIC
+    uint32_t sample_size;      ///< bytes per sample, 2 for CU8, 4 for CS16
+    uint32_t sample_rate;      ///< in Hz
+    uint32_t center_frequency; ///< in Hz
+    int64_t time_us;           ///< wall time of the first sample
+    uint64_t samples;          ///< number of samples after the header
+} iq_snippet_header_t;
+
+typedef struct iq_snippet iq_snippet_t;
+
+/** Create the ring and open the snippet log, creates the directory if needed.
+
+    @param dir the directory of the log
+    @param size the disk space of the log in bytes
+    @param ring_size the size of the ring in bytes, bounds the longest snippet
+    @return the state, NULL on error
+*/
+iq_snippet_t *iq_snippet_create(char const *dir, size_t size, unsigned ring_size);
+
+/// Close the log and free the ring, may be NULL.
+void iq_snippet_free(iq_snippet_t *snip);
+
+/// The directory of the log.
+char const *iq_snippet_dir(iq_snippet_t const *snip);
+
+/** Push a buffer of samples into the ring.
+
+    @param snip the state
+    @param format the sample size, rate, center frequency, and the wall time of the end of the buffer
+    @param buf the samples
+    @param len the length of the buffer in bytes
+*/
+void iq_snippet_push(iq_snippet_t *snip, iq_snippet_header_t const *format, void const *buf, uint32_t len);
+
+/// Empty the ring after a gap in the samples, e.g. dropped or skipped buffers.
+void iq_snippet_reset(iq_snippet_t *snip);
+
+/** Save the samples of a package.
+
+    @param snip the state
+    @param start_ago the start of the package in samples before the end of the last buffer
+    @param end_ago the end of the package in samples before the end of the last buffer
+    @param margin samples added before and after, clipped to the ring
+    @return the sequence number of the snippet, 0 if the package is not in the ring or the log failed
+*/
+uint64_t iq_snippet_save(iq_snippet_t *snip, unsigned start_ago, unsigned end_ago, unsigned margin);
+
+#endif /* INCLUDE_IQ_SNIPPET_H_ */
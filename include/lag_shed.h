@@ -0,0 +1,69 @@
+/** @file
+    Buffer load shedding, skips the quietest SDR buffers while the processing lags the input.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_LAG_SHED_H_
+#define INCLUDE_LAG_SHED_H_
+
+#include <stdint.h>
+
+/*
+The lag is the wall time a buffer is processed at less the sample time of
+its last sample, relative to the smallest such offset seen, i.e. the
+buffer processed with the least delay. The reference may follow a slow
+SDR clock upwards by LAG_SHED_DRIFT_PPM of the sample time, so a clock
+drift does not build up to a lag.
+
+While the lag is over the limit, a share of the buffers is skipped, the
+quietest first: a buffer is skipped if its level is below that share of
+the levels of the last LAG_SHED_LEVELS buffers. The share is half at the
+limit and grows with the lag to all but the loudest buffers at twice the
+limit. The caller estimates the levels, e.g. with the squelch pre-scan,
+and accounts the samples of a skipped buffer as if processed.
+
+The state is not locked, one thread processes the buffers.
+*/
+
+#define LAG_SHED_LEVELS    64  ///< recent buffer levels to rank a buffer in
+#define LAG_SHED_DRIFT_PPM 500 ///< the reference follows a slow SDR clock by up to this much of the sample time
+
+typedef struct lag_shed lag_shed_t;
+
+/** Create the buffer load shedding state.
+
+    @param limit_us skip buffers while the lag is over this many us, must not be 0
+    @return the state, NULL on alloc failure
+*/
+lag_shed_t *lag_shed_create(int64_t limit_us);
+
+/// Free the buffer load shedding state, may be NULL.
+void lag_shed_free(lag_shed_t *shed);
+
+/// Start over after a gap in the input, e.g. a reconnect or a sample rate change.
+void lag_shed_reset(lag_shed_t *shed);
+
+/** Update the lag with a buffer about to be processed.
+
+    @param shed the state
+    @param now_us the wall time
+    @param sample_us the sample time of the end of the buffer, counted from any start
+    @return the current lag in us
+*/
+int64_t lag_shed_update(lag_shed_t *shed, int64_t now_us, int64_t sample_us);
+
+/** Check if a buffer is skipped, call after lag_shed_update().
+
+    @param shed the state
+    @param level the level estimate of the buffer, e.g. in dB
+    @return 1 to skip the buffer, 0 to process it
+*/
+int lag_shed_skip(lag_shed_t *shed, float level);
+
+#endif /* INCLUDE_LAG_SHED_H_ */
@@ -0,0 +1,81 @@
+/** @file
+    Load shedding of the decoders, a CPU time budget per package and per second, and a skip of quiet sources.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_LOAD_SHED_H_
+#define INCLUDE_LOAD_SHED_H_
+
+#include <stdint.h>
+
+/*
+Under overload the core decoders should keep up while the costly extras
+give way. A package runs within a time budget and each second of input
+within another. Once the time of a package, or the time of all packages of
+the current input second, is over its budget, the remaining sheddable
+decoders of the package are skipped. The caller decides which decoders are
+sheddable, e.g. the fallback decoders of a later priority and the flex
+decoders.
+
+Packages are also keyed by their source, e.g. a hash of their pulse
+widths. After a number of packages of a source in a row that no decoder
+decoded, the further packages of the source skip the decoders, but every
+LOAD_SHED_PROBE th of them is still decoded, so a source decoding again
+returns. The sources are kept in a small table, the least recently seen
+source gives way to a new one.
+
+All times are passed in by the caller in ns of a monotonic clock, the
+state is not locked, one thread decodes the packages.
+*/
+
+#define LOAD_SHED_SOURCES 32 ///< sources tracked for the quiet skip
+#define LOAD_SHED_PROBE   16 ///< every this many skipped packages of a quiet source one is decoded
+
+typedef struct load_shed load_shed_t;
+
+/** Create the load shedding state.
+
+    @param package_ns the decoder time budget of a package, 0 for none
+    @param second_ns the decoder time budget of a second of input, 0 for none
+    @param quiet_max skip a source after this many packages in a row without an event, 0 for never
+    @return the state, NULL if nothing is enabled or on alloc failure
+*/
+load_shed_t *load_shed_create(uint64_t package_ns, uint64_t second_ns, unsigned quiet_max);
+
+/// Free the load shedding state, may be NULL.
+void load_shed_free(load_shed_t *shed);
+
+/** Start a package.
+
+    @param shed the state
+    @param source the key of the source of the package
+    @param second the input second the package started in, e.g. the sample offset divided by the sample rate
+    @param now the current time
+    @return 1 to skip the decoders on the package of a quiet source, 0 to decode it and call load_shed_end()
+*/
+int load_shed_begin(load_shed_t *shed, uint64_t source, uint64_t second, uint64_t now);
+
+/** Check if the package is over the budget, before each sheddable decoder.
+
+    @param shed the state
+    @param now the current time
+    @return 1 to skip the decoder, 0 to run it, always 0 outside of load_shed_begin() and load_shed_end()
+*/
+int load_shed_over(load_shed_t *shed, uint64_t now);
+
+/** End a package started with load_shed_begin().
+
+    @param shed the state
+    @param events the events the decoders produced on the package
+    @param now the current time
+    @return the number of load_shed_over() checks on the package which shed, 0 if nothing was shed
+*/
+unsigned load_shed_end(load_shed_t *shed, int events, uint64_t now);
+
+#endif /* INCLUDE_LOAD_SHED_H_ */
@@ -0,0 +1,96 @@
+/** @file
+    Lock-free ring of log messages for the event loop, with a per source rate limit.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_LOG_RING_H_
+#define INCLUDE_LOG_RING_H_
+
+#include "r_util.h"
+
+#include <stdint.h>
+
+/*
+Any thread may log, the event loop owns the outputs. A logging thread
+claims a slot with a compare-and-swap on the write position, fills in the
+preformatted message, and publishes the slot with its sequence number.
+The event loop pops the published slots in order. A full ring drops the
+message, nothing blocks. The first message after the ring was drained
+wakes the event loop.
+*/
+
+#define LOG_RING_SIZE 512    ///< messages queued for the event loop
+#define LOG_RING_MSG_MAX 256 ///< message length, as print_logf() formats
+#define LOG_RATE_LIMIT 100   ///< messages per source and second for live inputs, more are suppressed
+
+/// A queued log message.
+typedef struct log_rec {
+    int level;
+    char const *src;                  ///< the log source, must be a static string e.g. __func__
+    char time[LOCAL_TIME_BUFLEN];     ///< the report time when logged, empty if off
+    char msg[LOG_RING_MSG_MAX];
+} log_rec_t;
+
+typedef struct log_ring log_ring_t;
+
+/// Called on the logging thread when the ring has messages again, e.g. to wake the event loop.
+typedef void (*log_ring_wakeup_fn)(void *ctx);
+
+/** Create a log ring.
+
+    @param size the number of messages, rounded up to a power of two
+    @param wakeup_cb the handler to wake the consumer, may be NULL
+    @param ctx user context passed to the handler
+    @return the ring, NULL on alloc failure
+*/
+log_ring_t *log_ring_create(unsigned size, log_ring_wakeup_fn wakeup_cb, void *ctx);
+
+/// Free a log ring, the remaining messages are discarded.
+void log_ring_free(log_ring_t *ring);
+
+/** Queue a message from any thread, never blocks.
+
+    @param ring the log ring
+    @param level the log level
+    @param src the log source, a static string
+    @param time the report time, may be NULL
+    @param msg the message, truncated to LOG_RING_MSG_MAX
+    @return 0 on success, -1 if the ring was full and the message was dropped
+*/
+int log_ring_push(log_ring_t *ring, int level, char const *src, char const *time, char const *msg);
+
+/** Dequeue a message, call from the consumer thread only.
+
+    @param ring the log ring
+    @param[out] rec the message
+    @return 0 on success, -1 if no message is queued
+*/
+int log_ring_pop(log_ring_t *ring, log_rec_t *rec);
+
+/// The number of messages dropped on a full ring.
+unsigned log_ring_dropped(log_ring_t const *ring);
+
+/// Set the messages per source and second, 0 for no limit, the default.
+void log_rate_set_limit(unsigned limit);
+
+/** Check the rate limit of a log source, from any thread.
+
+    Each source may log the set limit of messages a second, the rest of the second is suppressed.
+    The count is approximate if threads log from the same source at once.
+
+    @param src the log source, compared by pointer
+    @param[out] suppressed the messages suppressed in the last limited second, to report once, may be NULL
+    @return 1 if the message should be logged, 0 if it is suppressed
+*/
+int log_rate_allow(char const *src, unsigned *suppressed);
+
+/// The number of messages suppressed by the rate limit.
+unsigned log_rate_suppressed(void);
+
+#endif /* INCLUDE_LOG_RING_H_ */
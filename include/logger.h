@@ -40,6 +40,13 @@ typedef void (*r_logger_handler)(log_level_t level, char const *src, char const
 */
 void r_logger_set_log_handler(r_logger_handler const handler, void *userdata);
 
+/** Get the log handler, e.g. to wrap it.
+
+    @param[out] handler the handler in use, NULL for the default handler
+    @param[out] userdata user data passed back to the handler
+*/
+void r_logger_get_log_handler(r_logger_handler *handler, void **userdata);
+
 /** Log a message string.
 
     @param level a log level
@@ -0,0 +1,41 @@
+/** @file
+    Cumulative histograms for the metrics exporter.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_METRICS_H_
+#define INCLUDE_METRICS_H_
+
+#include <stdint.h>
+
+#define METRICS_HIST_BOUNDS 12 ///< most bucket bounds of a histogram, the +Inf bucket is extra
+
+/// A histogram with fixed bucket bounds, never reset.
+typedef struct metrics_hist {
+    double bounds[METRICS_HIST_BOUNDS];       ///< upper bounds of the buckets, ascending
+    unsigned num_bounds;                      ///< number of bucket bounds used
+    uint64_t counts[METRICS_HIST_BOUNDS + 1]; ///< count of each bucket, not cumulative, the last is the +Inf bucket
+    double sum;                               ///< sum of all values added
+} metrics_hist_t;
+
+/** Set up an empty histogram.
+
+    @param hist the histogram
+    @param bounds the ascending upper bounds of the buckets
+    @param num_bounds number of bounds, at most METRICS_HIST_BOUNDS
+*/
+void metrics_hist_init(metrics_hist_t *hist, double const *bounds, unsigned num_bounds);
+
+/// Count a value in the first bucket with a bound not below the value.
+void metrics_hist_add(metrics_hist_t *hist, double value);
+
+/// Get the number of values added.
+uint64_t metrics_hist_count(metrics_hist_t const *hist);
+
+#endif /* INCLUDE_METRICS_H_ */
@@ -3875,6 +3875,8 @@ void mg_ssl_if_conn_free(struct mg_connection *nc);
 enum mg_ssl_if_result mg_ssl_if_handshake(struct mg_connection *nc);
 int mg_ssl_if_read(struct mg_connection *nc, void *buf, size_t buf_size);
 int mg_ssl_if_write(struct mg_connection *nc, const void *data, size_t len);
+/* The TLS library object of a connection (an SSL * for OpenSSL), NULL if none. */
+void *mg_ssl_if_get_ssl(struct mg_connection *nc);
 
 #ifdef __cplusplus
 }
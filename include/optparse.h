@@ -98,6 +98,17 @@ char *hostport_param(char *param, char const **host, char const **port);
 /// @return parsed number value
 uint32_t atouint32_metric(char const *str, char const *error_hint);
 
+/// Convert a string to a time in seconds, uses strtod() and accepts
+/// time suffixes of 'd', 'h', 'm', 's', and 'ms' (also 'D', 'H', 'M', 'S', and 'MS'),
+/// or the form hours:minutes[:seconds].
+///
+/// Parse errors will fprintf(stderr, ...) and exit(1).
+///
+/// @param str character string to parse
+/// @param error_hint prepended to error output
+/// @return parsed number value in seconds, with fractions
+double atod_time(char const *str, char const *error_hint);
+
 /// Convert a string to an integer, uses strtod() and accepts
 /// time suffixes of 'd', 'h', 'm', and 's' (also 'D', 'H', 'M', and 'S'),
 /// or the form hours:minutes[:seconds].
@@ -0,0 +1,60 @@
+/** @file
+    Aggregating output wrapper, prints one record per sensor and window.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_AGGREGATE_H_
+#define INCLUDE_OUTPUT_AGGREGATE_H_
+
+#include "data.h"
+
+/*
+The events of a sensor, told apart by the model, id, and channel, are
+collected over a window of wall clock time aligned to the window length.
+Each numeric field keeps the min, max, sum, and count of its values. When
+the window ends one record is printed to the wrapped output: the last event
+with each numeric field followed by `<field>_min`, `<field>_max`, and
+`<field>_mean`, then the `window` length and the `events` in the window.
+
+The sensors are kept in a fixed-size table with open addressing, the state
+never grows. The events of sensors that don't fit in the table, and the
+records without a model like logs and reports, are printed unchanged.
+*/
+
+#define AGGREGATE_SENSORS 256 ///< sensors in the table, a power of two
+#define AGGREGATE_FIELDS  16  ///< numeric fields aggregated per sensor, further fields keep the last value
+#define AGGREGATE_KEY_LEN 32  ///< longest aggregated field key, including the terminator
+
+/** Wrap an output to print aggregated records.
+
+    @param inner the output to wrap, the wrapper takes ownership
+    @param window_s the window length in seconds
+    @return the wrapping output, or @p inner on alloc failure
+*/
+struct data_output *data_output_aggregate_create(struct data_output *inner, unsigned window_s);
+
+/** Print the records of the windows that ended.
+
+    Does nothing for other outputs.
+
+    @param output the output
+    @param now the time in s, or a negative time to print all windows
+    @return the number of records printed
+*/
+unsigned data_output_aggregate_expire(struct data_output *output, double now);
+
+/** Add an event at a given time, as the print function does with the current time.
+
+    @param output the aggregating output
+    @param data the event, retained if needed
+    @param now the time in s
+*/
+void data_output_aggregate_add(struct data_output *output, data_t *data, double now);
+
+#endif /* INCLUDE_OUTPUT_AGGREGATE_H_ */
@@ -0,0 +1,40 @@
+/** @file
+    Asynchronous output wrapper, prints to a slow output from a worker thread.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_ASYNC_H_
+#define INCLUDE_OUTPUT_ASYNC_H_
+
+#include "data.h"
+
+struct thread_sched;
+
+/** Wrap an output to print the records on a worker thread.
+
+    Each record is retained and queued, the event loop never waits for the output.
+    Records are dropped if the queue is full, see the "outputs" stats.
+    Only wrap outputs that do not use the event loop, i.e. the file outputs.
+
+    @param inner the output to wrap, the wrapper takes ownership
+    @param queue_size the maximum number of queued records
+    @return the wrapping output, or @p inner if built without threads or on failure
+*/
+struct data_output *data_output_async_create(struct data_output *inner, unsigned queue_size);
+
+/** Set the CPU affinity and priority of the worker thread of an async output.
+
+    Does nothing for other outputs, failures only log a warning.
+
+    @param output the output
+    @param sched the scheduling settings
+*/
+void data_output_async_set_sched(struct data_output *output, struct thread_sched const *sched);
+
+#endif /* INCLUDE_OUTPUT_ASYNC_H_ */
@@ -0,0 +1,56 @@
+/** @file
+    Change-only output wrapper, prints the events of a sensor that changed.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_DELTA_H_
+#define INCLUDE_OUTPUT_DELTA_H_
+
+#include "data.h"
+
+/*
+The last printed event of each sensor, told apart by the model, id, and
+channel, is kept in a fixed-size table. An event is printed if a numeric
+field moved more than the deadband from the printed value, a string field
+changed, a field came or went, or the heartbeat time passed since the last
+printed event. Other events are dropped. The reception meta data (time,
+rssi, snr, noise, freq) doesn't count as a change.
+
+Unlike the repeat dedup this suppresses unchanged readings across minutes.
+Events with nested values, the records without a model (logs, reports),
+and the events of sensors that don't fit in the table always print.
+Sensors not heard for DELTA_FORGET_S, or the heartbeat if longer, are
+dropped from the table.
+*/
+
+#define DELTA_SENSORS 256  ///< sensors in the table, a power of two
+#define DELTA_FIELDS  16   ///< numeric fields compared per sensor, an event with more always prints
+#define DELTA_KEY_LEN 32   ///< longest compared field key, including the terminator
+#define DELTA_FORGET_S 3600 ///< time after that a silent sensor is dropped from the table
+#define DELTA_HEARTBEAT_DEFAULT_S 600 ///< heartbeat if not given
+
+/** Wrap an output to only print the changed events.
+
+    @param inner the output to wrap, the wrapper takes ownership
+    @param deadband the change of a numeric field to print, 0 for any change
+    @param heartbeat_s the time after the last printed event of a sensor to print it anyway, 0 for never
+    @return the wrapping output, or @p inner on alloc failure
+*/
+struct data_output *data_output_delta_create(struct data_output *inner, double deadband, unsigned heartbeat_s);
+
+/** Add an event at a given time, as the print function does with the current time.
+
+    @param output the change-only output
+    @param data the event
+    @param now the time in s
+    @return 1 if the event was printed, 0 if it was dropped
+*/
+int data_output_delta_add(struct data_output *output, data_t *data, double now);
+
+#endif /* INCLUDE_OUTPUT_DELTA_H_ */
@@ -0,0 +1,28 @@
+/** @file
+    Event log output for rtl_433 events, an append-only log of memory-mapped segments.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_EVENTLOG_H_
+#define INCLUDE_OUTPUT_EVENTLOG_H_
+
+#include "data.h"
+
+#define EVENTLOG_DEFAULT_DIR "rtl_433_events"
+
+/** Construct an event log output, see event_log.h for the readers.
+
+    @param log_level the maximum log level to output
+    @param dir the directory of the segments
+    @param opts options: segment=<bytes>, segments=<n>
+    @return The initialized event log output instance, NULL on error.
+*/
+struct data_output *data_output_eventlog_create(int log_level, char const *dir, char *opts);
+
+#endif /* INCLUDE_OUTPUT_EVENTLOG_H_ */
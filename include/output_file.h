@@ -15,17 +15,33 @@
 #include "data.h"
 #include <stdio.h>
 
+/// Layouts of the CSV output.
+enum csv_layout {
+    CSV_LAYOUT_WIDE,   ///< one column per known field, the header lists all fields
+    CSV_LAYOUT_SPARSE, ///< the header grows with the fields seen, rows end at their last value
+    CSV_LAYOUT_LONG,   ///< one row per value: event number, key, value
+};
+
 /** Construct data output for CSV printer.
 
     @param log_level the highest log level to process
     @param file the output stream
+    @param layout one of CSV_LAYOUT_WIDE, CSV_LAYOUT_SPARSE, CSV_LAYOUT_LONG
     @return The auxiliary data to pass along with data_csv_printer to data_print.
             You must release this object with data_output_free once you're done with it.
 */
-struct data_output *data_output_csv_create(int log_level, FILE *file);
+struct data_output *data_output_csv_create(int log_level, FILE *file, int layout);
 
 struct data_output *data_output_json_create(int log_level, FILE *file);
 
 struct data_output *data_output_kv_create(int log_level, FILE *file);
 
+/** Construct data output for a CBOR sequence, one CBOR map per event.
+
+    @param log_level the highest log level to process
+    @param file the output stream, should be opened in binary mode
+    @return The data output, release with data_output_free().
+*/
+struct data_output *data_output_cbor_create(int log_level, FILE *file);
+
 #endif /* INCLUDE_OUTPUT_FILE_H_ */
@@ -0,0 +1,67 @@
+/** @file
+    Filtering output wrapper, prints the events that match an expression.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_FILTER_H_
+#define INCLUDE_OUTPUT_FILTER_H_
+
+#include "data.h"
+
+#include <stddef.h>
+
+/*
+A filter is an expression of field predicates, e.g. `model~Acurite*&&rssi>-20`:
+
+    expr := and ( "||" and )*
+    and  := not ( "&&" not )*
+    not  := "!" not | "(" expr ")" | key [ op value ]
+    op   := "=" | "==" | "!=" | "~" | "!~" | "<" | "<=" | ">" | ">="
+
+A key alone tests that the field is present. Numbers compare as numbers if
+both the field and the value are numbers, otherwise the text of the value,
+"~" matches a glob with "*" and "?". A predicate on a missing or nested
+field is false. The expression is compiled once to postfix code over the
+interned key ids of the top level fields, evaluating an event doesn't
+allocate or format anything unless a number is matched as text.
+
+Only the events with a model are filtered, logs and reports always print.
+*/
+
+#define FILTER_OPS_MAX 64   ///< most predicates and operators in an expression
+#define FILTER_EXPR_MAX 256 ///< longest expression
+
+typedef struct output_filter output_filter_t;
+
+/** Compile a filter expression.
+
+    Interns the keys, call before decoding starts.
+
+    @param expr the expression
+    @param[out] err a message on a syntax error, may be NULL
+    @param err_size the size of @p err
+    @return the filter, NULL on a syntax error or alloc failure
+*/
+output_filter_t *output_filter_compile(char const *expr, char *err, size_t err_size);
+
+/// Free a compiled filter.
+void output_filter_free(output_filter_t *filter);
+
+/// Returns 1 if the event matches the filter, 0 otherwise.
+int output_filter_match(output_filter_t const *filter, data_t const *data);
+
+/** Wrap an output to only print the matching events.
+
+    @param inner the output to wrap, the wrapper takes ownership
+    @param filter the compiled filter, the wrapper takes ownership
+    @return the wrapping output, or @p inner on alloc failure
+*/
+struct data_output *data_output_filter_create(struct data_output *inner, output_filter_t *filter);
+
+#endif /* INCLUDE_OUTPUT_FILTER_H_ */
@@ -22,11 +22,13 @@ struct r_cfg;
 
     @param host the server host to bind
     @param port the server port to bind
-    @param opts additional options, currently "control" enables write access
+    @param opts additional options: "control" enables write access,
+                "clients=<n>" sets the maximum number of clients (default 4),
+                "buffers=<n>" sets the number of frames buffered for slow clients (default 16)
     @param cfg the r_api config to use
     @return The initialized rtltcp output instance.
             You must release this object with raw_output_free once you're done with it.
 */
-struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, char const *opts, struct r_cfg *cfg);
+struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, char *opts, struct r_cfg *cfg);
 
 #endif /* INCLUDE_OUTPUT_RTLTCP_H_ */
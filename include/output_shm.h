@@ -0,0 +1,29 @@
+/** @file
+    Shared memory ring output for rtl_433 events.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_SHM_H_
+#define INCLUDE_OUTPUT_SHM_H_
+
+#include "data.h"
+
+#define SHM_DEFAULT_NAME "rtl_433"
+#define SHM_DEFAULT_SIZE (1024 * 1024)
+
+/** Construct a shared memory ring output, see shm_ring.h for the reader.
+
+    @param log_level the maximum log level to output
+    @param name the shared memory object name
+    @param opts options: cbor, size=<bytes>
+    @return The initialized shared memory output instance, NULL on error.
+*/
+struct data_output *data_output_shm_create(int log_level, char const *name, char *opts);
+
+#endif /* INCLUDE_OUTPUT_SHM_H_ */
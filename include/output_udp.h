@@ -1,5 +1,5 @@
 /** @file
-    UDP syslog output for rtl_433 events.
+    UDP syslog and CBOR output for rtl_433 events.
 
     Copyright (C) 2021 Christian Zuckschwerdt
 
@@ -14,6 +14,28 @@
 
 #include "data.h"
 
-struct data_output *data_output_syslog_create(int log_level, const char *host, const char *port);
+struct mg_mgr;
+
+/** Construct a syslog UDP output.
+
+    @param mgr the mongoose manager for the flush timer
+    @param log_level the maximum log level to output
+    @param host the syslog host
+    @param port the syslog port
+    @param opts options: batch[=<ms>], batch_size=<n>, pack[=<bytes>]
+    @return The initialized syslog output instance.
+*/
+struct data_output *data_output_syslog_create(struct mg_mgr *mgr, int log_level, const char *host, const char *port, char *opts);
+
+/** Construct a CBOR UDP output.
+
+    @param mgr the mongoose manager for the flush timer
+    @param log_level the maximum log level to output
+    @param host the destination host
+    @param port the destination port
+    @param opts options: batch[=<ms>], batch_size=<n>, pack[=<bytes>]
+    @return The initialized UDP output instance.
+*/
+struct data_output *data_output_udp_cbor_create(struct mg_mgr *mgr, int log_level, const char *host, const char *port, char *opts);
 
 #endif /* INCLUDE_OUTPUT_UDP_H_ */
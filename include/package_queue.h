@@ -0,0 +1,85 @@
+/** @file
+    Queue of detected packages for a decode thread, to detect the next packages while one is decoded.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PACKAGE_QUEUE_H_
+#define INCLUDE_PACKAGE_QUEUE_H_
+
+#include "pulse_data.h"
+
+/*
+One thread detects, one thread decodes. The detecting thread takes a free
+slot, copies the package pulses in, and queues it, then continues with the
+next package. The decode thread decodes the slots in the order they were
+queued and frees them. The slots keep their pulse storage, a copy only
+grows it. All slots are free again after package_queue_drain(), e.g. at
+the end of each buffer.
+*/
+
+/// A queued package, valid from package_queue_acquire() until it was decoded.
+typedef struct package_slot {
+    int package_type;        ///< PULSE_DATA_OOK or PULSE_DATA_FSK
+    int events;              ///< the events of the package, set by the caller and the decoder
+    void *owner;             ///< the caller's context of the package, e.g. the channel
+    pulse_data_t pulses;     ///< the OOK pulses of the package
+    pulse_data_t fsk_pulses; ///< the FSK pulses of the package
+} package_slot_t;
+
+/// Called on the decode thread for each queued package.
+typedef void (*package_queue_fn)(void *ctx, package_slot_t *slot);
+
+typedef struct package_queue package_queue_t;
+
+struct thread_sched;
+
+/** Start the decode thread.
+
+    @param slots number of packages queued at most, at least 1
+    @param decode_fn the package handler
+    @param ctx user context passed to the handler
+    @return the queue or NULL on failure or if built without threads
+*/
+package_queue_t *package_queue_start(unsigned slots, package_queue_fn decode_fn, void *ctx);
+
+/** Stop and join the decode thread and free all resources, the queued packages are discarded.
+
+    @param queue the queue, may be NULL
+*/
+void package_queue_stop(package_queue_t *queue);
+
+/** Set the CPU affinity and priority of the decode thread, failures only log a warning.
+
+    @param queue the queue, may be NULL
+    @param sched the scheduling settings
+    @param name the thread name for the log
+*/
+void package_queue_set_sched(package_queue_t *queue, struct thread_sched const *sched, char const *name);
+
+/** Get the next free slot, waits for the decoder if all slots are queued.
+
+    @param queue the queue
+    @return the slot to fill in and pass to package_queue_push()
+*/
+package_slot_t *package_queue_acquire(package_queue_t *queue);
+
+/** Queue the slot from package_queue_acquire() for the decode thread.
+
+    @param queue the queue
+    @param slot the filled in slot
+*/
+void package_queue_push(package_queue_t *queue, package_slot_t *slot);
+
+/** Wait until all queued packages were decoded.
+
+    @param queue the queue, may be NULL
+*/
+void package_queue_drain(package_queue_t *queue);
+
+#endif /* INCLUDE_PACKAGE_QUEUE_H_ */
@@ -14,9 +14,61 @@
 
 #include "pulse_detect.h"
 
+#include <stdio.h>
+
 struct r_device;
+struct data;
+
+#define PULSE_ANALYZE_NEW 2 ///< analyze_pulses mode, only the first package of each signal shape
 
 /// Analyze and print result.
 void pulse_analyzer(pulse_data_t *data, int package_type, struct r_device *device);
 
+/*
+The streaming analyzer groups the packages by their signal shape: the
+pulse and gap widths that make up a good share of a package, in steps
+of a quarter octave. Sorting a package costs one pass over its pulses
+and a compare with each known shape, only a new shape is worth the full
+analysis. Each shape keeps rolling histograms of its widths.
+
+For discovery the shapes also keep the package with the best SNR as a
+sample, with a modulation guess, the flex decoder spec of the guess and
+the bits it slices. The shapes are locked, any thread may add and read.
+*/
+
+typedef struct pulse_clusters pulse_clusters_t;
+
+/** Create the signal shapes of the streaming analyzer.
+
+    @param keep_samples keep and analyze a sample package of each shape
+    @return the shapes, NULL on alloc failure
+*/
+pulse_clusters_t *pulse_clusters_create(int keep_samples);
+
+void pulse_clusters_free(pulse_clusters_t *clusters);
+
+/** Add a package to the signal shape it matches.
+
+    @param clusters the signal shapes seen
+    @param data the package
+    @param package_type PULSE_DATA_OOK or PULSE_DATA_FSK
+    @return the number of the shape if the package starts a new one, 0 otherwise
+*/
+int pulse_clusters_add(pulse_clusters_t *clusters, pulse_data_t const *data, int package_type);
+
+/// Print the signal shapes seen with the widths of their rolling histograms.
+void pulse_clusters_print(pulse_clusters_t *clusters, FILE *out);
+
+/// Describe the signal shapes seen, the caller owns the data.
+struct data *pulse_clusters_data(pulse_clusters_t *clusters);
+
+/** Dump the sample package of a signal shape in the .ook format.
+
+    @param clusters the signal shapes seen
+    @param num the number of the shape
+    @param[out] len the length of the text
+    @return the text, the caller frees it, NULL if there is no such shape or sample
+*/
+char *pulse_clusters_sample_ook(pulse_clusters_t *clusters, unsigned num, size_t *len);
+
 #endif /* INCLUDE_PULSE_ANALYZER_H_ */
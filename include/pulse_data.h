@@ -17,7 +17,8 @@
 #include <stdio.h>
 #include "data.h"
 
-#define PD_MAX_PULSES        1200 // Maximum number of pulses before forcing End Of Package
+#define PD_MAX_PULSES        4800 // Maximum number of pulses before forcing End Of Package
+#define PD_INITIAL_PULSES    128  // Initial capacity of the pulse storage, grows on demand
 #define PD_MIN_PULSES        16   // Minimum number of pulses before declaring a proper package
 #define PD_MIN_PULSE_SAMPLES 10   // Minimum number of samples in a pulse for proper detection
 #define PD_MIN_GAP_MS        10   // Minimum gap size in milliseconds to exceed to declare End Of Package
@@ -33,10 +34,15 @@ typedef struct pulse_data {
     unsigned start_ago;   ///< Start of first pulse in number of samples ago.
     unsigned end_ago;     ///< End of last pulse in number of samples ago.
     unsigned int num_pulses;
-    int pulse[PD_MAX_PULSES]; ///< Width of pulses (high) in number of samples.
-    int gap[PD_MAX_PULSES];   ///< Width of gaps between pulses (low) in number of samples.
+    unsigned max_pulses;      ///< Capacity of the pulse and gap storage, see pulse_data_reserve().
+    int *pulse;               ///< Width of pulses (high) in number of samples.
+    int *gap;                 ///< Width of gaps between pulses (low) in number of samples.
     int ook_low_estimate;     ///< Estimate for the OOK low level (base noise level) at beginning of package.
     int ook_high_estimate;    ///< Estimate for the OOK high level at end of package.
+    int pulse_peak;           ///< Peak envelope level over the pulse samples, 0 if unknown.
+    int pulse_mean;           ///< Mean envelope level over the pulse samples, 0 if unknown.
+    uint64_t pulse_bins;      ///< Width bins occupied by the pulses, see pulse_data_fingerprint(), 0 if not computed.
+    uint64_t gap_bins;        ///< Width bins occupied by the gaps, see pulse_data_fingerprint(), 0 if not computed.
     int fsk_f1_est;           ///< Estimate for the F1 frequency for FSK.
     int fsk_f2_est;           ///< Estimate for the F2 frequency for FSK.
     float freq1_hz;
@@ -46,19 +52,54 @@ typedef struct pulse_data {
     float rssi_db;
     float snr_db;
     float noise_db;
+    uint64_t iq_snippet;      ///< Sequence number of the IQ snippet of the package, 0 if none.
 } pulse_data_t;
 
-/// Clear the content of a pulse_data_t structure.
+/// Clear the content of a pulse_data_t structure, keeps the storage and only zeros the used part.
 void pulse_data_clear(pulse_data_t *data);
 
+/** Grow the pulse and gap storage to hold at least @p num_pulses.
+
+    Pulses and gaps share one allocation, a zero initialized pulse_data_t starts
+    without storage. Writers keep room for the entry at num_pulses.
+
+    @param data the pulse data
+    @param num_pulses the number of pulses needed
+    @return 0 on success, -1 if @p num_pulses exceeds PD_MAX_PULSES
+*/
+int pulse_data_reserve(pulse_data_t *data, unsigned num_pulses);
+
+/// Free the pulse and gap storage of a pulse_data_t structure.
+void pulse_data_free(pulse_data_t *data);
+
+/// Copy a package into @p dst, keeps the storage of @p dst and grows it as needed.
+void pulse_data_copy(pulse_data_t *dst, pulse_data_t const *src);
+
+/// Width bin of a pulse or gap, four bins per octave of samples, clamped to bin 63.
+unsigned pulse_data_width_bin(int width);
+
+/// Compute the width bins which the pulses and gaps occupy, a cheap fingerprint of the package.
+void pulse_data_fingerprint(pulse_data_t *data);
+
 /// Shift out part of the data to make room for more.
 void pulse_data_shift(pulse_data_t *data);
 
 /// Print the content of a pulse_data_t structure (for debug).
 void pulse_data_print(pulse_data_t const *data);
 
-/// Dump the content of a pulse_data_t structure as raw binary.
-void pulse_data_dump_raw(uint8_t *buf, unsigned len, uint64_t buf_offset, pulse_data_t const *data, uint8_t bits);
+/** Paint the pulses and gaps of a package into a logic state buffer.
+
+    Only the spans of the package within the buffer are written, the rest of
+    the buffer is left as is.
+
+    @param buf the logic state buffer, one byte per sample
+    @param len the buffer length in samples
+    @param buf_offset the sample position of the buffer start
+    @param data the package
+    @param bits the state bits of the pulses, the FRAME bit 0x01 is always set
+    @param[in,out] dirty the range of painted samples as start and end, widened to cover the package
+*/
+void pulse_data_dump_raw(uint8_t *buf, unsigned len, uint64_t buf_offset, pulse_data_t const *data, uint8_t bits, unsigned dirty[2]);
 
 /// Print a header for the VCD format.
 void pulse_data_print_vcd_header(FILE *file, uint32_t sample_rate);
@@ -75,6 +116,45 @@ void pulse_data_print_pulse_header(FILE *file);
 /// Print the content of a pulse_data_t structure as OOK text.
 void pulse_data_dump(FILE *file, pulse_data_t const *data);
 
+/*
+The binary pulse format stores the packages with their widths in samples,
+integers are LEB128 varints, signed ones zigzag encoded, the levels in 0.1 dB.
+
+    header:  "RTL433PD", u32 version (little-endian), u64 creation time in us
+    package: 'P', flags (1: FSK), offset, sample rate, sample depth,
+             center frequency, freq1, freq2 (signed, Hz),
+             range, rssi, snr, noise (signed, 0.1 dB),
+             OOK low, OOK high, FSK F1, FSK F2 estimates (signed),
+             number of pulses, then pulse and gap width for each
+*/
+
+#define PD_BIN_VERSION 1 ///< version of the binary pulse format
+#define PD_BIN_HEADER_LEN 20 ///< length of the header of the binary pulse format
+
+/// Write a header for the binary pulse format.
+void pulse_data_print_bin_header(FILE *file);
+
+/// Write the content of a pulse_data_t structure in the binary pulse format.
+void pulse_data_dump_bin(FILE *file, pulse_data_t const *data);
+
+/// Read the header of the binary pulse format, returns 0 on success or -1 if the file has none.
+int pulse_data_load_bin_header(FILE *file);
+
+/// Read the next pulse_data_t structure in the binary pulse format, no pulses at the end or on error.
+void pulse_data_load_bin(FILE *file, pulse_data_t *data);
+
+/// Write a header for the binary pulse format to @p buf, PD_BIN_HEADER_LEN bytes, returns the length.
+size_t pulse_data_encode_bin_header(uint8_t *buf);
+
+/// Check the header of the binary pulse format in @p buf, returns the length or 0 if there is none.
+size_t pulse_data_decode_bin_header(uint8_t const *buf, size_t len);
+
+/// Write a pulse_data_t structure in the binary pulse format to @p buf, returns the length or 0 if it does not fit.
+size_t pulse_data_encode_bin(uint8_t *buf, size_t size, pulse_data_t const *data);
+
+/// Read a pulse_data_t structure in the binary pulse format from @p buf, returns the length read or 0 on error.
+size_t pulse_data_decode_bin(uint8_t const *buf, size_t len, pulse_data_t *data);
+
 /// Print the content of a pulse_data_t structure as OOK json.
 data_t *pulse_data_print_data(pulse_data_t const *data);
 
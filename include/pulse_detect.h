@@ -17,11 +17,14 @@
 #include <stdio.h>
 #include "pulse_data.h"
 #include "data.h"
+#include "fsk_track.h"
 
 /// Package types.
 enum package_types {
     PULSE_DATA_OOK = 1,
     PULSE_DATA_FSK = 2,
+    PULSE_DATA_OOK_PARTIAL = 3, ///< OOK package still being received, see pulse_detect_set_stream()
+    PULSE_DATA_FSK_PARTIAL = 4, ///< FSK package still being received, see pulse_detect_set_stream()
 };
 
 /// FSK pulse detector to use.
@@ -34,6 +37,9 @@ enum {
 
 typedef struct pulse_detect pulse_detect_t;
 
+/// Demodulate FM samples on demand up to and including sample @p end, returns the number of valid samples.
+typedef unsigned (*pulse_detect_fm_fn)(void *ctx, unsigned end);
+
 pulse_detect_t *pulse_detect_create(void);
 
 void pulse_detect_free(pulse_detect_t *pulse_detect);
@@ -48,6 +54,71 @@ void pulse_detect_free(pulse_detect_t *pulse_detect);
 /// @param verbosity Debug output verbosity, 0=None, 1=Levels, 2=Histograms
 void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, float fixed_high_level, float min_high_level, float high_low_ratio, int verbosity);
 
+/// Set an on demand source for the FM samples.
+///
+/// FM samples are then only demodulated where the detector evaluates a possible package.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param fm_fn Callback to fill the fm_data buffer, NULL if fm_data is always complete
+/// @param fm_ctx User context for the callback
+void pulse_detect_set_fm_source(pulse_detect_t *pulse_detect, pulse_detect_fm_fn fm_fn, void *fm_ctx);
+
+/// Set the streaming of partial packages.
+///
+/// While a package is received a partial package is returned each time
+/// another @p stream_pulses pulses are complete, the package is then continued.
+/// The pulse data holds only the complete pulses, the last gap is not the end of the package.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param stream_pulses Number of pulses between partial packages, 0 to only return complete packages
+void pulse_detect_set_stream(pulse_detect_t *pulse_detect, unsigned stream_pulses);
+
+/// The adaptive levels of a detector, e.g. to keep them for each frequency while hopping.
+typedef struct pulse_detect_estimates {
+    int ook_low_estimate;  ///< Estimate for the OOK low level (base noise level)
+    int ook_high_estimate; ///< Estimate for the OOK high level
+    int lead_in_counter;   ///< Samples the low level estimate has settled for
+    fsk_track_t fsk_track; ///< Recent FSK offsets
+} pulse_detect_estimates_t;
+
+/// Get the adaptive levels.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param[out] estimates The current levels
+void pulse_detect_get_estimates(pulse_detect_t const *pulse_detect, pulse_detect_estimates_t *estimates);
+
+/// Continue with adaptive levels from an earlier pulse_detect_get_estimates().
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param estimates The levels to restore
+void pulse_detect_set_estimates(pulse_detect_t *pulse_detect, pulse_detect_estimates_t const *estimates);
+
+/// Seed the FSK detector of each package from the recent decoded packages.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param enable nonzero to seed, the offsets are tracked in any case
+void pulse_detect_set_fsk_track(pulse_detect_t *pulse_detect, int enable);
+
+/// Track the FSK frequency estimates of a decoded package.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param fsk_pulses The decoded FSK package
+void pulse_detect_track_fsk(pulse_detect_t *pulse_detect, pulse_data_t const *fsk_pulses);
+
+/// Get the FSK frequency estimates the next package is seeded with.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param[out] hi_est FM estimate of the higher frequency
+/// @param[out] lo_est FM estimate of the lower frequency
+/// @return 1 if the recent packages give a seed, 0 otherwise
+int pulse_detect_fsk_offset(pulse_detect_t const *pulse_detect, int *hi_est, int *lo_est);
+
+/// Check if a package is being received, i.e. the end of the package is not yet detected.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @return nonzero while a package is in progress
+int pulse_detect_in_package(pulse_detect_t const *pulse_detect);
+
 /// Demodulate On/Off Keying (OOK) and Frequency Shift Keying (FSK) from an envelope signal.
 ///
 /// Function is stateful and can be called with chunks of input data.
@@ -65,6 +136,8 @@ void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, floa
 /// @retval 0 all input sample data is processed
 /// @retval 1 OOK package is detected (but all sample data is still not completely processed)
 /// @retval 2 FSK package is detected (but all sample data is still not completely processed)
+/// @retval 3 OOK package is partially received, call again to continue the package
+/// @retval 4 FSK package is partially received, call again to continue the package
 int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_data, int16_t const *fm_data, int len, uint32_t samp_rate, uint64_t sample_offset, pulse_data_t *pulses, pulse_data_t *fsk_pulses, unsigned fpdm);
 
 #endif /* INCLUDE_PULSE_DETECT_H_ */
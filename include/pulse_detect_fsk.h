@@ -38,6 +38,9 @@ typedef struct {
     int16_t minn;
     int16_t midd;
     int skip_samples;
+
+    int seed_hi; ///< Seeded estimate of the higher frequency, unseeded if not above seed_lo
+    int seed_lo; ///< Seeded estimate of the lower frequency
 } pulse_detect_fsk_t;
 
 /// Init/clear Demodulate Frequency Shift Keying (FSK) state.
@@ -45,6 +48,17 @@ typedef struct {
 /// @param s Internal state
 void pulse_detect_fsk_init(pulse_detect_fsk_t *s);
 
+/// Seed the frequency estimates of a package, e.g. from the recent packages.
+///
+/// Call after pulse_detect_fsk_init(). The classic detector takes the initial
+/// frequency from the closer estimate and detects the first shift at half the
+/// seeded deviation. The min/max detector starts with the estimates as its
+/// trackers, no samples are skipped to converge.
+/// @param s Internal state
+/// @param hi_est FM estimate of the higher frequency
+/// @param lo_est FM estimate of the lower frequency
+void pulse_detect_fsk_seed(pulse_detect_fsk_t *s, int hi_est, int lo_est);
+
 /// Demodulate Frequency Shift Keying (FSK) sample by sample.
 ///
 /// Function is stateful between calls
@@ -60,6 +74,15 @@ void pulse_detect_fsk_init(pulse_detect_fsk_t *s);
 /// @param fsk_pulses Will return a pulse_data_t structure for FSK demodulated data
 void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses);
 
+/// Demodulate Frequency Shift Keying (FSK) for a block of samples.
+///
+/// Same as calling pulse_detect_fsk_classic() for each sample.
+/// @param s Internal state
+/// @param fm_data Samples of FM data
+/// @param len Number of samples
+/// @param fsk_pulses Will return a pulse_data_t structure for FSK demodulated data
+void pulse_detect_fsk_classic_block(pulse_detect_fsk_t *s, int16_t const *fm_data, unsigned len, pulse_data_t *fsk_pulses);
+
 /// Wrap up FSK modulation and store last data at End Of Package.
 ///
 /// @param s Internal state
@@ -74,4 +97,13 @@ void pulse_detect_fsk_wrap_up(pulse_detect_fsk_t *s, pulse_data_t *fsk_pulses);
 /// @param fsk_pulses Will return a pulse_data_t structure for FSK demodulated data
 void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses);
 
+/// Demodulate Frequency Shift Keying (FSK) for a block of samples.
+///
+/// Same as calling pulse_detect_fsk_minmax() for each sample.
+/// @param s Internal state
+/// @param fm_data Samples of FM data
+/// @param len Number of samples
+/// @param fsk_pulses Will return a pulse_data_t structure for FSK demodulated data
+void pulse_detect_fsk_minmax_block(pulse_detect_fsk_t *s, int16_t const *fm_data, unsigned len, pulse_data_t *fsk_pulses);
+
 #endif /* INCLUDE_PULSE_DETECT_FSK_H_ */
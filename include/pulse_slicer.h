@@ -16,6 +16,58 @@
 
 #include "pulse_detect.h"
 #include "r_device.h"
+#include "bitbuffer.h"
+
+/// Number of row searches remembered for the declared preambles of the decoders.
+#define SLICE_SYNCS 8
+
+/// The first match of a declared preamble in a row, e.g. the sync word of a decoder family.
+typedef struct slice_sync {
+    uint8_t preamble[8]; ///< the pattern, preambles longer than this are not remembered
+    unsigned preamble_bits;
+    unsigned row_bits;
+    unsigned pos; ///< position of the first match, row_bits if not found
+    uint8_t row[BITBUF_COLS];
+} slice_sync_t;
+
+/// Bits sliced from one package, shared by decoders with the same modulation and timing.
+///
+/// The caller sets `device->slice_cache` while the decoders run on a package
+/// and clears the cache before the next package.
+typedef struct slice_cache {
+    struct slice_entry *entries;
+    unsigned num_entries;
+    unsigned max_entries;
+    unsigned char *data; ///< used rows of the recorded bits
+    size_t data_len;
+    size_t data_size;
+    slice_sync_t syncs[SLICE_SYNCS]; ///< recent preamble searches, shared by decoders with other timings
+    unsigned num_syncs; ///< searches done, the oldest is replaced
+} slice_cache_t;
+
+/// Free all slices in the cache, the cache can then be used for another package.
+void slice_cache_clear(slice_cache_t *cache);
+
+/// Precompute the timing of a decoder in samples.
+///
+/// The slicers compute the timing on the first package that reaches the decoder
+/// and recompute it if a package has a different sample rate, call this again if
+/// the widths or limits of the decoder change.
+///
+/// @param device The decoder, reads the widths and limits [us]
+/// @param sample_rate The sample rate of the pulse data
+void pulse_slicer_set_timing(r_device *device, uint32_t sample_rate);
+
+/// Check if a package can match the timing of a decoder.
+///
+/// Needs the fingerprint from pulse_data_fingerprint(), a package without
+/// a fingerprint always matches. The decoder can only match if the package
+/// has pulses or gaps near the nominal widths of its symbols.
+///
+/// @param pulses The pulse sequence with fingerprint
+/// @param device The decoder
+/// @return 0 if the decoder can be skipped, 1 otherwise
+int pulse_slicer_prefilter(pulse_data_t const *pulses, r_device *device);
 
 /// Demodulate a Pulse Code Modulation signal.
 ///
@@ -0,0 +1,78 @@
+/** @file
+    Text packages from external receivers, read line by line from stdin, a serial device, or TCP.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_TEXT_H_
+#define INCLUDE_PULSE_TEXT_H_
+
+#include "pulse_data.h"
+
+/*
+Gateways (e.g. CC1101, ESP32, or RFLink based) print their packages as text
+lines. A line is one of:
+
+- an RfRaw code, e.g. "AAB1040...55", a package of its own,
+- a pulse and a gap in us, e.g. "480 960", as in the .ook format, the lines
+  of a package end at a blank line, a ';' comment or header line, or after
+  PULSE_TEXT_IDLE_MS without input,
+- a bit row code, e.g. "{25}fb2dd58", as -y takes, decoded without slicing,
+- a ';' header line of the .ook format, ";fsk", ";freq1", and ";freq2" apply
+  to the next package, other lines are ignored.
+
+The reader does one read() of what is available and parses all complete
+lines of it before the next read, a fast gateway is decoded in batches.
+*/
+
+#define PULSE_TEXT_IDLE_MS 100 ///< a pulse list without an end line ends after this time without input
+
+enum pulse_text_item {
+    PULSE_TEXT_NONE  = 0, ///< a timeout, or only comments
+    PULSE_TEXT_PULSES,    ///< a package in the pulse data
+    PULSE_TEXT_BITS,      ///< a bit row code
+};
+
+typedef struct pulse_text pulse_text_t;
+
+/** Open a text input.
+
+    @param spec "-" for stdin, "tcp://<host>:<port>" to connect to a gateway, otherwise a file or serial device path
+    @param sample_rate the sample rate of the pulse data, the timings are converted from us
+    @return the input, NULL on error
+*/
+pulse_text_t *pulse_text_open(char const *spec, uint32_t sample_rate);
+
+/** Parse one line, for a reader of its own.
+
+    @param text the input, may be opened on an empty spec
+    @param line the line, without the end of line
+    @param[out] pulses the package if PULSE_TEXT_PULSES is returned
+    @return the item the line completed, the line itself may be held back for the next package
+*/
+int pulse_text_parse(pulse_text_t *text, char const *line, pulse_data_t *pulses);
+
+/** Get the next package or bit row.
+
+    @param text the input
+    @param[out] pulses the package on PULSE_TEXT_PULSES
+    @param timeout_ms the time to wait for input
+    @return PULSE_TEXT_PULSES, PULSE_TEXT_BITS, PULSE_TEXT_NONE on a timeout, -1 on the end of the input or an error
+*/
+int pulse_text_next(pulse_text_t *text, pulse_data_t *pulses, int timeout_ms);
+
+/// The bit row code of the last PULSE_TEXT_BITS.
+char const *pulse_text_bits(pulse_text_t const *text);
+
+/// The number of lines that were not understood.
+unsigned pulse_text_invalid(pulse_text_t const *text);
+
+/// Close the input.
+void pulse_text_free(pulse_text_t *text);
+
+#endif /* INCLUDE_PULSE_TEXT_H_ */
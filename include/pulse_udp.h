@@ -0,0 +1,72 @@
+/** @file
+    Pulse packages over UDP, to decode the packages of remote receivers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_UDP_H_
+#define INCLUDE_PULSE_UDP_H_
+
+#include "pulse_data.h"
+
+#include <stddef.h>
+
+/*
+Each datagram holds a header and a package in the binary pulse format,
+see pulse_data.h, i.e. a datagram reads as a short .pls file. The header
+time is the send time. A receiver reads the datagrams of many senders on
+one socket, a lost datagram is a lost package.
+*/
+
+#define PULSE_UDP_PORT "1435" ///< default port of the pulse packages
+
+typedef struct pulse_sender pulse_sender_t;
+
+/** Open a sender of pulse packages.
+
+    @param host the receiving host
+    @param port the receiving port
+    @return the sender, NULL on error
+*/
+pulse_sender_t *pulse_sender_create(char const *host, char const *port);
+
+/// Send a package, from any thread.
+void pulse_sender_send(pulse_sender_t *sender, pulse_data_t const *pulses);
+
+/// Close a sender.
+void pulse_sender_free(pulse_sender_t *sender);
+
+typedef struct pulse_receiver pulse_receiver_t;
+
+/** Open a receiver of pulse packages.
+
+    @param host the address to bind, e.g. "0.0.0.0"
+    @param port the port to bind
+    @return the receiver, NULL on error
+*/
+pulse_receiver_t *pulse_receiver_create(char const *host, char const *port);
+
+/** Receive the next package.
+
+    @param receiver the receiver
+    @param[out] pulses the package
+    @param timeout_ms the time to wait for a datagram
+    @return 1 on a package, 0 on a timeout, -1 on a socket error
+*/
+int pulse_receiver_next(pulse_receiver_t *receiver, pulse_data_t *pulses, int timeout_ms);
+
+/// The numeric host of the sender of the last package.
+char const *pulse_receiver_peer(pulse_receiver_t const *receiver);
+
+/// The number of datagrams received that held no valid package.
+unsigned pulse_receiver_invalid(pulse_receiver_t const *receiver);
+
+/// Close a receiver.
+void pulse_receiver_free(pulse_receiver_t *receiver);
+
+#endif /* INCLUDE_PULSE_UDP_H_ */
@@ -13,12 +13,15 @@
 #define INCLUDE_R_API_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 struct r_cfg;
 struct r_device;
 struct data;
 struct pulse_data;
 struct list;
+struct worker_pool;
+struct dm_state;
 struct mg_mgr;
 
 /* general */
@@ -31,16 +34,85 @@ void r_init_cfg(struct r_cfg *cfg);
 
 void r_free_cfg(struct r_cfg *cfg);
 
+/// Free @p cfg as r_free_cfg(), but keep the log handler, the file sinks, and the interned keys of the process.
+void r_free_cfg_local(struct r_cfg *cfg);
+
+/// Add a further input opened with @p dev_query, owned by @p cfg.
+struct r_cfg *r_add_input(struct r_cfg *cfg, char *dev_query);
+
+/// Clone the options, outputs, and decoders of @p cfg to a further input, once the outputs are started.
+void r_start_input(struct r_cfg *cfg, struct r_cfg *input);
+
+/// Free an input started with r_start_input() that is not in r_cfg.inputs, the outputs are kept.
+void r_free_input(struct r_cfg *input);
+
 /* device decoder protocols */
 
 void register_protocol(struct r_cfg *cfg, struct r_device *r_dev, char *arg);
 
+/** Register a flex decoder, see -X.
+
+    The parsed specs are cached, registering a spec again on a reload clones
+    the parsed decoder. A spec not registered in a reload is dropped.
+    Exits on a bad spec.
+*/
+void register_flex_protocol(struct r_cfg *cfg, char *spec);
+
 void free_protocol(struct r_device *r_dev);
 
 void unregister_protocol(struct r_cfg *cfg, struct r_device *r_dev);
 
 void register_all_protocols(struct r_cfg *cfg, unsigned disabled);
 
+/** Take on newly registered decoders in place of the @p retired ones.
+
+    The further inputs get copies of the new decoders, the pulse streaming and
+    FM demod follow the new decoders, and the retired decoders are freed.
+    Call on the event loop with the inputs paused between buffers.
+*/
+void r_reload_protocols(struct r_cfg *cfg, struct list *retired);
+
+/** Sort the decoders for the dispatch, see decoder_dispatch_t.
+
+    The decode functions rebuild a stale dispatch on their own, call this
+    after changing the decoders if packages are decoded on several threads.
+*/
+void r_update_dispatch(struct dm_state *demod);
+
+/** Get the sample buffers of a demod for buffers of @p n_samples samples.
+
+    The buffers grow to the largest buffer seen, the channel, logic and
+    dumper conversion buffers are only allocated if the demod needs them.
+
+    @return 0 on success, -1 on alloc failure
+*/
+int r_demod_reserve(struct dm_state *demod, unsigned n_samples);
+
+/// Bytes of sample buffers a demod needs per sample, to estimate the memory use before the buffers exist.
+size_t r_demod_sample_bytes(struct dm_state const *demod);
+
+/// Memory use of the subsystems in bytes.
+typedef struct r_mem_usage {
+    size_t sdr;      ///< sample buffers of the SDR
+    size_t demod;    ///< demods and their sample buffers
+    size_t pulses;   ///< pulse storage of the demods
+    size_t decoders; ///< registered decoders and their dispatch
+    size_t grabber;  ///< sample grabber ring
+    size_t dumpers;  ///< block pool of the async dumper writer
+} r_mem_usage_t;
+
+/// Get the memory use of the subsystems.
+void r_get_mem_usage(struct r_cfg *cfg, r_mem_usage_t *mem);
+
+/// Prepare the unit conversions of the registered decoders unless the units are native, call before the inputs start.
+void r_prepare_conversions(struct r_cfg *cfg);
+
+/// Give the registered decoders a memo of their recent decodes if requested, call before the inputs start.
+void r_prepare_decode_memo(struct r_cfg *cfg);
+
+/// Find the highest log level the outputs take and pass it to the registered decoders, call after adding outputs.
+void r_update_log_level(struct r_cfg *cfg);
+
 /* output helper */
 
 void calc_rssi_snr(struct r_cfg *cfg, struct pulse_data *pulse_data);
@@ -55,6 +127,43 @@ int run_ook_demods(struct list *r_devs, struct pulse_data *pulse_data);
 
 int run_fsk_demods(struct list *r_devs, struct pulse_data *fsk_pulse_data);
 
+/// Run the OOK decoders of the dispatch order on an OOK package on the pool threads, or on this thread with a NULL pool.
+int run_ook_demods_pool(struct worker_pool *pool, struct dm_state *demod, struct pulse_data *pulse_data);
+
+/// Run the FSK decoders of the dispatch order on an FSK package on the pool threads, or on this thread with a NULL pool.
+int run_fsk_demods_pool(struct worker_pool *pool, struct dm_state *demod, struct pulse_data *fsk_pulse_data);
+
+/// Run the decoders on an OOK package in order of recent hits, see r_cfg.adaptive_order, the output order is kept.
+int run_ook_demods_adaptive(struct r_cfg *cfg, struct pulse_data *pulse_data);
+
+/// Run the decoders on an FSK package in order of recent hits, see r_cfg.adaptive_order, the output order is kept.
+int run_fsk_demods_adaptive(struct r_cfg *cfg, struct pulse_data *fsk_pulse_data);
+
+/** Run the decoder pinned to the fingerprint of a package alone, see -Y pin.
+
+    Starts the package of decode_pin_begin(), the caller ends it with decode_pin_end(), sets @p tried if the decoder ran.
+    @return the events of the pinned decoder, 0 if none or nothing is pinned, then the cascade runs
+*/
+int run_demods_pinned(struct dm_state *demod, struct pulse_data *pulse_data, uint64_t key, int fsk, int *tried);
+
+/** Run the decoders of the dispatch order on a package the reference way, for the verify mode.
+
+    Each priority runs on this thread without the fingerprint prefilter, the slice cache, and the load shedding.
+    The decoded data goes to @p event_fn, and is freed after the call, instead of the outputs.
+    The decoder counters and timing are kept as they were.
+*/
+int run_demods_reference(struct dm_state *demod, struct pulse_data *pulse_data, int fsk,
+        void (*event_fn)(void *ctx, struct r_device *r_dev, struct data *data), void *ctx);
+
+/// Run the decoders with r_device.stream_pulses on a partial OOK package, returns the number of events.
+int run_ook_demods_partial(struct dm_state *demod, struct pulse_data *pulse_data);
+
+/// Run the decoders with r_device.stream_pulses on a partial FSK package, returns the number of events.
+int run_fsk_demods_partial(struct dm_state *demod, struct pulse_data *fsk_pulse_data);
+
+/// Get the smallest r_device.stream_pulses of the decoders, 0 if no decoder streams.
+unsigned stream_pulses_min(struct list *r_devs);
+
 /* handlers */
 
 void r_redirect_logging(struct r_cfg *cfg);
@@ -69,6 +178,30 @@ struct data *create_report_data(struct r_cfg *cfg, int level);
 
 void flush_report_data(struct r_cfg *cfg);
 
+/// Get the state of the adaptive hop scheduler, NULL if it's not used.
+struct data *create_hop_schedule_data(struct r_cfg *cfg);
+
+/// Get the state of the band scan, NULL if it's not used.
+struct data *create_band_scan_data(struct r_cfg *cfg);
+
+/// Output the merged events whose window ended, or all held events, call this on the thread that decodes.
+void expire_merged_events(struct r_cfg *cfg, int all);
+
+/// Deliver output data queued by the DSP thread, call this on the event loop thread.
+void flush_output_queue(struct r_cfg *cfg);
+
+/// Output the log messages queued by the other threads, call this on the event loop thread.
+void flush_log_ring(struct r_cfg *cfg);
+
+/// Print the output data collected in a r_cfg.output_capture list and empty the list.
+void flush_output_capture(struct r_cfg *cfg, struct list *capture);
+
+/// Pass the output data collected in a r_cfg.output_capture list to @p forward_fn, which takes the data, and empty the list.
+void forward_output_capture(struct list *capture, void (*forward_fn)(void *ctx, struct data *data, int level), void *ctx);
+
+/// Output data made elsewhere, e.g. by a decode worker, as is, @p ctx is the r_cfg.
+void output_remote_data(void *ctx, struct data *data, int level);
+
 /* setup */
 
 void add_json_output(struct r_cfg *cfg, char *param);
@@ -79,6 +212,14 @@ void add_log_output(struct r_cfg *cfg, char *param);
 
 void add_kv_output(struct r_cfg *cfg, char *param);
 
+void add_cbor_output(struct r_cfg *cfg, char *param);
+
+void add_udp_output(struct r_cfg *cfg, char *param);
+
+void add_shm_output(struct r_cfg *cfg, char *param);
+
+void add_eventlog_output(struct r_cfg *cfg, char *param);
+
 void add_mqtt_output(struct r_cfg *cfg, char *param);
 
 void add_influx_output(struct r_cfg *cfg, char *param);
@@ -93,6 +234,39 @@ void add_null_output(struct r_cfg *cfg, char *param);
 
 void add_rtltcp_output(struct r_cfg *cfg, char *param);
 
+void add_rfraw_output(struct r_cfg *cfg, char *param);
+
+void add_pulse_output(struct r_cfg *cfg, char *param);
+
+/// Cut an ",aggregate=<time>" option from an output argument, returns the window in s or 0 without the option.
+unsigned output_aggregate_param(char *arg);
+
+/// Wrap the outputs from index @p first on to print one aggregated record per sensor and window.
+void aggregate_outputs(struct r_cfg *cfg, size_t first, unsigned window_s);
+
+/// Cut the ",delta[=<deadband>]" and ",heartbeat=<time>" options from an output argument, returns 0 without delta.
+int output_delta_param(char *arg, double *deadband, unsigned *heartbeat_s);
+
+/// Wrap the outputs from index @p first on to only print the events of a sensor that changed.
+void delta_outputs(struct r_cfg *cfg, size_t first, double deadband, unsigned heartbeat_s);
+
+/// Cut a ",filter=<expr>" option from an output argument, checks and copies the expression, returns 0 without the option.
+int output_filter_param(char *arg, char *expr, size_t expr_size);
+
+/// Wrap the outputs from index @p first on to only print the events that match the filter expression.
+void filter_outputs(struct r_cfg *cfg, size_t first, char const *expr);
+
+#define OUTPUT_FIELDS_MAX 256 ///< longest field projection options of an output
+
+/// Cut the ",fields=<rule>" and ",exclude=<rule>" options from an output argument, checks and copies them, returns 0 without the options.
+int output_fields_param(char *arg, char *rules, size_t rules_size);
+
+/// Set the field projection of the outputs from index @p first on, before any wrapping.
+void project_outputs(struct r_cfg *cfg, size_t first, char const *rules);
+
+/// Print the aggregated records of the windows that ended, call on the event loop.
+void expire_aggregates(struct r_cfg *cfg);
+
 void start_outputs(struct r_cfg *cfg, char const *const *well_known);
 
 void add_sr_dumper(struct r_cfg *cfg, char const *spec, int overwrite);
@@ -103,6 +277,9 @@ void close_dumpers(struct r_cfg *cfg);
 
 void add_dumper(struct r_cfg *cfg, char const *spec, int overwrite);
 
+/// Write the sample dumpers from a writer thread, see -Y dump_async.
+void start_dump_writer(struct r_cfg *cfg, int wait);
+
 void add_infile(struct r_cfg *cfg, char *in_file);
 
 void add_data_tag(struct r_cfg *cfg, char *param);
@@ -119,4 +296,7 @@ void set_sample_rate(struct r_cfg *cfg, uint32_t sample_rate);
 
 void set_gain_str(struct r_cfg *cfg, char const *gain_str);
 
+/// Set the tuner gain from the gain option, starts or stops the software gain control for "agc".
+void apply_tuner_gain(struct r_cfg *cfg, int verbose);
+
 #endif /* INCLUDE_R_API_H_ */
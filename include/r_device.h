@@ -5,6 +5,10 @@
 #ifndef INCLUDE_R_DEVICE_H_
 #define INCLUDE_R_DEVICE_H_
 
+#include <stdint.h>
+#include "cpu_stats.h"
+#include "stats.h"
+
 /**
     Supported Modulation and Coding types.
 
@@ -53,6 +57,33 @@ enum decode_return_codes {
 
 struct bitbuffer;
 struct data;
+struct pulse_data;
+struct decode_scratch;
+struct data_schema_field;
+
+#define TIMING_STEPS_MAX 16 ///< most timing hypotheses of a decoder
+
+#ifdef FIXED_POINT
+typedef int64_t slice_recip_t; ///< reciprocal of a width in samples, Q32
+#else
+typedef float slice_recip_t; ///< reciprocal of a width in samples
+#endif
+
+/// Timing of a decoder in samples, precomputed by pulse_slicer_set_timing().
+typedef struct r_device_timing {
+    uint32_t sample_rate; ///< sample rate the timing is for, 0 if not computed yet
+    int valid;            ///< no nonzero limit rounds to zero samples at this rate
+    int s_short;
+    int s_long;
+    int s_reset;
+    int s_gap;
+    int s_sync;
+    int s_tolerance;
+    slice_recip_t f_short; ///< precision reciprocal of the short width in samples, 0 if not set
+    slice_recip_t f_long;  ///< precision reciprocal of the long width in samples, 0 if not set
+    uint64_t pulse_bins; ///< width bins of which a package needs a pulse to match, 0 for any package
+    uint64_t gap_bins;   ///< width bins of which a package needs a gap to match, 0 for any package
+} r_device_timing_t;
 
 /** Device protocol decoder struct. */
 typedef struct r_device {
@@ -67,27 +98,74 @@ typedef struct r_device {
     float gap_limit;
     float sync_width;
     float tolerance;
+    float timing_scale_min; ///< PWM/PPM only: smallest scale of the timing hypotheses, 0 for the fixed timing
+    float timing_scale_max; ///< PWM/PPM only: largest scale of the timing hypotheses
+    unsigned timing_steps;  ///< PWM/PPM only: hypotheses from the smallest to the largest scale, at most TIMING_STEPS_MAX
     int (*decode_fn)(struct r_device *decoder, struct bitbuffer *bitbuffer);
+    /// Used instead of decode_fn if set, with the scratch buffers of the thread, never NULL.
+    int (*decode_fn2)(struct r_device *decoder, struct bitbuffer *bitbuffer, struct decode_scratch *scratch);
     struct r_device *(*create_fn)(char *args);
     unsigned priority; ///< Run later and only if no previous events were produced
     unsigned disabled; ///< 0: default enabled, 1: default disabled, 2: disabled, 3: disabled and hidden
     char const *const *fields; ///< List of fields this decoder produces; required for CSV output. NULL-terminated.
+    struct data_schema_field const *schema; ///< The fields with their types in output order, NULL key terminated, for decoder_output_record(); NULL for none
+    unsigned stream_pulses; ///< Decode while the package is received once it has this many pulses, 0 waits for the end of the package
+    unsigned exclusive; ///< A successful decode rules out the other decoders of this priority, used with the adaptive order
+    unsigned keeps_state; ///< The decoder combines several packages, a repeat may decode differently, never memoized
+    unsigned max_rows;        ///< Skip the decoder for packages sliced to more rows, 0 for any number of rows
+    uint16_t row_bits[4];     ///< Skip the decoder unless a row has one of these lengths, 0 terminated, all 0 for any length
+    uint8_t const *preamble;  ///< Skip the decoder unless a row contains this pattern, NULL for any package
+    unsigned preamble_bits;   ///< Number of bits in the preamble pattern
 
     /* public for each decoder */
     int verbose;
     int verbose_bits;
+    int log_level; ///< the highest log level any output takes, the decoder_log_ functions skip the messages above
     void (*log_fn)(struct r_device *decoder, int level, struct data *data);
     void (*output_fn)(struct r_device *decoder, struct data *data);
 
     /* Decoder results / statistics */
-    unsigned decode_events;
-    unsigned decode_ok;
-    unsigned decode_messages;
-    unsigned decode_fails[5];
+    cpu_stat_t cpu_slice;  ///< time in the slicer, includes cpu_decode
+    cpu_stat_t cpu_decode; ///< time in decode_fn
+    decoder_stats_t stats_base; ///< the counters at the start of the report interval, for the report only
+    unsigned char stats_pad0[STATS_CACHE_LINE];
+    decoder_stats_t stats; ///< the counters, written by the thread running the decoder, see stats.h
+    unsigned char stats_pad1[STATS_CACHE_LINE];
 
     /* private for flex decoder and output callback */
     void *decode_ctx;
     void *output_ctx;
+    int want_windows; ///< the decoder or its preamble checks slice_windows, the slice cache then records them
+    struct bitbuffer_windows const *slice_windows; ///< windows of the bits passed to decode_fn, NULL if not known
+
+    /* private for streaming decodes */
+    struct pulse_data const *stream_pulse_data; ///< package this decoder already reported while it was received
+    uint64_t stream_offset;                     ///< sample offset of that package
+
+    /* private for threaded decodes */
+    void *defer_ctx; ///< queue for the outputs while the decoder runs on a decode pool thread, NULL to output directly
+
+    /* private for the adaptive decoder order */
+    unsigned hit_score;  ///< recent successful packages, halved periodically
+    unsigned list_index; ///< position in the decoder list, restores the output order
+
+    /* private for the slicers */
+    r_device_timing_t timing; ///< timing in samples, recomputed when a package has another sample rate
+    struct bitbuffer *slice_bits; ///< scratch bits without a scratch, kept all zero between slicer runs, allocated on first use
+    struct decode_scratch *scratch; ///< scratch buffers of the thread running the decoder, NULL if not set
+
+    /* private for registering on further inputs */
+    struct r_device *create_template; ///< protocol this decoder was registered from
+    char *create_arg;                 ///< argument it was registered with, NULL for none
+
+    /* private for the slice cache */
+    struct slice_cache *slice_cache; ///< bits already sliced from the current package, NULL to always slice
+
+    /* private for the decode memo */
+    struct decode_memo *decode_memo; ///< recent decodes of this decoder, NULL to always decode
+
+    /* private for the static schema */
+    struct data_schema *record_schema; ///< the schema prepared from the fields of schema, NULL without a schema
 } r_device;
 
 #endif /* INCLUDE_R_DEVICE_H_ */
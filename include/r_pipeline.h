@@ -0,0 +1,127 @@
+/** @file
+    Embeddable decoder pipeline, from IQ samples or pulses to the decoded events.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_R_PIPELINE_H_
+#define INCLUDE_R_PIPELINE_H_
+
+#include "data.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct pulse_data;
+
+/*
+A pipeline is a complete receiver without an SDR, an event loop, or
+outputs: the caller feeds buffers and each decoded event is passed to the
+event handler before the feed returns, on the caller's thread.
+
+Pipelines share nothing, several pipelines can be fed from several threads
+at once. The process wide tables are set up by the first r_pipeline_create(),
+create one pipeline before feeding others concurrently. The pipelines log
+through the process wide log handler, see r_logger_set_log_handler().
+*/
+
+typedef struct r_pipeline r_pipeline_t;
+
+/** Called with each decoded event.
+
+    The event belongs to the pipeline and is freed once the handler returns,
+    use data_retain() and data_free() to keep it.
+
+    @param ctx the user context given to r_pipeline_create()
+    @param data the event, the fields as with the JSON output
+*/
+typedef void (*r_pipeline_event_fn)(void *ctx, data_t *data);
+
+/// Sample formats of r_pipeline_feed_iq().
+enum r_pipeline_format {
+    R_PIPELINE_CU8  = 2, ///< interleaved unsigned 8 bit I and Q, the sample size in bytes
+    R_PIPELINE_CS16 = 4, ///< interleaved signed 16 bit I and Q, the sample size in bytes
+};
+
+/// A field of an event, see r_pipeline_fields(). The strings and nested values point into the event.
+typedef struct r_field {
+    char const *key;
+    unsigned key_id; ///< one of data_key_ids, 0 for other keys
+    data_type_t type;
+    data_value_t value; ///< v_int, v_dbl, or v_ptr to the string, the nested data_t, or the data_array_t
+} r_field_t;
+
+/** Create a pipeline without decoders.
+
+    @param samp_rate the sample rate of the IQ buffers and pulses
+    @param format the sample format, one of r_pipeline_format
+    @param event_cb the handler of the decoded events
+    @param ctx user context passed to the handler
+    @return the pipeline, NULL on alloc failure or an unknown format
+*/
+r_pipeline_t *r_pipeline_create(uint32_t samp_rate, int format, r_pipeline_event_fn event_cb, void *ctx);
+
+/// Free a pipeline, the events retained by the caller are kept.
+void r_pipeline_free(r_pipeline_t *p);
+
+/// Register all decoders enabled by default.
+void r_pipeline_register_all(r_pipeline_t *p);
+
+/** Register a decoder by protocol number, as with `-R`.
+
+    @param p the pipeline
+    @param protocol_num the protocol number
+    @param arg the decoder arguments, may be NULL
+    @return 0 on success, -1 for an unknown protocol number
+*/
+int r_pipeline_register(r_pipeline_t *p, unsigned protocol_num, char const *arg);
+
+/** Register a flex decoder, as with `-X`, an invalid spec is fatal as on the command line.
+
+    @param p the pipeline
+    @param spec the flex decoder spec
+    @return 0 on success, -1 on alloc failure
+*/
+int r_pipeline_register_flex(r_pipeline_t *p, char const *spec);
+
+/// Set the frequency the samples were received on, reported as the freq fields.
+void r_pipeline_set_frequency(r_pipeline_t *p, uint32_t frequency);
+
+/// Add the modulation, frequency, RSSI, SNR, and noise fields to the events, as with `-M level`.
+void r_pipeline_set_report_meta(r_pipeline_t *p, int report_meta);
+
+/** Demodulate and decode a buffer of IQ samples, the state carries over to the next buffer.
+
+    @param p the pipeline
+    @param buf the samples in the format of the pipeline
+    @param len the buffer length in bytes, a trailing partial sample is ignored
+    @return the number of events, -1 on alloc failure of the sample buffers
+*/
+int r_pipeline_feed_iq(r_pipeline_t *p, void const *buf, size_t len);
+
+/** Decode a package of pulses, e.g. from another receiver or a pulse file.
+
+    The pulses are decoded in place, the package is not copied.
+
+    @param p the pipeline
+    @param pulses the package, with the sample rate of the pipeline if its sample_rate is 0
+    @param fsk nonzero if the pulses are FSK
+    @return the number of events
+*/
+int r_pipeline_feed_pulses(r_pipeline_t *p, struct pulse_data *pulses, int fsk);
+
+/** Get the fields of an event as a flat array, without copies.
+
+    @param data the event, as passed to the event handler
+    @param[out] fields the fields, the strings stay valid while the event is
+    @param size the number of fields that fit
+    @return the number of fields of the event, at most @p size are written
+*/
+unsigned r_pipeline_fields(data_t const *data, r_field_t *fields, unsigned size);
+
+#endif /* INCLUDE_R_PIPELINE_H_ */
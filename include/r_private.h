@@ -13,52 +13,168 @@
 #include "fileformat.h"
 #include "samp_grab.h"
 #include "am_analyze.h"
+#include "gated_iq.h"
+#include "sigmf.h"
+#include "write_sigrok.h"
 #include "rtl_433.h"
 #include "compat_time.h"
+#include "cpu_stats.h"
+
+/// The dumper formats converted from the samples, the dumpers of a format share a buffer.
+enum dump_conversion {
+    DUMP_CU8,
+    DUMP_CS16,
+    DUMP_CS8,
+    DUMP_CF32,
+    DUMP_F32_AM,
+    DUMP_F32_FM,
+    DUMP_F32_I,
+    DUMP_F32_Q,
+    DUMP_CONVERSIONS,
+};
+
+/// Get the conversion of a dumper format, -1 if the format is dumped as is.
+static inline int dump_conversion(int format)
+{
+    switch (format) {
+    case CU8_IQ:
+    case GIQ_CU8:
+    case SIGMF_CU8: return DUMP_CU8;
+    case CS16_IQ:
+    case GIQ_CS16:
+    case SIGMF_CS16: return DUMP_CS16;
+    case CS8_IQ:
+    case SIGMF_CS8: return DUMP_CS8;
+    case CF32_IQ:
+    case SIGMF_CF32: return DUMP_CF32;
+    case F32_AM: return DUMP_F32_AM;
+    case F32_FM: return DUMP_F32_FM;
+    case F32_I: return DUMP_F32_I;
+    case F32_Q: return DUMP_F32_Q;
+    default: return -1;
+    }
+}
+
+/// Get the buffer size of a dumper conversion for @p max_samples samples.
+static inline size_t dump_conversion_size(int conversion, size_t max_samples)
+{
+    switch (conversion) {
+    case DUMP_CU8: return max_samples * 2 * sizeof(uint8_t);
+    case DUMP_CS16: return max_samples * 2 * sizeof(int16_t);
+    case DUMP_CS8: return max_samples * 2 * sizeof(int8_t);
+    case DUMP_CF32: return max_samples * 2 * sizeof(float);
+    default: return max_samples * sizeof(float);
+    }
+}
+
+/// The decoders of r_devs in the order they run: the OOK decoders then the FSK decoders, each by priority, then by list position.
+typedef struct decoder_dispatch {
+    struct r_device **devs;
+    unsigned *priority; ///< the priority of each decoder, to find the priority groups without touching the decoders
+    unsigned num_ook;   ///< the first num_ook decoders are OOK, the rest FSK
+    unsigned len;
+    unsigned size;
+    int stale; ///< r_devs changed, rebuilt by r_update_dispatch() before the next package
+    unsigned generation; ///< counts the rebuilds, a decoder pointer kept across one may be stale
+} decoder_dispatch_t;
+
+/// The adaptive levels of a hop frequency, restored when hopping back to it.
+typedef struct hop_levels {
+    int valid; ///< the frequency was demodulated before
+    db_level_t noise_level;
+    db_level_t min_level_auto;
+    pulse_detect_estimates_t estimates;
+} hop_levels_t;
+
+// slices of the decoder list, a few per thread to balance the load
+#define DECODE_POOL_TASKS 16
 
 struct dm_state {
     float auto_level;
     float squelch_offset;
     float level_limit;
-    float noise_level;
-    float min_level_auto;
+    db_level_t noise_level;
+    db_level_t min_level_auto;
+    hop_levels_t hop_levels[MAX_FREQS]; ///< the levels of each -f frequency while hopping
     float min_level;
     float min_snr;
+    float gate_snr; ///< packages below this SNR skip the decoders, 0 is off
+    int prefilter;  ///< skip the decoders whose pulse widths don't occur in the package
+    struct load_shed *load_shed; ///< skips the fallback and flex decoders over the CPU budget, NULL if off
+    struct decode_pin *decode_pin; ///< the decoders pinned to the package fingerprints, NULL if off
     float low_pass;
     int use_mag_est;
+    int use_fused_demod; ///< single pass AM and FM demod
     int detect_verbosity;
 
-    int16_t am_buf[MAXIMAL_BUF_LENGTH];  // AM demodulated signal (for OOK decoding)
+    int16_t *am_buf;  // AM demodulated signal (for OOK decoding)
     union {
-        // These buffers aren't used at the same time, so let's use a union to save some memory
-        int16_t fm[MAXIMAL_BUF_LENGTH];  // FM demodulated signal (for FSK decoding)
-        uint16_t temp[MAXIMAL_BUF_LENGTH];  // Temporary buffer (to be optimized out..)
+        int16_t *fm;  // FM demodulated signal (for FSK decoding)
     } buf;
-    uint8_t u8_buf[MAXIMAL_BUF_LENGTH]; // format conversion buffer
-    float f32_buf[MAXIMAL_BUF_LENGTH]; // format conversion buffer
+    unsigned buf_samples; ///< capacity of the sample buffers, see r_demod_reserve()
+    int lock_buffers; ///< lock the sample buffers into RAM when allocated
+    uint8_t *u8_buf; ///< logic state buffer, allocated by r_demod_reserve() if there is a logic dumper
+    unsigned u8_dirty[2]; ///< range of u8_buf painted with packages, the rest of the buffer is clear
+    uint8_t *dump_buf[DUMP_CONVERSIONS]; ///< conversion buffer of each dumper format, allocated by r_demod_reserve() if the format is dumped
     int sample_size; // CU8: 2, CS16: 4
     pulse_detect_t *pulse_detect;
     filter_state_t lowpass_filter_state;
     demodfm_state_t demod_FM_state;
+    demodfm_lazy_t demod_FM_lazy;
+    int decimation; ///< decimation factor ahead of the demodulators, 0 is off, -1 is auto
+    decimator_state_t decimator;
     int enable_FM_demod;
     unsigned fsk_pulse_detect_mode;
-    unsigned frequency;
+    unsigned frequency; ///< channel frequency when channelizing, 0 for the SDR center frequency
+    uint8_t *channel_buf; ///< decimated samples of this channel, the IQ buffer is shared by all channels
+    unsigned rx_channel; ///< SDR RX channel of the samples with -Y mimo, 0 otherwise
     samp_grab_t *samp_grab;
     am_analyze_t *am_analyze;
     int analyze_pulses;
+    struct pulse_clusters *pulse_clusters; ///< signal shapes of the streaming analyzer, allocated on the first package
     file_info_t load_info;
     list_t dumper;
+    struct dump_writer *dump_writer; ///< writer thread of the dumpers, NULL to write directly
+    list_t gated_iq; ///< writers of the gated dumpers
+    list_t sigmf; ///< writers of the SigMF dumpers
+    sigrok_writer_t *sigrok; ///< writer of the Sigrok channel dumpers, which have no file of their own
 
     /* Protocol states */
     list_t r_devs;
+    decoder_dispatch_t dispatch; ///< r_devs sorted for the hot decode path
+    struct decode_scratch *scratch;        ///< scratch of the decoders run on one thread, allocated on first use
+    struct decode_scratch *stream_scratch; ///< scratch of the streaming decoders, they run on the DSP thread
+    struct decode_scratch *pool_scratch[DECODE_POOL_TASKS]; ///< scratch of each decode pool task
 
     pulse_data_t    pulse_data;
     pulse_data_t    fsk_pulse_data;
     unsigned frame_event_count;
+    int stream_events; ///< events the streaming decoders reported on the current package
     unsigned frame_start_ago;
     unsigned frame_end_ago;
     struct timeval now;
     float sample_file_pos;
+    cpu_stat_t cpu_stages[CPU_STAGE_COUNT]; ///< time in the processing stages of this channel
 };
 
+/// Get the list element of the gated writer of a dumper file, NULL if the dumper is not gated.
+static inline void **find_gated_dumper(struct dm_state *demod, FILE *file)
+{
+    for (void **iter = demod->gated_iq.elems; iter && *iter; ++iter) {
+        if (gated_iq_writer_file(*iter) == file)
+            return iter;
+    }
+    return NULL;
+}
+
+/// Get the SigMF writer of a dumper file, NULL if the dumper is not SigMF.
+static inline sigmf_writer_t *find_sigmf_dumper(struct dm_state *demod, FILE *file)
+{
+    for (void **iter = demod->sigmf.elems; iter && *iter; ++iter) {
+        if (sigmf_writer_file(*iter) == file)
+            return *iter;
+    }
+    return NULL;
+}
+
 #endif /* INCLUDE_R_PRIVATE_H_ */
@@ -158,6 +158,14 @@ bool str_endswith(char const *restrict str, char const *restrict suffix);
 */
 char *str_replace(char const *orig, char const *rep, char const *with);
 
+/** Replace a pattern in a string in place.
+
+    @param str string to search for patterns
+    @param rep the pattern to replace
+    @param with the replacement pattern, must not be longer than @p rep
+*/
+void str_replace_inplace(char *str, char const *rep, char const *with);
+
 /** Make a nice printable string for a frequency.
 
     @param freq the frequency to convert to a string.
@@ -0,0 +1,74 @@
+/** @file
+    Pacing of file inputs to a speed factor of realtime or to a CPU bound.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_REPLAY_PACER_H_
+#define INCLUDE_REPLAY_PACER_H_
+
+#include <stdint.h>
+
+/*
+The pacer keeps absolute deadlines, the input time handed over so far at the
+speed factor is due at the start time plus that time. Time spent processing
+is absorbed by the next wait instead of adding up, a late buffer is not
+waited for but the schedule is kept. With a CPU bound the input is unpaced
+and the pacer sleeps so that the busy time between the waits stays within
+the bound of the elapsed time.
+*/
+
+/// The state of a pacer.
+typedef struct replay_pacer {
+    double speed;      ///< speed factor over realtime, 0 if unpaced
+    unsigned cpu_pct;  ///< bound of the busy time in percent, 0 for none
+    uint64_t start_ns; ///< monotonic time of the start
+    uint64_t wake_ns;  ///< monotonic time of the end of the last wait
+    uint64_t busy_ns;  ///< time spent outside of the waits
+    uint64_t input_ns; ///< input time handed over
+    uint64_t late_ns;  ///< longest time a deadline was missed by
+} replay_pacer_t;
+
+/** Start pacing.
+
+    @param p the pacer
+    @param speed the speed factor over realtime, 0 if unpaced
+    @param cpu_pct the bound of the busy time in percent if unpaced, 0 for none
+*/
+void replay_pacer_start(replay_pacer_t *p, double speed, unsigned cpu_pct);
+
+/** Wait until an input time is due.
+
+    @param p the pacer
+    @param input_ns the input time from the start in ns, the end of the data to hand over
+*/
+void replay_pacer_wait(replay_pacer_t *p, uint64_t input_ns);
+
+/** Wait until the next samples are due.
+
+    @param p the pacer
+    @param n_samples the number of samples to hand over
+    @param sample_rate the sample rate
+*/
+void replay_pacer_advance(replay_pacer_t *p, uint64_t n_samples, uint32_t sample_rate);
+
+/** Get the achieved speed factor.
+
+    @param p the pacer
+    @return the input time handed over by the elapsed time, 0 if none elapsed
+*/
+double replay_pacer_rate(replay_pacer_t const *p);
+
+/** Get the elapsed time.
+
+    @param p the pacer
+    @return the time since the start in seconds
+*/
+double replay_pacer_elapsed(replay_pacer_t const *p);
+
+#endif /* INCLUDE_REPLAY_PACER_H_ */
@@ -14,6 +14,7 @@
 
 #include "pulse_detect.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 /// Check if a given string is in RfRaw format.
 bool rfraw_check(char const *p);
@@ -21,4 +22,16 @@ bool rfraw_check(char const *p);
 /// Decode RfRaw string to pulse data.
 bool rfraw_parse(pulse_data_t *data, char const *p);
 
+/** Encode pulse data as one RfRaw B1 code, e.g. "AAB1...55".
+
+    The widths are grouped in up to 8 timings within 20%, each width is sent as the mean
+    of its timing in us. The code is not terminated with a newline.
+
+    @param data the pulse data
+    @param buf the output buffer, needs 2 chars per pulse and some 40 chars
+    @param size the buffer size
+    @return the length of the code, 0 if there are more than 8 timings or the buffer is too small
+*/
+size_t rfraw_encode(pulse_data_t const *data, char *buf, size_t size);
+
 #endif /* INCLUDE_RFRAW_H_ */
@@ -0,0 +1,91 @@
+/** @file
+    Bounded FIFO queue of fixed-size elements for passing data between threads.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_RING_QUEUE_H_
+#define INCLUDE_RING_QUEUE_H_
+
+#include <stddef.h>
+
+/*
+The queue is a ring under a mutex, not a lock free ring with the atomics of
+compat_atomic.h. It carries a few hundred SDR buffers or outputs a second,
+the consumer sleeps on the condition when it is empty anyway, and the
+consumers pop a batch per wakeup while the producers signal only an empty
+queue, so the lock is taken about once per buffer and is never contended
+for long. The loop thread also pops from the DSP queue when flushing, a
+single consumer ring would not allow that.
+*/
+
+typedef struct ring_queue ring_queue_t;
+
+/// Queue counters, updated by the producers and consumers.
+typedef struct ring_queue_stats {
+    unsigned size;    ///< capacity of the queue in elements
+    unsigned len;     ///< current number of queued elements
+    unsigned len_max; ///< high water mark of queued elements
+    unsigned pushed;  ///< total number of elements queued
+    unsigned dropped; ///< total number of elements rejected because the queue was full
+} ring_queue_stats_t;
+
+/** Create a queue.
+
+    Elements are copied in and out by value, the queue never blocks producers.
+
+    @param size the maximum number of elements to hold
+    @param elem_size the size of one element in bytes
+    @return the new queue, NULL on alloc failure
+*/
+ring_queue_t *ring_queue_create(unsigned size, size_t elem_size);
+
+/** Free a queue, discarding any queued elements.
+
+    @param q the queue, may be NULL
+*/
+void ring_queue_free(ring_queue_t *q);
+
+/** Append an element to the queue, never blocks.
+
+    @param q the queue
+    @param elem the element to copy in
+    @return the number of elements queued before this one, -1 if the queue was full and the element was dropped
+*/
+int ring_queue_push(ring_queue_t *q, void const *elem);
+
+/** Remove the oldest element from the queue.
+
+    @param q the queue
+    @param[out] elem the buffer to copy the element to
+    @param wait if set block until an element is available or the queue is closed
+    @return 0 on success, -1 if the queue is empty (or closed when waiting)
+*/
+int ring_queue_pop(ring_queue_t *q, void *elem, int wait);
+
+/** Discard all queued elements.
+
+    @param q the queue
+    @return the number of elements discarded
+*/
+unsigned ring_queue_clear(ring_queue_t *q);
+
+/** Wake all waiting consumers, subsequent waits return immediately.
+
+    @param q the queue
+*/
+void ring_queue_close(ring_queue_t *q);
+
+/** Get a snapshot of the queue counters.
+
+    @param q the queue
+    @param[out] stats the counters
+*/
+void ring_queue_get_stats(ring_queue_t *q, ring_queue_stats_t *stats);
+
+#endif /* INCLUDE_RING_QUEUE_H_ */
@@ -6,14 +6,20 @@
 #define INCLUDE_RTL_433_H_
 
 #include <stdint.h>
+#include <stdio.h>
 #include "list.h"
+#include "metrics.h"
+#include "stats.h"
 #include <time.h>
 #include <signal.h>
 
 #define DEFAULT_SAMPLE_RATE     250000
 #define DEFAULT_FREQUENCY       433920000
 #define DEFAULT_HOP_TIME        (60*10)
+#define DEFAULT_SETTLE_MS       -1 ///< measure the tuner settle time
 #define DEFAULT_ASYNC_BUF_NUMBER    0 // Force use of default value (librtlsdr default: 15)
+#define DSP_EVENT_QUEUE_SIZE        1024 // Output events queued from the DSP thread to the event loop
+#define DEFAULT_DUMP_ASYNC_MB       32 // Block pool of the async dumper writer in MB
 #define DEFAULT_BUF_LENGTH      (16 * 32 * 512) // librtlsdr default
 #define FSK_PULSE_DETECTOR_LIMIT 800000000
 
@@ -21,12 +27,30 @@
 #define MAXIMAL_BUF_LENGTH      (256 * 16384)
 #define SIGNAL_GRABBER_BUFFER   (12 * DEFAULT_BUF_LENGTH)
 #define MAX_FREQS               32
+#define MEM_BUDGET_MIN_BUF_LENGTH (32 * 512) // Smallest SDR buffer for a memory budget, in bytes
+#define MEM_BUDGET_MIN_BUF_NUMBER 4 // Fewest SDR buffers for a memory budget
+#define LATENCY_QUEUE_MS        1000 // SDR buffers queued for a latency target, in ms of signal
+#define LATENCY_MAX_BUF_NUMBER  64   // Maximum number of SDR buffers for a latency target
+#define DSP_MERGE_BYTES         65536 // Queued SDR buffers are demodulated as one up to this many bytes
+#define LATENCY_HIST_MS         1000 // Latency statistic in 1 ms steps, longer latencies count in the last step
+#define SQUELCH_PRESCAN_STRIDE  16   // Squelch pre-scan level estimate from every n-th sample
+#define SQUELCH_PRESCAN_MARGIN  1.5f // Squelch without demodulating if the pre-scan is this many dB below the squelch level
+#define DEFAULT_DEDUP_MS        1000 // Window of the duplicate suppression in ms
+#define DEDUP_EVENTS            32   // Recent events remembered by the duplicate suppression
 
 #define INPUT_LINE_MAX 8192 /**< enough for a complete textual bitbuffer (25*256) */
 
 struct sdr_dev;
 struct r_device;
 struct mg_mgr;
+struct dsp_thread;
+struct log_ring;
+struct pulse_clusters;
+struct pulse_sender;
+struct event_merge;
+struct decode_farm;
+struct thread_sched;
+struct data_render;
 
 typedef enum {
     CONVERT_NATIVE,
@@ -55,6 +79,7 @@ typedef enum {
     DEVICE_STATE_STARTING,
     DEVICE_STATE_GRACE,
     DEVICE_STATE_STARTED,
+    DEVICE_STATE_SLEEPING, ///< stopped by the duty cycle until the next expected report
 } device_state_t;
 
 typedef struct r_cfg {
@@ -66,10 +91,12 @@ typedef struct r_cfg {
     char *settings_str;
     int ppm_error;
     uint32_t out_block_size;
+    unsigned latency_ms; ///< SDR buffer latency target in ms, 0 to use out_block_size
     char const *test_data;
     list_t in_files;
     char const *in_filename;
-    int in_replay;
+    double in_replay;  ///< replay speed factor over realtime, 0 if not paced
+    int in_replay_cpu; ///< replay as fast as possible with at most this percent CPU time, 0 for no bound
     volatile sig_atomic_t hop_now;
     volatile sig_atomic_t exit_async;
     volatile sig_atomic_t exit_code; ///< 0=no err, 1=params or cmd line err, 2=sdr device read error, 3=usb init error, 5=USB error (reset), other=other error
@@ -79,22 +106,57 @@ typedef struct r_cfg {
     uint32_t center_frequency;
     int fsk_pulse_detect_mode;
     int hop_times;
-    int hop_time[MAX_FREQS];
-    time_t hop_start_time;
+    int hop_time_ms[MAX_FREQS];
+    uint64_t hop_start_pos;  ///< input position where the dwell on the current frequency started
+    int hop_deferred;        ///< the current hop waits for the end of a package
+    int settle_ms;           ///< samples to discard after a retune in ms, -1 to measure the settle time
+    uint32_t settle_freq;    ///< frequency the tuner is settling to, 0 if settled
+    uint64_t settle_samples; ///< samples at the new frequency discarded so far
+    uint64_t settle_target;  ///< samples at the new frequency to discard, 0 while measuring
+    unsigned settle_stable;  ///< number of consecutive level blocks without a step
+    float settle_level;      ///< level of the last block in dB
+    float settle_est;        ///< moving average of the measured settle time in samples
+    int adaptive_hop;        ///< schedule the hops by the activity of the frequencies
+    struct hop_sched *hop_sched; ///< adaptive hop scheduler, NULL for round robin hops
+    struct soft_agc *agc;    ///< software gain control for "-g agc", NULL otherwise
+    uint64_t hop_dwell;      ///< samples to dwell on the current frequency with the adaptive scheduler
+    double band_scan;        ///< time in s a band scan listener stays on a quiet channel, 0 if off
+    struct band_sched *band_sched; ///< band scan shared by the inputs, owned by the first, NULL if off
+    int band_listener;       ///< the listener index of a further input in the band scan, -1 for the scanner
+    int band_active;         ///< the band scan input saw activity since the last dwell or update
+    int fsk_track;           ///< 1 to seed the FSK detectors from the recent offsets, 2 to also correct the ppm
+    unsigned fsk_ppm_packages; ///< FSK packages tracked since the last ppm correction
+    int fsk_ppm_based;       ///< nonzero if the FSK offset base is set
+    double fsk_ppm_base_hz;  ///< FSK offset the ppm correction keeps, the first tracked offset
+    unsigned mem_budget;     ///< memory budget in MB the SDR buffers are sized to, 0 for no budget
+    size_t sdr_buf_bytes;    ///< memory of the SDR sample buffers
     int duration;
     time_t stop_time;
     int after_successful_events_flag;
     uint32_t samp_rate;
     uint64_t input_pos;
+    int64_t buf_time_us; ///< arrival time of the current SDR buffer in us, 0 for file inputs
+    int64_t buf_time_ns; ///< time of the first sample of the current SDR buffer in ns, 0 if unknown
     uint32_t bytes_to_read;
     struct sdr_dev *dev;
     int grab_mode; ///< Signal grabber mode: 0=off, 1=all, 2=unknown, 3=known
     int raw_mode; ///< Raw pulses printing mode: 0=off, 1=all, 2=unknown, 3=known
+    FILE *raw_file; ///< the raw pulses as RfRaw lines instead of events, NULL to output events, see add_rfraw_output()
+    struct pulse_sender *pulse_sender; ///< all packages are sent to a remote decoder, see add_pulse_output()
     int verbosity; ///< 0=normal, 1=verbose, 2=verbose decoders, 3=debug decoders, 4=trace decoding.
+    int output_log_level; ///< the highest log level any output takes, see r_update_log_level()
     int verbose_bits;
     conversion_mode_t conversion_mode;
+    struct key_conversion *key_conversions; ///< unit conversions of the registered fields, indexed by key id
+    unsigned key_conversions_len;
     int report_meta;
     int report_noise;
+    unsigned dedup_ms;                  ///< drop events repeating a recent event within this many ms, 0 to output all
+    uint32_t dedup_hash[DEDUP_EVENTS];  ///< hashes of the recent events, 0 for an unused entry
+    double dedup_time[DEDUP_EVENTS];    ///< input position of the recent events in seconds
+    unsigned dedup_next;                ///< entry to replace with the next new event
+    unsigned merge_ms;                  ///< merge the copies of an event heard by several receivers within this many ms, 0 to output each
+    struct event_merge *event_merge;    ///< the events held for their copies, see expire_merged_events()
     int report_protocol;
     time_mode_t report_time;
     int report_time_hires;
@@ -104,33 +166,105 @@ typedef struct r_cfg {
     int report_stats;
     int stats_interval;
     volatile sig_atomic_t stats_now;
+    volatile sig_atomic_t reload_now; ///< rebuild the decoders from the config files and the command line, see SIGHUP
+    volatile sig_atomic_t trace_now;  ///< write the trace to a file, see SIGUSR2
     time_t stats_time;
     int no_default_devices;
     struct r_device *devices;
     uint16_t num_r_devices;
+    unsigned protocols_changes; ///< counts the changes of the registered decoders, to invalidate cached listings
     list_t data_tags;
     list_t output_handler;
+    struct data_render *output_render; ///< renderings of the record shared by the outputs, owned by the event loop
     list_t raw_handler;
     int has_logout;
     struct dm_state *demod;
+    int channelize; ///< demodulate all frequencies as channels of one capture instead of hopping
+    int mimo; ///< stream an SDR RX channel for each frequency instead of hopping, each is a channel
+    list_t channels; ///< dm_state of each channel, the first is demod, empty unless channelizing
+    struct dm_state *demod_chan; ///< dm_state being demodulated, demod unless channelizing
+    struct worker_pool *channel_pool; ///< worker threads to demodulate the channels, NULL to run on the DSP thread
+    unsigned decode_threads; ///< number of threads to run the decoders of a package on, 0 or 1 for the DSP thread only
+    struct worker_pool *decode_pool; ///< worker threads to run the decoders, NULL to run on the DSP thread
+    unsigned package_queue_len; ///< number of packages detected ahead while one is decoded, 0 to decode each as detected
+    struct package_queue *package_queue; ///< thread to decode the packages detected ahead, NULL to decode on the DSP thread
+    struct package_slot const *package;  ///< the queued package being decoded, NULL while decoding the pulses of demod_chan
+    float package_budget_ms; ///< decoder time of a package after which the fallback and flex decoders are shed, 0 for no limit
+    float second_budget_ms;  ///< decoder time of a second of input after which the fallback and flex decoders are shed, 0 for no limit
+    unsigned quiet_skip;     ///< skip the decoders on a source after this many packages in a row without an event, 0 for never
+    unsigned lag_skip_ms;        ///< skip the quietest SDR buffers while the processing lags the input by more than this, 0 for never
+    struct lag_shed *lag_shed;   ///< the lag and the recent buffer levels, NULL if off
+    char *snippet_dir;           ///< save the IQ snippet of each package to this directory, NULL if off
+    unsigned snippet_mb;         ///< disk space of the IQ snippets in MB
+    unsigned snippet_margin_ms;  ///< samples saved before and after the pulses of a package
+    struct iq_snippet *iq_snippet; ///< the sample ring and the snippet log of the first input, NULL if off
+    unsigned spectrum_bins;      ///< output bins of the spectrum monitor, 0 if off
+    double spectrum_interval;    ///< input time between spectrum snapshots in seconds
+    struct spectrum *spectrum;   ///< the spectrum monitor of the first input, NULL if off
+    double duty_learn;           ///< listen this long before the duty cycle sleeps between the expected reports, 0 if off
+    double duty_margin;          ///< listen at least this long before and after an expected report in seconds
+    struct duty_sched *duty_sched; ///< the duty cycle of the SDR input, NULL if off
+    char *verify_prefix;         ///< compare the optimized paths with the reference paths, reproducers at this path prefix, NULL if off
+    struct verify *verify;       ///< the verifier of the first input, NULL if off
+    unsigned file_threads; ///< number of threads to decode the input files on, each file in a pipeline of its own, 0 or 1 for one after the other
+    list_t *output_capture; ///< collect the output data instead of printing, see flush_output_capture(), NULL to print
+    double output_from; ///< only output the packages starting at this or a later position in seconds into the input file
+    double output_to;   ///< only output the packages starting before this position, equal to output_from to output all
+    struct thread_sched *sched_acquire; ///< scheduling of the acquire thread, NULL for the defaults
+    struct thread_sched *sched_dsp;     ///< scheduling of the DSP thread, NULL for the defaults
+    struct thread_sched *sched_workers; ///< scheduling of the channel and decode worker threads, NULL for the defaults
+    struct thread_sched *sched_output;  ///< scheduling of the async output threads, NULL for the defaults
+    int lock_buffers;                   ///< lock the sample buffers and the demod state into RAM
+    unsigned dump_async; ///< size of the block pool of the async dumper writer in MB, 0 to write the dumpers directly
+    int dump_flags;      ///< DUMP_WRITER_DIRECT and DUMP_WRITER_DONTNEED for the async dumper writer
+    int adaptive_order;        ///< 0: list order, 1: run the decoders by recent hits, 2: also stop at exclusive decodes
+    list_t adaptive_devs;      ///< the decoders by modulation class, priority, and recent hits, empty to rebuild
+    unsigned adaptive_num_ook; ///< the first adaptive_num_ook of adaptive_devs are OOK decoders, the rest FSK
+    unsigned adaptive_packages; ///< packages since the last decay of the hit scores
+    unsigned decode_memo_ms;   ///< reuse the decodes of repeated bits within this many ms, 0 to always decode
+    int pin_mode;              ///< 0: off, 1: run the decoder pinned to a package fingerprint first, 2: also drop other sensors
+    list_t pin_sensors;        ///< "<model>:<id>" of the pinned sensors, empty to pin any decoder
+    list_t farm_workers;       ///< "host:port" of the decode workers of the -r udp:// packages, empty to decode here
+    list_t flex_cache;         ///< the parsed -X specs, see register_flex_protocol()
+    unsigned flex_cache_gen;   ///< count of reloads, the cached specs not registered in the last one are dropped
+    struct decode_farm *decode_farm; ///< the coordinator of the decode workers, NULL if off
+    int calibrate;             ///< 0: use a cached choice or measure for a live input, 1: always measure, -1: off
+    char *calibration_path;    ///< the cache of the calibration, NULL for the default
+    int calibration_source;    ///< where the kernel choice came from, see calibration_source in calibrate.h
     char const *sr_filename;
     int sr_execopen;
     int watchdog; ///< SDR acquire stall watchdog
     /* global stats */
     time_t running_since;           ///< program start time statistic
-    unsigned total_frames_count;    ///< total frames recieved statistic
-    unsigned total_frames_squelch;  ///< total frames with noise only statistic
-    unsigned total_frames_ook;      ///< total frames with ook demod statistic
-    unsigned total_frames_fsk;      ///< total frames with fsk demod statistic
-    unsigned total_frames_events;   ///< total frames with decoder events statistic
+    metrics_hist_t hist_rssi;       ///< RSSI of the events in dB statistic
+    metrics_hist_t hist_snr;        ///< SNR of the events in dB statistic
+    metrics_hist_t hist_latency;    ///< radio to output latency of the events in seconds statistic
     /* sdr stats */
     time_t sdr_since; ///< time of last SDR connect statistic
     /* per report interval stats */
     time_t frames_since;    ///< time at start of report interval statistic
-    unsigned frames_ook;    ///< counter of ook demods for report interval statistic
-    unsigned frames_fsk;    ///< counter of fsk demods for report interval statistic
-    unsigned frames_events; ///< counter of decoder events for report interval statistic
+    input_stats_t stats_base; ///< the counters at the start of the report interval statistic
+    unsigned latency_hist[LATENCY_HIST_MS + 1]; ///< counter of radio to output latencies in ms for report interval statistic
+    unsigned sched_late_max_us; ///< largest arrival delay of an SDR buffer beyond its duration for report interval statistic
+    unsigned sched_wait_max_us; ///< largest wait of an SDR buffer from arrival to processing for report interval statistic
+    int64_t sched_last_us;      ///< arrival of the last SDR buffer, 0 after a start, processing thread only
+    unsigned sched_lag_us;      ///< lag of the processing behind the input at the last SDR buffer, with -Y lag_skip only
+    unsigned sched_lag_max_us;  ///< largest lag of the processing behind the input for report interval statistic
+    uint64_t acquire_dropped; ///< samples dropped on the acquire thread not yet passed on, acquire thread only
+    unsigned char *merge_buf; ///< queued SDR buffers merged into one, DSP thread only
+    size_t merge_size;        ///< size of merge_buf
+    unsigned char stats_pad0[STATS_CACHE_LINE];
+    input_stats_t stats; ///< the counters, never reset, written by the thread processing the input, see stats.h
+    unsigned char stats_pad1[STATS_CACHE_LINE];
     struct mg_mgr *mgr;
+    struct dsp_thread *dsp_thread; ///< DSP worker thread for live inputs, NULL if demod runs on the event loop
+    struct log_ring *log_ring; ///< log messages of the other threads for the event loop, NULL to log synchronously
+    unsigned log_ring_dropped; ///< log messages dropped on a full ring and reported, event loop only
+    int discover;              ///< cluster the packages no decoder takes, see pulse_clusters_create()
+    struct pulse_clusters *discovery; ///< signal shapes of the undecoded packages, shared by all inputs, NULL if off
+    char const *input_name; ///< tag on the events of this input, NULL unless there are further inputs
+    list_t inputs;          ///< further inputs, each a clone of this cfg with its own device, demod, and DSP thread
+    struct r_cfg *parent;   ///< cfg owning the outputs of this further input, NULL for the first input
 } r_cfg_t;
 
 #endif /* INCLUDE_RTL_433_H_ */
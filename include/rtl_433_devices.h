@@ -278,4 +278,9 @@
 DEVICES
 #undef DECL
 
+#ifdef RTL433_DECODERS_SUBSET
+// the decoders chosen with the RTL433_DECODERS build option, generated by CMake
+#include "rtl_433_devices_subset.h"
+#endif
+
 #endif /* INCLUDE_RTL_433_DEVICES_H_ */
@@ -0,0 +1,49 @@
+/** @file
+    Compressed stream extension of the rtl_tcp protocol.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_RTLTCP_COMPRESS_H_
+#define INCLUDE_RTLTCP_COMPRESS_H_
+
+/*
+A client asks for the extension with the command RTLTCP_SET_COMPRESSION and
+the wanted RTLTCP_COMPRESS_* flags as parameter. Other servers ignore the
+command and keep sending plain I/Q data.
+
+A server that accepts finishes the current frame, then sends the sync: the
+RTLTCP_SYNC_MAGIC bytes and the accepted flags as 32-bit big endian. From
+then on the stream is a sequence of chunks, each with a header of the type
+byte, three zero bytes, the number of samples and the payload length, both
+32-bit big endian:
+- RTLTCP_CHUNK_RAW: the payload is plain CU8 data
+- RTLTCP_CHUNK_CODED: the payload is CU8 data coded with iq_codec_encode()
+- RTLTCP_CHUNK_SKIP: no payload, the samples were left out as silent
+
+Data chunks hold at most RTLTCP_CHUNK_SAMPLES samples.
+*/
+
+#define RTLTCP_SET_COMPRESSION 0x40
+
+#define RTLTCP_COMPRESS_LOSSLESS 0x01 ///< code the data chunks losslessly
+#define RTLTCP_COMPRESS_SQUELCH 0x02  ///< skip silent frames
+
+/// Sync sequence, the first byte does not repeat which keeps the search simple.
+#define RTLTCP_SYNC_MAGIC {'R', 'T', 'L', 'Z', 0xa5, 0x5a, 0xc3, 0x3c, 0x96, 0x69, 0x0f, 0xf0}
+#define RTLTCP_SYNC_MAGIC_LEN 12
+#define RTLTCP_SYNC_LEN (RTLTCP_SYNC_MAGIC_LEN + 4)
+
+#define RTLTCP_CHUNK_RAW 0
+#define RTLTCP_CHUNK_CODED 1
+#define RTLTCP_CHUNK_SKIP 2
+
+#define RTLTCP_CHUNK_HEADER_LEN 12
+#define RTLTCP_CHUNK_SAMPLES 16384
+
+#endif /* INCLUDE_RTLTCP_COMPRESS_H_ */
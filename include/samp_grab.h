@@ -14,6 +14,8 @@
 
 #include <stdint.h>
 
+#define SAMP_GRAB_QUEUE 8 ///< grabs waiting for the writer thread, further grabs are dropped
+
 typedef struct samp_grab {
     uint32_t *frequency;
     uint32_t *samp_rate;
@@ -24,6 +26,8 @@ typedef struct samp_grab {
     unsigned sg_size;
     unsigned sg_index;
     unsigned sg_len;
+
+    struct samp_grab_thread *thread; ///< the writer thread, NULL to write synchronously
 } samp_grab_t;
 
 samp_grab_t *samp_grab_create(unsigned size);
@@ -35,6 +39,7 @@ void samp_grab_push(samp_grab_t *g, unsigned char *iq_buf, uint32_t len);
 void samp_grab_reset(samp_grab_t *g);
 
 /// grab_end is counted in samples from end of buf.
+/// The signal is copied and written to the next free g%03u file, from the writer thread if there is one.
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end);
 
 #endif /* INCLUDE_SAMP_GRAB_H_ */
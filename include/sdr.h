@@ -16,9 +16,12 @@
 
 #define SDR_DEFAULT_BUF_NUMBER 15
 #define SDR_DEFAULT_BUF_LENGTH 0x40000
+#define SDR_RX_CHANNELS_MAX 8 ///< RX channels streamed at once
 
 typedef struct sdr_dev sdr_dev_t;
 
+struct thread_sched;
+
 typedef enum sdr_event_flags {
     SDR_EV_EMPTY = 0,
     SDR_EV_DATA = 1 << 0,
@@ -26,8 +29,13 @@ typedef enum sdr_event_flags {
     SDR_EV_CORR = 1 << 2,
     SDR_EV_FREQ = 1 << 3,
     SDR_EV_GAIN = 1 << 4,
+    SDR_EV_RETRY = 1 << 5, ///< the input lost the connection and is trying to reconnect
+    SDR_EV_SKIP = 1 << 6,  ///< the source left out silent samples, the count is in skipped
 } sdr_event_flags_t;
 
+/// The event flags of the settings sdr_control() applies.
+#define SDR_CTL_FLAGS (SDR_EV_RATE | SDR_EV_CORR | SDR_EV_FREQ | SDR_EV_GAIN)
+
 typedef struct sdr_event {
     sdr_event_flags_t ev;
     uint32_t sample_rate;
@@ -36,10 +44,28 @@ typedef struct sdr_event {
     char const *gain_str;
     void *buf;
     int len;
+    int64_t time_us; ///< arrival time in us, stamped when the event is received, 0 if unknown
+    int64_t time_ns; ///< time of the first sample in ns, from the hardware if available, otherwise estimated, 0 if unknown
+    uint64_t dropped; ///< number of samples lost right before this buffer, detected or estimated
+    uint64_t skipped; ///< number of samples left out as silent, with SDR_EV_SKIP
+    sdr_dev_t *lease; ///< device that leased the buffer, release with sdr_release(), NULL if not leased
+    unsigned rx_channels; ///< RX channels in buf, len bytes each one after the other, 0 or 1 for one
 } sdr_event_t;
 
 typedef void (*sdr_event_cb_t)(sdr_event_t *ev, void *ctx);
 
+/// Connection statistics of a network input, all but connects are for the current connection.
+typedef struct sdr_stats {
+    unsigned connects;   ///< number of successful connects, including the first one
+    uint64_t bytes;      ///< bytes received
+    uint64_t iq_bytes;   ///< I/Q data bytes carried, more than received with compression
+    unsigned rate_kbps;  ///< average throughput in kbit/s
+    unsigned gap_max_ms; ///< longest wait for data
+    unsigned jitter_us;  ///< interarrival jitter of the buffers, as in RFC 3550
+    unsigned lag_ms;     ///< arrival delay of the last buffer behind the sample clock
+    unsigned lag_max_ms; ///< largest arrival delay of a buffer behind the sample clock
+} sdr_stats_t;
+
 /** Find the closest matching device, optionally report status.
 
     @param out_dev device output returned
@@ -67,6 +93,14 @@ int sdr_close(sdr_dev_t *dev);
 */
 char const *sdr_get_dev_info(sdr_dev_t *dev);
 
+/** Get the connection statistics of a network input.
+
+    @param dev the device handle
+    @param[out] stats the statistics
+    @return 0 on success, -1 if the input has no connection statistics
+*/
+int sdr_get_stats(sdr_dev_t *dev, sdr_stats_t *stats);
+
 /** Get sample size.
 
     @param dev the device handle
@@ -97,6 +131,31 @@ int sdr_set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose);
 */
 uint32_t sdr_get_center_freq(sdr_dev_t *dev);
 
+/** Stream several RX channels of the device at once, SoapySDR only.
+
+    Call right after sdr_open(), the sample rate, gain, and frequency
+    correction then apply to each channel. The data events carry the
+    buffer of each channel, see sdr_event_t::rx_channels.
+
+    @param dev the device handle
+    @param num number of RX channels, from channel 0 on
+    @param verbose the verbosity level for reports to stderr
+    @return 0 on success
+*/
+int sdr_set_rx_channels(sdr_dev_t *dev, unsigned num, int verbose);
+
+/** Set the frequency of an RX channel, optionally report status.
+
+    Channel 0 is the center frequency, see sdr_set_center_freq().
+
+    @param dev the device handle
+    @param channel the RX channel
+    @param freq in Hz
+    @param verbose the verbosity level for reports to stderr
+    @return 0 on success
+*/
+int sdr_set_channel_freq(sdr_dev_t *dev, unsigned channel, uint32_t freq, int verbose);
+
 /** Set the frequency correction value for the device, optionally report status.
 
     @param dev the device handle
@@ -157,6 +216,24 @@ uint32_t sdr_get_sample_rate(sdr_dev_t *dev);
 */
 int sdr_apply_settings(sdr_dev_t *dev, char const *sdr_settings, int verbose);
 
+/** Change settings while the input streams, never waits for the device.
+
+    The settings are queued to the control thread which applies them between
+    the buffers, a newer setting replaces a queued one of the same kind.
+    Once applied the acquire thread reports the reported settings in an event
+    of their SDR_EV_RATE, SDR_EV_CORR, SDR_EV_FREQ, or SDR_EV_GAIN flags ahead
+    of the next buffer. Without a running input the settings are applied
+    right away and not reported.
+
+    @param dev the device handle
+    @param cmd the flags of the settings to change, and their sample_rate,
+               freq_correction, center_frequency, or gain_str, NULL for auto gain
+    @param verbose the verbosity level for reports to stderr
+    @param report report the settings once applied
+    @return 0 on success
+*/
+int sdr_control(sdr_dev_t *dev, sdr_event_t const *cmd, int verbose, int report);
+
 /** Activate stream (only needed for SoapySDR).
 
     @param dev the device handle
@@ -179,6 +256,44 @@ int sdr_deactivate(sdr_dev_t *dev);
 */
 int sdr_reset(sdr_dev_t *dev, int verbose);
 
+/** Enable buffer leases, call before sdr_start().
+
+    With leases the RTL-SDR hands out the USB transfer buffers without a copy,
+    as does SoapySDR with the DMA buffers of a driver with direct buffer access
+    if the samples need no conversion. Each leased data event must then be
+    released with sdr_release() once the buffer is no longer used. The acquire
+    thread never waits for a release: at most half the USB transfers or DMA
+    buffers are leased, further buffers are copied into the ring as without
+    leases. A leased USB buffer stays valid as long as a copy in the ring, a
+    DMA buffer goes back to the driver once its frames are released.
+    Release from another thread, sdr_stop() waits for all leases.
+    Without leases every buffer is copied and stays valid until sdr_close().
+    Other inputs never lease their buffers.
+
+    @param dev the device handle
+    @param enable 1 to lease buffers, 0 to copy them
+*/
+void sdr_lease_buffers(sdr_dev_t *dev, int enable);
+
+/** Set the scheduling of the acquire thread and lock the sample buffers.
+
+    Call before sdr_start(), failures only log a warning.
+    Leased buffers are not locked, the kernel pins the RTL-SDR USB buffers, the driver the SoapySDR DMA buffers.
+
+    @param dev the device handle
+    @param sched the scheduling settings of the acquire thread, may be NULL
+    @param lock_buffers 1 to lock the sample buffers into RAM
+*/
+void sdr_set_sched(sdr_dev_t *dev, struct thread_sched const *sched, int lock_buffers);
+
+/** Release the buffer lease of a data event, does nothing if the buffer is not leased.
+
+    The buffer must not be used after this.
+
+    @param ev the event, the lease is cleared
+*/
+void sdr_release(sdr_event_t *ev);
+
 /** Start the SDR data acquisition.
 
     @note
@@ -198,7 +313,8 @@ int sdr_start_sync(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_nu
 /** Stop the SDR data acquisition.
 
     @note
-    All previous sdr_event_t buffers will remain valid until sdr_close().
+    All previous sdr_event_t buffers will remain valid until sdr_close(),
+    except for leased buffers, see sdr_lease_buffers().
 
     @param dev the device handle
     @return 0 on success
@@ -0,0 +1,110 @@
+/** @file
+    Table of the last event of each sensor, with LRU eviction.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SENSOR_TABLE_H_
+#define INCLUDE_SENSOR_TABLE_H_
+
+#include "data.h"
+
+#include <stdint.h>
+
+/*
+The sensors are told apart by the model, id, and channel (data_sensor_key()).
+The entries are a fixed pool allocated upfront, hashed into chained buckets
+and linked in the order they were last heard. A new sensor in a full table
+takes the entry of the sensor heard least recently. Entries never move, the
+entry index is a stable cursor to page through the table while it changes:
+a page may miss the sensors added or show the sensors updated meanwhile.
+*/
+
+#define SENSOR_TABLE_DEFAULT 256   ///< sensors in a table if not given
+#define SENSOR_TABLE_PAGE_MAX 1000 ///< most sensors on a page
+
+/// The last event of a sensor.
+typedef struct sensor_entry {
+    uint32_t key;        ///< the sensor hash, 0 if the entry is unused
+    unsigned hash_next;  ///< index + 1 of the next entry in the bucket, 0 for none
+    unsigned lru_prev;   ///< index + 1 of the entry heard next more recently, 0 for none
+    unsigned lru_next;   ///< index + 1 of the entry heard next less recently, 0 for none
+    unsigned count;      ///< events of the sensor since it was added
+    int has_rssi;
+    double rssi;         ///< the rssi of the last event, if has_rssi
+    double first_seen;   ///< the time in s the sensor was added
+    double last_seen;    ///< the time in s of the last event
+    data_t *data;        ///< the last event, retained
+} sensor_entry_t;
+
+typedef struct sensor_table {
+    unsigned capacity;
+    unsigned len;        ///< entries used, the first len of the pool
+    unsigned mask;       ///< buckets - 1, a power of two
+    unsigned *buckets;   ///< index + 1 of the first entry in each bucket
+    sensor_entry_t *entries;
+    unsigned lru_first;  ///< index + 1 of the entry heard most recently
+    unsigned lru_last;   ///< index + 1 of the entry heard least recently
+    unsigned updates;    ///< events added
+    unsigned evicted;    ///< sensors evicted from a full table
+} sensor_table_t;
+
+/** Allocate the entries of a table.
+
+    @param table the table to set up
+    @param capacity the number of sensors, at least 1
+    @return 0 on success, -1 on alloc failure
+*/
+int sensor_table_init(sensor_table_t *table, unsigned capacity);
+
+/// Release the events and entries of a table.
+void sensor_table_free(sensor_table_t *table);
+
+/** Add an event as the last event of its sensor.
+
+    @param table the table
+    @param data the event, retained by the table
+    @param now the time in s
+    @param[out] evicted the last event of a sensor evicted to make room, the caller frees it, may be NULL
+    @return the entry of the sensor, NULL for the records without a model
+*/
+sensor_entry_t const *sensor_table_update(sensor_table_t *table, data_t *data, double now, data_t **evicted);
+
+/// Returns the entry of a sensor key, NULL if not in the table.
+sensor_entry_t const *sensor_table_find(sensor_table_t const *table, uint32_t key);
+
+/// Returns a record of an entry: the "last_seen" and "first_seen" time in whole s, "count", "rssi", and the "event".
+data_t *sensor_entry_data(sensor_entry_t const *entry);
+
+/** Returns the fields of an event that changed since the last event of its sensor.
+
+    The record has the model, id, channel, and time of the event, the fields
+    that are new or have a new value, and "delta":1. The fields a projection
+    skips are neither compared nor added.
+
+    @param entry the entry of the sensor, before the event is added
+    @param data the event
+    @param skip the fields to skip, NULL for all fields
+    @return the record, NULL if the whole event has to be sent: the entry has no event,
+            a field of the last event is gone, a field is nested, or on alloc failure
+*/
+data_t *sensor_entry_delta(sensor_entry_t const *entry, data_t const *data, data_skip_t const *skip);
+
+/** Returns a page of the table as a record.
+
+    The record has the "total" sensors in the table, the "count" on the page, the "sensors"
+    array of entry records, and the "next" cursor if more entries follow.
+
+    @param table the table
+    @param cursor the entry index to start at, 0 for the first page
+    @param limit the most entries on the page, at most SENSOR_TABLE_PAGE_MAX
+    @return the record, NULL on alloc failure
+*/
+data_t *sensor_table_page(sensor_table_t const *table, unsigned cursor, unsigned limit);
+
+#endif /* INCLUDE_SENSOR_TABLE_H_ */
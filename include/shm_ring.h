@@ -0,0 +1,119 @@
+/** @file
+    Ring of records in POSIX shared memory, one writer and any number of readers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SHM_RING_H_
+#define INCLUDE_SHM_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+The shared memory object holds a header and a data area of a power of two
+bytes. Positions count the bytes written since the ring was created, the
+data offset of a position is the position modulo the data size. A record is
+a 16 byte record header (sequence number, length) and the payload, padded
+to 8 bytes, and may wrap around the end of the data area.
+
+The writer never waits for the readers, it overwrites the oldest records.
+Before writing a record it moves `reserve` to the end of the record, after
+writing it moves `head` there. A reader copies the record at its position
+and then checks `reserve` to see if the record was overwritten meanwhile,
+no locks are taken on either side. A reader that falls a ring behind loses
+records, the sequence numbers of the records it reads then have a gap.
+
+The readers poll, there is no wake up. shm_ring.c only needs libc, copy it
+with this header to read a ring in other programs.
+*/
+
+#define SHM_RING_MAGIC   0x33333452 ///< "R433" in little endian
+#define SHM_RING_VERSION 1
+
+/// Formats of the records, as set by the writer.
+enum shm_ring_format {
+    SHM_RING_JSON = 1, ///< one compact JSON object per record, without a newline
+    SHM_RING_CBOR = 2, ///< one CBOR map per record
+};
+
+/// The shared header, at the start of the object.
+typedef struct shm_ring_header {
+    uint32_t magic;       ///< SHM_RING_MAGIC once the ring is ready
+    uint32_t version;     ///< SHM_RING_VERSION
+    uint32_t format;      ///< one of shm_ring_format
+    uint32_t header_size; ///< offset of the data area
+    uint64_t size;        ///< size of the data area, a power of two
+    uint64_t reserve;     ///< end position of the record being written
+    uint64_t head;        ///< end position of the last complete record
+    uint64_t seq;         ///< sequence number of the last complete record, the first is 1
+    uint32_t closed;      ///< nonzero once the writer closed the ring
+    uint32_t pad;
+    uint64_t pad2;        ///< to 64 bytes
+} shm_ring_header_t;
+
+/// Reader results besides a record length.
+enum shm_ring_result {
+    SHM_RING_EMPTY   = 0,  ///< no new record
+    SHM_RING_OVERRUN = -1, ///< records were lost, the reader continues at the newest record
+    SHM_RING_CLOSED  = -2, ///< the writer closed the ring, reopen it to follow a new writer
+    SHM_RING_SHORT   = -3, ///< the buffer is too small for the record, it is skipped
+};
+
+typedef struct shm_ring_writer shm_ring_writer_t;
+
+/** Create a ring, replacing an existing object of that name.
+
+    @param name the object name, e.g. "/rtl_433", a leading "/" is added if missing
+    @param size the data size in bytes, rounded up to a power of two
+    @param format the record format, one of shm_ring_format
+    @return the writer, NULL on error
+*/
+shm_ring_writer_t *shm_ring_writer_create(char const *name, size_t size, int format);
+
+/** Write a record, never blocks.
+
+    @param writer the writer
+    @param buf the payload
+    @param len the payload length, at most a quarter of the data size
+    @return the sequence number of the record, 0 if it is too long
+*/
+uint64_t shm_ring_write(shm_ring_writer_t *writer, void const *buf, size_t len);
+
+/// Mark the ring closed and remove the object name, the readers keep their mapping.
+void shm_ring_writer_free(shm_ring_writer_t *writer);
+
+typedef struct shm_ring_reader shm_ring_reader_t;
+
+/** Open a ring for reading, the reader gets the records written after it opened.
+
+    @param name the object name, a leading "/" is added if missing
+    @return the reader, NULL if there is no ready ring of that name
+*/
+shm_ring_reader_t *shm_ring_reader_open(char const *name);
+
+/** Read the next record.
+
+    @param reader the reader
+    @param buf the buffer for the payload
+    @param size the buffer size
+    @param[out] seq the sequence number of the record, may be NULL
+    @return the payload length, or one of shm_ring_result
+*/
+long shm_ring_read(shm_ring_reader_t *reader, void *buf, size_t size, uint64_t *seq);
+
+/// The record format of the ring, one of shm_ring_format.
+int shm_ring_reader_format(shm_ring_reader_t const *reader);
+
+/// The number of records lost to overruns.
+uint64_t shm_ring_reader_lost(shm_ring_reader_t const *reader);
+
+/// Close a reader.
+void shm_ring_reader_close(shm_ring_reader_t *reader);
+
+#endif /* INCLUDE_SHM_RING_H_ */
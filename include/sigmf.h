@@ -0,0 +1,151 @@
+/** @file
+    SigMF recordings, a JSON metadata file next to the raw samples.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SIGMF_H_
+#define INCLUDE_SIGMF_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+A SigMF dataset is a "<base>.sigmf-data" file with the raw samples and a
+"<base>.sigmf-meta" file with the global parameters, the captures (a new one
+on each change of the center frequency), and the annotations of the decoded
+packages. The data file is a plain sample file which can be mapped.
+
+The writer rewrites the metadata every SIGMF_META_INTERVAL_S seconds while the
+data is recorded and once more when finished, always to a temporary file which
+is then renamed, so a reader never sees a partial metadata file.
+*/
+
+#define SIGMF_META_INTERVAL_S 10 ///< seconds between the metadata updates of a recording
+#define SIGMF_LABEL_MAX       128 ///< length of the label of an annotation
+
+/// The parameters of a SigMF dataset.
+typedef struct sigmf_info {
+    int format;                ///< CU8_IQ, CS8_IQ, CS16_IQ, or CF32_IQ
+    uint32_t sample_rate;      ///< sample rate in Hz
+    uint32_t center_frequency; ///< center frequency of the first capture in Hz, 0 if unknown
+    char *data_path;           ///< path of the data file, free() this
+} sigmf_info_t;
+
+typedef struct sigmf_writer sigmf_writer_t;
+
+/** Get the path of the metadata file of a dataset.
+
+    @param path the path of the metadata or the data file, or the base with ".sigmf"
+    @return the path of the metadata file, free() this, NULL on alloc failure
+*/
+char *sigmf_meta_path(char const *path);
+
+/** Get the path of the data file of a dataset.
+
+    @param path the path of the metadata or the data file, or the base with ".sigmf"
+    @return the path of the data file, free() this, NULL on alloc failure
+*/
+char *sigmf_data_path(char const *path);
+
+/** Get the SigMF datatype of a sample format.
+
+    @param format CU8_IQ, CS8_IQ, CS16_IQ, or CF32_IQ
+    @return the datatype, NULL if the format is not supported
+*/
+char const *sigmf_datatype(int format);
+
+/** Read the metadata of a dataset.
+
+    @param path the path of the metadata or the data file
+    @param[out] info the parameters of the dataset
+    @return 0 on success, -1 on error
+*/
+int sigmf_read_meta(char const *path, sigmf_info_t *info);
+
+/** Start the metadata of a recording, the data file is written by the caller.
+
+    @param path the dataset path, see sigmf_meta_path()
+    @param format the sample format of the data file, CU8_IQ, CS8_IQ, CS16_IQ, or CF32_IQ
+    @param recorder the name of the recording program
+    @return the writer or NULL on error
+*/
+sigmf_writer_t *sigmf_writer_create(char const *path, int format, char const *recorder);
+
+/** Get the path of the data file of a recording.
+
+    @param w the writer
+    @return the path of the data file
+*/
+char const *sigmf_writer_data_path(sigmf_writer_t const *w);
+
+/** Set the data file of a recording, to find the writer of a dumper.
+
+    @param w the writer
+    @param file the data file
+*/
+void sigmf_writer_set_file(sigmf_writer_t *w, FILE *file);
+
+/** Get the data file of a recording.
+
+    @param w the writer
+    @return the data file, NULL if not set
+*/
+FILE *sigmf_writer_file(sigmf_writer_t const *w);
+
+/** Count the samples written to the data file, starts a capture if the frequency changed.
+
+    @param w the writer
+    @param n_samples the number of samples written
+    @param sample_rate the sample rate of the samples
+    @param center_frequency the center frequency of the samples
+    @param time_us the time of the first sample in us since the epoch, 0 if unknown
+*/
+void sigmf_writer_samples(sigmf_writer_t *w, uint64_t n_samples, uint32_t sample_rate, uint32_t center_frequency, int64_t time_us);
+
+/** Get the number of samples written to the data file.
+
+    @param w the writer
+    @return the number of samples counted with sigmf_writer_samples()
+*/
+uint64_t sigmf_writer_position(sigmf_writer_t const *w);
+
+/** Add a label to the next annotation, e.g. the model of each event of a package.
+
+    Repeated labels are added only once.
+
+    @param w the writer
+    @param label the label
+*/
+void sigmf_writer_label(sigmf_writer_t *w, char const *label);
+
+/** Annotate a package with the labels added since the last annotation.
+
+    @param w the writer
+    @param sample_start the first sample of the package in the data file
+    @param sample_count the number of samples of the package
+    @param freq_lower the lower frequency edge in Hz, 0 if unknown
+    @param freq_upper the upper frequency edge in Hz, 0 if unknown
+    @param comment a comment, may be NULL
+*/
+void sigmf_writer_annotate(sigmf_writer_t *w, uint64_t sample_start, uint64_t sample_count, double freq_lower, double freq_upper, char const *comment);
+
+/** Write the metadata of a recording.
+
+    @param w the writer
+    @return 0 on success, -1 on error
+*/
+int sigmf_writer_finish(sigmf_writer_t *w);
+
+/** Free a writer.
+
+    @param w the writer, may be NULL
+*/
+void sigmf_writer_free(sigmf_writer_t *w);
+
+#endif /* INCLUDE_SIGMF_H_ */
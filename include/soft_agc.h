@@ -0,0 +1,94 @@
+/** @file
+    Software gain control from the statistics of the raw samples.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SOFT_AGC_H_
+#define INCLUDE_SOFT_AGC_H_
+
+#include "baseband.h"
+
+#include <stdint.h>
+
+/*
+The control looks at the amplitude statistics of the raw samples over a
+window of half a second. If more than SOFT_AGC_CLIP_LIMIT of the samples
+clip the gain is lowered one step. If nothing clips and the strongest 0.1%
+of the samples stay SOFT_AGC_HEADROOM_DB below full scale the gain is raised
+one step. Between the two is a dead band of more than a step, a raise can't
+cause the next lower. After a change the statistics are discarded for a
+hold time while the tuner settles. The gain only changes between packages,
+a window ending in a package waits for the package to end.
+*/
+
+#define SOFT_AGC_STEP_DB     3.0f  ///< gain change per step
+#define SOFT_AGC_CLIP_LIMIT  1e-4f ///< ratio of clipped samples to lower the gain
+#define SOFT_AGC_HEADROOM_DB 18    ///< headroom of the strongest samples to raise the gain, a multiple of 6 dB
+#define SOFT_AGC_STRIDE      16    ///< samples to skip between the counted samples
+#define SOFT_AGC_DEFAULT_DB  20.0f ///< start gain for "agc" without a gain
+#define SOFT_AGC_MIN_DB      1.0f  ///< lowest tuner gain, "0" would select the tuner auto gain
+#define SOFT_AGC_MAX_DB      49.6f ///< highest tuner gain, the top R820T gain step
+
+typedef struct soft_agc soft_agc_t;
+
+/// Statistics of the control.
+typedef struct soft_agc_stats {
+    float gain_db;      ///< current gain
+    float clip_ratio;   ///< ratio of clipped samples in the last window
+    float peak_dbfs;    ///< upper bound of the strongest 0.1% of samples in the last window
+    unsigned raised;    ///< gain raises
+    unsigned lowered;   ///< gain lowers
+    unsigned windows;   ///< windows evaluated
+} soft_agc_stats_t;
+
+/** Parse a gain option for the software gain control.
+
+    @param gain_str the gain option, "agc" or "agc=<start gain dB>"
+    @param[out] gain the start gain, unchanged for "agc"
+    @return 1 if the option selects the software gain control, 0 otherwise
+*/
+int soft_agc_parse(char const *gain_str, float *gain);
+
+/** Create a gain control.
+
+    @param gain start gain in dB
+    @param min_gain lowest gain in dB
+    @param max_gain highest gain in dB
+    @param sample_rate the sample rate, the window and hold time are in samples
+    @return the gain control or NULL on alloc failure
+*/
+soft_agc_t *soft_agc_create(float gain, float min_gain, float max_gain, uint32_t sample_rate);
+
+/** Free a gain control.
+
+    @param agc the gain control, may be NULL
+*/
+void soft_agc_free(soft_agc_t *agc);
+
+/** Add the statistics of a buffer and decide on a gain change.
+
+    @param agc the gain control
+    @param stats the amplitude statistics of the buffer
+    @param n_samples the number of samples in the buffer
+    @param in_package nonzero if a package is in progress, the gain then stays
+    @return 1 if the gain changed, 0 otherwise
+*/
+int soft_agc_update(soft_agc_t *agc, iq_stats_t const *stats, uint32_t n_samples, int in_package);
+
+/// The current gain in dB.
+float soft_agc_gain(soft_agc_t const *agc);
+
+/** Get the statistics of a gain control.
+
+    @param agc the gain control
+    @param[out] stats the statistics
+*/
+void soft_agc_get_stats(soft_agc_t const *agc, soft_agc_stats_t *stats);
+
+#endif /* INCLUDE_SOFT_AGC_H_ */
@@ -0,0 +1,90 @@
+/** @file
+    Spectrum monitor, an averaged FFT of one SDR buffer per interval on a thread of its own.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SPECTRUM_H_
+#define INCLUDE_SPECTRUM_H_
+
+#include <stdint.h>
+
+struct thread_sched;
+
+/*
+A snapshot is taken from one SDR buffer per interval: SPECTRUM_AVERAGES
+windows of SPECTRUM_FFT_SIZE samples from the start of the buffer are
+copied, the DSP thread only pays for that copy. The spectrum thread,
+scheduled as the worker threads, applies a Hann window, runs the FFTs,
+averages the power, and folds the FFT bins into the output bins. The cost is fixed by
+the FFT size and the averages, independent of the sample rate. A buffer
+is not taken while the previous snapshot is still computed.
+
+The readers poll the sequence number and copy the last snapshot.
+*/
+
+#define SPECTRUM_FFT_SIZE     1024 ///< samples of an FFT, a power of two
+#define SPECTRUM_AVERAGES     8    ///< FFTs averaged to a snapshot, fewer if the buffer is shorter
+#define SPECTRUM_BINS_DEFAULT 256  ///< output bins if not given
+#define SPECTRUM_BINS_MIN     16
+
+/// The input of a snapshot.
+typedef struct spectrum_info {
+    uint32_t center_frequency; ///< in Hz
+    uint32_t sample_rate;      ///< in Hz
+    int64_t time_us;           ///< wall time of the buffer
+    unsigned averages;         ///< FFTs averaged
+    unsigned bins;             ///< output bins, from -rate/2 to +rate/2
+} spectrum_info_t;
+
+typedef struct spectrum spectrum_t;
+
+/** Create the spectrum monitor and start its thread.
+
+    @param bins the output bins, rounded down to a power of two from SPECTRUM_BINS_MIN to SPECTRUM_FFT_SIZE
+    @param interval_s the input time between snapshots in seconds
+    @return the monitor, NULL on alloc failure
+*/
+spectrum_t *spectrum_create(unsigned bins, double interval_s);
+
+/** Set the CPU affinity and priority of the spectrum thread, failures only log a warning.
+
+    @param spec the monitor, may be NULL
+    @param sched the scheduling settings, NULL for the defaults
+    @param name the thread name for the log
+*/
+void spectrum_set_sched(spectrum_t *spec, struct thread_sched const *sched, char const *name);
+
+/// Stop the thread and free the monitor, may be NULL.
+void spectrum_free(spectrum_t *spec);
+
+/** Offer an SDR buffer, a window is copied if a snapshot is due.
+
+    Without threads the snapshot is computed right away.
+
+    @param spec the monitor
+    @param iq_buf the samples, CU8 or CS16
+    @param len the length of the buffer in bytes
+    @param sample_size bytes per sample, 2 for CU8, 4 for CS16
+    @param info the center frequency, sample rate, and time of the buffer
+*/
+void spectrum_push(spectrum_t *spec, void const *iq_buf, uint32_t len, unsigned sample_size, spectrum_info_t const *info);
+
+/// The sequence number of the last snapshot, 0 if none yet.
+unsigned spectrum_seq(spectrum_t *spec);
+
+/** Copy the last snapshot.
+
+    @param spec the monitor
+    @param[out] info the input of the snapshot
+    @param[out] db the power of each bin in dBFS, room for the output bins
+    @return the sequence number of the snapshot, 0 if none yet
+*/
+unsigned spectrum_read(spectrum_t *spec, spectrum_info_t *info, float *db);
+
+#endif /* INCLUDE_SPECTRUM_H_ */
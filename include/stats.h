@@ -0,0 +1,111 @@
+/** @file
+    Lock free statistics counters.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_STATS_H_
+#define INCLUDE_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compat_atomic.h"
+
+/*
+The counters are kept in blocks, each block is written by only one thread
+at a time: the counters of an input by the thread processing the input,
+the counters of a decoder by the thread running the decoder (the decode
+pool hands each decoder to one task of a batch). The writer increments
+without a locked instruction, the readers load each counter atomically
+and aggregate the blocks they need. Where 64 bit accesses are not lock
+free, e.g. some 32 bit ARM and MIPS targets, both take the lock of
+atomic_add64() and atomic_get64() instead.
+
+The counters are 64 bit and never reset. A report interval keeps a copy
+of the counters at its start and reports the difference, so the readers
+never write to a block.
+*/
+
+#define STATS_CACHE_LINE 64 ///< padding around the counter blocks, to not share a cache line with other fields
+
+/// Counters of a decoder.
+typedef struct decoder_stats {
+    uint64_t events;          ///< packages passed to the decoder
+    uint64_t ok;              ///< packages decoded
+    uint64_t messages;        ///< messages output
+    uint64_t fails[5];        ///< packages failed, indexed by the negated DECODE_ return code
+    uint64_t dups;            ///< messages dropped as repeats of a recent message, see -M dedup
+    uint64_t slice_lookups;   ///< packages looked up in the slice cache
+    uint64_t slice_hits;      ///< packages replayed from bits another decoder sliced
+    uint64_t memo_hits;       ///< packages answered from a recent decode of the same bits, see -Y memo
+    uint64_t prefilter_skips; ///< packages skipped because the pulse widths can't match
+    uint64_t shed_skips;      ///< packages skipped because the decoding was over the CPU budget
+} decoder_stats_t;
+
+/// Counters of an input.
+typedef struct input_stats {
+    uint64_t frames;           ///< SDR frames received
+    uint64_t frames_squelch;   ///< frames with noise only
+    uint64_t frames_ook;       ///< frames with OOK demodulation
+    uint64_t frames_fsk;       ///< frames with FSK demodulation
+    uint64_t frames_events;    ///< frames with decoder events
+    uint64_t frames_shed;      ///< frames on which decoders were shed over the CPU budget
+    uint64_t frames_quiet;     ///< frames of a quiet source which skipped the decoders
+    uint64_t drops;            ///< SDR buffers with dropped samples before them
+    uint64_t samples_dropped;  ///< samples dropped by the SDR or the DSP queue
+    uint64_t hops;             ///< frequency hops
+    uint64_t hops_deferred;    ///< hops deferred to the end of a package
+    uint64_t settle_discarded; ///< samples discarded while the tuner settled
+    uint64_t sched_buffers;    ///< SDR buffers processed
+    uint64_t sched_late;       ///< SDR buffers arriving more than a buffer duration late
+    uint64_t sched_merged;     ///< queued SDR buffers merged into the one before them
+    uint64_t lag_skips;        ///< SDR buffers skipped while the processing lagged the input
+    uint64_t samples_lag_skipped; ///< samples of the SDR buffers skipped while the processing lagged
+    uint64_t snippets;         ///< IQ snippets saved
+    uint64_t snippets_missed;  ///< packages without an IQ snippet, not in the ring or the log failed
+} input_stats_t;
+
+/// Add to a counter, only from the thread writing the block.
+static inline void stats_add(uint64_t *counter, uint64_t n)
+{
+#if ATOMIC_64_LOCK_FREE
+    atomic_set_relaxed(counter, atomic_get_relaxed(counter) + n); // the single writer needs no locked add
+#else
+    atomic_add64(counter, n); // a torn 64 bit access would lose counts, take the lock
+#endif
+}
+
+/// Read a counter, from any thread.
+static inline uint64_t stats_get(uint64_t const *counter)
+{
+#if ATOMIC_64_LOCK_FREE
+    return atomic_get_relaxed(counter);
+#else
+    return atomic_get64(counter);
+#endif
+}
+
+/** Read the counters of a block.
+
+    @param[out] dst the copy of the counters
+    @param src the block, e.g. a decoder_stats_t
+    @param size the size of the block in bytes
+*/
+void stats_read(void *dst, void const *src, size_t size);
+
+/** Read the counters of a block less a copy taken earlier, i.e. the counts since then.
+
+    @param[out] dst the counts since @p base was taken
+    @param src the block, e.g. a decoder_stats_t
+    @param base a copy of the block from stats_read()
+    @param size the size of the block in bytes
+*/
+void stats_read_since(void *dst, void const *src, void const *base, size_t size);
+
+#endif /* INCLUDE_STATS_H_ */
@@ -0,0 +1,86 @@
+/** @file
+    Streaming compression of messages, permessage-deflate and gzip.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_STREAM_DEFLATE_H_
+#define INCLUDE_STREAM_DEFLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+A stream compresses a sequence of messages with one deflate context, each
+message ends with a sync flush and can be decoded as soon as it arrives.
+With context takeover a message refers back to the earlier messages, the
+repeated keys and values of JSON events then shrink to a few bytes each.
+
+The raw format is the permessage-deflate of websockets (RFC 7692), the
+00 00 ff ff tail of the sync flush is stripped from each message. The gzip
+format is a single gzip member over the whole stream, as HTTP
+Content-Encoding, the last message finishes it.
+
+The window is smaller than the zlib default to bound the memory per client,
+about 128 KiB with STREAM_DEFLATE_WBITS and STREAM_DEFLATE_MEMLEVEL.
+Without zlib no stream can be created.
+*/
+
+#define STREAM_DEFLATE_WBITS    14    ///< default window bits of a stream
+#define STREAM_DEFLATE_MEMLEVEL 7     ///< memory level of a stream
+#define STREAM_INFLATE_MAX      65536 ///< most bytes of an inflated message
+
+/// The format of a stream.
+enum stream_deflate_format {
+    STREAM_DEFLATE_RAW,  ///< permessage-deflate, raw deflate without the flush tail
+    STREAM_DEFLATE_GZIP, ///< a gzip member
+};
+
+typedef struct stream_deflate stream_deflate_t;
+
+/// Returns 1 if streams can be created, i.e. built with zlib.
+int stream_deflate_available(void);
+
+/** Create a stream.
+
+    @param format one of stream_deflate_format
+    @param window_bits the window bits, 9 to 15
+    @param no_context_takeover 1 to compress each message on its own
+    @return the stream, NULL without zlib or on failure
+*/
+stream_deflate_t *stream_deflate_create(int format, int window_bits, int no_context_takeover);
+
+/** Free a stream.
+
+    @param z the stream, may be NULL
+*/
+void stream_deflate_free(stream_deflate_t *z);
+
+/** Compress a message given in parts.
+
+    @param z the stream
+    @param bufs the parts of the message
+    @param lens the length of each part
+    @param n the number of parts
+    @param finish 1 to end the stream with this message, gzip only
+    @param[out] out the compressed message, valid until the next call
+    @return the length of the compressed message, 0 on error
+*/
+size_t stream_deflate_write(stream_deflate_t *z, void const *const *bufs, size_t const *lens, unsigned n, int finish, uint8_t const **out);
+
+/** Decompress a permessage-deflate message of a peer without context takeover.
+
+    @param buf the compressed message
+    @param len the length of @p buf
+    @param[out] dst the message
+    @param dst_size the size of @p dst, e.g. STREAM_INFLATE_MAX
+    @return the length of the message, -1 on error or if it does not fit
+*/
+long stream_inflate_message(void const *buf, size_t len, char *dst, size_t dst_size);
+
+#endif /* INCLUDE_STREAM_DEFLATE_H_ */
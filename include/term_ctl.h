@@ -57,6 +57,21 @@ void term_set_fg(void *ctx, term_color_t color);
  */
 void term_set_bg(void *ctx, term_color_t bg, term_color_t fg);
 
+/// Room for an escape sequence of term_fg_escape() or term_bg_escape().
+#define TERM_ESCAPE_MAX 16
+
+/**
+ * Formats the escape sequence of 'term_set_fg()' into 'buf', e.g. to write it along with the text.
+ * Returns the length, or -1 if the console is colored with calls instead (a legacy Windows console).
+ */
+int term_fg_escape(void *ctx, term_color_t color, char *buf, size_t size);
+
+/**
+ * Formats the escape sequence of 'term_set_bg()' into 'buf', the length is 0 if both colors are omitted.
+ * Returns the length, or -1 if the console is colored with calls instead (a legacy Windows console).
+ */
+int term_bg_escape(void *ctx, term_color_t bg, term_color_t fg, char *buf, size_t size);
+
 /*
  * Defined in newer <sal.h> for MSVC.
  */
@@ -0,0 +1,68 @@
+/** @file
+    CPU affinity, real-time priority, and memory locking of the worker threads.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_THREAD_SCHED_H_
+#define INCLUDE_THREAD_SCHED_H_
+
+#include "compat_pthread.h"
+
+#include <stddef.h>
+
+#define THREAD_SCHED_OTHER 0 ///< the default time sharing policy
+#define THREAD_SCHED_FIFO  1 ///< real-time first in, first out
+#define THREAD_SCHED_RR    2 ///< real-time round robin
+
+#define THREAD_SCHED_DEFAULT_PRIORITY 10 ///< real-time priority if none is given
+
+/// Scheduling settings of a thread, all zero keeps the defaults.
+typedef struct thread_sched {
+    int set;       ///< the settings were given
+    int cpu_first; ///< first CPU to run on, -1 for any
+    int cpu_last;  ///< last CPU to run on
+    int policy;    ///< one of THREAD_SCHED_OTHER, THREAD_SCHED_FIFO, THREAD_SCHED_RR
+    int priority;  ///< real-time priority, 1 to 99
+} thread_sched_t;
+
+/** Parse scheduling settings.
+
+    The format is `[<cpu>[-<cpu>]][:fifo|rr|other][:<priority>]`,
+    e.g. "2", "2-3:fifo", ":rr:20". The settings end at a comma or the end of the string.
+
+    @param[out] sched the settings
+    @param arg the setting string
+    @return 0 on success, -1 on error
+*/
+int thread_sched_parse(thread_sched_t *sched, char const *arg);
+
+#ifdef THREADS
+/** Apply scheduling settings to a thread.
+
+    Failures, e.g. missing privileges for real-time priorities, only log a warning.
+
+    @param thread the thread
+    @param sched the settings, may be NULL
+    @param name the thread name for the log
+    @return 0 on success or if nothing is set, -1 if any setting failed
+*/
+int thread_sched_apply(pthread_t thread, thread_sched_t const *sched, char const *name);
+#endif
+
+/** Lock memory into RAM to keep it from being paged out.
+
+    Failures, e.g. exceeding RLIMIT_MEMLOCK, only log a warning.
+
+    @param addr the start of the memory
+    @param len the length of the memory
+    @return 0 on success, -1 on error
+*/
+int thread_sched_lock_memory(void const *addr, size_t len);
+
+#endif /* INCLUDE_THREAD_SCHED_H_ */
@@ -0,0 +1,57 @@
+/** @file
+    TLS session resumption and handshake stats for the client outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_TLS_SESSION_H_
+#define INCLUDE_TLS_SESSION_H_
+
+#include "data.h"
+
+struct mg_connection;
+
+/*
+A client output keeps the TLS session of its last connection and offers it
+on the next connect, the server then skips the certificate exchange and the
+key agreement (an abbreviated handshake). The session is taken when the
+connection closes, with TLS 1.3 the session ticket arrives only after the
+handshake. Without OpenSSL the functions do nothing.
+*/
+
+typedef struct tls_session {
+    void *session;         ///< the cached session of the last connection, NULL if none
+    int enabled;           ///< a TLS connection was made
+    int pending;           ///< a handshake is in progress
+    double start;          ///< mg_time() the handshake started
+    unsigned handshakes;   ///< completed handshakes
+    unsigned resumed;      ///< handshakes that resumed the cached session
+    unsigned failed;       ///< failed handshakes
+    double total_ms;       ///< time spent in completed handshakes
+    double last_ms;        ///< time of the last completed handshake
+} tls_session_t;
+
+/// Offer the cached session on a new connection, call right after mg_connect_opt().
+void tls_session_connect(tls_session_t *ts, struct mg_connection *nc);
+
+/// Count the handshake, call on MG_EV_CONNECT with the connect status.
+void tls_session_connected(tls_session_t *ts, struct mg_connection *nc, int status);
+
+/// Keep the session of the connection for the next connect, call once the server answered.
+void tls_session_keep(tls_session_t *ts, struct mg_connection *nc);
+
+/// Keep the session of the connection if still resumable, call on MG_EV_CLOSE.
+void tls_session_closed(tls_session_t *ts, struct mg_connection *nc);
+
+/// Free the cached session and detach from the connection @p nc, may be NULL.
+void tls_session_clear(tls_session_t *ts, struct mg_connection *nc);
+
+/// Append the handshake stats to @p data if TLS was used, returns the data.
+data_t *tls_session_stats(tls_session_t const *ts, data_t *data);
+
+#endif /* INCLUDE_TLS_SESSION_H_ */
@@ -0,0 +1,98 @@
+/** @file
+    Trace of the hot path events, exported as Chrome trace JSON.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_TRACE_H_
+#define INCLUDE_TRACE_H_
+
+#include "cpu_stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Each thread records into a ring of its own, claimed on the first event,
+so recording needs no lock: the writer fills a record then publishes the
+position. The export copies the rings while the threads keep recording
+and drops the records overwritten meanwhile. The rings share a fixed
+budget of TRACE_BUFFER_SIZE, threads beyond TRACE_MAX_THREADS are not
+traced. While disabled an event costs a single branch.
+*/
+
+#define TRACE_BUFFER_SIZE (1024 * 1024)      ///< memory of all rings
+#define TRACE_MAX_THREADS 8                  ///< threads with a ring, the others are not traced
+#define TRACE_DUMP_FILE "rtl_433_trace.json" ///< written on SIGUSR2
+
+/// Traced events, the name of an event is given on recording.
+enum trace_event {
+    TRACE_BUFFER,  ///< SDR buffer arrival, the arg is the length in bytes
+    TRACE_DSP,     ///< demodulation of a buffer, the arg is the length in bytes
+    TRACE_PACKAGE, ///< decoding of a detected package, the arg is the number of pulses
+    TRACE_DECODER, ///< a decoder run, the arg is the number of events
+    TRACE_OUTPUT,  ///< delivery of an event to an output, the arg is the output index
+    TRACE_EVENT_COUNT,
+};
+
+/// Tracing is on, read only, see trace_enable().
+extern int volatile trace_on;
+
+/// Enable the tracing, off by default, may be toggled any time.
+void trace_enable(int enable);
+
+/// Name the calling thread in the trace, call before it records the first event.
+void trace_thread_name(char const *name);
+
+/// Record an event, use trace_begin() and trace_end().
+void trace_record(enum trace_event event, char const *name, uint32_t arg, uint64_t start, uint64_t end);
+
+/// Start a traced section, returns 0 if the tracing is disabled.
+static inline uint64_t trace_begin(void)
+{
+    return trace_on ? cpu_stats_now() : 0;
+}
+
+/** End a traced section, does nothing if @p start is 0.
+
+    @param event the kind of event
+    @param name the event name, must stay valid until the next trace_clear()
+    @param arg an event argument, see enum trace_event
+    @param start the time from trace_begin()
+*/
+static inline void trace_end(enum trace_event event, char const *name, uint32_t arg, uint64_t start)
+{
+    if (start)
+        trace_record(event, name, arg, start, cpu_stats_now());
+}
+
+/// Record an instant event, see trace_end().
+static inline void trace_instant(enum trace_event event, char const *name, uint32_t arg)
+{
+    if (trace_on)
+        trace_record(event, name, arg, 0, 0);
+}
+
+/// Drop the recorded events, e.g. before the decoders and their names are freed.
+void trace_clear(void);
+
+/** Export the recorded events as Chrome trace JSON, for chrome://tracing or Perfetto.
+
+    @param[out] len the length of the text
+    @return the text to free(), NULL on alloc failure
+*/
+char *trace_export_json(size_t *len);
+
+/** Write the recorded events as Chrome trace JSON to a file.
+
+    @param path the file path
+    @return 0 on success, -1 on error
+*/
+int trace_write_file(char const *path);
+
+#endif /* INCLUDE_TRACE_H_ */
@@ -0,0 +1,129 @@
+/** @file
+    Differential verify mode, the optimized paths against the reference paths on the same input.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_VERIFY_H_
+#define INCLUDE_VERIFY_H_
+
+#include <stdint.h>
+#include "baseband.h"
+
+struct r_device;
+struct data;
+struct dm_state;
+struct pulse_data;
+
+/*
+Each frame of the first channel is demodulated again with the scalar code
+(see baseband_set_scalar()) into buffers of the verifier, from copies of the
+filter and FM states the optimized run started with. The AM buffer is
+compared if the frame was processed, the FM buffer if it was computed in
+full and not on demand. The pulses are detected from these buffers, equal
+buffers give equal pulses.
+
+Each package that reaches the decoders is decoded again the reference way
+(see run_demods_reference()) after the optimized run: on one thread, in the
+dispatch order, without the fingerprint prefilter and the slice cache. The
+events of both runs are compared as compact JSON in order.
+
+The first divergence of the AM, the FM, and the decoded events is logged and
+its input is saved as a reproducer, the frame as <prefix>_NNN_<freq>M_<rate>k.cu8
+(or .cs16) and the package as <prefix>_NNN.ook. Later divergences are only
+counted. Both paths are timed on the same input for the speedup.
+
+Decoders with a state across packages (e.g. Secplus v2) see each package
+twice, their events may differ, as do the events of the adaptive order that
+stops after an exclusive decoder (-Y adaptive=2). Load shedding is off while
+verifying.
+
+One thread demodulates the verified channel and one thread decodes, the
+state is not locked.
+*/
+
+#define VERIFY_PREFIX_DEFAULT "verify"
+
+typedef struct verify verify_t;
+
+/// Statistics of the verify mode.
+typedef struct verify_stats {
+    unsigned frames;          ///< frames compared
+    unsigned frame_diffs;     ///< frames with a different AM or FM buffer
+    unsigned packages;        ///< packages compared
+    unsigned package_diffs;   ///< packages with different events
+    double baseband_speedup;  ///< time of the scalar over the optimized demodulation, 0 if none compared
+    double decode_speedup;    ///< time of the reference over the optimized decoding, 0 if none compared
+} verify_stats_t;
+
+/** Create a verifier.
+
+    @param prefix the path prefix of the reproducer files
+    @return the verifier or NULL on failure
+*/
+verify_t *verify_create(char const *prefix);
+
+/** Free a verifier, logs a summary.
+
+    @param v the verifier, may be NULL
+*/
+void verify_free(verify_t *v);
+
+/** Start the optimized demodulation of a frame, copies the states it starts from.
+
+    @param v the verifier
+    @param lp_state the low pass filter state
+    @param fm_state the FM demodulator state
+*/
+void verify_frame_begin(verify_t *v, filter_state_t const *lp_state, demodfm_state_t const *fm_state);
+
+/** Compare the optimized demodulation of a frame with the scalar code.
+
+    @param v the verifier
+    @param iq_buf the frame
+    @param n_samples the number of samples
+    @param sample_size 2 for CU8, 4 for CS16
+    @param use_mag_est the magnitude estimate instead of the amplitude for CU8
+    @param center_frequency the frequency of the frame in Hz, for the reproducer name
+    @param samp_rate the sample rate in Hz
+    @param low_pass the low pass of the FM demodulator
+    @param am_buf the AM buffer of the optimized run
+    @param fm_buf the FM buffer of the optimized run, NULL if not computed in full
+*/
+void verify_frame_end(verify_t *v, uint8_t const *iq_buf, uint32_t n_samples, unsigned sample_size, int use_mag_est,
+        uint32_t center_frequency, uint32_t samp_rate, float low_pass, int16_t const *am_buf, int16_t const *fm_buf);
+
+/// Start capturing the events of the optimized decoding of a package.
+void verify_decode_begin(verify_t *v);
+
+/** Capture an event of the optimized decoding, call before the event is changed or dropped.
+
+    @param v the verifier, may be NULL
+    @param r_dev the decoder
+    @param data the event
+*/
+void verify_event(verify_t *v, struct r_device *r_dev, struct data *data);
+
+/** Decode the package the reference way and compare the events.
+
+    @param v the verifier
+    @param demod the demod with the decoders
+    @param pulses the package
+    @param fsk 1 for an FSK package
+    @param start the cpu_stats_now() the optimized decoding started
+*/
+void verify_decode_end(verify_t *v, struct dm_state *demod, struct pulse_data *pulses, int fsk, uint64_t start);
+
+/** Get the statistics.
+
+    @param v the verifier
+    @param[out] stats the statistics
+*/
+void verify_get_stats(verify_t const *v, verify_stats_t *stats);
+
+#endif /* INCLUDE_VERIFY_H_ */
@@ -0,0 +1,55 @@
+/** @file
+    Fixed pool of worker threads to run a batch of independent tasks.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_WORKER_POOL_H_
+#define INCLUDE_WORKER_POOL_H_
+
+/// Called on any pool thread for each task of a batch.
+typedef void (*worker_pool_fn)(void *ctx, unsigned task);
+
+typedef struct worker_pool worker_pool_t;
+
+struct thread_sched;
+
+/** Start the worker threads.
+
+    @param threads number of worker threads, the caller of worker_pool_run() works too
+    @return the pool or NULL on failure or if built without threads
+*/
+worker_pool_t *worker_pool_start(unsigned threads);
+
+/** Stop and join the worker threads and free all resources.
+
+    @param pool the pool, may be NULL
+*/
+void worker_pool_stop(worker_pool_t *pool);
+
+/** Set the CPU affinity and priority of the worker threads, failures only log a warning.
+
+    @param pool the pool, may be NULL
+    @param sched the scheduling settings
+    @param name the pool name for the log
+*/
+void worker_pool_set_sched(worker_pool_t *pool, struct thread_sched const *sched, char const *name);
+
+/** Run a batch of tasks and wait for all of them to finish.
+
+    Each idle thread, including the caller, takes the next pending task,
+    the tasks must not depend on each other.
+
+    @param pool the pool, NULL to run all tasks on the caller
+    @param tasks number of tasks, the handler is called with 0 to tasks - 1
+    @param task_fn the task handler
+    @param ctx user context passed to the handler
+*/
+void worker_pool_run(worker_pool_t *pool, unsigned tasks, worker_pool_fn task_fn, void *ctx);
+
+#endif /* INCLUDE_WORKER_POOL_H_ */
@@ -12,15 +12,56 @@
 #ifndef INCLUDE_WRITE_SIGROK_
 #define INCLUDE_WRITE_SIGROK_
 
-/** Write a Sigrok file from data dump files.
+#include <stddef.h>
 
-    @param filename file to write
-    @param samplerate sample rate for the channels
-    @param probes number of binary channels, needs "logic-1-1" file
-    @param analogs number of analog channels, needs "analog-1-N-1" with N starting at probes+1
+/*
+A Sigrok session file is a ZIP archive with a "version" and a "metadata" file
+and the channel data split into chunk files: "logic-1-N" for the logic probes,
+one byte per sample, and "analog-1-C-N" for each analog channel C, one float
+per sample, with N counting the chunks from 1.
+
+The writer buffers SIGROK_CHUNK_SIZE bytes of each channel and appends the
+full chunks to the archive, deflated if built with zlib. The central directory
+is written when finished, there are no temporary files and no external zip.
+*/
+
+#define SIGROK_CHUNK_SIZE (4 * 1024 * 1024) ///< bytes of a channel per chunk file
+
+typedef struct sigrok_writer sigrok_writer_t;
+
+/** Start a Sigrok file.
+
+    @param filename file to write, replaced if it exists
+    @param probes number of binary channels, the logic data has one bit per probe
+    @param analogs number of analog channels, numbered from probes+1
     @param labels channel labels, probes+analog strings or NULL for generic labels
+    @return the writer or NULL on error
+*/
+sigrok_writer_t *sigrok_writer_create(char const *filename, unsigned probes, unsigned analogs, char const *labels[]);
+
+/** Add samples to a channel.
+
+    @param sr the writer
+    @param channel 0 for the logic data, 1 to analogs for the analog channels
+    @param buf the samples, bytes for the logic data, floats for the analog channels
+    @param len the length of the samples in bytes
+    @return 0 on success, -1 on a write error
+*/
+int sigrok_writer_write(sigrok_writer_t *sr, unsigned channel, void const *buf, size_t len);
+
+/** Write the remaining chunks, the metadata, and the directory, then close the file.
+
+    @param sr the writer
+    @param samplerate sample rate for the channels
+    @return 0 on success, -1 on a write error
+*/
+int sigrok_writer_finish(sigrok_writer_t *sr, unsigned samplerate);
+
+/** Free a writer, closes the file if not finished.
+
+    @param sr the writer, may be NULL
 */
-void write_sigrok(char const *filename, unsigned samplerate, unsigned probes, unsigned analogs, char const *labels[]);
+void sigrok_writer_free(sigrok_writer_t *sr);
 
 /** Open a file in a forked Pulseview.
 
@@ -0,0 +1,277 @@
+/** @file
+    AES-128 decryption, e.g. for the encrypted payloads of M-Bus meters.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "aes.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define AES_NI
+#include <wmmintrin.h>
+#define TARGET_AES __attribute__((target("aes,sse2")))
+#endif
+
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+#define AES_ARMV8
+#include <arm_neon.h>
+#endif
+
+/// The S-box and the inverse S-box.
+static uint8_t const aes_sbox[256] = {
+        0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+        0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+        0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+        0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+        0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+        0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+        0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+        0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+        0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+        0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+        0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+        0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+        0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+        0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+        0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+        0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t const aes_inv_sbox[256] = {
+        0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+        0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+        0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+        0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+        0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+        0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+        0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+        0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+        0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+        0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+        0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+        0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+        0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+        0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+        0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+        0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d,
+};
+
+static uint8_t xtime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ (x & 0x80 ? 0x1b : 0));
+}
+
+static uint8_t gmul(uint8_t x, uint8_t y)
+{
+    uint8_t p = 0;
+    for (; y; y >>= 1, x = xtime(x)) {
+        if (y & 1)
+            p ^= x;
+    }
+    return p;
+}
+
+void aes128_set_key(aes128_key_t *key, uint8_t const user_key[AES_BLOCK_SIZE], int use_hw)
+{
+    uint8_t *rk  = key->rk;
+    uint8_t rcon = 0x01;
+    memcpy(rk, user_key, AES_BLOCK_SIZE);
+    for (unsigned i = AES_BLOCK_SIZE; i < sizeof(key->rk); i += 4) {
+        uint8_t t[4] = {rk[i - 4], rk[i - 3], rk[i - 2], rk[i - 1]};
+        if (i % AES_BLOCK_SIZE == 0) {
+            // RotWord, SubWord, and Rcon
+            uint8_t t0 = t[0];
+            t[0] = aes_sbox[t[1]] ^ rcon;
+            t[1] = aes_sbox[t[2]];
+            t[2] = aes_sbox[t[3]];
+            t[3] = aes_sbox[t0];
+            rcon = xtime(rcon);
+        }
+        for (unsigned j = 0; j < 4; ++j)
+            rk[i + j] = rk[i + j - AES_BLOCK_SIZE] ^ t[j];
+    }
+
+    key->hw = 0;
+#ifdef AES_NI
+    if (use_hw) {
+        __builtin_cpu_init();
+        key->hw = __builtin_cpu_supports("aes");
+    }
+#endif
+#ifdef AES_ARMV8
+    key->hw = use_hw;
+#endif
+    (void)use_hw;
+}
+
+/// Decrypt a block with the inverse cipher.
+static void aes128_decrypt_block(uint8_t const *rk, uint8_t s[AES_BLOCK_SIZE])
+{
+    for (unsigned i = 0; i < AES_BLOCK_SIZE; ++i)
+        s[i] ^= rk[10 * AES_BLOCK_SIZE + i];
+
+    for (int round = 9; round >= 0; --round) {
+        // InvShiftRows and InvSubBytes, the state is column major
+        uint8_t t[AES_BLOCK_SIZE];
+        for (unsigned c = 0; c < 4; ++c) {
+            for (unsigned r = 0; r < 4; ++r)
+                t[c * 4 + r] = aes_inv_sbox[s[((c + 4 - r) % 4) * 4 + r]];
+        }
+        // AddRoundKey
+        for (unsigned i = 0; i < AES_BLOCK_SIZE; ++i)
+            s[i] = t[i] ^ rk[round * AES_BLOCK_SIZE + i];
+        if (round == 0)
+            break;
+        // InvMixColumns
+        for (unsigned c = 0; c < 4; ++c) {
+            uint8_t *col = &s[c * 4];
+            uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+            col[0] = gmul(a0, 0x0e) ^ gmul(a1, 0x0b) ^ gmul(a2, 0x0d) ^ gmul(a3, 0x09);
+            col[1] = gmul(a0, 0x09) ^ gmul(a1, 0x0e) ^ gmul(a2, 0x0b) ^ gmul(a3, 0x0d);
+            col[2] = gmul(a0, 0x0d) ^ gmul(a1, 0x09) ^ gmul(a2, 0x0e) ^ gmul(a3, 0x0b);
+            col[3] = gmul(a0, 0x0b) ^ gmul(a1, 0x0d) ^ gmul(a2, 0x09) ^ gmul(a3, 0x0e);
+        }
+    }
+}
+
+#ifdef AES_NI
+TARGET_AES
+static void aes128_cbc_decrypt_ni(uint8_t const *rk, uint8_t const *iv, uint8_t const *in, uint8_t *out, unsigned len)
+{
+    // the round keys of the equivalent inverse cipher
+    __m128i k[11];
+    k[0]  = _mm_loadu_si128((__m128i const *)rk);
+    k[10] = _mm_loadu_si128((__m128i const *)(rk + 10 * AES_BLOCK_SIZE));
+    for (unsigned i = 1; i < 10; ++i)
+        k[i] = _mm_aesimc_si128(_mm_loadu_si128((__m128i const *)(rk + i * AES_BLOCK_SIZE)));
+
+    __m128i prev = _mm_loadu_si128((__m128i const *)iv);
+    for (unsigned n = 0; n < len; n += AES_BLOCK_SIZE) {
+        __m128i c = _mm_loadu_si128((__m128i const *)(in + n));
+        __m128i s = _mm_xor_si128(c, k[10]);
+        for (unsigned i = 9; i > 0; --i)
+            s = _mm_aesdec_si128(s, k[i]);
+        s = _mm_aesdeclast_si128(s, k[0]);
+        _mm_storeu_si128((__m128i *)(out + n), _mm_xor_si128(s, prev));
+        prev = c;
+    }
+}
+#endif /* AES_NI */
+
+#ifdef AES_ARMV8
+static void aes128_cbc_decrypt_armv8(uint8_t const *rk, uint8_t const *iv, uint8_t const *in, uint8_t *out, unsigned len)
+{
+    // the round keys of the equivalent inverse cipher
+    uint8x16_t k[11];
+    k[0]  = vld1q_u8(rk);
+    k[10] = vld1q_u8(rk + 10 * AES_BLOCK_SIZE);
+    for (unsigned i = 1; i < 10; ++i)
+        k[i] = vaesimcq_u8(vld1q_u8(rk + i * AES_BLOCK_SIZE));
+
+    uint8x16_t prev = vld1q_u8(iv);
+    for (unsigned n = 0; n < len; n += AES_BLOCK_SIZE) {
+        uint8x16_t c = vld1q_u8(in + n);
+        uint8x16_t s = vaesdq_u8(c, k[10]);
+        for (unsigned i = 9; i > 0; --i)
+            s = vaesdq_u8(vaesimcq_u8(s), k[i]);
+        vst1q_u8(out + n, veorq_u8(veorq_u8(s, k[0]), prev));
+        prev = c;
+    }
+}
+#endif /* AES_ARMV8 */
+
+void aes128_cbc_decrypt(aes128_key_t const *key, uint8_t const iv[AES_BLOCK_SIZE], uint8_t const *in, uint8_t *out, unsigned len)
+{
+#ifdef AES_NI
+    if (key->hw) {
+        aes128_cbc_decrypt_ni(key->rk, iv, in, out, len);
+        return;
+    }
+#endif
+#ifdef AES_ARMV8
+    if (key->hw) {
+        aes128_cbc_decrypt_armv8(key->rk, iv, in, out, len);
+        return;
+    }
+#endif
+    uint8_t prev[AES_BLOCK_SIZE];
+    memcpy(prev, iv, AES_BLOCK_SIZE);
+    for (unsigned n = 0; n < len; n += AES_BLOCK_SIZE) {
+        uint8_t c[AES_BLOCK_SIZE];
+        memcpy(c, in + n, AES_BLOCK_SIZE);
+        uint8_t *s = out + n;
+        memcpy(s, c, AES_BLOCK_SIZE);
+        aes128_decrypt_block(key->rk, s);
+        for (unsigned i = 0; i < AES_BLOCK_SIZE; ++i)
+            s[i] ^= prev[i];
+        memcpy(prev, c, AES_BLOCK_SIZE);
+    }
+}
+
+#ifdef _TEST
+#include <stdio.h>
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (a), (b)); \
+        } \
+    } while (0)
+
+static void hex_bytes(char const *hex, uint8_t *out)
+{
+    for (unsigned i = 0; hex[2 * i]; ++i) {
+        unsigned v;
+        sscanf(&hex[2 * i], "%2x", &v);
+        out[i] = (uint8_t)v;
+    }
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    aes128_key_t key;
+    uint8_t k[16], iv[16], in[32], want[32], out[32];
+
+    for (int hw = 0; hw < 2; ++hw) {
+        fprintf(stderr, "aes:: FIPS-197 C.1 (hw %d)\n", hw);
+        hex_bytes("000102030405060708090a0b0c0d0e0f", k);
+        memset(iv, 0, sizeof(iv));
+        hex_bytes("69c4e0d86a7b0430d8cdb78070b4c55a", in);
+        hex_bytes("00112233445566778899aabbccddeeff", want);
+        aes128_set_key(&key, k, hw);
+        if (hw && !key.hw)
+            fprintf(stderr, "aes:: no AES instructions, testing the software AES again\n");
+        aes128_cbc_decrypt(&key, iv, in, out, 16);
+        ASSERT_EQUALS(memcmp(out, want, 16), 0);
+
+        fprintf(stderr, "aes:: SP 800-38A F.2.2 CBC-AES128.Decrypt (hw %d)\n", hw);
+        hex_bytes("2b7e151628aed2a6abf7158809cf4f3c", k);
+        hex_bytes("000102030405060708090a0b0c0d0e0f", iv);
+        hex_bytes("7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2", in);
+        hex_bytes("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51", want);
+        aes128_set_key(&key, k, hw);
+        aes128_cbc_decrypt(&key, iv, in, out, 32);
+        ASSERT_EQUALS(memcmp(out, want, 32), 0);
+
+        // in place
+        aes128_cbc_decrypt(&key, iv, in, in, 32);
+        ASSERT_EQUALS(memcmp(in, want, 32), 0);
+    }
+
+    fprintf(stderr, "aes:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -21,6 +21,7 @@
 
 #define FRAME_END_MIN 50000 /* minimum sample count to detect frame end */
 #define FRAME_PAD 10000 /* number of samples to pad both frame start and end */
+#define AM_RUN_BLOCK 16 /* samples checked at once for an edge, a vector of the compiler */
 
 am_analyze_t *am_analyze_create(void)
 {
@@ -42,12 +43,64 @@ void am_analyze_skip(am_analyze_t *a, unsigned n_samples)
     a->signal_start = 0;
 }
 
+/// Count the leading samples at or below the threshold, a block at a time while no sample in it rises.
+static unsigned am_run_below(int16_t const *buf, unsigned len, int threshold)
+{
+    unsigned n = 0;
+    for (; n + AM_RUN_BLOCK <= len; n += AM_RUN_BLOCK) {
+        int16_t peak = buf[n];
+        for (unsigned k = 1; k < AM_RUN_BLOCK; ++k)
+            peak = buf[n + k] > peak ? buf[n + k] : peak;
+        if (peak > threshold)
+            break;
+    }
+    while (n < len && buf[n] <= threshold)
+        n++;
+    return n;
+}
+
+/// Count the leading samples at or above the threshold, a block at a time while no sample in it falls.
+static unsigned am_run_above(int16_t const *buf, unsigned len, int threshold)
+{
+    unsigned n = 0;
+    for (; n + AM_RUN_BLOCK <= len; n += AM_RUN_BLOCK) {
+        int16_t low = buf[n];
+        for (unsigned k = 1; k < AM_RUN_BLOCK; ++k)
+            low = buf[n + k] < low ? buf[n + k] : low;
+        if (low < threshold)
+            break;
+    }
+    while (n < len && buf[n] >= threshold)
+        n++;
+    return n;
+}
+
 void am_analyze(am_analyze_t *a, int16_t *am_buf, unsigned n_samples, int debug_output, samp_grab_t *g)
 {
     unsigned int i;
     int threshold = (a->level_limit ? a->level_limit : 8000);  // Does not support auto level. Use old default instead.
 
     for (i = 0; i < n_samples; i++) {
+        // between the edges the samples only advance the counter, skip over them
+        unsigned run = 0;
+        if (a->print2) {
+            run = am_run_above(&am_buf[i], n_samples - i, threshold);
+        }
+        else if (a->print) {
+            // stop short of the sample that could end the frame
+            unsigned limit = n_samples - i;
+            if (a->signal_start) {
+                unsigned frame_end = a->pulse_end + FRAME_END_MIN;
+                unsigned left      = frame_end > a->counter ? frame_end - a->counter : 0;
+                limit              = left < limit ? left : limit;
+            }
+            run = am_run_below(&am_buf[i], limit, threshold);
+        }
+        a->counter += run;
+        i += run;
+        if (i >= n_samples)
+            break;
+
         if (am_buf[i] > threshold) {
             if (!a->signal_start)
                 a->signal_start = a->counter;
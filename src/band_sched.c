@@ -0,0 +1,255 @@
+/** @file
+    Band scan, a scanning input assigns the further inputs to the busy channels.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "band_sched.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct channel {
+    uint32_t frequency;
+    double score;
+    double last_active; ///< time of the last activity, 0 if never active
+    int listener;       ///< -1 if not covered
+    unsigned dwells;
+    unsigned active_dwells;
+    unsigned assigns;
+} channel_t;
+
+struct band_sched {
+    double hold;
+    unsigned channels;
+    unsigned listeners;
+    channel_t *chan;
+    int *assigned; ///< the channel of each listener, -1 if idle
+#ifdef THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+band_sched_t *band_sched_create(uint32_t const *frequencies, unsigned channels, unsigned listeners, double hold)
+{
+    band_sched_t *sched = calloc(1, sizeof(*sched));
+    if (!sched) {
+        WARN_CALLOC("band_sched_create()");
+        return NULL;
+    }
+    sched->chan = calloc(channels ? channels : 1, sizeof(*sched->chan));
+    if (!sched->chan) {
+        WARN_CALLOC("band_sched_create()");
+        free(sched);
+        return NULL;
+    }
+    sched->assigned = calloc(listeners ? listeners : 1, sizeof(*sched->assigned));
+    if (!sched->assigned) {
+        WARN_CALLOC("band_sched_create()");
+        free(sched->chan);
+        free(sched);
+        return NULL;
+    }
+    sched->hold      = hold;
+    sched->channels  = channels;
+    sched->listeners = listeners;
+    for (unsigned i = 0; i < channels; ++i) {
+        sched->chan[i].frequency = frequencies[i];
+        sched->chan[i].listener  = -1;
+    }
+    for (unsigned i = 0; i < listeners; ++i)
+        sched->assigned[i] = -1;
+#ifdef THREADS
+    pthread_mutex_init(&sched->lock, NULL);
+#endif
+    return sched;
+}
+
+void band_sched_free(band_sched_t *sched)
+{
+    if (!sched)
+        return;
+#ifdef THREADS
+    pthread_mutex_destroy(&sched->lock);
+#endif
+    free(sched->assigned);
+    free(sched->chan);
+    free(sched);
+}
+
+static void sched_lock(band_sched_t *sched)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&sched->lock);
+#else
+    (void)sched;
+#endif
+}
+
+static void sched_unlock(band_sched_t *sched)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&sched->lock);
+#else
+    (void)sched;
+#endif
+}
+
+unsigned band_sched_scan(band_sched_t *sched, unsigned index, int active, double now)
+{
+    sched_lock(sched);
+    channel_t *chan = &sched->chan[index];
+    chan->score = chan->score * (1 - BAND_SCHED_ALPHA) + (active ? BAND_SCHED_ALPHA : 0);
+    chan->dwells++;
+    if (active) {
+        chan->active_dwells++;
+        chan->last_active = now;
+    }
+
+    unsigned next = (index + 1) % sched->channels;
+    for (unsigned i = 1; i <= sched->channels; ++i) {
+        unsigned candidate = (index + i) % sched->channels;
+        if (sched->chan[candidate].listener < 0) {
+            next = candidate;
+            break;
+        }
+    }
+    sched_unlock(sched);
+    return next;
+}
+
+int band_sched_listen(band_sched_t *sched, unsigned listener, int active, double now)
+{
+    sched_lock(sched);
+    int index = sched->assigned[listener];
+    if (index >= 0) {
+        channel_t *chan = &sched->chan[index];
+        if (active)
+            chan->last_active = now;
+        if (now - chan->last_active > sched->hold) {
+            // quiet for the hold time, the channel has to score again
+            chan->listener  = -1;
+            chan->score     = 0;
+            sched->assigned[listener] = -1;
+        }
+    }
+
+    int tune = -1;
+    if (sched->assigned[listener] < 0) {
+        channel_t *best = NULL;
+        for (unsigned i = 0; i < sched->channels; ++i) {
+            channel_t *chan = &sched->chan[i];
+            if (chan->listener < 0 && chan->score >= BAND_SCHED_HOT && (!best || chan->score > best->score)) {
+                best = chan;
+                tune = (int)i;
+            }
+        }
+        if (best) {
+            best->listener    = (int)listener;
+            best->last_active = now;
+            best->assigns++;
+            sched->assigned[listener] = tune;
+        }
+    }
+    sched_unlock(sched);
+    return tune;
+}
+
+void band_sched_get_stats(band_sched_t *sched, unsigned index, double now, band_sched_stats_t *stats)
+{
+    sched_lock(sched);
+    channel_t const *chan = &sched->chan[index];
+    stats->frequency     = chan->frequency;
+    stats->score         = chan->score;
+    stats->idle          = chan->last_active > 0 ? now - chan->last_active : 0;
+    stats->listener      = chan->listener;
+    stats->dwells        = chan->dwells;
+    stats->active_dwells = chan->active_dwells;
+    stats->assigns       = chan->assigns;
+    sched_unlock(sched);
+}
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    uint32_t freqs[4] = {433920000, 434000000, 868300000, 915000000};
+    band_sched_stats_t stats;
+
+    fprintf(stderr, "band_sched:: the scanner hops round robin without activity\n");
+    band_sched_t *sched = band_sched_create(freqs, 4, 2, 10.0);
+    ASSERT_EQUALS(sched != NULL, 1);
+    ASSERT_EQUALS((int)band_sched_scan(sched, 0, 0, 1.0), 1);
+    ASSERT_EQUALS((int)band_sched_scan(sched, 3, 0, 1.5), 0);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 2.0), -1);
+
+    fprintf(stderr, "band_sched:: a single active dwell is not sustained traffic\n");
+    ASSERT_EQUALS((int)band_sched_scan(sched, 2, 1, 3.0), 3);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 3.0), -1);
+
+    fprintf(stderr, "band_sched:: a listener takes a channel active on consecutive visits\n");
+    band_sched_scan(sched, 2, 1, 5.0);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 5.0), 2);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 5.5), -1);
+    ASSERT_EQUALS(band_sched_listen(sched, 1, 0, 5.5), -1);
+    band_sched_get_stats(sched, 2, 6.0, &stats);
+    ASSERT_EQUALS((int)stats.frequency, 868300000);
+    ASSERT_EQUALS(stats.listener, 0);
+    ASSERT_EQUALS((int)stats.dwells, 2);
+    ASSERT_EQUALS((int)stats.active_dwells, 2);
+    ASSERT_EQUALS((int)stats.assigns, 1);
+
+    fprintf(stderr, "band_sched:: the scanner skips the covered channel\n");
+    ASSERT_EQUALS((int)band_sched_scan(sched, 1, 0, 6.0), 3);
+
+    fprintf(stderr, "band_sched:: the second listener takes the next busy channel\n");
+    band_sched_scan(sched, 0, 1, 7.0);
+    band_sched_scan(sched, 0, 1, 8.0);
+    ASSERT_EQUALS(band_sched_listen(sched, 1, 0, 8.0), 0);
+    ASSERT_EQUALS((int)band_sched_scan(sched, 3, 0, 8.5), 1);
+
+    fprintf(stderr, "band_sched:: activity keeps a listener, a quiet channel is released\n");
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 1, 14.0), -1);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 23.0), -1);
+    band_sched_get_stats(sched, 2, 23.0, &stats);
+    ASSERT_EQUALS(stats.listener, 0);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 24.5), -1);
+    band_sched_get_stats(sched, 2, 24.5, &stats);
+    ASSERT_EQUALS(stats.listener, -1);
+    ASSERT_EQUALS(stats.score == 0, 1);
+    ASSERT_EQUALS((int)band_sched_scan(sched, 1, 0, 25.0), 2);
+
+    fprintf(stderr, "band_sched:: with all channels covered the scanner keeps hopping\n");
+    band_sched_free(sched);
+    sched = band_sched_create(freqs, 1, 1, 10.0);
+    band_sched_scan(sched, 0, 1, 1.0);
+    band_sched_scan(sched, 0, 1, 2.0);
+    ASSERT_EQUALS(band_sched_listen(sched, 0, 0, 2.0), 0);
+    ASSERT_EQUALS((int)band_sched_scan(sched, 0, 0, 3.0), 0);
+    band_sched_free(sched);
+
+    fprintf(stderr, "band_sched:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <math.h>
 
+#include "compat_atomic.h"
 #include "logger.h"
 #include "r_util.h"
 
@@ -31,23 +32,962 @@ static void calc_squares(void)
         scaled_squares[i] = (127 - i) * (127 - i);
 }
 
-// This will give a noisy envelope of OOK/ASK signals.
-// Subtract the bias (-128) and get an envelope estimation.
-float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+/// Mixer table resolution, the phase truncation spurs are at about -60 dBc.
+#define NCO_TABLE_BITS 10
+#define NCO_TABLE_SIZE (1 << NCO_TABLE_BITS)
+
+static int16_t nco_cos[NCO_TABLE_SIZE];
+static int16_t nco_rot[NCO_TABLE_SIZE][4]; ///< cos, sin, -sin, cos of each phase, the pairs of the SIMD mixers
+
+/// precalculate lookup table for the decimator mixer.
+static void calc_nco_table(void)
 {
-    unsigned long i;
+    if (nco_cos[0])
+        return; // already initialized
+    for (int i = 0; i < NCO_TABLE_SIZE; i++)
+        nco_cos[i] = (int16_t)lrint(cos(2.0 * M_PI * i / NCO_TABLE_SIZE) * 32767.0);
+    for (int i = 0; i < NCO_TABLE_SIZE; i++) {
+        int16_t c = nco_cos[i];
+        int16_t s = nco_cos[(i - NCO_TABLE_SIZE / 4) & (NCO_TABLE_SIZE - 1)]; // never -32768
+        nco_rot[i][0] = c;
+        nco_rot[i][1] = s;
+        nco_rot[i][2] = (int16_t)-s;
+        nco_rot[i][3] = c;
+    }
+}
+
+// SIMD kernels process a multiple of their vector width and return the number
+// of samples done, the scalar loops finish the remainder. Results are bit-exact.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BASEBAND_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(BASEBAND_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define BASEBAND_AVX2
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BASEBAND_NEON
+#include <arm_neon.h>
+#endif
+
+typedef uint32_t (*kernel_cu8_fn)(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum);
+typedef uint32_t (*kernel_cs16_fn)(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum);
+
+/// Decimator kernel, filters outputs at skip, skip + factor, ... of a work block, returns the number of outputs.
+typedef uint32_t (*decim_fn)(int16_t const *w_i, int16_t const *w_q, uint32_t len, int16_t *y_buf, decimator_state_t const *state);
+
+/// Decimator mixer kernel, shifts interleaved input into the I and Q work buffers, advances the phase, returns the number of samples.
+typedef uint32_t (*mix_cu8_fn)(uint8_t const *x_buf, int16_t *w_i, int16_t *w_q, uint32_t len, uint32_t *phase, uint32_t step);
+typedef uint32_t (*mix_cs16_fn)(int16_t const *x_buf, int16_t *w_i, int16_t *w_q, uint32_t len, uint32_t *phase, uint32_t step);
+
+/// The active SIMD kernels, NULL for scalar only.
+static struct baseband_kernels {
+    baseband_simd_t simd;
+    kernel_cu8_fn envelope_cu8;
+    kernel_cu8_fn magnitude_cu8;
+    kernel_cs16_fn magnitude_cs16;
+    void (*low_pass)(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state);
+    uint32_t (*fm_disc_cu8)(uint8_t const *x_buf, int16_t *f_buf, uint32_t len);
+    decim_fn decimate;
+    mix_cu8_fn mix_cu8;
+    mix_cs16_fn mix_cs16;
+    unsigned long (*convert_cu8_f32)(uint8_t const *src, float *dst, unsigned long n);
+    unsigned long (*convert_s16_f32)(int16_t const *src, float *dst, unsigned long n);
+} kernels;
+
+/// No kernels, the scalar code of the functions.
+static struct baseband_kernels const scalar_kernels = {BASEBAND_SIMD_NONE};
+
+/// The calling thread runs the scalar code only, see baseband_set_scalar().
+static COMPAT_TLS int scalar_only;
+
+/// The kernels of the calling thread.
+static inline struct baseband_kernels const *active_kernels(void)
+{
+    return scalar_only ? &scalar_kernels : &kernels;
+}
+
+// Polynomial atan(t) * 4 / pi for t in [0, 1], Q15 coeffs of the odd terms.
+// From Abramowitz and Stegun 4.4.49, error max 1e-5, 2e-4 radians after fixed-point rounding.
+#define ATAN_C1 41716
+#define ATAN_C3 -13781
+#define ATAN_C5 7516
+#define ATAN_C7 -3552
+#define ATAN_C9 869
+
+#ifdef BASEBAND_SSE2
+static uint32_t envelope_cu8_sse2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(127);
+    __m128i const flip = _mm_set1_epi32(0x8000);
+    __m128i const flip16 = _mm_set1_epi16((short)0x8000);
+    __m128i acc = zero;
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        __m128i v  = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i]);
+        __m128i lo = _mm_sub_epi16(bias, _mm_unpacklo_epi8(v, zero));
+        __m128i hi = _mm_sub_epi16(bias, _mm_unpackhi_epi8(v, zero));
+        // pairwise I*I + Q*Q, max 32768
+        __m128i a = _mm_madd_epi16(lo, lo);
+        __m128i b = _mm_madd_epi16(hi, hi);
+        acc = _mm_add_epi32(acc, _mm_add_epi32(a, b));
+        // there is no unsigned pack in SSE2, shift to signed range and back
+        __m128i y = _mm_packs_epi32(_mm_sub_epi32(a, flip), _mm_sub_epi32(b, flip));
+        _mm_storeu_si128((__m128i *)&y_buf[i], _mm_xor_si128(y, flip16));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    *sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return n;
+}
+
+static uint32_t magnitude_cu8_sse2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(128);
+    __m128i const even = _mm_set1_epi32(0xffff);
+    __m128i const coef = _mm_set1_epi32((51 << 16) | 122);
+    __m128i acc = zero;
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        __m128i v = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i]);
+        __m128i m[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i x = _mm_sub_epi16(k ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero), bias);
+            x = _mm_max_epi16(x, _mm_sub_epi16(zero, x)); // abs
+            // swap I and Q, min and max are then the same in both lanes of a pair
+            __m128i s = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            // max in the even lanes, min in the odd lanes
+            __m128i p = _mm_or_si128(_mm_and_si128(even, _mm_max_epi16(x, s)), _mm_andnot_si128(even, _mm_min_epi16(x, s)));
+            m[k] = _mm_madd_epi16(p, coef); // max 22144
+        }
+        acc = _mm_add_epi32(acc, _mm_add_epi32(m[0], m[1]));
+        _mm_storeu_si128((__m128i *)&y_buf[i], _mm_packs_epi32(m[0], m[1]));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    *sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return n;
+}
+
+static inline __m128i magnitude_cs16_epi16_sse2(__m128i x)
+{
+    __m128i const flip = _mm_set1_epi16((short)0x8000);
+    __m128i const even = _mm_set1_epi32(0xffff);
+    __m128i const coef = _mm_set1_epi32((51 << 16) | 122);
+    __m128i sgn = _mm_srai_epi16(x, 15);
+    x = _mm_sub_epi16(_mm_xor_si128(x, sgn), sgn); // abs, -32768 becomes 32768 unsigned
+    // swap I and Q, unsigned min/max by flipping the sign bit
+    __m128i s  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+    __m128i xf = _mm_xor_si128(x, flip);
+    __m128i sf = _mm_xor_si128(s, flip);
+    __m128i mx = _mm_xor_si128(_mm_max_epi16(xf, sf), flip);
+    __m128i mi = _mm_xor_si128(_mm_min_epi16(xf, sf), flip);
+    // max in the even lanes, min in the odd lanes
+    __m128i v = _mm_or_si128(_mm_and_si128(even, mx), _mm_andnot_si128(even, mi));
+    // the signed multiply is off by 65536 * coef only for a value of 32768
+    __m128i e = _mm_madd_epi16(v, coef);
+    e = _mm_add_epi32(e, _mm_slli_epi32(_mm_madd_epi16(_mm_srli_epi16(v, 15), coef), 16));
+    return _mm_srli_epi32(e, 8); // max 22144
+}
+
+static uint32_t magnitude_cs16_sse2(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    __m128i acc = _mm_setzero_si128();
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        __m128i lo = magnitude_cs16_epi16_sse2(_mm_loadu_si128((__m128i const *)&iq_buf[2 * i]));
+        __m128i hi = magnitude_cs16_epi16_sse2(_mm_loadu_si128((__m128i const *)&iq_buf[2 * i + 8]));
+        acc = _mm_add_epi32(acc, _mm_add_epi32(lo, hi));
+        _mm_storeu_si128((__m128i *)&y_buf[i], _mm_packs_epi32(lo, hi));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    *sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return n;
+}
+#endif /* BASEBAND_SSE2 */
+
+#ifdef BASEBAND_AVX2
+TARGET_AVX2
+static inline uint32_t hsum_epi32_avx2(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(s);
+}
+
+TARGET_AVX2
+static uint32_t envelope_cu8_avx2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    __m256i const bias = _mm256_set1_epi16(127);
+    __m256i acc = _mm256_setzero_si256();
+    uint32_t n = len & ~15u;
+    for (uint32_t i = 0; i < n; i += 16) {
+        __m128i v0 = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i]);
+        __m128i v1 = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i + 16]);
+        __m256i lo = _mm256_sub_epi16(bias, _mm256_cvtepu8_epi16(v0));
+        __m256i hi = _mm256_sub_epi16(bias, _mm256_cvtepu8_epi16(v1));
+        __m256i a = _mm256_madd_epi16(lo, lo); // max 32768
+        __m256i b = _mm256_madd_epi16(hi, hi);
+        acc = _mm256_add_epi32(acc, _mm256_add_epi32(a, b));
+        // pack is per 128-bit lane, fix the order
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)&y_buf[i], y);
+    }
+    *sum += hsum_epi32_avx2(acc);
+    return n;
+}
+
+TARGET_AVX2
+static uint32_t magnitude_cu8_avx2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    __m256i const bias = _mm256_set1_epi16(128);
+    __m256i const swap = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+            2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    __m256i const coef = _mm256_set1_epi32((51 << 16) | 122);
+    __m256i acc = _mm256_setzero_si256();
+    uint32_t n = len & ~15u;
+    for (uint32_t i = 0; i < n; i += 16) {
+        __m256i m[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i v = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i + 16 * k]);
+            __m256i x = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(v), bias));
+            __m256i s = _mm256_shuffle_epi8(x, swap);
+            // max in the even lanes, min in the odd lanes
+            __m256i p = _mm256_blend_epi16(_mm256_min_epi16(x, s), _mm256_max_epi16(x, s), 0x55);
+            m[k] = _mm256_madd_epi16(p, coef); // max 22144
+        }
+        acc = _mm256_add_epi32(acc, _mm256_add_epi32(m[0], m[1]));
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi32(m[0], m[1]), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)&y_buf[i], y);
+    }
+    *sum += hsum_epi32_avx2(acc);
+    return n;
+}
+
+TARGET_AVX2
+static uint32_t magnitude_cs16_avx2(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    __m256i const c_mx = _mm256_set1_epi32(122);
+    __m256i const c_mi = _mm256_set1_epi32(51);
+    __m256i const even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i acc = _mm256_setzero_si256();
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        __m256i m[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i v = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i + 8 * k]);
+            __m256i x = _mm256_abs_epi32(_mm256_cvtepi16_epi32(v)); // max 32768
+            __m256i s = _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+            __m256i mx = _mm256_max_epi32(x, s);
+            __m256i mi = _mm256_min_epi32(x, s);
+            __m256i e = _mm256_add_epi32(_mm256_mullo_epi32(mx, c_mx), _mm256_mullo_epi32(mi, c_mi));
+            // keep the even lanes in the low half
+            m[k] = _mm256_permutevar8x32_epi32(_mm256_srli_epi32(e, 8), even); // max 22144
+        }
+        __m256i y32 = _mm256_permute2x128_si256(m[0], m[1], 0x20);
+        acc = _mm256_add_epi32(acc, y32);
+        __m128i y = _mm_packus_epi32(_mm256_castsi256_si128(y32), _mm256_extracti128_si256(y32, 1));
+        _mm_storeu_si128((__m128i *)&y_buf[i], y);
+    }
+    *sum += hsum_epi32_avx2(acc);
+    return n;
+}
+#ifndef FIXED_POINT // the SIMD discriminators divide in float
+/// Polynomial atan2 for 32-bit lanes, see atan2_poly().
+TARGET_AVX2
+static inline __m256i atan2_poly_avx2(__m256i y, __m256i x)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i ax = _mm256_abs_epi32(x);
+    __m256i ay = _mm256_abs_epi32(y);
+    __m256i mn = _mm256_min_epi32(ax, ay);
+    __m256i mx = _mm256_max_epi32(_mm256_max_epi32(ax, ay), _mm256_set1_epi32(1));
+    __m256 ratio = _mm256_div_ps(_mm256_cvtepi32_ps(mn), _mm256_cvtepi32_ps(mx));
+    __m256i q = _mm256_cvttps_epi32(_mm256_mul_ps(ratio, _mm256_set1_ps(32768.0f)));
+    __m256i s = _mm256_srai_epi32(_mm256_mullo_epi32(q, q), 15);
+    __m256i p = _mm256_set1_epi32(ATAN_C9);
+    p = _mm256_add_epi32(_mm256_set1_epi32(ATAN_C7), _mm256_srai_epi32(_mm256_mullo_epi32(p, s), 15));
+    p = _mm256_add_epi32(_mm256_set1_epi32(ATAN_C5), _mm256_srai_epi32(_mm256_mullo_epi32(p, s), 15));
+    p = _mm256_add_epi32(_mm256_set1_epi32(ATAN_C3), _mm256_srai_epi32(_mm256_mullo_epi32(p, s), 15));
+    p = _mm256_add_epi32(_mm256_set1_epi32(ATAN_C1), _mm256_srai_epi32(_mm256_mullo_epi32(p, s), 15));
+    __m256i a = _mm256_srai_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(p, q), 15), 2);
+    a = _mm256_blendv_epi8(a, _mm256_sub_epi32(_mm256_set1_epi32(16384), a), _mm256_cmpgt_epi32(ay, ax));
+    a = _mm256_blendv_epi8(a, _mm256_sub_epi32(_mm256_set1_epi32(32768), a), _mm256_cmpgt_epi32(zero, x));
+    a = _mm256_blendv_epi8(a, _mm256_sub_epi32(zero, a), _mm256_cmpgt_epi32(zero, y));
+    return _mm256_min_epi32(a, _mm256_set1_epi32(INT16_MAX));
+}
+
+/// FM discriminator for samples 1 and up, sample 0 needs the previous buffer.
+TARGET_AVX2
+static uint32_t fm_disc_cu8_avx2(uint8_t const *x_buf, int16_t *f_buf, uint32_t len)
+{
+    __m256i const bias = _mm256_set1_epi16(128);
+    __m256i const swap = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+            2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    __m256i const conj = _mm256_set1_epi32((1 << 16) | 0xffff); // -1 for I, +1 for Q
+    uint32_t n = 1;
+    for (; n + 8 <= len; n += 8) {
+        __m256i x0 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)&x_buf[2 * n])), bias);
+        __m256i x1 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)&x_buf[2 * n - 2])), bias);
+        // x[n] * conj(x[n-1])
+        __m256i pr = _mm256_madd_epi16(x0, x1);
+        __m256i pi = _mm256_madd_epi16(x0, _mm256_sign_epi16(_mm256_shuffle_epi8(x1, swap), conj));
+        __m256i a = atan2_poly_avx2(pi, pr);
+        a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, a), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)&f_buf[n], _mm256_castsi256_si128(a));
+    }
+    return n;
+}
+#endif /* FIXED_POINT */
+#endif /* BASEBAND_AVX2 */
+
+#ifdef BASEBAND_NEON
+static uint32_t envelope_cu8_neon(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    uint8x8_t const bias = vdup_n_u8(127);
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        uint8x8x2_t v = vld2_u8(&iq_buf[2 * i]);
+        // 127 - x wraps to the signed difference
+        int16x8_t x = vreinterpretq_s16_u16(vsubl_u8(bias, v.val[0]));
+        int16x8_t y = vreinterpretq_s16_u16(vsubl_u8(bias, v.val[1]));
+        int32x4_t lo = vmlal_s16(vmull_s16(vget_low_s16(x), vget_low_s16(x)), vget_low_s16(y), vget_low_s16(y));
+        int32x4_t hi = vmlal_s16(vmull_s16(vget_high_s16(x), vget_high_s16(x)), vget_high_s16(y), vget_high_s16(y));
+        uint16x8_t e = vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(lo)), vmovn_u32(vreinterpretq_u32_s32(hi))); // max 32768
+        vst1q_u16(&y_buf[i], e);
+        acc = vpadalq_u16(acc, e);
+    }
+    uint32x2_t s = vadd_u32(vget_low_u32(acc), vget_high_u32(acc));
+    *sum += vget_lane_u32(vpadd_u32(s, s), 0);
+    return n;
+}
+
+static uint32_t magnitude_cu8_neon(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    uint8x8_t const bias = vdup_n_u8(128);
+    uint8x8_t const c_mx = vdup_n_u8(122);
+    uint8x8_t const c_mi = vdup_n_u8(51);
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        uint8x8x2_t v = vld2_u8(&iq_buf[2 * i]);
+        uint8x8_t x = vabd_u8(v.val[0], bias); // max 128
+        uint8x8_t y = vabd_u8(v.val[1], bias);
+        uint16x8_t e = vmlal_u8(vmull_u8(vmax_u8(x, y), c_mx), vmin_u8(x, y), c_mi); // max 22144
+        vst1q_u16(&y_buf[i], e);
+        acc = vpadalq_u16(acc, e);
+    }
+    uint32x2_t s = vadd_u32(vget_low_u32(acc), vget_high_u32(acc));
+    *sum += vget_lane_u32(vpadd_u32(s, s), 0);
+    return n;
+}
+
+static uint32_t magnitude_cs16_neon(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len, uint32_t *sum)
+{
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t n = len & ~7u;
+    for (uint32_t i = 0; i < n; i += 8) {
+        int16x8x2_t v = vld2q_s16(&iq_buf[2 * i]);
+        // non-saturating abs, -32768 becomes 32768 unsigned
+        uint16x8_t x = vreinterpretq_u16_s16(vabsq_s16(v.val[0]));
+        uint16x8_t y = vreinterpretq_u16_s16(vabsq_s16(v.val[1]));
+        uint16x8_t mx = vmaxq_u16(x, y);
+        uint16x8_t mi = vminq_u16(x, y);
+        uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(mx), 122), vget_low_u16(mi), 51);
+        uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(mx), 122), vget_high_u16(mi), 51);
+        uint16x8_t e = vcombine_u16(vshrn_n_u32(lo, 8), vshrn_n_u32(hi, 8)); // max 22144
+        vst1q_u16(&y_buf[i], e);
+        acc = vpadalq_u16(acc, e);
+    }
+    uint32x2_t s = vadd_u32(vget_low_u32(acc), vget_high_u32(acc));
+    *sum += vget_lane_u32(vpadd_u32(s, s), 0);
+    return n;
+}
+#if defined(__aarch64__) && !defined(FIXED_POINT)
+/// Polynomial atan2 for 32-bit lanes, see atan2_poly().
+static inline int32x4_t atan2_poly_neon(int32x4_t y, int32x4_t x)
+{
+    int32x4_t const zero = vdupq_n_s32(0);
+    int32x4_t ax = vabsq_s32(x);
+    int32x4_t ay = vabsq_s32(y);
+    int32x4_t mn = vminq_s32(ax, ay);
+    int32x4_t mx = vmaxq_s32(vmaxq_s32(ax, ay), vdupq_n_s32(1));
+    float32x4_t ratio = vdivq_f32(vcvtq_f32_s32(mn), vcvtq_f32_s32(mx));
+    int32x4_t q = vcvtq_s32_f32(vmulq_n_f32(ratio, 32768.0f));
+    int32x4_t s = vshrq_n_s32(vmulq_s32(q, q), 15);
+    int32x4_t p = vdupq_n_s32(ATAN_C9);
+    p = vaddq_s32(vdupq_n_s32(ATAN_C7), vshrq_n_s32(vmulq_s32(p, s), 15));
+    p = vaddq_s32(vdupq_n_s32(ATAN_C5), vshrq_n_s32(vmulq_s32(p, s), 15));
+    p = vaddq_s32(vdupq_n_s32(ATAN_C3), vshrq_n_s32(vmulq_s32(p, s), 15));
+    p = vaddq_s32(vdupq_n_s32(ATAN_C1), vshrq_n_s32(vmulq_s32(p, s), 15));
+    int32x4_t a = vshrq_n_s32(vshrq_n_s32(vmulq_s32(p, q), 15), 2);
+    a = vbslq_s32(vcgtq_s32(ay, ax), vsubq_s32(vdupq_n_s32(16384), a), a);
+    a = vbslq_s32(vcltq_s32(x, zero), vsubq_s32(vdupq_n_s32(32768), a), a);
+    a = vbslq_s32(vcltq_s32(y, zero), vnegq_s32(a), a);
+    return vminq_s32(a, vdupq_n_s32(INT16_MAX));
+}
+
+/// FM discriminator for samples 1 and up, sample 0 needs the previous buffer.
+static uint32_t fm_disc_cu8_neon(uint8_t const *x_buf, int16_t *f_buf, uint32_t len)
+{
+    uint8x8_t const bias = vdup_n_u8(128);
+    uint32_t n = 1;
+    for (; n + 8 <= len; n += 8) {
+        uint8x8x2_t v0 = vld2_u8(&x_buf[2 * n]);
+        uint8x8x2_t v1 = vld2_u8(&x_buf[2 * n - 2]);
+        int16x8_t x0r = vreinterpretq_s16_u16(vsubl_u8(v0.val[0], bias));
+        int16x8_t x0i = vreinterpretq_s16_u16(vsubl_u8(v0.val[1], bias));
+        int16x8_t x1r = vreinterpretq_s16_u16(vsubl_u8(v1.val[0], bias));
+        int16x8_t x1i = vreinterpretq_s16_u16(vsubl_u8(v1.val[1], bias));
+        // x[n] * conj(x[n-1])
+        int32x4_t pr_lo = vmlal_s16(vmull_s16(vget_low_s16(x0r), vget_low_s16(x1r)), vget_low_s16(x0i), vget_low_s16(x1i));
+        int32x4_t pr_hi = vmlal_s16(vmull_s16(vget_high_s16(x0r), vget_high_s16(x1r)), vget_high_s16(x0i), vget_high_s16(x1i));
+        int32x4_t pi_lo = vmlsl_s16(vmull_s16(vget_low_s16(x0i), vget_low_s16(x1r)), vget_low_s16(x0r), vget_low_s16(x1i));
+        int32x4_t pi_hi = vmlsl_s16(vmull_s16(vget_high_s16(x0i), vget_high_s16(x1r)), vget_high_s16(x0r), vget_high_s16(x1i));
+        int16x8_t a = vcombine_s16(vmovn_s32(atan2_poly_neon(pi_lo, pr_lo)), vmovn_s32(atan2_poly_neon(pi_hi, pr_hi)));
+        vst1q_s16(&f_buf[n], a);
+    }
+    return n;
+}
+#endif /* __aarch64__ && !FIXED_POINT */
+#endif /* BASEBAND_NEON */
+
+// Fixed-point arithmetic on Q0.15
+#define F_SCALE 15
+#define S_CONST (1 << F_SCALE)
+#define FIX(x) ((int)(x * S_CONST))
+
+///  [b,a] = butter(1, 0.01) -> 3x tau (95%) ~100 samples
+//static int const lp_a[FILTER_ORDER + 1] = {FIX(1.00000) >> 1, FIX(0.96907) >> 1};
+//static int const lp_b[FILTER_ORDER + 1] = {FIX(0.015466) >> 1, FIX(0.015466) >> 1};
+///  [b,a] = butter(1, 0.05) -> 3x tau (95%) ~20 samples
+static int const lp_a[FILTER_ORDER + 1] = {FIX(1.00000) >> 1, FIX(0.85408) >> 1};
+static int const lp_b[FILTER_ORDER + 1] = {FIX(0.07296) >> 1, FIX(0.07296) >> 1};
+// note that coeffs are prescaled by div 2
+
+/// Number of buffer segments filtered in parallel, as two groups of four lanes.
+#define LP_LANES 8
+/// Samples to run a segment's filter before its start, the truncated IIR then matches the serial result.
+#define LP_WARMUP 128
+/// Shortest buffer for the block filter.
+#define LP_MIN_BLOCK (LP_LANES * LP_WARMUP * 2)
+
+#ifdef BASEBAND_SSE2
+/** Block low pass filter, splits the buffer into segments and runs one IIR per lane.
+
+    Every segment but the first starts from the input LP_WARMUP samples before it,
+    the first-order IIR forgets its state quickly enough for the output to match
+    the scalar filter (in rare cases within 1 LSB at the segment starts).
+*/
+static void low_pass_filter_sse2(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
+{
+    __m128i const coef_a = _mm_set1_epi32(lp_a[1]); // a1 in the low half, 0 in the high half
+    __m128i const coef_b = _mm_set1_epi16((short)lp_b[0]);
+    __m128i const zero   = _mm_setzero_si128();
+
+    uint32_t seg = (len / LP_LANES) & ~3u;
+    int32_t y_last[LP_LANES];
+    int32_t p_last[LP_LANES];
+
+    // lane state: last output and last b * input
+    y_last[0] = state->y[0];
+    p_last[0] = lp_b[0] * state->x[0];
+    int32_t x_tail = x_buf[LP_LANES * seg - 1]; // read before an in-place filter overwrites it
+    for (int k = 1; k < LP_LANES; ++k) {
+        uint32_t pos = k * seg - LP_WARMUP;
+        int16_t y = x_buf[pos - 1];
+        for (uint32_t i = pos; i < k * seg; ++i) {
+            y = (lp_a[1] * y + lp_b[0] * (x_buf[i] + x_buf[i - 1])) >> (F_SCALE - 1);
+        }
+        y_last[k] = y;
+        p_last[k] = lp_b[0] * x_buf[k * seg - 1];
+    }
+
+    __m128i y_vec[2];
+    __m128i p_vec[2];
+    for (int g = 0; g < 2; ++g) {
+        y_vec[g] = _mm_loadu_si128((__m128i const *)&y_last[4 * g]);
+        p_vec[g] = _mm_loadu_si128((__m128i const *)&p_last[4 * g]);
+    }
+
+    for (uint32_t i = 0; i < seg; i += 4) {
+        for (int g = 0; g < 2; ++g) {
+            uint32_t pos = 4 * g * seg + i;
+            // b * x as 32 bit for four samples of each lane
+            __m128i q[4];
+            for (int k = 0; k < 4; ++k) {
+                __m128i x = _mm_loadl_epi64((__m128i const *)&x_buf[pos + k * seg]);
+                q[k] = _mm_unpacklo_epi16(_mm_mullo_epi16(x, coef_b), _mm_mulhi_epu16(x, coef_b));
+            }
+            // transpose to one vector per time step
+            __m128i t0 = _mm_unpacklo_epi32(q[0], q[1]);
+            __m128i t1 = _mm_unpacklo_epi32(q[2], q[3]);
+            __m128i t2 = _mm_unpackhi_epi32(q[0], q[1]);
+            __m128i t3 = _mm_unpackhi_epi32(q[2], q[3]);
+            q[0] = _mm_unpacklo_epi64(t0, t1);
+            q[1] = _mm_unpackhi_epi64(t0, t1);
+            q[2] = _mm_unpacklo_epi64(t2, t3);
+            q[3] = _mm_unpackhi_epi64(t2, t3);
+
+            // the recursion, madd uses the outputs truncated to int16
+            __m128i y[4];
+            __m128i y_prev = y_vec[g];
+            __m128i p_prev = p_vec[g];
+            for (int s = 0; s < 4; ++s) {
+                __m128i u = _mm_add_epi32(q[s], p_prev);
+                y[s]   = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(y_prev, coef_a), u), F_SCALE - 1);
+                y_prev = y[s];
+                p_prev = q[s];
+            }
+            y_vec[g] = y_prev;
+            p_vec[g] = p_prev;
+
+            // truncate to int16 and transpose back to one vector per lane
+            for (int s = 0; s < 4; ++s) {
+                y[s] = _mm_srai_epi32(_mm_slli_epi32(y[s], 16), 16);
+            }
+            __m128i y01 = _mm_packs_epi32(y[0], y[1]);
+            __m128i y23 = _mm_packs_epi32(y[2], y[3]);
+            __m128i a   = _mm_unpacklo_epi16(y01, _mm_srli_si128(y01, 8));
+            __m128i b   = _mm_unpacklo_epi16(y23, _mm_srli_si128(y23, 8));
+            __m128i c   = _mm_unpacklo_epi32(a, b);
+            __m128i d   = _mm_unpackhi_epi32(a, b);
+            _mm_storel_epi64((__m128i *)&y_buf[pos + 0 * seg], c);
+            _mm_storel_epi64((__m128i *)&y_buf[pos + 1 * seg], _mm_unpackhi_epi64(c, zero));
+            _mm_storel_epi64((__m128i *)&y_buf[pos + 2 * seg], d);
+            _mm_storel_epi64((__m128i *)&y_buf[pos + 3 * seg], _mm_unpackhi_epi64(d, zero));
+        }
+    }
+
+    // the remainder continues serially from the last segment
+    for (unsigned long i = LP_LANES * seg; i < len; i++) {
+        int32_t x = x_buf[i];
+        y_buf[i] = (lp_a[1] * y_buf[i - 1] + lp_b[0] * (x + x_tail)) >> (F_SCALE - 1);
+        x_tail   = x;
+    }
+}
+#endif /* BASEBAND_SSE2 */
+
+/// Clamp a decimator sum to int16, with rounding.
+static inline int16_t decim_round(int32_t acc)
+{
+    acc = (acc + (1 << 14)) >> 15;
+    return acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc;
+}
+
+#ifdef BASEBAND_SSE2
+static uint32_t decimate_sse2(int16_t const *w_i, int16_t const *w_q, uint32_t len, int16_t *y_buf, decimator_state_t const *state)
+{
+    int16_t const *taps  = state->taps;
+    unsigned const ntaps = state->num_taps; // a multiple of 16
+    __m128i const round  = _mm_set1_epi32(1 << 14);
+    uint32_t n_out       = 0;
+    for (uint32_t p = state->skip; p < len; p += state->factor) {
+        __m128i acc_i = _mm_setzero_si128();
+        __m128i acc_q = _mm_setzero_si128();
+        for (unsigned k = 0; k < ntaps; k += 8) {
+            __m128i h = _mm_loadu_si128((__m128i const *)&taps[k]);
+            acc_i = _mm_add_epi32(acc_i, _mm_madd_epi16(_mm_loadu_si128((__m128i const *)&w_i[p + k]), h));
+            acc_q = _mm_add_epi32(acc_q, _mm_madd_epi16(_mm_loadu_si128((__m128i const *)&w_q[p + k]), h));
+        }
+        // horizontal sums to [I, Q, x, x], then round and saturate
+        __m128i s = _mm_add_epi32(_mm_unpacklo_epi32(acc_i, acc_q), _mm_unpackhi_epi32(acc_i, acc_q));
+        s = _mm_add_epi32(s, _mm_srli_si128(s, 8));
+        s = _mm_srai_epi32(_mm_add_epi32(s, round), 15);
+        int32_t iq = _mm_cvtsi128_si32(_mm_packs_epi32(s, s));
+        memcpy(&y_buf[2 * n_out], &iq, sizeof(iq));
+        n_out++;
+    }
+    return n_out;
+}
+#endif /* BASEBAND_SSE2 */
+
+#ifdef BASEBAND_NEON
+static inline int32_t hsum_s32_neon(int32x4_t v)
+{
+    int32x2_t s = vadd_s32(vget_low_s32(v), vget_high_s32(v));
+    return vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+static uint32_t decimate_neon(int16_t const *w_i, int16_t const *w_q, uint32_t len, int16_t *y_buf, decimator_state_t const *state)
+{
+    int16_t const *taps  = state->taps;
+    unsigned const ntaps = state->num_taps; // a multiple of 16
+    uint32_t n_out       = 0;
+    for (uint32_t p = state->skip; p < len; p += state->factor) {
+        int32x4_t acc_i = vdupq_n_s32(0);
+        int32x4_t acc_q = vdupq_n_s32(0);
+        for (unsigned k = 0; k < ntaps; k += 8) {
+            int16x8_t h = vld1q_s16(&taps[k]);
+            int16x8_t x = vld1q_s16(&w_i[p + k]);
+            int16x8_t y = vld1q_s16(&w_q[p + k]);
+            acc_i = vmlal_s16(acc_i, vget_low_s16(x), vget_low_s16(h));
+            acc_i = vmlal_s16(acc_i, vget_high_s16(x), vget_high_s16(h));
+            acc_q = vmlal_s16(acc_q, vget_low_s16(y), vget_low_s16(h));
+            acc_q = vmlal_s16(acc_q, vget_high_s16(y), vget_high_s16(h));
+        }
+        y_buf[2 * n_out]     = decim_round(hsum_s32_neon(acc_i));
+        y_buf[2 * n_out + 1] = decim_round(hsum_s32_neon(acc_q));
+        n_out++;
+    }
+    return n_out;
+}
+#endif /* BASEBAND_NEON */
+
+// The mixers look up cos and sin of each sample in the table as the scalar nco_mix(),
+// the complex multiply, rounding, and saturation are done on 8 samples at once.
+
+#ifdef BASEBAND_SSE2
+/// Rotate 4 interleaved samples by the table entries of 4 phases, returns I and sets Q, as 32 bit.
+static inline __m128i mix4_sse2(__m128i x, uint32_t *phase, uint32_t step, __m128i *r_q)
+{
+    __m128i const round = _mm_set1_epi32(1 << 14);
+    // pairs of (c, s) and (-s, c), the madd sums are I * c + Q * s and Q * c - I * s
+    int16_t cs[8];
+    int16_t sc[8];
+    for (int j = 0; j < 4; ++j) {
+        int16_t const *rot = nco_rot[*phase >> (32 - NCO_TABLE_BITS)];
+        memcpy(&cs[2 * j], &rot[0], 2 * sizeof(int16_t));
+        memcpy(&sc[2 * j], &rot[2], 2 * sizeof(int16_t));
+        *phase += step;
+    }
+    __m128i rot_i = _mm_loadu_si128((__m128i const *)cs);
+    __m128i rot_q = _mm_loadu_si128((__m128i const *)sc);
+    __m128i y_i = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, rot_i), round), 15);
+    *r_q = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, rot_q), round), 15);
+    return y_i;
+}
+
+static uint32_t mix_cs16_sse2(int16_t const *x_buf, int16_t *w_i, int16_t *w_q, uint32_t len, uint32_t *phase, uint32_t step)
+{
+    uint32_t n = len & ~7u;
+    for (uint32_t k = 0; k < n; k += 8) {
+        __m128i q_lo, q_hi;
+        __m128i i_lo = mix4_sse2(_mm_loadu_si128((__m128i const *)&x_buf[2 * k]), phase, step, &q_lo);
+        __m128i i_hi = mix4_sse2(_mm_loadu_si128((__m128i const *)&x_buf[2 * k + 8]), phase, step, &q_hi);
+        _mm_storeu_si128((__m128i *)&w_i[k], _mm_packs_epi32(i_lo, i_hi));
+        _mm_storeu_si128((__m128i *)&w_q[k], _mm_packs_epi32(q_lo, q_hi));
+    }
+    return n;
+}
+
+static uint32_t mix_cu8_sse2(uint8_t const *x_buf, int16_t *w_i, int16_t *w_q, uint32_t len, uint32_t *phase, uint32_t step)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(128);
+    uint32_t n = len & ~7u;
+    for (uint32_t k = 0; k < n; k += 8) {
+        __m128i v = _mm_loadu_si128((__m128i const *)&x_buf[2 * k]);
+        __m128i q_lo, q_hi;
+        __m128i i_lo = mix4_sse2(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias), phase, step, &q_lo);
+        __m128i i_hi = mix4_sse2(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias), phase, step, &q_hi);
+        _mm_storeu_si128((__m128i *)&w_i[k], _mm_packs_epi32(i_lo, i_hi));
+        _mm_storeu_si128((__m128i *)&w_q[k], _mm_packs_epi32(q_lo, q_hi));
+    }
+    return n;
+}
+#endif /* BASEBAND_SSE2 */
+
+#ifdef BASEBAND_NEON
+/// Rotate 8 deinterleaved samples by the table entries of 8 phases.
+static inline void mix8_neon(int16x8_t x_i, int16x8_t x_q, uint32_t *phase, uint32_t step, int16_t *w_i, int16_t *w_q)
+{
+    int16_t c[8];
+    int16_t s[8];
+    for (int j = 0; j < 8; ++j) {
+        int16_t const *rot = nco_rot[*phase >> (32 - NCO_TABLE_BITS)];
+        c[j] = rot[0];
+        s[j] = rot[1];
+        *phase += step;
+    }
+    int16x8_t vc = vld1q_s16(c);
+    int16x8_t vs = vld1q_s16(s);
+    int32x4_t i_lo = vmlal_s16(vmull_s16(vget_low_s16(x_i), vget_low_s16(vc)), vget_low_s16(x_q), vget_low_s16(vs));
+    int32x4_t i_hi = vmlal_s16(vmull_s16(vget_high_s16(x_i), vget_high_s16(vc)), vget_high_s16(x_q), vget_high_s16(vs));
+    int32x4_t q_lo = vmlsl_s16(vmull_s16(vget_low_s16(x_q), vget_low_s16(vc)), vget_low_s16(x_i), vget_low_s16(vs));
+    int32x4_t q_hi = vmlsl_s16(vmull_s16(vget_high_s16(x_q), vget_high_s16(vc)), vget_high_s16(x_i), vget_high_s16(vs));
+    // round, shift, and saturate as nco_mix()
+    vst1q_s16(w_i, vcombine_s16(vqrshrn_n_s32(i_lo, 15), vqrshrn_n_s32(i_hi, 15)));
+    vst1q_s16(w_q, vcombine_s16(vqrshrn_n_s32(q_lo, 15), vqrshrn_n_s32(q_hi, 15)));
+}
+
+static uint32_t mix_cs16_neon(int16_t const *x_buf, int16_t *w_i, int16_t *w_q, uint32_t len, uint32_t *phase, uint32_t step)
+{
+    uint32_t n = len & ~7u;
+    for (uint32_t k = 0; k < n; k += 8) {
+        int16x8x2_t x = vld2q_s16(&x_buf[2 * k]);
+        mix8_neon(x.val[0], x.val[1], phase, step, &w_i[k], &w_q[k]);
+    }
+    return n;
+}
+
+static uint32_t mix_cu8_neon(uint8_t const *x_buf, int16_t *w_i, int16_t *w_q, uint32_t len, uint32_t *phase, uint32_t step)
+{
+    int16x8_t const bias = vdupq_n_s16(128);
+    uint32_t n = len & ~7u;
+    for (uint32_t k = 0; k < n; k += 8) {
+        uint8x8x2_t x = vld2_u8(&x_buf[2 * k]);
+        int16x8_t x_i = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x.val[0])), bias);
+        int16x8_t x_q = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x.val[1])), bias);
+        mix8_neon(x_i, x_q, phase, step, &w_i[k], &w_q[k]);
+    }
+    return n;
+}
+#endif /* BASEBAND_NEON */
+
+#ifdef BASEBAND_SSE2
+static unsigned long convert_cu8_f32_sse2(uint8_t const *src, float *dst, unsigned long n)
+{
+    __m128i const zero  = _mm_setzero_si128();
+    __m128i const bias  = _mm_set1_epi16(128);
+    __m128 const scale  = _mm_set1_ps(1.0f / 0x80);
+    unsigned long i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x  = _mm_loadu_si128((__m128i const *)&src[i]);
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(x, zero), bias);
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(x, zero), bias);
+        // sign extend to 32 bit by shifting down the high half
+        _mm_storeu_ps(&dst[i],      _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), scale));
+        _mm_storeu_ps(&dst[i + 4],  _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), scale));
+        _mm_storeu_ps(&dst[i + 8],  _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), scale));
+        _mm_storeu_ps(&dst[i + 12], _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), scale));
+    }
+    return i;
+}
+
+static unsigned long convert_s16_f32_sse2(int16_t const *src, float *dst, unsigned long n)
+{
+    __m128 const scale = _mm_set1_ps(1.0f / 0x8000);
+    unsigned long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((__m128i const *)&src[i]);
+        _mm_storeu_ps(&dst[i],     _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), scale));
+        _mm_storeu_ps(&dst[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), scale));
+    }
+    return i;
+}
+#endif /* BASEBAND_SSE2 */
+
+#ifdef BASEBAND_NEON
+static unsigned long convert_cu8_f32_neon(uint8_t const *src, float *dst, unsigned long n)
+{
+    int16x8_t const bias = vdupq_n_s16(128);
+    unsigned long i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = vld1q_u8(&src[i]);
+        int16x8_t lo = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(x))), bias);
+        int16x8_t hi = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(x))), bias);
+        vst1q_f32(&dst[i],      vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), 1.0f / 0x80));
+        vst1q_f32(&dst[i + 4],  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), 1.0f / 0x80));
+        vst1q_f32(&dst[i + 8],  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), 1.0f / 0x80));
+        vst1q_f32(&dst[i + 12], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), 1.0f / 0x80));
+    }
+    return i;
+}
+
+static unsigned long convert_s16_f32_neon(int16_t const *src, float *dst, unsigned long n)
+{
+    unsigned long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(&src[i]);
+        vst1q_f32(&dst[i],     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.0f / 0x8000));
+        vst1q_f32(&dst[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1.0f / 0x8000));
+    }
+    return i;
+}
+#endif /* BASEBAND_NEON */
+
+static int simd_supported(baseband_simd_t simd)
+{
+    switch (simd) {
+    case BASEBAND_SIMD_NONE:
+        return 1;
+#ifdef BASEBAND_SSE2
+    case BASEBAND_SIMD_SSE2:
+        return 1;
+#endif
+#ifdef BASEBAND_AVX2
+    case BASEBAND_SIMD_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef BASEBAND_NEON
+    case BASEBAND_SIMD_NEON:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+int baseband_set_simd(baseband_simd_t simd)
+{
+    if (!simd_supported(simd))
+        return -1;
+
+    struct baseband_kernels k = {.simd = simd};
+#ifdef BASEBAND_SSE2
+    if (simd == BASEBAND_SIMD_SSE2) {
+        k.envelope_cu8   = envelope_cu8_sse2;
+        k.magnitude_cu8  = magnitude_cu8_sse2;
+        k.magnitude_cs16 = magnitude_cs16_sse2;
+        k.low_pass       = low_pass_filter_sse2;
+        k.decimate       = decimate_sse2;
+        k.mix_cu8        = mix_cu8_sse2;
+        k.mix_cs16       = mix_cs16_sse2;
+        k.convert_cu8_f32 = convert_cu8_f32_sse2;
+        k.convert_s16_f32 = convert_s16_f32_sse2;
+    }
+#endif
+#ifdef BASEBAND_AVX2
+    if (simd == BASEBAND_SIMD_AVX2) {
+        k.envelope_cu8   = envelope_cu8_avx2;
+        k.magnitude_cu8  = magnitude_cu8_avx2;
+        k.magnitude_cs16 = magnitude_cs16_avx2;
+        k.low_pass       = low_pass_filter_sse2;
+#ifndef FIXED_POINT
+        k.fm_disc_cu8    = fm_disc_cu8_avx2;
+#endif
+        k.decimate       = decimate_sse2;
+        k.mix_cu8        = mix_cu8_sse2;
+        k.mix_cs16       = mix_cs16_sse2;
+        k.convert_cu8_f32 = convert_cu8_f32_sse2;
+        k.convert_s16_f32 = convert_s16_f32_sse2;
+    }
+#endif
+#ifdef BASEBAND_NEON
+    if (simd == BASEBAND_SIMD_NEON) {
+        k.envelope_cu8   = envelope_cu8_neon;
+        k.magnitude_cu8  = magnitude_cu8_neon;
+        k.magnitude_cs16 = magnitude_cs16_neon;
+        k.decimate       = decimate_neon;
+        k.mix_cu8        = mix_cu8_neon;
+        k.mix_cs16       = mix_cs16_neon;
+        k.convert_cu8_f32 = convert_cu8_f32_neon;
+        k.convert_s16_f32 = convert_s16_f32_neon;
+#if defined(__aarch64__) && !defined(FIXED_POINT)
+        k.fm_disc_cu8    = fm_disc_cu8_neon;
+#endif
+    }
+#endif
+    kernels = k;
+    return 0;
+}
+
+int baseband_set_scalar(int scalar)
+{
+    int prev    = scalar_only;
+    scalar_only = scalar;
+    return prev;
+}
+
+baseband_simd_t baseband_get_simd(void)
+{
+    return kernels.simd;
+}
+
+char const *baseband_simd_name(baseband_simd_t simd)
+{
+    switch (simd) {
+    case BASEBAND_SIMD_NONE:
+        return "none";
+    case BASEBAND_SIMD_SSE2:
+        return "SSE2";
+    case BASEBAND_SIMD_AVX2:
+        return "AVX2";
+    case BASEBAND_SIMD_NEON:
+        return "NEON";
+    default:
+        return "unknown";
+    }
+}
+
+#ifdef FIXED_POINT
+/// log2(v) in 1/256 steps for v > 0, the fraction bits by repeated squaring of the mantissa.
+static int32_t log2_q8(uint32_t v)
+{
+    int32_t e = 31;
+    while (!(v & 0x80000000u)) {
+        v <<= 1;
+        e--;
+    }
+    uint64_t m = v; // mantissa in [1, 2) as Q31
+    int32_t r  = e * 256;
+    for (int32_t bit = 128; bit; bit >>= 1) {
+        m = (m * m) >> 31;
+        if (m >= ((uint64_t)1 << 32)) {
+            m >>= 1;
+            r += bit;
+        }
+    }
+    return r;
+}
+
+// 10*log10(2) in Q16, the offsets 10*log10(16384) and 20*log10(16384) in 1/256 dB
+#define DB_PER_LOG2_Q16 197283
+#define AMP_DB_OFFSET   10789
+#define MAG_DB_OFFSET   21578
+
+db_level_t baseband_amp_sum_db(uint32_t sum, uint32_t n)
+{
+    if (n == 0 || sum < n)
+        return -AMP_DB_OFFSET;
+    return (db_level_t)(((int64_t)(log2_q8(sum) - log2_q8(n)) * DB_PER_LOG2_Q16) >> 16) - AMP_DB_OFFSET;
+}
+
+db_level_t baseband_mag_sum_db(uint32_t sum, uint32_t n)
+{
+    if (n == 0 || sum < n)
+        return -MAG_DB_OFFSET;
+    return (db_level_t)(((int64_t)(log2_q8(sum) - log2_q8(n)) * DB_PER_LOG2_Q16) >> 15) - MAG_DB_OFFSET;
+}
+#else
+db_level_t baseband_amp_sum_db(uint32_t sum, uint32_t n)
+{
+    return n > 0 && sum >= n ? AMP_TO_DB((float)sum / n) : AMP_TO_DB(1);
+}
+
+db_level_t baseband_mag_sum_db(uint32_t sum, uint32_t n)
+{
+    return n > 0 && sum >= n ? MAG_TO_DB((float)sum / n) : MAG_TO_DB(1);
+}
+#endif
+
+static uint32_t envelope_sum_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    unsigned long i = 0;
     uint32_t sum = 0;
-    for (i = 0; i < len; i++) {
+    if (active_kernels()->envelope_cu8)
+        i = active_kernels()->envelope_cu8(iq_buf, y_buf, len, &sum);
+    for (; i < len; i++) {
         y_buf[i] = scaled_squares[iq_buf[2 * i ]] + scaled_squares[iq_buf[2 * i + 1]];
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? AMP_TO_DB((float)sum / len) : AMP_TO_DB(1);
+    return sum;
+}
+
+// This will give a noisy envelope of OOK/ASK signals.
+// Subtract the bias (-128) and get an envelope estimation.
+db_level_t envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    uint32_t sum = envelope_sum_cu8(iq_buf, y_buf, len);
+    return baseband_amp_sum_db(sum, len);
 }
 
 /// This will give a noisy envelope of OOK/ASK signals.
 /// Subtracts the bias (-128) and calculates the norm (scaled by 16384).
 /// Using a LUT is slower for O1 and above.
-float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+db_level_t envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -57,16 +997,16 @@ float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len
         y_buf[i]  = x * x + y * y; // max 32768, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? AMP_TO_DB((float)sum / len) : AMP_TO_DB(1);
+    return baseband_amp_sum_db(sum, len);
 }
 
-/// 122/128, 51/128 Magnitude Estimator for CU8 (SIMD has min/max).
-/// Note that magnitude emphasizes quiet signals / deemphasizes loud signals.
-float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+static uint32_t magnitude_sum_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
-    unsigned long i;
+    unsigned long i = 0;
     uint32_t sum = 0;
-    for (i = 0; i < len; i++) {
+    if (active_kernels()->magnitude_cu8)
+        i = active_kernels()->magnitude_cu8(iq_buf, y_buf, len, &sum);
+    for (; i < len; i++) {
         uint16_t x = abs(iq_buf[2 * i] - 128);
         uint16_t y = abs(iq_buf[2 * i + 1] - 128);
         uint16_t mi = x < y ? x : y;
@@ -75,11 +1015,19 @@ float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i] = mag_est; // max 22144, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+    return sum;
+}
+
+/// 122/128, 51/128 Magnitude Estimator for CU8 (SIMD has min/max).
+/// Note that magnitude emphasizes quiet signals / deemphasizes loud signals.
+db_level_t magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    uint32_t sum = magnitude_sum_cu8(iq_buf, y_buf, len);
+    return baseband_mag_sum_db(sum, len);
 }
 
 /// True Magnitude for CU8 (sqrt can SIMD but float is slow).
-float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+db_level_t magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -89,15 +1037,16 @@ float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i]  = (uint16_t)(sqrt(x * x + y * y) * 128.0); // max 181, scaled 23170, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+    return baseband_mag_sum_db(sum, len);
 }
 
-/// 122/128, 51/128 Magnitude Estimator for CS16 (SIMD has min/max).
-float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+static uint32_t magnitude_sum_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
-    unsigned long i;
+    unsigned long i = 0;
     uint32_t sum = 0;
-    for (i = 0; i < len; i++) {
+    if (active_kernels()->magnitude_cs16)
+        i = active_kernels()->magnitude_cs16(iq_buf, y_buf, len, &sum);
+    for (; i < len; i++) {
         uint32_t x = abs(iq_buf[2 * i]);
         uint32_t y = abs(iq_buf[2 * i + 1]);
         uint32_t mi = x < y ? x : y;
@@ -106,11 +1055,18 @@ float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i] = mag_est >> 8; // max 5668864, scaled 22144, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+    return sum;
+}
+
+/// 122/128, 51/128 Magnitude Estimator for CS16 (SIMD has min/max).
+db_level_t magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    uint32_t sum = magnitude_sum_cs16(iq_buf, y_buf, len);
+    return baseband_mag_sum_db(sum, len);
 }
 
 /// True Magnitude for CS16 (sqrt can SIMD but float is slow).
-float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+db_level_t magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -120,14 +1076,79 @@ float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i]  = (int)sqrt(x * x + y * y) >> 1; // max 46341, scaled 23170, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+    return baseband_mag_sum_db(sum, len);
 }
 
+/// Same level as envelope_detect() or magnitude_est_cu8(), from every stride-th sample only.
+db_level_t baseband_level_estimate_cu8(uint8_t const *iq_buf, uint32_t len, int use_mag_est, unsigned stride)
+{
+    uint32_t sum = 0;
+    uint32_t n   = 0;
+    for (uint32_t i = 0; i < len; i += stride, ++n) {
+        if (use_mag_est) {
+            uint16_t x  = abs(iq_buf[2 * i] - 128);
+            uint16_t y  = abs(iq_buf[2 * i + 1] - 128);
+            uint16_t mi = x < y ? x : y;
+            uint16_t mx = x > y ? x : y;
+            sum += 122 * mx + 51 * mi;
+        } else {
+            sum += scaled_squares[iq_buf[2 * i]] + scaled_squares[iq_buf[2 * i + 1]];
+        }
+    }
+    if (use_mag_est)
+        return baseband_mag_sum_db(sum, n);
+    return baseband_amp_sum_db(sum, n);
+}
+
+/// Same level as magnitude_est_cs16(), from every stride-th sample only.
+db_level_t baseband_level_estimate_cs16(int16_t const *iq_buf, uint32_t len, unsigned stride)
+{
+    uint32_t sum = 0;
+    uint32_t n   = 0;
+    for (uint32_t i = 0; i < len; i += stride, ++n) {
+        uint32_t x  = abs(iq_buf[2 * i]);
+        uint32_t y  = abs(iq_buf[2 * i + 1]);
+        uint32_t mi = x < y ? x : y;
+        uint32_t mx = x > y ? x : y;
+        sum += (122 * mx + 51 * mi) >> 8;
+    }
+    return baseband_mag_sum_db(sum, n);
+}
+
+/// The 6 dB bin of a peak amplitude of 0 to 128.
+static inline unsigned iq_stats_bin(unsigned peak)
+{
+    unsigned bin = 0;
+    while (bin < IQ_STATS_BINS - 1 && peak < (64u >> bin))
+        bin++;
+    return bin;
+}
+
+void baseband_iq_stats_cu8(uint8_t const *iq_buf, uint32_t len, unsigned stride, iq_stats_t *stats)
+{
+    for (uint32_t i = 0; i < len; i += stride) {
+        uint8_t x = iq_buf[2 * i];
+        uint8_t y = iq_buf[2 * i + 1];
+        unsigned ax = abs(x - 128);
+        unsigned ay = abs(y - 128);
+        stats->clipped += x == 0 || x == 255 || y == 0 || y == 255;
+        stats->bins[iq_stats_bin(ax > ay ? ax : ay)]++;
+        stats->samples++;
+    }
+}
+
+void baseband_iq_stats_cs16(int16_t const *iq_buf, uint32_t len, unsigned stride, iq_stats_t *stats)
+{
+    for (uint32_t i = 0; i < len; i += stride) {
+        unsigned ax = abs(iq_buf[2 * i]);
+        unsigned ay = abs(iq_buf[2 * i + 1]);
+        unsigned peak = ax > ay ? ax : ay;
+        stats->clipped += peak >= 0x7ff0;
+        stats->bins[iq_stats_bin(peak >> 8)]++;
+        stats->samples++;
+    }
+}
 
-// Fixed-point arithmetic on Q0.15
-#define F_SCALE 15
-#define S_CONST (1 << F_SCALE)
-#define FIX(x) ((int)(x * S_CONST))
 
 /** Something that might look like a IIR lowpass filter.
 
@@ -140,27 +1161,34 @@ float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 */
 void baseband_low_pass_filter(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
 {
-    ///  [b,a] = butter(1, 0.01) -> 3x tau (95%) ~100 samples
-    //static int const a[FILTER_ORDER + 1] = {FIX(1.00000) >> 1, FIX(0.96907) >> 1};
-    //static int const b[FILTER_ORDER + 1] = {FIX(0.015466) >> 1, FIX(0.015466) >> 1};
-    ///  [b,a] = butter(1, 0.05) -> 3x tau (95%) ~20 samples
-    static int const a[FILTER_ORDER + 1] = {FIX(1.00000) >> 1, FIX(0.85408) >> 1};
-    static int const b[FILTER_ORDER + 1] = {FIX(0.07296) >> 1, FIX(0.07296) >> 1};
-    // note that coeffs are prescaled by div 2
+    int const *a = lp_a;
+    int const *b = lp_b;
 
     // Prevent out of bounds access
     if (len < FILTER_ORDER) {
         return;
     }
 
-    // Calculate first sample
-    y_buf[0] = (a[1] * state->y[0] + b[0] * (x_buf[0] + state->x[0])) >> (F_SCALE - 1); // note: prescaled, b[0]==b[1]
-    for (unsigned long i = 1; i < len; i++) {
-        y_buf[i] = (a[1] * y_buf[i - 1] + b[0] * (x_buf[i] + x_buf[i - 1])) >> (F_SCALE - 1); // note: prescaled, b[0]==b[1]
+    // Keep the last inputs, the output may overwrite them when filtering in place
+    int16_t x_last[FILTER_ORDER];
+    memcpy(x_last, &x_buf[len - FILTER_ORDER], FILTER_ORDER * sizeof (int16_t));
+
+    if (active_kernels()->low_pass && len >= LP_MIN_BLOCK) {
+        active_kernels()->low_pass(x_buf, y_buf, len, state);
+    }
+    else {
+        int32_t x_prev = state->x[0];
+        int32_t y_prev = state->y[0];
+        for (unsigned long i = 0; i < len; i++) {
+            int32_t x = x_buf[i];
+            y_buf[i]  = (a[1] * y_prev + b[0] * (x + x_prev)) >> (F_SCALE - 1); // note: prescaled, b[0]==b[1]
+            y_prev    = y_buf[i];
+            x_prev    = x;
+        }
     }
 
     // Save last samples
-    memcpy(state->x, &x_buf[len - FILTER_ORDER], FILTER_ORDER * sizeof (int16_t));
+    memcpy(state->x, x_last, FILTER_ORDER * sizeof (int16_t));
     memcpy(state->y, &y_buf[len - FILTER_ORDER], FILTER_ORDER * sizeof (int16_t));
 }
 
@@ -197,6 +1225,82 @@ static int16_t atan2_int16(int32_t y, int32_t x)
     return angle;
 }
 
+/** Branchless polynomial implementation of atan2() with int16_t normalized output.
+
+    Folds the angle into the first octant, the ratio is an IEEE division so that the
+    SIMD variants give the same result, the polynomial is evaluated in Q15.
+    Error max 0.0002 radians.
+    @param y Numerator (imaginary value of complex vector)
+    @param x Denominator (real value of complex vector)
+    @return angle in radians (Pi equals INT16_MAX)
+*/
+static int16_t atan2_poly(int32_t y, int32_t x)
+{
+    int32_t const ax = abs(x);
+    int32_t const ay = abs(y);
+    int32_t const mn = ax < ay ? ax : ay;
+    int32_t const mx = ax < ay ? ay : ax;
+#ifdef FIXED_POINT
+    int32_t const q = (int32_t)(((int64_t)mn << 15) / (mx ? mx : 1));
+#else
+    float const ratio = (float)mn / (float)(mx ? mx : 1);
+    int32_t const q = (int32_t)(ratio * 32768.0f);
+#endif
+    int32_t const s = (q * q) >> 15;
+
+    int32_t p = ATAN_C9;
+    p = ATAN_C7 + ((p * s) >> 15);
+    p = ATAN_C5 + ((p * s) >> 15);
+    p = ATAN_C3 + ((p * s) >> 15);
+    p = ATAN_C1 + ((p * s) >> 15);
+    int32_t a = ((p * q) >> 15) >> 2; // first octant, Pi/4 equals 8192
+
+    a = ay > ax ? 16384 - a : a;
+    a = x < 0 ? 32768 - a : a;
+    a = y < 0 ? -a : a;
+    return a > INT16_MAX ? INT16_MAX : a;
+}
+
+/// FM demodulation with the polynomial discriminator, the discriminator runs on whole blocks first.
+static void baseband_demod_FM_poly(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_samples, demodfm_state_t *state)
+{
+    int32_t const *alp = state->alp_16;
+    int32_t const *blp = state->blp_16;
+
+    if (!num_samples)
+        return;
+
+    // Instantaneous frequency into y_buf
+    y_buf[0] = atan2_poly((x_buf[1] - 128) * state->xr - (x_buf[0] - 128) * state->xi,
+            (x_buf[0] - 128) * state->xr + (x_buf[1] - 128) * state->xi);
+    unsigned long n = 1;
+    if (active_kernels()->fm_disc_cu8)
+        n = active_kernels()->fm_disc_cu8(x_buf, y_buf, num_samples);
+    for (; n < num_samples; n++) {
+        int16_t x0r = x_buf[2 * n] - 128;
+        int16_t x0i = x_buf[2 * n + 1] - 128;
+        int16_t x1r = x_buf[2 * n - 2] - 128;
+        int16_t x1i = x_buf[2 * n - 1] - 128;
+        y_buf[n] = atan2_poly(x0i * x1r - x0r * x1i, x0r * x1r + x0i * x1i);
+    }
+
+    // Low pass filter in place
+    int16_t x1f = state->xf;
+    int16_t y0f = state->yf;
+    for (n = 0; n < num_samples; n++) {
+        int16_t x0f = y_buf[n];
+        y0f      = (alp[1] * y0f + blp[0] * (x0f + x1f)) >> (F_SCALE - 1); // note: prescaled, blp[0]==blp[1]
+        x1f      = x0f;
+        y_buf[n] = y0f;
+    }
+
+    // Store newest sample for next run
+    state->xr = x_buf[2 * num_samples - 2] - 128;
+    state->xi = x_buf[2 * num_samples - 1] - 128;
+    state->xf = x1f;
+    state->yf = y0f;
+}
+
 /// Fast Instantaneous frequency and Low Pass filter, CU8 samples
 void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
 {
@@ -221,6 +1325,11 @@ void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_s
         state->blp_16[1] = FIX(gain);
         state->rate      = samp_rate;
     }
+    if (state->poly) {
+        baseband_demod_FM_poly(x_buf, y_buf, num_samples, state);
+        return;
+    }
+
     int32_t const *alp = state->alp_16;
     int32_t const *blp = state->blp_16;
 
@@ -290,6 +1399,35 @@ static int32_t atan2_int32(int32_t y, int32_t x)
     return angle;
 }
 
+/// Polynomial atan2() with int32_t normalized output, see atan2_poly().
+static int32_t atan2_poly64(int64_t y, int64_t x)
+{
+    int64_t const ax = x < 0 ? -x : x;
+    int64_t const ay = y < 0 ? -y : y;
+    int64_t const mn = ax < ay ? ax : ay;
+    int64_t const mx = ax < ay ? ay : ax;
+#ifdef FIXED_POINT
+    int32_t const q = (int32_t)(((int64_t)mn << 15) / (mx ? mx : 1));
+#else
+    float const ratio = (float)mn / (float)(mx ? mx : 1);
+    int32_t const q = (int32_t)(ratio * 32768.0f);
+#endif
+    int32_t const s = (q * q) >> 15;
+
+    int32_t p = ATAN_C9;
+    p = ATAN_C7 + ((p * s) >> 15);
+    p = ATAN_C5 + ((p * s) >> 15);
+    p = ATAN_C3 + ((p * s) >> 15);
+    p = ATAN_C1 + ((p * s) >> 15);
+    int32_t a = ((p * q) >> 15) >> 2;
+
+    a = ay > ax ? 16384 - a : a;
+    a = x < 0 ? 32768 - a : a;
+    a = y < 0 ? -a : a;
+    a = a > INT16_MAX ? INT16_MAX : a;
+    return a * 65536;
+}
+
 /// Fast Instantaneous frequency and Low Pass filter, CS16 samples.
 void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
 {
@@ -316,6 +1454,7 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
     }
     int64_t const *alp = state->alp_32;
     int64_t const *blp = state->blp_32;
+    int const poly     = state->poly;
 
     // Pre-feed old sample
     int32_t x0r = state->xr; // IQ sample: x[n], real
@@ -340,7 +1479,7 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
         pr = (int64_t)x0r * x1r + (int64_t)x0i * x1i; // May exactly overflow an int32_t (-32768*-32768 + -32768*-32768)
         pi = (int64_t)x0i * x1r - (int64_t)x0r * x1i;
         // xlp = (int32_t)((atan2f(pi, pr) / M_PI) * INT32_MAX); // Floating point implementation
-        x0f = atan2_int32(pi, pr); // Integer implementation
+        x0f = poly ? atan2_poly64(pi, pr) : atan2_int32(pi, pr); // Integer implementation
         // xlp = atan2_int16(pi >> 16, pr >> 16) << 16; // Integer implementation, truncated
         // xlp = pi; // Cheat and use only imaginary part (works OK, but is amplitude sensitive)
         // Low pass filter
@@ -356,7 +1495,329 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
     state->yf = y0f;
 }
 
+/// Input samples per decimator block, history and block stay in cache.
+#define DECIM_BLOCK 4096
+
+void baseband_decimator_init(decimator_state_t *state, unsigned factor)
+{
+    memset(state, 0, sizeof(*state));
+    if (factor < 2)
+        return;
+    if (factor > DECIM_MAX_FACTOR)
+        factor = DECIM_MAX_FACTOR;
+    unsigned const n = factor * DECIM_TAPS_PER_PHASE;
+
+    // Hamming windowed sinc with the cutoff at the output Nyquist frequency
+    double h[DECIM_MAX_TAPS];
+    double sum = 0.0;
+    for (unsigned k = 0; k < n; ++k) {
+        double t = k - (n - 1) / 2.0;
+        double x = M_PI * t / factor;
+        double sinc = x == 0.0 ? 1.0 : sin(x) / x;
+        h[k] = sinc * (0.54 - 0.46 * cos(2.0 * M_PI * k / (n - 1)));
+        sum += h[k];
+    }
+    int32_t total = 0;
+    for (unsigned k = 0; k < n; ++k) {
+        state->taps[k] = (int16_t)lrint(h[k] / sum * 32768.0);
+        total += state->taps[k];
+    }
+    // unity DC gain, put the rounding error on the center taps
+    state->taps[n / 2] += (32768 - total) / 2;
+    state->taps[n / 2 - 1] += 32768 - total - (32768 - total) / 2;
+
+    state->factor   = factor;
+    state->num_taps = n;
+}
+
+void baseband_decimator_set_shift(decimator_state_t *state, int32_t freq_offset, uint32_t samp_rate)
+{
+    if (!samp_rate)
+        return;
+    // the step wraps around, negative offsets are steps above half a turn
+    state->nco_step = (uint32_t)(int64_t)llround((double)freq_offset / samp_rate * 4294967296.0);
+}
+
+/// Multiply by exp(-j phase), i.e. rotate the sample clockwise, with rounding.
+static inline void nco_mix(int32_t x_i, int32_t x_q, uint32_t phase, int16_t *y_i, int16_t *y_q)
+{
+    unsigned idx = phase >> (32 - NCO_TABLE_BITS);
+    int32_t c = nco_cos[idx];
+    int32_t s = nco_cos[(idx - NCO_TABLE_SIZE / 4) & (NCO_TABLE_SIZE - 1)]; // sin is cos a quarter turn back
+    int32_t r_i = (x_i * c + x_q * s + (1 << 14)) >> 15;
+    int32_t r_q = (x_q * c - x_i * s + (1 << 14)) >> 15;
+    *y_i = r_i > INT16_MAX ? INT16_MAX : r_i < INT16_MIN ? INT16_MIN : r_i;
+    *y_q = r_q > INT16_MAX ? INT16_MAX : r_q < INT16_MIN ? INT16_MIN : r_q;
+}
+
+static uint32_t decimate_scalar(int16_t const *w_i, int16_t const *w_q, uint32_t len, int16_t *y_buf, decimator_state_t const *state)
+{
+    int16_t const *taps  = state->taps;
+    unsigned const ntaps = state->num_taps;
+    uint32_t n_out       = 0;
+    for (uint32_t p = state->skip; p < len; p += state->factor) {
+        int32_t acc_i = 0;
+        int32_t acc_q = 0;
+        for (unsigned k = 0; k < ntaps; ++k) {
+            acc_i += taps[k] * w_i[p + k];
+            acc_q += taps[k] * w_q[p + k];
+        }
+        y_buf[2 * n_out]     = decim_round(acc_i);
+        y_buf[2 * n_out + 1] = decim_round(acc_q);
+        n_out++;
+    }
+    return n_out;
+}
+
+/// Decimate one block in the work buffers, which hold num_taps - 1 history samples ahead of len new samples.
+static uint32_t decimate_block(int16_t *w_i, int16_t *w_q, uint32_t len, int16_t *y_buf, decimator_state_t *state)
+{
+    unsigned const ntaps = state->num_taps;
+    uint32_t n_out = active_kernels()->decimate ? active_kernels()->decimate(w_i, w_q, len, y_buf, state)
+                                      : decimate_scalar(w_i, w_q, len, y_buf, state);
+    state->skip = state->skip + n_out * state->factor - len;
+    // keep the newest samples as history
+    memmove(w_i, &w_i[len], sizeof(int16_t) * (ntaps - 1));
+    memmove(w_q, &w_q[len], sizeof(int16_t) * (ntaps - 1));
+    return n_out;
+}
+
+uint32_t baseband_decimate_cu8(uint8_t const *x_buf, uint8_t *y_buf, uint32_t len, decimator_state_t *state)
+{
+    int16_t w_i[DECIM_MAX_TAPS + DECIM_BLOCK];
+    int16_t w_q[DECIM_MAX_TAPS + DECIM_BLOCK];
+    int16_t out[2 * (DECIM_BLOCK / 2 + 1)];
+    unsigned const hist = state->num_taps - 1;
+    uint32_t n_out = 0;
+
+    memcpy(w_i, state->hist_i, sizeof(int16_t) * hist);
+    memcpy(w_q, state->hist_q, sizeof(int16_t) * hist);
+    for (uint32_t pos = 0; pos < len; pos += DECIM_BLOCK) {
+        uint32_t n = len - pos < DECIM_BLOCK ? len - pos : DECIM_BLOCK;
+        if (state->nco_step) {
+            uint32_t k = active_kernels()->mix_cu8 ? active_kernels()->mix_cu8(&x_buf[2 * pos], &w_i[hist], &w_q[hist], n, &state->nco_phase, state->nco_step) : 0;
+            for (; k < n; ++k) {
+                nco_mix(x_buf[2 * (pos + k)] - 128, x_buf[2 * (pos + k) + 1] - 128, state->nco_phase,
+                        &w_i[hist + k], &w_q[hist + k]);
+                state->nco_phase += state->nco_step;
+            }
+        } else {
+            for (uint32_t k = 0; k < n; ++k) {
+                w_i[hist + k] = x_buf[2 * (pos + k)] - 128;
+                w_q[hist + k] = x_buf[2 * (pos + k) + 1] - 128;
+            }
+        }
+        uint32_t m = decimate_block(w_i, w_q, n, out, state);
+        // the output never overtakes the input, so this may be done in place
+        for (uint32_t k = 0; k < 2 * m; ++k) {
+            int v = out[k] + 128;
+            y_buf[2 * n_out + k] = v > 255 ? 255 : v < 0 ? 0 : v;
+        }
+        n_out += m;
+    }
+    memcpy(state->hist_i, w_i, sizeof(int16_t) * hist);
+    memcpy(state->hist_q, w_q, sizeof(int16_t) * hist);
+    return n_out;
+}
+
+uint32_t baseband_decimate_cs16(int16_t const *x_buf, int16_t *y_buf, uint32_t len, decimator_state_t *state)
+{
+    int16_t w_i[DECIM_MAX_TAPS + DECIM_BLOCK];
+    int16_t w_q[DECIM_MAX_TAPS + DECIM_BLOCK];
+    unsigned const hist = state->num_taps - 1;
+    uint32_t n_out = 0;
+
+    memcpy(w_i, state->hist_i, sizeof(int16_t) * hist);
+    memcpy(w_q, state->hist_q, sizeof(int16_t) * hist);
+    for (uint32_t pos = 0; pos < len; pos += DECIM_BLOCK) {
+        uint32_t n = len - pos < DECIM_BLOCK ? len - pos : DECIM_BLOCK;
+        if (state->nco_step) {
+            uint32_t k = active_kernels()->mix_cs16 ? active_kernels()->mix_cs16(&x_buf[2 * pos], &w_i[hist], &w_q[hist], n, &state->nco_phase, state->nco_step) : 0;
+            for (; k < n; ++k) {
+                nco_mix(x_buf[2 * (pos + k)], x_buf[2 * (pos + k) + 1], state->nco_phase,
+                        &w_i[hist + k], &w_q[hist + k]);
+                state->nco_phase += state->nco_step;
+            }
+        } else {
+            for (uint32_t k = 0; k < n; ++k) {
+                w_i[hist + k] = x_buf[2 * (pos + k)];
+                w_q[hist + k] = x_buf[2 * (pos + k) + 1];
+            }
+        }
+        // the output never overtakes the input, so this may be done in place
+        n_out += decimate_block(w_i, w_q, n, &y_buf[2 * n_out], state);
+    }
+    memcpy(state->hist_i, w_i, sizeof(int16_t) * hist);
+    memcpy(state->hist_q, w_q, sizeof(int16_t) * hist);
+    return n_out;
+}
+
+/// Samples to demodulate ahead of a skipped span, the low pass settles in about 10 samples.
+#define FM_LAZY_WARMUP 64
+/// Minimum samples per lazy demodulation step.
+#define FM_LAZY_CHUNK 1024
+
+void baseband_demod_FM_lazy_start(demodfm_lazy_t *lazy, void const *iq_buf, int cs16, int16_t *fm_buf, uint32_t len,
+        uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    lazy->iq_buf    = iq_buf;
+    lazy->cs16      = cs16;
+    lazy->fm_buf    = fm_buf;
+    lazy->len       = len;
+    lazy->pos       = 0;
+    lazy->samp_rate = samp_rate;
+    lazy->low_pass  = low_pass;
+    lazy->state     = state;
+}
+
+uint32_t baseband_demod_FM_lazy(demodfm_lazy_t *lazy, uint32_t end)
+{
+    if (end >= lazy->len)
+        end = lazy->len - 1;
+    if (!lazy->len || end < lazy->pos)
+        return lazy->pos;
+
+    uint32_t start = lazy->pos;
+    if (end - start > FM_LAZY_WARMUP) {
+        // skip ahead, re-seed the previous IQ sample and let the low pass settle
+        start = end - FM_LAZY_WARMUP;
+        if (lazy->cs16) {
+            int16_t const *iq = lazy->iq_buf;
+            lazy->state->xr   = iq[2 * start - 2];
+            lazy->state->xi   = iq[2 * start - 1];
+        } else {
+            uint8_t const *iq = lazy->iq_buf;
+            lazy->state->xr   = iq[2 * start - 2] - 128;
+            lazy->state->xi   = iq[2 * start - 1] - 128;
+        }
+    }
+    uint32_t stop = end + 1 > start + FM_LAZY_CHUNK ? end + 1 : start + FM_LAZY_CHUNK;
+    if (stop > lazy->len)
+        stop = lazy->len;
+
+    if (lazy->cs16) {
+        int16_t const *iq = lazy->iq_buf;
+        baseband_demod_FM_cs16(&iq[2 * start], &lazy->fm_buf[start], stop - start, lazy->samp_rate, lazy->low_pass, lazy->state);
+    } else {
+        uint8_t const *iq = lazy->iq_buf;
+        baseband_demod_FM(&iq[2 * start], &lazy->fm_buf[start], stop - start, lazy->samp_rate, lazy->low_pass, lazy->state);
+    }
+    lazy->pos = stop;
+    return stop;
+}
+
+void baseband_demod_FM_lazy_finish(demodfm_lazy_t *lazy)
+{
+    if (lazy->pos < lazy->len)
+        baseband_demod_FM_lazy(lazy, lazy->len - 1);
+}
+
+/// Samples per block for the fused demodulators, IQ and all outputs of a block stay in cache.
+static uint32_t fused_block_len = BASEBAND_FUSED_BLOCK_MAX;
+
+void baseband_set_fused_block(uint32_t len)
+{
+    fused_block_len = len < 64 ? 64 : len > BASEBAND_FUSED_BLOCK_MAX ? BASEBAND_FUSED_BLOCK_MAX : len;
+}
+
+uint32_t baseband_get_fused_block(void)
+{
+    return fused_block_len;
+}
+
+db_level_t baseband_demod_fused_cu8(uint8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, uint32_t len, int use_mag_est,
+        filter_state_t *lp_state, uint32_t samp_rate, float low_pass, demodfm_state_t *fm_state)
+{
+    uint16_t env_buf[BASEBAND_FUSED_BLOCK_MAX];
+    uint32_t block = fused_block_len;
+    uint32_t sum   = 0;
+    for (uint32_t pos = 0; pos < len; pos += block) {
+        uint32_t n = len - pos < block ? len - pos : block;
+        if (use_mag_est)
+            sum += magnitude_sum_cu8(&iq_buf[2 * pos], env_buf, n);
+        else
+            sum += envelope_sum_cu8(&iq_buf[2 * pos], env_buf, n);
+        baseband_low_pass_filter(env_buf, &am_buf[pos], n, lp_state);
+        if (fm_buf)
+            baseband_demod_FM(&iq_buf[2 * pos], &fm_buf[pos], n, samp_rate, low_pass, fm_state);
+    }
+    if (use_mag_est)
+        return baseband_mag_sum_db(sum, len);
+    else
+        return baseband_amp_sum_db(sum, len);
+}
+
+db_level_t baseband_demod_fused_cs16(int16_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, uint32_t len,
+        filter_state_t *lp_state, uint32_t samp_rate, float low_pass, demodfm_state_t *fm_state)
+{
+    uint16_t env_buf[BASEBAND_FUSED_BLOCK_MAX];
+    uint32_t block = fused_block_len;
+    uint32_t sum   = 0;
+    for (uint32_t pos = 0; pos < len; pos += block) {
+        uint32_t n = len - pos < block ? len - pos : block;
+        sum += magnitude_sum_cs16(&iq_buf[2 * pos], env_buf, n);
+        baseband_low_pass_filter(env_buf, &am_buf[pos], n, lp_state);
+        if (fm_buf)
+            baseband_demod_FM_cs16(&iq_buf[2 * pos], &fm_buf[pos], n, samp_rate, low_pass, fm_state);
+    }
+    return baseband_mag_sum_db(sum, len);
+}
+
+void baseband_convert_cu8_cs16(uint8_t const *src, int16_t *dst, unsigned long n)
+{
+    // scale Q0.7 to Q0.15, plain loops the compiler vectorizes
+    for (unsigned long i = 0; i < n; ++i)
+        dst[i] = (int16_t)((src[i] - 128) * 256);
+}
+
+void baseband_convert_cs16_cu8(int16_t const *src, uint8_t *dst, unsigned long n)
+{
+    // scale Q0.15 to Q0.7, rounding toward zero
+    for (unsigned long i = 0; i < n; ++i)
+        dst[i] = (uint8_t)(src[i] / 256 + 128);
+}
+
+void baseband_convert_cu8_cs8(uint8_t const *src, int8_t *dst, unsigned long n)
+{
+    for (unsigned long i = 0; i < n; ++i)
+        dst[i] = (int8_t)(src[i] - 128);
+}
+
+void baseband_convert_cs16_cs8(int16_t const *src, int8_t *dst, unsigned long n)
+{
+    for (unsigned long i = 0; i < n; ++i)
+        dst[i] = (int8_t)(src[i] >> 8);
+}
+
+void baseband_convert_cu8_f32(uint8_t const *src, float *dst, unsigned long n, unsigned stride)
+{
+    unsigned long i = 0;
+    if (stride == 1 && active_kernels()->convert_cu8_f32)
+        i = active_kernels()->convert_cu8_f32(src, dst, n);
+    for (; i < n; ++i)
+        dst[i] = (src[i * stride] - 128) * (1.0f / 0x80); // scale from Q0.7
+}
+
+void baseband_convert_s16_f32(int16_t const *src, float *dst, unsigned long n, unsigned stride)
+{
+    unsigned long i = 0;
+    if (stride == 1 && active_kernels()->convert_s16_f32)
+        i = active_kernels()->convert_s16_f32(src, dst, n);
+    for (; i < n; ++i)
+        dst[i] = src[i * stride] * (1.0f / 0x8000); // scale from Q0.15
+}
+
 void baseband_init(void)
 {
     calc_squares();
+    calc_nco_table();
+
+    // pick the best available kernels
+    if (!kernels.simd) {
+        baseband_simd_t const prefer[] = {BASEBAND_SIMD_AVX2, BASEBAND_SIMD_SSE2, BASEBAND_SIMD_NEON};
+        for (unsigned i = 0; i < sizeof(prefer) / sizeof(*prefer); ++i) {
+            if (baseband_set_simd(prefer[i]) == 0)
+                break;
+        }
+    }
 }
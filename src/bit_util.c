@@ -15,6 +15,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 uint8_t reverse8(uint8_t x)
 {
     x = (x & 0xF0) >> 4 | (x & 0x0F) << 4;
@@ -33,7 +37,20 @@ uint32_t reverse32(uint32_t x)
 
 void reflect_bytes(uint8_t message[], unsigned num_bytes)
 {
-    for (unsigned i = 0; i < num_bytes; ++i) {
+    unsigned i = 0;
+#if defined(__aarch64__)
+    // RBIT reverses each byte of a vector
+    for (; i + 16 <= num_bytes; i += 16) {
+        vst1q_u8(&message[i], vrbitq_u8(vld1q_u8(&message[i])));
+    }
+#endif
+    for (; i + 8 <= num_bytes; i += 8) {
+        uint64_t x;
+        memcpy(&x, &message[i], sizeof(x));
+        x = reverse8_u64(x);
+        memcpy(&message[i], &x, sizeof(x));
+    }
+    for (; i < num_bytes; ++i) {
         message[i] = reverse8(message[i]);
     }
 }
@@ -47,24 +64,37 @@ uint8_t reflect4(uint8_t x)
 
 void reflect_nibbles(uint8_t message[], unsigned num_bytes)
 {
-    for (unsigned i = 0; i < num_bytes; ++i) {
+    unsigned i = 0;
+    for (; i + 8 <= num_bytes; i += 8) {
+        uint64_t x;
+        memcpy(&x, &message[i], sizeof(x));
+        x = reflect4_u64(x);
+        memcpy(&message[i], &x, sizeof(x));
+    }
+    for (; i < num_bytes; ++i) {
         message[i] = reflect4(message[i]);
     }
 }
 
 unsigned extract_nibbles_4b1s(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
 {
+    unsigned num_bytes = (offset_bits + num_bits + 7) / 8;
     unsigned ret = 0;
 
     while (num_bits >= 5) {
-        uint16_t bits = (message[offset_bits / 8] << 8) | message[(offset_bits / 8) + 1];
-        bits >>= 11 - (offset_bits % 8); // align 5 bits to LSB
-        if ((bits & 1) != 1)
-            break; // stuff-bit error
-        *dst++ = (bits >> 1) & 0xf;
-        ret += 1;
-        offset_bits += 5;
-        num_bits -= 5;
+        // up to 11 nibbles of 5 bits from each word
+        uint64_t word  = peek_bits64(message, num_bytes, offset_bits);
+        unsigned count = num_bits / 5 < 11 ? num_bits / 5 : 11;
+        for (unsigned i = 0; i < count; ++i) {
+            unsigned bits = word >> 59; // 5 bits in the LSBs
+            if ((bits & 1) != 1)
+                return ret; // stuff-bit error
+            *dst++ = (bits >> 1) & 0xf;
+            ret += 1;
+            word <<= 5;
+        }
+        offset_bits += count * 5;
+        num_bits -= count * 5;
     }
 
     return ret;
@@ -72,77 +102,79 @@ unsigned extract_nibbles_4b1s(uint8_t *message, unsigned offset_bits, unsigned n
 
 unsigned extract_bytes_uart(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
 {
+    unsigned num_bytes = (offset_bits + num_bits + 7) / 8;
     unsigned ret = 0;
 
     while (num_bits >= 10) {
-        int startb = message[offset_bits / 8] >> (7 - (offset_bits % 8));
-        offset_bits += 1;
-        int datab = message[offset_bits / 8];
-        if (offset_bits % 8) {
-            datab = (message[offset_bits / 8] << 8) | message[offset_bits / 8 + 1];
-            datab >>= 8 - (offset_bits % 8);
-        }
-        offset_bits += 8;
-        int stopb = message[offset_bits / 8] >> (7 - (offset_bits % 8));
-        offset_bits += 1;
-        if ((startb & 1) != 0)
-            break; // start-bit error
-        if ((stopb & 1) != 1)
-            break; // stop-bit error
-        *dst++ = reverse8(datab & 0xff);
-        ret += 1;
-        num_bits -= 10;
+        // up to 5 frames of 10 bits from each word
+        uint64_t word  = peek_bits64(message, num_bytes, offset_bits);
+        unsigned count = num_bits / 10 < 5 ? num_bits / 10 : 5;
+        for (unsigned i = 0; i < count; ++i) {
+            unsigned frame = word >> 54; // start bit, 8 data bits, stop bit
+            if ((frame & 0x200) != 0)
+                return ret; // start-bit error
+            if ((frame & 1) != 1)
+                return ret; // stop-bit error
+            *dst++ = reverse8((frame >> 1) & 0xff);
+            ret += 1;
+            word <<= 10;
+        }
+        offset_bits += count * 10;
+        num_bits -= count * 10;
     }
 
     return ret;
 }
 
-static unsigned symbol_match(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t symbol)
-{
-    unsigned symbol_len = symbol & 0x1f;
-
-    // check required len
-    if (num_bits < symbol_len) {
-        return 0;
-    }
+/// A symbol of up to 27 bits prepared for matching against the MSBs of a word.
+typedef struct {
+    unsigned len;
+    uint64_t mask;
+    uint64_t bits;
+} symbol_mask_t;
 
-    // match each bit otherwise abort
-    for (unsigned pos = 0; pos < symbol_len; ++pos) {
-        unsigned m_pos = offset_bits + pos;
-        unsigned m_bit = message[m_pos / 8] >> (7 - (m_pos % 8));
-        unsigned s_bit = symbol >> (31 - pos);
-        if ((m_bit & 1) != (s_bit & 1)) {
-            return 0;
-        }
+static symbol_mask_t symbol_prepare(uint32_t symbol)
+{
+    symbol_mask_t sym = {.len = symbol & 0x1f};
+    if (sym.len) {
+        sym.mask = ~(uint64_t)0 << (64 - sym.len);
+        sym.bits = ((uint64_t)symbol << 32) & sym.mask;
     }
+    return sym;
+}
 
-    return symbol_len;
+static inline int symbol_match(symbol_mask_t const *sym, uint64_t word, unsigned num_bits)
+{
+    return sym->len && num_bits >= sym->len && (word & sym->mask) == sym->bits;
 }
 
 unsigned extract_bits_symbols(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t zero, uint32_t one, uint32_t sync, uint8_t *dst)
 {
-    unsigned zero_len = zero & 0x1f;
-    unsigned one_len  = one & 0x1f;
-    unsigned sync_len = sync & 0x1f;
+    symbol_mask_t const zero_sym = symbol_prepare(zero);
+    symbol_mask_t const one_sym  = symbol_prepare(one);
+    symbol_mask_t const sync_sym = symbol_prepare(sync);
+    unsigned num_bytes = (offset_bits + num_bits + 7) / 8;
 
     unsigned dst_len = 0;
 
     while (num_bits >= 1) {
+        // the word holds at least 57 bits, enough for any symbol
+        uint64_t word = peek_bits64(message, num_bytes, offset_bits);
         // TODO: match the longest symbol first
-        if (symbol_match(message, offset_bits, num_bits, sync)) {
-            offset_bits += sync_len;
-            num_bits -= sync_len;
+        if (symbol_match(&sync_sym, word, num_bits)) {
+            offset_bits += sync_sym.len;
+            num_bits -= sync_sym.len;
             // just skip
         }
-        else if (symbol_match(message, offset_bits, num_bits, zero)) {
-            offset_bits += zero_len;
-            num_bits -= zero_len;
+        else if (symbol_match(&zero_sym, word, num_bits)) {
+            offset_bits += zero_sym.len;
+            num_bits -= zero_sym.len;
             // no need to set a zero
             dst_len += 1;
         }
-        else if (symbol_match(message, offset_bits, num_bits, one)) {
-            offset_bits += one_len;
-            num_bits -= one_len;
+        else if (symbol_match(&one_sym, word, num_bits)) {
+            offset_bits += one_sym.len;
+            num_bits -= one_sym.len;
             dst[dst_len / 8] |= 0x80 >> (dst_len % 8);
             dst_len += 1;
         }
@@ -193,11 +225,179 @@ uint8_t crc7(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8
     return remainder >> 1 & 0x7f; // discard the LSB
 }
 
+/// CRC tables of the common polynomials, msb first, entry i is the crc of byte i.
+/// Other polynomials are computed a bit at a time.
+static uint8_t const crc8_31_table[256] = {
+        0x00, 0x31, 0x62, 0x53, 0xc4, 0xf5, 0xa6, 0x97, 0xb9, 0x88, 0xdb, 0xea, 0x7d, 0x4c, 0x1f, 0x2e,
+        0x43, 0x72, 0x21, 0x10, 0x87, 0xb6, 0xe5, 0xd4, 0xfa, 0xcb, 0x98, 0xa9, 0x3e, 0x0f, 0x5c, 0x6d,
+        0x86, 0xb7, 0xe4, 0xd5, 0x42, 0x73, 0x20, 0x11, 0x3f, 0x0e, 0x5d, 0x6c, 0xfb, 0xca, 0x99, 0xa8,
+        0xc5, 0xf4, 0xa7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7c, 0x4d, 0x1e, 0x2f, 0xb8, 0x89, 0xda, 0xeb,
+        0x3d, 0x0c, 0x5f, 0x6e, 0xf9, 0xc8, 0x9b, 0xaa, 0x84, 0xb5, 0xe6, 0xd7, 0x40, 0x71, 0x22, 0x13,
+        0x7e, 0x4f, 0x1c, 0x2d, 0xba, 0x8b, 0xd8, 0xe9, 0xc7, 0xf6, 0xa5, 0x94, 0x03, 0x32, 0x61, 0x50,
+        0xbb, 0x8a, 0xd9, 0xe8, 0x7f, 0x4e, 0x1d, 0x2c, 0x02, 0x33, 0x60, 0x51, 0xc6, 0xf7, 0xa4, 0x95,
+        0xf8, 0xc9, 0x9a, 0xab, 0x3c, 0x0d, 0x5e, 0x6f, 0x41, 0x70, 0x23, 0x12, 0x85, 0xb4, 0xe7, 0xd6,
+        0x7a, 0x4b, 0x18, 0x29, 0xbe, 0x8f, 0xdc, 0xed, 0xc3, 0xf2, 0xa1, 0x90, 0x07, 0x36, 0x65, 0x54,
+        0x39, 0x08, 0x5b, 0x6a, 0xfd, 0xcc, 0x9f, 0xae, 0x80, 0xb1, 0xe2, 0xd3, 0x44, 0x75, 0x26, 0x17,
+        0xfc, 0xcd, 0x9e, 0xaf, 0x38, 0x09, 0x5a, 0x6b, 0x45, 0x74, 0x27, 0x16, 0x81, 0xb0, 0xe3, 0xd2,
+        0xbf, 0x8e, 0xdd, 0xec, 0x7b, 0x4a, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xc2, 0xf3, 0xa0, 0x91,
+        0x47, 0x76, 0x25, 0x14, 0x83, 0xb2, 0xe1, 0xd0, 0xfe, 0xcf, 0x9c, 0xad, 0x3a, 0x0b, 0x58, 0x69,
+        0x04, 0x35, 0x66, 0x57, 0xc0, 0xf1, 0xa2, 0x93, 0xbd, 0x8c, 0xdf, 0xee, 0x79, 0x48, 0x1b, 0x2a,
+        0xc1, 0xf0, 0xa3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1a, 0x2b, 0xbc, 0x8d, 0xde, 0xef,
+        0x82, 0xb3, 0xe0, 0xd1, 0x46, 0x77, 0x24, 0x15, 0x3b, 0x0a, 0x59, 0x68, 0xff, 0xce, 0x9d, 0xac,
+};
+
+static uint8_t const crc8_07_table[256] = {
+        0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15, 0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+        0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65, 0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+        0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5, 0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+        0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85, 0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+        0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2, 0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+        0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2, 0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+        0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32, 0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+        0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42, 0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+        0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c, 0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+        0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec, 0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+        0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c, 0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+        0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c, 0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+        0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b, 0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+        0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b, 0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+        0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb, 0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+        0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+};
+
+static uint16_t const crc16_1021_table[256] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+        0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+        0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+        0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+        0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+        0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+        0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+        0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+        0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+        0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+        0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+        0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+        0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+        0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+        0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+        0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+        0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+        0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+        0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+        0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+        0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+        0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+        0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+        0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+        0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+        0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+        0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+        0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+        0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+        0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+        0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+static uint16_t const crc16_8005_table[256] = {
+        0x0000, 0x8005, 0x800f, 0x000a, 0x801b, 0x001e, 0x0014, 0x8011,
+        0x8033, 0x0036, 0x003c, 0x8039, 0x0028, 0x802d, 0x8027, 0x0022,
+        0x8063, 0x0066, 0x006c, 0x8069, 0x0078, 0x807d, 0x8077, 0x0072,
+        0x0050, 0x8055, 0x805f, 0x005a, 0x804b, 0x004e, 0x0044, 0x8041,
+        0x80c3, 0x00c6, 0x00cc, 0x80c9, 0x00d8, 0x80dd, 0x80d7, 0x00d2,
+        0x00f0, 0x80f5, 0x80ff, 0x00fa, 0x80eb, 0x00ee, 0x00e4, 0x80e1,
+        0x00a0, 0x80a5, 0x80af, 0x00aa, 0x80bb, 0x00be, 0x00b4, 0x80b1,
+        0x8093, 0x0096, 0x009c, 0x8099, 0x0088, 0x808d, 0x8087, 0x0082,
+        0x8183, 0x0186, 0x018c, 0x8189, 0x0198, 0x819d, 0x8197, 0x0192,
+        0x01b0, 0x81b5, 0x81bf, 0x01ba, 0x81ab, 0x01ae, 0x01a4, 0x81a1,
+        0x01e0, 0x81e5, 0x81ef, 0x01ea, 0x81fb, 0x01fe, 0x01f4, 0x81f1,
+        0x81d3, 0x01d6, 0x01dc, 0x81d9, 0x01c8, 0x81cd, 0x81c7, 0x01c2,
+        0x0140, 0x8145, 0x814f, 0x014a, 0x815b, 0x015e, 0x0154, 0x8151,
+        0x8173, 0x0176, 0x017c, 0x8179, 0x0168, 0x816d, 0x8167, 0x0162,
+        0x8123, 0x0126, 0x012c, 0x8129, 0x0138, 0x813d, 0x8137, 0x0132,
+        0x0110, 0x8115, 0x811f, 0x011a, 0x810b, 0x010e, 0x0104, 0x8101,
+        0x8303, 0x0306, 0x030c, 0x8309, 0x0318, 0x831d, 0x8317, 0x0312,
+        0x0330, 0x8335, 0x833f, 0x033a, 0x832b, 0x032e, 0x0324, 0x8321,
+        0x0360, 0x8365, 0x836f, 0x036a, 0x837b, 0x037e, 0x0374, 0x8371,
+        0x8353, 0x0356, 0x035c, 0x8359, 0x0348, 0x834d, 0x8347, 0x0342,
+        0x03c0, 0x83c5, 0x83cf, 0x03ca, 0x83db, 0x03de, 0x03d4, 0x83d1,
+        0x83f3, 0x03f6, 0x03fc, 0x83f9, 0x03e8, 0x83ed, 0x83e7, 0x03e2,
+        0x83a3, 0x03a6, 0x03ac, 0x83a9, 0x03b8, 0x83bd, 0x83b7, 0x03b2,
+        0x0390, 0x8395, 0x839f, 0x039a, 0x838b, 0x038e, 0x0384, 0x8381,
+        0x0280, 0x8285, 0x828f, 0x028a, 0x829b, 0x029e, 0x0294, 0x8291,
+        0x82b3, 0x02b6, 0x02bc, 0x82b9, 0x02a8, 0x82ad, 0x82a7, 0x02a2,
+        0x82e3, 0x02e6, 0x02ec, 0x82e9, 0x02f8, 0x82fd, 0x82f7, 0x02f2,
+        0x02d0, 0x82d5, 0x82df, 0x02da, 0x82cb, 0x02ce, 0x02c4, 0x82c1,
+        0x8243, 0x0246, 0x024c, 0x8249, 0x0258, 0x825d, 0x8257, 0x0252,
+        0x0270, 0x8275, 0x827f, 0x027a, 0x826b, 0x026e, 0x0264, 0x8261,
+        0x0220, 0x8225, 0x822f, 0x022a, 0x823b, 0x023e, 0x0234, 0x8231,
+        0x8213, 0x0216, 0x021c, 0x8219, 0x0208, 0x820d, 0x8207, 0x0202,
+};
+
+static uint16_t const crc16_3d65_table[256] = {
+        0x0000, 0x3d65, 0x7aca, 0x47af, 0xf594, 0xc8f1, 0x8f5e, 0xb23b,
+        0xd64d, 0xeb28, 0xac87, 0x91e2, 0x23d9, 0x1ebc, 0x5913, 0x6476,
+        0x91ff, 0xac9a, 0xeb35, 0xd650, 0x646b, 0x590e, 0x1ea1, 0x23c4,
+        0x47b2, 0x7ad7, 0x3d78, 0x001d, 0xb226, 0x8f43, 0xc8ec, 0xf589,
+        0x1e9b, 0x23fe, 0x6451, 0x5934, 0xeb0f, 0xd66a, 0x91c5, 0xaca0,
+        0xc8d6, 0xf5b3, 0xb21c, 0x8f79, 0x3d42, 0x0027, 0x4788, 0x7aed,
+        0x8f64, 0xb201, 0xf5ae, 0xc8cb, 0x7af0, 0x4795, 0x003a, 0x3d5f,
+        0x5929, 0x644c, 0x23e3, 0x1e86, 0xacbd, 0x91d8, 0xd677, 0xeb12,
+        0x3d36, 0x0053, 0x47fc, 0x7a99, 0xc8a2, 0xf5c7, 0xb268, 0x8f0d,
+        0xeb7b, 0xd61e, 0x91b1, 0xacd4, 0x1eef, 0x238a, 0x6425, 0x5940,
+        0xacc9, 0x91ac, 0xd603, 0xeb66, 0x595d, 0x6438, 0x2397, 0x1ef2,
+        0x7a84, 0x47e1, 0x004e, 0x3d2b, 0x8f10, 0xb275, 0xf5da, 0xc8bf,
+        0x23ad, 0x1ec8, 0x5967, 0x6402, 0xd639, 0xeb5c, 0xacf3, 0x9196,
+        0xf5e0, 0xc885, 0x8f2a, 0xb24f, 0x0074, 0x3d11, 0x7abe, 0x47db,
+        0xb252, 0x8f37, 0xc898, 0xf5fd, 0x47c6, 0x7aa3, 0x3d0c, 0x0069,
+        0x641f, 0x597a, 0x1ed5, 0x23b0, 0x918b, 0xacee, 0xeb41, 0xd624,
+        0x7a6c, 0x4709, 0x00a6, 0x3dc3, 0x8ff8, 0xb29d, 0xf532, 0xc857,
+        0xac21, 0x9144, 0xd6eb, 0xeb8e, 0x59b5, 0x64d0, 0x237f, 0x1e1a,
+        0xeb93, 0xd6f6, 0x9159, 0xac3c, 0x1e07, 0x2362, 0x64cd, 0x59a8,
+        0x3dde, 0x00bb, 0x4714, 0x7a71, 0xc84a, 0xf52f, 0xb280, 0x8fe5,
+        0x64f7, 0x5992, 0x1e3d, 0x2358, 0x9163, 0xac06, 0xeba9, 0xd6cc,
+        0xb2ba, 0x8fdf, 0xc870, 0xf515, 0x472e, 0x7a4b, 0x3de4, 0x0081,
+        0xf508, 0xc86d, 0x8fc2, 0xb2a7, 0x009c, 0x3df9, 0x7a56, 0x4733,
+        0x2345, 0x1e20, 0x598f, 0x64ea, 0xd6d1, 0xebb4, 0xac1b, 0x917e,
+        0x475a, 0x7a3f, 0x3d90, 0x00f5, 0xb2ce, 0x8fab, 0xc804, 0xf561,
+        0x9117, 0xac72, 0xebdd, 0xd6b8, 0x6483, 0x59e6, 0x1e49, 0x232c,
+        0xd6a5, 0xebc0, 0xac6f, 0x910a, 0x2331, 0x1e54, 0x59fb, 0x649e,
+        0x00e8, 0x3d8d, 0x7a22, 0x4747, 0xf57c, 0xc819, 0x8fb6, 0xb2d3,
+        0x59c1, 0x64a4, 0x230b, 0x1e6e, 0xac55, 0x9130, 0xd69f, 0xebfa,
+        0x8f8c, 0xb2e9, 0xf546, 0xc823, 0x7a18, 0x477d, 0x00d2, 0x3db7,
+        0xc83e, 0xf55b, 0xb2f4, 0x8f91, 0x3daa, 0x00cf, 0x4760, 0x7a05,
+        0x1e73, 0x2316, 0x64b9, 0x59dc, 0xebe7, 0xd682, 0x912d, 0xac48,
+};
+
+static uint8_t const *crc8_table(uint8_t polynomial)
+{
+    return polynomial == 0x31 ? crc8_31_table : polynomial == 0x07 ? crc8_07_table : NULL;
+}
+
+static uint16_t const *crc16_table(uint16_t polynomial)
+{
+    switch (polynomial) {
+    case 0x1021: return crc16_1021_table;
+    case 0x8005: return crc16_8005_table;
+    case 0x3d65: return crc16_3d65_table;
+    default: return NULL;
+    }
+}
+
 uint8_t crc8(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8_t init)
 {
     uint8_t remainder = init;
     unsigned byte, bit;
 
+    uint8_t const *table = crc8_table(polynomial);
+    if (table) {
+        for (byte = 0; byte < nBytes; ++byte) {
+            remainder = table[remainder ^ message[byte]];
+        }
+        return remainder;
+    }
+
     for (byte = 0; byte < nBytes; ++byte) {
         remainder ^= message[byte];
         for (bit = 0; bit < 8; ++bit) {
@@ -254,6 +454,14 @@ uint16_t crc16(uint8_t const message[], unsigned nBytes, uint16_t polynomial, ui
     uint16_t remainder = init;
     unsigned byte, bit;
 
+    uint16_t const *table = crc16_table(polynomial);
+    if (table) {
+        for (byte = 0; byte < nBytes; ++byte) {
+            remainder = (uint16_t)(remainder << 8) ^ table[(remainder >> 8) ^ message[byte]];
+        }
+        return remainder;
+    }
+
     for (byte = 0; byte < nBytes; ++byte) {
         remainder ^= message[byte] << 8;
         for (bit = 0; bit < 8; ++bit) {
@@ -274,17 +482,12 @@ uint8_t lfsr_digest8(uint8_t const message[], unsigned bytes, uint8_t gen, uint8
     for (unsigned k = 0; k < bytes; ++k) {
         uint8_t data = message[k];
         for (int i = 7; i >= 0; --i) {
-            // fprintf(stderr, "key is %02x\n", key);
-            // XOR key into sum if data bit is set
-            if ((data >> i) & 1)
-                sum ^= key;
+            // XOR key into sum if data bit is set, masks instead of branches on the data
+            sum ^= key & -((data >> i) & 1);
 
             // roll the key right (actually the lsb is dropped here)
             // and apply the gen (needs to include the dropped lsb as msb)
-            if (key & 1)
-                key = (key >> 1) ^ gen;
-            else
-                key = (key >> 1);
+            key = (key >> 1) ^ (gen & -(key & 1));
         }
     }
     return sum;
@@ -298,18 +501,12 @@ uint8_t lfsr_digest8_reflect(uint8_t const message[], int bytes, uint8_t gen, ui
         uint8_t data = message[k];
         // Process individual bits of each byte (reflected)
         for (int i = 0; i < 8; ++i) {
-            // fprintf(stderr, "key is %02x\n", key);
-            // XOR key into sum if data bit is set
-            if ((data >> i) & 1) {
-                sum ^= key;
-            }
+            // XOR key into sum if data bit is set, masks instead of branches on the data
+            sum ^= key & -((data >> i) & 1);
 
             // roll the key left (actually the lsb is dropped here)
             // and apply the gen (needs to include the dropped lsb as msb)
-            if (key & 0x80)
-                key = (key << 1) ^ gen;
-            else
-                key = (key << 1);
+            key = (key << 1) ^ (gen & -(key >> 7));
         }
     }
     return sum;
@@ -321,17 +518,12 @@ uint16_t lfsr_digest16(uint8_t const message[], unsigned bytes, uint16_t gen, ui
     for (unsigned k = 0; k < bytes; ++k) {
         uint8_t data = message[k];
         for (int i = 7; i >= 0; --i) {
-            // fprintf(stderr, "key at bit %d : %04x\n", i, key);
-            // if data bit is set then xor with key
-            if ((data >> i) & 1)
-                sum ^= key;
+            // if data bit is set then xor with key, masks instead of branches on the data
+            sum ^= key & -((data >> i) & 1);
 
             // roll the key right (actually the lsb is dropped here)
             // and apply the gen (needs to include the dropped lsb as msb)
-            if (key & 1)
-                key = (key >> 1) ^ gen;
-            else
-                key = (key >> 1);
+            key = (key >> 1) ^ (gen & -(key & 1));
         }
     }
     return sum;
@@ -423,6 +615,129 @@ int add_nibbles(uint8_t const message[], unsigned num_bytes)
         } \
     } while (0)
 
+/// The crc8() bit loop as reference for the tables.
+static uint8_t crc8_bitwise(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8_t init)
+{
+    uint8_t remainder = init;
+    for (unsigned byte = 0; byte < nBytes; ++byte) {
+        remainder ^= message[byte];
+        for (unsigned bit = 0; bit < 8; ++bit) {
+            remainder = remainder & 0x80 ? (remainder << 1) ^ polynomial : remainder << 1;
+        }
+    }
+    return remainder;
+}
+
+/// The crc16() bit loop as reference for the tables.
+static uint16_t crc16_bitwise(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
+{
+    uint16_t remainder = init;
+    for (unsigned byte = 0; byte < nBytes; ++byte) {
+        remainder ^= message[byte] << 8;
+        for (unsigned bit = 0; bit < 8; ++bit) {
+            remainder = remainder & 0x8000 ? (remainder << 1) ^ polynomial : remainder << 1;
+        }
+    }
+    return remainder;
+}
+
+/// The lfsr_digest16() branching bit loop as reference.
+static uint16_t lfsr_digest16_branching(uint8_t const message[], unsigned bytes, uint16_t gen, uint16_t key)
+{
+    uint16_t sum = 0;
+    for (unsigned k = 0; k < bytes; ++k) {
+        for (int i = 7; i >= 0; --i) {
+            if ((message[k] >> i) & 1)
+                sum ^= key;
+            key = key & 1 ? (key >> 1) ^ gen : key >> 1;
+        }
+    }
+    return sum;
+}
+
+/// The lfsr_digest8() branching bit loop as reference.
+static uint8_t lfsr_digest8_branching(uint8_t const message[], unsigned bytes, uint8_t gen, uint8_t key)
+{
+    uint8_t sum = 0;
+    for (unsigned k = 0; k < bytes; ++k) {
+        for (int i = 7; i >= 0; --i) {
+            if ((message[k] >> i) & 1)
+                sum ^= key;
+            key = key & 1 ? (key >> 1) ^ gen : key >> 1;
+        }
+    }
+    return sum;
+}
+
+/// The lfsr_digest8_reflect() branching bit loop as reference.
+static uint8_t lfsr_digest8_reflect_branching(uint8_t const message[], int bytes, uint8_t gen, uint8_t key)
+{
+    uint8_t sum = 0;
+    for (int k = bytes - 1; k >= 0; --k) {
+        for (int i = 0; i < 8; ++i) {
+            if ((message[k] >> i) & 1)
+                sum ^= key;
+            key = key & 0x80 ? (key << 1) ^ gen : key << 1;
+        }
+    }
+    return sum;
+}
+
+/// The extract_nibbles_4b1s() bit at a time reference.
+static unsigned extract_nibbles_4b1s_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
+{
+    unsigned ret = 0;
+    while (num_bits >= 5) {
+        unsigned bits = 0;
+        for (unsigned i = 0; i < 5; ++i)
+            bits = bits << 1 | (message[(offset_bits + i) / 8] >> (7 - (offset_bits + i) % 8) & 1);
+        if ((bits & 1) != 1)
+            break;
+        *dst++ = (bits >> 1) & 0xf;
+        ret += 1;
+        offset_bits += 5;
+        num_bits -= 5;
+    }
+    return ret;
+}
+
+/// The extract_bits_symbols() bit at a time reference.
+static unsigned symbol_match_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t symbol)
+{
+    unsigned symbol_len = symbol & 0x1f;
+    if (num_bits < symbol_len)
+        return 0;
+    for (unsigned pos = 0; pos < symbol_len; ++pos) {
+        unsigned m_pos = offset_bits + pos;
+        if (((message[m_pos / 8] >> (7 - (m_pos % 8))) & 1) != ((symbol >> (31 - pos)) & 1))
+            return 0;
+    }
+    return symbol_len;
+}
+
+static unsigned extract_bits_symbols_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t zero, uint32_t one, uint32_t sync, uint8_t *dst)
+{
+    unsigned dst_len = 0;
+    while (num_bits >= 1) {
+        unsigned len;
+        if ((len = symbol_match_bitwise(message, offset_bits, num_bits, sync))) {
+        }
+        else if ((len = symbol_match_bitwise(message, offset_bits, num_bits, zero))) {
+            dst_len += 1;
+        }
+        else if ((len = symbol_match_bitwise(message, offset_bits, num_bits, one))) {
+            dst[dst_len / 8] |= 0x80 >> (dst_len % 8);
+            dst_len += 1;
+        }
+        else {
+            break;
+        }
+        offset_bits += len;
+        num_bits -= len;
+    }
+    return dst_len;
+}
+
 int main(void) {
     unsigned passed = 0;
     unsigned failed = 0;
@@ -456,6 +771,109 @@ int main(void) {
     ASSERT_EQUALS(bytes[3], 0x02);
     ASSERT_EQUALS(bytes[4], 0x03);
 
+    fprintf(stderr, "util::extract_nibbles_4b1s(), extract_bits_symbols(): words against a bit at a time\n");
+    uint8_t stream[48];
+    unsigned extract_seed = 7;
+    unsigned extract_mismatches = 0;
+    for (unsigned k = 0; k < 200; ++k) {
+        for (unsigned i = 0; i < sizeof(stream); ++i) {
+            extract_seed = extract_seed * 1103515245 + 12345;
+            // mostly set bits keep the 4b1s stuff-bits valid for a while
+            stream[i] = k & 1 ? (extract_seed >> 16) | 0x21 : extract_seed >> 16;
+        }
+        unsigned offset = k % 13;
+        unsigned len    = sizeof(stream) * 8 - offset - k % 29;
+        uint8_t out_a[64] = {0};
+        uint8_t out_b[64] = {0};
+        if (extract_nibbles_4b1s(stream, offset, len, out_a) != extract_nibbles_4b1s_bitwise(stream, offset, len, out_b)
+                || memcmp(out_a, out_b, sizeof(out_a)))
+            extract_mismatches++;
+        // e.g. PWM symbols 10/110 with a sync of 1110, encode the random bits with them
+        uint32_t zero = 0x80000000 | 2;
+        uint32_t one  = 0xc0000000 | 3;
+        uint32_t sync = 0xe0000000 | (k & 2 ? 4 : 0);
+        if (k & 4) {
+            zero = 0; // a single symbol
+        }
+        memcpy(out_a, stream, sizeof(stream));
+        memset(stream, 0, sizeof(stream));
+        for (unsigned i = 0, pos = offset; pos + 4 <= sizeof(stream) * 8; ++i) {
+            uint32_t sym = i % 17 == 16 ? sync : out_a[i / 8] >> (i % 8) & 1 ? one : zero;
+            for (unsigned j = 0; j < (sym & 0x1f); ++j, ++pos)
+                stream[pos / 8] |= (sym >> (31 - j) & 1) << (7 - pos % 8);
+            if (!(sym & 0x1f))
+                break;
+        }
+        memset(out_a, 0, sizeof(out_a));
+        memset(out_b, 0, sizeof(out_b));
+        if (extract_bits_symbols(stream, offset, len, zero, one, sync, out_a) != extract_bits_symbols_bitwise(stream, offset, len, zero, one, sync, out_b)
+                || memcmp(out_a, out_b, sizeof(out_a)))
+            extract_mismatches++;
+    }
+    ASSERT_EQUALS(extract_mismatches, 0);
+
+    fprintf(stderr, "util::crc8(), crc16(): tables against a bit at a time\n");
+    uint8_t data[64];
+    unsigned seed = 1;
+    for (unsigned i = 0; i < sizeof(data); ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+    unsigned crc_mismatches = 0;
+    uint8_t const polys8[] = {0x31, 0x07};
+    uint16_t const polys16[] = {0x1021, 0x8005, 0x3d65};
+    for (unsigned len = 0; len <= sizeof(data); ++len) {
+        for (int p = 0; p < 3; ++p) {
+            for (unsigned init = 0; init < 0x10000; init += 0x1f7f) {
+                if (p < 2 && crc8(data, len, polys8[p], (uint8_t)init) != crc8_bitwise(data, len, polys8[p], (uint8_t)init))
+                    crc_mismatches++;
+                if (crc16(data, len, polys16[p], (uint16_t)init) != crc16_bitwise(data, len, polys16[p], (uint16_t)init))
+                    crc_mismatches++;
+            }
+        }
+    }
+    ASSERT_EQUALS(crc_mismatches, 0);
+
+    fprintf(stderr, "util::lfsr_digest8(), lfsr_digest16(): against the branching bit loop\n");
+    unsigned lfsr_mismatches = 0;
+    for (unsigned len = 0; len <= 24; ++len) {
+        for (unsigned key = 1; key < 0x10000; key += 0x0d3f) {
+            uint16_t gens[] = {0x8810, 0x9831};
+            for (int g = 0; g < 2; ++g) {
+                uint16_t d16 = lfsr_digest16(data, len, gens[g], (uint16_t)key);
+                if (d16 != lfsr_digest16_branching(data, len, gens[g], (uint16_t)key))
+                    lfsr_mismatches++;
+                if (lfsr_digest8(data, len, (uint8_t)gens[g], (uint8_t)key) != lfsr_digest8_branching(data, len, (uint8_t)gens[g], (uint8_t)key))
+                    lfsr_mismatches++;
+                if (lfsr_digest8_reflect(data, len, (uint8_t)gens[g], (uint8_t)key) != lfsr_digest8_reflect_branching(data, len, (uint8_t)gens[g], (uint8_t)key))
+                    lfsr_mismatches++;
+            }
+        }
+    }
+    ASSERT_EQUALS(lfsr_mismatches, 0);
+
+    fprintf(stderr, "util::reflect_bytes(), reflect_nibbles(): words against a byte at a time\n");
+    unsigned reflect_mismatches = 0;
+    for (unsigned len = 0; len <= 40; ++len) {
+        for (unsigned offset = 0; offset < 3; ++offset) {
+            uint8_t ref_a[43];
+            uint8_t ref_b[43];
+            memcpy(ref_a, data, sizeof(ref_a));
+            memcpy(ref_b, data, sizeof(ref_b));
+            reflect_bytes(&ref_a[offset], len);
+            for (unsigned i = 0; i < len; ++i)
+                ref_b[offset + i] = reverse8(ref_b[offset + i]);
+            if (memcmp(ref_a, ref_b, sizeof(ref_a)))
+                reflect_mismatches++;
+            reflect_nibbles(&ref_a[offset], len);
+            for (unsigned i = 0; i < len; ++i)
+                ref_b[offset + i] = reflect4(ref_b[offset + i]);
+            if (memcmp(ref_a, ref_b, sizeof(ref_a)))
+                reflect_mismatches++;
+        }
+    }
+    ASSERT_EQUALS(reflect_mismatches, 0);
+
     fprintf(stderr, "util:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
 
     return failed;
@@ -0,0 +1,346 @@
+/** @file
+    A bit arena, rows of any length in one contiguous buffer.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "bitarena.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BYTES_MIN 64 ///< initial size of the bit buffer
+#define ARENA_ROWS_MIN  16 ///< initial size of the row table
+
+void bitarena_free(bitarena_t *arena)
+{
+    free(arena->bits);
+    free(arena->rows);
+    memset(arena, 0, sizeof(*arena));
+}
+
+/// The byte offset past the last row.
+static uint32_t arena_end(bitarena_t const *arena)
+{
+    if (!arena->num_rows)
+        return 0;
+    bitarena_row_t const *last = &arena->rows[arena->num_rows - 1];
+    return last->offset + (last->len + 7) / 8;
+}
+
+void bitarena_clear(bitarena_t *arena)
+{
+    if (arena->bits)
+        memset(arena->bits, 0, arena_end(arena));
+    arena->num_rows = 0;
+}
+
+/// Grow the bit buffer to at least @p size bytes, the new bytes are zeroed.
+static int reserve_bytes(bitarena_t *arena, uint64_t size)
+{
+    if (size <= arena->bits_size)
+        return 0;
+    if (size > UINT32_MAX)
+        return -1;
+    uint64_t new_size = arena->bits_size ? (uint64_t)arena->bits_size * 2 : ARENA_BYTES_MIN;
+    if (new_size < size)
+        new_size = size;
+    if (new_size > UINT32_MAX)
+        new_size = UINT32_MAX;
+    uint8_t *bits = realloc(arena->bits, new_size);
+    if (!bits) {
+        WARN_REALLOC("bitarena_add_bit()");
+        return -1;
+    }
+    memset(bits + arena->bits_size, 0, new_size - arena->bits_size);
+    arena->bits      = bits;
+    arena->bits_size = (uint32_t)new_size;
+    return 0;
+}
+
+/// Start a new empty row after the last row.
+static int start_row(bitarena_t *arena)
+{
+    if (arena->num_rows == arena->rows_size) {
+        unsigned new_size = arena->rows_size ? arena->rows_size * 2 : ARENA_ROWS_MIN;
+        bitarena_row_t *rows = realloc(arena->rows, new_size * sizeof(*rows));
+        if (!rows) {
+            WARN_REALLOC("bitarena_add_row()");
+            return -1;
+        }
+        arena->rows      = rows;
+        arena->rows_size = new_size;
+    }
+    bitarena_row_t *row = &arena->rows[arena->num_rows];
+    row->offset = arena_end(arena);
+    row->len    = 0;
+    row->syncs  = 0;
+    arena->num_rows++;
+    return 0;
+}
+
+/// The last row with room for @p count more bits, NULL on alloc failure.
+static bitarena_row_t *reserve_bits(bitarena_t *arena, unsigned count)
+{
+    if (arena->num_rows == 0 && start_row(arena) < 0) // Add first row automatically
+        return NULL;
+    bitarena_row_t *row = &arena->rows[arena->num_rows - 1];
+    uint64_t bits = (uint64_t)row->len + count;
+    if (bits > UINT32_MAX || reserve_bytes(arena, row->offset + (bits + 7) / 8) < 0)
+        return NULL;
+    return row;
+}
+
+int bitarena_add_bit(bitarena_t *arena, int bit)
+{
+    bitarena_row_t *row = reserve_bits(arena, 1);
+    if (!row)
+        return -1;
+    if (bit)
+        arena->bits[row->offset + row->len / 8] |= 0x80 >> (row->len % 8);
+    row->len++;
+    return 0;
+}
+
+int bitarena_add_bits_run(bitarena_t *arena, int bit, unsigned count)
+{
+    bitarena_row_t *row = reserve_bits(arena, count);
+    if (!row)
+        return -1;
+    if (bit) {
+        uint8_t *b    = arena->bits + row->offset;
+        uint32_t pos  = row->len;
+        uint32_t end  = row->len + count;
+        // the head up to a byte boundary, whole bytes, then the tail
+        for (; pos < end && pos % 8; ++pos)
+            b[pos / 8] |= 0x80 >> (pos % 8);
+        uint32_t bytes = (end - pos) / 8;
+        memset(b + pos / 8, 0xff, bytes);
+        pos += bytes * 8;
+        for (; pos < end; ++pos)
+            b[pos / 8] |= 0x80 >> (pos % 8);
+    }
+    // unused bytes are zero already
+    row->len += count;
+    return 0;
+}
+
+int bitarena_add_bits(bitarena_t *arena, uint64_t word, unsigned nbits)
+{
+    if (nbits > 64)
+        nbits = 64;
+    bitarena_row_t *row = reserve_bits(arena, nbits);
+    if (!row)
+        return -1;
+    uint8_t *b = arena->bits + row->offset;
+    while (nbits) {
+        unsigned avail = 8 - row->len % 8;
+        unsigned take  = nbits < avail ? nbits : avail;
+        unsigned chunk = (unsigned)(word >> (nbits - take)) & ((1u << take) - 1);
+        b[row->len / 8] |= (uint8_t)(chunk << (avail - take));
+        row->len += take;
+        nbits -= take;
+    }
+    return 0;
+}
+
+int bitarena_add_row(bitarena_t *arena)
+{
+    if (arena->num_rows == 0 && start_row(arena) < 0) // Add first row automatically
+        return -1;
+    return start_row(arena);
+}
+
+int bitarena_add_sync(bitarena_t *arena)
+{
+    if (arena->num_rows == 0 && start_row(arena) < 0) // Add first row automatically
+        return -1;
+    if (arena->rows[arena->num_rows - 1].len && start_row(arena) < 0)
+        return -1;
+    arena->rows[arena->num_rows - 1].syncs++;
+    return 0;
+}
+
+/// The number of bitbuffer rows a row of @p len bits occupies, including the spilled rows.
+static unsigned bitbuffer_rows_needed(unsigned len)
+{
+    unsigned rows = (len + BITBUF_COLS * 8 - 1) / (BITBUF_COLS * 8);
+    return rows ? rows : 1;
+}
+
+unsigned bitarena_to_bitbuffer(bitarena_t const *arena, unsigned first_row, bitbuffer_t *bits)
+{
+    memset(bits, 0, sizeof(*bits));
+    unsigned copied = 0;
+    unsigned pos    = 0; // the first free bitbuffer row
+    for (unsigned i = first_row; i < arena->num_rows; ++i) {
+        unsigned len  = arena->rows[i].len;
+        unsigned need = bitbuffer_rows_needed(len);
+        if (pos + need > BITBUF_ROWS) {
+            if (copied)
+                break;
+            // a single row longer than the bitbuffer, keep what fits
+            need = BITBUF_ROWS - pos;
+            len  = need * BITBUF_COLS * 8;
+        }
+        // the bitbuffer rows are contiguous, a long row spills into the following rows
+        memcpy(bits->bb[pos], bitarena_row_bits(arena, i), (len + 7) / 8);
+        bits->bits_per_row[pos]     = (uint16_t)len;
+        bits->syncs_before_row[pos] = (uint16_t)arena->rows[i].syncs;
+        bits->num_rows = pos + 1;
+        pos += need;
+        bits->free_row = pos;
+        copied++;
+    }
+    return copied;
+}
+
+int bitarena_add_bitbuffer(bitarena_t *arena, bitbuffer_t const *bits)
+{
+    // skip the spilled rows of long rows
+    for (unsigned i = 0; i < bits->num_rows; i += bitbuffer_rows_needed(bits->bits_per_row[i])) {
+        if (start_row(arena) < 0)
+            return -1;
+        bitarena_row_t *row = reserve_bits(arena, bits->bits_per_row[i]);
+        if (!row)
+            return -1;
+        memcpy(arena->bits + row->offset, bits->bb[i], (bits->bits_per_row[i] + 7) / 8);
+        row->len   = bits->bits_per_row[i];
+        row->syncs = bits->syncs_before_row[i];
+        // the bitbuffer might carry stray bits past the row length, clear them
+        if (row->len % 8)
+            arena->bits[row->offset + row->len / 8] &= (uint8_t)(0xff00 >> (row->len % 8));
+    }
+    return 0;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Compare the bitbuffer rows, with the spilled rows, to the arena rows.
+static int compare_rows(bitarena_t const *arena, unsigned first_row, unsigned rows, bitbuffer_t const *bits)
+{
+    unsigned pos = 0;
+    for (unsigned i = first_row; i < first_row + rows; ++i) {
+        unsigned len = bits->bits_per_row[pos];
+        if (len != bitarena_row_len(arena, i)
+                || bits->syncs_before_row[pos] != arena->rows[i].syncs
+                || memcmp(bits->bb[pos], bitarena_row_bits(arena, i), (len + 7) / 8))
+            return 0;
+        pos += bitbuffer_rows_needed(len);
+    }
+    return 1;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    bitarena_t arena = {0};
+    bitarena_t ref   = {0};
+    bitbuffer_t bits = {0};
+
+    fprintf(stderr, "bitarena:: bulk appends match single bits\n");
+    for (unsigned k = 0; k < 200; ++k) {
+        unsigned run  = (k * 7) % 23;
+        uint64_t word = 0x9e3779b97f4a7c15ULL * (k + 1);
+        unsigned n    = (k * 13) % 65;
+        bitarena_add_bits_run(&arena, k & 1, run);
+        bitarena_add_bits(&arena, word, n);
+        for (unsigned j = 0; j < run; ++j)
+            bitarena_add_bit(&ref, k & 1);
+        for (unsigned j = n; j > 0; --j)
+            bitarena_add_bit(&ref, (word >> (j - 1)) & 1);
+        if (k % 50 == 49) {
+            bitarena_add_row(&arena);
+            bitarena_add_row(&ref);
+        }
+    }
+    ASSERT_EQUALS(arena.num_rows, 5);
+    ASSERT_EQUALS(ref.num_rows, 5);
+    ASSERT_EQUALS(memcmp(arena.rows, ref.rows, 5 * sizeof(*arena.rows)), 0);
+    ASSERT_EQUALS(memcmp(arena.bits, ref.bits, arena_end(&arena)), 0);
+    bitarena_free(&ref);
+
+    fprintf(stderr, "bitarena:: syncs and empty rows\n");
+    bitarena_clear(&arena);
+    ASSERT_EQUALS(arena.num_rows, 0);
+    bitarena_add_sync(&arena);
+    bitarena_add_sync(&arena);
+    bitarena_add_bits(&arena, 0xa5, 8);
+    bitarena_add_sync(&arena);
+    bitarena_add_row(&arena);
+    bitarena_add_bit(&arena, 1);
+    ASSERT_EQUALS(arena.num_rows, 3);
+    ASSERT_EQUALS(arena.rows[0].syncs, 2);
+    ASSERT_EQUALS(arena.rows[1].syncs, 1);
+    ASSERT_EQUALS(bitarena_row_len(&arena, 1), 0);
+    ASSERT_EQUALS(bitarena_row_bits(&arena, 0)[0], 0xa5);
+    ASSERT_EQUALS(bitarena_row_bits(&arena, 2)[0], 0x80);
+
+    fprintf(stderr, "bitarena:: many rows in windows\n");
+    bitarena_clear(&arena);
+    for (unsigned i = 0; i < 3 * BITBUF_ROWS + 7; ++i) {
+        bitarena_add_bits(&arena, i, 16);
+        bitarena_add_row(&arena);
+    }
+    unsigned total = 0;
+    int match      = 1;
+    while (total < arena.num_rows) {
+        unsigned n = bitarena_to_bitbuffer(&arena, total, &bits);
+        match &= compare_rows(&arena, total, n, &bits);
+        if (!n)
+            break;
+        total += n;
+    }
+    ASSERT_EQUALS(total, arena.num_rows);
+    ASSERT_EQUALS(match, 1);
+
+    fprintf(stderr, "bitarena:: long rows spill and round trip\n");
+    bitarena_clear(&arena);
+    bitarena_add_bits_run(&arena, 1, BITBUF_COLS * 8 + 5);
+    bitarena_add_row(&arena);
+    bitarena_add_bits(&arena, 0x3, 2);
+    unsigned n = bitarena_to_bitbuffer(&arena, 0, &bits);
+    ASSERT_EQUALS(n, 2);
+    ASSERT_EQUALS(bits.num_rows, 3);
+    ASSERT_EQUALS(bits.bits_per_row[0], BITBUF_COLS * 8 + 5);
+    ASSERT_EQUALS(bits.bits_per_row[2], 2);
+    ASSERT_EQUALS(compare_rows(&arena, 0, n, &bits), 1);
+    bitarena_t copy = {0};
+    bitarena_add_bitbuffer(&copy, &bits);
+    ASSERT_EQUALS(copy.num_rows, 2);
+    ASSERT_EQUALS(bitarena_row_len(&copy, 0), BITBUF_COLS * 8 + 5);
+    ASSERT_EQUALS(memcmp(copy.bits, arena.bits, BITBUF_COLS + 2), 0);
+    bitarena_free(&copy);
+
+    fprintf(stderr, "bitarena:: a row longer than the bitbuffer is truncated\n");
+    bitarena_clear(&arena);
+    bitarena_add_bits_run(&arena, 1, BITBUF_MAX_ROW_BITS + 100);
+    ASSERT_EQUALS(bitarena_to_bitbuffer(&arena, 0, &bits), 1);
+    ASSERT_EQUALS(bits.bits_per_row[0], BITBUF_MAX_ROW_BITS);
+    ASSERT_EQUALS(bits.free_row, BITBUF_ROWS);
+
+    bitarena_free(&arena);
+
+    fprintf(stderr, "bitarena:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0 ? 1 : 0;
+}
+
+#endif /* _TEST */
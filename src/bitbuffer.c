@@ -10,6 +10,9 @@
 */
 
 #include "bitbuffer.h"
+#include "bit_util.h"
+#include "c_util.h" // for MIN()
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +22,23 @@ void bitbuffer_clear(bitbuffer_t *bits)
     memset(bits, 0, sizeof(*bits));
 }
 
+/// Rows the bitbuffer holds bits in, rows spill past num_rows up to free_row.
+static unsigned used_rows(bitbuffer_t const *bits)
+{
+    unsigned rows = bits->free_row > bits->num_rows ? bits->free_row : bits->num_rows;
+    return rows < BITBUF_ROWS ? rows : BITBUF_ROWS;
+}
+
+void bitbuffer_clear_used(bitbuffer_t *bits)
+{
+    unsigned rows = used_rows(bits);
+    memset(bits->bits_per_row, 0, rows * sizeof(*bits->bits_per_row));
+    memset(bits->syncs_before_row, 0, rows * sizeof(*bits->syncs_before_row));
+    memset(bits->bb, 0, rows * sizeof(*bits->bb));
+    bits->num_rows = 0;
+    bits->free_row = 0;
+}
+
 void bitbuffer_add_bit(bitbuffer_t *bits, int bit)
 {
     if (bits->num_rows == 0)
@@ -71,6 +91,92 @@ void bitbuffer_add_bit(bitbuffer_t *bits, int bit)
 */
 }
 
+/// Number of bits that can be added to the current row before the next spill or limit, 0 if bitbuffer_add_bit() needs to add the next bit.
+static inline unsigned bits_unspilled(bitbuffer_t const *bits)
+{
+    unsigned len  = bits->bits_per_row[bits->num_rows - 1];
+    unsigned room = BITBUF_COLS * 8 - len % (BITBUF_COLS * 8);
+    if ((len > 0 && room == BITBUF_COLS * 8) || len + 1 >= UINT16_MAX)
+        return 0;
+    return MIN(room, UINT16_MAX - 1 - len);
+}
+
+/// The row bytes are clear, set @p n one bits at bit @p pos.
+static void set_bits_run(uint8_t *b, unsigned pos, unsigned n)
+{
+    unsigned head = pos % 8;
+    if (head) {
+        unsigned k = MIN(8 - head, n);
+        b[pos / 8] |= (uint8_t)(((0xff00 >> k) & 0xff) >> head);
+        pos += k;
+        n -= k;
+    }
+    memset(&b[pos / 8], 0xff, n / 8);
+    if (n % 8)
+        b[(pos + n) / 8] |= (uint8_t)(0xff00 >> (n % 8));
+}
+
+void bitbuffer_add_bits_run(bitbuffer_t *bits, int bit, unsigned count)
+{
+    if (count == 0)
+        return;
+    if (bits->num_rows == 0)
+        bits->free_row = bits->num_rows = 1; // Add first row automatically
+
+    while (count) {
+        uint16_t *len = &bits->bits_per_row[bits->num_rows - 1];
+        unsigned n    = bits_unspilled(bits);
+        n             = MIN(n, count);
+        if (n == 0) {
+            // the spill and the row limits are handled bit by bit
+            unsigned before = *len;
+            bitbuffer_add_bit(bits, bit);
+            if (bits->bits_per_row[bits->num_rows - 1] == before)
+                return; // full
+            count--;
+            continue;
+        }
+        if (bit)
+            set_bits_run(bits->bb[bits->num_rows - 1], *len, n);
+        *len += n;
+        count -= n;
+    }
+}
+
+void bitbuffer_add_bits(bitbuffer_t *bits, uint64_t word, unsigned nbits)
+{
+    if (nbits == 0)
+        return;
+    if (bits->num_rows == 0)
+        bits->free_row = bits->num_rows = 1; // Add first row automatically
+
+    while (nbits) {
+        uint16_t *len = &bits->bits_per_row[bits->num_rows - 1];
+        unsigned n    = bits_unspilled(bits);
+        n             = MIN(n, nbits);
+        if (n == 0) {
+            unsigned before = *len;
+            bitbuffer_add_bit(bits, (word >> (nbits - 1)) & 1);
+            if (bits->bits_per_row[bits->num_rows - 1] == before)
+                return; // full
+            nbits--;
+            continue;
+        }
+        // the next n bits from the top, a byte at a time
+        uint8_t *b   = bits->bb[bits->num_rows - 1];
+        unsigned pos = *len;
+        for (unsigned left = n; left;) {
+            unsigned k = MIN(8 - pos % 8, left);
+            unsigned v = (unsigned)(word >> (nbits - k)) & ((1u << k) - 1);
+            b[pos / 8] |= (uint8_t)(v << (8 - pos % 8 - k));
+            pos += k;
+            left -= k;
+            nbits -= k;
+        }
+        *len += n;
+    }
+}
+
 /// Set the width of the current (last) row by expanding or truncating as needed.
 static void bitbuffer_set_width(bitbuffer_t *bits, uint16_t width)
 {
@@ -128,62 +234,140 @@ void bitbuffer_add_sync(bitbuffer_t *bits)
     bits->syncs_before_row[bits->num_rows - 1]++;
 }
 
-void bitbuffer_invert(bitbuffer_t *bits)
+/// Copy the rows in use, the transforms then work in place on the copy.
+static void copy_used(bitbuffer_t const *bits, bitbuffer_t *out)
 {
-    for (unsigned row = 0; row < bits->num_rows; ++row) {
-        if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
+    if (bits == out)
+        return;
+    unsigned rows     = used_rows(bits);
+    unsigned out_rows = used_rows(out);
+    memcpy(out, bits, offsetof(bitbuffer_t, bb));
+    memcpy(out->bb, bits->bb, rows * sizeof(*bits->bb));
+    // a reused scratch buffer may hold more rows
+    if (out_rows > rows)
+        memset(out->bb[rows], 0, (out_rows - rows) * sizeof(*out->bb));
+}
 
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                b[col] = ~b[col]; // Invert
-            }
-            b[last_col] ^= 0xFF >> last_bits; // Re-invert unused bits in last byte
-        }
+static inline uint64_t load_be64(uint8_t const *b)
+{
+    uint64_t x = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        x = x << 8 | b[i];
+    return x;
+}
+
+static inline void store_be64(uint8_t *b, uint64_t x)
+{
+    for (unsigned i = 0; i < 8; ++i)
+        b[i] = (uint8_t)(x >> (56 - 8 * i));
+}
+
+/// Invert a row, 8 bytes at a time.
+static void invert_row(uint8_t *b, unsigned len)
+{
+    unsigned const bytes = (len + 7) / 8;
+    unsigned col = 0;
+    for (; col + 8 <= bytes; col += 8) {
+        uint64_t x;
+        memcpy(&x, &b[col], sizeof(x));
+        x = ~x;
+        memcpy(&b[col], &x, sizeof(x));
     }
+    for (; col < bytes; ++col) {
+        b[col] = ~b[col]; // Invert
+    }
+    if (len % 8)
+        b[bytes - 1] ^= 0xFF >> (len % 8); // Re-invert unused bits in last byte
 }
 
-void bitbuffer_nrzs_decode(bitbuffer_t *bits)
+/// XOR each bit of a row with the bit before it, the first bit with zero, and then with @p space.
+static void nrz_decode_row(uint8_t *b, unsigned len, uint64_t space)
+{
+    unsigned const bytes = (len + 7) / 8;
+    unsigned col = 0;
+    uint64_t prev = 0; // last bit of the previous word
+    for (; col + 8 <= bytes; col += 8) {
+        uint64_t x = load_be64(&b[col]);
+        store_be64(&b[col], x ^ (prev << 63 | x >> 1) ^ space);
+        prev = x & 1;
+    }
+    for (; col < bytes; ++col) {
+        unsigned x = b[col];
+        b[col] = (uint8_t)(x ^ (prev << 7 | x >> 1) ^ space);
+        prev = x & 1;
+    }
+    if (len % 8)
+        b[bytes - 1] &= 0xFF << (8 - len % 8); // Clear unused bits in last byte
+}
+
+/// Reflect each byte of a row, 8 bytes at a time.
+static void reflect_row(uint8_t *b, unsigned len)
+{
+    unsigned const bytes = (len + 7) / 8;
+    unsigned col = 0;
+    for (; col + 8 <= bytes; col += 8) {
+        uint64_t x;
+        memcpy(&x, &b[col], sizeof(x));
+        x = reverse8_u64(x);
+        memcpy(&b[col], &x, sizeof(x));
+    }
+    for (; col < bytes; ++col) {
+        b[col] = (uint8_t)reverse8_u64(b[col]);
+    }
+}
+
+void bitbuffer_invert(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
-        if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
+        invert_row(bits->bb[row], bits->bits_per_row[row]);
+    }
+}
 
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
+void bitbuffer_invert_to(bitbuffer_t const *bits, bitbuffer_t *out)
+{
+    copy_used(bits, out);
+    bitbuffer_invert(out);
+}
 
-            int prev = 0;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                int mask = (prev << 7) | b[col] >> 1;
-                prev     = b[col];
-                b[col]   = b[col] ^ ~mask;
-            }
-            b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
-        }
+void bitbuffer_nrzs_decode(bitbuffer_t *bits)
+{
+    for (unsigned row = 0; row < bits->num_rows; ++row) {
+        nrz_decode_row(bits->bb[row], bits->bits_per_row[row], ~(uint64_t)0);
     }
 }
 
+void bitbuffer_nrzs_decode_to(bitbuffer_t const *bits, bitbuffer_t *out)
+{
+    copy_used(bits, out);
+    bitbuffer_nrzs_decode(out);
+}
+
 void bitbuffer_nrzm_decode(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
-        if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
+        nrz_decode_row(bits->bb[row], bits->bits_per_row[row], 0);
+    }
+}
 
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
+void bitbuffer_nrzm_decode_to(bitbuffer_t const *bits, bitbuffer_t *out)
+{
+    copy_used(bits, out);
+    bitbuffer_nrzm_decode(out);
+}
 
-            int prev = 0;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                int mask = (prev << 7) | b[col] >> 1;
-                prev     = b[col];
-                b[col]   = b[col] ^ mask;
-            }
-            b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
-        }
+void bitbuffer_reflect(bitbuffer_t *bits)
+{
+    for (unsigned row = 0; row < bits->num_rows; ++row) {
+        reflect_row(bits->bb[row], bits->bits_per_row[row]);
     }
 }
 
+void bitbuffer_reflect_to(bitbuffer_t const *bits, bitbuffer_t *out)
+{
+    copy_used(bits, out);
+    bitbuffer_reflect(out);
+}
+
 void bitbuffer_extract_bytes(bitbuffer_t *bitbuffer, unsigned row,
         unsigned pos, uint8_t *out, unsigned len)
 {
@@ -219,30 +403,138 @@ static inline uint8_t bit_at(const uint8_t *bytes, unsigned bit)
     return (uint8_t)(bytes[bit >> 3] >> (7 - (bit & 7)) & 1);
 }
 
-unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
-        const uint8_t *pattern, unsigned pattern_bits_len)
+/// Bits of a pattern matched a word at a time, leaves room for a byte of shift in 64 bits.
+#define SEARCH_WORD_BITS 56
+
+bitbuffer_pattern_t bitbuffer_search_prepare(const uint8_t *pattern, unsigned pattern_bits_len)
+{
+    bitbuffer_pattern_t prep = {.pattern = pattern, .bits = pattern_bits_len};
+    unsigned head = pattern_bits_len < SEARCH_WORD_BITS ? pattern_bits_len : SEARCH_WORD_BITS;
+    if (!head)
+        return prep;
+    for (unsigned i = 0; i < (head + 7) / 8; ++i) {
+        prep.value |= (uint64_t)pattern[i] << (56 - 8 * i);
+    }
+    prep.mask  = ~(uint64_t)0 << (64 - head);
+    prep.value &= prep.mask;
+    return prep;
+}
+
+unsigned bitbuffer_search_pattern(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        bitbuffer_pattern_t const *pattern)
 {
     uint8_t *bits = bitbuffer->bb[row];
     unsigned len  = bitbuffer->bits_per_row[row];
-    unsigned ipos = start;
-    unsigned ppos = 0; // cursor on init pattern
 
-    while (ipos < len && ppos < pattern_bits_len) {
-        if (bit_at(bits, ipos) == bit_at(pattern, ppos)) {
-            ppos++;
-            ipos++;
-            if (ppos == pattern_bits_len)
-                return ipos - pattern_bits_len;
+    if (!pattern->bits || pattern->bits > len || start > len - pattern->bits)
+        return len; // Not found
+    unsigned last = len - pattern->bits; // last possible match
+
+    // the window holds the 8 bytes from byte pos, bytes past the row read as zero
+    unsigned row_bytes = (len + 7) / 8;
+    if (row_bytes > BITBUF_COLS * BITBUF_ROWS - row * BITBUF_COLS)
+        row_bytes = BITBUF_COLS * BITBUF_ROWS - row * BITBUF_COLS;
+    unsigned pos = start / 8;
+    uint64_t win = 0;
+    for (unsigned i = pos; i < pos + 8; ++i) {
+        win = win << 8 | (i < row_bytes ? bits[i] : 0);
+    }
+
+    for (unsigned shift = start & 7;; shift = 0) {
+        for (; shift < 8; ++shift) {
+            unsigned ipos = pos * 8 + shift;
+            if (ipos > last)
+                return len; // Not found
+            if (((win << shift) & pattern->mask) != pattern->value)
+                continue;
+            unsigned ppos = SEARCH_WORD_BITS;
+            while (ppos < pattern->bits && bit_at(bits, ipos + ppos) == bit_at(pattern->pattern, ppos))
+                ppos++;
+            if (ppos >= pattern->bits)
+                return ipos;
         }
-        else {
-            ipos -= ppos;
-            ipos++;
-            ppos = 0;
+        pos++;
+        win = win << 8 | (pos + 7 < row_bytes ? bits[pos + 7] : 0);
+    }
+}
+
+unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        const uint8_t *pattern, unsigned pattern_bits_len)
+{
+    bitbuffer_pattern_t prep = bitbuffer_search_prepare(pattern, pattern_bits_len);
+    return bitbuffer_search_pattern(bitbuffer, row, start, &prep);
+}
+
+static inline unsigned window_hash(unsigned window)
+{
+    return (window * 0x9e3779b1u) >> 20 & 4095;
+}
+
+void bitbuffer_windows_build(bitbuffer_t *bits, bitbuffer_windows_t *windows)
+{
+    *windows = (bitbuffer_windows_t){{0}};
+    for (unsigned row = 0; row < bits->num_rows; ++row) {
+        uint8_t *b   = bits->bb[row];
+        unsigned len = bits->bits_per_row[row];
+        if (len < 16)
+            continue;
+        unsigned window = 0;
+        for (unsigned pos = 0; pos < len; ++pos) {
+            window = (window << 1 | bit_at(b, pos)) & 0xffff;
+            if (pos >= 15) {
+                unsigned h = window_hash(window);
+                windows->bloom[h >> 6] |= (uint64_t)1 << (h & 63);
+            }
         }
     }
+}
 
-    // Not found
-    return len;
+int bitbuffer_windows_may_match(bitbuffer_windows_t const *windows, bitbuffer_pattern_t const *pattern)
+{
+    if (pattern->bits < 16)
+        return 1;
+    unsigned h = window_hash((unsigned)(pattern->value >> 48));
+    return (windows->bloom[h >> 6] >> (h & 63)) & 1;
+}
+
+/// The 16 bits at a bit position, the row needs to hold all 16 bits.
+static inline unsigned bits16_at(const uint8_t *bytes, unsigned bit)
+{
+    unsigned i     = bit >> 3;
+    unsigned shift = bit & 7;
+    uint32_t word  = (uint32_t)bytes[i] << 16 | (uint32_t)bytes[i + 1] << 8 | (shift ? bytes[i + 2] : 0);
+    return (word >> (8 - shift)) & 0xffff;
+}
+
+/// Gather the 8 even bits of a 16 bit word into a byte.
+static inline uint8_t even_bits(unsigned word)
+{
+    word &= 0x5555;
+    word = (word | word >> 1) & 0x3333;
+    word = (word | word >> 2) & 0x0f0f;
+    word = (word | word >> 4) & 0x00ff;
+    return (uint8_t)word;
+}
+
+/// Add 8 bits at once if they fit the current row without a spill, otherwise leave it to bitbuffer_add_bit().
+static inline int add_byte_unspilled(bitbuffer_t *bits, uint8_t byte)
+{
+    if (bits->num_rows == 0)
+        bits->free_row = bits->num_rows = 1; // Add first row automatically
+
+    unsigned len    = bits->bits_per_row[bits->num_rows - 1];
+    unsigned offset = len % (BITBUF_COLS * 8);
+    if ((len > 0 && offset == 0) || offset + 8 > BITBUF_COLS * 8 || len + 8 >= UINT16_MAX - 1)
+        return 0;
+
+    uint8_t *b         = bits->bb[bits->num_rows - 1];
+    unsigned col_index = len / 8;
+    unsigned bit_index = len % 8;
+    b[col_index] |= byte >> bit_index;
+    if (bit_index)
+        b[col_index + 1] |= (uint8_t)(byte << (8 - bit_index));
+    bits->bits_per_row[bits->num_rows - 1] += 8;
+    return 1;
 }
 
 unsigned bitbuffer_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned start,
@@ -255,6 +547,16 @@ unsigned bitbuffer_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned
     if (max && len > start + (max * 2))
         len = start + (max * 2);
 
+    // 8 symbols at a time, any invalid symbol is found by the bit loop
+    while (ipos + 16 <= len) {
+        unsigned word = bits16_at(bits, ipos);
+        if (((word ^ word >> 1) & 0x5555) != 0x5555)
+            break;
+        if (!add_byte_unspilled(outbuf, even_bits(word)))
+            break;
+        ipos += 16;
+    }
+
     while (ipos < len) {
         uint8_t bit1, bit2;
 
@@ -305,6 +607,18 @@ unsigned bitbuffer_differential_manchester_decode(bitbuffer_t *inbuf, unsigned r
         }
     }
 
+    // 8 symbols at a time, a missing clock is found by the bit loop
+    while (ipos + 16 <= len) {
+        unsigned word  = bits16_at(bits, ipos);
+        unsigned edges = (bit2 << 16 | word) ^ word >> 1;
+        if ((edges & 0xaaaa) != 0xaaaa)
+            break;
+        if (!add_byte_unspilled(outbuf, even_bits(~edges)))
+            break;
+        bit2 = word & 1;
+        ipos += 16;
+    }
+
     while (ipos < len) {
         bit1 = bit_at(bits, ipos++);
         if (bit1 == bit2)
@@ -493,31 +807,183 @@ unsigned bitbuffer_count_repeats(bitbuffer_t *bits, unsigned row, unsigned max_b
     return cnt;
 }
 
-int bitbuffer_find_repeated_row(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+/// Hash the bits bitbuffer_compare_rows() compares, FNV-1a.
+static uint32_t row_hash(bitbuffer_t *bits, unsigned row, unsigned max_bits)
 {
-    for (int i = 0; i < bits->num_rows; ++i) {
-        if (bits->bits_per_row[i] >= min_bits &&
-                bitbuffer_count_repeats(bits, i, 0) >= min_repeats) {
-            return i;
+    uint8_t *b    = bits->bb[row];
+    unsigned len  = bits->bits_per_row[row];
+    uint32_t hash = 2166136261u;
+    unsigned bytes;
+    if (max_bits == 0 || len < max_bits) {
+        bytes = (len + 7) / 8;
+        hash  = (hash ^ (len & 0xff)) * 16777619u;
+        hash  = (hash ^ (len >> 8)) * 16777619u;
+    }
+    else {
+        bytes = max_bits / 8;
+        hash  = (hash ^ 0xff) * 16777619u; // prefix rows never equal full rows
+        if (max_bits & 7)
+            hash = (hash ^ (b[bytes] & (0xff00 >> (max_bits & 7)))) * 16777619u;
+    }
+    for (unsigned i = 0; i < bytes; ++i) {
+        hash = (hash ^ b[i]) * 16777619u;
+    }
+    return hash;
+}
+
+unsigned bitbuffer_unique_rows(bitbuffer_t *bits, unsigned max_bits, bitbuffer_row_repeats_t *unique)
+{
+    uint32_t hashes[BITBUF_ROWS];
+    unsigned num_unique = 0;
+    for (unsigned i = 0; i < bits->num_rows && i < BITBUF_ROWS; ++i) {
+        uint32_t hash = row_hash(bits, i, max_bits);
+        unsigned j;
+        for (j = 0; j < num_unique; ++j) {
+            if (hashes[j] == hash && bitbuffer_compare_rows(bits, unique[j].row, i, max_bits))
+                break;
+        }
+        if (j < num_unique) {
+            unique[j].repeats++;
+        }
+        else {
+            hashes[num_unique] = hash;
+            unique[num_unique] = (bitbuffer_row_repeats_t){.row = (uint16_t)i, .repeats = 1};
+            num_unique++;
         }
     }
-    return -1;
+    return num_unique;
 }
 
-int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+/// The first of the equal rows is the first row with enough repeats.
+static int find_repeated(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits, unsigned max_bits)
 {
-    for (int i = 0; i < bits->num_rows; ++i) {
-        if (bits->bits_per_row[i] >= min_bits &&
-                bitbuffer_count_repeats(bits, i, min_bits) >= min_repeats) {
-            return i;
+    bitbuffer_row_repeats_t unique[BITBUF_ROWS];
+    unsigned num_unique = bitbuffer_unique_rows(bits, max_bits, unique);
+    for (unsigned i = 0; i < num_unique; ++i) {
+        if (bits->bits_per_row[unique[i].row] >= min_bits && unique[i].repeats >= min_repeats) {
+            return unique[i].row;
         }
     }
     return -1;
 }
 
+int bitbuffer_find_repeated_row(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+{
+    return find_repeated(bits, min_repeats, min_bits, 0);
+}
+
+int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+{
+    return find_repeated(bits, min_repeats, min_bits, min_bits);
+}
+
 // Unit testing
 #ifdef _TEST
 
+/// The previous bit at a time search as reference.
+static unsigned search_bitwise(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        const uint8_t *pattern, unsigned pattern_bits_len)
+{
+    uint8_t *bits = bitbuffer->bb[row];
+    unsigned len  = bitbuffer->bits_per_row[row];
+    unsigned ipos = start;
+    unsigned ppos = 0; // cursor on init pattern
+
+    while (ipos < len && ppos < pattern_bits_len) {
+        if (bit_at(bits, ipos) == bit_at(pattern, ppos)) {
+            ppos++;
+            ipos++;
+            if (ppos == pattern_bits_len)
+                return ipos - pattern_bits_len;
+        }
+        else {
+            ipos -= ppos;
+            ipos++;
+            ppos = 0;
+        }
+    }
+
+    // Not found
+    return len;
+}
+
+/// The previous bit at a time Manchester decoder as reference.
+static unsigned manchester_bitwise(bitbuffer_t *inbuf, unsigned row, unsigned start,
+        bitbuffer_t *outbuf, unsigned max)
+{
+    uint8_t *bits     = inbuf->bb[row];
+    unsigned int len  = inbuf->bits_per_row[row];
+    unsigned int ipos = start;
+
+    if (max && len > start + (max * 2))
+        len = start + (max * 2);
+
+    while (ipos < len) {
+        uint8_t bit1, bit2;
+
+        bit1 = bit_at(bits, ipos++);
+        bit2 = bit_at(bits, ipos++);
+
+        if (bit1 == bit2)
+            break;
+
+        bitbuffer_add_bit(outbuf, bit2);
+    }
+
+    return ipos;
+}
+
+/// The previous bit at a time differential Manchester decoder as reference.
+static unsigned differential_manchester_bitwise(bitbuffer_t *inbuf, unsigned row, unsigned start,
+        bitbuffer_t *outbuf, unsigned max)
+{
+    uint8_t *bits     = inbuf->bb[row];
+    unsigned int len  = inbuf->bits_per_row[row];
+    unsigned int ipos = start;
+    uint8_t bit1, bit2 = 0;
+
+    if (max && len > start + (max * 2))
+        len = start + (max * 2);
+
+    // the first long pulse will determine the clock
+    // if needed skip one short pulse to get in synch
+    while (ipos < len) {
+        bit1 = bit_at(bits, ipos++);
+        bit2 = bit_at(bits, ipos++);
+        uint8_t bit3 = bit_at(bits, ipos);
+
+        if (bit1 != bit2) {
+            if (bit2 != bit3) {
+                bitbuffer_add_bit(outbuf, 0);
+            }
+            else {
+                bit2 = bit1;
+                ipos -= 1;
+                break;
+            }
+        }
+        else {
+            bit2 = 1 - bit1;
+            ipos -= 2;
+            break;
+        }
+    }
+
+    while (ipos < len) {
+        bit1 = bit_at(bits, ipos++);
+        if (bit1 == bit2)
+            break; // clock missing, abort
+        bit2 = bit_at(bits, ipos++);
+
+        if (bit1 == bit2)
+            bitbuffer_add_bit(outbuf, 1);
+        else
+            bitbuffer_add_bit(outbuf, 0);
+    }
+
+    return ipos;
+}
+
 #define ASSERT(expr) \
     do { \
         if (expr) { \
@@ -528,6 +994,39 @@ int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsi
         } \
     } while (0)
 
+/// The previous byte at a time transforms as reference: invert, NRZ-S, NRZ-M, reflect.
+static void transform_bytewise(bitbuffer_t *bits, int op)
+{
+    for (unsigned row = 0; row < bits->num_rows; ++row) {
+        if (bits->bits_per_row[row] == 0)
+            continue;
+        uint8_t *b = bits->bb[row];
+        const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
+        const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
+        int prev = 0;
+        for (unsigned col = 0; col <= last_col; ++col) {
+            int mask = (prev << 7) | b[col] >> 1;
+            prev     = b[col];
+            if (op == 0)
+                b[col] = ~b[col];
+            else if (op == 1)
+                b[col] = b[col] ^ ~mask;
+            else if (op == 2)
+                b[col] = b[col] ^ mask;
+            else {
+                uint8_t r = 0;
+                for (int i = 0; i < 8; ++i)
+                    r |= ((b[col] >> i) & 1) << (7 - i);
+                b[col] = r;
+            }
+        }
+        if (op == 0)
+            b[last_col] ^= 0xFF >> last_bits;
+        else if (op < 3)
+            b[last_col] &= 0xFF << (8 - last_bits);
+    }
+}
+
 int main(void)
 {
     unsigned passed = 0;
@@ -585,6 +1084,232 @@ int main(void)
     ASSERT(bits.num_rows == 0);
     bitbuffer_print(&bits);
 
+    fprintf(stderr, "TEST: bitbuffer:: Search\n");
+    bitbuffer_parse(&bits, "{80}aaaaaaaa2dd4f00dcafe");
+    uint8_t const sync[] = {0xaa, 0x2d, 0xd4};
+    ASSERT(bitbuffer_search(&bits, 0, 0, sync, 24) == 24);
+    ASSERT(bitbuffer_search(&bits, 0, 0, sync, 20) == 24);
+    ASSERT(bitbuffer_search(&bits, 0, 0, sync, 3) == 0);
+    ASSERT(bitbuffer_search(&bits, 0, 1, sync, 3) == 2);
+    ASSERT(bitbuffer_search(&bits, 0, 25, sync, 24) == 80);
+    ASSERT(bitbuffer_search(&bits, 0, 0, sync, 0) == 80);
+    uint8_t const tail[] = {0xaa, 0xaa, 0xaa, 0x2d, 0xd4, 0xf0, 0x0d, 0xca, 0xfe};
+    ASSERT(bitbuffer_search(&bits, 0, 0, tail, 72) == 8);
+    ASSERT(bitbuffer_search(&bits, 0, 9, tail, 72) == 80);
+    ASSERT(bitbuffer_search(&bits, 0, 0, &tail[7], 16) == 64);
+    uint8_t const tail17[] = {0xca, 0xfe, 0x80};
+    ASSERT(bitbuffer_search(&bits, 0, 0, tail17, 17) == 80);
+
+    fprintf(stderr, "TEST: bitbuffer:: Search against bit at a time\n");
+    bitbuffer_clear(&bits);
+    bitbuffer_add_row(&bits);
+    bits.bits_per_row[0] = 8 * BITBUF_COLS - 3;
+    unsigned seed = 1;
+    for (int i = 0; i < BITBUF_COLS; ++i) {
+        seed = seed * 1103515245 + 12345;
+        bits.bb[0][i] = (seed >> 16) & 0x0f ? 0xaa : (seed >> 8) & 0xff;
+    }
+    unsigned mismatches = 0;
+    for (unsigned len = 1; len <= 80; ++len) {
+        for (unsigned at = 0; at + len <= bits.bits_per_row[0]; at += 61) {
+            uint8_t pattern[10] = {0};
+            for (unsigned i = 0; i < len; ++i) {
+                if (bit_at(bits.bb[0], at + i))
+                    pattern[i / 8] |= 0x80 >> (i % 8);
+            }
+            for (unsigned start = 0; start <= at; start += 59) {
+                if (bitbuffer_search(&bits, 0, start, pattern, len) != search_bitwise(&bits, 0, start, pattern, len))
+                    mismatches++;
+            }
+        }
+    }
+    ASSERT(mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: Window summary\n");
+    bitbuffer_windows_t windows;
+    bitbuffer_windows_build(&bits, &windows);
+    unsigned missed = 0;
+    unsigned ruled_out = 0;
+    for (unsigned at = 0; at + 24 <= bits.bits_per_row[0]; at += 7) {
+        uint8_t present[3];
+        bitbuffer_extract_bytes(&bits, 0, at, present, 24);
+        bitbuffer_pattern_t prep = bitbuffer_search_prepare(present, 24);
+        if (!bitbuffer_windows_may_match(&windows, &prep))
+            missed++;
+        uint8_t absent[3] = {present[0] ^ 0x5a, present[1], present[2]};
+        prep = bitbuffer_search_prepare(absent, 24);
+        if (bitbuffer_search_pattern(&bits, 0, 0, &prep) == bits.bits_per_row[0] && !bitbuffer_windows_may_match(&windows, &prep))
+            ruled_out++;
+    }
+    ASSERT(missed == 0);
+    ASSERT(ruled_out > 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: Manchester decode against bit at a time\n");
+    bitbuffer_t *mc_out = calloc(4, sizeof(*mc_out));
+    if (!mc_out) {
+        return 1;
+    }
+    mismatches = 0;
+    for (int round = 0; round < 400; ++round) {
+        bitbuffer_clear(&bits);
+        bitbuffer_add_row(&bits);
+        bits.bits_per_row[0] = 8 * BITBUF_COLS;
+        // valid symbols with the odd error
+        for (int i = 0; i < BITBUF_COLS; ++i) {
+            seed = seed * 1103515245 + 12345;
+            uint8_t sym = (seed >> 16) & 0x55;
+            uint8_t clk = round & 1 ? 0xaa : (uint8_t)((seed >> 8) & 0xaa);
+            bits.bb[0][i] = (seed >> 24) % 97 == 0 ? (uint8_t)(seed >> 4) : sym | (uint8_t)(~sym << 1 & clk);
+        }
+        // differential symbols always start with a clock edge
+        for (int i = 1; round % 4 == 3 && i + 1 < 8 * BITBUF_COLS; i += 2) {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 24) % 211 == 0 || bit_at(bits.bb[0], i) == bit_at(bits.bb[0], i + 1))
+                bits.bb[0][(i + 1) / 8] ^= 0x80 >> ((i + 1) % 8);
+        }
+        seed = seed * 1103515245 + 12345;
+        unsigned start = (seed >> 16) % 40;
+        unsigned max   = round % 3 ? 0 : (seed >> 8) % 600;
+        bitbuffer_clear(&mc_out[0]);
+        bitbuffer_clear(&mc_out[1]);
+        bitbuffer_add_bit(&mc_out[0], 1); // unaligned output
+        bitbuffer_add_bit(&mc_out[1], 1);
+        unsigned pos   = bitbuffer_manchester_decode(&bits, 0, start, &mc_out[0], max);
+        unsigned ref   = manchester_bitwise(&bits, 0, start, &mc_out[1], max);
+        bitbuffer_clear(&mc_out[2]);
+        bitbuffer_clear(&mc_out[3]);
+        unsigned dpos  = bitbuffer_differential_manchester_decode(&bits, 0, start, &mc_out[2], max);
+        unsigned dref  = differential_manchester_bitwise(&bits, 0, start, &mc_out[3], max);
+        if (pos != ref || memcmp(&mc_out[0], &mc_out[1], sizeof(*mc_out))
+                || dpos != dref || memcmp(&mc_out[2], &mc_out[3], sizeof(*mc_out)))
+            mismatches++;
+    }
+    free(mc_out);
+    ASSERT(mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: Unique rows\n");
+    bitbuffer_parse(&bits, "{25}a5a5a58 {25}a5a5a58 {24}a5a5a5 {25}a5a5a50 {25}a5a5a58 {12}a50");
+    bitbuffer_row_repeats_t unique[BITBUF_ROWS];
+    ASSERT(bitbuffer_unique_rows(&bits, 0, unique) == 4);
+    ASSERT(unique[0].row == 0 && unique[0].repeats == 3);
+    ASSERT(unique[1].row == 2 && unique[1].repeats == 1);
+    ASSERT(unique[2].row == 3 && unique[2].repeats == 1);
+    ASSERT(bitbuffer_unique_rows(&bits, 24, unique) == 2);
+    ASSERT(unique[0].row == 0 && unique[0].repeats == 5);
+    ASSERT(bitbuffer_find_repeated_row(&bits, 3, 25) == 0);
+    ASSERT(bitbuffer_find_repeated_row(&bits, 4, 25) == -1);
+    ASSERT(bitbuffer_find_repeated_prefix(&bits, 5, 20) == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: Repeated rows against counting\n");
+    mismatches = 0;
+    for (int round = 0; round < 200; ++round) {
+        bitbuffer_clear(&bits);
+        for (int i = 0; i < BITBUF_ROWS; ++i) {
+            bitbuffer_add_row(&bits);
+            seed = seed * 1103515245 + 12345;
+            unsigned variant = (seed >> 16) % 4;
+            bits.bits_per_row[i] = (uint16_t)(20 + variant % 2 + round % 7);
+            bits.bb[i][0] = 0x5a;
+            bits.bb[i][1] = variant < 3 ? 0xc3 : 0xc7;
+            bits.bb[i][2] = (uint8_t)(round & 0x80);
+        }
+        for (unsigned min_bits = 0; min_bits < 30; min_bits += 3) {
+            for (unsigned min_repeats = 1; min_repeats < 40; min_repeats += 5) {
+                int ref_row = -1;
+                int ref_prefix = -1;
+                for (int i = bits.num_rows - 1; i >= 0; --i) {
+                    if (bits.bits_per_row[i] >= min_bits && bitbuffer_count_repeats(&bits, i, 0) >= min_repeats)
+                        ref_row = i;
+                    if (bits.bits_per_row[i] >= min_bits && bitbuffer_count_repeats(&bits, i, min_bits) >= min_repeats)
+                        ref_prefix = i;
+                }
+                if (bitbuffer_find_repeated_row(&bits, min_repeats, min_bits) != ref_row
+                        || bitbuffer_find_repeated_prefix(&bits, min_repeats, min_bits) != ref_prefix)
+                    mismatches++;
+            }
+        }
+    }
+    ASSERT(mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: Add runs and words against bit at a time\n");
+    bitbuffer_t *add_out = calloc(2, sizeof(*add_out));
+    if (!add_out) {
+        return 1;
+    }
+    mismatches = 0;
+    for (int round = 0; round < 60; ++round) {
+        bitbuffer_clear(&add_out[0]);
+        bitbuffer_clear(&add_out[1]);
+        // long rows spill over several rows and run into the row count limit
+        for (int op = 0; op < 400; ++op) {
+            seed = seed * 1103515245 + 12345;
+            unsigned kind = (seed >> 16) % 16;
+            if (kind == 0 && round % 2) {
+                bitbuffer_add_row(&add_out[0]);
+                bitbuffer_add_row(&add_out[1]);
+            }
+            else if (kind < 8) {
+                int bit        = (seed >> 3) & 1;
+                unsigned count = (seed >> 20) % (round % 3 ? 40 : 3000);
+                bitbuffer_add_bits_run(&add_out[0], bit, count);
+                for (unsigned i = 0; i < count; ++i)
+                    bitbuffer_add_bit(&add_out[1], bit);
+            }
+            else {
+                seed = seed * 1103515245 + 12345;
+                uint64_t word  = (uint64_t)seed << 32 | (seed * 2654435761u);
+                unsigned nbits = (seed >> 8) % 65;
+                bitbuffer_add_bits(&add_out[0], word, nbits);
+                for (unsigned i = nbits; i > 0; --i)
+                    bitbuffer_add_bit(&add_out[1], (word >> (i - 1)) & 1);
+            }
+        }
+        if (memcmp(&add_out[0], &add_out[1], sizeof(*add_out)))
+            mismatches++;
+    }
+    free(add_out);
+    ASSERT(mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: Transforms against byte at a time\n");
+    bitbuffer_t *tr = calloc(4, sizeof(*tr));
+    if (!tr) {
+        return 1;
+    }
+    void (*const transforms[])(bitbuffer_t *) = {bitbuffer_invert, bitbuffer_nrzs_decode, bitbuffer_nrzm_decode, bitbuffer_reflect};
+    void (*const transforms_to[])(bitbuffer_t const *, bitbuffer_t *) = {bitbuffer_invert_to, bitbuffer_nrzs_decode_to, bitbuffer_nrzm_decode_to, bitbuffer_reflect_to};
+    mismatches = 0;
+    for (int round = 0; round < 40; ++round) {
+        bitbuffer_clear(&tr[0]);
+        // rows of any length, some spill over several rows
+        for (int op = 0; op < 30; ++op) {
+            seed = seed * 1103515245 + 12345;
+            uint64_t word = (uint64_t)seed << 32 | (seed * 2654435761u);
+            unsigned count = (seed >> 20) % (round % 4 ? 3 : 40);
+            for (unsigned i = 0; i < count; ++i)
+                bitbuffer_add_bits(&tr[0], word * (i + 1), 64);
+            bitbuffer_add_bits(&tr[0], word, (seed >> 8) % 65);
+            if (round % 2)
+                bitbuffer_add_row(&tr[0]);
+        }
+        for (int op = 0; op < 4; ++op) {
+            tr[1] = tr[0];
+            tr[2] = tr[0];
+            transforms[op](&tr[1]);
+            transform_bytewise(&tr[2], op);
+            // the scratch buffer still holds the rows of the previous round
+            transforms_to[op](&tr[0], &tr[3]);
+            if (memcmp(&tr[1], &tr[2], sizeof(*tr)) || memcmp(&tr[1], &tr[3], sizeof(*tr)))
+                mismatches++;
+        }
+    }
+    // the source is unchanged
+    tr[1] = tr[0];
+    bitbuffer_invert_to(&tr[0], &tr[3]);
+    if (memcmp(&tr[0], &tr[1], sizeof(*tr)))
+        mismatches++;
+    free(tr);
+    ASSERT(mismatches == 0);
+
     fprintf(stderr, "TEST: bitbuffer:: Add 1 row too many\n");
     for (int i = 0; i <= BITBUF_ROWS; ++i) {
         bitbuffer_add_row(&bits);
@@ -0,0 +1,380 @@
+/** @file
+    Startup calibration, pick the fastest baseband kernels and block length on this machine.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "calibrate.h"
+#include "cpu_stats.h"
+#include "fatal.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#endif
+
+#define CACHE_LINE_MAX (CALIBRATE_KEY_MAX + 64)
+
+static uint32_t const block_lens[] = {1024, 2048, 4096, BASEBAND_FUSED_BLOCK_MAX};
+
+/// Copy the value of a "name : value" line of /proc/cpuinfo if the name matches, returns 1 if it did.
+static int cpuinfo_value(char const *line, char const *name, char *buf, size_t len)
+{
+    size_t name_len = strlen(name);
+    if (strncmp(line, name, name_len) || (line[name_len] != ' ' && line[name_len] != '\t' && line[name_len] != ':'))
+        return 0;
+    char const *colon = strchr(line, ':');
+    if (!colon)
+        return 0;
+    snprintf(buf, len, "%s", colon + 1 + strspn(colon + 1, " \t"));
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return 1;
+}
+
+/// Get the CPU model, "unknown" if not known.
+static void cpu_model(char *buf, size_t len)
+{
+    char model[128] = "";
+    char hardware[128] = "";
+    char part[32] = "";
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            // x86 has a model name, ARM a board model or hardware and the part of each core
+            if (!*model && cpuinfo_value(line, "model name", model, sizeof(model)))
+                continue;
+            if (!*hardware && (cpuinfo_value(line, "Model", hardware, sizeof(hardware)) || cpuinfo_value(line, "Hardware", hardware, sizeof(hardware))))
+                continue;
+            if (!*part)
+                cpuinfo_value(line, "CPU part", part, sizeof(part));
+        }
+        fclose(file);
+    }
+    if (*model)
+        snprintf(buf, len, "%s", model);
+    else if (*hardware || *part)
+        snprintf(buf, len, "%s%s%s", hardware, *hardware && *part ? " part " : "", part);
+    else
+        snprintf(buf, len, "unknown");
+}
+
+void calibrate_key(char *key, size_t key_len, char const *build, uint32_t samp_rate, uint32_t n_samples)
+{
+    char model[256];
+    cpu_model(model, sizeof(model));
+    snprintf(key, key_len, "%s|%s%s|%u|%u", model, build,
+#ifdef FIXED_POINT
+            " fixed point",
+#else
+            "",
+#endif
+            samp_rate, n_samples);
+    // the key is a field of a line
+    for (char *p = key; *p; ++p) {
+        if (*p == '\t' || *p == '\r' || *p == '\n')
+            *p = ' ';
+    }
+}
+
+/// Make a synthetic CU8 signal, OOK bursts of a carrier off the center in noise.
+static void synthesize(uint8_t *iq_buf, uint32_t n_samples)
+{
+    uint32_t lcg = 12345;
+    for (uint32_t i = 0; i < n_samples; ++i) {
+        int on  = (i / 500) % 3 == 0;
+        double a = on ? 100.0 : 0.0;
+        lcg = lcg * 1103515245u + 12345u;
+        int noise_i = (int)(lcg >> 28) - 8;
+        lcg = lcg * 1103515245u + 12345u;
+        int noise_q = (int)(lcg >> 28) - 8;
+        iq_buf[2 * i]     = (uint8_t)(128 + (int)(a * cos(i * 0.3)) + noise_i);
+        iq_buf[2 * i + 1] = (uint8_t)(128 + (int)(a * sin(i * 0.3)) + noise_q);
+    }
+}
+
+/// Time the fused demodulator with the current choice, the fastest of the runs in ns.
+static uint64_t time_fused(uint8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, uint32_t n_samples, uint32_t samp_rate,
+        demodfm_state_t *fm_state)
+{
+    filter_state_t lp_state = {0};
+    uint64_t best = UINT64_MAX;
+    // a first run to warm the caches
+    for (int run = 0; run <= CALIBRATE_RUNS; ++run) {
+        uint64_t start = cpu_stats_now();
+        baseband_demod_fused_cu8(iq_buf, am_buf, fm_buf, n_samples, 0, &lp_state, samp_rate, 0.1f, fm_state);
+        uint64_t ns = cpu_stats_now() - start;
+        if (run && ns < best)
+            best = ns;
+    }
+    return best ? best : 1;
+}
+
+int calibrate_measure(uint32_t samp_rate, uint32_t n_samples, calibration_t *cal)
+{
+    if (n_samples > CALIBRATE_SAMPLES)
+        n_samples = CALIBRATE_SAMPLES;
+    if (!n_samples)
+        n_samples = 1;
+
+    uint8_t *iq_buf = malloc(2 * n_samples);
+    if (!iq_buf) {
+        WARN_MALLOC("calibrate_measure()");
+        return -1;
+    }
+    int16_t *am_buf = malloc(2 * n_samples * sizeof(*am_buf));
+    if (!am_buf) {
+        WARN_MALLOC("calibrate_measure()");
+        free(iq_buf);
+        return -1;
+    }
+    int16_t *fm_buf = am_buf + n_samples;
+    synthesize(iq_buf, n_samples);
+
+    baseband_simd_t prev_simd = baseband_get_simd();
+    uint32_t prev_block       = baseband_get_fused_block();
+    uint64_t best_ns          = UINT64_MAX;
+    uint64_t default_ns       = 0;
+    demodfm_state_t fm_state  = {0}; // kept, the filter is set up once
+    *cal = (calibration_t){.simd = prev_simd, .fused_block = prev_block, .source = CALIBRATION_MEASURED};
+    for (baseband_simd_t simd = BASEBAND_SIMD_NONE; simd <= BASEBAND_SIMD_NEON; ++simd) {
+        if (baseband_set_simd(simd))
+            continue; // not supported
+        for (unsigned i = 0; i < sizeof(block_lens) / sizeof(*block_lens); ++i) {
+            baseband_set_fused_block(block_lens[i]);
+            uint64_t ns = time_fused(iq_buf, am_buf, fm_buf, n_samples, samp_rate, &fm_state);
+            if (simd == prev_simd && block_lens[i] == prev_block)
+                default_ns = ns;
+            if (ns < best_ns) {
+                best_ns          = ns;
+                cal->simd        = simd;
+                cal->fused_block = block_lens[i];
+            }
+        }
+    }
+    baseband_set_simd(prev_simd);
+    baseband_set_fused_block(prev_block);
+    free(am_buf);
+    free(iq_buf);
+
+    cal->msps         = n_samples * 1e3 / best_ns;
+    cal->msps_default = default_ns ? n_samples * 1e3 / default_ns : 0.0;
+    return 0;
+}
+
+/// Returns 1 if this build and CPU support the kernels, the current choice is kept.
+static int simd_supported(baseband_simd_t simd)
+{
+    baseband_simd_t prev = baseband_get_simd();
+    if (baseband_set_simd(simd))
+        return 0;
+    baseband_set_simd(prev);
+    return 1;
+}
+
+/// Parse a "key\tsimd\tblock\tmsps" line of the cache, returns 0 if it has the key.
+static int parse_line(char *line, char const *key, calibration_t *cal)
+{
+    line[strcspn(line, "\r\n")] = '\0';
+    char *simd_name = strchr(line, '\t');
+    if (!simd_name)
+        return -1;
+    *simd_name++ = '\0';
+    if (strcmp(line, key))
+        return -1;
+    char *block = strchr(simd_name, '\t');
+    if (!block)
+        return -1;
+    *block++ = '\0';
+    for (baseband_simd_t simd = BASEBAND_SIMD_NONE; simd <= BASEBAND_SIMD_NEON; ++simd) {
+        if (strcmp(simd_name, baseband_simd_name(simd)))
+            continue;
+        char *end;
+        unsigned long len = strtoul(block, &end, 10);
+        if (end == block || len < 64 || len > BASEBAND_FUSED_BLOCK_MAX)
+            return -1;
+        *cal = (calibration_t){
+                .simd        = simd,
+                .fused_block = (uint32_t)len,
+                .source      = CALIBRATION_CACHED,
+                .msps        = *end == '\t' ? atof(end + 1) : 0.0,
+        };
+        return 0;
+    }
+    return -1;
+}
+
+int calibrate_load(char const *path, char const *key, calibration_t *cal)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return -1;
+    char line[CACHE_LINE_MAX];
+    int ret = -1;
+    while (ret && fgets(line, sizeof(line), file))
+        ret = parse_line(line, key, cal);
+    fclose(file);
+    if (!ret && !simd_supported(cal->simd))
+        ret = -1; // e.g. the cache is shared with another machine
+    return ret;
+}
+
+/// Create the directories of a file path, returns 0 on success.
+static int make_dirs(char const *path)
+{
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; ++p) {
+        if (*p != '/' && *p != '\\')
+            continue;
+        char sep = *p;
+        *p = '\0';
+        if (mkdir(dir, 0755) && errno != EEXIST)
+            return -1;
+        *p = sep;
+    }
+    return 0;
+}
+
+int calibrate_save(char const *path, char const *key, calibration_t const *cal)
+{
+    if (make_dirs(path))
+        return -1;
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *tmp = fopen(tmp_path, "w");
+    if (!tmp)
+        return -1;
+
+    // keep the choices of the other keys
+    FILE *file = fopen(path, "r");
+    if (file) {
+        char line[CACHE_LINE_MAX];
+        size_t key_len = strlen(key);
+        while (fgets(line, sizeof(line), file)) {
+            if (!strncmp(line, key, key_len) && line[key_len] == '\t')
+                continue;
+            fputs(line, tmp);
+        }
+        fclose(file);
+    }
+    fprintf(tmp, "%s\t%s\t%u\t%.1f\n", key, baseband_simd_name(cal->simd), cal->fused_block, cal->msps);
+    if (ferror(tmp) || fclose(tmp)) {
+        remove(tmp_path);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(path); // rename() does not replace on Windows
+#endif
+    if (rename(tmp_path, path)) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+void calibrate_apply(calibration_t const *cal)
+{
+    baseband_set_simd(cal->simd);
+    baseband_set_fused_block(cal->fused_block);
+}
+
+int calibrate_default_path(char *path, size_t path_len)
+{
+#ifdef _WIN32
+    char const *dir = getenv("LOCALAPPDATA");
+    if (!dir || !*dir)
+        return -1;
+    snprintf(path, path_len, "%s\\rtl_433\\calibration", dir);
+#else
+    char const *dir = getenv("XDG_CACHE_HOME");
+    if (dir && *dir) {
+        snprintf(path, path_len, "%s/rtl_433/calibration", dir);
+        return 0;
+    }
+    dir = getenv("HOME");
+    if (!dir || !*dir)
+        return -1;
+    snprintf(path, path_len, "%s/.cache/rtl_433/calibration", dir);
+#endif
+    return 0;
+}
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    baseband_init();
+    baseband_simd_t init_simd = baseband_get_simd();
+
+    fprintf(stderr, "calibrate:: the key has the build, rate, and length\n");
+    char key[CALIBRATE_KEY_MAX];
+    calibrate_key(key, sizeof(key), "test\tbuild", 250000, 131072);
+    ASSERT_EQUALS(strstr(key, "|test build") != NULL, 1);
+    ASSERT_EQUALS(strstr(key, "|250000|131072") != NULL, 1);
+
+    fprintf(stderr, "calibrate:: measure, the choice is the fastest and the defaults are kept\n");
+    calibration_t cal;
+    ASSERT_EQUALS(calibrate_measure(250000, 16384, &cal), 0);
+    ASSERT_EQUALS(cal.source, CALIBRATION_MEASURED);
+    ASSERT_EQUALS(simd_supported(cal.simd), 1);
+    ASSERT_EQUALS(cal.msps > 0.0 && cal.msps >= cal.msps_default, 1);
+    ASSERT_EQUALS((int)baseband_get_simd(), (int)init_simd);
+    ASSERT_EQUALS((int)baseband_get_fused_block(), BASEBAND_FUSED_BLOCK_MAX);
+    calibrate_apply(&cal);
+    ASSERT_EQUALS((int)baseband_get_simd(), (int)cal.simd);
+    ASSERT_EQUALS((int)baseband_get_fused_block(), (int)cal.fused_block);
+
+    fprintf(stderr, "calibrate:: save and load, the other keys are kept\n");
+    char path[256];
+    snprintf(path, sizeof(path), "calibrate_test_%d/calibration", (int)(cpu_stats_now() % 100000));
+    calibration_t other = {.simd = BASEBAND_SIMD_NONE, .fused_block = 2048, .msps = 12.5};
+    ASSERT_EQUALS(calibrate_save(path, "other|key", &other), 0);
+    ASSERT_EQUALS(calibrate_save(path, key, &cal), 0);
+    cal.fused_block = 1024;
+    ASSERT_EQUALS(calibrate_save(path, key, &cal), 0);
+    calibration_t loaded;
+    ASSERT_EQUALS(calibrate_load(path, key, &loaded), 0);
+    ASSERT_EQUALS(loaded.source, CALIBRATION_CACHED);
+    ASSERT_EQUALS((int)loaded.simd, (int)cal.simd);
+    ASSERT_EQUALS((int)loaded.fused_block, 1024);
+    ASSERT_EQUALS(calibrate_load(path, "other|key", &loaded), 0);
+    ASSERT_EQUALS((int)loaded.fused_block, 2048);
+    ASSERT_EQUALS(loaded.msps == 12.5, 1);
+    ASSERT_EQUALS(calibrate_load(path, "missing|key", &loaded), -1);
+    ASSERT_EQUALS(calibrate_load("calibrate_test_missing", key, &loaded), -1);
+    remove(path);
+    *strrchr(path, '/') = '\0';
+    remove(path);
+
+    fprintf(stderr, "calibrate:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,51 @@
+/** @file
+    compat_atomic addresses compatibility atomic operations and thread local storage.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "compat_atomic.h"
+
+#if !ATOMIC_64_LOCK_FREE
+
+// only the 32 bit GCC targets without 64 bit atomics get here, never Windows
+#ifdef THREADS
+#include <pthread.h>
+
+static pthread_mutex_t atomic64_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ATOMIC64_LOCK()   pthread_mutex_lock(&atomic64_lock)
+#define ATOMIC64_UNLOCK() pthread_mutex_unlock(&atomic64_lock)
+#else
+#define ATOMIC64_LOCK()
+#define ATOMIC64_UNLOCK()
+#endif
+
+uint64_t atomic_get64(uint64_t const *p)
+{
+    ATOMIC64_LOCK();
+    uint64_t v = *p;
+    ATOMIC64_UNLOCK();
+    return v;
+}
+
+void atomic_set64(uint64_t *p, uint64_t v)
+{
+    ATOMIC64_LOCK();
+    *p = v;
+    ATOMIC64_UNLOCK();
+}
+
+uint64_t atomic_add64(uint64_t *p, uint64_t v)
+{
+    ATOMIC64_LOCK();
+    v = *p += v;
+    ATOMIC64_UNLOCK();
+    return v;
+}
+
+#endif /* !ATOMIC_64_LOCK_FREE */
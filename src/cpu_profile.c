@@ -0,0 +1,210 @@
+/** @file
+    CPU time profile of the processing stages, decoders, and outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "cpu_profile.h"
+#include "rtl_433.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "data.h"
+#include "list.h"
+#include "abuf.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FOLDED_LINE_MAX 400 ///< room for a stack of the longest decoder name
+
+/// Sum the stage counters of all channels of the first input.
+static void read_stages(struct r_cfg *cfg, uint64_t stages[CPU_STAGE_COUNT])
+{
+    unsigned n_chans = cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+    for (int s = 0; s < CPU_STAGE_COUNT; ++s) {
+        stages[s] = 0;
+        for (unsigned i = 0; i < n_chans; ++i) {
+            struct dm_state *chan = cfg->channels.len ? cfg->channels.elems[i] : cfg->demod;
+            stages[s] += chan->cpu_stages[s].ns;
+        }
+    }
+}
+
+void cpu_profile_start(cpu_profile_t *prof, struct r_cfg *cfg)
+{
+    cpu_profile_free(prof, cfg);
+
+    list_t *r_devs = &cfg->demod->r_devs;
+    prof->decoders = calloc(r_devs->len ? r_devs->len : 1, sizeof(*prof->decoders));
+    if (!prof->decoders)
+        FATAL_CALLOC("cpu_profile_start()");
+    prof->outputs = calloc(cfg->output_handler.len ? cfg->output_handler.len : 1, sizeof(*prof->outputs));
+    if (!prof->outputs)
+        FATAL_CALLOC("cpu_profile_start()");
+
+    prof->was_enabled = cpu_stats_enabled();
+    cpu_stats_enable(1);
+
+    read_stages(cfg, prof->stages);
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device const *r_dev = *iter;
+        cpu_profile_decoder_t *dec = &prof->decoders[prof->num_decoders++];
+        dec->r_dev     = r_dev;
+        dec->slice_ns  = r_dev->cpu_slice.ns;
+        dec->decode_ns = r_dev->cpu_decode.ns;
+    }
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t const *output = cfg->output_handler.elems[i];
+        prof->outputs[prof->num_outputs++] = output ? output->cpu_stat.ns : 0;
+    }
+
+    prof->start_time = time(NULL);
+    prof->running    = 1;
+}
+
+void cpu_profile_stop(cpu_profile_t *prof, struct r_cfg *cfg)
+{
+    if (!prof->running)
+        return;
+
+    prof->folded    = cpu_profile_folded(prof, cfg);
+    prof->stop_time = time(NULL);
+    prof->running   = 0;
+    if (!prof->was_enabled)
+        cpu_stats_enable(0);
+}
+
+/// The slicer of a decoder as a frame name.
+static char const *slicer_frame(unsigned modulation)
+{
+    switch (modulation) {
+    case OOK_PULSE_PCM:
+    case FSK_PULSE_PCM:
+        return "pulse_slicer_pcm";
+    case OOK_PULSE_PPM:
+        return "pulse_slicer_ppm";
+    case OOK_PULSE_PWM:
+    case FSK_PULSE_PWM:
+        return "pulse_slicer_pwm";
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        return "pulse_slicer_manchester_zerobit";
+    case OOK_PULSE_PIWM_RAW:
+        return "pulse_slicer_piwm_raw";
+    case OOK_PULSE_PIWM_DC:
+        return "pulse_slicer_piwm_dc";
+    case OOK_PULSE_DMC:
+        return "pulse_slicer_dmc";
+    case OOK_PULSE_PWM_OSV1:
+        return "pulse_slicer_osv1";
+    case OOK_PULSE_NRZS:
+        return "pulse_slicer_nrzs";
+    default:
+        return "pulse_slicer";
+    }
+}
+
+/// Append a stack with the time since the start, skips empty stacks.
+static void folded_stack(abuf_t *buf, char const *stack, uint64_t ns, uint64_t start_ns)
+{
+    // the counters of a replaced decoder or output restart from 0
+    uint64_t us = (ns >= start_ns ? ns - start_ns : ns) / 1000;
+    if (us)
+        abuf_printf(buf, "%s %llu\n", stack, (unsigned long long)us);
+}
+
+char *cpu_profile_folded(cpu_profile_t const *prof, struct r_cfg *cfg)
+{
+    if (!prof->running && !prof->folded) {
+        return NULL;
+    }
+    else if (!prof->running) {
+        char *text = strdup(prof->folded);
+        if (!text)
+            WARN_STRDUP("cpu_profile_folded()");
+        return text;
+    }
+
+    list_t *r_devs = &cfg->demod->r_devs;
+    size_t size = (CPU_STAGE_COUNT + r_devs->len * 2 + cfg->output_handler.len + 1) * FOLDED_LINE_MAX;
+    char *text = malloc(size);
+    if (!text) {
+        WARN_MALLOC("cpu_profile_folded()");
+        return NULL;
+    }
+    abuf_t buf;
+    abuf_init(&buf, text, size);
+
+    uint64_t stages[CPU_STAGE_COUNT];
+    read_stages(cfg, stages);
+    static char const *const stage_stacks[CPU_STAGE_DECODE] = {
+            "sdr_callback;baseband;decimate",
+            "sdr_callback;baseband;envelope",
+            "sdr_callback;baseband;lowpass",
+            "sdr_callback;baseband;fm",
+            "sdr_callback;pulse_detect",
+    };
+    for (int s = 0; s < CPU_STAGE_DECODE; ++s)
+        folded_stack(&buf, stage_stacks[s], stages[s], prof->stages[s]);
+
+    // the decode stage less the decoders is the dispatch, negative if the decode pool runs the decoders in parallel
+    uint64_t decoders_ns = 0;
+    uint64_t decoders_start_ns = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device const *r_dev = *iter;
+        cpu_profile_decoder_t const *dec = NULL;
+        for (unsigned i = 0; !dec && i < prof->num_decoders; ++i)
+            dec = prof->decoders[i].r_dev == r_dev ? &prof->decoders[i] : NULL;
+        uint64_t slice_start  = dec && dec->slice_ns <= r_dev->cpu_slice.ns ? dec->slice_ns : 0;
+        uint64_t decode_start = dec && dec->decode_ns <= r_dev->cpu_decode.ns ? dec->decode_ns : 0;
+        decoders_ns += r_dev->cpu_slice.ns;
+        decoders_start_ns += slice_start;
+
+        // the flame graph separates frames with ';' and the value with the last space
+        char name[FOLDED_LINE_MAX - 100];
+        snprintf(name, sizeof(name), "%s", r_dev->name ? r_dev->name : "");
+        for (char *p = name; *p; ++p) {
+            if (*p == ';' || *p == '\n')
+                *p = ',';
+        }
+        char const *demods = r_dev->modulation >= FSK_DEMOD_MIN_VAL ? "run_fsk_demods" : "run_ook_demods";
+        char const *slicer = slicer_frame(r_dev->modulation);
+        char stack[FOLDED_LINE_MAX];
+        snprintf(stack, sizeof(stack), "sdr_callback;%s;%s", demods, slicer);
+        folded_stack(&buf, stack, r_dev->cpu_slice.ns - r_dev->cpu_decode.ns, slice_start - decode_start);
+        snprintf(stack, sizeof(stack), "sdr_callback;%s;%s;%s", demods, slicer, name);
+        folded_stack(&buf, stack, r_dev->cpu_decode.ns, decode_start);
+    }
+    uint64_t decode_ns = stages[CPU_STAGE_DECODE] >= prof->stages[CPU_STAGE_DECODE]
+            ? stages[CPU_STAGE_DECODE] - prof->stages[CPU_STAGE_DECODE] : stages[CPU_STAGE_DECODE];
+    uint64_t dispatch_ns = decoders_ns - decoders_start_ns;
+    if (decode_ns > dispatch_ns)
+        folded_stack(&buf, "sdr_callback;decode_package", decode_ns - dispatch_ns, 0);
+
+    // the outputs run on the event loop when the demodulation has a thread of its own
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) {
+        data_output_t const *output = cfg->output_handler.elems[i];
+        if (!output)
+            continue;
+        char stack[64];
+        snprintf(stack, sizeof(stack), "event_loop;data_output_print;output_%u", (unsigned)i);
+        folded_stack(&buf, stack, output->cpu_stat.ns, i < prof->num_outputs ? prof->outputs[i] : 0);
+    }
+
+    return text;
+}
+
+void cpu_profile_free(cpu_profile_t *prof, struct r_cfg *cfg)
+{
+    cpu_profile_stop(prof, cfg);
+    free(prof->decoders);
+    free(prof->outputs);
+    free(prof->folded);
+    *prof = (cpu_profile_t){0};
+}
@@ -0,0 +1,72 @@
+/** @file
+    CPU time accounting of the processing stages, decoders, and outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "cpu_stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static int volatile cpu_stats_on; // toggled by a profile while the threads run
+
+void cpu_stats_enable(int enable)
+{
+    cpu_stats_on = enable;
+}
+
+int cpu_stats_enabled(void)
+{
+    return cpu_stats_on;
+}
+
+uint64_t cpu_stats_now(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart + 1;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec + 1;
+#endif
+}
+
+uint64_t cpu_stats_start(void)
+{
+    return cpu_stats_on ? cpu_stats_now() : 0;
+}
+
+void cpu_stats_end(cpu_stat_t *stat, uint64_t start)
+{
+    if (!start)
+        return;
+    stat->ns += cpu_stats_now() - start;
+    stat->calls += 1;
+}
+
+char const *cpu_stage_name(enum cpu_stage stage)
+{
+    switch (stage) {
+    case CPU_STAGE_DECIMATE: return "decimate";
+    case CPU_STAGE_ENVELOPE: return "envelope";
+    case CPU_STAGE_LOWPASS: return "lowpass";
+    case CPU_STAGE_FM: return "fm";
+    case CPU_STAGE_DETECT: return "detect";
+    case CPU_STAGE_DECODE: return "decode";
+    default: return "";
+    }
+}
@@ -13,6 +13,7 @@
 #include "data.h"
 
 #include "abuf.h"
+#include "compat_atomic.h"
 #include "fatal.h"
 
 #include <stdarg.h>
@@ -151,23 +152,481 @@ alloc_error:
     return NULL;
 }
 
+/* key ids */
+
+/// Names of the well-known keys, sorted, indexed by data_key_ids.
+static char const *const data_key_names[DATA_KEY_COUNT] = {
+        "",
+        "channel",
+        "codes",
+        "freq",
+        "freq1",
+        "freq2",
+        "id",
+        "lvl",
+        "mic",
+        "mod",
+        "model",
+        "msg",
+        "noise",
+        "num_rows",
+        "protocol",
+        "rssi",
+        "snr",
+        "src",
+        "subtype",
+        "tag",
+        "time",
+        "type",
+};
+
+static char **interned_keys;         ///< interned keys, the id is DATA_KEY_COUNT + index
+static unsigned interned_len;        ///< number of interned keys
+static unsigned interned_size;       ///< capacity of interned_keys
+static unsigned *interned_slots;     ///< open addressing hash of key ids, 0 is empty
+static unsigned interned_slots_size; ///< power of two, at least twice interned_len
+
+static unsigned key_hash(char const *key)
+{
+    unsigned h = 2166136261u; // FNV-1a
+    for (; *key; ++key)
+        h = (h ^ (unsigned char)*key) * 16777619u;
+    return h;
+}
+
+static unsigned known_key_id(char const *key)
+{
+    unsigned lo = 1;
+    unsigned hi = DATA_KEY_COUNT;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        int cmp = strcmp(key, data_key_names[mid]);
+        if (!cmp)
+            return mid;
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return DATA_KEY_OTHER;
+}
+
+/// Returns the slot for @p key, either holding its id or empty.
+static unsigned *interned_slot(char const *key)
+{
+    unsigned mask = interned_slots_size - 1;
+    for (unsigned i = key_hash(key) & mask;; i = (i + 1) & mask) {
+        unsigned id = interned_slots[i];
+        if (!id || !strcmp(interned_keys[id - DATA_KEY_COUNT], key))
+            return &interned_slots[i];
+    }
+}
+
+R_API unsigned data_key_id(char const *key)
+{
+    unsigned id = known_key_id(key);
+    if (id || !interned_len)
+        return id;
+    return *interned_slot(key);
+}
+
+R_API unsigned data_key_intern(char const *key)
+{
+    unsigned id = known_key_id(key);
+    if (id)
+        return id;
+    if (interned_len && (id = *interned_slot(key)))
+        return id;
+
+    if (interned_len >= interned_size) {
+        unsigned size = interned_size ? interned_size * 2 : 64;
+        char **keys = realloc(interned_keys, size * sizeof(*keys));
+        if (!keys) {
+            WARN_REALLOC("data_key_intern()");
+            return 0; // NOTE: returns 0 on alloc failure.
+        }
+        interned_keys = keys;
+        interned_size = size;
+    }
+    if (2 * (interned_len + 1) > interned_slots_size) {
+        unsigned size = interned_slots_size ? interned_slots_size * 2 : 128;
+        unsigned *slots = calloc(size, sizeof(*slots));
+        if (!slots) {
+            WARN_CALLOC("data_key_intern()");
+            return 0; // NOTE: returns 0 on alloc failure.
+        }
+        free(interned_slots);
+        interned_slots      = slots;
+        interned_slots_size = size;
+        for (unsigned i = 0; i < interned_len; ++i)
+            *interned_slot(interned_keys[i]) = DATA_KEY_COUNT + i;
+    }
+    char *dup = strdup(key);
+    if (!dup) {
+        WARN_STRDUP("data_key_intern()");
+        return 0; // NOTE: returns 0 on alloc failure.
+    }
+    unsigned *slot = interned_slot(key);
+    interned_keys[interned_len] = dup;
+    *slot = DATA_KEY_COUNT + interned_len++;
+    return *slot;
+}
+
+R_API char const *data_key_name(unsigned key_id)
+{
+    if (key_id && key_id < DATA_KEY_COUNT)
+        return data_key_names[key_id];
+    if (key_id >= DATA_KEY_COUNT && key_id < DATA_KEY_COUNT + interned_len)
+        return interned_keys[key_id - DATA_KEY_COUNT];
+    return NULL;
+}
+
+R_API unsigned data_key_count(void)
+{
+    return DATA_KEY_COUNT + interned_len;
+}
+
+R_API uint32_t data_sensor_key(data_t const *data)
+{
+    int has_model = 0;
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (; data; data = data->next) {
+        if (data->key_id != DATA_KEY_MODEL && data->key_id != DATA_KEY_ID && data->key_id != DATA_KEY_CHANNEL)
+            continue;
+        has_model |= data->key_id == DATA_KEY_MODEL;
+        unsigned char const *p = (unsigned char const *)&data->key_id;
+        size_t len = sizeof(data->key_id);
+        if (data->type == DATA_STRING)
+            p = data->value.v_ptr, len = strlen(data->value.v_ptr);
+        else if (data->type == DATA_INT)
+            p = (unsigned char const *)&data->value.v_int, len = sizeof(data->value.v_int);
+        hash = (hash ^ data->key_id) * 16777619u;
+        for (size_t i = 0; i < len; ++i)
+            hash = (hash ^ p[i]) * 16777619u;
+    }
+    if (!has_model)
+        return 0;
+    return hash ? hash : 1;
+}
+
+/* field projections */
+
+struct data_projection {
+    data_render_t render; ///< the renderings of the projected record
+    unsigned rules_len;
+    struct data_projection_rule {
+        char *model;      ///< the model, NULL for all models
+        int exclude;
+        unsigned ids_len;
+        unsigned *ids;
+    } *rules;
+    data_skip_t *all;     ///< the fields to skip for the models without a rule, NULL to print all
+    data_skip_t **models; ///< the fields to skip for the model of each rule, by rule
+};
+
+R_API int data_skip(data_skip_t const *skip, data_t const *data)
+{
+    if (!skip)
+        return 0;
+    return skip->flags[data->key_id < skip->len ? data->key_id : 0];
+}
+
+/// Returns 1 if the model pattern of a rule matches @p model, a trailing "*" matches any suffix.
+static int projection_model_match(char const *pattern, char const *model)
+{
+    size_t len = strlen(pattern);
+    if (len && pattern[len - 1] == '*')
+        return !strncmp(pattern, model, len - 1);
+    return !strcmp(pattern, model);
+}
+
+/// Returns the fields to skip with the rules for all models and the rules for @p model, NULL if none are skipped.
+static data_skip_t *projection_build(data_projection_t const *projection, char const *model)
+{
+    unsigned len = data_key_count();
+    int include  = 0;
+    int exclude  = 0;
+    for (unsigned i = 0; i < projection->rules_len; ++i) {
+        struct data_projection_rule const *rule = &projection->rules[i];
+        if (rule->model && (!model || strcmp(rule->model, model)))
+            continue;
+        include |= !rule->exclude;
+        exclude |= rule->exclude;
+    }
+    if (!include && !exclude)
+        return NULL;
+
+    data_skip_t *skip = calloc(1, sizeof(*skip) + len);
+    if (!skip) {
+        WARN_CALLOC("projection_build()");
+        return NULL; // NOTE: prints all fields on alloc failure.
+    }
+    skip->len = len;
+    // without an include list all fields print, unknown keys only with none
+    memset(skip->flags, include, len);
+    for (int pass = 0; pass < 2; ++pass) {
+        // excludes go last and win over includes
+        for (unsigned i = 0; i < projection->rules_len; ++i) {
+            struct data_projection_rule const *rule = &projection->rules[i];
+            if (rule->exclude != pass || (rule->model && (!model || strcmp(rule->model, model))))
+                continue;
+            for (unsigned j = 0; j < rule->ids_len; ++j)
+                skip->flags[rule->ids[j]] = (unsigned char)pass;
+        }
+    }
+    return skip;
+}
+
+static void projection_free_skips(data_projection_t *projection)
+{
+    free(projection->all);
+    projection->all = NULL;
+    if (projection->models) {
+        for (unsigned i = 0; i < projection->rules_len; ++i)
+            free(projection->models[i]);
+    }
+    free(projection->models);
+    projection->models = NULL;
+}
+
+R_API data_projection_t *data_projection_create(void)
+{
+    data_projection_t *projection = calloc(1, sizeof(*projection));
+    if (!projection) {
+        WARN_CALLOC("data_projection_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    return projection;
+}
+
+R_API int data_projection_add(data_projection_t *projection, char const *rule, int exclude)
+{
+    if (!projection || !rule)
+        return -1;
+    struct data_projection_rule r = {.exclude = exclude};
+    char const *keys = strchr(rule, '/');
+    if (keys) {
+        r.model = strdup(rule);
+        if (!r.model) {
+            WARN_STRDUP("data_projection_add()");
+            return -1;
+        }
+        r.model[keys - rule] = '\0';
+        keys++;
+    }
+    else {
+        keys = rule;
+    }
+
+    r.ids = calloc(strlen(keys) / 2 + 1, sizeof(*r.ids)); // at most every other char starts a key
+    if (!r.ids) {
+        WARN_CALLOC("data_projection_add()");
+        free(r.model);
+        return -1;
+    }
+    int valid = !r.model || *r.model;
+    while (valid) {
+        size_t key_len = strcspn(keys, "+");
+        char key[64];
+        valid = key_len && key_len < sizeof(key);
+        if (!valid)
+            break;
+        memcpy(key, keys, key_len);
+        key[key_len] = '\0';
+        unsigned id = data_key_intern(key);
+        valid = id != 0;
+        if (!valid)
+            break;
+        r.ids[r.ids_len++] = id;
+        keys += key_len;
+        if (!*keys)
+            break;
+        keys++; // the "+" before the next key
+    }
+    if (!valid) {
+        free(r.ids);
+        free(r.model);
+        return -1;
+    }
+
+    struct data_projection_rule *rules = realloc(projection->rules, (projection->rules_len + 1) * sizeof(*rules));
+    if (!rules) {
+        WARN_REALLOC("data_projection_add()");
+        free(r.ids);
+        free(r.model);
+        return -1;
+    }
+    // the skips are rebuilt for the new rule and the keys interned meanwhile
+    projection_free_skips(projection);
+    projection->rules = rules;
+    projection->rules[projection->rules_len++] = r;
+    projection->all    = projection_build(projection, NULL);
+    projection->models = calloc(projection->rules_len, sizeof(*projection->models));
+    if (!projection->models) {
+        WARN_CALLOC("data_projection_add()");
+        return 0; // NOTE: the model rules are ignored on alloc failure.
+    }
+    for (unsigned i = 0; i < projection->rules_len; ++i) {
+        if (projection->rules[i].model)
+            projection->models[i] = projection_build(projection, projection->rules[i].model);
+    }
+    return 0;
+}
+
+R_API data_skip_t const *data_projection_skip(data_projection_t const *projection, data_t const *data)
+{
+    if (!projection)
+        return NULL;
+    char const *model = NULL;
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING) {
+            model = d->value.v_ptr;
+            break;
+        }
+    }
+    if (!model)
+        return NULL; // logs and reports print all fields
+    if (!projection->models)
+        return projection->all;
+    for (unsigned i = 0; i < projection->rules_len; ++i) {
+        char const *pattern = projection->rules[i].model;
+        if (pattern && projection_model_match(pattern, model))
+            return projection->models[i];
+    }
+    return projection->all;
+}
+
+R_API void data_projection_free(data_projection_t *projection)
+{
+    if (!projection)
+        return;
+    projection_free_skips(projection);
+    for (unsigned i = 0; i < projection->rules_len; ++i) {
+        free(projection->rules[i].model);
+        free(projection->rules[i].ids);
+    }
+    free(projection->rules);
+    data_render_free(&projection->render);
+    free(projection);
+}
+
+R_API void data_key_free_all(void)
+{
+    for (unsigned i = 0; i < interned_len; ++i)
+        free(interned_keys[i]);
+    free(interned_keys);
+    free(interned_slots);
+    interned_keys       = NULL;
+    interned_slots      = NULL;
+    interned_len        = 0;
+    interned_size       = 0;
+    interned_slots_size = 0;
+}
+
 // the static analyzer can't prove the allocs to be correct
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunknown-warning-option"
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 
+/// The cache of the calling thread, NULL if none.
+static COMPAT_TLS data_cache_t *data_cache;
+
+R_API data_cache_t *data_cache_use(data_cache_t *cache)
+{
+    data_cache_t *prev = data_cache;
+    data_cache = cache;
+    return prev;
+}
+
+R_API void data_cache_clear(data_cache_t *cache)
+{
+    while (cache->free_list) {
+        data_t *data = cache->free_list;
+        cache->free_list = data->next;
+        free(data);
+    }
+    cache->len = 0;
+}
+
+/// Allocate an element of @p size bytes, a cache block if the thread uses a cache and it fits.
+static data_t *data_element_get(size_t size)
+{
+    data_cache_t *cache = data_cache;
+    if (!cache || size > DATA_CACHE_BLOCK) {
+        data_t *data = calloc(1, size);
+        if (!data)
+            return NULL;
+        return data;
+    }
+
+    data_t *data = cache->free_list;
+    if (data) {
+        cache->free_list = data->next;
+        cache->len--;
+        cache->hits++;
+        memset(data, 0, size);
+    }
+    else {
+        cache->misses++;
+        data = calloc(1, DATA_CACHE_BLOCK);
+        if (!data)
+            return NULL;
+    }
+    data->inline_strs = DATA_CACHE_ELEMENT;
+    return data;
+}
+
+/// Free an element, a cache block is kept if the thread uses a cache with room.
+static void data_element_put(data_t *data)
+{
+    data_cache_t *cache = data_cache;
+    if (!cache || !(data->inline_strs & DATA_CACHE_ELEMENT) || cache->len >= DATA_CACHE_MAX) {
+        free(data);
+        return;
+    }
+    data->next       = cache->free_list;
+    cache->free_list = data;
+    cache->len++;
+}
+
+/// Allocate a data element with its strings stored after it, one allocation for the element.
+static data_t *data_new(const char *key, const char *pretty_key, const char *format, const char *str)
+{
+    size_t key_len    = strlen(key) + 1;
+    size_t pretty_len = strlen(pretty_key) + 1;
+    size_t format_len = format ? strlen(format) + 1 : 0;
+    size_t str_len    = str ? strlen(str) + 1 : 0;
+
+    data_t *data = data_element_get(sizeof(*data) + key_len + pretty_len + format_len + str_len);
+    if (!data) {
+        WARN_CALLOC("vdata_make()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    char *p          = (char *)(data + 1);
+    data->key        = memcpy(p, key, key_len);
+    data->pretty_key = memcpy(p += key_len, pretty_key, pretty_len);
+    if (format)
+        data->format = memcpy(p += pretty_len, format, format_len);
+    if (str)
+        data->value.v_ptr = memcpy(p + (format ? format_len : pretty_len), str, str_len);
+    data->key_id      = data_key_id(key);
+    data->inline_strs |= DATA_INLINE_KEY | DATA_INLINE_PRETTY_KEY | (format ? DATA_INLINE_FORMAT : 0) | (str ? DATA_INLINE_VALUE : 0);
+    return data;
+}
+
 static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key, va_list ap)
 {
     data_type_t type;
     data_t *prev = first;
     while (prev && prev->next)
         prev = prev->next;
-    char *format = NULL;
+    char const *format = NULL;
     int skip = 0; // skip the data item if this is set
     type = va_arg(ap, data_type_t);
     do {
         data_t *current;
         data_value_t value = {0};
+        char const *str    = NULL; // string values are stored with the element
         // store explicit release function, CSA checker gets confused without this
         value_release_fn value_release = NULL; // appease CSA checker
 
@@ -181,14 +640,7 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
                 fprintf(stderr, "vdata_make() format type used twice\n");
                 goto alloc_error;
             }
-            format = va_arg(ap, char *);
-            if (format) {
-                format = strdup(format);
-                if (!format) {
-                    WARN_STRDUP("vdata_make()");
-                    goto alloc_error;
-                }
-            }
+            format = va_arg(ap, char const *);
             type = va_arg(ap, data_type_t);
             continue;
         case DATA_COUNT:
@@ -205,10 +657,7 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
             value.v_dbl = va_arg(ap, double);
             break;
         case DATA_STRING:
-            value_release = (value_release_fn)free; // appease CSA checker
-            value.v_ptr = strdup(va_arg(ap, char const *));
-            if (!value.v_ptr)
-                WARN_STRDUP("vdata_make()");
+            str = va_arg(ap, char const *);
             break;
         case DATA_ARRAY:
             value_release = (value_release_fn)data_array_free; // appease CSA checker
@@ -222,40 +671,27 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
         if (skip) {
             if (value_release) // could use dmt[type].value_release
                 value_release(value.v_ptr);
-            free(format);
             format = NULL;
             skip = 0;
         }
         else {
-            current = calloc(1, sizeof(*current));
+            current = data_new(key, pretty_key ? pretty_key : key, format, str);
             if (!current) {
-                WARN_CALLOC("vdata_make()");
                 if (value_release) // could use dmt[type].value_release
                     value_release(value.v_ptr);
                 goto alloc_error;
             }
-            current->type   = type;
-            current->format = format;
-            format          = NULL; // consumed
-            current->value  = value;
-            current->next   = NULL;
+            current->type = type;
+            format        = NULL; // consumed
+            if (!str)
+                current->value = value;
+            current->next = NULL;
 
             if (prev)
                 prev->next = current;
             prev = current;
             if (!first)
                 first = current;
-
-            current->key = strdup(key);
-            if (!current->key) {
-                WARN_STRDUP("vdata_make()");
-                goto alloc_error;
-            }
-            current->pretty_key = strdup(pretty_key ? pretty_key : key);
-            if (!current->pretty_key) {
-                WARN_STRDUP("vdata_make()");
-                goto alloc_error;
-            }
         }
 
         // next args
@@ -273,7 +709,6 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
     return first;
 
 alloc_error:
-    free(format); // if not consumed
     data_free(first);
     return NULL;
 }
@@ -364,47 +799,154 @@ R_API void data_array_free(data_array_t *array)
 
 R_API data_t *data_retain(data_t *data)
 {
-    if (data)
-        ++data->retain;
+    if (!data)
+        return NULL;
+    atomic_add(&data->retain, 1);
     return data;
 }
 
+/// Copy an array, the boxed data and arrays deeply, data_array() copies the strings.
+static data_array_t *array_copy(data_array_t const *array)
+{
+    data_array_t *copy = data_array(array->num_values, array->type, array->values);
+    if (!copy || (array->type != DATA_DATA && array->type != DATA_ARRAY))
+        return copy;
+    for (int i = 0; i < copy->num_values; ++i) {
+        void **elem = (void **)copy->values + i;
+        *elem = array->type == DATA_DATA ? (void *)data_copy(*elem) : (void *)array_copy(*elem);
+        if (!*elem) {
+            copy->num_values = i; // release only the copies
+            data_array_free(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+R_API data_t *data_copy(data_t const *data)
+{
+    data_t *first = NULL;
+    data_t **next = &first;
+    for (; data; data = data->next) {
+        data_t *copy = data_new(data->key, data->pretty_key, data->format, data->type == DATA_STRING ? data->value.v_ptr : NULL);
+        if (!copy)
+            goto alloc_error;
+        copy->key_id = data->key_id;
+        *next        = copy;
+        next         = &copy->next;
+        if (data->type == DATA_DATA && data->value.v_ptr) {
+            copy->value.v_ptr = data_copy(data->value.v_ptr);
+            if (!copy->value.v_ptr)
+                goto alloc_error;
+        }
+        else if (data->type == DATA_ARRAY) {
+            copy->value.v_ptr = array_copy(data->value.v_ptr);
+            if (!copy->value.v_ptr)
+                goto alloc_error; // the type is still DATA_DATA, a NULL value frees as is
+        }
+        else if (data->type != DATA_STRING) {
+            copy->value = data->value;
+        }
+        copy->type = data->type;
+    }
+    return first;
+
+alloc_error:
+    data_free(first);
+    return NULL;
+}
+
+/// Drops one retain count, returns 0 if the caller holds the last reference.
+static int data_release_retained(data_t *data)
+{
+    unsigned retain = atomic_get(&data->retain);
+    while (retain) {
+        if (atomic_cas(&data->retain, retain, retain - 1))
+            return 1;
+        retain = atomic_get(&data->retain);
+    }
+    return 0;
+}
+
 #if defined(__clang__)
     // ignore "call to function _free through pointer to incorrect function type"
     __attribute__((no_sanitize("undefined")))
 #endif
 R_API void data_free(data_t *data)
 {
-    if (data && data->retain) {
-        --data->retain;
+    if (data && data_release_retained(data))
         return;
-    }
     while (data) {
         data_t *prev_data = data;
-        if (dmt[data->type].value_release)
+        if (dmt[data->type].value_release && !(data->inline_strs & DATA_INLINE_VALUE))
             dmt[data->type].value_release(data->value.v_ptr);
-        free(data->format);
-        free(data->pretty_key);
-        free(data->key);
+        if (!(data->inline_strs & DATA_INLINE_FORMAT))
+            free(data->format);
+        if (!(data->inline_strs & DATA_INLINE_PRETTY_KEY))
+            free(data->pretty_key);
+        if (!(data->inline_strs & DATA_INLINE_KEY))
+            free(data->key);
         data = data->next;
-        free(prev_data);
+        data_element_put(prev_data);
     }
 }
 
+R_API void data_replace_key(data_t *data, char *key)
+{
+    if (!(data->inline_strs & DATA_INLINE_KEY))
+        free(data->key);
+    data->key    = key;
+    data->key_id = data_key_id(key);
+    data->inline_strs &= ~DATA_INLINE_KEY;
+}
+
+R_API void data_use_key(data_t *data, unsigned key_id)
+{
+    if (!(data->inline_strs & DATA_INLINE_KEY))
+        free(data->key);
+    data->key    = (char *)data_key_name(key_id);
+    data->key_id = key_id;
+    data->inline_strs |= DATA_INLINE_KEY;
+}
+
+R_API void data_replace_format(data_t *data, char *format)
+{
+    if (!(data->inline_strs & DATA_INLINE_FORMAT))
+        free(data->format);
+    data->format = format;
+    data->inline_strs &= ~DATA_INLINE_FORMAT;
+}
+
 #pragma GCC diagnostic pop
 
 /* data output */
 
 R_API void data_output_print(data_output_t *output, data_t *data)
+{
+    data_output_print_shared(output, data, NULL);
+}
+
+R_API void data_output_print_shared(data_output_t *output, data_t *data, data_render_t *render)
 {
     if (!output)
         return;
+    data_skip_t const *skip = data_projection_skip(output->projection, data);
+    if (skip) {
+        // the shared renderings have all fields, render the projection for this output
+        render = &output->projection->render;
+        data_render_start(render, data);
+        render->skip = skip;
+    }
+    output->render = render;
+    output->skip   = skip;
     if (output->output_print) {
         output->output_print(output, data);
     }
     else {
         output->print_data(output, data, NULL);
     }
+    output->render = NULL;
+    output->skip   = NULL;
 }
 
 R_API void data_output_start(struct data_output *output, char const *const *fields, int num_fields)
@@ -418,7 +960,9 @@ R_API void data_output_free(data_output_t *output)
 {
     if (!output)
         return;
+    data_projection_t *projection = output->projection;
     output->output_free(output);
+    data_projection_free(projection);
 }
 
 /* output helpers */
@@ -469,19 +1013,27 @@ R_API void print_array_value(data_output_t *output, data_array_t *array, char co
 typedef struct {
     struct data_output output;
     abuf_t msg;
+    int truncated; ///< something did not fit
 } data_print_jsons_t;
 
+static void jsons_cat(data_print_jsons_t *jsons, char const *str)
+{
+    if (jsons->msg.left < strlen(str) + 1)
+        jsons->truncated = 1;
+    abuf_cat(&jsons->msg, str);
+}
+
 static void R_API_CALLCONV format_jsons_array(data_output_t *output, data_array_t *array, char const *format)
 {
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
-    abuf_cat(&jsons->msg, "[");
+    jsons_cat(jsons, "[");
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            abuf_cat(&jsons->msg, ",");
+            jsons_cat(jsons, ",");
         print_array_value(output, array, format, c);
     }
-    abuf_cat(&jsons->msg, "]");
+    jsons_cat(jsons, "]");
 }
 
 static void R_API_CALLCONV format_jsons_object(data_output_t *output, data_t *data, char const *format)
@@ -489,20 +1041,32 @@ static void R_API_CALLCONV format_jsons_object(data_output_t *output, data_t *da
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
+    data_skip_t const *skip = output->skip;
+    output->skip            = NULL; // the nested objects print all fields
     bool separator = false;
-    abuf_cat(&jsons->msg, "{");
-    while (data) {
+    jsons_cat(jsons, "{");
+    for (; data; data = data->next) {
+        if (data_skip(skip, data))
+            continue;
         if (separator)
-            abuf_cat(&jsons->msg, ",");
+            jsons_cat(jsons, ",");
         output->print_string(output, data->key, NULL);
-        abuf_cat(&jsons->msg, ":");
+        jsons_cat(jsons, ":");
         print_value(output, data->type, data->value, data->format);
         separator = true;
-        data      = data->next;
     }
-    abuf_cat(&jsons->msg, "}");
+    jsons_cat(jsons, "}");
 }
 
+/// The char after the backslash of escaped chars in JSON strings, 0 for plain chars.
+static char const jsons_escapes[256] = {
+        ['\t'] = 't',
+        ['\n'] = 'n',
+        ['\r'] = 'r',
+        ['"']  = '"',
+        ['\\'] = '\\',
+};
+
 static void R_API_CALLCONV format_jsons_string(data_output_t *output, const char *str, char const *format)
 {
     UNUSED(format);
@@ -513,46 +1077,37 @@ static void R_API_CALLCONV format_jsons_string(data_output_t *output, const char
 
     size_t str_len = strlen(str);
     if (size < str_len + 3) {
+        jsons->truncated = 1;
         return;
     }
 
     if (str[0] == '{' && str[str_len - 1] == '}') {
         // Print embedded JSON object verbatim
-        abuf_cat(&jsons->msg, str);
+        jsons_cat(jsons, str);
         return;
     }
 
     *buf++ = '"';
     size--;
-    for (; *str && size >= 3; ++str) {
-        if (*str == '\r') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 'r';
-            size--;
-            continue;
-        }
-        if (*str == '\n') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 'n';
-            size--;
-            continue;
-        }
-        if (*str == '\t') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 't';
-            size--;
-            continue;
-        }
-        if (*str == '"' || *str == '\\') {
-            *buf++ = '\\';
-            size--;
-        }
-        *buf++ = *str;
-        size--;
+    while (*str && size >= 3) {
+        // copy runs of plain chars, keep room for the closing quote
+        size_t run = 0;
+        while (str[run] && !jsons_escapes[(unsigned char)str[run]])
+            run++;
+        if (run > size - 2)
+            run = size - 2;
+        memcpy(buf, str, run);
+        buf += run;
+        size -= run;
+        str += run;
+        if (!*str || size < 3)
+            break;
+        *buf++ = '\\';
+        *buf++ = jsons_escapes[(unsigned char)*str++];
+        size -= 2;
     }
+    if (*str || size < 2)
+        jsons->truncated = 1;
     if (size >= 2) {
         *buf++ = '"';
         size--;
@@ -563,16 +1118,64 @@ static void R_API_CALLCONV format_jsons_string(data_output_t *output, const char
     jsons->msg.left = size;
 }
 
+/// Format the digits of @p val before @p end, returns the start.
+static char *jsons_digits(char *end, uint64_t val)
+{
+    do {
+        *--end = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    return end;
+}
+
+/** Format a value from 1e-4 to 1e7 like "%.5f" with trailing zeros removed.
+
+    The value is rounded as scaled integer, returns 0 if that could round
+    differently than printf, i.e. if the value is too close to a rounding tie.
+*/
+static size_t jsons_fixed5(char *buf, double val)
+{
+    double scaled  = val * 100000.0;
+    uint64_t whole = (uint64_t)scaled;
+    double frac    = scaled - (double)whole;
+    if (frac > 0.499 && frac < 0.501)
+        return 0;
+    whole += frac > 0.5;
+
+    char tmp[32];
+    char *end = tmp + sizeof(tmp);
+    char *p   = jsons_digits(end, whole % 100000);
+    while (p > end - 5)
+        *--p = '0';
+    *--p = '.';
+    p = jsons_digits(p, whole / 100000);
+    // remove trailing zeros, always keep one digit after the decimal point
+    while (end[-1] == '0' && end[-2] != '.')
+        end--;
+    size_t len = end - p;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return len;
+}
+
 static void R_API_CALLCONV format_jsons_double(data_output_t *output, double data, char const *format)
 {
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
+    char buf[32];
+    size_t len;
+    size_t left = jsons->msg.left;
     // use scientific notation for very big/small values
     if (data > 1e7 || data < 1e-4) {
-        abuf_printf(&jsons->msg, "%g", data);
+        if (abuf_printf(&jsons->msg, "%g", data) >= (int)left)
+            jsons->truncated = 1;
+    }
+    else if (data >= 1e-4 && (len = jsons_fixed5(buf, data)) && len < jsons->msg.left) {
+        abuf_cat(&jsons->msg, buf);
     }
     else {
-        abuf_printf(&jsons->msg, "%.5f", data);
+        if (abuf_printf(&jsons->msg, "%.5f", data) >= (int)left)
+            jsons->truncated = 1;
         // remove trailing zeros, always keep one digit after the decimal point
         while (jsons->msg.left > 0 && *(jsons->msg.tail - 1) == '0' && *(jsons->msg.tail - 2) != '.') {
             jsons->msg.tail--;
@@ -586,24 +1189,431 @@ static void R_API_CALLCONV format_jsons_int(data_output_t *output, int data, cha
 {
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
-    abuf_printf(&jsons->msg, "%d", data);
+    char buf[16];
+    char *end = buf + sizeof(buf) - 1;
+    *end      = '\0';
+    char *p   = jsons_digits(end, data < 0 ? 0u - (unsigned)data : (unsigned)data);
+    if (data < 0)
+        *--p = '-';
+    if ((size_t)(end - p) < jsons->msg.left) {
+        abuf_cat(&jsons->msg, p);
+    }
+    else {
+        abuf_printf(&jsons->msg, "%d", data);
+        jsons->truncated = 1;
+    }
 }
 
-R_API size_t data_print_jsons(data_t *data, char *dst, size_t len)
+static void jsons_init(data_print_jsons_t *jsons, data_skip_t const *skip, void *dst, size_t len)
 {
-    data_print_jsons_t jsons = {
+    *jsons = (data_print_jsons_t){
             .output = {
                     .print_data   = format_jsons_object,
                     .print_array  = format_jsons_array,
                     .print_string = format_jsons_string,
                     .print_double = format_jsons_double,
                     .print_int    = format_jsons_int,
+                    .skip         = skip,
             },
     };
+    abuf_init(&jsons->msg, dst, len);
+}
 
-    abuf_init(&jsons.msg, dst, len);
+/// Format @p data without the fields of @p skip as compact JSON, sets @p truncated if the buffer is too short.
+static size_t print_jsons(data_t *data, data_skip_t const *skip, void *dst, size_t len, int *truncated)
+{
+    data_print_jsons_t jsons;
+    jsons_init(&jsons, skip, dst, len);
 
     format_jsons_object(&jsons.output, data, NULL);
 
+    if (truncated)
+        *truncated = jsons.truncated;
     return len - jsons.msg.left;
 }
+
+R_API size_t data_print_jsons(data_t *data, char *dst, size_t len)
+{
+    return print_jsons(data, NULL, dst, len, NULL);
+}
+
+/* CBOR printer */
+
+typedef struct {
+    struct data_output output;
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    int truncated; ///< something did not fit
+} data_print_cbor_t;
+
+static void cbor_put(data_print_cbor_t *cbor, void const *src, size_t len)
+{
+    if (cbor->len + len > cbor->size) {
+        cbor->truncated = 1;
+        return;
+    }
+    memcpy(&cbor->buf[cbor->len], src, len);
+    cbor->len += len;
+}
+
+/// Put the initial byte of a data item with major type @p major and argument @p val.
+static void cbor_head(data_print_cbor_t *cbor, unsigned major, uint64_t val)
+{
+    uint8_t head[9];
+    size_t len;
+    if (val < 24) {
+        head[0] = major << 5 | val;
+        len     = 1;
+    }
+    else if (val <= 0xff) {
+        head[0] = major << 5 | 24;
+        len     = 2;
+    }
+    else if (val <= 0xffff) {
+        head[0] = major << 5 | 25;
+        len     = 3;
+    }
+    else if (val <= 0xffffffff) {
+        head[0] = major << 5 | 26;
+        len     = 5;
+    }
+    else {
+        head[0] = major << 5 | 27;
+        len     = 9;
+    }
+    for (size_t i = len - 1; i > 0; --i) {
+        head[i] = val & 0xff;
+        val >>= 8;
+    }
+    cbor_put(cbor, head, len);
+}
+
+static void R_API_CALLCONV format_cbor_array(data_output_t *output, data_array_t *array, char const *format)
+{
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    cbor_head(cbor, 4, array->num_values);
+    for (int c = 0; c < array->num_values; ++c) {
+        print_array_value(output, array, format, c);
+    }
+}
+
+static void R_API_CALLCONV format_cbor_string(data_output_t *output, const char *str, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    size_t len = strlen(str);
+    cbor_head(cbor, 3, len);
+    cbor_put(cbor, str, len);
+}
+
+static void R_API_CALLCONV format_cbor_object(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    data_skip_t const *skip = output->skip;
+    output->skip            = NULL; // the nested maps encode all fields
+    unsigned count = 0;
+    for (data_t *d = data; d; d = d->next)
+        count += !data_skip(skip, d);
+    cbor_head(cbor, 5, count);
+    for (; data; data = data->next) {
+        if (data_skip(skip, data))
+            continue;
+        format_cbor_string(output, data->key, NULL);
+        print_value(output, data->type, data->value, data->format);
+    }
+}
+
+static void R_API_CALLCONV format_cbor_double(data_output_t *output, double data, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    uint64_t bits;
+    memcpy(&bits, &data, sizeof(bits));
+    uint8_t item[9] = {0xfb}; // major type 7, 64-bit float
+    for (int i = 8; i > 0; --i) {
+        item[i] = bits & 0xff;
+        bits >>= 8;
+    }
+    cbor_put(cbor, item, sizeof(item));
+}
+
+static void R_API_CALLCONV format_cbor_int(data_output_t *output, int data, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    if (data >= 0)
+        cbor_head(cbor, 0, (uint64_t)data);
+    else
+        cbor_head(cbor, 1, (uint64_t)(-1 - (int64_t)data));
+}
+
+static void cbor_init(data_print_cbor_t *cbor, data_skip_t const *skip, void *dst, size_t len)
+{
+    *cbor = (data_print_cbor_t){
+            .output = {
+                    .print_data   = format_cbor_object,
+                    .print_array  = format_cbor_array,
+                    .print_string = format_cbor_string,
+                    .print_double = format_cbor_double,
+                    .print_int    = format_cbor_int,
+                    .skip         = skip,
+            },
+            .buf  = dst,
+            .size = len,
+    };
+}
+
+/// Encode @p data without the fields of @p skip as CBOR, sets @p truncated if the buffer is too short.
+static size_t print_cbor(data_t *data, data_skip_t const *skip, void *dst, size_t len, int *truncated)
+{
+    data_print_cbor_t cbor;
+    cbor_init(&cbor, skip, dst, len);
+
+    format_cbor_object(&cbor.output, data, NULL);
+
+    *truncated = cbor.truncated;
+    return cbor.len;
+}
+
+R_API size_t data_print_cbor(data_t *data, uint8_t *dst, size_t len)
+{
+    int truncated;
+    size_t cbor_len = print_cbor(data, NULL, dst, len, &truncated);
+    return truncated ? 0 : cbor_len;
+}
+
+/* static schemas */
+
+struct data_schema {
+    unsigned len;
+    struct data_schema_key {
+        data_schema_field_t field; ///< the strings are the caller's
+        unsigned key_id;
+        char const *key;           ///< the interned key
+        char *jsons_key;           ///< the JSON key with its colon, e.g. "\"id\":"
+        uint8_t *cbor_key;         ///< the CBOR text string of the key
+        size_t cbor_len;
+    } keys[];
+};
+
+R_API data_schema_t *data_schema_create(data_schema_field_t const *fields)
+{
+    unsigned len = 0;
+    while (fields[len].key)
+        len++;
+    if (len > DATA_SCHEMA_FIELDS) {
+        fprintf(stderr, "data_schema_create() more than %d fields\n", DATA_SCHEMA_FIELDS);
+        return NULL;
+    }
+
+    data_schema_t *schema = calloc(1, sizeof(*schema) + len * sizeof(*schema->keys));
+    if (!schema) {
+        WARN_CALLOC("data_schema_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    schema->len = len;
+    for (unsigned i = 0; i < len; ++i) {
+        struct data_schema_key *k = &schema->keys[i];
+        k->field = fields[i];
+        if (k->field.type != DATA_INT && k->field.type != DATA_DOUBLE && k->field.type != DATA_STRING) {
+            fprintf(stderr, "data_schema_create() bad data type (%d) of \"%s\"\n", k->field.type, k->field.key);
+            data_schema_free(schema);
+            return NULL;
+        }
+        k->key_id = data_key_intern(k->field.key);
+        k->key    = data_key_name(k->key_id);
+        if (!k->key_id || !k->key) {
+            data_schema_free(schema);
+            return NULL;
+        }
+
+        // the keys are formatted as the printers do, escapes double the length at most
+        size_t key_len = strlen(k->key);
+        k->jsons_key = malloc(key_len * 2 + 4);
+        if (!k->jsons_key) {
+            WARN_MALLOC("data_schema_create()");
+            data_schema_free(schema);
+            return NULL;
+        }
+        data_print_jsons_t jsons;
+        jsons_init(&jsons, NULL, k->jsons_key, key_len * 2 + 4);
+        format_jsons_string(&jsons.output, k->key, NULL);
+        jsons_cat(&jsons, ":");
+
+        k->cbor_key = malloc(key_len + 9);
+        if (!k->cbor_key) {
+            WARN_MALLOC("data_schema_create()");
+            data_schema_free(schema);
+            return NULL;
+        }
+        data_print_cbor_t cbor;
+        cbor_init(&cbor, NULL, k->cbor_key, key_len + 9);
+        format_cbor_string(&cbor.output, k->key, NULL);
+        k->cbor_len = cbor.len;
+    }
+    return schema;
+}
+
+R_API void data_schema_free(data_schema_t *schema)
+{
+    if (!schema)
+        return;
+    for (unsigned i = 0; i < schema->len; ++i) {
+        free(schema->keys[i].jsons_key);
+        free(schema->keys[i].cbor_key);
+    }
+    free(schema);
+}
+
+R_API data_t *data_schema_make(data_schema_t const *schema, data_record_t const *record)
+{
+    data_t *first = NULL;
+    data_t **next = &first;
+    for (unsigned i = 0; i < schema->len; ++i) {
+        if (!(record->set >> i & 1))
+            continue;
+        struct data_schema_key const *k = &schema->keys[i];
+        char const *pretty_key = k->field.pretty_key ? k->field.pretty_key : k->key;
+        char const *format     = k->field.format;
+        char const *str        = k->field.type == DATA_STRING ? record->values[i].v_ptr : NULL;
+        size_t pretty_len      = strlen(pretty_key) + 1;
+        size_t format_len      = format ? strlen(format) + 1 : 0;
+        size_t str_len         = str ? strlen(str) + 1 : 0;
+
+        // like data_new() with the interned key
+        data_t *data = data_element_get(sizeof(*data) + pretty_len + format_len + str_len);
+        if (!data) {
+            WARN_CALLOC("data_schema_make()");
+            data_free(first);
+            return NULL; // NOTE: returns NULL on alloc failure.
+        }
+        char *p          = (char *)(data + 1);
+        data->key        = (char *)k->key;
+        data->pretty_key = memcpy(p, pretty_key, pretty_len);
+        if (format)
+            data->format = memcpy(p += pretty_len, format, format_len);
+        if (str)
+            data->value.v_ptr = memcpy(p + (format ? format_len : pretty_len), str, str_len);
+        else
+            data->value = record->values[i];
+        data->type        = k->field.type;
+        data->key_id      = k->key_id;
+        data->inline_strs |= DATA_INLINE_KEY | DATA_INLINE_PRETTY_KEY | (format ? DATA_INLINE_FORMAT : 0) | (str ? DATA_INLINE_VALUE : 0);
+        *next = data;
+        next  = &data->next;
+    }
+    return first;
+}
+
+R_API size_t data_schema_print_jsons(data_schema_t const *schema, data_record_t const *record, char *dst, size_t len)
+{
+    data_print_jsons_t jsons;
+    jsons_init(&jsons, NULL, dst, len);
+
+    bool separator = false;
+    jsons_cat(&jsons, "{");
+    for (unsigned i = 0; i < schema->len; ++i) {
+        if (!(record->set >> i & 1))
+            continue;
+        struct data_schema_key const *k = &schema->keys[i];
+        if (separator)
+            jsons_cat(&jsons, ",");
+        jsons_cat(&jsons, k->jsons_key);
+        print_value(&jsons.output, k->field.type, record->values[i], k->field.format);
+        separator = true;
+    }
+    jsons_cat(&jsons, "}");
+
+    return len - jsons.msg.left;
+}
+
+R_API size_t data_schema_print_cbor(data_schema_t const *schema, data_record_t const *record, uint8_t *dst, size_t len)
+{
+    data_print_cbor_t cbor;
+    cbor_init(&cbor, NULL, dst, len);
+
+    unsigned count = 0;
+    for (unsigned i = 0; i < schema->len; ++i)
+        count += record->set >> i & 1;
+    cbor_head(&cbor, 5, count);
+    for (unsigned i = 0; i < schema->len; ++i) {
+        if (!(record->set >> i & 1))
+            continue;
+        struct data_schema_key const *k = &schema->keys[i];
+        cbor_put(&cbor, k->cbor_key, k->cbor_len);
+        print_value(&cbor.output, k->field.type, record->values[i], k->field.format);
+    }
+
+    return cbor.truncated ? 0 : cbor.len;
+}
+
+/* shared renderings */
+
+#define RENDER_MIN 4096
+#define RENDER_MAX (1024 * 1024)
+
+typedef size_t (*render_fn)(data_t *data, data_skip_t const *skip, void *dst, size_t len, int *truncated);
+
+R_API void data_render_start(data_render_t *render, data_t *data)
+{
+    render->data = data;
+    render->skip = NULL;
+    for (int i = 0; i < DATA_RENDER_FORMATS; ++i)
+        render->formats[i].ready = 0;
+}
+
+R_API void data_render_free(data_render_t *render)
+{
+    for (int i = 0; i < DATA_RENDER_FORMATS; ++i)
+        free(render->formats[i].buf);
+    memset(render, 0, sizeof(*render));
+}
+
+/// Render the record once in a format, grow the buffer until the record fits.
+static void const *render_format(data_render_t *render, data_t *data, int format, render_fn fn, size_t *len)
+{
+    if (!render || render->data != data)
+        return NULL;
+
+    struct data_render_buf *f = &render->formats[format];
+    while (!f->ready && f->size <= RENDER_MAX) {
+        int truncated = 1;
+        if (f->size)
+            f->len = fn(data, render->skip, f->buf, f->size, &truncated);
+        if (!truncated) {
+            f->ready = 1;
+            break;
+        }
+        size_t size = f->size ? f->size * 2 : RENDER_MIN;
+        void *buf   = realloc(f->buf, size);
+        if (!buf) {
+            WARN_REALLOC("render_format()");
+            return NULL; // NOTE: returns NULL on alloc failure.
+        }
+        f->buf  = buf;
+        f->size = size;
+    }
+    if (!f->ready)
+        return NULL;
+
+    if (len)
+        *len = f->len;
+    return f->buf;
+}
+
+R_API char const *data_render_jsons(data_render_t *render, data_t *data, size_t *len)
+{
+    return render_format(render, data, DATA_RENDER_JSONS, print_jsons, len);
+}
+
+R_API uint8_t const *data_render_cbor(data_render_t *render, data_t *data, size_t *len)
+{
+    return render_format(render, data, DATA_RENDER_CBOR, print_cbor, len);
+}
@@ -12,6 +12,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
 
 #include "data_tag.h"
 #include "mongoose.h"
@@ -21,8 +23,15 @@
 #include "optparse.h"
 #include "c_util.h" // for MIN()
 #include "fileformat.h"
+#include "compat_pthread.h"
 #include "fatal.h"
 
+/*
+The reports arrive on the event loop while the tags are applied to the
+events on the DSP thread. Each report is parsed once on arrival into an
+immutable data_t that the events share by reference, the lock only
+guards swapping and retaining the current report.
+*/
 typedef struct gpsd_client {
     struct mg_connect_opts connect_opts;
     struct mg_connection *conn;
@@ -30,9 +39,29 @@ typedef struct gpsd_client {
     char address[253 + 6 + 1]; // dns max + port
     char const *init_str;
     char const *filter_str;
-    char msg[1024]; // GPSd TPV should about 600 bytes
+    char const **includes; ///< keys to filter from a JSON report, NULL to tag the report line
+    data_t *report;        ///< the last report, filtered or as string, shared with the events
+#ifdef THREADS
+    pthread_mutex_t lock;  ///< guards report
+#endif
 } gpsd_client_t;
 
+#ifdef THREADS
+#define GPSD_LOCK(c) pthread_mutex_lock(&(c)->lock)
+#define GPSD_UNLOCK(c) pthread_mutex_unlock(&(c)->lock)
+#else
+#define GPSD_LOCK(c)
+#define GPSD_UNLOCK(c)
+#endif
+
+#ifdef THREADS
+#define MAP_LOCK(m) pthread_mutex_lock(&(m)->lock)
+#define MAP_UNLOCK(m) pthread_mutex_unlock(&(m)->lock)
+#else
+#define MAP_LOCK(m)
+#define MAP_UNLOCK(m)
+#endif
+
 // GPSd JSON mode
 char const watch_json[] = "?WATCH={\"enable\":true,\"json\":true}\n";
 char const filter_json[] = "{\"class\":\"TPV\",";
@@ -40,11 +69,33 @@ char const filter_json[] = "{\"class\":\"TPV\",";
 char const watch_nmea[] = "?WATCH={\"enable\":true,\"nmea\":true}\n";
 char const filter_nmea[] = "$GPGGA,";
 
+static data_t *append_filtered_json(data_t *data, char const *json, char const **includes);
+
 static void gpsd_client_line(gpsd_client_t *ctx, char *line)
 {
-    if (!ctx->filter_str || strncmp(line, ctx->filter_str, strlen(ctx->filter_str)) == 0) {
-        snprintf(ctx->msg, sizeof(ctx->msg), "%s", line);
-    }
+    if (!ctx || (ctx->filter_str && strncmp(line, ctx->filter_str, strlen(ctx->filter_str)) != 0))
+        return;
+
+    data_t *report;
+    if (ctx->includes)
+        report = append_filtered_json(NULL, line, ctx->includes);
+    else
+        report = data_str(NULL, "report", "", NULL, line);
+
+    GPSD_LOCK(ctx);
+    data_t *prev = ctx->report;
+    ctx->report  = report;
+    GPSD_UNLOCK(ctx);
+    data_free(prev); // events still holding the previous report keep it
+}
+
+/// Get the last report, to data_free().
+static data_t *gpsd_client_report(gpsd_client_t *ctx)
+{
+    GPSD_LOCK(ctx);
+    data_t *report = data_retain(ctx->report);
+    GPSD_UNLOCK(ctx);
+    return report;
 }
 
 static struct mg_connection *gpsd_client_connect(gpsd_client_t *ctx, struct mg_mgr *mgr);
@@ -117,7 +168,7 @@ static struct mg_connection *gpsd_client_connect(gpsd_client_t *ctx, struct mg_m
     return ctx->conn;
 }
 
-static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char const *init_str, char const *filter_str, struct mg_mgr *mgr)
+static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char const *init_str, char const *filter_str, char const **includes, struct mg_mgr *mgr)
 {
     gpsd_client_t *ctx;
     ctx = calloc(1, sizeof(gpsd_client_t));
@@ -134,7 +185,11 @@ static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char
 
     ctx->init_str = init_str;
     ctx->filter_str = filter_str;
+    ctx->includes = includes;
     ctx->connect_opts.user_data = ctx;
+#ifdef THREADS
+    pthread_mutex_init(&ctx->lock, NULL);
+#endif
 
     if (!gpsd_client_connect(ctx, mgr)) {
         exit(1);
@@ -145,13 +200,459 @@ static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char
 
 static void gpsd_client_free(gpsd_client_t *ctx)
 {
-    if (ctx && ctx->conn) {
+    if (!ctx)
+        return;
+    if (ctx->conn) {
         ctx->conn->user_data = NULL;
         ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
     }
+    data_free(ctx->report);
+#ifdef THREADS
+    pthread_mutex_destroy(&ctx->lock);
+#endif
     free(ctx);
 }
 
+/*
+A map tag looks up the model, id and channel of each event in a table
+loaded from a CSV or JSON file. The values of each entry are parsed once
+into an immutable data_t that the events share by reference. The file is
+checked for changes on the event loop, a new table is loaded there and
+swapped under the lock, the lookup is a probe of an open addressing hash.
+*/
+#define TAG_MAP_CHECK_S 2.0   ///< interval to check the file for changes
+#define TAG_MAP_COLUMNS 32    ///< most CSV columns
+#define TAG_MAP_KEY_LEN 256   ///< longest "model\tid\tchannel" key
+
+typedef struct tag_map_entry {
+    uint32_t hash;
+    char *key;      ///< "model\tid\tchannel", NULL if unused
+    data_t *values; ///< the values to tag, shared with the events
+} tag_map_entry_t;
+
+typedef struct tag_map_table {
+    unsigned mask;  ///< slots - 1, at most half the slots are used
+    unsigned count;
+    tag_map_entry_t *slots;
+} tag_map_table_t;
+
+typedef struct tag_map {
+    char const *path;
+    time_t mtime;
+    off_t size;
+    struct mg_connection *timer;
+    list_t columns;         ///< value keys of the first load, owned
+    tag_map_table_t *table; ///< the current table
+#ifdef THREADS
+    pthread_mutex_t lock;   ///< guards table
+#endif
+} tag_map_t;
+
+/// FNV-1a hash of a key string.
+static uint32_t tag_map_hash(char const *key)
+{
+    uint32_t hash = 2166136261u;
+    for (; *key; ++key)
+        hash = (hash ^ (uint8_t)*key) * 16777619u;
+    return hash;
+}
+
+static void tag_map_table_free(tag_map_table_t *table)
+{
+    if (!table)
+        return;
+    for (unsigned i = 0; i <= table->mask; ++i) {
+        free(table->slots[i].key);
+        data_free(table->slots[i].values); // events still holding the values keep them
+    }
+    free(table->slots);
+    free(table);
+}
+
+/// Create a table with room for @p n entries.
+static tag_map_table_t *tag_map_table_create(unsigned n)
+{
+    tag_map_table_t *table = calloc(1, sizeof(*table));
+    if (!table) {
+        WARN_CALLOC("tag_map_table_create()");
+        return NULL;
+    }
+    unsigned slots = 16;
+    while (slots < 2 * n)
+        slots *= 2;
+    table->slots = calloc(slots, sizeof(*table->slots));
+    if (!table->slots) {
+        WARN_CALLOC("tag_map_table_create()");
+        free(table);
+        return NULL;
+    }
+    table->mask = slots - 1;
+    return table;
+}
+
+/// Add an entry, takes the @p values, a later entry of the same key replaces the earlier.
+static void tag_map_table_add(tag_map_table_t *table, char const *model, char const *id, char const *channel, data_t *values)
+{
+    char key[TAG_MAP_KEY_LEN];
+    snprintf(key, sizeof(key), "%s\t%s\t%s", model, id, channel);
+    uint32_t hash = tag_map_hash(key);
+    for (unsigned i = hash & table->mask;; i = (i + 1) & table->mask) {
+        tag_map_entry_t *entry = &table->slots[i];
+        if (entry->key && (entry->hash != hash || strcmp(entry->key, key)))
+            continue;
+        if (entry->key) {
+            data_free(entry->values);
+            entry->values = values;
+            return;
+        }
+        if (2 * (table->count + 1) > table->mask + 1) {
+            data_free(values); // more entries than counted
+            return;
+        }
+        entry->key = strdup(key);
+        if (!entry->key) {
+            WARN_STRDUP("tag_map_table_add()");
+            data_free(values);
+            return;
+        }
+        entry->hash   = hash;
+        entry->values = values;
+        table->count++;
+        return;
+    }
+}
+
+/// Add a value key to the columns if new.
+static void tag_map_add_column(list_t *columns, char const *key)
+{
+    if (!columns)
+        return;
+    for (size_t i = 0; i < columns->len; ++i) {
+        if (!strcmp(columns->elems[i], key))
+            return;
+    }
+    char *column = strdup(key);
+    if (!column) {
+        WARN_STRDUP("tag_map_add_column()");
+        return;
+    }
+    list_push(columns, column);
+}
+
+/// Split the next CSV field off @p line in place, removes the quotes, NULL at the end.
+static char *csv_field(char **line)
+{
+    char *p = *line;
+    if (!p)
+        return NULL;
+    while (*p == ' ' || *p == '\t')
+        ++p;
+    if (*p != '"') {
+        char *comma = strchr(p, ',');
+        if (comma)
+            *comma = '\0';
+        *line = comma ? comma + 1 : NULL;
+        return trim_ws(p);
+    }
+    char *field = ++p;
+    char *out   = field;
+    while (*p) {
+        if (*p == '"' && p[1] == '"') {
+            *out++ = '"';
+            p += 2;
+        }
+        else if (*p == '"') {
+            ++p;
+            break;
+        }
+        else {
+            *out++ = *p++;
+        }
+    }
+    char *comma = strchr(p, ',');
+    *out  = '\0';
+    *line = comma ? comma + 1 : NULL;
+    return field;
+}
+
+/// Load a CSV with a header line, the model, id and optional channel columns are matched, the others tagged.
+static tag_map_table_t *tag_map_load_csv(char *text, list_t *columns)
+{
+    unsigned lines = 1;
+    for (char *p = text; *p; ++p)
+        lines += *p == '\n';
+    tag_map_table_t *table = tag_map_table_create(lines);
+    if (!table)
+        return NULL;
+
+    char *names[TAG_MAP_COLUMNS] = {0};
+    unsigned n_names = 0;
+    int model_col = -1, id_col = -1, channel_col = -1;
+    char *next = text;
+    while (next) {
+        char *line = next;
+        next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        line = trim_ws(line);
+        if (!*line || *line == '#')
+            continue;
+
+        char *fields[TAG_MAP_COLUMNS] = {0};
+        unsigned n = 0;
+        for (char *f = csv_field(&line); f && n < TAG_MAP_COLUMNS; f = csv_field(&line))
+            fields[n++] = f;
+
+        if (!n_names) {
+            // the header
+            for (unsigned i = 0; i < n; ++i) {
+                if (!strcasecmp(fields[i], "model"))
+                    model_col = (int)i;
+                else if (!strcasecmp(fields[i], "id"))
+                    id_col = (int)i;
+                else if (!strcasecmp(fields[i], "channel"))
+                    channel_col = (int)i;
+                else
+                    tag_map_add_column(columns, fields[i]);
+                names[i] = fields[i];
+            }
+            n_names = n;
+            if (model_col < 0 || id_col < 0) {
+                fprintf(stderr, "Tag map needs a header line with \"model\" and \"id\" columns.\n");
+                tag_map_table_free(table);
+                return NULL;
+            }
+            continue;
+        }
+
+        data_t *values = NULL;
+        for (unsigned i = 0; i < n && i < n_names; ++i) {
+            if ((int)i != model_col && (int)i != id_col && (int)i != channel_col && *fields[i])
+                values = data_str(values, names[i], "", NULL, fields[i]);
+        }
+        char const *model   = (unsigned)model_col < n ? fields[model_col] : "";
+        char const *id      = (unsigned)id_col < n ? fields[id_col] : "";
+        char const *channel = channel_col >= 0 && (unsigned)channel_col < n ? fields[channel_col] : "";
+        if (values)
+            tag_map_table_add(table, model, id, channel, values);
+    }
+    return table;
+}
+
+/// Get the index after the token @p i and its children.
+static int json_skip(jsmntok_t const *tok, int i)
+{
+    for (int pending = 1; pending > 0; ++i)
+        pending += tok[i].size - 1;
+    return i;
+}
+
+/// Load a JSON array of flat objects, the model, id and optional channel keys are matched, the others tagged.
+static tag_map_table_t *tag_map_load_json(char *text, list_t *columns)
+{
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    int toks = jsmn_parse(&parser, text, strlen(text), NULL, 0);
+    if (toks < 1) {
+        fprintf(stderr, "Tag map has invalid JSON (%d).\n", toks);
+        return NULL;
+    }
+    jsmntok_t *tok = calloc((size_t)toks, sizeof(*tok));
+    if (!tok) {
+        WARN_CALLOC("tag_map_load_json()");
+        return NULL;
+    }
+    jsmn_init(&parser);
+    toks = jsmn_parse(&parser, text, strlen(text), tok, (unsigned)toks);
+    if (toks < 1 || tok[0].type != JSMN_ARRAY) {
+        fprintf(stderr, "Tag map needs a JSON array of objects.\n");
+        free(tok);
+        return NULL;
+    }
+    // terminate all strings and primitives in place
+    for (int i = 0; i < toks; ++i) {
+        if (tok[i].type == JSMN_STRING || tok[i].type == JSMN_PRIMITIVE)
+            text[tok[i].end] = '\0';
+    }
+
+    tag_map_table_t *table = tag_map_table_create((unsigned)tok[0].size);
+    for (int i = 1; table && i < toks; i = json_skip(tok, i)) {
+        if (tok[i].type != JSMN_OBJECT)
+            continue;
+        char const *model   = NULL;
+        char const *id      = NULL;
+        char const *channel = "";
+        data_t *values      = NULL;
+        int end = json_skip(tok, i);
+        for (int k = i + 1; k < end; k = json_skip(tok, k + 1)) {
+            jsmntok_t const *v = &tok[k + 1];
+            char const *key = text + tok[k].start;
+            char const *val = text + v->start;
+            if (v->type != JSMN_STRING && (v->type != JSMN_PRIMITIVE || *val == 'n'))
+                continue; // nested or null
+            if (!strcmp(key, "model"))
+                model = val;
+            else if (!strcmp(key, "id"))
+                id = val;
+            else if (!strcmp(key, "channel"))
+                channel = val;
+            else {
+                tag_map_add_column(columns, key);
+                values = data_str(values, key, "", NULL, val);
+            }
+        }
+        if (model && id && values)
+            tag_map_table_add(table, model, id, channel, values);
+        else
+            data_free(values);
+    }
+    free(tok);
+    return table;
+}
+
+/// Load the file, on success swap the table and set the columns if given.
+static int tag_map_load(tag_map_t *map, list_t *columns)
+{
+    FILE *fp = fopen(map->path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Tag map \"%s\" can't be opened.\n", map->path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    map->mtime = st.st_mtime;
+    map->size  = st.st_size;
+    char *text = malloc((size_t)st.st_size + 1);
+    if (!text) {
+        WARN_MALLOC("tag_map_load()");
+        fclose(fp);
+        return -1;
+    }
+    size_t len = fread(text, 1, (size_t)st.st_size, fp);
+    fclose(fp);
+    text[len] = '\0';
+
+    char const *p = text;
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        ++p;
+    tag_map_table_t *table = *p == '[' ? tag_map_load_json(text, columns) : tag_map_load_csv(text, columns);
+    free(text);
+    if (!table)
+        return -1;
+
+    MAP_LOCK(map);
+    tag_map_table_t *prev = map->table;
+    map->table = table;
+    MAP_UNLOCK(map);
+    tag_map_table_free(prev);
+    fprintf(stderr, "Tag map \"%s\" loaded %u entries.\n", map->path, table->count);
+    return 0;
+}
+
+/// Reload the file on changes, keeps the current table if the new one fails.
+static void tag_map_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    // note that while shutting down the map is NULL
+    tag_map_t *map = (tag_map_t *)nc->user_data;
+    (void)ev_data;
+    if (ev != MG_EV_TIMER || !map)
+        return;
+    mg_set_timer(nc, mg_time() + TAG_MAP_CHECK_S);
+    struct stat st;
+    if (stat(map->path, &st) != 0 || (st.st_mtime == map->mtime && st.st_size == map->size))
+        return;
+    tag_map_load(map, NULL);
+}
+
+static tag_map_t *tag_map_init(char const *path, struct mg_mgr *mgr)
+{
+    tag_map_t *map = calloc(1, sizeof(*map));
+    if (!map) {
+        WARN_CALLOC("tag_map_init()");
+        return NULL;
+    }
+    map->path = path;
+#ifdef THREADS
+    pthread_mutex_init(&map->lock, NULL);
+#endif
+    if (tag_map_load(map, &map->columns) < 0) {
+        exit(1);
+    }
+    if (mgr) {
+        struct mg_add_sock_opts opts = {.user_data = map};
+        map->timer = mg_add_sock_opt(mgr, INVALID_SOCKET, tag_map_event, opts);
+        if (map->timer)
+            mg_set_timer(map->timer, mg_time() + TAG_MAP_CHECK_S);
+    }
+    return map;
+}
+
+static void tag_map_free(tag_map_t *map)
+{
+    if (!map)
+        return;
+    if (map->timer) {
+        map->timer->user_data = NULL;
+        map->timer->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
+    tag_map_table_free(map->table);
+    list_free_elems(&map->columns, free);
+#ifdef THREADS
+    pthread_mutex_destroy(&map->lock);
+#endif
+    free(map);
+}
+
+/// Print a model, id or channel value of the event, empty if missing.
+static char const *tag_map_field(data_t const *data, unsigned key_id, char *buf, size_t size)
+{
+    for (; data; data = data->next) {
+        if (data->key_id != key_id)
+            continue;
+        if (data->type == DATA_STRING)
+            return data->value.v_ptr;
+        if (data->type == DATA_INT) {
+            snprintf(buf, size, "%d", data->value.v_int);
+            return buf;
+        }
+        break;
+    }
+    return "";
+}
+
+/// Get the values of the event, falls back to the entry without channel, to data_free().
+static data_t *tag_map_lookup(tag_map_t *map, data_t const *data)
+{
+    char id_buf[16];
+    char channel_buf[16];
+    char const *model   = tag_map_field(data, DATA_KEY_MODEL, NULL, 0);
+    char const *id      = tag_map_field(data, DATA_KEY_ID, id_buf, sizeof(id_buf));
+    char const *channel = tag_map_field(data, DATA_KEY_CHANNEL, channel_buf, sizeof(channel_buf));
+    if (!*model)
+        return NULL;
+
+    data_t *values = NULL;
+    MAP_LOCK(map);
+    tag_map_table_t const *table = map->table;
+    for (int pass = 0; table && !values && pass < (*channel ? 2 : 1); ++pass) {
+        char key[TAG_MAP_KEY_LEN];
+        snprintf(key, sizeof(key), "%s\t%s\t%s", model, id, pass ? "" : channel);
+        uint32_t hash = tag_map_hash(key);
+        for (unsigned i = hash & table->mask; table->slots[i].key; i = (i + 1) & table->mask) {
+            tag_map_entry_t const *entry = &table->slots[i];
+            if (entry->hash == hash && !strcmp(entry->key, key)) {
+                values = data_retain(entry->values);
+                break;
+            }
+        }
+    }
+    MAP_UNLOCK(map);
+    return values;
+}
+
 data_tag_t *data_tag_create(char *param, struct mg_mgr *mgr)
 {
     data_tag_t *tag;
@@ -220,7 +721,20 @@ data_tag_t *data_tag_create(char *param, struct mg_mgr *mgr)
 
         fprintf(stderr, "Getting %s data from %s port %s\n", mode, host, port);
 
-        tag->gpsd_client = gpsd_client_init(host, port, init_str, filter_str, mgr);
+        tag->gpsd_client = gpsd_client_init(host, port, init_str, filter_str, tag->includes, mgr);
+    }
+    else if (strncmp(tag->val, "map:", 4) == 0) {
+        tag->tag_map = tag_map_init(tag->val + 4, mgr);
+        if (!tag->tag_map) {
+            free(tag);
+            return NULL;
+        }
+        if (!tag->key) {
+            // the value keys of the first load are the output fields
+            list_t includes = {0};
+            list_push_all(&includes, tag->tag_map->columns.elems);
+            tag->includes = (char const **)includes.elems;
+        }
     }
     else {
         if (!tag->key)
@@ -234,6 +748,7 @@ void data_tag_free(data_tag_t *tag)
 {
     free((void *)tag->includes);
     gpsd_client_free(tag->gpsd_client);
+    tag_map_free(tag->tag_map);
 
     free(tag);
 }
@@ -291,23 +806,35 @@ data_t *data_tag_apply(data_tag_t *tag, data_t *data, char const *filename)
 {
     char const *val = tag->val;
     if (tag->gpsd_client) {
-        val = tag->gpsd_client->msg;
-        if (tag->includes) {
-            if (tag->key) {
-                // wrap tag includes
-                data_t *obj = append_filtered_json(NULL, val, tag->includes);
-                // append tag wrapper
-                data = data_dat(data, tag->key, "", NULL, obj);
-            }
-            else {
-                // append tag includes
-                data = append_filtered_json(data, val, tag->includes);
-            }
+        data_t *report = gpsd_client_report(tag->gpsd_client);
+        if (tag->includes && tag->key) {
+            // append tag wrapper, the event holds a reference to the report
+            return data_dat(data, tag->key, "", NULL, report);
+        }
+        else if (tag->includes) {
+            // append tag includes, copies of the filtered values
+            for (data_t *d = report; d; d = d->next)
+                data = data_str(data, d->key, "", NULL, d->value.v_ptr);
         }
         else {
             // append tag string
-            data = data_str(data, tag->key, "", NULL, val);
+            data = data_str(data, tag->key, "", NULL, report ? report->value.v_ptr : "");
+        }
+        data_free(report);
+        return data;
+    }
+    else if (tag->tag_map) {
+        data_t *values = tag_map_lookup(tag->tag_map, data);
+        if (!values)
+            return data;
+        if (tag->key) {
+            // append tag wrapper, the event holds a reference to the values
+            return data_dat(data, tag->key, "", NULL, values);
         }
+        // append the values, copies of the shared values
+        for (data_t *d = values; d; d = d->next)
+            data = data_str(data, d->key, "", NULL, d->value.v_ptr);
+        data_free(values);
         return data;
     }
     else if (filename && !strcmp("PATH", tag->val)) {
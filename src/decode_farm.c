@@ -0,0 +1,1140 @@
+/** @file
+    Decode farm, shard the pulse packages of remote receivers over decode workers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decode_farm.h"
+#include "list.h"
+#include "bit_util.h"
+#include "data.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+    #if !defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600)
+    #undef _WIN32_WINNT
+    #define _WIN32_WINNT 0x0600   /* Needed to pull in 'struct sockaddr_storage' */
+    #endif
+
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+
+    #define SOCKET          int
+    #define INVALID_SOCKET  (-1)
+    #define closesocket(x)  close(x)
+#endif
+
+#ifdef _WIN32
+    #define perror(str)           ws2_perror(str)
+
+    static void ws2_perror(const char *str)
+    {
+        if (str && *str)
+            fprintf(stderr, "%s: ", str);
+        fprintf(stderr, "Winsock error %d.\n", WSAGetLastError());
+    }
+#endif
+
+#define FARM_DATAGRAM_MAX 65507 ///< max UDP payload, the largest package takes about 48k
+#define FARM_MAGIC        "RTL433DF"
+#define FARM_HEADER_LEN   13    ///< magic, kind, and id
+#define FARM_SOURCE_MAX   255   ///< longer receiver names are cut
+#define FARM_DEPTH_MAX    8     ///< deepest nesting of the data in a result
+
+/// Kinds of the datagrams.
+enum farm_kind {
+    FARM_PACKAGE = 1, ///< coordinator to worker: time in us, source, and a package in the binary pulse format
+    FARM_PING    = 2, ///< coordinator to worker
+    FARM_RESULT  = 3, ///< worker to coordinator: the number of outputs, each a level and the data
+    FARM_PONG    = 4, ///< worker to coordinator
+};
+
+/* Encoding of the results */
+
+typedef struct farm_writer {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    int overflow;
+} farm_writer_t;
+
+static void put_bytes(farm_writer_t *w, void const *src, size_t len)
+{
+    if (w->overflow || w->len + len > w->size) {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, src, len);
+    w->len += len;
+}
+
+static void put_uint(farm_writer_t *w, uint64_t val, unsigned bytes)
+{
+    uint8_t le[8];
+    for (unsigned i = 0; i < bytes; ++i)
+        le[i] = (uint8_t)(val >> (8 * i));
+    put_bytes(w, le, bytes);
+}
+
+/// A string is its length with the NUL, 0 for NULL, and the bytes with the NUL.
+static void put_str(farm_writer_t *w, char const *str)
+{
+    size_t len = str ? strlen(str) + 1 : 0;
+    if (len > 0xffff) {
+        w->overflow = 1;
+        return;
+    }
+    put_uint(w, len, 2);
+    put_bytes(w, str, len);
+}
+
+static void put_data(farm_writer_t *w, data_t const *data);
+
+static void put_value(farm_writer_t *w, data_type_t type, void const *value)
+{
+    if (type == DATA_INT) {
+        put_uint(w, (uint32_t)(*(int const *)value), 4);
+    }
+    else if (type == DATA_DOUBLE) {
+        uint64_t bits;
+        memcpy(&bits, value, sizeof(bits));
+        put_uint(w, bits, 8);
+    }
+    else if (type == DATA_STRING) {
+        put_str(w, *(char *const *)value);
+    }
+    else if (type == DATA_DATA) {
+        put_data(w, *(data_t *const *)value);
+    }
+    else if (type == DATA_ARRAY) {
+        data_array_t const *array = *(data_array_t *const *)value;
+        put_uint(w, array->type, 1);
+        put_uint(w, (uint32_t)array->num_values, 4);
+        size_t size = array->type == DATA_INT ? sizeof(int) : array->type == DATA_DOUBLE ? sizeof(double) : sizeof(void *);
+        for (int i = 0; i < array->num_values; ++i)
+            put_value(w, array->type, (char const *)array->values + size * i);
+    }
+    else {
+        w->overflow = 1;
+    }
+}
+
+/// Each element is the type, key, pretty key, format, and value, the list ends with 0xff.
+static void put_data(farm_writer_t *w, data_t const *data)
+{
+    for (; data; data = data->next) {
+        put_uint(w, data->type, 1);
+        put_str(w, data->key);
+        put_str(w, data->pretty_key);
+        put_str(w, data->format);
+        put_value(w, data->type, data->type == DATA_STRING ? (void const *)&data->value.v_ptr : (void const *)&data->value);
+    }
+    put_uint(w, 0xff, 1);
+}
+
+typedef struct farm_reader {
+    uint8_t const *buf;
+    size_t len;
+    size_t pos;
+    int error;
+} farm_reader_t;
+
+static uint64_t get_uint(farm_reader_t *r, unsigned bytes)
+{
+    if (r->error || r->pos + bytes > r->len) {
+        r->error = 1;
+        return 0;
+    }
+    uint64_t val = 0;
+    for (unsigned i = 0; i < bytes; ++i)
+        val |= (uint64_t)r->buf[r->pos + i] << (8 * i);
+    r->pos += bytes;
+    return val;
+}
+
+/// The string points into the buffer.
+static char const *get_str(farm_reader_t *r)
+{
+    size_t len = (size_t)get_uint(r, 2);
+    if (r->error || !len)
+        return NULL;
+    if (r->pos + len > r->len || r->buf[r->pos + len - 1] != '\0') {
+        r->error = 1;
+        return NULL;
+    }
+    char const *str = (char const *)r->buf + r->pos;
+    r->pos += len;
+    return str;
+}
+
+static data_t *get_data(farm_reader_t *r, unsigned depth);
+
+static data_array_t *get_array(farm_reader_t *r, unsigned depth)
+{
+    data_type_t type = (data_type_t)get_uint(r, 1);
+    uint32_t num_values = (uint32_t)get_uint(r, 4);
+    // each value takes at least a byte
+    if (r->error || type >= DATA_COUNT || num_values > r->len - r->pos || depth >= FARM_DEPTH_MAX) {
+        r->error = 1;
+        return NULL;
+    }
+    size_t size = type == DATA_INT ? sizeof(int) : type == DATA_DOUBLE ? sizeof(double) : sizeof(void *);
+    void *values = NULL;
+    if (num_values) {
+        values = calloc(num_values, size);
+        if (!values) {
+            WARN_CALLOC("get_array()");
+            r->error = 1;
+            return NULL;
+        }
+    }
+    uint32_t n = 0;
+    for (; n < num_values && !r->error; ++n) {
+        if (type == DATA_INT) {
+            ((int *)values)[n] = (int)(uint32_t)get_uint(r, 4);
+        }
+        else if (type == DATA_DOUBLE) {
+            uint64_t bits = get_uint(r, 8);
+            memcpy((double *)values + n, &bits, sizeof(bits));
+        }
+        else if (type == DATA_STRING) {
+            ((char const **)values)[n] = get_str(r);
+            r->error |= !((char const **)values)[n];
+        }
+        else if (type == DATA_DATA) {
+            ((data_t **)values)[n] = get_data(r, depth + 1);
+        }
+        else {
+            ((data_array_t **)values)[n] = get_array(r, depth + 1);
+        }
+    }
+    // the strings are copied, the data and arrays are taken
+    data_array_t *array = r->error ? NULL : data_array((int)num_values, type, values);
+    if (!array) {
+        r->error = 1;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (type == DATA_DATA)
+                data_free(((data_t **)values)[i]);
+            else if (type == DATA_ARRAY)
+                data_array_free(((data_array_t **)values)[i]);
+        }
+    }
+    free(values);
+    return array;
+}
+
+static data_t *get_data(farm_reader_t *r, unsigned depth)
+{
+    data_t *data = NULL;
+    if (depth >= FARM_DEPTH_MAX) {
+        r->error = 1;
+        return NULL;
+    }
+    for (;;) {
+        unsigned type = (unsigned)get_uint(r, 1);
+        if (r->error || type == 0xff)
+            break;
+        char const *key        = get_str(r);
+        char const *pretty_key = get_str(r);
+        char const *format     = get_str(r);
+        if (!key || type >= DATA_COUNT) {
+            r->error = 1;
+            break;
+        }
+        if (type == DATA_INT) {
+            int val = (int)(uint32_t)get_uint(r, 4);
+            data    = r->error ? data : data_int(data, key, pretty_key, format, val);
+        }
+        else if (type == DATA_DOUBLE) {
+            uint64_t bits = get_uint(r, 8);
+            double val;
+            memcpy(&val, &bits, sizeof(val));
+            data = r->error ? data : data_dbl(data, key, pretty_key, format, val);
+        }
+        else if (type == DATA_STRING) {
+            char const *val = get_str(r);
+            data = r->error || !val ? data : data_str(data, key, pretty_key, format, val);
+            r->error |= !val;
+        }
+        else if (type == DATA_DATA) {
+            data_t *val = get_data(r, depth + 1);
+            data = r->error ? data : data_dat(data, key, pretty_key, format, val);
+        }
+        else {
+            data_array_t *val = get_array(r, depth + 1);
+            data = r->error ? data : data_ary(data, key, pretty_key, format, val);
+        }
+        if (!data) {
+            r->error = 1; // the data was freed on the alloc failure
+            return NULL;
+        }
+    }
+    if (r->error) {
+        data_free(data);
+        return NULL;
+    }
+    return data;
+}
+
+static size_t put_header(uint8_t *buf, unsigned kind, uint32_t id)
+{
+    farm_writer_t w = {.buf = buf, .size = FARM_HEADER_LEN};
+    put_bytes(&w, FARM_MAGIC, 8);
+    put_uint(&w, kind, 1);
+    put_uint(&w, id, 4);
+    return w.len;
+}
+
+/// Check the header, returns the kind or 0 if there is none.
+static unsigned get_header(farm_reader_t *r, uint32_t *id)
+{
+    if (r->len < FARM_HEADER_LEN || memcmp(r->buf, FARM_MAGIC, 8)) {
+        r->error = 1;
+        return 0;
+    }
+    r->pos   = 8;
+    unsigned kind = (unsigned)get_uint(r, 1);
+    *id = (uint32_t)get_uint(r, 4);
+    return kind;
+}
+
+/* Sockets */
+
+/// Open a datagram socket for @p host and @p port, bound to it for a worker.
+static SOCKET farm_open(char const *host, char const *port, int passive, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    struct addrinfo hints, *res, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = passive ? AI_PASSIVE : AI_ADDRCONFIG;
+    int error = getaddrinfo(host, port, &hints, &res0);
+    if (error) {
+        print_log(LOG_ERROR, __func__, gai_strerror(error));
+        return INVALID_SOCKET;
+    }
+    SOCKET sock = INVALID_SOCKET;
+    for (res = res0; res; res = res->ai_next) {
+        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        if (passive && bind(sock, res->ai_addr, res->ai_addrlen) < 0) {
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+            continue;
+        }
+        memset(addr, 0, sizeof(*addr));
+        memcpy(addr, res->ai_addr, res->ai_addrlen);
+        *addr_len = res->ai_addrlen;
+        break; // success
+    }
+    freeaddrinfo(res0);
+    if (sock == INVALID_SOCKET)
+        perror(passive ? "error on binding" : "socket");
+    return sock;
+}
+
+/* Coordinator */
+
+typedef struct farm_worker {
+    char *spec;
+    SOCKET sock;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    double last_reply; ///< time of the last result or pong
+    double last_ping;
+    int healthy;       ///< the health last logged
+    unsigned in_flight;
+    unsigned sent;
+    unsigned spilled;
+    unsigned results;
+    unsigned events;
+} farm_worker_t;
+
+/// A point on the hash ring.
+typedef struct farm_point {
+    uint32_t hash;
+    unsigned worker;
+} farm_point_t;
+
+/// An output of a worker.
+typedef struct farm_record {
+    data_t *data;
+    int level;
+} farm_record_t;
+
+/// A package awaiting its result.
+typedef struct farm_pending {
+    uint32_t id;     ///< 0 if the slot is free
+    unsigned worker;
+    int next;        ///< the slot of the next package of the source, -1 if none
+    int done;        ///< the result arrived
+    double time;     ///< the time sent
+    list_t records;  ///< the outputs of the result
+} farm_pending_t;
+
+/// A receiver and its packages awaiting their result, in order.
+typedef struct farm_source {
+    char *name;
+    int head; ///< the slot of the oldest package, -1 if none
+    int tail; ///< the slot of the newest package
+} farm_source_t;
+
+struct decode_farm {
+    unsigned num_workers;
+    farm_worker_t workers[DECODE_FARM_WORKERS];
+    unsigned num_points;
+    farm_point_t points[DECODE_FARM_WORKERS * DECODE_FARM_VNODES];
+    uint32_t next_id;
+    unsigned pending;
+    farm_pending_t slots[DECODE_FARM_PENDING];
+    list_t sources; ///< farm_source_t
+    unsigned sent;
+    unsigned dropped;
+    unsigned lost;
+    unsigned late;
+    uint8_t buf[FARM_DATAGRAM_MAX];
+};
+
+/// Spread the bits of a hash, FNV-1a alone clusters short similar inputs.
+static uint32_t mix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/// The fingerprint bucket of a package, the width bins without the trailing gap which varies with the end of package detection.
+static uint32_t package_key(pulse_data_t const *pulses)
+{
+    uint64_t bins[3] = {0, 0, pulses->fsk_f2_est ? 1 : 0};
+    for (unsigned n = 0; n < pulses->num_pulses; ++n) {
+        bins[0] |= (uint64_t)1 << pulse_data_width_bin(pulses->pulse[n]);
+        if (n + 1 < pulses->num_pulses)
+            bins[1] |= (uint64_t)1 << pulse_data_width_bin(pulses->gap[n]);
+    }
+    return mix32(fnv1a(FNV1A_INIT, bins, sizeof(bins)));
+}
+
+static int point_cmp(void const *a, void const *b)
+{
+    farm_point_t const *pa = a;
+    farm_point_t const *pb = b;
+    if (pa->hash != pb->hash)
+        return pa->hash < pb->hash ? -1 : 1;
+    return pa->worker < pb->worker ? -1 : pa->worker > pb->worker ? 1 : 0;
+}
+
+/// Place the points of each worker by the hash of its spec, a worker keeps its points when others are added.
+static void ring_build(farm_point_t *points, unsigned *num_points, char *const *specs, unsigned num_workers)
+{
+    unsigned n = 0;
+    for (unsigned i = 0; i < num_workers; ++i) {
+        for (unsigned v = 0; v < DECODE_FARM_VNODES; ++v) {
+            uint32_t hash = fnv1a(FNV1A_INIT, specs[i], strlen(specs[i]));
+            hash = fnv1a(hash, &v, sizeof(v));
+            points[n++] = (farm_point_t){.hash = mix32(hash), .worker = i};
+        }
+    }
+    qsort(points, n, sizeof(*points), point_cmp);
+    *num_points = n;
+}
+
+/// The first point at or after @p key, wrapping around.
+static unsigned ring_find(farm_point_t const *points, unsigned num_points, uint32_t key)
+{
+    unsigned lo = 0;
+    unsigned hi = num_points;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (points[mid].hash < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < num_points ? lo : 0;
+}
+
+static int worker_healthy(farm_worker_t const *worker, double now)
+{
+    return now - worker->last_reply < DECODE_FARM_HEALTH_S;
+}
+
+/// The first usable worker clockwise from @p key, -1 if none, @p spilled is set if it's not the owner of the key.
+static int ring_pick(decode_farm_t const *farm, uint32_t key, double now, int *spilled)
+{
+    uint64_t tried = 0;
+    unsigned first = ring_find(farm->points, farm->num_points, key);
+    *spilled = 0;
+    for (unsigned i = 0; i < farm->num_points; ++i) {
+        unsigned w = farm->points[(first + i) % farm->num_points].worker;
+        if (tried & ((uint64_t)1 << w))
+            continue;
+        farm_worker_t const *worker = &farm->workers[w];
+        if (worker_healthy(worker, now) && worker->in_flight < DECODE_FARM_WINDOW)
+            return (int)w;
+        tried |= (uint64_t)1 << w;
+        *spilled = 1;
+    }
+    return -1;
+}
+
+decode_farm_t *decode_farm_create(void)
+{
+    decode_farm_t *farm = calloc(1, sizeof(*farm));
+    if (!farm) {
+        WARN_CALLOC("decode_farm_create()");
+        return NULL;
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        free(farm);
+        return NULL;
+    }
+#endif
+    farm->next_id = 1;
+    return farm;
+}
+
+int decode_farm_add_worker(decode_farm_t *farm, char const *host, char const *port, double now)
+{
+    if (farm->num_workers >= DECODE_FARM_WORKERS) {
+        print_logf(LOG_ERROR, "Farm", "At most %d decode workers are supported", DECODE_FARM_WORKERS);
+        return -1;
+    }
+    farm_worker_t *worker = &farm->workers[farm->num_workers];
+    char spec[300];
+    snprintf(spec, sizeof(spec), strchr(host, ':') ? "[%s]:%s" : "%s:%s", host, port);
+    worker->spec = strdup(spec);
+    if (!worker->spec) {
+        WARN_STRDUP("decode_farm_add_worker()");
+        return -1;
+    }
+    worker->sock = farm_open(host, port, 0, &worker->addr, &worker->addr_len);
+    if (worker->sock == INVALID_SOCKET) {
+        print_logf(LOG_ERROR, "Farm", "Failed to open decode worker %s", spec);
+        free(worker->spec);
+        worker->spec = NULL;
+        return -1;
+    }
+    // a grace period to answer the first ping
+    worker->last_reply = now;
+    worker->last_ping  = now - DECODE_FARM_PING_S;
+    worker->healthy    = 1;
+    farm->num_workers++;
+
+    char *specs[DECODE_FARM_WORKERS];
+    for (unsigned i = 0; i < farm->num_workers; ++i)
+        specs[i] = farm->workers[i].spec;
+    ring_build(farm->points, &farm->num_points, specs, farm->num_workers);
+    return 0;
+}
+
+static void free_records(list_t *records)
+{
+    for (void **iter = records->elems; iter && *iter; ++iter) {
+        farm_record_t *record = *iter;
+        data_free(record->data);
+    }
+    list_free_elems(records, free);
+}
+
+static void free_source(void *ptr)
+{
+    farm_source_t *source = ptr;
+    free(source->name);
+    free(source);
+}
+
+void decode_farm_free(decode_farm_t *farm)
+{
+    if (!farm)
+        return;
+    for (unsigned i = 0; i < farm->num_workers; ++i) {
+        closesocket(farm->workers[i].sock);
+        free(farm->workers[i].spec);
+    }
+    for (unsigned i = 0; i < DECODE_FARM_PENDING; ++i)
+        free_records(&farm->slots[i].records);
+    list_free_elems(&farm->sources, free_source);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    free(farm);
+}
+
+static farm_source_t *find_source(decode_farm_t *farm, char const *name)
+{
+    for (void **iter = farm->sources.elems; iter && *iter; ++iter) {
+        farm_source_t *source = *iter;
+        if (!strcmp(source->name, name))
+            return source;
+    }
+    farm_source_t *source = calloc(1, sizeof(*source));
+    if (!source) {
+        WARN_CALLOC("decode_farm_submit()");
+        return NULL;
+    }
+    source->name = strdup(name);
+    if (!source->name) {
+        WARN_STRDUP("decode_farm_submit()");
+        free(source);
+        return NULL;
+    }
+    source->head = -1;
+    source->tail = -1;
+    list_push(&farm->sources, source);
+    return source;
+}
+
+/// Take a slot and queue it on the source, returns the slot or -1 if the slot of the next id is still taken.
+static int pending_add(decode_farm_t *farm, farm_source_t *source, unsigned worker, double now)
+{
+    uint32_t id = farm->next_id;
+    int slot    = (int)(id % DECODE_FARM_PENDING);
+    farm_pending_t *p = &farm->slots[slot];
+    if (p->id)
+        return -1;
+    farm->next_id = id + 1 ? id + 1 : 1; // 0 marks the late events
+    p->id     = id;
+    p->worker = worker;
+    p->next   = -1;
+    p->done   = 0;
+    p->time   = now;
+    if (source->head < 0)
+        source->head = slot;
+    else
+        farm->slots[source->tail].next = slot;
+    source->tail = slot;
+    farm->pending++;
+    farm->workers[worker].in_flight++;
+    return slot;
+}
+
+int decode_farm_submit(decode_farm_t *farm, pulse_data_t const *pulses, char const *source_name, double now)
+{
+    int spilled;
+    int w = ring_pick(farm, package_key(pulses), now, &spilled);
+    farm_source_t *source = w < 0 ? NULL : find_source(farm, source_name ? source_name : "");
+    int slot = source ? pending_add(farm, source, (unsigned)w, now) : -1;
+    if (slot < 0) {
+        farm->dropped++;
+        return -1;
+    }
+    farm_worker_t *worker = &farm->workers[w];
+
+    size_t source_len = strlen(source->name);
+    if (source_len > FARM_SOURCE_MAX)
+        source_len = FARM_SOURCE_MAX;
+    farm_writer_t out = {.buf = farm->buf, .size = sizeof(farm->buf)};
+    out.len = put_header(farm->buf, FARM_PACKAGE, farm->slots[slot].id);
+    put_uint(&out, (uint64_t)(now * 1e6), 8);
+    put_uint(&out, source_len, 1);
+    put_bytes(&out, source->name, source_len);
+    size_t len = out.overflow ? 0 : pulse_data_encode_bin(out.buf + out.len, out.size - out.len, pulses);
+    if (len && sendto(worker->sock, (char const *)farm->buf, out.len + len, 0, (struct sockaddr *)&worker->addr, worker->addr_len) < 0)
+        perror("sendto");
+
+    farm->sent++;
+    worker->sent++;
+    worker->spilled += spilled;
+    return 0;
+}
+
+/// Decode the outputs of a result, to the pending package or to @p output_fn as late events.
+static void receive_result(decode_farm_t *farm, unsigned w, uint32_t id, farm_reader_t *r,
+        void (*output_fn)(void *ctx, data_t *data, int level), void *ctx)
+{
+    farm_worker_t *worker = &farm->workers[w];
+    farm_pending_t *p = &farm->slots[id % DECODE_FARM_PENDING];
+    int on_time = id && p->id == id && p->worker == w && !p->done;
+    if (on_time) {
+        p->done = 1;
+        worker->in_flight--;
+        worker->results++;
+    }
+
+    unsigned count = (unsigned)get_uint(r, 2);
+    for (unsigned i = 0; i < count && !r->error; ++i) {
+        int level    = (int)get_uint(r, 1);
+        data_t *data = get_data(r, 0);
+        if (!data)
+            break;
+        worker->events++;
+        if (on_time) {
+            farm_record_t *record = malloc(sizeof(*record));
+            if (!record) {
+                WARN_MALLOC("decode_farm_poll()");
+                data_free(data);
+                continue; // NOTE: drops the data on alloc failure.
+            }
+            record->data  = data;
+            record->level = level;
+            list_push(&p->records, record);
+        }
+        else {
+            farm->late++;
+            output_fn(ctx, data, level);
+        }
+    }
+    if (r->error)
+        print_logf(LOG_WARNING, "Farm", "Invalid result from decode worker %s", worker->spec);
+}
+
+/// Receive the datagrams of the workers, waits up to @p timeout_ms for the first.
+static void receive_datagrams(decode_farm_t *farm, int timeout_ms, double now,
+        void (*output_fn)(void *ctx, data_t *data, int level), void *ctx)
+{
+    for (;;) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        SOCKET max_sock = 0;
+        for (unsigned i = 0; i < farm->num_workers; ++i) {
+            FD_SET(farm->workers[i].sock, &fds);
+            if (farm->workers[i].sock > max_sock)
+                max_sock = farm->workers[i].sock;
+        }
+        struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        int ready = select((int)max_sock + 1, &fds, NULL, NULL, &tv);
+        if (ready <= 0)
+            return; // a timeout, a signal, or an error
+        timeout_ms = 0; // take what arrived meanwhile
+
+        for (unsigned i = 0; i < farm->num_workers; ++i) {
+            farm_worker_t *worker = &farm->workers[i];
+            if (!FD_ISSET(worker->sock, &fds))
+                continue;
+            int len = recv(worker->sock, (char *)farm->buf, sizeof(farm->buf), 0);
+            if (len < 0)
+                continue; // e.g. the port of the worker is closed
+            farm_reader_t r = {.buf = farm->buf, .len = (size_t)len};
+            uint32_t id;
+            unsigned kind = get_header(&r, &id);
+            if (kind == FARM_PONG || kind == FARM_RESULT)
+                worker->last_reply = now;
+            if (kind == FARM_RESULT)
+                receive_result(farm, i, id, &r, output_fn, ctx);
+        }
+    }
+}
+
+/// Output the results of each source in order, up to the first package still awaited.
+static void release_results(decode_farm_t *farm, double now,
+        void (*output_fn)(void *ctx, data_t *data, int level), void *ctx)
+{
+    for (void **iter = farm->sources.elems; iter && *iter; ++iter) {
+        farm_source_t *source = *iter;
+        while (source->head >= 0) {
+            farm_pending_t *p = &farm->slots[source->head];
+            if (!p->done && now - p->time < DECODE_FARM_RESULT_S)
+                break;
+            if (!p->done) {
+                farm->lost++;
+                farm->workers[p->worker].in_flight--;
+            }
+            for (void **rec = p->records.elems; rec && *rec; ++rec) {
+                farm_record_t *record = *rec;
+                output_fn(ctx, record->data, record->level);
+            }
+            list_free_elems(&p->records, free);
+            source->head = p->next;
+            p->id        = 0;
+            farm->pending--;
+        }
+    }
+}
+
+void decode_farm_poll(decode_farm_t *farm, int timeout_ms, double now,
+        void (*output_fn)(void *ctx, data_t *data, int level), void *ctx)
+{
+    for (unsigned i = 0; i < farm->num_workers; ++i) {
+        farm_worker_t *worker = &farm->workers[i];
+        if (now - worker->last_ping >= DECODE_FARM_PING_S) {
+            worker->last_ping = now;
+            size_t len = put_header(farm->buf, FARM_PING, 0);
+            sendto(worker->sock, (char const *)farm->buf, len, 0, (struct sockaddr *)&worker->addr, worker->addr_len);
+        }
+    }
+
+    receive_datagrams(farm, timeout_ms, now, output_fn, ctx);
+    release_results(farm, now, output_fn, ctx);
+
+    for (unsigned i = 0; i < farm->num_workers; ++i) {
+        farm_worker_t *worker = &farm->workers[i];
+        int healthy = worker_healthy(worker, now);
+        if (healthy == worker->healthy)
+            continue;
+        worker->healthy = healthy;
+        if (healthy)
+            print_logf(LOG_NOTICE, "Farm", "Decode worker %s is back", worker->spec);
+        else
+            print_logf(LOG_WARNING, "Farm", "Decode worker %s is not responding, its packages go to the next workers", worker->spec);
+    }
+}
+
+unsigned decode_farm_pending(decode_farm_t const *farm)
+{
+    return farm->pending;
+}
+
+void decode_farm_get_stats(decode_farm_t const *farm, double now, decode_farm_stats_t *stats)
+{
+    unsigned healthy = 0;
+    for (unsigned i = 0; i < farm->num_workers; ++i)
+        healthy += worker_healthy(&farm->workers[i], now);
+    *stats = (decode_farm_stats_t){
+            .workers = farm->num_workers,
+            .healthy = healthy,
+            .pending = farm->pending,
+            .sent    = farm->sent,
+            .dropped = farm->dropped,
+            .lost    = farm->lost,
+            .late    = farm->late,
+    };
+}
+
+void decode_farm_get_worker_stats(decode_farm_t const *farm, unsigned index, double now, decode_farm_worker_stats_t *stats)
+{
+    farm_worker_t const *worker = &farm->workers[index];
+    *stats = (decode_farm_worker_stats_t){
+            .spec      = worker->spec,
+            .healthy   = worker_healthy(worker, now),
+            .in_flight = worker->in_flight,
+            .sent      = worker->sent,
+            .spilled   = worker->spilled,
+            .results   = worker->results,
+            .events    = worker->events,
+    };
+}
+
+/* Worker */
+
+struct decode_worker {
+    SOCKET sock;
+    struct sockaddr_storage peer; ///< the coordinator of the last package
+    socklen_t peer_len;
+    uint32_t id;       ///< the id of the last package, 0 after its result was sent
+    double time;       ///< the time the coordinator received the last package
+    unsigned count;    ///< outputs in the result
+    unsigned truncated;
+    farm_writer_t out; ///< the result, after the header and the count
+    char source[FARM_SOURCE_MAX + 1];
+    uint8_t buf[FARM_DATAGRAM_MAX];
+    uint8_t out_buf[FARM_DATAGRAM_MAX];
+};
+
+decode_worker_t *decode_worker_create(char const *host, char const *port)
+{
+    decode_worker_t *worker = calloc(1, sizeof(*worker));
+    if (!worker) {
+        WARN_CALLOC("decode_worker_create()");
+        return NULL;
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        free(worker);
+        return NULL;
+    }
+#endif
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    worker->sock = farm_open(host, port, 1, &addr, &addr_len);
+    if (worker->sock == INVALID_SOCKET) {
+        decode_worker_free(worker);
+        return NULL;
+    }
+    worker->out = (farm_writer_t){.buf = worker->out_buf, .size = sizeof(worker->out_buf), .len = FARM_HEADER_LEN + 2};
+    return worker;
+}
+
+int decode_worker_next(decode_worker_t *worker, pulse_data_t *pulses, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(worker->sock, &fds);
+    struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    int ready = select((int)worker->sock + 1, &fds, NULL, NULL, &tv);
+#ifndef _WIN32
+    if (ready < 0 && errno == EINTR)
+        return 0; // a signal, the caller checks if it should stop
+#endif
+    if (ready < 0) {
+        perror("select");
+        return -1;
+    }
+    if (ready == 0)
+        return 0;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int len = recvfrom(worker->sock, (char *)worker->buf, sizeof(worker->buf), 0, (struct sockaddr *)&addr, &addr_len);
+    if (len < 0) {
+        perror("recvfrom");
+        return -1;
+    }
+    farm_reader_t r = {.buf = worker->buf, .len = (size_t)len};
+    uint32_t id;
+    unsigned kind = get_header(&r, &id);
+    if (kind != FARM_PING && kind != FARM_PACKAGE)
+        return 0;
+    // the late events go to the last coordinator
+    worker->peer     = addr;
+    worker->peer_len = addr_len;
+    if (kind == FARM_PING) {
+        uint8_t pong[FARM_HEADER_LEN];
+        size_t pong_len = put_header(pong, FARM_PONG, id);
+        sendto(worker->sock, (char const *)pong, pong_len, 0, (struct sockaddr *)&addr, addr_len);
+        return 0;
+    }
+
+    worker->time      = (double)get_uint(&r, 8) * 1e-6;
+    size_t source_len = (size_t)get_uint(&r, 1);
+    if (!r.error && r.pos + source_len <= r.len) {
+        memcpy(worker->source, r.buf + r.pos, source_len);
+        r.pos += source_len;
+    }
+    else {
+        r.error = 1;
+        source_len = 0;
+    }
+    worker->source[source_len] = '\0';
+    worker->id = id;
+    if (r.error || !pulse_data_decode_bin(r.buf + r.pos, r.len - r.pos, pulses)) {
+        decode_worker_reply(worker); // an empty result, the coordinator doesn't wait for it
+        return 0;
+    }
+    return 1;
+}
+
+char const *decode_worker_source(decode_worker_t const *worker)
+{
+    return worker->source;
+}
+
+double decode_worker_time(decode_worker_t const *worker)
+{
+    return worker->time;
+}
+
+void decode_worker_add(decode_worker_t *worker, data_t *data, int level)
+{
+    farm_writer_t out = worker->out;
+    put_uint(&out, (unsigned)level, 1);
+    put_data(&out, data);
+    data_free(data);
+    if (out.overflow || worker->count >= 0xffff) {
+        worker->truncated++;
+        return;
+    }
+    worker->out = out;
+    worker->count++;
+}
+
+void decode_worker_reply(decode_worker_t *worker)
+{
+    if ((!worker->id && !worker->count) || !worker->peer_len)
+        return;
+    put_header(worker->out_buf, FARM_RESULT, worker->id);
+    farm_writer_t count = {.buf = worker->out_buf + FARM_HEADER_LEN, .size = 2};
+    put_uint(&count, worker->count, 2);
+    if (sendto(worker->sock, (char const *)worker->out_buf, worker->out.len, 0, (struct sockaddr *)&worker->peer, worker->peer_len) < 0)
+        perror("sendto");
+    worker->id      = 0;
+    worker->count   = 0;
+    worker->out.len = FARM_HEADER_LEN + 2;
+}
+
+unsigned decode_worker_truncated(decode_worker_t const *worker)
+{
+    return worker->truncated;
+}
+
+void decode_worker_free(decode_worker_t *worker)
+{
+    if (!worker)
+        return;
+    if (worker->sock != INVALID_SOCKET)
+        closesocket(worker->sock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    free(worker);
+}
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+static char output_json[4][256];
+static unsigned output_count;
+
+static void output_test(void *ctx, data_t *data, int level)
+{
+    (void)ctx;
+    (void)level;
+    if (output_count < 4)
+        data_print_jsons(data, output_json[output_count], sizeof(output_json[0]));
+    output_count++;
+    data_free(data);
+}
+
+/// Queue a result as a worker would send it.
+static void result_test(decode_farm_t *farm, unsigned w, uint32_t id, data_t *data)
+{
+    uint8_t buf[1024];
+    farm_writer_t out = {.buf = buf, .size = sizeof(buf)};
+    put_uint(&out, data ? 1 : 0, 2);
+    if (data) {
+        put_uint(&out, 0, 1);
+        put_data(&out, data);
+        data_free(data);
+    }
+    farm_reader_t r = {.buf = buf, .len = out.len};
+    receive_result(farm, w, id, &r, output_test, NULL);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "decode_farm:: the result encoding keeps the types, names, and formats\n");
+    data_t *data = data_make(
+            "model",    "Model",    DATA_STRING, "Test-Sensor",
+            "id",       "",         DATA_INT,    -42,
+            "temp_C",   "Temp",     DATA_FORMAT, "%.1f C", DATA_DOUBLE, 21.5,
+            "codes",    "",         DATA_ARRAY,  data_array(2, DATA_STRING, (char *[2]){"{12}abc", "{8}55"}),
+            "nested",   "",         DATA_DATA,   data_make("a", "", DATA_INT, 1, NULL),
+            NULL);
+    uint8_t buf[1024];
+    farm_writer_t out = {.buf = buf, .size = sizeof(buf)};
+    put_data(&out, data);
+    ASSERT_EQUALS(out.overflow, 0);
+    farm_reader_t r = {.buf = buf, .len = out.len};
+    data_t *copy = get_data(&r, 0);
+    ASSERT_EQUALS(copy != NULL, 1);
+    ASSERT_EQUALS((int)r.pos, (int)out.len);
+    char json[256];
+    char json_copy[256];
+    data_print_jsons(data, json, sizeof(json));
+    data_print_jsons(copy, json_copy, sizeof(json_copy));
+    ASSERT_EQUALS(strcmp(json, json_copy), 0);
+    ASSERT_EQUALS(strcmp(copy->pretty_key, "Model"), 0);
+    ASSERT_EQUALS(strcmp(copy->next->next->format, "%.1f C"), 0);
+    data_free(copy);
+    r = (farm_reader_t){.buf = buf, .len = out.len - 1}; // truncated
+    ASSERT_EQUALS(get_data(&r, 0) == NULL, 1);
+    out = (farm_writer_t){.buf = buf, .size = 16};
+    put_data(&out, data);
+    ASSERT_EQUALS(out.overflow, 1);
+    data_free(data);
+
+    fprintf(stderr, "decode_farm:: each worker keeps its keys when a worker is added\n");
+    char *specs[3] = {"10.0.0.1:1436", "10.0.0.2:1436", "10.0.0.3:1436"};
+    static farm_point_t points2[3 * DECODE_FARM_VNODES];
+    static farm_point_t points3[3 * DECODE_FARM_VNODES];
+    unsigned num2, num3;
+    ring_build(points2, &num2, specs, 2);
+    ring_build(points3, &num3, specs, 3);
+    unsigned moved = 0;
+    unsigned moved_elsewhere = 0; // keys only move to the new worker
+    unsigned owned[3] = {0};
+    for (uint32_t key = 0; key < 3000; ++key) {
+        uint32_t h = mix32(key);
+        unsigned w2 = points2[ring_find(points2, num2, h)].worker;
+        unsigned w3 = points3[ring_find(points3, num3, h)].worker;
+        owned[w3]++;
+        moved += w2 != w3;
+        moved_elsewhere += w2 != w3 && w3 != 2;
+    }
+    ASSERT_EQUALS(moved_elsewhere, 0u);
+    ASSERT_EQUALS(moved > 600 && moved < 1400, 1);
+    ASSERT_EQUALS(owned[0] > 600 && owned[1] > 600 && owned[2] > 600, 1);
+
+    fprintf(stderr, "decode_farm:: the results of a source are output in order\n");
+    decode_farm_t *farm = decode_farm_create();
+    ASSERT_EQUALS(farm != NULL, 1);
+    ASSERT_EQUALS(decode_farm_add_worker(farm, "localhost", "1436", 100.0), 0);
+    ASSERT_EQUALS(decode_farm_add_worker(farm, "localhost", "1437", 100.0), 0);
+    farm_source_t *edge = find_source(farm, "edge-1");
+    int slot1 = pending_add(farm, edge, 0, 100.0);
+    int slot2 = pending_add(farm, edge, 1, 100.0);
+    ASSERT_EQUALS(farm->workers[0].in_flight + farm->workers[1].in_flight, 2u);
+    result_test(farm, 1, farm->slots[slot2].id, data_make("seq", "", DATA_INT, 2, NULL));
+    release_results(farm, 100.1, output_test, NULL);
+    ASSERT_EQUALS((int)output_count, 0); // held for the first package
+    result_test(farm, 0, farm->slots[slot1].id, data_make("seq", "", DATA_INT, 1, NULL));
+    release_results(farm, 100.2, output_test, NULL);
+    ASSERT_EQUALS((int)output_count, 2);
+    ASSERT_EQUALS(strcmp(output_json[0], "{\"seq\":1}"), 0);
+    ASSERT_EQUALS(strcmp(output_json[1], "{\"seq\":2}"), 0);
+    ASSERT_EQUALS(decode_farm_pending(farm), 0u);
+
+    fprintf(stderr, "decode_farm:: a lost result releases the later results, it's output late\n");
+    slot1 = pending_add(farm, edge, 0, 101.0);
+    slot2 = pending_add(farm, edge, 0, 101.0);
+    uint32_t id1 = farm->slots[slot1].id;
+    result_test(farm, 0, farm->slots[slot2].id, NULL);
+    release_results(farm, 101.0 + DECODE_FARM_RESULT_S, output_test, NULL);
+    ASSERT_EQUALS(farm->lost, 1u);
+    ASSERT_EQUALS(farm->workers[0].in_flight, 0u);
+    result_test(farm, 0, id1, data_make("seq", "", DATA_INT, 3, NULL));
+    ASSERT_EQUALS(farm->late, 1u);
+    ASSERT_EQUALS((int)output_count, 3);
+
+    fprintf(stderr, "decode_farm:: a silent or busy worker is skipped\n");
+    int spilled;
+    uint32_t key = 12345;
+    int owner = ring_pick(farm, key, 101.0, &spilled);
+    ASSERT_EQUALS(spilled, 0);
+    farm->workers[owner].in_flight = DECODE_FARM_WINDOW;
+    ASSERT_EQUALS(ring_pick(farm, key, 101.0, &spilled), 1 - owner);
+    ASSERT_EQUALS(spilled, 1);
+    farm->workers[owner].in_flight = 0;
+    farm->workers[1 - owner].last_reply = 110.0;
+    ASSERT_EQUALS(ring_pick(farm, key, 110.0 + DECODE_FARM_HEALTH_S, &spilled), -1);
+    decode_farm_free(farm);
+
+    fprintf(stderr, "decode_farm:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
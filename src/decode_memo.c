@@ -0,0 +1,275 @@
+/** @file
+    Decode memo, reuse the decode of a package that repeats the bits of a recent one.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decode_memo.h"
+#include "bitbuffer.h"
+#include "bit_util.h"
+#include "data.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// A remembered decode.
+typedef struct memo_entry {
+    uint64_t hash;   ///< hash of the sliced rows, 0 if unused
+    double time;     ///< time of the decoded package
+    int ret;         ///< return code of the decoder
+    unsigned num_events;
+    data_t *events[DECODE_MEMO_EVENTS]; ///< copies of the events
+} memo_entry_t;
+
+struct decode_memo {
+    double window;
+    double now;              ///< time of the package the decoder runs on
+    memo_entry_t *hit;       ///< the entry found by decode_memo_begin(), NULL on a miss
+    memo_entry_t *recording; ///< the entry of the running decoder, NULL if not remembering
+    int record_failed;       ///< the run has too many events or a copy failed
+    memo_entry_t entries[DECODE_MEMO_ENTRIES];
+};
+
+decode_memo_t *decode_memo_create(double window)
+{
+    decode_memo_t *memo = calloc(1, sizeof(*memo));
+    if (!memo) {
+        WARN_CALLOC("decode_memo_create()");
+        return NULL;
+    }
+    memo->window = window;
+    return memo;
+}
+
+static void entry_clear(memo_entry_t *entry)
+{
+    for (unsigned i = 0; i < entry->num_events; ++i)
+        data_free(entry->events[i]);
+    *entry = (memo_entry_t){0};
+}
+
+void decode_memo_free(decode_memo_t *memo)
+{
+    if (!memo)
+        return;
+    for (unsigned i = 0; i < DECODE_MEMO_ENTRIES; ++i)
+        entry_clear(&memo->entries[i]);
+    free(memo);
+}
+
+void decode_memo_set_time(decode_memo_t *memo, double now)
+{
+    memo->now = now;
+}
+
+/// Get a hash of the rows as a decoder sees them, never 0.
+static uint64_t bits_hash(bitbuffer_t const *bits)
+{
+    uint64_t hash = FNV1A64_INIT;
+    unsigned num_rows = bits->num_rows < BITBUF_ROWS ? bits->num_rows : BITBUF_ROWS;
+    hash = fnv1a64(hash, &bits->num_rows, sizeof(bits->num_rows));
+    for (unsigned row = 0; row < num_rows; ++row) {
+        unsigned len = bits->bits_per_row[row];
+        // a long row, e.g. of PCM, runs on into the next rows
+        uint8_t const *b = (uint8_t const *)bits->bb + row * BITBUF_COLS;
+        hash = fnv1a64(hash, &bits->bits_per_row[row], sizeof(bits->bits_per_row[row]));
+        hash = fnv1a64(hash, &bits->syncs_before_row[row], sizeof(bits->syncs_before_row[row]));
+        hash = fnv1a64(hash, b, len / 8);
+        if (len & 7) {
+            // bits past the end of the row are undefined
+            uint8_t last = b[len / 8] & (0xff00 >> (len & 7));
+            hash = fnv1a64(hash, &last, 1);
+        }
+    }
+    return hash ? hash : 1;
+}
+
+int decode_memo_begin(decode_memo_t *memo, bitbuffer_t const *bits)
+{
+    uint64_t hash = bits_hash(bits);
+    memo->hit       = NULL;
+    memo->recording = NULL;
+
+    // reuse a recent decode, the time restarts with each input file, a later decode is stale
+    memo_entry_t *oldest = &memo->entries[0];
+    for (unsigned i = 0; i < DECODE_MEMO_ENTRIES; ++i) {
+        memo_entry_t *entry = &memo->entries[i];
+        int fresh = entry->hash && memo->now >= entry->time && memo->now - entry->time < memo->window;
+        if (fresh && entry->hash == hash) {
+            memo->hit = entry;
+            return 1;
+        }
+        if (!fresh && entry->hash)
+            entry_clear(entry);
+        if (!entry->hash || (oldest->hash && entry->time < oldest->time))
+            oldest = entry;
+    }
+
+    entry_clear(oldest);
+    oldest->hash        = hash;
+    oldest->time        = memo->now;
+    memo->recording     = oldest;
+    memo->record_failed = 0;
+    return 0;
+}
+
+void decode_memo_record(decode_memo_t *memo, data_t const *data)
+{
+    memo_entry_t *entry = memo->recording;
+    if (!entry || memo->record_failed)
+        return;
+    if (entry->num_events >= DECODE_MEMO_EVENTS) {
+        memo->record_failed = 1;
+        return;
+    }
+    data_t *copy = data_copy(data);
+    if (!copy) {
+        memo->record_failed = 1;
+        return;
+    }
+    entry->events[entry->num_events++] = copy;
+}
+
+void decode_memo_end(decode_memo_t *memo, int ret)
+{
+    memo_entry_t *entry = memo->recording;
+    memo->recording     = NULL;
+    if (!entry)
+        return;
+    if (memo->record_failed)
+        entry_clear(entry);
+    else
+        entry->ret = ret;
+}
+
+int decode_memo_replay(decode_memo_t *memo, void (*output_fn)(void *ctx, data_t *data), void *ctx)
+{
+    memo_entry_t *entry = memo->hit;
+    memo->hit           = NULL;
+    if (!entry)
+        return 0;
+    for (unsigned i = 0; i < entry->num_events; ++i) {
+        data_t *copy = data_copy(entry->events[i]);
+        if (copy)
+            output_fn(ctx, copy);
+    }
+    return entry->ret;
+}
+
+// Unit testing
+#ifdef _TEST
+
+#include <string.h>
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+static char replayed[256];
+
+static void output_test(void *ctx, data_t *data)
+{
+    unsigned *count = ctx;
+    *count += 1;
+    data_print_jsons(data, replayed, sizeof(replayed));
+    data_free(data);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    unsigned count  = 0;
+    bitbuffer_t bits = {0};
+    bits.num_rows        = 2;
+    bits.bits_per_row[0] = 12;
+    bits.bb[0][0]        = 0xab;
+    bits.bb[0][1]        = 0xc0;
+    bits.bits_per_row[1] = 8;
+    bits.bb[1][0]        = 0x55;
+
+    fprintf(stderr, "decode_memo:: remember a decode and replay it for a repeat\n");
+    decode_memo_t *memo = decode_memo_create(0.3);
+    ASSERT_EQUALS(memo != NULL, 1);
+    decode_memo_set_time(memo, 10.0);
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 0);
+    data_t *data = data_make(
+            "model", "", DATA_STRING, "Test-Remote",
+            "id",    "", DATA_INT,    42,
+            "codes", "", DATA_ARRAY,  data_array(2, DATA_STRING, (char *[2]){"{12}abc", "{8}55"}),
+            NULL);
+    decode_memo_record(memo, data);
+    data_free(data);
+    decode_memo_end(memo, 1);
+
+    decode_memo_set_time(memo, 10.2);
+    bits.bb[0][1] = 0xcf; // bits past the end of the row don't count
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 1);
+    ASSERT_EQUALS(decode_memo_replay(memo, output_test, &count), 1);
+    ASSERT_EQUALS((int)count, 1);
+    ASSERT_EQUALS(strcmp(replayed, "{\"model\":\"Test-Remote\",\"id\":42,\"codes\":[\"{12}abc\",\"{8}55\"]}"), 0);
+
+    fprintf(stderr, "decode_memo:: decode other bits, and a repeat after the window\n");
+    bits.bb[1][0] = 0x56;
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 0);
+    decode_memo_end(memo, -2); // an abort code
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 1);
+    ASSERT_EQUALS(decode_memo_replay(memo, output_test, &count), -2);
+    ASSERT_EQUALS((int)count, 1);
+    bits.bb[1][0] = 0x55;
+    decode_memo_set_time(memo, 10.4);
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 0);
+    decode_memo_end(memo, 0);
+
+    fprintf(stderr, "decode_memo:: a decode with too many events is not remembered\n");
+    decode_memo_set_time(memo, 20.0);
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 0);
+    for (unsigned i = 0; i <= DECODE_MEMO_EVENTS; ++i) {
+        data = data_make("id", "", DATA_INT, (int)i, NULL);
+        decode_memo_record(memo, data);
+        data_free(data);
+    }
+    decode_memo_end(memo, DECODE_MEMO_EVENTS + 1);
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 0);
+    decode_memo_end(memo, 0);
+
+    fprintf(stderr, "decode_memo:: a new input file restarts the time\n");
+    decode_memo_set_time(memo, 0.1);
+    ASSERT_EQUALS(decode_memo_begin(memo, &bits), 0);
+    decode_memo_end(memo, 0);
+
+    fprintf(stderr, "decode_memo:: a row longer than BITBUF_COLS bytes is hashed to its end\n");
+    static bitbuffer_t long_bits;
+    uint8_t *flat = (uint8_t *)long_bits.bb;
+    long_bits.num_rows        = 1;
+    long_bits.bits_per_row[0] = BITBUF_COLS * 8 * 2 + 12;
+    flat[BITBUF_COLS * 2]     = 0x5a;
+    flat[BITBUF_COLS * 2 + 1] = 0xb0;
+    decode_memo_set_time(memo, 1.0);
+    ASSERT_EQUALS(decode_memo_begin(memo, &long_bits), 0);
+    decode_memo_end(memo, -1);
+    flat[BITBUF_COLS * 2 + 1] = 0xbf; // bits past the end of the row don't count
+    ASSERT_EQUALS(decode_memo_begin(memo, &long_bits), 1);
+    ASSERT_EQUALS(decode_memo_replay(memo, output_test, &count), -1);
+    flat[BITBUF_COLS * 2] = 0x5b; // in the third row of the buffer
+    ASSERT_EQUALS(decode_memo_begin(memo, &long_bits), 0);
+    decode_memo_end(memo, 0);
+    decode_memo_free(memo);
+
+    fprintf(stderr, "decode_memo:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
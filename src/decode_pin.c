@@ -0,0 +1,342 @@
+/** @file
+    Decoder pinning, run the decoder that decoded a package fingerprint before, alone and first.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decode_pin.h"
+#include "data.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct pin_sensor {
+    char *model; ///< the spec, cut at the id
+    char const *id;
+    long id_int;
+    int id_is_int; ///< the id parses as a number, matches an integer id
+} pin_sensor_t;
+
+typedef struct pin_slot {
+    uint64_t key; ///< 0 if free
+    void *decoder;
+    unsigned uses;
+} pin_slot_t;
+
+struct decode_pin {
+    pin_sensor_t *sensors;
+    unsigned num_sensors;
+    unsigned generation;
+    void *noted; ///< the first decoder of a pinned sensor event of the current package
+    pin_slot_t slots[DECODE_PIN_SLOTS];
+    decode_pin_stats_t stats;
+#ifdef THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+int decode_pin_valid_sensor(char const *spec)
+{
+    char const *colon = spec ? strrchr(spec, ':') : NULL;
+    return colon && colon != spec && colon[1];
+}
+
+decode_pin_t *decode_pin_create(char const *const *sensors, unsigned num_sensors)
+{
+    decode_pin_t *pin = calloc(1, sizeof(*pin));
+    if (!pin) {
+        WARN_CALLOC("decode_pin_create()");
+        return NULL;
+    }
+    pin->sensors = calloc(num_sensors ? num_sensors : 1, sizeof(*pin->sensors));
+    if (!pin->sensors) {
+        WARN_CALLOC("decode_pin_create()");
+        free(pin);
+        return NULL;
+    }
+    for (unsigned i = 0; i < num_sensors; ++i) {
+        pin_sensor_t *sensor = &pin->sensors[pin->num_sensors];
+        sensor->model = strdup(sensors[i]);
+        if (!sensor->model) {
+            WARN_STRDUP("decode_pin_create()");
+            decode_pin_free(pin);
+            return NULL;
+        }
+        pin->num_sensors++;
+        // the model may contain a colon, the id follows the last one
+        char *colon = strrchr(sensor->model, ':');
+        *colon     = '\0';
+        sensor->id = colon + 1;
+        char *end;
+        sensor->id_int    = strtol(sensor->id, &end, 0);
+        sensor->id_is_int = !*end;
+    }
+#ifdef THREADS
+    pthread_mutex_init(&pin->lock, NULL);
+#endif
+    return pin;
+}
+
+void decode_pin_free(decode_pin_t *pin)
+{
+    if (!pin)
+        return;
+#ifdef THREADS
+    pthread_mutex_destroy(&pin->lock);
+#endif
+    for (unsigned i = 0; i < pin->num_sensors; ++i)
+        free(pin->sensors[i].model);
+    free(pin->sensors);
+    free(pin);
+}
+
+static void pin_lock(decode_pin_t *pin)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&pin->lock);
+#else
+    (void)pin;
+#endif
+}
+
+static void pin_unlock(decode_pin_t *pin)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&pin->lock);
+#else
+    (void)pin;
+#endif
+}
+
+/// Find the slot of a key, a free slot, or the least used slot of the probe.
+static pin_slot_t *find_slot(decode_pin_t *pin, uint64_t key, int add)
+{
+    unsigned home     = (unsigned)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (DECODE_PIN_SLOTS - 1);
+    pin_slot_t *spare = NULL;
+    for (unsigned i = 0; i < DECODE_PIN_PROBE; ++i) {
+        pin_slot_t *slot = &pin->slots[(home + i) & (DECODE_PIN_SLOTS - 1)];
+        if (slot->key == key)
+            return slot;
+        if (!spare || (spare->key && (!slot->key || slot->uses < spare->uses)))
+            spare = slot;
+    }
+    return add ? spare : NULL;
+}
+
+/// Check if an event is of a pinned sensor.
+static int sensor_pinned(decode_pin_t const *pin, data_t const *data)
+{
+    char const *model = NULL;
+    data_t const *id  = NULL;
+    for (; data; data = data->next) {
+        if (data->key_id == DATA_KEY_MODEL && data->type == DATA_STRING)
+            model = data->value.v_ptr;
+        else if (data->key_id == DATA_KEY_ID)
+            id = data;
+    }
+    if (!model || !id)
+        return 0;
+    for (unsigned i = 0; i < pin->num_sensors; ++i) {
+        pin_sensor_t const *sensor = &pin->sensors[i];
+        if (strcmp(sensor->model, model))
+            continue;
+        if (id->type == DATA_INT && sensor->id_is_int && sensor->id_int == id->value.v_int)
+            return 1;
+        if (id->type == DATA_STRING && !strcasecmp(sensor->id, id->value.v_ptr))
+            return 1;
+    }
+    return 0;
+}
+
+void *decode_pin_begin(decode_pin_t *pin, uint64_t key, unsigned generation)
+{
+    pin_lock(pin);
+    if (pin->generation != generation) {
+        // the decoders changed, the pointers may be stale
+        memset(pin->slots, 0, sizeof(pin->slots));
+        pin->stats.entries = 0;
+        pin->generation    = generation;
+    }
+    pin->noted = NULL;
+    pin->stats.packages++;
+    pin_slot_t *slot = key ? find_slot(pin, key, 0) : NULL;
+    if (slot)
+        slot->uses++;
+    void *decoder = slot ? slot->decoder : NULL;
+    pin_unlock(pin);
+    return decoder;
+}
+
+int decode_pin_event(decode_pin_t *pin, void *decoder, struct data const *data)
+{
+    int pinned = !pin->num_sensors || sensor_pinned(pin, data);
+    if (pinned) {
+        pin_lock(pin);
+        if (!pin->noted)
+            pin->noted = decoder;
+        pin_unlock(pin);
+    }
+    return pinned;
+}
+
+void decode_pin_drop(decode_pin_t *pin)
+{
+    pin_lock(pin);
+    pin->stats.dropped++;
+    pin_unlock(pin);
+}
+
+void decode_pin_end(decode_pin_t *pin, uint64_t key, int tried, int hit)
+{
+    pin_lock(pin);
+    if (tried) {
+        if (hit)
+            pin->stats.hits++;
+        else
+            pin->stats.misses++;
+    }
+    if (!hit && key && pin->noted) {
+        pin_slot_t *slot = find_slot(pin, key, 1);
+        if (!slot->key)
+            pin->stats.entries++;
+        slot->key     = key;
+        slot->decoder = pin->noted;
+        slot->uses    = 0;
+        pin->stats.learned++;
+    }
+    pin->noted = NULL;
+    pin_unlock(pin);
+}
+
+void decode_pin_get_stats(decode_pin_t *pin, decode_pin_stats_t *stats)
+{
+    pin_lock(pin);
+    *stats         = pin->stats;
+    stats->sensors = pin->num_sensors;
+    pin_unlock(pin);
+}
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    int dev_a       = 0; // stand-ins for the decoders
+    int dev_b       = 0;
+    decode_pin_stats_t stats;
+
+    fprintf(stderr, "decode_pin:: sensors are <model>:<id>\n");
+    ASSERT_EQUALS(decode_pin_valid_sensor("Acurite-Tower:1234"), 1);
+    ASSERT_EQUALS(decode_pin_valid_sensor("Some:Model:0x1f"), 1);
+    ASSERT_EQUALS(decode_pin_valid_sensor("Acurite-Tower"), 0);
+    ASSERT_EQUALS(decode_pin_valid_sensor("Acurite-Tower:"), 0);
+    ASSERT_EQUALS(decode_pin_valid_sensor(":1234"), 0);
+
+    char const *sensors[] = {"Acurite-Tower:1234", "Some:Model:0x1f", "Oregon-THGR810:ab"};
+    decode_pin_t *pin     = decode_pin_create(sensors, 3);
+    ASSERT_EQUALS(pin != NULL, 1);
+
+    fprintf(stderr, "decode_pin:: the events of the pinned sensors match\n");
+    data_t *tower = data_make("model", "", DATA_STRING, "Acurite-Tower", "id", "", DATA_INT, 1234, NULL);
+    data_t *other = data_make("model", "", DATA_STRING, "Acurite-Tower", "id", "", DATA_INT, 99, NULL);
+    data_t *hex   = data_make("model", "", DATA_STRING, "Some:Model", "id", "", DATA_INT, 31, NULL);
+    data_t *str   = data_make("model", "", DATA_STRING, "Oregon-THGR810", "id", "", DATA_STRING, "AB", NULL);
+    data_t *anon  = data_make("model", "", DATA_STRING, "Acurite-Tower", NULL);
+    ASSERT_EQUALS(decode_pin_event(pin, &dev_a, tower), 1);
+    ASSERT_EQUALS(decode_pin_event(pin, &dev_a, other), 0);
+    ASSERT_EQUALS(decode_pin_event(pin, &dev_a, hex), 1);
+    ASSERT_EQUALS(decode_pin_event(pin, &dev_a, str), 1);
+    ASSERT_EQUALS(decode_pin_event(pin, &dev_a, anon), 0);
+
+    fprintf(stderr, "decode_pin:: the cascade pins the decoder of a pinned sensor\n");
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 1) == NULL, 1);
+    decode_pin_event(pin, &dev_b, other);
+    decode_pin_end(pin, 42, 0, 0);
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 1) == NULL, 1);
+    decode_pin_event(pin, &dev_a, tower);
+    decode_pin_event(pin, &dev_b, hex);
+    decode_pin_end(pin, 42, 0, 0);
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 1) == &dev_a, 1);
+    decode_pin_end(pin, 42, 1, 1);
+
+    fprintf(stderr, "decode_pin:: a miss pins the decoder the cascade found\n");
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 1) == &dev_a, 1);
+    decode_pin_event(pin, &dev_b, str);
+    decode_pin_end(pin, 42, 1, 0);
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 1) == &dev_b, 1);
+    decode_pin_end(pin, 42, 1, 0);
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 1) == &dev_b, 1);
+    decode_pin_end(pin, 42, 1, 1);
+    ASSERT_EQUALS(decode_pin_begin(pin, 0, 1) == NULL, 1);
+    decode_pin_event(pin, &dev_a, tower);
+    decode_pin_end(pin, 0, 0, 0);
+    decode_pin_drop(pin);
+    decode_pin_get_stats(pin, &stats);
+    ASSERT_EQUALS((int)stats.sensors, 3);
+    ASSERT_EQUALS((int)stats.entries, 1);
+    ASSERT_EQUALS((int)stats.packages, 7);
+    ASSERT_EQUALS((int)stats.hits, 2);
+    ASSERT_EQUALS((int)stats.misses, 2);
+    ASSERT_EQUALS((int)stats.learned, 2);
+    ASSERT_EQUALS((int)stats.dropped, 1);
+
+    fprintf(stderr, "decode_pin:: a new generation of decoders clears the table\n");
+    ASSERT_EQUALS(decode_pin_begin(pin, 42, 2) == NULL, 1);
+    decode_pin_end(pin, 42, 0, 0);
+    decode_pin_get_stats(pin, &stats);
+    ASSERT_EQUALS((int)stats.entries, 0);
+
+    fprintf(stderr, "decode_pin:: a full probe replaces the least used fingerprint\n");
+    for (uint64_t key = 1; key <= 4 * DECODE_PIN_SLOTS; ++key) {
+        decode_pin_begin(pin, key, 2);
+        decode_pin_event(pin, &dev_a, tower);
+        decode_pin_end(pin, key, 0, 0);
+    }
+    decode_pin_get_stats(pin, &stats);
+    ASSERT_EQUALS(stats.entries <= DECODE_PIN_SLOTS, 1);
+    ASSERT_EQUALS(stats.entries > DECODE_PIN_SLOTS / 2, 1);
+    ASSERT_EQUALS(decode_pin_begin(pin, 4 * DECODE_PIN_SLOTS, 2) == &dev_a, 1);
+    decode_pin_end(pin, 4 * DECODE_PIN_SLOTS, 1, 1);
+    decode_pin_free(pin);
+
+    fprintf(stderr, "decode_pin:: without sensors any decoder is pinned\n");
+    pin = decode_pin_create(NULL, 0);
+    ASSERT_EQUALS(decode_pin_begin(pin, 7, 1) == NULL, 1);
+    ASSERT_EQUALS(decode_pin_event(pin, &dev_b, anon), 1);
+    decode_pin_end(pin, 7, 0, 0);
+    ASSERT_EQUALS(decode_pin_begin(pin, 7, 1) == &dev_b, 1);
+    decode_pin_end(pin, 7, 1, 1);
+    decode_pin_free(pin);
+
+    data_free(tower);
+    data_free(other);
+    data_free(hex);
+    data_free(str);
+    data_free(anon);
+
+    fprintf(stderr, "decode_pin:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,57 @@
+/** @file
+    Scratch buffers of a decoder thread, reused for every package.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decode_scratch.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+decode_scratch_t *decode_scratch_create(void)
+{
+    decode_scratch_t *scratch = calloc(1, sizeof(*scratch));
+    if (!scratch) {
+        WARN_CALLOC("decode_scratch_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    return scratch;
+}
+
+void decode_scratch_free(decode_scratch_t *scratch)
+{
+    if (!scratch)
+        return;
+    data_cache_clear(&scratch->data_cache);
+    free(scratch);
+}
+
+bitbuffer_t *decode_scratch_take_bits(decode_scratch_t *scratch)
+{
+    if (scratch->bits_taken >= DECODE_SCRATCH_BITS)
+        return NULL;
+    return &scratch->bits[scratch->bits_taken++];
+}
+
+void decode_scratch_give_bits(decode_scratch_t *scratch, bitbuffer_t *bits)
+{
+    if (!bits)
+        return;
+    bitbuffer_clear_used(bits);
+    memset(bits->bb[0], 0, sizeof(bits->bb[0])); // decoders may write the first row without adding it
+    if (scratch->bits_taken && bits == &scratch->bits[scratch->bits_taken - 1])
+        scratch->bits_taken--;
+}
+
+data_cache_t *decode_scratch_use(decode_scratch_t *scratch)
+{
+    return data_cache_use(scratch ? &scratch->data_cache : NULL);
+}
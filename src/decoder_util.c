@@ -12,6 +12,9 @@
 #include "decoder_util.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "log_ring.h"
+#include "decode_memo.h"
 #include "fatal.h"
 
 // create decoder functions
@@ -43,6 +46,119 @@ void *decoder_user_data(r_device *decoder)
     return decoder->decode_ctx;
 }
 
+// state table functions
+
+/// The header of a state table slot, the state follows.
+typedef struct {
+    uint64_t key;
+    uint64_t time; ///< when the state was last stored
+    int used;
+} state_slot_t;
+
+#define STATE_SET_SLOTS 4
+
+static size_t state_slot_size(unsigned state_size)
+{
+    // keep the slots aligned for the 64 bit header
+    return (sizeof(state_slot_t) + state_size + 7) & ~(size_t)7;
+}
+
+static unsigned state_num_sets(unsigned capacity)
+{
+    unsigned num_sets = 1;
+    while (num_sets * STATE_SET_SLOTS < capacity)
+        num_sets *= 2;
+    return num_sets;
+}
+
+size_t decoder_state_table_size(unsigned capacity, unsigned state_size)
+{
+    return sizeof(decoder_state_table_t) + state_num_sets(capacity) * STATE_SET_SLOTS * state_slot_size(state_size);
+}
+
+void decoder_state_table_init(decoder_state_table_t *table, unsigned capacity, unsigned state_size, uint64_t max_age)
+{
+    table->num_sets  = state_num_sets(capacity);
+    table->slot_size = state_slot_size(state_size);
+    table->max_age   = max_age;
+    memset(table->slots, 0, (size_t)table->num_sets * STATE_SET_SLOTS * table->slot_size);
+}
+
+/// The first slot of the set of a key.
+static state_slot_t *state_set(decoder_state_table_t *table, uint64_t key)
+{
+    uint64_t h   = key * 0x9e3779b97f4a7c15ULL;
+    unsigned set = (unsigned)(h >> 32) & (table->num_sets - 1);
+    return (state_slot_t *)&table->slots[(size_t)set * STATE_SET_SLOTS * table->slot_size];
+}
+
+static state_slot_t *state_next(decoder_state_table_t *table, state_slot_t *slot)
+{
+    return (state_slot_t *)((unsigned char *)slot + table->slot_size);
+}
+
+static int state_expired(decoder_state_table_t const *table, state_slot_t const *slot, uint64_t now)
+{
+    return now - slot->time > table->max_age;
+}
+
+/// Prefer an empty slot, then an expired one, then the least recently stored.
+static int state_evict_first(decoder_state_table_t const *table, state_slot_t const *a, state_slot_t const *b, uint64_t now)
+{
+    if (!a->used || !b->used)
+        return !a->used && b->used;
+    int a_expired = state_expired(table, a, now);
+    if (a_expired != state_expired(table, b, now))
+        return a_expired;
+    return a->time < b->time;
+}
+
+void *decoder_state_find(decoder_state_table_t *table, uint64_t key, uint64_t now)
+{
+    state_slot_t *slot = state_set(table, key);
+    for (int i = 0; i < STATE_SET_SLOTS; ++i, slot = state_next(table, slot)) {
+        if (slot->used && slot->key == key)
+            return state_expired(table, slot, now) ? NULL : slot + 1;
+    }
+    return NULL;
+}
+
+void *decoder_state_get(decoder_state_table_t *table, uint64_t key, uint64_t now, int *created)
+{
+    state_slot_t *slot   = state_set(table, key);
+    state_slot_t *victim = NULL;
+    for (int i = 0; i < STATE_SET_SLOTS; ++i, slot = state_next(table, slot)) {
+        if (slot->used && slot->key == key) {
+            if (state_expired(table, slot, now)) {
+                victim = slot; // start over
+                break;
+            }
+            slot->time = now;
+            if (created)
+                *created = 0;
+            return slot + 1;
+        }
+        if (!victim || state_evict_first(table, slot, victim, now))
+            victim = slot;
+    }
+    memset(victim, 0, table->slot_size);
+    victim->key  = key;
+    victim->time = now;
+    victim->used = 1;
+    if (created)
+        *created = 1;
+    return victim + 1;
+}
+
+void decoder_state_remove(decoder_state_table_t *table, uint64_t key)
+{
+    state_slot_t *slot = state_set(table, key);
+    for (int i = 0; i < STATE_SET_SLOTS; ++i, slot = state_next(table, slot)) {
+        if (slot->used && slot->key == key)
+            slot->used = 0;
+    }
+}
+
 // output functions
 
 void decoder_output_log(r_device *decoder, int level, data_t *data)
@@ -52,15 +168,29 @@ void decoder_output_log(r_device *decoder, int level, data_t *data)
 
 void decoder_output_data(r_device *decoder, data_t *data)
 {
+    if (decoder->decode_memo)
+        decode_memo_record(decoder->decode_memo, data);
     decoder->output_fn(decoder, data);
 }
 
+void decoder_output_record(r_device *decoder, data_record_t const *record)
+{
+    data_t *data = data_schema_make(decoder->record_schema, record);
+    if (data)
+        decoder_output_data(decoder, data);
+}
+
 // helper
 
 static char *bitrow_asprint_code(uint8_t const *bitrow, unsigned bit_len)
 {
-    char *row_code;
-    char row_bytes[BITBUF_ROWS * BITBUF_COLS * 2 + 1]; // TODO: this is a lot of stack
+    // a simple bitrow representation, the hex digits are printed in place
+    char *row_code = malloc(8 + bit_len / 4 + 2); // "{nnnnn}..\0"
+    if (!row_code) {
+        WARN_MALLOC("decoder_output_bitbuffer()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    char *row_bytes = row_code + sprintf(row_code, "{%u}", bit_len);
 
     row_bytes[0] = '\0';
     // print byte-wide
@@ -72,17 +202,9 @@ static char *bitrow_asprint_code(uint8_t const *bitrow, unsigned bit_len)
 
     // print at least one '0'
     if (bit_len == 0) {
-        snprintf(row_bytes, sizeof(row_bytes), "0");
+        snprintf(row_bytes, 2, "0");
     }
 
-    // a simple bitrow representation
-    row_code = malloc(8 + bit_len / 4 + 1); // "{nnnn}..\0"
-    if (!row_code) {
-        WARN_MALLOC("decoder_output_bitbuffer()");
-        return NULL; // NOTE: returns NULL on alloc failure.
-    }
-    sprintf(row_code, "{%u}%s", bit_len, row_bytes);
-
     return row_code;
 }
 
@@ -113,6 +235,28 @@ static char *bitrow_asprint_bits(uint8_t const *bitrow, unsigned bit_len)
     return row_bits;
 }
 
+/// Check the rate limit of a decoder log source, reports the messages suppressed before.
+static int decoder_log_allow(r_device *decoder, int level, char const *func)
+{
+    unsigned suppressed;
+    if (!log_rate_allow(func, &suppressed))
+        return 0;
+
+    if (suppressed) {
+        char msg[60];
+        snprintf(msg, sizeof(msg), "%u messages suppressed by the rate limit", suppressed);
+        /* clang-format off */
+        data_t *data = data_make(
+                "src",     "",     DATA_STRING, func,
+                "lvl",      "",     DATA_INT,    level,
+                "msg",      "",     DATA_STRING, msg,
+                NULL);
+        /* clang-format on */
+        decoder_output_log(decoder, level, data);
+    }
+    return 1;
+}
+
 // variadic output functions
 
 int decoder_verbose(r_device *decoder)
@@ -120,11 +264,20 @@ int decoder_verbose(r_device *decoder)
     return decoder->verbose;
 }
 
+/// Check if a message of this level is logged and some output takes it, before anything is formatted.
+static int decoder_log_wanted(r_device *decoder, int level)
+{
+    // note that decoder levels start at LOG_WARNING
+    return decoder->verbose >= level && decoder->log_level >= level + 4;
+}
+
 void decoder_log(r_device *decoder, int level, char const *func, char const *msg)
 {
-    if (decoder->verbose >= level) {
+    if (decoder_log_wanted(decoder, level)) {
         // note that decoder levels start at LOG_WARNING
         level += 4;
+        if (!decoder_log_allow(decoder, level, func))
+            return;
 
         /* clang-format off */
         data_t *data = data_make(
@@ -139,7 +292,7 @@ void decoder_log(r_device *decoder, int level, char const *func, char const *msg
 
 void decoder_logf(r_device *decoder, int level, char const *func, _Printf_format_string_ const char *format, ...)
 {
-    if (decoder->verbose >= level) {
+    if (decoder_log_wanted(decoder, level)) {
         char msg[60]; // fixed length limit
         va_list ap;
         va_start(ap, format);
@@ -152,9 +305,11 @@ void decoder_logf(r_device *decoder, int level, char const *func, _Printf_format
 
 void decoder_log_bitbuffer(r_device *decoder, int level, char const *func, const bitbuffer_t *bitbuffer, char const *msg)
 {
-    if (decoder->verbose >= level) {
+    if (decoder_log_wanted(decoder, level)) {
         // note that decoder levels start at LOG_WARNING
         level += 4;
+        if (!decoder_log_allow(decoder, level, func))
+            return;
 
         char *row_codes[BITBUF_ROWS] = {0};
         char *row_bits[BITBUF_ROWS] = {0};
@@ -194,7 +349,7 @@ void decoder_log_bitbuffer(r_device *decoder, int level, char const *func, const
 void decoder_logf_bitbuffer(r_device *decoder, int level, char const *func, const bitbuffer_t *bitbuffer, _Printf_format_string_ const char *format, ...)
 {
     // TODO: pass to interested outputs
-    if (decoder->verbose >= level) {
+    if (decoder_log_wanted(decoder, level)) {
         char msg[60]; // fixed length limit
         va_list ap;
         va_start(ap, format);
@@ -207,9 +362,11 @@ void decoder_logf_bitbuffer(r_device *decoder, int level, char const *func, cons
 
 void decoder_log_bitrow(r_device *decoder, int level, char const *func, uint8_t const *bitrow, unsigned bit_len, char const *msg)
 {
-    if (decoder->verbose >= level) {
+    if (decoder_log_wanted(decoder, level)) {
         // note that decoder levels start at LOG_WARNING
         level += 4;
+        if (!decoder_log_allow(decoder, level, func))
+            return;
 
         char *row_code;
         char *row_bits = NULL;
@@ -239,7 +396,7 @@ void decoder_log_bitrow(r_device *decoder, int level, char const *func, uint8_t
 
 void decoder_logf_bitrow(r_device *decoder, int level, char const *func, uint8_t const *bitrow, unsigned bit_len, _Printf_format_string_ const char *format, ...)
 {
-    if (decoder->verbose >= level) {
+    if (decoder_log_wanted(decoder, level)) {
         char msg[60]; // fixed length limit
         va_list ap;
         va_start(ap, format);
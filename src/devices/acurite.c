@@ -469,9 +469,9 @@ static int acurite_6045_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsign
 Acurite 899 Rain Gauge decoder
 
 */
-static int acurite_899_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t const *bb)
+static int acurite_899_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row)
 {
-    (void)bitbuffer;
+    uint8_t const *bb = bitbuffer->bb[row];
     // MIC (checksum, parity) validated in calling function
 
     uint16_t sensor_id = ((bb[0] & 0x3f) << 8) | bb[1]; //
@@ -518,10 +518,10 @@ static int acurite_899_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t
 Acurite 3n1 Weather Station decoder
 
 */
-static int acurite_3n1_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t const *bb)
+static int acurite_3n1_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row)
 {
     // MIC (checksum, parity) validated in calling function
-    (void)bitbuffer;
+    uint8_t const *bb = bitbuffer->bb[row];
 
     char const *channel_str = acurite_getChannel(bb[0]);
 
@@ -601,10 +601,10 @@ Acurite 5n1 Weather Station decoder
 XXX todo docs
 
 */
-static int acurite_5n1_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t const *bb)
+static int acurite_5n1_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row)
 {
     // MIC (checksum, parity) validated in calling function
-    (void)bitbuffer;
+    uint8_t const *bb = bitbuffer->bb[row];
 
     char const *channel_str = acurite_getChannel(bb[0]);
     uint16_t sensor_id = ((bb[0] & 0x0f) << 8) | bb[1];
@@ -960,11 +960,11 @@ Notes:
   - @todo - check if high 3 bits ever used for anything else
 
 */
-static int acurite_tower_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t const *bb)
+static int acurite_tower_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row)
 {
     // MIC (checksum, parity) validated in calling function
 
-    (void)bitbuffer;
+    uint8_t const *bb = bitbuffer->bb[row];
     int exception = 0;
     char const *channel_str = acurite_getChannel(bb[0]);
     int sensor_id = ((bb[0] & 0x3f) << 8) | bb[1];
@@ -1033,9 +1033,9 @@ related information from their website so specs, manual, etc.
 aren't easy to find
 
 */
-static int acurite_1190_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t const *bb)
+static int acurite_1190_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row)
 {
-    (void)bitbuffer;
+    uint8_t const *bb = bitbuffer->bb[row];
     // Channel is the first two bits of the 0th byte
     // but only 3 of the 4 possible values are valid
     char const *channel_str = acurite_getChannel(bb[0]);
@@ -1081,11 +1081,11 @@ CCII IIII | IIII IIII | pBMM MMMM | bTTT TTTT | bTTT TTTT | KKKK KKKK
 - p: Parity bit
 
 */
-static int acurite_515_decode(r_device *decoder, bitbuffer_t *bitbuffer, uint8_t const *bb)
+static int acurite_515_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row)
 {
     // length, MIC (checksum, parity) validated in calling function
 
-    (void)bitbuffer;
+    uint8_t const *bb = bitbuffer->bb[row];
     int exception = 0;
     char channel_type_str[3];
     uint8_t message_type = bb[2] & 0x3f;
@@ -1218,6 +1218,61 @@ static int acurite_txr_check(r_device *decoder, uint8_t const bb[], unsigned bro
     return 0;
 }
 
+/**
+Check Acurite 3n1 message integrity (length, checksum).
+
+@todo - does 3n1 use parity checking?
+3n1 g001 in rtl_433_test has odd parity the 2nd to last byte in both copies
+but g002 passes parity check
+*/
+static int acurite_3n1_check(r_device *decoder, uint8_t const bb[], unsigned browlen)
+{
+    if (browlen < ACURITE_3N1_BYTELEN) {
+        decoder_log_bitrow(decoder, 1, __func__, bb, browlen * 8, "3n1 wrong length");
+        return DECODE_ABORT_LENGTH;
+    }
+
+    if ((add_bytes(bb, ACURITE_3N1_BYTELEN - 1) & 0xff) != bb[ACURITE_3N1_BYTELEN - 1]) {
+        decoder_log_bitrow(decoder, 1, __func__, bb, browlen * 8, "bad checksum");
+        return DECODE_FAIL_MIC;
+    }
+
+    return 0;
+}
+
+/// Message types of the TXR family, the length to check and the decoder to dispatch to.
+typedef struct {
+    uint8_t bytelen;       ///< expected message length in bytes
+    uint8_t checksum_only; ///< check the length and checksum but not the parity and channel
+    int (*decode)(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row);
+} acurite_txr_msg_t;
+
+/*
+@todo - does the 899 use parity checking?
+The available sample shows a parity bit in the message byte
+but there isn't enough accumulated rain in the data bytes
+to see if parity is used
+*/
+static acurite_txr_msg_t const acurite_txr_msgs[64] = {
+        [ACURITE_MSGTYPE_1190_DETECTOR]                  = {ACURITE_1190_BYTELEN, 0, acurite_1190_decode},
+        [ACURITE_MSGTYPE_TOWER_SENSOR]                   = {ACURITE_TXR_BYTELEN, 0, acurite_tower_decode},
+        [ACURITE_MSGTYPE_6045M]                          = {ACURITE_6045_BYTELEN, 0, acurite_6045_decode},
+        [ACURITE_MSGTYPE_515_REFRIGERATOR]               = {ACURITE_515_BYTELEN, 0, acurite_515_decode},
+        [ACURITE_MSGTYPE_515_FREEZER]                    = {ACURITE_515_BYTELEN, 0, acurite_515_decode},
+        [ACURITE_MSGTYPE_5N1_WINDSPEED_WINDDIR_RAINFALL] = {ACURITE_5N1_BYTELEN, 0, acurite_5n1_decode},
+        [ACURITE_MSGTYPE_5N1_WINDSPEED_TEMP_HUMIDITY]    = {ACURITE_5N1_BYTELEN, 0, acurite_5n1_decode},
+        [ACURITE_MSGTYPE_3N1_WINDSPEED_TEMP_HUMIDITY]    = {ACURITE_3N1_BYTELEN, 1, acurite_3n1_decode},
+        [ACURITE_MSGTYPE_899_RAINFALL]                   = {ACURITE_899_BYTELEN, 0, acurite_899_decode},
+        // Atlas messages without lightning sensor installed - 8 bytes
+        [ACURITE_MSGTYPE_ATLAS_WNDSPD_TEMP_HUM]          = {ACURITE_ATLAS_BYTELEN, 0, acurite_atlas_decode},
+        [ACURITE_MSGTYPE_ATLAS_WNDSPD_RAIN]              = {ACURITE_ATLAS_BYTELEN, 0, acurite_atlas_decode},
+        [ACURITE_MSGTYPE_ATLAS_WNDSPD_UV_LUX]            = {ACURITE_ATLAS_BYTELEN, 0, acurite_atlas_decode},
+        // Atlas messages with lightning sensor installed - 10 bytes
+        [ACURITE_MSGTYPE_ATLAS_WNDSPD_TEMP_HUM_LTNG]     = {ACURITE_ATLAS_LTNG_BYTELEN, 0, acurite_atlas_decode},
+        [ACURITE_MSGTYPE_ATLAS_WNDSPD_RAIN_LTNG]         = {ACURITE_ATLAS_LTNG_BYTELEN, 0, acurite_atlas_decode},
+        [ACURITE_MSGTYPE_ATLAS_WNDSPD_UV_LUX_LTNG]       = {ACURITE_ATLAS_LTNG_BYTELEN, 0, acurite_atlas_decode},
+};
+
 /**
 Process messages for Acurite weather stations, tower and related sensors
 @sa acurite_1190_decode()
@@ -1290,176 +1345,27 @@ static int acurite_txr_decode(r_device *decoder, bitbuffer_t *bitbuffer)
         // M = Message type
         message_type = bb[2] & 0x3f;
 
-        // Check so that unknown message type can be flagged
-        // and dispatching to decoders can be easier to maintain
-        switch(message_type) {
-            case ACURITE_MSGTYPE_1190_DETECTOR:
-            case ACURITE_MSGTYPE_TOWER_SENSOR:
-            case ACURITE_MSGTYPE_6045M:
-            case ACURITE_MSGTYPE_5N1_WINDSPEED_WINDDIR_RAINFALL:
-            case ACURITE_MSGTYPE_5N1_WINDSPEED_TEMP_HUMIDITY:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_TEMP_HUM:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_RAIN:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_UV_LUX:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_TEMP_HUM_LTNG:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_RAIN_LTNG:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_UV_LUX_LTNG:
-            case ACURITE_MSGTYPE_515_REFRIGERATOR:
-            case ACURITE_MSGTYPE_515_FREEZER:
-            case ACURITE_MSGTYPE_3N1_WINDSPEED_TEMP_HUMIDITY:
-            case ACURITE_MSGTYPE_899_RAINFALL:
-                break;
-
-            default:
-                decoder_log_bitrow(decoder, 1, __func__, bb, row_bit_cnt,
-                                   "Unknown message type");
-                error_ret = DECODE_FAIL_SANITY;
-                continue;
-                break;
+        // Classify the row once by message type, then check and decode it once
+        acurite_txr_msg_t const *msg = &acurite_txr_msgs[message_type];
+        if (!msg->decode) {
+            decoder_log_bitrow(decoder, 1, __func__, bb, row_bit_cnt,
+                               "Unknown message type");
+            error_ret = DECODE_FAIL_SANITY;
+            continue;
         }
 
-        // Check message type and dispatch to appropriate decoders
         // NOTE: since we are processing each row, do not return
         // until all rows have been processed
-        if (message_type == ACURITE_MSGTYPE_TOWER_SENSOR) {
-            if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_TXR_BYTELEN)) != 0) {
-                error_ret = ret;
-            } else {
-                    if ((ret = acurite_tower_decode(decoder, bitbuffer, bb)) > 0) {
-                    decoded += ret;
-                } else if (ret < 0) {
-                    error_ret = ret;
-                }
-            }
-        }
-
-        if (message_type == ACURITE_MSGTYPE_1190_DETECTOR) {
-            if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_1190_BYTELEN)) != 0) {
-                error_ret = ret;
-            } else {
-                if ((ret = acurite_1190_decode(decoder, bitbuffer, bb)) > 0) {
-                    decoded += ret;
-                } else if (ret < 0) {
-                    error_ret = ret;
-                }
-            }
-        }
-
-        if (message_type == ACURITE_MSGTYPE_6045M) {
-            if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_6045_BYTELEN)) != 0) {
-                error_ret = ret;
-            } else {
-                if ((ret = acurite_6045_decode(decoder, bitbuffer, brow)) > 0) {
-                    decoded += ret;
-                } else if (ret < 0) {
-                    error_ret = ret;
-                }
-            }
-        }
-
-        if (message_type == ACURITE_MSGTYPE_515_REFRIGERATOR ||
-            message_type == ACURITE_MSGTYPE_515_FREEZER) {
-            if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_515_BYTELEN)) != 0) {
-                error_ret = ret;
-            } else {
-                if ((ret = acurite_515_decode(decoder, bitbuffer, bb)) > 0) {
-                    decoded += ret;
-                } else if (ret < 0) {
-                    error_ret = ret;
-                }
-            }
-        }
-
-        if (message_type == ACURITE_MSGTYPE_5N1_WINDSPEED_TEMP_HUMIDITY ||
-            message_type == ACURITE_MSGTYPE_5N1_WINDSPEED_WINDDIR_RAINFALL) {
-            if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_5N1_BYTELEN)) != 0) {
-                error_ret = ret;
-            } else {
-                if ((ret = acurite_5n1_decode(decoder, bitbuffer, bb)) > 0) {
-                    decoded += ret;
-                } else if (ret < 0) {
-                    error_ret = ret;
-                }
-            }
-        }
-
-        if (message_type == ACURITE_MSGTYPE_3N1_WINDSPEED_TEMP_HUMIDITY) {
-            /*
-              @todo - does 3n1 use parity checking?
-              3n1 g001 in rtl_433_test has odd parity the 2nd to last byte in both copies
-              but g002 passes parity check
-            */
-
-            if (browlen < ACURITE_3N1_BYTELEN) {
-                decoder_log_bitrow(decoder, 1, __func__, bb, browlen * 8, "3n1 wrong length");
-                error_ret = DECODE_ABORT_LENGTH;
-                continue;
-            }
-
-            if ((add_bytes(bb, ACURITE_3N1_BYTELEN - 1) & 0xff) !=
-                bb[ACURITE_3N1_BYTELEN - 1]) {
-                decoder_log_bitrow(decoder, 1, __func__, bb, browlen * 8, "bad checksum");
-                error_ret = DECODE_FAIL_MIC;
-                continue;
-            }
-
-            if ((ret = acurite_3n1_decode(decoder, bitbuffer, bb)) > 0) {
-                decoded += ret;
-            } else if (ret < 0) {
-                error_ret = ret;
-            }
-        }
-
-        if (message_type == ACURITE_MSGTYPE_899_RAINFALL) {
-            /*
-              @todo - does the 899 use parity checking?
-              The available sample shows a parity bit in the message byte
-              but there isn't enough accumulated rain in the data bytes
-              to see if parity is used
-            */
-            if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_899_BYTELEN)) != 0) {
-                error_ret = ret;
-            } else {
-                if ((ret = acurite_899_decode(decoder, bitbuffer, bb)) > 0) {
-                    decoded += ret;
-                } else if (ret < 0) {
-                    error_ret = ret;
-                }
-            }
-        }
-
-        // process Atlas
-        switch(message_type) {
-            // Atlas messages without lightning sensor installed - 8 bytes
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_TEMP_HUM:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_RAIN:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_UV_LUX:
-                if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_ATLAS_BYTELEN)) != 0) {
-                    error_ret = ret;
-                } else {
-                    if ((ret = acurite_atlas_decode(decoder, bitbuffer, brow)) > 0) {
-                        decoded += ret;
-                    } else if (ret < 0) {
-                        error_ret = ret;
-                    }
-                }
-                break;
-
-            // Atlas messages with lightning sensor installed - 10 bytes
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_TEMP_HUM_LTNG:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_RAIN_LTNG:
-            case ACURITE_MSGTYPE_ATLAS_WNDSPD_UV_LUX_LTNG:
-                if ((ret = acurite_txr_check(decoder, bb, browlen, ACURITE_ATLAS_LTNG_BYTELEN)) != 0) {
-                    error_ret = ret;
-                } else {
-                    if ((ret = acurite_atlas_decode(decoder, bitbuffer, brow)) > 0) {
-                        decoded += ret;
-                    } else if (ret < 0) {
-                        error_ret = ret;
-                    }
-                }
-                break;
-
+        if (msg->checksum_only)
+            ret = acurite_3n1_check(decoder, bb, browlen);
+        else
+            ret = acurite_txr_check(decoder, bb, browlen, msg->bytelen);
+        if (ret != 0) {
+            error_ret = ret;
+        } else if ((ret = msg->decode(decoder, bitbuffer, brow)) > 0) {
+            decoded += ret;
+        } else if (ret < 0) {
+            error_ret = ret;
         }
 
         decoder_logf(decoder, 2, __func__,
@@ -177,6 +177,8 @@ Some payloads:
 
 #include "decoder.h"
 
+static uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // (partial) preamble and sync word
+
 static int ambientweather_whx_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     int events = 0;
@@ -186,7 +188,6 @@ static int ambientweather_whx_decode(r_device *decoder, bitbuffer_t *bitbuffer)
     uint8_t const wh31e_type_code = 0x30; // 48
     uint8_t const wh31b_type_code = 0x37; // 55
 
-    uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // (partial) preamble and sync word
 
     for (row = 0; row < bitbuffer->num_rows; ++row) {
         // Validate message and reject it as fast as possible : check for preamble
@@ -394,6 +395,8 @@ r_device const ambientweather_wh31e = {
         .long_width  = 56,
         .reset_limit = 1500,
         .gap_limit   = 1800,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &ambientweather_whx_decode,
         .fields      = output_fields,
 };
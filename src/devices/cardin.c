@@ -124,6 +124,7 @@ r_device const cardin = {
         .sync_width  = 6150,
         .gap_limit   = 1600,
         .reset_limit = 32000,
+        .row_bits    = {24},
         .decode_fn   = &cardin_decode,
         .fields      = output_fields,
 };
@@ -189,10 +189,12 @@ The WH65B sends the same data with a slightly longer preamble and postamble
  */
 #define MODEL_WH24 24 /* internal identifier for model WH24, family code is always 0x24 */
 #define MODEL_WH65B 65 /* internal identifier for model WH65B, family code is always 0x24 */
+
+static uint8_t const preamble[] = {0xAA, 0x2D, 0xD4}; // part of preamble and sync word
+
 static int fineoffset_WH24_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     data_t *data;
-    uint8_t const preamble[] = {0xAA, 0x2D, 0xD4}; // part of preamble and sync word
     uint8_t b[17]; // aligned packet data
     unsigned bit_offset;
     int type;
@@ -382,7 +384,6 @@ FAM:8d ID: 8h 1b Bat_MSB:1d PMTWO:14d Bat_LSB:2d PMTEN:14d CRC:8h BITSIM:8h bbbb
 static int fineoffset_WH0290_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     data_t *data;
-    uint8_t const preamble[] = {0xAA, 0x2D, 0xD4};
     uint8_t b[8];
     unsigned bit_offset;
 
@@ -462,7 +463,6 @@ WH32B is the same as WH25 but two packets in one transmission of {971} and XOR s
 static int fineoffset_WH25_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     data_t *data;
-    uint8_t const preamble[] = {0xAA, 0x2D, 0xD4};
     uint8_t b[8];
     int type = 25;
     unsigned bit_offset;
@@ -593,7 +593,6 @@ Short explanation:
 static int fineoffset_WH51_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     data_t *data;
-    uint8_t const preamble[] = {0xAA, 0x2D, 0xD4};
     uint8_t b[14];
     unsigned bit_offset;
 
@@ -1025,6 +1024,8 @@ r_device const fineoffset_WH25 = {
         .short_width = 58,    // Bit width = 58µs (measured across 580 samples / 40 bits / 250 kHz)
         .long_width  = 58,    // NRZ encoding (bit width = pulse width)
         .reset_limit = 20000, // Package starts with a huge gap of ~18900 us
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_WH25_callback,
         .fields      = output_fields_WH25,
 };
@@ -1035,6 +1036,8 @@ r_device const fineoffset_WH51 = {
         .short_width = 58, // Bit width = 58µs (measured across 580 samples / 40 bits / 250 kHz)
         .long_width  = 58, // NRZ encoding (bit width = pulse width)
         .reset_limit = 5000,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_WH51_callback,
         .fields      = output_fields_WH51,
 };
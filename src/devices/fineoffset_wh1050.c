@@ -198,6 +198,8 @@ static int fineoffset_wh1050_decode(r_device *decoder, bitbuffer_t *bitbuffer, u
 Fineoffset or TFA OOK/FSK protocol.
 @sa fineoffset_wh1050_decode()
 */
+static uint8_t const preamble_fsk[] = {0xAA, 0x2D, 0xD4}; // part of preamble and sync word for FSK
+
 static int fineoffset_wh1050_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     unsigned bitpos = 0;
@@ -223,7 +225,6 @@ static int fineoffset_wh1050_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 
     unsigned bits = bitbuffer->bits_per_row[0];
     uint8_t preamble_byte = bitbuffer->bb[0][0]; // for OOK
-    uint8_t const preamble_fsk[] = {0xAA, 0x2D, 0xD4}; // part of preamble and sync word for FSK
     if (bits == 79 && preamble_byte == 0xfe) {
         fineoffset_wh1050_decode(decoder, bitbuffer, 7, TYPE_OOK);
     } else if (bits == 80 && preamble_byte == 0xff) {
@@ -271,6 +272,8 @@ r_device const tfa_303151 = {
         .short_width = 60,
         .long_width  = 60,
         .reset_limit = 2500,
+        .preamble    = preamble_fsk,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_wh1050_callback,
         .priority    = 10, // Eliminate false positives by letting Fineoffset/Ecowitt WH55 go earlier
         .fields      = output_fields,
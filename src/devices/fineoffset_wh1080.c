@@ -120,6 +120,8 @@ static int const wind_dir_degr[]= {0, 23, 45, 68, 90, 113, 135, 158, 180, 203, 2
 #define TYPE_OOK 1
 #define TYPE_FSK 2
 
+static uint8_t const fsk_preamble[] = {0xAA, 0x2D, 0xD4};
+
 static int fineoffset_wh1080_callback(r_device *decoder, bitbuffer_t *bitbuffer, int type)
 {
     data_t *data;
@@ -130,7 +132,6 @@ static int fineoffset_wh1080_callback(r_device *decoder, bitbuffer_t *bitbuffer,
     int preamble;         // 7 or 8 preamble bits
     int temp_raw;
     float temperature;
-    uint8_t const fsk_preamble[] = {0xAA, 0x2D, 0xD4};
 
     if (bitbuffer->num_rows != 1) {
         return DECODE_ABORT_EARLY;
@@ -365,6 +366,8 @@ r_device const fineoffset_wh1080_fsk = {
         .short_width = 58,
         .long_width  = 58,
         .reset_limit = 5800,
+        .preamble    = fsk_preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_wh1080_callback_fsk,
         .fields      = output_fields,
 };
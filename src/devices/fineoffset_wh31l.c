@@ -85,9 +85,10 @@ Raw flex decoder and BitBench format:
 
 #include "decoder.h"
 
+static uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // (partial) preamble and sync word
+
 static int fineoffset_wh31l_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // (partial) preamble and sync word
 
     int row = 0;
     // Search for preamble and sync-word
@@ -172,6 +173,8 @@ r_device const fineoffset_wh31l = {
         .short_width = 56,
         .long_width  = 56,
         .reset_limit = 1000,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_wh31l_decode,
         .fields      = output_fields,
 };
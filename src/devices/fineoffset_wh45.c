@@ -61,9 +61,10 @@ Technical documents for the SCD30 are here:
 https://sensirion.com/products/catalog/SCD30/
 */
 
+static uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // 24 bit, part of preamble and sync word
+
 static int fineoffset_wh45_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // 24 bit, part of preamble and sync word
     uint8_t b[15];
 
     // bit counts have been observed between 187 and 222
@@ -148,6 +149,8 @@ r_device const fineoffset_wh45 = {
         .short_width = 58,
         .long_width  = 58,
         .reset_limit = 2500,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_wh45_decode,
         .fields      = output_fields,
 };
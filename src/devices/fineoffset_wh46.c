@@ -57,9 +57,10 @@ Technical documents for the SCD30 are here:
 https://sensirion.com/products/catalog/SCD30/
 */
 
+static uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // 24 bit, part of preamble and sync word
+
 static int fineoffset_wh46_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // 24 bit, part of preamble and sync word
     uint8_t b[21];
 
     // Find a data package and extract data buffer
@@ -151,6 +152,8 @@ r_device const fineoffset_wh46 = {
         .short_width = 58,
         .long_width  = 58,
         .reset_limit = 2500,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_wh46_decode,
         .fields      = output_fields,
 };
@@ -43,10 +43,10 @@ Format string:
 
 */
 
+static uint8_t const preamble[] = {0xAA, 0x2D, 0xD4, 0x55}; // part of preamble, sync word, and message type
+
 static int fineoffset_wh55_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xAA, 0x2D, 0xD4, 0x55}; // part of preamble, sync word, and message type
-
     if (bitbuffer->num_rows != 1) {
         return DECODE_ABORT_EARLY; // We expect a single row
     }
@@ -114,6 +114,9 @@ r_device const fineoffset_wh55 = {
         .short_width = 60,
         .long_width  = 60,
         .reset_limit = 2500,
+        .max_rows    = 1,
+        .preamble    = preamble,
+        .preamble_bits = 32,
         .decode_fn   = &fineoffset_wh55_decode,
         .fields      = output_fields,
 };
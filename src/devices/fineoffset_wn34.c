@@ -37,10 +37,11 @@ Packet layout:
 
 */
 
+static uint8_t const preamble[] = {0xAA, 0x2D, 0xD4};
+
 static int fineoffset_wn34_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     data_t *data;
-    uint8_t const preamble[] = {0xAA, 0x2D, 0xD4};
     uint8_t b[9];
     unsigned bit_offset;
     float temperature;
@@ -138,6 +139,8 @@ r_device const fineoffset_wn34 = {
         .short_width = 58,
         .long_width  = 58,
         .reset_limit = 2500,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_wn34_decode,
         .fields      = output_fields,
 };
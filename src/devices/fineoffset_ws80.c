@@ -43,9 +43,10 @@ Packet layout:
 
 */
 
+static uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // 24 bit, part of preamble and sync word
+
 static int fineoffset_ws80_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xaa, 0x2d, 0xd4}; // 24 bit, part of preamble and sync word
     uint8_t b[18];
 
     // Validate package, WS80 nominal size is 219 bit periods
@@ -137,6 +138,8 @@ r_device const fineoffset_ws80 = {
         .short_width = 58,
         .long_width  = 58,
         .reset_limit = 1500,
+        .preamble    = preamble,
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_ws80_decode,
         .fields      = output_fields,
 };
@@ -57,9 +57,10 @@ Packet layout:
 
 */
 
+static uint8_t const preamble[] = {0xaa, 0xaa, 0x2d, 0xd4}; // 32 bit, part of preamble and sync word
+
 static int fineoffset_ws90_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xaa, 0xaa, 0x2d, 0xd4}; // 32 bit, part of preamble and sync word
     uint8_t b[32];
 
     // Validate package, WS90 nominal size is 345 bit periods
@@ -169,6 +170,8 @@ r_device const fineoffset_ws90 = {
         .short_width = 58,
         .long_width  = 58,
         .reset_limit = 3000,
+        .preamble    = &preamble[1], // the sync word the other Fine Offset decoders declare
+        .preamble_bits = 24,
         .decode_fn   = &fineoffset_ws90_decode,
         .fields      = output_fields,
 };
@@ -10,6 +10,7 @@
 */
 
 #include "decoder.h"
+#include "decode_scratch.h"
 #include "optparse.h"
 #include "fatal.h"
 #include <stdlib.h>
@@ -92,6 +93,9 @@ struct flex_params {
     uint8_t match_bits[128];
     unsigned preamble_len;
     uint8_t preamble_bits[128];
+    uint8_t match_raw_bits[128];   ///< match_bits as they appear before the invert
+    bitbuffer_pattern_t match_raw; ///< match_raw_bits prepared, searches the rows as sliced
+    bitbuffer_pattern_t preamble;  ///< preamble_bits prepared
     uint32_t symbol_zero;
     uint32_t symbol_one;
     uint32_t symbol_sync;
@@ -138,14 +142,14 @@ static void render_getters(data_t *data, uint8_t *bits, struct flex_params *para
 /**
 Generic flex decoder.
 */
-static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
+static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer, decode_scratch_t *scratch)
 {
     int i;
     int match_count = 0;
     data_t *data;
     data_t *row_data[BITBUF_ROWS];
     char *row_codes[BITBUF_ROWS];
-    char row_bytes[BITBUF_ROWS * BITBUF_COLS * 2 + 1]; // TODO: this is a lot of stack
+    char *row_bytes = scratch->text;
 
     struct flex_params *params = decoder_user_data(decoder);
 
@@ -169,19 +173,35 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_EARLY;
     // TODO: set match_count to count of repeated rows
 
+    // discard unless match, on the rows as sliced before any changes to the bitbuffer
+    // NOTE: not with reflect, the reflected bytes reorder the bits across byte boundaries
+    if (params->match_len && !params->reflect) {
+        // the flex decoders of a timing share one window summary of the rows
+        if (decoder->slice_windows && !bitbuffer_windows_may_match(decoder->slice_windows, &params->match_raw))
+            return DECODE_FAIL_SANITY;
+        r = -1;
+        match_count = 0;
+        for (i = 0; i < bitbuffer->num_rows; i++) {
+            if (bitbuffer_search_pattern(bitbuffer, i, 0, &params->match_raw) < bitbuffer->bits_per_row[i]) {
+                if (r < 0)
+                    r = i;
+                match_count++;
+            }
+        }
+        if (!match_count)
+            return DECODE_FAIL_SANITY;
+    }
+
     if (params->invert) {
         bitbuffer_invert(bitbuffer);
     }
 
     if (params->reflect) {
-        // TODO: refactor to utils
-        for (i = 0; i < bitbuffer->num_rows; ++i) {
-            reflect_bytes(bitbuffer->bb[i], (bitbuffer->bits_per_row[i] + 7) / 8);
-        }
+        bitbuffer_reflect(bitbuffer);
     }
 
     // discard unless match
-    if (params->match_len) {
+    if (params->match_len && params->reflect) {
         r = -1;
         match_count = 0;
         for (i = 0; i < bitbuffer->num_rows; i++) {
@@ -200,7 +220,7 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         r = -1;
         match_count = 0;
         for (i = 0; i < bitbuffer->num_rows; i++) {
-            unsigned pos = bitbuffer_search(bitbuffer, i, 0, params->preamble_bits, params->preamble_len);
+            unsigned pos = bitbuffer_search_pattern(bitbuffer, i, 0, &params->preamble);
             if (pos < bitbuffer->bits_per_row[i]) {
                 if (r < 0)
                     r = i;
@@ -208,9 +228,11 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
                 pos += params->preamble_len;
                 // TODO: refactor to bitbuffer_shift_row()
                 unsigned len = bitbuffer->bits_per_row[i] - pos;
-                bitbuffer_t tmp = {0};
-                bitbuffer_extract_bytes(bitbuffer, i, pos, tmp.bb[0], len);
-                memcpy(bitbuffer->bb[i], tmp.bb[0], (len + 7) / 8);
+                bitbuffer_t *tmp = decode_scratch_take_bits(scratch);
+                bitbuffer_extract_bytes(bitbuffer, i, pos, tmp->bb[0], len);
+                memcpy(bitbuffer->bb[i], tmp->bb[0], (len + 7) / 8);
+                memset(tmp->bb[0], 0, (len + 7) / 8);
+                decode_scratch_give_bits(scratch, tmp);
                 bitbuffer->bits_per_row[i] = len;
             }
         }
@@ -225,10 +247,12 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 
         for (i = 0; i < bitbuffer->num_rows; i++) {
             // TODO: refactor to bitbuffer_decode_symbol_row()
-            unsigned len    = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
-            len             = extract_bits_symbols(bitbuffer->bb[i], 0, len, zero, one, sync, tmp.bb[0]);
-            memcpy(bitbuffer->bb[i], tmp.bb[0], len); // safe to write over: can only be shorter
+            unsigned len     = bitbuffer->bits_per_row[i];
+            bitbuffer_t *tmp = decode_scratch_take_bits(scratch);
+            len              = extract_bits_symbols(bitbuffer->bb[i], 0, len, zero, one, sync, tmp->bb[0]);
+            memcpy(bitbuffer->bb[i], tmp->bb[0], len); // safe to write over: can only be shorter
+            memset(tmp->bb[0], 0, len);
+            decode_scratch_give_bits(scratch, tmp);
             bitbuffer->bits_per_row[i] = len;
         }
         // TODO: apply min_bits, max_bits check
@@ -238,9 +262,11 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         for (i = 0; i < bitbuffer->num_rows; i++) {
             // TODO: refactor to bitbuffer_decode_uart_row()
             unsigned len = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
-            len = extract_bytes_uart(bitbuffer->bb[i], 0, len, tmp.bb[0]);
-            memcpy(bitbuffer->bb[i], tmp.bb[0], len); // safe to write over: can only be shorter
+            bitbuffer_t *tmp = decode_scratch_take_bits(scratch);
+            len = extract_bytes_uart(bitbuffer->bb[i], 0, len, tmp->bb[0]);
+            memcpy(bitbuffer->bb[i], tmp->bb[0], len); // safe to write over: can only be shorter
+            memset(tmp->bb[0], 0, len);
+            decode_scratch_give_bits(scratch, tmp);
             bitbuffer->bits_per_row[i] = len * 8;
         }
     }
@@ -249,10 +275,11 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         for (i = 0; i < bitbuffer->num_rows; i++) {
             // TODO: refactor to bitbuffer_decode_dm_row()
             unsigned len = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
-            bitbuffer_differential_manchester_decode(bitbuffer, i, 0, &tmp, len);
-            len = tmp.bits_per_row[0];
-            memcpy(bitbuffer->bb[i], tmp.bb[0], (len + 7) / 8); // safe to write over: can only be shorter
+            bitbuffer_t *tmp = decode_scratch_take_bits(scratch);
+            bitbuffer_differential_manchester_decode(bitbuffer, i, 0, tmp, len);
+            len = tmp->bits_per_row[0];
+            memcpy(bitbuffer->bb[i], tmp->bb[0], (len + 7) / 8); // safe to write over: can only be shorter
+            decode_scratch_give_bits(scratch, tmp);
             bitbuffer->bits_per_row[i] = len;
         }
     }
@@ -307,7 +334,7 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 
         // print at least one '0'
         if (row_bytes[0] == '\0') {
-            snprintf(row_bytes, sizeof(row_bytes), "0");
+            snprintf(row_bytes, DECODE_SCRATCH_TEXT, "0");
         }
 
         // a simpler representation for csv output
@@ -408,6 +435,10 @@ static void help(void)
             "\tmatch=<bits> : only match if the <bits> are found\n"
             "\tpreamble=<bits> : match and align at the <bits> preamble\n"
             "\t\t<bits> is a row spec of {<bit count>}<bits as hex number>\n"
+            "\tstream=<n> : decode while the package is received, once it has <n> pulses\n"
+            "\tscale=<min>:<max>[:<steps>] : PWM/PPM only, try the timings scaled from <min> to <max> in <steps> (default: 5),\n"
+            "\t\tand decode with the one that fits the most pulses, for units that vary in bit rate\n"
+            "\texclusive : a match rules out the other decoders (with -Y adaptive=2)\n"
             "\tunique : suppress duplicate row output\n\n"
             "\tcountonly : suppress detailed row output\n\n"
             "E.g. -X \"n=doorbell,m=OOK_PWM,s=400,l=800,r=7000,g=1000,match={24}0xa9878c,repeats>=3\"\n\n");
@@ -464,6 +495,24 @@ static float parse_float(char const *str, char const *error_hint)
 
 }
 
+/// Parse "<min>:<max>[:<steps>]" timing scales, the steps default to 5.
+static void parse_scale(char const *str, r_device *dev)
+{
+    if (!str || !*str) {
+        fprintf(stderr, "scale: missing <min>:<max> argument\n");
+        exit(1);
+    }
+    char *endptr;
+    dev->timing_scale_min = strtod(str, &endptr);
+    dev->timing_scale_max = *endptr == ':' ? strtod(endptr + 1, &endptr) : 0.0;
+    dev->timing_steps     = *endptr == ':' ? strtoul(endptr + 1, &endptr, 10) : 5;
+    if (*endptr != '\0' || dev->timing_scale_min <= 0.0f || dev->timing_scale_max <= dev->timing_scale_min
+            || dev->timing_steps < 2 || dev->timing_steps > TIMING_STEPS_MAX) {
+        fprintf(stderr, "scale: invalid argument (%s), use <min>:<max>[:<steps>] with 0 < min < max and 2 to %d steps\n", str, TIMING_STEPS_MAX);
+        exit(1);
+    }
+}
+
 static unsigned parse_modulation(char const *str)
 {
     if (!strcasecmp(str, "OOK_MC_ZEROBIT"))
@@ -614,7 +663,7 @@ static void parse_getter(const char *arg, struct flex_get *getter)
     */
 }
 
-// NOTE: this is declared in rtl_433.c also.
+// NOTE: this is declared in rtl_433.c and r_api.c also.
 r_device *flex_create_device(char *spec);
 
 r_device *flex_create_device(char *spec)
@@ -634,7 +683,7 @@ r_device *flex_create_device(char *spec)
     if (!spec)
         FATAL_STRDUP("flex_create_device()");
 
-    dev->decode_fn = flex_callback;
+    dev->decode_fn2 = flex_callback;
     dev->fields = output_fields;
 
     char *key, *val;
@@ -670,6 +719,8 @@ r_device *flex_create_device(char *spec)
             dev->reset_limit = parse_float(val, "reset: ");
         else if (!strcasecmp(key, "t") || !strcasecmp(key, "tolerance"))
             dev->tolerance = parse_float(val, "tolerance: ");
+        else if (!strcasecmp(key, "scale"))
+            parse_scale(val, dev);
         else if (!strcasecmp(key, "prio") || !strcasecmp(key, "priority"))
             dev->priority = parse_atoiv(val, 0, "priority: ");
 
@@ -705,6 +756,11 @@ r_device *flex_create_device(char *spec)
         else if (!strcasecmp(key, "preamble"))
             params->preamble_len = parse_bits(val, params->preamble_bits);
 
+        else if (!strcasecmp(key, "stream"))
+            dev->stream_pulses = parse_atoiv(val, 0, "stream: ");
+        else if (!strcasecmp(key, "exclusive"))
+            dev->exclusive = parse_atoiv(val, 1, "exclusive: ");
+
         else if (!strcasecmp(key, "countonly"))
             params->count_only = parse_atoiv(val, 1, "countonly: ");
 
@@ -740,6 +796,14 @@ r_device *flex_create_device(char *spec)
     if (params->min_bits < params->match_len)
         params->min_bits = params->match_len;
 
+    // prepare the searches once
+    for (unsigned b = 0; b < (params->match_len + 7) / 8; ++b) {
+        params->match_raw_bits[b] = params->invert ? ~params->match_bits[b] : params->match_bits[b];
+    }
+    params->match_raw = bitbuffer_search_prepare(params->match_raw_bits, params->match_len);
+    params->preamble  = bitbuffer_search_prepare(params->preamble_bits, params->preamble_len);
+    dev->want_windows = params->match_len >= 16 && !params->reflect;
+
     if (params->min_bits > 0 && params->min_repeats < 1)
         params->min_repeats = 1;
 
@@ -816,3 +880,25 @@ r_device *flex_create_device(char *spec)
     free(spec);
     return dev;
 }
+
+// NOTE: this is declared in r_api.c also.
+r_device *flex_clone_device(r_device const *flex_device);
+
+/// Copy a parsed flex decoder, the strings of the spec are shared.
+r_device *flex_clone_device(r_device const *flex_device)
+{
+    r_device *dev = decoder_create(flex_device, sizeof(struct flex_params));
+    if (!dev) {
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    struct flex_params *params = decoder_user_data(dev);
+    *params = *(struct flex_params const *)flex_device->decode_ctx;
+
+    // the searches and the fields point into the params
+    params->match_raw = bitbuffer_search_prepare(params->match_raw_bits, params->match_len);
+    params->preamble  = bitbuffer_search_prepare(params->preamble_bits, params->preamble_len);
+    if (params->unique)
+        dev->fields = params->fields;
+
+    return dev;
+}
@@ -14,8 +14,24 @@ Wireless M-Bus (EN 13757-4).
 Implements the Physical layer (RF receiver) and Data Link layer of the
 Wireless M-Bus protocol. Will return a data string (including the CI byte)
 for further processing by an Application layer (outside this program).
+
+The decoders (except the Mode F stub) are run while a telegram is received,
+a partial telegram is rejected as too short until all the blocks given by
+the L field are in, then decoded at once. Long multi-block telegrams spill
+over the bitbuffer rows and are not cut short.
+
+Payloads encrypted with security mode 5 (AES-128-CBC) are decrypted if the
+key of the meter is given in a key file, e.g. `-R 104:keys=meters.txt`.
+Each line of the file has the manufacturer code, the ID, and the key in hex,
+blank lines and lines starting with `#` are ignored:
+
+    # Manufacturer ID Key
+    KAM 12345678 000102030405060708090A0B0C0D0E0F
 */
 #include "decoder.h"
+#include "optparse.h"
+#include "aes.h"
+#include <stdlib.h>
 
 #define BLOCK1A_SIZE 12     // Size of Block 1, format A
 #define BLOCK1B_SIZE 10     // Size of Block 1, format B
@@ -28,47 +44,51 @@ static unsigned bcd2int(uint8_t bcd)
     return 10*(bcd>>4) + (bcd & 0xF);
 }
 
-// Mapping from 6 bits to 4 bits. "3of6" coding used for Mode T
-static uint8_t m_bus_decode_3of6(uint8_t byte)
+// Mapping from 6 bits to 4 bits, 0xF0 marks an invalid code. "3of6" coding used for Mode T
+static uint8_t const m_bus_3of6_table[64] = {
+        0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, // 0x00
+        0xF0, 0xF0, 0xF0, 0x03, 0xF0, 0x01, 0x02, 0xF0, // 0x08
+        0xF0, 0xF0, 0xF0, 0x07, 0xF0, 0xF0, 0x00, 0xF0, // 0x10
+        0xF0, 0x05, 0x06, 0xF0, 0x04, 0xF0, 0xF0, 0xF0, // 0x18
+        0xF0, 0xF0, 0xF0, 0x0B, 0xF0, 0x09, 0x0A, 0xF0, // 0x20
+        0xF0, 0x0F, 0xF0, 0xF0, 0x08, 0xF0, 0xF0, 0xF0, // 0x28
+        0xF0, 0x0D, 0x0E, 0xF0, 0x0C, 0xF0, 0xF0, 0xF0, // 0x30
+        0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, // 0x38
+};
+
+// Reader of the 12 bit "3of6" code words of a bit row, loads whole bytes into an accumulator
+typedef struct {
+    uint8_t const *next; // next byte to load
+    uint32_t acc;        // loaded bits, only the low "bits" are valid
+    unsigned bits;
+} m_bus_3of6_reader_t;
+
+static void m_bus_3of6_init(m_bus_3of6_reader_t *r, uint8_t const *bits, unsigned bit_offset)
 {
-    uint8_t out = 0xF0; // Error
-    //fprintf(stderr,"Decode %0d\n", byte);
-    switch(byte) {
-        case 22:    out = 0x00;  break;  // 0x16
-        case 13:    out = 0x01;  break;  // 0x0D
-        case 14:    out = 0x02;  break;  // 0x0E
-        case 11:    out = 0x03;  break;  // 0x0B
-        case 28:    out = 0x04;  break;  // 0x1C
-        case 25:    out = 0x05;  break;  // 0x19
-        case 26:    out = 0x06;  break;  // 0x1A
-        case 19:    out = 0x07;  break;  // 0x13
-        case 44:    out = 0x08;  break;  // 0x2C
-        case 37:    out = 0x09;  break;  // 0x25
-        case 38:    out = 0x0A;  break;  // 0x26
-        case 35:    out = 0x0B;  break;  // 0x23
-        case 52:    out = 0x0C;  break;  // 0x34
-        case 49:    out = 0x0D;  break;  // 0x31
-        case 50:    out = 0x0E;  break;  // 0x32
-        case 41:    out = 0x0F;  break;  // 0x29
-        default:    break;  // Error
-    }
-    return out;
+    r->next = bits + bit_offset / 8;
+    r->acc  = *r->next++;
+    r->bits = 8 - bit_offset % 8;
 }
 
 // Decode input 6 bit nibbles to output 4 bit nibbles (packed in bytes). "3of6" coding used for Mode T
 // Bad data must be handled with second layer CRC
-static int m_bus_decode_3of6_buffer(uint8_t const *bits, unsigned bit_offset, uint8_t* output, unsigned num_bytes)
+static int m_bus_3of6_read(m_bus_3of6_reader_t *r, uint8_t *output, unsigned num_bytes)
 {
     int successful_contiguous_bytes = -1;
-    for (unsigned n=0; n<num_bytes; ++n) {
-        uint8_t nibble_h = m_bus_decode_3of6(bitrow_get_byte(bits, n*12+bit_offset) >> 2);
-        uint8_t nibble_l = m_bus_decode_3of6(bitrow_get_byte(bits, n*12+bit_offset+6) >> 2);
+    for (unsigned n = 0; n < num_bytes; ++n) {
+        while (r->bits < 12) {
+            r->acc = r->acc << 8 | *r->next++;
+            r->bits += 8;
+        }
+        r->bits -= 12;
+        unsigned word   = (r->acc >> r->bits) & 0xFFF;
+        uint8_t nibble_h = m_bus_3of6_table[word >> 6];
+        uint8_t nibble_l = m_bus_3of6_table[word & 0x3F];
         if (nibble_h > 0xf || nibble_l > 0xf) {
-            // return -1;  // fail at first 3of6 decoding error
             nibble_l &= 0x0F;  // assume logical 0 nibble if 3of6 decoding error, let CRC fail decoding if necessary
             if (successful_contiguous_bytes < 0) successful_contiguous_bytes = n;  // return count found until the first error
         }
-        output[n] = (nibble_h << 4) | nibble_l;
+        output[n] = (uint8_t)((nibble_h << 4) | nibble_l);
     }
     if (successful_contiguous_bytes < 0) successful_contiguous_bytes = num_bytes;  // if all data decoded successfully
     return successful_contiguous_bytes;
@@ -96,6 +116,117 @@ static void m_bus_manuf_decode(uint16_t m_field, char *three_letter_code)
     three_letter_code[3] = 0;
 }
 
+// AES keys of the meters, hashed by manufacturer and ID
+typedef struct {
+    uint32_t        id;
+    uint16_t        m_field;
+    uint8_t         used;
+    aes128_key_t    key;
+} m_bus_key_t;
+
+typedef struct {
+    unsigned        mask;       // Number of slots - 1, a power of two
+    m_bus_key_t     slots[];    // Open addressing with linear probing, at most half used
+} m_bus_keys_t;
+
+static unsigned m_bus_key_hash(uint16_t m_field, uint32_t id)
+{
+    uint32_t h = (id ^ (uint32_t)m_field << 16) * 0x9E3779B1u;
+    return h ^ h >> 16;
+}
+
+static aes128_key_t const *m_bus_key_find(m_bus_keys_t const *keys, uint16_t m_field, uint32_t id)
+{
+    for (unsigned i = m_bus_key_hash(m_field, id); ; ++i) {
+        m_bus_key_t const *slot = &keys->slots[i & keys->mask];
+        if (!slot->used)
+            return NULL;
+        if (slot->m_field == m_field && slot->id == id)
+            return &slot->key;
+    }
+}
+
+// Parse a key file line, returns 1 for a key, 0 for a blank or comment line, -1 on error
+static int m_bus_key_parse(char const *line, uint16_t *m_field, uint32_t *id, uint8_t *key)
+{
+    char m_str[4];
+    char key_str[33];
+    char tail[2];
+    unsigned a_id;
+
+    while (*line == ' ' || *line == '\t')
+        line++;
+    if (!*line || *line == '#' || *line == '\r' || *line == '\n')
+        return 0;
+    if (sscanf(line, "%3s %u %32s %1s", m_str, &a_id, key_str, tail) != 3 || strlen(key_str) != 32)
+        return -1;
+    *m_field = 0;
+    for (unsigned i = 0; i < 3; ++i) {
+        if (m_str[i] < 'A' || m_str[i] > 'Z')
+            return -1;
+        *m_field = (uint16_t)(*m_field << 5 | (m_str[i] - 0x40));
+    }
+    *id = a_id;
+    for (unsigned i = 0; i < 16; ++i) {
+        unsigned v;
+        if (sscanf(&key_str[2 * i], "%2x", &v) != 1)
+            return -1;
+        key[i] = (uint8_t)v;
+    }
+    return 1;
+}
+
+// Load a key file into the context of a new decoder, exits on errors
+static r_device *m_bus_keys_load(r_device const *dev_template, char const *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "M-Bus: failed to open key file \"%s\"\n", path);
+        exit(1);
+    }
+
+    char line[256];
+    uint16_t m_field;
+    uint32_t id;
+    uint8_t key[16];
+    unsigned count = 0;
+    for (unsigned n = 1; fgets(line, sizeof(line), fp); ++n) {
+        int ret = m_bus_key_parse(line, &m_field, &id, key);
+        if (ret < 0) {
+            fprintf(stderr, "M-Bus: bad key in \"%s\" line %u, use \"<manufacturer> <id> <32 hex digits>\"\n", path, n);
+            exit(1);
+        }
+        count += ret;
+    }
+
+    unsigned size = 16;
+    while (size < 2 * count)
+        size *= 2;
+    r_device *r_dev = decoder_create(dev_template, sizeof(m_bus_keys_t) + size * sizeof(m_bus_key_t));
+    if (!r_dev) {
+        fclose(fp);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    m_bus_keys_t *keys = decoder_user_data(r_dev);
+    keys->mask = size - 1;
+
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp)) {
+        if (m_bus_key_parse(line, &m_field, &id, key) < 1)
+            continue;
+        unsigned i = m_bus_key_hash(m_field, id);
+        m_bus_key_t *slot = &keys->slots[i & keys->mask];
+        while (slot->used && (slot->m_field != m_field || slot->id != id))
+            slot = &keys->slots[++i & keys->mask];
+        slot->used    = 1;
+        slot->m_field = m_field;
+        slot->id      = id;
+        aes128_set_key(&slot->key, key, 1); // a repeated meter takes the last key
+    }
+    fclose(fp);
+    return r_dev;
+}
+
 // Decode device type string
 static char const *m_bus_device_type_str(uint8_t devType)
 {
@@ -695,6 +826,12 @@ static void parse_payload(data_t *data, const m_bus_block1_t *block1, const m_bu
         dife_cnt = 0;
         vife_cnt = 0;
 
+        /* Skip idle filler, e.g. the padding of an encrypted payload */
+        if (b[off] == 0x2F) {
+            off++;
+            continue;
+        }
+
         /* Parse DIF */
         dif = b[off];
         dif_sn = (dif&0x40) >> 6;
@@ -765,7 +902,9 @@ static int parse_block2(const m_bus_data_t *in, m_bus_block1_t *block1)
     return 0;
 }
 
-static int m_bus_decode_format_a(r_device *decoder, const m_bus_data_t *in, m_bus_data_t *out, m_bus_block1_t *block1)
+// Decode format A, the CRC of each block is validated unless already done while decoding the blocks
+// Returns 1 on success, DECODE_ABORT_LENGTH if the package is not complete, DECODE_FAIL_MIC or DECODE_FAIL_SANITY otherwise
+static int m_bus_parse_format_a(r_device *decoder, const m_bus_data_t *in, m_bus_data_t *out, m_bus_block1_t *block1, int check_crc)
 {
 
     // Get Block 1
@@ -787,14 +926,18 @@ static int m_bus_decode_format_a(r_device *decoder, const m_bus_data_t *in, m_bu
     out->length      = block1->L-9 + BLOCK1A_SIZE-2;
 
     // Validate CRC
-    if (!m_bus_crc_valid(decoder, in->data, 10)) return 0;
+    if (check_crc && !m_bus_crc_valid(decoder, in->data, 10)) return DECODE_FAIL_MIC;
 
     // Check length of package is sufficient
+    if (block1->L < 9) {
+        decoder_logf(decoder, 1, __func__, "M-Bus: Invalid packet Length: %u", block1->L);
+        return DECODE_FAIL_SANITY;
+    }
     unsigned num_data_blocks = (block1->L-9+15)/16;      // Data blocks are 16 bytes long + 2 CRC bytes (not counted in L)
-    if ((block1->L < 9) || ((block1->L-9)+num_data_blocks*2 > in->length-BLOCK1A_SIZE)) {   // add CRC bytes for each data block
+    if ((block1->L-9)+num_data_blocks*2 > in->length-BLOCK1A_SIZE) {   // add CRC bytes for each data block
         decoder_logf(decoder, 1, __func__, "M-Bus: Package (%u) too short for packet Length: %u", in->length, block1->L);
         decoder_logf(decoder, 1, __func__, "M-Bus: %u > %u", (block1->L-9)+num_data_blocks*2, in->length-BLOCK1A_SIZE);
-        return 0;
+        return DECODE_ABORT_LENGTH;
     }
 
     memcpy(out->data, in->data, BLOCK1A_SIZE-2);
@@ -805,7 +948,7 @@ static int m_bus_decode_format_a(r_device *decoder, const m_bus_data_t *in, m_bu
         uint8_t block_size      = MIN(block1->L-9-n*16, 16)+2;      // Maximum block size is 16 Data + 2 CRC
 
         // Validate CRC
-        if (!m_bus_crc_valid(decoder, in_ptr, block_size-2)) return 0;
+        if (check_crc && !m_bus_crc_valid(decoder, in_ptr, block_size-2)) return DECODE_FAIL_MIC;
 
         // Get block data
         memcpy(out_ptr, in_ptr, block_size);
@@ -816,6 +959,41 @@ static int m_bus_decode_format_a(r_device *decoder, const m_bus_data_t *in, m_bu
     return 1;
 }
 
+static int m_bus_decode_format_a(r_device *decoder, const m_bus_data_t *in, m_bus_data_t *out, m_bus_block1_t *block1)
+{
+    return m_bus_parse_format_a(decoder, in, out, block1, 1);
+}
+
+// Decode a "3of6" coded format A telegram (Mode T) a block at a time, stops at the first block with a bad CRC
+// Returns 1 if the blocks received are valid, DECODE_ABORT_LENGTH without a whole Block 1, DECODE_FAIL_MIC otherwise
+static int m_bus_decode_3of6_format_a(r_device *decoder, uint8_t const *bits, unsigned bit_offset, unsigned num_bytes, m_bus_data_t *out)
+{
+    m_bus_3of6_reader_t reader;
+    m_bus_3of6_init(&reader, bits, bit_offset);
+
+    // Block 1
+    if (num_bytes < BLOCK1A_SIZE) {
+        decoder_logf(decoder, 1, __func__, "M-Bus: Package (%u) too short for Block 1", num_bytes);
+        return DECODE_ABORT_LENGTH;
+    }
+    m_bus_3of6_read(&reader, out->data, BLOCK1A_SIZE);
+    if (!m_bus_crc_valid(decoder, out->data, 10)) return DECODE_FAIL_MIC;
+    out->length = BLOCK1A_SIZE;
+
+    // Data blocks of 16 bytes + 2 CRC bytes (not counted in L), a short package is left to the format A check
+    unsigned L = out->data[0];
+    for (unsigned n = 0; L > 9 + n * 16; ++n) {
+        unsigned block_size = MIN(L - 9 - n * 16, 16) + 2;
+        if (out->length + block_size > num_bytes)
+            break;
+        m_bus_3of6_read(&reader, out->data + out->length, block_size);
+        if (!m_bus_crc_valid(decoder, out->data + out->length, block_size - 2)) return DECODE_FAIL_MIC;
+        out->length += block_size;
+    }
+    return 1;
+}
+
+// Decode format B, returns 1 on success, DECODE_ABORT_LENGTH if the package is not complete, DECODE_FAIL_MIC or DECODE_FAIL_SANITY otherwise
 static int m_bus_decode_format_b(r_device *decoder, const m_bus_data_t *in, m_bus_data_t *out, m_bus_block1_t *block1)
 {
     // Get Block 1
@@ -830,13 +1008,17 @@ static int m_bus_decode_format_b(r_device *decoder, const m_bus_data_t *in, m_bu
     out->length      = block1->L-(9+2) + BLOCK1B_SIZE-2;
 
     // Check length of package is sufficient
-    if ((block1->L < 12) || (block1->L+1 > (int)in->length)) {   // L includes all bytes except itself
+    if (block1->L < 12) {
+        decoder_logf(decoder, 1, __func__, "M-Bus: Invalid packet Length: %u", block1->L);
+        return DECODE_FAIL_SANITY;
+    }
+    if (block1->L+1 > (int)in->length) {   // L includes all bytes except itself
         decoder_logf(decoder, 1, __func__, "M-Bus: Package too short for Length: %u", block1->L);
-        return 0;
+        return DECODE_ABORT_LENGTH;
     }
 
     // Validate CRC
-    if (!m_bus_crc_valid(decoder, in->data, MIN(block1->L-1, (BLOCK1B_SIZE+BLOCK2B_SIZE)-2))) return 0;
+    if (!m_bus_crc_valid(decoder, in->data, MIN(block1->L-1, (BLOCK1B_SIZE+BLOCK2B_SIZE)-2))) return DECODE_FAIL_MIC;
 
     // Get data from Block 2
     memcpy(out->data, in->data, (MIN(block1->L-11, BLOCK2B_SIZE-2))+BLOCK1B_SIZE);
@@ -845,7 +1027,7 @@ static int m_bus_decode_format_b(r_device *decoder, const m_bus_data_t *in, m_bu
     uint8_t L_OFFSET = BLOCK1B_SIZE+BLOCK2B_SIZE-1;     // How much to subtract from L (127)
     if (block1->L > (L_OFFSET+2)) {        // Any more data? (besided 2 extra CRC)
         // Validate CRC
-        if (!m_bus_crc_valid(decoder, in->data+BLOCK1B_SIZE+BLOCK2B_SIZE, block1->L-L_OFFSET-2)) return 0;
+        if (!m_bus_crc_valid(decoder, in->data+BLOCK1B_SIZE+BLOCK2B_SIZE, block1->L-L_OFFSET-2)) return DECODE_FAIL_MIC;
 
         // Get Block 3
         memcpy(out->data+(BLOCK2B_SIZE-2), in->data+BLOCK2B_SIZE, block1->L-L_OFFSET-2);
@@ -855,6 +1037,36 @@ static int m_bus_decode_format_b(r_device *decoder, const m_bus_data_t *in, m_bu
     return 1;
 }
 
+// Decrypt a security mode 5 (AES-128-CBC) payload, the IV is M and A of Block 1 and 8 times the access number
+// Returns 1 if decrypted, 0 if the key is unknown or wrong
+static int m_bus_decrypt_mode5(r_device *decoder, const m_bus_data_t *in, const m_bus_block1_t *block1, m_bus_data_t *out)
+{
+    m_bus_keys_t const *keys = decoder_user_data(decoder);
+    if (!keys)
+        return 0;
+    aes128_key_t const *key = m_bus_key_find(keys, (uint16_t)(in->data[3] << 8 | in->data[2]), block1->A_ID);
+    if (!key)
+        return 0;
+
+    unsigned offset = block1->block2.pl_offset;
+    unsigned length = (block1->block2.CW >> 4 & 0x0F) * AES_BLOCK_SIZE;   // Number of encrypted blocks
+    if (!length || offset + length > in->length)
+        return 0;
+
+    uint8_t iv[AES_BLOCK_SIZE];
+    memcpy(iv, &in->data[2], 8);
+    memset(&iv[8], block1->block2.AC, 8);
+    *out = *in;
+    aes128_cbc_decrypt(key, iv, &in->data[offset], &out->data[offset], length);
+
+    // The decrypted payload starts with 2 0x2F bytes
+    if (out->data[offset] != 0x2F || out->data[offset + 1] != 0x2F) {
+        decoder_logf(decoder, 1, __func__, "M-Bus: Wrong key for %s %u", block1->M_str, block1->A_ID);
+        return 0;
+    }
+    return 1;
+}
+
 static int m_bus_output_data(r_device *decoder, bitbuffer_t *bitbuffer, const m_bus_data_t *out, const m_bus_block1_t *block1, char const *mode)
 {
     (void)bitbuffer; // note: to match the common decoder function signature
@@ -912,10 +1124,13 @@ static int m_bus_output_data(r_device *decoder, bitbuffer_t *bitbuffer, const m_
         data = data_int(data, "CW",     "Configuration Word",   "0x%04X",   block1->block2.CW);
         /* clang-format on */
     }
-    /* Encryption not supported */
+    m_bus_data_t plain;
     if (!(block1->block2.CW&0x0500)) {
         parse_payload(data, block1, out);
+    } else if ((block1->block2.CW >> 8 & 0x1F) == 5 && m_bus_decrypt_mode5(decoder, out, block1, &plain)) {
+        parse_payload(data, block1, &plain);
     } else {
+        /* Unknown key or encryption mode not supported */
         /* clang-format off */
         data = data_int(data, "payload_encrypted", "Payload Encrypted", NULL, 1);
         /* clang-format on */
@@ -967,8 +1182,9 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
             data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/8;
             bitbuffer_extract_bytes(bitbuffer, 0, bit_offset, data_in.data, data_in.length*8);
             // Decode
-            if (!m_bus_decode_format_a(decoder, &data_in, &data_out, &block1))
-                return DECODE_FAIL_SANITY;
+            int ret = m_bus_decode_format_a(decoder, &data_in, &data_out, &block1);
+            if (ret <= 0)
+                return ret;
         } // Format A
         // Format B
         else if (next_byte == 0x3D) {
@@ -977,8 +1193,9 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
             data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/8;
             bitbuffer_extract_bytes(bitbuffer, 0, bit_offset, data_in.data, data_in.length*8);
             // Decode
-            if (!m_bus_decode_format_b(decoder, &data_in, &data_out, &block1))
-                return DECODE_FAIL_SANITY;
+            int ret = m_bus_decode_format_b(decoder, &data_in, &data_out, &block1);
+            if (ret <= 0)
+                return ret;
         } // Format B
         // Unknown Format
         else {
@@ -994,17 +1211,20 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         decoder_log(decoder, 1, __func__, "Experimental - Not tested");
         // Extract data
 
-        data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/12;    // Each byte is encoded into 12 bits
+        unsigned num_bytes = (bitbuffer->bits_per_row[0]-bit_offset)/12;    // Each byte is encoded into 12 bits
 
-        decoder_logf(decoder, 1, __func__, "MBus telegram length: %u", data_in.length);
-        if (m_bus_decode_3of6_buffer(bitbuffer->bb[0], bit_offset, data_in.data, data_in.length) < 0) {
+        decoder_logf(decoder, 1, __func__, "MBus telegram length: %u", num_bytes);
+        // Decode the blocks as far as the CRCs are valid
+        int ret = m_bus_decode_3of6_format_a(decoder, bitbuffer->bb[0], bit_offset, MIN(num_bytes, sizeof(data_in.data)), &data_in);
+        if (ret <= 0) {
             decoder_log(decoder, 1, __func__, "M-Bus: Decoding error");
-            return DECODE_FAIL_SANITY;
+            return ret;
         }
         // Decode
-        if (!m_bus_decode_format_a(decoder, &data_in, &data_out, &block1)) {
+        ret = m_bus_parse_format_a(decoder, &data_in, &data_out, &block1, 0);
+        if (ret <= 0) {
             decoder_log_bitrow(decoder, 1, __func__, data_in.data, data_in.length, "MBus telegram unknown format");
-            return DECODE_FAIL_SANITY;
+            return ret;
         }
     }   // Mode T
 
@@ -1042,7 +1262,9 @@ static int m_bus_mode_r_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/8;
     bitbuffer_extract_bytes(bitbuffer, 0, bit_offset, data_in.data, data_in.length*8);
     // Decode
-    if (!m_bus_decode_format_a(decoder, &data_in, &data_out, &block1))    return 0;
+    int ret = m_bus_decode_format_a(decoder, &data_in, &data_out, &block1);
+    if (ret <= 0)
+        return ret;
 
     m_bus_output_data(decoder, bitbuffer, &data_out, &block1, "R");
     return 1;
@@ -1137,7 +1359,9 @@ static int m_bus_mode_s_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     data_in.length = (bitbuffer->bits_per_row[0]);
     bitbuffer_extract_bytes(&packet_bits, 0, 0, data_in.data, data_in.length);
 
-    if (!m_bus_decode_format_a(decoder, &data_in, &data_out, &block1))    return 0;
+    int ret = m_bus_decode_format_a(decoder, &data_in, &data_out, &block1);
+    if (ret <= 0)
+        return ret;
 
     m_bus_output_data(decoder, bitbuffer, &data_out, &block1, "S");
 
@@ -1189,6 +1413,52 @@ static char const *const output_fields[] = {
         NULL,
 };
 
+static r_device *m_bus_create(r_device const *dev_template, char *arg)
+{
+    char const *path = NULL;
+    char *key, *val;
+    while (getkwargs(&arg, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcmp(key, "keys") && val && *val)
+            path = val;
+        else {
+            fprintf(stderr, "M-Bus: unknown option \"%s\", use \"keys=<file>\"\n", key);
+            exit(1);
+        }
+    }
+    if (path)
+        return m_bus_keys_load(dev_template, path); // NOTE: returns NULL on alloc failure.
+    return decoder_create(dev_template, 0); // NOTE: returns NULL on alloc failure.
+}
+
+r_device const m_bus_mode_c_t;
+r_device const m_bus_mode_c_t_downlink;
+r_device const m_bus_mode_s;
+r_device const m_bus_mode_r;
+
+static r_device *m_bus_mode_c_t_create(char *arg)
+{
+    return m_bus_create(&m_bus_mode_c_t, arg);
+}
+
+static r_device *m_bus_mode_c_t_downlink_create(char *arg)
+{
+    return m_bus_create(&m_bus_mode_c_t_downlink, arg);
+}
+
+static r_device *m_bus_mode_s_create(char *arg)
+{
+    return m_bus_create(&m_bus_mode_s, arg);
+}
+
+static r_device *m_bus_mode_r_create(char *arg)
+{
+    return m_bus_create(&m_bus_mode_r, arg);
+}
+
 // Mode C1, C2 (Meter TX), T1, T2 (Meter TX),
 // Frequency 868.95 MHz, Bitrate 100 kbps (uplink), Modulation NRZ FSK
 r_device const m_bus_mode_c_t = {
@@ -1198,7 +1468,9 @@ r_device const m_bus_mode_c_t = {
         .long_width  = 10,  // NRZ encoding (bit width = pulse width)
         .reset_limit = 500, //
         .decode_fn   = &m_bus_mode_c_t_callback,
+        .create_fn   = &m_bus_mode_c_t_create,
         .fields      = output_fields,
+        .stream_pulses = 128, // Decode as soon as the telegram per its L field is complete
 };
 
 // Mode T communication in downlink direction at 32.768 kbps
@@ -1209,7 +1481,9 @@ r_device const m_bus_mode_c_t_downlink = {
         .long_width  = (1000.0 / 32.768),
         .reset_limit = ((1000.0 / 32.768) * 9), // 9 bit periods
         .decode_fn   = &m_bus_mode_c_t_callback,
+        .create_fn   = &m_bus_mode_c_t_downlink_create,
         .fields      = output_fields,
+        .stream_pulses = 128, // Decode as soon as the telegram per its L field is complete
 };
 
 // Mode S1, S1-m, S2, T2 (Meter RX),    (Meter RX not so interesting)
@@ -1221,7 +1495,9 @@ r_device const m_bus_mode_s = {
         .long_width  = (1000.0 / 32.768),
         .reset_limit = ((1000.0 / 32.768) * 9), // 9 bit periods
         .decode_fn   = &m_bus_mode_s_callback,
+        .create_fn   = &m_bus_mode_s_create,
         .fields      = output_fields,
+        .stream_pulses = 128, // Decode as soon as the telegram per its L field is complete
 };
 
 // Mode C2 (Meter RX)
@@ -1239,6 +1515,8 @@ r_device const m_bus_mode_r = {
         .long_width  = 0,                       // Unused
         .reset_limit = (1000.0f / 4.8f * 1.5f), // 3 clock half periods
         .decode_fn   = &m_bus_mode_r_callback,
+        .create_fn   = &m_bus_mode_r_create,
+        .stream_pulses = 128, // Decode as soon as the telegram per its L field is complete
         .disabled    = 1, // Disable per default, as it runs on non-standard frequency
 };
 
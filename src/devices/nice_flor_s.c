@@ -87,6 +87,8 @@ r_device const nice_flor_s = {
         .gap_limit   = 2000,
         .reset_limit = 5000,
         .tolerance   = 100,
+        .max_rows    = 2,
+        .row_bits    = {52, 72},
         .decode_fn   = &nice_flor_s_decode,
         .disabled    = 1,
         .fields      = output_fields,
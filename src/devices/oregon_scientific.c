@@ -244,7 +244,10 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
     int battery_low = (msg[3] >> 2) & 0x01;
 
     decoder_logf(decoder, 1, __func__,"Found sensor type (%08x)", sensor_id);
-    if ((sensor_id == ID_THGR122N) || (sensor_id == ID_THGR968)) {
+    // Dispatch on the sensor ID, the switch is a table lookup instead of a compare for each model
+    switch (sensor_id) {
+    case ID_THGR122N:
+    case ID_THGR968: {
         if (validate_os_v2_message(decoder, msg, 76, msg_bits, 15) != 0)
             return 0;
         /* clang-format off */
@@ -260,7 +263,7 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_WGR968) {
+    case ID_WGR968: {
         if (validate_os_v2_message(decoder, msg, 94, msg_bits, 17) != 0)
             return 0;
         float quadrant      = (msg[4] & 0x0f) * 10 + ((msg[4] >> 4) & 0x0f) * 1 + ((msg[5] >> 4) & 0x0f) * 100;
@@ -280,7 +283,7 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_BHTR968) {
+    case ID_BHTR968: {
         if (validate_os_v2_message(decoder, msg, 92, msg_bits, 19) != 0)
             return 0;
         //unsigned int comfort = msg[7] >> 4;
@@ -311,7 +314,7 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_BTHR918) {
+    case ID_BTHR918: {
         // Similar to the BHTR968, but smaller message and slightly different pressure offset
         if (validate_os_v2_message(decoder, msg, 84, msg_bits, 19) != 0)
             return 0;
@@ -331,7 +334,7 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_RGR968) {
+    case ID_RGR968: {
         if (validate_os_v2_message(decoder, msg, 80, msg_bits, 16) != 0)
             return 0;
         float rain_rate  = ((msg[4] & 0x0f) * 100 + (msg[4] >> 4) * 10 + ((msg[5] >> 4) & 0x0f)) / 10.0F;
@@ -349,73 +352,160 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if ((sensor_id == ID_THR228N || sensor_id == ID_AWR129) && msg_bits == 76) {
-        if (validate_os_v2_message(decoder, msg, 76, msg_bits, 12) != 0)
-            return 0;
-        float temp_c = get_os_temperature(msg);
-        /* clang-format off */
-        data = data_make(
-                "model", "", DATA_COND, sensor_id == ID_THR228N, DATA_STRING, "Oregon-THR228N",
-                "model", "", DATA_COND, sensor_id == ID_AWR129, DATA_STRING, "Oregon-AWR129",
-                "id",                        "House Code",    DATA_INT,        device_id,
-                "channel",             "Channel",         DATA_INT,        channel,
-                "battery_ok",          "Battery",         DATA_INT,    !battery_low,
-                "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
-                NULL);
-        /* clang-format on */
-        decoder_output_data(decoder, data);
-        return 1;
-    }
-    else if (sensor_id == ID_THN132N && msg_bits == 64) {
-        if (validate_os_v2_message(decoder, msg, 64, msg_bits, 12) != 0)
-            return 0;
-        // Sanity check BCD digits
-        if (((msg[5] >> 4) & 0x0F) > 9 || (msg[4] & 0x0F) > 9 || ((msg[4] >> 4) & 0x0F) > 9) {
-            decoder_log(decoder, 1, __func__, "THN132N Message failed BCD sanity check.");
-            return DECODE_FAIL_SANITY;
+    case ID_THR228N: // same as ID_THN132N
+    case ID_AWR129:
+        if (msg_bits == 76) {
+            if (validate_os_v2_message(decoder, msg, 76, msg_bits, 12) != 0)
+                return 0;
+            float temp_c = get_os_temperature(msg);
+            /* clang-format off */
+            data = data_make(
+                    "model", "", DATA_COND, sensor_id == ID_THR228N, DATA_STRING, "Oregon-THR228N",
+                    "model", "", DATA_COND, sensor_id == ID_AWR129, DATA_STRING, "Oregon-AWR129",
+                    "id",                        "House Code",    DATA_INT,        device_id,
+                    "channel",             "Channel",         DATA_INT,        channel,
+                    "battery_ok",          "Battery",         DATA_INT,    !battery_low,
+                    "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
+                    NULL);
+            /* clang-format on */
+            decoder_output_data(decoder, data);
+            return 1;
         }
-        float temp_c = get_os_temperature(msg);
-        // Sanity check value
-        if (temp_c > 70 || temp_c < -50) {
-            decoder_logf(decoder, 1, __func__, "THN132N Message failed values sanity check: temperature_C %.1fC.", temp_c);
-            return DECODE_FAIL_SANITY;
+        if (sensor_id == ID_THN132N && msg_bits == 64) {
+            if (validate_os_v2_message(decoder, msg, 64, msg_bits, 12) != 0)
+                return 0;
+            // Sanity check BCD digits
+            if (((msg[5] >> 4) & 0x0F) > 9 || (msg[4] & 0x0F) > 9 || ((msg[4] >> 4) & 0x0F) > 9) {
+                decoder_log(decoder, 1, __func__, "THN132N Message failed BCD sanity check.");
+                return DECODE_FAIL_SANITY;
+            }
+            float temp_c = get_os_temperature(msg);
+            // Sanity check value
+            if (temp_c > 70 || temp_c < -50) {
+                decoder_logf(decoder, 1, __func__, "THN132N Message failed values sanity check: temperature_C %.1fC.", temp_c);
+                return DECODE_FAIL_SANITY;
+            }
+
+            /* clang-format off */
+            data = data_make(
+                    "model",                 "",                        DATA_STRING, "Oregon-THN132N",
+                    "id",                        "House Code",    DATA_INT,        device_id,
+                    "channel",             "Channel",         DATA_INT,        channel,
+                    "battery_ok",          "Battery",         DATA_INT,    !battery_low,
+                    "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
+                    NULL);
+            /* clang-format on */
+            decoder_output_data(decoder, data);
+            return 1;
+        }
+        break;
+    case ID_RTGR328N_1:
+    case ID_RTGR328N_2:
+    case ID_RTGR328N_3:
+    case ID_RTGR328N_4:
+    case ID_RTGR328N_5:
+        if (msg_bits == 173) {
+            if (validate_os_v2_message(decoder, msg, 173, msg_bits, 15) != 0)
+                 return 0;
+            /* clang-format off */
+            data = data_make(
+                    "model",            "",             DATA_STRING, "Oregon-RTGR328N",
+                    "id",               "House Code",   DATA_INT,    device_id,
+                    "channel",          "Channel",      DATA_INT,    channel, // 1 to 5
+                    "battery_ok",          "Battery",         DATA_INT,    !battery_low,
+                    "temperature_C",    "Temperature",  DATA_FORMAT, "%.2f C", DATA_DOUBLE, get_os_temperature(msg),
+                    "humidity",         "Humidity",     DATA_FORMAT, "%u %%",   DATA_INT,    get_os_humidity(msg),
+                    NULL);
+            /* clang-format on */
+            decoder_output_data(decoder, data);
+            return 1;
         }
+        break;
+    case ID_RTGR328N_6:
+    case ID_RTGR328N_7: {
+        if (validate_os_v2_message(decoder, msg, 100, msg_bits, 21) != 0)
+            return 0;
+
+        int year    = ((msg[9] & 0x0F) * 10) + ((msg[9] & 0xF0) >> 4) + 2000;
+        int month   = ((msg[8] & 0xF0) >> 4);
+        //int weekday = ((msg[8] & 0x0F));
+        int day     = ((msg[7] & 0x0F) * 10) + ((msg[7] & 0xF0) >> 4);
+        int hours   = ((msg[6] & 0x0F) * 10) + ((msg[6] & 0xF0) >> 4);
+        int minutes = ((msg[5] & 0x0F) * 10) + ((msg[5] & 0xF0) >> 4);
+        int seconds = ((msg[4] & 0x0F) * 10) + ((msg[4] & 0xF0) >> 4);
+
+        char clock_str[24];
+        snprintf(clock_str, sizeof(clock_str), "%04d-%02d-%02dT%02d:%02d:%02d",
+                year, month, day, hours, minutes, seconds);
 
         /* clang-format off */
         data = data_make(
-                "model",                 "",                        DATA_STRING, "Oregon-THN132N",
-                "id",                        "House Code",    DATA_INT,        device_id,
-                "channel",             "Channel",         DATA_INT,        channel,
+                "model",            "",             DATA_STRING, "Oregon-RTGR328N",
+                "id",               "House Code",   DATA_INT,    device_id,
+                "channel",          "Channel",      DATA_INT,    channel, // 1 to 5
                 "battery_ok",          "Battery",         DATA_INT,    !battery_low,
-                "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
+                "radio_clock",      "Radio Clock",  DATA_STRING, clock_str,
                 NULL);
         /* clang-format on */
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if ((sensor_id & 0x0fff) == ID_RTGN129 && msg_bits == 80) {
-        if (validate_os_v2_message(decoder, msg, 80, msg_bits, 15) != 0)
+    case ID_BTHGN129: {
+        if (validate_os_v2_message(decoder, msg, 92, msg_bits, 19) != 0)
             return 0;
         float temp_c = get_os_temperature(msg);
+        // Pressure is given in hPa. You may need to adjust the offset
+        // according to your altitude level (600 is a good starting point)
+        float pressure = ((msg[7] & 0x0f) | (msg[8] & 0xf0)) * 2 + (msg[8] & 0x01) + 600;
         /* clang-format off */
         data = data_make(
-                "model",                 "",                        DATA_STRING, "Oregon-RTGN129",
+                "model",                 "",                        DATA_STRING, "Oregon-BTHGN129",
                 "id",                        "House Code",    DATA_INT,        device_id,
                 "channel",             "Channel",         DATA_INT,        channel, // 1 to 5
                 "battery_ok",          "Battery",         DATA_INT,    !battery_low,
                 "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
-                "humidity",            "Humidity",        DATA_FORMAT, "%u %%",     DATA_INT,        get_os_humidity(msg),
+                "humidity",             "Humidity",     DATA_FORMAT, "%u %%", DATA_INT, get_os_humidity(msg),
+                "pressure_hPa",    "Pressure",        DATA_FORMAT, "%.2f hPa", DATA_DOUBLE, pressure,
                 NULL);
         /* clang-format on */
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (((sensor_id == ID_RTGR328N_1) || (sensor_id == ID_RTGR328N_2) || (sensor_id == ID_RTGR328N_3) || (sensor_id == ID_RTGR328N_4) || (sensor_id == ID_RTGR328N_5)) && msg_bits == 173) {
+    case ID_UVR128:
+        if (msg_bits == 148) {
+            if (validate_os_v2_message(decoder, msg, 148, msg_bits, 12) != 0)
+                return 0;
+            // Sanity check BCD digits
+            if (((msg[4] >> 4) & 0x0F) > 9 || (msg[4] & 0x0F) > 9) {
+                decoder_log(decoder, 1, __func__, "UVR128 Message failed BCD sanity check.");
+                return DECODE_FAIL_SANITY;
+            }
+            int uvidx = get_os_uv(msg);
+            // Sanity check value
+            if (uvidx < 0 || uvidx > 25) {
+                decoder_logf(decoder, 1, __func__, "UVR128 Message failed values sanity check: uv %u.", uvidx);
+                return DECODE_FAIL_SANITY;
+            }
+
+            /* clang-format off */
+            data = data_make(
+                    "model",                    "",                     DATA_STRING, "Oregon-UVR128",
+                    "id",                         "House Code", DATA_INT,        device_id,
+                    "uv",                         "UV Index",     DATA_FORMAT, "%u", DATA_INT, uvidx,
+                    "battery_ok",          "Battery",         DATA_INT,    !battery_low,
+                    //"channel",                "Channel",        DATA_INT,        channel,
+                    NULL);
+            /* clang-format on */
+            decoder_output_data(decoder, data);
+            return 1;
+        }
+        break;
+    case ID_THGR328N: {
         if (validate_os_v2_message(decoder, msg, 173, msg_bits, 15) != 0)
-             return 0;
+            return 0;
         /* clang-format off */
         data = data_make(
-                "model",            "",             DATA_STRING, "Oregon-RTGR328N",
+                "model",            "",             DATA_STRING, "Oregon-THGR328N",
                 "id",               "House Code",   DATA_INT,    device_id,
                 "channel",          "Channel",      DATA_INT,    channel, // 1 to 5
                 "battery_ok",          "Battery",         DATA_INT,    !battery_low,
@@ -426,29 +516,21 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if ((sensor_id == ID_RTGR328N_6) || (sensor_id == ID_RTGR328N_7)) {
-        if (validate_os_v2_message(decoder, msg, 100, msg_bits, 21) != 0)
-            return 0;
-
-        int year    = ((msg[9] & 0x0F) * 10) + ((msg[9] & 0xF0) >> 4) + 2000;
-        int month   = ((msg[8] & 0xF0) >> 4);
-        //int weekday = ((msg[8] & 0x0F));
-        int day     = ((msg[7] & 0x0F) * 10) + ((msg[7] & 0xF0) >> 4);
-        int hours   = ((msg[6] & 0x0F) * 10) + ((msg[6] & 0xF0) >> 4);
-        int minutes = ((msg[5] & 0x0F) * 10) + ((msg[5] & 0xF0) >> 4);
-        int seconds = ((msg[4] & 0x0F) * 10) + ((msg[4] & 0xF0) >> 4);
-
-        char clock_str[24];
-        snprintf(clock_str, sizeof(clock_str), "%04d-%02d-%02dT%02d:%02d:%02d",
-                year, month, day, hours, minutes, seconds);
+    }
 
+    // Models with a varying nibble in the ID, or an ID of a model above with another packet size
+    if ((sensor_id & 0x0fff) == ID_RTGN129 && msg_bits == 80) {
+        if (validate_os_v2_message(decoder, msg, 80, msg_bits, 15) != 0)
+            return 0;
+        float temp_c = get_os_temperature(msg);
         /* clang-format off */
         data = data_make(
-                "model",            "",             DATA_STRING, "Oregon-RTGR328N",
-                "id",               "House Code",   DATA_INT,    device_id,
-                "channel",          "Channel",      DATA_INT,    channel, // 1 to 5
+                "model",                 "",                        DATA_STRING, "Oregon-RTGN129",
+                "id",                        "House Code",    DATA_INT,        device_id,
+                "channel",             "Channel",         DATA_INT,        channel, // 1 to 5
                 "battery_ok",          "Battery",         DATA_INT,    !battery_low,
-                "radio_clock",      "Radio Clock",  DATA_STRING, clock_str,
+                "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
+                "humidity",            "Humidity",        DATA_FORMAT, "%u %%",     DATA_INT,        get_os_humidity(msg),
                 NULL);
         /* clang-format on */
         decoder_output_data(decoder, data);
@@ -495,70 +577,6 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
             return 0;
         }
     }
-    else if (sensor_id == ID_BTHGN129) {
-        if (validate_os_v2_message(decoder, msg, 92, msg_bits, 19) != 0)
-            return 0;
-        float temp_c = get_os_temperature(msg);
-        // Pressure is given in hPa. You may need to adjust the offset
-        // according to your altitude level (600 is a good starting point)
-        float pressure = ((msg[7] & 0x0f) | (msg[8] & 0xf0)) * 2 + (msg[8] & 0x01) + 600;
-        /* clang-format off */
-        data = data_make(
-                "model",                 "",                        DATA_STRING, "Oregon-BTHGN129",
-                "id",                        "House Code",    DATA_INT,        device_id,
-                "channel",             "Channel",         DATA_INT,        channel, // 1 to 5
-                "battery_ok",          "Battery",         DATA_INT,    !battery_low,
-                "temperature_C",    "Celsius",        DATA_FORMAT, "%.2f C", DATA_DOUBLE, temp_c,
-                "humidity",             "Humidity",     DATA_FORMAT, "%u %%", DATA_INT, get_os_humidity(msg),
-                "pressure_hPa",    "Pressure",        DATA_FORMAT, "%.2f hPa", DATA_DOUBLE, pressure,
-                NULL);
-        /* clang-format on */
-        decoder_output_data(decoder, data);
-        return 1;
-    }
-    else if (sensor_id == ID_UVR128 && msg_bits == 148) {
-        if (validate_os_v2_message(decoder, msg, 148, msg_bits, 12) != 0)
-            return 0;
-        // Sanity check BCD digits
-        if (((msg[4] >> 4) & 0x0F) > 9 || (msg[4] & 0x0F) > 9) {
-            decoder_log(decoder, 1, __func__, "UVR128 Message failed BCD sanity check.");
-            return DECODE_FAIL_SANITY;
-        }
-        int uvidx = get_os_uv(msg);
-        // Sanity check value
-        if (uvidx < 0 || uvidx > 25) {
-            decoder_logf(decoder, 1, __func__, "UVR128 Message failed values sanity check: uv %u.", uvidx);
-            return DECODE_FAIL_SANITY;
-        }
-
-        /* clang-format off */
-        data = data_make(
-                "model",                    "",                     DATA_STRING, "Oregon-UVR128",
-                "id",                         "House Code", DATA_INT,        device_id,
-                "uv",                         "UV Index",     DATA_FORMAT, "%u", DATA_INT, uvidx,
-                "battery_ok",          "Battery",         DATA_INT,    !battery_low,
-                //"channel",                "Channel",        DATA_INT,        channel,
-                NULL);
-        /* clang-format on */
-        decoder_output_data(decoder, data);
-        return 1;
-    }
-    else if (sensor_id == ID_THGR328N) {
-        if (validate_os_v2_message(decoder, msg, 173, msg_bits, 15) != 0)
-            return 0;
-        /* clang-format off */
-        data = data_make(
-                "model",            "",             DATA_STRING, "Oregon-THGR328N",
-                "id",               "House Code",   DATA_INT,    device_id,
-                "channel",          "Channel",      DATA_INT,    channel, // 1 to 5
-                "battery_ok",          "Battery",         DATA_INT,    !battery_low,
-                "temperature_C",    "Temperature",  DATA_FORMAT, "%.2f C", DATA_DOUBLE, get_os_temperature(msg),
-                "humidity",         "Humidity",     DATA_FORMAT, "%u %%",   DATA_INT,    get_os_humidity(msg),
-                NULL);
-        /* clang-format on */
-        decoder_output_data(decoder, data);
-        return 1;
-    }
     else if (msg_bits > 16) {
         decoder_logf_bitrow(decoder, 1, __func__, msg, msg_bits, "Unrecognized Oregon Scientific v2.1 message (sensor type %04x)", sensor_id);
     }
@@ -608,31 +626,25 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
     // CM160 preamble might look like 7f ff ff aa, i.e. ff ff f5
     uint8_t const alt_pattern[] = {0xff, 0xf5};
 
-    int os_pos    = bitbuffer_search(bitbuffer, 0, 0, os_pattern, 16) + 16;
-    int cm180_pos = bitbuffer_search(bitbuffer, 0, 0, cm180_pattern, 16) + 8; // keep the 0x46
-    int cm180i_pos = bitbuffer_search(bitbuffer, 0, 0, cm180i_pattern, 16) + 8; // keep the 0x46
-    int alt_pos   = bitbuffer_search(bitbuffer, 0, 0, alt_pattern, 16) + 16;
-
-    if (bitbuffer->bits_per_row[0] - os_pos >= 7 * 8) {
-        msg_pos = os_pos;
-        msg_len = bitbuffer->bits_per_row[0] - os_pos;
-    }
-
-    // 52 bits: secondary frame (instant watts only)
-    // 108 bits: primary frame (instant watts + cumulative wattshour)
-    else if (bitbuffer->bits_per_row[0] - cm180_pos >= 52) {
-        msg_pos = cm180_pos;
-        msg_len = bitbuffer->bits_per_row[0] - cm180_pos;
-    }
-
-    else if (bitbuffer->bits_per_row[0] - cm180i_pos >= 84) {
-        msg_pos = cm180i_pos;
-        msg_len = bitbuffer->bits_per_row[0] - cm180i_pos;
-    }
-
-    else if (bitbuffer->bits_per_row[0] - alt_pos >= 7 * 8) {
-        msg_pos = alt_pos;
-        msg_len = bitbuffer->bits_per_row[0] - alt_pos;
+    // Search the other preambles only if the previous one is not found
+    int row_bits = bitbuffer->bits_per_row[0];
+    msg_pos = bitbuffer_search(bitbuffer, 0, 0, os_pattern, 16) + 16;
+    msg_len = row_bits - msg_pos;
+    if (msg_len < 7 * 8) {
+        // 52 bits: secondary frame (instant watts only)
+        // 108 bits: primary frame (instant watts + cumulative wattshour)
+        msg_pos = bitbuffer_search(bitbuffer, 0, 0, cm180_pattern, 16) + 8; // keep the 0x46
+        msg_len = row_bits - msg_pos;
+        if (msg_len < 52) {
+            msg_pos = bitbuffer_search(bitbuffer, 0, 0, cm180i_pattern, 16) + 8; // keep the 0x46
+            msg_len = row_bits - msg_pos;
+            if (msg_len < 84) {
+                msg_pos = bitbuffer_search(bitbuffer, 0, 0, alt_pattern, 16) + 16;
+                msg_len = row_bits - msg_pos;
+                if (msg_len < 7 * 8)
+                    msg_len = 0;
+            }
+        }
     }
 
     if (msg_len == 0 || msg_len > (int)sizeof(msg) * 8)
@@ -646,7 +658,10 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
     int device_id   = (msg[2] & 0x0f) | (msg[3] & 0xf0); // not for CM sensor types
     int battery_low = (msg[3] >> 2) & 0x01;              // not for CM sensor types
 
-    if (sensor_id == ID_THGR810 || sensor_id == ID_THGR810a) {
+    // Dispatch on the sensor ID, the Owl CM sensors are told by the first byte
+    switch (sensor_id) {
+    case ID_THGR810:
+    case ID_THGR810a: {
         if (validate_os_checksum(decoder, msg, 15) != 0)
             return DECODE_FAIL_MIC;
         // Sanity check BCD digits
@@ -674,7 +689,7 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
         decoder_output_data(decoder, data);
         return 1;                                    //msg[k] = ((msg[k] & 0x0F) << 4) + ((msg[k] & 0xF0) >> 4);
     }
-    else if (sensor_id == ID_THN802) {
+    case ID_THN802: {
         if (validate_os_checksum(decoder, msg, 12) != 0)
             return DECODE_FAIL_MIC;
         float temp_c = get_os_temperature(msg);
@@ -690,7 +705,7 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_UV800) {
+    case ID_UV800: {
         if (validate_os_checksum(decoder, msg, 13) != 0)
             return DECODE_FAIL_MIC;
         int uvidx = get_os_uv(msg);
@@ -706,7 +721,7 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_PCR800) {
+    case ID_PCR800: {
         if (validate_os_checksum(decoder, msg, 18) != 0)
             return DECODE_FAIL_MIC;
         // Sanity check BCD digits
@@ -740,7 +755,7 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_PCR800a) {
+    case ID_PCR800a: {
         if (validate_os_checksum(decoder, msg, 18) != 0)
             return DECODE_FAIL_MIC;
         float rain_rate = get_os_rain_rate(msg);
@@ -758,7 +773,8 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if (sensor_id == ID_WGR800 || sensor_id == ID_WGR800a) {
+    case ID_WGR800:
+    case ID_WGR800a: {
         if (validate_os_checksum(decoder, msg, 17) != 0)
             return DECODE_FAIL_MIC;
         // Sanity check BCD digits
@@ -796,7 +812,9 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
         decoder_output_data(decoder, data);
         return 1;
     }
-    else if ((msg[0] == 0x20) || (msg[0] == 0x21) || (msg[0] == 0x22) || (msg[0] == 0x23) || (msg[0] == 0x24)) { // Owl CM160 Readings
+    }
+
+    if ((msg[0] == 0x20) || (msg[0] == 0x21) || (msg[0] == 0x22) || (msg[0] == 0x23) || (msg[0] == 0x24)) { // Owl CM160 Readings
         msg[0] = msg[0] & 0x0F;
 
         if (validate_os_checksum(decoder, msg, 22) != 0)
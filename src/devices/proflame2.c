@@ -89,7 +89,11 @@ static int proflame2_mc(bitbuffer_t *bitbuffer, unsigned row, unsigned start, ui
 
 static int proflame2_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    for (int row = 0; row < bitbuffer->num_rows; ++row) {
+    // the remote repeats the frame, check each distinct row once
+    bitbuffer_row_repeats_t unique[BITBUF_ROWS];
+    unsigned num_unique = bitbuffer_unique_rows(bitbuffer, 0, unique);
+    for (unsigned i = 0; i < num_unique; ++i) {
+        int row = unique[i].row;
         uint8_t b[7] = {0};
         int ret = proflame2_mc(bitbuffer, row, 0, b);
 
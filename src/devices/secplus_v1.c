@@ -410,4 +410,5 @@ r_device const secplus_v1 = {
         .reset_limit = 80000,
         .decode_fn   = &secplus_v1_callback,
         .fields      = output_fields,
+        .keeps_state = 1,
 };
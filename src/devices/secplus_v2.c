@@ -19,12 +19,18 @@ Security+ 2.0  is described in [US patent application US20110317835A1](https://p
 */
 
 #include "decoder.h"
+#include "compat_time.h"
+#include <stdlib.h>
 
 /**
 Security+ 2.0 rolling code.
 
 Data comes in two bursts/packets.
 
+@warning This decoder is not stateless, a half received alone is kept for a
+short while and paired with the other half of the same remote, as learned
+from earlier packages with both halves.
+
 Layout:
 
     bits = `AA BB IIII OOOO X*30`
@@ -234,6 +240,96 @@ static int secplus_v2_decode_v2_half(r_device *decoder, bitbuffer_t *bits, uint8
     return 0;
 }
 
+// max age of a half waiting for the other half in ms
+#define SECPLUS_V2_MAX_AGE 800
+// number of halves tracked, about two per remote
+#define SECPLUS_V2_HALVES 128
+// the learned pairing of the halves of a remote is kept this long in ms
+#define SECPLUS_V2_PAIR_AGE (24 * 3600 * 1000)
+
+/// A half by its fixed bits, the key is the part (1 or 2) above the 20 fixed bits.
+///
+/// The two records of the keys SECPLUS_V2_LAST(part) instead hold the key
+/// of the last unpaired half of that part in `partner`.
+typedef struct {
+    uint64_t partner;   ///< key of the other half of this remote, 0 if not known yet
+    uint64_t time;      ///< when the rolling digits were received, in ms
+    int pending;        ///< the rolling digits wait for the other half
+    uint8_t rolling[9]; ///< trinary rolling digits of this half
+} secplus_v2_half_t;
+
+#define SECPLUS_V2_KEY(part, fixed_bits) ((uint64_t)((part) + 1) << 20 | (fixed_bits))
+#define SECPLUS_V2_LAST(part) ((uint64_t)1 << 32 | (part))
+
+static uint64_t secplus_v2_now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/// The 20 bits of a fixed half, 0 if not decoded.
+static uint32_t secplus_v2_fixed_bits(bitbuffer_t *fixed)
+{
+    if (!fixed->bits_per_row[0])
+        return 0;
+    uint8_t *bb = fixed->bb[0];
+    return (uint32_t)bb[0] << 12 | bb[1] << 4 | bb[2] >> 4;
+}
+
+/// Remember that two halves belong to one remote.
+static void secplus_v2_learn(decoder_state_table_t *halves, uint32_t fixed_bits_1, uint32_t fixed_bits_2, uint64_t now)
+{
+    secplus_v2_half_t *half_1 = decoder_state_get(halves, SECPLUS_V2_KEY(0, fixed_bits_1), now, NULL);
+    half_1->partner = SECPLUS_V2_KEY(1, fixed_bits_2);
+    half_1->pending = 0;
+    secplus_v2_half_t *half_2 = decoder_state_get(halves, SECPLUS_V2_KEY(1, fixed_bits_2), now, NULL);
+    half_2->partner = SECPLUS_V2_KEY(0, fixed_bits_1);
+    half_2->pending = 0;
+}
+
+/// Pair a half with the other half of its remote from an earlier package, otherwise keep it for later.
+///
+/// The other half is looked up by the learned pairing of the remote first,
+/// then the last unpaired half of the other part is taken.
+/// @return 1 if the other half was found, 0 if the half is kept
+static int secplus_v2_pair(r_device *decoder, decoder_state_table_t *halves, int part, uint32_t fixed_bits, uint8_t const rolling[],
+        uint32_t *other_fixed_bits, uint8_t other_rolling[])
+{
+    uint64_t now = secplus_v2_now();
+    uint64_t key = SECPLUS_V2_KEY(part, fixed_bits);
+    secplus_v2_half_t *half = decoder_state_get(halves, key, now, NULL);
+
+    uint64_t other_key = half->partner;
+    secplus_v2_half_t *other = other_key ? decoder_state_find(halves, other_key, now) : NULL;
+    if (!other || !other->pending || now - other->time > SECPLUS_V2_MAX_AGE) {
+        secplus_v2_half_t *last = decoder_state_find(halves, SECPLUS_V2_LAST(!part), now);
+        other_key = last && now - last->time <= SECPLUS_V2_MAX_AGE ? last->partner : 0;
+        other = other_key ? decoder_state_find(halves, other_key, now) : NULL;
+    }
+
+    if (!other || !other->pending || now - other->time > SECPLUS_V2_MAX_AGE) {
+        memcpy(half->rolling, rolling, sizeof(half->rolling));
+        half->time    = now;
+        half->pending = 1;
+        secplus_v2_half_t *last = decoder_state_get(halves, SECPLUS_V2_LAST(part), now, NULL);
+        last->partner = key;
+        last->time    = now;
+        decoder_logf(decoder, 1, __func__, "caching part %d", part + 1);
+        return 0;
+    }
+
+    decoder_logf(decoder, 1, __func__, "Load cache part %d", !part + 1);
+    memcpy(other_rolling, other->rolling, sizeof(other->rolling));
+    *other_fixed_bits = (uint32_t)other_key & 0xfffff;
+    other->pending = 0;
+    half->pending  = 0;
+    half->partner  = other_key;
+    other->partner = key;
+    decoder_state_remove(halves, SECPLUS_V2_LAST(!part));
+    return 1;
+}
+
 static const uint8_t _preamble[] = {0xaa, 0xaa, 0x95, 0x60};
 unsigned _preamble_len           = 28;
 
@@ -297,10 +393,32 @@ static int secplus_v2_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         }
     }
 
-    // Do we have what we need ??
-    if (fixed_1.bits_per_row[0] == 0 || fixed_2.bits_per_row[0] == 0) {
+    if (fixed_1.bits_per_row[0] == 0 && fixed_2.bits_per_row[0] == 0) {
+        return DECODE_FAIL_SANITY;
+    }
+
+    // the halves usually come in one package, otherwise pair with a half of an earlier package
+    decoder_state_table_t *halves = decoder_user_data(decoder);
+    uint32_t fixed_bits_1 = secplus_v2_fixed_bits(&fixed_1);
+    uint32_t fixed_bits_2 = secplus_v2_fixed_bits(&fixed_2);
+    if (fixed_1.bits_per_row[0] && fixed_2.bits_per_row[0]) {
+        if (halves) {
+            secplus_v2_learn(halves, fixed_bits_1, fixed_bits_2, secplus_v2_now());
+        }
+    }
+    else if (!halves) {
         return DECODE_FAIL_SANITY;
     }
+    else if (fixed_1.bits_per_row[0]) {
+        if (!secplus_v2_pair(decoder, halves, 0, fixed_bits_1, rolling_1, &fixed_bits_2, rolling_2)) {
+            return DECODE_FAIL_SANITY;
+        }
+    }
+    else {
+        if (!secplus_v2_pair(decoder, halves, 1, fixed_bits_2, rolling_2, &fixed_bits_1, rolling_1)) {
+            return DECODE_FAIL_SANITY;
+        }
+    }
 
     // Assemble rolling_1[] and rolling_2[] into rolling_digits[]
     uint8_t rolling_digits[24] = {0};
@@ -341,17 +459,7 @@ static int secplus_v2_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     rolling_total = rolling_total >> 4;
 
     // Assemble "fixed" data part
-    uint64_t fixed_total = 0;
-    uint8_t *bb;
-    bb = fixed_1.bb[0];
-    fixed_total ^= ((uint64_t)bb[0]) << 32;
-    fixed_total ^= ((uint64_t)bb[1]) << 24;
-    fixed_total ^= ((uint64_t)bb[2]) << 16;
-
-    bb = fixed_2.bb[0];
-    fixed_total ^= ((uint64_t)bb[0]) << 12;
-    fixed_total ^= ((uint64_t)bb[1]) << 4;
-    fixed_total ^= (bb[2] >> 4) & 0x0f;
+    uint64_t fixed_total = ((uint64_t)(fixed_bits_1 & 0xfffff) << 20) | (fixed_bits_2 & 0xfffff);
 
     // int button    = fixed_total >> 32;
     // int remote_id = fixed_total & 0xffffffff;
@@ -394,6 +502,23 @@ static char const *const output_fields[] = {
 //      Freq 310.01M
 //  -X "n=vI3,m=OOK_PCM,s=230,l=230,t=40,r=10000,g=7400,match={24}0xaaaa9560"
 
+r_device const secplus_v2;
+
+static r_device *secplus_v2_create(char *arg)
+{
+    if (arg) {
+        fprintf(stderr, "secplus_v2: this decoder takes no arguments\n");
+        exit(1);
+    }
+    size_t size = decoder_state_table_size(SECPLUS_V2_HALVES, sizeof(secplus_v2_half_t));
+    r_device *r_dev = decoder_create(&secplus_v2, size);
+    if (!r_dev) {
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    decoder_state_table_init(decoder_user_data(r_dev), SECPLUS_V2_HALVES, sizeof(secplus_v2_half_t), SECPLUS_V2_PAIR_AGE);
+    return r_dev;
+}
+
 r_device const secplus_v2 = {
         .name        = "Security+ 2.0 (Keyfob)",
         .modulation  = OOK_PULSE_PCM,
@@ -403,5 +528,7 @@ r_device const secplus_v2 = {
         .gap_limit   = 1500,
         .reset_limit = 9000,
         .decode_fn   = &secplus_v2_callback,
+        .create_fn   = &secplus_v2_create,
         .fields      = output_fields,
+        .keeps_state = 1,
 };
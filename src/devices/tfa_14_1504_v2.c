@@ -48,10 +48,10 @@ Example payloads (excluding preamble):
 #define NUM_BITS_TOTAL    (NUM_BITS_PREAMBLE + NUM_BITS_DATA)
 #define NUM_BITS_MAX      (NUM_BITS_TOTAL + 12)
 
+static uint8_t const preamble[] = {0xaa, 0xaa, 0x5c};
+
 static int tfa_14_1504_v2_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    uint8_t const preamble[] = {0xaa, 0xaa, 0x5c};
-
     if (bitbuffer->num_rows != 1) {
         return DECODE_ABORT_EARLY;
     }
@@ -131,6 +131,9 @@ r_device const tfa_14_1504_v2 = {
         .short_width = 360,
         .long_width  = 360,
         .reset_limit = 4096,
+        .max_rows    = 1,
+        .preamble    = preamble,
+        .preamble_bits = NUM_BITS_PREAMBLE,
         .decode_fn   = &tfa_14_1504_v2_decode,
         .fields      = output_fields,
 };
@@ -25,9 +25,31 @@ TFA pool temperature sensor.
 
 #include "decoder.h"
 
+/// Fields of the output, indexes into output_schema.
+enum {
+    FIELD_MODEL,
+    FIELD_ID,
+    FIELD_CHANNEL,
+    FIELD_BATTERY_OK,
+    FIELD_TEMPERATURE_C,
+    FIELD_MIC,
+};
+
+/* clang-format off */
+static data_schema_field_t const output_schema[] = {
+        [FIELD_MODEL]         = {"model",           "",             DATA_STRING,    NULL},
+        [FIELD_ID]            = {"id",              "Id",           DATA_INT,       NULL},
+        [FIELD_CHANNEL]       = {"channel",         "Channel",      DATA_INT,       NULL},
+        [FIELD_BATTERY_OK]    = {"battery_ok",      "Battery",      DATA_INT,       NULL},
+        [FIELD_TEMPERATURE_C] = {"temperature_C",   "Temperature",  DATA_DOUBLE,    "%.1f C"},
+        [FIELD_MIC]           = {"mic",             "Integrity",    DATA_STRING,    NULL},
+        {NULL},
+};
+/* clang-format on */
+
 static int tfa_pool_thermometer_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    data_t *data;
+    data_record_t record;
     uint8_t *b;
     int checksum, checksum_rx, device, channel, battery;
     int temp_raw;
@@ -63,18 +85,15 @@ static int tfa_pool_thermometer_decode(r_device *decoder, bitbuffer_t *bitbuffer
     channel     = ((b[3] & 0xC0) >> 6);
     battery     = ((b[3] & 0x20) >> 5);
 
-    /* clang-format off */
-    data = data_make(
-            "model",            "",                 DATA_STRING,    "TFA-Pool",
-            "id",               "Id",               DATA_INT,       device,
-            "channel",          "Channel",          DATA_INT,       channel,
-            "battery_ok",       "Battery",          DATA_INT,       battery,
-            "temperature_C",    "Temperature",      DATA_FORMAT,    "%.1f C",  DATA_DOUBLE,    temp_f,
-            "mic",              "Integrity",        DATA_STRING,    "CHECKSUM",
-            NULL);
-    /* clang-format on */
-
-    decoder_output_data(decoder, data);
+    record.set = 0;
+    data_record_str(&record, FIELD_MODEL, "TFA-Pool");
+    data_record_int(&record, FIELD_ID, device);
+    data_record_int(&record, FIELD_CHANNEL, channel);
+    data_record_int(&record, FIELD_BATTERY_OK, battery);
+    data_record_dbl(&record, FIELD_TEMPERATURE_C, temp_f);
+    data_record_str(&record, FIELD_MIC, "CHECKSUM");
+
+    decoder_output_record(decoder, &record);
     return 1;
 }
 
@@ -97,4 +116,5 @@ r_device const tfa_pool_thermometer = {
         .reset_limit = 10000,
         .decode_fn   = &tfa_pool_thermometer_decode,
         .fields      = output_fields,
+        .schema      = output_schema,
 };
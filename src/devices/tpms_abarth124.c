@@ -82,6 +82,8 @@ static int tpms_abarth124_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsi
     return 1;
 }
 
+static uint8_t const preamble_raw[] = {0x55, 0x55, 0x56}; // before invert
+
 /** @sa tpms_abarth124_decode() */
 static int tpms_abarth124_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
@@ -121,6 +123,9 @@ r_device const tpms_abarth124 = {
         .short_width = 52,  // 12-13 samples @250k
         .long_width  = 52,  // FSK
         .reset_limit = 150, // Maximum gap size before End Of Message [us].
+        .preamble    = preamble_raw,
+        .preamble_bits = 24,
+        .want_windows = 1,
         .decode_fn   = &tpms_abarth124_callback,
         .fields      = output_fields,
 };
@@ -181,6 +181,8 @@ static int tpms_ford_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned
     return 1;
 }
 
+static uint8_t const preamble_raw[] = {0x55, 0x56}; // before invert
+
 /** @sa tpms_ford_decode() */
 static int tpms_ford_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
@@ -232,6 +234,9 @@ r_device const tpms_ford = {
         .short_width = 52,  // 12-13 samples @250k
         .long_width  = 52,  // FSK
         .reset_limit = 150, // Maximum gap size before End Of Message [us].
+        .preamble    = preamble_raw,
+        .preamble_bits = 16,
+        .want_windows = 1,
         .decode_fn   = &tpms_ford_callback,
         .fields      = output_fields,
 };
@@ -104,6 +104,8 @@ static int tpms_hyundai_vdo_decode(r_device *decoder, bitbuffer_t *bitbuffer, un
 Wrapper for the Hyundai-VDO tpms.
 @sa tpms_hyundai_vdo_decode()
 */
+static uint8_t const preamble_raw[] = {0x55, 0x55, 0x55, 0x56}; // before invert
+
 static int tpms_hyundai_vdo_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
     // full preamble is 55 55 55 56 (inverted: aa aa aa a9)
@@ -147,6 +149,9 @@ r_device const tpms_hyundai_vdo = {
         .short_width = 52,  // in the FCC test protocol is actually 42us, but works with 52 also
         .long_width  = 52,  // FSK
         .reset_limit = 150, // Maximum gap size before End Of Message [us].
+        .preamble    = preamble_raw,
+        .preamble_bits = 32,
+        .want_windows = 1,
         .decode_fn   = &tpms_hyundai_vdo_callback,
         .fields      = output_fields,
 };
@@ -83,12 +83,12 @@ static int tpms_porsche_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsign
     return 1;
 }
 
+// Full preamble is {30}ccccccca (33333332).
+static uint8_t const preamble_pattern[] = {0x33, 0x33, 0x20}; // 20 bit
+
 /** @sa tpms_porsche_decode() */
 static int tpms_porsche_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    // Full preamble is {30}ccccccca (33333332).
-    uint8_t const preamble_pattern[] = {0x33, 0x33, 0x20}; // 20 bit
-
     int events = 0;
 
     // Find a preamble with enough bits after it that it could be a complete packet
@@ -119,6 +119,9 @@ r_device const tpms_porsche = {
         .short_width = 52,  // 12-13 samples @250k
         .long_width  = 52,  // FSK
         .reset_limit = 150, // Maximum gap size before End Of Message [us].
+        .preamble    = preamble_pattern,
+        .preamble_bits = 20,
+        .want_windows = 1,
         .decode_fn   = &tpms_porsche_callback,
         .fields      = output_fields,
 };
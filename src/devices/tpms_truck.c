@@ -94,6 +94,8 @@ static int tpms_truck_decode(r_device *decoder, bitbuffer_t *bitbuffer, unsigned
     return 1;
 }
 
+static uint8_t const preamble_raw[] = {0x55, 0x55, 0x56}; // before invert
+
 /** @sa tpms_truck_decode() */
 static int tpms_truck_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
@@ -133,6 +135,9 @@ r_device const tpms_truck = {
         .short_width = 52,
         .long_width  = 52,
         .reset_limit = 150,
+        .preamble    = preamble_raw,
+        .preamble_bits = 24,
+        .want_windows = 1,
         .decode_fn   = &tpms_truck_callback,
         .fields      = output_fields,
 };
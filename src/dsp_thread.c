@@ -0,0 +1,337 @@
+/** @file
+    Demodulation worker thread between the SDR acquire thread and the event loop.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "dsp_thread.h"
+#include "data.h"
+#include "r_util.h"
+#include "logger.h"
+#include "trace.h"
+#include "fatal.h"
+#include "thread_sched.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+// The pipeline is: SDR thread -> IQ queue -> DSP thread -> event queue -> event loop.
+// The IQ queue only holds references into the SDR buffer ring, the SDR keeps
+// the buffers valid as long as the queue is shorter than the ring.
+// Leased buffers are released once processed or dropped.
+// The DSP thread takes all queued buffers (up to a batch) per wakeup and is
+// only signaled when the queue was empty, a backlog costs no syscalls.
+
+#ifdef THREADS
+
+typedef struct dsp_event {
+    data_t *data;
+    int level;
+} dsp_event_t;
+
+struct dsp_thread {
+    ring_queue_t *iq_queue;
+    ring_queue_t *event_queue;
+    dsp_process_fn process_cb;
+    dsp_wakeup_fn wakeup_cb;
+    void *ctx;
+
+    pthread_t thread;
+    pthread_t loop_thread;
+    pthread_mutex_t lock; ///< lock for busy and exit_thread
+    pthread_cond_t cond;  ///< signaled on push, idle, and exit
+    int busy;             ///< DSP thread is processing a batch of buffers
+    int paused;           ///< DSP thread is held between batches
+    int waiters;          ///< threads waiting for the DSP thread to be idle
+    int exit_thread;
+};
+
+static THREAD_RETURN THREAD_CALL dsp_thread_loop(void *arg)
+{
+    dsp_thread_t *dsp = arg;
+    print_log(LOG_DEBUG, __func__, "dsp_thread enter...");
+    trace_thread_name("dsp");
+
+    pthread_mutex_lock(&dsp->lock);
+    for (;;) {
+        sdr_event_t evs[DSP_THREAD_BATCH];
+        unsigned n = 0;
+        if (dsp->exit_thread)
+            break;
+        while (!dsp->paused && n < DSP_THREAD_BATCH && !ring_queue_pop(dsp->iq_queue, &evs[n], 0))
+            ++n;
+        if (!n) {
+            pthread_cond_wait(&dsp->cond, &dsp->lock);
+            continue;
+        }
+        dsp->busy = 1;
+        pthread_mutex_unlock(&dsp->lock);
+
+        dsp->process_cb(evs, n, dsp->ctx);
+        for (unsigned i = 0; i < n; ++i)
+            sdr_release(&evs[i]);
+
+        pthread_mutex_lock(&dsp->lock);
+        dsp->busy = 0;
+        if (dsp->waiters)
+            pthread_cond_broadcast(&dsp->cond);
+    }
+    pthread_mutex_unlock(&dsp->lock);
+
+    print_log(LOG_DEBUG, __func__, "dsp_thread done...");
+    return (THREAD_RETURN)0;
+}
+
+dsp_thread_t *dsp_thread_start(unsigned iq_queue_size, unsigned event_queue_size, dsp_process_fn process_cb, dsp_wakeup_fn wakeup_cb, void *ctx)
+{
+    dsp_thread_t *dsp = calloc(1, sizeof(*dsp));
+    if (!dsp) {
+        WARN_CALLOC("dsp_thread_start()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    dsp->iq_queue    = ring_queue_create(iq_queue_size, sizeof(sdr_event_t));
+    dsp->event_queue = ring_queue_create(event_queue_size, sizeof(dsp_event_t));
+    if (!dsp->iq_queue || !dsp->event_queue) {
+        ring_queue_free(dsp->iq_queue);
+        ring_queue_free(dsp->event_queue);
+        free(dsp);
+        return NULL;
+    }
+    dsp->process_cb  = process_cb;
+    dsp->wakeup_cb   = wakeup_cb;
+    dsp->ctx         = ctx;
+    dsp->loop_thread = pthread_self();
+
+    pthread_mutex_init(&dsp->lock, NULL);
+    pthread_cond_init(&dsp->cond, NULL);
+
+#ifndef _WIN32
+    // Block all signals from the worker thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&dsp->thread, NULL, dsp_thread_loop, dsp);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        pthread_mutex_destroy(&dsp->lock);
+        pthread_cond_destroy(&dsp->cond);
+        ring_queue_free(dsp->iq_queue);
+        ring_queue_free(dsp->event_queue);
+        free(dsp);
+        return NULL;
+    }
+
+    return dsp;
+}
+
+void dsp_thread_stop(dsp_thread_t *dsp)
+{
+    if (!dsp)
+        return;
+
+    pthread_mutex_lock(&dsp->lock);
+    dsp->exit_thread = 1;
+    pthread_mutex_unlock(&dsp->lock);
+    pthread_cond_broadcast(&dsp->cond);
+
+    int r = pthread_join(dsp->thread, NULL);
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+    }
+
+    sdr_event_t ev;
+    while (!ring_queue_pop(dsp->iq_queue, &ev, 0)) {
+        sdr_release(&ev);
+    }
+
+    dsp_event_t event;
+    while (!ring_queue_pop(dsp->event_queue, &event, 0)) {
+        data_free(event.data);
+    }
+
+    pthread_mutex_destroy(&dsp->lock);
+    pthread_cond_destroy(&dsp->cond);
+    ring_queue_free(dsp->iq_queue);
+    ring_queue_free(dsp->event_queue);
+    free(dsp);
+}
+
+void dsp_thread_set_sched(dsp_thread_t *dsp, thread_sched_t const *sched)
+{
+    if (dsp)
+        thread_sched_apply(dsp->thread, sched, "DSP");
+}
+
+int dsp_thread_push(dsp_thread_t *dsp, sdr_event_t const *ev)
+{
+    int prev_len = ring_queue_push(dsp->iq_queue, ev);
+    if (prev_len < 0) {
+        sdr_event_t dropped = *ev;
+        sdr_release(&dropped);
+        return -1;
+    }
+
+    // only wake the DSP thread on the first buffer, it pops until the queue is empty
+    if (prev_len == 0) {
+        pthread_mutex_lock(&dsp->lock);
+        pthread_cond_broadcast(&dsp->cond);
+        pthread_mutex_unlock(&dsp->lock);
+    }
+    return 0;
+}
+
+void dsp_thread_flush(dsp_thread_t *dsp)
+{
+    pthread_mutex_lock(&dsp->lock);
+    sdr_event_t ev;
+    while (!ring_queue_pop(dsp->iq_queue, &ev, 0)) {
+        sdr_release(&ev);
+    }
+    dsp->waiters++;
+    while (dsp->busy)
+        pthread_cond_wait(&dsp->cond, &dsp->lock);
+    dsp->waiters--;
+    pthread_mutex_unlock(&dsp->lock);
+}
+
+void dsp_thread_pause(dsp_thread_t *dsp)
+{
+    pthread_mutex_lock(&dsp->lock);
+    dsp->paused = 1;
+    dsp->waiters++;
+    while (dsp->busy)
+        pthread_cond_wait(&dsp->cond, &dsp->lock);
+    dsp->waiters--;
+    pthread_mutex_unlock(&dsp->lock);
+}
+
+void dsp_thread_resume(dsp_thread_t *dsp)
+{
+    pthread_mutex_lock(&dsp->lock);
+    dsp->paused = 0;
+    pthread_cond_broadcast(&dsp->cond);
+    pthread_mutex_unlock(&dsp->lock);
+}
+
+int dsp_thread_is_loop(dsp_thread_t *dsp)
+{
+    return pthread_equal(dsp->loop_thread, pthread_self());
+}
+
+int dsp_thread_post_event(dsp_thread_t *dsp, data_t *data, int level)
+{
+    dsp_event_t event = {.data = data, .level = level};
+    int prev_len = ring_queue_push(dsp->event_queue, &event);
+    if (prev_len < 0) {
+        data_free(data);
+        return -1;
+    }
+    // only wake the loop on the first event, the loop drains the whole queue
+    if (prev_len == 0 && dsp->wakeup_cb)
+        dsp->wakeup_cb(dsp->ctx);
+    return 0;
+}
+
+int dsp_thread_pop_event(dsp_thread_t *dsp, data_t **data, int *level)
+{
+    dsp_event_t event;
+    if (ring_queue_pop(dsp->event_queue, &event, 0))
+        return -1;
+    *data  = event.data;
+    *level = event.level;
+    return 0;
+}
+
+void dsp_thread_get_stats(dsp_thread_t *dsp, ring_queue_stats_t *iq_stats, ring_queue_stats_t *event_stats)
+{
+    ring_queue_get_stats(dsp->iq_queue, iq_stats);
+    ring_queue_get_stats(dsp->event_queue, event_stats);
+}
+
+#else
+
+dsp_thread_t *dsp_thread_start(unsigned iq_queue_size, unsigned event_queue_size, dsp_process_fn process_cb, dsp_wakeup_fn wakeup_cb, void *ctx)
+{
+    UNUSED(iq_queue_size);
+    UNUSED(event_queue_size);
+    UNUSED(process_cb);
+    UNUSED(wakeup_cb);
+    UNUSED(ctx);
+    return NULL;
+}
+
+void dsp_thread_stop(dsp_thread_t *dsp)
+{
+    UNUSED(dsp);
+}
+
+void dsp_thread_set_sched(dsp_thread_t *dsp, thread_sched_t const *sched)
+{
+    UNUSED(dsp);
+    UNUSED(sched);
+}
+
+int dsp_thread_push(dsp_thread_t *dsp, sdr_event_t const *ev)
+{
+    UNUSED(dsp);
+    UNUSED(ev);
+    return -1;
+}
+
+void dsp_thread_flush(dsp_thread_t *dsp)
+{
+    UNUSED(dsp);
+}
+
+void dsp_thread_pause(dsp_thread_t *dsp)
+{
+    UNUSED(dsp);
+}
+
+void dsp_thread_resume(dsp_thread_t *dsp)
+{
+    UNUSED(dsp);
+}
+
+int dsp_thread_is_loop(dsp_thread_t *dsp)
+{
+    UNUSED(dsp);
+    return 1;
+}
+
+int dsp_thread_post_event(dsp_thread_t *dsp, data_t *data, int level)
+{
+    UNUSED(dsp);
+    UNUSED(level);
+    data_free(data);
+    return -1;
+}
+
+int dsp_thread_pop_event(dsp_thread_t *dsp, data_t **data, int *level)
+{
+    UNUSED(dsp);
+    UNUSED(data);
+    UNUSED(level);
+    return -1;
+}
+
+void dsp_thread_get_stats(dsp_thread_t *dsp, ring_queue_stats_t *iq_stats, ring_queue_stats_t *event_stats)
+{
+    UNUSED(dsp);
+    *iq_stats    = (ring_queue_stats_t){0};
+    *event_stats = (ring_queue_stats_t){0};
+}
+
+#endif
@@ -0,0 +1,565 @@
+/** @file
+    Asynchronous writer of the sample dumpers, writes from a worker thread.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "dump_writer.h"
+#include "ring_queue.h"
+#include "list.h"
+#include "logger.h"
+#include "fatal.h"
+#include "compat_time.h"
+#include "compat_pthread.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#endif
+
+#define DUMP_WRITER_STREAMS_MAX 64 ///< files written at once, bounds the finish markers on the queue
+#define DUMP_WRITER_ADVISE_LAG (4 * DUMP_WRITER_BLOCK) ///< written bytes advised again until their writeback is done
+
+// The dumpers fill a block of their stream and queue it once full, the
+// writer thread writes the blocks in queue order and returns them to the
+// free list. Removing a stream queues a finish marker with the partial
+// block, the writer writes it as the tail and signals the stream done.
+
+#ifdef THREADS
+
+typedef struct {
+    FILE *file;
+    char *name;
+    uint8_t *block;   ///< the block being filled, NULL if none
+    size_t fill;      ///< bytes in the block being filled
+    int finished;     ///< the finish marker was written, guarded by the lock
+    int failed;       ///< errno of a failed write, guarded by the lock
+    // writer thread only
+    int direct;       ///< O_DIRECT is set on the file
+    uint64_t offset;  ///< file offset of the next write
+    uint64_t advised; ///< file offset up to which the written data is clean
+} dump_stream_t;
+
+typedef struct {
+    dump_stream_t *stream;
+    uint8_t *block;  ///< the block, NULL for a finish marker without data
+    size_t len;      ///< bytes to write
+    int finish;      ///< the last block of the stream
+    int64_t time_us; ///< time the block was queued
+} dump_write_t;
+
+struct dump_writer {
+    int flags;
+    unsigned blocks;           ///< number of blocks in the pool
+    uint8_t *pool_alloc;       ///< the allocation of the pool
+    ring_queue_t *free_blocks; ///< queue of free block pointers
+    ring_queue_t *writes;      ///< queue of dump_write_t for the writer thread
+    list_t streams;            ///< the added files, dumpers only
+    int dropping;              ///< data is being dropped, dumpers only
+    pthread_mutex_t lock;      ///< guards the stats and the stream flags
+    pthread_cond_t cond;       ///< signaled on finished streams
+    dump_writer_stats_t stats;
+    pthread_t thread;
+};
+
+static int64_t time_now_us(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+#ifdef O_DIRECT
+/// Set or clear O_DIRECT on a file, returns 0 on success.
+static int set_direct(int fd, int on)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return -1;
+    return fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT);
+}
+#endif
+
+/// Write all of a buffer to a stream, returns 0 or the errno.
+static int write_all(dump_stream_t *s, uint8_t const *buf, size_t len)
+{
+#ifdef _WIN32
+    // the stream is unbuffered
+    size_t n = fwrite(buf, 1, len, s->file);
+    s->offset += n;
+    return n == len ? 0 : errno ? errno : EIO;
+#else
+    int fd = fileno(s->file);
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+#ifdef O_DIRECT
+        if (n < 0 && errno == EINVAL && s->direct) {
+            print_logf(LOG_WARNING, "Dumper", "Direct I/O is not supported for \"%s\", writing through the cache", s->name);
+            set_direct(fd, 0);
+            s->direct = 0;
+            continue;
+        }
+#endif
+        if (n <= 0)
+            return n < 0 ? errno : EIO;
+        buf += n;
+        len -= (size_t)n;
+        s->offset += (uint64_t)n;
+    }
+    return 0;
+#endif
+}
+
+static void write_block(dump_writer_t *w, dump_write_t const *wr)
+{
+    dump_stream_t *s = wr->stream;
+
+#ifdef O_DIRECT
+    // direct I/O needs whole aligned blocks, the tail goes through the cache
+    if (s->direct && (wr->finish || wr->len % DUMP_WRITER_ALIGN)) {
+        set_direct(fileno(s->file), 0);
+        s->direct = 0;
+    }
+#endif
+    int err = wr->len ? write_all(s, wr->block, wr->len) : 0;
+    if (err) {
+        print_logf(LOG_ERROR, "Dumper", "Failed to write \"%s\": %s", s->name, strerror(err));
+        pthread_mutex_lock(&w->lock);
+        s->failed = err;
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    if ((w->flags & DUMP_WRITER_DONTNEED) && !s->direct && s->offset > s->advised) {
+        // the first advice starts the writeback, the pages are dropped on a later one once clean
+        posix_fadvise(fileno(s->file), (off_t)s->advised, (off_t)(s->offset - s->advised), POSIX_FADV_DONTNEED);
+        if (s->offset > s->advised + DUMP_WRITER_ADVISE_LAG)
+            s->advised = s->offset - DUMP_WRITER_ADVISE_LAG;
+        if (wr->finish) {
+            fdatasync(fileno(s->file));
+            posix_fadvise(fileno(s->file), 0, 0, POSIX_FADV_DONTNEED);
+        }
+    }
+#endif
+}
+
+static THREAD_RETURN THREAD_CALL dump_writer_loop(void *arg)
+{
+    dump_writer_t *w = arg;
+
+    for (;;) {
+        dump_write_t wr;
+        // returns -1 only once the queue is closed and drained
+        if (ring_queue_pop(w->writes, &wr, 1))
+            break;
+        int failed;
+        pthread_mutex_lock(&w->lock);
+        failed = wr.stream->failed;
+        pthread_mutex_unlock(&w->lock);
+
+        int64_t start = time_now_us();
+        if (!failed)
+            write_block(w, &wr);
+        int64_t end = time_now_us();
+        if (wr.block)
+            ring_queue_push(w->free_blocks, &wr.block);
+
+        pthread_mutex_lock(&w->lock);
+        if (!failed && wr.len) {
+            w->stats.writes++;
+            w->stats.bytes += wr.len;
+        }
+        unsigned stall_ms   = (unsigned)((end - start) / 1000);
+        unsigned backlog_ms = (unsigned)((end - wr.time_us) / 1000);
+        if (stall_ms > w->stats.stall_max_ms)
+            w->stats.stall_max_ms = stall_ms;
+        if (backlog_ms > w->stats.backlog_max_ms)
+            w->stats.backlog_max_ms = backlog_ms;
+        if (wr.finish) {
+            wr.stream->finished = 1;
+            pthread_cond_broadcast(&w->cond);
+        }
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    return (THREAD_RETURN)0;
+}
+
+/// Find the stream of a file, returns its index or -1.
+static int find_stream(dump_writer_t *w, FILE *file)
+{
+    for (size_t i = 0; i < w->streams.len; ++i) {
+        dump_stream_t *s = w->streams.elems[i];
+        if (s->file == file)
+            return (int)i;
+    }
+    return -1;
+}
+
+/// Queue the block of a stream, a finish marker is queued even without a block.
+static void queue_block(dump_writer_t *w, dump_stream_t *s, int finish)
+{
+    dump_write_t wr = {.stream = s, .block = s->block, .len = s->fill, .finish = finish, .time_us = time_now_us()};
+    // the queue holds all blocks and a marker for each stream, it is never full
+    ring_queue_push(w->writes, &wr);
+    s->block = NULL;
+    s->fill  = 0;
+}
+
+dump_writer_t *dump_writer_create(size_t buf_size, int flags)
+{
+    dump_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("dump_writer_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    w->flags  = flags;
+    w->blocks = (unsigned)(buf_size / DUMP_WRITER_BLOCK);
+    if (w->blocks < 4)
+        w->blocks = 4;
+    w->pool_alloc = malloc((size_t)w->blocks * DUMP_WRITER_BLOCK + DUMP_WRITER_ALIGN);
+    if (!w->pool_alloc) {
+        WARN_MALLOC("dump_writer_create()");
+        free(w);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    w->free_blocks = ring_queue_create(w->blocks, sizeof(uint8_t *));
+    w->writes      = ring_queue_create(w->blocks + DUMP_WRITER_STREAMS_MAX, sizeof(dump_write_t));
+    if (!w->free_blocks || !w->writes) {
+        ring_queue_free(w->free_blocks);
+        ring_queue_free(w->writes);
+        free(w->pool_alloc);
+        free(w);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    // align the blocks for direct I/O
+    uint8_t *pool = w->pool_alloc + (DUMP_WRITER_ALIGN - (uintptr_t)w->pool_alloc % DUMP_WRITER_ALIGN) % DUMP_WRITER_ALIGN;
+    for (unsigned i = 0; i < w->blocks; ++i) {
+        uint8_t *block = pool + (size_t)i * DUMP_WRITER_BLOCK;
+        ring_queue_push(w->free_blocks, &block);
+    }
+    w->stats.blocks = w->blocks;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+#ifndef _WIN32
+    // Block all signals from the writer thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&w->thread, NULL, dump_writer_loop, w);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        ring_queue_free(w->free_blocks);
+        ring_queue_free(w->writes);
+        free(w->pool_alloc);
+        free(w);
+        return NULL;
+    }
+
+    print_logf(LOG_INFO, "Dumper", "Writing the dumpers from a thread with %u blocks of %u kB", w->blocks, DUMP_WRITER_BLOCK / 1024);
+    return w;
+}
+
+void dump_writer_free(dump_writer_t *w)
+{
+    if (!w)
+        return;
+
+    while (w->streams.len) {
+        dump_stream_t *s = w->streams.elems[w->streams.len - 1];
+        dump_writer_remove(w, s->file);
+    }
+
+    ring_queue_close(w->writes);
+    int r = pthread_join(w->thread, NULL);
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+    }
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    ring_queue_free(w->free_blocks);
+    ring_queue_free(w->writes);
+    list_free_elems(&w->streams, NULL);
+    free(w->pool_alloc);
+    free(w);
+}
+
+int dump_writer_add(dump_writer_t *w, FILE *file, char const *name)
+{
+    if (!w || !file || find_stream(w, file) >= 0)
+        return -1;
+    // each file holds a block while filling it, the others keep the writes going
+    if (w->streams.len >= DUMP_WRITER_STREAMS_MAX || w->streams.len + 2 >= w->blocks) {
+        print_logf(LOG_WARNING, "Dumper", "Too many files for the buffer, writing \"%s\" directly", name);
+        return -1;
+    }
+
+    dump_stream_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        WARN_CALLOC("dump_writer_add()");
+        return -1; // NOTE: writes directly on alloc failure.
+    }
+    s->name = strdup(name);
+    if (!s->name) {
+        WARN_STRDUP("dump_writer_add()");
+        free(s);
+        return -1; // NOTE: writes directly on alloc failure.
+    }
+    s->file = file;
+    // the writer bypasses the stdio buffer, e.g. of the headers
+    fflush(file);
+#ifdef _WIN32
+    setvbuf(file, NULL, _IONBF, 0);
+#else
+    off_t pos = lseek(fileno(file), 0, SEEK_CUR);
+    s->offset  = pos > 0 ? (uint64_t)pos : 0;
+    s->advised = s->offset;
+#endif
+
+    if (w->flags & DUMP_WRITER_DIRECT) {
+#ifdef O_DIRECT
+        if (s->offset % DUMP_WRITER_ALIGN || set_direct(fileno(file), 1))
+            print_logf(LOG_WARNING, "Dumper", "Direct I/O is not available for \"%s\", writing through the cache", name);
+        else
+            s->direct = 1;
+#else
+        print_logf(LOG_WARNING, "Dumper", "Direct I/O is not supported on this system, writing \"%s\" through the cache", name);
+#endif
+    }
+
+    list_push(&w->streams, s);
+    return 0;
+}
+
+int dump_writer_remove(dump_writer_t *w, FILE *file)
+{
+    int idx = w ? find_stream(w, file) : -1;
+    if (idx < 0)
+        return -1;
+    dump_stream_t *s = w->streams.elems[idx];
+
+    queue_block(w, s, 1);
+    pthread_mutex_lock(&w->lock);
+    while (!s->finished)
+        pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+
+    list_remove(&w->streams, (size_t)idx, NULL);
+    free(s->name);
+    free(s);
+    return 0;
+}
+
+size_t dump_writer_write(dump_writer_t *w, FILE *file, void const *buf, size_t len)
+{
+    int idx = w ? find_stream(w, file) : -1;
+    if (idx < 0)
+        return fwrite(buf, 1, len, file);
+    dump_stream_t *s = w->streams.elems[idx];
+
+    pthread_mutex_lock(&w->lock);
+    int failed = s->failed;
+    pthread_mutex_unlock(&w->lock);
+    if (failed)
+        return 0;
+
+    uint8_t const *p = buf;
+    size_t left      = len;
+    while (left) {
+        if (!s->block && ring_queue_pop(w->free_blocks, &s->block, 0)) {
+            if (!(w->flags & DUMP_WRITER_WAIT)) {
+                if (!w->dropping)
+                    print_log(LOG_WARNING, "Dumper", "Writes are behind, dropping dumper data");
+                w->dropping = 1;
+                pthread_mutex_lock(&w->lock);
+                w->stats.dropped += left;
+                pthread_mutex_unlock(&w->lock);
+                break;
+            }
+            pthread_mutex_lock(&w->lock);
+            w->stats.waits++;
+            pthread_mutex_unlock(&w->lock);
+            ring_queue_pop(w->free_blocks, &s->block, 1);
+        }
+        if (w->dropping) {
+            print_log(LOG_NOTICE, "Dumper", "Writes caught up");
+            w->dropping = 0;
+        }
+        size_t n = DUMP_WRITER_BLOCK - s->fill;
+        if (n > left)
+            n = left;
+        memcpy(&s->block[s->fill], p, n);
+        s->fill += n;
+        p += n;
+        left -= n;
+        if (s->fill == DUMP_WRITER_BLOCK)
+            queue_block(w, s, 0);
+    }
+    return len;
+}
+
+void dump_writer_get_stats(dump_writer_t *w, dump_writer_stats_t *stats)
+{
+    ring_queue_stats_t queue;
+    ring_queue_get_stats(w->writes, &queue);
+
+    pthread_mutex_lock(&w->lock);
+    *stats = w->stats;
+    pthread_mutex_unlock(&w->lock);
+    stats->queued     = queue.len;
+    stats->queued_max = queue.len_max;
+}
+
+#else
+
+dump_writer_t *dump_writer_create(size_t buf_size, int flags)
+{
+    (void)buf_size;
+    (void)flags;
+    print_log(LOG_WARNING, "Dumper", "async dumpers not available in this build, writing directly.");
+    return NULL;
+}
+
+void dump_writer_free(dump_writer_t *w)
+{
+    (void)w;
+}
+
+int dump_writer_add(dump_writer_t *w, FILE *file, char const *name)
+{
+    (void)w;
+    (void)file;
+    (void)name;
+    return -1;
+}
+
+int dump_writer_remove(dump_writer_t *w, FILE *file)
+{
+    (void)w;
+    (void)file;
+    return -1;
+}
+
+size_t dump_writer_write(dump_writer_t *w, FILE *file, void const *buf, size_t len)
+{
+    (void)w;
+    return fwrite(buf, 1, len, file);
+}
+
+void dump_writer_get_stats(dump_writer_t *w, dump_writer_stats_t *stats)
+{
+    (void)w;
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* THREADS */
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define TEST_FILE "dump_writer_test.tmp"
+
+/// Write a header and the data in odd chunks through a writer, returns the number of differences in the file.
+static int write_compare(int flags, char const *header, uint8_t const *data, size_t len)
+{
+    FILE *file = fopen(TEST_FILE, "wb");
+    if (!file)
+        return -1;
+    fputs(header, file); // buffered by stdio before the writer is added
+    dump_writer_t *w = flags >= 0 ? dump_writer_create(4 * DUMP_WRITER_BLOCK, flags) : NULL;
+    dump_writer_add(w, file, TEST_FILE);
+    size_t ret = 0;
+    for (size_t pos = 0; pos < len; pos += 77777) {
+        size_t n = len - pos < 77777 ? len - pos : 77777;
+        ret += dump_writer_write(w, file, &data[pos], n);
+    }
+    dump_writer_remove(w, file);
+    dump_writer_free(w);
+    fclose(file);
+
+    int diffs = ret != len;
+    file = fopen(TEST_FILE, "rb");
+    if (!file)
+        return -1;
+    char buf_header[16];
+    size_t header_len = strlen(header);
+    diffs += fread(buf_header, 1, header_len, file) != header_len || memcmp(buf_header, header, header_len);
+    uint8_t buf[4096];
+    size_t pos = 0;
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        if (pos + n > len || memcmp(buf, &data[pos], n))
+            ++diffs;
+        pos += n;
+    }
+    fclose(file);
+    remove(TEST_FILE);
+    return diffs + (pos != len);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    enum { LEN = 10 * DUMP_WRITER_BLOCK + 12345 };
+    uint8_t *data = malloc(LEN);
+    if (!data)
+        FATAL_MALLOC("main()");
+    srand(433);
+    for (unsigned i = 0; i < LEN; ++i)
+        data[i] = (uint8_t)rand();
+
+#ifdef THREADS
+    fprintf(stderr, "dump_writer:: waiting for blocks\n");
+    ASSERT_EQUALS(write_compare(DUMP_WRITER_WAIT, "HEADER", data, LEN), 0);
+
+    fprintf(stderr, "dump_writer:: dropping the page cache\n");
+    ASSERT_EQUALS(write_compare(DUMP_WRITER_WAIT | DUMP_WRITER_DONTNEED, "HEADER", data, LEN), 0);
+
+    fprintf(stderr, "dump_writer:: direct I/O\n");
+    ASSERT_EQUALS(write_compare(DUMP_WRITER_WAIT | DUMP_WRITER_DIRECT, "", data, LEN), 0);
+
+    fprintf(stderr, "dump_writer:: direct I/O after an unaligned header\n");
+    ASSERT_EQUALS(write_compare(DUMP_WRITER_WAIT | DUMP_WRITER_DIRECT, "HEADER", data, LEN), 0);
+
+    fprintf(stderr, "dump_writer:: a short file\n");
+    ASSERT_EQUALS(write_compare(0, "HEADER", data, 1000), 0);
+#endif
+
+    fprintf(stderr, "dump_writer:: writing directly without a writer\n");
+    ASSERT_EQUALS(write_compare(-1, "HEADER", data, LEN), 0);
+
+    free(data);
+    fprintf(stderr, "dump_writer:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+#endif /* _TEST */
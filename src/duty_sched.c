@@ -0,0 +1,356 @@
+/** @file
+    Duty cycled reception, sleep between the expected reports of periodic sensors.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "duty_sched.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define REPEAT_S 2.0         ///< events of a sensor closer than this are one report
+#define REPEAT_LISTEN_S 1.0  ///< listen this long after an expected report for its repeats
+#define DUE_MARGIN 0.02      ///< least margin of an expected report, of the report interval
+#define PERIOD_TOLERANCE 0.25
+#define IDLE_CHECK_S 10.0    ///< recheck interval while awake without windows
+
+typedef struct sensor {
+    uint32_t key;   ///< 0 if unused
+    double last;    ///< time of the last report
+    double period;  ///< estimated report interval, 0 if unknown
+    double checked; ///< the last expected report counted as received or missed
+    unsigned misses; ///< expected reports missed in a row
+} sensor_t;
+
+struct duty_sched {
+    double learn;
+    double margin;
+    double learn_until; ///< learning until this time, 0 before the first decision
+    double since;       ///< time of the last decision
+    int awake;
+    double awake_total;
+    double asleep_total;
+    unsigned sleeps;
+    unsigned reports;
+    unsigned missed;
+    sensor_t sensors[DUTY_SCHED_SENSORS];
+#ifdef THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+duty_sched_t *duty_sched_create(double learn, double margin)
+{
+    duty_sched_t *sched = calloc(1, sizeof(*sched));
+    if (!sched) {
+        WARN_CALLOC("duty_sched_create()");
+        return NULL;
+    }
+    sched->learn  = learn;
+    sched->margin = margin;
+    sched->awake  = 1;
+#ifdef THREADS
+    pthread_mutex_init(&sched->lock, NULL);
+#endif
+    return sched;
+}
+
+void duty_sched_free(duty_sched_t *sched)
+{
+    if (!sched)
+        return;
+#ifdef THREADS
+    pthread_mutex_destroy(&sched->lock);
+#endif
+    free(sched);
+}
+
+static void sched_lock(duty_sched_t *sched)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&sched->lock);
+#else
+    (void)sched;
+#endif
+}
+
+static void sched_unlock(duty_sched_t *sched)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&sched->lock);
+#else
+    (void)sched;
+#endif
+}
+
+/// The margin around an expected report, wider after each miss.
+static double sensor_margin(duty_sched_t const *sched, sensor_t const *s)
+{
+    double margin = s->period * DUE_MARGIN;
+    if (margin < sched->margin)
+        margin = sched->margin;
+    return margin * (1 + s->misses);
+}
+
+/// Get the next expected report whose window did not end before now, 0 if unknown.
+static double sensor_due(duty_sched_t const *sched, sensor_t const *s, double now)
+{
+    if (!s->key || s->period <= 0)
+        return 0;
+    double end = sensor_margin(sched, s) + REPEAT_LISTEN_S;
+    int k = (int)((now - end - s->last) / s->period) + 1;
+    if (k < 1)
+        k = 1;
+    return s->last + k * s->period;
+}
+
+void duty_sched_event(duty_sched_t *sched, uint32_t key, double now)
+{
+    if (!key)
+        return;
+    sched_lock(sched);
+
+    // find the sensor, or the slot of the longest unseen one
+    sensor_t *s = NULL;
+    sensor_t *oldest = &sched->sensors[0];
+    for (unsigned i = 0; i < DUTY_SCHED_SENSORS; ++i) {
+        if (sched->sensors[i].key == key) {
+            s = &sched->sensors[i];
+            break;
+        }
+        if (!sched->sensors[i].key || (oldest->key && sched->sensors[i].last < oldest->last))
+            oldest = &sched->sensors[i];
+    }
+    if (!s) {
+        *oldest = (sensor_t){.key = key, .last = now};
+        sched_unlock(sched);
+        return;
+    }
+
+    double dt = now - s->last;
+    if (dt < REPEAT_S) {
+        sched_unlock(sched);
+        return; // a repeat of the same report
+    }
+    // reports might have been missed while asleep
+    int n = s->period > 0 ? (int)(dt / s->period + 0.5) : 0;
+    if (n >= 1 && dt / n - s->period <= PERIOD_TOLERANCE * s->period && s->period - dt / n <= PERIOD_TOLERANCE * s->period) {
+        s->period = 0.75 * s->period + 0.25 * dt / n;
+        sched->reports++;
+        s->misses = 0;
+    }
+    else {
+        s->period = dt;
+    }
+    s->last    = now;
+    s->checked = now;
+    sched_unlock(sched);
+}
+
+int duty_sched_next(duty_sched_t *sched, double now, double *next)
+{
+    sched_lock(sched);
+    if (sched->learn_until == 0) {
+        sched->learn_until = now + sched->learn;
+        sched->since       = now;
+    }
+    if (now > sched->since) {
+        if (sched->awake)
+            sched->awake_total += now - sched->since;
+        else
+            sched->asleep_total += now - sched->since;
+    }
+    sched->since = now;
+
+    // count the expected reports that did not arrive, forget the sensors missed too often
+    for (unsigned i = 0; i < DUTY_SCHED_SENSORS; ++i) {
+        sensor_t *s = &sched->sensors[i];
+        if (!s->key || s->period <= 0 || now < sched->learn_until)
+            continue;
+        double end = sensor_margin(sched, s) + REPEAT_LISTEN_S;
+        int k = (int)((now - end - s->last) / s->period);
+        double due = s->last + k * s->period;
+        if (k < 1 || due <= s->checked)
+            continue;
+        s->checked = due;
+        s->misses++;
+        sched->missed++;
+        if (s->misses >= DUTY_SCHED_MISSES) {
+            *s = (sensor_t){0};
+            sched->learn_until = now + sched->learn;
+        }
+    }
+
+    int awake = 1;
+    *next = now + IDLE_CHECK_S;
+    if (now < sched->learn_until) {
+        *next = sched->learn_until;
+    }
+    else {
+        // the windows around the expected reports
+        double awake_until = 0;
+        double next_start  = 0;
+        for (unsigned i = 0; i < DUTY_SCHED_SENSORS; ++i) {
+            sensor_t const *s = &sched->sensors[i];
+            double due = sensor_due(sched, s, now);
+            if (!due)
+                continue;
+            double margin = sensor_margin(sched, s);
+            double start  = due - margin - DUTY_SCHED_WAKE_S;
+            double end    = due + margin + REPEAT_LISTEN_S;
+            if (start <= now && (!awake_until || end < awake_until))
+                awake_until = end;
+            else if (start > now && (!next_start || start < next_start))
+                next_start = start;
+        }
+        if (awake_until) {
+            *next = awake_until;
+        }
+        else if (next_start) {
+            *next = next_start;
+            awake = next_start - now < DUTY_SCHED_SLEEP_MIN_S; // not worth a restart
+        }
+    }
+
+    if (sched->awake && !awake)
+        sched->sleeps++;
+    sched->awake = awake;
+    sched_unlock(sched);
+    return awake;
+}
+
+void duty_sched_get_stats(duty_sched_t *sched, double now, duty_sched_stats_t *stats)
+{
+    *stats = (duty_sched_stats_t){0};
+    sched_lock(sched);
+    stats->awake    = sched->awake_total;
+    stats->asleep   = sched->asleep_total;
+    if (sched->learn_until != 0 && now > sched->since) {
+        if (sched->awake)
+            stats->awake += now - sched->since;
+        else
+            stats->asleep += now - sched->since;
+    }
+    stats->learning = sched->learn_until == 0 || now < sched->learn_until;
+    stats->sleeps   = sched->sleeps;
+    stats->reports  = sched->reports;
+    stats->missed   = sched->missed;
+    for (unsigned i = 0; i < DUTY_SCHED_SENSORS; ++i) {
+        if (sched->sensors[i].key && sched->sensors[i].period > 0)
+            stats->sensors++;
+    }
+    sched_unlock(sched);
+}
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+typedef struct sim_sensor {
+    uint32_t key;
+    double period;
+    double next; ///< time of the next report
+    unsigned sent;
+    unsigned captured;
+} sim_sensor_t;
+
+/// Simulate sensors for @p duration s in steps of 0.1 s, the receiver needs DUTY_SCHED_WAKE_S to restart.
+static double simulate(duty_sched_t *sched, sim_sensor_t *sensors, unsigned n, double from, double duration)
+{
+    double next_decision = from;
+    double ready_at      = from;
+    int awake            = 1;
+    unsigned jitter      = 1;
+    for (double now = from; now < from + duration; now += 0.1) {
+        if (now >= next_decision) {
+            int was_awake = awake;
+            awake = duty_sched_next(sched, now, &next_decision);
+            if (awake && !was_awake)
+                ready_at = now + DUTY_SCHED_WAKE_S * 0.8;
+        }
+        for (unsigned i = 0; i < n; ++i) {
+            sim_sensor_t *s = &sensors[i];
+            if (now < s->next)
+                continue;
+            s->sent++;
+            if (awake && now >= ready_at) {
+                s->captured++;
+                duty_sched_event(sched, s->key, now);
+                duty_sched_event(sched, s->key, now + 0.3); // a repeat
+            }
+            // a jitter of up to +-0.2 s
+            jitter = jitter * 1103515245 + 12345;
+            s->next += s->period + ((int)((jitter >> 16) % 41) - 20) / 100.0;
+        }
+    }
+    duty_sched_stats_t stats;
+    duty_sched_get_stats(sched, from + duration, &stats);
+    return stats.awake / (stats.awake + stats.asleep);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    duty_sched_stats_t stats;
+    double next;
+
+    fprintf(stderr, "duty_sched:: stay awake while learning and without sensors\n");
+    duty_sched_t *sched = duty_sched_create(60.0, 0.5);
+    ASSERT_EQUALS(sched != NULL, 1);
+    ASSERT_EQUALS(duty_sched_next(sched, 1000.0, &next), 1);
+    ASSERT_EQUALS(next == 1060.0, 1);
+    ASSERT_EQUALS(duty_sched_next(sched, 1100.0, &next), 1);
+    duty_sched_get_stats(sched, 1100.0, &stats);
+    ASSERT_EQUALS((int)stats.sensors, 0);
+    ASSERT_EQUALS((int)stats.learning, 0);
+    duty_sched_free(sched);
+
+    fprintf(stderr, "duty_sched:: sleep between the reports of two sensors\n");
+    sched = duty_sched_create(120.0, 0.5);
+    sim_sensor_t sensors[2] = {
+            {.key = 0x0f0, .period = 16.0, .next = 3.0},
+            {.key = 0xa71, .period = 30.0, .next = 11.0},
+    };
+    simulate(sched, sensors, 2, 0.0, 200.0);
+    duty_sched_get_stats(sched, 200.0, &stats);
+    ASSERT_EQUALS((int)stats.sensors, 2);
+    for (unsigned i = 0; i < 2; ++i)
+        sensors[i].sent = sensors[i].captured = 0;
+    double duty = simulate(sched, sensors, 2, 200.0, 3600.0);
+    fprintf(stderr, "duty_sched:: awake %.0f %%, captured %u of %u and %u of %u\n", duty * 100,
+            sensors[0].captured, sensors[0].sent, sensors[1].captured, sensors[1].sent);
+    ASSERT_EQUALS(duty < 0.45, 1);
+    ASSERT_EQUALS(sensors[0].captured >= sensors[0].sent * 95 / 100, 1);
+    ASSERT_EQUALS(sensors[1].captured >= sensors[1].sent * 95 / 100, 1);
+
+    fprintf(stderr, "duty_sched:: relearn after losing a sensor\n");
+    sensors[1].next = 1e9; // gone
+    simulate(sched, sensors, 2, 3800.0, 300.0);
+    duty_sched_get_stats(sched, 4100.0, &stats);
+    ASSERT_EQUALS((int)stats.sensors, 1);
+    ASSERT_EQUALS(stats.missed >= DUTY_SCHED_MISSES, 1);
+    duty_sched_free(sched);
+
+    fprintf(stderr, "duty_sched:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,626 @@
+/** @file
+    Append-only log of records in memory-mapped segment files, one writer and any number of readers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "event_log.h"
+#include "compat_atomic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define EVENT_LOG_SEGMENT_MIN 4096
+#define EVENT_LOG_SEGMENT_MAX (1u << 30)
+#define RECORD_HEADER_LEN 16
+#define SEGMENT_SUFFIX ".evlog"
+#define SEGMENT_NAME_LEN (16 + sizeof(SEGMENT_SUFFIX) - 1)
+
+/// The header of each record in the data area.
+typedef struct record_header {
+    uint64_t seq;
+    uint32_t len;
+    uint32_t pad;
+} record_header_t;
+
+static void segment_path(char *path, size_t size, char const *dir, uint64_t first)
+{
+    snprintf(path, size, "%s/%016llx" SEGMENT_SUFFIX, dir, (unsigned long long)first);
+}
+
+static int cmp_seq(void const *a, void const *b)
+{
+    uint64_t x = *(uint64_t const *)a;
+    uint64_t y = *(uint64_t const *)b;
+    return x < y ? -1 : x > y;
+}
+
+/// The first sequence numbers of the segments in @p dir, sorted, returns the count, -1 on alloc failure.
+static int list_segments(char const *dir, uint64_t **firsts)
+{
+    *firsts = NULL;
+    DIR *d  = opendir(dir);
+    if (!d)
+        return 0;
+    int len  = 0;
+    int size = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        char const *name = ent->d_name;
+        char *end;
+        if (strlen(name) != SEGMENT_NAME_LEN || strcmp(name + 16, SEGMENT_SUFFIX))
+            continue;
+        unsigned long long first = strtoull(name, &end, 16);
+        if (end != name + 16 || !first)
+            continue;
+        if (len == size) {
+            size = size ? size * 2 : 16;
+            uint64_t *grown = realloc(*firsts, size * sizeof(*grown));
+            if (!grown) {
+                fprintf(stderr, "event_log: realloc() failed\n");
+                free(*firsts);
+                *firsts = NULL;
+                closedir(d);
+                return -1;
+            }
+            *firsts = grown;
+        }
+        (*firsts)[len++] = first;
+    }
+    closedir(d);
+    if (len)
+        qsort(*firsts, len, sizeof(**firsts), cmp_seq);
+    return len;
+}
+
+/// Map a segment file, returns the header if it is a ready segment that starts at @p first, NULL otherwise.
+static event_log_header_t *segment_map(char const *path, uint64_t first, int writable, size_t *map_len)
+{
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (!fstat(fd, &st) && (size_t)st.st_size > sizeof(event_log_header_t))
+        map = mmap(NULL, (size_t)st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    event_log_header_t *header = map;
+    uint32_t magic = atomic_get(&header->magic);
+    if (magic != EVENT_LOG_MAGIC
+            || header->version != EVENT_LOG_VERSION
+            || header->header_size < sizeof(*header)
+            || header->first_seq != first
+            || header->count > header->index_len
+            || header->end > header->data_size
+            || header->header_size + (uint64_t)header->index_len * 4 > (uint64_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    *map_len = (size_t)st.st_size;
+    return header;
+}
+
+/* Writer */
+
+struct event_log {
+    char *dir;
+    size_t segment_size;
+    unsigned segments_max;
+    unsigned segments;          ///< segment files in the directory
+    event_log_header_t *header; ///< the last segment
+    uint32_t *index;
+    uint8_t *data;
+    size_t map_len;
+    uint64_t seq;               ///< sequence number of the last record
+};
+
+static void writer_attach(event_log_t *log, event_log_header_t *header, size_t map_len)
+{
+    log->header  = header;
+    log->index   = (uint32_t *)((uint8_t *)header + header->header_size);
+    log->data    = (uint8_t *)(log->index + header->index_len);
+    log->map_len = map_len;
+}
+
+/// Start a new segment at sequence number @p first, returns 0 on success.
+static int segment_create(event_log_t *log, uint64_t first)
+{
+    char path[1024];
+    segment_path(path, sizeof(path), log->dir, first);
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("event_log");
+        return -1;
+    }
+    void *map = MAP_FAILED;
+    if (!ftruncate(fd, (off_t)log->segment_size))
+        map = mmap(NULL, log->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("event_log");
+        unlink(path);
+        return -1;
+    }
+
+    // an index entry for every 64 data bytes, an even count keeps the data 8 byte aligned
+    size_t room = log->segment_size - sizeof(event_log_header_t);
+    uint32_t index_len = (uint32_t)(room / (64 + 4)) & ~1u;
+
+    event_log_header_t *header = map;
+    header->version     = EVENT_LOG_VERSION;
+    header->header_size = sizeof(event_log_header_t);
+    header->index_len   = index_len;
+    header->first_seq   = first;
+    header->data_size   = (room - (size_t)index_len * 4) & ~(size_t)7;
+    // the readers check the magic first, the other fields are set before
+    atomic_set(&header->magic, EVENT_LOG_MAGIC);
+    writer_attach(log, header, log->segment_size);
+    log->segments++;
+    return 0;
+}
+
+/// Unmap the last segment, a closed segment is trimmed to the data used.
+static void segment_finish(event_log_t *log, int closed)
+{
+    event_log_header_t *header = log->header;
+    if (!header)
+        return;
+    char path[1024];
+    segment_path(path, sizeof(path), log->dir, header->first_seq);
+    size_t used = (size_t)(log->data - (uint8_t *)header) + (size_t)header->end;
+    if (closed)
+        atomic_set(&header->closed, 1);
+    msync(header, log->map_len, MS_SYNC);
+    munmap(header, log->map_len);
+    log->header = NULL;
+    if (closed) {
+        // the readers only access the data used, a longer mapping stays valid
+        int fd = open(path, O_RDWR);
+        if (fd >= 0) {
+            if (ftruncate(fd, (off_t)used))
+                perror("event_log");
+            close(fd);
+        }
+    }
+}
+
+/// Remove the oldest segments above the limit.
+static void remove_segments(event_log_t *log)
+{
+    uint64_t *firsts;
+    int len = list_segments(log->dir, &firsts);
+    if (len < 0)
+        return;
+    log->segments = (unsigned)len;
+    for (int i = 0; i < len && log->segments > log->segments_max; ++i) {
+        char path[1024];
+        segment_path(path, sizeof(path), log->dir, firsts[i]);
+        if (!unlink(path))
+            log->segments--;
+    }
+    free(firsts);
+}
+
+event_log_t *event_log_open(char const *dir, size_t segment_size, unsigned segments_max)
+{
+    if (mkdir(dir, 0755) && errno != EEXIST) {
+        perror("event_log");
+        return NULL;
+    }
+
+    event_log_t *log = calloc(1, sizeof(*log));
+    if (!log) {
+        fprintf(stderr, "event_log: calloc() failed\n");
+        return NULL;
+    }
+    log->dir = strdup(dir);
+    if (!log->dir) {
+        fprintf(stderr, "event_log: strdup() failed\n");
+        free(log);
+        return NULL;
+    }
+    if (segment_size < EVENT_LOG_SEGMENT_MIN)
+        segment_size = EVENT_LOG_SEGMENT_MIN;
+    if (segment_size > EVENT_LOG_SEGMENT_MAX)
+        segment_size = EVENT_LOG_SEGMENT_MAX;
+    log->segment_size = segment_size;
+    log->segments_max = segments_max < 2 ? 2 : segments_max;
+
+    uint64_t *firsts;
+    int len = list_segments(dir, &firsts);
+    if (len < 0) {
+        free(log->dir);
+        free(log);
+        return NULL;
+    }
+    log->segments = (unsigned)len;
+
+    uint64_t next = 1;
+    if (len) {
+        // continue after the last complete record of the previous writer
+        uint64_t first = firsts[len - 1];
+        char path[1024];
+        segment_path(path, sizeof(path), dir, first);
+        size_t map_len;
+        event_log_header_t *header = segment_map(path, first, 1, &map_len);
+        next = first;
+        if (header) {
+            uint64_t count = header->count;
+            writer_attach(log, header, map_len);
+            log->seq = first + count - 1;
+            next     = first + count;
+            if (header->closed)
+                segment_finish(log, 1);
+        }
+        else {
+            unlink(path); // not a ready segment, start it over
+            log->segments--;
+        }
+    }
+    free(firsts);
+
+    if (!log->header && segment_create(log, next)) {
+        free(log->dir);
+        free(log);
+        return NULL;
+    }
+    log->seq = next - 1;
+    remove_segments(log);
+    return log;
+}
+
+uint64_t event_log_append(event_log_t *log, void const *buf, size_t len)
+{
+    uint64_t total = RECORD_HEADER_LEN + ((len + 7) & ~(uint64_t)7);
+    event_log_header_t *header = log->header;
+    if (!header || total > header->data_size / 4)
+        return 0;
+
+    if (header->count >= header->index_len || header->end + total > header->data_size) {
+        segment_finish(log, 1);
+        if (segment_create(log, log->seq + 1))
+            return 0;
+        remove_segments(log);
+        header = log->header;
+    }
+
+    record_header_t rec = {.seq = log->seq + 1, .len = (uint32_t)len};
+    uint64_t end        = header->end;
+    memcpy(log->data + end, &rec, sizeof(rec));
+    memcpy(log->data + end + RECORD_HEADER_LEN, buf, len);
+    log->index[header->count] = (uint32_t)end;
+
+    atomic_set_relaxed(&header->end, end + total);
+    atomic_set(&header->count, header->count + 1);
+    log->seq = rec.seq;
+    return log->seq;
+}
+
+uint64_t event_log_last(event_log_t const *log)
+{
+    return log->seq;
+}
+
+unsigned event_log_segments(event_log_t const *log)
+{
+    return log->segments;
+}
+
+void event_log_close(event_log_t *log)
+{
+    if (!log)
+        return;
+    segment_finish(log, 0);
+    free(log->dir);
+    free(log);
+}
+
+/* Reader */
+
+struct reader_segment {
+    uint64_t first;
+    event_log_header_t const *header;
+    uint32_t const *index;
+    uint8_t const *data;
+    size_t avail; ///< data bytes in the mapping
+    size_t map_len;
+};
+
+struct event_log_reader {
+    char *dir;
+    unsigned len;
+    struct reader_segment *segments; ///< by first sequence number
+};
+
+/// Update the segments from the directory, keeps the mappings of the segments still there.
+static void reader_rescan(event_log_reader_t *reader)
+{
+    uint64_t *firsts;
+    int len = list_segments(reader->dir, &firsts);
+    if (len < 0)
+        return;
+    struct reader_segment *segments = calloc(len ? len : 1, sizeof(*segments));
+    if (!segments) {
+        fprintf(stderr, "event_log: calloc() failed\n");
+        free(firsts);
+        return;
+    }
+
+    unsigned num = 0;
+    unsigned old = 0;
+    for (int i = 0; i < len; ++i) {
+        for (; old < reader->len && reader->segments[old].first < firsts[i]; ++old)
+            munmap((void *)reader->segments[old].header, reader->segments[old].map_len);
+        if (old < reader->len && reader->segments[old].first == firsts[i]) {
+            segments[num++] = reader->segments[old++];
+            continue;
+        }
+        char path[1024];
+        segment_path(path, sizeof(path), reader->dir, firsts[i]);
+        size_t map_len;
+        event_log_header_t const *header = segment_map(path, firsts[i], 0, &map_len);
+        if (!header)
+            break; // a segment being created, the later ones follow it
+        struct reader_segment *seg = &segments[num++];
+        seg->first   = firsts[i];
+        seg->header  = header;
+        seg->index   = (uint32_t const *)((uint8_t const *)header + header->header_size);
+        seg->data    = (uint8_t const *)(seg->index + header->index_len);
+        seg->avail   = map_len - (size_t)(seg->data - (uint8_t const *)header);
+        seg->map_len = map_len;
+    }
+    for (; old < reader->len; ++old)
+        munmap((void *)reader->segments[old].header, reader->segments[old].map_len);
+    free(firsts);
+    free(reader->segments);
+    reader->segments = segments;
+    reader->len      = num;
+}
+
+event_log_reader_t *event_log_reader_open(char const *dir)
+{
+    event_log_reader_t *reader = calloc(1, sizeof(*reader));
+    if (!reader) {
+        fprintf(stderr, "event_log: calloc() failed\n");
+        return NULL;
+    }
+    reader->dir = strdup(dir);
+    if (!reader->dir) {
+        fprintf(stderr, "event_log: strdup() failed\n");
+        free(reader);
+        return NULL;
+    }
+    reader_rescan(reader);
+    return reader;
+}
+
+long event_log_get(event_log_reader_t *reader, uint64_t seq, void const **buf)
+{
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass)
+            reader_rescan(reader);
+        if (!reader->len)
+            continue;
+        if (seq < reader->segments[0].first)
+            return EVENT_LOG_GONE; // the segments are only removed from the start
+
+        // the last segment that starts at or before seq
+        unsigned lo = 0;
+        unsigned hi = reader->len;
+        while (hi - lo > 1) {
+            unsigned mid = (lo + hi) / 2;
+            if (reader->segments[mid].first <= seq)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        struct reader_segment const *seg = &reader->segments[lo];
+        uint64_t count = atomic_get(&seg->header->count);
+        if (seq - seg->first < count && seq - seg->first < seg->header->index_len) {
+            uint64_t off = seg->index[seq - seg->first];
+            record_header_t rec;
+            if (off % 8 || off + RECORD_HEADER_LEN > seg->avail)
+                return EVENT_LOG_GONE;
+            memcpy(&rec, seg->data + off, sizeof(rec));
+            if (rec.seq != seq || off + RECORD_HEADER_LEN + rec.len > seg->avail)
+                return EVENT_LOG_GONE;
+            *buf = seg->data + off + RECORD_HEADER_LEN;
+            return (long)rec.len;
+        }
+        // a later record is in a segment not mapped yet, if this one is closed
+        if (lo + 1 < reader->len || !atomic_get(&seg->header->closed))
+            return EVENT_LOG_EMPTY;
+    }
+    return EVENT_LOG_EMPTY;
+}
+
+uint64_t event_log_first(event_log_reader_t *reader)
+{
+    reader_rescan(reader);
+    return reader->len ? reader->segments[0].first : 1;
+}
+
+void event_log_reader_close(event_log_reader_t *reader)
+{
+    if (!reader)
+        return;
+    for (unsigned i = 0; i < reader->len; ++i)
+        munmap((void *)reader->segments[i].header, reader->segments[i].map_len);
+    free(reader->segments);
+    free(reader->dir);
+    free(reader);
+}
+
+#else /* _WIN32 */
+
+struct event_log {
+    int unused;
+};
+
+struct event_log_reader {
+    int unused;
+};
+
+event_log_t *event_log_open(char const *dir, size_t segment_size, unsigned segments_max)
+{
+    (void)dir;
+    (void)segment_size;
+    (void)segments_max;
+    fprintf(stderr, "event_log: memory-mapped segments are not supported on this platform\n");
+    return NULL;
+}
+
+uint64_t event_log_append(event_log_t *log, void const *buf, size_t len)
+{
+    (void)log;
+    (void)buf;
+    (void)len;
+    return 0;
+}
+
+uint64_t event_log_last(event_log_t const *log)
+{
+    (void)log;
+    return 0;
+}
+
+unsigned event_log_segments(event_log_t const *log)
+{
+    (void)log;
+    return 0;
+}
+
+void event_log_close(event_log_t *log)
+{
+    (void)log;
+}
+
+event_log_reader_t *event_log_reader_open(char const *dir)
+{
+    (void)dir;
+    return NULL;
+}
+
+long event_log_get(event_log_reader_t *reader, uint64_t seq, void const **buf)
+{
+    (void)reader;
+    (void)seq;
+    (void)buf;
+    return EVENT_LOG_EMPTY;
+}
+
+uint64_t event_log_first(event_log_reader_t *reader)
+{
+    (void)reader;
+    return 1;
+}
+
+void event_log_reader_close(event_log_reader_t *reader)
+{
+    (void)reader;
+}
+
+#endif /* _WIN32 */
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+#ifndef _WIN32
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/rtl_433_test_%d", (int)getpid());
+    char buf[1024];
+    void const *rec;
+
+    fprintf(stderr, "event_log:: read what was appended\n");
+    event_log_t *log = event_log_open(dir, 4096, 3);
+    ASSERT_EQUALS(log != NULL, 1);
+    if (!log)
+        return 1;
+    event_log_reader_t *reader = event_log_reader_open(dir);
+    ASSERT_EQUALS(reader != NULL, 1);
+    if (!reader)
+        return 1;
+    ASSERT_EQUALS(event_log_get(reader, 1, &rec), EVENT_LOG_EMPTY);
+    ASSERT_EQUALS(event_log_append(log, "{\"a\":1}", 7), 1);
+    ASSERT_EQUALS(event_log_append(log, "{\"bb\":22}", 9), 2);
+    ASSERT_EQUALS(event_log_get(reader, 2, &rec), 9);
+    ASSERT_EQUALS(memcmp(rec, "{\"bb\":22}", 9), 0);
+    ASSERT_EQUALS(event_log_get(reader, 1, &rec), 7);
+    ASSERT_EQUALS(memcmp(rec, "{\"a\":1}", 7), 0);
+    ASSERT_EQUALS(event_log_get(reader, 3, &rec), EVENT_LOG_EMPTY);
+    memset(buf, 'x', sizeof(buf));
+    ASSERT_EQUALS(event_log_append(log, buf, 1024), 0);
+
+    fprintf(stderr, "event_log:: records continue in new segments\n");
+    for (int i = 0; i < 100; ++i)
+        event_log_append(log, buf, 100 + i);
+    ASSERT_EQUALS(event_log_last(log), 102);
+    ASSERT_EQUALS(event_log_segments(log), 3);
+    ASSERT_EQUALS(event_log_get(reader, 102, &rec), 199);
+    ASSERT_EQUALS(memcmp(rec, buf, 199), 0);
+
+    fprintf(stderr, "event_log:: the oldest segments are removed\n");
+    uint64_t first = event_log_first(reader);
+    ASSERT_EQUALS(first > 2, 1);
+    ASSERT_EQUALS(event_log_get(reader, 1, &rec), EVENT_LOG_GONE);
+    ASSERT_EQUALS(event_log_get(reader, first, &rec) > 0, 1);
+
+    fprintf(stderr, "event_log:: a new writer continues after the last record\n");
+    event_log_close(log);
+    log = event_log_open(dir, 4096, 3);
+    ASSERT_EQUALS(log != NULL, 1);
+    if (!log)
+        return 1;
+    ASSERT_EQUALS(event_log_last(log), 102);
+    ASSERT_EQUALS(event_log_append(log, "{}", 2), 103);
+    ASSERT_EQUALS(event_log_get(reader, 103, &rec), 2);
+    event_log_close(log);
+    event_log_reader_close(reader);
+
+    uint64_t *firsts;
+    int len = list_segments(dir, &firsts);
+    for (int i = 0; i < len; ++i) {
+        char path[1024];
+        segment_path(path, sizeof(path), dir, firsts[i]);
+        unlink(path);
+    }
+    free(firsts);
+    rmdir(dir);
+#endif
+
+    fprintf(stderr, "event_log:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
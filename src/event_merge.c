@@ -0,0 +1,293 @@
+/** @file
+    Merge the copies of an event heard by several receivers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "event_merge.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUCKETS_MIN 64 ///< initial size of the hash table, grows when the chains get longer than 2
+
+typedef struct merge_entry {
+    struct merge_entry *chain; ///< next entry of the hash bucket
+    struct merge_entry *next;  ///< next entry in the order first heard
+    uint32_t hash;
+    double first;              ///< time the first copy was heard
+    float rssi_db;             ///< RSSI of the held copy
+    data_t *data;              ///< the copy with the best RSSI
+    unsigned receivers_len;
+    char *receivers[EVENT_MERGE_RECEIVERS];
+} merge_entry_t;
+
+struct event_merge {
+    double window;
+    unsigned buckets_len;      ///< a power of two
+    merge_entry_t **buckets;
+    merge_entry_t *head;       ///< oldest entry, expires first
+    merge_entry_t *tail;
+    merge_entry_t *spare;      ///< expired entries, reused for the next events
+    unsigned held;
+};
+
+event_merge_t *event_merge_create(unsigned window_ms)
+{
+    event_merge_t *merge = calloc(1, sizeof(*merge));
+    if (!merge) {
+        WARN_CALLOC("event_merge_create()");
+        return NULL;
+    }
+    merge->buckets = calloc(BUCKETS_MIN, sizeof(*merge->buckets));
+    if (!merge->buckets) {
+        WARN_CALLOC("event_merge_create()");
+        free(merge);
+        return NULL;
+    }
+    merge->buckets_len = BUCKETS_MIN;
+    merge->window      = window_ms / 1000.0;
+    return merge;
+}
+
+static void entry_clear(merge_entry_t *entry)
+{
+    data_free(entry->data);
+    entry->data = NULL;
+    for (unsigned i = 0; i < entry->receivers_len; ++i)
+        free(entry->receivers[i]);
+    entry->receivers_len = 0;
+}
+
+static void entry_list_free(merge_entry_t *entry)
+{
+    while (entry) {
+        merge_entry_t *next = entry->next;
+        entry_clear(entry);
+        free(entry);
+        entry = next;
+    }
+}
+
+void event_merge_free(event_merge_t *merge)
+{
+    if (!merge)
+        return;
+    entry_list_free(merge->head);
+    entry_list_free(merge->spare);
+    free(merge->buckets);
+    free(merge);
+}
+
+/// Double the hash table, the entries keep their order in the queue.
+static void grow_buckets(event_merge_t *merge)
+{
+    unsigned len = merge->buckets_len * 2;
+    merge_entry_t **buckets = calloc(len, sizeof(*buckets));
+    if (!buckets) {
+        WARN_CALLOC("event_merge_add()");
+        return; // longer chains, still correct
+    }
+    for (merge_entry_t *e = merge->head; e; e = e->next) {
+        merge_entry_t **bucket = &buckets[e->hash & (len - 1)];
+        e->chain = *bucket;
+        *bucket  = e;
+    }
+    free(merge->buckets);
+    merge->buckets     = buckets;
+    merge->buckets_len = len;
+}
+
+static void add_receiver(merge_entry_t *entry, char const *receiver)
+{
+    if (!receiver || entry->receivers_len >= EVENT_MERGE_RECEIVERS)
+        return;
+    // a receiver may decode the repeats of a transmission as several copies
+    for (unsigned i = 0; i < entry->receivers_len; ++i) {
+        if (!strcmp(entry->receivers[i], receiver))
+            return;
+    }
+    char *name = strdup(receiver);
+    if (!name) {
+        WARN_STRDUP("event_merge_add()");
+        return;
+    }
+    entry->receivers[entry->receivers_len++] = name;
+}
+
+int event_merge_add(event_merge_t *merge, uint32_t hash, data_t *data, char const *receiver, float rssi_db, double now)
+{
+    merge_entry_t **bucket = &merge->buckets[hash & (merge->buckets_len - 1)];
+    for (merge_entry_t *e = *bucket; e; e = e->chain) {
+        // an entry past its window is a new transmission, even if not emitted yet
+        if (e->hash != hash || now - e->first >= merge->window)
+            continue;
+        add_receiver(e, receiver);
+        if (rssi_db > e->rssi_db) {
+            data_free(e->data);
+            e->data    = data;
+            e->rssi_db = rssi_db;
+        }
+        else {
+            data_free(data);
+        }
+        return 1;
+    }
+
+    merge_entry_t *entry = merge->spare;
+    if (entry) {
+        merge->spare = entry->next;
+    }
+    else {
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+            WARN_CALLOC("event_merge_add()");
+            data_free(data);
+            return 0;
+        }
+    }
+    entry->hash    = hash;
+    entry->first   = now;
+    entry->rssi_db = rssi_db;
+    entry->data    = data;
+    entry->next    = NULL;
+    entry->chain   = *bucket;
+    *bucket        = entry;
+    add_receiver(entry, receiver);
+
+    if (merge->tail)
+        merge->tail->next = entry;
+    else
+        merge->head = entry;
+    merge->tail = entry;
+
+    if (++merge->held > merge->buckets_len * 2)
+        grow_buckets(merge);
+    return 0;
+}
+
+unsigned event_merge_expire(event_merge_t *merge, double now, event_merge_emit_fn emit, void *ctx)
+{
+    unsigned n = 0;
+    merge_entry_t *entry;
+    while ((entry = merge->head) && (now < 0.0 || now - entry->first >= merge->window)) {
+        merge->head = entry->next;
+        if (!merge->head)
+            merge->tail = NULL;
+        merge->held--;
+
+        // the oldest entry is the last the chain reaches, later entries are pushed in front
+        merge_entry_t **link = &merge->buckets[entry->hash & (merge->buckets_len - 1)];
+        while (*link != entry)
+            link = &(*link)->chain;
+        *link = entry->chain;
+
+        data_t *data = entry->data;
+        entry->data  = NULL;
+        if (entry->receivers_len)
+            data = data_ary(data, "receivers", "Receivers", NULL, data_array(entry->receivers_len, DATA_STRING, entry->receivers));
+        entry_clear(entry);
+        entry->next  = merge->spare;
+        merge->spare = entry;
+
+        emit(ctx, data);
+        n++;
+    }
+    return n;
+}
+
+unsigned event_merge_held(event_merge_t const *merge)
+{
+    return merge->held;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (a), (b)); \
+        } \
+    } while (0)
+
+typedef struct emitted {
+    unsigned count;
+    int id;          ///< of the last event
+    int receivers;   ///< of the last event, -1 without a list
+} emitted_t;
+
+static void test_emit(void *ctx, data_t *data)
+{
+    emitted_t *emitted = ctx;
+    emitted->count++;
+    emitted->receivers = -1;
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "id"))
+            emitted->id = d->value.v_int;
+        if (!strcmp(d->key, "receivers"))
+            emitted->receivers = ((data_array_t *)d->value.v_ptr)->num_values;
+    }
+    data_free(data);
+}
+
+static data_t *test_event(int id)
+{
+    return data_int(NULL, "id", "", NULL, id);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    emitted_t emitted = {0};
+
+    fprintf(stderr, "event_merge:: keep the best copy\n");
+    event_merge_t *merge = event_merge_create(1000);
+    ASSERT_EQUALS(merge != NULL, 1);
+    ASSERT_EQUALS(event_merge_add(merge, 7, test_event(1), "a", -20.0f, 10.0), 0);
+    ASSERT_EQUALS(event_merge_add(merge, 7, test_event(2), "b", -10.0f, 10.2), 1);
+    ASSERT_EQUALS(event_merge_add(merge, 7, test_event(3), "c", -30.0f, 10.4), 1);
+    ASSERT_EQUALS(event_merge_add(merge, 7, test_event(4), "a", -40.0f, 10.5), 1);
+    ASSERT_EQUALS((int)event_merge_held(merge), 1);
+    ASSERT_EQUALS((int)event_merge_expire(merge, 10.9, test_emit, &emitted), 0);
+    ASSERT_EQUALS((int)event_merge_expire(merge, 11.0, test_emit, &emitted), 1);
+    ASSERT_EQUALS(emitted.id, 2);
+    ASSERT_EQUALS(emitted.receivers, 3);
+
+    fprintf(stderr, "event_merge:: a copy after the window is a new event\n");
+    ASSERT_EQUALS(event_merge_add(merge, 7, test_event(5), "a", -20.0f, 20.0), 0);
+    ASSERT_EQUALS(event_merge_add(merge, 7, test_event(6), "b", -20.0f, 21.5), 0);
+    ASSERT_EQUALS((int)event_merge_held(merge), 2);
+    ASSERT_EQUALS((int)event_merge_expire(merge, 21.5, test_emit, &emitted), 1);
+    ASSERT_EQUALS(emitted.id, 5);
+    ASSERT_EQUALS((int)event_merge_expire(merge, -1.0, test_emit, &emitted), 1);
+    ASSERT_EQUALS(emitted.id, 6);
+
+    fprintf(stderr, "event_merge:: many events in order\n");
+    for (int i = 0; i < 5000; ++i)
+        event_merge_add(merge, (uint32_t)i * 2654435761u, test_event(i), NULL, 0.0f, 30.0 + i * 0.0001);
+    ASSERT_EQUALS((int)event_merge_held(merge), 5000);
+    ASSERT_EQUALS(event_merge_add(merge, 1234u * 2654435761u, test_event(-1), "x", 0.0f, 30.5), 1);
+    emitted.count = 0;
+    ASSERT_EQUALS((int)event_merge_expire(merge, 30.0 + 1000 * 0.0001 + 1.0, test_emit, &emitted), 1001);
+    ASSERT_EQUALS(emitted.id, 1000);
+    ASSERT_EQUALS(emitted.receivers, -1);
+    ASSERT_EQUALS((int)event_merge_expire(merge, -1.0, test_emit, &emitted), 3999);
+    ASSERT_EQUALS((int)event_merge_held(merge), 0);
+    event_merge_free(merge);
+
+    fprintf(stderr, "event_merge:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,355 @@
+/** @file
+    Sample file reader, memory-mapped with zero-copy blocks where possible.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "file_input.h"
+#include "fileformat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fatal.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define FILE_INPUT_MMAP
+#endif
+
+struct file_input {
+    FILE *file;
+    int format;
+    size_t block_len; ///< length of the blocks handed out
+    size_t read_len;  ///< length of the file data of a block
+    uint8_t *raw;     ///< stdio read buffer, NULL if mapped
+    uint8_t *buf;     ///< conversion buffer, NULL if passed as is
+    // the mapping
+    uint8_t *map;     ///< the mapped window, NULL if none
+    size_t map_len;   ///< length of the mapped window
+    uint64_t map_pos; ///< file offset of the mapped window
+    size_t window;    ///< length of the windows to map
+    uint64_t size;    ///< file size, 0 if read with stdio
+    uint64_t pos;     ///< file offset of the next block
+};
+
+void file_input_cs8_to_cu8(uint8_t const *src, uint8_t *dst, size_t len)
+{
+    // flipping the sign bit adds 128, a byte loop the compiler vectorizes
+    for (size_t i = 0; i < len; ++i)
+        dst[i] = src[i] ^ 0x80;
+}
+
+void file_input_cf32_to_cs16(float const *src, int16_t *dst, size_t n)
+{
+    // clamp before the conversion, without branches the compiler vectorizes, NaN maps to -1
+    for (size_t i = 0; i < n; ++i) {
+        float v = src[i] * INT16_MAX;
+        v       = v > -INT16_MAX ? v : -INT16_MAX;
+        v       = v < INT16_MAX ? v : INT16_MAX;
+        dst[i]  = (int16_t)v;
+    }
+}
+
+#ifdef FILE_INPUT_MMAP
+/// Map the window holding len bytes at the read position, returns 0 on success.
+static int map_window(file_input_t *in, size_t len)
+{
+    if (in->map && in->pos >= in->map_pos && in->pos + len <= in->map_pos + in->map_len)
+        return 0;
+
+    if (in->map)
+        munmap(in->map, in->map_len);
+    in->map = NULL;
+
+    uint64_t page   = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t offset = in->pos / page * page;
+    // the window always holds a block after the page aligned start
+    uint64_t window = in->window > in->read_len + page ? in->window : in->read_len + page;
+    window          = (window + page - 1) / page * page;
+    uint64_t rest   = in->size - offset;
+    size_t map_len  = (size_t)(window < rest ? window : rest);
+
+    void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(in->file), (off_t)offset);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, map_len, MADV_SEQUENTIAL);
+
+    in->map     = map;
+    in->map_len = map_len;
+    in->map_pos = offset;
+    return 0;
+}
+#endif
+
+file_input_t *file_input_open(char const *path, int format, size_t block_len)
+{
+    file_input_t *in = calloc(1, sizeof(*in));
+    if (!in) {
+        WARN_CALLOC("file_input_open()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    in->format    = format;
+    in->block_len = block_len;
+    in->read_len  = format == CF32_IQ ? block_len * 2 : block_len;
+    in->window    = FILE_INPUT_WINDOW;
+
+    if (!strcmp(path, "-"))
+        in->file = stdin;
+    else
+        in->file = fopen(path, "rb");
+    if (!in->file) {
+        free(in);
+        return NULL;
+    }
+
+#ifdef FILE_INPUT_MMAP
+    struct stat st;
+    if (in->file != stdin && !fstat(fileno(in->file), &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        in->size = (uint64_t)st.st_size;
+        if (map_window(in, 0))
+            in->size = 0; // read with stdio
+    }
+#endif
+
+    if (format == CF32_IQ || format == CS8_IQ) {
+        in->buf = malloc(block_len);
+        if (!in->buf) {
+            WARN_MALLOC("file_input_open()");
+            file_input_close(in);
+            return NULL;
+        }
+    }
+    if (!in->map) {
+        in->raw = malloc(in->read_len);
+        if (!in->raw) {
+            WARN_MALLOC("file_input_open()");
+            file_input_close(in);
+            return NULL;
+        }
+    }
+
+    return in;
+}
+
+size_t file_input_read(file_input_t *in, uint8_t **buf)
+{
+    uint8_t *data = NULL;
+    size_t len    = 0;
+    if (in->map) {
+#ifdef FILE_INPUT_MMAP
+        uint64_t rest = in->size - in->pos;
+        len           = (size_t)(in->read_len < rest ? in->read_len : rest);
+        if (!len || map_window(in, len))
+            return 0;
+        data = &in->map[in->pos - in->map_pos];
+        in->pos += len;
+#endif
+    }
+    else {
+        // whole values only for CF32, a partial float at the end is dropped
+        if (in->format == CF32_IQ)
+            len = fread(in->raw, sizeof(float), in->read_len / sizeof(float), in->file) * sizeof(float);
+        else
+            len = fread(in->raw, 1, in->read_len, in->file);
+        data = in->raw;
+        in->pos += len;
+    }
+
+    if (in->format == CF32_IQ) {
+        size_t n = len / sizeof(float);
+        file_input_cf32_to_cs16((float const *)data, (int16_t *)in->buf, n);
+        *buf = in->buf;
+        return n * sizeof(int16_t);
+    }
+    if (in->format == CS8_IQ) {
+        file_input_cs8_to_cu8(data, in->buf, len);
+        *buf = in->buf;
+        return len;
+    }
+    *buf = data;
+    return len;
+}
+
+uint64_t file_input_blocks(file_input_t const *in)
+{
+    if (!in->map)
+        return 0;
+    return (in->size + in->read_len - 1) / in->read_len;
+}
+
+int file_input_seek_block(file_input_t *in, uint64_t block)
+{
+    if (!in->map || block > file_input_blocks(in))
+        return -1;
+    // the window is mapped on the next read
+    in->pos = block * in->read_len;
+    return 0;
+}
+
+int file_input_is_mapped(file_input_t const *in)
+{
+    return in->map != NULL;
+}
+
+void file_input_close(file_input_t *in)
+{
+    if (!in)
+        return;
+
+#ifdef FILE_INPUT_MMAP
+    if (in->map)
+        munmap(in->map, in->map_len);
+#endif
+    if (in->file && in->file != stdin)
+        fclose(in->file);
+    free(in->raw);
+    free(in->buf);
+    free(in);
+}
+
+// Unit testing
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (a), (b)); \
+        } \
+    } while (0)
+
+#define TEST_FILE "file_input_test.tmp"
+
+/// Read a file in blocks and compare with the expected data, returns the number of differences.
+static int read_compare(file_input_t *in, uint8_t const *expected, size_t len)
+{
+    int diffs  = 0;
+    size_t pos = 0;
+    uint8_t *buf;
+    size_t n;
+    while ((n = file_input_read(in, &buf)) > 0) {
+        if (pos + n > len || memcmp(buf, &expected[pos], n))
+            ++diffs;
+        pos += n;
+    }
+    return diffs + (pos != len);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    enum { LEN = 100000 };
+    static uint8_t data[LEN];
+    static uint8_t expected[LEN];
+
+    fprintf(stderr, "file_input:: CS8 conversion\n");
+    for (unsigned i = 0; i < 256; ++i)
+        data[i] = (uint8_t)i;
+    file_input_cs8_to_cu8(data, expected, 256);
+    int diffs = 0;
+    for (unsigned i = 0; i < 256; ++i)
+        diffs += expected[i] != (uint8_t)((int8_t)data[i] + 128);
+    ASSERT_EQUALS(diffs, 0);
+
+    fprintf(stderr, "file_input:: CF32 conversion\n");
+    float f[8] = {0.0f, 0.5f, -0.5f, 1.0f, -1.0f, 2.0f, -3.0f, 1e-6f};
+    int16_t s[8];
+    file_input_cf32_to_cs16(f, s, 8);
+    ASSERT_EQUALS(s[0], 0);
+    ASSERT_EQUALS(s[1], 16383);
+    ASSERT_EQUALS(s[2], -16383);
+    ASSERT_EQUALS(s[3], 32767);
+    ASSERT_EQUALS(s[4], -32767);
+    ASSERT_EQUALS(s[5], 32767);
+    ASSERT_EQUALS(s[6], -32767);
+    ASSERT_EQUALS(s[7], 0);
+
+    fprintf(stderr, "file_input:: CU8 blocks\n");
+    srand(433);
+    for (unsigned i = 0; i < LEN; ++i)
+        data[i] = (uint8_t)rand();
+    FILE *fp = fopen(TEST_FILE, "wb");
+    ASSERT_EQUALS(fp != NULL, 1);
+    if (!fp)
+        return 1;
+    fwrite(data, 1, LEN, fp);
+    fclose(fp);
+
+    file_input_t *in = file_input_open(TEST_FILE, CU8_IQ, 3000);
+    ASSERT_EQUALS(in != NULL, 1);
+    if (in) {
+#ifdef FILE_INPUT_MMAP
+        ASSERT_EQUALS(file_input_is_mapped(in), 1);
+        in->window = 1; // remap often, the window grows to a block and a page
+#endif
+        ASSERT_EQUALS(read_compare(in, data, LEN), 0);
+        file_input_close(in);
+    }
+
+    fprintf(stderr, "file_input:: CU8 seek\n");
+    in = file_input_open(TEST_FILE, CU8_IQ, 3000);
+    ASSERT_EQUALS(in != NULL, 1);
+    if (in) {
+#ifdef FILE_INPUT_MMAP
+        ASSERT_EQUALS((int)file_input_blocks(in), 34);
+        ASSERT_EQUALS(file_input_seek_block(in, 35), -1);
+        ASSERT_EQUALS(file_input_seek_block(in, 33), 0);
+        ASSERT_EQUALS(read_compare(in, &data[33 * 3000], LEN - 33 * 3000), 0);
+        ASSERT_EQUALS(file_input_seek_block(in, 5), 0);
+        ASSERT_EQUALS(read_compare(in, &data[5 * 3000], LEN - 5 * 3000), 0);
+#endif
+        file_input_close(in);
+    }
+
+    fprintf(stderr, "file_input:: CS8 blocks\n");
+    file_input_cs8_to_cu8(data, expected, LEN);
+    in = file_input_open(TEST_FILE, CS8_IQ, 4096);
+    ASSERT_EQUALS(in != NULL, 1);
+    if (in) {
+        ASSERT_EQUALS(read_compare(in, expected, LEN), 0);
+        file_input_close(in);
+    }
+
+    fprintf(stderr, "file_input:: CF32 blocks\n");
+    for (unsigned i = 0; i < LEN / sizeof(float); ++i)
+        ((float *)data)[i] = (float)(rand() % 20001 - 10000) / 10000.0f;
+    file_input_cf32_to_cs16((float const *)data, (int16_t *)expected, LEN / sizeof(float));
+    fp = fopen(TEST_FILE, "wb");
+    if (fp) {
+        fwrite(data, 1, LEN, fp);
+        fclose(fp);
+    }
+    in = file_input_open(TEST_FILE, CF32_IQ, 1000);
+    ASSERT_EQUALS(in != NULL, 1);
+    if (in) {
+        ASSERT_EQUALS(read_compare(in, expected, LEN / 2), 0);
+#ifdef FILE_INPUT_MMAP
+        ASSERT_EQUALS((int)file_input_blocks(in), 50);
+        ASSERT_EQUALS(file_input_seek_block(in, 10), 0);
+        ASSERT_EQUALS(read_compare(in, &expected[10 * 1000], LEN / 2 - 10 * 1000), 0);
+#endif
+        file_input_close(in);
+    }
+
+    fprintf(stderr, "file_input:: missing file\n");
+    remove(TEST_FILE);
+    ASSERT_EQUALS(file_input_open(TEST_FILE, CU8_IQ, 1000) == NULL, 1);
+
+    fprintf(stderr, "file_input:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,457 @@
+/** @file
+    Flush, sync, and rotation policy of the file outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "file_sink.h"
+#include "compat_pthread.h"
+#include "cpu_stats.h"
+#include "r_util.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/// A stream with a policy, the list is set up before the outputs start.
+typedef struct file_sink {
+    struct file_sink *next;
+    FILE *file;
+    char *path; ///< NULL for stdout
+    char const *mode;
+    file_sink_opts_t opts;
+    char *buf;           ///< the stream buffer of flush_bytes, the C library might ignore a size without buffer
+    int dirty;           ///< records were committed since the last flush
+    int unsynced;        ///< records were flushed since the last sync
+    uint64_t flush_ms;   ///< time of the last flush
+    uint64_t sync_ms;    ///< time of the last sync
+    int fd;              ///< a non-blocking descriptor of the terminal, -1 if none
+    char *pending;       ///< records queued for the terminal
+    size_t pending_len;
+    unsigned dropped;    ///< records dropped on the busy terminal
+    unsigned reported;   ///< drops told in a summary line
+    char day[LOCAL_TIME_BUFLEN];  ///< the day the file was opened
+    char opened[LOCAL_TIME_BUFLEN]; ///< the time the file was opened, names the rotated file
+#ifdef THREADS
+    pthread_mutex_t lock; ///< the event loop polls while an async output commits
+#endif
+} file_sink_t;
+
+#ifdef THREADS
+#define SINK_LOCK(s) pthread_mutex_lock(&(s)->lock)
+#define SINK_UNLOCK(s) pthread_mutex_unlock(&(s)->lock)
+#else
+#define SINK_LOCK(s)
+#define SINK_UNLOCK(s)
+#endif
+
+static file_sink_t *sinks;
+
+static uint64_t now_ms(void)
+{
+    return cpu_stats_now() / 1000000;
+}
+
+/// Parse a size with an optional "k" or "M" suffix, returns 0 on error.
+static size_t parse_size(char const *p, char **endptr)
+{
+    unsigned long val = strtoul(p, endptr, 10);
+    if (*endptr == p)
+        return 0;
+    if (**endptr == 'k' || **endptr == 'K') {
+        val *= 1024;
+        ++*endptr;
+    }
+    else if (**endptr == 'M') {
+        val *= 1024 * 1024;
+        ++*endptr;
+    }
+    return val;
+}
+
+/// Parse a time with a "ms" or "s" suffix, returns -1 if there is none.
+static long parse_time_ms(char const *p, char **endptr)
+{
+    long val = strtol(p, endptr, 10);
+    if (*endptr == p || val < 0)
+        return -1;
+    if (!strncmp(*endptr, "ms", 2)) {
+        *endptr += 2;
+        return val;
+    }
+    if (**endptr == 's') {
+        ++*endptr;
+        return val * 1000;
+    }
+    return -1;
+}
+
+static int opt_end(char const *p)
+{
+    return !*p || *p == ',' || *p == ':';
+}
+
+int file_sink_parse_opt(file_sink_opts_t *opts, char **arg)
+{
+    char *p = *arg;
+    char *end;
+    if (!strncmp(p, "flush=", 6)) {
+        p += 6;
+        long ms = parse_time_ms(p, &end);
+        if (ms >= 0 && opt_end(end)) {
+            opts->flush_ms = (unsigned)ms;
+        }
+        else {
+            opts->flush_bytes = parse_size(p, &end);
+            if (!opts->flush_bytes || !opt_end(end))
+                return -1;
+        }
+    }
+    else if (!strncmp(p, "sync=", 5)) {
+        p += 5;
+        long ms = parse_time_ms(p, &end);
+        if (ms <= 0 || !opt_end(end))
+            return -1;
+        opts->sync_ms = (unsigned)ms;
+    }
+    else if (!strncmp(p, "rotate=", 7)) {
+        p += 7;
+        if (!strncmp(p, "daily", 5) && opt_end(p + 5)) {
+            end = p + 5;
+            opts->rotate_daily = 1;
+        }
+        else {
+            opts->rotate_bytes = parse_size(p, &end);
+            if (!opts->rotate_bytes || !opt_end(end))
+                return -1;
+        }
+    }
+    else {
+        return 0;
+    }
+    *arg = end;
+    return 1;
+}
+
+int file_sink_opts_set(file_sink_opts_t const *opts)
+{
+    return opts && (opts->flush_bytes || opts->flush_ms || opts->sync_ms
+            || opts->rotate_bytes || opts->rotate_daily || opts->nonblock);
+}
+
+static void sink_sync(file_sink_t *sink)
+{
+#ifdef _WIN32
+    _commit(_fileno(sink->file));
+#elif defined(__APPLE__)
+    fsync(fileno(sink->file));
+#else
+    fdatasync(fileno(sink->file)); // might fail e.g. on a pipe, there is nothing to do then
+#endif
+    sink->unsynced = 0;
+    sink->sync_ms  = now_ms();
+}
+
+static void sink_flush(file_sink_t *sink)
+{
+    fflush(sink->file);
+    sink->dirty = 0;
+    sink->unsynced = 1;
+    sink->flush_ms = now_ms();
+}
+
+/// Set up the stream buffer and note the open time, after an open or reopen.
+static void sink_opened(file_sink_t *sink)
+{
+    if (sink->buf)
+        setvbuf(sink->file, sink->buf, _IOFBF, sink->opts.flush_bytes);
+    format_time_str(sink->day, "%Y%m%d", 0, 0);
+    format_time_str(sink->opened, "%Y%m%d-%H%M%S", 0, 0);
+}
+
+/// Rename the file to "<path>.<open time>" and reopen the path on the same stream.
+static void sink_rotate(file_sink_t *sink)
+{
+    sink_flush(sink);
+    if (sink->opts.sync_ms)
+        sink_sync(sink);
+
+    size_t size = strlen(sink->path) + LOCAL_TIME_BUFLEN + 8;
+    char *rotated = malloc(size);
+    if (!rotated) {
+        WARN_MALLOC("sink_rotate()");
+        return;
+    }
+    snprintf(rotated, size, "%s.%s", sink->path, sink->opened);
+    for (int i = 1; i < 100; ++i) {
+        FILE *exists = fopen(rotated, "r");
+        if (!exists)
+            break;
+        fclose(exists);
+        snprintf(rotated, size, "%s.%s-%d", sink->path, sink->opened, i);
+    }
+
+#ifdef _WIN32
+    // an open file can't be renamed, park the stream meanwhile
+    if (!freopen("NUL", sink->mode, sink->file)) {
+        print_logf(LOG_FATAL, "Output", "Failed to reopen \"%s\"", sink->path);
+        exit(1);
+    }
+#endif
+    if (rename(sink->path, rotated))
+        print_logf(LOG_ERROR, "Output", "Failed to rotate \"%s\" to \"%s\"", sink->path, rotated);
+    else
+        print_logf(LOG_NOTICE, "Output", "Rotated \"%s\" to \"%s\"", sink->path, rotated);
+    free(rotated);
+
+    if (!freopen(sink->path, sink->mode, sink->file)) {
+        print_logf(LOG_FATAL, "Output", "Failed to reopen \"%s\"", sink->path);
+        exit(1);
+    }
+    sink_opened(sink);
+}
+
+/// Open a non-blocking descriptor of a terminal, returns -1 if @p file is not a terminal.
+static int open_nonblock(FILE *file)
+{
+#ifdef _WIN32
+    UNUSED(file);
+    return -1; // the console is written blocking
+#else
+    // a description of its own, setting O_NONBLOCK on stdout would affect the shell too
+    char const *tty = isatty(fileno(file)) ? ttyname(fileno(file)) : NULL;
+    return tty ? open(tty, O_WRONLY | O_NOCTTY | O_NONBLOCK) : -1;
+#endif
+}
+
+FILE *file_sink_open(char const *path, char const *mode, file_sink_opts_t const *opts)
+{
+    FILE *file = path ? fopen(path, mode) : stdout;
+    if (!file || !file_sink_opts_set(opts))
+        return file;
+
+    int fd = opts->nonblock ? open_nonblock(file) : -1;
+    file_sink_opts_t sink_opts = *opts;
+    sink_opts.nonblock = fd >= 0;
+    if (!file_sink_opts_set(&sink_opts))
+        return file; // not a terminal
+
+    file_sink_t *sink = calloc(1, sizeof(*sink));
+    if (!sink) {
+        FATAL_CALLOC("file_sink_open()");
+    }
+    sink->file = file;
+    sink->mode = mode;
+    sink->opts = sink_opts;
+    sink->fd   = fd;
+    if (path) {
+        sink->path = strdup(path);
+        if (!sink->path)
+            FATAL_STRDUP("file_sink_open()");
+    }
+    else if (opts->rotate_bytes || opts->rotate_daily) {
+        print_log(LOG_WARNING, "Output", "Rotation needs a file path, not rotating stdout");
+        sink->opts.rotate_bytes = 0;
+        sink->opts.rotate_daily = 0;
+    }
+    if (opts->flush_bytes) {
+        sink->buf = malloc(opts->flush_bytes);
+        if (!sink->buf)
+            FATAL_MALLOC("file_sink_open()");
+    }
+    if (fd >= 0) {
+        sink->pending = malloc(FILE_SINK_PENDING_MAX);
+        if (!sink->pending)
+            FATAL_MALLOC("file_sink_open()");
+    }
+#ifdef THREADS
+    pthread_mutex_init(&sink->lock, NULL);
+#endif
+    sink_opened(sink);
+    sink->flush_ms = now_ms();
+    sink->sync_ms  = sink->flush_ms;
+
+    sink->next = sinks;
+    sinks      = sink;
+    return file;
+}
+
+static file_sink_t *find_sink(FILE *file)
+{
+    file_sink_t *sink = sinks;
+    while (sink && sink->file != file)
+        sink = sink->next;
+    return sink;
+}
+
+int file_sink_commit(FILE *file)
+{
+    file_sink_t *sink = find_sink(file);
+    if (!sink) {
+        fflush(file);
+        return 0;
+    }
+
+    SINK_LOCK(sink);
+    sink->dirty = 1;
+    if (sink->opts.rotate_bytes || sink->opts.rotate_daily) {
+        char day[LOCAL_TIME_BUFLEN];
+        if ((sink->opts.rotate_daily && strcmp(format_time_str(day, "%Y%m%d", 0, 0), sink->day))
+                || (sink->opts.rotate_bytes && ftell(file) >= (long)sink->opts.rotate_bytes)) {
+            sink_rotate(sink);
+            SINK_UNLOCK(sink);
+            return 1;
+        }
+    }
+
+    // without a flush option each record is flushed, a size alone leaves the flushing to the full buffer
+    uint64_t now = now_ms();
+    if (sink->opts.flush_ms ? now - sink->flush_ms >= sink->opts.flush_ms : !sink->opts.flush_bytes)
+        sink_flush(sink);
+    if (sink->opts.sync_ms && now - sink->sync_ms >= sink->opts.sync_ms) {
+        if (sink->dirty)
+            sink_flush(sink);
+        sink_sync(sink);
+    }
+    SINK_UNLOCK(sink);
+    return 0;
+}
+
+/// Queue a line on the drops since the last one once the queue is half empty, records are dropped until then.
+static void sink_report_drops(file_sink_t *sink)
+{
+    if (sink->dropped == sink->reported || sink->pending_len > FILE_SINK_PENDING_MAX / 2)
+        return;
+    char line[80];
+    unsigned dropped = sink->dropped - sink->reported;
+    int len = snprintf(line, sizeof(line), "[%u record%s dropped, the terminal is too slow]\n", dropped, dropped == 1 ? "" : "s");
+    memcpy(sink->pending + sink->pending_len, line, (size_t)len);
+    sink->pending_len += (size_t)len;
+    sink->reported = sink->dropped;
+}
+
+/// Write as much of the queue as the terminal takes.
+static void sink_drain(file_sink_t *sink)
+{
+#ifndef _WIN32
+    size_t done = 0;
+    while (done < sink->pending_len) {
+        ssize_t n = write(sink->fd, sink->pending + done, sink->pending_len - done);
+        if (n > 0)
+            done += (size_t)n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            done = sink->pending_len; // the terminal is gone, e.g. a hangup
+        else
+            break;
+    }
+    memmove(sink->pending, sink->pending + done, sink->pending_len - done);
+    sink->pending_len -= done;
+#else
+    UNUSED(sink);
+#endif
+}
+
+int file_sink_write(FILE *file, char const *buf, size_t len)
+{
+    file_sink_t *sink = find_sink(file);
+    if (!sink || sink->fd < 0) {
+        fwrite(buf, 1, len, file);
+        return file_sink_commit(file);
+    }
+
+    SINK_LOCK(sink);
+    fflush(file); // keep the order with text written to the stream, e.g. a color reset
+    sink_drain(sink);
+    sink_report_drops(sink);
+    if (sink->dropped != sink->reported || sink->pending_len + len > FILE_SINK_PENDING_MAX) {
+        sink->dropped++;
+    }
+    else {
+        memcpy(sink->pending + sink->pending_len, buf, len);
+        sink->pending_len += len;
+    }
+    sink_drain(sink);
+    SINK_UNLOCK(sink);
+    return 0;
+}
+
+unsigned file_sink_dropped(FILE *file)
+{
+    file_sink_t *sink = find_sink(file);
+    if (!sink)
+        return 0;
+    SINK_LOCK(sink);
+    unsigned dropped = sink->dropped;
+    SINK_UNLOCK(sink);
+    return dropped;
+}
+
+void file_sink_poll(void)
+{
+    uint64_t now = now_ms();
+    for (file_sink_t *sink = sinks; sink; sink = sink->next) {
+        SINK_LOCK(sink);
+        if (sink->dirty && sink->opts.flush_ms && now - sink->flush_ms >= sink->opts.flush_ms)
+            sink_flush(sink);
+        if (sink->unsynced && sink->opts.sync_ms && now - sink->sync_ms >= sink->opts.sync_ms)
+            sink_sync(sink);
+        if (sink->fd >= 0) {
+            sink_drain(sink);
+            sink_report_drops(sink);
+            sink_drain(sink);
+        }
+        SINK_UNLOCK(sink);
+    }
+}
+
+void file_sink_close_all(void)
+{
+    while (sinks) {
+        file_sink_t *sink = sinks;
+        sinks = sink->next;
+
+        if (sink->fd >= 0) {
+            // the last records are worth a wait
+            fwrite(sink->pending, 1, sink->pending_len, sink->file);
+            sink->pending_len = 0;
+            sink_report_drops(sink);
+            fwrite(sink->pending, 1, sink->pending_len, sink->file);
+#ifndef _WIN32
+            close(sink->fd);
+#endif
+        }
+        fflush(sink->file);
+        if (sink->opts.sync_ms)
+            sink_sync(sink);
+        if (sink->path) {
+            fclose(sink->file);
+            free(sink->buf);
+        }
+        // stdout keeps the buffer, a stream buffer can't be changed after writing
+#ifdef THREADS
+        pthread_mutex_destroy(&sink->lock);
+#endif
+        free(sink->pending);
+        free(sink->path);
+        free(sink);
+    }
+}
@@ -50,7 +50,11 @@ void file_info_check_read(file_info_t *info)
             && info->format != CS16_IQ
             && info->format != CF32_IQ
             && info->format != S16_AM
-            && info->format != PULSE_OOK) {
+            && info->format != PULSE_OOK
+            && info->format != PULSE_BIN
+            && info->format != GIQ_CU8
+            && info->format != GIQ_CS16
+            && (info->format & 0xffff0000) != F_SIGMF) {
         fprintf(stderr, "File type not supported as input (%s).\n", info->spec);
         exit(1);
     }
@@ -69,7 +73,14 @@ void file_info_check_write(file_info_t *info)
             && info->format != F32_I
             && info->format != F32_Q
             && info->format != U8_LOGIC
-            && info->format != VCD_LOGIC) {
+            && info->format != VCD_LOGIC
+            && info->format != PULSE_BIN
+            && info->format != GIQ_CU8
+            && info->format != GIQ_CS16
+            && info->format != SIGMF_CU8
+            && info->format != SIGMF_CS8
+            && info->format != SIGMF_CS16
+            && info->format != SIGMF_CF32) {
         fprintf(stderr, "File type not supported as output (%s).\n", info->spec);
         exit(1);
     }
@@ -90,6 +101,13 @@ char const *file_info_string(file_info_t *info)
     case VCD_LOGIC: return "VCD logic (text)";
     case U8_LOGIC:  return "U8 logic (1ch uint8)";
     case PULSE_OOK: return "OOK pulse data (text)";
+    case PULSE_BIN: return "Pulse data (binary)";
+    case GIQ_CU8:   return "Gated CU8 IQ (2ch uint8 segments)";
+    case GIQ_CS16:  return "Gated CS16 IQ (2ch int16 segments)";
+    case SIGMF_CU8:  return "SigMF CU8 IQ (2ch uint8)";
+    case SIGMF_CS8:  return "SigMF CS8 IQ (2ch int8)";
+    case SIGMF_CS16: return "SigMF CS16 IQ (2ch int16)";
+    case SIGMF_CF32: return "SigMF CF32 IQ (2ch float32)";
     default:        return "Unknown";
     }
 }
@@ -113,6 +131,8 @@ static uint32_t file_type_guess_auto_format(uint32_t type)
     else if (type == F_I) return F32_I;
     else if (type == F_Q) return F32_Q;
     else if (type == F_LOGIC) return U8_LOGIC;
+    else if (type == F_GIQ) return GIQ_CU8;
+    else if (type == F_SIGMF) return SIGMF_CU8;
 
     else if (type == F_CU8) return CU8_IQ;
     else if (type == F_CS8) return CS8_IQ;
@@ -120,6 +140,7 @@ static uint32_t file_type_guess_auto_format(uint32_t type)
     else if (type == F_U8) return U8_LOGIC;
     else if (type == F_VCD) return VCD_LOGIC;
     else if (type == F_OOK) return PULSE_OOK;
+    else if (type == F_PLS) return PULSE_BIN;
     else if (type == F_CS16) return CS16_IQ;
     else if (type == F_CF32) return CF32_IQ;
     else return type;
@@ -198,6 +219,14 @@ static void file_type(char const *filename, file_info_t *info)
             else if (len == 3 && !strncasecmp("f32", t, 3)) file_type_set_format(&info->format, F_F32);
             else if (len == 3 && !strncasecmp("vcd", t, 3)) file_type_set_content(&info->format, F_VCD);
             else if (len == 3 && !strncasecmp("ook", t, 3)) file_type_set_content(&info->format, F_OOK);
+            else if (len == 3 && !strncasecmp("giq", t, 3)) file_type_set_content(&info->format, F_GIQ);
+            else if (len == 3 && !strncasecmp("pls", t, 3)) file_type_set_content(&info->format, F_PLS);
+            else if (len == 5 && !strncasecmp("sigmf", t, 5)) {
+                file_type_set_content(&info->format, F_SIGMF);
+                // the ".sigmf-data" and ".sigmf-meta" extensions are not a format
+                if (!strncasecmp("-data", p, 5) || !strncasecmp("-meta", p, 5))
+                    p += 5;
+            }
             else if (len == 4 && !strncasecmp("cs16", t, 4)) file_type_set_format(&info->format, F_CS16);
             else if (len == 4 && !strncasecmp("cs32", t, 4)) file_type_set_format(&info->format, F_CS32);
             else if (len == 4 && !strncasecmp("cf32", t, 4)) file_type_set_format(&info->format, F_CF32);
@@ -237,6 +266,8 @@ Parse "[A-Za-z][0-9A-Za-z]+" as format or content specifier:
 2ch formats: "cu8", "cs8", "cs16", "cs32", "cf32"
 1ch formats: "u8", "s8", "s16", "u16", "s32", "u32", "f32"
 text formats: "vcd", "ook"
+binary pulse format: "pls"
+container formats: "giq", "sigmf" (also ".sigmf-data", ".sigmf-meta")
 content types: "iq", "i", "q", "am", "fm", "logic"
 
 Parses left to right, with the exception of a prefix up to the last colon ":"
@@ -351,6 +382,20 @@ int main(void)
     assert_file_type(S16_FM, ".s16_fm");
     assert_file_type(S16_FM, ".s16,fm");
 
+    assert_file_type(GIQ_CU8, ".giq");
+    assert_file_type(GIQ_CU8, ".cu8.giq");
+    assert_file_type(GIQ_CS16, ".cs16.giq");
+    assert_file_type(GIQ_CS16, "giq:cs16:file.bin");
+    assert_file_type(PULSE_BIN, ".pls");
+    assert_file_type(PULSE_BIN, "pls:file.bin");
+    assert_file_type(SIGMF_CU8, ".sigmf");
+    assert_file_type(SIGMF_CU8, ".sigmf-data");
+    assert_file_type(SIGMF_CU8, ".sigmf-meta");
+    assert_file_type(SIGMF_CS16, ".cs16.sigmf");
+    assert_file_type(SIGMF_CS16, ".cs16.sigmf-meta");
+    assert_file_type(SIGMF_CF32, "cf32:file.sigmf-data");
+    assert_file_type(SIGMF_CS8, "sigmf:cs8:file.bin");
+
     fprintf(stderr, "\nDone!\n");
 }
 #endif /* _TEST */
@@ -0,0 +1,122 @@
+/** @file
+    Frequency offset tracking of the FSK packages on a channel.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "fsk_track.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FSK_TRACK_MIN_DEV 1000 ///< smallest deviation between the tracked frequencies, in FM units
+
+/// The median of @p len values, the upper one for an even @p len.
+static int median(int16_t const *vals, unsigned len)
+{
+    int16_t sorted[FSK_TRACK_LEN];
+    for (unsigned i = 0; i < len; ++i) {
+        unsigned j = i;
+        for (; j > 0 && sorted[j - 1] > vals[i]; --j)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = vals[i];
+    }
+    return sorted[len / 2];
+}
+
+void fsk_track_add(fsk_track_t *track, int f1_est, int f2_est)
+{
+    int hi = f1_est > f2_est ? f1_est : f2_est;
+    int lo = f1_est > f2_est ? f2_est : f1_est;
+    track->hi[track->next] = (int16_t)hi;
+    track->lo[track->next] = (int16_t)lo;
+    track->next = (track->next + 1) % FSK_TRACK_LEN;
+    if (track->count < FSK_TRACK_LEN)
+        track->count++;
+
+    track->seeded  = 0;
+    track->seed_hi = median(track->hi, track->count);
+    track->seed_lo = median(track->lo, track->count);
+    int dev        = track->seed_hi - track->seed_lo;
+    if (track->count < FSK_TRACK_MIN || dev < FSK_TRACK_MIN_DEV)
+        return;
+
+    unsigned agree = 0;
+    for (unsigned i = 0; i < track->count; ++i) {
+        agree += abs(track->hi[i] - track->seed_hi) <= dev / 4
+                && abs(track->lo[i] - track->seed_lo) <= dev / 4;
+    }
+    track->seeded = agree >= FSK_TRACK_MIN && agree * 2 > track->count;
+}
+
+int fsk_track_seed(fsk_track_t const *track, int *hi_est, int *lo_est)
+{
+    if (!track->seeded)
+        return 0;
+    *hi_est = track->seed_hi;
+    *lo_est = track->seed_lo;
+    return 1;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    int hi = 0;
+    int lo = 0;
+
+    fprintf(stderr, "fsk_track:: seed after agreeing packages\n");
+    fsk_track_t track = {0};
+    fsk_track_add(&track, 9000, 1000);
+    fsk_track_add(&track, 1200, 9100); // either order
+    ASSERT_EQUALS(fsk_track_seed(&track, &hi, &lo), 0);
+    fsk_track_add(&track, 8800, 900);
+    ASSERT_EQUALS(fsk_track_seed(&track, &hi, &lo), 1);
+    ASSERT_EQUALS(hi, 9000);
+    ASSERT_EQUALS(lo, 1000);
+
+    fprintf(stderr, "fsk_track:: follow a drift\n");
+    for (int i = 0; i < 8; ++i)
+        fsk_track_add(&track, 12000 + i * 100, 4000 + i * 100);
+    ASSERT_EQUALS(fsk_track_seed(&track, &hi, &lo), 1);
+    ASSERT_EQUALS(hi, 12400);
+    ASSERT_EQUALS(lo, 4400);
+
+    fprintf(stderr, "fsk_track:: no seed from senders on other offsets\n");
+    track = (fsk_track_t){0};
+    for (int i = 0; i < 8; ++i)
+        fsk_track_add(&track, i & 1 ? 9000 : -3000, i & 1 ? 1000 : -11000);
+    ASSERT_EQUALS(fsk_track_seed(&track, &hi, &lo), 0);
+    fsk_track_add(&track, 9000, 1000);
+    fsk_track_add(&track, 9000, 1000);
+    ASSERT_EQUALS(fsk_track_seed(&track, &hi, &lo), 1);
+    ASSERT_EQUALS(hi, 9000);
+
+    fprintf(stderr, "fsk_track:: no seed without deviation\n");
+    track = (fsk_track_t){0};
+    for (int i = 0; i < 4; ++i)
+        fsk_track_add(&track, 5000, 4500);
+    ASSERT_EQUALS(fsk_track_seed(&track, &hi, &lo), 0);
+
+    fprintf(stderr, "fsk_track:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,550 @@
+/** @file
+    Squelch-gated I/Q recordings, only the buffers with a signal are kept.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "gated_iq.h"
+#include "fileformat.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GATED_IQ_VERSION     1
+#define GATED_IQ_HEADER_LEN  16
+#define GATED_IQ_RECORD_LEN  32
+#define GATED_IQ_ENTRY_LEN   40
+#define GATED_IQ_TRAILER_LEN 16
+#define GATED_IQ_RECORD_MAX  (64 * 1024 * 1024) ///< longest record accepted by the reader, in bytes
+
+static void put_u32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_u64le(uint8_t *p, uint64_t v)
+{
+    put_u32le(p, (uint32_t)v);
+    put_u32le(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t get_u32le(uint8_t const *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64le(uint8_t const *p)
+{
+    return (uint64_t)get_u32le(p) | (uint64_t)get_u32le(p + 4) << 32;
+}
+
+static unsigned format_sample_size(int format)
+{
+    if (format == CU8_IQ)
+        return 2;
+    if (format == CS16_IQ)
+        return 4;
+    return 0;
+}
+
+struct gated_iq_writer {
+    FILE *file;
+    gated_iq_write_fn write_fn;
+    void *write_ctx;
+    int format;
+    unsigned sample_size;
+    uint64_t pos;               ///< file offset of the next record
+    unsigned hang;              ///< squelched buffers still to record after a signal
+    int failed;                 ///< a write failed, the index is not written
+    gated_iq_segment_t *index;  ///< the segments recorded
+    unsigned index_len;
+    unsigned index_size;
+    gated_iq_segment_t pre;     ///< the last squelched buffer, recorded before a signal
+    uint8_t *pre_buf;
+    size_t pre_len;             ///< length of the kept buffer, 0 if none
+    size_t pre_size;
+};
+
+gated_iq_writer_t *gated_iq_writer_create(FILE *file, int format, gated_iq_write_fn write_fn, void *ctx)
+{
+    unsigned sample_size = format_sample_size(format);
+    if (!sample_size) {
+        print_logf(LOG_ERROR, __func__, "Gated recordings need CU8 or CS16 samples");
+        return NULL;
+    }
+
+    gated_iq_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("gated_iq_writer_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    w->file        = file;
+    w->write_fn    = write_fn;
+    w->write_ctx   = ctx;
+    w->format      = format;
+    w->sample_size = sample_size;
+
+    uint8_t header[GATED_IQ_HEADER_LEN];
+    memcpy(header, "RTL433GI", 8);
+    put_u32le(&header[8], GATED_IQ_VERSION);
+    put_u32le(&header[12], (uint32_t)format);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        print_logf(LOG_ERROR, __func__, "Writing the gated recording header failed");
+        free(w);
+        return NULL;
+    }
+    w->pos = GATED_IQ_HEADER_LEN;
+    return w;
+}
+
+static int writer_put(gated_iq_writer_t *w, void const *buf, size_t len)
+{
+    size_t n = 0;
+    if (!w->failed)
+        n = w->write_fn ? w->write_fn(w->write_ctx, w->file, buf, len) : fwrite(buf, 1, len, w->file);
+    if (n != len) {
+        w->failed = 1;
+        return -1;
+    }
+    w->pos += len;
+    return 0;
+}
+
+/// Write a record, starts a new segment unless it continues the last one.
+static int writer_record(gated_iq_writer_t *w, gated_iq_segment_t const *rec, void const *buf, size_t len)
+{
+    gated_iq_segment_t *seg = w->index_len ? &w->index[w->index_len - 1] : NULL;
+    if (!seg || seg->sample_offset + seg->n_samples != rec->sample_offset
+            || seg->center_frequency != rec->center_frequency
+            || seg->sample_rate != rec->sample_rate) {
+        if (w->index_len == w->index_size) {
+            unsigned size = w->index_size ? w->index_size * 2 : 64;
+            gated_iq_segment_t *index = realloc(w->index, size * sizeof(*index));
+            if (!index) {
+                WARN_REALLOC("gated_iq_writer_write()");
+                w->failed = 1;
+                return -1;
+            }
+            w->index      = index;
+            w->index_size = size;
+        }
+        seg              = &w->index[w->index_len++];
+        *seg             = *rec;
+        seg->file_offset = w->pos;
+        seg->n_samples   = 0;
+    }
+    seg->n_samples += len / w->sample_size;
+
+    uint8_t header[GATED_IQ_RECORD_LEN];
+    memcpy(header, "GSEG", 4);
+    put_u32le(&header[4], (uint32_t)len);
+    put_u64le(&header[8], rec->sample_offset);
+    put_u64le(&header[16], (uint64_t)rec->time_us);
+    put_u32le(&header[24], rec->center_frequency);
+    put_u32le(&header[28], rec->sample_rate);
+    if (writer_put(w, header, sizeof(header)))
+        return -1;
+    return writer_put(w, buf, len);
+}
+
+int gated_iq_writer_write(gated_iq_writer_t *w, gated_iq_segment_t const *rec, int signal, void const *buf, size_t len)
+{
+    if (w->failed)
+        return -1;
+
+    if (signal) {
+        // the kept buffer is the lead-in if nothing was lost in between
+        if (w->pre_len && w->pre.sample_offset + w->pre_len / w->sample_size == rec->sample_offset) {
+            if (writer_record(w, &w->pre, w->pre_buf, w->pre_len))
+                return -1;
+        }
+        w->pre_len = 0;
+        w->hang    = GATED_IQ_HANGOVER;
+        return writer_record(w, rec, buf, len);
+    }
+    if (w->hang) {
+        w->hang--;
+        return writer_record(w, rec, buf, len);
+    }
+
+    // keep the squelched buffer in case a signal follows
+    if (len > w->pre_size) {
+        uint8_t *pre_buf = realloc(w->pre_buf, len);
+        if (!pre_buf) {
+            WARN_REALLOC("gated_iq_writer_write()");
+            w->pre_len = 0;
+            return 0; // the lead-in is lost, the recording goes on
+        }
+        w->pre_buf  = pre_buf;
+        w->pre_size = len;
+    }
+    memcpy(w->pre_buf, buf, len);
+    w->pre     = *rec;
+    w->pre_len = len;
+    return 0;
+}
+
+int gated_iq_writer_finish(gated_iq_writer_t *w)
+{
+    if (w->failed)
+        return -1;
+
+    uint64_t index_offset = w->pos;
+    uint8_t buf[GATED_IQ_ENTRY_LEN];
+    memcpy(buf, "GIDX", 4);
+    put_u32le(&buf[4], w->index_len);
+    if (writer_put(w, buf, 8))
+        return -1;
+    for (unsigned i = 0; i < w->index_len; ++i) {
+        gated_iq_segment_t const *seg = &w->index[i];
+        put_u64le(&buf[0], seg->file_offset);
+        put_u64le(&buf[8], seg->sample_offset);
+        put_u64le(&buf[16], (uint64_t)seg->time_us);
+        put_u64le(&buf[24], seg->n_samples);
+        put_u32le(&buf[32], seg->center_frequency);
+        put_u32le(&buf[36], seg->sample_rate);
+        if (writer_put(w, buf, GATED_IQ_ENTRY_LEN))
+            return -1;
+    }
+    put_u64le(&buf[0], index_offset);
+    put_u32le(&buf[8], w->index_len);
+    memcpy(&buf[12], "GEND", 4);
+    if (writer_put(w, buf, GATED_IQ_TRAILER_LEN))
+        return -1;
+    w->failed = 1; // nothing can be recorded after the index
+    return 0;
+}
+
+FILE *gated_iq_writer_file(gated_iq_writer_t const *w)
+{
+    return w->file;
+}
+
+void gated_iq_writer_free(gated_iq_writer_t *w)
+{
+    if (!w)
+        return;
+    free(w->index);
+    free(w->pre_buf);
+    free(w);
+}
+
+struct gated_iq_reader {
+    FILE *file;
+    int format;
+    unsigned sample_size;
+    uint8_t *buf;               ///< the samples of the last record
+    size_t buf_size;
+    gated_iq_segment_t *index;  ///< the segments, NULL if there is no index
+    unsigned index_len;
+};
+
+static int file_seek(FILE *file, int64_t offset, int whence)
+{
+#ifdef _WIN32
+    return _fseeki64(file, offset, whence);
+#else
+    return fseeko(file, (off_t)offset, whence);
+#endif
+}
+
+/// Read the index from the end of the file, returns -1 if there is none.
+static int reader_load_index(gated_iq_reader_t *r)
+{
+    uint8_t buf[GATED_IQ_ENTRY_LEN];
+    if (file_seek(r->file, -GATED_IQ_TRAILER_LEN, SEEK_END)
+            || fread(buf, 1, GATED_IQ_TRAILER_LEN, r->file) != GATED_IQ_TRAILER_LEN
+            || memcmp(&buf[12], "GEND", 4))
+        return -1;
+    uint64_t index_offset = get_u64le(&buf[0]);
+    unsigned count        = get_u32le(&buf[8]);
+    if (index_offset > INT64_MAX
+            || file_seek(r->file, (int64_t)index_offset, SEEK_SET)
+            || fread(buf, 1, 8, r->file) != 8
+            || memcmp(buf, "GIDX", 4)
+            || get_u32le(&buf[4]) != count)
+        return -1;
+
+    if (!count)
+        return 0; // nothing was recorded
+    gated_iq_segment_t *index = calloc(count, sizeof(*index));
+    if (!index) {
+        WARN_CALLOC("gated_iq_reader_open()");
+        return -1; // NOTE: the file is read without the index on alloc failure.
+    }
+    for (unsigned i = 0; i < count; ++i) {
+        if (fread(buf, 1, GATED_IQ_ENTRY_LEN, r->file) != GATED_IQ_ENTRY_LEN) {
+            free(index);
+            return -1;
+        }
+        index[i].file_offset      = get_u64le(&buf[0]);
+        index[i].sample_offset    = get_u64le(&buf[8]);
+        index[i].time_us          = (int64_t)get_u64le(&buf[16]);
+        index[i].n_samples        = get_u64le(&buf[24]);
+        index[i].center_frequency = get_u32le(&buf[32]);
+        index[i].sample_rate      = get_u32le(&buf[36]);
+    }
+    r->index     = index;
+    r->index_len = count;
+    return 0;
+}
+
+gated_iq_reader_t *gated_iq_reader_open(char const *path)
+{
+    gated_iq_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        WARN_CALLOC("gated_iq_reader_open()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    int is_stdin = !strcmp(path, "-");
+    r->file = is_stdin ? stdin : fopen(path, "rb");
+    if (!r->file) {
+        free(r);
+        return NULL;
+    }
+
+    uint8_t header[GATED_IQ_HEADER_LEN];
+    if (fread(header, 1, sizeof(header), r->file) != sizeof(header)
+            || memcmp(header, "RTL433GI", 8)
+            || get_u32le(&header[8]) != GATED_IQ_VERSION) {
+        print_logf(LOG_ERROR, __func__, "Not a gated recording \"%s\"", path);
+        gated_iq_reader_close(r);
+        return NULL;
+    }
+    r->format      = (int)get_u32le(&header[12]);
+    r->sample_size = format_sample_size(r->format);
+    if (!r->sample_size) {
+        print_logf(LOG_ERROR, __func__, "Unknown sample format of the gated recording \"%s\"", path);
+        gated_iq_reader_close(r);
+        return NULL;
+    }
+
+    // an unfinished recording has no index but can be read from the start
+    if (!is_stdin && reader_load_index(r))
+        print_logf(LOG_WARNING, __func__, "The gated recording \"%s\" has no index", path);
+    if (!is_stdin && file_seek(r->file, GATED_IQ_HEADER_LEN, SEEK_SET)) {
+        gated_iq_reader_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+int gated_iq_reader_format(gated_iq_reader_t const *r)
+{
+    return r->format;
+}
+
+size_t gated_iq_reader_read(gated_iq_reader_t *r, uint8_t **buf, gated_iq_segment_t *rec)
+{
+    uint8_t header[GATED_IQ_RECORD_LEN];
+    size_t n = fread(header, 1, 4, r->file);
+    if (n == 4 && !memcmp(header, "GIDX", 4))
+        return 0; // the index follows the records
+    if (n == 4 && memcmp(header, "GSEG", 4)) {
+        print_log(LOG_WARNING, __func__, "Corrupt record in the gated recording");
+        return 0;
+    }
+    if (n != 4 || fread(&header[4], 1, GATED_IQ_RECORD_LEN - 4, r->file) != GATED_IQ_RECORD_LEN - 4)
+        return 0; // the recording was cut off
+
+    size_t len = get_u32le(&header[4]);
+    if (!len || len > GATED_IQ_RECORD_MAX || len % r->sample_size) {
+        print_log(LOG_WARNING, __func__, "Corrupt record in the gated recording");
+        return 0;
+    }
+    if (len > r->buf_size) {
+        uint8_t *samples = realloc(r->buf, len);
+        if (!samples) {
+            WARN_REALLOC("gated_iq_reader_read()");
+            return 0;
+        }
+        r->buf      = samples;
+        r->buf_size = len;
+    }
+    if (fread(r->buf, 1, len, r->file) != len)
+        return 0;
+
+    rec->file_offset      = 0;
+    rec->sample_offset    = get_u64le(&header[8]);
+    rec->time_us          = (int64_t)get_u64le(&header[16]);
+    rec->n_samples        = len / r->sample_size;
+    rec->center_frequency = get_u32le(&header[24]);
+    rec->sample_rate      = get_u32le(&header[28]);
+    *buf = r->buf;
+    return len;
+}
+
+unsigned gated_iq_reader_segments(gated_iq_reader_t const *r)
+{
+    return r->index_len;
+}
+
+gated_iq_segment_t const *gated_iq_reader_segment(gated_iq_reader_t const *r, unsigned index)
+{
+    return index < r->index_len ? &r->index[index] : NULL;
+}
+
+int gated_iq_reader_seek(gated_iq_reader_t *r, unsigned index)
+{
+    if (index >= r->index_len || r->index[index].file_offset > INT64_MAX)
+        return -1;
+    return file_seek(r->file, (int64_t)r->index[index].file_offset, SEEK_SET);
+}
+
+void gated_iq_reader_close(gated_iq_reader_t *r)
+{
+    if (!r)
+        return;
+    if (r->file && r->file != stdin)
+        fclose(r->file);
+    free(r->index);
+    free(r->buf);
+    free(r);
+}
+
+// Unit testing
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define TEST_FILE "gated_iq_test.tmp"
+#define TEST_BUF  1000 ///< bytes of a test buffer, 500 CU8 samples
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    static uint8_t data[20][TEST_BUF];
+    // buffers 3 to 5, 12, and 16 are signal, 16 is after a gap of lost samples
+    int const signal[20] = {0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0};
+
+    fprintf(stderr, "gated_iq:: write\n");
+    FILE *fp = fopen(TEST_FILE, "wb");
+    ASSERT_EQUALS(fp != NULL, 1);
+    if (!fp)
+        return 1;
+    gated_iq_writer_t *w = gated_iq_writer_create(fp, CU8_IQ, NULL, NULL);
+    ASSERT_EQUALS(w != NULL, 1);
+    if (!w)
+        return 1;
+    ASSERT_EQUALS(gated_iq_writer_create(fp, CF32_IQ, NULL, NULL) == NULL, 1);
+    uint64_t offset = 0;
+    for (unsigned i = 0; i < 20; ++i) {
+        memset(data[i], i, TEST_BUF);
+        if (i == 16)
+            offset += 7; // samples lost
+        gated_iq_segment_t rec = {
+                .sample_offset    = offset,
+                .time_us          = 1000000 + (int64_t)i * 1000,
+                .center_frequency = 433920000,
+                .sample_rate      = 250000,
+        };
+        ASSERT_EQUALS(gated_iq_writer_write(w, &rec, signal[i], data[i], TEST_BUF), 0);
+        offset += TEST_BUF / 2;
+    }
+    ASSERT_EQUALS(gated_iq_writer_finish(w), 0);
+    gated_iq_writer_free(w);
+    fclose(fp);
+
+    fprintf(stderr, "gated_iq:: index\n");
+    gated_iq_reader_t *r = gated_iq_reader_open(TEST_FILE);
+    ASSERT_EQUALS(r != NULL, 1);
+    if (!r)
+        return 1;
+    ASSERT_EQUALS(gated_iq_reader_format(r), CU8_IQ);
+    // 2..6, 11..13, and 16..17, the lead-in 15 is not contiguous with 16
+    ASSERT_EQUALS(gated_iq_reader_segments(r), 3);
+    gated_iq_segment_t const *seg = gated_iq_reader_segment(r, 0);
+    ASSERT_EQUALS(seg->sample_offset, 2 * TEST_BUF / 2);
+    ASSERT_EQUALS(seg->n_samples, 5 * TEST_BUF / 2);
+    ASSERT_EQUALS(seg->time_us, 1002000);
+    seg = gated_iq_reader_segment(r, 1);
+    ASSERT_EQUALS(seg->sample_offset, 11 * TEST_BUF / 2);
+    ASSERT_EQUALS(seg->n_samples, 3 * TEST_BUF / 2);
+    seg = gated_iq_reader_segment(r, 2);
+    ASSERT_EQUALS(seg->sample_offset, 16 * TEST_BUF / 2 + 7);
+    ASSERT_EQUALS(seg->n_samples, 2 * TEST_BUF / 2);
+    ASSERT_EQUALS(seg->center_frequency, 433920000);
+    ASSERT_EQUALS(gated_iq_reader_segment(r, 3) == NULL, 1);
+
+    fprintf(stderr, "gated_iq:: records\n");
+    unsigned const expected[] = {2, 3, 4, 5, 6, 11, 12, 13, 16, 17};
+    unsigned n = 0;
+    int diffs = 0;
+    uint8_t *buf;
+    gated_iq_segment_t rec;
+    size_t len;
+    while ((len = gated_iq_reader_read(r, &buf, &rec)) > 0) {
+        unsigned i = n < 10 ? expected[n] : 0;
+        diffs += len != TEST_BUF || memcmp(buf, data[i], TEST_BUF)
+                || rec.sample_offset != i * TEST_BUF / 2 + (i >= 16 ? 7 : 0)
+                || rec.time_us != 1000000 + (int64_t)i * 1000
+                || rec.sample_rate != 250000;
+        ++n;
+    }
+    ASSERT_EQUALS(n, 10);
+    ASSERT_EQUALS(diffs, 0);
+
+    fprintf(stderr, "gated_iq:: seek\n");
+    ASSERT_EQUALS(gated_iq_reader_seek(r, 3), -1);
+    ASSERT_EQUALS(gated_iq_reader_seek(r, 1), 0);
+    len = gated_iq_reader_read(r, &buf, &rec);
+    ASSERT_EQUALS(len, TEST_BUF);
+    ASSERT_EQUALS(rec.sample_offset, 11 * TEST_BUF / 2);
+    ASSERT_EQUALS(buf[0], 11);
+    gated_iq_reader_close(r);
+
+    fprintf(stderr, "gated_iq:: unfinished\n");
+    fp = fopen(TEST_FILE, "wb");
+    w  = fp ? gated_iq_writer_create(fp, CS16_IQ, NULL, NULL) : NULL;
+    ASSERT_EQUALS(w != NULL, 1);
+    if (w) {
+        gated_iq_segment_t one = {.sample_offset = 100, .sample_rate = 1000000};
+        gated_iq_writer_write(w, &one, 1, data[1], TEST_BUF);
+        gated_iq_writer_free(w);
+    }
+    if (fp)
+        fclose(fp);
+    r = gated_iq_reader_open(TEST_FILE);
+    ASSERT_EQUALS(r != NULL, 1);
+    if (r) {
+        ASSERT_EQUALS(gated_iq_reader_format(r), CS16_IQ);
+        ASSERT_EQUALS(gated_iq_reader_segments(r), 0);
+        len = gated_iq_reader_read(r, &buf, &rec);
+        ASSERT_EQUALS(len, TEST_BUF);
+        ASSERT_EQUALS(rec.n_samples, TEST_BUF / 4);
+        ASSERT_EQUALS(gated_iq_reader_read(r, &buf, &rec), 0);
+        gated_iq_reader_close(r);
+    }
+
+    fprintf(stderr, "gated_iq:: not a recording\n");
+    fp = fopen(TEST_FILE, "wb");
+    if (fp) {
+        fwrite(data[0], 1, TEST_BUF, fp);
+        fclose(fp);
+    }
+    ASSERT_EQUALS(gated_iq_reader_open(TEST_FILE) == NULL, 1);
+    remove(TEST_FILE);
+
+    fprintf(stderr, "gated_iq:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,359 @@
+/** @file
+    Adaptive frequency hop scheduler.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "hop_sched.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define REPEAT_S 2.0        ///< events of a sensor closer than this are one report
+#define DUE_MARGIN 0.05     ///< tolerance of a predicted report, of the report interval
+#define DUE_MARGIN_MIN_S 1.0
+#define STALE_PERIODS 8     ///< forget a sensor missed this many report intervals
+#define PERIOD_TOLERANCE 0.25
+#define HISTORY_DECAY 0.9   ///< weight of the rate history on each dwell
+#define REVISIT_ROUNDS 10   ///< visit each frequency at least once in this many rounds of base dwells
+#define EXTEND_MAX 4        ///< longest dwell, times the base dwell
+#define PACKAGE_WEIGHT 0.1  ///< value of an undecoded package, of an event
+
+typedef struct sensor {
+    uint32_t key;  ///< 0 if unused
+    double last;   ///< time of the last report
+    double period; ///< estimated report interval, 0 if unknown
+} sensor_t;
+
+typedef struct freq_state {
+    sensor_t sensors[HOP_SCHED_SENSORS];
+    int visited;
+    double last_visit;    ///< end of the last dwell
+    double listen;        ///< total dwell time
+    double hist_time;     ///< decayed dwell time
+    double hist_events;   ///< decayed events not from periodic sensors
+    double hist_packages; ///< decayed packages
+    unsigned dwell_events;
+    unsigned dwell_packages;
+    unsigned dwells;
+    unsigned packages;
+    unsigned events;
+} freq_state_t;
+
+struct hop_sched {
+    unsigned frequencies;
+    unsigned current;
+    double dwell_start;
+    freq_state_t *freq;
+};
+
+hop_sched_t *hop_sched_create(unsigned frequencies)
+{
+    hop_sched_t *sched = calloc(1, sizeof(*sched));
+    if (!sched) {
+        WARN_CALLOC("hop_sched_create()");
+        return NULL;
+    }
+    sched->freq = calloc(frequencies ? frequencies : 1, sizeof(*sched->freq));
+    if (!sched->freq) {
+        WARN_CALLOC("hop_sched_create()");
+        free(sched);
+        return NULL;
+    }
+    sched->frequencies = frequencies ? frequencies : 1;
+    return sched;
+}
+
+void hop_sched_free(hop_sched_t *sched)
+{
+    if (!sched)
+        return;
+    free(sched->freq);
+    free(sched);
+}
+
+static double due_margin(sensor_t const *s)
+{
+    double margin = s->period * DUE_MARGIN;
+    return margin > DUE_MARGIN_MIN_S ? margin : DUE_MARGIN_MIN_S;
+}
+
+/// Get the time of the next expected report of a sensor, not before now less the margin, 0 if unknown.
+static double sensor_due(sensor_t const *s, double now)
+{
+    if (!s->key || s->period <= 0 || now - s->last > STALE_PERIODS * s->period)
+        return 0;
+    double margin = due_margin(s);
+    int k = (int)((now - margin - s->last) / s->period) + 1;
+    if (k < 1)
+        k = 1;
+    return s->last + k * s->period;
+}
+
+void hop_sched_package(hop_sched_t *sched, unsigned index)
+{
+    if (index >= sched->frequencies)
+        return;
+    freq_state_t *f = &sched->freq[index];
+    f->packages++;
+    f->dwell_packages++;
+}
+
+void hop_sched_event(hop_sched_t *sched, unsigned index, uint32_t key, double now)
+{
+    if (index >= sched->frequencies)
+        return;
+    freq_state_t *f = &sched->freq[index];
+    f->events++;
+    if (!key) {
+        f->dwell_events++;
+        return;
+    }
+
+    // find the sensor, or the slot of the longest unseen one
+    sensor_t *s = NULL;
+    sensor_t *oldest = &f->sensors[0];
+    for (unsigned i = 0; i < HOP_SCHED_SENSORS; ++i) {
+        if (f->sensors[i].key == key) {
+            s = &f->sensors[i];
+            break;
+        }
+        if (!f->sensors[i].key || (oldest->key && f->sensors[i].last < oldest->last))
+            oldest = &f->sensors[i];
+    }
+    if (!s) {
+        *oldest = (sensor_t){.key = key, .last = now};
+        f->dwell_events++;
+        return;
+    }
+
+    double dt = now - s->last;
+    if (dt < REPEAT_S)
+        return; // a repeat of the same report
+    if (s->period <= 0)
+        f->dwell_events++; // not predicted
+
+    // reports might have been missed while listening elsewhere
+    int n = s->period > 0 ? (int)(dt / s->period + 0.5) : 0;
+    if (n >= 1 && dt / n - s->period <= PERIOD_TOLERANCE * s->period && s->period - dt / n <= PERIOD_TOLERANCE * s->period)
+        s->period = 0.75 * s->period + 0.25 * dt / n;
+    else
+        s->period = dt;
+    s->last = now;
+}
+
+/// Get the best events per second of a frequency and the dwell for it.
+static double freq_value(freq_state_t const *f, double now, double dwell, double *best_dwell)
+{
+    double rate = 0;
+    if (f->hist_time > 0)
+        rate = (f->hist_events + PACKAGE_WEIGHT * f->hist_packages) / f->hist_time;
+
+    // the options are the base dwell, or longer to cover a sensor due shortly after
+    double best = -1;
+    *best_dwell = dwell;
+    for (int i = -1; i < HOP_SCHED_SENSORS; ++i) {
+        double len = dwell;
+        if (i >= 0) {
+            double due = sensor_due(&f->sensors[i], now);
+            if (!due)
+                continue;
+            len = due + due_margin(&f->sensors[i]) - now;
+            if (len <= dwell || len > EXTEND_MAX * dwell)
+                continue;
+        }
+        double events = rate * len;
+        for (unsigned j = 0; j < HOP_SCHED_SENSORS; ++j) {
+            double due = sensor_due(&f->sensors[j], now);
+            if (due && due + due_margin(&f->sensors[j]) <= now + len)
+                events += 1;
+        }
+        double value = events / len;
+        if (value > best) {
+            best        = value;
+            *best_dwell = len;
+        }
+    }
+    return best;
+}
+
+unsigned hop_sched_next(hop_sched_t *sched, double now, double const *dwell, double *next_dwell)
+{
+    // account the dwell that ended
+    freq_state_t *cur = &sched->freq[sched->current];
+    double len = now - sched->dwell_start;
+    if (len > 0) {
+        cur->listen += len;
+        cur->hist_time     = cur->hist_time * HISTORY_DECAY + len;
+        cur->hist_events   = cur->hist_events * HISTORY_DECAY + cur->dwell_events;
+        cur->hist_packages = cur->hist_packages * HISTORY_DECAY + cur->dwell_packages;
+    }
+    cur->dwells++;
+    cur->visited        = 1;
+    cur->last_visit     = now;
+    cur->dwell_events   = 0;
+    cur->dwell_packages = 0;
+
+    double revisit = 0;
+    for (unsigned i = 0; i < sched->frequencies; ++i)
+        revisit += dwell[i];
+    revisit *= REVISIT_ROUNDS;
+
+    // in round robin order starting after the current one, the first one wins ties
+    int best = -1;
+    double best_value = 0;
+    double best_dwell = 0;
+    int forced = -1;
+    double forced_away = 0;
+    for (unsigned j = 1; j <= sched->frequencies; ++j) {
+        unsigned i = (sched->current + j) % sched->frequencies;
+        freq_state_t const *f = &sched->freq[i];
+
+        // unvisited or long unvisited frequencies go first to keep learning
+        double away = now - f->last_visit;
+        if (!f->visited && (forced < 0 || sched->freq[forced].visited)) {
+            forced = (int)i;
+        }
+        else if (f->visited && i != sched->current && away >= revisit && (forced < 0 || (sched->freq[forced].visited && away > forced_away))) {
+            forced      = (int)i;
+            forced_away = away;
+        }
+
+        double value_dwell;
+        double value = freq_value(f, now, dwell[i], &value_dwell);
+        if (best < 0 || value > best_value) {
+            best       = (int)i;
+            best_value = value;
+            best_dwell = value_dwell;
+        }
+    }
+    if (forced >= 0) {
+        best       = forced;
+        best_dwell = dwell[forced];
+    }
+
+    sched->current     = (unsigned)best;
+    sched->dwell_start = now;
+    *next_dwell        = best_dwell;
+    return sched->current;
+}
+
+void hop_sched_get_stats(hop_sched_t const *sched, unsigned index, double now, hop_sched_stats_t *stats)
+{
+    *stats = (hop_sched_stats_t){0};
+    if (index >= sched->frequencies)
+        return;
+    freq_state_t const *f = &sched->freq[index];
+    stats->listen       = f->listen;
+    stats->event_rate   = f->hist_time > 0 ? f->hist_events / f->hist_time : 0;
+    stats->package_rate = f->hist_time > 0 ? f->hist_packages / f->hist_time : 0;
+    stats->dwells       = f->dwells;
+    stats->packages     = f->packages;
+    stats->events       = f->events;
+    for (unsigned i = 0; i < HOP_SCHED_SENSORS; ++i) {
+        double due = sensor_due(&f->sensors[i], now);
+        if (!due)
+            continue;
+        stats->sensors++;
+        if (!stats->next_due || due < stats->next_due)
+            stats->next_due = due;
+    }
+}
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (a), (b)); \
+        } \
+    } while (0)
+
+/// Simulate a sensor reporting every period s on frequency 1 of 2, returns the captured reports of the last 100.
+static int simulate(double period, int repeats)
+{
+    double dwell[2] = {1.0, 1.0};
+    hop_sched_t *sched = hop_sched_create(2);
+    if (!sched)
+        return -1;
+    unsigned index   = 0;
+    double dwell_end = dwell[0];
+    double report    = 5.0;
+    int reports      = 0;
+    int captured     = 0;
+    while (reports < 200) {
+        if (report < dwell_end) {
+            if (index == 1) {
+                for (int r = 0; r < repeats; ++r)
+                    hop_sched_event(sched, 1, 0x433, report + r * 0.1);
+                captured += reports >= 100;
+            }
+            reports++;
+            report += period;
+        }
+        else {
+            double next_dwell;
+            index = hop_sched_next(sched, dwell_end, dwell, &next_dwell);
+            dwell_end += next_dwell;
+        }
+    }
+    hop_sched_free(sched);
+    return captured;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    double dwell[3] = {1.0, 1.0, 1.0};
+    double next_dwell;
+    hop_sched_stats_t stats;
+
+    fprintf(stderr, "hop_sched:: visit all frequencies first\n");
+    hop_sched_t *sched = hop_sched_create(3);
+    ASSERT_EQUALS(sched != NULL, 1);
+    ASSERT_EQUALS((int)hop_sched_next(sched, 1.0, dwell, &next_dwell), 1);
+    ASSERT_EQUALS((int)hop_sched_next(sched, 2.0, dwell, &next_dwell), 2);
+    ASSERT_EQUALS(next_dwell == 1.0, 1);
+
+    fprintf(stderr, "hop_sched:: stay where the events are\n");
+    hop_sched_event(sched, 2, 0, 2.5);
+    hop_sched_package(sched, 2);
+    ASSERT_EQUALS((int)hop_sched_next(sched, 3.0, dwell, &next_dwell), 2);
+    hop_sched_get_stats(sched, 2, 3.0, &stats);
+    ASSERT_EQUALS((int)stats.events, 1);
+    ASSERT_EQUALS((int)stats.packages, 1);
+    ASSERT_EQUALS((int)stats.dwells, 1);
+    ASSERT_EQUALS(stats.event_rate == 1.0, 1);
+    ASSERT_EQUALS((int)hop_sched_next(sched, 4.0, dwell, &next_dwell), 2);
+
+    fprintf(stderr, "hop_sched:: learn the report interval\n");
+    hop_sched_event(sched, 2, 0x433, 4.5);
+    hop_sched_event(sched, 2, 0x433, 4.6); // repeat
+    hop_sched_event(sched, 2, 0x433, 34.5);
+    hop_sched_get_stats(sched, 2, 35.0, &stats);
+    ASSERT_EQUALS((int)stats.sensors, 1);
+    ASSERT_EQUALS(stats.next_due == 64.5, 1);
+    ASSERT_EQUALS((int)stats.events, 4);
+    hop_sched_free(sched);
+
+    fprintf(stderr, "hop_sched:: catch a periodic sensor\n");
+    ASSERT_EQUALS(simulate(30.0, 1) >= 95, 1);
+    ASSERT_EQUALS(simulate(47.0, 3) >= 95, 1);
+    ASSERT_EQUALS(simulate(16.0, 2) >= 95, 1);
+
+    fprintf(stderr, "hop_sched:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -19,8 +19,15 @@ A choice of endpoints are available:
 - "/cmd": simple JSON command API
 - "/events": HTTP (chunked) streaming API, streams JSON events
 - "/stream": HTTP (plain) streaming API, streams JSON events
-- "/api": RESTful API (not implemented)
-- "ws:": Websocket API (similar to cmd/events API)
+- "/api": RESTful API (currently the streaming stats only)
+- "/api/profile": folded stacks of the last CPU time profile, see "start_profile"
+- "/api/trace": the recorded trace as Chrome trace JSON, see "trace"
+- "/api/discovery": the signal shapes of the undecoded packages as JSON, with -Y discover
+- "/api/discovery/sample?shape=N": the sample package of a signal shape in the .ook format
+- "/api/sensors": the last event of each sensor, see "Sensors"
+- "/api/iq?seq=N": the samples of an IQ snippet, with -Y snippets, see "IQ snippets"
+- "/metrics": OpenMetrics (Prometheus) exposition of the program, decoder, DSP, and output counters
+- "ws:": Websocket API (similar to cmd/events API), streams the spectrum with -Y spectrum, see "Spectrum"
 
 ## JSON-RPC API
 
@@ -49,6 +56,50 @@ On Events and Stream endpoints a keep-alive of CRLF will be send every 60 second
 Use e.g. httpie with `http --stream --timeout=70 :8433/events`
 or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 
+The last events are kept as history, by default 100 events in at most 1 MiB,
+set e.g. `-F http:0.0.0.0:8433,history=1000,history_size=4000000`.
+Websocket clients receive the history on connect.
+Events and Stream clients receive the history after a sequence number with `?since=<seq>`,
+events then carry a "seq" key to resume after a reconnect, e.g. `/events?since=0`.
+
+With an event log, e.g. `-F eventlog:rtl_433_events -F http:0.0.0.0:8433,eventlog=rtl_433_events`,
+Events and Stream clients read the log from a sequence number with `?from=<seq>` (0 for the
+oldest record) and then follow the records as they are appended, the "seq" key is the log
+sequence number and survives restarts. The records are located with the segment index and
+sent from the mapped segments, independent of the history. A client behind the oldest segment
+continues at the oldest record, the lost records show as a gap in the sequence numbers.
+Add `?model=<model>` to only receive events of that model.
+
+Events are queued per client. A client that falls behind loses the oldest queued events,
+a client that doesn't receive anything for 30 seconds while its queue is full is closed.
+The counts are reported on "/api".
+
+## Compression and deltas
+
+Websocket clients that offer permessage-deflate (RFC 7692, all current browsers do) receive
+the events compressed, with one compression context per client, the repeated keys and values
+then take a few bytes each. Events and Stream clients with `Accept-Encoding: gzip` receive a
+gzip stream, e.g. `curl -N --compressed :8433/events`. The window of each client is 16 KiB,
+about 128 KiB of memory per client. Set `-F http:0.0.0.0:8433,compress=0` to turn it off,
+builds without zlib don't compress.
+
+Add `?delta=1` (e.g. `ws://127.0.0.1:8433/ws?delta=1`) to receive only the fields that changed
+since the last event of the same sensor, with the model, id, channel, and time, and `"delta":1`.
+The first event of a sensor, an event after a missed one, and an event with a field gone or a
+nested field is sent whole, merge the deltas into the last whole event of the sensor.
+Each delta is rendered once and shared by all delta clients. Deltas need the sensor table,
+the event log (`?from=`) sends whole events.
+
+## Sensors
+
+The last event of each sensor (model, id, channel) is kept with the time it was first and
+last heard, its event count, and the rssi, by default for 256 sensors, set e.g.
+`-F http:0.0.0.0:8433,sensors=1000`, `sensors=0` turns it off. A new sensor in a full
+table replaces the sensor heard least recently.
+"/api/sensors" pages through the table with `?limit=<n>` (default 100, max 1000), a page
+that doesn't hold all sensors has a "next" cursor to get the next page with `?cursor=<next>`.
+Get a single sensor with e.g. `/api/sensors?model=Acurite-Tower&id=1234&channel=A`.
+
 ## Queries
 
 - "registered_protocols"
@@ -90,6 +141,61 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 - "report_meta":      "time"|"reltime"|"notime"|"hires"|"utc"|"protocol"|"level"
 - "convert":          "native"|"si"|"customary"
 - "protocol":         1
+- "reload":           0  (rebuild the decoders from the conf files and the command line, as on SIGHUP)
+- "start_profile":    10 (time the stages, decoders, and outputs for 10 seconds, 0 until "stop_profile")
+- "stop_profile":     0  (stop a profile, returns the "folded" stacks)
+- "trace":            1  (record the hot path events, 0 to stop, as with -M trace)
+- "spectrum":         1  (stream the spectrum to this websocket, 0 to stop, with -Y spectrum)
+
+## Profile
+
+A profile reports the CPU time since "start_profile" as folded stacks, one line per stack
+with the time in microseconds, e.g. "sdr_callback;run_ook_demods;pulse_slicer_pwm;Acurite 986 1234".
+Get the stacks of the running or last profile as text on "/api/profile", render with e.g.
+`curl -s :8433/api/profile | flamegraph.pl --countname=us >profile.svg`.
+The stacks are built from the -M cputime counters, which are enabled while profiling.
+
+## Trace
+
+With "trace" on, each thread records its SDR buffers, DSP runs, packages, decoder runs,
+and output deliveries to a ring, the last events of about 1 MiB are kept.
+Get them from "/api/trace" and load the file in chrome://tracing or https://ui.perfetto.dev,
+e.g. `curl -s -o trace.json :8433/api/trace`. SIGUSR2 writes the same to rtl_433_trace.json.
+
+## Discovery
+
+With -Y discover the packages no decoder takes are grouped by their signal shape.
+"/api/discovery" lists the shapes with their counts, widths, and the modulation guess,
+flex decoder spec, and bits of the sample with the best SNR. Get the sample to test a
+decoder on with e.g. `curl -s -o shape3.ook ':8433/api/discovery/sample?shape=3'`
+and `rtl_433 -r shape3.ook -X '...'`.
+
+## IQ snippets
+
+With -Y snippets the samples of each package, and a margin, are saved to a log and the
+events carry the snippet number as "iq". Get the samples with e.g.
+`curl -s -OJ ':8433/api/iq?seq=42'`, the file name has the format, center frequency, and
+sample rate for `rtl_433 -r`, e.g. "iq42_433.92M_250k.cu8". The log keeps the most recent
+snippets, an older one is gone.
+
+## Spectrum
+
+With -Y spectrum an averaged spectrum is computed once per -Y spectrum_interval of input.
+A websocket client subscribes with the "spectrum" command and receives each new snapshot as
+`{"spectrum":{"time_us":..,"center_frequency":..,"sample_rate":..,"averages":..,"bins":..,"db":[..]}}`,
+the power in dBFS of each bin from -sample_rate/2 to +sample_rate/2 around the center frequency.
+A client with a full send buffer skips snapshots.
+
+## Thread
+
+With `-F http:0.0.0.0:8433,thread` the server runs its own event manager on its own thread,
+a burst of requests or a long replay then doesn't delay the SDR input and the decoders.
+The events are queued to the server thread (1024 at most, a full queue drops events, counted
+as "events_dropped" on "/api"). The listings of "get_meta", "get_protocols", and "get_stats"
+are served from snapshots the event loop publishes, meta and protocols after each change and
+after each command, stats once a second for 10 seconds after a "get_stats". The commands,
+"/metrics", "/api/profile", and "/api/discovery" read the config and are run on the event loop,
+the streaming, history, sensors, IQ snippets, trace, and spectrum are served on the server thread.
 
 */
 
@@ -107,7 +213,26 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 #include "mongoose.h"
 #include "logger.h"
 #include "fatal.h"
+#include "cpu_stats.h"
+#include "cpu_profile.h"
+#include "trace.h"
+#include "dsp_thread.h"
+#include "dump_writer.h"
+#include "metrics.h"
+#include "pulse_analyzer.h"
+#include "sensor_table.h"
+#include "event_log.h"
+#include "iq_snippet.h"
+#include "spectrum.h"
+#include "calibrate.h"
+#include "output_eventlog.h"
+#include "ring_queue.h"
+#include "stream_deflate.h"
+#include "compat_pthread.h"
+#include <signal.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
 
 // embed index.html so browsers allow access as local
 #define INDEX_HTML \
@@ -128,109 +253,74 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
     "<script src=\"https://triq.org/rxui/js/chunk-vendors.js\"></script>" \
     "<script src=\"https://triq.org/rxui/js/app.js\"></script>"
 
-// generic ring list
-
-#define DEFAULT_HISTORY_SIZE 100
-
-typedef struct {
-    unsigned size;
-    void **data;
-    void **head;
-    void **tail;
-} ring_list_t;
-
-static ring_list_t *ring_list_new(unsigned size)
-{
-    ring_list_t *ring = calloc(1, sizeof(ring_list_t));
-    if (!ring) {
-        WARN_CALLOC("ring_list_new()");
-        return NULL;
-    }
-
-    ring->data = calloc(size, sizeof(void *));
-    if (!ring->data) {
-        WARN_CALLOC("ring_list_new()");
-        free(ring);
-        return NULL;
-    }
-
-    ring->size = size;
-    ring->tail = ring->data;
-
-    return ring;
-}
-
-// the ring needs to be empty before calling this
-static void ring_list_free(ring_list_t *ring)
-{
-    if (ring) {
-        if (ring->data)
-            free(ring->data);
-        free(ring);
-    }
-}
-
-// free the data returned
-static void *ring_list_shift(ring_list_t *ring)
-{
-    if (!ring->head)
-        return NULL;
-
-    void *ret = *ring->head;
-
-    ++ring->head;
-    if (ring->head >= ring->data + ring->size)
-        ring->head -= ring->size;
-    if (ring->head == ring->tail)
-        ring->head = NULL;
-
-    return ret;
-}
-
-// retain data before passing in and free the data returned.
-static void *ring_list_push(ring_list_t *ring, void *data)
-{
-    *ring->tail = data;
-
-    if (!ring->head)
-        ring->head = ring->tail;
-
-    ++ring->tail;
-    if (ring->tail >= ring->data + ring->size)
-        ring->tail -= ring->size;
-
-    if (ring->tail == ring->head)
-        return ring_list_shift(ring);
-
-    return NULL;
-}
-
-static void **ring_list_iter(ring_list_t *ring)
-{
-    return ring->head;
-}
+// data helpers that could go into r_api
 
-static void **ring_list_next(ring_list_t *ring, void **iter)
+/// The config values listed by meta_data(), a cached listing is current while these are equal.
+typedef struct meta_key {
+    uint32_t frequency[MAX_FREQS];
+    int frequencies;
+    int hop_time_ms[MAX_FREQS];
+    int hop_times;
+    uint32_t center_frequency;
+    int duration;
+    uint32_t samp_rate;
+    int conversion_mode;
+    int fsk_pulse_detect_mode;
+    int after_successful_events_flag;
+    int report_meta;
+    int report_protocol;
+    int report_time;
+    int report_time_hires;
+    int report_time_tz;
+    int report_time_utc;
+    int report_description;
+    int report_stats;
+    int stats_interval;
+    int simd;
+    uint32_t fused_block;
+    int calibration_source;
+} meta_key_t;
+
+static void meta_key_get(r_cfg_t *cfg, meta_key_t *key)
 {
-    if (!iter)
-        return NULL;
-
-    ++iter;
-    if (iter >= ring->data + ring->size)
-        iter -= ring->size;
-    if (iter == ring->tail)
-        iter = NULL;
-
-    return iter;
+    memset(key, 0, sizeof(*key)); // the unused entries and any padding compare equal
+    for (int i = 0; i < cfg->frequencies; ++i)
+        key->frequency[i] = cfg->frequency[i];
+    key->frequencies = cfg->frequencies;
+    for (int i = 0; i < cfg->hop_times; ++i)
+        key->hop_time_ms[i] = cfg->hop_time_ms[i];
+    key->hop_times                    = cfg->hop_times;
+    key->center_frequency             = cfg->center_frequency;
+    key->duration                     = cfg->duration;
+    key->samp_rate                    = cfg->samp_rate;
+    key->conversion_mode              = cfg->conversion_mode;
+    key->fsk_pulse_detect_mode        = cfg->fsk_pulse_detect_mode;
+    key->after_successful_events_flag = cfg->after_successful_events_flag;
+    key->report_meta                  = cfg->report_meta;
+    key->report_protocol              = cfg->report_protocol;
+    key->report_time                  = cfg->report_time;
+    key->report_time_hires            = cfg->report_time_hires;
+    key->report_time_tz               = cfg->report_time_tz;
+    key->report_time_utc              = cfg->report_time_utc;
+    key->report_description           = cfg->report_description;
+    key->report_stats                 = cfg->report_stats;
+    key->simd                         = baseband_get_simd();
+    key->fused_block                  = baseband_get_fused_block();
+    key->calibration_source           = cfg->calibration_source;
+    key->stats_interval               = cfg->stats_interval;
 }
 
-// data helpers that could go into r_api
+/// Names of the calibration_source values.
+static char const *const calibration_names[] = {"default", "cached", "measured"};
 
 static data_t *meta_data(r_cfg_t *cfg)
 {
+    double hop_times[MAX_FREQS]; // in seconds
+    for (int i = 0; i < cfg->hop_times; ++i)
+        hop_times[i] = cfg->hop_time_ms[i] / 1000.0;
     return data_make(
             "frequencies", "", DATA_ARRAY, data_array(cfg->frequencies, DATA_INT, cfg->frequency),
-            "hop_times", "", DATA_ARRAY, data_array(cfg->hop_times, DATA_INT, cfg->hop_time),
+            "hop_times", "", DATA_ARRAY, data_array(cfg->hop_times, DATA_DOUBLE, hop_times),
             "center_frequency", "", DATA_INT, cfg->center_frequency,
             "duration", "", DATA_INT, cfg->duration,
             "samp_rate", "", DATA_INT, cfg->samp_rate,
@@ -246,6 +336,9 @@ static data_t *meta_data(r_cfg_t *cfg)
             "report_description", "", DATA_INT, cfg->report_description,
             "report_stats", "", DATA_INT, cfg->report_stats,
             "stats_interval", "", DATA_INT, cfg->stats_interval,
+            "kernels", "", DATA_STRING, baseband_simd_name(baseband_get_simd()),
+            "fused_block", "", DATA_INT, baseband_get_fused_block(),
+            "calibration", "", DATA_STRING, calibration_names[cfg->calibration_source],
             NULL);
 }
 
@@ -325,10 +418,19 @@ static data_t *protocols_data(r_cfg_t *cfg)
 
 typedef struct rpc rpc_t;
 
+static void rpc_start_profile(rpc_t *rpc);
+static void rpc_stop_profile(rpc_t *rpc);
+static void rpc_get_meta(rpc_t *rpc);
+static void rpc_get_protocols(rpc_t *rpc);
+static void rpc_get_stats(rpc_t *rpc);
+static void rpc_spectrum(rpc_t *rpc);
+
 typedef void (*rpc_response_fn)(rpc_t *rpc, int error_code, char const *message, int is_json);
 
 struct rpc {
     struct mg_connection *nc;
+    struct http_server_context *ctx;
+    struct http_call *call; ///< the call the reply is kept in on the event loop, NULL to reply on nc
     rpc_response_fn response;
     int ver;
     char *method;
@@ -533,7 +635,7 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 2, NULL, cfg->ppm_error);
     }
     else if (!strcmp(rpc->method, "get_hop_interval")) {
-        rpc->response(rpc, 2, NULL, cfg->hop_time[0]);
+        rpc->response(rpc, 2, NULL, cfg->hop_time_ms[0] / 1000); // in seconds
     }
     else if (!strcmp(rpc->method, "get_center_frequency")) {
         rpc->response(rpc, 3, NULL, cfg->center_frequency); // unsigned
@@ -557,31 +659,42 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 2, NULL, cfg->conversion_mode);
     }
     else if (!strcmp(rpc->method, "get_stats")) {
-        char buf[20480]; // we expect the stats string to be around 15k bytes.
-        data_t *data = create_report_data(cfg, 2/*report active devices*/);
-        // flush_report_data(cfg); // snapshot, do not flush
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
-        data_free(data);
+        rpc_get_stats(rpc);
     }
     else if (!strcmp(rpc->method, "get_meta")) {
-        char buf[2048]; // we expect the meta string to be around 500 bytes.
-        data_t *data = meta_data(cfg);
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
-        data_free(data);
+        rpc_get_meta(rpc);
+    }
+    else if (!strcmp(rpc->method, "get_hop_schedule")) {
+        char buf[8192]; // we expect the schedule string to be around 200 bytes per frequency.
+        data_t *data = create_hop_schedule_data(cfg);
+        if (!data) {
+            rpc->response(rpc, -1, "Adaptive hopping is off", 0);
+        }
+        else {
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc->response(rpc, 1, buf, 0);
+            data_free(data);
+        }
+    }
+    else if (!strcmp(rpc->method, "get_band_scan")) {
+        char buf[8192]; // around 150 bytes per channel
+        data_t *data = create_band_scan_data(cfg);
+        if (!data) {
+            rpc->response(rpc, -1, "Band scan is off", 0);
+        }
+        else {
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc->response(rpc, 1, buf, 0);
+            data_free(data);
+        }
     }
     else if (!strcmp(rpc->method, "get_protocols")) {
-        char buf[65536]; // we expect the protocol string to be around 60k bytes.
-        data_t *data = protocols_data(cfg);
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
-        data_free(data);
+        rpc_get_protocols(rpc);
     }
 
     // Setter
     else if (!strcmp(rpc->method, "hop_interval")) {
-        cfg->hop_time[0] = rpc->val;
+        cfg->hop_time_ms[0] = rpc->val * 1000; // in seconds
         rpc->response(rpc, 0, "Ok", 0);
     }
     else if (!strcmp(rpc->method, "report_meta")) {
@@ -610,6 +723,7 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 0, "Ok", 0);
     }
     else if (!strcmp(rpc->method, "convert")) {
+        // the decoders registered with native units look up their conversions on output
         cfg->conversion_mode = rpc->val;
         rpc->response(rpc, 0, "Ok", 0);
     }
@@ -629,6 +743,23 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         // set_protocol(rpc->val);
         rpc->response(rpc, 0, "Ok", 0);
     }
+    else if (!strcmp(rpc->method, "reload")) {
+        cfg->reload_now = 1; // the event loop rebuilds the decoders after this poll
+        rpc->response(rpc, 0, "Ok", 0);
+    }
+    else if (!strcmp(rpc->method, "start_profile")) {
+        rpc_start_profile(rpc);
+    }
+    else if (!strcmp(rpc->method, "stop_profile")) {
+        rpc_stop_profile(rpc);
+    }
+    else if (!strcmp(rpc->method, "trace")) {
+        trace_enable(rpc->val);
+        rpc->response(rpc, 0, "Ok", 0);
+    }
+    else if (!strcmp(rpc->method, "spectrum")) {
+        rpc_spectrum(rpc);
+    }
 
     // Apply
     else if (!strcmp(rpc->method, "device")) {
@@ -673,17 +804,814 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
 
 #define KEEP_ALIVE 60 /* seconds */
 
+#define WS_FLAG_RSV1 0x40 ///< the first frame of a compressed websocket message
+
+#define CLIENT_QUEUE_SIZE 256            ///< max messages queued per client
+#define CLIENT_QUEUE_BYTES (256 * 1024)  ///< high-water mark of queued bytes per client
+#define CLIENT_SEND_MBUF_MAX (16 * 1024) ///< move queued messages to the send buffer up to this size
+#define CLIENT_STALL_TIMEOUT 30          ///< seconds without progress before a client with a full queue is evicted
+
+#define DEFAULT_HISTORY_SIZE 100              ///< default max messages in the history
+#define DEFAULT_HISTORY_BYTES (1024 * 1024)   ///< default max bytes in the history
+#define DEFAULT_SENSORS_PAGE 100              ///< default sensors per page of "/api/sensors"
+
+#define THREAD_EVENTS_QUEUE 1024 ///< events queued to the server thread
+#define THREAD_CALLS_MAX 64      ///< requests of the server thread in flight on the event loop
+#define SNAPSHOT_INTERVAL 1.0    ///< seconds between the checks of the listings on the event loop
+#define STATS_SNAPSHOT_AGE 1.0   ///< seconds a stats snapshot answers "get_stats"
+#define STATS_SNAPSHOT_IDLE 10.0 ///< seconds the stats snapshot is refreshed after a "get_stats"
+
+/// A message shared by the history and all client queues, freed with the last reference.
+typedef struct http_msg {
+    unsigned refs;
+    unsigned seq;                ///< sequence number, increases by one for each message
+    double time;                 ///< time the message was received
+    char const *model;           ///< model of an event, from the model index, or NULL
+    struct http_msg *model_next; ///< next message of the same model in the history
+    unsigned sensor;             ///< index + 1 of the sensor of an event in the sensor table, or 0
+    unsigned sensor_prev;        ///< the sequence number of the previous event of the sensor, or 0
+    char *delta;                 ///< the fields changed since the previous event of the sensor, or NULL
+    size_t delta_len;
+    size_t len;
+    char text[];
+} http_msg_t;
+
+/// The messages of a model in the history, oldest to newest chained with model_next.
+typedef struct http_model {
+    char *name;
+    http_msg_t *first;
+    http_msg_t *last;
+} http_model_t;
+
+/// A streaming client on the events, stream, or websocket API.
+typedef struct http_client {
+    struct http_client *next;
+    struct mg_connection *nc;
+    int is_chunked;
+    int with_seq;         ///< add the sequence number to events
+    int replaying;        ///< sending the history from replay_seq before queued messages
+    unsigned replay_seq;  ///< the next message of the history to send
+    uint64_t log_seq;     ///< the next record of the event log to send, 0 if not reading the log
+    char *model;          ///< only send events of this model, or NULL
+    int spectrum;         ///< stream the spectrum snapshots, websocket only
+    unsigned spectrum_seq; ///< the last spectrum snapshot sent
+    stream_deflate_t *deflate; ///< compresses the messages, permessage-deflate or gzip, or NULL
+    unsigned *sensor_seq; ///< with deltas, the last event sent of each sensor in the sensor table, or NULL
+    http_msg_t *queue[CLIENT_QUEUE_SIZE];
+    unsigned queue_head;
+    unsigned queue_len;
+    size_t queue_bytes;
+    double last_progress; ///< time the client last received data
+} http_client_t;
+
+/// A JSON listing published by the event loop, never changed, freed with the last reference.
+typedef struct http_snapshot {
+    unsigned refs; ///< guarded by the lock of the server
+    double time;   ///< time the listing was published
+    size_t len;
+    char text[];
+} http_snapshot_t;
+
+/// A reply rendered where the config is read, sent where the connection is served.
+typedef struct http_reply {
+    int status;        ///< the HTTP status code, 0 if not rendered
+    char const *type;  ///< the content type of the body
+    char const *error; ///< the message of an error status, or NULL
+    char *body;        ///< the body of a 200 reply
+    size_t len;
+    int close;         ///< close the connection after the reply
+} http_reply_t;
+
+enum http_call_kind {
+    HTTP_CALL_RPC,       ///< a command
+    HTTP_CALL_METRICS,   ///< "/metrics"
+    HTTP_CALL_PROFILE,   ///< "/api/profile"
+    HTTP_CALL_DISCOVERY, ///< "/api/discovery"
+    HTTP_CALL_SAMPLE,    ///< "/api/discovery/sample"
+};
+
+/// A request the server thread hands to the event loop, the event loop renders the reply and hands it back.
+typedef struct http_call {
+    struct http_call *next;   ///< the next request in flight
+    struct mg_connection *nc; ///< the connection waiting for the reply, NULL once closed
+    int kind;
+    unsigned shape;           ///< the signal shape of HTTP_CALL_SAMPLE
+    rpc_t rpc;                ///< the command of HTTP_CALL_RPC
+    rpc_response_fn response; ///< frames the reply of the command on nc
+    int replied;
+    int code;                 ///< the reply code of the command
+    int arg;                  ///< the reply value of the command
+    http_reply_t reply;       ///< the reply, the message of a command in body or error
+} http_call_t;
+
+/// A record queued to the server thread.
+typedef struct http_event {
+    data_t *data; ///< retained
+    char *json;   ///< the record with a projection rendered on the event loop, or NULL
+    size_t len;
+    data_skip_t const *skip; ///< the projection of json, or NULL
+} http_event_t;
+
+/// The counters of the clients and the history as reported on "/api".
+typedef struct http_counters {
+    unsigned clients;
+    unsigned history;
+    size_t history_bytes;
+    unsigned history_seq;
+    double history_time; ///< time of the oldest message in the history, 0 if empty
+    unsigned history_models;
+    unsigned messages;
+    size_t messages_bytes;
+    unsigned queued;
+    size_t queued_bytes;
+    unsigned dropped;
+    unsigned evicted;
+    unsigned sensors;
+    unsigned sensors_evicted;
+    unsigned deflate_clients;
+    uint64_t deflate_in;
+    uint64_t deflate_out;
+    unsigned delta_clients;
+    unsigned deltas;
+    unsigned deltas_sent;
+} http_counters_t;
+
 struct http_server_context {
     struct mg_connection *conn;
     struct mg_serve_http_opts server_opts;
     r_cfg_t *cfg;
     struct data_output *output;
-    ring_list_t *history;
+    http_msg_t **history;  ///< ring of the last messages
+    unsigned history_max;  ///< max messages in the history
+    size_t history_budget; ///< max bytes in the history
+    unsigned history_head;
+    unsigned history_len;
+    size_t history_bytes;
+    unsigned next_seq;     ///< the sequence number of the next message
+    http_model_t *models;  ///< open addressing hash of the models in the history
+    unsigned models_size;  ///< power of two
+    unsigned num_models;
+    http_client_t *clients;
+    unsigned num_clients;
+    unsigned num_msgs;  ///< shared messages alive
+    size_t msgs_bytes;  ///< bytes of shared messages alive
+    unsigned dropped;   ///< messages dropped from full client queues
+    unsigned evicted;   ///< stalled clients closed
+    sensor_table_t sensors; ///< the last event of each sensor, no capacity if off
+    unsigned *sensor_seq;   ///< the sequence number of the last event of each sensor, NULL if off
+    int compress;             ///< compress for the clients that accept it
+    unsigned deflate_clients; ///< clients receiving compressed messages
+    uint64_t deflate_in;      ///< bytes of messages compressed
+    uint64_t deflate_out;     ///< bytes of compressed messages
+    unsigned delta_clients;   ///< clients receiving deltas
+    unsigned deltas;          ///< deltas rendered
+    unsigned deltas_sent;     ///< deltas sent to clients
+    event_log_reader_t *log; ///< the event log of "/events?from=", NULL if not set
+    unsigned log_clients;    ///< clients reading the event log
+    event_log_reader_t *iq_log; ///< the IQ snippet log of "/api/iq", opened on the first request
+    unsigned spectrum_clients; ///< clients streaming the spectrum
+    unsigned spectrum_seq;     ///< the snapshot in spectrum_json, 0 if none
+    char *spectrum_json;       ///< the last snapshot as websocket message, allocated on the first use
+    size_t spectrum_len;
+    float *spectrum_db;        ///< room for the bins of a snapshot
+    cpu_profile_t profile; ///< stopped by a timer on conn, or on loop with a thread, if timed
+    double profile_until;  ///< time a timed profile stops, 0 if not timed
+    http_snapshot_t *meta; ///< the get_meta listing, NULL until published
+    meta_key_t meta_key;   ///< the config values of meta
+    http_snapshot_t *protocols; ///< the get_protocols listing, NULL until published
+    unsigned protocols_changes; ///< cfg->protocols_changes of protocols
+    http_snapshot_t *stats;     ///< the get_stats listing, NULL until requested
+    double stats_wanted;        ///< refresh the stats on the event loop until this time
+    // with a thread, only the snapshots, the counters, and stop are shared, under the lock
+    int threaded;               ///< the server runs on its own thread
+    struct mg_mgr mgr;          ///< the event manager of the server thread
+    struct mg_connection *loop; ///< the listings timer on the event loop
+    ring_queue_t *events;       ///< records from the event loop to the server thread
+    ring_queue_t *calls;        ///< requests from the server thread to the event loop
+    ring_queue_t *replies;      ///< replies from the event loop to the server thread
+    http_call_t *pending;       ///< the requests in flight, server thread only
+    unsigned num_pending;
+    data_render_t render;       ///< renders the records on the server thread
+    http_counters_t counters;   ///< published by the server thread after each poll
+    int stop;                   ///< the server thread exits
+#ifdef THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+#endif
 };
 
-struct nc_context {
-    int is_chunked;
-};
+static void http_lock(struct http_server_context *ctx)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&ctx->lock);
+#else
+    (void)ctx;
+#endif
+}
+
+static void http_unlock(struct http_server_context *ctx)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&ctx->lock);
+#else
+    (void)ctx;
+#endif
+}
+
+/// Publish a listing to @p slot, the readers keep the snapshot they took, returns -1 on alloc failure.
+static int http_snapshot_publish(struct http_server_context *ctx, http_snapshot_t **slot, char const *text, size_t len)
+{
+    http_snapshot_t *snap = malloc(sizeof(*snap) + len + 1);
+    if (!snap) {
+        WARN_MALLOC("http_snapshot_publish()");
+        return -1;
+    }
+    snap->refs = 1;
+    snap->time = mg_time();
+    snap->len  = len;
+    memcpy(snap->text, text, len);
+    snap->text[len] = '\0';
+
+    http_lock(ctx);
+    http_snapshot_t *old = *slot;
+    *slot                = snap;
+    int last             = old && !--old->refs;
+    http_unlock(ctx);
+    if (last)
+        free(old);
+    return 0;
+}
+
+/// Take the snapshot of @p slot, NULL if none or older than @p max_age seconds (if not 0).
+static http_snapshot_t *http_snapshot_get(struct http_server_context *ctx, http_snapshot_t **slot, double max_age)
+{
+    http_lock(ctx);
+    http_snapshot_t *snap = *slot;
+    if (snap && max_age > 0 && mg_time() - snap->time > max_age)
+        snap = NULL;
+    if (snap)
+        snap->refs++;
+    http_unlock(ctx);
+    return snap;
+}
+
+static void http_snapshot_unref(struct http_server_context *ctx, http_snapshot_t *snap)
+{
+    if (!snap)
+        return;
+    http_lock(ctx);
+    int last = !--snap->refs;
+    http_unlock(ctx);
+    if (last)
+        free(snap);
+}
+
+// the listings are built on the event loop, dashboards poll them, meta and protocols are rebuilt only after a change
+
+static void http_update_meta(struct http_server_context *ctx)
+{
+    meta_key_t key;
+    meta_key_get(ctx->cfg, &key);
+    if (ctx->meta && !memcmp(&key, &ctx->meta_key, sizeof(key)))
+        return;
+    char buf[2048]; // we expect the meta string to be around 500 bytes.
+    data_t *data = meta_data(ctx->cfg);
+    size_t len   = data_print_jsons(data, buf, sizeof(buf));
+    data_free(data);
+    if (!http_snapshot_publish(ctx, &ctx->meta, buf, len))
+        ctx->meta_key = key;
+}
+
+static void http_update_protocols(struct http_server_context *ctx)
+{
+    if (ctx->protocols && ctx->protocols_changes == ctx->cfg->protocols_changes)
+        return;
+    char buf[65536]; // we expect the protocol string to be around 60k bytes.
+    data_t *data = protocols_data(ctx->cfg);
+    size_t len   = data_print_jsons(data, buf, sizeof(buf));
+    data_free(data);
+    if (!http_snapshot_publish(ctx, &ctx->protocols, buf, len))
+        ctx->protocols_changes = ctx->cfg->protocols_changes;
+}
+
+static void http_update_stats(struct http_server_context *ctx)
+{
+    char buf[20480]; // we expect the stats string to be around 15k bytes.
+    data_t *data = create_report_data(ctx->cfg, 2/*report active devices*/);
+    // flush_report_data(cfg); // snapshot, do not flush
+    size_t len = data_print_jsons(data, buf, sizeof(buf));
+    data_free(data);
+    http_snapshot_publish(ctx, &ctx->stats, buf, len);
+}
+
+static http_msg_t *http_msg_new(struct http_server_context *ctx, char const *text, size_t len)
+{
+    http_msg_t *msg = malloc(sizeof(*msg) + len + 1);
+    if (!msg) {
+        WARN_MALLOC("http_msg_new()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    msg->refs        = 1;
+    msg->seq         = 0;
+    msg->time        = 0.0;
+    msg->model       = NULL;
+    msg->model_next  = NULL;
+    msg->sensor      = 0;
+    msg->sensor_prev = 0;
+    msg->delta       = NULL;
+    msg->delta_len   = 0;
+    msg->len         = len;
+    memcpy(msg->text, text, len);
+    msg->text[len] = '\0';
+    ctx->num_msgs++;
+    ctx->msgs_bytes += len;
+    return msg;
+}
+
+static void http_msg_unref(struct http_server_context *ctx, http_msg_t *msg)
+{
+    if (!msg || --msg->refs)
+        return;
+    ctx->num_msgs--;
+    ctx->msgs_bytes -= msg->len + msg->delta_len;
+    free(msg->delta);
+    free(msg);
+}
+
+static unsigned http_model_hash(char const *name)
+{
+    unsigned h = 2166136261u; // FNV-1a
+    for (; *name; ++name)
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+/// Returns the model index entry of @p name, NULL if not found.
+static http_model_t *http_model_find(struct http_server_context *ctx, char const *name)
+{
+    if (!ctx->models_size)
+        return NULL;
+    unsigned mask = ctx->models_size - 1;
+    for (unsigned i = http_model_hash(name) & mask;; i = (i + 1) & mask) {
+        http_model_t *m = &ctx->models[i];
+        if (!m->name)
+            return NULL;
+        if (!strcmp(m->name, name))
+            return m;
+    }
+}
+
+/// Returns the model index entry of @p name, adds the model if needed, NULL on alloc failure.
+static http_model_t *http_model_add(struct http_server_context *ctx, char const *name)
+{
+    http_model_t *m = http_model_find(ctx, name);
+    if (m)
+        return m;
+
+    if (2 * (ctx->num_models + 1) > ctx->models_size) {
+        unsigned size = ctx->models_size ? ctx->models_size * 2 : 64;
+        http_model_t *models = calloc(size, sizeof(*models));
+        if (!models) {
+            WARN_CALLOC("http_model_add()");
+            return NULL; // NOTE: returns NULL on alloc failure.
+        }
+        for (unsigned j = 0; j < ctx->models_size; ++j) {
+            http_model_t *old = &ctx->models[j];
+            if (!old->name)
+                continue;
+            unsigned i = http_model_hash(old->name) & (size - 1);
+            while (models[i].name)
+                i = (i + 1) & (size - 1);
+            models[i] = *old;
+        }
+        free(ctx->models);
+        ctx->models      = models;
+        ctx->models_size = size;
+    }
+
+    char *dup = strdup(name);
+    if (!dup) {
+        WARN_STRDUP("http_model_add()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    unsigned mask = ctx->models_size - 1;
+    unsigned i    = http_model_hash(name) & mask;
+    while (ctx->models[i].name)
+        i = (i + 1) & mask;
+    m       = &ctx->models[i];
+    m->name = dup;
+    ctx->num_models++;
+    return m;
+}
+
+/// Returns the message with sequence number @p seq from the history, NULL if not in the history.
+static http_msg_t *http_history_get(struct http_server_context *ctx, unsigned seq)
+{
+    unsigned first = ctx->next_seq - ctx->history_len;
+    if (seq < first || seq >= ctx->next_seq)
+        return NULL;
+    return ctx->history[(ctx->history_head + seq - first) % ctx->history_max];
+}
+
+static void http_history_shift(struct http_server_context *ctx)
+{
+    http_msg_t *msg    = ctx->history[ctx->history_head];
+    ctx->history_head  = (ctx->history_head + 1) % ctx->history_max;
+    ctx->history_len--;
+    ctx->history_bytes -= msg->len;
+    if (msg->model) {
+        http_model_t *m = http_model_find(ctx, msg->model);
+        if (m) {
+            m->first = msg->model_next;
+            if (!m->first)
+                m->last = NULL;
+        }
+        msg->model_next = NULL;
+    }
+    http_msg_unref(ctx, msg);
+}
+
+/// Add a message to the history, assigns the sequence number, drops the oldest messages above the limits.
+static void http_history_push(struct http_server_context *ctx, http_msg_t *msg, char const *model)
+{
+    msg->seq  = ctx->next_seq++;
+    msg->time = mg_time();
+
+    if (msg->len > ctx->history_budget)
+        return; // too big to keep
+    while (ctx->history_len && (ctx->history_len >= ctx->history_max || ctx->history_bytes + msg->len > ctx->history_budget))
+        http_history_shift(ctx);
+
+    http_model_t *m = model ? http_model_add(ctx, model) : NULL;
+    if (m) {
+        msg->model = m->name;
+        if (m->last)
+            m->last->model_next = msg;
+        else
+            m->first = msg;
+        m->last = msg;
+    }
+
+    msg->refs++;
+    ctx->history[(ctx->history_head + ctx->history_len) % ctx->history_max] = msg;
+    ctx->history_len++;
+    ctx->history_bytes += msg->len;
+}
+
+/// Returns the first message after @p since in the history, of @p model if given, NULL if none.
+static http_msg_t *http_history_after(struct http_server_context *ctx, unsigned since, char const *model)
+{
+    unsigned first = ctx->next_seq - ctx->history_len;
+    if (since < first)
+        since = first - 1;
+    if (!model)
+        return http_history_get(ctx, since + 1);
+
+    http_model_t *m = http_model_find(ctx, model);
+    http_msg_t *msg = m ? m->first : NULL;
+    while (msg && msg->seq <= since)
+        msg = msg->model_next;
+    return msg;
+}
+
+static http_client_t *http_client_find(struct http_server_context *ctx, struct mg_connection *nc)
+{
+    for (http_client_t *client = ctx->clients; client; client = client->next)
+        if (client->nc == nc)
+            return client;
+    return NULL;
+}
+
+/// Register a streaming client, the connection keeps the server context as user data.
+static http_client_t *http_client_add(struct http_server_context *ctx, struct mg_connection *nc, int is_chunked)
+{
+    http_client_t *client = calloc(1, sizeof(*client));
+    if (!client) {
+        WARN_CALLOC("http_client_add()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    client->nc            = nc;
+    client->is_chunked    = is_chunked;
+    client->last_progress = mg_time();
+    client->next          = ctx->clients;
+    ctx->clients          = client;
+    ctx->num_clients++;
+    return client;
+}
+
+static void http_client_remove(struct http_server_context *ctx, http_client_t *client)
+{
+    for (http_client_t **p = &ctx->clients; *p; p = &(*p)->next) {
+        if (*p == client) {
+            *p = client->next;
+            break;
+        }
+    }
+    for (; client->queue_len; client->queue_len--) {
+        http_msg_unref(ctx, client->queue[client->queue_head]);
+        client->queue_head = (client->queue_head + 1) % CLIENT_QUEUE_SIZE;
+    }
+    ctx->num_clients--;
+    if (client->log_seq)
+        ctx->log_clients--;
+    if (client->spectrum)
+        ctx->spectrum_clients--;
+    if (client->deflate)
+        ctx->deflate_clients--;
+    if (client->sensor_seq)
+        ctx->delta_clients--;
+    stream_deflate_free(client->deflate);
+    free(client->sensor_seq);
+    free(client->model);
+    free(client);
+}
+
+/// Write a compressed websocket message, mongoose masks the opcode and can't set RSV1.
+static void ws_send_deflated(struct mg_connection *nc, uint8_t const *buf, size_t len)
+{
+    uint8_t hdr[10];
+    size_t hdr_len = 2;
+    hdr[0] = 0x80 | WS_FLAG_RSV1 | WEBSOCKET_OP_TEXT; // FIN
+    if (len < 126) {
+        hdr[1] = (uint8_t)len;
+    }
+    else if (len < 65536) {
+        hdr[1]  = 126;
+        hdr[2]  = (uint8_t)(len >> 8);
+        hdr[3]  = (uint8_t)len;
+        hdr_len = 4;
+    }
+    else {
+        hdr[1] = 127;
+        for (int i = 0; i < 8; ++i)
+            hdr[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        hdr_len = 10;
+    }
+    mg_send(nc, hdr, (int)hdr_len);
+    mg_send(nc, buf, (int)len);
+}
+
+/// Write a message in parts to the send buffer of a client, compressed if negotiated, @p finish ends a gzip stream.
+static void http_client_write(struct http_server_context *ctx, http_client_t *client, struct mg_str const *parts, unsigned n, int finish)
+{
+    struct mg_connection *nc = client->nc;
+    if (client->deflate) {
+        void const *bufs[4];
+        size_t lens[4];
+        size_t in_len = 0;
+        for (unsigned i = 0; i < n; ++i) {
+            bufs[i] = parts[i].p;
+            lens[i] = parts[i].len;
+            in_len += parts[i].len;
+        }
+        uint8_t const *out;
+        size_t len = stream_deflate_write(client->deflate, bufs, lens, n, finish, &out);
+        if (!len) {
+            // the context of the peer no longer matches
+            nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            return; // NOTE: closes the client on alloc failure.
+        }
+        ctx->deflate_in += in_len;
+        ctx->deflate_out += len;
+        if (nc->flags & MG_F_IS_WEBSOCKET)
+            ws_send_deflated(nc, out, len);
+        else if (client->is_chunked)
+            mg_send_http_chunk(nc, (char const *)out, len);
+        else
+            mg_send(nc, out, (int)len);
+        return;
+    }
+
+    if (nc->flags & MG_F_IS_WEBSOCKET) {
+        mg_send_websocket_framev(nc, WEBSOCKET_OP_TEXT, parts, (int)n);
+        return;
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        if (!parts[i].len)
+            continue; // an empty chunk ends the response
+        if (client->is_chunked)
+            mg_send_http_chunk(nc, parts[i].p, parts[i].len);
+        else
+            mg_send(nc, parts[i].p, (int)parts[i].len);
+    }
+}
+
+/// Write a framed message with sequence number @p msg_seq to the send buffer of a client.
+static void http_client_send_text(struct http_server_context *ctx, http_client_t *client, char const *text, size_t len, uint64_t msg_seq)
+{
+    char seq[32]   = "";
+    size_t seq_len = 0;
+    // the sequence number is inserted as first key of the object
+    if (client->with_seq && len >= 2 && text[0] == '{') {
+        seq_len = snprintf(seq, sizeof(seq), "{\"seq\":%llu%s", (unsigned long long)msg_seq, text[1] == '}' ? "" : ",");
+        text++;
+        len--;
+    }
+
+    struct mg_str parts[3] = {{seq, seq_len}, {text, len}, {"\r\n", 2}};
+    // websocket messages are not terminated
+    http_client_write(ctx, client, parts, client->nc->flags & MG_F_IS_WEBSOCKET ? 2 : 3, 0);
+}
+
+/// Send a message, the delta of an event if the client received the previous event of the sensor.
+static void http_client_send(struct http_server_context *ctx, http_client_t *client, http_msg_t *msg)
+{
+    if (client->sensor_seq && msg->sensor) {
+        unsigned *last = &client->sensor_seq[msg->sensor - 1];
+        int delta      = msg->delta && msg->sensor_prev && *last == msg->sensor_prev;
+        *last          = msg->seq;
+        if (delta) {
+            ctx->deltas_sent++;
+            http_client_send_text(ctx, client, msg->delta, msg->delta_len, msg->seq);
+            return;
+        }
+    }
+    http_client_send_text(ctx, client, msg->text, msg->len, msg->seq);
+}
+
+/// Returns 1 if the compact JSON of an event has the model @p model.
+static int http_json_has_model(char const *text, size_t len, char const *model)
+{
+    static char const key[] = "\"model\":\"";
+    size_t key_len          = sizeof(key) - 1;
+    size_t model_len        = strlen(model);
+    char const *end         = text + len;
+    for (char const *p = text; (p = memchr(p, '"', (size_t)(end - p))) != NULL; ++p) {
+        if ((size_t)(end - p) > key_len + model_len && !memcmp(p, key, key_len)
+                && !memcmp(p + key_len, model, model_len) && p[key_len + model_len] == '"')
+            return 1;
+    }
+    return 0;
+}
+
+/// Write the records of the event log from log_seq on, in place from the mapped segments, as long as the send buffer is short.
+static void http_client_pump_log(struct http_server_context *ctx, http_client_t *client)
+{
+    struct mg_connection *nc = client->nc;
+    while (nc->send_mbuf.len < CLIENT_SEND_MBUF_MAX) {
+        void const *rec;
+        long len = event_log_get(ctx->log, client->log_seq, &rec);
+        if (len == EVENT_LOG_EMPTY)
+            break; // caught up, the next records are sent as they are appended
+        if (len == EVENT_LOG_GONE) {
+            // the lost records show as a gap in the sequence numbers
+            client->log_seq = event_log_first(ctx->log);
+            continue;
+        }
+        if (!client->model || http_json_has_model(rec, (size_t)len, client->model))
+            http_client_send_text(ctx, client, rec, (size_t)len, client->log_seq);
+        client->log_seq++;
+    }
+}
+
+/// Write the history and queued messages to the send buffer of a client, as long as the send buffer is short.
+static void http_client_pump(struct http_server_context *ctx, http_client_t *client)
+{
+    struct mg_connection *nc = client->nc;
+    if (client->log_seq) {
+        http_client_pump_log(ctx, client);
+        return;
+    }
+    while (client->replaying && nc->send_mbuf.len < CLIENT_SEND_MBUF_MAX) {
+        http_msg_t *msg = http_history_after(ctx, client->replay_seq - 1, client->model);
+        if (!msg) {
+            // caught up, continue with the live messages
+            client->replaying = 0;
+            break;
+        }
+        http_client_send(ctx, client, msg);
+        client->replay_seq = msg->seq + 1;
+    }
+
+    while (!client->replaying && client->queue_len && nc->send_mbuf.len < CLIENT_SEND_MBUF_MAX) {
+        http_msg_t *msg    = client->queue[client->queue_head];
+        client->queue_head = (client->queue_head + 1) % CLIENT_QUEUE_SIZE;
+        client->queue_len--;
+        client->queue_bytes -= msg->len;
+        http_client_send(ctx, client, msg);
+        http_msg_unref(ctx, msg);
+    }
+}
+
+/// Send the history after @p since to a client.
+static void http_client_replay(struct http_server_context *ctx, http_client_t *client, unsigned since)
+{
+    client->replaying  = 1;
+    client->replay_seq = since + 1;
+    http_client_pump(ctx, client);
+}
+
+/// Queue a message to a client, drops the oldest messages above the high-water mark or evicts a stalled client.
+static void http_client_queue(struct http_server_context *ctx, http_client_t *client, http_msg_t *msg)
+{
+    if (client->nc->flags & (MG_F_CLOSE_IMMEDIATELY | MG_F_SEND_AND_CLOSE))
+        return;
+    if (client->log_seq) {
+        http_client_pump(ctx, client); // the event is sent from the log
+        return;
+    }
+    if (client->model && (!msg->model || strcmp(msg->model, client->model)))
+        return;
+    if (client->replaying && msg->seq >= client->replay_seq && http_history_get(ctx, msg->seq) == msg)
+        return; // the message is sent with the history
+
+    while (client->queue_len && (client->queue_len >= CLIENT_QUEUE_SIZE || client->queue_bytes + msg->len > CLIENT_QUEUE_BYTES)) {
+        if (mg_time() - client->last_progress > CLIENT_STALL_TIMEOUT) {
+            print_logf(LOG_NOTICE, "HTTP server", "Closing stalled client (%u messages queued)", client->queue_len);
+            client->nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            ctx->evicted++;
+            return;
+        }
+        http_msg_t *old    = client->queue[client->queue_head];
+        client->queue_head = (client->queue_head + 1) % CLIENT_QUEUE_SIZE;
+        client->queue_len--;
+        client->queue_bytes -= old->len;
+        http_msg_unref(ctx, old);
+        ctx->dropped++;
+    }
+
+    msg->refs++;
+    client->queue[(client->queue_head + client->queue_len) % CLIENT_QUEUE_SIZE] = msg;
+    client->queue_len++;
+    client->queue_bytes += msg->len;
+    http_client_pump(ctx, client);
+}
+
+/// Count the clients and the history, on the thread serving the connections.
+static void http_counters_get(struct http_server_context *ctx, http_counters_t *c)
+{
+    *c = (http_counters_t){0};
+    for (http_client_t *client = ctx->clients; client; client = client->next) {
+        c->queued += client->queue_len;
+        c->queued_bytes += client->queue_bytes;
+    }
+
+    unsigned first     = ctx->next_seq - ctx->history_len;
+    http_msg_t *oldest = http_history_get(ctx, first);
+
+    c->clients         = ctx->num_clients;
+    c->history         = ctx->history_len;
+    c->history_bytes   = ctx->history_bytes;
+    c->history_seq     = ctx->next_seq - 1;
+    c->history_time    = oldest ? oldest->time : 0.0;
+    c->history_models  = ctx->num_models;
+    c->messages        = ctx->num_msgs;
+    c->messages_bytes  = ctx->msgs_bytes;
+    c->dropped         = ctx->dropped;
+    c->evicted         = ctx->evicted;
+    c->sensors         = ctx->sensors.len;
+    c->sensors_evicted = ctx->sensors.evicted;
+    c->deflate_clients = ctx->deflate_clients;
+    c->deflate_in      = ctx->deflate_in;
+    c->deflate_out     = ctx->deflate_out;
+    c->delta_clients   = ctx->delta_clients;
+    c->deltas          = ctx->deltas;
+    c->deltas_sent     = ctx->deltas_sent;
+}
+
+static data_t *http_server_stats(struct http_server_context *ctx)
+{
+    http_counters_t c;
+    if (ctx->threaded) {
+        // the counters of the last poll of the server thread
+        http_lock(ctx);
+        c = ctx->counters;
+        http_unlock(ctx);
+    }
+    else {
+        http_counters_get(ctx, &c);
+    }
+
+    data_t *data = data_make(
+            "clients",          "", DATA_INT, c.clients,
+            "history",          "", DATA_INT, c.history,
+            "history_bytes",    "", DATA_INT, (int)c.history_bytes,
+            "history_seq",      "", DATA_INT, (int)c.history_seq,
+            "history_span",     "", DATA_DOUBLE, c.history_time > 0.0 ? mg_time() - c.history_time : 0.0,
+            "history_models",   "", DATA_INT, c.history_models,
+            "messages",         "", DATA_INT, c.messages,
+            "messages_bytes",   "", DATA_INT, (int)c.messages_bytes,
+            "queued",           "", DATA_INT, c.queued,
+            "queued_bytes",     "", DATA_INT, (int)c.queued_bytes,
+            "dropped",          "", DATA_INT, c.dropped,
+            "evicted",          "", DATA_INT, c.evicted,
+            "sensors",          "", DATA_INT, c.sensors,
+            "sensors_evicted",  "", DATA_INT, c.sensors_evicted,
+            "deflate_clients",  "", DATA_INT, c.deflate_clients,
+            "deflate_in_bytes", "", DATA_DOUBLE, (double)c.deflate_in,
+            "deflate_out_bytes", "", DATA_DOUBLE, (double)c.deflate_out,
+            "delta_clients",    "", DATA_INT, c.delta_clients,
+            "deltas",           "", DATA_INT, c.deltas,
+            "deltas_sent",      "", DATA_INT, c.deltas_sent,
+            NULL);
+    if (ctx->threaded) {
+        ring_queue_stats_t events;
+        ring_queue_get_stats(ctx->events, &events);
+        data = data_int(data, "events_queued", "", NULL, (int)events.len);
+        data = data_int(data, "events_dropped", "", NULL, (int)events.dropped);
+    }
+    return data;
+}
 
 static void handle_options(struct mg_connection *nc, struct http_message *hm)
 {
@@ -733,73 +1661,905 @@ static void handle_redirect(struct mg_connection *nc, struct http_message *hm)
             "\r\n\r\n");
 }
 
-static void handle_openmetrics(struct mg_connection *nc, struct http_message *hm)
+/// Append formatted text to the growing metrics body.
+static void metrics_printf(struct mbuf *buf, _Printf_format_string_ char const *restrict format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+static void metrics_printf(struct mbuf *buf, char const *restrict format, ...)
 {
-    if (mg_vcmp(&hm->method, "GET") != 0) {
-        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+    char line[512];
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(line, sizeof(line), format, ap);
+    va_end(ap);
+    if (len < 0)
+        return;
+    if ((size_t)len < sizeof(line)) {
+        mbuf_append(buf, line, (size_t)len);
         return;
     }
+    // a long line, format again into the buffer itself
+    size_t pos = buf->len;
+    mbuf_resize(buf, pos + (size_t)len + 1);
+    if (buf->size < pos + (size_t)len + 1)
+        return; // out of memory
+    va_start(ap, format);
+    vsnprintf(buf->buf + pos, (size_t)len + 1, format, ap);
+    va_end(ap);
+    buf->len = pos + (size_t)len;
+}
 
-    struct http_server_context *ctx = nc->user_data;
-    r_cfg_t *cfg = ctx->cfg;
+/// Append a label value with the quote, backslash, and newline escaped.
+static void metrics_label(struct mbuf *buf, char const *value)
+{
+    for (char const *p = value; *p; ++p) {
+        if (*p == '"' || *p == '\\')
+            mbuf_append(buf, "\\", 1);
+        if (*p == '\n')
+            mbuf_append(buf, "\\n", 2);
+        else
+            mbuf_append(buf, p, 1);
+    }
+}
 
-    time_t now;
-    time(&now);
+/// Append the metric family header lines.
+static void metrics_family(struct mbuf *buf, char const *name, char const *type, char const *unit, char const *help)
+{
+    metrics_printf(buf, "# TYPE %s %s\n", name, type);
+    if (unit)
+        metrics_printf(buf, "# UNIT %s %s\n", name, unit);
+    metrics_printf(buf, "# HELP %s %s\n", name, help);
+}
 
-    char buf[2000];
-    int len = snprintf(buf, sizeof(buf),
-            "# TYPE uptime_seconds counter\n"
-            "# UNIT uptime_seconds seconds\n"
-            "# HELP uptime_seconds Program uptime.\n"
-            "uptime_seconds_total %.1f\n"
-            "uptime_seconds_created %.1f\n"
-            "# TYPE decoder_enabled gauge\n"
-            "# HELP decoder_enabled Number of enabled decoders.\n"
-            "decoder_enabled %u\n"
-            "# TYPE input_uptime_seconds counter\n"
-            "# UNIT input_uptime_seconds seconds\n"
-            "# HELP input_uptime_seconds SDR Receiver uptime.\n"
-            "input_uptime_seconds_total %.1f\n"
-            "input_uptime_seconds_created %.1f\n"
-            "# TYPE input_count_frames counter\n"
+/// Append a histogram with cumulative buckets.
+static void metrics_histogram(struct mbuf *buf, metrics_hist_t const *hist, char const *name, char const *unit, char const *help)
+{
+    metrics_family(buf, name, "histogram", unit, help);
+    uint64_t count = 0;
+    for (unsigned i = 0; i < hist->num_bounds; ++i) {
+        count += hist->counts[i];
+        metrics_printf(buf, "%s_bucket{le=\"%g\"} %.0f\n", name, hist->bounds[i], (double)count);
+    }
+    count += hist->counts[hist->num_bounds];
+    metrics_printf(buf, "%s_bucket{le=\"+Inf\"} %.0f\n", name, (double)count);
+    metrics_printf(buf, "%s_count %.0f\n", name, (double)count);
+    metrics_printf(buf, "%s_sum %g\n", name, hist->sum);
+}
+
+/// Append a counter of each decoder with events, labeled with the protocol number and name.
+static void metrics_decoders(struct mbuf *buf, list_t *r_devs, char const *name, char const *help, size_t field)
+{
+    metrics_family(buf, name, "counter", NULL, help);
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        decoder_stats_t s;
+        stats_read(&s, &r_dev->stats, sizeof(s));
+        if (!s.events)
+            continue;
+        metrics_printf(buf, "%s_total{protocol=\"%u\",name=\"", name, r_dev->protocol_num);
+        metrics_label(buf, r_dev->name);
+        metrics_printf(buf, "\"} %llu\n", (unsigned long long)*(uint64_t const *)((char const *)&s + field));
+    }
+}
+
+/// Send a rendered reply.
+static void http_reply_send(struct mg_connection *nc, http_reply_t const *reply)
+{
+    if (reply->status != 200) {
+        mg_http_send_error(nc, reply->status ? reply->status : 500, reply->error);
+        return;
+    }
+    mg_printf(nc,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n",
+            reply->type, (unsigned)reply->len);
+    mg_send(nc, reply->body, reply->len);
+    if (reply->close)
+        nc->flags |= MG_F_SEND_AND_CLOSE;
+}
+
+static void reply_metrics(struct http_server_context *ctx, http_reply_t *reply)
+{
+    r_cfg_t *cfg = ctx->cfg;
+    list_t *r_devs = &cfg->demod->r_devs;
+
+    time_t now;
+    time(&now);
+
+    input_stats_t is;
+    stats_read(&is, &cfg->stats, sizeof(is));
+
+    struct mbuf buf;
+    mbuf_init(&buf, 16384);
+    metrics_printf(&buf,
+            "# TYPE uptime_seconds counter\n"
+            "# UNIT uptime_seconds seconds\n"
+            "# HELP uptime_seconds Program uptime.\n"
+            "uptime_seconds_total %.1f\n"
+            "uptime_seconds_created %.1f\n"
+            "# TYPE decoder_enabled gauge\n"
+            "# HELP decoder_enabled Number of enabled decoders.\n"
+            "decoder_enabled %u\n"
+            "# TYPE input_uptime_seconds counter\n"
+            "# UNIT input_uptime_seconds seconds\n"
+            "# HELP input_uptime_seconds SDR Receiver uptime.\n"
+            "input_uptime_seconds_total %.1f\n"
+            "input_uptime_seconds_created %.1f\n"
+            "# TYPE input_count_frames counter\n"
             "# UNIT input_count_frames frames\n"
             "# HELP input_count_frames Number of SDR frames received.\n"
-            "input_count_frames_total %u\n"
+            "input_count_frames_total %.0f\n"
             "# TYPE input_squelch_frames counter\n"
             "# UNIT input_squelch_frames frames\n"
             "# HELP input_squelch_frames Number of SDR frames skipped by squelch.\n"
-            "input_squelch_frames_total %u\n"
+            "input_squelch_frames_total %.0f\n"
             "# TYPE input_ook_frames counter\n"
             "# UNIT input_ook_frames frames\n"
             "# HELP input_ook_frames Number of SDR frames with OOK demodulation.\n"
-            "input_ook_frames_total %u\n"
+            "input_ook_frames_total %.0f\n"
             "# TYPE input_fsk_frames counter\n"
             "# UNIT input_fsk_frames frames\n"
             "# HELP input_fsk_frames Number of SDR frames with FSK demodulation.\n"
-            "input_fsk_frames_total %u\n"
+            "input_fsk_frames_total %.0f\n"
             "# TYPE input_event_frames counter\n"
             "# UNIT input_event_frames frames\n"
             "# HELP input_event_frames Number of SDR frames with decode events.\n"
-            "input_event_frames_total %u\n"
-            "# EOF\n",
+            "input_event_frames_total %.0f\n"
+            "# TYPE input_drops counter\n"
+            "# HELP input_drops Number of SDR buffers with dropped samples before them.\n"
+            "input_drops_total %.0f\n"
+            "# TYPE input_dropped_samples counter\n"
+            "# UNIT input_dropped_samples samples\n"
+            "# HELP input_dropped_samples Number of samples dropped by the SDR or the DSP queue.\n"
+            "input_dropped_samples_total %.0f\n",
             (float)(now - cfg->running_since), // uptime_seconds_total,
             (float)cfg->running_since,         // uptime_seconds_created,
             (unsigned)cfg->demod->r_devs.len,  // decoder_enabled,
             (float)(now - cfg->sdr_since),     // input_uptime_seconds_total,
             (float)cfg->sdr_since,             // input_uptime_seconds_created,
-            cfg->total_frames_count,           // input_count_frames_total,
-            cfg->total_frames_squelch,         // input_squelch_frames_total,
-            cfg->total_frames_ook,             // input_ook_frames_total,
-            cfg->total_frames_fsk,             // input_fsk_frames_total,
-            cfg->total_frames_events);         // input_event_frames_total,
+            (double)is.frames,                 // input_count_frames_total,
+            (double)is.frames_squelch,         // input_squelch_frames_total,
+            (double)is.frames_ook,             // input_ook_frames_total,
+            (double)is.frames_fsk,             // input_fsk_frames_total,
+            (double)is.frames_events,          // input_event_frames_total,
+            (double)is.drops,                  // input_drops_total,
+            (double)is.samples_dropped);       // input_dropped_samples_total,
+
+    // counters of the decoders, not reset with the report interval
+    metrics_decoders(&buf, r_devs, "decoder_events", "Number of packages sliced for the decoder.",
+            offsetof(decoder_stats_t, events));
+    metrics_decoders(&buf, r_devs, "decoder_ok", "Number of packages the decoder decoded.",
+            offsetof(decoder_stats_t, ok));
+    metrics_decoders(&buf, r_devs, "decoder_messages", "Number of messages the decoder output.",
+            offsetof(decoder_stats_t, messages));
+    metrics_decoders(&buf, r_devs, "decoder_duplicates", "Number of messages dropped as repeats.",
+            offsetof(decoder_stats_t, dups));
+    static char const *const fail_reasons[5] = {"fail_other", "abort_length", "abort_early", "fail_mic", "fail_sanity"};
+    metrics_family(&buf, "decoder_fails", "counter", NULL, "Number of packages the decoder failed on.");
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        decoder_stats_t s;
+        stats_read(&s, &r_dev->stats, sizeof(s));
+        for (int i = 0; i < 5; ++i) {
+            if (!s.fails[i])
+                continue;
+            metrics_printf(&buf, "decoder_fails_total{protocol=\"%u\",name=\"", r_dev->protocol_num);
+            metrics_label(&buf, r_dev->name);
+            metrics_printf(&buf, "\",reason=\"%s\"} %llu\n", fail_reasons[i], (unsigned long long)s.fails[i]);
+        }
+    }
+
+    if (cpu_stats_enabled()) {
+        metrics_family(&buf, "dsp_stage_seconds", "counter", "seconds", "CPU time in the processing stages.");
+        unsigned n_chans = cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+        for (int s = 0; s < CPU_STAGE_COUNT; ++s) {
+            uint64_t ns = 0;
+            for (unsigned i = 0; i < n_chans; ++i) {
+                struct dm_state *chan = cfg->channels.len ? cfg->channels.elems[i] : cfg->demod;
+                ns += chan->cpu_stages[s].ns;
+            }
+            metrics_printf(&buf, "dsp_stage_seconds_total{stage=\"%s\"} %.6f\n", cpu_stage_name(s), ns * 1e-9);
+        }
+        metrics_family(&buf, "output_send_seconds", "counter", "seconds", "CPU time in the outputs.");
+        for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+            data_output_t *output = cfg->output_handler.elems[i];
+            if (output)
+                metrics_printf(&buf, "output_send_seconds_total{output=\"%u\"} %.6f\n", (unsigned)i, output->cpu_stat.ns * 1e-9);
+        }
+        metrics_family(&buf, "output_sends", "counter", NULL, "Number of events sent to the outputs.");
+        for (size_t i = 0; i < cfg->output_handler.len; ++i) {
+            data_output_t *output = cfg->output_handler.elems[i];
+            if (output)
+                metrics_printf(&buf, "output_sends_total{output=\"%u\"} %u\n", (unsigned)i, output->cpu_stat.calls);
+        }
+    }
+
+    if (cfg->dsp_thread) {
+        ring_queue_stats_t iq_stats;
+        ring_queue_stats_t event_stats;
+        dsp_thread_get_stats(cfg->dsp_thread, &iq_stats, &event_stats);
+        metrics_family(&buf, "dsp_queue_length", "gauge", NULL, "Number of elements in the DSP thread queues.");
+        metrics_printf(&buf, "dsp_queue_length{queue=\"iq\"} %u\n", iq_stats.len);
+        metrics_printf(&buf, "dsp_queue_length{queue=\"event\"} %u\n", event_stats.len);
+        metrics_family(&buf, "dsp_queue_size", "gauge", NULL, "Capacity of the DSP thread queues.");
+        metrics_printf(&buf, "dsp_queue_size{queue=\"iq\"} %u\n", iq_stats.size);
+        metrics_printf(&buf, "dsp_queue_size{queue=\"event\"} %u\n", event_stats.size);
+        metrics_family(&buf, "dsp_queue_dropped", "counter", NULL, "Number of elements dropped by the full DSP thread queues.");
+        metrics_printf(&buf, "dsp_queue_dropped_total{queue=\"iq\"} %u\n", iq_stats.dropped);
+        metrics_printf(&buf, "dsp_queue_dropped_total{queue=\"event\"} %u\n", event_stats.dropped);
+    }
+
+    if (cfg->lag_shed) {
+        metrics_family(&buf, "input_lag_seconds", "gauge", "seconds", "Lag of the processing behind the SDR input.");
+        metrics_printf(&buf, "input_lag_seconds %.3f\n", cfg->sched_lag_us * 1e-6);
+        metrics_family(&buf, "input_lag_skipped_buffers", "counter", NULL, "Number of SDR buffers skipped while the processing lagged.");
+        metrics_printf(&buf, "input_lag_skipped_buffers_total %.0f\n", (double)is.lag_skips);
+        metrics_family(&buf, "input_lag_skipped_samples", "counter", "samples", "Number of samples skipped while the processing lagged.");
+        metrics_printf(&buf, "input_lag_skipped_samples_total %.0f\n", (double)is.samples_lag_skipped);
+    }
+
+    if (cfg->iq_snippet) {
+        metrics_family(&buf, "iq_snippets", "counter", NULL, "Number of IQ snippets saved.");
+        metrics_printf(&buf, "iq_snippets_total %.0f\n", (double)is.snippets);
+        metrics_family(&buf, "iq_snippets_missed", "counter", NULL, "Number of packages without an IQ snippet.");
+        metrics_printf(&buf, "iq_snippets_missed_total %.0f\n", (double)is.snippets_missed);
+    }
+
+    if (cfg->demod->dump_writer) {
+        dump_writer_stats_t dump_stats;
+        dump_writer_get_stats(cfg->demod->dump_writer, &dump_stats);
+        metrics_family(&buf, "dump_queue_length", "gauge", NULL, "Number of blocks queued to the dump writer.");
+        metrics_printf(&buf, "dump_queue_length %u\n", dump_stats.queued);
+    }
+
+    metrics_histogram(&buf, &cfg->hist_rssi, "event_rssi_db", NULL, "RSSI of the packages with events in dB.");
+    metrics_histogram(&buf, &cfg->hist_snr, "event_snr_db", NULL, "SNR of the packages with events in dB.");
+    metrics_histogram(&buf, &cfg->hist_latency, "output_latency_seconds", "seconds", "Latency from the end of the package on air to the output.");
+    metrics_printf(&buf, "# EOF\n");
+
+    if (!buf.buf) {
+        reply->status = 500; // 500 Internal Server Error
+        return;
+    }
+    // the reply takes the buffer
+    reply->status = 200;
+    reply->type   = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    reply->body   = buf.buf;
+    reply->len    = buf.len;
+    reply->close  = 1;
+}
+
+// curl -D - 'http://127.0.0.1:8433/api'
+static void handle_api(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+
+    struct http_server_context *ctx = nc->user_data;
+
+    char buf[1000];
+    data_t *data = data_make(
+            "http", "", DATA_DATA, http_server_stats(ctx),
+            NULL);
+    size_t len = data_print_jsons(data, buf, sizeof(buf));
+    data_free(data);
+
+    mg_printf(nc,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n",
+            (unsigned)len);
+    mg_send(nc, buf, len);
+}
+
+static void rpc_start_profile(rpc_t *rpc)
+{
+    struct http_server_context *ctx = rpc->ctx;
+
+    cpu_profile_start(&ctx->profile, ctx->cfg);
+    ctx->profile_until = rpc->val ? mg_time() + rpc->val : 0;
+    // the server connection has no other use for a timer, with a thread the listings timer stops the profile
+    if (!ctx->threaded)
+        mg_set_timer(ctx->conn, ctx->profile_until);
+    rpc->response(rpc, 0, "Ok", 0);
+}
+
+static void rpc_stop_profile(rpc_t *rpc)
+{
+    struct http_server_context *ctx = rpc->ctx;
+
+    ctx->profile_until = 0;
+    if (!ctx->threaded)
+        mg_set_timer(ctx->conn, 0);
+    cpu_profile_stop(&ctx->profile, ctx->cfg);
+    char *folded = cpu_profile_folded(&ctx->profile, ctx->cfg);
+    if (!folded) {
+        rpc->response(rpc, -1, "No profile", 0);
+        return;
+    }
+
+    size_t len = strlen(folded) * 2 + 256; // room to escape the newlines
+    char *buf  = malloc(len);
+    if (!buf) {
+        WARN_MALLOC("rpc_stop_profile()");
+        rpc->response(rpc, -1, "Out of memory", 0);
+        free(folded);
+        return;
+    }
+    data_t *data = data_make(
+            "seconds",  "", DATA_INT, (int)(ctx->profile.stop_time - ctx->profile.start_time),
+            "folded",   "", DATA_STRING, folded,
+            NULL);
+    data_print_jsons(data, buf, len);
+    rpc->response(rpc, 1, buf, 0);
+    data_free(data);
+    free(buf);
+    free(folded);
+}
+
+/// Reply with the listing of @p slot.
+static void rpc_snapshot(rpc_t *rpc, http_snapshot_t **slot)
+{
+    http_snapshot_t *snap = http_snapshot_get(rpc->ctx, slot, 0);
+    if (!snap) {
+        rpc->response(rpc, -1, "Out of memory", 0);
+        return;
+    }
+    rpc->response(rpc, 1, snap->text, 0);
+    http_snapshot_unref(rpc->ctx, snap);
+}
+
+static void rpc_get_meta(rpc_t *rpc)
+{
+    http_update_meta(rpc->ctx);
+    rpc_snapshot(rpc, &rpc->ctx->meta);
+}
+
+static void rpc_get_protocols(rpc_t *rpc)
+{
+    http_update_protocols(rpc->ctx);
+    rpc_snapshot(rpc, &rpc->ctx->protocols);
+}
+
+static void rpc_get_stats(rpc_t *rpc)
+{
+    struct http_server_context *ctx = rpc->ctx;
+
+    // a server thread answers from the snapshot while it is refreshed
+    ctx->stats_wanted = mg_time() + STATS_SNAPSHOT_IDLE;
+    http_update_stats(ctx);
+    rpc_snapshot(rpc, &ctx->stats);
+}
+
+static void rpc_spectrum(rpc_t *rpc)
+{
+    struct http_server_context *ctx = rpc->ctx;
+    http_client_t *client = http_client_find(ctx, rpc->nc);
+
+    if (!ctx->cfg->spectrum) {
+        rpc->response(rpc, -1, "Spectrum is off, use -Y spectrum", 0);
+        return;
+    }
+    if (!client || !(rpc->nc->flags & MG_F_IS_WEBSOCKET)) {
+        rpc->response(rpc, -1, "The spectrum streams on a websocket only", 0);
+        return;
+    }
+    int on = rpc->val ? 1 : 0;
+    if (on != client->spectrum)
+        ctx->spectrum_clients += on ? 1 : -1;
+    client->spectrum     = on;
+    client->spectrum_seq = 0;
+    rpc->response(rpc, 0, "Ok", 0);
+}
+
+/// Render the last spectrum snapshot to spectrum_json, returns the snapshot sequence number or 0.
+static unsigned spectrum_render(struct http_server_context *ctx)
+{
+    // each bin takes at most 8 chars, e.g. "-123.4,"
+    size_t size = SPECTRUM_FFT_SIZE * 8 + 256;
+    if (!ctx->spectrum_json) {
+        ctx->spectrum_json = malloc(size);
+        if (!ctx->spectrum_json) {
+            WARN_MALLOC("spectrum_render()");
+            return 0;
+        }
+    }
+    if (!ctx->spectrum_db) {
+        ctx->spectrum_db = malloc(SPECTRUM_FFT_SIZE * sizeof(*ctx->spectrum_db));
+        if (!ctx->spectrum_db) {
+            WARN_MALLOC("spectrum_render()");
+            return 0;
+        }
+    }
+
+    spectrum_info_t info;
+    unsigned seq = spectrum_read(ctx->cfg->spectrum, &info, ctx->spectrum_db);
+    if (!seq)
+        return 0;
+    abuf_t buf;
+    abuf_init(&buf, ctx->spectrum_json, size);
+    abuf_printf(&buf, "{\"spectrum\":{\"time_us\":%lld,\"center_frequency\":%u,\"sample_rate\":%u,\"averages\":%u,\"bins\":%u,\"db\":[",
+            (long long)info.time_us, info.center_frequency, info.sample_rate, info.averages, info.bins);
+    for (unsigned i = 0; i < info.bins; ++i)
+        abuf_printf(&buf, "%s%.1f", i ? "," : "", ctx->spectrum_db[i]);
+    abuf_cat(&buf, "]}}");
+    ctx->spectrum_len = buf.tail - buf.head;
+    ctx->spectrum_seq = seq;
+    return seq;
+}
+
+/// Send a new spectrum snapshot to a client, a client with a full send buffer skips it.
+static void http_client_spectrum(struct http_server_context *ctx, http_client_t *client)
+{
+    unsigned seq = spectrum_seq(ctx->cfg->spectrum);
+    if (!seq || seq == client->spectrum_seq || client->nc->send_mbuf.len >= CLIENT_SEND_MBUF_MAX)
+        return;
+    if (seq != ctx->spectrum_seq && !spectrum_render(ctx))
+        return;
+    client->spectrum_seq = ctx->spectrum_seq;
+    struct mg_str part   = {ctx->spectrum_json, ctx->spectrum_len};
+    http_client_write(ctx, client, &part, 1, 0);
+}
+
+static void reply_profile(struct http_server_context *ctx, http_reply_t *reply)
+{
+    char *folded = cpu_profile_folded(&ctx->profile, ctx->cfg);
+    if (!folded) {
+        reply->status = 404; // 404 Not Found
+        reply->error  = "No profile";
+        return;
+    }
+    reply->status = 200;
+    reply->type   = "text/plain";
+    reply->body   = folded;
+    reply->len    = strlen(folded);
+}
+
+// curl -s -o trace.json 'http://127.0.0.1:8433/api/trace'
+static void handle_trace(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+
+    size_t len;
+    char *json = trace_export_json(&len);
+    if (!json) {
+        mg_http_send_error(nc, 500, NULL); // 500 Internal Server Error
+        return;
+    }
+    mg_printf(nc,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n",
+            (unsigned)len);
+    mg_send(nc, json, len);
+    free(json);
+}
+
+static void reply_discovery(struct http_server_context *ctx, http_reply_t *reply)
+{
+    if (!ctx->cfg->discovery) {
+        reply->status = 404; // 404 Not Found
+        reply->error  = "Discovery is off, use -Y discover";
+        return;
+    }
+
+    // the shapes do not fit a fixed buffer, the render grows its own
+    data_t *data = pulse_clusters_data(ctx->cfg->discovery);
+    data_render_t render = {0};
+    data_render_start(&render, data);
+    size_t len;
+    char const *json = data_render_jsons(&render, data, &len);
+    reply->status    = 500; // 500 Internal Server Error
+    if (json) {
+        reply->body = malloc(len);
+        if (!reply->body) {
+            WARN_MALLOC("reply_discovery()");
+        }
+        else {
+            memcpy(reply->body, json, len);
+            reply->status = 200;
+            reply->type   = "application/json";
+            reply->len    = len;
+        }
+    }
+    data_render_free(&render);
+    data_free(data);
+}
+
+static void reply_discovery_sample(struct http_server_context *ctx, unsigned shape, http_reply_t *reply)
+{
+    if (!ctx->cfg->discovery) {
+        reply->status = 404; // 404 Not Found
+        reply->error  = "Discovery is off, use -Y discover";
+        return;
+    }
+
+    size_t len = 0;
+    char *ook  = shape ? pulse_clusters_sample_ook(ctx->cfg->discovery, shape, &len) : NULL;
+    if (!ook) {
+        reply->status = 404; // 404 Not Found
+        reply->error  = "No such shape";
+        return;
+    }
+    reply->status = 200;
+    reply->type   = "text/plain";
+    reply->body   = ook;
+    reply->len    = len;
+}
+
+/// Render a reply that reads the config, on the event loop.
+static void http_reply_render(struct http_server_context *ctx, int kind, unsigned shape, http_reply_t *reply)
+{
+    if (kind == HTTP_CALL_METRICS)
+        reply_metrics(ctx, reply);
+    else if (kind == HTTP_CALL_PROFILE)
+        reply_profile(ctx, reply);
+    else if (kind == HTTP_CALL_DISCOVERY)
+        reply_discovery(ctx, reply);
+    else if (kind == HTTP_CALL_SAMPLE)
+        reply_discovery_sample(ctx, shape, reply);
+}
+
+// requests of the server thread to the event loop
+
+static void http_call_free(http_call_t *call)
+{
+    free(call->rpc.method);
+    free(call->rpc.arg);
+    free(call->rpc.id);
+    free(call->reply.body);
+    free(call);
+}
+
+// keep the reply of a command run on the event loop, only the first reply counts
+static void rpc_response_call(rpc_t *rpc, int ret_code, char const *message, int arg)
+{
+    http_call_t *call = rpc->call;
+    if (call->replied)
+        return;
+    call->replied = 1;
+    call->code    = ret_code;
+    call->arg     = arg;
+    if (message) {
+        call->reply.body = strdup(message);
+        if (!call->reply.body) {
+            WARN_STRDUP("rpc_response_call()");
+            call->code        = -1;
+            call->reply.error = "Out of memory";
+        }
+    }
+    else if (ret_code < 0) {
+        call->reply.error = "Unknown error";
+    }
+}
+
+/// Copy a string of a command to the call, returns -1 on alloc failure.
+static int rpc_copy_str(char **dst, char const *src)
+{
+    if (!src)
+        return 0;
+    *dst = strdup(src);
+    if (!*dst) {
+        WARN_STRDUP("rpc_copy_str()");
+        return -1;
+    }
+    return 0;
+}
+
+/// Send the reply of a call if the connection is still open, on the server thread.
+static void http_call_reply(http_call_t *call)
+{
+    if (!call->nc)
+        return; // closed while in flight
+    if (call->kind != HTTP_CALL_RPC) {
+        http_reply_send(call->nc, &call->reply);
+        return;
+    }
+    rpc_t rpc     = call->rpc;
+    rpc.nc        = call->nc;
+    rpc.call      = NULL;
+    rpc.response  = call->response;
+    if (!call->replied)
+        call->response(&rpc, -1, "No reply", 0);
+    else
+        call->response(&rpc, call->code, call->reply.body ? call->reply.body : call->reply.error, call->arg);
+}
+
+static void http_thread_wake(struct mg_connection *nc, int ev, void *ev_data);
+static void http_loop_wake(struct mg_connection *nc, int ev, void *ev_data);
+
+/// Hand a request to the event loop, on the server thread. A request beyond the limit is rejected.
+static void http_call_post(struct http_server_context *ctx, http_call_t *call)
+{
+    int queued = ctx->num_pending < THREAD_CALLS_MAX ? ring_queue_push(ctx->calls, &call) : -1;
+    if (queued < 0) {
+        call->replied     = 1;
+        call->code        = -1;
+        call->reply       = (http_reply_t){.status = 503, .error = "Too many requests"}; // 503 Service Unavailable
+        http_call_reply(call);
+        http_call_free(call);
+        return;
+    }
+    call->next   = ctx->pending;
+    ctx->pending = call;
+    ctx->num_pending++;
+    // the event loop takes all queued requests on one wake up
+    if (queued == 0)
+        mg_broadcast(ctx->loop->mgr, http_loop_wake, &ctx, sizeof(ctx));
+}
+
+/// Take the replies of the event loop, on the server thread.
+static void http_call_take(struct http_server_context *ctx)
+{
+    http_call_t *call;
+    while (!ring_queue_pop(ctx->replies, &call, 0)) {
+        for (http_call_t **p = &ctx->pending; *p; p = &(*p)->next) {
+            if (*p == call) {
+                *p = call->next;
+                ctx->num_pending--;
+                break;
+            }
+        }
+        http_call_reply(call);
+        http_call_free(call);
+    }
+}
+
+/// Forget the connection of the requests in flight, on the server thread.
+static void http_call_closed(struct http_server_context *ctx, struct mg_connection *nc)
+{
+    for (http_call_t *call = ctx->pending; call; call = call->next) {
+        if (call->nc == nc)
+            call->nc = NULL;
+    }
+}
+
+/// Reply to a request that reads the config, with a thread the event loop renders the reply.
+static void http_reply_call(struct mg_connection *nc, int kind, unsigned shape)
+{
+    struct http_server_context *ctx = nc->user_data;
+
+    if (!ctx->threaded) {
+        http_reply_t reply = {0};
+        http_reply_render(ctx, kind, shape, &reply);
+        http_reply_send(nc, &reply);
+        free(reply.body);
+        return;
+    }
+    http_call_t *call = calloc(1, sizeof(*call));
+    if (!call) {
+        WARN_CALLOC("http_reply_call()");
+        mg_http_send_error(nc, 500, NULL); // 500 Internal Server Error
+        return;
+    }
+    call->nc    = nc;
+    call->kind  = kind;
+    call->shape = shape;
+    http_call_post(ctx, call);
+}
+
+/// Run a command, with a thread the listings are answered from the snapshots and the rest is run on the event loop.
+static void http_rpc_exec(struct http_server_context *ctx, rpc_t *rpc)
+{
+    if (!ctx->threaded) {
+        rpc_exec(rpc, ctx->cfg);
+        return;
+    }
+
+    char const *method = rpc->method ? rpc->method : "";
+    if (!strcmp(method, "spectrum")) {
+        rpc_spectrum(rpc); // streams on the server thread
+        return;
+    }
+    http_snapshot_t *snap = NULL;
+    if (!strcmp(method, "get_meta"))
+        snap = http_snapshot_get(ctx, &ctx->meta, 0);
+    else if (!strcmp(method, "get_protocols"))
+        snap = http_snapshot_get(ctx, &ctx->protocols, 0);
+    else if (!strcmp(method, "get_stats"))
+        snap = http_snapshot_get(ctx, &ctx->stats, STATS_SNAPSHOT_AGE);
+    if (snap) {
+        rpc->response(rpc, 1, snap->text, 0);
+        http_snapshot_unref(ctx, snap);
+        return;
+    }
+
+    http_call_t *call = calloc(1, sizeof(*call));
+    if (!call) {
+        WARN_CALLOC("http_rpc_exec()");
+        rpc->response(rpc, -1, "Out of memory", 0);
+        return;
+    }
+    call->nc       = rpc->nc;
+    call->kind     = HTTP_CALL_RPC;
+    call->response = rpc->response;
+    call->rpc      = (rpc_t){
+            .ctx      = ctx,
+            .call     = call,
+            .response = rpc_response_call,
+            .ver      = rpc->ver,
+            .val      = rpc->val,
+    };
+    if (rpc_copy_str(&call->rpc.method, rpc->method) || rpc_copy_str(&call->rpc.arg, rpc->arg) || rpc_copy_str(&call->rpc.id, rpc->id)) {
+        rpc->response(rpc, -1, "Out of memory", 0);
+        http_call_free(call);
+        return;
+    }
+    http_call_post(ctx, call);
+}
+
+// curl -s 'http://127.0.0.1:8433/metrics'
+static void handle_openmetrics(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+    http_reply_call(nc, HTTP_CALL_METRICS, 0);
+}
+
+// curl -s 'http://127.0.0.1:8433/api/profile' | flamegraph.pl --countname=us >profile.svg
+static void handle_profile(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+    http_reply_call(nc, HTTP_CALL_PROFILE, 0);
+}
+
+// curl -s 'http://127.0.0.1:8433/api/discovery'
+static void handle_discovery(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+    http_reply_call(nc, HTTP_CALL_DISCOVERY, 0);
+}
+
+// curl -s -o shape1.ook 'http://127.0.0.1:8433/api/discovery/sample?shape=1'
+static void handle_discovery_sample(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+
+    char arg[16] = {0};
+    mg_get_http_var(&hm->query_string, "shape", arg, sizeof(arg));
+    http_reply_call(nc, HTTP_CALL_SAMPLE, (unsigned)strtoul(arg, NULL, 10));
+}
+
+// curl -s -OJ 'http://127.0.0.1:8433/api/iq?seq=42'
+static void handle_iq_snippet(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+
+    struct http_server_context *ctx = nc->user_data;
+    if (!ctx->cfg->iq_snippet) {
+        mg_http_send_error(nc, 404, "IQ snippets are off, use -Y snippets"); // 404 Not Found
+        return;
+    }
+    if (!ctx->iq_log)
+        ctx->iq_log = event_log_reader_open(iq_snippet_dir(ctx->cfg->iq_snippet));
+    if (!ctx->iq_log) {
+        mg_http_send_error(nc, 500, NULL); // 500 Internal Server Error
+        return;
+    }
+
+    char arg[32] = {0};
+    mg_get_http_var(&hm->query_string, "seq", arg, sizeof(arg));
+    uint64_t seq = strtoull(arg, NULL, 10);
+
+    void const *rec = NULL;
+    long len = seq ? event_log_get(ctx->iq_log, seq, &rec) : EVENT_LOG_EMPTY;
+    iq_snippet_header_t header = {0};
+    if (len >= (long)sizeof(header))
+        memcpy(&header, rec, sizeof(header));
+    if (header.magic != IQ_SNIPPET_MAGIC) {
+        mg_http_send_error(nc, 404, "No such snippet"); // 404 Not Found
+        return;
+    }
+    size_t data_len = (size_t)len - sizeof(header);
+    mg_printf(nc,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Disposition: attachment; filename=\"iq%llu_%gM_%gk.%s\"\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n",
+            (unsigned long long)seq, header.center_frequency / 1000000.0, header.sample_rate / 1000.0,
+            header.sample_size == 2 ? "cu8" : "cs16", (unsigned)data_len);
+    mg_send(nc, (char const *)rec + sizeof(header), data_len);
+}
+
+/// Add a sensor field from a query variable to @p data, numbers as int as the decoders report them.
+static data_t *sensor_query_field(data_t *data, struct http_message *hm, char const *key)
+{
+    char val[256];
+    if (mg_get_http_var(&hm->query_string, key, val, sizeof(val)) <= 0)
+        return data;
+    char *endptr;
+    long num = strtol(val, &endptr, 10);
+    if (*val && !*endptr)
+        return data_int(data, key, "", NULL, (int)num);
+    return data_str(data, key, "", NULL, val);
+}
+
+// curl -s 'http://127.0.0.1:8433/api/sensors?limit=10'
+// curl -s 'http://127.0.0.1:8433/api/sensors?model=Acurite-Tower&id=1234&channel=A'
+static void handle_sensors(struct mg_connection *nc, struct http_message *hm)
+{
+    if (mg_vcmp(&hm->method, "GET") != 0) {
+        mg_http_send_error(nc, 405, NULL); // 405 Method Not Allowed
+        return;
+    }
+
+    struct http_server_context *ctx = nc->user_data;
+    if (!ctx->sensors.capacity) {
+        mg_http_send_error(nc, 404, "Sensors are off, use e.g. sensors=256"); // 404 Not Found
+        return;
+    }
 
-    mg_printf(nc,
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Length: %u\r\n"
-            "\r\n",
-            len);
-    mg_send(nc, buf, (size_t)len);
-    nc->flags |= MG_F_SEND_AND_CLOSE;
+    data_t *data;
+    char arg[256];
+    if (mg_get_http_var(&hm->query_string, "model", arg, sizeof(arg)) > 0) {
+        // a single sensor, keyed as the events are
+        data_t *query = sensor_query_field(NULL, hm, "model");
+        query         = sensor_query_field(query, hm, "id");
+        query         = sensor_query_field(query, hm, "channel");
+        sensor_entry_t const *entry = sensor_table_find(&ctx->sensors, data_sensor_key(query));
+        data_free(query);
+        if (!entry) {
+            mg_http_send_error(nc, 404, "No such sensor"); // 404 Not Found
+            return;
+        }
+        data = sensor_entry_data(entry);
+    }
+    else {
+        unsigned limit = DEFAULT_SENSORS_PAGE;
+        if (mg_get_http_var(&hm->query_string, "limit", arg, sizeof(arg)) > 0)
+            limit = (unsigned)strtoul(arg, NULL, 10);
+        unsigned cursor = 0;
+        if (mg_get_http_var(&hm->query_string, "cursor", arg, sizeof(arg)) > 0)
+            cursor = (unsigned)strtoul(arg, NULL, 10);
+        data = sensor_table_page(&ctx->sensors, cursor, limit);
+    }
+
+    // the pages do not fit a fixed buffer, the render grows its own
+    data_render_t render = {0};
+    data_render_start(&render, data);
+    size_t len;
+    char const *json = data ? data_render_jsons(&render, data, &len) : NULL;
+    if (!json) {
+        mg_http_send_error(nc, 500, NULL); // 500 Internal Server Error
+    }
+    else {
+        mg_printf(nc,
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: application/json\r\n"
+                "Content-Length: %u\r\n"
+                "\r\n",
+                (unsigned)len);
+        mg_send(nc, json, len);
+    }
+    data_render_free(&render);
+    data_free(data);
 }
 
 // reply to ws command
@@ -906,23 +2666,193 @@ static void rpc_response_jsoncmd(rpc_t *rpc, int ret_code, char const *message,
     mg_send_http_chunk(rpc->nc, "", 0); /* Send empty chunk, the end of response */
 }
 
+/// Returns 1 if a permessage-deflate offer from @p p to @p end is acceptable, sets the window bits and takeover.
+static int ws_deflate_params(char const *p, char const *end, int *window_bits, int *no_context_takeover)
+{
+    int first = 1;
+    *window_bits         = STREAM_DEFLATE_WBITS;
+    *no_context_takeover = 0;
+    while (p < end) {
+        char const *param_end = memchr(p, ';', (size_t)(end - p));
+        if (!param_end)
+            param_end = end;
+        char param[64];
+        char *q = param;
+        for (; p < param_end && q < param + sizeof(param) - 1; ++p) {
+            if (*p != ' ' && *p != '\t' && *p != '"')
+                *q++ = *p;
+        }
+        *q = '\0';
+        p  = param_end + 1;
+
+        if (first) {
+            if (strcmp(param, "permessage-deflate"))
+                return 0;
+            first = 0;
+        }
+        else if (!strcmp(param, "server_no_context_takeover")) {
+            *no_context_takeover = 1;
+        }
+        else if (!strncmp(param, "server_max_window_bits=", 23)) {
+            int bits = atoi(param + 23);
+            if (bits < 9 || bits > 15)
+                return 0; // zlib has no window of 8 bits
+            if (bits < *window_bits)
+                *window_bits = bits;
+        }
+        else if (strcmp(param, "client_no_context_takeover") && strcmp(param, "client_max_window_bits")
+                && strncmp(param, "client_max_window_bits=", 23)) {
+            return 0; // the client inflates with any window, an unknown parameter declines the offer
+        }
+    }
+    return !first;
+}
+
+/// Returns 1 if a websocket handshake has an acceptable permessage-deflate offer, sets the window bits and takeover.
+static int ws_deflate_offer(struct http_server_context *ctx, struct http_message *hm, int *window_bits, int *no_context_takeover)
+{
+    struct mg_str *ext = ctx->compress ? mg_get_http_header(hm, "Sec-WebSocket-Extensions") : NULL;
+    if (!ext)
+        return 0;
+    // the offers in order of preference
+    char const *end = ext->p + ext->len;
+    for (char const *p = ext->p; p < end;) {
+        char const *offer_end = memchr(p, ',', (size_t)(end - p));
+        if (!offer_end)
+            offer_end = end;
+        if (ws_deflate_params(p, offer_end, window_bits, no_context_takeover))
+            return 1;
+        p = offer_end + 1;
+    }
+    return 0;
+}
+
+/// Answer a websocket handshake with permessage-deflate, as mongoose would without the extension.
+static void ws_handshake_deflate(struct mg_connection *nc, struct http_message *hm, int window_bits, int no_context_takeover)
+{
+    static char const magic[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    struct mg_str *key = mg_get_http_header(hm, "Sec-WebSocket-Key");
+    if (!key)
+        return; // mongoose answers
+
+    uint8_t const *msgs[2] = {(uint8_t const *)key->p, (uint8_t const *)magic};
+    size_t const lens[2]   = {key->len, sizeof(magic) - 1};
+    unsigned char sha[20];
+    char accept[30];
+    mg_hash_sha1_v(2, msgs, lens, sha);
+    mg_base64_encode(sha, sizeof(sha), accept);
+
+    mg_printf(nc, "HTTP/1.1 101 Switching Protocols\r\n"
+                  "Upgrade: websocket\r\n"
+                  "Connection: Upgrade\r\n");
+    struct mg_str *protocol = mg_get_http_header(hm, "Sec-WebSocket-Protocol");
+    if (protocol)
+        mg_printf(nc, "Sec-WebSocket-Protocol: %.*s\r\n", (int)protocol->len, protocol->p);
+    // the client compresses each message on its own, a command is inflated without a context
+    mg_printf(nc, "Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover; server_max_window_bits=%d%s\r\n",
+            window_bits, no_context_takeover ? "; server_no_context_takeover" : "");
+    mg_printf(nc, "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+}
+
+/// Compress the messages to a client with a stream, NULL to send them uncompressed.
+static void http_client_deflate(struct http_server_context *ctx, http_client_t *client, stream_deflate_t *deflate)
+{
+    client->deflate = deflate;
+    if (deflate)
+        ctx->deflate_clients++;
+}
+
+/// Returns a gzip stream if the request accepts gzip, NULL otherwise.
+static stream_deflate_t *http_gzip_accepted(struct http_server_context *ctx, struct http_message *hm)
+{
+    struct mg_str *enc = ctx->compress ? mg_get_http_header(hm, "Accept-Encoding") : NULL;
+    if (!enc)
+        return NULL;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%.*s", (int)enc->len, enc->p);
+    char *gzip = strstr(buf, "gzip");
+    if (!gzip || (!strncmp(gzip + 4, ";q=0", 4) && gzip[8] != '.'))
+        return NULL; // not accepted with a weight of 0
+    return stream_deflate_create(STREAM_DEFLATE_GZIP, STREAM_DEFLATE_WBITS, 0);
+}
+
+/// Send the deltas of events to a client with "delta" in the query, not to the event log clients.
+static void http_client_delta(struct http_server_context *ctx, http_client_t *client, struct http_message *hm)
+{
+    char delta[8];
+    char since[32];
+    char from[32];
+    if (!ctx->sensor_seq || mg_get_http_var(&hm->query_string, "delta", delta, sizeof(delta)) <= 0 || !atobv(delta, 1))
+        return;
+    if (ctx->log && mg_get_http_var(&hm->query_string, "from", from, sizeof(from)) > 0
+            && mg_get_http_var(&hm->query_string, "since", since, sizeof(since)) <= 0)
+        return;
+    client->sensor_seq = calloc(ctx->sensors.capacity, sizeof(*client->sensor_seq));
+    if (!client->sensor_seq) {
+        WARN_CALLOC("http_client_delta()");
+        return; // NOTE: sends whole events on alloc failure.
+    }
+    ctx->delta_clients++;
+}
+
+/// Reply 404 to a request to read the event log without one, returns 1 if sent.
+static int http_log_missing(struct http_server_context *ctx, struct mg_connection *nc, struct http_message *hm)
+{
+    char from[32];
+    if (ctx->log || mg_get_http_var(&hm->query_string, "from", from, sizeof(from)) <= 0)
+        return 0;
+    mg_http_send_error(nc, 404, "No event log, use e.g. eventlog=rtl_433_events"); // 404 Not Found
+    return 1;
+}
+
+/// Apply the query of a streaming request, "since" replays the history after a sequence number,
+/// "from" sends the event log from a sequence number, "model" filters events, "delta" sends deltas.
+static void http_client_query(struct http_server_context *ctx, http_client_t *client, struct http_message *hm)
+{
+    char model[256];
+    char since[32];
+    char from[32];
+    if (mg_get_http_var(&hm->query_string, "model", model, sizeof(model)) > 0) {
+        client->model = strdup(model);
+        if (!client->model)
+            WARN_STRDUP("http_client_query()");
+    }
+    http_client_delta(ctx, client, hm);
+    if (mg_get_http_var(&hm->query_string, "since", since, sizeof(since)) > 0) {
+        client->with_seq = 1;
+        http_client_replay(ctx, client, (unsigned)strtoul(since, NULL, 10));
+    }
+    else if (ctx->log && mg_get_http_var(&hm->query_string, "from", from, sizeof(from)) > 0) {
+        client->with_seq = 1;
+        client->log_seq  = strtoull(from, NULL, 10);
+        if (client->log_seq < 1)
+            client->log_seq = event_log_first(ctx->log);
+        ctx->log_clients++;
+        http_client_pump(ctx, client);
+    }
+}
+
 // {"cmd":"sample_rate","val":1024000}
 // http --stream --timeout=70 :8433/events
 //s.a. https://developer.twitter.com/en/docs/tutorials/consuming-streaming-data.html
 static void handle_json_events(struct mg_connection *nc, struct http_message *hm)
 {
-    UNUSED(hm);
+    struct http_server_context *ctx = nc->user_data;
+    if (http_log_missing(ctx, nc, hm))
+        return;
+
     /* Send headers */
-    mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    stream_deflate_t *gzip = http_gzip_accepted(ctx, hm);
+    mg_printf(nc, "HTTP/1.1 200 OK\r\n%sTransfer-Encoding: chunked\r\n\r\n", gzip ? "Content-Encoding: gzip\r\n" : "");
 
-    /* Mark connection */
-    struct nc_context *ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) {
-        WARN_CALLOC("handle_json_events()");
+    /* Register client */
+    http_client_t *client = http_client_add(ctx, nc, 1);
+    if (!client) {
+        stream_deflate_free(gzip);
         return;
     }
-    ctx->is_chunked = 1;
-    nc->user_data   = ctx;
+    http_client_deflate(ctx, client, gzip);
+    http_client_query(ctx, client, hm);
 
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
 }
@@ -930,18 +2860,22 @@ static void handle_json_events(struct mg_connection *nc, struct http_message *hm
 // (echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433
 static void handle_json_stream(struct mg_connection *nc, struct http_message *hm)
 {
-    UNUSED(hm);
+    struct http_server_context *ctx = nc->user_data;
+    if (http_log_missing(ctx, nc, hm))
+        return;
+
     /* Send headers */
-    mg_printf(nc, "HTTP/1.1 200 OK\r\n\r\n");
+    stream_deflate_t *gzip = http_gzip_accepted(ctx, hm);
+    mg_printf(nc, "HTTP/1.1 200 OK\r\n%s\r\n", gzip ? "Content-Encoding: gzip\r\n" : "");
 
-    /* Mark connection */
-    struct nc_context *ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) {
-        WARN_CALLOC("handle_json_stream()");
+    /* Register client */
+    http_client_t *client = http_client_add(ctx, nc, 0);
+    if (!client) {
+        stream_deflate_free(gzip);
         return;
     }
-    ctx->is_chunked = 0;
-    nc->user_data   = ctx;
+    http_client_deflate(ctx, client, gzip);
+    http_client_query(ctx, client, hm);
 
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
 }
@@ -957,6 +2891,7 @@ static void handle_cmd_rpc(struct mg_connection *nc, struct http_message *hm)
     char cmd[100], arg[100], val[100];
     rpc_t rpc = {
             .nc = nc,
+            .ctx = ctx,
             .response = rpc_response_jsoncmd,
             .method = cmd,
             .arg = arg,
@@ -981,7 +2916,7 @@ static void handle_cmd_rpc(struct mg_connection *nc, struct http_message *hm)
     rpc.val = strtol(val, &endptr, 10);
     fprintf(stderr, "POST Got %s, arg %s, val %s (%u)\n", cmd, arg, val, rpc.val);
 
-    rpc_exec(&rpc, ctx->cfg);
+    http_rpc_exec(ctx, &rpc);
 }
 
 // Handles POST with JSONRPC command
@@ -992,6 +2927,7 @@ static void handle_json_rpc(struct mg_connection *nc, struct http_message *hm)
 
     rpc_t rpc = {
             .nc       = nc,
+            .ctx      = ctx,
             .response = rpc_response_jsonrpc,
     };
 
@@ -1001,7 +2937,7 @@ static void handle_json_rpc(struct mg_connection *nc, struct http_message *hm)
     /* Parse JSON */
     int ret = jsonrpc_parse(&rpc, &hm->body);
     if (!ret) {
-        rpc_exec(&rpc, ctx->cfg);
+        http_rpc_exec(ctx, &rpc);
     }
     else {
         char *error = "{\"error\":\"Invalid command\"}";
@@ -1020,61 +2956,125 @@ static void handle_ws_rpc(struct mg_connection *nc, struct websocket_message *wm
 
     rpc_t rpc = {
             .nc       = nc,
+            .ctx      = ctx,
             .response = rpc_response_ws,
     };
 
     struct mg_str d = {(char *)wm->data, wm->size};
+    char *inflated  = NULL;
+    int ret         = -1;
+    if (wm->flags & WS_FLAG_RSV1) {
+        // a compressed command, the client compresses each on its own
+        http_client_t *client = http_client_find(ctx, nc);
+        long len              = -1;
+        if (client && client->deflate) {
+            inflated = malloc(STREAM_INFLATE_MAX);
+            if (!inflated)
+                WARN_MALLOC("handle_ws_rpc()"); // NOTE: an invalid command on alloc failure.
+            else
+                len = stream_inflate_message(wm->data, wm->size, inflated, STREAM_INFLATE_MAX);
+        }
+        d = (struct mg_str){inflated, len > 0 ? (size_t)len : 0};
+    }
 
     /* Parse JSON */
-    int ret = json_parse(&rpc, &d);
+    if (d.len)
+        ret = json_parse(&rpc, &d);
     if (!ret) {
-        rpc_exec(&rpc, ctx->cfg);
+        http_rpc_exec(ctx, &rpc);
     }
     else {
         char *error = "{\"error\":\"Invalid command\"}";
         mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, error, strlen(error));
     }
 
+    free(inflated);
     free(rpc.method);
     free(rpc.id);
     free(rpc.arg);
 }
 
 static void ev_handler(struct mg_connection *nc, int ev, void *ev_data);
+static void http_broadcast_send(struct http_server_context *ctx, char const *msg, size_t len, char const *model);
 
 static void send_keep_alive(struct mg_connection *nc)
 {
     if (nc->handler != ev_handler)
         return; // this should not happen
 
-    struct nc_context *ctx = nc->user_data;
-    if (!ctx)
+    struct http_server_context *ctx = nc->user_data;
+    http_client_t *client = ctx ? http_client_find(ctx, nc) : NULL;
+    if (!client)
         return; // this should not happen
 
-    if (ctx->is_chunked) {
-        mg_send_http_chunk(nc, "\r\n", 2);
-    }
-    else {
-        mg_send(nc, "\r\n", 2);
-    }
+    struct mg_str crlf = {"\r\n", 2};
+    http_client_write(ctx, client, &crlf, 1, 0);
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
 }
 
 static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
 {
+    // note that while shutting down the ctx is NULL
+    if (!nc->user_data)
+        return;
+
     switch (ev) {
-    case MG_EV_TIMER:
-        send_keep_alive(nc);
+    case MG_EV_TIMER: {
+        struct http_server_context *ctx = nc->user_data;
+        if (nc == ctx->conn) {
+            ctx->profile_until = 0;
+            cpu_profile_stop(&ctx->profile, ctx->cfg); // a timed profile is done
+        }
+        else
+            send_keep_alive(nc);
+        break;
+    }
+    case MG_EV_POLL: {
+        // the event log grows without an event to this output, e.g. from another process
+        struct http_server_context *ctx = nc->user_data;
+        http_client_t *client = ctx->log_clients || ctx->spectrum_clients ? http_client_find(ctx, nc) : NULL;
+        if (client && client->log_seq)
+            http_client_pump(ctx, client);
+        if (client && client->spectrum)
+            http_client_spectrum(ctx, client);
+        break;
+    }
+    case MG_EV_SEND: {
+        struct http_server_context *ctx = nc->user_data;
+        http_client_t *client = http_client_find(ctx, nc);
+        if (client && *(int *)ev_data > 0) {
+            client->last_progress = mg_time();
+            http_client_pump(ctx, client);
+        }
+        break;
+    }
+    case MG_EV_WEBSOCKET_HANDSHAKE_REQUEST: {
+        struct http_server_context *ctx = nc->user_data;
+        struct http_message *hm = (struct http_message *)ev_data;
+        int window_bits, no_context_takeover;
+        if (ws_deflate_offer(ctx, hm, &window_bits, &no_context_takeover))
+            ws_handshake_deflate(nc, hm, window_bits, no_context_takeover);
         break;
+    }
     case MG_EV_WEBSOCKET_HANDSHAKE_DONE: {
         struct http_server_context *ctx = nc->user_data;
+        struct http_message *hm = (struct http_message *)ev_data;
+        http_client_t *client = http_client_add(ctx, nc, 0);
+        int window_bits, no_context_takeover;
+        if (client && ws_deflate_offer(ctx, hm, &window_bits, &no_context_takeover))
+            http_client_deflate(ctx, client, stream_deflate_create(STREAM_DEFLATE_RAW, window_bits, no_context_takeover));
+        if (client)
+            http_client_delta(ctx, client, hm);
         /* New websocket connection. Send meta. */
-        data_t *meta = meta_data(ctx->cfg);
-        data_output_print(ctx->output, meta);
-        data_free(meta);
+        if (!ctx->threaded)
+            http_update_meta(ctx);
+        http_snapshot_t *meta = http_snapshot_get(ctx, &ctx->meta, 0);
+        if (meta)
+            http_broadcast_send(ctx, meta->text, meta->len, NULL);
+        http_snapshot_unref(ctx, meta);
         /* Send history */
-        for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
-            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, (char *)*iter, strlen((char *)*iter));
+        if (client)
+            http_client_replay(ctx, client, 0);
         break;
     }
     case MG_EV_WEBSOCKET_FRAME: {
@@ -1112,7 +3112,25 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
             handle_openmetrics(nc, hm);
         }
         else if (mg_vcmp(&hm->uri, "/api") == 0) {
-            //handle_api_query(nc, hm);
+            handle_api(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/api/profile") == 0) {
+            handle_profile(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/api/trace") == 0) {
+            handle_trace(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/api/discovery") == 0) {
+            handle_discovery(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/api/discovery/sample") == 0) {
+            handle_discovery_sample(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/api/sensors") == 0) {
+            handle_sensors(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/api/iq") == 0) {
+            handle_iq_snippet(nc, hm);
         }
 #ifdef SERVE_STATIC
         else {
@@ -1122,9 +3140,15 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
 #endif
         break;
     }
-    case MG_EV_CLOSE:
+    case MG_EV_CLOSE: {
         //fprintf(stderr, "MG_EV_CLOSE %p %p %p\n", ev_data, nc, nc->user_data);
+        struct http_server_context *ctx = nc->user_data;
+        http_client_t *client = http_client_find(ctx, nc);
+        if (client)
+            http_client_remove(ctx, client);
+        http_call_closed(ctx, nc);
         break;
+    }
     default:
         break;
     }
@@ -1135,42 +3159,279 @@ static int is_websocket(const struct mg_connection *nc)
     return nc->flags & MG_F_IS_WEBSOCKET;
 }
 
-// event handler to broadcast to all our sockets
-static void http_broadcast_send(struct http_server_context *ctx, char const *msg, size_t len)
+/// Render the delta of an event to a message, kept if shorter than the event.
+static void http_msg_delta(struct http_server_context *ctx, http_msg_t *msg, data_t *delta)
 {
-    struct mg_connection *nc;
-    struct mg_mgr *mgr = ctx->conn->mgr;
+    char buf[2048];
+    size_t len = data_print_jsons(delta, buf, sizeof(buf));
+    if (!len || len >= msg->len)
+        return;
+    msg->delta = malloc(len);
+    if (!msg->delta) {
+        WARN_MALLOC("http_msg_delta()");
+        return; // NOTE: sends the whole event on alloc failure.
+    }
+    memcpy(msg->delta, buf, len);
+    msg->delta_len = len;
+    ctx->msgs_bytes += len;
+    ctx->deltas++;
+}
 
-    char *dup = strdup(msg);
-    if (!dup) {
-        WARN_STRDUP("http_broadcast_send()");
+// broadcast to all our streaming clients, the message is shared and not copied per client
+static void http_broadcast_event(struct http_server_context *ctx, char const *msg, size_t len, char const *model, sensor_entry_t const *entry, data_t *delta)
+{
+    unsigned sensor = entry ? (unsigned)(entry - ctx->sensors.entries) : 0;
+    http_msg_t *shared = http_msg_new(ctx, msg, len);
+    if (!shared) {
+        if (entry)
+            ctx->sensor_seq[sensor] = 0; // the next delta would refer to this event
+        return; // NOTE: skip output on alloc failure.
     }
-    else {
-        free(ring_list_push(ctx->history, dup));
+    if (entry) {
+        shared->sensor      = sensor + 1;
+        shared->sensor_prev = ctx->sensor_seq[sensor];
+        if (delta)
+            http_msg_delta(ctx, shared, delta);
     }
 
-    for (nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
-        if (nc->handler != ev_handler)
-            continue;
+    http_history_push(ctx, shared, model);
+    if (entry)
+        ctx->sensor_seq[sensor] = shared->seq;
+
+    for (http_client_t *client = ctx->clients; client; client = client->next) {
+        http_client_queue(ctx, client, shared);
+        if (!is_websocket(client->nc))
+            mg_set_timer(client->nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
+    }
+
+    http_msg_unref(ctx, shared);
+}
+
+static void http_broadcast_send(struct http_server_context *ctx, char const *msg, size_t len, char const *model)
+{
+    http_broadcast_event(ctx, msg, len, model, NULL, NULL);
+}
+
+/// The listings timer on the event loop, refreshes the snapshots and stops a timed profile.
+static void http_loop_handler(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    // note that while shutting down the ctx is NULL
+    struct http_server_context *ctx = nc->user_data;
+    if (!ctx || ev != MG_EV_TIMER)
+        return;
+
+    double now = mg_time();
+    http_update_meta(ctx);
+    http_update_protocols(ctx);
+    if (now < ctx->stats_wanted)
+        http_update_stats(ctx);
+    if (ctx->profile_until && now >= ctx->profile_until) {
+        ctx->profile_until = 0;
+        cpu_profile_stop(&ctx->profile, ctx->cfg); // a timed profile is done
+    }
+    double next = now + SNAPSHOT_INTERVAL;
+    if (ctx->profile_until && ctx->profile_until < next)
+        next = ctx->profile_until;
+    mg_set_timer(nc, next);
+}
+
+/// Run the requests of the server thread, on the event loop, the wake up is delivered to each connection.
+static void http_loop_wake(struct mg_connection *nc, int ev, void *ev_data)
+{
+    struct http_server_context *ctx;
+    memcpy(&ctx, ev_data, sizeof(ctx));
+    // only the listings timer of a running server has it as user data
+    if (ev != MG_EV_POLL || nc->handler != http_loop_handler || !ctx || nc->user_data != ctx)
+        return;
 
-        struct nc_context *cctx = nc->user_data; // might not be valid
-        if (is_websocket(nc)) {
-            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, msg, len);
+    http_call_t *call;
+    while (!ring_queue_pop(ctx->calls, &call, 0)) {
+        if (call->kind == HTTP_CALL_RPC) {
+            rpc_exec(&call->rpc, ctx->cfg);
+            // the listings read after the reply reflect the command
+            http_update_meta(ctx);
+            http_update_protocols(ctx);
         }
-        else if (cctx && cctx->is_chunked) {
-            mg_send_http_chunk(nc, msg, len);
-            mg_send_http_chunk(nc, "\r\n", 2);
-            mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
+        else {
+            http_reply_render(ctx, call->kind, call->shape, &call->reply);
+        }
+        // at most THREAD_CALLS_MAX are in flight, the replies always fit
+        if (ring_queue_push(ctx->replies, &call) == 0)
+            mg_broadcast(&ctx->mgr, http_thread_wake, NULL, 0);
+    }
+}
+
+/// Wakes the server thread from its poll, the thread then takes the queued records and replies.
+static void http_thread_wake(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(nc);
+    UNUSED(ev);
+    UNUSED(ev_data);
+}
+
+/// Keep the sensor of an event and send the record to the streaming clients, @p json is the rendered record or NULL.
+/// @p skip is the projection of the rendered record, or NULL.
+static void http_server_publish(struct http_server_context *ctx, data_t *data, data_skip_t const *skip, char const *json, size_t len)
+{
+    // collect well-known top level keys
+    data_t *data_model = NULL;
+    for (data_t *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL)
+            data_model = d;
+    }
+    char const *model           = data_model && data_model->type == DATA_STRING ? data_model->value.v_ptr : NULL;
+    sensor_entry_t const *entry = NULL;
+    data_t *delta               = NULL;
+    if (data_model) {
+        uint32_t key = data_sensor_key(data);
+        // the delta to the last event, before this event replaces it
+        if (ctx->delta_clients && key)
+            delta = sensor_entry_delta(sensor_table_find(&ctx->sensors, key), data, skip);
+        entry = sensor_table_update(&ctx->sensors, data, mg_time(), NULL);
+    }
+
+    if (json) {
+        http_broadcast_event(ctx, json, len, model, entry, delta);
+        data_free(delta);
+    }
+    else if (data_model) {
+        // "events"
+        char buf[2048]; // we expect the biggest strings to be around 500 bytes.
+        len = data_print_jsons(data, buf, sizeof(buf));
+        http_broadcast_event(ctx, buf, len, model, entry, delta);
+        data_free(delta);
+    }
+    else {
+        // "states"
+        size_t buf_size = 20000; // state message need a large buffer
+        char *buf       = malloc(buf_size);
+        if (!buf) {
+            WARN_MALLOC("http_server_publish()");
+            return; // NOTE: skip output on alloc failure.
         }
-        else if (cctx && !cctx->is_chunked) {
-            mg_send(nc, msg, len);
-            mg_send(nc, "\r\n", 2);
-            mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
+        len = data_print_jsons(data, buf, buf_size);
+        http_broadcast_send(ctx, buf, len, model);
+        free(buf);
+    }
+}
+
+/// Take the queued records, on the server thread.
+static void http_event_take(struct http_server_context *ctx)
+{
+    http_event_t event;
+    while (!ring_queue_pop(ctx->events, &event, 0)) {
+        char const *json = event.json;
+        size_t len       = event.len;
+        if (!json) {
+            data_render_start(&ctx->render, event.data);
+            json = data_render_jsons(&ctx->render, event.data, &len);
         }
+        http_server_publish(ctx, event.data, event.skip, json, len);
+        data_free(event.data);
+        free(event.json);
+    }
+}
+
+#define SHUTDOWN_JSON "{\"shutdown\":\"goodbye\"}"
+
+/// Close the server and the streaming connections with a goodbye.
+static void http_server_goodbye(struct http_server_context *ctx)
+{
+    // close the server
+    ctx->conn->user_data = NULL;
+    ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
+
+    // close connections with a goodbye
+    while (ctx->clients) {
+        http_client_t *client    = ctx->clients;
+        struct mg_connection *nc = client->nc;
+        struct mg_str parts[2]   = {{SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1}, {"\r\n", 2}};
+        // the last message ends a gzip stream
+        http_client_write(ctx, client, parts, is_websocket(nc) ? 1 : 2, 1);
+        if (!is_websocket(nc) && client->is_chunked)
+            mg_send_http_chunk(nc, "", 0); /* Send empty chunk, the end of response */
+        http_client_remove(ctx, client);
+    }
+}
+
+/// Free the server, the connections are closed.
+static void http_server_free(struct http_server_context *ctx)
+{
+    if (ctx->loop) {
+        ctx->loop->user_data = NULL;
+        ctx->loop->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
+    while (ctx->history_len)
+        http_history_shift(ctx);
+    free(ctx->history);
+    sensor_table_free(&ctx->sensors);
+    free(ctx->sensor_seq);
+    event_log_reader_close(ctx->log);
+    event_log_reader_close(ctx->iq_log);
+    free(ctx->spectrum_json);
+    free(ctx->spectrum_db);
+    for (unsigned i = 0; i < ctx->models_size; ++i)
+        free(ctx->models[i].name);
+    free(ctx->models);
+    cpu_profile_free(&ctx->profile, ctx->cfg);
+    http_snapshot_unref(ctx, ctx->meta);
+    http_snapshot_unref(ctx, ctx->protocols);
+    http_snapshot_unref(ctx, ctx->stats);
+    ring_queue_free(ctx->events);
+    ring_queue_free(ctx->calls);
+    ring_queue_free(ctx->replies);
+    data_render_free(&ctx->render);
+#ifdef THREADS
+    pthread_mutex_destroy(&ctx->lock);
+#endif
+
+    free(ctx);
+}
+
+#ifdef THREADS
+
+static int http_mgr_sending(struct mg_mgr *mgr)
+{
+    for (struct mg_connection *nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
+        if (nc->send_mbuf.len)
+            return 1;
+    }
+    return 0;
+}
+
+static THREAD_RETURN THREAD_CALL http_server_loop(void *arg)
+{
+    struct http_server_context *ctx = arg;
+    trace_thread_name("http_server");
+
+    for (;;) {
+        mg_mgr_poll(&ctx->mgr, 500);
+        http_event_take(ctx);
+        http_call_take(ctx);
+
+        http_counters_t counters;
+        http_counters_get(ctx, &counters);
+        http_lock(ctx);
+        ctx->counters = counters;
+        int stop      = ctx->stop;
+        http_unlock(ctx);
+        if (stop)
+            break;
     }
+
+    http_server_goodbye(ctx);
+    // give the goodbyes a moment to go out
+    for (int i = 0; i < 10 && http_mgr_sending(&ctx->mgr); ++i)
+        mg_mgr_poll(&ctx->mgr, 100);
+    mg_mgr_free(&ctx->mgr);
+
+    return (THREAD_RETURN)0;
 }
 
-static struct http_server_context *http_server_start(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg, struct data_output *output)
+#endif
+
+static struct http_server_context *http_server_start(struct mg_mgr *mgr, char const *host, char const *port, unsigned history_max, size_t history_budget, unsigned sensors, int compress, int threaded, r_cfg_t *cfg, struct data_output *output)
 {
     struct mg_bind_opts bind_opts;
     const char *err_str;
@@ -1181,10 +3442,51 @@ static struct http_server_context *http_server_start(struct mg_mgr *mgr, char co
         WARN_CALLOC("http_server_start()");
         return NULL;
     }
+#ifdef THREADS
+    pthread_mutex_init(&ctx->lock, NULL);
+#endif
+
+    ctx->cfg            = cfg;
+    ctx->output         = output;
+    ctx->next_seq       = 1;
+    ctx->history_max    = history_max;
+    ctx->history_budget = history_budget;
+    ctx->compress       = compress && stream_deflate_available();
+    ctx->history        = calloc(history_max, sizeof(*ctx->history));
+    if (!ctx->history) {
+        WARN_CALLOC("http_server_start()");
+        http_server_free(ctx);
+        return NULL;
+    }
+    if (sensors && sensor_table_init(&ctx->sensors, sensors) < 0) {
+        http_server_free(ctx);
+        return NULL;
+    }
+    if (sensors) {
+        ctx->sensor_seq = calloc(sensors, sizeof(*ctx->sensor_seq));
+        if (!ctx->sensor_seq) {
+            WARN_CALLOC("http_server_start()");
+            http_server_free(ctx);
+            return NULL;
+        }
+    }
 
-    ctx->cfg     = cfg;
-    ctx->output  = output;
-    ctx->history = ring_list_new(DEFAULT_HISTORY_SIZE);
+    if (threaded) {
+        ctx->threaded = 1;
+        ctx->events   = ring_queue_create(THREAD_EVENTS_QUEUE, sizeof(http_event_t));
+        ctx->calls    = ring_queue_create(THREAD_CALLS_MAX, sizeof(http_call_t *));
+        ctx->replies  = ring_queue_create(THREAD_CALLS_MAX, sizeof(http_call_t *));
+        if (ctx->events && ctx->calls && ctx->replies) {
+            struct mg_add_sock_opts loop_opts = {.user_data = ctx};
+            ctx->loop = mg_add_sock_opt(mgr, INVALID_SOCKET, http_loop_handler, loop_opts);
+        }
+        if (!ctx->loop) {
+            http_server_free(ctx);
+            return NULL;
+        }
+        mg_set_timer(ctx->loop, mg_time()); // publish the listings once the event loop runs
+        mg_mgr_init(&ctx->mgr, NULL);
+    }
 
     char address[253 + 6 + 1]; // dns max + port
     // if the host is an IPv6 address it needs quoting
@@ -1198,12 +3500,13 @@ static struct http_server_context *http_server_start(struct mg_mgr *mgr, char co
     bind_opts.user_data = ctx;
     bind_opts.error_string = &err_str;
 
-    ctx->conn = mg_bind_opt(mgr, address, ev_handler, bind_opts);
+    ctx->conn = mg_bind_opt(threaded ? &ctx->mgr : mgr, address, ev_handler, bind_opts);
     if (ctx->conn == NULL) {
         print_logf(LOG_ERROR, __func__, "Error starting server on address %s: %s", address,
                 *bind_opts.error_string);
-        ring_list_free(ctx->history);
-        free(ctx);
+        if (threaded)
+            mg_mgr_free(&ctx->mgr);
+        http_server_free(ctx);
         return NULL;
     }
 
@@ -1211,49 +3514,76 @@ static struct http_server_context *http_server_start(struct mg_mgr *mgr, char co
     ctx->server_opts.document_root            = "."; // Serve current directory
     ctx->server_opts.enable_directory_listing = "yes";
 
-    print_logf(LOG_NOTICE, "HTTP server", "Serving HTTP-API on address %s, serving %s", address,
-            ctx->server_opts.document_root);
+#ifdef THREADS
+    if (threaded) {
+#ifndef _WIN32
+        // Block all signals from the server thread
+        sigset_t sigset;
+        sigset_t oldset;
+        sigfillset(&sigset);
+        pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+        int r = pthread_create(&ctx->thread, NULL, http_server_loop, ctx);
+#ifndef _WIN32
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+            mg_mgr_free(&ctx->mgr);
+            http_server_free(ctx);
+            return NULL;
+        }
+    }
+#endif
+
+    print_logf(LOG_NOTICE, "HTTP server", "Serving HTTP-API on address %s%s, serving %s", address,
+            threaded ? " from its own thread" : "", ctx->server_opts.document_root);
 
     return ctx;
 }
 
-#define SHUTDOWN_JSON "{\"shutdown\":\"goodbye\"}"
-
 static int http_server_stop(struct http_server_context *ctx)
 {
     if (!ctx)
         return 0;
 
-    // close the server
-    ctx->conn->user_data = NULL;
-    ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
-
-    // close connections with a goodbye
-    struct mg_mgr *mgr = ctx->conn->mgr;
-    for (struct mg_connection *nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
-        if (nc->handler != ev_handler)
-            continue;
-
-        struct nc_context *cctx = nc->user_data; // might not be valid
-        if (is_websocket(nc)) {
-            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
+#ifdef THREADS
+    if (ctx->threaded) {
+        http_lock(ctx);
+        ctx->stop = 1;
+        http_unlock(ctx);
+        mg_broadcast(&ctx->mgr, http_thread_wake, NULL, 0);
+        int r = pthread_join(ctx->thread, NULL);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
         }
-        else if (cctx && cctx->is_chunked) {
-            mg_send_http_chunk(nc, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
-            mg_send_http_chunk(nc, "\r\n", 2);
-            mg_send_http_chunk(nc, "", 0);            /* Send empty chunk, the end of response */
-        }
-        else if (cctx && !cctx->is_chunked) {
-            mg_send(nc, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
-            mg_send(nc, "\r\n", 2);
+
+        // the server thread closed the connections, nothing waits for the records and requests in flight
+        http_event_t event;
+        while (!ring_queue_pop(ctx->events, &event, 0)) {
+            data_free(event.data);
+            free(event.json);
         }
+        http_call_t *call;
+        while (!ring_queue_pop(ctx->calls, &call, 0))
+            http_call_free(call);
+        while (!ring_queue_pop(ctx->replies, &call, 0))
+            http_call_free(call);
+        http_server_free(ctx);
+        return 0;
     }
+#endif
 
-    for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
-        free((data_t *)*iter);
-    ring_list_free(ctx->history);
+    http_server_goodbye(ctx);
 
-    free(ctx);
+    // remove ctx from our connections
+    struct mg_mgr *mgr = ctx->conn->mgr;
+    for (struct mg_connection *nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
+        if (nc->handler == ev_handler)
+            nc->user_data = NULL;
+    }
+
+    http_server_free(ctx);
 
     return 0;
 }
@@ -1269,33 +3599,43 @@ static void R_API_CALLCONV print_http_data(data_output_t *output, data_t *data,
 {
     UNUSED(format);
     data_output_http_t *http = (data_output_http_t *)output;
+    struct http_server_context *ctx = http->server;
 
-    // collect well-known top level keys
-    data_t *data_model = NULL;
-    for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "model"))
-            data_model = d;
+    if (!ctx->threaded) {
+        size_t len;
+        char const *json = data_render_jsons(output->render, data, &len);
+        http_server_publish(ctx, data, output->skip, json, len);
+        return;
     }
 
-    if (data_model) {
-        // "events"
-        char buf[2048]; // we expect the biggest strings to be around 500 bytes.
-        size_t len = data_print_jsons(data, buf, sizeof(buf));
-        http_broadcast_send(http->server, buf, len);
-    }
-    else {
-        // "states"
-        size_t buf_size = 20000; // state message need a large buffer
-        char *buf       = malloc(buf_size);
-        if (!buf) {
+    // the server thread renders the record, a projection is rendered here
+    http_event_t event = {.data = data, .skip = output->skip};
+    char const *json   = output->skip ? data_render_jsons(output->render, data, &event.len) : NULL;
+    if (json) {
+        event.json = malloc(event.len);
+        if (!event.json) {
             WARN_MALLOC("print_http_data()");
             return; // NOTE: skip output on alloc failure.
         }
-        size_t len = data_print_jsons(data, buf, buf_size);
-        http_broadcast_send(http->server, buf, len);
-        free(buf);
+        memcpy(event.json, json, event.len);
+    }
+    data_retain(data);
+    int queued = ring_queue_push(ctx->events, &event);
+    if (queued < 0) {
+        data_free(data); // dropped, counted by the queue
+        free(event.json);
+    }
+    else if (queued == 0) {
+        // the server thread takes all queued records on one wake up
+        mg_broadcast(&ctx->mgr, http_thread_wake, NULL, 0);
     }
 }
+static data_t *R_API_CALLCONV data_output_http_stats(data_output_t *output)
+{
+    data_output_http_t *http = (data_output_http_t *)output;
+
+    return http_server_stats(http->server);
+}
 
 static void R_API_CALLCONV data_output_http_free(data_output_t *output)
 {
@@ -1309,8 +3649,53 @@ static void R_API_CALLCONV data_output_http_free(data_output_t *output)
     free(http);
 }
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg)
+struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, char *opts, r_cfg_t *cfg)
 {
+    unsigned history_max  = DEFAULT_HISTORY_SIZE;
+    size_t history_budget = DEFAULT_HISTORY_BYTES;
+    unsigned sensors      = SENSOR_TABLE_DEFAULT;
+    char const *eventlog  = NULL;
+    int compress          = 1;
+    int threaded          = 0;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "history"))
+            history_max = atoiv(val, DEFAULT_HISTORY_SIZE);
+        else if (!strcasecmp(key, "history_size"))
+            history_budget = atoiv(val, DEFAULT_HISTORY_BYTES);
+        else if (!strcasecmp(key, "sensors"))
+            sensors = atoiv(val, SENSOR_TABLE_DEFAULT);
+        else if (!strcasecmp(key, "eventlog"))
+            eventlog = val && *val ? val : EVENTLOG_DEFAULT_DIR;
+        else if (!strcasecmp(key, "compress"))
+            compress = atobv(val, 1);
+        else if (!strcasecmp(key, "thread"))
+            threaded = atobv(val, 1);
+        else {
+            print_logf(LOG_FATAL, "HTTP server", "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+    if ((int)history_max < 1 || (int)history_budget < 0) {
+        print_log(LOG_FATAL, "HTTP server", "Invalid history option.");
+        exit(1);
+    }
+    if ((int)sensors < 0) {
+        print_log(LOG_FATAL, "HTTP server", "Invalid sensors option.");
+        exit(1);
+    }
+#ifndef THREADS
+    if (threaded) {
+        print_log(LOG_WARNING, "HTTP server", "Threads not available in this build, serving from the event loop.");
+        threaded = 0;
+    }
+#endif
+
     data_output_http_t *http = calloc(1, sizeof(data_output_http_t));
     if (!http) {
         WARN_CALLOC("data_output_http_create()");
@@ -1319,12 +3704,18 @@ struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host
 
     http->output.log_level    = LOG_TRACE; // sensible default, not parsed from args
     http->output.print_data   = print_http_data;
+    http->output.output_stats = data_output_http_stats;
     http->output.output_free  = data_output_http_free;
 
-    http->server = http_server_start(mgr, host, port, cfg, &http->output);
+    http->server = http_server_start(mgr, host, port, history_max, history_budget, sensors, compress, threaded, cfg, &http->output);
     if (!http->server) {
         exit(1);
     }
+    if (eventlog) {
+        http->server->log = event_log_reader_open(eventlog);
+        if (!http->server->log)
+            exit(1);
+    }
 
     return (struct data_output *)http;
 }
@@ -0,0 +1,279 @@
+/** @file
+    Lossless compression of CU8 I/Q data for network transport.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "iq_codec.h"
+
+#include <string.h>
+
+// Each block starts with a byte: 0xff for stored data, otherwise bit 7 set for
+// differences to the previous sample of the same channel and the Rice parameter
+// k in the low bits. The zigzag mapped values follow as Rice codes, a unary
+// quotient of ones ended by a zero then k remainder bits, MSB first, padded to
+// whole bytes. The previous sample carries over from block to block.
+
+#define BLOCK_STORED 0xff
+#define BLOCK_DELTA 0x80
+#define RICE_K_MAX 7
+
+typedef struct bit_writer {
+    uint8_t *p;
+    uint64_t acc;
+    unsigned n;
+} bit_writer_t;
+
+static void bits_put(bit_writer_t *bw, uint32_t value, unsigned count)
+{
+    bw->acc = bw->acc << count | value;
+    bw->n += count;
+    while (bw->n >= 8) {
+        bw->n -= 8;
+        *bw->p++ = (uint8_t)(bw->acc >> bw->n);
+    }
+}
+
+static void bits_flush(bit_writer_t *bw)
+{
+    if (bw->n)
+        *bw->p++ = (uint8_t)(bw->acc << (8 - bw->n));
+    bw->n = 0;
+}
+
+typedef struct bit_reader {
+    uint8_t const *p;
+    uint8_t const *end;
+    uint64_t acc;
+    unsigned n;
+} bit_reader_t;
+
+/// Make at least count bits available, returns 0 on success.
+static int bits_need(bit_reader_t *br, unsigned count)
+{
+    while (br->n <= 56 && br->p < br->end) {
+        br->acc = br->acc << 8 | *br->p++;
+        br->n += 8;
+    }
+    return br->n < count ? -1 : 0;
+}
+
+static uint32_t bits_get(bit_reader_t *br, unsigned count)
+{
+    br->n -= count;
+    return (uint32_t)(br->acc >> br->n) & ((1u << count) - 1);
+}
+
+static inline uint8_t zigzag(uint8_t v)
+{
+    return (uint8_t)(v << 1) ^ (uint8_t)(0 - (v >> 7));
+}
+
+static inline uint8_t unzigzag(uint8_t z)
+{
+    return (uint8_t)(z >> 1) ^ (uint8_t)(0 - (z & 1));
+}
+
+size_t iq_codec_bound(size_t len)
+{
+    return len + (len / 2 + IQ_CODEC_BLOCK - 1) / IQ_CODEC_BLOCK;
+}
+
+size_t iq_codec_encode(uint8_t const *src, size_t len, uint8_t *dst)
+{
+    bit_writer_t bw = {.p = dst};
+    uint8_t prev[2] = {128, 128};
+
+    for (size_t pos = 0; pos < len; pos += 2 * IQ_CODEC_BLOCK) {
+        size_t n = len - pos < 2 * IQ_CODEC_BLOCK ? len - pos : 2 * IQ_CODEC_BLOCK;
+        uint8_t const *blk = &src[pos];
+
+        // histograms of the zigzag mapped values and differences
+        unsigned hist[2][256] = {{0}};
+        uint8_t last[2] = {prev[0], prev[1]};
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t x = blk[i];
+            hist[0][zigzag(x ^ 0x80)] += 1;
+            hist[1][zigzag((uint8_t)(x - last[i & 1]))] += 1;
+            last[i & 1] = x;
+        }
+
+        // pick the mode and parameter with the fewest bits
+        uint64_t best_bits = (uint64_t)n * 8;
+        int best_delta = -1;
+        unsigned best_k = 0;
+        for (int delta = 0; delta < 2; ++delta) {
+            for (unsigned k = 0; k <= RICE_K_MAX; ++k) {
+                uint64_t bits = 0;
+                for (unsigned z = 0; z < 256; ++z)
+                    bits += (uint64_t)hist[delta][z] * ((z >> k) + 1 + k);
+                if (bits < best_bits) {
+                    best_bits  = bits;
+                    best_delta = delta;
+                    best_k     = k;
+                }
+            }
+        }
+
+        if (best_delta < 0) {
+            bits_put(&bw, BLOCK_STORED, 8);
+            memcpy(bw.p, blk, n);
+            bw.p += n;
+        }
+        else {
+            bits_put(&bw, (best_delta ? BLOCK_DELTA : 0) | best_k, 8);
+            for (size_t i = 0; i < n; ++i) {
+                uint8_t x = blk[i];
+                uint8_t z = best_delta ? zigzag((uint8_t)(x - prev[i & 1])) : zigzag(x ^ 0x80);
+                unsigned q = z >> best_k;
+                while (q >= 24) {
+                    bits_put(&bw, 0xffffff, 24);
+                    q -= 24;
+                }
+                // q ones, a zero, then the remainder
+                bits_put(&bw, ((1u << q) - 1) << (1 + best_k) | (z & ((1u << best_k) - 1)), q + 1 + best_k);
+                prev[i & 1] = x;
+            }
+            bits_flush(&bw);
+        }
+        prev[0] = last[0];
+        prev[1] = last[1];
+    }
+
+    return (size_t)(bw.p - dst);
+}
+
+int iq_codec_decode(uint8_t const *src, size_t src_len, uint8_t *dst, size_t len)
+{
+    bit_reader_t br = {.p = src, .end = src + src_len};
+    uint8_t prev[2] = {128, 128};
+
+    for (size_t pos = 0; pos < len; pos += 2 * IQ_CODEC_BLOCK) {
+        size_t n = len - pos < 2 * IQ_CODEC_BLOCK ? len - pos : 2 * IQ_CODEC_BLOCK;
+        uint8_t *blk = &dst[pos];
+
+        if (bits_need(&br, 8))
+            return -1;
+        unsigned mode = bits_get(&br, 8);
+        if (mode == BLOCK_STORED) {
+            for (size_t i = 0; i < n; ++i) {
+                if (bits_need(&br, 8))
+                    return -1;
+                blk[i] = (uint8_t)bits_get(&br, 8);
+            }
+        }
+        else {
+            unsigned k = mode & RICE_K_MAX;
+            int delta  = mode & BLOCK_DELTA;
+            if (mode & ~(BLOCK_DELTA | RICE_K_MAX))
+                return -1;
+            for (size_t i = 0; i < n; ++i) {
+                unsigned q = 0;
+                for (;;) {
+                    if (bits_need(&br, 1))
+                        return -1;
+                    if (!bits_get(&br, 1))
+                        break;
+                    if (++q > 255u >> k)
+                        return -1;
+                }
+                if (bits_need(&br, k))
+                    return -1;
+                uint8_t z = (uint8_t)(q << k | (k ? bits_get(&br, k) : 0));
+                blk[i] = delta ? (uint8_t)(prev[i & 1] + unzigzag(z)) : unzigzag(z) ^ 0x80;
+                prev[i & 1] = blk[i];
+            }
+            // blocks are padded to whole bytes
+            br.n &= ~7u;
+        }
+        prev[0] = blk[n - 2];
+        prev[1] = blk[n - 1];
+    }
+
+    return 0;
+}
+
+// Unit testing
+#ifdef _TEST
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (a), (b)); \
+        } \
+    } while (0)
+
+/// Encode, decode, and compare, returns the coded length or -1 on failure.
+static int roundtrip(uint8_t const *data, size_t len)
+{
+    size_t bound = iq_codec_bound(len);
+    uint8_t *coded = malloc(bound + 1);
+    if (!coded)
+        return -1;
+    uint8_t *back = malloc(len + 1);
+    if (!back) {
+        free(coded);
+        return -1;
+    }
+    size_t coded_len = iq_codec_encode(data, len, coded);
+    int ret = coded_len <= bound && !iq_codec_decode(coded, coded_len, back, len) && !memcmp(data, back, len) ? (int)coded_len : -1;
+    free(coded);
+    free(back);
+    return ret;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    enum { LEN = 2 * 3 * IQ_CODEC_BLOCK + 6 };
+    static uint8_t data[LEN];
+
+    fprintf(stderr, "iq_codec:: silence\n");
+    for (unsigned i = 0; i < LEN; ++i)
+        data[i] = i & 1 ? 128 : 127;
+    ASSERT_EQUALS(roundtrip(data, LEN) > 0, 1);
+    ASSERT_EQUALS(roundtrip(data, LEN) < LEN / 4, 1);
+
+    fprintf(stderr, "iq_codec:: noise\n");
+    srand(433);
+    for (unsigned i = 0; i < LEN; ++i)
+        data[i] = (uint8_t)(128 + rand() % 9 - 4);
+    ASSERT_EQUALS(roundtrip(data, LEN) > 0, 1);
+    ASSERT_EQUALS(roundtrip(data, LEN) < LEN / 2, 1);
+
+    fprintf(stderr, "iq_codec:: full scale random\n");
+    for (unsigned i = 0; i < LEN; ++i)
+        data[i] = (uint8_t)rand();
+    ASSERT_EQUALS(roundtrip(data, LEN) > 0, 1);
+    ASSERT_EQUALS(roundtrip(data, LEN) <= (int)iq_codec_bound(LEN), 1);
+
+    fprintf(stderr, "iq_codec:: extremes\n");
+    for (unsigned i = 0; i < LEN; ++i)
+        data[i] = i & 2 ? 0 : 255;
+    ASSERT_EQUALS(roundtrip(data, LEN) > 0, 1);
+    ASSERT_EQUALS(roundtrip(data, 2) > 0, 1);
+    ASSERT_EQUALS(roundtrip(data, 0), 0);
+
+    fprintf(stderr, "iq_codec:: corrupt data\n");
+    uint8_t coded[16] = {0x07};
+    ASSERT_EQUALS(iq_codec_decode(coded, 0, data, 2), -1);
+    ASSERT_EQUALS(iq_codec_decode(coded, 1, data, 2), -1);
+    coded[0] = 0x40;
+    ASSERT_EQUALS(iq_codec_decode(coded, sizeof(coded), data, 2), -1);
+
+    fprintf(stderr, "iq_codec:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
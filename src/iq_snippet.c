@@ -0,0 +1,269 @@
+/** @file
+    IQ snippets, the exact samples of each package in a size-capped log on disk.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "iq_snippet.h"
+#include "event_log.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct iq_snippet {
+    event_log_t *log;
+    char *dir;
+
+    iq_snippet_header_t format; ///< the format of the samples in the ring, time_us at the end
+    char *ring;
+    unsigned ring_size;
+    unsigned ring_index; ///< where the next buffer goes
+    unsigned ring_len;   ///< bytes of contiguous samples in the ring
+
+    char *record; ///< header and samples of the snippet being saved
+};
+
+iq_snippet_t *iq_snippet_create(char const *dir, size_t size, unsigned ring_size)
+{
+    iq_snippet_t *snip = calloc(1, sizeof(*snip));
+    if (!snip) {
+        WARN_CALLOC("iq_snippet_create()");
+        return NULL;
+    }
+    snip->dir = strdup(dir);
+    if (!snip->dir) {
+        WARN_STRDUP("iq_snippet_create()");
+        iq_snippet_free(snip);
+        return NULL;
+    }
+    snip->ring_size = ring_size;
+    snip->ring      = malloc(ring_size);
+    if (!snip->ring) {
+        WARN_MALLOC("iq_snippet_create()");
+        iq_snippet_free(snip);
+        return NULL;
+    }
+    snip->record = malloc(sizeof(iq_snippet_header_t) + ring_size);
+    if (!snip->record) {
+        WARN_MALLOC("iq_snippet_create()");
+        iq_snippet_free(snip);
+        return NULL;
+    }
+
+    snip->log = event_log_open(dir, size / EVENT_LOG_SEGMENTS_DEFAULT, EVENT_LOG_SEGMENTS_DEFAULT);
+    if (!snip->log) {
+        iq_snippet_free(snip);
+        return NULL;
+    }
+    return snip;
+}
+
+void iq_snippet_free(iq_snippet_t *snip)
+{
+    if (!snip)
+        return;
+    if (snip->log)
+        event_log_close(snip->log);
+    free(snip->record);
+    free(snip->ring);
+    free(snip->dir);
+    free(snip);
+}
+
+char const *iq_snippet_dir(iq_snippet_t const *snip)
+{
+    return snip->dir;
+}
+
+void iq_snippet_reset(iq_snippet_t *snip)
+{
+    snip->ring_len = 0;
+}
+
+void iq_snippet_push(iq_snippet_t *snip, iq_snippet_header_t const *format, void const *buf, uint32_t len)
+{
+    if (format->sample_size != snip->format.sample_size
+            || format->sample_rate != snip->format.sample_rate
+            || format->center_frequency != snip->format.center_frequency)
+        snip->ring_len = 0;
+    snip->format = *format;
+
+    char const *p = buf;
+    if (len > snip->ring_size) {
+        // only the end of the buffer fits
+        p += len - snip->ring_size;
+        len = snip->ring_size;
+    }
+    snip->ring_len = snip->ring_len + len < snip->ring_size ? snip->ring_len + len : snip->ring_size;
+    while (len) {
+        unsigned chunk = snip->ring_size - snip->ring_index;
+        if (chunk > len)
+            chunk = len;
+        memcpy(&snip->ring[snip->ring_index], p, chunk);
+        p += chunk;
+        len -= chunk;
+        snip->ring_index = (snip->ring_index + chunk) % snip->ring_size;
+    }
+}
+
+uint64_t iq_snippet_save(iq_snippet_t *snip, unsigned start_ago, unsigned end_ago, unsigned margin)
+{
+    unsigned sample_size = snip->format.sample_size;
+    if (!sample_size || start_ago <= end_ago)
+        return 0;
+    unsigned avail = snip->ring_len / sample_size;
+    if (start_ago > avail)
+        return 0; // the package started before the ring
+
+    start_ago = avail - start_ago > margin ? start_ago + margin : avail;
+    end_ago   = end_ago > margin ? end_ago - margin : 0;
+
+    iq_snippet_header_t *header = (iq_snippet_header_t *)snip->record;
+    *header         = snip->format;
+    header->magic   = IQ_SNIPPET_MAGIC;
+    header->samples = start_ago - end_ago;
+    if (snip->format.sample_rate)
+        header->time_us -= (int64_t)start_ago * 1000000 / snip->format.sample_rate;
+
+    unsigned len   = (unsigned)header->samples * sample_size;
+    unsigned start = (snip->ring_index + snip->ring_size - start_ago * sample_size) % snip->ring_size;
+    unsigned chunk = snip->ring_size - start;
+    if (chunk > len)
+        chunk = len;
+    char *data = snip->record + sizeof(*header);
+    memcpy(data, &snip->ring[start], chunk);
+    memcpy(data + chunk, snip->ring, len - chunk);
+
+    return event_log_append(snip->log, snip->record, sizeof(*header) + len);
+}
+
+#ifdef _TEST
+#ifndef _WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Push CU8 samples numbered from @p first, I is the low byte of the number and Q the high byte.
+static void push_samples(iq_snippet_t *snip, iq_snippet_header_t *format, unsigned first, unsigned n)
+{
+    uint8_t buf[2 * 100];
+    format->time_us = (int64_t)(first + n) * 1000000 / format->sample_rate;
+    for (unsigned i = 0; i < n; ++i) {
+        buf[2 * i]     = (uint8_t)(first + i);
+        buf[2 * i + 1] = (uint8_t)((first + i) >> 8);
+    }
+    iq_snippet_push(snip, format, buf, 2 * n);
+}
+
+/// Check that a snippet holds the samples numbered from @p first, returns the number of bad samples.
+static unsigned check_samples(event_log_reader_t *reader, uint64_t seq, unsigned first, unsigned n)
+{
+    void const *rec;
+    long len = event_log_get(reader, seq, &rec);
+    if (len != (long)(sizeof(iq_snippet_header_t) + 2 * n))
+        return n ? n : 1;
+    iq_snippet_header_t const *header = rec;
+    if (header->magic != IQ_SNIPPET_MAGIC || header->samples != n)
+        return n ? n : 1;
+    uint8_t const *data = (uint8_t const *)rec + sizeof(*header);
+    unsigned bad = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        if (data[2 * i] != (uint8_t)(first + i) || data[2 * i + 1] != (uint8_t)((first + i) >> 8))
+            bad++;
+    }
+    return bad;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+#ifndef _WIN32
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/rtl_433_snippet_test_%d", (int)getpid());
+    void const *rec;
+
+    fprintf(stderr, "iq_snippet:: a package with its margin\n");
+    // 500 samples of CU8 in the ring, at 1 kHz a sample is 1 ms
+    iq_snippet_t *snip = iq_snippet_create(dir, 1024 * 1024, 1000);
+    ASSERT_EQUALS(snip != NULL, 1);
+    if (!snip)
+        return 1;
+    event_log_reader_t *reader = event_log_reader_open(dir);
+    ASSERT_EQUALS(reader != NULL, 1);
+    if (!reader)
+        return 1;
+    iq_snippet_header_t format = {.sample_size = 2, .sample_rate = 1000, .center_frequency = 433920000};
+    for (unsigned k = 0; k < 300; k += 100)
+        push_samples(snip, &format, k, 100);
+    uint64_t seq = iq_snippet_save(snip, 150, 50, 10);
+    ASSERT_EQUALS(seq, 1);
+    ASSERT_EQUALS(check_samples(reader, seq, 140, 120), 0);
+    ASSERT_EQUALS(event_log_get(reader, seq, &rec) > 0, 1);
+    ASSERT_EQUALS(((iq_snippet_header_t const *)rec)->time_us, 140000);
+    ASSERT_EQUALS(((iq_snippet_header_t const *)rec)->center_frequency, 433920000);
+
+    fprintf(stderr, "iq_snippet:: a package across the end of the ring\n");
+    for (unsigned k = 300; k < 600; k += 100)
+        push_samples(snip, &format, k, 100);
+    seq = iq_snippet_save(snip, 450, 50, 0);
+    ASSERT_EQUALS(seq, 2);
+    ASSERT_EQUALS(check_samples(reader, seq, 150, 400), 0);
+
+    fprintf(stderr, "iq_snippet:: the margin is clipped to the ring\n");
+    seq = iq_snippet_save(snip, 495, 5, 10);
+    ASSERT_EQUALS(seq, 3);
+    ASSERT_EQUALS(check_samples(reader, seq, 100, 500), 0);
+    ASSERT_EQUALS(iq_snippet_save(snip, 501, 5, 0), 0); // started before the ring
+    ASSERT_EQUALS(iq_snippet_save(snip, 50, 50, 0), 0);  // no samples
+
+    fprintf(stderr, "iq_snippet:: a gap or a new format empties the ring\n");
+    format.sample_rate = 2000;
+    push_samples(snip, &format, 600, 100);
+    ASSERT_EQUALS(iq_snippet_save(snip, 150, 50, 0), 0);
+    seq = iq_snippet_save(snip, 80, 20, 0);
+    ASSERT_EQUALS(seq, 4);
+    ASSERT_EQUALS(check_samples(reader, seq, 620, 60), 0);
+    iq_snippet_reset(snip);
+    ASSERT_EQUALS(iq_snippet_save(snip, 80, 20, 0), 0);
+
+    event_log_reader_close(reader);
+    iq_snippet_free(snip);
+
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *entry;
+        while ((entry = readdir(d))) {
+            char path[1024];
+            if (entry->d_name[0] == '.')
+                continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+        closedir(d);
+    }
+    ASSERT_EQUALS(rmdir(dir), 0);
+#endif
+
+    fprintf(stderr, "iq_snippet:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,168 @@
+/** @file
+    Buffer load shedding, skips the quietest SDR buffers while the processing lags the input.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "lag_shed.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct lag_shed {
+    int64_t limit_us;
+
+    int has_ref;           ///< a buffer was seen since the start or a reset
+    int64_t ref_us;        ///< the smallest wall time less sample time, i.e. no lag
+    int64_t ref_sample_us; ///< sample time the reference was last set at
+    int64_t lag_us;        ///< lag of the current buffer
+
+    unsigned num_levels;  ///< levels in the ring
+    unsigned next_level;  ///< ring entry to replace next
+    float levels[LAG_SHED_LEVELS];
+};
+
+lag_shed_t *lag_shed_create(int64_t limit_us)
+{
+    lag_shed_t *shed = calloc(1, sizeof(*shed));
+    if (!shed) {
+        WARN_CALLOC("lag_shed_create()");
+        return NULL;
+    }
+    shed->limit_us = limit_us > 0 ? limit_us : 1;
+    return shed;
+}
+
+void lag_shed_free(lag_shed_t *shed)
+{
+    free(shed);
+}
+
+void lag_shed_reset(lag_shed_t *shed)
+{
+    shed->has_ref = 0;
+    shed->lag_us  = 0;
+}
+
+int64_t lag_shed_update(lag_shed_t *shed, int64_t now_us, int64_t sample_us)
+{
+    int64_t offset_us = now_us - sample_us;
+    if (!shed->has_ref || offset_us < shed->ref_us) {
+        shed->has_ref       = 1;
+        shed->ref_us        = offset_us;
+        shed->ref_sample_us = sample_us;
+    }
+    else {
+        // follow a slow SDR clock, a lag from the processing builds up much faster
+        int64_t drift_us = (sample_us - shed->ref_sample_us) * LAG_SHED_DRIFT_PPM / 1000000;
+        if (drift_us > 0) {
+            shed->ref_us        = offset_us < shed->ref_us + drift_us ? offset_us : shed->ref_us + drift_us;
+            shed->ref_sample_us = sample_us;
+        }
+    }
+    shed->lag_us = offset_us - shed->ref_us;
+    return shed->lag_us;
+}
+
+int lag_shed_skip(lag_shed_t *shed, float level)
+{
+    int skip = 0;
+    if (shed->lag_us > shed->limit_us && shed->num_levels) {
+        // half of the buffers at the limit, all but the loudest at twice the limit
+        double share = (double)shed->lag_us / (2 * shed->limit_us);
+        if (share > 1.0)
+            share = 1.0;
+        unsigned below = 0;
+        for (unsigned i = 0; i < shed->num_levels; ++i)
+            below += shed->levels[i] < level;
+        skip = below < share * shed->num_levels;
+    }
+
+    shed->levels[shed->next_level] = level;
+    shed->next_level = (shed->next_level + 1) % LAG_SHED_LEVELS;
+    if (shed->num_levels < LAG_SHED_LEVELS)
+        shed->num_levels += 1;
+    return skip;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define BUF_US 16384 // duration of a buffer
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "lag_shed:: no lag\n");
+    lag_shed_t *shed = lag_shed_create(100000);
+    int64_t now = 1700000000000000LL;
+    unsigned skipped = 0;
+    for (int i = 1; i <= 100; ++i) {
+        // processed as the buffers come in, with a jitter
+        ASSERT_EQUALS(lag_shed_update(shed, now + i * BUF_US + (i % 3) * 1000, i * BUF_US) <= 2000, 1);
+        skipped += lag_shed_skip(shed, (float)(i % 10));
+    }
+    ASSERT_EQUALS(skipped, 0);
+
+    fprintf(stderr, "lag_shed:: the quiet buffers are skipped first\n");
+    // the processing falls behind by 150 ms, 3/4 of the buffers are skipped
+    int64_t t = now + 101 * BUF_US + 150000;
+    skipped = 0;
+    unsigned loud_skipped = 0;
+    for (int i = 101; i <= 200; ++i) {
+        int64_t lag = lag_shed_update(shed, t, i * BUF_US);
+        ASSERT_EQUALS(lag > 145000 && lag <= 150000, 1);
+        float level = (float)(i % 10);
+        int skip = lag_shed_skip(shed, level);
+        skipped += skip;
+        loud_skipped += skip && level >= 8.0f;
+        t += BUF_US;
+    }
+    ASSERT_EQUALS(skipped >= 60 && skipped <= 80, 1);
+    ASSERT_EQUALS(loud_skipped, 0);
+
+    fprintf(stderr, "lag_shed:: all but the loudest over twice the limit\n");
+    lag_shed_update(shed, t + 250000, 201 * BUF_US);
+    ASSERT_EQUALS(lag_shed_skip(shed, 8.5f), 1);
+    lag_shed_update(shed, t + 250000, 202 * BUF_US);
+    ASSERT_EQUALS(lag_shed_skip(shed, 20.0f), 0);
+
+    fprintf(stderr, "lag_shed:: the lag is gone after a reset\n");
+    lag_shed_reset(shed);
+    ASSERT_EQUALS(lag_shed_update(shed, t + 999999, 300 * BUF_US), 0);
+    ASSERT_EQUALS(lag_shed_skip(shed, 0.0f), 0);
+    lag_shed_free(shed);
+
+    fprintf(stderr, "lag_shed:: a slow SDR clock is no lag\n");
+    shed = lag_shed_create(100000);
+    int64_t lag = 0;
+    for (int i = 0; i < 100000; ++i) {
+        // the SDR clock is 100 ppm slow, about 160 ms behind after 1640 s
+        int64_t sample = (int64_t)i * BUF_US;
+        lag = lag_shed_update(shed, now + sample + sample / 10000, sample);
+    }
+    ASSERT_EQUALS(lag < 1000, 1);
+    lag_shed_free(shed);
+
+    fprintf(stderr, "lag_shed:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,237 @@
+/** @file
+    Load shedding of the decoders, a CPU time budget per package and per second, and a skip of quiet sources.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "load_shed.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// A source of packages for the quiet skip.
+typedef struct shed_source {
+    uint64_t key;
+    unsigned seen;   ///< stamp of the last package, 0 for an unused entry
+    unsigned misses; ///< packages in a row without an event
+    unsigned skips;  ///< packages skipped since the source went quiet
+} shed_source_t;
+
+struct load_shed {
+    uint64_t package_ns;
+    uint64_t second_ns;
+    unsigned quiet_max;
+
+    uint64_t second;        ///< the current input second
+    uint64_t second_used;   ///< decoder time of the finished packages of the current second
+    uint64_t package_start; ///< start time of the current package
+    int active;             ///< a package is decoded, between load_shed_begin() and load_shed_end()
+    int over;               ///< the current package is over a budget
+    unsigned num_shed;      ///< decoders shed on the current package
+
+    unsigned stamp;         ///< counts the packages, for the least recently seen source
+    shed_source_t *source;  ///< source of the current package, NULL if not tracked
+    shed_source_t sources[LOAD_SHED_SOURCES];
+};
+
+load_shed_t *load_shed_create(uint64_t package_ns, uint64_t second_ns, unsigned quiet_max)
+{
+    if (!package_ns && !second_ns && !quiet_max)
+        return NULL;
+
+    load_shed_t *shed = calloc(1, sizeof(*shed));
+    if (!shed) {
+        WARN_CALLOC("load_shed_create()");
+        return NULL;
+    }
+    shed->package_ns = package_ns;
+    shed->second_ns  = second_ns;
+    shed->quiet_max  = quiet_max;
+    return shed;
+}
+
+void load_shed_free(load_shed_t *shed)
+{
+    free(shed);
+}
+
+/// Find the entry of a source, replaces the least recently seen one if the source is new.
+static shed_source_t *find_source(load_shed_t *shed, uint64_t key)
+{
+    shed_source_t *oldest = &shed->sources[0];
+    for (unsigned i = 0; i < LOAD_SHED_SOURCES; ++i) {
+        shed_source_t *s = &shed->sources[i];
+        if (s->seen && s->key == key)
+            return s;
+        if (s->seen < oldest->seen)
+            oldest = s;
+    }
+    *oldest = (shed_source_t){.key = key};
+    return oldest;
+}
+
+int load_shed_begin(load_shed_t *shed, uint64_t source, uint64_t second, uint64_t now)
+{
+    if (second != shed->second) {
+        shed->second      = second;
+        shed->second_used = 0;
+    }
+    shed->package_start = now;
+    shed->over          = shed->second_ns && shed->second_used >= shed->second_ns;
+    shed->num_shed      = 0;
+
+    shed->source = NULL;
+    shed->active = 1;
+    if (!shed->quiet_max)
+        return 0;
+    if (!++shed->stamp) {
+        // the stamps wrapped, start the order over
+        for (unsigned i = 0; i < LOAD_SHED_SOURCES; ++i)
+            shed->sources[i].seen = shed->sources[i].seen ? 1 : 0;
+        shed->stamp = 2;
+    }
+    shed_source_t *s = find_source(shed, source);
+    s->seen = shed->stamp;
+    if (s->misses >= shed->quiet_max && ++s->skips % LOAD_SHED_PROBE) {
+        shed->active = 0;
+        return 1;
+    }
+    shed->source = s;
+    return 0;
+}
+
+int load_shed_over(load_shed_t *shed, uint64_t now)
+{
+    if (!shed->active)
+        return 0; // not within a package, e.g. a test run of the decoders
+    if (!shed->over) {
+        uint64_t used = now - shed->package_start;
+        shed->over = (shed->package_ns && used > shed->package_ns)
+                || (shed->second_ns && shed->second_used + used > shed->second_ns);
+    }
+    shed->num_shed += shed->over;
+    return shed->over;
+}
+
+unsigned load_shed_end(load_shed_t *shed, int events, uint64_t now)
+{
+    if (!shed->active)
+        return 0;
+    shed->active = 0;
+    shed->second_used += now - shed->package_start;
+
+    shed_source_t *s = shed->source;
+    if (s && events > 0) {
+        s->misses = 0;
+        s->skips  = 0;
+    }
+    else if (s && s->misses < shed->quiet_max) {
+        s->misses += 1;
+    }
+    shed->source = NULL;
+    return shed->num_shed;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define MS 1000000 // ns
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "load_shed:: nothing enabled\n");
+    ASSERT_EQUALS(load_shed_create(0, 0, 0) == NULL, 1);
+
+    fprintf(stderr, "load_shed:: package budget\n");
+    load_shed_t *shed = load_shed_create(2 * MS, 0, 0);
+    ASSERT_EQUALS(load_shed_begin(shed, 1, 0, 100 * MS), 0);
+    ASSERT_EQUALS(load_shed_over(shed, 101 * MS), 0);
+    ASSERT_EQUALS(load_shed_over(shed, 103 * MS), 1);
+    ASSERT_EQUALS(load_shed_over(shed, 103 * MS), 1);
+    ASSERT_EQUALS(load_shed_end(shed, 1, 104 * MS), 2);
+    ASSERT_EQUALS(load_shed_begin(shed, 1, 0, 200 * MS), 0);
+    ASSERT_EQUALS(load_shed_over(shed, 201 * MS), 0); // each package has a budget of its own
+    ASSERT_EQUALS(load_shed_end(shed, 1, 201 * MS), 0);
+    ASSERT_EQUALS(load_shed_over(shed, 300 * MS), 0); // no package
+    load_shed_free(shed);
+
+    fprintf(stderr, "load_shed:: second budget\n");
+    shed = load_shed_create(0, 5 * MS, 0);
+    for (int i = 0; i < 2; ++i) {
+        load_shed_begin(shed, 1, 7, (uint64_t)(i * 10) * MS);
+        ASSERT_EQUALS(load_shed_over(shed, (uint64_t)(i * 10 + 1) * MS), 0);
+        load_shed_end(shed, 0, (uint64_t)(i * 10 + 2) * MS);
+    }
+    load_shed_begin(shed, 1, 7, 30 * MS);
+    ASSERT_EQUALS(load_shed_over(shed, 30 * MS), 0);
+    ASSERT_EQUALS(load_shed_over(shed, 32 * MS), 1); // 4 ms used before
+    load_shed_end(shed, 0, 32 * MS);
+    load_shed_begin(shed, 1, 7, 40 * MS);
+    ASSERT_EQUALS(load_shed_over(shed, 40 * MS), 1); // the rest of the second is shed
+    load_shed_end(shed, 0, 40 * MS);
+    load_shed_begin(shed, 1, 8, 50 * MS);
+    ASSERT_EQUALS(load_shed_over(shed, 51 * MS), 0); // the next second starts over
+    load_shed_end(shed, 0, 51 * MS);
+    load_shed_free(shed);
+
+    fprintf(stderr, "load_shed:: quiet sources\n");
+    shed = load_shed_create(0, 0, 3);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQUALS(load_shed_begin(shed, 42, 0, 0), 0);
+        load_shed_end(shed, 0, 0);
+        ASSERT_EQUALS(load_shed_begin(shed, 43, 0, 0), 0); // another source decodes
+        load_shed_end(shed, 1, 0);
+    }
+    unsigned decoded = 0;
+    for (int i = 1; i < 2 * LOAD_SHED_PROBE; ++i) {
+        if (!load_shed_begin(shed, 42, 0, 0)) {
+            decoded += 1;
+            ASSERT_EQUALS(i, LOAD_SHED_PROBE); // the probe
+            load_shed_end(shed, 0, 0);
+        }
+    }
+    ASSERT_EQUALS(decoded, 1);
+    ASSERT_EQUALS(load_shed_begin(shed, 43, 0, 0), 0);
+    load_shed_end(shed, 0, 0);
+    // the next probe decodes, the source returns
+    ASSERT_EQUALS(load_shed_begin(shed, 42, 0, 0), 0);
+    load_shed_end(shed, 1, 0);
+    ASSERT_EQUALS(load_shed_begin(shed, 42, 0, 0), 0);
+    load_shed_end(shed, 0, 0);
+
+    fprintf(stderr, "load_shed:: a new source replaces the least recently seen\n");
+    for (uint64_t key = 100; key < 100 + LOAD_SHED_SOURCES; ++key) {
+        load_shed_begin(shed, key, 0, 0);
+        load_shed_end(shed, 0, 0);
+    }
+    // 42 and 43 were replaced, 42 starts over
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQUALS(load_shed_begin(shed, 42, 0, 0), 0);
+        load_shed_end(shed, 0, 0);
+    }
+    ASSERT_EQUALS(load_shed_begin(shed, 42, 0, 0), 1);
+    load_shed_free(shed);
+
+    fprintf(stderr, "load_shed:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
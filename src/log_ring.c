@@ -0,0 +1,204 @@
+/** @file
+    Lock-free ring of log messages for the event loop, with a per source rate limit.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "log_ring.h"
+#include "compat_atomic.h"
+#include "cpu_stats.h"
+#include "fatal.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the counters are long to be 32 bit on Windows, the positions wrap around
+
+/// Claim an empty slot of @p p for @p src, returns 1 if the slot holds @p src now.
+static inline int atomic_claim_ptr(char const **p, char const *src)
+{
+    void *prev = atomic_cas_ptr((void **)p, NULL, (void *)src);
+    return !prev || prev == src;
+}
+
+/* Log ring */
+
+/// A slot, the sequence is the position it can be written at, or the position + 1 once published.
+typedef struct log_slot {
+    long seq;
+    log_rec_t rec;
+} log_slot_t;
+
+struct log_ring {
+    unsigned mask;
+    log_slot_t *slots;
+    long write_pos;  ///< the next position to claim
+    long read_pos;   ///< the next position to pop, consumer only
+    long waiting;    ///< the consumer drained the ring and needs a wakeup
+    long dropped;
+    log_ring_wakeup_fn wakeup_cb;
+    void *ctx;
+};
+
+log_ring_t *log_ring_create(unsigned size, log_ring_wakeup_fn wakeup_cb, void *ctx)
+{
+    unsigned n = 2;
+    while (n < size)
+        n *= 2;
+
+    log_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        WARN_CALLOC("log_ring_create()");
+        return NULL;
+    }
+    ring->slots = calloc(n, sizeof(*ring->slots));
+    if (!ring->slots) {
+        WARN_CALLOC("log_ring_create()");
+        free(ring);
+        return NULL;
+    }
+    for (unsigned i = 0; i < n; ++i)
+        ring->slots[i].seq = (long)i;
+    ring->mask      = n - 1;
+    ring->waiting   = 1;
+    ring->wakeup_cb = wakeup_cb;
+    ring->ctx       = ctx;
+    return ring;
+}
+
+void log_ring_free(log_ring_t *ring)
+{
+    if (!ring)
+        return;
+    free(ring->slots);
+    free(ring);
+}
+
+int log_ring_push(log_ring_t *ring, int level, char const *src, char const *time, char const *msg)
+{
+    log_slot_t *slot;
+    long pos = atomic_get(&ring->write_pos);
+    for (;;) {
+        slot      = &ring->slots[(unsigned long)pos & ring->mask];
+        long seq  = atomic_get(&slot->seq);
+        long diff = (long)((unsigned long)seq - (unsigned long)pos);
+        if (diff == 0) {
+            if (atomic_cas(&ring->write_pos, pos, (long)((unsigned long)pos + 1)))
+                break;
+            pos = atomic_get(&ring->write_pos); // another thread claimed it
+        }
+        else if (diff < 0) {
+            atomic_add(&ring->dropped, 1); // the slot is not popped yet, the ring is full
+            return -1;
+        }
+        else {
+            pos = atomic_get(&ring->write_pos);
+        }
+    }
+
+    log_rec_t *rec = &slot->rec;
+    rec->level = level;
+    rec->src   = src;
+    snprintf(rec->time, sizeof(rec->time), "%s", time ? time : "");
+    snprintf(rec->msg, sizeof(rec->msg), "%s", msg ? msg : "");
+    atomic_set(&slot->seq, (long)((unsigned long)pos + 1));
+
+    if (atomic_xchg(&ring->waiting, 0) && ring->wakeup_cb)
+        ring->wakeup_cb(ring->ctx);
+    return 0;
+}
+
+int log_ring_pop(log_ring_t *ring, log_rec_t *rec)
+{
+    long pos        = ring->read_pos;
+    log_slot_t *slot = &ring->slots[(unsigned long)pos & ring->mask];
+    if (atomic_get(&slot->seq) != (long)((unsigned long)pos + 1)) {
+        // drained, ask for a wakeup then check again for a message published meanwhile
+        atomic_set(&ring->waiting, 1);
+        if (atomic_get(&slot->seq) != (long)((unsigned long)pos + 1))
+            return -1;
+        atomic_set(&ring->waiting, 0);
+    }
+
+    *rec = slot->rec;
+    atomic_set(&slot->seq, (long)((unsigned long)pos + ring->mask + 1));
+    ring->read_pos = (long)((unsigned long)pos + 1);
+    return 0;
+}
+
+unsigned log_ring_dropped(log_ring_t const *ring)
+{
+    return (unsigned)atomic_get((long *)&ring->dropped);
+}
+
+/* Rate limit */
+
+#define LOG_RATE_SOURCES 128 ///< sources tracked, more sources are not limited
+#define LOG_RATE_PROBES 8
+
+/// The messages of a source in the current second.
+typedef struct log_rate {
+    char const *src;
+    long second;
+    long count;
+    long suppressed; ///< in the last limited second, not reported yet
+} log_rate_t;
+
+static log_rate_t log_rates[LOG_RATE_SOURCES];
+static long log_rate_total; ///< all messages suppressed
+static long log_rate_limit; ///< messages per source and second, 0 for no limit
+
+void log_rate_set_limit(unsigned limit)
+{
+    atomic_set(&log_rate_limit, (long)limit);
+}
+
+static log_rate_t *rate_slot(char const *src)
+{
+    unsigned h = (unsigned)(((uintptr_t)src >> 3) * 2654435761u);
+    for (unsigned i = 0; i < LOG_RATE_PROBES; ++i) {
+        log_rate_t *rate = &log_rates[(h + i) % LOG_RATE_SOURCES];
+        if (atomic_claim_ptr(&rate->src, src))
+            return rate;
+    }
+    return NULL;
+}
+
+int log_rate_allow(char const *src, unsigned *suppressed)
+{
+    if (suppressed)
+        *suppressed = 0;
+    long limit = atomic_get(&log_rate_limit);
+    if (!limit)
+        return 1;
+    log_rate_t *rate = src ? rate_slot(src) : NULL;
+    if (!rate)
+        return 1;
+
+    long now    = (long)(cpu_stats_now() / 1000000000);
+    long second = atomic_get(&rate->second);
+    if (second != now && atomic_cas(&rate->second, second, now)) {
+        atomic_set(&rate->count, 0);
+        long prev = atomic_xchg(&rate->suppressed, 0);
+        if (suppressed)
+            *suppressed = (unsigned)prev;
+    }
+    if (atomic_add(&rate->count, 1) <= limit)
+        return 1;
+
+    atomic_add(&rate->suppressed, 1);
+    atomic_add(&log_rate_total, 1);
+    return 0;
+}
+
+unsigned log_rate_suppressed(void)
+{
+    return (unsigned)atomic_get(&log_rate_total);
+}
@@ -29,6 +29,12 @@ void r_logger_set_log_handler(r_logger_handler const handler, void *userdata)
     logger_handler_userdata = userdata;
 }
 
+void r_logger_get_log_handler(r_logger_handler *handler, void **userdata)
+{
+    *handler  = logger_handler;
+    *userdata = logger_handler_userdata;
+}
+
 void print_log(log_level_t level, char const *src, char const *msg)
 {
     if (logger_handler) {
@@ -0,0 +1,40 @@
+/** @file
+    Cumulative histograms for the metrics exporter.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "metrics.h"
+
+#include <string.h>
+
+void metrics_hist_init(metrics_hist_t *hist, double const *bounds, unsigned num_bounds)
+{
+    memset(hist, 0, sizeof(*hist));
+    if (num_bounds > METRICS_HIST_BOUNDS)
+        num_bounds = METRICS_HIST_BOUNDS;
+    memcpy(hist->bounds, bounds, num_bounds * sizeof(*bounds));
+    hist->num_bounds = num_bounds;
+}
+
+void metrics_hist_add(metrics_hist_t *hist, double value)
+{
+    unsigned i = 0;
+    while (i < hist->num_bounds && value > hist->bounds[i])
+        ++i;
+    hist->counts[i] += 1;
+    hist->sum += value;
+}
+
+uint64_t metrics_hist_count(metrics_hist_t const *hist)
+{
+    uint64_t count = 0;
+    for (unsigned i = 0; i <= hist->num_bounds; ++i)
+        count += hist->counts[i];
+    return count;
+}
@@ -4885,6 +4885,11 @@ void mg_ssl_if_conn_close_notify(struct mg_connection *nc) {
   SSL_shutdown(ctx->ssl);
 }
 
+void *mg_ssl_if_get_ssl(struct mg_connection *nc) {
+  struct mg_ssl_if_ctx *ctx = (struct mg_ssl_if_ctx *) nc->ssl_if_data;
+  return ctx != NULL ? ctx->ssl : NULL;
+}
+
 void mg_ssl_if_conn_free(struct mg_connection *nc) {
   struct mg_ssl_if_ctx *ctx = (struct mg_ssl_if_ctx *) nc->ssl_if_data;
   if (ctx == NULL) return;
@@ -5413,6 +5418,11 @@ void mg_ssl_if_conn_close_notify(struct mg_connection *nc) {
   mbedtls_ssl_close_notify(ctx->ssl);
 }
 
+void *mg_ssl_if_get_ssl(struct mg_connection *nc) {
+  struct mg_ssl_if_ctx *ctx = (struct mg_ssl_if_ctx *) nc->ssl_if_data;
+  return ctx != NULL ? ctx->ssl : NULL;
+}
+
 void mg_ssl_if_conn_free(struct mg_connection *nc) {
   struct mg_ssl_if_ctx *ctx = (struct mg_ssl_if_ctx *) nc->ssl_if_data;
   if (ctx == NULL) return;
@@ -15035,6 +15045,12 @@ void mg_ssl_if_conn_close_notify(struct mg_connection *nc) {
   (void) nc;
 }
 
+void *mg_ssl_if_get_ssl(struct mg_connection *nc) {
+  /* SimpleLink handles TLS. */
+  (void) nc;
+  return NULL;
+}
+
 void mg_ssl_if_conn_free(struct mg_connection *nc) {
   struct mg_ssl_if_ctx *ctx = (struct mg_ssl_if_ctx *) nc->ssl_if_data;
   if (ctx == NULL) return;
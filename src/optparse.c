@@ -195,7 +195,7 @@ uint32_t atouint32_metric(char const *str, char const *error_hint)
     return (uint32_t)val;
 }
 
-int atoi_time(char const *str, char const *error_hint)
+double atod_time(char const *str, char const *error_hint)
 {
     if (!str) {
         fprintf(stderr, "%smissing time argument\n", error_hint);
@@ -258,6 +258,11 @@ int atoi_time(char const *str, char const *error_hint)
             break;
         case 'm':
         case 'M':
+            if (endptr[1] == 's' || endptr[1] == 'S') {
+                val += num / 1000;
+                endptr += 2;
+                break;
+            }
             val += num * 60;
             ++endptr;
             break;
@@ -283,6 +288,13 @@ int atoi_time(char const *str, char const *error_hint)
 
     } while (*endptr);
 
+    return val;
+}
+
+int atoi_time(char const *str, char const *error_hint)
+{
+    double val = atod_time(str, error_hint);
+
     if (val > INT_MAX || val < INT_MIN) {
         fprintf(stderr, "%stime argument too big (%f)\n", error_hint, val);
         exit(1);
@@ -466,6 +478,14 @@ int main(void)
     ASSERT_EQUALS(atoi_time(" 2 : 3 ", ""), 2 * 60 * 60 + 3 * 60);
     ASSERT_EQUALS(atoi_time(" 2 : 3 : 4 ", ""), 2 * 60 * 60 + 3 * 60 + 4);
 
+    fprintf(stderr, "optparse:: atod_time\n");
+    ASSERT_EQUALS(atod_time("1.5", "") == 1.5, 1);
+    ASSERT_EQUALS(atod_time("250ms", "") == 0.25, 1);
+    ASSERT_EQUALS(atod_time("250 MS", "") == 0.25, 1);
+    ASSERT_EQUALS(atod_time("1s500ms", "") == 1.5, 1);
+    ASSERT_EQUALS(atod_time("2m3s", "") == 123.0, 1);
+    ASSERT_EQUALS(atod_time("1:2", "") == 3720.0, 1);
+
     fprintf(stderr, "optparse:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
 
     return failed;
@@ -0,0 +1,452 @@
+/** @file
+    Aggregating output wrapper, prints one record per sensor and window.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_aggregate.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct agg_field {
+    char key[AGGREGATE_KEY_LEN];
+    double min;
+    double max;
+    double sum;
+    unsigned count;
+} agg_field_t;
+
+typedef struct agg_sensor {
+    uint32_t hash;     ///< sensor key, 0 for a free slot
+    double end;        ///< end of the current window in s
+    data_t *last;      ///< the last event, retained
+    unsigned events;   ///< events in the current window
+    unsigned fields_len;
+    agg_field_t fields[AGGREGATE_FIELDS];
+} agg_sensor_t;
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    double window;
+    unsigned held;         ///< sensors in the table
+    unsigned records;      ///< aggregated records printed
+    unsigned passed;       ///< events printed unchanged as the table was full
+    char **fields;         ///< CSV fields with the aggregated fields added, the strings are owned
+    int fields_len;
+    agg_sensor_t sensors[AGGREGATE_SENSORS];
+} data_output_aggregate_t;
+
+static int is_sensor_key(data_t const *d)
+{
+    return d->key_id == DATA_KEY_MODEL || d->key_id == DATA_KEY_ID || d->key_id == DATA_KEY_CHANNEL;
+}
+
+/// The slot of a sensor, or the free slot to add it to, -1 if the table is full.
+static int find_slot(data_output_aggregate_t *agg, uint32_t hash)
+{
+    unsigned mask = AGGREGATE_SENSORS - 1;
+    for (unsigned i = 0, slot = hash & mask; i < AGGREGATE_SENSORS; ++i, slot = (slot + 1) & mask) {
+        if (agg->sensors[slot].hash == hash || !agg->sensors[slot].hash)
+            return (int)slot;
+    }
+    return -1;
+}
+
+/// Free a slot, the following sensors of the probe sequence move up.
+static void remove_slot(data_output_aggregate_t *agg, unsigned slot)
+{
+    unsigned mask = AGGREGATE_SENSORS - 1;
+    agg->sensors[slot].hash = 0;
+    agg->held--;
+    for (unsigned next = (slot + 1) & mask; agg->sensors[next].hash; next = (next + 1) & mask) {
+        unsigned home = agg->sensors[next].hash & mask;
+        // the sensor stays if its home is cyclically in (slot, next]
+        if (slot <= next ? slot < home && home <= next : slot < home || home <= next)
+            continue;
+        agg->sensors[slot]      = agg->sensors[next];
+        agg->sensors[next].hash = 0;
+        agg->sensors[next].last = NULL;
+        slot                    = next;
+    }
+}
+
+static agg_field_t *find_field(agg_sensor_t *sensor, char const *key)
+{
+    for (unsigned i = 0; i < sensor->fields_len; ++i) {
+        if (!strcmp(sensor->fields[i].key, key))
+            return &sensor->fields[i];
+    }
+    if (sensor->fields_len >= AGGREGATE_FIELDS || strlen(key) >= AGGREGATE_KEY_LEN)
+        return NULL; // only the last value
+    agg_field_t *field = &sensor->fields[sensor->fields_len++];
+    strcpy(field->key, key);
+    field->count = 0;
+    return field;
+}
+
+static void add_values(agg_sensor_t *sensor, data_t const *data)
+{
+    for (data_t const *d = data; d; d = d->next) {
+        if ((d->type != DATA_INT && d->type != DATA_DOUBLE) || is_sensor_key(d))
+            continue;
+        agg_field_t *field = find_field(sensor, d->key);
+        if (!field)
+            continue;
+        double val = d->type == DATA_INT ? d->value.v_int : d->value.v_dbl;
+        if (!field->count || val < field->min)
+            field->min = val;
+        if (!field->count || val > field->max)
+            field->max = val;
+        field->sum = field->count ? field->sum + val : val;
+        field->count++;
+    }
+}
+
+/// Append the min, max, and mean of a field with the keys of the field and a suffix.
+static data_t *append_stats(data_t *rec, data_t const *d, agg_field_t const *field)
+{
+    char key[AGGREGATE_KEY_LEN + 8];
+    char pretty[64];
+    char const *pretty_key = d->pretty_key ? d->pretty_key : "";
+    static char const *const suffix[] = {"min", "max", "mean"};
+    double const vals[] = {field->min, field->max, field->sum / field->count};
+    for (int i = 0; i < 3; ++i) {
+        snprintf(key, sizeof(key), "%s_%s", d->key, suffix[i]);
+        if (*pretty_key)
+            snprintf(pretty, sizeof(pretty), "%s %s", pretty_key, suffix[i]);
+        else
+            pretty[0] = '\0';
+        // an integer mean is fractional, the integer format doesn't apply
+        if (d->type == DATA_INT && i < 2)
+            rec = data_int(rec, key, pretty, d->format, (int)vals[i]);
+        else
+            rec = data_dbl(rec, key, pretty, d->type == DATA_DOUBLE ? d->format : NULL, vals[i]);
+    }
+    return rec;
+}
+
+/// Print the record of a sensor and free its slot.
+static void emit_sensor(data_output_aggregate_t *agg, unsigned slot)
+{
+    agg_sensor_t *sensor = &agg->sensors[slot];
+    data_t *rec = NULL;
+    for (data_t const *d = sensor->last; d; d = d->next) {
+        if (d->type == DATA_STRING) {
+            rec = data_str(rec, d->key, d->pretty_key, d->format, d->value.v_ptr);
+        }
+        else if (d->type == DATA_INT) {
+            rec = data_int(rec, d->key, d->pretty_key, d->format, d->value.v_int);
+        }
+        else if (d->type == DATA_DOUBLE) {
+            rec = data_dbl(rec, d->key, d->pretty_key, d->format, d->value.v_dbl);
+        }
+        else {
+            continue; // nested values are not aggregated, the arrays of a window don't combine
+        }
+        agg_field_t *field = is_sensor_key(d) || d->type == DATA_STRING ? NULL : find_field(sensor, d->key);
+        if (field && field->count)
+            rec = append_stats(rec, d, field);
+    }
+    rec = data_int(rec, "window", "Window", "%d s", (int)agg->window);
+    rec = data_int(rec, "events", "Events", NULL, (int)sensor->events);
+
+    data_free(sensor->last);
+    sensor->last = NULL;
+    remove_slot(agg, slot);
+    if (rec) {
+        data_output_print(agg->inner, rec);
+        data_free(rec);
+        agg->records++;
+    }
+}
+
+static void R_API_CALLCONV aggregate_print(data_output_t *output, data_t *data);
+
+void data_output_aggregate_add(data_output_t *output, data_t *data, double now)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    // the unchanged records can use the shared renderings
+    uint32_t hash = data_sensor_key(data);
+    if (!hash) {
+        data_output_print_shared(agg->inner, data, output->render); // logs and reports
+        return;
+    }
+    int slot = find_slot(agg, hash);
+    if (slot >= 0 && agg->sensors[slot].hash && now >= agg->sensors[slot].end) {
+        emit_sensor(agg, (unsigned)slot);
+        slot = find_slot(agg, hash);
+    }
+    if (slot < 0) {
+        agg->passed++;
+        data_output_print_shared(agg->inner, data, output->render);
+        return;
+    }
+    agg_sensor_t *sensor = &agg->sensors[slot];
+    if (!sensor->hash) {
+        sensor->hash       = hash;
+        sensor->end        = (floor(now / agg->window) + 1.0) * agg->window;
+        sensor->events     = 0;
+        sensor->fields_len = 0;
+        agg->held++;
+    }
+    sensor->events++;
+    add_values(sensor, data);
+    data_free(sensor->last);
+    sensor->last = data_retain(data);
+}
+
+unsigned data_output_aggregate_expire(data_output_t *output, double now)
+{
+    if (!output || output->output_print != aggregate_print)
+        return 0;
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    unsigned n = 0;
+    for (unsigned slot = 0; slot < AGGREGATE_SENSORS && agg->held;) {
+        agg_sensor_t *sensor = &agg->sensors[slot];
+        if (sensor->hash && (now < 0.0 || now >= sensor->end)) {
+            emit_sensor(agg, slot);
+            n++;
+            continue; // a following sensor may have moved up
+        }
+        slot++;
+    }
+    return n;
+}
+
+static void R_API_CALLCONV aggregate_print(data_output_t *output, data_t *data)
+{
+    struct timeval now;
+    get_time_now(&now);
+    data_output_aggregate_add(output, data, now.tv_sec + now.tv_usec * 1e-6);
+}
+
+static void R_API_CALLCONV aggregate_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    // the CSV columns of the aggregated fields, the key fields and strings get unused columns
+    agg->fields = calloc((size_t)num_fields * 4 + 2, sizeof(*agg->fields));
+    if (!agg->fields) {
+        WARN_CALLOC("aggregate_start()");
+        data_output_start(agg->inner, fields, num_fields);
+        return;
+    }
+    static char const *const suffix[] = {"", "_min", "_max", "_mean"};
+    static char const *const extra[] = {"window", "events"};
+    for (int i = 0; i < num_fields + 2; ++i) {
+        char const *name = i < num_fields ? fields[i] : extra[i - num_fields];
+        int is_key = i >= num_fields || !strcmp(name, "model") || !strcmp(name, "id") || !strcmp(name, "channel")
+                || !strcmp(name, "time");
+        for (int j = 0; j < (is_key ? 1 : 4); ++j) {
+            size_t len = strlen(name) + strlen(suffix[j]) + 1;
+            char *field = malloc(len);
+            if (!field) {
+                WARN_MALLOC("aggregate_start()");
+                continue;
+            }
+            snprintf(field, len, "%s%s", name, suffix[j]);
+            agg->fields[agg->fields_len++] = field;
+        }
+    }
+    data_output_start(agg->inner, (char const *const *)agg->fields, agg->fields_len);
+}
+
+static data_t *R_API_CALLCONV aggregate_stats(data_output_t *output)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    data_t *data = data_make(
+            "aggregate_sensors", "", DATA_INT, (int)agg->held,
+            "aggregate_records", "", DATA_INT, (int)agg->records,
+            "aggregate_passed",  "", DATA_INT, (int)agg->passed,
+            NULL);
+
+    if (data && agg->inner->output_stats) {
+        data_t *tail = data;
+        while (tail->next)
+            tail = tail->next;
+        tail->next = agg->inner->output_stats(agg->inner);
+    }
+    return data;
+}
+
+static void R_API_CALLCONV aggregate_free(data_output_t *output)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    if (!agg)
+        return;
+
+    // the windows in progress are worth a record
+    data_output_aggregate_expire(output, -1.0);
+    data_output_free(agg->inner);
+    for (int i = 0; i < agg->fields_len; ++i)
+        free(agg->fields[i]);
+    free(agg->fields);
+    free(agg);
+}
+
+struct data_output *data_output_aggregate_create(struct data_output *inner, unsigned window_s)
+{
+    if (!inner || !window_s)
+        return inner;
+
+    data_output_aggregate_t *agg = calloc(1, sizeof(*agg));
+    if (!agg) {
+        WARN_CALLOC("data_output_aggregate_create()");
+        return inner; // NOTE: prints the events unchanged on alloc failure.
+    }
+    agg->inner  = inner;
+    agg->window = window_s;
+
+    agg->output.log_level    = inner->log_level;
+    agg->output.output_start = aggregate_start;
+    agg->output.output_print = aggregate_print;
+    agg->output.output_stats = aggregate_stats;
+    agg->output.output_free  = aggregate_free;
+
+    return &agg->output;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Keeps the values of the last printed record.
+typedef struct {
+    data_output_t output;
+    unsigned count;
+    int id;
+    int events;
+    double temp;
+    double temp_min;
+    double temp_max;
+    double temp_mean;
+} capture_output_t;
+
+static void R_API_CALLCONV capture_print(data_output_t *output, data_t *data)
+{
+    capture_output_t *capture = (capture_output_t *)output;
+    capture->count++;
+    capture->events = -1;
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "id"))
+            capture->id = d->value.v_int;
+        else if (!strcmp(d->key, "events"))
+            capture->events = d->value.v_int;
+        else if (!strcmp(d->key, "temperature_C"))
+            capture->temp = d->value.v_dbl;
+        else if (!strcmp(d->key, "temperature_C_min"))
+            capture->temp_min = d->value.v_dbl;
+        else if (!strcmp(d->key, "temperature_C_max"))
+            capture->temp_max = d->value.v_dbl;
+        else if (!strcmp(d->key, "temperature_C_mean"))
+            capture->temp_mean = d->value.v_dbl;
+    }
+}
+
+static void R_API_CALLCONV capture_free(data_output_t *output)
+{
+    (void)output;
+}
+
+static data_t *test_event(int id, double temp)
+{
+    return data_make(
+            "model",         "", DATA_STRING, "Test-Sensor",
+            "id",            "", DATA_INT,    id,
+            "temperature_C", "", DATA_DOUBLE, temp,
+            NULL);
+}
+
+static void add(data_output_t *output, data_t *data, double now)
+{
+    data_output_aggregate_add(output, data, now);
+    data_free(data);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    capture_output_t capture = {.output = {.output_print = capture_print, .output_free = capture_free}};
+
+    data_output_t *output = data_output_aggregate_create(&capture.output, 60);
+    ASSERT_EQUALS(output != &capture.output, 1);
+
+    fprintf(stderr, "output_aggregate:: one record per window\n");
+    add(output, test_event(1, 20.0), 600.0);
+    add(output, test_event(1, 22.0), 610.0);
+    add(output, test_event(1, 21.0), 620.0);
+    add(output, test_event(2, 5.0), 630.0);
+    ASSERT_EQUALS(capture.count, 0);
+    ASSERT_EQUALS(data_output_aggregate_expire(output, 659.0), 0);
+    ASSERT_EQUALS(data_output_aggregate_expire(output, 660.0), 2);
+    ASSERT_EQUALS(capture.count, 2);
+
+    fprintf(stderr, "output_aggregate:: min, max, mean, last\n");
+    add(output, test_event(3, 10.0), 700.0);
+    add(output, test_event(3, 14.0), 710.0);
+    add(output, test_event(3, 12.5), 715.0);
+    add(output, test_event(3, 30.0), 720.0); // the next window, prints the first
+    ASSERT_EQUALS(capture.count, 3);
+    ASSERT_EQUALS(capture.id, 3);
+    ASSERT_EQUALS(capture.events, 3);
+    ASSERT_EQUALS((int)(capture.temp * 10), 125);
+    ASSERT_EQUALS((int)(capture.temp_min * 10), 100);
+    ASSERT_EQUALS((int)(capture.temp_max * 10), 140);
+    ASSERT_EQUALS((int)(capture.temp_mean * 10), 121);
+    ASSERT_EQUALS(data_output_aggregate_expire(output, -1.0), 1);
+    ASSERT_EQUALS(capture.events, 1);
+
+    fprintf(stderr, "output_aggregate:: records without a model pass\n");
+    data_t *report = data_int(NULL, "enabled", "", NULL, 1);
+    add(output, report, 800.0);
+    ASSERT_EQUALS(capture.count, 5);
+    ASSERT_EQUALS(capture.events, -1);
+
+    fprintf(stderr, "output_aggregate:: a full table passes the events\n");
+    for (int i = 0; i < AGGREGATE_SENSORS + 10; ++i)
+        add(output, test_event(100 + i, 1.0), 900.0);
+    ASSERT_EQUALS(capture.count, 15);
+    ASSERT_EQUALS(data_output_aggregate_expire(output, 900.5), 0);
+
+    fprintf(stderr, "output_aggregate:: sensors are found after removals\n");
+    // each event of the next window prints and removes its sensor, and adds it again
+    for (int i = 0; i < AGGREGATE_SENSORS; i += 2)
+        add(output, test_event(100 + i, 3.0), 965.0);
+    ASSERT_EQUALS(capture.count, 15 + AGGREGATE_SENSORS / 2);
+    // a lost sensor would be added as a new one without printing
+    for (int i = 1; i < AGGREGATE_SENSORS; i += 2)
+        add(output, test_event(100 + i, 3.0), 966.0);
+    ASSERT_EQUALS(capture.count, 15 + AGGREGATE_SENSORS);
+    ASSERT_EQUALS(data_output_aggregate_expire(output, -1.0), AGGREGATE_SENSORS);
+    ASSERT_EQUALS(capture.events, 1);
+
+    data_output_free(output);
+    fprintf(stderr, "output_aggregate:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
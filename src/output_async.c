@@ -0,0 +1,193 @@
+/** @file
+    Asynchronous output wrapper, prints to a slow output from a worker thread.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_async.h"
+#include "ring_queue.h"
+#include "cpu_stats.h"
+#include "trace.h"
+#include "r_util.h"
+#include "logger.h"
+#include "fatal.h"
+#include "thread_sched.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+// The event loop retains each record and queues a reference, the worker
+// prints it to the wrapped output and releases it. The shared renderings
+// are only valid during the event loop call, the wrapped output renders
+// on its own.
+
+#ifdef THREADS
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    ring_queue_t *queue; ///< queue of retained records
+    pthread_t thread;
+} data_output_async_t;
+
+static THREAD_RETURN THREAD_CALL data_output_async_loop(void *arg)
+{
+    data_output_async_t *async = arg;
+    trace_thread_name("output_async");
+
+    for (;;) {
+        data_t *data;
+        // returns -1 only once the queue is closed and drained
+        if (ring_queue_pop(async->queue, &data, 1))
+            break;
+        uint64_t trace_start = trace_begin();
+        uint64_t start = cpu_stats_start();
+        data_output_print(async->inner, data);
+        cpu_stats_end(&async->inner->cpu_stat, start);
+        trace_end(TRACE_OUTPUT, "output delivered", 0, trace_start);
+        data_free(data);
+    }
+
+    return (THREAD_RETURN)0;
+}
+
+static void R_API_CALLCONV data_output_async_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_async_t *async = (data_output_async_t *)output;
+
+    // called before any records are queued, the worker prints the projection
+    if (output->projection && !async->inner->projection) {
+        async->inner->projection = output->projection;
+        output->projection       = NULL;
+    }
+    data_output_start(async->inner, fields, num_fields);
+}
+
+static void R_API_CALLCONV data_output_async_print(data_output_t *output, data_t *data)
+{
+    data_output_async_t *async = (data_output_async_t *)output;
+
+    data_retain(data);
+    if (ring_queue_push(async->queue, &data) < 0)
+        data_free(data); // dropped, counted by the queue
+}
+
+static data_t *R_API_CALLCONV data_output_async_stats(data_output_t *output)
+{
+    data_output_async_t *async = (data_output_async_t *)output;
+
+    ring_queue_stats_t stats;
+    ring_queue_get_stats(async->queue, &stats);
+
+    data_t *data = data_make(
+            "async_ns",         "", DATA_DOUBLE, (double)async->inner->cpu_stat.ns,
+            "async_calls",      "", DATA_INT, async->inner->cpu_stat.calls,
+            "queue",            "", DATA_INT, stats.len,
+            "queue_max",        "", DATA_INT, stats.len_max,
+            "queue_size",       "", DATA_INT, stats.size,
+            "dropped",          "", DATA_INT, stats.dropped,
+            NULL);
+
+    if (data && async->inner->output_stats) {
+        data_t *tail = data;
+        while (tail->next)
+            tail = tail->next;
+        tail->next = async->inner->output_stats(async->inner);
+    }
+    return data;
+}
+
+static void R_API_CALLCONV data_output_async_free(data_output_t *output)
+{
+    data_output_async_t *async = (data_output_async_t *)output;
+
+    if (!async)
+        return;
+
+    // the worker drains the queue before it exits
+    ring_queue_close(async->queue);
+    int r = pthread_join(async->thread, NULL);
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+    }
+    ring_queue_free(async->queue);
+    data_output_free(async->inner);
+    free(async);
+}
+
+struct data_output *data_output_async_create(struct data_output *inner, unsigned queue_size)
+{
+    if (!inner)
+        return NULL;
+
+    data_output_async_t *async = calloc(1, sizeof(*async));
+    if (!async) {
+        WARN_CALLOC("data_output_async_create()");
+        return inner; // NOTE: prints synchronously on alloc failure.
+    }
+    async->queue = ring_queue_create(queue_size, sizeof(data_t *));
+    if (!async->queue) {
+        free(async);
+        return inner; // NOTE: prints synchronously on alloc failure.
+    }
+    async->inner = inner;
+
+    async->output.log_level    = inner->log_level;
+    async->output.output_start = data_output_async_start;
+    async->output.output_print = data_output_async_print;
+    async->output.output_stats = data_output_async_stats;
+    async->output.output_free  = data_output_async_free;
+
+#ifndef _WIN32
+    // Block all signals from the worker thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&async->thread, NULL, data_output_async_loop, async);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        ring_queue_free(async->queue);
+        free(async);
+        return inner;
+    }
+
+    return (struct data_output *)async;
+}
+
+void data_output_async_set_sched(struct data_output *output, thread_sched_t const *sched)
+{
+    if (!output || output->output_free != data_output_async_free)
+        return;
+
+    data_output_async_t *async = (data_output_async_t *)output;
+    thread_sched_apply(async->thread, sched, "output");
+}
+
+#else
+
+struct data_output *data_output_async_create(struct data_output *inner, unsigned queue_size)
+{
+    UNUSED(queue_size);
+    print_log(LOG_WARNING, "Output", "async output not available in this build, printing synchronously.");
+    return inner;
+}
+
+void data_output_async_set_sched(struct data_output *output, thread_sched_t const *sched)
+{
+    UNUSED(output);
+    UNUSED(sched);
+}
+
+#endif
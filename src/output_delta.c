@@ -0,0 +1,340 @@
+/** @file
+    Change-only output wrapper, prints the events of a sensor that changed.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_delta.h"
+#include "r_util.h"
+#include "bit_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct delta_field {
+    char key[DELTA_KEY_LEN];
+    double val;
+} delta_field_t;
+
+typedef struct delta_sensor {
+    uint32_t hash;      ///< sensor key, 0 for a free slot
+    uint32_t strings;   ///< hash of the printed string fields
+    double printed;     ///< time the last event was printed
+    double seen;        ///< time the last event was heard
+    unsigned fields_len;
+    delta_field_t fields[DELTA_FIELDS]; ///< the printed numeric fields in event order
+} delta_sensor_t;
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    double deadband;
+    double heartbeat;
+    double forget;
+    unsigned held;       ///< sensors in the table
+    unsigned sweep;      ///< next slot to check for a silent sensor
+    unsigned printed;
+    unsigned suppressed;
+    delta_sensor_t sensors[DELTA_SENSORS];
+} data_output_delta_t;
+
+/// The sensor key and the reception meta data are not compared.
+static int is_compared(data_t const *d)
+{
+    switch (d->key_id) {
+    case DATA_KEY_MODEL:
+    case DATA_KEY_ID:
+    case DATA_KEY_CHANNEL:
+    case DATA_KEY_TIME:
+    case DATA_KEY_RSSI:
+    case DATA_KEY_SNR:
+    case DATA_KEY_NOISE:
+    case DATA_KEY_FREQ:
+    case DATA_KEY_FREQ1:
+    case DATA_KEY_FREQ2:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+static int find_slot(data_output_delta_t *delta, uint32_t hash)
+{
+    unsigned mask = DELTA_SENSORS - 1;
+    for (unsigned i = 0, slot = hash & mask; i < DELTA_SENSORS; ++i, slot = (slot + 1) & mask) {
+        if (delta->sensors[slot].hash == hash || !delta->sensors[slot].hash)
+            return (int)slot;
+    }
+    return -1;
+}
+
+/// Free a slot, the following sensors of the probe sequence move up.
+static void remove_slot(data_output_delta_t *delta, unsigned slot)
+{
+    unsigned mask = DELTA_SENSORS - 1;
+    delta->sensors[slot].hash = 0;
+    delta->held--;
+    for (unsigned next = (slot + 1) & mask; delta->sensors[next].hash; next = (next + 1) & mask) {
+        unsigned home = delta->sensors[next].hash & mask;
+        // the sensor stays if its home is cyclically in (slot, next]
+        if (slot <= next ? slot < home && home <= next : slot < home || home <= next)
+            continue;
+        delta->sensors[slot]      = delta->sensors[next];
+        delta->sensors[next].hash = 0;
+        slot                      = next;
+    }
+}
+
+/// Check if an event differs from the printed one, -1 if it can't be compared.
+static int has_changed(data_output_delta_t const *delta, delta_sensor_t const *sensor, data_t const *data, uint32_t *strings)
+{
+    int changed = 0;
+    unsigned n  = 0;
+    *strings    = FNV1A_INIT;
+    for (data_t const *d = data; d; d = d->next) {
+        if (!is_compared(d))
+            continue;
+        if (d->type == DATA_STRING) {
+            *strings = fnv1a(*strings, d->key, strlen(d->key) + 1);
+            *strings = fnv1a(*strings, d->value.v_ptr, strlen(d->value.v_ptr) + 1);
+            continue;
+        }
+        if (d->type != DATA_INT && d->type != DATA_DOUBLE)
+            return -1; // nested values
+        if (n >= DELTA_FIELDS || strlen(d->key) >= DELTA_KEY_LEN)
+            return -1;
+        double val = d->type == DATA_INT ? d->value.v_int : d->value.v_dbl;
+        // the fields keep their order, a key mismatch is a new field
+        if (n >= sensor->fields_len || strcmp(sensor->fields[n].key, d->key))
+            changed = 1;
+        else if (val - sensor->fields[n].val > delta->deadband || sensor->fields[n].val - val > delta->deadband)
+            changed = 1;
+        n++;
+    }
+    return changed || n != sensor->fields_len || *strings != sensor->strings;
+}
+
+/// Keep the printed values of an event.
+static void keep_values(delta_sensor_t *sensor, data_t const *data, uint32_t strings)
+{
+    sensor->strings    = strings;
+    sensor->fields_len = 0;
+    for (data_t const *d = data; d; d = d->next) {
+        if (!is_compared(d) || (d->type != DATA_INT && d->type != DATA_DOUBLE))
+            continue;
+        delta_field_t *field = &sensor->fields[sensor->fields_len++];
+        strcpy(field->key, d->key); // checked by has_changed()
+        field->val = d->type == DATA_INT ? d->value.v_int : d->value.v_dbl;
+    }
+}
+
+int data_output_delta_add(data_output_t *output, data_t *data, double now)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    // one step of the sweep for silent sensors on each event
+    delta_sensor_t *old = &delta->sensors[delta->sweep];
+    if (old->hash && now - old->seen > delta->forget)
+        remove_slot(delta, delta->sweep);
+    delta->sweep = (delta->sweep + 1) & (DELTA_SENSORS - 1);
+
+    uint32_t hash = data_sensor_key(data);
+    int slot      = hash ? find_slot(delta, hash) : -1;
+    if (slot < 0) {
+        // logs, reports, and the sensors that don't fit, the unchanged records can use the shared renderings
+        data_output_print_shared(delta->inner, data, output->render);
+        return 1;
+    }
+
+    delta_sensor_t *sensor = &delta->sensors[slot];
+    uint32_t strings;
+    int changed = has_changed(delta, sensor, data, &strings);
+    if (sensor->hash && changed == 0 && (!delta->heartbeat || now - sensor->printed < delta->heartbeat)) {
+        sensor->seen = now;
+        delta->suppressed++;
+        return 0;
+    }
+
+    if (changed < 0) {
+        // can't be compared, forget the sensor
+        if (sensor->hash)
+            remove_slot(delta, (unsigned)slot);
+    }
+    else {
+        if (!sensor->hash) {
+            sensor->hash = hash;
+            delta->held++;
+        }
+        sensor->printed = now;
+        sensor->seen    = now;
+        keep_values(sensor, data, strings);
+    }
+    delta->printed++;
+    data_output_print_shared(delta->inner, data, output->render);
+    return 1;
+}
+
+static void R_API_CALLCONV delta_print(data_output_t *output, data_t *data)
+{
+    struct timeval now;
+    get_time_now(&now);
+    data_output_delta_add(output, data, now.tv_sec + now.tv_usec * 1e-6);
+}
+
+static void R_API_CALLCONV delta_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    data_output_start(delta->inner, fields, num_fields);
+}
+
+static data_t *R_API_CALLCONV delta_stats(data_output_t *output)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    data_t *data = data_make(
+            "delta_sensors",    "", DATA_INT, (int)delta->held,
+            "delta_printed",    "", DATA_INT, (int)delta->printed,
+            "delta_suppressed", "", DATA_INT, (int)delta->suppressed,
+            NULL);
+
+    if (data && delta->inner->output_stats) {
+        data_t *tail = data;
+        while (tail->next)
+            tail = tail->next;
+        tail->next = delta->inner->output_stats(delta->inner);
+    }
+    return data;
+}
+
+static void R_API_CALLCONV delta_free(data_output_t *output)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    if (!delta)
+        return;
+
+    data_output_free(delta->inner);
+    free(delta);
+}
+
+struct data_output *data_output_delta_create(struct data_output *inner, double deadband, unsigned heartbeat_s)
+{
+    if (!inner)
+        return NULL;
+
+    data_output_delta_t *delta = calloc(1, sizeof(*delta));
+    if (!delta) {
+        WARN_CALLOC("data_output_delta_create()");
+        return inner; // NOTE: prints all events on alloc failure.
+    }
+    delta->inner     = inner;
+    delta->deadband  = deadband < 0.0 ? 0.0 : deadband;
+    delta->heartbeat = heartbeat_s;
+    delta->forget    = heartbeat_s > DELTA_FORGET_S ? heartbeat_s : DELTA_FORGET_S;
+
+    delta->output.log_level    = inner->log_level;
+    delta->output.output_start = delta_start;
+    delta->output.output_print = delta_print;
+    delta->output.output_stats = delta_stats;
+    delta->output.output_free  = delta_free;
+
+    return &delta->output;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+static void R_API_CALLCONV count_print(data_output_t *output, data_t *data)
+{
+    (void)output;
+    (void)data;
+}
+
+static void R_API_CALLCONV count_free(data_output_t *output)
+{
+    (void)output;
+}
+
+static data_t *test_event(int id, double temp, char const *state, double rssi)
+{
+    return data_make(
+            "model",         "", DATA_STRING, "Test-Sensor",
+            "id",            "", DATA_INT,    id,
+            "temperature_C", "", DATA_DOUBLE, temp,
+            "state",         "", DATA_STRING, state,
+            "rssi",          "", DATA_DOUBLE, rssi,
+            NULL);
+}
+
+static int add(data_output_t *output, data_t *data, double now)
+{
+    int r = data_output_delta_add(output, data, now);
+    data_free(data);
+    return r;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    data_output_t inner = {.output_print = count_print, .output_free = count_free};
+
+    data_output_t *output = data_output_delta_create(&inner, 0.25, 600);
+    ASSERT_EQUALS(output != &inner, 1);
+
+    fprintf(stderr, "output_delta:: drop unchanged readings\n");
+    ASSERT_EQUALS(add(output, test_event(1, 20.0, "on", -10.0), 0.0), 1);
+    ASSERT_EQUALS(add(output, test_event(1, 20.0, "on", -12.0), 30.0), 0); // only the RSSI differs
+    ASSERT_EQUALS(add(output, test_event(1, 20.2, "on", -12.0), 60.0), 0); // within the deadband
+    ASSERT_EQUALS(add(output, test_event(2, 20.0, "on", -10.0), 60.0), 1); // another sensor
+
+    fprintf(stderr, "output_delta:: print the changes\n");
+    ASSERT_EQUALS(add(output, test_event(1, 20.3, "on", -10.0), 90.0), 1); // from the printed value
+    ASSERT_EQUALS(add(output, test_event(1, 20.3, "off", -10.0), 120.0), 1);
+    data_t *fewer = data_make("model", "", DATA_STRING, "Test-Sensor", "id", "", DATA_INT, 1, "state", "", DATA_STRING, "off", NULL);
+    ASSERT_EQUALS(add(output, fewer, 150.0), 1);
+
+    fprintf(stderr, "output_delta:: heartbeat\n");
+    ASSERT_EQUALS(add(output, test_event(2, 20.0, "on", -10.0), 659.0), 0);
+    ASSERT_EQUALS(add(output, test_event(2, 20.0, "on", -10.0), 660.0), 1);
+    ASSERT_EQUALS(add(output, test_event(2, 20.0, "on", -10.0), 700.0), 0);
+
+    fprintf(stderr, "output_delta:: records without a model always print\n");
+    ASSERT_EQUALS(add(output, data_int(NULL, "enabled", "", NULL, 1), 700.0), 1);
+    ASSERT_EQUALS(add(output, data_int(NULL, "enabled", "", NULL, 1), 701.0), 1);
+
+    fprintf(stderr, "output_delta:: silent sensors are forgotten\n");
+    for (int i = 0; i < DELTA_SENSORS; ++i)
+        add(output, test_event(100 + i, 1.0, "on", 0.0), 800.0);
+    // the table is full, sensor 1 and 2 are still held
+    ASSERT_EQUALS(add(output, test_event(1000, 1.0, "on", 0.0), 800.0), 1);
+    ASSERT_EQUALS(add(output, test_event(1000, 1.0, "on", 0.0), 800.0), 1);
+    // a sweep past the forget time frees the slots of the silent sensors
+    for (int i = 0; i < DELTA_SENSORS; ++i)
+        add(output, data_int(NULL, "enabled", "", NULL, 1), 5000.0);
+    ASSERT_EQUALS(add(output, test_event(1000, 1.0, "on", 0.0), 5000.0), 1);
+    ASSERT_EQUALS(add(output, test_event(1000, 1.0, "on", 0.0), 5001.0), 0);
+
+    data_output_free(output);
+    fprintf(stderr, "output_delta:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
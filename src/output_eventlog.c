@@ -0,0 +1,118 @@
+/** @file
+    Event log output for rtl_433 events, an append-only log of memory-mapped segments.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_eventlog.h"
+#include "event_log.h"
+
+#include "data.h"
+#include "optparse.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Event log printer, one compact JSON object per record */
+
+typedef struct {
+    struct data_output output;
+    event_log_t *log;
+    data_render_t render; ///< used if the output does not share the rendering
+    unsigned records;
+    unsigned dropped;     ///< records too long for a segment or not written
+} data_output_eventlog_t;
+
+static void R_API_CALLCONV data_output_eventlog_print(data_output_t *output, data_t *data)
+{
+    data_output_eventlog_t *evlog = (data_output_eventlog_t *)output;
+
+    size_t len;
+    char const *rec = data_render_jsons(output->render, data, &len);
+    int own         = !rec;
+    if (own) {
+        data_render_start(&evlog->render, data);
+        rec = data_render_jsons(&evlog->render, data, &len);
+    }
+    if (rec) {
+        if (event_log_append(evlog->log, rec, len))
+            evlog->records++;
+        else
+            evlog->dropped++;
+    }
+    if (own)
+        data_render_start(&evlog->render, NULL);
+}
+
+static data_t *R_API_CALLCONV data_output_eventlog_stats(data_output_t *output)
+{
+    data_output_eventlog_t *evlog = (data_output_eventlog_t *)output;
+
+    return data_make(
+            "records",          "", DATA_INT, evlog->records,
+            "dropped",          "", DATA_INT, evlog->dropped,
+            "segments",         "", DATA_INT, event_log_segments(evlog->log),
+            "last_seq",         "", DATA_DOUBLE, (double)event_log_last(evlog->log),
+            NULL);
+}
+
+static void R_API_CALLCONV data_output_eventlog_free(data_output_t *output)
+{
+    data_output_eventlog_t *evlog = (data_output_eventlog_t *)output;
+
+    if (!evlog)
+        return;
+
+    event_log_close(evlog->log);
+    data_render_free(&evlog->render);
+
+    free(evlog);
+}
+
+struct data_output *data_output_eventlog_create(int log_level, char const *dir, char *opts)
+{
+    size_t segment_size   = EVENT_LOG_SEGMENT_DEFAULT;
+    unsigned segments_max = EVENT_LOG_SEGMENTS_DEFAULT;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "segment"))
+            segment_size = atouint32_metric(val, "-F eventlog: segment=");
+        else if (!strcasecmp(key, "segments"))
+            segments_max = atouint32_metric(val, "-F eventlog: segments=");
+        else {
+            print_logf(LOG_FATAL, "Event log", "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+
+    data_output_eventlog_t *evlog = calloc(1, sizeof(data_output_eventlog_t));
+    if (!evlog) {
+        WARN_CALLOC("data_output_eventlog_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    evlog->log = event_log_open(dir, segment_size, segments_max);
+    if (!evlog->log) {
+        free(evlog);
+        return NULL;
+    }
+
+    evlog->output.log_level    = log_level;
+    evlog->output.output_print = data_output_eventlog_print;
+    evlog->output.output_stats = data_output_eventlog_stats;
+    evlog->output.output_free  = data_output_eventlog_free;
+
+    return (struct data_output *)evlog;
+}
@@ -12,6 +12,7 @@
 #include "output_file.h"
 
 #include "data.h"
+#include "file_sink.h"
 #include "term_ctl.h"
 #include "r_util.h"
 #include "logger.h"
@@ -21,6 +22,89 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdarg.h>
+
+/* Record buffer, a record is rendered then written with one call */
+
+typedef struct {
+    char *text;
+    size_t len;
+    size_t size;
+    int failed; ///< the record is incomplete on alloc failure
+} line_buf_t;
+
+/// Make room for @p len more bytes in the record, returns 0 on alloc failure.
+static int line_reserve(line_buf_t *line, size_t len)
+{
+    if (line->len + len < line->size)
+        return 1;
+    size_t size = line->size ? line->size : 1024;
+    while (size <= line->len + len)
+        size *= 2;
+    char *text = realloc(line->text, size);
+    if (!text) {
+        WARN_REALLOC("line_reserve()");
+        line->failed = 1;
+        return 0;
+    }
+    line->text = text;
+    line->size = size;
+    return 1;
+}
+
+static void line_putc(line_buf_t *line, char c)
+{
+    if (line_reserve(line, 1))
+        line->text[line->len++] = c;
+}
+
+static void line_puts(line_buf_t *line, char const *str)
+{
+    size_t len = strlen(str);
+    if (line_reserve(line, len)) {
+        memcpy(line->text + line->len, str, len);
+        line->len += len;
+    }
+}
+
+static int line_printf(line_buf_t *line, _Printf_format_string_ char const *restrict format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+/// Append formatted text, returns the length like printf().
+static int line_printf(line_buf_t *line, char const *restrict format, ...)
+{
+    char buf[64]; // the numbers fit, longer text is formatted again
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    if (len < 0 || !line_reserve(line, (size_t)len))
+        return 0;
+    if ((size_t)len < sizeof(buf)) {
+        memcpy(line->text + line->len, buf, (size_t)len);
+    }
+    else {
+        va_start(ap, format);
+        vsnprintf(line->text + line->len, (size_t)len + 1, format, ap);
+        va_end(ap);
+    }
+    line->len += (size_t)len;
+    return len;
+}
+
+/// Write and commit the record with one call and start a new one, returns 1 if the file was rotated.
+static int line_write(line_buf_t *line, FILE *file)
+{
+    int rotated = 0;
+    if (!line->failed && line->len)
+        rotated = file_sink_write(file, line->text, line->len);
+    line->len    = 0;
+    line->failed = 0;
+    return rotated;
+}
 
 /* JSON printer */
 
@@ -47,16 +131,19 @@ static void R_API_CALLCONV print_json_data(data_output_t *output, data_t *data,
     UNUSED(format);
     data_output_json_t *json = (data_output_json_t *)output;
 
+    data_skip_t const *skip = output->skip;
+    output->skip            = NULL; // the nested objects print all fields
     bool separator = false;
     fputc('{', json->file);
-    while (data) {
+    for (; data; data = data->next) {
+        if (data_skip(skip, data))
+            continue;
         if (separator)
             fprintf(json->file, ", ");
         output->print_string(output, data->key, NULL);
         fprintf(json->file, " : ");
         print_value(output, data->type, data->value, data->format);
         separator = true;
-        data = data->next;
     }
     fputc('}', json->file);
 }
@@ -118,7 +205,7 @@ static void R_API_CALLCONV data_output_json_print(data_output_t *output, data_t
     if (json && json->file) {
         json->output.print_data(output, data, NULL);
         fputc('\n', json->file);
-        fflush(json->file);
+        file_sink_commit(json->file);
     }
 }
 
@@ -153,39 +240,42 @@ struct data_output *data_output_json_create(int log_level, FILE *file)
 
 /* Pretty Key-Value printer */
 
-static int kv_color_for_key(char const *key)
+static int kv_color_for_key(data_t const *data)
 {
-    if (!key || !*key)
+    if (!*data->key)
         return TERM_COLOR_RESET;
-    if (!strcmp(key, "tag") || !strcmp(key, "time"))
+    switch (data->key_id) {
+    case DATA_KEY_TAG:
+    case DATA_KEY_TIME:
         return TERM_COLOR_BLUE;
-    if (!strcmp(key, "model") || !strcmp(key, "type") || !strcmp(key, "id"))
+    case DATA_KEY_MODEL:
+    case DATA_KEY_TYPE:
+    case DATA_KEY_ID:
         return TERM_COLOR_RED;
-    if (!strcmp(key, "mic"))
+    case DATA_KEY_MIC:
         return TERM_COLOR_CYAN;
-    if (!strcmp(key, "mod") || !strcmp(key, "freq") || !strcmp(key, "freq1") || !strcmp(key, "freq2"))
+    case DATA_KEY_MOD:
+    case DATA_KEY_FREQ:
+    case DATA_KEY_FREQ1:
+    case DATA_KEY_FREQ2:
         return TERM_COLOR_MAGENTA;
-    if (!strcmp(key, "rssi") || !strcmp(key, "snr") || !strcmp(key, "noise"))
+    case DATA_KEY_RSSI:
+    case DATA_KEY_SNR:
+    case DATA_KEY_NOISE:
         return TERM_COLOR_YELLOW;
-    return TERM_COLOR_GREEN;
+    default:
+        return TERM_COLOR_GREEN;
+    }
 }
 
-static int kv_break_before_key(char const *key)
+static int kv_break_before_key(unsigned key_id)
 {
-    if (!key || !*key)
-        return 0;
-    if (!strcmp(key, "model") || !strcmp(key, "mod") || !strcmp(key, "rssi") || !strcmp(key, "codes"))
-        return 1;
-    return 0;
+    return key_id == DATA_KEY_MODEL || key_id == DATA_KEY_MOD || key_id == DATA_KEY_RSSI || key_id == DATA_KEY_CODES;
 }
 
-static int kv_break_after_key(char const *key)
+static int kv_break_after_key(unsigned key_id)
 {
-    if (!key || !*key)
-        return 0;
-    if (!strcmp(key, "id") || !strcmp(key, "mic"))
-        return 1;
-    return 0;
+    return key_id == DATA_KEY_ID || key_id == DATA_KEY_MIC;
 }
 
 typedef struct {
@@ -197,8 +287,42 @@ typedef struct {
     int term_width;
     int data_recursion;
     int column;
+    line_buf_t line; ///< the current record
 } data_output_kv_t;
 
+/// Add a color to the record, a legacy Windows console is colored with a call after writing the text so far.
+static void kv_set_fg(data_output_kv_t *kv, term_color_t color)
+{
+    char buf[TERM_ESCAPE_MAX];
+    if (term_fg_escape(kv->term, color, buf, sizeof(buf)) >= 0) {
+        line_puts(&kv->line, buf);
+        return;
+    }
+    line_write(&kv->line, kv->file);
+    term_set_fg(kv->term, color);
+}
+
+/// Add a background color to the record, see kv_set_fg().
+static void kv_set_bg(data_output_kv_t *kv, term_color_t bg, term_color_t fg)
+{
+    char buf[TERM_ESCAPE_MAX];
+    if (term_bg_escape(kv->term, bg, fg, buf, sizeof(buf)) >= 0) {
+        line_puts(&kv->line, buf);
+        return;
+    }
+    line_write(&kv->line, kv->file);
+    term_set_bg(kv->term, bg, fg);
+}
+
+static void kv_ring_bell(data_output_kv_t *kv)
+{
+#ifdef _WIN32
+    term_ring_bell(kv->term); // a beep, nothing is written
+#else
+    line_putc(&kv->line, '\a');
+#endif
+}
+
 #define KV_SEP "_ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ "
 
 static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, char const *format)
@@ -209,6 +333,8 @@ static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, ch
     int color = kv->color;
     int ring_bell = kv->ring_bell;
     int is_log = 0;
+    data_skip_t const *skip = output->skip;
+    output->skip            = NULL; // the nested objects print all fields
 
     // top-level: update width and print separator
     if (!kv->data_recursion) {
@@ -217,11 +343,11 @@ static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, ch
         data_t *data_lvl  = NULL;
         data_t *data_msg  = NULL;
         for (data_t *d = data; d; d = d->next) {
-            if (!strcmp(d->key, "src"))
+            if (d->key_id == DATA_KEY_SRC)
                 data_src = d;
-            else if (!strcmp(d->key, "lvl"))
+            else if (d->key_id == DATA_KEY_LVL)
                 data_lvl = d;
-            else if (!strcmp(d->key, "msg"))
+            else if (d->key_id == DATA_KEY_MSG)
                 data_msg = d;
         }
         is_log = data_src && data_lvl && data_msg;
@@ -229,15 +355,15 @@ static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, ch
         kv->term_width = term_get_columns(kv->term); // update current term width
         if (!is_log) {
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_BLACK);
+            kv_set_fg(kv, TERM_COLOR_BLACK);
         if (ring_bell)
-            term_ring_bell(kv->term);
+            kv_ring_bell(kv);
         char sep[] = KV_SEP KV_SEP KV_SEP KV_SEP;
         if (kv->term_width < (int)sizeof(sep))
             sep[kv->term_width > 0 ? kv->term_width - 1 : 40] = '\0';
-        fprintf(kv->file, "%s\n", sep);
+        line_printf(&kv->line, "%s\n", sep);
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_RESET);
+            kv_set_fg(kv, TERM_COLOR_RESET);
         }
 
         // print special log format
@@ -273,17 +399,17 @@ static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, ch
                 src_bg = TERM_COLOR_BRIGHT_BLACK;
                 src_fg = TERM_COLOR_WHITE;
             }
-            term_set_bg(kv->term, src_bg, src_bg); // hides the brackets
-            fprintf(kv->file, "[");
-            term_set_bg(kv->term, 0, src_fg);
+            kv_set_bg(kv, src_bg, src_bg); // hides the brackets
+            line_printf(&kv->line, "[");
+            kv_set_bg(kv, 0, src_fg);
             print_value(output, data_src->type, data_src->value, data_src->format);
-            term_set_bg(kv->term, 0, src_bg); // hides the brackets
-            fprintf(kv->file, "]");
-            term_set_fg(kv->term, TERM_COLOR_RESET);
+            kv_set_bg(kv, 0, src_bg); // hides the brackets
+            line_printf(&kv->line, "]");
+            kv_set_fg(kv, TERM_COLOR_RESET);
             // fprintf(kv->file, " (");
             // print_value(output, data_lvl->type, data_lvl->value, data_lvl->format);
             // fprintf(kv->file, ") ");
-            fprintf(kv->file, " ");
+            line_printf(&kv->line, " ");
             print_value(output, data_msg->type, data_msg->value, data_msg->format);
             // force break on next key
             kv->column = kv->term_width;
@@ -292,46 +418,48 @@ static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, ch
     // nested data object: break before
     else {
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_RESET);
-        fprintf(kv->file, "\n");
+            kv_set_fg(kv, TERM_COLOR_RESET);
+        line_printf(&kv->line, "\n");
         kv->column = 0;
     }
 
     ++kv->data_recursion;
     for (; data; data = data->next) {
         // skip logging keys
-        if (is_log && (!strcmp(data->key, "time") || !strcmp(data->key, "src") || !strcmp(data->key, "lvl")
-                || !strcmp(data->key, "msg") || !strcmp(data->key, "num_rows"))) {
+        if (is_log && (data->key_id == DATA_KEY_TIME || data->key_id == DATA_KEY_SRC || data->key_id == DATA_KEY_LVL
+                || data->key_id == DATA_KEY_MSG || data->key_id == DATA_KEY_NUM_ROWS)) {
             continue;
         }
+        if (data_skip(skip, data))
+            continue;
 
         // break before some known keys
-        if (kv->column > 0 && kv_break_before_key(data->key)) {
-            fprintf(kv->file, "\n");
+        if (kv->column > 0 && kv_break_before_key(data->key_id)) {
+            line_printf(&kv->line, "\n");
             kv->column = 0;
         }
         // break if not enough width left
         else if (kv->column >= kv->term_width - 26) {
-            fprintf(kv->file, "\n");
+            line_printf(&kv->line, "\n");
             kv->column = 0;
         }
         // pad to next alignment if there is enough width left
         else if (kv->column > 0 && kv->column < kv->term_width - 26) {
-            kv->column += fprintf(kv->file, "%*s", 25 - kv->column % 26, " ");
+            kv->column += line_printf(&kv->line, "%*s", 25 - kv->column % 26, " ");
         }
 
         // print key
         char *key = *data->pretty_key ? data->pretty_key : data->key;
-        kv->column += fprintf(kv->file, "%-10s: ", key);
+        kv->column += line_printf(&kv->line, "%-10s: ", key);
         // print value
         if (color)
-            term_set_fg(kv->term, kv_color_for_key(data->key));
+            kv_set_fg(kv, kv_color_for_key(data));
         print_value(output, data->type, data->value, data->format);
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_RESET);
+            kv_set_fg(kv, TERM_COLOR_RESET);
 
         // force break after some known keys
-        if (kv->column > 0 && kv_break_after_key(data->key)) {
+        if (kv->column > 0 && kv_break_after_key(data->key_id)) {
             kv->column = kv->term_width; // force break;
         }
     }
@@ -351,7 +479,7 @@ static void R_API_CALLCONV print_kv_array(data_output_t *output, data_array_t *a
     //fprintf(kv->file, "[ ");
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            fprintf(kv->file, ", ");
+            line_printf(&kv->line, ", ");
         print_array_value(output, array, format, c);
     }
     //fprintf(kv->file, " ]");
@@ -361,21 +489,21 @@ static void R_API_CALLCONV print_kv_double(data_output_t *output, double data, c
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
-    kv->column += fprintf(kv->file, format ? format : "%.3f", data);
+    kv->column += line_printf(&kv->line, format ? format : "%.3f", data);
 }
 
 static void R_API_CALLCONV print_kv_int(data_output_t *output, int data, char const *format)
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
-    kv->column += fprintf(kv->file, format ? format : "%d", data);
+    kv->column += line_printf(&kv->line, format ? format : "%d", data);
 }
 
 static void R_API_CALLCONV print_kv_string(data_output_t *output, const char *data, char const *format)
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
-    kv->column += fprintf(kv->file, format ? format : "%s", data);
+    kv->column += line_printf(&kv->line, format ? format : "%s", data);
 }
 
 static void R_API_CALLCONV data_output_kv_print(data_output_t *output, data_t *data)
@@ -384,8 +512,8 @@ static void R_API_CALLCONV data_output_kv_print(data_output_t *output, data_t *d
 
     if (kv && kv->file) {
         kv->output.print_data(output, data, NULL);
-        fputc('\n', kv->file);
-        fflush(kv->file);
+        line_putc(&kv->line, '\n');
+        line_write(&kv->line, kv->file);
     }
 }
 
@@ -399,8 +527,21 @@ static void R_API_CALLCONV data_output_kv_free(data_output_t *output)
     if (kv->color)
         term_free(kv->term);
 
+    free(kv->line.text);
     free(output);
 }
+static data_t *R_API_CALLCONV data_output_kv_stats(data_output_t *output)
+{
+    data_output_kv_t *kv = (data_output_kv_t *)output;
+
+    unsigned dropped = file_sink_dropped(kv->file);
+    if (!dropped)
+        return NULL; // a terminal drops records only when busy
+    return data_make(
+            "term_dropped", "", DATA_INT, dropped,
+            NULL);
+}
+
 struct data_output *data_output_kv_create(int log_level, FILE *file)
 {
     data_output_kv_t *kv = calloc(1, sizeof(data_output_kv_t));
@@ -416,6 +557,7 @@ struct data_output *data_output_kv_create(int log_level, FILE *file)
     kv->output.print_double = print_kv_double;
     kv->output.print_int    = print_kv_int;
     kv->output.output_print = data_output_kv_print;
+    kv->output.output_stats = data_output_kv_stats;
     kv->output.output_free  = data_output_kv_free;
     kv->file                = file;
 
@@ -432,7 +574,17 @@ struct data_output *data_output_kv_create(int log_level, FILE *file)
 typedef struct {
     struct data_output output;
     FILE *file;
+    int layout;         ///< one of CSV_LAYOUT_WIDE, CSV_LAYOUT_SPARSE, CSV_LAYOUT_LONG
     const char **fields;
+    unsigned num_fields;
+    unsigned *columns;  ///< column + 1 of the fields, indexed by key id
+    unsigned num_ids;   ///< size of columns
+    data_t **row;       ///< elements of the current row, by column
+    unsigned *header;   ///< the columns in the sparse header, in the order first seen
+    unsigned *header_pos; ///< position + 1 of the columns in the sparse header, 0 if not seen yet
+    unsigned header_len;
+    unsigned events;    ///< events written in the long layout
+    line_buf_t line;    ///< the current row
     const char *separator;
 } data_output_csv_t;
 
@@ -441,16 +593,16 @@ static void R_API_CALLCONV print_csv_data(data_output_t *output, data_t *data, c
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    fputc('{', csv->file);
+    line_putc(&csv->line, '{');
     for (bool separator = false; data; data = data->next) {
         if (separator)
-            fprintf(csv->file, "; "); // NOTE: distinct from csv->separator
+            line_puts(&csv->line, "; "); // NOTE: distinct from csv->separator
         output->print_string(output, data->key, NULL);
-        fprintf(csv->file, ": ");
+        line_puts(&csv->line, ": ");
         print_value(output, data->type, data->value, data->format);
         separator = true;
     }
-    fputc('}', csv->file);
+    line_putc(&csv->line, '}');
 }
 
 static void R_API_CALLCONV print_csv_array(data_output_t *output, data_array_t *array, char const *format)
@@ -459,7 +611,7 @@ static void R_API_CALLCONV print_csv_array(data_output_t *output, data_array_t *
 
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            fprintf(csv->file, ";");
+            line_putc(&csv->line, ';');
         print_array_value(output, array, format, c);
     }
 }
@@ -469,10 +621,11 @@ static void R_API_CALLCONV print_csv_string(data_output_t *output, const char *s
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
+    size_t sep_len = strlen(csv->separator);
     while (str && *str) {
-        if (strncmp(str, csv->separator, strlen(csv->separator)) == 0)
-            fputc('\\', csv->file);
-        fputc(*str, csv->file);
+        if (strncmp(str, csv->separator, sep_len) == 0)
+            line_putc(&csv->line, '\\');
+        line_putc(&csv->line, *str);
         ++str;
     }
 }
@@ -482,6 +635,28 @@ static int compare_strings(const void *a, const void *b)
     return strcmp(*(char **)a, *(char **)b);
 }
 
+/// Output the CSV header, the sparse header is written as the columns appear.
+static void csv_write_header(data_output_csv_t *csv)
+{
+    if (csv->layout == CSV_LAYOUT_LONG) {
+        fprintf(csv->file, "event%skey%svalue\n", csv->separator, csv->separator);
+    }
+    else if (csv->layout == CSV_LAYOUT_WIDE) {
+        for (int i = 0; csv->fields[i]; ++i) {
+            fprintf(csv->file, "%s%s", i > 0 ? csv->separator : "", csv->fields[i]);
+        }
+        fprintf(csv->file, "\n");
+    }
+}
+
+/// Start a rotated file with a header, the sparse header grows again from the next row.
+static void csv_restart(data_output_csv_t *csv)
+{
+    csv->header_len = 0;
+    memset(csv->header_pos, 0, (csv->num_fields + 1) * sizeof(*csv->header_pos));
+    csv_write_header(csv);
+}
+
 static void R_API_CALLCONV data_output_csv_start(struct data_output *output, char const *const *fields, int num_fields)
 {
     data_output_csv_t *csv = (data_output_csv_t *)output;
@@ -544,21 +719,53 @@ static void R_API_CALLCONV data_output_csv_start(struct data_output *output, cha
         }
     }
     csv->fields[csv_fields] = NULL;
+    csv->num_fields = csv_fields;
     free((void *)allowed);
     free(use_count);
 
-    // Output the CSV header
-    for (i = 0; csv->fields[i]; ++i) {
-        fprintf(csv->file, "%s%s", i > 0 ? csv->separator : "", csv->fields[i]);
+    // map key ids to columns
+    for (i = 0; i < csv_fields; ++i)
+        data_key_intern(csv->fields[i]);
+    csv->num_ids = data_key_count();
+    csv->columns = calloc(csv->num_ids, sizeof(*csv->columns));
+    if (!csv->columns) {
+        WARN_CALLOC("data_output_csv_start()");
+        goto alloc_error;
     }
-    fprintf(csv->file, "\n");
+    csv->row = calloc(csv_fields + 1, sizeof(*csv->row)); // '+ 1' so we never alloc size 0
+    if (!csv->row) {
+        WARN_CALLOC("data_output_csv_start()");
+        goto alloc_error;
+    }
+    csv->header = calloc(csv_fields + 1, sizeof(*csv->header));
+    if (!csv->header) {
+        WARN_CALLOC("data_output_csv_start()");
+        goto alloc_error;
+    }
+    csv->header_pos = calloc(csv_fields + 1, sizeof(*csv->header_pos));
+    if (!csv->header_pos) {
+        WARN_CALLOC("data_output_csv_start()");
+        goto alloc_error;
+    }
+    for (i = 0; i < csv_fields; ++i) {
+        unsigned id = data_key_id(csv->fields[i]);
+        if (id)
+            csv->columns[id] = i + 1;
+    }
+
+    csv_write_header(csv);
     return;
 
 alloc_error:
     free(use_count);
     free((void *)allowed);
-    if (csv)
+    if (csv) {
         free((void *)csv->fields);
+        free(csv->columns);
+        free(csv->row);
+        free(csv->header);
+        free(csv->header_pos);
+    }
     free(csv);
 }
 
@@ -567,7 +774,7 @@ static void R_API_CALLCONV print_csv_double(data_output_t *output, double data,
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    fprintf(csv->file, "%.3f", data);
+    line_printf(&csv->line, "%.3f", data);
 }
 
 static void R_API_CALLCONV print_csv_int(data_output_t *output, int data, char const *format)
@@ -575,18 +782,37 @@ static void R_API_CALLCONV print_csv_int(data_output_t *output, int data, char c
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    fprintf(csv->file, "%d", data);
+    line_printf(&csv->line, "%d", data);
+}
+
+/// Add the new columns of a row to the sparse header, writes the header if it changed.
+static void csv_update_header(data_output_csv_t *csv)
+{
+    unsigned prev_len = csv->header_len;
+    for (unsigned i = 0; i < csv->num_fields; ++i) {
+        if (csv->row[i] && !csv->header_pos[i]) {
+            csv->header[csv->header_len++] = i;
+            csv->header_pos[i] = csv->header_len;
+        }
+    }
+    if (csv->header_len == prev_len)
+        return;
+
+    for (unsigned pos = 0; pos < csv->header_len; ++pos) {
+        if (pos)
+            line_puts(&csv->line, csv->separator);
+        line_puts(&csv->line, csv->fields[csv->header[pos]]);
+    }
+    line_putc(&csv->line, '\n');
 }
 
 static void R_API_CALLCONV data_output_csv_print(data_output_t *output, data_t *data)
 {
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    const char **fields = csv->fields;
-
     int regular = 0; // skip "states" output
     for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "msg") || !strcmp(d->key, "codes") || !strcmp(d->key, "model")) {
+        if (d->key_id == DATA_KEY_MSG || d->key_id == DATA_KEY_CODES || d->key_id == DATA_KEY_MODEL) {
             regular = 1;
             break;
         }
@@ -594,21 +820,61 @@ static void R_API_CALLCONV data_output_csv_print(data_output_t *output, data_t *
     if (!regular)
         return;
 
-    for (int i = 0; fields[i]; ++i) {
-        const char *key = fields[i];
-        data_t *found   = NULL;
-        if (i)
-            fprintf(csv->file, "%s", csv->separator);
-        for (data_t *iter = data; !found && iter; iter = iter->next)
-            if (strcmp(iter->key, key) == 0)
-                found = iter;
+    // pick the first element of each column
+    for (data_t *d = data; d; d = d->next) {
+        if (data_skip(output->skip, d))
+            continue;
+        unsigned id = d->key_id ? d->key_id : data_key_id(d->key); // key might be interned later
+        unsigned column = id < csv->num_ids ? csv->columns[id] : 0;
+        if (column && !csv->row[column - 1])
+            csv->row[column - 1] = d;
+    }
 
-        if (found)
+    if (csv->layout == CSV_LAYOUT_LONG) {
+        // one row per value
+        csv->events++;
+        for (unsigned i = 0; i < csv->num_fields; ++i) {
+            data_t *found = csv->row[i];
+            if (!found)
+                continue;
+            line_printf(&csv->line, "%u%s%s%s", csv->events, csv->separator, csv->fields[i], csv->separator);
             print_value(output, found->type, found->value, found->format);
+            line_putc(&csv->line, '\n');
+            csv->row[i] = NULL;
+        }
+    }
+    else if (csv->layout == CSV_LAYOUT_SPARSE) {
+        // the columns of the header so far, up to the last one in this row
+        csv_update_header(csv);
+        unsigned last = 0;
+        for (unsigned pos = 0; pos < csv->header_len; ++pos) {
+            if (csv->row[csv->header[pos]])
+                last = pos;
+        }
+        for (unsigned pos = 0; pos <= last; ++pos) {
+            data_t *found = csv->row[csv->header[pos]];
+            if (pos)
+                line_puts(&csv->line, csv->separator);
+            if (found)
+                print_value(output, found->type, found->value, found->format);
+            csv->row[csv->header[pos]] = NULL;
+        }
+        line_putc(&csv->line, '\n');
+    }
+    else {
+        for (unsigned i = 0; i < csv->num_fields; ++i) {
+            data_t *found = csv->row[i];
+            if (i)
+                line_puts(&csv->line, csv->separator);
+            if (found)
+                print_value(output, found->type, found->value, found->format);
+            csv->row[i] = NULL;
+        }
+        line_putc(&csv->line, '\n');
     }
 
-    fputc('\n', csv->file);
-    fflush(csv->file);
+    if (line_write(&csv->line, csv->file))
+        csv_restart(csv);
 }
 
 static void R_API_CALLCONV data_output_csv_free(data_output_t *output)
@@ -616,10 +882,15 @@ static void R_API_CALLCONV data_output_csv_free(data_output_t *output)
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
     free((void *)csv->fields);
+    free(csv->columns);
+    free(csv->row);
+    free(csv->header);
+    free(csv->header_pos);
+    free(csv->line.text);
     free(csv);
 }
 
-struct data_output *data_output_csv_create(int log_level, FILE *file)
+struct data_output *data_output_csv_create(int log_level, FILE *file, int layout)
 {
     data_output_csv_t *csv = calloc(1, sizeof(data_output_csv_t));
     if (!csv) {
@@ -637,6 +908,61 @@ struct data_output *data_output_csv_create(int log_level, FILE *file)
     csv->output.output_print = data_output_csv_print;
     csv->output.output_free  = data_output_csv_free;
     csv->file                = file;
+    csv->layout              = layout;
 
     return (struct data_output *)csv;
 }
+
+/* CBOR printer */
+
+typedef struct {
+    struct data_output output;
+    FILE *file;
+    data_render_t render; ///< used if the rendering is not shared
+} data_output_cbor_t;
+
+static void R_API_CALLCONV data_output_cbor_print(data_output_t *output, data_t *data)
+{
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    size_t len;
+    uint8_t const *buf = data_render_cbor(output->render, data, &len);
+    if (!buf) {
+        data_render_start(&cbor->render, data);
+        buf = data_render_cbor(&cbor->render, data, &len);
+        data_render_start(&cbor->render, NULL);
+    }
+    if (!buf)
+        return; // NOTE: skip output on alloc failure.
+
+    // a CBOR sequence (RFC 8742), the items need no delimiter
+    fwrite(buf, 1, len, cbor->file);
+    file_sink_commit(cbor->file);
+}
+
+static void R_API_CALLCONV data_output_cbor_free(data_output_t *output)
+{
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    if (!cbor)
+        return;
+
+    data_render_free(&cbor->render);
+    free(cbor);
+}
+
+struct data_output *data_output_cbor_create(int log_level, FILE *file)
+{
+    data_output_cbor_t *cbor = calloc(1, sizeof(data_output_cbor_t));
+    if (!cbor) {
+        WARN_CALLOC("data_output_cbor_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    cbor->output.log_level    = log_level;
+    cbor->output.output_print = data_output_cbor_print;
+    cbor->output.output_free  = data_output_cbor_free;
+    cbor->file                = file;
+
+    return (struct data_output *)cbor;
+}
@@ -0,0 +1,546 @@
+/** @file
+    Filtering output wrapper, prints the events that match an expression.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_filter.h"
+#include "fatal.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum filter_code {
+    FILTER_PRED,
+    FILTER_AND,
+    FILTER_OR,
+    FILTER_NOT,
+};
+
+enum filter_cmp {
+    FILTER_HAS,
+    FILTER_EQ,
+    FILTER_NE,
+    FILTER_GLOB,
+    FILTER_NOT_GLOB,
+    FILTER_LT,
+    FILTER_LE,
+    FILTER_GT,
+    FILTER_GE,
+};
+
+typedef struct filter_op {
+    enum filter_code code;
+    enum filter_cmp cmp;
+    unsigned key_id;
+    int is_num;  ///< the value is a number
+    double num;
+    char *str;   ///< the value text, NULL for FILTER_HAS
+} filter_op_t;
+
+struct output_filter {
+    unsigned len;
+    filter_op_t ops[FILTER_OPS_MAX]; ///< postfix code
+};
+
+typedef struct filter_parser {
+    char const *expr;
+    char const *p;
+    output_filter_t *filter;
+    char *err;
+    size_t err_size;
+    int failed;
+} filter_parser_t;
+
+#ifdef __GNUC__
+__attribute__((format(printf, 2, 3)))
+#endif
+static void parse_error(filter_parser_t *ps, char const *format, ...)
+{
+    if (ps->failed++)
+        return; // keep the first message
+    if (!ps->err || !ps->err_size)
+        return;
+    char msg[128];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(msg, sizeof(msg), format, ap);
+    va_end(ap);
+    snprintf(ps->err, ps->err_size, "%s at offset %d of \"%s\"", msg, (int)(ps->p - ps->expr), ps->expr);
+}
+
+static filter_op_t *emit(filter_parser_t *ps, enum filter_code code)
+{
+    output_filter_t *f = ps->filter;
+    if (f->len >= FILTER_OPS_MAX) {
+        parse_error(ps, "More than %d terms", FILTER_OPS_MAX);
+        return NULL;
+    }
+    filter_op_t *op = &f->ops[f->len++];
+    op->code        = code;
+    return op;
+}
+
+static void skip_ws(filter_parser_t *ps)
+{
+    while (isspace((unsigned char)*ps->p))
+        ps->p++;
+}
+
+/// Consume @p tok if next, returns 1 if consumed.
+static int accept(filter_parser_t *ps, char const *tok)
+{
+    skip_ws(ps);
+    size_t len = strlen(tok);
+    if (strncmp(ps->p, tok, len))
+        return 0;
+    ps->p += len;
+    return 1;
+}
+
+static enum filter_cmp parse_cmp(filter_parser_t *ps)
+{
+    skip_ws(ps);
+    // the longer operators first
+    static struct {
+        char const *tok;
+        enum filter_cmp cmp;
+    } const cmps[] = {
+            {"==", FILTER_EQ},
+            {"!=", FILTER_NE},
+            {"!~", FILTER_NOT_GLOB},
+            {"<=", FILTER_LE},
+            {">=", FILTER_GE},
+            {"=", FILTER_EQ},
+            {"~", FILTER_GLOB},
+            {"<", FILTER_LT},
+            {">", FILTER_GT},
+    };
+    for (unsigned i = 0; i < sizeof(cmps) / sizeof(*cmps); ++i) {
+        if (accept(ps, cmps[i].tok))
+            return cmps[i].cmp;
+    }
+    return FILTER_HAS;
+}
+
+static void parse_value(filter_parser_t *ps, filter_op_t *op)
+{
+    skip_ws(ps);
+    char const *start = ps->p;
+    char const *end;
+    if (*ps->p == '"') {
+        start = ++ps->p;
+        end   = strchr(start, '"');
+        if (!end) {
+            parse_error(ps, "Missing closing quote");
+            return;
+        }
+        ps->p = end + 1;
+    }
+    else {
+        while (*ps->p && !isspace((unsigned char)*ps->p) && *ps->p != ')'
+                && strncmp(ps->p, "&&", 2) && strncmp(ps->p, "||", 2))
+            ps->p++;
+        end = ps->p;
+        if (end == start) {
+            parse_error(ps, "Missing value");
+            return;
+        }
+    }
+
+    op->str = malloc((size_t)(end - start) + 1);
+    if (!op->str) {
+        WARN_MALLOC("output_filter_compile()");
+        ps->failed++;
+        return;
+    }
+    memcpy(op->str, start, (size_t)(end - start));
+    op->str[end - start] = '\0';
+
+    char *endptr;
+    op->num    = strtod(op->str, &endptr);
+    op->is_num = *op->str && !*endptr;
+}
+
+static void parse_pred(filter_parser_t *ps)
+{
+    skip_ws(ps);
+    char key[64];
+    size_t len = 0;
+    while (isalnum((unsigned char)*ps->p) || *ps->p == '_') {
+        if (len + 1 < sizeof(key))
+            key[len++] = *ps->p;
+        ps->p++;
+    }
+    key[len] = '\0';
+    if (!len) {
+        parse_error(ps, "Expected a field key");
+        return;
+    }
+
+    filter_op_t *op = emit(ps, FILTER_PRED);
+    if (!op)
+        return;
+    op->key_id = data_key_intern(key);
+    if (!op->key_id) {
+        ps->failed++; // alloc failure
+        return;
+    }
+    op->cmp = parse_cmp(ps);
+    if (op->cmp != FILTER_HAS)
+        parse_value(ps, op);
+}
+
+static void parse_or(filter_parser_t *ps);
+
+static void parse_not(filter_parser_t *ps)
+{
+    if (ps->failed)
+        return;
+    if (accept(ps, "!")) {
+        parse_not(ps);
+        emit(ps, FILTER_NOT);
+    }
+    else if (accept(ps, "(")) {
+        parse_or(ps);
+        if (!ps->failed && !accept(ps, ")"))
+            parse_error(ps, "Missing closing parenthesis");
+    }
+    else {
+        parse_pred(ps);
+    }
+}
+
+static void parse_and(filter_parser_t *ps)
+{
+    parse_not(ps);
+    while (!ps->failed && accept(ps, "&&")) {
+        parse_not(ps);
+        emit(ps, FILTER_AND);
+    }
+}
+
+static void parse_or(filter_parser_t *ps)
+{
+    parse_and(ps);
+    while (!ps->failed && accept(ps, "||")) {
+        parse_and(ps);
+        emit(ps, FILTER_OR);
+    }
+}
+
+output_filter_t *output_filter_compile(char const *expr, char *err, size_t err_size)
+{
+    if (err && err_size)
+        *err = '\0';
+    output_filter_t *filter = calloc(1, sizeof(*filter));
+    if (!filter) {
+        WARN_CALLOC("output_filter_compile()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    filter_parser_t ps = {.expr = expr, .p = expr, .filter = filter, .err = err, .err_size = err_size};
+    if (strlen(expr) >= FILTER_EXPR_MAX)
+        parse_error(&ps, "Longer than %d chars", FILTER_EXPR_MAX - 1);
+    parse_or(&ps);
+    skip_ws(&ps);
+    if (!ps.failed && *ps.p)
+        parse_error(&ps, "Unexpected \"%c\"", *ps.p);
+    if (ps.failed) {
+        output_filter_free(filter);
+        return NULL;
+    }
+    return filter;
+}
+
+void output_filter_free(output_filter_t *filter)
+{
+    if (!filter)
+        return;
+    for (unsigned i = 0; i < filter->len; ++i)
+        free(filter->ops[i].str);
+    free(filter);
+}
+
+/// Match a glob with "*" and "?".
+static int glob_match(char const *pattern, char const *text)
+{
+    char const *star = NULL;
+    char const *mark = NULL;
+    while (*text) {
+        if (*pattern == '*') {
+            star = pattern++;
+            mark = text;
+        }
+        else if (*pattern == '?' || *pattern == *text) {
+            pattern++;
+            text++;
+        }
+        else if (star) {
+            pattern = star + 1;
+            text    = ++mark;
+        }
+        else {
+            return 0;
+        }
+    }
+    while (*pattern == '*')
+        pattern++;
+    return !*pattern;
+}
+
+static int compare_result(enum filter_cmp cmp, int order)
+{
+    switch (cmp) {
+    case FILTER_EQ:
+        return order == 0;
+    case FILTER_NE:
+        return order != 0;
+    case FILTER_LT:
+        return order < 0;
+    case FILTER_LE:
+        return order <= 0;
+    case FILTER_GT:
+        return order > 0;
+    case FILTER_GE:
+        return order >= 0;
+    default:
+        return 0;
+    }
+}
+
+static int match_pred(filter_op_t const *op, data_t const *data)
+{
+    data_t const *d = data;
+    while (d && d->key_id != op->key_id)
+        d = d->next;
+    if (!d)
+        return 0;
+    if (op->cmp == FILTER_HAS)
+        return 1;
+
+    int is_num = d->type == DATA_INT || d->type == DATA_DOUBLE;
+    if (is_num && op->is_num && op->cmp != FILTER_GLOB && op->cmp != FILTER_NOT_GLOB) {
+        double val = d->type == DATA_INT ? d->value.v_int : d->value.v_dbl;
+        return compare_result(op->cmp, (val > op->num) - (val < op->num));
+    }
+
+    char buf[32];
+    char const *text = buf;
+    if (d->type == DATA_STRING)
+        text = d->value.v_ptr;
+    else if (d->type == DATA_INT)
+        snprintf(buf, sizeof(buf), "%d", d->value.v_int);
+    else if (d->type == DATA_DOUBLE)
+        snprintf(buf, sizeof(buf), "%g", d->value.v_dbl);
+    else
+        return 0; // nested values
+
+    if (op->cmp == FILTER_GLOB)
+        return glob_match(op->str, text);
+    if (op->cmp == FILTER_NOT_GLOB)
+        return !glob_match(op->str, text);
+    return compare_result(op->cmp, strcmp(text, op->str));
+}
+
+int output_filter_match(output_filter_t const *filter, data_t const *data)
+{
+    unsigned char stack[FILTER_OPS_MAX];
+    unsigned top = 0;
+    for (unsigned i = 0; i < filter->len; ++i) {
+        filter_op_t const *op = &filter->ops[i];
+        switch (op->code) {
+        case FILTER_PRED:
+            stack[top++] = (unsigned char)match_pred(op, data);
+            break;
+        case FILTER_AND:
+            top--;
+            stack[top - 1] = stack[top - 1] && stack[top];
+            break;
+        case FILTER_OR:
+            top--;
+            stack[top - 1] = stack[top - 1] || stack[top];
+            break;
+        case FILTER_NOT:
+            stack[top - 1] = !stack[top - 1];
+            break;
+        }
+    }
+    return top ? stack[0] : 1;
+}
+
+/* Filter output */
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    output_filter_t *filter;
+    unsigned passed;
+    unsigned dropped;
+} data_output_filter_t;
+
+static void R_API_CALLCONV filter_print(data_output_t *output, data_t *data)
+{
+    data_output_filter_t *filter = (data_output_filter_t *)output;
+
+    int has_model = 0;
+    for (data_t const *d = data; d && !has_model; d = d->next)
+        has_model = d->key_id == DATA_KEY_MODEL;
+    if (has_model && !output_filter_match(filter->filter, data)) {
+        filter->dropped++;
+        return;
+    }
+    filter->passed += has_model;
+    data_output_print_shared(filter->inner, data, output->render);
+}
+
+static void R_API_CALLCONV filter_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_filter_t *filter = (data_output_filter_t *)output;
+
+    data_output_start(filter->inner, fields, num_fields);
+}
+
+static data_t *R_API_CALLCONV filter_stats(data_output_t *output)
+{
+    data_output_filter_t *filter = (data_output_filter_t *)output;
+
+    data_t *data = data_make(
+            "filter_passed",    "", DATA_INT, (int)filter->passed,
+            "filter_dropped",   "", DATA_INT, (int)filter->dropped,
+            NULL);
+
+    if (data && filter->inner->output_stats) {
+        data_t *tail = data;
+        while (tail->next)
+            tail = tail->next;
+        tail->next = filter->inner->output_stats(filter->inner);
+    }
+    return data;
+}
+
+static void R_API_CALLCONV filter_free(data_output_t *output)
+{
+    data_output_filter_t *filter = (data_output_filter_t *)output;
+
+    if (!filter)
+        return;
+
+    data_output_free(filter->inner);
+    output_filter_free(filter->filter);
+    free(filter);
+}
+
+struct data_output *data_output_filter_create(struct data_output *inner, output_filter_t *expr)
+{
+    if (!inner) {
+        output_filter_free(expr);
+        return NULL;
+    }
+
+    data_output_filter_t *filter = calloc(1, sizeof(*filter));
+    if (!filter) {
+        WARN_CALLOC("data_output_filter_create()");
+        output_filter_free(expr);
+        return inner; // NOTE: prints all events on alloc failure.
+    }
+    filter->inner  = inner;
+    filter->filter = expr;
+
+    filter->output.log_level    = inner->log_level;
+    filter->output.output_start = filter_start;
+    filter->output.output_print = filter_print;
+    filter->output.output_stats = filter_stats;
+    filter->output.output_free  = filter_free;
+
+    return &filter->output;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Returns the match of an expression, -1 on a syntax error.
+static int match(char const *expr, data_t const *data)
+{
+    char err[256];
+    output_filter_t *filter = output_filter_compile(expr, err, sizeof(err));
+    if (!filter) {
+        fprintf(stderr, "output_filter:: %s\n", err);
+        return -1;
+    }
+    int r = output_filter_match(filter, data);
+    output_filter_free(filter);
+    return r;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    // the events get the ids of the keys interned before, as with the filters compiled at startup
+    data_key_intern("temperature_C");
+    data_t *data = data_make(
+            "model",         "", DATA_STRING, "Acurite-Tower",
+            "id",            "", DATA_INT,    1234,
+            "channel",       "", DATA_STRING, "A",
+            "temperature_C", "", DATA_DOUBLE, 21.5,
+            "rssi",          "", DATA_DOUBLE, -12.5,
+            NULL);
+
+    fprintf(stderr, "output_filter:: predicates\n");
+    ASSERT_EQUALS(match("model~Acurite*", data), 1);
+    ASSERT_EQUALS(match("model~Acurite", data), 0);
+    ASSERT_EQUALS(match("model=Acurite-Tower", data), 1);
+    ASSERT_EQUALS(match("model!~*Tower", data), 0);
+    ASSERT_EQUALS(match("id==1234", data), 1);
+    ASSERT_EQUALS(match("id~12?4", data), 1);
+    ASSERT_EQUALS(match("rssi>-20", data), 1);
+    ASSERT_EQUALS(match("rssi<=-13", data), 0);
+    ASSERT_EQUALS(match("temperature_C>=21.5", data), 1);
+    ASSERT_EQUALS(match("channel!=B", data), 1);
+    ASSERT_EQUALS(match("humidity", data), 0);
+    ASSERT_EQUALS(match("humidity<50", data), 0);
+    ASSERT_EQUALS(match("temperature_C", data), 1);
+    ASSERT_EQUALS(match("model=\"Acurite-Tower\"", data), 1);
+
+    fprintf(stderr, "output_filter:: operators\n");
+    ASSERT_EQUALS(match("model~Acurite* && rssi>-20", data), 1);
+    ASSERT_EQUALS(match("model~Acurite*&&rssi>-10", data), 0);
+    ASSERT_EQUALS(match("id=1||id=1234", data), 1);
+    ASSERT_EQUALS(match("!(id=1||id=2)", data), 1);
+    ASSERT_EQUALS(match("!humidity && (channel=A || channel=B)", data), 1);
+    ASSERT_EQUALS(match("id=1 || id=2 && id=1234", data), 0); // && binds tighter
+
+    fprintf(stderr, "output_filter:: syntax errors\n");
+    ASSERT_EQUALS(match("", data), -1);
+    ASSERT_EQUALS(match("id=", data), -1);
+    ASSERT_EQUALS(match("(id=1", data), -1);
+    ASSERT_EQUALS(match("id=1 id=2", data), -1);
+    ASSERT_EQUALS(match("id=1 &&", data), -1);
+    ASSERT_EQUALS(match("model=\"open", data), -1);
+
+    data_free(data);
+    data_key_free_all();
+    fprintf(stderr, "output_filter:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
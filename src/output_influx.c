@@ -17,33 +17,114 @@
 #include "logger.h"
 #include "fatal.h"
 #include "r_util.h"
+#include "tls_session.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
 
 #include "mongoose.h"
 
+#ifdef ZLIB
+#include <zlib.h>
+#endif
+
 /* InfluxDB client abstraction / printer */
 
+#define INFLUX_RETRY_MS 1000 ///< retry interval while the server is not reachable
+#define INFLUX_BUF_MAX (1024 * 1024) ///< close a buffer at this size, even without batching
+#define INFLUX_BUFS_DEFAULT 8
+
+/// A key sanitized for the line protocol.
+typedef struct {
+    char *name;
+    size_t len;
+} influx_key_t;
+
 typedef struct {
     struct data_output output;
     struct mg_mgr *mgr;
-    struct mg_connection *conn;
+    struct mg_connection *conn;  ///< kept open between posts
+    struct mg_connection *timer; ///< dummy connection for the flush and retry timer
     int prev_status;
     int prev_resp_code;
     char hostname[64];
     char url[400];
+    char address[260];  ///< host and port to connect to
+    char host[256];     ///< Host header
+    char path[400];     ///< path and query to post to
     char extra_headers[150];
     tls_opts_t tls_opts;
-    int databufidxfill;
-    struct mbuf databufs[2];
-
+    tls_session_t tls;  ///< the TLS session resumed on reconnects
+    int precision;      ///< fraction digits of the timestamps, 0 (s) to 9 (ns)
+    int gzip;           ///< post with Content-Encoding gzip
+    size_t batch_size;  ///< post once a buffer holds this many bytes, 0 to post when idle
+    int batch_ms;       ///< post at least at this interval, 0 to post when idle
+    unsigned num_bufs;
+    unsigned databufidxfill; ///< the buffer being filled
+    unsigned databufidxsend; ///< the oldest buffer ready to post
+    int posting;             ///< the buffer at databufidxsend is posted, waiting for the reply
+    struct mbuf *databufs;   ///< ring of num_bufs buffers
+    struct mbuf gzbuf;
+    double retry_time;       ///< don't reconnect before this time after a connect error
+    unsigned posts;          ///< answered posts
+    unsigned dropped;        ///< buffers dropped on a full ring
+    size_t dropped_bytes;
+    influx_key_t *keys;      ///< sanitized keys by key id
+    unsigned keys_len;
 } influx_client_t;
 
 static void influx_client_send(influx_client_t *ctx);
 
+/// The buffers between databufidxsend and databufidxfill are ready to post.
+static unsigned influx_client_ready(influx_client_t *ctx)
+{
+    return (ctx->databufidxfill + ctx->num_bufs - ctx->databufidxsend) % ctx->num_bufs;
+}
+
+/// Mark the fill buffer ready to post, drops the oldest ready buffer if the ring is full.
+static void influx_client_close_buf(influx_client_t *ctx)
+{
+    unsigned n    = ctx->num_bufs;
+    unsigned fill = ctx->databufidxfill;
+    if (!ctx->databufs[fill].len)
+        return;
+
+    if ((fill + 1) % n != ctx->databufidxsend) {
+        ctx->databufidxfill = (fill + 1) % n;
+        return;
+    }
+
+    // ring is full, drop the oldest buffer not being posted and move the empty buffer to the fill position
+    unsigned drop = ctx->posting ? (ctx->databufidxsend + 1) % n : ctx->databufidxsend;
+    if (drop == fill)
+        return; // keep filling, we can't drop the buffer being posted
+    ctx->dropped++;
+    ctx->dropped_bytes += ctx->databufs[drop].len;
+    if (ctx->dropped == 1 || !(ctx->dropped & (ctx->dropped - 1)))
+        print_logf(LOG_WARNING, "InfluxDB", "InfluxDB buffers full, dropped %u posts so far", ctx->dropped);
+    ctx->databufs[drop].len = 0;
+    for (unsigned i = drop; i != fill; i = (i + 1) % n) {
+        struct mbuf tmp                   = ctx->databufs[i];
+        ctx->databufs[i]                  = ctx->databufs[(i + 1) % n];
+        ctx->databufs[(i + 1) % n]        = tmp;
+    }
+}
+
+/// The post at databufidxsend is done, release the buffer.
+static void influx_client_posted(influx_client_t *ctx)
+{
+    if (!ctx->posting)
+        return;
+    struct mbuf *buf = &ctx->databufs[ctx->databufidxsend];
+    buf->len         = 0;
+    ctx->databufidxsend = (ctx->databufidxsend + 1) % ctx->num_bufs;
+    ctx->posting        = 0;
+    ctx->posts++;
+}
+
 static void influx_client_event(struct mg_connection *nc, int ev, void *ev_data)
 {
     // note that while shutting down the ctx is NULL
@@ -58,55 +139,126 @@ static void influx_client_event(struct mg_connection *nc, int ev, void *ev_data)
             if (ctx) {
                 if (ctx->prev_status != connect_status)
                     print_logf(LOG_WARNING, "InfluxDB", "InfluxDB connect error: %s", strerror(connect_status));
-                ctx->conn = NULL;
             }
         }
-        if (ctx)
+        if (ctx) {
+            tls_session_connected(&ctx->tls, nc, connect_status);
             ctx->prev_status = connect_status;
+            if (connect_status != 0)
+                ctx->retry_time = mg_time() + INFLUX_RETRY_MS / 1000.0;
+        }
         break;
     }
     case MG_EV_HTTP_CHUNK: // response is normally empty (so mongoose thinks we received a chunk only)
+        if (mg_get_http_header(hm, "Content-Length"))
+            break; // wait for the whole reply
+        // the reply has no body, discard to keep the connection for the next post
+        nc->recv_mbuf.len = 0;
+        // fall through
     case MG_EV_HTTP_REPLY:
-        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
         if (hm->resp_code == 204) {
             // mark influx data as sent
         }
         else {
             if (ctx && ctx->prev_resp_code != hm->resp_code)
-                print_logf(LOG_WARNING, "InfluxDB", "InfluxDB replied HTTP code: %d with message:\n%s", hm->resp_code, hm->body.p);
+                print_logf(LOG_WARNING, "InfluxDB", "InfluxDB replied HTTP code: %d with message:\n%.*s", hm->resp_code, (int)hm->body.len, hm->body.p);
         }
-        if (ctx) {
-            ctx->prev_resp_code = hm->resp_code;
+        if (!ctx)
+            break;
+        ctx->prev_resp_code = hm->resp_code;
+        if (nc == ctx->conn) {
+            tls_session_keep(&ctx->tls, nc);
+            influx_client_posted(ctx);
+            influx_client_send(ctx);
         }
         break;
     case MG_EV_CLOSE:
-        if (ctx) {
-            ctx->conn = NULL;
+        if (!ctx || nc != ctx->conn)
+            break;
+        tls_session_closed(&ctx->tls, nc);
+        ctx->conn = NULL;
+        // an unanswered post is sent again on the next connection
+        ctx->posting = 0;
+        // reconnect right away only if the server was reachable
+        if (ctx->prev_status == 0)
             influx_client_send(ctx);
-        }
         break;
     }
 }
 
+static void influx_timer_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    influx_client_t *ctx = (influx_client_t *)nc->user_data;
+    if (ev != MG_EV_TIMER || !ctx)
+        return;
+
+    if (ctx->batch_ms)
+        influx_client_close_buf(ctx);
+    influx_client_send(ctx);
+    mg_set_timer(nc, mg_time() + (ctx->batch_ms ? ctx->batch_ms : INFLUX_RETRY_MS) / 1000.0);
+}
+
 static influx_client_t *influx_client_init(influx_client_t *ctx, char const *url, char const *token)
 {
     snprintf(ctx->url, sizeof(ctx->url), "%s", url);
     snprintf(ctx->extra_headers, sizeof (ctx->extra_headers), "Authorization: Token %s\r\n", token);
 
+    struct mg_str host, path, query;
+    unsigned port = 0;
+    mg_parse_uri(mg_mk_str(url), NULL, NULL, &host, &port, &path, &query, NULL);
+    if (!port)
+        port = ctx->tls_opts.tls_ca_cert ? 443 : 80;
+    snprintf(ctx->path, sizeof(ctx->path), "%.*s%s%.*s", path.len ? (int)path.len : 1, path.len ? path.p : "/",
+            query.len ? "?" : "", (int)query.len, query.p);
+    // the Host header is the authority of the URL
+    snprintf(ctx->host, sizeof(ctx->host), "%.*s", (int)(path.p - host.p), host.p);
+    // if the host is an IPv6 address it needs quoting
+    if (memchr(host.p, ':', host.len))
+        snprintf(ctx->address, sizeof(ctx->address), "[%.*s]:%u", (int)host.len, host.p, port);
+    else
+        snprintf(ctx->address, sizeof(ctx->address), "%.*s:%u", (int)host.len, host.p, port);
+
+    ctx->databufs = calloc(ctx->num_bufs, sizeof(*ctx->databufs));
+    if (!ctx->databufs)
+        FATAL_CALLOC("influx_client_init()");
+
+    struct mg_add_sock_opts opts = {.user_data = ctx};
+    ctx->timer = mg_add_sock_opt(ctx->mgr, INVALID_SOCKET, influx_timer_event, opts);
+    if (ctx->timer)
+        mg_set_timer(ctx->timer, mg_time() + (ctx->batch_ms ? ctx->batch_ms : INFLUX_RETRY_MS) / 1000.0);
+
     return ctx;
 }
 
-static void influx_client_send(influx_client_t *ctx)
+#ifdef ZLIB
+/// Compress a post body with gzip into @p dst, returns 0 on success.
+static int influx_gzip(struct mbuf *dst, char const *src, size_t len)
 {
-    struct mbuf *buf = &ctx->databufs[ctx->databufidxfill];
-
-    /*fprintf(stderr, "Influx %p msg: \"%s\" with %lu/%lu %s\n",
-            (void*)ctx, buf->buf, buf->len, buf->size,
-            ctx->conn ? "buffering" : "to be sent");*/
-
-    if (ctx->conn || !buf->len)
-        return;
+    z_stream zs = {0};
+    // window bits 15 plus 16 to write a gzip header
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+    size_t bound = deflateBound(&zs, len);
+    if (dst->size < bound)
+        mbuf_resize(dst, bound);
+    if (dst->size < bound) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in   = (Bytef *)src;
+    zs.avail_in  = len;
+    zs.next_out  = (Bytef *)dst->buf;
+    zs.avail_out = dst->size;
+    int r        = deflate(&zs, Z_FINISH);
+    dst->len     = zs.total_out;
+    deflateEnd(&zs);
+    return r == Z_STREAM_END ? 0 : -1;
+}
+#endif
 
+static struct mg_connection *influx_client_connect(influx_client_t *ctx)
+{
     char const *error_string = NULL;
     struct mg_connect_opts opts = {.user_data = ctx, .error_string = &error_string};
     if (ctx->tls_opts.tls_ca_cert) {
@@ -139,23 +291,98 @@ static void influx_client_send(influx_client_t *ctx)
         exit(1);
 #endif
     }
-    if ((ctx->conn = mg_connect_http_opt(ctx->mgr, influx_client_event, opts, ctx->url, ctx->extra_headers, buf->buf)) == NULL) {
+    struct mg_connection *conn = mg_connect_opt(ctx->mgr, ctx->address, influx_client_event, opts);
+    if (!conn) {
         print_logf(LOG_WARNING, "InfluxDB", "Connect to InfluxDB (%s) failed (%s)", ctx->url, error_string);
+        return NULL;
     }
-    else {
-        ctx->databufidxfill ^= 1;
-        buf->len = 0;
-        *buf->buf = '\0';
+    mg_set_protocol_http_websocket(conn);
+    tls_session_connect(&ctx->tls, conn);
+    return conn;
+}
+
+/// Post the oldest ready buffer if no post is pending, the connection is kept open.
+static void influx_client_send(influx_client_t *ctx)
+{
+    // without batching post as soon as the previous post is done
+    if (!influx_client_ready(ctx) && !ctx->batch_size && !ctx->batch_ms)
+        influx_client_close_buf(ctx);
+
+    /*fprintf(stderr, "Influx %p ready: %u of %u %s\n",
+            (void*)ctx, influx_client_ready(ctx), ctx->num_bufs,
+            ctx->posting ? "waiting" : "to be sent");*/
+
+    if (ctx->posting || !influx_client_ready(ctx))
+        return;
+
+    if (!ctx->conn && ctx->prev_status != 0 && mg_time() < ctx->retry_time)
+        return;
+    if (!ctx->conn)
+        ctx->conn = influx_client_connect(ctx);
+    if (!ctx->conn)
+        return;
+
+    struct mbuf *buf = &ctx->databufs[ctx->databufidxsend];
+    char const *body = buf->buf;
+    size_t body_len  = buf->len;
+    char const *encoding = "";
+#ifdef ZLIB
+    if (ctx->gzip && !influx_gzip(&ctx->gzbuf, buf->buf, buf->len)) {
+        body     = ctx->gzbuf.buf;
+        body_len = ctx->gzbuf.len;
+        encoding = "Content-Encoding: gzip\r\n";
     }
+#endif
+
+    mg_printf(ctx->conn, "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Length: %zu\r\n%s%s\r\n",
+            ctx->path, ctx->host, body_len, ctx->extra_headers, encoding);
+    mg_send(ctx->conn, body, body_len);
+    ctx->posting = 1;
 }
 
 /* Helper */
 
+/// The chars allowed in tags and identifiers, [-.A-Za-z0-9].
+static char const influx_tag_chars[256] = {
+        ['-'] = 1, ['.'] = 1,
+        ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1, ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1, ['9'] = 1,
+        ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1, ['G'] = 1, ['H'] = 1, ['I'] = 1,
+        ['J'] = 1, ['K'] = 1, ['L'] = 1, ['M'] = 1, ['N'] = 1, ['O'] = 1, ['P'] = 1, ['Q'] = 1, ['R'] = 1,
+        ['S'] = 1, ['T'] = 1, ['U'] = 1, ['V'] = 1, ['W'] = 1, ['X'] = 1, ['Y'] = 1, ['Z'] = 1,
+        ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1, ['h'] = 1, ['i'] = 1,
+        ['j'] = 1, ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1, ['o'] = 1, ['p'] = 1, ['q'] = 1, ['r'] = 1,
+        ['s'] = 1, ['t'] = 1, ['u'] = 1, ['v'] = 1, ['w'] = 1, ['x'] = 1, ['y'] = 1, ['z'] = 1,
+};
+
+enum influx_class {
+    INFLUX_FIELD,
+    INFLUX_TAG,
+    INFLUX_SKIP,
+};
+
+/// The model and time have their own place in a line, some well-known keys are tags, all others are fields.
+static enum influx_class influx_key_class(unsigned key_id)
+{
+    switch (key_id) {
+    case DATA_KEY_MODEL:
+    case DATA_KEY_TIME:
+        return INFLUX_SKIP;
+    case DATA_KEY_TYPE:
+    case DATA_KEY_SUBTYPE:
+    case DATA_KEY_ID:
+    case DATA_KEY_CHANNEL:
+    case DATA_KEY_MIC:
+        return INFLUX_TAG;
+    default:
+        return INFLUX_FIELD;
+    }
+}
+
 /// clean the tag/identifier inplace to [-.A-Za-z0-9], esp. not whitespace, =, comma and replace any leading _ by x
 static char *influx_sanitize_tag(char *tag, char *end)
 {
     for (char *p = tag; *p && p != end; ++p)
-        if (*p != '-' && *p != '.' && (*p < 'A' || *p > 'Z') && (*p < 'a' || *p > 'z') && (*p < '0' || *p > '9'))
+        if (!influx_tag_chars[(unsigned char)*p])
             *p = '_';
 
     for (char *p = tag; *p && p != end; ++p)
@@ -203,88 +430,210 @@ static char *mbuf_snprintf(struct mbuf *a, char const *format, ...)
     return str;
 }
 
-static void mbuf_remove_part(struct mbuf *a, char *pos, size_t len)
+/// Sanitized key of a key id, cached on first use.
+static influx_key_t const *influx_key(influx_client_t *influx, unsigned key_id)
 {
-    if (pos >= a->buf && pos < &a->buf[a->len] && &pos[len] <= &a->buf[a->len]) {
-        memmove(pos, &pos[len], a->len - (pos - a->buf) - len);
-        a->len -= len;
+    if (!key_id)
+        return NULL;
+    if (key_id >= influx->keys_len) {
+        unsigned len = MAX(data_key_count(), key_id + 1);
+        influx_key_t *keys = realloc(influx->keys, len * sizeof(*keys));
+        if (!keys) {
+            WARN_REALLOC("influx_key()");
+            return NULL; // NOTE: the key is sanitized on output instead.
+        }
+        memset(&keys[influx->keys_len], 0, (len - influx->keys_len) * sizeof(*keys));
+        influx->keys     = keys;
+        influx->keys_len = len;
     }
+    influx_key_t *key = &influx->keys[key_id];
+    if (!key->name) {
+        char const *name = data_key_name(key_id);
+        if (!name)
+            return NULL;
+        key->name = strdup(name);
+        if (!key->name) {
+            WARN_STRDUP("influx_key()");
+            return NULL; // NOTE: the key is sanitized on output instead.
+        }
+        influx_sanitize_tag(key->name, NULL);
+        key->len = strlen(key->name);
+    }
+    return key;
 }
 
-static void R_API_CALLCONV print_influx_array(data_output_t *output, data_array_t *array, char const *format)
+/// Append @p str sanitized like influx_sanitize_tag().
+static void influx_put_sanitized(struct mbuf *buf, char const *str)
 {
-    UNUSED(array);
-    UNUSED(format);
-    influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
-    mbuf_snprintf(buf, "\"array\""); // TODO
+    size_t len = strlen(str);
+    if (buf->size - buf->len < len + 1)
+        mbuf_resize(buf, MAX(buf->len + len + 1, buf->size * 2));
+    if (buf->size - buf->len < len + 1)
+        return;
+    char *p     = &buf->buf[buf->len];
+    int leading = 1;
+    for (; *str; ++str) {
+        char c = *str;
+        if (!influx_tag_chars[(unsigned char)c])
+            c = leading ? 'x' : '_';
+        else
+            leading = 0;
+        *p++ = c;
+    }
+    *p       = '\0';
+    buf->len = p - buf->buf;
 }
 
-static void R_API_CALLCONV print_influx_data_escaped(data_output_t *output, data_t *data, char const *format)
+/// Append @p str double quoted, with quotes, backslash, and line breaks escaped.
+static void influx_put_quoted(struct mbuf *buf, char const *str)
 {
-    char str[1000];
-    data_print_jsons(data, str, sizeof (str));
-    output->print_string(output, str, format);
+    size_t len = strlen(str);
+    // worst case every char is escaped
+    if (buf->size - buf->len < 2 * len + 3)
+        mbuf_resize(buf, MAX(buf->len + 2 * len + 3, buf->size * 2));
+    if (buf->size - buf->len < 2 * len + 3)
+        return;
+    char *p = &buf->buf[buf->len];
+    *p++    = '"';
+    for (; *str; ++str) {
+        char c = *str;
+        if (c == '\r' || c == '\n' || c == '\t') {
+            *p++ = '\\';
+            *p++ = c == '\r' ? 'r' : c == '\n' ? 'n' : 't';
+            continue;
+        }
+        if (c == '"' || c == '\\')
+            *p++ = '\\';
+        *p++ = c;
+    }
+    *p++     = '"';
+    *p       = '\0';
+    buf->len = p - buf->buf;
 }
 
-static void R_API_CALLCONV print_influx_string_escaped(data_output_t *output, char const *str, char const *format)
+/// Append the digits of an int.
+static void influx_put_int(struct mbuf *buf, int val)
 {
-    UNUSED(format);
-    influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *databuf = &influx->databufs[influx->databufidxfill];
-    size_t size = databuf->size - databuf->len;
-    char *buf = &databuf->buf[databuf->len];
+    char tmp[16];
+    char *end     = tmp + sizeof(tmp);
+    char *p       = end;
+    unsigned uval = val < 0 ? 0u - (unsigned)val : (unsigned)val;
+    do {
+        *--p = '0' + uval % 10;
+        uval /= 10;
+    } while (uval);
+    if (val < 0)
+        *--p = '-';
+    mbuf_append(buf, p, end - p);
+}
 
-    if (size < strlen(str) + 3) {
-        return;
+/// Append a double like "%f", falls back to printf if the rounding could differ.
+static void influx_put_double(struct mbuf *buf, double val)
+{
+    double mag = fabs(val);
+    if (mag < 1e6) {
+        double scaled  = mag * 1000000.0;
+        uint64_t whole = (uint64_t)scaled;
+        double frac    = scaled - (double)whole;
+        if (frac < 0.499 || frac > 0.501) {
+            whole += frac > 0.5;
+            char tmp[32];
+            char *end = tmp + sizeof(tmp);
+            char *p   = end;
+            for (int i = 0; i < 6; ++i) {
+                *--p = '0' + whole % 10;
+                whole /= 10;
+            }
+            *--p = '.';
+            do {
+                *--p = '0' + whole % 10;
+                whole /= 10;
+            } while (whole);
+            // printf keeps the sign of a negative value that rounds to zero
+            if (signbit(val))
+                *--p = '-';
+            mbuf_append(buf, p, end - p);
+            return;
+        }
     }
+    mbuf_reserve(buf, 400); // %f of a double has at most 309 integer digits
+    mbuf_snprintf(buf, "%f", val);
+}
 
-    *buf++ = '"';
-    size--;
-    for (; *str && size >= 3; ++str) {
-        if (*str == '\r') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 'r';
-            size--;
-            continue;
-        }
-        if (*str == '\n') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 'n';
-            size--;
-            continue;
-        }
-        if (*str == '\t') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 't';
-            size--;
-            continue;
-        }
-        if (*str == '"' || *str == '\\') {
-            *buf++ = '\\';
-            size--;
-        }
-        *buf++ = *str;
-        size--;
+/// Append a tag value, sanitized.
+static void influx_put_tag_value(struct mbuf *buf, data_t *data)
+{
+    if (data->type == DATA_STRING) {
+        influx_put_sanitized(buf, data->value.v_ptr);
+    }
+    else if (data->type == DATA_INT) {
+        influx_put_int(buf, data->value.v_int);
+    }
+    else if (data->type == DATA_DOUBLE) {
+        influx_put_double(buf, data->value.v_dbl);
     }
-    if (size >= 2) {
-        *buf++ = '"';
-        size--;
+    else if (data->type == DATA_DATA) {
+        char str[1000];
+        data_print_jsons(data->value.v_ptr, str, sizeof(str));
+        influx_put_sanitized(buf, str);
     }
-    *buf = '\0';
+    else {
+        influx_put_sanitized(buf, "array");
+    }
+}
 
-    databuf->len = databuf->size - size;
+/// Append a field value, strings are quoted.
+static void influx_put_field_value(struct mbuf *buf, data_t *data)
+{
+    if (data->type == DATA_STRING) {
+        influx_put_quoted(buf, data->value.v_ptr);
+    }
+    else if (data->type == DATA_INT) {
+        influx_put_int(buf, data->value.v_int);
+    }
+    else if (data->type == DATA_DOUBLE) {
+        influx_put_double(buf, data->value.v_dbl);
+    }
+    else if (data->type == DATA_DATA) {
+        char str[1000];
+        data_print_jsons(data->value.v_ptr, str, sizeof(str));
+        influx_put_quoted(buf, str);
+    }
+    else {
+        mbuf_append(buf, "\"array\"", 7); // TODO
+    }
 }
 
-static void R_API_CALLCONV print_influx_string(data_output_t *output, char const *str, char const *format)
+/// Append a key, from the cache of sanitized keys if possible.
+static void influx_put_key(influx_client_t *influx, struct mbuf *buf, data_t *data)
 {
-    UNUSED(format);
-    influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
-    mbuf_snprintf(buf, "%s", str);
+    influx_key_t const *key = influx_key(influx, data->key_id);
+    if (key)
+        mbuf_append(buf, key->name, key->len);
+    else
+        influx_put_sanitized(buf, data->key);
+}
+
+/// Append the timestamp with the configured precision, unix time formats only.
+static void influx_put_time(influx_client_t *influx, struct mbuf *buf, char const *str)
+{
+    // relative time, date time, and ISO date time formats are not understood by InfluxDB
+    size_t len = strlen(str);
+    if (str[0] == '@' || (len > 10 && (str[10] == ' ' || str[10] == 'T')))
+        return;
+
+    mbuf_append(buf, " ", 1);
+    char const *frac = strchr(str, '.');
+    size_t whole_len = frac ? (size_t)(frac - str) : len;
+    mbuf_append(buf, str, whole_len);
+    // unix timestamp, with usec or seconds resolution configured
+    int digits = frac ? (int)(len - whole_len - 1) : 0;
+    if (digits > influx->precision)
+        digits = influx->precision;
+    if (digits > 0)
+        mbuf_append(buf, frac + 1, digits);
+    for (; digits < influx->precision; ++digits)
+        mbuf_append(buf, "0", 1);
 }
 
 // Generate InfluxDB line protocol
@@ -292,126 +641,93 @@ static void R_API_CALLCONV print_influx_data(data_output_t *output, data_t *data
 {
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
-    char *str;
-    char *end;
     struct mbuf *buf = &influx->databufs[influx->databufidxfill];
-    bool comma = false;
+    size_t line_start = buf->len;
+    data_skip_t const *skip = output->skip;
 
-    data_t *data_org = data;
     data_t *data_model = NULL;
     data_t *data_time = NULL;
     for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "model"))
+        if (d->key_id == DATA_KEY_MODEL)
             data_model = d;
-        if (!strcmp(d->key, "time"))
+        if (d->key_id == DATA_KEY_TIME && !data_skip(skip, d))
             data_time = d;
     }
 
     if (!data_model) {
         // data isn't from device (maybe report for example)
         // use hostname for measurement
-
-        mbuf_reserve(buf, 20000);
-        mbuf_snprintf(buf, "rtl_433_%s", influx->hostname);
+        mbuf_append(buf, "rtl_433_", 8);
+        mbuf_append(buf, influx->hostname, strlen(influx->hostname));
     }
     else {
         // use model for measurement
-
-        mbuf_reserve(buf, 1000);
-        str = &buf->buf[buf->len];
-        print_value(output, data_model->type, data_model->value, data_model->format);
-        influx_sanitize_tag(str, NULL);
+        influx_put_tag_value(buf, data_model);
     }
 
     // write tags
-    while (data) {
-        if (!strcmp(data->key, "model")
-                || !strcmp(data->key, "time")) {
-            // skip
-        }
-        else if (!strcmp(data->key, "type")
-                || !strcmp(data->key, "subtype")
-                || !strcmp(data->key, "id")
-                || !strcmp(data->key, "channel")
-                || !strcmp(data->key, "mic")) {
-            str = mbuf_snprintf(buf, ",%s=", data->key);
-            str++;
-            end = &buf->buf[buf->len - 1];
-            influx_sanitize_tag(str, end);
-            str = end + 1;
-            print_value(output, data->type, data->value, data->format);
-            influx_sanitize_tag(str, NULL);
+    for (data_t *d = data; d; d = d->next) {
+        if (influx_key_class(d->key_id) == INFLUX_TAG && !data_skip(skip, d)) {
+            mbuf_append(buf, ",", 1);
+            influx_put_key(influx, buf, d);
+            mbuf_append(buf, "=", 1);
+            influx_put_tag_value(buf, d);
         }
-        data = data->next;
     }
 
-    mbuf_snprintf(buf, " ");
-
-    // activate escaped output functions
-    influx->output.print_data   = print_influx_data_escaped;
-    influx->output.print_string = print_influx_string_escaped;
+    mbuf_append(buf, " ", 1);
 
     // write fields
-    data = data_org;
-    while (data) {
-        if (!strcmp(data->key, "model")
-                || !strcmp(data->key, "time")) {
-            // skip
-        }
-        else if (!strcmp(data->key, "type")
-                || !strcmp(data->key, "subtype")
-                || !strcmp(data->key, "id")
-                || !strcmp(data->key, "channel")
-                || !strcmp(data->key, "mic")) {
-            // skip
-        }
-        else {
-            str = mbuf_snprintf(buf, comma ? ",%s=" : "%s=", data->key);
+    bool comma = false;
+    for (data_t *d = data; d; d = d->next) {
+        if (influx_key_class(d->key_id) == INFLUX_FIELD && !data_skip(skip, d)) {
             if (comma)
-                str++;
-            end = &buf->buf[buf->len - 1];
-            influx_sanitize_tag(str, end);
-            print_value(output, data->type, data->value, data->format);
+                mbuf_append(buf, ",", 1);
+            influx_put_key(influx, buf, d);
+            mbuf_append(buf, "=", 1);
+            influx_put_field_value(buf, d);
             comma = true;
         }
-        data = data->next;
     }
-
-    // restore original output functions
-    influx->output.print_data   = print_influx_data;
-    influx->output.print_string = print_influx_string;
+    if (skip && !comma) {
+        buf->len = line_start; // a line needs a field, the projection left none
+        return;
+    }
 
     // write time if available
-    if (data_time) {
-        str = mbuf_snprintf(buf, " ");
-        print_value(output, data_time->type, data_time->value, data_time->format);
-        if (str[1] == '@' // relative time format configured
-                || str[11] == ' ' // date time format configured
-                || str[11] == 'T') {  // ISO date time format configured
-            // -> bad, because InfluxDB doesn't under stand those formats -> remove timestamp
-            buf->len = str - buf->buf;
-        }
-        else if ((str = strchr(str, '.'))) {
-            // unix usec timestamp format configured
-            mbuf_remove_part(buf, str, 1);
-            mbuf_snprintf(buf, "000");
-        }
-        else {
-            // unix timestamp with seconds resolution configured
-            mbuf_snprintf(buf, "000000000");
-        }
-    }
-    mbuf_snprintf(buf, "\n");
+    if (data_time && data_time->type == DATA_STRING)
+        influx_put_time(influx, buf, data_time->value.v_ptr);
+    mbuf_append(buf, "\n", 1);
+
+    if (buf->len >= (influx->batch_size ? influx->batch_size : INFLUX_BUF_MAX))
+        influx_client_close_buf(influx);
 
     influx_client_send(influx);
 }
 
+static void R_API_CALLCONV print_influx_array(data_output_t *output, data_array_t *array, char const *format)
+{
+    UNUSED(array);
+    UNUSED(format);
+    influx_client_t *influx = (influx_client_t *)output;
+    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
+    mbuf_append(buf, "\"array\"", 7); // TODO
+}
+
+static void R_API_CALLCONV print_influx_string(data_output_t *output, char const *str, char const *format)
+{
+    UNUSED(format);
+    influx_client_t *influx = (influx_client_t *)output;
+    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
+    influx_put_quoted(buf, str);
+}
+
 static void R_API_CALLCONV print_influx_double(data_output_t *output, double data, char const *format)
 {
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
     struct mbuf *buf = &influx->databufs[influx->databufidxfill];
-    mbuf_snprintf(buf, "%f", data);
+    influx_put_double(buf, data);
 }
 
 static void R_API_CALLCONV print_influx_int(data_output_t *output, int data, char const *format)
@@ -419,7 +735,7 @@ static void R_API_CALLCONV print_influx_int(data_output_t *output, int data, cha
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
     struct mbuf *buf = &influx->databufs[influx->databufidxfill];
-    mbuf_snprintf(buf, "%d", data);
+    influx_put_int(buf, data);
 }
 
 static void R_API_CALLCONV data_output_influx_free(data_output_t *output)
@@ -430,14 +746,62 @@ static void R_API_CALLCONV data_output_influx_free(data_output_t *output)
         return;
 
     // remove ctx from our connections
+    tls_session_clear(&influx->tls, influx->conn);
     if (influx->conn) {
         influx->conn->user_data = NULL;
         influx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
     }
+    if (influx->timer) {
+        influx->timer->user_data = NULL;
+        influx->timer->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
 
+    for (unsigned i = 0; i < influx->keys_len; ++i)
+        free(influx->keys[i].name);
+    free(influx->keys);
+    for (unsigned i = 0; i < influx->num_bufs; ++i)
+        mbuf_free(&influx->databufs[i]);
+    free(influx->databufs);
+    mbuf_free(&influx->gzbuf);
     free(influx);
 }
 
+/// Parse a precision of s, ms, us (or u), ns (or n), returns the number of fraction digits or -1.
+static int influx_parse_precision(char const *arg)
+{
+    size_t len = strcspn(arg, "&");
+    if (len == 1 && arg[0] == 's')
+        return 0;
+    if (len == 2 && !strncmp(arg, "ms", 2))
+        return 3;
+    if ((len == 2 && !strncmp(arg, "us", 2)) || (len == 1 && arg[0] == 'u'))
+        return 6;
+    if ((len == 2 && !strncmp(arg, "ns", 2)) || (len == 1 && arg[0] == 'n'))
+        return 9;
+    return -1;
+}
+
+static data_t *R_API_CALLCONV data_output_influx_stats(data_output_t *output)
+{
+    influx_client_t *influx = (influx_client_t *)output;
+
+    unsigned ready = influx_client_ready(influx);
+    size_t bytes   = 0;
+    for (unsigned i = 0; i < influx->num_bufs; ++i)
+        bytes += influx->databufs[i].len;
+
+    data_t *data = data_make(
+            "connected",        "", DATA_INT, influx->conn && influx->prev_status == 0,
+            "posts",            "", DATA_INT, (int)influx->posts,
+            "buffers",          "", DATA_INT, (int)ready,
+            "buffers_max",      "", DATA_INT, (int)influx->num_bufs - 1,
+            "bytes",            "", DATA_INT, (int)bytes,
+            "dropped",          "", DATA_INT, (int)influx->dropped,
+            "dropped_bytes",    "", DATA_INT, (int)influx->dropped_bytes,
+            NULL);
+    return tls_session_stats(&influx->tls, data);
+}
+
 struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
 {
     influx_client_t *influx = calloc(1, sizeof(influx_client_t));
@@ -454,6 +818,7 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
     influx_sanitize_tag(influx->hostname, NULL);
 
     char *token = NULL;
+    char const *precision = NULL;
 
     // param/opts starts with URL
     if (!opts) {
@@ -495,6 +860,16 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
             continue;
         else if (!strcasecmp(key, "t") || !strcasecmp(key, "token"))
             token = val;
+        else if (!strcasecmp(key, "batch"))
+            influx->batch_ms = val ? atoiv(val, 1) : 1000;
+        else if (!strcasecmp(key, "batch_size"))
+            influx->batch_size = atoiv(val, 1);
+        else if (!strcasecmp(key, "buffers"))
+            influx->num_bufs = atoiv(val, 1);
+        else if (!strcasecmp(key, "gzip"))
+            influx->gzip = atobv(val, 1);
+        else if (!strcasecmp(key, "precision"))
+            precision = val;
         else if (!tls_param(&influx->tls_opts, key, val)) {
             // ok
         }
@@ -504,7 +879,39 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
         }
     }
 
+    if (influx->num_bufs < 2)
+        influx->num_bufs = INFLUX_BUFS_DEFAULT;
+    if (influx->batch_ms < 0 || (int)influx->batch_size < 0) {
+        print_log(LOG_FATAL, __func__, "Invalid batch option.");
+        exit(1);
+    }
+#ifndef ZLIB
+    if (influx->gzip) {
+        print_log(LOG_FATAL, __func__, "influx gzip not available");
+        exit(1);
+    }
+#endif
+
+    // the precision is taken from the URL if given there
+    char const *url_precision = strstr(url, "precision=");
+    if (url_precision)
+        precision = url_precision + 10;
+    influx->precision = precision ? influx_parse_precision(precision) : 9;
+    if (influx->precision < 0) {
+        print_logf(LOG_FATAL, __func__, "Invalid precision \"%s\", use s, ms, us, or ns.", precision);
+        exit(1);
+    }
+    char url_buf[sizeof(influx->url)];
+    if (precision && !url_precision) {
+        // the v1 API spells microseconds as "u"
+        int v2 = strstr(url, "/api/v2/") != NULL;
+        char const *p = influx->precision == 0 ? "s" : influx->precision == 3 ? "ms" : influx->precision == 6 ? (v2 ? "us" : "u") : "ns";
+        snprintf(url_buf, sizeof(url_buf), "%s&precision=%s", url, p);
+        url = url_buf;
+    }
+
     influx->output.print_data   = print_influx_data;
+    influx->output.output_stats = data_output_influx_stats;
     influx->output.print_array  = print_influx_array;
     influx->output.print_string = print_influx_string;
     influx->output.print_double = print_influx_double;
@@ -12,6 +12,7 @@
 #include "output_log.h"
 
 #include "data.h"
+#include "file_sink.h"
 #include "r_util.h"
 #include "fatal.h"
 
@@ -90,11 +91,11 @@ static void R_API_CALLCONV data_output_log_print(data_output_t *output, data_t *
     data_t *data_lvl = NULL;
     data_t *data_msg = NULL;
     for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "src"))
+        if (d->key_id == DATA_KEY_SRC)
             data_src = d;
-        else if (!strcmp(d->key, "lvl"))
+        else if (d->key_id == DATA_KEY_LVL)
             data_lvl = d;
-        else if (!strcmp(d->key, "msg"))
+        else if (d->key_id == DATA_KEY_MSG)
             data_msg = d;
     }
 
@@ -116,11 +117,11 @@ static void R_API_CALLCONV data_output_log_print(data_output_t *output, data_t *
 
     for (; data; data = data->next) {
         // skip logging keys
-        if (!strcmp(data->key, "time")
-                || !strcmp(data->key, "src")
-                || !strcmp(data->key, "lvl")
-                || !strcmp(data->key, "msg")
-                || !strcmp(data->key, "num_rows")) {
+        if (data->key_id == DATA_KEY_TIME
+                || data->key_id == DATA_KEY_SRC
+                || data->key_id == DATA_KEY_LVL
+                || data->key_id == DATA_KEY_MSG
+                || data->key_id == DATA_KEY_NUM_ROWS) {
             continue;
         }
 
@@ -131,7 +132,7 @@ static void R_API_CALLCONV data_output_log_print(data_output_t *output, data_t *
     }
 
     fputc('\n', log->file);
-    fflush(log->file);
+    file_sink_commit(log->file);
 }
 
 static void R_API_CALLCONV data_output_log_free(data_output_t *output)
@@ -16,6 +16,8 @@
 #include "logger.h"
 #include "fatal.h"
 #include "r_util.h"
+#include "sensor_table.h"
+#include "tls_session.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -25,17 +27,65 @@
 
 /* MQTT client abstraction */
 
+#define MQTT_BATCH_TOPICS_MAX 4096  ///< forget the coalesced topics beyond this many
+#define MQTT_SEND_MBUF_MAX 65536    ///< keep messages queued while the socket has this many bytes unsent
+#define MQTT_INFLIGHT_MAX 64        ///< QoS 1 messages waiting for the PUBACK
+#define MQTT_QUEUE_SIZE (4 << 20)   ///< default memory limit of the outbound queue
+
+/// An outbound message, the topic and the payload are allocated in one block.
+typedef struct mqtt_message {
+    char *topic;
+    char const *msg;
+    size_t len;
+    uint16_t message_id; ///< nonzero once published with QoS 1
+    int acked;           ///< the PUBACK arrived
+    int retain;          ///< publish retained regardless of the retain option
+} mqtt_message_t;
+
+/// A topic with the latest message not yet published.
+typedef struct mqtt_pending {
+    char *topic;
+    unsigned hash;
+    int dirty;   ///< msg is not published yet
+    char *msg;
+    size_t len;
+    size_t size; ///< allocated size of msg
+} mqtt_pending_t;
+
 typedef struct mqtt_client {
     struct mg_connect_opts connect_opts;
     struct mg_send_mqtt_handshake_opts mqtt_opts;
     struct mg_connection *conn;
+    tls_session_t tls; ///< the TLS session resumed on reconnects
     int prev_status;
     char address[253 + 6 + 1]; // dns max + port
     char client_id[256];
     uint16_t message_id;
     int publish_flags; // MG_MQTT_RETAIN | MG_MQTT_QOS(0)
+    int connected;     ///< the CONNACK arrived on conn
+    mqtt_message_t *queue; ///< ring of outbound messages, the first inflight are published
+    unsigned queue_slots;
+    unsigned queue_head;
+    unsigned queue_len;
+    unsigned queue_len_max;
+    unsigned inflight;     ///< published QoS 1 messages at the queue head
+    size_t queue_bytes;
+    size_t queue_size;     ///< memory limit of the queued messages
+    unsigned dropped;      ///< messages dropped on a full queue
+    int batch_ms;      ///< coalesce posts for this long, 0 to publish immediately
+    size_t batch_size; ///< publish the coalesced posts early above this many bytes
+    size_t batch_len;  ///< bytes of the coalesced posts
+    mqtt_pending_t *pending;
+    unsigned pending_len;
+    unsigned *pending_index; ///< open addressing hash of pending + 1, 0 is empty
+    unsigned index_size;     ///< power of two, at least twice MQTT_BATCH_TOPICS_MAX
 } mqtt_client_t;
 
+static void mqtt_client_flush(mqtt_client_t *ctx);
+static void mqtt_client_drain(mqtt_client_t *ctx);
+static void mqtt_client_ack(mqtt_client_t *ctx, uint16_t message_id);
+static void mqtt_client_disconnected(mqtt_client_t *ctx);
+
 static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
 {
     // note that while shutting down the ctx is NULL
@@ -61,8 +111,10 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
             if (ctx && ctx->prev_status != connect_status)
                 print_logf(LOG_WARNING, "MQTT", "MQTT connect error: %s", strerror(connect_status));
         }
-        if (ctx)
+        if (ctx) {
+            tls_session_connected(&ctx->tls, nc, connect_status);
             ctx->prev_status = connect_status;
+        }
         break;
     }
     case MG_EV_MQTT_CONNACK:
@@ -71,10 +123,26 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
         }
         else {
             print_log(LOG_NOTICE, "MQTT", "MQTT Connection established.");
+            if (ctx) {
+                ctx->connected = 1;
+                tls_session_keep(&ctx->tls, nc);
+                mqtt_client_drain(ctx); // messages queued while disconnected
+                mqtt_client_flush(ctx); // posts kept while disconnected
+            }
         }
         break;
+    case MG_EV_SEND:
+        if (ctx)
+            mqtt_client_drain(ctx);
+        break;
+    case MG_EV_TIMER:
+        if (ctx)
+            mqtt_client_flush(ctx);
+        break;
     case MG_EV_MQTT_PUBACK:
-        print_logf(LOG_NOTICE, "MQTT", "MQTT Message publishing acknowledged (msg_id: %u)", msg->message_id);
+        print_logf(LOG_DEBUG, "MQTT", "MQTT Message publishing acknowledged (msg_id: %u)", msg->message_id);
+        if (ctx)
+            mqtt_client_ack(ctx, msg->message_id);
         break;
     case MG_EV_MQTT_SUBACK:
         print_log(LOG_NOTICE, "MQTT", "MQTT Subscription acknowledged.");
@@ -89,11 +157,14 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
             break; // shutting down
         if (ctx->prev_status == 0)
             print_log(LOG_WARNING, "MQTT", "MQTT Connection lost, reconnecting...");
-        // reconnect
+        tls_session_closed(&ctx->tls, nc);
+        mqtt_client_disconnected(ctx);
+        // reconnect, resuming the TLS session
         char const *error_string = NULL;
         ctx->connect_opts.error_string = &error_string;
         ctx->conn = mg_connect_opt(nc->mgr, ctx->address, mqtt_client_event, ctx->connect_opts);
         ctx->connect_opts.error_string = NULL;
+        tls_session_connect(&ctx->tls, ctx->conn);
         if (!ctx->conn) {
             print_logf(LOG_WARNING, "MQTT", "MQTT connect (%s) failed%s%s", ctx->address,
                     error_string ? ": " : "", error_string ? error_string : "");
@@ -102,12 +173,26 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
     }
 }
 
-static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts, char const *host, char const *port, char const *user, char const *pass, char const *client_id, int retain, int qos)
+static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts, char const *host, char const *port, char const *user, char const *pass, char const *client_id, int retain, int qos, int batch_ms, size_t batch_size, size_t queue_size)
 {
     mqtt_client_t *ctx = calloc(1, sizeof(*ctx));
     if (!ctx)
         FATAL_CALLOC("mqtt_client_init()");
 
+    ctx->queue_size = queue_size;
+
+    if (batch_ms > 0) {
+        ctx->batch_ms   = batch_ms;
+        ctx->batch_size = batch_size;
+        ctx->pending    = calloc(MQTT_BATCH_TOPICS_MAX, sizeof(*ctx->pending));
+        if (!ctx->pending)
+            FATAL_CALLOC("mqtt_client_init()");
+        ctx->index_size    = 2 * MQTT_BATCH_TOPICS_MAX;
+        ctx->pending_index = calloc(ctx->index_size, sizeof(*ctx->pending_index));
+        if (!ctx->pending_index)
+            FATAL_CALLOC("mqtt_client_init()");
+    }
+
     ctx->mqtt_opts.user_name = user;
     ctx->mqtt_opts.password  = pass;
     ctx->publish_flags  = MG_MQTT_QOS(qos) | (retain ? MG_MQTT_RETAIN : 0);
@@ -157,6 +242,7 @@ static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts,
     ctx->connect_opts.error_string = &error_string;
     ctx->conn = mg_connect_opt(mgr, ctx->address, mqtt_client_event, ctx->connect_opts);
     ctx->connect_opts.error_string = NULL;
+    tls_session_connect(&ctx->tls, ctx->conn);
     if (!ctx->conn) {
         print_logf(LOG_FATAL, "MQTT", "MQTT connect (%s) failed%s%s", ctx->address,
                 error_string ? ": " : "", error_string ? error_string : "");
@@ -166,21 +252,262 @@ static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts,
     return ctx;
 }
 
+/// Publish a message now with extra flags (MG_MQTT_DUP, MG_MQTT_RETAIN), returns the message id.
+static uint16_t mqtt_client_send(mqtt_client_t *ctx, char const *topic, void const *msg, size_t len, int flags)
+{
+    ctx->message_id++;
+    if (!ctx->message_id)
+        ctx->message_id++; // zero is not a valid id
+    mg_mqtt_publish(ctx->conn, topic, ctx->message_id, ctx->publish_flags | flags, msg, len);
+    return ctx->message_id;
+}
+
+static void mqtt_client_pop(mqtt_client_t *ctx)
+{
+    mqtt_message_t *m = &ctx->queue[ctx->queue_head];
+    ctx->queue_bytes -= strlen(m->topic) + 1 + m->len;
+    free(m->topic);
+    *m = (mqtt_message_t){0};
+    ctx->queue_head = (ctx->queue_head + 1) % ctx->queue_slots;
+    ctx->queue_len--;
+    if (ctx->inflight)
+        ctx->inflight--;
+}
+
+/// Append a message to the outbound queue, drops the oldest unpublished messages if the queue is full.
+static void mqtt_client_enqueue(mqtt_client_t *ctx, char const *topic, void const *msg, size_t len, int retain)
+{
+    size_t topic_len = strlen(topic);
+    size_t need      = topic_len + 1 + len;
+    while (!ctx->inflight && ctx->queue_len && ctx->queue_bytes + need > ctx->queue_size) {
+        mqtt_client_pop(ctx);
+        ctx->dropped++;
+    }
+    if (ctx->queue_bytes + need > ctx->queue_size) {
+        ctx->dropped++;
+        return;
+    }
+
+    if (ctx->queue_len == ctx->queue_slots) {
+        unsigned slots = ctx->queue_slots ? ctx->queue_slots * 2 : 64;
+        mqtt_message_t *queue = calloc(slots, sizeof(*queue));
+        if (!queue) {
+            WARN_CALLOC("mqtt_client_enqueue()");
+            ctx->dropped++;
+            return; // NOTE: drops the message on alloc failure.
+        }
+        for (unsigned i = 0; i < ctx->queue_len; ++i)
+            queue[i] = ctx->queue[(ctx->queue_head + i) % ctx->queue_slots];
+        free(ctx->queue);
+        ctx->queue       = queue;
+        ctx->queue_slots = slots;
+        ctx->queue_head  = 0;
+    }
+
+    char *block = malloc(need);
+    if (!block) {
+        WARN_MALLOC("mqtt_client_enqueue()");
+        ctx->dropped++;
+        return; // NOTE: drops the message on alloc failure.
+    }
+    memcpy(block, topic, topic_len + 1);
+    memcpy(block + topic_len + 1, msg, len);
+
+    mqtt_message_t *m = &ctx->queue[(ctx->queue_head + ctx->queue_len) % ctx->queue_slots];
+    *m = (mqtt_message_t){.topic = block, .msg = block + topic_len + 1, .len = len, .retain = retain};
+    ctx->queue_len++;
+    ctx->queue_bytes += need;
+    if (ctx->queue_len > ctx->queue_len_max)
+        ctx->queue_len_max = ctx->queue_len;
+}
+
+/// Publish queued messages while connected and the socket keeps up.
+static void mqtt_client_drain(mqtt_client_t *ctx)
+{
+    int qos = MG_MQTT_GET_QOS(ctx->publish_flags);
+    while (ctx->connected && ctx->queue_len > ctx->inflight
+            && ctx->conn->send_mbuf.len < MQTT_SEND_MBUF_MAX
+            && (!qos || ctx->inflight < MQTT_INFLIGHT_MAX)) {
+        mqtt_message_t *m = &ctx->queue[(ctx->queue_head + ctx->inflight) % ctx->queue_slots];
+        int flags         = (m->message_id ? MG_MQTT_DUP : 0) | (m->retain ? MG_MQTT_RETAIN : 0);
+        uint16_t id       = mqtt_client_send(ctx, m->topic, m->msg, m->len, flags);
+        if (!qos) {
+            mqtt_client_pop(ctx);
+        }
+        else {
+            m->message_id = id;
+            m->acked      = 0;
+            ctx->inflight++;
+        }
+    }
+}
+
+/// Release the acknowledged QoS 1 messages from the head of the queue.
+static void mqtt_client_ack(mqtt_client_t *ctx, uint16_t message_id)
+{
+    for (unsigned i = 0; i < ctx->inflight; ++i) {
+        mqtt_message_t *m = &ctx->queue[(ctx->queue_head + i) % ctx->queue_slots];
+        if (m->message_id == message_id) {
+            m->acked = 1;
+            break;
+        }
+    }
+    while (ctx->inflight && ctx->queue[ctx->queue_head].acked)
+        mqtt_client_pop(ctx);
+    mqtt_client_drain(ctx);
+}
+
+/// Unacknowledged messages are published again after a reconnect.
+static void mqtt_client_disconnected(mqtt_client_t *ctx)
+{
+    ctx->connected = 0;
+    ctx->inflight  = 0;
+}
+
+/// Publish a message, retained if @p retain is set or with the retain option.
+static void mqtt_client_publish_retain(mqtt_client_t *ctx, char const *topic, void const *msg, size_t len, int retain)
+{
+    // publish directly if nothing is queued and no PUBACK needs to be tracked
+    if (ctx->connected && !ctx->queue_len && !MG_MQTT_GET_QOS(ctx->publish_flags)
+            && ctx->conn->send_mbuf.len < MQTT_SEND_MBUF_MAX) {
+        mqtt_client_send(ctx, topic, msg, len, retain ? MG_MQTT_RETAIN : 0);
+        return;
+    }
+
+    mqtt_client_enqueue(ctx, topic, msg, len, retain);
+    mqtt_client_drain(ctx);
+}
+
+static void mqtt_client_publish_len(mqtt_client_t *ctx, char const *topic, void const *msg, size_t len)
+{
+    mqtt_client_publish_retain(ctx, topic, msg, len, 0);
+}
+
 static void mqtt_client_publish(mqtt_client_t *ctx, char const *topic, char const *str)
 {
-    if (!ctx->conn || !ctx->conn->proto_handler)
+    mqtt_client_publish_len(ctx, topic, str, strlen(str));
+}
+
+/// Publish the pending posts, keeps them while not connected.
+static void mqtt_client_flush(mqtt_client_t *ctx)
+{
+    if (!ctx->batch_len)
+        return;
+    if (!ctx->connected) {
+        if (ctx->conn && ctx->conn->ev_timer_time == 0)
+            mg_set_timer(ctx->conn, mg_time() + ctx->batch_ms / 1000.0);
         return;
+    }
 
-    ctx->message_id++;
-    mg_mqtt_publish(ctx->conn, topic, ctx->message_id, ctx->publish_flags, str, strlen(str));
+    for (unsigned i = 0; i < ctx->pending_len; ++i) {
+        mqtt_pending_t *p = &ctx->pending[i];
+        if (p->dirty)
+            mqtt_client_publish_len(ctx, p->topic, p->msg, p->len);
+        p->dirty = 0;
+    }
+    ctx->batch_len = 0;
+}
+
+/// Forget all coalesced topics, pending posts are dropped.
+static void mqtt_client_clear(mqtt_client_t *ctx)
+{
+    for (unsigned i = 0; i < ctx->pending_len; ++i) {
+        free(ctx->pending[i].topic);
+        free(ctx->pending[i].msg);
+    }
+    memset(ctx->pending, 0, ctx->pending_len * sizeof(*ctx->pending));
+    memset(ctx->pending_index, 0, ctx->index_size * sizeof(*ctx->pending_index));
+    ctx->pending_len = 0;
+    ctx->batch_len   = 0;
+}
+
+/// Find or add the pending post of a topic.
+static mqtt_pending_t *mqtt_client_pending(mqtt_client_t *ctx, char const *topic)
+{
+    unsigned hash = 2166136261u; // FNV-1a
+    for (char const *p = topic; *p; ++p)
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+
+    unsigned mask = ctx->index_size - 1;
+    unsigned slot = hash & mask;
+    for (; ctx->pending_index[slot]; slot = (slot + 1) & mask) {
+        mqtt_pending_t *p = &ctx->pending[ctx->pending_index[slot] - 1];
+        if (p->hash == hash && !strcmp(p->topic, topic))
+            return p;
+    }
+
+    if (ctx->pending_len >= MQTT_BATCH_TOPICS_MAX) {
+        mqtt_client_flush(ctx);
+        mqtt_client_clear(ctx);
+        return mqtt_client_pending(ctx, topic);
+    }
+    mqtt_pending_t *p = &ctx->pending[ctx->pending_len];
+    p->topic = strdup(topic);
+    if (!p->topic) {
+        WARN_STRDUP("mqtt_client_pending()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    p->hash = hash;
+    ctx->pending_index[slot] = ++ctx->pending_len;
+    return p;
+}
+
+/// Post a message to be published, coalesced with later posts to the same topic if batching.
+static void mqtt_client_post(mqtt_client_t *ctx, char const *topic, char const *str)
+{
+    if (!ctx->batch_ms) {
+        mqtt_client_publish(ctx, topic, str);
+        return;
+    }
+
+    mqtt_pending_t *p = mqtt_client_pending(ctx, topic);
+    if (!p)
+        return; // NOTE: skip output on alloc failure.
+
+    size_t len = strlen(str);
+    if (len >= p->size) {
+        char *msg = realloc(p->msg, len + 1);
+        if (!msg) {
+            WARN_REALLOC("mqtt_client_post()");
+            return; // NOTE: skip output on alloc failure.
+        }
+        p->msg  = msg;
+        p->size = len + 1;
+    }
+    memcpy(p->msg, str, len + 1);
+    if (p->dirty)
+        ctx->batch_len -= p->len;
+    else
+        ctx->batch_len += strlen(topic);
+    ctx->batch_len += len;
+    p->len   = len;
+    p->dirty = 1;
+
+    if (ctx->batch_len >= ctx->batch_size)
+        mqtt_client_flush(ctx);
+    else if (ctx->conn && ctx->conn->ev_timer_time == 0)
+        mg_set_timer(ctx->conn, mg_time() + ctx->batch_ms / 1000.0);
 }
 
 static void mqtt_client_free(mqtt_client_t *ctx)
 {
-    if (ctx && ctx->conn) {
+    if (!ctx)
+        return;
+
+    tls_session_clear(&ctx->tls, ctx->conn);
+    if (ctx->conn) {
         ctx->conn->user_data = NULL;
         ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
     }
+    if (ctx->pending) {
+        mqtt_client_clear(ctx);
+        free(ctx->pending);
+        free(ctx->pending_index);
+    }
+    while (ctx->queue_len) {
+        mqtt_client_pop(ctx);
+    }
+    free(ctx->queue);
     free(ctx);
 }
 
@@ -196,6 +523,119 @@ static char *mqtt_sanitize_topic(char *topic)
     return topic;
 }
 
+/* Topic templates */
+
+/// Tokens of a topic template, the record tokens are looked up by key id.
+enum mqtt_token {
+    MQTT_TOKEN_NONE, ///< literal text only
+    MQTT_TOKEN_HOSTNAME,
+    MQTT_TOKEN_TYPE,
+    MQTT_TOKEN_MODEL,
+    MQTT_TOKEN_SUBTYPE,
+    MQTT_TOKEN_CHANNEL,
+    MQTT_TOKEN_ID,
+    MQTT_TOKEN_PROTOCOL, // NOTE: needs "-M protocol"
+    MQTT_TOKEN_COUNT,
+};
+
+/// A literal followed by an optional token of a topic template.
+typedef struct mqtt_topic_segment {
+    char const *literal; ///< text before the token, not terminated
+    size_t literal_len;
+    int token;           ///< enum mqtt_token
+    char slash;          ///< leading character if the token expands, or 0
+    char const *def;     ///< default if the token is missing, not terminated, or NULL
+    size_t def_len;
+} mqtt_topic_segment_t;
+
+/// A compiled topic template, the segments point into the template string.
+typedef struct mqtt_topic {
+    mqtt_topic_segment_t *segments;
+    unsigned num_segments;
+    unsigned tokens; ///< mask of the record tokens used
+} mqtt_topic_t;
+
+/// Compile a topic template of literals and tokens like "[/model]" or "[id:none]", exits on errors.
+static void mqtt_topic_compile(mqtt_topic_t *topic, char const *format)
+{
+    *topic = (mqtt_topic_t){0};
+    if (!format)
+        return;
+
+    // one segment per token and one for trailing literal text
+    unsigned max_segments = 1;
+    for (char const *p = format; *p; ++p)
+        max_segments += *p == '[';
+    topic->segments = calloc(max_segments, sizeof(*topic->segments));
+    if (!topic->segments)
+        FATAL_CALLOC("mqtt_topic_compile()");
+
+    // consume entire format string
+    while (*format) {
+        mqtt_topic_segment_t *seg = &topic->segments[topic->num_segments++];
+        char const *t_start = NULL;
+        char const *t_end   = NULL;
+        // copy until '['
+        seg->literal = format;
+        while (*format && *format != '[')
+            format++;
+        seg->literal_len = format - seg->literal;
+        // skip '['
+        if (!*format)
+            break;
+        ++format;
+        // read slash
+        if (*format && (*format < 'a' || *format > 'z')) {
+            seg->slash = *format;
+            format++;
+        }
+        // read key until : or ]
+        t_start = t_end = format;
+        while (*format && *format != ':' && *format != ']' && *format != '[')
+            t_end = ++format;
+        // read default until ]
+        if (*format == ':') {
+            seg->def = ++format;
+            while (*format && *format != ']' && *format != '[')
+                ++format;
+            seg->def_len = format - seg->def;
+        }
+        // check for proper closing
+        if (*format != ']') {
+            print_log(LOG_FATAL, __func__, "unterminated token");
+            exit(1);
+        }
+        ++format;
+
+        // resolve token
+        if (!strncmp(t_start, "hostname", t_end - t_start))
+            seg->token = MQTT_TOKEN_HOSTNAME;
+        else if (!strncmp(t_start, "type", t_end - t_start))
+            seg->token = MQTT_TOKEN_TYPE;
+        else if (!strncmp(t_start, "model", t_end - t_start))
+            seg->token = MQTT_TOKEN_MODEL;
+        else if (!strncmp(t_start, "subtype", t_end - t_start))
+            seg->token = MQTT_TOKEN_SUBTYPE;
+        else if (!strncmp(t_start, "channel", t_end - t_start))
+            seg->token = MQTT_TOKEN_CHANNEL;
+        else if (!strncmp(t_start, "id", t_end - t_start))
+            seg->token = MQTT_TOKEN_ID;
+        else if (!strncmp(t_start, "protocol", t_end - t_start))
+            seg->token = MQTT_TOKEN_PROTOCOL;
+        else {
+            print_logf(LOG_FATAL, __func__, "unknown token \"%.*s\"", (int)(t_end - t_start), t_start);
+            exit(1);
+        }
+        topic->tokens |= 1u << seg->token;
+    }
+}
+
+static void mqtt_topic_free(mqtt_topic_t *topic)
+{
+    free(topic->segments);
+    *topic = (mqtt_topic_t){0};
+}
+
 /* MQTT printer */
 
 typedef struct {
@@ -206,6 +646,14 @@ typedef struct {
     char *devices;
     char *events;
     char *states;
+    char *sensors;
+    mqtt_topic_t devices_topic;
+    mqtt_topic_t events_topic;
+    mqtt_topic_t states_topic;
+    mqtt_topic_t sensors_topic;
+    sensor_table_t table; ///< the sensors with a retained message on the sensors topic
+    int cbor;             ///< post CBOR instead of JSON to events and states
+    data_render_t render; ///< used if the rendering is not shared, the buffers are reused
     //char *homie;
     //char *hass;
 } data_output_mqtt_t;
@@ -240,105 +688,108 @@ static char *append_topic(char *topic, data_t *data)
     return topic;
 }
 
-static char *expand_topic(char *topic, char const *format, data_t *data, char const *hostname)
+/// Expand a compiled topic template for a record, only substituted data is sanitized.
+static char *expand_topic(char *topic, mqtt_topic_t const *tpl, data_t *data, char const *hostname)
 {
     // collect well-known top level keys
-    data_t *data_type    = NULL;
-    data_t *data_model   = NULL;
-    data_t *data_subtype = NULL;
-    data_t *data_channel = NULL;
-    data_t *data_id      = NULL;
-    data_t *data_protocol = NULL;
-    for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "type"))
-            data_type = d;
-        else if (!strcmp(d->key, "model"))
-            data_model = d;
-        else if (!strcmp(d->key, "subtype"))
-            data_subtype = d;
-        else if (!strcmp(d->key, "channel"))
-            data_channel = d;
-        else if (!strcmp(d->key, "id"))
-            data_id = d;
-        else if (!strcmp(d->key, "protocol")) // NOTE: needs "-M protocol"
-            data_protocol = d;
-    }
-
-    // consume entire format string
-    while (format && *format) {
-        data_t *data_token  = NULL;
-        char const *string_token = NULL;
-        int leading_slash   = 0;
-        char const *t_start = NULL;
-        char const *t_end   = NULL;
-        char const *d_start = NULL;
-        char const *d_end   = NULL;
-        // copy until '['
-        while (*format && *format != '[')
-            *topic++ = *format++;
-        // skip '['
-        if (!*format)
+    data_t *tokens[MQTT_TOKEN_COUNT] = {0};
+    unsigned data_tokens = tpl->tokens & ~(1u << MQTT_TOKEN_HOSTNAME);
+    for (data_t *d = data; data_tokens && d; d = d->next) {
+        switch (d->key_id) {
+        case DATA_KEY_TYPE:
+            tokens[MQTT_TOKEN_TYPE] = d;
+            break;
+        case DATA_KEY_MODEL:
+            tokens[MQTT_TOKEN_MODEL] = d;
+            break;
+        case DATA_KEY_SUBTYPE:
+            tokens[MQTT_TOKEN_SUBTYPE] = d;
+            break;
+        case DATA_KEY_CHANNEL:
+            tokens[MQTT_TOKEN_CHANNEL] = d;
+            break;
+        case DATA_KEY_ID:
+            tokens[MQTT_TOKEN_ID] = d;
+            break;
+        case DATA_KEY_PROTOCOL:
+            tokens[MQTT_TOKEN_PROTOCOL] = d;
             break;
-        ++format;
-        // read slash
-        if (!leading_slash && (*format < 'a' || *format > 'z')) {
-            leading_slash = *format;
-            format++;
-        }
-        // read key until : or ]
-        t_start = t_end = format;
-        while (*format && *format != ':' && *format != ']' && *format != '[')
-            t_end = ++format;
-        // read default until ]
-        if (*format == ':') {
-            d_start = d_end = ++format;
-            while (*format && *format != ']' && *format != '[')
-                d_end = ++format;
-        }
-        // check for proper closing
-        if (*format != ']') {
-            print_log(LOG_FATAL, __func__, "unterminated token");
-            exit(1);
         }
-        ++format;
+    }
 
-        // resolve token
-        if (!strncmp(t_start, "hostname", t_end - t_start))
-            string_token = hostname;
-        else if (!strncmp(t_start, "type", t_end - t_start))
-            data_token = data_type;
-        else if (!strncmp(t_start, "model", t_end - t_start))
-            data_token = data_model;
-        else if (!strncmp(t_start, "subtype", t_end - t_start))
-            data_token = data_subtype;
-        else if (!strncmp(t_start, "channel", t_end - t_start))
-            data_token = data_channel;
-        else if (!strncmp(t_start, "id", t_end - t_start))
-            data_token = data_id;
-        else if (!strncmp(t_start, "protocol", t_end - t_start))
-            data_token = data_protocol;
-        else {
-            print_logf(LOG_FATAL, __func__, "unknown token \"%.*s\"", (int)(t_end - t_start), t_start);
-            exit(1);
-        }
+    for (unsigned i = 0; i < tpl->num_segments; ++i) {
+        mqtt_topic_segment_t const *seg = &tpl->segments[i];
+        memcpy(topic, seg->literal, seg->literal_len);
+        topic += seg->literal_len;
+        if (seg->token == MQTT_TOKEN_NONE)
+            continue;
 
         // append token or default
-        if (!data_token && !string_token && !d_start)
+        data_t *data_token = tokens[seg->token];
+        int string_token   = seg->token == MQTT_TOKEN_HOSTNAME;
+        if (!data_token && !string_token && !seg->def)
             continue;
-        if (leading_slash)
-            *topic++ = leading_slash;
-        if (data_token)
+        if (seg->slash)
+            *topic++ = seg->slash;
+        if (data_token) {
             topic = append_topic(topic, data_token);
-        else if (string_token)
-            topic += sprintf(topic, "%s", string_token);
-        else
-            topic += sprintf(topic, "%.*s", (int)(d_end - d_start), d_start);
+        }
+        else if (string_token) {
+            size_t len = strlen(hostname);
+            memcpy(topic, hostname, len);
+            topic += len;
+        }
+        else {
+            memcpy(topic, seg->def, seg->def_len);
+            topic += seg->def_len;
+        }
     }
 
     *topic = '\0';
     return topic;
 }
 
+/// Publish the JSON or CBOR of a record to the current topic.
+static void mqtt_publish_record(data_output_mqtt_t *mqtt, data_t *data, int retain)
+{
+    data_render_t *render = mqtt->output.render;
+    if (!render || render->data != data) {
+        render = &mqtt->render;
+        data_render_start(render, data);
+    }
+
+    size_t len;
+    void const *message;
+    if (mqtt->cbor)
+        message = data_render_cbor(render, data, &len);
+    else
+        message = data_render_jsons(render, data, &len);
+    if (message)
+        mqtt_client_publish_retain(mqtt->mqc, mqtt->topic, message, len, retain);
+
+    data_render_start(&mqtt->render, NULL);
+}
+
+/// Publish the retained last event of a sensor, clears the retained message of a sensor evicted from the table.
+static void mqtt_publish_sensor(data_output_mqtt_t *mqtt, data_t *data)
+{
+    data_t *evicted;
+    sensor_entry_t const *entry = sensor_table_update(&mqtt->table, data, mg_time(), &evicted);
+    if (evicted) {
+        expand_topic(mqtt->topic, &mqtt->sensors_topic, evicted, mqtt->hostname);
+        mqtt_client_publish_retain(mqtt->mqc, mqtt->topic, "", 0, 1);
+        data_free(evicted);
+    }
+    if (!entry)
+        return;
+
+    data_t *record = sensor_entry_data(entry);
+    expand_topic(mqtt->topic, &mqtt->sensors_topic, data, mqtt->hostname);
+    mqtt_publish_record(mqtt, record, 1);
+    *mqtt->topic = '\0'; // clear topic
+    data_free(record);
+}
+
 // <prefix>[/type][/model][/subtype][/channel][/id]/battery: "OK"|"LOW"
 static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data, char const *format)
 {
@@ -347,55 +798,51 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
 
     char *orig = mqtt->topic + strlen(mqtt->topic); // save current topic
     char *end  = orig;
+    data_skip_t const *skip = *mqtt->topic ? NULL : output->skip; // projected on the top-level only
 
     // top-level only
     if (!*mqtt->topic) {
         // collect well-known top level keys
         data_t *data_model = NULL;
         for (data_t *d = data; d; d = d->next) {
-            if (!strcmp(d->key, "model"))
+            if (d->key_id == DATA_KEY_MODEL)
                 data_model = d;
         }
 
         // "states" topic
         if (!data_model) {
             if (mqtt->states) {
-                size_t message_size = 20000; // state message need a large buffer
-                char *message       = malloc(message_size);
-                if (!message) {
-                    WARN_MALLOC("print_mqtt_data()");
-                    return; // NOTE: skip output on alloc failure.
-                }
-                data_print_jsons(data, message, message_size);
-                expand_topic(mqtt->topic, mqtt->states, data, mqtt->hostname);
-                mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
+                expand_topic(mqtt->topic, &mqtt->states_topic, data, mqtt->hostname);
+                mqtt_publish_record(mqtt, data, 0);
                 *mqtt->topic = '\0'; // clear topic
-                free(message);
             }
             return;
         }
 
         // "events" topic
         if (mqtt->events) {
-            char message[2048]; // we expect the biggest strings to be around 500 bytes.
-            data_print_jsons(data, message, sizeof(message));
-            expand_topic(mqtt->topic, mqtt->events, data, mqtt->hostname);
-            mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
+            expand_topic(mqtt->topic, &mqtt->events_topic, data, mqtt->hostname);
+            mqtt_publish_record(mqtt, data, 0);
             *mqtt->topic = '\0'; // clear topic
         }
 
+        // "sensors" topic
+        if (mqtt->sensors)
+            mqtt_publish_sensor(mqtt, data);
+
         // "devices" topic
         if (!mqtt->devices) {
             return;
         }
 
-        end = expand_topic(mqtt->topic, mqtt->devices, data, mqtt->hostname);
+        end = expand_topic(mqtt->topic, &mqtt->devices_topic, data, mqtt->hostname);
     }
 
     while (data) {
-        if (!strcmp(data->key, "type")
-                || !strcmp(data->key, "model")
-                || !strcmp(data->key, "subtype")) {
+        if (data->key_id == DATA_KEY_TYPE
+                || data->key_id == DATA_KEY_MODEL
+                || data->key_id == DATA_KEY_SUBTYPE
+                || data_skip(skip, data)) {
             // skip, except "id", "channel"
         }
         else {
@@ -414,7 +861,7 @@ static void R_API_CALLCONV print_mqtt_string(data_output_t *output, char const *
 {
     UNUSED(format);
     data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
-    mqtt_client_publish(mqtt->mqc, mqtt->topic, str);
+    mqtt_client_post(mqtt->mqc, mqtt->topic, str);
 }
 
 static void R_API_CALLCONV print_mqtt_double(data_output_t *output, double data, char const *format)
@@ -453,14 +900,38 @@ static void R_API_CALLCONV data_output_mqtt_free(data_output_t *output)
     free(mqtt->devices);
     free(mqtt->events);
     free(mqtt->states);
+    free(mqtt->sensors);
+    mqtt_topic_free(&mqtt->devices_topic);
+    mqtt_topic_free(&mqtt->events_topic);
+    mqtt_topic_free(&mqtt->states_topic);
+    mqtt_topic_free(&mqtt->sensors_topic);
+    sensor_table_free(&mqtt->table);
     //free(mqtt->homie);
     //free(mqtt->hass);
 
     mqtt_client_free(mqtt->mqc);
+    data_render_free(&mqtt->render);
 
     free(mqtt);
 }
 
+static data_t *R_API_CALLCONV data_output_mqtt_stats(data_output_t *output)
+{
+    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
+    mqtt_client_t *ctx       = mqtt->mqc;
+
+    data_t *data = data_make(
+            "connected",        "", DATA_INT, ctx->connected,
+            "queue",            "", DATA_INT, ctx->queue_len,
+            "queue_max",        "", DATA_INT, ctx->queue_len_max,
+            "queue_bytes",      "", DATA_INT, (int)ctx->queue_bytes,
+            "queue_size",       "", DATA_INT, (int)ctx->queue_size,
+            "inflight",         "", DATA_INT, ctx->inflight,
+            "dropped",          "", DATA_INT, ctx->dropped,
+            NULL);
+    return tls_session_stats(&ctx->tls, data);
+}
+
 static char *mqtt_topic_default(char const *topic, char const *base, char const *suffix)
 {
     char path[256];
@@ -513,12 +984,17 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
     char const *path_devices = "devices[/type][/model][/subtype][/channel][/id]";
     char const *path_events = "events";
     char const *path_states = "states";
+    char const *path_sensors = "sensors[/model][/channel][/id]";
 
     // get user and pass from env vars if available.
     char *user = getenv("MQTT_USERNAME");
     char *pass = getenv("MQTT_PASSWORD");
     int retain = 0;
     int qos = 0;
+    int batch_ms = 0;
+    int batch_size = 16384;
+    int queue_size = MQTT_QUEUE_SIZE;
+    int sensors_max = SENSOR_TABLE_DEFAULT;
 
     // parse host and port
     tls_opts_t tls_opts = {0};
@@ -546,6 +1022,14 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
             retain = atobv(val, 1);
         else if (!strcasecmp(key, "q") || !strcasecmp(key, "qos"))
             qos = atoiv(val, 1);
+        else if (!strcasecmp(key, "cbor"))
+            mqtt->cbor = atobv(val, 1);
+        else if (!strcasecmp(key, "batch"))
+            batch_ms = atoiv(val, 1000);
+        else if (!strcasecmp(key, "batch_size"))
+            batch_size = atoiv(val, batch_size);
+        else if (!strcasecmp(key, "queue_size"))
+            queue_size = atoiv(val, queue_size);
         else if (!strcasecmp(key, "b") || !strcasecmp(key, "base"))
             base_topic = val;
         // Simple key-topic mapping
@@ -566,6 +1050,11 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
         // JSON states to single topic
         else if (!strcasecmp(key, "s") || !strcasecmp(key, "states"))
             mqtt->states = mqtt_topic_default(val, base_topic, path_states);
+        // retained last event per sensor
+        else if (!strcasecmp(key, "sensors"))
+            mqtt->sensors = mqtt_topic_default(val, base_topic, path_sensors);
+        else if (!strcasecmp(key, "sensors_max"))
+            sensors_max = atoiv(val, SENSOR_TABLE_DEFAULT);
         // TODO: Homie Convention https://homieiot.github.io/
         //else if (!strcasecmp(key, "o") || !strcasecmp(key, "homie"))
         //    mqtt->homie = mqtt_topic_default(val, NULL, "homie"); // base topic
@@ -582,26 +1071,39 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
     }
 
     // Default is to use all formats
-    if (!mqtt->devices && !mqtt->events && !mqtt->states) {
+    if (!mqtt->devices && !mqtt->events && !mqtt->states && !mqtt->sensors) {
         mqtt->devices = mqtt_topic_default(NULL, base_topic, path_devices);
         mqtt->events  = mqtt_topic_default(NULL, base_topic, path_events);
         mqtt->states  = mqtt_topic_default(NULL, base_topic, path_states);
     }
+    mqtt_topic_compile(&mqtt->devices_topic, mqtt->devices);
+    mqtt_topic_compile(&mqtt->events_topic, mqtt->events);
+    mqtt_topic_compile(&mqtt->states_topic, mqtt->states);
+    mqtt_topic_compile(&mqtt->sensors_topic, mqtt->sensors);
+    if (mqtt->sensors && (sensors_max < 1 || sensor_table_init(&mqtt->table, (unsigned)sensors_max) < 0)) {
+        print_log(LOG_FATAL, "MQTT", "Invalid sensors_max option.");
+        exit(1);
+    }
     if (mqtt->devices)
         print_logf(LOG_NOTICE, "MQTT", "Publishing device info to MQTT topic \"%s\".", mqtt->devices);
     if (mqtt->events)
         print_logf(LOG_NOTICE, "MQTT", "Publishing events info to MQTT topic \"%s\".", mqtt->events);
     if (mqtt->states)
         print_logf(LOG_NOTICE, "MQTT", "Publishing states info to MQTT topic \"%s\".", mqtt->states);
+    if (mqtt->sensors)
+        print_logf(LOG_NOTICE, "MQTT", "Publishing retained sensor info to MQTT topic \"%s\".", mqtt->sensors);
+    if (mqtt->devices && batch_ms > 0)
+        print_logf(LOG_NOTICE, "MQTT", "Coalescing device info for %d ms or %d bytes.", batch_ms, batch_size);
 
     mqtt->output.print_data   = print_mqtt_data;
     mqtt->output.print_array  = print_mqtt_array;
     mqtt->output.print_string = print_mqtt_string;
     mqtt->output.print_double = print_mqtt_double;
     mqtt->output.print_int    = print_mqtt_int;
+    mqtt->output.output_stats = data_output_mqtt_stats;
     mqtt->output.output_free  = data_output_mqtt_free;
 
-    mqtt->mqc = mqtt_client_init(mgr, &tls_opts, host, port, user, pass, client_id, retain, qos);
+    mqtt->mqc = mqtt_client_init(mgr, &tls_opts, host, port, user, pass, client_id, retain, qos, batch_ms, batch_size, queue_size);
 
     return (struct data_output *)mqtt;
 }
@@ -13,6 +13,10 @@
 
 #include "rtl_433.h"
 #include "r_api.h"
+#include "r_private.h"
+#include "baseband.h"
+#include "iq_codec.h"
+#include "rtltcp_compress.h"
 #include "r_util.h"
 #include "optparse.h"
 #include "logger.h"
@@ -55,6 +59,10 @@
     #define closesocket(x)  close(x)
 #endif
 
+#ifdef _WIN32
+    #define SHUT_RDWR SD_BOTH
+#endif
+
 #include <time.h>
 
 #ifdef _WIN32
@@ -87,27 +95,76 @@ typedef SSIZE_T ssize_t;
 /* rtl_tcp server */
 
 // Only available if Threads are enabled.
-// Currently serves a maximum of 1 client connection.
-// The data backing from the SDR is assumed to be persistent, which is the case
-// since we never restart the SDR with different parameters or close it while active.
-// Should use shared memory for sendfile() someday.
+// Serves up to `clients` (default 4) client connections, each from its own thread.
+// The SDR reuses its buffers, so each frame is copied once into a ring of
+// refcounted frames shared by all clients. Every client has its own cursor
+// into the ring and sends straight from the shared frames. A client that falls
+// more than the ring length behind skips ahead to the newest frame, the
+// skipped frames are counted as overrun. The SDR thread never waits for clients.
+// A frame still being sent when its slot is reused stays alive until the
+// last client drops its reference, the slot then gets a new frame.
+// Clients can negotiate the compressed stream of rtltcp_compress.h, with
+// squelch a frame is only sent if it or a neighbouring frame is above the
+// squelch level, which needs a one frame lookahead. All other frames are
+// sent as skip chunks which keep the sample count.
 
 #ifdef THREADS
 
+#define RTLTCP_CLIENTS_DEFAULT 4
+#define RTLTCP_BUFFERS_DEFAULT 16
+#define RTLTCP_SEND_TIMEOUT 5 // seconds a client may block before it is dropped
+#define RTLTCP_SQUELCH_DEFAULT 5.0f // dB above the noise floor a frame needs to be sent to squelching clients
+#define RTLTCP_SQUELCH_BLOCK 256    // samples per level estimate, short bursts need to stand out
+
+typedef struct rtltcp_frame {
+    int refs;      ///< references held by the ring and by clients sending it
+    int active;    ///< the frame is above the squelch level
+    uint32_t size; ///< allocated data size in bytes
+    uint32_t len;  ///< data length in bytes
+    uint8_t data[];
+} rtltcp_frame_t;
+
+struct rtltcp_server;
+
+typedef struct rtltcp_client {
+    struct rtltcp_client *next;
+    struct rtltcp_server *srv;
+    SOCKET sock;
+    pthread_t thread;
+    int done;               ///< client thread has exited and can be joined
+    uint64_t cursor;        ///< sequence number of the next frame to send
+    uint64_t frames;        ///< frames sent
+    uint64_t overruns;      ///< number of times the client fell behind the ring
+    uint64_t frames_missed; ///< frames skipped on overruns
+    uint64_t frames_skipped; ///< frames left out by the squelch
+    unsigned compress_req;  ///< requested compression flags, 0 if none pending
+    unsigned compress;      ///< accepted compression flags
+    int prev_active;        ///< the previous frame was above the squelch level
+    uint8_t *zbuf;          ///< chunk send buffer for the compressed stream
+    char host[INET6_ADDRSTRLEN];
+    char port[NI_MAXSERV];
+} rtltcp_client_t;
+
 typedef struct rtltcp_server {
     struct sockaddr_storage addr;
     socklen_t addr_len;
     SOCKET sock;
     int client_count; ///< number of connected clients
+    int client_max;   ///< maximum number of connected clients
     int control;      ///< are clients allowed to change SDR parameters
+    int exit_server;  ///< set on stop, client threads exit
+    float squelch;    ///< squelch level in dB above the noise floor, 0 to never skip frames
+    float noise_db;   ///< estimated noise floor, SDR thread only
+
+    rtltcp_frame_t **ring; ///< ring of the most recent frames
+    unsigned ring_size;    ///< number of frames in the ring
+    uint64_t seq;          ///< sequence number of the next frame, the frame seq is in slot seq % ring_size
 
-    uint8_t const *data_buf; ///< data buffer with most recent data, NULL otherwise
-    uint32_t data_len;       ///< data buffer length in bytes, 0 otherwise
-    unsigned data_cnt;       ///< data buffer update counter
+    rtltcp_client_t *clients;
 
     pthread_t thread;
-    pthread_mutex_t lock; ///< lock for data buffer
-    pthread_cond_t cond;  ///< wait for data buffer
+    pthread_mutex_t lock; ///< lock for ring, clients, and counters
+    pthread_cond_t cond;  ///< broadcast on new frames and on stop
     r_cfg_t *cfg;
     struct raw_output *output;
 } rtltcp_server_t;
@@ -159,9 +216,10 @@ E.g. initialization from Gqrx:
 - RTLTCP_SET_FREQ  with 433968000
 */
 
-static int parse_command(r_cfg_t *cfg, int control, uint8_t const *buf, int len)
+static int parse_command(rtltcp_client_t *client, uint8_t const *buf, int len)
 {
-    UNUSED(cfg);
+    r_cfg_t *cfg = client->srv->cfg;
+    int control  = client->srv->control;
 
     if (len < 5)
         return 0;
@@ -224,6 +282,10 @@ static int parse_command(r_cfg_t *cfg, int control, uint8_t const *buf, int len)
     case RTLTCP_SET_BIAS_TEE:
         print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_BIAS_TEE with %u", arg);
         break;
+    case RTLTCP_SET_COMPRESSION:
+        print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_COMPRESSION with %u", arg);
+        client->compress_req = arg;
+        break;
     default:
         print_logf(LOG_WARNING, "rtl_tcp", "received unknown command %d with %u", cmd, arg);
         break;
@@ -232,21 +294,296 @@ static int parse_command(r_cfg_t *cfg, int control, uint8_t const *buf, int len)
     return 5;
 }
 
-// event handler to broadcast to all our sockets
+static void rtltcp_frame_unref(rtltcp_frame_t *frame)
+{
+    if (frame && --frame->refs <= 0)
+        free(frame);
+}
+
+// check a CU8 frame against the squelch level, tracks the noise floor
+static int rtltcp_frame_active(rtltcp_server_t *srv, uint8_t const *data, uint32_t len)
+{
+    float min_db = 100.0f;
+    float max_db = -100.0f;
+    uint32_t n_samples = len / 2;
+    for (uint32_t pos = 0; pos + RTLTCP_SQUELCH_BLOCK <= n_samples; pos += RTLTCP_SQUELCH_BLOCK) {
+        float db = DB_LEVEL_FLOAT(baseband_level_estimate_cu8(&data[pos * 2], RTLTCP_SQUELCH_BLOCK, 0, 2));
+        if (db < min_db)
+            min_db = db;
+        if (db > max_db)
+            max_db = db;
+    }
+    if (max_db < min_db)
+        return 1; // too short to tell
+
+    // the quietest block follows the noise floor, fast down and slowly up
+    if (srv->noise_db == 0.0f)
+        srv->noise_db = min_db;
+    else
+        srv->noise_db += (min_db - srv->noise_db) * (min_db < srv->noise_db ? 0.5f : 0.05f);
+
+    return max_db > srv->noise_db + srv->squelch;
+}
+
+// copy the frame into the next ring slot and wake all clients
 static void rtltcp_broadcast_send(rtltcp_server_t *srv, uint8_t const *data, uint32_t len)
 {
     // print_logf(LOG_TRACE, __func__, "%d byte frame", len);
     pthread_mutex_lock(&srv->lock);
+    if (!srv->client_count) {
+        // nobody is listening, just keep the sequence going
+        srv->seq += 1;
+        pthread_mutex_unlock(&srv->lock);
+        return;
+    }
+    // take the oldest frame out of the ring, lagging clients see an overrun
+    rtltcp_frame_t **slot = &srv->ring[srv->seq % srv->ring_size];
+    rtltcp_frame_t *frame = *slot;
+    *slot                 = NULL;
+    if (frame && (frame->refs > 1 || frame->size < len)) {
+        // still being sent by a client or too small, the last reference frees it
+        rtltcp_frame_unref(frame);
+        frame = NULL;
+    }
+    pthread_mutex_unlock(&srv->lock);
 
-    // update the data buffer reference
-    srv->data_buf = data;
-    srv->data_len = len;
-    srv->data_cnt += 1;
+    if (!frame) {
+        frame = malloc(sizeof(*frame) + len);
+        if (!frame) {
+            WARN_MALLOC("rtltcp_broadcast_send()");
+            pthread_mutex_lock(&srv->lock);
+            srv->seq += 1;
+            pthread_mutex_unlock(&srv->lock);
+            return; // NOTE: skip output on alloc failure.
+        }
+        frame->refs = 1;
+        frame->size = len;
+    }
+    memcpy(frame->data, data, len);
+    frame->len    = len;
+    frame->active = srv->squelch <= 0.0f || srv->cfg->demod->sample_size != 2 || rtltcp_frame_active(srv, data, len);
 
+    pthread_mutex_lock(&srv->lock);
+    srv->ring[srv->seq % srv->ring_size] = frame;
+    srv->seq += 1;
     pthread_mutex_unlock(&srv->lock);
-    pthread_cond_signal(&srv->cond);
-    // perhaps broadcast if we want to support multiple clients
-    //int pthread_cond_broadcast(&srv->cond);
+    pthread_cond_broadcast(&srv->cond);
+}
+
+// wait until the socket accepts more data, then send
+static ssize_t send_wait(SOCKET sock, void const *buf, size_t len)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval timeout = {.tv_sec = RTLTCP_SEND_TIMEOUT};
+
+    int ready = select(sock + 1, NULL, &fds, NULL, &timeout);
+    if (ready <= 0) {
+        print_log(LOG_ERROR, "rtl_tcp", "send not ready for write?");
+        return -1; // Cancel the connection on network problems
+    }
+
+    return send_all(sock, buf, len, MSG_NOSIGNAL); // ignore SIGPIPE
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// send a chunk of the compressed stream, the payload is already in place after the header
+static ssize_t send_chunk(SOCKET sock, uint8_t *chunk, int type, uint32_t samples, uint32_t payload_len)
+{
+    chunk[0] = (uint8_t)type;
+    chunk[1] = chunk[2] = chunk[3] = 0;
+    put_be32(&chunk[4], samples);
+    put_be32(&chunk[8], payload_len);
+    return send_wait(sock, chunk, RTLTCP_CHUNK_HEADER_LEN + payload_len);
+}
+
+// send a frame as chunks, coded if that is smaller
+static ssize_t send_frame_chunks(rtltcp_client_t *client, rtltcp_frame_t const *frame)
+{
+    uint8_t *payload = &client->zbuf[RTLTCP_CHUNK_HEADER_LEN];
+    for (uint32_t pos = 0; pos < frame->len; pos += RTLTCP_CHUNK_SAMPLES * 2) {
+        uint32_t len = frame->len - pos < RTLTCP_CHUNK_SAMPLES * 2 ? frame->len - pos : RTLTCP_CHUNK_SAMPLES * 2;
+        size_t coded_len = len;
+        if (client->compress & RTLTCP_COMPRESS_LOSSLESS)
+            coded_len = iq_codec_encode(&frame->data[pos], len, payload);
+        int type = RTLTCP_CHUNK_CODED;
+        if (coded_len >= len) {
+            memcpy(payload, &frame->data[pos], len);
+            coded_len = len;
+            type      = RTLTCP_CHUNK_RAW;
+        }
+        if (send_chunk(client->sock, client->zbuf, type, len / 2, (uint32_t)coded_len) < 0)
+            return -1;
+    }
+    return frame->len;
+}
+
+// accept a compression request, the stream switches after the sync
+static void accept_compression(rtltcp_client_t *client)
+{
+    rtltcp_server_t *srv = client->srv;
+    unsigned flags = client->compress_req & (RTLTCP_COMPRESS_LOSSLESS | RTLTCP_COMPRESS_SQUELCH);
+    client->compress_req = 0;
+    if (srv->squelch <= 0.0f)
+        flags &= ~RTLTCP_COMPRESS_SQUELCH;
+    if (client->compress || !flags || srv->cfg->demod->sample_size != 2) {
+        print_logf(LOG_NOTICE, "rtl_tcp", "client %s port %s compression declined", client->host, client->port);
+        return; // only CU8 is supported, the client keeps the plain stream
+    }
+
+    client->zbuf = malloc(RTLTCP_CHUNK_HEADER_LEN + iq_codec_bound(RTLTCP_CHUNK_SAMPLES * 2));
+    if (!client->zbuf) {
+        WARN_MALLOC("accept_compression()");
+        return; // NOTE: the client keeps the plain stream on alloc failure.
+    }
+
+    uint8_t sync[RTLTCP_SYNC_LEN] = RTLTCP_SYNC_MAGIC;
+    put_be32(&sync[RTLTCP_SYNC_MAGIC_LEN], flags);
+    send_all(client->sock, sync, sizeof(sync), MSG_NOSIGNAL); // ignore SIGPIPE
+    client->compress    = flags;
+    client->prev_active = 1; // start with a full frame
+    print_logf(LOG_NOTICE, "rtl_tcp", "client %s port %s compression%s%s", client->host, client->port,
+            flags & RTLTCP_COMPRESS_LOSSLESS ? " lossless" : "", flags & RTLTCP_COMPRESS_SQUELCH ? " squelch" : "");
+}
+
+static THREAD_RETURN THREAD_CALL client_thread(void *arg)
+{
+    rtltcp_client_t *client = arg;
+    rtltcp_server_t *srv    = client->srv;
+    SOCKET sock             = client->sock;
+
+    send_header(sock);
+
+    // Client loop
+    for (;;) {
+        // Read available commands
+        int abort = 0;
+        for (;;) {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(sock, &fds);
+            struct timeval timeout = {0};
+
+            int ready = select(sock + 1, &fds, NULL, NULL, &timeout);
+            if (ready <= 0)
+                break;
+
+            uint8_t buf[128] = {0};
+            ssize_t len = recv(sock, buf, sizeof(buf), 0);
+            //print_logf(LOG_TRACE, "rtl_tcp", "recv %zd bytes (%d)", len, ready);
+            if (len <= 0) {
+                abort = 1;
+                break;
+            }
+            int pos = 0;
+            while (pos + 5 <= len) {
+                pos += parse_command(client, & buf[pos], (int)len - pos);
+            }
+        }
+        if (abort) {
+            break;
+        }
+        if (client->compress_req) {
+            accept_compression(client);
+        }
+
+        // Wait for next frame, with squelch also for the one after it
+        unsigned lookahead = (client->compress & RTLTCP_COMPRESS_SQUELCH) && srv->ring_size > 1;
+        pthread_mutex_lock(&srv->lock);
+        while (srv->seq - client->cursor <= lookahead && !srv->exit_server)
+            pthread_cond_wait(&srv->cond, &srv->lock);
+        if (srv->exit_server) {
+            pthread_mutex_unlock(&srv->lock);
+            break;
+        }
+
+        // Get a reference to the frame, skip to the newest frame if it was overwritten
+        rtltcp_frame_t *frame = NULL;
+        if (srv->seq - client->cursor <= srv->ring_size)
+            frame = srv->ring[client->cursor % srv->ring_size];
+        if (!frame) {
+            uint64_t missed = srv->seq - client->cursor;
+            client->cursor  = srv->seq;
+            client->overruns += 1;
+            client->frames_missed += missed;
+            pthread_mutex_unlock(&srv->lock);
+            print_logf(client->overruns == 1 ? LOG_WARNING : LOG_DEBUG, "rtl_tcp",
+                    "client %s port %s overrun, skipped %u frames", client->host, client->port, (unsigned)missed);
+            continue;
+        }
+        // Skip the frame if it and both neighbours are below the squelch level
+        int active = 1;
+        if (client->compress & RTLTCP_COMPRESS_SQUELCH) {
+            rtltcp_frame_t const *next = lookahead ? srv->ring[(client->cursor + 1) % srv->ring_size] : NULL;
+            active = frame->active || client->prev_active || (next && next->active);
+            client->prev_active = frame->active;
+        }
+        frame->refs += 1;
+        client->cursor += 1;
+        pthread_mutex_unlock(&srv->lock);
+
+        // Send frame
+        ssize_t ret;
+        if (!client->compress)
+            ret = send_wait(sock, frame->data, frame->len);
+        else if (active)
+            ret = send_frame_chunks(client, frame);
+        else
+            ret = send_chunk(sock, client->zbuf, RTLTCP_CHUNK_SKIP, frame->len / 2, 0);
+        client->frames_skipped += !active;
+
+        pthread_mutex_lock(&srv->lock);
+        rtltcp_frame_unref(frame);
+        pthread_mutex_unlock(&srv->lock);
+
+        if (ret < 0)
+            break;
+        client->frames += 1;
+    }
+
+    print_logf(LOG_NOTICE, "rtl_tcp", "client disconnected from %s port %s, sent %u frames, %u squelched, %u overruns skipped %u frames",
+            client->host, client->port, (unsigned)client->frames, (unsigned)client->frames_skipped, (unsigned)client->overruns, (unsigned)client->frames_missed);
+
+    pthread_mutex_lock(&srv->lock);
+    srv->client_count -= 1;
+    client->done = 1;
+    pthread_mutex_unlock(&srv->lock);
+
+    return 0;
+}
+
+// join and free all clients that are done, or all clients on exit
+static void rtltcp_reap_clients(rtltcp_server_t *srv, int all)
+{
+    for (;;) {
+        pthread_mutex_lock(&srv->lock);
+        rtltcp_client_t **next = &srv->clients;
+        while (*next && !(*next)->done && !all)
+            next = &(*next)->next;
+        rtltcp_client_t *client = *next;
+        if (client)
+            *next = client->next;
+        pthread_mutex_unlock(&srv->lock);
+
+        if (!client)
+            break;
+
+        int r = pthread_join(client->thread, NULL);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+        }
+        closesocket(client->sock);
+        free(client->zbuf);
+        free(client);
+    }
 }
 
 static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
@@ -255,7 +592,7 @@ static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
 
     // Start listening for clients, waits for an incoming connection
     int listen_sock = srv->sock; // make it easy for the checker
-    int r = listen(listen_sock, 1);
+    int r = listen(listen_sock, srv->client_max);
     if (r < 0) {
         perror("ERROR on listen");
         closesocket(listen_sock);
@@ -270,6 +607,8 @@ static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
         unsigned addr_len = sizeof(addr);
         int sock = accept(listen_sock, (struct sockaddr *)&addr, &addr_len);
 
+        rtltcp_reap_clients(srv, 0);
+
         // TODO: ignore ECONNABORTED (Software caused connection abort)
         if (sock < 0) {
             perror("ERROR on accept");
@@ -296,81 +635,43 @@ static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
             closesocket(sock);
             continue;
         }
-        print_logf(LOG_NOTICE, "rtl_tcp", "client connected from %s port %s", host, port);
 
         pthread_mutex_lock(&srv->lock);
-        srv->client_count += 1;
-        unsigned prev_cnt = srv->data_cnt + 9; // data sent in previous loop, random value to get the current buffer
+        int client_count = srv->client_count;
         pthread_mutex_unlock(&srv->lock);
+        if (client_count >= srv->client_max) {
+            print_logf(LOG_WARNING, "rtl_tcp", "client from %s port %s rejected, already serving %d clients", host, port, client_count);
+            closesocket(sock);
+            continue;
+        }
 
-        send_header(sock);
-
-        // Client loop
-        for (;;) {
-            // Read available commands
-            int abort = 0;
-            for (;;) {
-                fd_set fds;
-                FD_ZERO(&fds);
-                FD_SET(sock, &fds);
-                struct timeval timeout = {0};
-
-                int ready = select(sock + 1, &fds, NULL, NULL, &timeout);
-                if (ready <= 0)
-                    break;
-
-                uint8_t buf[128] = {0};
-                ssize_t len = recv(sock, buf, sizeof(buf), 0);
-                //print_logf(LOG_TRACE, "rtl_tcp", "recv %zd bytes (%d)", len, ready);
-                if (len <= 0) {
-                    abort = 1;
-                    break;
-                }
-                int pos = 0;
-                while (pos + 5 <= len) {
-                    pos += parse_command(srv->cfg, srv->control, & buf[pos], (int)len - pos);
-                }
-            }
-            if (abort) {
-                break;
-            }
-
-            // Wait for send buffer to clear
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            struct timeval timeout = {.tv_usec = 100000}; // Wait at most 100 ms
-
-            int ready = select(sock + 1, NULL, &fds, NULL, &timeout);
-            if (ready <= 0) {
-                print_log(LOG_ERROR, "rtl_tcp", "send not ready for write?");
-                break; // Cancel the connection on network problems
-            }
-
-            // Wait for next frame
-            pthread_mutex_lock(&srv->lock);
-            while (srv->data_cnt == prev_cnt || srv->data_buf == NULL)
-                pthread_cond_wait(&srv->cond, &srv->lock);
-            // Maybe timeout to check recv()
-            // pthread_cond_timedwait(&srv->cond, &srv->lock, const struct timespec *abstime);
-
-            // Get data buffer reference
-            void const *data = srv->data_buf;
-            int data_len     = srv->data_len;
-            prev_cnt         = srv->data_cnt;
-
-            pthread_mutex_unlock(&srv->lock);
-
-            // Send frame
-            send_all(sock, data, data_len, MSG_NOSIGNAL); // ignore SIGPIPE
+        rtltcp_client_t *client = calloc(1, sizeof(*client));
+        if (!client) {
+            WARN_CALLOC("accept_thread()");
+            closesocket(sock);
+            continue; // NOTE: skip client on alloc failure.
         }
+        client->srv  = srv;
+        client->sock = sock;
+        snprintf(client->host, sizeof(client->host), "%s", host);
+        snprintf(client->port, sizeof(client->port), "%s", port);
+
+        print_logf(LOG_NOTICE, "rtl_tcp", "client connected from %s port %s", host, port);
 
         pthread_mutex_lock(&srv->lock);
-        srv->client_count -= 1;
+        client->cursor = srv->seq; // start with the next frame
+        r = pthread_create(&client->thread, NULL, client_thread, client);
+        if (!r) {
+            client->next = srv->clients;
+            srv->clients = client;
+            srv->client_count += 1;
+        }
         pthread_mutex_unlock(&srv->lock);
-
-        print_logf(LOG_NOTICE, "rtl_tcp", "client disconnected from %s port %s", host, port);
-        closesocket(sock);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+            closesocket(sock);
+            free(client);
+        }
     }
     return 0;
 }
@@ -431,6 +732,13 @@ static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char cons
     }
     print_logf(LOG_CRITICAL, "rtl_tcp server", "Serving rtl_tcp on address %s %s", address, portstr);
 
+    srv->ring = calloc(srv->ring_size, sizeof(*srv->ring));
+    if (!srv->ring) {
+        WARN_CALLOC("rtltcp_server_start()");
+        closesocket(sock);
+        return -1; // NOTE: returns error on alloc failure.
+    }
+
     pthread_mutex_init(&srv->lock, NULL);
     pthread_cond_init(&srv->cond, NULL);
 
@@ -460,11 +768,29 @@ static int rtltcp_server_stop(rtltcp_server_t *srv)
 
     print_logf(LOG_NOTICE, "rtl_tcp server", "Stopping rtl_tcp server...");
 
-    // thread is likely blocking in accept, recv, or send
+    // accept thread is likely blocking in accept
     int r = pthread_cancel(srv->thread);
     if (r) {
         fprintf(stderr, "%s: error in pthread_cancel, rc: %d\n", __func__, r);
     }
+    pthread_join(srv->thread, NULL);
+
+    // client threads might be blocking in select, recv, or send
+    pthread_mutex_lock(&srv->lock);
+    srv->exit_server = 1;
+    for (rtltcp_client_t *client = srv->clients; client; client = client->next) {
+        shutdown(client->sock, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&srv->lock);
+    pthread_cond_broadcast(&srv->cond);
+    rtltcp_reap_clients(srv, 1);
+
+    for (unsigned i = 0; i < srv->ring_size; ++i) {
+        rtltcp_frame_unref(srv->ring[i]);
+    }
+    free(srv->ring);
+    srv->ring = NULL;
+
     pthread_mutex_destroy(&srv->lock);
     pthread_cond_destroy(&srv->cond);
 
@@ -510,7 +836,7 @@ static void raw_output_rtltcp_free(raw_output_t *output)
     free(rtltcp);
 }
 
-struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, char const *opts, r_cfg_t *cfg)
+struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, char *opts, r_cfg_t *cfg)
 {
     raw_output_rtltcp_t *rtltcp = calloc(1, sizeof(raw_output_rtltcp_t));
     if (!rtltcp) {
@@ -527,11 +853,33 @@ struct raw_output *raw_output_rtltcp_create(const char *host, const char *port,
     }
 #endif
 
-    // If clients allowed to change SDR parameters
-    if (opts && !strcasecmp(opts, "control"))
-        rtltcp->server.control = 1;
-    else if (opts && *opts) {
-        print_logf(LOG_FATAL, __func__, "Invalid \"%s\" option.", opts);
+    rtltcp->server.client_max = RTLTCP_CLIENTS_DEFAULT;
+    rtltcp->server.ring_size  = RTLTCP_BUFFERS_DEFAULT;
+    rtltcp->server.squelch    = RTLTCP_SQUELCH_DEFAULT;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        // If clients allowed to change SDR parameters
+        else if (!strcasecmp(key, "control"))
+            rtltcp->server.control = atobv(val, 1);
+        else if (!strcasecmp(key, "clients"))
+            rtltcp->server.client_max = atoiv(val, RTLTCP_CLIENTS_DEFAULT);
+        else if (!strcasecmp(key, "buffers"))
+            rtltcp->server.ring_size = atoiv(val, RTLTCP_BUFFERS_DEFAULT);
+        // Squelch level for clients with compression, 0 to always send all frames
+        else if (!strcasecmp(key, "squelch"))
+            rtltcp->server.squelch = arg_float(val, "-F rtl_tcp squelch= ");
+        else {
+            print_logf(LOG_FATAL, __func__, "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+    if (rtltcp->server.client_max < 1 || (int)rtltcp->server.ring_size < 1) {
+        print_logf(LOG_FATAL, __func__, "Invalid clients=%d or buffers=%d option.", rtltcp->server.client_max, (int)rtltcp->server.ring_size);
         exit(1);
     }
 
@@ -548,7 +896,7 @@ struct raw_output *raw_output_rtltcp_create(const char *host, const char *port,
 
 #else
 
-struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, char const *opts, r_cfg_t *cfg)
+struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, char *opts, r_cfg_t *cfg)
 {
     UNUSED(host);
     UNUSED(port);
@@ -0,0 +1,128 @@
+/** @file
+    Shared memory ring output for rtl_433 events.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_shm.h"
+#include "shm_ring.h"
+
+#include "data.h"
+#include "optparse.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Shared memory printer, one compact JSON object or CBOR map per record */
+
+typedef struct {
+    struct data_output output;
+    shm_ring_writer_t *ring;
+    int format;           ///< one of shm_ring_format
+    data_render_t render; ///< used if the output does not share the rendering
+    unsigned records;
+    unsigned dropped;     ///< records longer than a quarter of the ring
+} data_output_shm_t;
+
+/// Get the rendering of @p data in the format of the output, NULL if @p render is not for this record.
+static void const *shm_render(data_output_shm_t *shm, data_render_t *render, data_t *data, size_t *len)
+{
+    if (shm->format == SHM_RING_CBOR)
+        return data_render_cbor(render, data, len);
+    return data_render_jsons(render, data, len);
+}
+
+static void R_API_CALLCONV data_output_shm_print(data_output_t *output, data_t *data)
+{
+    data_output_shm_t *shm = (data_output_shm_t *)output;
+
+    size_t len;
+    void const *rec = shm_render(shm, output->render, data, &len);
+    int own = !rec;
+    if (own) {
+        data_render_start(&shm->render, data);
+        rec = shm_render(shm, &shm->render, data, &len);
+    }
+    if (rec) {
+        if (shm_ring_write(shm->ring, rec, len))
+            shm->records++;
+        else
+            shm->dropped++;
+    }
+    if (own)
+        data_render_start(&shm->render, NULL);
+}
+
+static data_t *R_API_CALLCONV data_output_shm_stats(data_output_t *output)
+{
+    data_output_shm_t *shm = (data_output_shm_t *)output;
+
+    return data_make(
+            "records",          "", DATA_INT, shm->records,
+            "dropped",          "", DATA_INT, shm->dropped,
+            NULL);
+}
+
+static void R_API_CALLCONV data_output_shm_free(data_output_t *output)
+{
+    data_output_shm_t *shm = (data_output_shm_t *)output;
+
+    if (!shm)
+        return;
+
+    shm_ring_writer_free(shm->ring);
+    data_render_free(&shm->render);
+
+    free(shm);
+}
+
+struct data_output *data_output_shm_create(int log_level, char const *name, char *opts)
+{
+    int format  = SHM_RING_JSON;
+    size_t size = SHM_DEFAULT_SIZE;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "json"))
+            format = SHM_RING_JSON;
+        else if (!strcasecmp(key, "cbor"))
+            format = SHM_RING_CBOR;
+        else if (!strcasecmp(key, "size"))
+            size = atouint32_metric(val, "-F shm: size=");
+        else {
+            print_logf(LOG_FATAL, "SHM", "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+
+    data_output_shm_t *shm = calloc(1, sizeof(data_output_shm_t));
+    if (!shm) {
+        WARN_CALLOC("data_output_shm_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    shm->ring = shm_ring_writer_create(name, size, format);
+    if (!shm->ring) {
+        free(shm);
+        return NULL;
+    }
+
+    shm->output.log_level    = log_level;
+    shm->output.output_print = data_output_shm_print;
+    shm->output.output_stats = data_output_shm_stats;
+    shm->output.output_free  = data_output_shm_free;
+    shm->format              = format;
+
+    return (struct data_output *)shm;
+}
@@ -1,5 +1,5 @@
 /** @file
-    UDP syslog output for rtl_433 events.
+    UDP syslog and CBOR output for rtl_433 events.
 
     Copyright (C) 2021 Christian Zuckschwerdt
 
@@ -14,6 +14,7 @@
 #include "data.h"
 #include "abuf.h"
 #include "r_util.h"
+#include "optparse.h"
 #include "logger.h"
 #include "fatal.h"
 
@@ -21,6 +22,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "mongoose.h"
+
 #include <limits.h>
 // _POSIX_HOST_NAME_MAX is broken in gcc-13 at least on MacOS
 #ifndef _POSIX_HOST_NAME_MAX
@@ -76,10 +79,39 @@
 
 /* Datagram (UDP) client */
 
+// sendmmsg() is available where MSG_WAITFORONE is defined (Linux, FreeBSD),
+// otherwise a batch is sent with one sendto() per datagram.
+#ifdef MSG_WAITFORONE
+#define HAVE_SENDMMSG
+#endif
+
+#define DATAGRAM_MAX 65507       // max UDP payload, we don't want to send in fragments
+#define DATAGRAM_PACK_DEFAULT 1472 // typical MTU of 1500 less IPv4 and UDP headers
+#define DATAGRAM_BATCH_MAX 64    // max datagrams per flush
+#define DATAGRAM_BATCH_MS 100    // default flush interval
+
 typedef struct {
     struct sockaddr_storage addr;
     socklen_t addr_len;
     SOCKET sock;
+
+    struct mg_connection *timer; ///< dummy connection for the flush timer, NULL if not batching
+    int batch_ms;        ///< flush interval, 0 to send right away
+    unsigned batch_size; ///< flush once this many datagrams are queued
+    unsigned pack;       ///< pack events into datagrams up to this many bytes, 0 for one event per datagram
+    char pack_sep;       ///< separator between packed events, 0 for none
+
+    unsigned num_msgs;                  ///< number of queued datagrams
+    size_t msg_len[DATAGRAM_BATCH_MAX]; ///< queued datagram lengths, the data is consecutive in buf
+    char *buf;                          ///< queued datagram data
+    size_t buf_len;
+    size_t buf_size;
+
+    unsigned events;    ///< events queued or sent
+    unsigned datagrams; ///< datagrams sent
+    unsigned sends;     ///< send calls
+    unsigned errors;    ///< failed send calls
+    unsigned dropped;   ///< events dropped as too large
 } datagram_client_t;
 
 static int datagram_client_open(datagram_client_t *client, const char *host, const char *port)
@@ -123,11 +155,22 @@ static int datagram_client_open(datagram_client_t *client, const char *host, con
     return 0;
 }
 
+static void datagram_client_flush(datagram_client_t *client);
+
 static void datagram_client_close(datagram_client_t *client)
 {
     if (!client)
         return;
 
+    datagram_client_flush(client);
+    if (client->timer) {
+        client->timer->user_data = NULL;
+        client->timer->flags |= MG_F_CLOSE_IMMEDIATELY;
+        client->timer = NULL;
+    }
+    free(client->buf);
+    client->buf = NULL;
+
     if (client->sock != INVALID_SOCKET) {
         closesocket(client->sock);
         client->sock = INVALID_SOCKET;
@@ -140,10 +183,174 @@ static void datagram_client_close(datagram_client_t *client)
 
 static void datagram_client_send(datagram_client_t *client, const char *message, size_t message_len)
 {
+    client->sends++;
     int r =  sendto(client->sock, message, message_len, 0, (struct sockaddr *)&client->addr, client->addr_len);
     if (r == -1) {
+        client->errors++;
         perror("sendto");
     }
+    else {
+        client->datagrams++;
+    }
+}
+
+/// Send all queued datagrams, with as few calls as possible.
+static void datagram_client_flush(datagram_client_t *client)
+{
+    if (!client->num_msgs)
+        return;
+
+#ifdef HAVE_SENDMMSG
+    struct iovec iov[DATAGRAM_BATCH_MAX];
+    struct mmsghdr msgs[DATAGRAM_BATCH_MAX];
+    memset(msgs, 0, sizeof(msgs));
+    char *p = client->buf;
+    for (unsigned i = 0; i < client->num_msgs; ++i) {
+        iov[i].iov_base             = p;
+        iov[i].iov_len              = client->msg_len[i];
+        msgs[i].msg_hdr.msg_name    = &client->addr;
+        msgs[i].msg_hdr.msg_namelen = client->addr_len;
+        msgs[i].msg_hdr.msg_iov     = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen  = 1;
+        p += client->msg_len[i];
+    }
+    unsigned sent = 0;
+    while (sent < client->num_msgs) {
+        client->sends++;
+        int r = sendmmsg(client->sock, &msgs[sent], client->num_msgs - sent, 0);
+        if (r <= 0) {
+            client->errors++;
+            perror("sendmmsg");
+            break; // drop the rest of the batch
+        }
+        sent += (unsigned)r;
+        client->datagrams += (unsigned)r;
+    }
+#else
+    char const *p = client->buf;
+    for (unsigned i = 0; i < client->num_msgs; ++i) {
+        datagram_client_send(client, p, client->msg_len[i]);
+        p += client->msg_len[i];
+    }
+#endif
+
+    client->num_msgs = 0;
+    client->buf_len  = 0;
+}
+
+/// Queue a message for the next flush, packed into the last datagram if it fits.
+static void datagram_client_queue(datagram_client_t *client, char const *message, size_t message_len)
+{
+    // an event larger than the pack size still gets a datagram of its own
+    if (message_len > DATAGRAM_MAX) {
+        client->dropped++;
+        return;
+    }
+    client->events++;
+
+    if (!client->batch_ms) {
+        datagram_client_send(client, message, message_len);
+        return;
+    }
+
+    size_t sep_len = client->pack_sep ? 1 : 0;
+    int packed     = client->pack && client->num_msgs
+            && client->msg_len[client->num_msgs - 1] + sep_len + message_len <= client->pack;
+    if (!packed && client->num_msgs >= client->batch_size)
+        datagram_client_flush(client);
+
+    size_t needed = client->buf_len + sep_len + message_len;
+    if (needed > client->buf_size) {
+        size_t buf_size = needed > 2 * client->buf_size ? needed : 2 * client->buf_size;
+        char *buf = realloc(client->buf, buf_size);
+        if (!buf) {
+            WARN_REALLOC("datagram_client_queue()");
+            client->dropped++;
+            return; // NOTE: skip output on alloc failure.
+        }
+        client->buf      = buf;
+        client->buf_size = buf_size;
+    }
+
+    if (packed) {
+        if (sep_len)
+            client->buf[client->buf_len++] = client->pack_sep;
+        client->msg_len[client->num_msgs - 1] += sep_len + message_len;
+    }
+    else {
+        client->msg_len[client->num_msgs++] = message_len;
+    }
+    memcpy(&client->buf[client->buf_len], message, message_len);
+    client->buf_len += message_len;
+
+    // without packing a full batch can go right away, otherwise wait for the timer
+    if (!client->pack && client->num_msgs >= client->batch_size)
+        datagram_client_flush(client);
+}
+
+static void datagram_timer_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    datagram_client_t *client = (datagram_client_t *)nc->user_data;
+    if (ev != MG_EV_TIMER || !client)
+        return;
+
+    datagram_client_flush(client);
+    mg_set_timer(nc, mg_time() + client->batch_ms / 1000.0);
+}
+
+/// Parse the batching options, unknown options are fatal.
+static void datagram_client_options(datagram_client_t *client, char *opts, char pack_sep)
+{
+    client->batch_size = DATAGRAM_BATCH_MAX;
+    client->pack_sep   = pack_sep;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "batch"))
+            client->batch_ms = atoiv(val, DATAGRAM_BATCH_MS);
+        else if (!strcasecmp(key, "batch_size"))
+            client->batch_size = atoiv(val, DATAGRAM_BATCH_MAX);
+        else if (!strcasecmp(key, "pack"))
+            client->pack = atoiv(val, DATAGRAM_PACK_DEFAULT);
+        else {
+            print_logf(LOG_FATAL, __func__, "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+    if (client->batch_ms < 0 || client->batch_size < 1 || client->batch_size > DATAGRAM_BATCH_MAX || client->pack > DATAGRAM_MAX) {
+        print_logf(LOG_FATAL, __func__, "Invalid batch, batch_size (1-%d) or pack (up to %d) option.", DATAGRAM_BATCH_MAX, DATAGRAM_MAX);
+        exit(1);
+    }
+    // packed datagrams are sent on the timer
+    if (client->pack && !client->batch_ms)
+        client->batch_ms = DATAGRAM_BATCH_MS;
+}
+
+static void datagram_client_start_timer(datagram_client_t *client, struct mg_mgr *mgr)
+{
+    if (!client->batch_ms)
+        return;
+
+    struct mg_add_sock_opts opts = {.user_data = client};
+    client->timer = mg_add_sock_opt(mgr, INVALID_SOCKET, datagram_timer_event, opts);
+    if (client->timer)
+        mg_set_timer(client->timer, mg_time() + client->batch_ms / 1000.0);
+}
+
+static data_t *datagram_client_stats(datagram_client_t *client)
+{
+    return data_make(
+            "events",           "", DATA_INT, client->events,
+            "datagrams",        "", DATA_INT, client->datagrams,
+            "sends",            "", DATA_INT, client->sends,
+            "errors",           "", DATA_INT, client->errors,
+            "dropped",          "", DATA_INT, client->dropped,
+            NULL);
 }
 
 /* Syslog UDP printer, RFC 5424 (IETF-syslog protocol) */
@@ -178,12 +385,28 @@ static void R_API_CALLCONV data_output_syslog_print(data_output_t *output, data_
 
     abuf_printf(&msg, "<%d>1 %s %s rtl_433 - - - ", syslog->pri, timestamp, syslog->hostname);
 
-    msg.tail += data_print_jsons(data, msg.tail, msg.left);
-    if (msg.tail >= msg.head + sizeof(message))
-        return; // abort on overflow, we don't actually want to send more than fits the MTU
+    size_t len;
+    char const *json = data_render_jsons(output->render, data, &len);
+    if (json) {
+        if (len >= msg.left)
+            return; // abort on overflow, we don't actually want to send more than fits the MTU
+        abuf_cat(&msg, json);
+    }
+    else {
+        msg.tail += data_print_jsons(data, msg.tail, msg.left);
+        if (msg.tail >= msg.head + sizeof(message))
+            return; // abort on overflow, we don't actually want to send more than fits the MTU
+    }
 
     size_t abuf_len = msg.tail - msg.head;
-    datagram_client_send(&syslog->client, message, abuf_len);
+    datagram_client_queue(&syslog->client, message, abuf_len);
+}
+
+static data_t *R_API_CALLCONV data_output_syslog_stats(data_output_t *output)
+{
+    data_output_syslog_t *syslog = (data_output_syslog_t *)output;
+
+    return datagram_client_stats(&syslog->client);
 }
 
 static void R_API_CALLCONV data_output_syslog_free(data_output_t *output)
@@ -198,7 +421,7 @@ static void R_API_CALLCONV data_output_syslog_free(data_output_t *output)
     free(syslog);
 }
 
-struct data_output *data_output_syslog_create(int log_level, const char *host, const char *port)
+struct data_output *data_output_syslog_create(struct mg_mgr *mgr, int log_level, const char *host, const char *port, char *opts)
 {
     data_output_syslog_t *syslog = calloc(1, sizeof(data_output_syslog_t));
     if (!syslog) {
@@ -217,6 +440,7 @@ struct data_output *data_output_syslog_create(int log_level, const char *host, c
 
     syslog->output.log_level    = log_level;
     syslog->output.output_print = data_output_syslog_print;
+    syslog->output.output_stats = data_output_syslog_stats;
     syslog->output.output_free  = data_output_syslog_free;
     // Severity 5 "Notice", Facility 20 "local use 4"
     syslog->pri = 20 * 8 + 5;
@@ -233,7 +457,84 @@ struct data_output *data_output_syslog_create(int log_level, const char *host, c
     gethostname(syslog->hostname, _POSIX_HOST_NAME_MAX + 1);
     #endif
     syslog->hostname[_POSIX_HOST_NAME_MAX] = '\0';
+    // packed syslog messages are separated by newlines
+    datagram_client_options(&syslog->client, opts, '\n');
     datagram_client_open(&syslog->client, host, port);
+    datagram_client_start_timer(&syslog->client, mgr);
 
     return (struct data_output *)syslog;
 }
+
+/* CBOR UDP printer, one CBOR encoded event per datagram, or a CBOR sequence if packed */
+
+typedef struct {
+    struct data_output output;
+    datagram_client_t client;
+    data_render_t render; ///< used if the output does not share the rendering
+} data_output_udp_cbor_t;
+
+static void R_API_CALLCONV data_output_udp_cbor_print(data_output_t *output, data_t *data)
+{
+    data_output_udp_cbor_t *udp = (data_output_udp_cbor_t *)output;
+
+    size_t len;
+    uint8_t const *cbor = data_render_cbor(output->render, data, &len);
+    if (!cbor) {
+        data_render_start(&udp->render, data);
+        cbor = data_render_cbor(&udp->render, data, &len);
+        data_render_start(&udp->render, NULL);
+    }
+    if (!cbor)
+        return;
+
+    datagram_client_queue(&udp->client, (char const *)cbor, len);
+}
+
+static data_t *R_API_CALLCONV data_output_udp_cbor_stats(data_output_t *output)
+{
+    data_output_udp_cbor_t *udp = (data_output_udp_cbor_t *)output;
+
+    return datagram_client_stats(&udp->client);
+}
+
+static void R_API_CALLCONV data_output_udp_cbor_free(data_output_t *output)
+{
+    data_output_udp_cbor_t *udp = (data_output_udp_cbor_t *)output;
+
+    if (!udp)
+        return;
+
+    datagram_client_close(&udp->client);
+    data_render_free(&udp->render);
+
+    free(udp);
+}
+
+struct data_output *data_output_udp_cbor_create(struct mg_mgr *mgr, int log_level, const char *host, const char *port, char *opts)
+{
+    data_output_udp_cbor_t *udp = calloc(1, sizeof(data_output_udp_cbor_t));
+    if (!udp) {
+        WARN_CALLOC("data_output_udp_cbor_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+
+    if (WSAStartup(MAKEWORD(2,2),&wsa) != 0) {
+        perror("WSAStartup()");
+        free(udp);
+        return NULL;
+    }
+#endif
+
+    udp->output.log_level    = log_level;
+    udp->output.output_print = data_output_udp_cbor_print;
+    udp->output.output_stats = data_output_udp_cbor_stats;
+    udp->output.output_free  = data_output_udp_cbor_free;
+    // packed CBOR items simply concatenate to a CBOR sequence (RFC 8742)
+    datagram_client_options(&udp->client, opts, 0);
+    datagram_client_open(&udp->client, host, port);
+    datagram_client_start_timer(&udp->client, mgr);
+
+    return (struct data_output *)udp;
+}
@@ -0,0 +1,220 @@
+/** @file
+    Queue of detected packages for a decode thread, to detect the next packages while one is decoded.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "package_queue.h"
+#include "r_util.h"
+#include "trace.h"
+#include "fatal.h"
+#include "thread_sched.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#ifdef THREADS
+
+struct package_queue {
+    pthread_t thread;
+    pthread_mutex_t lock; ///< lock for the slot positions and exit_thread
+    pthread_cond_t work;  ///< signaled on a queued package and exit
+    pthread_cond_t done;  ///< signaled when a package was decoded
+    package_queue_fn decode_fn;
+    void *ctx;
+    unsigned size;    ///< number of slots
+    unsigned head;    ///< next slot to decode
+    unsigned tail;    ///< next slot to fill
+    unsigned pending; ///< slots queued and not yet decoded
+    int exit_thread;
+    package_slot_t *slots;
+};
+
+static THREAD_RETURN THREAD_CALL package_queue_loop(void *arg)
+{
+    package_queue_t *queue = arg;
+    // no logging outside of the decoder, the outputs are only synchronized with the queue
+    trace_thread_name("decode");
+
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->exit_thread) {
+        if (!queue->pending) {
+            pthread_cond_wait(&queue->work, &queue->lock);
+            continue;
+        }
+        package_slot_t *slot = &queue->slots[queue->head];
+        pthread_mutex_unlock(&queue->lock);
+
+        queue->decode_fn(queue->ctx, slot);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->head = (queue->head + 1) % queue->size;
+        queue->pending--;
+        pthread_cond_broadcast(&queue->done);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return (THREAD_RETURN)0;
+}
+
+package_queue_t *package_queue_start(unsigned slots, package_queue_fn decode_fn, void *ctx)
+{
+    if (!slots)
+        return NULL;
+
+    package_queue_t *queue = calloc(1, sizeof(*queue));
+    if (!queue) {
+        WARN_CALLOC("package_queue_start()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    queue->slots = calloc(slots, sizeof(*queue->slots));
+    if (!queue->slots) {
+        WARN_CALLOC("package_queue_start()");
+        free(queue);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    queue->size      = slots;
+    queue->decode_fn = decode_fn;
+    queue->ctx       = ctx;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->work, NULL);
+    pthread_cond_init(&queue->done, NULL);
+
+#ifndef _WIN32
+    // Block all signals from the decode thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&queue->thread, NULL, package_queue_loop, queue);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->work);
+        pthread_cond_destroy(&queue->done);
+        free(queue->slots);
+        free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void package_queue_stop(package_queue_t *queue)
+{
+    if (!queue)
+        return;
+
+    pthread_mutex_lock(&queue->lock);
+    queue->exit_thread = 1;
+    pthread_mutex_unlock(&queue->lock);
+    pthread_cond_broadcast(&queue->work);
+
+    int r = pthread_join(queue->thread, NULL);
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+    }
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->work);
+    pthread_cond_destroy(&queue->done);
+    for (unsigned i = 0; i < queue->size; ++i) {
+        pulse_data_free(&queue->slots[i].pulses);
+        pulse_data_free(&queue->slots[i].fsk_pulses);
+    }
+    free(queue->slots);
+    free(queue);
+}
+
+void package_queue_set_sched(package_queue_t *queue, thread_sched_t const *sched, char const *name)
+{
+    if (!queue)
+        return;
+
+    thread_sched_apply(queue->thread, sched, name);
+}
+
+package_slot_t *package_queue_acquire(package_queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->pending == queue->size)
+        pthread_cond_wait(&queue->done, &queue->lock);
+    package_slot_t *slot = &queue->slots[queue->tail];
+    pthread_mutex_unlock(&queue->lock);
+    return slot;
+}
+
+void package_queue_push(package_queue_t *queue, package_slot_t *slot)
+{
+    UNUSED(slot); // the slot is always the one at the tail
+
+    pthread_mutex_lock(&queue->lock);
+    queue->tail = (queue->tail + 1) % queue->size;
+    queue->pending++;
+    pthread_cond_signal(&queue->work);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void package_queue_drain(package_queue_t *queue)
+{
+    if (!queue)
+        return;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->pending)
+        pthread_cond_wait(&queue->done, &queue->lock);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+#else
+
+package_queue_t *package_queue_start(unsigned slots, package_queue_fn decode_fn, void *ctx)
+{
+    UNUSED(slots);
+    UNUSED(decode_fn);
+    UNUSED(ctx);
+    return NULL;
+}
+
+void package_queue_stop(package_queue_t *queue)
+{
+    UNUSED(queue);
+}
+
+void package_queue_set_sched(package_queue_t *queue, thread_sched_t const *sched, char const *name)
+{
+    UNUSED(queue);
+    UNUSED(sched);
+    UNUSED(name);
+}
+
+package_slot_t *package_queue_acquire(package_queue_t *queue)
+{
+    UNUSED(queue);
+    return NULL;
+}
+
+void package_queue_push(package_queue_t *queue, package_slot_t *slot)
+{
+    UNUSED(queue);
+    UNUSED(slot);
+}
+
+void package_queue_drain(package_queue_t *queue)
+{
+    UNUSED(queue);
+}
+
+#endif
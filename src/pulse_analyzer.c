@@ -12,10 +12,16 @@
 #include "pulse_analyzer.h"
 #include "pulse_slicer.h"
 #include "c_util.h" // for MIN(), MAX()
+#include "fatal.h"
+#include "logger.h"
+#include "data.h"
+#include "r_util.h"
+#include "compat_pthread.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 
 #define MAX_HIST_BINS 16
 
@@ -201,163 +207,253 @@ static void hexstr_print(hexstr_t *h, FILE *out)
 
 #define TOLERANCE (0.2f) // 20% tolerance should still discern between the pulse widths: 0.33, 0.66, 1.0
 
-/// Analyze the statistics of a pulse data structure and print result
-void pulse_analyzer(pulse_data_t *data, int package_type, r_device* device)
+/// The width statistics of a package.
+typedef struct {
+    int total_period;
+    histogram_t pulses;
+    histogram_t gaps;
+    histogram_t periods;
+    histogram_t timings;
+} pulse_stats_t;
+
+/// Generate the width statistics of a package with pulses.
+static void pulse_stats_build(pulse_stats_t *stats, pulse_data_t const *data)
 {
-    if (data->num_pulses == 0) {
-        fprintf(stderr, "No pulses detected.\n");
-        return;
-    }
+    *stats = (pulse_stats_t){0};
 
-    double to_ms = 1e3 / data->sample_rate;
-    double to_us = 1e6 / data->sample_rate;
     // Generate pulse period data
-    int pulse_total_period = 0;
     pulse_data_t pulse_periods = {0};
+    pulse_data_reserve(&pulse_periods, data->num_pulses);
     pulse_periods.num_pulses = data->num_pulses;
     for (unsigned n = 0; n < pulse_periods.num_pulses; ++n) {
         pulse_periods.pulse[n] = data->pulse[n] + data->gap[n];
-        pulse_total_period += data->pulse[n] + data->gap[n];
+        stats->total_period += data->pulse[n] + data->gap[n];
     }
-    pulse_total_period -= data->gap[pulse_periods.num_pulses - 1];
-
-    histogram_t hist_pulses  = {0};
-    histogram_t hist_gaps    = {0};
-    histogram_t hist_periods = {0};
-    histogram_t hist_timings = {0};
+    stats->total_period -= data->gap[pulse_periods.num_pulses - 1];
 
     // Generate statistics
-    histogram_sum(&hist_pulses, data->pulse, data->num_pulses, TOLERANCE);
-    histogram_sum(&hist_gaps, data->gap, data->num_pulses - 1, TOLERANCE);                      // Leave out last gap (end)
-    histogram_sum(&hist_periods, pulse_periods.pulse, pulse_periods.num_pulses - 1, TOLERANCE); // Leave out last gap (end)
-    histogram_sum(&hist_timings, data->pulse, data->num_pulses, TOLERANCE);
-    histogram_sum(&hist_timings, data->gap, data->num_pulses, TOLERANCE);
+    histogram_sum(&stats->pulses, data->pulse, data->num_pulses, TOLERANCE);
+    histogram_sum(&stats->gaps, data->gap, data->num_pulses - 1, TOLERANCE);                      // Leave out last gap (end)
+    histogram_sum(&stats->periods, pulse_periods.pulse, pulse_periods.num_pulses - 1, TOLERANCE); // Leave out last gap (end)
+    pulse_data_free(&pulse_periods);
+    histogram_sum(&stats->timings, data->pulse, data->num_pulses, TOLERANCE);
+    histogram_sum(&stats->timings, data->gap, data->num_pulses, TOLERANCE);
 
     // Fuse overlapping bins
-    histogram_fuse_bins(&hist_pulses, TOLERANCE);
-    histogram_fuse_bins(&hist_gaps, TOLERANCE);
-    histogram_fuse_bins(&hist_periods, TOLERANCE);
-    histogram_fuse_bins(&hist_timings, TOLERANCE);
+    histogram_fuse_bins(&stats->pulses, TOLERANCE);
+    histogram_fuse_bins(&stats->gaps, TOLERANCE);
+    histogram_fuse_bins(&stats->periods, TOLERANCE);
+    histogram_fuse_bins(&stats->timings, TOLERANCE);
+}
 
-    fprintf(stderr, "Analyzing pulses...\n");
-    fprintf(stderr, "Total count: %4u,  width: %4.2f ms\t\t(%5i S)\n",
-            data->num_pulses, pulse_total_period * to_ms, pulse_total_period);
-    fprintf(stderr, "Pulse width distribution:\n");
-    histogram_print(&hist_pulses, data->sample_rate);
-    fprintf(stderr, "Gap width distribution:\n");
-    histogram_print(&hist_gaps, data->sample_rate);
-    fprintf(stderr, "Pulse period distribution:\n");
-    histogram_print(&hist_periods, data->sample_rate);
-    fprintf(stderr, "Pulse timing distribution:\n");
-    histogram_print(&hist_timings, data->sample_rate);
-    fprintf(stderr, "Level estimates [high, low]: %6i, %6i\n",
-            data->ook_high_estimate, data->ook_low_estimate);
-    fprintf(stderr, "RSSI: %.1f dB SNR: %.1f dB Noise: %.1f dB\n",
-            data->rssi_db, data->snr_db, data->noise_db);
-    fprintf(stderr, "Frequency offsets [F1, F2]:  %6i, %6i\t(%+.1f kHz, %+.1f kHz)\n",
-            data->fsk_f1_est, data->fsk_f2_est,
-            (float)data->fsk_f1_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0,
-            (float)data->fsk_f2_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0);
+/// Guess the modulation and set the timing of @p device, sorts the pulse and gap histograms, returns a description.
+static char const *pulse_stats_guess(pulse_stats_t *stats, pulse_data_t const *data, int package_type, r_device *device)
+{
+    double to_us = 1e6 / data->sample_rate;
+    histogram_t *hist_pulses = &stats->pulses;
+    histogram_t *hist_gaps   = &stats->gaps;
 
-    fprintf(stderr, "Guessing modulation: ");
-    device->name    = "Analyzer Device",
-    device->verbose = 2,
-    histogram_sort_mean(&hist_pulses); // Easier to work with sorted data
-    histogram_sort_mean(&hist_gaps);
-    if (hist_pulses.bins[0].mean == 0) {
-        histogram_delete_bin(&hist_pulses, 0);
+    histogram_sort_mean(hist_pulses); // Easier to work with sorted data
+    histogram_sort_mean(hist_gaps);
+    if (hist_pulses->bins[0].mean == 0) {
+        histogram_delete_bin(hist_pulses, 0);
     } // Remove FSK initial zero-bin
 
     // Attempt to find a matching modulation
     if (data->num_pulses == 1) {
-        fprintf(stderr, "Single pulse detected. Probably Frequency Shift Keying or just noise...\n");
+        return "Single pulse detected. Probably Frequency Shift Keying or just noise...";
     }
-    else if (hist_pulses.bins_count == 1 && hist_gaps.bins_count == 1) {
-        fprintf(stderr, "Un-modulated signal. Maybe a preamble...\n");
+    else if (hist_pulses->bins_count == 1 && hist_gaps->bins_count == 1) {
+        return "Un-modulated signal. Maybe a preamble...";
     }
-    else if (hist_pulses.bins_count == 1 && hist_gaps.bins_count > 1) {
-        fprintf(stderr, "Pulse Position Modulation with fixed pulse width\n");
+    else if (hist_pulses->bins_count == 1 && hist_gaps->bins_count > 1) {
         device->modulation  = OOK_PULSE_PPM; // TODO: there is not FSK_PULSE_PPM
-        device->short_width = to_us * hist_gaps.bins[0].mean;
-        device->long_width  = to_us * hist_gaps.bins[1].mean;
-        device->gap_limit   = to_us * (hist_gaps.bins[1].max + 1);                        // Set limit above next lower gap
-        device->reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
+        device->short_width = to_us * hist_gaps->bins[0].mean;
+        device->long_width  = to_us * hist_gaps->bins[1].mean;
+        device->gap_limit   = to_us * (hist_gaps->bins[1].max + 1);                         // Set limit above next lower gap
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return "Pulse Position Modulation with fixed pulse width";
     }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 1) {
-        fprintf(stderr, "Pulse Width Modulation with fixed gap\n");
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 1) {
         device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device->short_width = to_us * hist_pulses.bins[0].mean;
-        device->long_width  = to_us * hist_pulses.bins[1].mean;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
         device->tolerance   = (device->long_width - device->short_width) * 0.4;
-        device->reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return "Pulse Width Modulation with fixed gap";
     }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 2 && hist_periods.bins_count == 1) {
-        fprintf(stderr, "Pulse Width Modulation with fixed period\n");
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 2 && stats->periods.bins_count == 1) {
         device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device->short_width = to_us * hist_pulses.bins[0].mean;
-        device->long_width  = to_us * hist_pulses.bins[1].mean;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
         device->tolerance   = (device->long_width - device->short_width) * 0.4;
-        device->reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return "Pulse Width Modulation with fixed period";
     }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 2 && hist_periods.bins_count == 3) {
-        fprintf(stderr, "Manchester coding\n");
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 2 && stats->periods.bins_count == 3) {
         device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_MANCHESTER_ZEROBIT : OOK_PULSE_MANCHESTER_ZEROBIT;
-        device->short_width = to_us * MIN(hist_pulses.bins[0].mean, hist_pulses.bins[1].mean); // Assume shortest pulse is half period
-        device->long_width  = 0;                                                               // Not used
-        device->reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1);      // Set limit above biggest gap
+        device->short_width = to_us * MIN(hist_pulses->bins[0].mean, hist_pulses->bins[1].mean); // Assume shortest pulse is half period
+        device->long_width  = 0;                                                                  // Not used
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1);       // Set limit above biggest gap
+        return "Manchester coding";
     }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count >= 3) {
-        fprintf(stderr, "Pulse Width Modulation with multiple packets\n");
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count >= 3) {
         device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device->short_width = to_us * hist_pulses.bins[0].mean;
-        device->long_width  = to_us * hist_pulses.bins[1].mean;
-        device->gap_limit   = to_us * (hist_gaps.bins[1].max + 1); // Set limit above second gap
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->gap_limit   = to_us * (hist_gaps->bins[1].max + 1); // Set limit above second gap
         device->tolerance   = (device->long_width - device->short_width) * 0.4;
-        device->reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if ((hist_pulses.bins_count >= 3 && hist_gaps.bins_count >= 3)
-            && (abs(hist_pulses.bins[1].mean - 2*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)    // Pulses are multiples of shortest pulse
-            && (abs(hist_pulses.bins[2].mean - 3*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)
-            && (abs(hist_gaps.bins[0].mean   -   hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)    // Gaps are multiples of shortest pulse
-            && (abs(hist_gaps.bins[1].mean   - 2*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)
-            && (abs(hist_gaps.bins[2].mean   - 3*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)) {
-        fprintf(stderr, "Non Return to Zero coding (Pulse Code)\n");
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return "Pulse Width Modulation with multiple packets";
+    }
+    else if ((hist_pulses->bins_count >= 3 && hist_gaps->bins_count >= 3)
+            && (abs(hist_pulses->bins[1].mean - 2*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)    // Pulses are multiples of shortest pulse
+            && (abs(hist_pulses->bins[2].mean - 3*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)
+            && (abs(hist_gaps->bins[0].mean   -   hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)    // Gaps are multiples of shortest pulse
+            && (abs(hist_gaps->bins[1].mean   - 2*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)
+            && (abs(hist_gaps->bins[2].mean   - 3*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)) {
         device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PCM : OOK_PULSE_PCM;
-        device->short_width = to_us * hist_pulses.bins[0].mean;        // Shortest pulse is bit width
-        device->long_width  = to_us * hist_pulses.bins[0].mean;        // Bit period equal to pulse length (NRZ)
-        device->reset_limit = to_us * hist_pulses.bins[0].mean * 1024; // No limit to run of zeros...
+        device->short_width = to_us * hist_pulses->bins[0].mean;        // Shortest pulse is bit width
+        device->long_width  = to_us * hist_pulses->bins[0].mean;        // Bit period equal to pulse length (NRZ)
+        device->reset_limit = to_us * hist_pulses->bins[0].mean * 1024; // No limit to run of zeros...
+        return "Non Return to Zero coding (Pulse Code)";
     }
-    else if (hist_pulses.bins_count == 3) {
-        fprintf(stderr, "Pulse Width Modulation with sync/delimiter\n");
+    else if (hist_pulses->bins_count == 3) {
         // Re-sort to find lowest pulse count index (is probably delimiter)
-        histogram_sort_count(&hist_pulses);
-        int p1 = hist_pulses.bins[1].mean;
-        int p2 = hist_pulses.bins[2].mean;
+        histogram_sort_count(hist_pulses);
+        int p1 = hist_pulses->bins[1].mean;
+        int p2 = hist_pulses->bins[2].mean;
         device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device->short_width = to_us * (p1 < p2 ? p1 : p2);                                // Set to shorter pulse width
-        device->long_width  = to_us * (p1 < p2 ? p2 : p1);                                // Set to longer pulse width
-        device->sync_width  = to_us * hist_pulses.bins[0].mean;                           // Set to lowest count pulse width
-        device->reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
+        device->short_width = to_us * (p1 < p2 ? p1 : p2);                                  // Set to shorter pulse width
+        device->long_width  = to_us * (p1 < p2 ? p2 : p1);                                  // Set to longer pulse width
+        device->sync_width  = to_us * hist_pulses->bins[0].mean;                            // Set to lowest count pulse width
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return "Pulse Width Modulation with sync/delimiter";
     }
     else {
-        fprintf(stderr, "No clue...\n");
+        return "No clue...";
+    }
+}
+
+/// Format the flex decoder spec of the guessed modulation, returns 0 if there is no matching slicer.
+static int analyzer_flex_spec(r_device const *device, char *buf, size_t size)
+{
+    switch (device->modulation) {
+    case FSK_PULSE_PCM:
+        snprintf(buf, size, "n=name,m=FSK_PCM,s=%.0f,l=%.0f,r=%.0f",
+                device->short_width, device->long_width, device->reset_limit);
+        return 1;
+    case OOK_PULSE_PPM:
+        snprintf(buf, size, "n=name,m=OOK_PPM,s=%.0f,l=%.0f,g=%.0f,r=%.0f",
+                device->short_width, device->long_width,
+                device->gap_limit, device->reset_limit);
+        return 1;
+    case OOK_PULSE_PWM:
+        snprintf(buf, size, "n=name,m=OOK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f",
+                device->short_width, device->long_width, device->reset_limit,
+                device->gap_limit, device->tolerance, device->sync_width);
+        return 1;
+    case FSK_PULSE_PWM:
+        snprintf(buf, size, "n=name,m=FSK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f",
+                device->short_width, device->long_width, device->reset_limit,
+                device->gap_limit, device->tolerance, device->sync_width);
+        return 1;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+        snprintf(buf, size, "n=name,m=OOK_MC_ZEROBIT,s=%.0f,l=%.0f,r=%.0f",
+                device->short_width, device->long_width, device->reset_limit);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/// Run the slicer of the guessed modulation, terminates the package at the reset limit.
+static void analyzer_slice(pulse_data_t *data, r_device *device)
+{
+    double to_us = 1e6 / data->sample_rate;
+    pulse_slicer_set_timing(device, data->sample_rate);
+    switch (device->modulation) {
+    case FSK_PULSE_PCM:
+        pulse_slicer_pcm(data, device);
+        break;
+    case OOK_PULSE_PPM:
+        data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
+        pulse_slicer_ppm(data, device);
+        break;
+    case OOK_PULSE_PWM:
+    case FSK_PULSE_PWM:
+        data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
+        pulse_slicer_pwm(data, device);
+        break;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+        data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
+        pulse_slicer_manchester_zerobit(data, device);
+        break;
+    default:
+        break;
     }
+    // the slicer scratch bits don't outlive the analyzer device
+    free(device->slice_bits);
+    device->slice_bits = NULL;
+}
 
+/// Analyze the statistics of a pulse data structure and print result
+void pulse_analyzer(pulse_data_t *data, int package_type, r_device* device)
+{
+    if (data->num_pulses == 0) {
+        fprintf(stderr, "No pulses detected.\n");
+        return;
+    }
+
+    double to_ms = 1e3 / data->sample_rate;
+    double to_us = 1e6 / data->sample_rate;
+    pulse_stats_t stats;
+    pulse_stats_build(&stats, data);
+    histogram_t const *hist_gaps    = &stats.gaps;
+    histogram_t const *hist_timings = &stats.timings;
+
+    fprintf(stderr, "Analyzing pulses...\n");
+    fprintf(stderr, "Total count: %4u,  width: %4.2f ms\t\t(%5i S)\n",
+            data->num_pulses, stats.total_period * to_ms, stats.total_period);
+    fprintf(stderr, "Pulse width distribution:\n");
+    histogram_print(&stats.pulses, data->sample_rate);
+    fprintf(stderr, "Gap width distribution:\n");
+    histogram_print(&stats.gaps, data->sample_rate);
+    fprintf(stderr, "Pulse period distribution:\n");
+    histogram_print(&stats.periods, data->sample_rate);
+    fprintf(stderr, "Pulse timing distribution:\n");
+    histogram_print(&stats.timings, data->sample_rate);
+    fprintf(stderr, "Level estimates [high, low]: %6i, %6i\n",
+            data->ook_high_estimate, data->ook_low_estimate);
+    if (data->pulse_mean)
+        fprintf(stderr, "Pulse levels [peak, mean]:   %6i, %6i\n",
+                data->pulse_peak, data->pulse_mean);
+    fprintf(stderr, "RSSI: %.1f dB SNR: %.1f dB Noise: %.1f dB\n",
+            data->rssi_db, data->snr_db, data->noise_db);
+    fprintf(stderr, "Frequency offsets [F1, F2]:  %6i, %6i\t(%+.1f kHz, %+.1f kHz)\n",
+            data->fsk_f1_est, data->fsk_f2_est,
+            (float)data->fsk_f1_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0,
+            (float)data->fsk_f2_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0);
+
+    fprintf(stderr, "Guessing modulation: ");
+    device->name    = "Analyzer Device";
+    device->verbose = 2;
+    fprintf(stderr, "%s\n", pulse_stats_guess(&stats, data, package_type, device));
     // Output RfRaw line (if possible)
-    if (hist_timings.bins_count <= 8) {
+    if (hist_timings->bins_count <= 8) {
         // if there is no 3rd gap length output one long B1 code
-        if (hist_gaps.bins_count <= 2) {
+        if (hist_gaps->bins_count <= 2) {
             hexstr_t hexstr = {.p = {0}};
             hexstr_push_byte(&hexstr, 0xaa);
             hexstr_push_byte(&hexstr, 0xb1);
-            hexstr_push_byte(&hexstr, hist_timings.bins_count);
-            for (unsigned b = 0; b < hist_timings.bins_count; ++b) {
-                double w = hist_timings.bins[b].mean * to_us;
+            hexstr_push_byte(&hexstr, hist_timings->bins_count);
+            for (unsigned b = 0; b < hist_timings->bins_count; ++b) {
+                double w = hist_timings->bins[b].mean * to_us;
                 hexstr_push_word(&hexstr, w < USHRT_MAX ? w : USHRT_MAX);
             }
             for (unsigned i = 0; i < data->num_pulses; ++i) {
-                int p = histogram_find_bin_index(&hist_timings, data->pulse[i]);
-                int g = histogram_find_bin_index(&hist_timings, data->gap[i]);
+                int p = histogram_find_bin_index(hist_timings, data->pulse[i]);
+                int g = histogram_find_bin_index(hist_timings, data->gap[i]);
                 if (p < 0 || g < 0) {
                     fprintf(stderr, "%s: this can't happen\n", __func__);
                     exit(1);
@@ -372,8 +468,8 @@ void pulse_analyzer(pulse_data_t *data, int package_type, r_device* device)
         // otherwise try to group as B0 codes
         else {
             // pick last gap length but a most the 4th
-            int limit_bin = MIN(3, hist_gaps.bins_count - 1);
-            int limit = hist_gaps.bins[limit_bin].min;
+            int limit_bin = MIN(3, hist_gaps->bins_count - 1);
+            int limit = hist_gaps->bins[limit_bin].min;
             hexstr_t hexstrs[HEXSTR_MAX_COUNT] = {{.p = {0}}};
             unsigned hexstr_cnt = 0;
             unsigned i = 0;
@@ -382,15 +478,15 @@ void pulse_analyzer(pulse_data_t *data, int package_type, r_device* device)
                 hexstr_push_byte(hexstr, 0xaa);
                 hexstr_push_byte(hexstr, 0xb0);
                 hexstr_push_byte(hexstr, 0); // len
-                hexstr_push_byte(hexstr, hist_timings.bins_count);
+                hexstr_push_byte(hexstr, hist_timings->bins_count);
                 hexstr_push_byte(hexstr, 1); // repeats
-                for (unsigned b = 0; b < hist_timings.bins_count; ++b) {
-                    double w =hist_timings.bins[b].mean * to_us;
+                for (unsigned b = 0; b < hist_timings->bins_count; ++b) {
+                    double w =hist_timings->bins[b].mean * to_us;
                     hexstr_push_word(hexstr, w < USHRT_MAX ? w : USHRT_MAX);
                 }
                 for (; i < data->num_pulses; ++i) {
-                    int p = histogram_find_bin_index(&hist_timings, data->pulse[i]);
-                    int g = histogram_find_bin_index(&hist_timings, data->gap[i]);
+                    int p = histogram_find_bin_index(hist_timings, data->pulse[i]);
+                    int g = histogram_find_bin_index(hist_timings, data->gap[i]);
                     if (p < 0 || g < 0) {
                         fprintf(stderr, "%s: this can't happen\n", __func__);
                         exit(1);
@@ -430,43 +526,412 @@ void pulse_analyzer(pulse_data_t *data, int package_type, r_device* device)
         fprintf(stderr, "Attempting demodulation... short_width: %.0f, long_width: %.0f, reset_limit: %.0f, sync_width: %.0f\n",
                 device->short_width, device->long_width,
                 device->reset_limit, device->sync_width);
-        switch (device->modulation) {
-        case FSK_PULSE_PCM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=FSK_PCM,s=%.0f,l=%.0f,r=%.0f'\n",
-                    device->short_width, device->long_width, device->reset_limit);
-            pulse_slicer_pcm(data, device);
-            break;
-        case OOK_PULSE_PPM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_PPM,s=%.0f,l=%.0f,g=%.0f,r=%.0f'\n",
-                    device->short_width, device->long_width,
-                    device->gap_limit, device->reset_limit);
-            data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
-            pulse_slicer_ppm(data, device);
-            break;
-        case OOK_PULSE_PWM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f'\n",
-                    device->short_width, device->long_width, device->reset_limit,
-                    device->gap_limit, device->tolerance, device->sync_width);
-            data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
-            pulse_slicer_pwm(data, device);
-            break;
-        case FSK_PULSE_PWM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=FSK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f'\n",
-                    device->short_width, device->long_width, device->reset_limit,
-                    device->gap_limit, device->tolerance, device->sync_width);
-            data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
-            pulse_slicer_pwm(data, device);
-            break;
-        case OOK_PULSE_MANCHESTER_ZEROBIT:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_MC_ZEROBIT,s=%.0f,l=%.0f,r=%.0f'\n",
-                    device->short_width, device->long_width, device->reset_limit);
-            data->gap[data->num_pulses - 1] = device->reset_limit / to_us + 1; // Be sure to terminate package
-            pulse_slicer_manchester_zerobit(data, device);
-            break;
-        default:
+        char flex[160];
+        if (analyzer_flex_spec(device, flex, sizeof(flex)))
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", flex);
+        else
             fprintf(stderr, "Unsupported\n");
-        }
+        analyzer_slice(data, device);
     }
 
     fprintf(stderr, "\n");
 }
+
+/* Streaming analyzer */
+
+#define SHAPE_BUCKETS 64  ///< quarter octave steps of the widths, see pulse_data_width_bin()
+#define SHAPE_MAX 64      ///< shapes tracked, the least recently seen is replaced
+#define SHAPE_SHARE 16    ///< a width is part of the shape if it makes 1/16 of the package
+#define SHAPE_DECAY 65536 ///< halve the rolling histograms at this many pulses
+#define SHAPE_SNR_STEP 3  ///< dB of SNR a package needs above the sample to replace it
+
+/// Rolling histogram of the widths in quarter octave buckets.
+typedef struct {
+    unsigned total;
+    unsigned count[SHAPE_BUCKETS];
+    uint64_t sum[SHAPE_BUCKETS];
+} shape_hist_t;
+
+/// A signal shape, the packages with about the same pulse and gap widths.
+typedef struct {
+    unsigned num;        ///< shape number as reported, 0 for an unused slot
+    int package_type;
+    uint64_t pulse_mask; ///< the buckets of the pulse widths
+    uint64_t gap_mask;   ///< the buckets of the gap widths
+    unsigned packages;
+    unsigned last_seen;  ///< package sequence, to pick the slot to replace
+    time_t first_time;
+    time_t last_time;
+    uint32_t sample_rate;
+    shape_hist_t pulses;
+    shape_hist_t gaps;
+    /* with samples kept */
+    pulse_data_t sample; ///< the package with the best SNR
+    char const *guess;   ///< the modulation guess of the sample, NULL if not analyzed
+    char flex[160];      ///< a flex decoder spec for the sample, empty if there is no matching slicer
+    unsigned bits;       ///< bits in the longest row the flex decoder slices
+} pulse_shape_t;
+
+struct pulse_clusters {
+    int keep_samples;
+    unsigned packages;
+    unsigned shapes_num; ///< shapes found so far
+    pulse_shape_t shapes[SHAPE_MAX];
+#ifdef THREADS
+    pthread_mutex_t lock; ///< packages may come from several channels or inputs
+#endif
+};
+
+pulse_clusters_t *pulse_clusters_create(int keep_samples)
+{
+    pulse_clusters_t *clusters = calloc(1, sizeof(*clusters));
+    if (!clusters) {
+        WARN_CALLOC("pulse_clusters_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    clusters->keep_samples = keep_samples;
+#ifdef THREADS
+    pthread_mutex_init(&clusters->lock, NULL);
+#endif
+    return clusters;
+}
+
+void pulse_clusters_free(pulse_clusters_t *clusters)
+{
+    if (!clusters)
+        return;
+    for (unsigned i = 0; i < SHAPE_MAX; ++i)
+        pulse_data_free(&clusters->shapes[i].sample);
+#ifdef THREADS
+    pthread_mutex_destroy(&clusters->lock);
+#endif
+    free(clusters);
+}
+
+static void clusters_lock(pulse_clusters_t *clusters)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&clusters->lock);
+#else
+    (void)clusters;
+#endif
+}
+
+static void clusters_unlock(pulse_clusters_t *clusters)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&clusters->lock);
+#else
+    (void)clusters;
+#endif
+}
+
+/// Buckets holding a good share of the widths.
+static uint64_t shape_mask(unsigned const *count, unsigned total)
+{
+    uint64_t mask = 0;
+    for (unsigned b = 0; b < SHAPE_BUCKETS; ++b) {
+        if (count[b] && count[b] * SHAPE_SHARE >= total)
+            mask |= (uint64_t)1 << b;
+    }
+    return mask;
+}
+
+/// Check if every bucket of each mask is in or next to a bucket of the other, a width may jitter across a step.
+static int shape_mask_match(uint64_t a, uint64_t b)
+{
+    uint64_t near_a = a | a << 1 | a >> 1;
+    uint64_t near_b = b | b << 1 | b >> 1;
+    return !(a & ~near_b) && !(b & ~near_a);
+}
+
+static void shape_hist_add(shape_hist_t *hist, unsigned const *count, uint64_t const *sum, unsigned total)
+{
+    if (hist->total + total > SHAPE_DECAY) {
+        hist->total = 0;
+        for (unsigned b = 0; b < SHAPE_BUCKETS; ++b) {
+            hist->count[b] /= 2;
+            hist->sum[b] /= 2;
+            hist->total += hist->count[b];
+        }
+    }
+    for (unsigned b = 0; b < SHAPE_BUCKETS; ++b) {
+        hist->count[b] += count[b];
+        hist->sum[b] += sum[b];
+    }
+    hist->total += total;
+}
+
+/// Copy the pulses and the meta data of a package, keeps the storage of @p dst.
+static void shape_copy_pulses(pulse_data_t *dst, pulse_data_t const *src)
+{
+    int *pulse          = dst->pulse;
+    int *gap            = dst->gap;
+    unsigned max_pulses = dst->max_pulses;
+    *dst                = *src;
+    dst->pulse          = pulse;
+    dst->gap            = gap;
+    dst->max_pulses     = max_pulses;
+    if (!src->num_pulses || pulse_data_reserve(dst, src->num_pulses) < 0) {
+        dst->num_pulses = 0;
+        return;
+    }
+    memcpy(dst->pulse, src->pulse, src->num_pulses * sizeof(*src->pulse));
+    memcpy(dst->gap, src->gap, src->num_pulses * sizeof(*src->gap));
+}
+
+/// Take the longest row of the codes the analyzer slicer logs.
+static void shape_capture_bits(r_device *device, int level, data_t *data)
+{
+    (void)level;
+    pulse_shape_t *shape = device->output_ctx;
+    for (data_t *d = data; d; d = d->next) {
+        if (d->type != DATA_ARRAY || strcmp(d->key, "codes"))
+            continue;
+        data_array_t const *codes = d->value.v_ptr;
+        char *const *rows = codes->values;
+        for (int i = 0; i < codes->num_values; ++i) {
+            unsigned bits = rows[i] ? (unsigned)strtoul(rows[i] + 1, NULL, 10) : 0; // "{<bits>}<hex>"
+            if (bits > shape->bits)
+                shape->bits = bits;
+        }
+    }
+    data_free(data);
+}
+
+/// Guess the modulation of the sample and slice it with the matching flex decoder.
+static void shape_describe(pulse_shape_t *shape)
+{
+    pulse_data_t const *sample = &shape->sample;
+    shape->guess   = NULL;
+    shape->flex[0] = '\0';
+    shape->bits    = 0;
+    if (!sample->num_pulses || !sample->sample_rate)
+        return;
+
+    pulse_stats_t stats;
+    pulse_stats_build(&stats, sample);
+    r_device device = {
+            .name       = "Discovery",
+            .verbose    = 2,
+            .log_level  = LOG_TRACE,
+            .log_fn     = shape_capture_bits,
+            .output_ctx = shape,
+    };
+    shape->guess = pulse_stats_guess(&stats, sample, shape->package_type, &device);
+    if (!device.modulation || !analyzer_flex_spec(&device, shape->flex, sizeof(shape->flex)))
+        return;
+
+    // the slicer terminates the package, keep the sample as received
+    pulse_data_t scratch = {0};
+    shape_copy_pulses(&scratch, sample);
+    if (scratch.num_pulses)
+        analyzer_slice(&scratch, &device);
+    pulse_data_free(&scratch);
+}
+
+int pulse_clusters_add(pulse_clusters_t *clusters, pulse_data_t const *data, int package_type)
+{
+    unsigned pulse_count[SHAPE_BUCKETS] = {0};
+    unsigned gap_count[SHAPE_BUCKETS]   = {0};
+    uint64_t pulse_sum[SHAPE_BUCKETS]   = {0};
+    uint64_t gap_sum[SHAPE_BUCKETS]     = {0};
+
+    // leave out the last gap, it's the end of the package
+    unsigned num_gaps = data->num_pulses ? data->num_pulses - 1 : 0;
+    for (unsigned n = 0; n < data->num_pulses; ++n) {
+        unsigned b = pulse_data_width_bin(data->pulse[n]);
+        pulse_count[b]++;
+        pulse_sum[b] += data->pulse[n] > 0 ? (unsigned)data->pulse[n] : 0;
+        if (n < num_gaps) {
+            b = pulse_data_width_bin(data->gap[n]);
+            gap_count[b]++;
+            gap_sum[b] += data->gap[n] > 0 ? (unsigned)data->gap[n] : 0;
+        }
+    }
+    uint64_t pulse_mask = shape_mask(pulse_count, data->num_pulses);
+    uint64_t gap_mask   = shape_mask(gap_count, num_gaps);
+
+    clusters_lock(clusters);
+    clusters->packages++;
+    pulse_shape_t *shape  = NULL;
+    pulse_shape_t *oldest = &clusters->shapes[0];
+    for (unsigned i = 0; i < SHAPE_MAX; ++i) {
+        pulse_shape_t *s = &clusters->shapes[i];
+        if (!s->num) {
+            oldest = s;
+            break; // the slots fill in order, there are no more shapes
+        }
+        if (s->package_type == package_type
+                && shape_mask_match(s->pulse_mask, pulse_mask)
+                && shape_mask_match(s->gap_mask, gap_mask)) {
+            shape = s;
+            break;
+        }
+        if (s->last_seen < oldest->last_seen)
+            oldest = s;
+    }
+
+    int is_new = !shape;
+    if (is_new) {
+        shape = oldest;
+        pulse_data_t sample = shape->sample; // reuse the storage
+        *shape = (pulse_shape_t){
+                .num          = ++clusters->shapes_num,
+                .package_type = package_type,
+                .pulse_mask   = pulse_mask,
+                .gap_mask     = gap_mask,
+                .first_time   = time(NULL),
+                .sample       = sample,
+        };
+        shape->sample.num_pulses = 0;
+    }
+    shape->packages++;
+    shape->last_seen   = clusters->packages;
+    shape->last_time   = is_new ? shape->first_time : time(NULL);
+    shape->sample_rate = data->sample_rate;
+    shape_hist_add(&shape->pulses, pulse_count, pulse_sum, data->num_pulses);
+    shape_hist_add(&shape->gaps, gap_count, gap_sum, num_gaps);
+
+    // the full analysis only runs on a new shape or a clearly better sample
+    if (clusters->keep_samples
+            && (is_new || data->snr_db >= shape->sample.snr_db + SHAPE_SNR_STEP)) {
+        shape_copy_pulses(&shape->sample, data);
+        shape_describe(shape);
+    }
+    int num = is_new ? (int)shape->num : 0;
+    clusters_unlock(clusters);
+
+    return num;
+}
+
+static void shape_hist_print(shape_hist_t const *hist, uint32_t sample_rate, FILE *out)
+{
+    double to_us = sample_rate ? 1e6 / sample_rate : 0.0;
+    char const *sep = "";
+    for (unsigned b = 0; b < SHAPE_BUCKETS; ++b) {
+        if (!hist->count[b] || hist->count[b] * SHAPE_SHARE < hist->total)
+            continue;
+        fprintf(out, "%s%.0f us (%u%%)", sep, (double)hist->sum[b] / hist->count[b] * to_us,
+                hist->count[b] * 100 / hist->total);
+        sep = ", ";
+    }
+    if (!*sep)
+        fprintf(out, "none");
+}
+
+void pulse_clusters_print(pulse_clusters_t *clusters, FILE *out)
+{
+    clusters_lock(clusters);
+    fprintf(out, "Signal shapes: %u in %u packages\n", clusters->shapes_num, clusters->packages);
+    for (unsigned i = 0; i < SHAPE_MAX && clusters->shapes[i].num; ++i) {
+        pulse_shape_t const *s = &clusters->shapes[i];
+        fprintf(out, " [#%u] %s packages: %4u,  pulses: ", s->num,
+                s->package_type == PULSE_DATA_FSK ? "FSK" : "OOK", s->packages);
+        shape_hist_print(&s->pulses, s->sample_rate, out);
+        fprintf(out, ",  gaps: ");
+        shape_hist_print(&s->gaps, s->sample_rate, out);
+        fprintf(out, "\n");
+        if (s->guess)
+            fprintf(out, "      %s, %u bits%s%s%s\n", s->guess, s->bits,
+                    *s->flex ? ", -X '" : "", s->flex, *s->flex ? "'" : "");
+    }
+    clusters_unlock(clusters);
+}
+
+/// The widths of a rolling histogram, as a list of width and share.
+static data_t *shape_hist_data(shape_hist_t const *hist, uint32_t sample_rate)
+{
+    double to_us = sample_rate ? 1e6 / sample_rate : 0.0;
+    data_t *widths[SHAPE_BUCKETS];
+    int num = 0;
+    for (unsigned b = 0; b < SHAPE_BUCKETS; ++b) {
+        if (!hist->count[b] || hist->count[b] * SHAPE_SHARE < hist->total)
+            continue;
+        /* clang-format off */
+        widths[num++] = data_make(
+                "width_us", "", DATA_INT, (int)((double)hist->sum[b] / hist->count[b] * to_us + 0.5),
+                "share",    "", DATA_INT, (int)(hist->count[b] * 100 / hist->total),
+                NULL);
+        /* clang-format on */
+    }
+    return data_make(
+            "widths", "", DATA_ARRAY, data_array(num, DATA_DATA, widths),
+            NULL);
+}
+
+data_t *pulse_clusters_data(pulse_clusters_t *clusters)
+{
+    clusters_lock(clusters);
+    data_t *shapes[SHAPE_MAX];
+    int num = 0;
+    for (unsigned i = 0; i < SHAPE_MAX && clusters->shapes[i].num; ++i) {
+        pulse_shape_t const *s = &clusters->shapes[i];
+        char first_str[LOCAL_TIME_BUFLEN];
+        char last_str[LOCAL_TIME_BUFLEN];
+        format_time_str(first_str, "%Y-%m-%dT%H:%M:%S", 0, s->first_time);
+        format_time_str(last_str, "%Y-%m-%dT%H:%M:%S", 0, s->last_time);
+        /* clang-format off */
+        data_t *data = data_make(
+                "shape",        "", DATA_INT,    (int)s->num,
+                "mod",          "", DATA_STRING, s->package_type == PULSE_DATA_FSK ? "FSK" : "OOK",
+                "packages",     "", DATA_INT,    (int)s->packages,
+                "first_seen",   "", DATA_STRING, first_str,
+                "last_seen",    "", DATA_STRING, last_str,
+                "pulses",       "", DATA_DATA,   shape_hist_data(&s->pulses, s->sample_rate),
+                "gaps",         "", DATA_DATA,   shape_hist_data(&s->gaps, s->sample_rate),
+                NULL);
+        /* clang-format on */
+        if (s->guess) {
+            data = data_str(data, "guess", "", NULL, s->guess);
+            data = data_int(data, "bits", "", NULL, (int)s->bits);
+            if (*s->flex)
+                data = data_str(data, "flex", "", NULL, s->flex);
+            data = data_dbl(data, "freq", "", "%.3f MHz", s->sample.freq1_hz / 1e6);
+            data = data_dbl(data, "rssi", "", "%.1f dB", (double)s->sample.rssi_db);
+            data = data_dbl(data, "snr", "", "%.1f dB", (double)s->sample.snr_db);
+        }
+        /* clang-format on */
+        shapes[num++] = data;
+    }
+    /* clang-format off */
+    data_t *data = data_make(
+            "packages",     "", DATA_INT,   (int)clusters->packages,
+            "found",        "", DATA_INT,   (int)clusters->shapes_num,
+            "shapes",       "", DATA_ARRAY, data_array(num, DATA_DATA, shapes),
+            NULL);
+    /* clang-format on */
+    clusters_unlock(clusters);
+    return data;
+}
+
+char *pulse_clusters_sample_ook(pulse_clusters_t *clusters, unsigned num, size_t *len)
+{
+    char *text = NULL;
+    clusters_lock(clusters);
+    for (unsigned i = 0; i < SHAPE_MAX && clusters->shapes[i].num; ++i) {
+        pulse_shape_t const *s = &clusters->shapes[i];
+        if (s->num != num || !s->sample.num_pulses)
+            continue;
+        // reuse the dumper format through a temporary file
+        FILE *file = tmpfile();
+        if (!file) {
+            break;
+        }
+        pulse_data_dump(file, &s->sample);
+        long size = ftell(file);
+        rewind(file);
+        text = size > 0 ? malloc((size_t)size + 1) : NULL;
+        if (!text) {
+            WARN_MALLOC("pulse_clusters_sample_ook()");
+        }
+        else {
+            *len       = fread(text, 1, (size_t)size, file);
+            text[*len] = '\0';
+        }
+        fclose(file);
+        break;
+    }
+    clusters_unlock(clusters);
+    return text;
+}
@@ -18,16 +18,115 @@
 #include <stdlib.h>
 #include <string.h>
 
+/// Number of entries in use, the detectors write at most one entry past the pulses.
+static unsigned pulse_data_used(pulse_data_t const *data)
+{
+    return data->num_pulses < data->max_pulses ? data->num_pulses + 1 : data->max_pulses;
+}
+
 void pulse_data_clear(pulse_data_t *data)
 {
+    int *pulse          = data->pulse;
+    int *gap            = data->gap;
+    unsigned max_pulses = data->max_pulses;
+    unsigned used       = pulse_data_used(data);
+    if (used) {
+        memset(pulse, 0, used * sizeof(*pulse));
+        memset(gap, 0, used * sizeof(*gap));
+    }
+
     *data = (pulse_data_t const){0};
+    data->pulse      = pulse;
+    data->gap        = gap;
+    data->max_pulses = max_pulses;
+}
+
+int pulse_data_reserve(pulse_data_t *data, unsigned num_pulses)
+{
+    if (num_pulses <= data->max_pulses)
+        return 0;
+    if (num_pulses > PD_MAX_PULSES)
+        return -1;
+
+    unsigned max_pulses = data->max_pulses ? data->max_pulses : PD_INITIAL_PULSES;
+    while (max_pulses < num_pulses)
+        max_pulses *= 2;
+    if (max_pulses > PD_MAX_PULSES)
+        max_pulses = PD_MAX_PULSES;
+
+    // pulses and gaps share one block, the first half holds the pulses
+    int *pulse = calloc(2 * max_pulses, sizeof(*pulse));
+    if (!pulse)
+        FATAL_CALLOC("pulse_data_reserve()");
+    if (data->max_pulses) {
+        memcpy(pulse, data->pulse, data->max_pulses * sizeof(*pulse));
+        memcpy(&pulse[max_pulses], data->gap, data->max_pulses * sizeof(*pulse));
+    }
+    free(data->pulse);
+    data->pulse      = pulse;
+    data->gap        = &pulse[max_pulses];
+    data->max_pulses = max_pulses;
+    return 0;
+}
+
+void pulse_data_free(pulse_data_t *data)
+{
+    free(data->pulse);
+    data->pulse      = NULL;
+    data->gap        = NULL;
+    data->max_pulses = 0;
+}
+
+void pulse_data_copy(pulse_data_t *dst, pulse_data_t const *src)
+{
+    unsigned used = pulse_data_used(src);
+    pulse_data_reserve(dst, used);
+
+    int *pulse          = dst->pulse;
+    int *gap            = dst->gap;
+    unsigned max_pulses = dst->max_pulses;
+    *dst                = *src;
+    dst->pulse          = pulse;
+    dst->gap            = gap;
+    dst->max_pulses     = max_pulses;
+    if (used) {
+        memcpy(pulse, src->pulse, used * sizeof(*pulse));
+        memcpy(gap, src->gap, used * sizeof(*gap));
+    }
+}
+
+unsigned pulse_data_width_bin(int width)
+{
+    if (width < 4)
+        return width > 0 ? width : 0;
+    unsigned msb = 2;
+    while (msb < 15 && width >> (msb + 1))
+        msb++;
+    if (width >> (msb + 1))
+        return 63;
+    return msb * 4 + ((width >> (msb - 2)) & 3);
+}
+
+void pulse_data_fingerprint(pulse_data_t *data)
+{
+    uint64_t pulse_bins = 0;
+    uint64_t gap_bins   = 0;
+    for (unsigned n = 0; n < data->num_pulses; ++n) {
+        pulse_bins |= (uint64_t)1 << pulse_data_width_bin(data->pulse[n]);
+        gap_bins |= (uint64_t)1 << pulse_data_width_bin(data->gap[n]);
+    }
+    data->pulse_bins = pulse_bins;
+    data->gap_bins   = gap_bins;
 }
 
 void pulse_data_shift(pulse_data_t *data)
 {
-    int offs = PD_MAX_PULSES / 2; // shift out half the data
-    memmove(data->pulse, &data->pulse[offs], (PD_MAX_PULSES - offs) * sizeof(*data->pulse));
-    memmove(data->gap, &data->gap[offs], (PD_MAX_PULSES - offs) * sizeof(*data->gap));
+    unsigned offs = PD_MAX_PULSES / 2; // shift out half the data
+    unsigned used = pulse_data_used(data);
+    if (used < offs)
+        return;
+    memmove(data->pulse, &data->pulse[offs], (used - offs) * sizeof(*data->pulse));
+    memmove(data->gap, &data->gap[offs], (used - offs) * sizeof(*data->gap));
     data->num_pulses -= offs;
     data->offset += offs;
 }
@@ -40,28 +139,42 @@ void pulse_data_print(pulse_data_t const *data)
     }
 }
 
-static void *bounded_memset(void *b, int c, int64_t size, int64_t offset, int64_t len)
+void pulse_data_dump_raw(uint8_t *buf, unsigned len, uint64_t buf_offset, pulse_data_t const *data, uint8_t bits, unsigned dirty[2])
 {
-    if (offset < 0) {
-        len += offset; // reduce len by negative offset
-        offset = 0;
-    }
-    if (offset + len > size) {
-        len = size - offset; // clip excessive len
+    int64_t pos = (int64_t)data->offset - (int64_t)buf_offset;
+    unsigned n  = 0;
+    // skip the pulses that ended before the buffer
+    for (; n < data->num_pulses && pos + data->pulse[n] + data->gap[n] <= 0; ++n)
+        pos += data->pulse[n] + data->gap[n];
+    if (n == data->num_pulses || pos >= len)
+        return;
+
+    unsigned start = pos < 0 ? 0 : (unsigned)pos;
+    for (; n < data->num_pulses && pos < len; ++n) {
+        int64_t end = pos + data->pulse[n];
+        int64_t from = pos < 0 ? 0 : pos;
+        int64_t to   = end > len ? len : end;
+        if (to > from)
+            memset(buf + from, 0x01 | bits, (size_t)(to - from));
+        pos = end;
+        end = pos + data->gap[n];
+        from = pos < 0 ? 0 : pos;
+        to   = end > len ? len : end;
+        if (to > from)
+            memset(buf + from, 0x01, (size_t)(to - from));
+        pos = end;
     }
-    if (len > 0)
-        memset((char *)b + offset, c, (size_t)len);
-    return b;
-}
+    unsigned stop = pos > len ? len : (unsigned)pos;
 
-void pulse_data_dump_raw(uint8_t *buf, unsigned len, uint64_t buf_offset, pulse_data_t const *data, uint8_t bits)
-{
-    int64_t pos = data->offset - buf_offset;
-    for (unsigned n = 0; n < data->num_pulses; ++n) {
-        bounded_memset(buf, 0x01 | bits, len, pos, data->pulse[n]);
-        pos += data->pulse[n];
-        bounded_memset(buf, 0x01, len, pos, data->gap[n]);
-        pos += data->gap[n];
+    if (dirty[0] == dirty[1]) {
+        dirty[0] = start;
+        dirty[1] = stop;
+    }
+    else {
+        if (start < dirty[0])
+            dirty[0] = start;
+        if (stop > dirty[1])
+            dirty[1] = stop;
     }
 }
 
@@ -98,32 +211,62 @@ void pulse_data_print_vcd_header(FILE *file, uint32_t sample_rate)
     chk_ret(fprintf(file, "#0 0/ 0' 0\"\n"));
 }
 
+/// Append a VCD change like "#1234 1'" and a newline, the time in integer units.
+static char *vcd_change(char *p, uint64_t time, char const *values)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + time % 10);
+        time /= 10;
+    } while (time);
+    *p++ = '#';
+    while (n)
+        *p++ = digits[--n];
+    *p++ = ' ';
+    while (*values)
+        *p++ = *values++;
+    *p++ = '\n';
+    return p;
+}
+
 void pulse_data_print_vcd(FILE *file, pulse_data_t const *data, int ch_id)
 {
-    float scale;
+    uint64_t scale;
     if (data->sample_rate <= 500000)
         scale = 1000000 / data->sample_rate; // unit: 1 us
     else
         scale = 10000000 / data->sample_rate; // unit: 100 ns
+
+    char const hi_frame[] = {'1', '/', ' ', '1', (char)ch_id, '\0'};
+    char const hi[]       = {'1', (char)ch_id, '\0'};
+    char const lo[]       = {'0', (char)ch_id, '\0'};
+
+    // all changes of the package are formatted into one buffer, a line is at most 30 chars
+    char buf[4096];
+    char *p     = buf;
     uint64_t pos = data->offset;
     for (unsigned n = 0; n < data->num_pulses; ++n) {
-        if (n == 0)
-            chk_ret(fprintf(file, "#%.f 1/ 1%c\n", pos * scale, ch_id));
-        else
-            chk_ret(fprintf(file, "#%.f 1%c\n", pos * scale, ch_id));
+        if (p > buf + sizeof(buf) - 64) {
+            chk_ret(fwrite(buf, 1, (size_t)(p - buf), file) == (size_t)(p - buf) ? 0 : -1);
+            p = buf;
+        }
+        p = vcd_change(p, pos * scale, n == 0 ? hi_frame : hi);
         pos += data->pulse[n];
-        chk_ret(fprintf(file, "#%.f 0%c\n", pos * scale, ch_id));
+        p = vcd_change(p, pos * scale, lo);
         pos += data->gap[n];
     }
     if (data->num_pulses > 0)
-        chk_ret(fprintf(file, "#%.f 0/\n", pos * scale));
+        p = vcd_change(p, pos * scale, "0/");
+    if (p > buf)
+        chk_ret(fwrite(buf, 1, (size_t)(p - buf), file) == (size_t)(p - buf) ? 0 : -1);
 }
 
 void pulse_data_load(FILE *file, pulse_data_t *data, uint32_t sample_rate)
 {
     char s[1024];
     int i    = 0;
-    int size = sizeof(data->pulse) / sizeof(*data->pulse);
+    int size = PD_MAX_PULSES;
 
     pulse_data_clear(data);
     data->sample_rate = sample_rate;
@@ -157,6 +300,7 @@ void pulse_data_load(FILE *file, pulse_data_t *data, uint32_t sample_rate)
         p          = endptr + 1;
         long space = strtol(p, &endptr, 10);
         // fprintf(stderr, "read: mark %ld space %ld\n", mark, space);
+        pulse_data_reserve(data, i + 1);
         data->pulse[i] = (int)(to_sample * mark);
         data->gap[i++] = (int)(to_sample * space);
     }
@@ -212,9 +356,274 @@ void pulse_data_dump(FILE *file, pulse_data_t const *data)
     chk_ret(fprintf(file, ";end\n"));
 }
 
+#define PD_BIN_MAGIC "RTL433PD"
+#define PD_BIN_TAG   'P'
+
+/// Append a varint, needs 10 bytes of room.
+static unsigned put_varint(uint8_t *buf, uint64_t val)
+{
+    unsigned n = 0;
+    while (val >= 0x80) {
+        buf[n++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    buf[n++] = (uint8_t)val;
+    return n;
+}
+
+/// Append a zigzag encoded signed varint, needs 10 bytes of room.
+static unsigned put_svarint(uint8_t *buf, int64_t val)
+{
+    return put_varint(buf, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+/// A package source, a file or a buffer.
+typedef struct pd_reader {
+    FILE *file;
+    uint8_t const *buf;
+    size_t len;
+    size_t pos;
+} pd_reader_t;
+
+static int read_byte(pd_reader_t *reader)
+{
+    if (reader->file)
+        return getc(reader->file);
+    return reader->pos < reader->len ? reader->buf[reader->pos++] : EOF;
+}
+
+/// Read a varint, returns -1 on a truncated or overlong value.
+static int get_varint(pd_reader_t *reader, uint64_t *val)
+{
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int c = read_byte(reader);
+        if (c == EOF)
+            return -1;
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *val = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/// Read a zigzag encoded signed varint, returns -1 on a truncated or overlong value.
+static int get_svarint(pd_reader_t *reader, int64_t *val)
+{
+    uint64_t v;
+    if (get_varint(reader, &v))
+        return -1;
+    *val = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    return 0;
+}
+
+static int64_t to_decibels(float db)
+{
+    return (int64_t)(db * 10.0f + (db < 0.0f ? -0.5f : 0.5f));
+}
+
+size_t pulse_data_encode_bin_header(uint8_t *buf)
+{
+    struct timeval now;
+    get_time_now(&now);
+    uint64_t time_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+    memcpy(buf, PD_BIN_MAGIC, 8);
+    for (unsigned i = 0; i < 4; ++i)
+        buf[8 + i] = (uint8_t)(PD_BIN_VERSION >> (8 * i));
+    for (unsigned i = 0; i < 8; ++i)
+        buf[12 + i] = (uint8_t)(time_us >> (8 * i));
+    return PD_BIN_HEADER_LEN;
+}
+
+void pulse_data_print_bin_header(FILE *file)
+{
+    if (!file) {
+        FATAL("Invalid stream in pulse_data_print_bin_header()");
+    }
+
+    uint8_t buf[PD_BIN_HEADER_LEN];
+    pulse_data_encode_bin_header(buf);
+    chk_ret(fwrite(buf, sizeof(buf), 1, file) == 1 ? 0 : -1);
+}
+
+/// Encode the fields of a package up to the pulses, needs 170 bytes of room.
+static unsigned encode_package_fields(uint8_t *buf, pulse_data_t const *data)
+{
+    unsigned n = 0;
+    buf[n++] = PD_BIN_TAG;
+    n += put_varint(&buf[n], data->fsk_f2_est ? 1 : 0);
+    n += put_varint(&buf[n], data->offset);
+    n += put_varint(&buf[n], data->sample_rate);
+    n += put_varint(&buf[n], data->depth_bits);
+    n += put_varint(&buf[n], data->centerfreq_hz > 0.0f ? (uint64_t)(data->centerfreq_hz + 0.5f) : 0);
+    n += put_svarint(&buf[n], (int64_t)data->freq1_hz);
+    n += put_svarint(&buf[n], (int64_t)data->freq2_hz);
+    n += put_svarint(&buf[n], to_decibels(data->range_db));
+    n += put_svarint(&buf[n], to_decibels(data->rssi_db));
+    n += put_svarint(&buf[n], to_decibels(data->snr_db));
+    n += put_svarint(&buf[n], to_decibels(data->noise_db));
+    n += put_svarint(&buf[n], data->ook_low_estimate);
+    n += put_svarint(&buf[n], data->ook_high_estimate);
+    n += put_svarint(&buf[n], data->fsk_f1_est);
+    n += put_svarint(&buf[n], data->fsk_f2_est);
+    n += put_varint(&buf[n], data->num_pulses);
+    return n;
+}
+
+void pulse_data_dump_bin(FILE *file, pulse_data_t const *data)
+{
+    if (!file) {
+        FATAL("Invalid stream in pulse_data_dump_bin()");
+    }
+
+    // the package is assembled in the buffer and written in few chunks
+    uint8_t buf[4096];
+    unsigned n = encode_package_fields(buf, data);
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        if (n > sizeof(buf) - 20) {
+            chk_ret(fwrite(buf, n, 1, file) == 1 ? 0 : -1);
+            n = 0;
+        }
+        n += put_varint(&buf[n], data->pulse[i] > 0 ? (unsigned)data->pulse[i] : 0);
+        n += put_varint(&buf[n], data->gap[i] > 0 ? (unsigned)data->gap[i] : 0);
+    }
+    chk_ret(fwrite(buf, n, 1, file) == 1 ? 0 : -1);
+}
+
+size_t pulse_data_encode_bin(uint8_t *buf, size_t size, pulse_data_t const *data)
+{
+    // the widths are 32 bit, at most 5 bytes each
+    if (size < 170 + (size_t)data->num_pulses * 10)
+        return 0;
+
+    size_t n = encode_package_fields(buf, data);
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        n += put_varint(&buf[n], data->pulse[i] > 0 ? (unsigned)data->pulse[i] : 0);
+        n += put_varint(&buf[n], data->gap[i] > 0 ? (unsigned)data->gap[i] : 0);
+    }
+    return n;
+}
+
+/// Check the magic and version of a header, returns 0 on success or -1 if it is none.
+static int check_bin_header(uint8_t const *buf)
+{
+    if (memcmp(buf, PD_BIN_MAGIC, 8)) {
+        fprintf(stderr, "Not a binary pulse data file\n");
+        return -1;
+    }
+    unsigned version = buf[8] | buf[9] << 8 | buf[10] << 16 | (unsigned)buf[11] << 24;
+    if (version != PD_BIN_VERSION) {
+        fprintf(stderr, "Unsupported binary pulse data version %u\n", version);
+        return -1;
+    }
+    return 0;
+}
+
+int pulse_data_load_bin_header(FILE *file)
+{
+    uint8_t buf[PD_BIN_HEADER_LEN];
+    if (fread(buf, sizeof(buf), 1, file) != 1) {
+        fprintf(stderr, "Not a binary pulse data file\n");
+        return -1;
+    }
+    return check_bin_header(buf);
+}
+
+size_t pulse_data_decode_bin_header(uint8_t const *buf, size_t len)
+{
+    if (len < PD_BIN_HEADER_LEN || check_bin_header(buf))
+        return 0;
+    return PD_BIN_HEADER_LEN;
+}
+
+/// Read the next package, returns 0 on success, 1 at the end, or -1 on error.
+static int load_package(pd_reader_t *reader, pulse_data_t *data)
+{
+    pulse_data_clear(data);
+
+    int c = read_byte(reader);
+    if (c == EOF)
+        return 1;
+
+    uint64_t flags, offset, sample_rate, depth_bits, centerfreq, num_pulses;
+    int64_t freq1, freq2, range, rssi, snr, noise, ook_low, ook_high, fsk_f1, fsk_f2;
+    if (c != PD_BIN_TAG
+            || get_varint(reader, &flags)
+            || get_varint(reader, &offset)
+            || get_varint(reader, &sample_rate)
+            || get_varint(reader, &depth_bits)
+            || get_varint(reader, &centerfreq)
+            || get_svarint(reader, &freq1)
+            || get_svarint(reader, &freq2)
+            || get_svarint(reader, &range)
+            || get_svarint(reader, &rssi)
+            || get_svarint(reader, &snr)
+            || get_svarint(reader, &noise)
+            || get_svarint(reader, &ook_low)
+            || get_svarint(reader, &ook_high)
+            || get_svarint(reader, &fsk_f1)
+            || get_svarint(reader, &fsk_f2)
+            || get_varint(reader, &num_pulses)
+            || num_pulses > PD_MAX_PULSES) {
+        fprintf(stderr, "Invalid binary pulse data package\n");
+        return -1;
+    }
+    data->offset            = offset;
+    data->sample_rate       = (uint32_t)sample_rate;
+    data->depth_bits        = (unsigned)depth_bits;
+    data->centerfreq_hz     = (float)centerfreq;
+    data->freq1_hz          = (float)freq1;
+    data->freq2_hz          = (float)freq2;
+    data->range_db          = range * 0.1f;
+    data->rssi_db           = rssi * 0.1f;
+    data->snr_db            = snr * 0.1f;
+    data->noise_db          = noise * 0.1f;
+    data->ook_low_estimate  = (int)ook_low;
+    data->ook_high_estimate = (int)ook_high;
+    data->fsk_f1_est        = (int)fsk_f1;
+    data->fsk_f2_est        = (int)fsk_f2;
+    if ((flags & 1) && !data->fsk_f2_est)
+        data->fsk_f2_est = 1; // keep the package FSK
+
+    // room for the entry past the pulses
+    pulse_data_reserve(data, (unsigned)num_pulses < PD_MAX_PULSES ? (unsigned)num_pulses + 1 : PD_MAX_PULSES);
+    for (unsigned i = 0; i < num_pulses; ++i) {
+        uint64_t pulse, gap;
+        if (get_varint(reader, &pulse) || get_varint(reader, &gap)) {
+            fprintf(stderr, "Truncated binary pulse data package\n");
+            data->num_pulses = 0;
+            return -1;
+        }
+        data->pulse[i] = (int)pulse;
+        data->gap[i]   = (int)gap;
+    }
+    data->num_pulses = (unsigned)num_pulses;
+    return 0;
+}
+
+void pulse_data_load_bin(FILE *file, pulse_data_t *data)
+{
+    pd_reader_t reader = {.file = file};
+    load_package(&reader, data);
+}
+
+size_t pulse_data_decode_bin(uint8_t const *buf, size_t len, pulse_data_t *data)
+{
+    pd_reader_t reader = {.buf = buf, .len = len};
+    if (load_package(&reader, data))
+        return 0;
+    return reader.pos;
+}
+
 data_t *pulse_data_print_data(pulse_data_t const *data)
 {
-    int pulses[2 * PD_MAX_PULSES];
+    int *pulses = malloc(2 * (data->num_pulses ? data->num_pulses : 1) * sizeof(*pulses));
+    if (!pulses) {
+        WARN_MALLOC("pulse_data_print_data()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
     double to_us = 1e6 / data->sample_rate;
     for (unsigned i = 0; i < data->num_pulses; ++i) {
         pulses[i * 2 + 0] = data->pulse[i] * to_us;
@@ -222,7 +631,7 @@ data_t *pulse_data_print_data(pulse_data_t const *data)
     }
 
     /* clang-format off */
-    return data_make(
+    data_t *d = data_make(
             "mod",              "", DATA_STRING, (data->fsk_f2_est) ? "FSK" : "OOK",
             "count",            "", DATA_INT,    data->num_pulses,
             "pulses",           "", DATA_ARRAY,  data_array(2 * data->num_pulses, DATA_INT, pulses),
@@ -235,6 +644,10 @@ data_t *pulse_data_print_data(pulse_data_t const *data)
             "rssi_dB",          "", DATA_FORMAT, "%.1f dB", DATA_DOUBLE, data->rssi_db,
             "snr_dB",           "", DATA_FORMAT, "%.1f dB", DATA_DOUBLE, data->snr_db,
             "noise_dB",         "", DATA_FORMAT, "%.1f dB", DATA_DOUBLE, data->noise_db,
+            "iq",               "", DATA_COND,   data->iq_snippet != 0, DATA_INT, (int)data->iq_snippet,
             NULL);
     /* clang-format on */
+
+    free(pulses);
+    return d;
 }
@@ -21,8 +21,13 @@
 #include <stdlib.h>
 
 // OOK adaptive level estimator constants
+#ifdef FIXED_POINT
+#define OOK_MAX_HIGH_LEVEL  16384       // DB_TO_AMP(0) without the float exp10
+#define OOK_MAX_LOW_LEVEL   518         // DB_TO_AMP(-15)
+#else
 #define OOK_MAX_HIGH_LEVEL  DB_TO_AMP(0)   // Maximum estimate for high level (-0 dB)
 #define OOK_MAX_LOW_LEVEL   DB_TO_AMP(-15) // Maximum estimate for low level
+#endif
 #define OOK_EST_HIGH_RATIO  64          // Constant for slowness of OOK high level estimator
 #define OOK_EST_LOW_RATIO   1024        // Constant for slowness of OOK low level (noise) estimator (very slow)
 
@@ -50,9 +55,79 @@ struct pulse_detect {
 
     int verbosity; ///< Debug output verbosity, 0=None, 1=Levels, 2=Histograms
 
+    pulse_detect_fm_fn fm_fn; ///< On demand FM source, NULL if the FM data is complete
+    void *fm_ctx;             ///< User context for the FM source
+    int fm_ready;             ///< Number of valid FM samples in this chunk
+
+    unsigned stream_pulses;   ///< Number of pulses between partial packages, 0 = off
+    unsigned stream_mark;     ///< Number of OOK pulses for the next partial package
+    unsigned fsk_stream_mark; ///< Number of FSK pulses for the next partial package
+
+    uint64_t pulse_level_sum; ///< Sum of the envelope over the pulse samples of this package
+    unsigned pulse_samples;   ///< Number of pulse samples of this package
+    int pulse_peak;           ///< Peak envelope of the pulse samples of this package
+
     pulse_detect_fsk_t pulse_detect_fsk;
+    int fsk_track_seed;    ///< Seed the FSK detector from the tracked offsets
+    fsk_track_t fsk_track; ///< FSK offsets of the recent decoded packages
 };
 
+void pulse_detect_set_fm_source(pulse_detect_t *pulse_detect, pulse_detect_fm_fn fm_fn, void *fm_ctx)
+{
+    pulse_detect->fm_fn    = fm_fn;
+    pulse_detect->fm_ctx   = fm_ctx;
+    pulse_detect->fm_ready = 0;
+}
+
+/// Get FM sample @p n, demodulating on demand.
+static inline int16_t fm_sample(pulse_detect_t *s, int16_t const *fm_data, int n)
+{
+    if (s->fm_fn && n >= s->fm_ready)
+        s->fm_ready = s->fm_fn(s->fm_ctx, n);
+    return fm_data[n];
+}
+
+void pulse_detect_set_stream(pulse_detect_t *pulse_detect, unsigned stream_pulses)
+{
+    pulse_detect->stream_pulses = stream_pulses;
+}
+
+int pulse_detect_in_package(pulse_detect_t const *pulse_detect)
+{
+    return pulse_detect->ook_state != PD_OOK_STATE_IDLE;
+}
+
+void pulse_detect_get_estimates(pulse_detect_t const *pulse_detect, pulse_detect_estimates_t *estimates)
+{
+    estimates->ook_low_estimate  = pulse_detect->ook_low_estimate;
+    estimates->ook_high_estimate = pulse_detect->ook_high_estimate;
+    estimates->lead_in_counter   = pulse_detect->lead_in_counter;
+    estimates->fsk_track         = pulse_detect->fsk_track;
+}
+
+void pulse_detect_set_estimates(pulse_detect_t *pulse_detect, pulse_detect_estimates_t const *estimates)
+{
+    pulse_detect->ook_low_estimate  = estimates->ook_low_estimate;
+    pulse_detect->ook_high_estimate = estimates->ook_high_estimate;
+    pulse_detect->lead_in_counter   = estimates->lead_in_counter;
+    pulse_detect->fsk_track         = estimates->fsk_track;
+}
+
+void pulse_detect_set_fsk_track(pulse_detect_t *pulse_detect, int enable)
+{
+    pulse_detect->fsk_track_seed = enable;
+}
+
+void pulse_detect_track_fsk(pulse_detect_t *pulse_detect, pulse_data_t const *fsk_pulses)
+{
+    fsk_track_add(&pulse_detect->fsk_track, fsk_pulses->fsk_f1_est, fsk_pulses->fsk_f2_est);
+}
+
+int pulse_detect_fsk_offset(pulse_detect_t const *pulse_detect, int *hi_est, int *lo_est)
+{
+    return fsk_track_seed(&pulse_detect->fsk_track, hi_est, lo_est);
+}
+
 pulse_detect_t *pulse_detect_create(void)
 {
     pulse_detect_t *pulse_detect = calloc(1, sizeof(pulse_detect_t));
@@ -183,6 +258,108 @@ static void print_att_hist(char const *s, int att_hist[])
     }
 }
 
+/// Samples per block for the idle and gap scans.
+#define PD_SCAN_BLOCK 16
+
+/// Default high level estimate while idle, a ratio of the low level.
+static inline int idle_high_estimate(pulse_detect_t const *pulse_detect, int ook_low_estimate)
+{
+    int ook_high_estimate = pulse_detect->ook_high_low_ratio * ook_low_estimate;
+    ook_high_estimate     = MAX(ook_high_estimate, pulse_detect->ook_min_high_level);
+    return MIN(ook_high_estimate, OOK_MAX_HIGH_LEVEL);
+}
+
+/// Level a sample needs to exceed to start a pulse, i.e. the OOK threshold plus hysteresis.
+static inline int ook_trigger_level(pulse_detect_t const *pulse_detect, int ook_low_estimate, int ook_high_estimate)
+{
+    int16_t ook_threshold = (ook_low_estimate + ook_high_estimate) / 2;
+    if (pulse_detect->ook_fixed_high_level != 0) {
+        ook_threshold = pulse_detect->ook_fixed_high_level; // Manual override
+    }
+    return ook_threshold + ook_threshold / 8;
+}
+
+/// Level an idle sample needs to exceed to start a pulse, never decreases with the low level.
+static inline int idle_trigger_level(pulse_detect_t const *pulse_detect, int ook_low_estimate)
+{
+    return ook_trigger_level(pulse_detect, ook_low_estimate, idle_high_estimate(pulse_detect, ook_low_estimate));
+}
+
+/// Find the first sample above a level before @p end, blocks without one are scanned at once.
+static int find_rising_edge(int16_t const *envelope_data, int pos, int end, int level)
+{
+    for (; pos + PD_SCAN_BLOCK <= end; pos += PD_SCAN_BLOCK) {
+        int x_max = envelope_data[pos];
+        for (int i = 1; i < PD_SCAN_BLOCK; ++i) {
+            x_max = MAX(x_max, envelope_data[pos + i]);
+        }
+        if (x_max > level)
+            break;
+    }
+    while (pos < end && envelope_data[pos] <= level) {
+        pos++;
+    }
+    return pos;
+}
+
+/** Skip idle samples which can't start a pulse.
+
+    Each update moves the noise estimate down by at most the block span over
+    OOK_EST_LOW_RATIO plus one, and never above the block maximum. A block whose
+    maximum stays below the trigger level of the lowest reachable estimate can't
+    start a pulse, only the noise estimator runs over it. The result matches the
+    state machine exactly.
+
+    @return the position of the first block which might start a pulse, or the last partial block
+*/
+static int pulse_detect_skip_idle(pulse_detect_t *pulse_detect, int16_t const *envelope_data, int pos, int len)
+{
+    int ook_low_estimate = pulse_detect->ook_low_estimate;
+    for (; pos + PD_SCAN_BLOCK <= len; pos += PD_SCAN_BLOCK) {
+        int16_t const *x = &envelope_data[pos];
+        int x_min = x[0];
+        int x_max = x[0];
+        for (int i = 1; i < PD_SCAN_BLOCK; ++i) {
+            x_min = MIN(x_min, x[i]);
+            x_max = MAX(x_max, x[i]);
+        }
+        int const span   = MAX(ook_low_estimate, x_max) - x_min;
+        int const low_lo = ook_low_estimate - PD_SCAN_BLOCK * (span / OOK_EST_LOW_RATIO + 1);
+        if (x_max > idle_trigger_level(pulse_detect, low_lo))
+            break;
+        for (int i = 0; i < PD_SCAN_BLOCK; ++i) {
+            int const ook_low_delta = x[i] - ook_low_estimate;
+            ook_low_estimate += ook_low_delta / OOK_EST_LOW_RATIO;
+            ook_low_estimate += ((ook_low_delta > 0) ? 1 : -1);
+        }
+    }
+    pulse_detect->ook_low_estimate  = ook_low_estimate;
+    pulse_detect->ook_high_estimate = idle_high_estimate(pulse_detect, ook_low_estimate);
+    return pos;
+}
+
+/// Store the level statistics of the pulse samples so far.
+static void pulse_detect_store_levels(pulse_detect_t *s, pulse_data_t *pulses)
+{
+    pulses->ook_low_estimate  = s->ook_low_estimate;
+    pulses->ook_high_estimate = s->ook_high_estimate;
+    pulses->pulse_peak        = s->pulse_peak;
+    pulses->pulse_mean        = s->pulse_samples ? (int)(s->pulse_level_sum / s->pulse_samples) : 0;
+}
+
+/// Demodulate FSK for the samples from @p from up to @p to of the first pulse.
+static void pulse_detect_fsk_block(pulse_detect_t *s, int16_t const *fm_data, int from, int to, pulse_data_t *fsk_pulses, unsigned fpdm)
+{
+    if (to <= from)
+        return;
+    fm_sample(s, fm_data, to - 1); // make the FM data ready for the whole block
+    if (fpdm == FSK_PULSE_DETECT_OLD) {
+        pulse_detect_fsk_classic_block(&s->pulse_detect_fsk, &fm_data[from], to - from, fsk_pulses);
+    } else {
+        pulse_detect_fsk_minmax_block(&s->pulse_detect_fsk, &fm_data[from], to - from, fsk_pulses);
+    }
+}
+
 /// Demodulate On/Off Keying (OOK) and Frequency Shift Keying (FSK) from an envelope signal
 int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_data, int16_t const *fm_data, int len, uint32_t samp_rate, uint64_t sample_offset, pulse_data_t *pulses, pulse_data_t *fsk_pulses, unsigned fpdm)
 {
@@ -195,11 +372,39 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
         // age the pulse_data if this is a fresh buffer
         pulses->start_ago += len;
         fsk_pulses->start_ago += len;
+        s->fm_ready = 0;
     }
 
     int eop_on_spurious = 0;
+    int fsk_from        = -1; // first sample of the pending FSK block
+    // the idle and gap scans are off with the level histogram
+    int const skip_idle = pulse_detect->verbosity < LOG_NOTICE;
+    int slow_until      = 0; // process the block after a failed idle scan sample by sample
+    // the gap length at which a package ends
+    int const min_gap_len = PD_MIN_GAP_MS * samples_per_ms;
+    int const max_gap_len = PD_MAX_GAP_MS * samples_per_ms;
     // Process all new samples
     while (s->data_counter < len) {
+        // Fast path over idle noise, once the estimate settled and the high level follows the low level
+        if (skip_idle && s->ook_state == PD_OOK_STATE_IDLE && s->data_counter >= slow_until
+                && s->lead_in_counter > OOK_EST_LOW_RATIO
+                && s->ook_high_estimate == idle_high_estimate(pulse_detect, s->ook_low_estimate)) {
+            s->data_counter = pulse_detect_skip_idle(pulse_detect, envelope_data, s->data_counter, len);
+            slow_until      = s->data_counter + PD_SCAN_BLOCK;
+            if (s->data_counter >= len)
+                break;
+        }
+        // Fast path to the next rising edge or the end of package, the levels are constant during a gap
+        if (skip_idle && s->ook_state == PD_OOK_STATE_GAP && !eop_on_spurious) {
+            int const eop_len = MIN(MAX(PD_MAX_GAP_RATIO * s->max_pulse, min_gap_len), max_gap_len);
+            int const trigger = ook_trigger_level(pulse_detect, s->ook_low_estimate, s->ook_high_estimate);
+            int const end     = MIN(len, s->data_counter + MAX(eop_len - s->pulse_length, 0));
+            int const edge    = find_rising_edge(envelope_data, s->data_counter, end, trigger);
+            s->pulse_length += edge - s->data_counter;
+            s->data_counter = edge;
+            if (s->data_counter >= len)
+                break;
+        }
         // Calculate OOK detection threshold and hysteresis
         int16_t const am_n    = envelope_data[s->data_counter];
         if (pulse_detect->verbosity >= LOG_NOTICE) {
@@ -220,6 +425,8 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     // Initialize all data
                     pulse_data_clear(pulses);
                     pulse_data_clear(fsk_pulses);
+                    pulse_data_reserve(pulses, 1);
+                    pulse_data_reserve(fsk_pulses, 1);
                     pulses->sample_rate = samp_rate;
                     fsk_pulses->sample_rate = samp_rate;
                     pulses->offset = sample_offset + s->data_counter;
@@ -228,7 +435,15 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     fsk_pulses->start_ago = len - s->data_counter;
                     s->pulse_length = 0;
                     s->max_pulse = 0;
+                    s->stream_mark = s->stream_pulses;
+                    s->fsk_stream_mark = s->stream_pulses;
+                    s->pulse_level_sum = 0;
+                    s->pulse_samples = 0;
+                    s->pulse_peak = 0;
                     pulse_detect_fsk_init(&s->pulse_detect_fsk);
+                    int seed_hi, seed_lo;
+                    if (s->fsk_track_seed && fsk_track_seed(&s->fsk_track, &seed_hi, &seed_lo))
+                        pulse_detect_fsk_seed(&s->pulse_detect_fsk, seed_hi, seed_lo);
                     s->ook_state = PD_OOK_STATE_PULSE;
                 }
                 else {    // We are still idle..
@@ -268,20 +483,20 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 }
                 // Still pulse
                 else {
+                    // Level statistics of the pulse samples
+                    s->pulse_level_sum += am_n;
+                    s->pulse_samples += 1;
+                    s->pulse_peak = MAX(s->pulse_peak, am_n);
                     // Calculate OOK high level estimate
                     s->ook_high_estimate += am_n / OOK_EST_HIGH_RATIO - s->ook_high_estimate / OOK_EST_HIGH_RATIO;
                     s->ook_high_estimate = MAX(s->ook_high_estimate, pulse_detect->ook_min_high_level);
                     s->ook_high_estimate = MIN(s->ook_high_estimate, OOK_MAX_HIGH_LEVEL);
                     // Estimate pulse carrier frequency
-                    pulses->fsk_f1_est += fm_data[s->data_counter] / OOK_EST_HIGH_RATIO - pulses->fsk_f1_est / OOK_EST_HIGH_RATIO;
+                    pulses->fsk_f1_est += fm_sample(s, fm_data, s->data_counter) / OOK_EST_HIGH_RATIO - pulses->fsk_f1_est / OOK_EST_HIGH_RATIO;
                 }
                 // FSK Demodulation
-                if (pulses->num_pulses == 0) {    // Only during first pulse
-                    if (fpdm == FSK_PULSE_DETECT_OLD) {
-                        pulse_detect_fsk_classic(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    } else {
-                        pulse_detect_fsk_minmax(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    }
+                if (pulses->num_pulses == 0 && fsk_from < 0) {    // Only during first pulse
+                    fsk_from = s->data_counter;
                 }
                 break;
             case PD_OOK_STATE_GAP_START:    // Beginning of gap - it might be a spurious gap
@@ -295,6 +510,10 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 else if (s->pulse_length >= PD_MIN_PULSE_SAMPLES) {
                     s->ook_state = PD_OOK_STATE_GAP;
                     // Determine if FSK modulation is detected
+                    if (fsk_from >= 0) {
+                        pulse_detect_fsk_block(s, fm_data, fsk_from, s->data_counter, fsk_pulses, fpdm);
+                        fsk_from = -1;
+                    }
                     if (fsk_pulses->num_pulses > PD_MIN_PULSES) {
                         // Store last pulse/gap
                         if (fpdm == FSK_PULSE_DETECT_OLD)
@@ -302,8 +521,7 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                         // Store estimates
                         fsk_pulses->fsk_f1_est = s->pulse_detect_fsk.fm_f1_est;
                         fsk_pulses->fsk_f2_est = s->pulse_detect_fsk.fm_f2_est;
-                        fsk_pulses->ook_low_estimate = s->ook_low_estimate;
-                        fsk_pulses->ook_high_estimate = s->ook_high_estimate;
+                        pulse_detect_store_levels(s, fsk_pulses);
                         pulses->end_ago = len - s->data_counter;
                         fsk_pulses->end_ago = len - s->data_counter;
                         s->ook_state = PD_OOK_STATE_IDLE;    // Ensure everything is reset
@@ -321,12 +539,8 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     }
                 } // if
                 // FSK Demodulation (continue during short gap - we might return...)
-                if (pulses->num_pulses == 0) {    // Only during first pulse
-                    if (fpdm == FSK_PULSE_DETECT_OLD) {
-                        pulse_detect_fsk_classic(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    } else {
-                        pulse_detect_fsk_minmax(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    }
+                if (pulses->num_pulses == 0 && fsk_from < 0) {    // Only during first pulse
+                    fsk_from = s->data_counter;
                 }
                 break;
             case PD_OOK_STATE_GAP:
@@ -335,13 +549,13 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 if (am_n > (ook_threshold + ook_hysteresis)) {    // New pulse?
                     pulses->gap[pulses->num_pulses] = s->pulse_length;    // Store gap width
                     pulses->num_pulses += 1;    // Next pulse
+                    pulse_data_reserve(pulses, pulses->num_pulses + 1);
 
                     // EOP if too many pulses
                     if (pulses->num_pulses >= PD_MAX_PULSES) {
                         s->ook_state = PD_OOK_STATE_IDLE;
                         // Store estimates
-                        pulses->ook_low_estimate = s->ook_low_estimate;
-                        pulses->ook_high_estimate = s->ook_high_estimate;
+                        pulse_detect_store_levels(s, pulses);
                         pulses->end_ago = len - s->data_counter;
                         if (pulse_detect->verbosity >= LOG_INFO) {
                             print_att_hist("PULSE_DATA_OOK MAX_PULSES", att_hist);
@@ -362,8 +576,7 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     pulses->num_pulses += 1;    // Store last pulse
                     s->ook_state = PD_OOK_STATE_IDLE;
                     // Store estimates
-                    pulses->ook_low_estimate = s->ook_low_estimate;
-                    pulses->ook_high_estimate = s->ook_high_estimate;
+                    pulse_detect_store_levels(s, pulses);
                     pulses->end_ago = len - s->data_counter;
                     if (pulse_detect->verbosity >= LOG_INFO) {
                         print_att_hist("PULSE_DATA_OOK EOP", att_hist);
@@ -382,9 +595,41 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 fprintf(stderr, "demod_OOK(): Unknown state!!\n");
                 s->ook_state = PD_OOK_STATE_IDLE;
         } // switch
+
+        // The FSK block ends with the first pulse, on a spurious first pulse, or when streaming
+        if (fsk_from >= 0 && (s->stream_pulses
+                || (s->ook_state != PD_OOK_STATE_PULSE && s->ook_state != PD_OOK_STATE_GAP_START))) {
+            pulse_detect_fsk_block(s, fm_data, fsk_from, s->data_counter + 1, fsk_pulses, fpdm);
+            fsk_from = -1;
+        }
+
+        // Partial package for the streaming decoders, FSK is only demodulated during the first pulse
+        if (s->stream_pulses && s->ook_state != PD_OOK_STATE_IDLE) {
+            if (pulses->num_pulses >= s->stream_mark) {
+                s->stream_mark = pulses->num_pulses + s->stream_pulses;
+                pulse_detect_store_levels(s, pulses);
+                pulses->end_ago = len - s->data_counter;
+                s->data_counter += 1;
+                return PULSE_DATA_OOK_PARTIAL;
+            }
+            if (pulses->num_pulses == 0 && fsk_pulses->num_pulses >= s->fsk_stream_mark) {
+                s->fsk_stream_mark = fsk_pulses->num_pulses + s->stream_pulses;
+                fsk_pulses->fsk_f1_est = s->pulse_detect_fsk.fm_f1_est;
+                fsk_pulses->fsk_f2_est = s->pulse_detect_fsk.fm_f2_est;
+                pulse_detect_store_levels(s, fsk_pulses);
+                pulses->end_ago = len - s->data_counter;
+                fsk_pulses->end_ago = len - s->data_counter;
+                s->data_counter += 1;
+                return PULSE_DATA_FSK_PARTIAL;
+            }
+        }
         s->data_counter += 1;
     } // while
 
+    if (fsk_from >= 0) {
+        pulse_detect_fsk_block(s, fm_data, fsk_from, len, fsk_pulses, fpdm);
+    }
+
     s->data_counter = 0;
     if (pulse_detect->verbosity >= LOG_DEBUG) {
         print_att_hist("Out of data", att_hist);
@@ -31,43 +31,60 @@ void pulse_detect_fsk_init(pulse_detect_fsk_t *s)
     s->skip_samples = 40;
 }
 
-void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+void pulse_detect_fsk_seed(pulse_detect_fsk_t *s, int hi_est, int lo_est)
+{
+    s->seed_hi      = hi_est;
+    s->seed_lo      = lo_est;
+    s->var_test_max = (int16_t)hi_est;
+    s->var_test_min = (int16_t)lo_est;
+    s->skip_samples = 0;
+}
+
+/// One sample of the classic FSK detector, inlined into the block loop.
+static inline void fsk_classic_step(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
 {
     int const fm_f1_delta = abs(fm_n - s->fm_f1_est); // Get delta from F1 frequency estimate
     int const fm_f2_delta = abs(fm_n - s->fm_f2_est); // Get delta from F2 frequency estimate
     s->fsk_pulse_length += 1;
 
     switch(s->fsk_state) {
-        case PD_FSK_STATE_INIT:        // Initial frequency - High or low?
+        case PD_FSK_STATE_INIT: {      // Initial frequency - High or low?
+            int const seeded = s->seed_hi > s->seed_lo;
+            // Seeded? The initial frequency is the closer seed
+            if (seeded && s->fsk_pulse_length == 1) {
+                s->fm_f1_est = abs(fm_n - s->seed_hi) < abs(fm_n - s->seed_lo) ? s->seed_hi : s->seed_lo;
+            }
             // Initial samples?
-            if (s->fsk_pulse_length < PD_MIN_PULSE_SAMPLES) {
+            else if (!seeded && s->fsk_pulse_length < PD_MIN_PULSE_SAMPLES) {
                 s->fm_f1_est = s->fm_f1_est/2 + fm_n/2;        // Quick initial estimator
             }
-            // Above default frequency delta?
-            else if (fm_f1_delta > (FSK_DEFAULT_FM_DELTA/2)) {
+            // Above default (or half the seeded) frequency delta?
+            else if (fm_f1_delta > (seeded ? (s->seed_hi - s->seed_lo) / 2 : FSK_DEFAULT_FM_DELTA/2)) {
                 // Positive frequency delta - Initial frequency was low (gap)
                 if (fm_n > s->fm_f1_est) {
                     s->fsk_state = PD_FSK_STATE_FH;
                     s->fm_f2_est = s->fm_f1_est;    // Switch estimates
-                    s->fm_f1_est = fm_n;            // Prime F1 estimate
+                    s->fm_f1_est = seeded && s->fm_f2_est == s->seed_lo ? s->seed_hi : fm_n; // Prime F1 estimate
                     fsk_pulses->pulse[0] = 0;        // Initial frequency was a gap...
                     fsk_pulses->gap[0] = s->fsk_pulse_length;        // Store gap width
                     fsk_pulses->num_pulses += 1;
+                    pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1);
                     s->fsk_pulse_length = 0;
                 }
                 // Negative Frequency delta - Initial frequency was high (pulse)
                 else {
                     s->fsk_state = PD_FSK_STATE_FL;
-                    s->fm_f2_est = fm_n;    // Prime F2 estimate
+                    s->fm_f2_est = seeded && s->fm_f1_est == s->seed_hi ? s->seed_lo : fm_n; // Prime F2 estimate
                     fsk_pulses->pulse[0] = s->fsk_pulse_length;    // Store pulse width
                     s->fsk_pulse_length = 0;
                 }
             }
-            // Still below threshold
-            else {
+            // Still below threshold, a seed is kept
+            else if (!seeded) {
                 s->fm_f1_est += fm_n/FSK_EST_FAST - s->fm_f1_est/FSK_EST_FAST;    // Fast estimator
             }
             break;
+        }
         case PD_FSK_STATE_FH:        // Pulse high at F1 frequency
             // Closer to F2 than F1?
             if (fm_f1_delta > fm_f2_delta) {
@@ -113,6 +130,7 @@ void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t
                         // TODO: workaround, specifically for the Inkbird-ITH20R: free some of the buffer
                         pulse_data_shift(fsk_pulses);
                     }
+                    pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1);
                 }
                 // Else rewind to last pulse
                 else {
@@ -140,6 +158,21 @@ void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t
     } // switch(s->fsk_state)
 }
 
+void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+{
+    fsk_classic_step(s, fm_n, fsk_pulses);
+}
+
+void pulse_detect_fsk_classic_block(pulse_detect_fsk_t *s, int16_t const *fm_data, unsigned len, pulse_data_t *fsk_pulses)
+{
+    // work on a local copy, the pulse stores can't alias it and the estimates stay in registers
+    pulse_detect_fsk_t st = *s;
+    for (unsigned n = 0; n < len; ++n) {
+        fsk_classic_step(&st, fm_data[n], fsk_pulses);
+    }
+    *s = st;
+}
+
 void pulse_detect_fsk_wrap_up(pulse_detect_fsk_t *s, pulse_data_t *fsk_pulses)
 {
     if (fsk_pulses->num_pulses < PD_MAX_PULSES) { // Avoid overflow
@@ -152,10 +185,12 @@ void pulse_detect_fsk_wrap_up(pulse_detect_fsk_t *s, pulse_data_t *fsk_pulses)
             fsk_pulses->gap[fsk_pulses->num_pulses] = s->fsk_pulse_length; // Store last gap
         }
         fsk_pulses->num_pulses += 1;
+        pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1);
     }
 }
 
-void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+/// One sample of the min/max FSK detector, inlined into the block loop.
+static inline void fsk_minmax_step(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
 {
     int16_t mid = 0;
 
@@ -204,6 +239,7 @@ void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *
                         // TODO: workaround, specifically for the Inkbird-ITH20R: free some of the buffer
                         pulse_data_shift(fsk_pulses);
                     }
+                    pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1);
                 }
                 s->fm_f1_est += fm_n / FSK_EST_SLOW - s->fm_f1_est / FSK_EST_SLOW; // Slow estimator
                 break;
@@ -219,3 +255,18 @@ void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *
         s->skip_samples -= 1;
     }
 }
+
+void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+{
+    fsk_minmax_step(s, fm_n, fsk_pulses);
+}
+
+void pulse_detect_fsk_minmax_block(pulse_detect_fsk_t *s, int16_t const *fm_data, unsigned len, pulse_data_t *fsk_pulses)
+{
+    // work on a local copy, the pulse stores can't alias it and the trackers stay in registers
+    pulse_detect_fsk_t st = *s;
+    for (unsigned n = 0; n < len; ++n) {
+        fsk_minmax_step(&st, fm_data[n], fsk_pulses);
+    }
+    *s = st;
+}
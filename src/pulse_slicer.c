@@ -17,28 +17,243 @@
 #include "c_util.h" // for MIN()
 #include "logger.h"
 #include "decoder_util.h" // TODO: this should be refactored
+#include "decode_scratch.h"
+#include "decode_memo.h"
+#include "cpu_stats.h"
+#include "fatal.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <stdint.h>
 #include <math.h>
 #include <limits.h>
 
-static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_name)
+// Precision reciprocals of widths and widths in units of a reciprocal, rounded, Q32 integers in fixed point.
+#ifdef FIXED_POINT
+#define SLICE_RECIP(count, width) ((((slice_recip_t)(count)) << 32) / (width))
+#define SLICE_UNITS(x, f)         ((int)(((int64_t)(x) * (f) + ((int64_t)1 << 31)) >> 32))
+#define SLICE_RECIP_FLOAT(f)      ((float)(f) / 4294967296.0f)
+#else
+#define SLICE_RECIP(count, width) ((float)(count) / (width))
+#define SLICE_UNITS(x, f)         ((int)((x) * (f) + 0.5f))
+#define SLICE_RECIP_FLOAT(f)      (f)
+#endif
+
+/// Timing of a slicer in samples, decoders with equal keys slice a package to the same bits.
+typedef struct slice_key {
+    char const *demod_name;
+    int s_short;
+    int s_long;
+    int s_reset;
+    int s_gap;
+    int s_sync;
+    int s_tolerance;
+    float short_width; ///< exact width, only for slicers with precision reciprocals
+    float long_width;  ///< exact width, only for slicers with precision reciprocals
+} slice_key_t;
+
+/// Events of one slicer run, the bits are as given to the decoder.
+typedef struct slice_entry {
+    slice_key_t key;
+    int failed; ///< recording ran out of memory, always slice
+    int has_windows; ///< each recorded event is followed by its bitbuffer_windows_t
+    unsigned num_bits;
+    size_t offset; ///< start of the recorded bits in the cache data
+} slice_entry_t;
+
+static int slice_key_equal(slice_key_t const *a, slice_key_t const *b)
 {
-    // run decoder
-    int ret = 0;
-    if (device->decode_fn) {
-        ret = device->decode_fn(device, bits);
+    return a->demod_name == b->demod_name
+            && a->s_short == b->s_short
+            && a->s_long == b->s_long
+            && a->s_reset == b->s_reset
+            && a->s_gap == b->s_gap
+            && a->s_sync == b->s_sync
+            && a->s_tolerance == b->s_tolerance
+            && a->short_width == b->short_width
+            && a->long_width == b->long_width;
+}
+
+/// Rows a slicer wrote to, rows spill past num_rows up to free_row.
+static unsigned used_rows(bitbuffer_t const *bits)
+{
+    unsigned rows = bits->free_row > bits->num_rows ? bits->free_row : bits->num_rows;
+    return rows < BITBUF_ROWS ? rows : BITBUF_ROWS;
+}
+
+/// Record only the used rows, a full bitbuffer is mostly zeros.
+static void slice_entry_add(slice_cache_t *cache, slice_entry_t *entry, bitbuffer_t const *bits, bitbuffer_windows_t const *windows)
+{
+    if (entry->failed)
+        return;
+    size_t head = offsetof(bitbuffer_t, bb);
+    size_t rows = used_rows(bits) * sizeof(*bits->bb);
+    size_t len  = head + rows + (entry->has_windows ? sizeof(*windows) : 0);
+    if (cache->data_len + len > cache->data_size) {
+        size_t data_size = cache->data_size ? cache->data_size : 16 * 1024;
+        while (cache->data_len + len > data_size)
+            data_size *= 2;
+        unsigned char *data = realloc(cache->data, data_size);
+        if (!data) {
+            WARN_REALLOC("slice_entry_add()");
+            entry->failed = 1;
+            return;
+        }
+        cache->data      = data;
+        cache->data_size = data_size;
     }
+    memcpy(&cache->data[cache->data_len], bits, head);
+    memcpy(&cache->data[cache->data_len + head], bits->bb, rows);
+    if (entry->has_windows)
+        memcpy(&cache->data[cache->data_len + head + rows], windows, sizeof(*windows));
+    cache->data_len += len;
+    entry->num_bits += 1;
+}
+
+void slice_cache_clear(slice_cache_t *cache)
+{
+    free(cache->entries);
+    free(cache->data);
+    *cache = (slice_cache_t){0};
+}
+
+static int slice_sync_equal(slice_sync_t const *sync, r_device const *device, bitbuffer_t const *bits, unsigned row)
+{
+    unsigned len = bits->bits_per_row[row];
+    if (sync->preamble_bits != device->preamble_bits || sync->row_bits != len
+            || memcmp(sync->preamble, device->preamble, (device->preamble_bits + 7) / 8)
+            || memcmp(sync->row, bits->bb[row], len / 8))
+        return 0;
+    // bits past the end of the row are undefined
+    uint8_t mask = 0xff00 >> (len & 7);
+    return !(len & 7) || !((sync->row[len / 8] ^ bits->bb[row][len / 8]) & mask);
+}
+
+/// Search a row for the declared preamble of a decoder.
+///
+/// Decoders of a family often declare the same preamble, e.g. the sync word
+/// of the Fine Offset sensors, but with other timings the slice cache can't
+/// share their bits. The rows often still slice the same, the search is then
+/// done once per row for the whole family.
+static unsigned preamble_search(r_device const *device, bitbuffer_t *bits, unsigned row)
+{
+    slice_cache_t *cache = device->slice_cache;
+    // a long row, e.g. of PCM, runs on into the next rows and is not remembered
+    if (!cache || device->preamble_bits > 8 * sizeof(cache->syncs[0].preamble)
+            || bits->bits_per_row[row] > 8 * sizeof(cache->syncs[0].row))
+        return bitbuffer_search(bits, row, 0, device->preamble, device->preamble_bits);
+
+    unsigned num_syncs = MIN(cache->num_syncs, SLICE_SYNCS);
+    for (unsigned i = 0; i < num_syncs; ++i) {
+        if (slice_sync_equal(&cache->syncs[i], device, bits, row))
+            return cache->syncs[i].pos;
+    }
+
+    unsigned pos = bitbuffer_search(bits, row, 0, device->preamble, device->preamble_bits);
+    unsigned len = bits->bits_per_row[row];
+    slice_sync_t *sync = &cache->syncs[cache->num_syncs++ % SLICE_SYNCS];
+    memcpy(sync->preamble, device->preamble, (device->preamble_bits + 7) / 8);
+    sync->preamble_bits = device->preamble_bits;
+    sync->row_bits      = len;
+    sync->pos           = pos;
+    memcpy(sync->row, bits->bb[row], (len + 7) / 8);
+    return pos;
+}
+
+/// Check the declared row constraints of a decoder, returns the abort code if the decoder can't match.
+static int check_constraints(r_device const *device, bitbuffer_t *bits)
+{
+    if (device->max_rows && bits->num_rows > device->max_rows)
+        return DECODE_ABORT_EARLY;
+
+    if (device->row_bits[0]) {
+        int found = 0;
+        for (int row = 0; !found && row < bits->num_rows; ++row) {
+            for (unsigned i = 0; i < sizeof(device->row_bits) / sizeof(*device->row_bits) && device->row_bits[i]; ++i) {
+                if (bits->bits_per_row[row] == device->row_bits[i]) {
+                    found = 1;
+                    break;
+                }
+            }
+        }
+        if (!found)
+            return DECODE_ABORT_LENGTH;
+    }
+
+    if (device->preamble) {
+        // the windows of bits shared by a family of decoders rule out most preambles without a search
+        if (device->slice_windows) {
+            bitbuffer_pattern_t prep = bitbuffer_search_prepare(device->preamble, device->preamble_bits);
+            if (!bitbuffer_windows_may_match(device->slice_windows, &prep))
+                return DECODE_ABORT_EARLY;
+        }
+        int found = 0;
+        for (int row = 0; !found && row < bits->num_rows; ++row) {
+            found = preamble_search(device, bits, row) < bits->bits_per_row[row];
+        }
+        if (!found)
+            return DECODE_ABORT_EARLY;
+    }
+
+    return 0;
+}
+
+/// Output a remembered event as the decoder would.
+static void memo_output(void *ctx, data_t *data)
+{
+    decoder_output_data(ctx, data);
+}
+
+static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_name, slice_entry_t *rec)
+{
+    // record the bits before the decoder may change them
+    bitbuffer_windows_t windows;
+    if (rec && rec->has_windows) {
+        bitbuffer_windows_build(bits, &windows);
+        device->slice_windows = &windows;
+    }
+    if (rec)
+        slice_entry_add(device->slice_cache, rec, bits, &windows);
+
+    // a repeat of the bits of a recent decode gives the same events, only on the decode paths and not while the decoder logs at -vv
+    decode_memo_t *memo = device->slice_cache && device->verbose <= 1 ? device->decode_memo : NULL;
+    int has_decode = device->decode_fn || device->decode_fn2;
+    int ret;
+    if (memo && decode_memo_begin(memo, bits)) {
+        stats_add(&device->stats.memo_hits, 1);
+        ret = decode_memo_replay(memo, memo_output, device);
+    }
+    else {
+        // run decoder, unless the constraints rule it out, the decoder logs its own checks at -vv if an output takes them
+        ret = has_decode && (device->verbose <= 1 || device->log_level < LOG_INFO) ? check_constraints(device, bits) : 0;
+        if (device->decode_fn2 && !ret) {
+            // outside of the decode paths, e.g. with the analyzer, the decoder gets a scratch of its own
+            decode_scratch_t *scratch = device->scratch ? device->scratch : decode_scratch_create();
+            uint64_t start = cpu_stats_start();
+            ret = scratch ? device->decode_fn2(device, bits, scratch) : DECODE_FAIL_OTHER;
+            cpu_stats_end(&device->cpu_decode, start);
+            if (scratch != device->scratch)
+                decode_scratch_free(scratch);
+        }
+        else if (device->decode_fn && !ret) {
+            uint64_t start = cpu_stats_start();
+            ret = device->decode_fn(device, bits);
+            cpu_stats_end(&device->cpu_decode, start);
+        }
+        if (memo)
+            decode_memo_end(memo, ret);
+    }
+    device->slice_windows = NULL;
 
     // statistics accounting
-    device->decode_events += 1;
+    stats_add(&device->stats.events, 1);
     if (ret > 0) {
-        device->decode_ok += 1;
-        device->decode_messages += ret;
+        stats_add(&device->stats.ok, 1);
+        stats_add(&device->stats.messages, (uint64_t)ret);
     }
     else if (ret >= DECODE_FAIL_SANITY) {
-        device->decode_fails[-ret] += 1;
+        stats_add(&device->stats.fails[-ret], 1);
         ret = 0;
     }
     else {
@@ -46,49 +261,259 @@ static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_
         exit(1);
     }
 
-    // Find longest row
-    unsigned max_bits = 0;
-    for (int row = 0; row < bits->num_rows; ++row) {
-        if (bits->bits_per_row[row] > max_bits) {
-            max_bits = bits->bits_per_row[row];
+    // Debug printout
+    int print = !has_decode || (device->verbose && ret > 0) || (device->verbose > 2);
+    if (!print && device->verbose > 1) {
+        // Find longest row
+        unsigned max_bits = 0;
+        for (int row = 0; row < bits->num_rows; ++row) {
+            if (bits->bits_per_row[row] > max_bits) {
+                max_bits = bits->bits_per_row[row];
+            }
         }
+        print = max_bits > 16;
     }
-
-    // Debug printout
-    if (!device->decode_fn || (device->verbose && ret > 0) || (device->verbose > 1 && max_bits > 16) || (device->verbose > 2)) {
+    if (print) {
         decoder_log_bitbuffer(device, ret > 0 ? 1 : 2, demod_name, bits, device->name);
     }
 
     return ret;
 }
 
-int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
+/// Width bins within the tolerance of a nominal width.
+static uint64_t width_bins(int width, int tolerance)
+{
+    if (width <= 0)
+        return 0;
+    // the nominal widths of many decoders are rough, allow at least half a width
+    int tol = MAX(tolerance, width / 2);
+    unsigned lo = pulse_data_width_bin(MAX(width - tol, 1));
+    unsigned hi = pulse_data_width_bin(width + tol);
+    uint64_t bins = 0;
+    for (unsigned bin = lo; bin <= hi; ++bin)
+        bins |= (uint64_t)1 << bin;
+    return bins;
+}
+
+/// Number of timing hypotheses of a decoder, 1 for the fixed timing.
+static unsigned hypothesis_steps(r_device const *device)
+{
+    if (device->timing_steps < 2 || device->timing_scale_min <= 0.0f || device->timing_scale_max <= device->timing_scale_min)
+        return 1;
+    return MIN(device->timing_steps, TIMING_STEPS_MAX);
+}
+
+/// Scale of a timing hypothesis, geometric steps from the smallest to the largest scale.
+static float hypothesis_scale(r_device const *device, unsigned k, unsigned steps)
+{
+    if (steps < 2)
+        return 1.0f;
+    return device->timing_scale_min * powf(device->timing_scale_max / device->timing_scale_min, (float)k / (steps - 1));
+}
+
+/// Width bins of the short and long width of all timing hypotheses.
+static uint64_t hypothesis_bins(r_device const *device, r_device_timing_t const *t)
+{
+    unsigned steps = hypothesis_steps(device);
+    uint64_t bins  = 0;
+    for (unsigned k = 0; k < steps; ++k) {
+        float scale = steps > 1 ? hypothesis_scale(device, k, steps) : 1.0f;
+        int tolerance = (int)(t->s_tolerance * scale);
+        bins |= width_bins((int)(t->s_short * scale), tolerance) | width_bins((int)(t->s_long * scale), tolerance);
+    }
+    return bins;
+}
+
+void pulse_slicer_set_timing(r_device *device, uint32_t sample_rate)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
+    r_device_timing_t *t = &device->timing;
+    float samples_per_us = sample_rate / 1.0e6f;
+
+    t->sample_rate = sample_rate;
+    t->s_short     = device->short_width * samples_per_us;
+    t->s_long      = device->long_width * samples_per_us;
+    t->s_reset     = device->reset_limit * samples_per_us;
+    t->s_gap       = device->gap_limit * samples_per_us;
+    t->s_sync      = device->sync_width * samples_per_us;
+    t->s_tolerance = device->tolerance * samples_per_us;
+
+    // precision reciprocals
+#ifdef FIXED_POINT
+    // the widths are float, this runs once per decoder and sample rate
+    t->f_short = device->short_width > 0.0f ? (slice_recip_t)(4294967296.0 / (device->short_width * samples_per_us)) : 0;
+    t->f_long  = device->long_width > 0.0f ? (slice_recip_t)(4294967296.0 / (device->long_width * samples_per_us)) : 0;
+#else
+    t->f_short = device->short_width > 0.0f ? 1.0f / (device->short_width * samples_per_us) : 0;
+    t->f_long  = device->long_width > 0.0f ? 1.0f / (device->long_width * samples_per_us) : 0;
+#endif
 
     // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    t->valid = !((device->short_width > 0 && t->s_short <= 0)
+            || (device->long_width > 0 && t->s_long <= 0)
+            || (device->reset_limit > 0 && t->s_reset <= 0)
+            || (device->gap_limit > 0 && t->s_gap <= 0)
+            || (device->sync_width > 0 && t->s_sync <= 0)
+            || (device->tolerance > 0 && t->s_tolerance <= 0));
+
+    // the symbols a message of this modulation can't be without
+    switch (device->modulation) {
+    case OOK_PULSE_PCM:
+    case FSK_PULSE_PCM:
+        // any pulse of at least half a bit
+        t->pulse_bins = t->s_short > 0 ? ~(((uint64_t)1 << pulse_data_width_bin(MAX(t->s_short / 2, 1))) - 1) : 0;
+        t->gap_bins   = 0;
+        break;
+    case OOK_PULSE_PPM:
+        t->pulse_bins = 0;
+        t->gap_bins   = hypothesis_bins(device, t);
+        break;
+    case OOK_PULSE_PWM:
+    case FSK_PULSE_PWM:
+        t->pulse_bins = hypothesis_bins(device, t);
+        t->gap_bins   = 0;
+        break;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        // half and full bit pulses
+        t->pulse_bins = width_bins(t->s_short, t->s_tolerance) | width_bins(t->s_short * 2, t->s_tolerance);
+        t->gap_bins   = 0;
+        break;
+    default:
+        t->pulse_bins = 0;
+        t->gap_bins   = 0;
+    }
+}
+
+int pulse_slicer_prefilter(pulse_data_t const *pulses, r_device *device)
+{
+    // no fingerprint
+    if (!pulses->pulse_bins)
+        return 1;
+
+    if (device->timing.sample_rate != pulses->sample_rate)
+        pulse_slicer_set_timing(device, pulses->sample_rate);
+
+    r_device_timing_t const *t = &device->timing;
+    // the slicer reports a too low sample rate
+    if (!t->valid)
+        return 1;
+    return (!t->pulse_bins || (t->pulse_bins & pulses->pulse_bins))
+            && (!t->gap_bins || (t->gap_bins & pulses->gap_bins));
+}
+
+/// Get the timing of a decoder for the sample rate of a package, NULL if the sample rate is too low.
+static r_device_timing_t const *slicer_timing(pulse_data_t const *pulses, r_device *device, char const *demod_name)
+{
+    if (device->timing.sample_rate != pulses->sample_rate)
+        pulse_slicer_set_timing(device, pulses->sample_rate);
+    // the memo ages its decodes by the package time
+    if (device->decode_memo && pulses->sample_rate)
+        decode_memo_set_time(device->decode_memo, (double)pulses->offset / pulses->sample_rate);
+
+    if (!device->timing.valid) {
+        print_logf(LOG_WARNING, demod_name, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+        return NULL;
+    }
+    return &device->timing;
+}
+
+/// Get the scratch bits of the thread or the decoder, all zero. The slicer clears the used rows again before it returns.
+static bitbuffer_t *slicer_bits(r_device *device)
+{
+    if (device->scratch)
+        return &device->scratch->slice_bits;
+    if (!device->slice_bits) {
+        device->slice_bits = calloc(1, sizeof(*device->slice_bits));
+        if (!device->slice_bits)
+            WARN_CALLOC("slicer_bits()");
+    }
+    return device->slice_bits;
+}
+
+/// Replay the events of an earlier slicer run with the same key, otherwise start recording this run.
+///
+/// Only for slicers which clear the bits after each event, the following
+/// events then don't depend on changes the decoder made to the bits.
+/// @return 1 if the events were replayed, 0 if the slicer needs to run
+static int slice_cache_replay(r_device *device, slice_key_t const *key, int *events, slice_entry_t **rec)
+{
+    slice_cache_t *cache = device->slice_cache;
+    *rec = NULL;
+    // the slicers log more details at higher verbosity, always slice then
+    if (!cache || device->verbose > 1)
         return 0;
+
+    stats_add(&device->stats.slice_lookups, 1);
+    for (unsigned i = 0; i < cache->num_entries; ++i) {
+        slice_entry_t *entry = &cache->entries[i];
+        if (!slice_key_equal(&entry->key, key))
+            continue;
+        if (entry->failed)
+            return 0;
+        bitbuffer_t *bits = slicer_bits(device);
+        if (!bits)
+            return 0;
+        stats_add(&device->stats.slice_hits, 1);
+        size_t head = offsetof(bitbuffer_t, bb);
+        size_t pos  = entry->offset;
+        for (unsigned j = 0; j < entry->num_bits; ++j) {
+            // the decoder may change the bits, replay a copy
+            memcpy(bits, &cache->data[pos], head);
+            size_t len = used_rows(bits) * sizeof(*bits->bb);
+            memcpy(bits->bb, &cache->data[pos + head], len);
+            pos += head + len;
+            bitbuffer_windows_t windows;
+            if (entry->has_windows) {
+                memcpy(&windows, &cache->data[pos], sizeof(windows));
+                pos += sizeof(windows);
+                device->slice_windows = &windows;
+            }
+            *events += account_event(device, bits, key->demod_name, NULL);
+            bitbuffer_clear_used(bits);
+        }
+        return 1;
     }
 
+    if (cache->num_entries >= cache->max_entries) {
+        unsigned max_entries = cache->max_entries ? cache->max_entries * 2 : 8;
+        slice_entry_t *entries = realloc(cache->entries, max_entries * sizeof(*entries));
+        if (!entries) {
+            WARN_REALLOC("slice_cache_replay()");
+            return 0;
+        }
+        cache->entries     = entries;
+        cache->max_entries = max_entries;
+    }
+    *rec = &cache->entries[cache->num_entries++];
+    **rec = (slice_entry_t){.key = *key, .has_windows = device->want_windows, .offset = cache->data_len};
+    return 0;
+}
+
+int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
+{
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
+        return 0;
+
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_gap   = timing->s_gap;
+    int s_sync  = timing->s_sync;
+    int s_tolerance = timing->s_tolerance;
+
     // precision reciprocals
-    float f_short = device->short_width > 0.0f ? 1.0f / (device->short_width * samples_per_us) : 0;
-    float f_long  = device->long_width > 0.0f ? 1.0f / (device->long_width * samples_per_us) : 0;
+    slice_recip_t f_short = timing->f_short;
+    slice_recip_t f_long  = timing->f_long;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    slice_key_t const key = {__func__, s_short, s_long, s_reset, s_gap, s_sync, s_tolerance, device->short_width, device->long_width};
+    slice_entry_t *rec;
+    if (slice_cache_replay(device, &key, &events, &rec))
+        return events;
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
 
     int const gap_limit = s_gap ? s_gap : s_reset;
     int const max_zeros = gap_limit / s_long;
@@ -115,15 +540,15 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
         }
         // require at least min_count bits preamble
         if (count >= min_count) {
-            f_long  = (float)count / lwidth;
-            f_short = (float)count / swidth;
+            f_long  = SLICE_RECIP(count, lwidth);
+            f_short = SLICE_RECIP(count, swidth);
             min_count = count;
             preamble_len = count;
             if (device->verbose > 1) {
                 float to_us = 1e6f / pulses->sample_rate;
                 print_logf(LOG_INFO, __func__, "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit preamble",
-                        to_us / f_long, to_us * s_long,
-                        to_us / f_short, to_us * s_short, count);
+                        to_us / SLICE_RECIP_FLOAT(f_long), to_us * s_long,
+                        to_us / SLICE_RECIP_FLOAT(f_short), to_us * s_short, count);
             }
         }
     }
@@ -143,13 +568,13 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
     }
     // require at least 8 bits measured
     if (rz_count > 8) {
-        f_long  = (float)rz_count / rzl_width;
-        f_short = (float)rz_count / rzs_width;
+        f_long  = SLICE_RECIP(rz_count, rzl_width);
+        f_short = SLICE_RECIP(rz_count, rzs_width);
         if (device->verbose > 1) {
             float to_us = 1e6 / pulses->sample_rate;
             print_logf(LOG_INFO, __func__, "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit measured",
-                    to_us / f_long, to_us * s_long,
-                    to_us / f_short, to_us * s_short, rz_count);
+                    to_us / SLICE_RECIP_FLOAT(f_long), to_us * s_long,
+                    to_us / SLICE_RECIP_FLOAT(f_short), to_us * s_short, rz_count);
         }
     }
     // NRZ
@@ -157,21 +582,21 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
         int width = 0;
         int count = 0;
         while (n < pulses->num_pulses
-                && (int)(pulses->pulse[n] * f_short + 0.5) == 1
-                && (int)(pulses->gap[n] * f_long + 0.5) == 1) {
+                && SLICE_UNITS(pulses->pulse[n], f_short) == 1
+                && SLICE_UNITS(pulses->gap[n], f_long) == 1) {
             width += pulses->pulse[n] + pulses->gap[n];
             count += 2;
             n++;
         }
         // require at least min_count full bits preamble
         if (count >= min_count) {
-            f_short = f_long = (float)count / width;
+            f_short = f_long = SLICE_RECIP(count, width);
             min_count = count;
             preamble_len = count;
             if (device->verbose > 1) {
                 float to_us = 1e6f / pulses->sample_rate;
                 print_logf(LOG_INFO, __func__, "Exact bit width (in us) is %.2f vs %.2f, %d bit preamble",
-                        to_us / f_short, to_us * s_short, count);
+                        to_us / SLICE_RECIP_FLOAT(f_short), to_us * s_short, count);
             }
         }
     }
@@ -202,30 +627,28 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
     }
     // require at least 10 bits measured
     if (nrz_count > 20) {
-        f_short = f_long = (float)nrz_count / nrz_width;
+        f_short = f_long = SLICE_RECIP(nrz_count, nrz_width);
         if (device->verbose > 1) {
             float to_us = 1e6 / pulses->sample_rate;
             print_logf(LOG_INFO, __func__, "%s: Exact bit width (in us) is %.2f vs %.2f, %d bit measured", device->name,
-                    to_us / f_short, to_us * s_short, nrz_count);
+                    to_us / SLICE_RECIP_FLOAT(f_short), to_us * s_short, nrz_count);
         }
     }
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
         // Determine number of high bit periods for NRZ coding, where bits may not be separated
-        int highs = (pulses->pulse[n]) * f_short + 0.5f;
+        int highs = SLICE_UNITS(pulses->pulse[n], f_short);
         // Determine number of low bit periods in current gap length (rounded)
         // for RZ subtract the nominal bit-gap
-        int lows = (pulses->gap[n] + s_short - s_long) * f_long + 0.5f;
+        int lows = SLICE_UNITS(pulses->gap[n] + s_short - s_long, f_long);
 
         // Add run of ones (1 for RZ, many for NRZ)
-        for (int i = 0; i < highs; ++i) {
-            bitbuffer_add_bit(&bits, 1);
-        }
+        if (highs > 0)
+            bitbuffer_add_bits_run(bits, 1, highs);
         // Add run of zeros, handle possibly negative "lows" gracefully
         lows = MIN(lows, max_zeros); // Don't overflow at end of message
-        for (int i = 0; i < lows; ++i) {
-            bitbuffer_add_bit(&bits, 0);
-        }
+        if (lows > 0)
+            bitbuffer_add_bits_run(bits, 0, lows);
 
         // Validate data
         if ((s_short != s_long)                                       // Only for RZ coding
@@ -237,49 +660,226 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
                         n, pulses->pulse[n], pulses->gap[n],
                         pulses->pulse[n] + pulses->gap[n]);
             }
-            bitbuffer_clear(&bits);
+            bitbuffer_clear_used(bits);
         }
 
         // Check for new packet in multipacket
         else if (pulses->gap[n] > gap_limit && pulses->gap[n] <= s_reset) {
-            bitbuffer_add_row(&bits);
+            bitbuffer_add_row(bits);
         }
         // End of Message?
         if (((n == pulses->num_pulses - 1)                            // No more pulses? (FSK)
                     || (pulses->gap[n] > s_reset))      // Long silence (OOK)
-                && (bits.bits_per_row[0] > 0 || bits.num_rows > 1)) { // Only if data has been accumulated
+                && (bits->bits_per_row[0] > 0 || bits->num_rows > 1)) { // Only if data has been accumulated
 
-            events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
+            events += account_event(device, bits, __func__, rec);
+            bitbuffer_clear_used(bits);
         }
     } // for
+    bitbuffer_clear_used(bits);
     return events;
 }
 
-int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device)
+/// Bits of a slicer not yet added to the bitbuffer, flushed before any other access to the bitbuffer.
+typedef struct pending_bits {
+    uint64_t word;
+    unsigned len;
+} pending_bits_t;
+
+static inline void pending_flush(bitbuffer_t *bits, pending_bits_t *pending)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
+    if (pending->len) {
+        bitbuffer_add_bits(bits, pending->word, pending->len);
+        pending->word = 0;
+        pending->len  = 0;
+    }
+}
 
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
+static inline void pending_add(bitbuffer_t *bits, pending_bits_t *pending, int bit)
+{
+    pending->word = pending->word << 1 | (unsigned)bit;
+    if (++pending->len == 64)
+        pending_flush(bits, pending);
+}
 
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
-        return 0;
+/// Symbol classes of a pulse or gap, see slice_classify().
+enum slice_class {
+    SLICE_SKIP   = 0,  ///< no symbol
+    SLICE_SHORT  = 1,  ///< a short width
+    SLICE_LONG   = 2,  ///< a long width
+    SLICE_SYNC   = 3,  ///< a sync width
+    SLICE_BREAK  = 4,  ///< a width outside the timing, starts a new row
+    SLICE_SYMBOL = 7,  ///< mask of the symbol classes
+    SLICE_RESET  = 8,  ///< the gap is beyond the reset limit
+    SLICE_GAP    = 16, ///< the gap is beyond the gap limit
+};
+
+#define SLICE_BLOCK 256 ///< pulses classified at a time, the classes of a block are on the stack
+
+/// Bounds of the symbol classes (non inclusive), a width matching several classes gets the first.
+typedef struct slice_bounds {
+    int short_l, short_u;
+    int long_l, long_u;
+    int sync_l, sync_u;
+    int break_l, break_u;
+    int reset_l; ///< gaps above are SLICE_RESET
+    int gap_l;   ///< gaps above are SLICE_GAP
+} slice_bounds_t;
+
+/// Classify the widths of a block, without branches for the compiler to vectorize.
+static inline void slice_classify(int const *widths, int const *gaps, unsigned len, uint8_t *classes, slice_bounds_t const b)
+{
+    for (unsigned i = 0; i < len; ++i) {
+        int w = widths[i];
+        int is_short = (w > b.short_l) & (w < b.short_u);
+        int is_long  = (w > b.long_l) & (w < b.long_u);
+        int is_sync  = (w > b.sync_l) & (w < b.sync_u);
+        int is_break = (w > b.break_l) & (w < b.break_u);
+        int c = is_short ? SLICE_SHORT : is_long ? SLICE_LONG : is_sync ? SLICE_SYNC : is_break ? SLICE_BREAK : SLICE_SKIP;
+        c |= (gaps[i] > b.reset_l ? SLICE_RESET : 0) | (gaps[i] > b.gap_l ? SLICE_GAP : 0);
+        classes[i] = (uint8_t)c;
+    }
+}
+
+/** Scale the timing to the hypothesis that fits the most symbols of the package.
+
+    Each hypothesis classifies the widths (the gaps for PPM, the pulses for PWM)
+    as short, long, sync or none, with the tolerance or a quarter of the width.
+    All hypotheses are scored in one pass over the package, a block of widths at
+    a time, and only the best is sliced and decoded. A tie goes to the scale
+    closest to the nominal timing.
+
+    @return @p timing if the decoder has no hypotheses, @p scaled otherwise
+*/
+static r_device_timing_t const *slicer_hypothesis(pulse_data_t const *pulses, r_device const *device,
+        r_device_timing_t const *timing, int use_gaps, r_device_timing_t *scaled)
+{
+    unsigned steps = hypothesis_steps(device);
+    if (steps < 2)
+        return timing;
+
+    float scales[TIMING_STEPS_MAX];
+    slice_bounds_t bounds[TIMING_STEPS_MAX];
+    unsigned scores[TIMING_STEPS_MAX] = {0};
+    for (unsigned k = 0; k < steps; ++k) {
+        float scale = hypothesis_scale(device, k, steps);
+        int s_short = (int)(timing->s_short * scale + 0.5f);
+        int s_long  = (int)(timing->s_long * scale + 0.5f);
+        int s_sync  = (int)(timing->s_sync * scale + 0.5f);
+        int t_short = timing->s_tolerance > 0 ? (int)(timing->s_tolerance * scale + 0.5f) : s_short / 4;
+        int t_long  = timing->s_tolerance > 0 ? t_short : s_long / 4;
+        int t_sync  = timing->s_tolerance > 0 ? t_short : s_sync / 4;
+        scales[k] = scale;
+        // no breaks, resets or gaps, only the symbols count
+        bounds[k] = (slice_bounds_t){s_short - t_short, s_short + t_short, s_long - t_long, s_long + t_long,
+                s_sync > 0 ? s_sync - t_sync : 0, s_sync > 0 ? s_sync + t_sync : 0, INT_MAX, INT_MAX, INT_MAX, INT_MAX};
+    }
+
+    int const *widths = use_gaps ? pulses->gap : pulses->pulse;
+    uint8_t classes[SLICE_BLOCK];
+    for (unsigned base = 0; base < pulses->num_pulses; base += SLICE_BLOCK) {
+        unsigned len = MIN(pulses->num_pulses - base, SLICE_BLOCK);
+        for (unsigned k = 0; k < steps; ++k) {
+            slice_classify(&widths[base], &widths[base], len, classes, bounds[k]);
+            unsigned hits = 0;
+            for (unsigned i = 0; i < len; ++i)
+                hits += (classes[i] & SLICE_SYMBOL) != SLICE_SKIP;
+            scores[k] += hits;
+        }
     }
 
+    unsigned best = 0;
+    for (unsigned k = 1; k < steps; ++k) {
+        if (scores[k] > scores[best]
+                || (scores[k] == scores[best] && fabsf(logf(scales[k])) < fabsf(logf(scales[best]))))
+            best = k;
+    }
+    float scale = scales[best];
+    if (device->verbose > 1)
+        print_logf(LOG_DEBUG, __func__, "protocol %u \"%s\" timing scaled by %.3f, %u of %u symbols",
+                device->protocol_num, device->name, scale, scores[best], pulses->num_pulses);
+
+    *scaled = *timing;
+    scaled->s_short     = (int)(timing->s_short * scale + 0.5f);
+    scaled->s_long      = (int)(timing->s_long * scale + 0.5f);
+    scaled->s_gap       = (int)(timing->s_gap * scale + 0.5f);
+    scaled->s_sync      = (int)(timing->s_sync * scale + 0.5f);
+    scaled->s_tolerance = (int)(timing->s_tolerance * scale + 0.5f);
+    // a slower unit has longer gaps, a faster one keeps the reset limit
+    scaled->s_reset     = scale > 1.0f ? (int)(timing->s_reset * scale + 0.5f) : timing->s_reset;
+    scaled->f_short     = (slice_recip_t)(timing->f_short / scale);
+    scaled->f_long      = (slice_recip_t)(timing->f_long / scale);
+    return scaled;
+}
+
+/// The PPM slicer loop, inlined with constant bounds for the common timing shapes.
+static inline int ppm_slice(pulse_data_t const *pulses, r_device *device, bitbuffer_t *bits, slice_entry_t *rec,
+        char const *demod_name, int zero_l, int zero_u, int one_l, int one_u, int sync_l, int sync_u, int s_reset)
+{
+    // short gap=0, long gap=1, other gaps before the reset limit start a new row
+    slice_bounds_t const bounds = {zero_l, zero_u, one_l, one_u, sync_l, sync_u, INT_MIN, s_reset, s_reset - 1, INT_MAX};
     int events = 0;
-    bitbuffer_t bits = {0};
+    pending_bits_t pending = {0};
+    uint8_t classes[SLICE_BLOCK];
+    for (unsigned base = 0; base < pulses->num_pulses; base += SLICE_BLOCK) {
+        unsigned len = MIN(pulses->num_pulses - base, SLICE_BLOCK);
+        slice_classify(&pulses->gap[base], &pulses->gap[base], len, classes, bounds);
+        for (unsigned i = 0; i < len; ++i) {
+            switch (classes[i] & SLICE_SYMBOL) {
+            case SLICE_SHORT:
+                pending_add(bits, &pending, 0);
+                break;
+            case SLICE_LONG:
+                pending_add(bits, &pending, 1);
+                break;
+            case SLICE_SYNC:
+                pending_flush(bits, &pending);
+                bitbuffer_add_sync(bits);
+                break;
+            case SLICE_BREAK:
+                // Check for new packet in multipacket
+                pending_flush(bits, &pending);
+                bitbuffer_add_row(bits);
+                break;
+            }
+            // End of Message?
+            int end = (base + i == pulses->num_pulses - 1) // No more pulses? (FSK)
+                    || (classes[i] & SLICE_RESET);         // Long silence (OOK)
+            if (end)
+                pending_flush(bits, &pending);
+            if (end && (bits->bits_per_row[0] > 0 || bits->num_rows > 1)) { // Only if data has been accumulated
+
+                events += account_event(device, bits, demod_name, rec);
+                bitbuffer_clear_used(bits);
+            }
+        }
+    } // for pulses
+    return events;
+}
+
+int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device)
+{
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
+        return 0;
+    r_device_timing_t scaled;
+    timing = slicer_hypothesis(pulses, device, timing, 1, &scaled);
+
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_gap   = timing->s_gap;
+    int s_sync  = timing->s_sync;
+    int s_tolerance = timing->s_tolerance;
+
+    int events = 0;
+    slice_key_t const key = {__func__, s_short, s_long, s_reset, s_gap, s_sync, s_tolerance, 0, 0};
+    slice_entry_t *rec;
+    if (slice_cache_replay(device, &key, &events, &rec))
+        return events;
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
 
     // lower and upper bounds (non inclusive)
     int zero_l, zero_u;
@@ -305,60 +905,90 @@ int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device)
         one_u  = s_gap ? s_gap : s_reset;
     }
 
-    for (unsigned n = 0; n < pulses->num_pulses; ++n) {
-        if (pulses->gap[n] > zero_l && pulses->gap[n] < zero_u) {
-            // Short gap
-            bitbuffer_add_bit(&bits, 0);
-        }
-        else if (pulses->gap[n] > one_l && pulses->gap[n] < one_u) {
-            // Long gap
-            bitbuffer_add_bit(&bits, 1);
-        }
-        else if (pulses->gap[n] > sync_l && pulses->gap[n] < sync_u) {
-            // Sync gap
-            bitbuffer_add_sync(&bits);
-        }
+    if (sync_u == 0) {
+        // no sync, the compiler drops the sync test
+        events = ppm_slice(pulses, device, bits, rec, __func__, zero_l, zero_u, one_l, one_u, 0, 0, s_reset);
+    }
+    else {
+        events = ppm_slice(pulses, device, bits, rec, __func__, zero_l, zero_u, one_l, one_u, sync_l, sync_u, s_reset);
+    }
+    bitbuffer_clear_used(bits);
+    return events;
+}
 
-        // Check for new packet in multipacket
-        else if (pulses->gap[n] < s_reset) {
-            bitbuffer_add_row(&bits);
-        }
-        // End of Message?
-        if (((n == pulses->num_pulses - 1)                            // No more pulses? (FSK)
-                    || (pulses->gap[n] >= s_reset))     // Long silence (OOK)
-                && (bits.bits_per_row[0] > 0 || bits.num_rows > 1)) { // Only if data has been accumulated
+/// The PWM slicer loop, inlined with constant bounds for the common timing shapes.
+static inline int pwm_slice(pulse_data_t const *pulses, r_device *device, bitbuffer_t *bits, slice_entry_t *rec,
+        char const *demod_name, int one_l, int one_u, int zero_l, int zero_u, int sync_l, int sync_u, int s_reset, int s_gap)
+{
+    // short pulse=1, long pulse=0, spurious short pulses are ignored, other pulses start a new row
+    slice_bounds_t const bounds = {one_l, one_u, zero_l, zero_u, sync_l, sync_u, one_l, INT_MAX, s_reset, s_gap > 0 ? s_gap : INT_MAX};
+    int events = 0;
+    pending_bits_t pending = {0};
+    uint8_t classes[SLICE_BLOCK];
+    for (unsigned base = 0; base < pulses->num_pulses; base += SLICE_BLOCK) {
+        unsigned len = MIN(pulses->num_pulses - base, SLICE_BLOCK);
+        slice_classify(&pulses->pulse[base], &pulses->gap[base], len, classes, bounds);
+        for (unsigned i = 0; i < len; ++i) {
+            switch (classes[i] & SLICE_SYMBOL) {
+            case SLICE_SHORT:
+                pending_add(bits, &pending, 1);
+                break;
+            case SLICE_LONG:
+                pending_add(bits, &pending, 0);
+                break;
+            case SLICE_SYNC:
+                pending_flush(bits, &pending);
+                bitbuffer_add_sync(bits);
+                break;
+            case SLICE_BREAK:
+                // Pulse outside specified timing
+                pending_flush(bits, &pending);
+                bitbuffer_add_row(bits);
+                break;
+            }
 
-            events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
+            // End of Message?
+            int end = (base + i == pulses->num_pulses - 1) // No more pulses? (FSK)
+                    || (classes[i] & SLICE_RESET);         // Long silence (OOK)
+            int gap = classes[i] & SLICE_GAP;
+            if (end || gap)
+                pending_flush(bits, &pending);
+            if (end && (bits->num_rows > 0)) { // Only if data has been accumulated
+                events += account_event(device, bits, demod_name, rec);
+                bitbuffer_clear_used(bits);
+            }
+            else if (gap && bits->num_rows > 0 && bits->bits_per_row[bits->num_rows - 1] > 0) {
+                // New packet in multipacket
+                bitbuffer_add_row(bits);
+            }
         }
-    } // for pulses
+    }
     return events;
 }
 
 int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
         return 0;
-    }
+    r_device_timing_t scaled;
+    timing = slicer_hypothesis(pulses, device, timing, 0, &scaled);
+
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_gap   = timing->s_gap;
+    int s_sync  = timing->s_sync;
+    int s_tolerance = timing->s_tolerance;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    slice_key_t const key = {__func__, s_short, s_long, s_reset, s_gap, s_sync, s_tolerance, 0, 0};
+    slice_entry_t *rec;
+    if (slice_cache_replay(device, &key, &events, &rec))
+        return events;
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
 
     // lower and upper bounds (non inclusive)
     int one_l, one_u;
@@ -411,71 +1041,42 @@ int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device)
         sync_u = INT_MAX;
     }
 
-    for (unsigned n = 0; n < pulses->num_pulses; ++n) {
-        if (pulses->pulse[n] > one_l && pulses->pulse[n] < one_u) {
-            // 'Short' 1 pulse
-            bitbuffer_add_bit(&bits, 1);
-        }
-        else if (pulses->pulse[n] > zero_l && pulses->pulse[n] < zero_u) {
-            // 'Long' 0 pulse
-            bitbuffer_add_bit(&bits, 0);
-        }
-        else if (pulses->pulse[n] > sync_l && pulses->pulse[n] < sync_u) {
-            // Sync pulse
-            bitbuffer_add_sync(&bits);
-        }
-        else if (pulses->pulse[n] <= one_l) {
-            // Ignore spurious short pulses
-        }
-        else {
-            // Pulse outside specified timing
-            bitbuffer_add_row(&bits);
-        }
-
-        // End of Message?
-        if (((n == pulses->num_pulses - 1)                       // No more pulses? (FSK)
-                    || (pulses->gap[n] > s_reset)) // Long silence (OOK)
-                && (bits.num_rows > 0)) {                        // Only if data has been accumulated
-            events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
-        }
-        else if (s_gap > 0 && pulses->gap[n] > s_gap
-                && bits.num_rows > 0 && bits.bits_per_row[bits.num_rows - 1] > 0) {
-            // New packet in multipacket
-            bitbuffer_add_row(&bits);
-        }
+    if (s_tolerance <= 0 && s_sync <= 0) {
+        // no sync, short=1, long=0: a single threshold, the compiler drops the other tests
+        events = pwm_slice(pulses, device, bits, rec, __func__, 0, one_u, one_u - 1, INT_MAX, 0, 0, s_reset, s_gap);
     }
+    else {
+        events = pwm_slice(pulses, device, bits, rec, __func__, one_l, one_u, zero_l, zero_u, sync_l, sync_u, s_reset, s_gap);
+    }
+    bitbuffer_clear_used(bits);
     return events;
 }
 
 int pulse_slicer_manchester_zerobit(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
         return 0;
-    }
+
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_gap   = timing->s_gap;
+    int s_sync  = timing->s_sync;
+    int s_tolerance = timing->s_tolerance;
 
     int events = 0;
+    slice_key_t const key = {__func__, s_short, s_long, s_reset, s_gap, s_sync, s_tolerance, 0, 0};
+    slice_entry_t *rec;
+    if (slice_cache_replay(device, &key, &events, &rec))
+        return events;
     int time_since_last = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
 
     // First rising edge is always counted as a zero (Seems to be hardcoded policy for the Oregon Scientific sensors...)
-    bitbuffer_add_bit(&bits, 0);
+    bitbuffer_add_bit(bits, 0);
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
         // The pulse or gap is too long or too short, thus invalid
@@ -487,17 +1088,17 @@ int pulse_slicer_manchester_zerobit(pulse_data_t const *pulses, r_device *device
             if (pulses->pulse[n] > s_short * 1.5
                     && pulses->pulse[n] <= s_short * 2 + s_tolerance) {
                 // Long last pulse means with the gap this is a [1]10 transition, add a one
-                bitbuffer_add_bit(&bits, 1);
+                bitbuffer_add_bit(bits, 1);
             }
-            bitbuffer_add_row(&bits);
-            bitbuffer_add_bit(&bits, 0); // Prepare for new message with hardcoded 0
+            bitbuffer_add_row(bits);
+            bitbuffer_add_bit(bits, 0); // Prepare for new message with hardcoded 0
             time_since_last = 0;
         }
         // Falling edge is on end of pulse
         else if (pulses->pulse[n] + time_since_last > (s_short * 1.5)) {
             // Last bit was recorded more than short_width*1.5 samples ago
             // so this pulse start must be a data edge (falling data edge means bit = 1)
-            bitbuffer_add_bit(&bits, 1);
+            bitbuffer_add_bit(bits, 1);
             time_since_last = 0;
         }
         else {
@@ -507,23 +1108,24 @@ int pulse_slicer_manchester_zerobit(pulse_data_t const *pulses, r_device *device
         // End of Message?
         if (((n == pulses->num_pulses - 1)                       // No more pulses? (FSK)
                     || (pulses->gap[n] > s_reset)) // Long silence (OOK)
-                && (bits.num_rows > 0)) {                        // Only if data has been accumulated
-            events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
-            bitbuffer_add_bit(&bits, 0); // Prepare for new message with hardcoded 0
+                && (bits->num_rows > 0)) {                        // Only if data has been accumulated
+            events += account_event(device, bits, __func__, rec);
+            bitbuffer_clear_used(bits);
+            bitbuffer_add_bit(bits, 0); // Prepare for new message with hardcoded 0
             time_since_last = 0;
         }
         // Rising edge is on end of gap
         else if (pulses->gap[n] + time_since_last > (s_short * 1.5)) {
             // Last bit was recorded more than short_width*1.5 samples ago
             // so this pulse end is a data edge (rising data edge means bit = 0)
-            bitbuffer_add_bit(&bits, 0);
+            bitbuffer_add_bit(bits, 0);
             time_since_last = 0;
         }
         else {
             time_since_last += pulses->gap[n];
         }
     }
+    bitbuffer_clear_used(bits);
     return events;
 }
 
@@ -537,43 +1139,36 @@ static inline int pulse_slicer_get_symbol(pulse_data_t const *pulses, unsigned i
 
 int pulse_slicer_dmc(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
+        return 0;
 
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_tolerance = timing->s_tolerance;
 
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
         return 0;
-    }
-
-    bitbuffer_t bits = {0};
     int events = 0;
+    pending_bits_t pending = {0};
 
     for (unsigned int n = 0; n < pulses->num_pulses * 2; ++n) {
         int symbol = pulse_slicer_get_symbol(pulses, n);
 
         if (abs(symbol - s_short) < s_tolerance) {
             // Short - 1
-            bitbuffer_add_bit(&bits, 1);
+            pending_add(bits, &pending, 1);
             symbol = n + 1 < pulses->num_pulses * 2 ? pulse_slicer_get_symbol(pulses, ++n) : 0;
             if (abs(symbol - s_short) > s_tolerance) {
+                pending_flush(bits, &pending);
                 if (symbol >= s_reset - s_tolerance) {
                     // Don't expect another short gap at end of message
                     n--;
                 }
-                else if (bits.num_rows > 0 && bits.bits_per_row[bits.num_rows - 1] > 0) {
-                    bitbuffer_add_row(&bits);
+                else if (bits->num_rows > 0 && bits->bits_per_row[bits->num_rows - 1] > 0) {
+                    bitbuffer_add_row(bits);
 /*
                     print_logf(LOG_WARNING, __func__, "Detected error during pulse_slicer_dmc(): %s",
                             device->name);
@@ -583,63 +1178,57 @@ int pulse_slicer_dmc(pulse_data_t const *pulses, r_device *device)
         }
         else if (abs(symbol - s_long) < s_tolerance) {
             // Long - 0
-            bitbuffer_add_bit(&bits, 0);
+            pending_add(bits, &pending, 0);
         }
-        else if (symbol >= s_reset - s_tolerance
-                && bits.num_rows > 0) { // Only if data has been accumulated
-            //END message ?
-            events += account_event(device, &bits, __func__);
+        else if (symbol >= s_reset - s_tolerance) {
+            pending_flush(bits, &pending);
+            if (bits->num_rows > 0) { // Only if data has been accumulated
+                //END message ?
+                events += account_event(device, bits, __func__, NULL);
+            }
         }
     }
 
+    bitbuffer_clear_used(bits);
     return events;
 }
 
 int pulse_slicer_piwm_raw(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
         return 0;
-    }
+
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_tolerance = timing->s_tolerance;
 
     // precision reciprocal
-    float f_short = device->short_width > 0.0f ? 1.0f / (device->short_width * samples_per_us) : 0;
+    slice_recip_t f_short = timing->f_short;
 
     int w;
 
-    bitbuffer_t bits = {0};
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
     int events = 0;
 
     for (unsigned int n = 0; n < pulses->num_pulses * 2; ++n) {
         int symbol = pulse_slicer_get_symbol(pulses, n);
-        w = symbol * f_short + 0.5;
+        w = SLICE_UNITS(symbol, f_short);
         if (symbol > s_long) {
-            bitbuffer_add_row(&bits);
+            bitbuffer_add_row(bits);
         }
         else if (abs(symbol - w * s_short) < s_tolerance) {
             // Add w symbols
-            for (; w > 0; --w)
-                bitbuffer_add_bit(&bits, 1 - n % 2);
+            if (w > 0)
+                bitbuffer_add_bits_run(bits, 1 - n % 2, w);
         }
         else if (symbol < s_reset
-                && bits.num_rows > 0
-                && bits.bits_per_row[bits.num_rows - 1] > 0) {
-            bitbuffer_add_row(&bits);
+                && bits->num_rows > 0
+                && bits->bits_per_row[bits->num_rows - 1] > 0) {
+            bitbuffer_add_row(bits);
 /*
             print_logf(LOG_WARNING, __func__, "Detected error during pulse_slicer_piwm_raw(): %s",
                     device->name);
@@ -648,114 +1237,109 @@ int pulse_slicer_piwm_raw(pulse_data_t const *pulses, r_device *device)
 
         if (((n == pulses->num_pulses * 2 - 1)              // No more pulses? (FSK)
                     || (symbol > s_reset)) // Long silence (OOK)
-                && (bits.num_rows > 0)) {                   // Only if data has been accumulated
+                && (bits->num_rows > 0)) {                   // Only if data has been accumulated
             //END message ?
-            events += account_event(device, &bits, __func__);
+            events += account_event(device, bits, __func__, NULL);
         }
     }
 
+    bitbuffer_clear_used(bits);
     return events;
 }
 
 int pulse_slicer_piwm_dc(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
+        return 0;
 
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
+    int s_short = timing->s_short;
+    int s_long  = timing->s_long;
+    int s_reset = timing->s_reset;
+    int s_tolerance = timing->s_tolerance;
 
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
         return 0;
-    }
-
-    bitbuffer_t bits = {0};
     int events = 0;
 
-    for (unsigned int n = 0; n < pulses->num_pulses * 2; ++n) {
-        int symbol = pulse_slicer_get_symbol(pulses, n);
-        if (abs(symbol - s_short) < s_tolerance) {
-            // Short - 1
-            bitbuffer_add_bit(&bits, 1);
-        }
-        else if (abs(symbol - s_long) < s_tolerance) {
-            // Long - 0
-            bitbuffer_add_bit(&bits, 0);
-        }
-        else if (symbol < s_reset
-                && bits.num_rows > 0
-                && bits.bits_per_row[bits.num_rows - 1] > 0) {
-            bitbuffer_add_row(&bits);
+    // short=1, long=0, other pulses and gaps before the reset limit start a new row
+    slice_bounds_t const bounds = {
+            s_short - s_tolerance, s_short + s_tolerance,
+            s_long - s_tolerance, s_long + s_tolerance,
+            0, 0,
+            INT_MIN, s_reset,
+            s_reset, INT_MAX,
+    };
+    uint8_t classes[2][SLICE_BLOCK]; // of the pulses and the gaps
+    for (unsigned base = 0; base < pulses->num_pulses; base += SLICE_BLOCK) {
+        unsigned len = MIN(pulses->num_pulses - base, SLICE_BLOCK);
+        slice_classify(&pulses->pulse[base], &pulses->pulse[base], len, classes[0], bounds);
+        slice_classify(&pulses->gap[base], &pulses->gap[base], len, classes[1], bounds);
+        for (unsigned int n = base * 2; n < (base + len) * 2; ++n) {
+            int c = classes[n % 2][n / 2 - base];
+            if ((c & SLICE_SYMBOL) == SLICE_SHORT) {
+                // Short - 1
+                bitbuffer_add_bit(bits, 1);
+            }
+            else if ((c & SLICE_SYMBOL) == SLICE_LONG) {
+                // Long - 0
+                bitbuffer_add_bit(bits, 0);
+            }
+            else if ((c & SLICE_SYMBOL) == SLICE_BREAK
+                    && bits->num_rows > 0
+                    && bits->bits_per_row[bits->num_rows - 1] > 0) {
+                bitbuffer_add_row(bits);
 /*
-            print_logf(LOG_WARNING, __func__, "Detected error during pulse_slicer_piwm_dc(): %s",
-                    device->name);
+                print_logf(LOG_WARNING, __func__, "Detected error during pulse_slicer_piwm_dc(): %s",
+                        device->name);
 */
-        }
+            }
 
-        if (((n == pulses->num_pulses * 2 - 1)              // No more pulses? (FSK)
-                    || (symbol > s_reset)) // Long silence (OOK)
-                && (bits.num_rows > 0)) {                   // Only if data has been accumulated
-            //END message ?
-            events += account_event(device, &bits, __func__);
+            if (((n == pulses->num_pulses * 2 - 1) // No more pulses? (FSK)
+                        || (c & SLICE_RESET))      // Long silence (OOK)
+                    && (bits->num_rows > 0)) {     // Only if data has been accumulated
+                //END message ?
+                events += account_event(device, bits, __func__, NULL);
+            }
         }
     }
 
+    bitbuffer_clear_used(bits);
     return events;
 }
 
 int pulse_slicer_nrzs(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
         return 0;
-    }
+
+    int s_short = timing->s_short;
+    int s_reset = timing->s_reset;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
     int limit = s_short;
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
         if (pulses->pulse[n] > limit) {
-            for (int i = 0 ; i < (pulses->pulse[n]/limit) ; i++) {
-                bitbuffer_add_bit(&bits, 1);
-            }
-            bitbuffer_add_bit(&bits, 0);
+            bitbuffer_add_bits_run(bits, 1, pulses->pulse[n] / limit);
+            bitbuffer_add_bit(bits, 0);
         } else if (pulses->pulse[n] < limit) {
-            bitbuffer_add_bit(&bits, 0);
+            bitbuffer_add_bit(bits, 0);
         }
 
         if (n == pulses->num_pulses - 1
                     || pulses->gap[n] >= s_reset) {
 
-            events += account_event(device, &bits, __func__);
+            events += account_event(device, bits, __func__, NULL);
         }
     }
 
+    bitbuffer_clear_used(bits);
     return events;
 }
 
@@ -775,31 +1359,20 @@ int pulse_slicer_nrzs(pulse_data_t const *pulses, r_device *device)
 
 int pulse_slicer_osv1(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6f;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *timing = slicer_timing(pulses, device, __func__);
+    if (!timing)
         return 0;
-    }
+
+    int s_short = timing->s_short;
+    int s_reset = timing->s_reset;
 
     unsigned int n;
     int preamble = 0;
     int events = 0;
     int manbit = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
     int halfbit_min = s_short / 2;
     int halfbit_max = s_short * 3 / 2;
     int sync_min = 2 * halfbit_max;
@@ -832,46 +1405,100 @@ int pulse_slicer_osv1(pulse_data_t const *pulses, r_device *device)
     if (pulses->gap[n] > pulses->pulse[n]) {
         manbit ^= 1;
         if (manbit)
-            bitbuffer_add_bit(&bits, 0);
+            bitbuffer_add_bit(bits, 0);
     }
 
     /* remaining data bits */
     for (n++; n < pulses->num_pulses; ++n) {
         manbit ^= 1;
         if (manbit)
-            bitbuffer_add_bit(&bits, 1);
+            bitbuffer_add_bit(bits, 1);
         if (pulses->pulse[n] > halfbit_max) {
             manbit ^= 1;
             if (manbit)
-                bitbuffer_add_bit(&bits, 1);
+                bitbuffer_add_bit(bits, 1);
         }
         if ((n == pulses->num_pulses - 1
                     || pulses->gap[n] > s_reset)
-                && (bits.num_rows > 0)) { // Only if data has been accumulated
+                && (bits->num_rows > 0)) { // Only if data has been accumulated
             //END message ?
-            events += account_event(device, &bits, __func__);
+            events += account_event(device, bits, __func__, NULL);
+            bitbuffer_clear_used(bits);
             return events;
         }
         manbit ^= 1;
         if (manbit)
-            bitbuffer_add_bit(&bits, 0);
+            bitbuffer_add_bit(bits, 0);
         if (pulses->gap[n] > halfbit_max) {
             manbit ^= 1;
             if (manbit)
-                bitbuffer_add_bit(&bits, 0);
+                bitbuffer_add_bit(bits, 0);
         }
     }
+    bitbuffer_clear_used(bits);
     return events;
 }
 
 int pulse_slicer_string(const char *code, r_device *device)
 {
     int events = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t *bits = slicer_bits(device);
+    if (!bits)
+        return 0;
 
-    bitbuffer_parse(&bits, code);
+    bitbuffer_parse(bits, code);
 
-    events += account_event(device, &bits, __func__);
+    events += account_event(device, bits, __func__, NULL);
 
+    bitbuffer_clear_used(bits);
     return events;
 }
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    static bitbuffer_t bits;
+    slice_cache_t cache = {0};
+    uint8_t const preamble[] = {0x2d, 0xd4};
+    r_device device = {.preamble = preamble, .preamble_bits = 16, .slice_cache = &cache};
+
+    fprintf(stderr, "pulse_slicer:: a short row is searched once\n");
+    bitbuffer_add_bits_run(&bits, 0, 40);
+    bitbuffer_add_bits(&bits, 0x2dd4, 16);
+    bitbuffer_add_bits_run(&bits, 1, 44);
+    ASSERT_EQUALS(preamble_search(&device, &bits, 0), 40);
+    ASSERT_EQUALS(cache.num_syncs, 1);
+    ASSERT_EQUALS(preamble_search(&device, &bits, 0), 40);
+    ASSERT_EQUALS(cache.num_syncs, 1);
+
+    fprintf(stderr, "pulse_slicer:: a row longer than BITBUF_COLS bytes is not remembered\n");
+    bitbuffer_clear(&bits);
+    slice_cache_clear(&cache);
+    unsigned long_bits = BITBUF_COLS * 8 * 3 + 100;
+    bitbuffer_add_bits_run(&bits, 0, long_bits - 116);
+    bitbuffer_add_bits(&bits, 0x2dd4, 16);
+    bitbuffer_add_bits_run(&bits, 1, 100);
+    ASSERT_EQUALS(bits.bits_per_row[0], long_bits);
+    ASSERT_EQUALS(preamble_search(&device, &bits, 0), long_bits - 116);
+    ASSERT_EQUALS(cache.num_syncs, 0);
+    ASSERT_EQUALS(preamble_search(&device, &bits, 0), long_bits - 116);
+    ASSERT_EQUALS(cache.num_syncs, 0);
+
+    slice_cache_clear(&cache);
+    fprintf(stderr, "pulse_slicer:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,457 @@
+/** @file
+    Text packages from external receivers, read line by line from stdin, a serial device, or TCP.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_text.h"
+#include "rfraw.h"
+
+#include "logger.h"
+#include "fatal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <io.h>
+    #define read(fd, buf, len) _read(fd, buf, (unsigned)(len))
+    #define close(fd)          _close(fd)
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+
+    #define SOCKET          int
+    #define INVALID_SOCKET  (-1)
+    #define closesocket(x)  close(x)
+#endif
+
+#define PULSE_TEXT_LINE_MAX 4096  ///< longer lines are dropped, an RfRaw code of 1000 pulses fits
+#define PULSE_TEXT_BUF_SIZE 65536 ///< bytes read at once
+
+struct pulse_text {
+    int fd;           ///< file or serial device, -1 for a socket
+    SOCKET sock;      ///< TCP connection, INVALID_SOCKET for a file
+    uint32_t sample_rate;
+    int eof;
+
+    // the package being parsed
+    int open;         ///< pulse lines were read for the package
+    int fsk;          ///< the next package is FSK, from a ";fsk" header
+    float freq1_hz;   ///< from a ";freq1" header
+    float freq2_hz;   ///< from a ";freq2" header
+    char *held;       ///< a line to parse after the pending package, NULL if none
+    char *bits;       ///< the last bit row code
+    unsigned invalid;
+
+    size_t len;       ///< bytes in buf
+    size_t pos;       ///< the start of the next line in buf
+    char *buf;
+};
+
+/// Connect to a gateway at @p host and @p port.
+static SOCKET pulse_text_connect(char const *host, char const *port)
+{
+    struct addrinfo hints, *res, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_ADDRCONFIG;
+    int error = getaddrinfo(host, port, &hints, &res0);
+    if (error) {
+        print_log(LOG_ERROR, __func__, gai_strerror(error));
+        return INVALID_SOCKET;
+    }
+    SOCKET sock = INVALID_SOCKET;
+    for (res = res0; res; res = res->ai_next) {
+        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        if (connect(sock, res->ai_addr, (int)res->ai_addrlen) < 0) {
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+            continue;
+        }
+        break; // success
+    }
+    freeaddrinfo(res0);
+    if (sock == INVALID_SOCKET)
+        print_logf(LOG_ERROR, __func__, "Can't connect to %s port %s", host, port);
+    return sock;
+}
+
+pulse_text_t *pulse_text_open(char const *spec, uint32_t sample_rate)
+{
+    pulse_text_t *text = calloc(1, sizeof(*text));
+    if (!text) {
+        WARN_CALLOC("pulse_text_open()");
+        return NULL;
+    }
+    text->fd          = -1;
+    text->sock        = INVALID_SOCKET;
+    text->sample_rate = sample_rate ? sample_rate : 1000000;
+    text->buf         = malloc(PULSE_TEXT_BUF_SIZE);
+    if (!text->buf) {
+        WARN_MALLOC("pulse_text_open()");
+        pulse_text_free(text);
+        return NULL;
+    }
+    if (!*spec)
+        return text; // a parser only
+
+    if (!strncmp(spec, "tcp://", 6)) {
+        char host[256];
+        char const *port = strrchr(spec + 6, ':');
+        size_t host_len  = port ? (size_t)(port - (spec + 6)) : 0;
+        if (!port || !port[1] || host_len >= sizeof(host)) {
+            print_logf(LOG_ERROR, __func__, "Expected tcp://<host>:<port>, got \"%s\"", spec);
+            pulse_text_free(text);
+            return NULL;
+        }
+        memcpy(host, spec + 6, host_len);
+        host[host_len] = '\0';
+        // an IPv6 address is in brackets
+        char *h = host;
+        if (*h == '[' && host_len > 1 && h[host_len - 1] == ']') {
+            h[host_len - 1] = '\0';
+            h++;
+        }
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+            print_log(LOG_ERROR, __func__, "WSAStartup failed");
+            pulse_text_free(text);
+            return NULL;
+        }
+#endif
+        text->sock = pulse_text_connect(h, port + 1);
+        if (text->sock == INVALID_SOCKET) {
+            pulse_text_free(text);
+            return NULL;
+        }
+    }
+    else if (!strcmp(spec, "-")) {
+        text->fd = 0; // stdin
+    }
+    else {
+        text->fd = open(spec, O_RDONLY);
+        if (text->fd < 0) {
+            print_logf(LOG_ERROR, __func__, "Can't open \"%s\": %s", spec, strerror(errno));
+            pulse_text_free(text);
+            return NULL;
+        }
+    }
+    return text;
+}
+
+void pulse_text_free(pulse_text_t *text)
+{
+    if (!text)
+        return;
+    if (text->sock != INVALID_SOCKET) {
+        closesocket(text->sock);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+    if (text->fd > 0)
+        close(text->fd);
+    free(text->held);
+    free(text->bits);
+    free(text->buf);
+    free(text);
+}
+
+char const *pulse_text_bits(pulse_text_t const *text)
+{
+    return text->bits;
+}
+
+unsigned pulse_text_invalid(pulse_text_t const *text)
+{
+    return text->invalid;
+}
+
+/// Start a package with the header values read for it.
+static void start_package(pulse_text_t *text, pulse_data_t *pulses)
+{
+    pulse_data_clear(pulses);
+    pulses->sample_rate = text->sample_rate;
+    pulses->freq1_hz    = text->freq1_hz;
+    pulses->freq2_hz    = text->freq2_hz;
+    pulses->fsk_f2_est  = text->fsk; // keep the package FSK
+}
+
+/// Finish the package, the header values were for it.
+static int end_package(pulse_text_t *text, pulse_data_t *pulses)
+{
+    (void)pulses;
+    text->open     = 0;
+    text->fsk      = 0;
+    text->freq1_hz = 0;
+    text->freq2_hz = 0;
+    return PULSE_TEXT_PULSES;
+}
+
+/// Hold a line back for the next call.
+static void hold_line(pulse_text_t *text, char const *line)
+{
+    free(text->held);
+    text->held = strdup(line);
+    if (!text->held)
+        WARN_STRDUP("pulse_text_parse()");
+}
+
+int pulse_text_parse(pulse_text_t *text, char const *line, pulse_data_t *pulses)
+{
+    while (isspace((unsigned char)*line))
+        line++;
+
+    // a header, a comment, or a blank line ends a pulse list
+    if (!*line || *line == ';') {
+        if (text->open) {
+            if (*line)
+                hold_line(text, line);
+            return end_package(text, pulses);
+        }
+        if (!strncmp(line, ";fsk", 4))
+            text->fsk = 1;
+        else if (!strncmp(line, ";ook", 4))
+            text->fsk = 0;
+        else if (!strncmp(line, ";freq1", 6))
+            text->freq1_hz = (float)strtol(line + 6, NULL, 10);
+        else if (!strncmp(line, ";freq2", 6))
+            text->freq2_hz = (float)strtol(line + 6, NULL, 10);
+        return PULSE_TEXT_NONE;
+    }
+
+    // a code is a package of its own
+    int is_rfraw = rfraw_check(line);
+    if (is_rfraw || *line == '{') {
+        if (text->open) {
+            hold_line(text, line);
+            return end_package(text, pulses);
+        }
+        if (*line == '{') {
+            free(text->bits);
+            text->bits = strdup(line);
+            if (!text->bits) {
+                WARN_STRDUP("pulse_text_parse()");
+                return PULSE_TEXT_NONE;
+            }
+            return PULSE_TEXT_BITS;
+        }
+        start_package(text, pulses);
+        if (!rfraw_parse(pulses, line) || !pulses->num_pulses) {
+            text->invalid++;
+            return PULSE_TEXT_NONE;
+        }
+        return end_package(text, pulses);
+    }
+
+    // a pulse and a gap in us
+    char *end;
+    long mark = strtol(line, &end, 10);
+    if (end == line || mark < 0) {
+        text->invalid++;
+        return PULSE_TEXT_NONE;
+    }
+    char const *p = end;
+    long space    = strtol(p, &end, 10);
+    if (end == p || space < 0) {
+        text->invalid++;
+        return PULSE_TEXT_NONE;
+    }
+    if (!text->open) {
+        start_package(text, pulses);
+        text->open = 1;
+    }
+    unsigned i = pulses->num_pulses;
+    if (pulse_data_reserve(pulses, i + 1)) {
+        // too long, decode what there is and start over with this pulse
+        hold_line(text, line);
+        return end_package(text, pulses);
+    }
+    double to_sample   = text->sample_rate / 1e6;
+    pulses->pulse[i]   = (int)(to_sample * mark);
+    pulses->gap[i]     = (int)(to_sample * space);
+    pulses->num_pulses = i + 1;
+    return PULSE_TEXT_NONE;
+}
+
+/// Wait for input and read what is available, returns the bytes read, 0 on a timeout, -1 on the end or an error.
+static int read_input(pulse_text_t *text, int timeout_ms)
+{
+    if (text->eof)
+        return -1;
+    // keep the partial line at the start of the buffer
+    if (text->pos) {
+        memmove(text->buf, text->buf + text->pos, text->len - text->pos);
+        text->len -= text->pos;
+        text->pos = 0;
+    }
+    if (text->len >= PULSE_TEXT_BUF_SIZE - 1) {
+        text->len = 0; // an overlong line, drop it
+        text->invalid++;
+    }
+
+#ifdef _WIN32
+    int can_wait = text->sock != INVALID_SOCKET; // select() takes sockets only
+#else
+    int can_wait = 1;
+#endif
+    if (can_wait) {
+        int nfd = text->sock != INVALID_SOCKET ? (int)text->sock : text->fd;
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(nfd, &fds);
+        struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        int r = select(nfd + 1, &fds, NULL, NULL, &tv);
+#ifndef _WIN32
+        if (r < 0 && errno == EINTR)
+            return 0; // a signal, the caller checks if it should stop
+#endif
+        if (r < 0) {
+            print_logf(LOG_ERROR, __func__, "select: %s", strerror(errno));
+            return -1;
+        }
+        if (r == 0)
+            return 0;
+    }
+
+    size_t room = PULSE_TEXT_BUF_SIZE - 1 - text->len;
+    int n;
+    if (text->sock != INVALID_SOCKET)
+        n = (int)recv(text->sock, text->buf + text->len, (int)room, 0);
+    else
+        n = (int)read(text->fd, text->buf + text->len, room);
+#ifndef _WIN32
+    if (n < 0 && errno == EINTR)
+        return 0;
+#endif
+    if (n <= 0) {
+        text->eof = 1;
+        return -1;
+    }
+    text->len += (size_t)n;
+    return n;
+}
+
+int pulse_text_next(pulse_text_t *text, pulse_data_t *pulses, int timeout_ms)
+{
+    for (;;) {
+        // the line held back by the last package
+        if (text->held) {
+            char *held = text->held;
+            text->held = NULL;
+            int r      = pulse_text_parse(text, held, pulses);
+            free(held);
+            if (r)
+                return r;
+        }
+        // the complete lines in the buffer
+        while (text->pos < text->len) {
+            char *line = text->buf + text->pos;
+            char *eol  = memchr(line, '\n', text->len - text->pos);
+            if (!eol)
+                break;
+            text->pos = (size_t)(eol - text->buf) + 1;
+            if (eol > line && eol[-1] == '\r')
+                eol--;
+            *eol = '\0';
+            if (eol - line >= PULSE_TEXT_LINE_MAX) {
+                text->invalid++;
+                continue;
+            }
+            int r = pulse_text_parse(text, line, pulses);
+            if (r)
+                return r;
+        }
+        // a pulse list without an end line ends when the gateway is idle
+        int r = read_input(text, text->open && timeout_ms > PULSE_TEXT_IDLE_MS ? PULSE_TEXT_IDLE_MS : timeout_ms);
+        if (r == 0 && text->open)
+            return end_package(text, pulses);
+        if (r < 0 && text->open)
+            return end_package(text, pulses); // the last package, the next call ends
+        if (r <= 0)
+            return r;
+    }
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (int)(a), (int)(b), __LINE__); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    pulse_text_t *text = pulse_text_open("", 250000);
+    if (!text)
+        return 1;
+    pulse_data_t pulses = {0};
+
+    // a pulse list with a header, ended by a blank line
+    ASSERT_EQUALS(pulse_text_parse(text, ";fsk 2 pulses", &pulses), PULSE_TEXT_NONE);
+    ASSERT_EQUALS(pulse_text_parse(text, ";freq1 -5000", &pulses), PULSE_TEXT_NONE);
+    ASSERT_EQUALS(pulse_text_parse(text, "400 800", &pulses), PULSE_TEXT_NONE);
+    ASSERT_EQUALS(pulse_text_parse(text, "800 400\r", &pulses), PULSE_TEXT_NONE);
+    ASSERT_EQUALS(pulse_text_parse(text, "", &pulses), PULSE_TEXT_PULSES);
+    ASSERT_EQUALS(pulses.num_pulses, 2);
+    ASSERT_EQUALS(pulses.pulse[0], 100); // 400 us at 250 kHz
+    ASSERT_EQUALS(pulses.gap[1], 100);
+    ASSERT_EQUALS(pulses.freq1_hz, -5000);
+    ASSERT_EQUALS(pulses.fsk_f2_est != 0, 1);
+
+    // the header of the next package ends a pulse list, and applies to the next one
+    ASSERT_EQUALS(pulse_text_parse(text, "500 500", &pulses), PULSE_TEXT_NONE);
+    ASSERT_EQUALS(pulse_text_parse(text, ";fsk", &pulses), PULSE_TEXT_PULSES);
+    ASSERT_EQUALS(pulses.num_pulses, 1);
+    ASSERT_EQUALS(pulses.fsk_f2_est, 0);
+
+    // a bit row is passed as is
+    ASSERT_EQUALS(pulse_text_parse(text, "{25}fb2dd58", &pulses), PULSE_TEXT_BITS);
+    ASSERT_EQUALS(strcmp(pulse_text_bits(text), "{25}fb2dd58"), 0);
+
+    // an RfRaw code is a package
+    ASSERT_EQUALS(pulse_text_parse(text, "AAB1 03 0200 0500 1F40 8191819082 55", &pulses), PULSE_TEXT_PULSES);
+    ASSERT_EQUALS(pulses.num_pulses > 0, 1);
+
+    // garbage is counted
+    ASSERT_EQUALS(pulse_text_parse(text, "OK", &pulses), PULSE_TEXT_NONE);
+    ASSERT_EQUALS(pulse_text_invalid(text), 1);
+
+    pulse_data_free(&pulses);
+    pulse_text_free(text);
+
+    fprintf(stderr, "pulse_text test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+#endif /* _TEST */
@@ -0,0 +1,268 @@
+/** @file
+    Pulse packages over UDP, to decode the packages of remote receivers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_udp.h"
+
+#include "logger.h"
+#include "fatal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+    #if !defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600)
+    #undef _WIN32_WINNT
+    #define _WIN32_WINNT 0x0600   /* Needed to pull in 'struct sockaddr_storage' */
+    #endif
+
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+
+    #define SOCKET          int
+    #define INVALID_SOCKET  (-1)
+    #define closesocket(x)  close(x)
+#endif
+
+#ifdef _WIN32
+    #define perror(str)           ws2_perror(str)
+
+    static void ws2_perror(const char *str)
+    {
+        if (str && *str)
+            fprintf(stderr, "%s: ", str);
+        fprintf(stderr, "Winsock error %d.\n", WSAGetLastError());
+    }
+#endif
+
+#define PULSE_UDP_DATAGRAM_MAX 65507 ///< max UDP payload, the largest package takes about 48k
+
+/// Open a datagram socket for @p host and @p port, bound to it for a receiver.
+static SOCKET pulse_udp_open(char const *host, char const *port, int passive, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    struct addrinfo hints, *res, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = passive ? AI_PASSIVE : AI_ADDRCONFIG;
+    int error = getaddrinfo(host, port, &hints, &res0);
+    if (error) {
+        print_log(LOG_ERROR, __func__, gai_strerror(error));
+        return INVALID_SOCKET;
+    }
+    SOCKET sock = INVALID_SOCKET;
+    for (res = res0; res; res = res->ai_next) {
+        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        if (passive && bind(sock, res->ai_addr, res->ai_addrlen) < 0) {
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+            continue;
+        }
+        memset(addr, 0, sizeof(*addr));
+        memcpy(addr, res->ai_addr, res->ai_addrlen);
+        *addr_len = res->ai_addrlen;
+        break; // success
+    }
+    freeaddrinfo(res0);
+    if (sock == INVALID_SOCKET)
+        perror(passive ? "error on binding" : "socket");
+    return sock;
+}
+
+/* Sender */
+
+struct pulse_sender {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    SOCKET sock;
+};
+
+pulse_sender_t *pulse_sender_create(char const *host, char const *port)
+{
+    pulse_sender_t *sender = calloc(1, sizeof(*sender));
+    if (!sender) {
+        WARN_CALLOC("pulse_sender_create()");
+        return NULL;
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        free(sender);
+        return NULL;
+    }
+#endif
+    sender->sock = pulse_udp_open(host, port, 0, &sender->addr, &sender->addr_len);
+    if (sender->sock == INVALID_SOCKET) {
+        pulse_sender_free(sender);
+        return NULL;
+    }
+    return sender;
+}
+
+void pulse_sender_send(pulse_sender_t *sender, pulse_data_t const *pulses)
+{
+    // the inputs decode on threads of their own, each package is encoded on the sending thread
+    uint8_t stack_buf[4096];
+    size_t size = PD_BIN_HEADER_LEN + 170 + (size_t)pulses->num_pulses * 10;
+    uint8_t *buf = size <= sizeof(stack_buf) ? stack_buf : malloc(size);
+    if (!buf) {
+        WARN_MALLOC("pulse_sender_send()");
+        return;
+    }
+
+    size_t len = pulse_data_encode_bin_header(buf);
+    len += pulse_data_encode_bin(buf + len, size - len, pulses);
+    if (sendto(sender->sock, (char const *)buf, len, 0, (struct sockaddr *)&sender->addr, sender->addr_len) < 0)
+        perror("sendto");
+
+    if (buf != stack_buf)
+        free(buf);
+}
+
+void pulse_sender_free(pulse_sender_t *sender)
+{
+    if (!sender)
+        return;
+    if (sender->sock != INVALID_SOCKET)
+        closesocket(sender->sock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    free(sender);
+}
+
+/* Receiver */
+
+struct pulse_receiver {
+    SOCKET sock;
+    size_t len;      ///< length of the datagram
+    size_t pos;      ///< position of the next package in the datagram
+    unsigned invalid;
+    char peer[INET6_ADDRSTRLEN];
+    uint8_t buf[PULSE_UDP_DATAGRAM_MAX];
+};
+
+pulse_receiver_t *pulse_receiver_create(char const *host, char const *port)
+{
+    pulse_receiver_t *receiver = calloc(1, sizeof(*receiver));
+    if (!receiver) {
+        WARN_CALLOC("pulse_receiver_create()");
+        return NULL;
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        free(receiver);
+        return NULL;
+    }
+#endif
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    receiver->sock = pulse_udp_open(host, port, 1, &addr, &addr_len);
+    if (receiver->sock == INVALID_SOCKET) {
+        pulse_receiver_free(receiver);
+        return NULL;
+    }
+    return receiver;
+}
+
+/// Wait for a datagram and check its header, returns 1 on a datagram, 0 on a timeout, -1 on error.
+static int receive_datagram(pulse_receiver_t *receiver, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(receiver->sock, &fds);
+    struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    int r = select((int)receiver->sock + 1, &fds, NULL, NULL, &tv);
+#ifndef _WIN32
+    if (r < 0 && errno == EINTR)
+        return 0; // a signal, the caller checks if it should stop
+#endif
+    if (r < 0) {
+        perror("select");
+        return -1;
+    }
+    if (r == 0)
+        return 0;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int len = recvfrom(receiver->sock, (char *)receiver->buf, sizeof(receiver->buf), 0, (struct sockaddr *)&addr, &addr_len);
+    if (len < 0) {
+        perror("recvfrom");
+        return -1;
+    }
+    receiver->len = (size_t)len;
+    receiver->pos = pulse_data_decode_bin_header(receiver->buf, receiver->len);
+    if (!receiver->pos) {
+        receiver->len = 0;
+        receiver->invalid++;
+        return 1; // no packages
+    }
+    if (getnameinfo((struct sockaddr *)&addr, addr_len, receiver->peer, sizeof(receiver->peer), NULL, 0, NI_NUMERICHOST))
+        snprintf(receiver->peer, sizeof(receiver->peer), "unknown");
+    return 1;
+}
+
+int pulse_receiver_next(pulse_receiver_t *receiver, pulse_data_t *pulses, int timeout_ms)
+{
+    while (receiver->pos >= receiver->len) {
+        int r = receive_datagram(receiver, timeout_ms);
+        if (r <= 0)
+            return r;
+    }
+    size_t n = pulse_data_decode_bin(receiver->buf + receiver->pos, receiver->len - receiver->pos, pulses);
+    if (!n) {
+        receiver->invalid++;
+        receiver->pos = receiver->len; // drop the rest of the datagram
+        return 0;
+    }
+    receiver->pos += n;
+    return 1;
+}
+
+char const *pulse_receiver_peer(pulse_receiver_t const *receiver)
+{
+    return receiver->peer;
+}
+
+unsigned pulse_receiver_invalid(pulse_receiver_t const *receiver)
+{
+    return receiver->invalid;
+}
+
+void pulse_receiver_free(pulse_receiver_t *receiver)
+{
+    if (!receiver)
+        return;
+    if (receiver->sock != INVALID_SOCKET)
+        closesocket(receiver->sock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    free(receiver);
+}
@@ -18,30 +18,64 @@
 
 #include "r_api.h"
 #include "r_util.h"
+#include "bit_util.h"
 #include "rtl_433.h"
 #include "r_private.h"
 #include "rtl_433_devices.h"
 #include "r_device.h"
 #include "pulse_slicer.h"
+#include "decode_scratch.h"
+#include "decode_memo.h"
+#include "decode_pin.h"
 #include "pulse_detect_fsk.h"
+#include "pulse_analyzer.h"
+#include "pulse_udp.h"
 #include "sdr.h"
 #include "data.h"
+#include "abuf.h"
 #include "data_tag.h"
 #include "list.h"
 #include "optparse.h"
 #include "output_file.h"
+#include "file_sink.h"
 #include "output_log.h"
 #include "output_udp.h"
+#include "output_shm.h"
+#include "output_eventlog.h"
+#include "output_aggregate.h"
+#include "output_delta.h"
+#include "output_filter.h"
+#include "output_async.h"
 #include "output_mqtt.h"
 #include "output_influx.h"
 #include "output_trigger.h"
 #include "output_rtltcp.h"
 #include "write_sigrok.h"
 #include "mongoose.h"
+#include "compat_atomic.h"
 #include "compat_time.h"
 #include "logger.h"
+#include "log_ring.h"
+#include "package_queue.h"
+#include "load_shed.h"
+#include "lag_shed.h"
+#include "iq_snippet.h"
+#include "spectrum.h"
+#include "duty_sched.h"
+#include "verify.h"
 #include "fatal.h"
 #include "http_server.h"
+#include "dsp_thread.h"
+#include "worker_pool.h"
+#include "cpu_stats.h"
+#include "trace.h"
+#include "hop_sched.h"
+#include "band_sched.h"
+#include "event_merge.h"
+#include "decode_farm.h"
+#include "dump_writer.h"
+#include "soft_agc.h"
+#include "thread_sched.h"
 
 #ifndef _WIN32
 #include <sys/stat.h>
@@ -64,6 +98,10 @@
 #include "getopt/getopt.h"
 #endif
 
+// NOTE: these are defined in devices/flex.c
+r_device *flex_create_device(char *spec);
+r_device *flex_clone_device(r_device const *flex_device);
+
 char const *version_string(void)
 {
     return "rtl_433"
@@ -115,19 +153,22 @@ void set_center_freq(r_cfg_t *cfg, uint32_t center_freq)
     cfg->frequency_index = 0;
     cfg->frequency[0] = center_freq;
     // cfg->center_frequency = center_freq; // actually applied in the sdr event
-    sdr_set_center_freq(cfg->dev, center_freq, 1);
+    sdr_event_t cmd = {.ev = SDR_EV_FREQ, .center_frequency = center_freq};
+    sdr_control(cfg->dev, &cmd, 1, 1);
 }
 
 void set_freq_correction(r_cfg_t *cfg, int freq_correction)
 {
     // cfg->ppm_error = freq_correction; // actually applied in the sdr event
-    sdr_set_freq_correction(cfg->dev, freq_correction, 0);
+    sdr_event_t cmd = {.ev = SDR_EV_CORR, .freq_correction = freq_correction};
+    sdr_control(cfg->dev, &cmd, 0, 1);
 }
 
 void set_sample_rate(r_cfg_t *cfg, uint32_t sample_rate)
 {
     // cfg->samp_rate = sample_rate; // actually applied in the sdr event
-    sdr_set_sample_rate(cfg->dev, sample_rate, 0);
+    sdr_event_t cmd = {.ev = SDR_EV_RATE, .sample_rate = sample_rate};
+    sdr_control(cfg->dev, &cmd, 0, 1);
 }
 
 void set_gain_str(struct r_cfg *cfg, char const *gain_str)
@@ -141,24 +182,60 @@ void set_gain_str(struct r_cfg *cfg, char const *gain_str)
         if (!cfg->gain_str)
             WARN_STRDUP("set_gain_str()");
     }
-    sdr_set_tuner_gain(cfg->dev, gain_str, 0);
+    apply_tuner_gain(cfg, 0);
+}
+
+void apply_tuner_gain(struct r_cfg *cfg, int verbose)
+{
+    float gain = SOFT_AGC_DEFAULT_DB;
+    if (!soft_agc_parse(cfg->gain_str, &gain)) {
+        soft_agc_free(cfg->agc);
+        cfg->agc = NULL;
+        sdr_event_t cmd = {.ev = SDR_EV_GAIN, .gain_str = cfg->gain_str};
+        sdr_control(cfg->dev, &cmd, verbose, 1);
+        return;
+    }
+    if (!cfg->agc) {
+        cfg->agc = soft_agc_create(gain, SOFT_AGC_MIN_DB, SOFT_AGC_MAX_DB, cfg->samp_rate);
+        if (!cfg->agc)
+            return;
+    }
+    char gain_str[16];
+    snprintf(gain_str, sizeof(gain_str), "%.1f", soft_agc_gain(cfg->agc));
+    sdr_event_t cmd = {.ev = SDR_EV_GAIN, .gain_str = gain_str};
+    sdr_control(cfg->dev, &cmd, verbose, 1);
 }
 
 /* general */
 
+/// Bucket bounds of the metrics histograms.
+static double const rssi_bounds[]    = {-30.0, -25.0, -20.0, -15.0, -12.0, -9.0, -6.0, -3.0, 0.0};
+static double const snr_bounds[]     = {6.0, 9.0, 12.0, 15.0, 18.0, 21.0, 24.0, 30.0, 40.0};
+static double const latency_bounds[] = {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5};
+
 void r_init_cfg(r_cfg_t *cfg)
 {
     cfg->out_block_size  = DEFAULT_BUF_LENGTH;
     cfg->samp_rate       = DEFAULT_SAMPLE_RATE;
+    cfg->settle_ms       = DEFAULT_SETTLE_MS;
+    cfg->snippet_mb        = IQ_SNIPPET_SIZE_DEFAULT;
+    cfg->snippet_margin_ms = IQ_SNIPPET_MARGIN_MS;
+    cfg->spectrum_interval = 1.0;
+    cfg->duty_margin       = 0.5;
     cfg->conversion_mode = CONVERT_NATIVE;
     cfg->fsk_pulse_detect_mode = FSK_PULSE_DETECT_AUTO;
     // Default log level is to show all LOG_FATAL, LOG_ERROR, LOG_WARNING
     // abnormal messages and LOG_CRITICAL information.
     cfg->verbosity = LOG_WARNING;
+    cfg->output_log_level = LOG_TRACE; // until the outputs are known
 
     list_ensure_size(&cfg->in_files, 100);
     list_ensure_size(&cfg->output_handler, 16);
 
+    metrics_hist_init(&cfg->hist_rssi, rssi_bounds, sizeof(rssi_bounds) / sizeof(*rssi_bounds));
+    metrics_hist_init(&cfg->hist_snr, snr_bounds, sizeof(snr_bounds) / sizeof(*snr_bounds));
+    metrics_hist_init(&cfg->hist_latency, latency_bounds, sizeof(latency_bounds) / sizeof(*latency_bounds));
+
     // collect devices list, this should be a module
     r_device r_devices[] = {
 #define DECL(name) name,
@@ -194,6 +271,7 @@ void r_init_cfg(r_cfg_t *cfg)
     time(&cfg->running_since);
     time(&cfg->frames_since);
     get_time_now(&cfg->demod->now);
+    cfg->demod_chan = cfg->demod;
 
     list_ensure_size(&cfg->demod->r_devs, 100);
     list_ensure_size(&cfg->demod->dumper, 32);
@@ -210,8 +288,188 @@ r_cfg_t *r_create_cfg(void)
     return cfg;
 }
 
-void r_free_cfg(r_cfg_t *cfg)
+/// Write a gated dumper through the writer thread of the dumpers.
+static size_t write_gated_dumper(void *ctx, FILE *file, void const *buf, size_t len)
+{
+    struct dm_state *demod = ctx;
+    return dump_writer_write(demod->dump_writer, file, buf, len);
+}
+
+/// Write the index of the gated dumpers, call before the files are closed.
+static void finish_gated_dumpers(struct dm_state *demod)
+{
+    for (void **iter = demod->gated_iq.elems; iter && *iter; ++iter) {
+        if (gated_iq_writer_finish(*iter))
+            print_log(LOG_ERROR, "Dumper", "Writing the index of a gated dumper failed");
+    }
+    list_free_elems(&demod->gated_iq, (list_elem_free_fn)gated_iq_writer_free);
+}
+
+/// Write the metadata of the SigMF dumpers, the data files are closed with the dumpers.
+static void finish_sigmf_dumpers(struct dm_state *demod)
+{
+    for (void **iter = demod->sigmf.elems; iter && *iter; ++iter) {
+        if (sigmf_writer_finish(*iter))
+            print_log(LOG_ERROR, "Dumper", "Writing the metadata of a SigMF dumper failed");
+    }
+    list_free_elems(&demod->sigmf, (list_elem_free_fn)sigmf_writer_free);
+}
+
+/// Write the remaining chunks and the directory of the Sigrok archive.
+static void finish_sigrok_dumper(r_cfg_t *cfg)
+{
+    if (!cfg->demod->sigrok)
+        return;
+    if (sigrok_writer_finish(cfg->demod->sigrok, cfg->samp_rate))
+        print_log(LOG_ERROR, "Dumper", "Writing the Sigrok file failed");
+    sigrok_writer_free(cfg->demod->sigrok);
+    cfg->demod->sigrok = NULL;
+}
+
+/// Free the device, demod, and decoders of an input, the outputs are kept.
+/// Free the decoders of an input.
+static void free_input_protocols(r_cfg_t *cfg, list_t *r_devs)
+{
+    // the contexts copied from a flex template are owned by the decoders of the first input
+    for (void **iter = r_devs->elems; cfg->parent && iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->decode_ctx == r_dev->create_template->decode_ctx)
+            r_dev->decode_ctx = NULL;
+    }
+    list_free_elems(r_devs, (list_elem_free_fn)free_protocol);
+}
+
+/// Free the sample buffers of a demod, r_demod_reserve() allocates them again.
+static void free_demod_buffers(struct dm_state *demod)
+{
+    free(demod->am_buf);
+    demod->am_buf = NULL;
+    free(demod->buf.fm);
+    demod->buf.fm = NULL;
+    free(demod->channel_buf);
+    demod->channel_buf = NULL;
+    free(demod->u8_buf);
+    demod->u8_buf = NULL;
+    for (int i = 0; i < DUMP_CONVERSIONS; ++i) {
+        free(demod->dump_buf[i]);
+        demod->dump_buf[i] = NULL;
+    }
+    demod->buf_samples = 0;
+}
+
+/// Get a buffer, locked into RAM if requested.
+static void *demod_buffer(struct dm_state *demod, size_t size, int clear)
+{
+    void *buf = clear ? calloc(1, size) : malloc(size);
+    if (!buf)
+        return NULL;
+    if (demod->lock_buffers)
+        thread_sched_lock_memory(buf, size);
+    return buf;
+}
+
+int r_demod_reserve(struct dm_state *demod, unsigned n_samples)
+{
+    if (n_samples > demod->buf_samples) {
+        // the buffers only hold the current samples, no need to copy
+        free_demod_buffers(demod);
+        demod->am_buf = demod_buffer(demod, n_samples * sizeof(*demod->am_buf), 0);
+        if (!demod->am_buf)
+            return -1;
+        demod->buf.fm = demod_buffer(demod, n_samples * sizeof(*demod->buf.fm), 0);
+        if (!demod->buf.fm)
+            return -1;
+        demod->buf_samples = n_samples;
+    }
+
+    // a channel decimates into a buffer of its own, the other channels still need the samples
+    if (demod->frequency && !demod->channel_buf) {
+        demod->channel_buf = demod_buffer(demod, (size_t)demod->buf_samples * demod->sample_size, 0);
+        if (!demod->channel_buf)
+            return -1;
+    }
+    // the dumpers of a format share the buffers, only the dumped formats get one
+    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        if (dumper->format == U8_LOGIC && !demod->u8_buf) {
+            demod->u8_buf = demod_buffer(demod, demod->buf_samples, 1);
+            if (!demod->u8_buf)
+                return -1;
+            demod->u8_dirty[0] = demod->u8_dirty[1] = 0;
+        }
+        int conversion = dump_conversion(dumper->format);
+        if (conversion >= 0 && !demod->dump_buf[conversion]) {
+            demod->dump_buf[conversion] = demod_buffer(demod, dump_conversion_size(conversion, demod->buf_samples), 0);
+            if (!demod->dump_buf[conversion])
+                return -1;
+        }
+    }
+    return 0;
+}
+
+size_t r_demod_sample_bytes(struct dm_state const *demod)
+{
+    size_t bytes = sizeof(*demod->am_buf) + sizeof(*demod->buf.fm);
+    if (demod->frequency)
+        bytes += demod->sample_size;
+    int used[DUMP_CONVERSIONS] = {0};
+    int logic = 0;
+    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        logic |= dumper->format == U8_LOGIC;
+        int conversion = dump_conversion(dumper->format);
+        if (conversion >= 0)
+            used[conversion] = 1;
+    }
+    bytes += logic;
+    for (int i = 0; i < DUMP_CONVERSIONS; ++i) {
+        if (used[i])
+            bytes += dump_conversion_size(i, 1);
+    }
+    return bytes;
+}
+
+/// Memory of a demod and its buffers.
+static size_t demod_mem(struct dm_state const *demod)
+{
+    size_t bytes = sizeof(*demod) + (size_t)demod->buf_samples * (sizeof(*demod->am_buf) + sizeof(*demod->buf.fm));
+    if (demod->channel_buf)
+        bytes += (size_t)demod->buf_samples * demod->sample_size;
+    if (demod->u8_buf)
+        bytes += demod->buf_samples;
+    for (int i = 0; i < DUMP_CONVERSIONS; ++i) {
+        if (demod->dump_buf[i])
+            bytes += dump_conversion_size(i, demod->buf_samples);
+    }
+    return bytes;
+}
+
+void r_get_mem_usage(r_cfg_t *cfg, r_mem_usage_t *mem)
 {
+    *mem = (r_mem_usage_t){0};
+    mem->sdr = cfg->sdr_buf_bytes + cfg->merge_size;
+
+    // the first channel is the demod itself
+    struct dm_state *demod = cfg->demod;
+    for (size_t i = 0; i < (cfg->channels.len ? cfg->channels.len : 1); ++i) {
+        struct dm_state const *chan = cfg->channels.len ? cfg->channels.elems[i] : demod;
+        mem->demod += demod_mem(chan);
+        mem->pulses += (size_t)(chan->pulse_data.max_pulses + chan->fsk_pulse_data.max_pulses) * 2 * sizeof(int);
+    }
+
+    mem->decoders = (size_t)demod->r_devs.len * sizeof(r_device)
+            + (size_t)demod->dispatch.size * (sizeof(*demod->dispatch.devs) + sizeof(*demod->dispatch.priority));
+    if (demod->samp_grab)
+        mem->grabber = demod->samp_grab->sg_size;
+    if (demod->dump_writer)
+        mem->dumpers = (size_t)(cfg->dump_async ? cfg->dump_async : DEFAULT_DUMP_ASYNC_MB) * 1024 * 1024;
+}
+
+static void free_input_state(r_cfg_t *cfg)
+{
+    dsp_thread_stop(cfg->dsp_thread);
+    cfg->dsp_thread = NULL;
+
     if (cfg->dev) {
         sdr_deactivate(cfg->dev);
         sdr_close(cfg->dev);
@@ -220,7 +478,44 @@ void r_free_cfg(r_cfg_t *cfg)
 
     free(cfg->gain_str);
     cfg->gain_str = NULL;
+    soft_agc_free(cfg->agc);
+    cfg->agc = NULL;
+
+    package_queue_stop(cfg->package_queue);
+    cfg->package_queue = NULL;
+    worker_pool_stop(cfg->channel_pool);
+    cfg->channel_pool = NULL;
+    worker_pool_stop(cfg->decode_pool);
+    cfg->decode_pool = NULL;
+    list_free_elems(&cfg->adaptive_devs, NULL);
+    hop_sched_free(cfg->hop_sched);
+    cfg->hop_sched = NULL;
+    lag_shed_free(cfg->lag_shed);
+    cfg->lag_shed = NULL;
+    iq_snippet_free(cfg->iq_snippet);
+    cfg->iq_snippet = NULL;
+    spectrum_free(cfg->spectrum);
+    cfg->spectrum = NULL;
+    duty_sched_free(cfg->duty_sched);
+    cfg->duty_sched = NULL;
+    verify_free(cfg->verify);
+    cfg->verify = NULL;
+    free(cfg->merge_buf);
+    cfg->merge_buf  = NULL;
+    cfg->merge_size = 0;
+    event_merge_free(cfg->event_merge);
+    cfg->event_merge = NULL;
+    decode_farm_free(cfg->decode_farm);
+    cfg->decode_farm = NULL;
 
+    if (!cfg->demod)
+        return; // a further input that was never started
+
+    finish_gated_dumpers(cfg->demod);
+    finish_sigmf_dumpers(cfg->demod);
+    finish_sigrok_dumper(cfg);
+    dump_writer_free(cfg->demod->dump_writer);
+    cfg->demod->dump_writer = NULL;
     for (void **iter = cfg->demod->dumper.elems; iter && *iter; ++iter) {
         file_info_t const *dumper = *iter;
         if (dumper->file && (dumper->file != stdout))
@@ -228,20 +523,270 @@ void r_free_cfg(r_cfg_t *cfg)
     }
     list_free_elems(&cfg->demod->dumper, free);
 
-    list_free_elems(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
+    free_input_protocols(cfg, &cfg->demod->r_devs);
+    free(cfg->demod->dispatch.devs);
+    free(cfg->demod->dispatch.priority);
+    cfg->demod->dispatch = (decoder_dispatch_t){0};
+    load_shed_free(cfg->demod->load_shed);
+    cfg->demod->load_shed = NULL;
+    decode_pin_free(cfg->demod->decode_pin);
+    cfg->demod->decode_pin = NULL;
+    decode_scratch_free(cfg->demod->scratch);
+    cfg->demod->scratch = NULL;
+    decode_scratch_free(cfg->demod->stream_scratch);
+    cfg->demod->stream_scratch = NULL;
+    for (unsigned i = 0; i < DECODE_POOL_TASKS; ++i) {
+        decode_scratch_free(cfg->demod->pool_scratch[i]);
+        cfg->demod->pool_scratch[i] = NULL;
+    }
 
     if (cfg->demod->am_analyze)
         am_analyze_free(cfg->demod->am_analyze);
     cfg->demod->am_analyze = NULL;
 
+    pulse_clusters_free(cfg->demod->pulse_clusters);
+    cfg->demod->pulse_clusters = NULL;
+
     pulse_detect_free(cfg->demod->pulse_detect);
     cfg->demod->pulse_detect = NULL;
+    pulse_data_free(&cfg->demod->pulse_data);
+    pulse_data_free(&cfg->demod->fsk_pulse_data);
+
+    // the first channel is the demod itself
+    for (size_t i = 1; i < cfg->channels.len; ++i) {
+        struct dm_state *chan = cfg->channels.elems[i];
+        pulse_clusters_free(chan->pulse_clusters);
+        pulse_detect_free(chan->pulse_detect);
+        pulse_data_free(&chan->pulse_data);
+        pulse_data_free(&chan->fsk_pulse_data);
+        free_demod_buffers(chan);
+        free(chan);
+    }
+    list_free_elems(&cfg->channels, NULL);
+    free_demod_buffers(cfg->demod);
+    cfg->demod_chan = NULL;
+}
 
-    list_free_elems(&cfg->raw_handler, (list_elem_free_fn)raw_output_free);
+static void free_input(r_cfg_t *input)
+{
+    free(input->demod);
+    free(input);
+}
 
-    r_logger_set_log_handler(NULL, NULL);
+void r_free_input(r_cfg_t *input)
+{
+    if (!input)
+        return;
+
+    free_input_state(input);
+    free_input(input);
+}
+
+r_cfg_t *r_add_input(r_cfg_t *cfg, char *dev_query)
+{
+    r_cfg_t *input = calloc(1, sizeof(*input));
+    if (!input)
+        FATAL_CALLOC("r_add_input()");
+
+    // the input settings start from the defaults, everything else is cloned on start
+    input->dev_query = dev_query;
+    input->samp_rate = DEFAULT_SAMPLE_RATE;
+    list_push(&cfg->inputs, input);
+
+    return input;
+}
+
+/// Register copies of the decoders of the first input, decoders keep state, each input needs its own instances.
+static void copy_input_protocols(r_cfg_t *input, list_t *r_devs)
+{
+    list_ensure_size(&input->demod->r_devs, r_devs->len);
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        char *arg = NULL;
+        if (r_dev->create_arg) {
+            arg = strdup(r_dev->create_arg);
+            if (!arg)
+                FATAL_STRDUP("copy_input_protocols()");
+        }
+        register_protocol(input, r_dev->create_template, arg);
+        free(arg);
+    }
+}
+
+void r_start_input(r_cfg_t *cfg, r_cfg_t *input)
+{
+    r_cfg_t settings = *input;
+
+    // share the options, tags, and outputs, the raw outputs only get the first input
+    *input = *cfg;
+    input->parent      = cfg;
+    input->input_name  = settings.dev_query;
+    input->inputs      = (list_t){0};
+    input->in_files    = (list_t){0};
+    input->raw_handler = (list_t){0};
+    input->mgr         = get_mgr(cfg);
+
+    // the input settings
+    input->dev_query        = settings.dev_query;
+    input->gain_str         = settings.gain_str;
+    input->settings_str     = settings.settings_str;
+    input->ppm_error        = settings.ppm_error;
+    input->frequencies      = settings.frequencies;
+    input->frequency_index  = settings.frequency_index;
+    input->center_frequency = settings.center_frequency;
+    input->hop_times        = settings.hop_times;
+    input->samp_rate        = settings.samp_rate;
+    memcpy(input->frequency, settings.frequency, sizeof(input->frequency));
+    memcpy(input->hop_time_ms, settings.hop_time_ms, sizeof(input->hop_time_ms));
+
+    // the state of its own
+    input->dev_state         = DEVICE_STATE_STOPPED;
+    input->dev               = NULL;
+    input->dev_info          = NULL;
+    input->dsp_thread        = NULL;
+    input->hop_now           = 0;
+    input->hop_start_pos     = 0;
+    input->hop_deferred      = 0;
+    input->settle_freq       = 0;
+    input->settle_est        = 0;
+    input->hop_sched         = NULL;
+    input->band_sched        = NULL;
+    input->band_active       = 0;
+    input->agc               = NULL;
+    input->fsk_ppm_packages  = 0;
+    input->fsk_ppm_based     = 0;
+    input->event_merge       = NULL;
+    input->farm_workers      = (list_t){0};
+    input->decode_farm       = NULL;
+    input->calibration_path  = NULL;
+    input->exit_async        = 0;
+    input->exit_code         = 0;
+    input->stats_now         = 0;
+    input->input_pos         = 0;
+    input->buf_time_us       = 0;
+    input->buf_time_ns       = 0;
+    input->watchdog          = 0;
+    input->channels          = (list_t){0};
+    input->channel_pool      = NULL;
+    input->decode_pool       = NULL;
+    input->package_queue     = NULL;
+    input->package           = NULL;
+    input->lag_shed          = NULL;
+    input->iq_snippet        = NULL;
+    input->spectrum          = NULL;
+    input->duty_sched        = NULL;
+    input->verify            = NULL;
+    input->adaptive_devs     = (list_t){0};
+    input->adaptive_num_ook  = 0;
+    input->adaptive_packages = 0;
+    input->pin_sensors       = (list_t){0};
+    input->flex_cache        = (list_t){0};
+
+    // the statistics of its own
+    memset(&input->stats, 0, sizeof(input->stats));
+    memset(&input->stats_base, 0, sizeof(input->stats_base));
+    input->sdr_since             = 0;
+    input->acquire_dropped       = 0;
+    input->merge_buf             = NULL;
+    input->merge_size            = 0;
+    input->sched_lag_us          = 0;
+    input->sched_lag_max_us      = 0;
+    memset(input->latency_hist, 0, sizeof(input->latency_hist));
+
+    // only copy the demod settings, the dumpers, analyzer, and grabber stay with the first input
+    struct dm_state *src   = cfg->demod;
+    struct dm_state *demod = calloc(1, sizeof(*demod));
+    if (!demod)
+        FATAL_CALLOC("r_start_input()");
+    demod->auto_level = src->auto_level;
+    demod->squelch_offset = src->squelch_offset;
+    demod->level_limit = src->level_limit;
+    demod->min_level = src->min_level;
+    demod->min_snr = src->min_snr;
+    demod->gate_snr = src->gate_snr;
+    demod->prefilter = src->prefilter;
+    demod->low_pass = src->low_pass;
+    demod->use_mag_est = src->use_mag_est;
+    demod->use_fused_demod = src->use_fused_demod;
+    demod->detect_verbosity = src->detect_verbosity;
+    demod->demod_FM_state.poly = src->demod_FM_state.poly;
+    demod->decimation = src->decimation;
+    demod->enable_FM_demod = src->enable_FM_demod;
+    demod->analyze_pulses = src->analyze_pulses;
+    demod->pulse_detect = pulse_detect_create();
+    if (!demod->pulse_detect)
+        FATAL_CALLOC("r_start_input()");
+    get_time_now(&demod->now);
+    input->demod      = demod;
+    input->demod_chan = demod;
+    if (cfg->pin_mode) {
+        demod->decode_pin = decode_pin_create((char const *const *)cfg->pin_sensors.elems, (unsigned)cfg->pin_sensors.len);
+        if (!demod->decode_pin)
+            FATAL_CALLOC("r_start_input()");
+    }
+
+    copy_input_protocols(input, &src->r_devs);
+
+    pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level, demod->min_snr, demod->detect_verbosity);
+    pulse_detect_set_stream(demod->pulse_detect, stream_pulses_min(&demod->r_devs));
+    r_update_dispatch(demod);
+}
+
+/// A parsed flex decoder, kept to register the same spec again on a reload.
+typedef struct flex_cache_entry {
+    uint32_t hash;       ///< FNV-1a of the spec
+    char *spec;          ///< the spec as given
+    r_device *dev;       ///< the parsed decoder, registered as clones
+    unsigned generation; ///< the reload the spec was last registered in
+} flex_cache_entry_t;
+
+static void flex_cache_free(flex_cache_entry_t *entry)
+{
+    // the strings of the spec are shared with the clones and kept
+    free(entry->dev->decode_ctx);
+    free(entry->dev);
+    free(entry->spec);
+    free(entry);
+}
+
+/// Free a cfg, also the state shared by the process unless @p local.
+static void free_cfg(r_cfg_t *cfg, int local)
+{
+    // the further inputs share the decoder contexts of this one
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        free_input_state(*iter);
+    }
+    free_input_state(cfg);
+    pulse_clusters_free(cfg->discovery);
+    cfg->discovery = NULL;
+
+    // the other threads are stopped, output what they logged
+    if (cfg->log_ring) {
+        flush_log_ring(cfg);
+        log_ring_free(cfg->log_ring);
+        cfg->log_ring = NULL;
+    }
+    if (!local)
+        r_logger_set_log_handler(NULL, NULL);
+
+    // after the log handler, stopping the raw outputs logs without a demod
+    list_free_elems(&cfg->raw_handler, (list_elem_free_fn)raw_output_free);
 
     list_free_elems(&cfg->output_handler, (list_elem_free_fn)data_output_free);
+    cfg->raw_file = NULL; // as the file outputs, closed with the sinks or on exit
+    pulse_sender_free(cfg->pulse_sender);
+    cfg->pulse_sender = NULL;
+    if (!local)
+        file_sink_close_all();
+    if (cfg->output_render)
+        data_render_free(cfg->output_render);
+    free(cfg->output_render);
+    cfg->output_render = NULL;
+    if (!local)
+        data_key_free_all();
+    free(cfg->key_conversions);
+    cfg->key_conversions     = NULL;
+    cfg->key_conversions_len = 0;
 
     list_free_elems(&cfg->data_tags, (list_elem_free_fn)data_tag_free);
 
@@ -253,17 +798,158 @@ void r_free_cfg(r_cfg_t *cfg)
     free(cfg->devices);
     cfg->devices = NULL;
 
+    free(cfg->snippet_dir);
+    cfg->snippet_dir = NULL;
+
+    free(cfg->verify_prefix);
+    cfg->verify_prefix = NULL;
+
+    list_free_elems(&cfg->farm_workers, free);
+    list_free_elems(&cfg->pin_sensors, free);
+    list_free_elems(&cfg->flex_cache, (list_elem_free_fn)flex_cache_free);
+
+    band_sched_free(cfg->band_sched);
+    cfg->band_sched = NULL;
+
+    free(cfg->calibration_path);
+    cfg->calibration_path = NULL;
+
+    free(cfg->sched_acquire);
+    free(cfg->sched_dsp);
+    free(cfg->sched_workers);
+    free(cfg->sched_output);
+    cfg->sched_acquire = NULL;
+    cfg->sched_dsp     = NULL;
+    cfg->sched_workers = NULL;
+    cfg->sched_output  = NULL;
+
     mg_mgr_free(cfg->mgr);
     free(cfg->mgr);
     cfg->mgr = NULL;
 
+    // after the event loop, the timers of the further inputs refer to them
+    list_free_elems(&cfg->inputs, (list_elem_free_fn)free_input);
+
     //free(cfg);
 }
 
+void r_free_cfg(r_cfg_t *cfg)
+{
+    free_cfg(cfg, 0);
+}
+
+void r_free_cfg_local(r_cfg_t *cfg)
+{
+    free_cfg(cfg, 1);
+}
+
 /* device decoder protocols */
 
+/// Sample rate of the demodulated data, i.e. after decimation.
+static uint32_t demod_samp_rate(r_cfg_t *cfg)
+{
+    unsigned factor = cfg->demod_chan->decimator.factor;
+    return factor ? cfg->samp_rate / factor : cfg->samp_rate;
+}
+
+/// Unit conversion of double fields, matched by the key suffix.
+typedef struct unit_conversion {
+    conversion_mode_t mode;
+    char const *key_from; ///< key suffix to convert
+    char const *key_to;
+    char const *unit_from; ///< unit in the format string
+    char const *unit_to;
+    int unit_last; ///< only the last char of the format is the unit
+    float (*convert)(float);
+} unit_conversion_t;
+
+/// The conversions of each mode, the first match wins.
+static unit_conversion_t const unit_conversions[] = {
+        {CONVERT_SI, "_F", "_C", "F", "C", 1, fahrenheit2celsius},
+        {CONVERT_SI, "_mi_h", "_km_h", "mi/h", "km/h", 0, mph2kmph},
+        {CONVERT_SI, "_in", "_mm", "in", "mm", 0, inch2mm},
+        {CONVERT_SI, "_in_h", "_mm_h", "in/h", "mm/h", 0, inch2mm},
+        {CONVERT_SI, "_inHg", "_hPa", "inHg", "hPa", 0, inhg2hpa},
+        {CONVERT_SI, "_PSI", "_kPa", "PSI", "kPa", 0, psi2kpa},
+        {CONVERT_CUSTOMARY, "_C", "_F", "C", "F", 1, celsius2fahrenheit},
+        {CONVERT_CUSTOMARY, "_km_h", "_mi_h", "km/h", "mi/h", 0, kmph2mph},
+        {CONVERT_CUSTOMARY, "_mm", "_in", "mm", "in", 0, mm2inch},
+        {CONVERT_CUSTOMARY, "_mm_h", "_in_h", "mm/h", "in/h", 0, mm2inch},
+        {CONVERT_CUSTOMARY, "_hPa", "_inHg", "hPa", "inHg", 0, hpa2inhg},
+        {CONVERT_CUSTOMARY, "_kPa", "_PSI", "kPa", "PSI", 0, kpa2psi},
+};
+
+/// Prepared unit conversions of a key, indexed by conversion mode less CONVERT_SI.
+typedef struct key_conversion {
+    int prepared;
+    uint8_t unit[2];     ///< index + 1 of the unit conversion, 0 for none
+    unsigned key_id[2];  ///< id of the converted key, 0 if not interned
+} key_conversion_t;
+
+/// Returns the index of the unit conversion for @p key, -1 if none.
+static int find_unit_conversion(conversion_mode_t mode, char const *key)
+{
+    for (size_t i = 0; i < sizeof(unit_conversions) / sizeof(*unit_conversions); ++i) {
+        if (unit_conversions[i].mode == mode && str_endswith(key, unit_conversions[i].key_from))
+            return i;
+    }
+    return -1;
+}
+
+/// Intern the fields of a decoder and prepare their unit conversions, for all modes as the mode can change.
+static void prepare_conversions(r_cfg_t *cfg, r_device *r_dev)
+{
+    for (char const *const *p = r_dev->fields; p && *p; ++p) {
+        unsigned id = data_key_intern(*p);
+        if (!id)
+            continue; // NOTE: the key is looked up on output
+        if (id >= cfg->key_conversions_len) {
+            unsigned len = MAX(id + 1, cfg->key_conversions_len * 2);
+            key_conversion_t *kcs = realloc(cfg->key_conversions, len * sizeof(*kcs));
+            if (!kcs) {
+                WARN_REALLOC("prepare_conversions()");
+                return;
+            }
+            memset(&kcs[cfg->key_conversions_len], 0, (len - cfg->key_conversions_len) * sizeof(*kcs));
+            cfg->key_conversions     = kcs;
+            cfg->key_conversions_len = len;
+        }
+        key_conversion_t *kc = &cfg->key_conversions[id];
+        if (kc->prepared)
+            continue;
+        for (int mode = 0; mode < 2; ++mode) {
+            int unit = find_unit_conversion(CONVERT_SI + mode, *p);
+            if (unit < 0)
+                continue;
+            char *key = str_replace(*p, unit_conversions[unit].key_from, unit_conversions[unit].key_to);
+            kc->key_id[mode] = key ? data_key_intern(key) : 0;
+            kc->unit[mode]   = unit + 1;
+            free(key);
+        }
+        kc->prepared = 1;
+    }
+}
+
+/// Give a decoder a memo of its recent decodes if requested, see -Y memo.
+static void prepare_decode_memo(r_cfg_t *cfg, r_device *r_dev)
+{
+    if (!cfg->decode_memo_ms || r_dev->keeps_state || r_dev->decode_memo)
+        return;
+    r_dev->decode_memo = decode_memo_create(cfg->decode_memo_ms / 1000.0);
+    if (!r_dev->decode_memo)
+        FATAL_CALLOC("prepare_decode_memo()");
+}
+
 void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
 {
+    // keep the arg to register the protocol on further inputs
+    char *create_arg = NULL;
+    if (arg && *arg) {
+        create_arg = strdup(arg);
+        if (!create_arg)
+            FATAL_STRDUP("register_protocol()");
+    }
+
     // use arg of 'v', 'vv', 'vvv' as device verbosity
     int dev_verbose = 0;
     if (arg && *arg == 'v') {
@@ -290,14 +976,31 @@ void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
         *p = *r_dev; // copy
     }
 
+    p->create_template = r_dev;
+    p->create_arg      = create_arg;
+
     p->verbose      = dev_verbose ? dev_verbose : (cfg->verbosity > 4 ? cfg->verbosity - 5 : 0);
     p->verbose_bits = cfg->verbose_bits;
+    p->log_level    = cfg->output_log_level;
     p->log_fn       = log_device_handler;
 
     p->output_fn  = data_acquired_handler;
     p->output_ctx = cfg;
+    // most runs keep the native units, r_prepare_conversions() catches up if -C follows the -R
+    if (cfg->conversion_mode != CONVERT_NATIVE)
+        prepare_conversions(cfg, p);
+    // r_prepare_decode_memo() catches up if -Y memo follows the -R
+    prepare_decode_memo(cfg, p);
+    if (p->schema) {
+        p->record_schema = data_schema_create(p->schema);
+        if (!p->record_schema)
+            FATAL("bad schema or low memory? data_schema_create() failed in register_protocol()");
+    }
 
     list_push(&cfg->demod->r_devs, p);
+    list_clear(&cfg->adaptive_devs, NULL); // rebuilt with the next package
+    cfg->demod->dispatch.stale = 1;
+    cfg->protocols_changes++;
 
     if (cfg->verbosity >= LOG_INFO) {
         fprintf(stderr, "Registering protocol [%u] \"%s\"\n", r_dev->protocol_num, r_dev->name);
@@ -308,6 +1011,10 @@ void free_protocol(r_device *r_dev)
 {
     // free(r_dev->name);
     free(r_dev->decode_ctx);
+    free(r_dev->slice_bits);
+    decode_memo_free(r_dev->decode_memo);
+    data_schema_free(r_dev->record_schema);
+    free(r_dev->create_arg);
     free(r_dev);
 }
 
@@ -316,10 +1023,175 @@ void unregister_protocol(r_cfg_t *cfg, r_device *r_dev)
     for (size_t i = 0; i < cfg->demod->r_devs.len; ++i) { // list might contain NULLs
         r_device *p = cfg->demod->r_devs.elems[i];
         if (!strcmp(p->name, r_dev->name)) {
+            list_clear(&cfg->adaptive_devs, NULL); // rebuilt with the next package
             list_remove(&cfg->demod->r_devs, i, (list_elem_free_fn)free_protocol);
+            cfg->demod->dispatch.stale = 1;
+            cfg->protocols_changes++;
+            i--; // so we don't skip the next elem now shifted down
+        }
+    }
+}
+
+void r_update_dispatch(struct dm_state *demod)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    unsigned num_devs = (unsigned)demod->r_devs.len;
+    if (num_devs > dispatch->size) {
+        r_device **devs = realloc(dispatch->devs, num_devs * sizeof(*devs));
+        if (!devs)
+            FATAL_REALLOC("r_update_dispatch()");
+        dispatch->devs = devs;
+        unsigned *priority = realloc(dispatch->priority, num_devs * sizeof(*priority));
+        if (!priority)
+            FATAL_REALLOC("r_update_dispatch()");
+        dispatch->priority = priority;
+        dispatch->size     = num_devs;
+    }
+
+    unsigned len = 0;
+    for (int fsk = 0; fsk <= 1; ++fsk) {
+        unsigned first = len;
+        for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+            r_device *r_dev = *iter;
+            if ((r_dev->modulation >= FSK_DEMOD_MIN_VAL) != fsk)
+                continue;
+            // insertion sort, stable and quick as nearly all decoders have the same priority
+            unsigned i = len++;
+            for (; i > first && dispatch->priority[i - 1] > r_dev->priority; --i) {
+                dispatch->devs[i]     = dispatch->devs[i - 1];
+                dispatch->priority[i] = dispatch->priority[i - 1];
+            }
+            dispatch->devs[i]     = r_dev;
+            dispatch->priority[i] = r_dev->priority;
+        }
+        if (!fsk)
+            dispatch->num_ook = len;
+    }
+    dispatch->len   = len;
+    dispatch->stale = 0;
+    dispatch->generation++;
+}
+
+void r_prepare_conversions(r_cfg_t *cfg)
+{
+    if (cfg->conversion_mode == CONVERT_NATIVE)
+        return;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        prepare_conversions(cfg, *iter);
+    }
+}
+
+void r_prepare_decode_memo(r_cfg_t *cfg)
+{
+    if (!cfg->decode_memo_ms)
+        return;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        prepare_decode_memo(cfg, *iter);
+    }
+}
+
+void r_update_log_level(r_cfg_t *cfg)
+{
+    int log_level = 0;
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (output && output->log_level > log_level)
+            log_level = output->log_level;
+    }
+    cfg->output_log_level = log_level;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        r_dev->log_level = log_level;
+    }
+}
+
+/// Set up the demodulation of an input and its channels for the decoders registered.
+static void update_input_protocols(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+    r_update_dispatch(demod);
+    if (demod->dispatch.len > demod->dispatch.num_ook)
+        demod->enable_FM_demod = 1; // NOTE: is kept on if the FSK decoders are removed
+    unsigned stream_min = stream_pulses_min(&demod->r_devs);
+    pulse_detect_set_stream(demod->pulse_detect, stream_min);
+    for (void **iter = cfg->channels.elems; iter && *iter; ++iter) {
+        struct dm_state *chan = *iter;
+        chan->enable_FM_demod |= demod->enable_FM_demod;
+        pulse_detect_set_stream(chan->pulse_detect, stream_min);
+    }
+}
+
+/// Drop the specs not registered since the last reload.
+static void flex_cache_evict(r_cfg_t *cfg)
+{
+    for (size_t i = 0; i < cfg->flex_cache.len; ++i) {
+        flex_cache_entry_t *entry = cfg->flex_cache.elems[i];
+        if (entry->generation != cfg->flex_cache_gen) {
+            list_remove(&cfg->flex_cache, i, (list_elem_free_fn)flex_cache_free);
             i--; // so we don't skip the next elem now shifted down
         }
     }
+    cfg->flex_cache_gen++;
+}
+
+void r_reload_protocols(r_cfg_t *cfg, list_t *retired)
+{
+    update_input_protocols(cfg);
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        r_cfg_t *input = *iter;
+        if (!input->demod)
+            continue; // never started
+        list_t old = input->demod->r_devs;
+        input->demod->r_devs = (list_t){0};
+        list_clear(&input->adaptive_devs, NULL); // rebuilt with the next package
+        copy_input_protocols(input, &cfg->demod->r_devs);
+        free_input_protocols(input, &old);
+        update_input_protocols(input);
+    }
+
+    // a flex decoder is the only user of its template, the other templates are the device list
+    for (void **iter = retired->elems; iter && *iter; ++iter) {
+        r_device *tmpl = ((r_device *)*iter)->create_template;
+        if (tmpl < cfg->devices || tmpl >= cfg->devices + cfg->num_r_devices)
+            free(tmpl);
+    }
+    free_input_protocols(cfg, retired);
+    if (retired->len)
+        flex_cache_evict(cfg); // not if decoders were only added
+    cfg->protocols_changes++; // even if the reload registered no decoder
+}
+
+void register_flex_protocol(r_cfg_t *cfg, char *spec)
+{
+    uint32_t hash = fnv1a(FNV1A_INIT, spec, strlen(spec));
+    flex_cache_entry_t *entry = NULL;
+    for (void **iter = cfg->flex_cache.elems; iter && *iter; ++iter) {
+        flex_cache_entry_t *e = *iter;
+        if (e->hash == hash && !strcmp(e->spec, spec)) {
+            entry = e;
+            break;
+        }
+    }
+
+    if (!entry) {
+        entry = calloc(1, sizeof(*entry));
+        if (!entry)
+            FATAL_CALLOC("register_flex_protocol()");
+        entry->spec = strdup(spec);
+        if (!entry->spec)
+            FATAL_STRDUP("register_flex_protocol()");
+        entry->hash = hash;
+        entry->dev  = flex_create_device(spec); // exits on a bad spec
+        if (!entry->dev)
+            FATAL_CALLOC("register_flex_protocol()");
+        list_push(&cfg->flex_cache, entry);
+    }
+    entry->generation = cfg->flex_cache_gen;
+
+    r_device *flex_device = flex_clone_device(entry->dev);
+    if (!flex_device)
+        FATAL_CALLOC("register_flex_protocol()");
+    register_protocol(cfg, flex_device, "");
 }
 
 void register_all_protocols(r_cfg_t *cfg, unsigned disabled)
@@ -334,21 +1206,59 @@ void register_all_protocols(r_cfg_t *cfg, unsigned disabled)
 
 /* output helper */
 
+#ifdef FIXED_POINT
+/// Integer variant for FPU-less targets, the levels are converted to float only to be stored.
+void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
+{
+    uint32_t ook_high_estimate = pulse_data->ook_high_estimate > 0 ? pulse_data->ook_high_estimate : 1;
+    uint32_t ook_low_estimate = pulse_data->ook_low_estimate > 0 ? pulse_data->ook_low_estimate : 1;
+    // the mean over the pulse samples is more accurate than the running high estimate
+    uint32_t pulse_level = pulse_data->pulse_mean > 0 ? (uint32_t)pulse_data->pulse_mean : ook_high_estimate;
+    int64_t samp_rate = demod_samp_rate(cfg);
+    int32_t foffs1 = (int32_t)(pulse_data->fsk_f1_est * samp_rate / (2 * INT16_MAX));
+    int32_t foffs2 = (int32_t)(pulse_data->fsk_f2_est * samp_rate / (2 * INT16_MAX));
+    // a channel is demodulated at its own frequency, not the SDR center
+    uint32_t center_frequency = cfg->demod_chan->frequency ? cfg->demod_chan->frequency : cfg->center_frequency;
+    pulse_data->freq1_hz = (int64_t)center_frequency + foffs1;
+    pulse_data->freq2_hz = (int64_t)center_frequency + foffs2;
+    pulse_data->centerfreq_hz = center_frequency;
+    pulse_data->depth_bits    = cfg->demod_chan->sample_size * 4;
+    db_level_t rssi;
+    db_level_t noise;
+    if (cfg->demod_chan->sample_size == 2 && !cfg->demod_chan->use_mag_est) { // amplitude (CU8)
+        pulse_data->range_db = 42.1442f; // 10*log10f(16384.0f) == 20*log10f(128.0f)
+        rssi  = baseband_amp_sum_db(pulse_level, 1);
+        noise = baseband_amp_sum_db(ook_low_estimate, 1);
+    }
+    else { // magnitude (CU8, CS16)
+        pulse_data->range_db = 84.2884f; // 20*log10f(16384.0f)
+        rssi  = baseband_mag_sum_db(pulse_level, 1);
+        noise = baseband_mag_sum_db(ook_low_estimate, 1);
+    }
+    pulse_data->rssi_db  = DB_LEVEL_FLOAT(rssi);
+    pulse_data->noise_db = DB_LEVEL_FLOAT(noise);
+    pulse_data->snr_db   = DB_LEVEL_FLOAT(rssi - noise);
+}
+#else
 void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
 {
     float ook_high_estimate = pulse_data->ook_high_estimate > 0 ? pulse_data->ook_high_estimate : 1;
     float ook_low_estimate = pulse_data->ook_low_estimate > 0 ? pulse_data->ook_low_estimate : 1;
-    float asnr   = ook_high_estimate / ook_low_estimate;
-    float foffs1 = (float)pulse_data->fsk_f1_est / INT16_MAX * cfg->samp_rate / 2.0f;
-    float foffs2 = (float)pulse_data->fsk_f2_est / INT16_MAX * cfg->samp_rate / 2.0f;
-    pulse_data->freq1_hz = (foffs1 + cfg->center_frequency);
-    pulse_data->freq2_hz = (foffs2 + cfg->center_frequency);
-    pulse_data->centerfreq_hz = cfg->center_frequency;
-    pulse_data->depth_bits    = cfg->demod->sample_size * 4;
+    // the mean over the pulse samples is more accurate than the running high estimate
+    float pulse_level = pulse_data->pulse_mean > 0 ? pulse_data->pulse_mean : ook_high_estimate;
+    float asnr   = pulse_level / ook_low_estimate;
+    float foffs1 = (float)pulse_data->fsk_f1_est / INT16_MAX * demod_samp_rate(cfg) / 2.0f;
+    float foffs2 = (float)pulse_data->fsk_f2_est / INT16_MAX * demod_samp_rate(cfg) / 2.0f;
+    // a channel is demodulated at its own frequency, not the SDR center
+    uint32_t center_frequency = cfg->demod_chan->frequency ? cfg->demod_chan->frequency : cfg->center_frequency;
+    pulse_data->freq1_hz = (foffs1 + center_frequency);
+    pulse_data->freq2_hz = (foffs2 + center_frequency);
+    pulse_data->centerfreq_hz = center_frequency;
+    pulse_data->depth_bits    = cfg->demod_chan->sample_size * 4;
     // NOTE: for (CU8) amplitude is 10x (because it's squares)
-    if (cfg->demod->sample_size == 2 && !cfg->demod->use_mag_est) { // amplitude (CU8)
+    if (cfg->demod_chan->sample_size == 2 && !cfg->demod_chan->use_mag_est) { // amplitude (CU8)
         pulse_data->range_db = 42.1442f; // 10*log10f(16384.0f) == 20*log10f(128.0f)
-        pulse_data->rssi_db  = 10.0f * log10f(ook_high_estimate) - 42.1442f; // 10*log10f(16384.0f)
+        pulse_data->rssi_db  = 10.0f * log10f(pulse_level) - 42.1442f; // 10*log10f(16384.0f)
         pulse_data->noise_db = 10.0f * log10f(ook_low_estimate) - 42.1442f; // 10*log10f(16384.0f)
         pulse_data->snr_db   = 10.0f * log10f(asnr);
     }
@@ -357,39 +1267,80 @@ void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
         // lowest (scaled x128) reading at  8 bit is -20*log10(128) = -42.1442 (eff. -36 dB)
         // lowest (scaled div2) reading at 12 bit is -20*log10(1024) = -60.2060 (eff. -54 dB)
         // lowest (scaled div2) reading at 16 bit is -20*log10(16384) = -84.2884 (eff. -78 dB)
-        pulse_data->rssi_db  = 20.0f * log10f(ook_high_estimate) - 84.2884f; // 20*log10f(16384.0f)
+        pulse_data->rssi_db  = 20.0f * log10f(pulse_level) - 84.2884f; // 20*log10f(16384.0f)
         pulse_data->noise_db = 20.0f * log10f(ook_low_estimate) - 84.2884f; // 20*log10f(16384.0f)
         pulse_data->snr_db   = 20.0f * log10f(asnr);
     }
 }
+#endif
+
+/// The formatted second of the last timestamp, per thread as the log handler runs on any thread.
+typedef struct time_cache {
+    time_t secs;
+    int report_time;
+    int with_tz;
+    size_t prefix_len;
+    char prefix[LOCAL_TIME_BUFLEN]; ///< the date and time up to the seconds
+    char zone[8];                   ///< the time offset, or empty
+} time_cache_t;
+
+static COMPAT_TLS time_cache_t time_cache = {.report_time = -1};
+
+/// Format the second of @p secs into the cache, the zone lookup happens only here.
+static void time_cache_update(time_t secs, int report_time, int with_tz)
+{
+    char buf[LOCAL_TIME_BUFLEN];
+    char const *format = report_time == REPORT_TIME_UNIX ? "%s" : report_time == REPORT_TIME_ISO ? "%Y-%m-%dT%H:%M:%S" : NULL;
+    format_time_str(buf, format, with_tz, secs);
+
+    size_t len = strlen(buf);
+    // the offset is "Z" or "+hhmm"
+    size_t zone_len = !with_tz ? 0 : buf[len - 1] == 'Z' ? 1 : 5;
+    memcpy(time_cache.zone, buf + len - zone_len, zone_len);
+    time_cache.zone[zone_len] = '\0';
+    time_cache.prefix_len = len - zone_len;
+    memcpy(time_cache.prefix, buf, time_cache.prefix_len);
+    time_cache.prefix[time_cache.prefix_len] = '\0';
+
+    time_cache.secs        = secs;
+    time_cache.report_time = report_time;
+    time_cache.with_tz     = with_tz;
+}
 
 char *time_pos_str(r_cfg_t *cfg, unsigned samples_ago, char *buf)
 {
     if (cfg->report_time == REPORT_TIME_SAMPLES) {
-        double s_per_sample = 1.0f / cfg->samp_rate;
-        return sample_pos_str(cfg->demod->sample_file_pos - samples_ago * s_per_sample, buf);
-    }
-    else {
-        struct timeval ago = cfg->demod->now;
-        double us_per_sample = 1e6 / cfg->samp_rate;
-        unsigned usecs_ago   = samples_ago * us_per_sample;
-        while (ago.tv_usec < (int)usecs_ago) {
-            ago.tv_sec -= 1;
-            ago.tv_usec += 1000000;
+        double s_per_sample = 1.0f / demod_samp_rate(cfg);
+        return sample_pos_str(cfg->demod_chan->sample_file_pos - samples_ago * s_per_sample, buf);
+    }
+
+    int64_t usecs_ago = (int64_t)samples_ago * 1000000 / demod_samp_rate(cfg);
+    int64_t usecs = (int64_t)cfg->demod_chan->now.tv_sec * 1000000 + cfg->demod_chan->now.tv_usec - usecs_ago;
+    time_t secs   = (time_t)(usecs / 1000000);
+    long frac     = (long)(usecs % 1000000);
+    if (frac < 0) {
+        secs -= 1;
+        frac += 1000000;
+    }
+
+    int report_time = cfg->report_time;
+    int with_tz     = cfg->report_time_tz;
+    if (secs != time_cache.secs || report_time != time_cache.report_time || with_tz != time_cache.with_tz)
+        time_cache_update(secs, report_time, with_tz);
+
+    char *p = buf;
+    memcpy(p, time_cache.prefix, time_cache.prefix_len);
+    p += time_cache.prefix_len;
+    if (cfg->report_time_hires) {
+        *p++ = '.';
+        for (int i = 5; i >= 0; --i) {
+            p[i] = (char)('0' + frac % 10);
+            frac /= 10;
         }
-        ago.tv_usec -= usecs_ago;
-
-        char const *format = NULL;
-        if (cfg->report_time == REPORT_TIME_UNIX)
-            format = "%s";
-        else if (cfg->report_time == REPORT_TIME_ISO)
-            format = "%Y-%m-%dT%H:%M:%S";
-
-        if (cfg->report_time_hires)
-            return usecs_time_str(buf, format, cfg->report_time_tz, &ago);
-        else
-            return format_time_str(buf, format, cfg->report_time_tz, ago.tv_sec);
+        p += 6;
     }
+    strcpy(p, time_cache.zone); // NOLINT
+    return buf;
 }
 
 // well-known fields "time", "msg" and "codes" are used to output general decoder messages
@@ -433,6 +1384,13 @@ char const **well_known_output_fields(r_cfg_t *cfg)
         list_push(&field_list, "snr");
         list_push(&field_list, "noise");
     }
+    else if (cfg->channelize || cfg->mimo) {
+        list_push(&field_list, "freq");
+    }
+    if (cfg->mimo)
+        list_push(&field_list, "rx_channel");
+    if (cfg->inputs.len)
+        list_push(&field_list, "input");
 
     return (char const **)field_list.elems;
 }
@@ -493,13 +1451,136 @@ char const **determine_csv_fields(r_cfg_t *cfg, char const *const *well_known, i
     return (char const **)field_list.elems;
 }
 
-int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
+/// Check the package fingerprint, count the decoders skipped.
+static int prefilter_device(r_device *r_dev, pulse_data_t const *pulse_data)
+{
+    if (pulse_slicer_prefilter(pulse_data, r_dev))
+        return 1;
+    stats_add(&r_dev->stats.prefilter_skips, 1);
+    return 0;
+}
+
+/// Run one decoder on an OOK package.
+static int run_ook_device(r_device *r_dev, pulse_data_t *pulse_data)
+{
+    if (r_dev->modulation < FSK_DEMOD_MIN_VAL && !prefilter_device(r_dev, pulse_data))
+        return 0;
+
+    switch (r_dev->modulation) {
+    case OOK_PULSE_PCM:
+    // case OOK_PULSE_RZ:
+        return pulse_slicer_pcm(pulse_data, r_dev);
+    case OOK_PULSE_PPM:
+        return pulse_slicer_ppm(pulse_data, r_dev);
+    case OOK_PULSE_PWM:
+        return pulse_slicer_pwm(pulse_data, r_dev);
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+        return pulse_slicer_manchester_zerobit(pulse_data, r_dev);
+    case OOK_PULSE_PIWM_RAW:
+        return pulse_slicer_piwm_raw(pulse_data, r_dev);
+    case OOK_PULSE_PIWM_DC:
+        return pulse_slicer_piwm_dc(pulse_data, r_dev);
+    case OOK_PULSE_DMC:
+        return pulse_slicer_dmc(pulse_data, r_dev);
+    case OOK_PULSE_PWM_OSV1:
+        return pulse_slicer_osv1(pulse_data, r_dev);
+    case OOK_PULSE_NRZS:
+        return pulse_slicer_nrzs(pulse_data, r_dev);
+    // FSK decoders
+    case FSK_PULSE_PCM:
+    case FSK_PULSE_PWM:
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        return 0;
+    default:
+        fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
+        return 0;
+    }
+}
+
+/// Run one decoder on an FSK package.
+static int run_fsk_device(r_device *r_dev, pulse_data_t *fsk_pulse_data)
+{
+    if (r_dev->modulation >= FSK_DEMOD_MIN_VAL && !prefilter_device(r_dev, fsk_pulse_data))
+        return 0;
+
+    switch (r_dev->modulation) {
+    // OOK decoders
+    case OOK_PULSE_PCM:
+    // case OOK_PULSE_RZ:
+    case OOK_PULSE_PPM:
+    case OOK_PULSE_PWM:
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+    case OOK_PULSE_PIWM_RAW:
+    case OOK_PULSE_PIWM_DC:
+    case OOK_PULSE_DMC:
+    case OOK_PULSE_PWM_OSV1:
+    case OOK_PULSE_NRZS:
+        return 0;
+    case FSK_PULSE_PCM:
+        return pulse_slicer_pcm(fsk_pulse_data, r_dev);
+    case FSK_PULSE_PWM:
+        return pulse_slicer_pwm(fsk_pulse_data, r_dev);
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        return pulse_slicer_manchester_zerobit(fsk_pulse_data, r_dev);
+    default:
+        fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
+        return 0;
+    }
+}
+
+/// Check if the decoder already reported this package while it was received.
+static int stream_reported(r_device const *r_dev, pulse_data_t const *pulse_data)
+{
+    return r_dev->stream_pulse_data == pulse_data && r_dev->stream_offset == pulse_data->offset;
+}
+
+/// Run a decoder on a package, with the CPU time and the trace of the run.
+static int run_timed(r_device *r_dev, pulse_data_t *pulse_data, int (*run_fn)(r_device *, pulse_data_t *))
+{
+    uint64_t trace_start = trace_begin();
+    uint64_t start = cpu_stats_start();
+    int events = run_fn(r_dev, pulse_data);
+    cpu_stats_end(&r_dev->cpu_slice, start);
+    trace_end(TRACE_DECODER, r_dev->name, events > 0 ? (uint32_t)events : 0, trace_start);
+    return events;
+}
+
+/// Check if a decoder gives way under overload, the fallback decoders of a later priority and the flex decoders do.
+static int sheddable(r_device const *r_dev)
+{
+    return r_dev->priority > 0 || !r_dev->protocol_num;
+}
+
+/// Check if a sheddable decoder is skipped as the package is over the CPU budget, count the skip.
+static int shed_device(load_shed_t *shed, r_device *r_dev)
+{
+    if (!shed || !sheddable(r_dev) || !load_shed_over(shed, cpu_stats_now()))
+        return 0;
+    stats_add(&r_dev->stats.shed_skips, 1);
+    return 1;
+}
+
+/// Get a scratch of the demod, allocated on first use, NULL on alloc failure.
+static decode_scratch_t *demod_scratch(decode_scratch_t **scratch)
+{
+    if (!*scratch)
+        *scratch = decode_scratch_create();
+    return *scratch;
+}
+
+/// Run the decoders by priority, stop if an event is produced.
+static int run_demods(list_t *r_devs, pulse_data_t *pulse_data, int (*run_fn)(r_device *, pulse_data_t *))
 {
     int p_events = 0;
+    int stream_events = 0; // decoders which already reported this package count as events
+    slice_cache_t slice_cache = {0};
+    // not a hot path, the list has no demod to keep a scratch
+    decode_scratch_t *scratch = decode_scratch_create();
+    data_cache_t *prev_cache = decode_scratch_use(scratch);
 
     unsigned next_priority = 0; // next smallest on each loop through decoders
     // run all decoders of each priority, stop if an event is produced
-    for (unsigned priority = 0; !p_events && priority < UINT_MAX; priority = next_priority) {
+    for (unsigned priority = 0; !p_events && !stream_events && priority < UINT_MAX; priority = next_priority) {
         next_priority = UINT_MAX;
         for (void **iter = r_devs->elems; iter && *iter; ++iter) {
             r_device *r_dev = *iter;
@@ -511,107 +1592,578 @@ int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
             if (r_dev->priority != priority)
                 continue;
 
-            switch (r_dev->modulation) {
-            case OOK_PULSE_PCM:
-            // case OOK_PULSE_RZ:
-                p_events += pulse_slicer_pcm(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PPM:
-                p_events += pulse_slicer_ppm(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PWM:
-                p_events += pulse_slicer_pwm(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_MANCHESTER_ZEROBIT:
-                p_events += pulse_slicer_manchester_zerobit(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PIWM_RAW:
-                p_events += pulse_slicer_piwm_raw(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PIWM_DC:
-                p_events += pulse_slicer_piwm_dc(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_DMC:
-                p_events += pulse_slicer_dmc(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PWM_OSV1:
-                p_events += pulse_slicer_osv1(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_NRZS:
-                p_events += pulse_slicer_nrzs(pulse_data, r_dev);
-                break;
-            // FSK decoders
-            case FSK_PULSE_PCM:
-            case FSK_PULSE_PWM:
-            case FSK_PULSE_MANCHESTER_ZEROBIT:
-                break;
-            default:
-                fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
+            if (stream_reported(r_dev, pulse_data)) {
+                stream_events += 1;
+                continue;
             }
+            r_dev->slice_cache = &slice_cache;
+            r_dev->scratch     = scratch;
+            p_events += run_timed(r_dev, pulse_data, run_fn);
+            r_dev->slice_cache = NULL;
+            r_dev->scratch     = NULL;
         }
     }
 
+    slice_cache_clear(&slice_cache);
+    data_cache_use(prev_cache);
+    decode_scratch_free(scratch);
     return p_events;
 }
 
-int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
+/// Run the streaming decoders on a partial package, each reports a package at most once.
+static int run_demods_partial(decode_scratch_t *scratch, r_device **devs, unsigned num_devs, pulse_data_t *pulse_data, int (*run_fn)(r_device *, pulse_data_t *))
 {
     int p_events = 0;
+    slice_cache_t slice_cache = {0};
+    data_cache_t *prev_cache = decode_scratch_use(scratch);
 
-    unsigned next_priority = 0; // next smallest on each loop through decoders
-    // run all decoders of each priority, stop if an event is produced
-    for (unsigned priority = 0; !p_events && priority < UINT_MAX; priority = next_priority) {
-        next_priority = UINT_MAX;
-        for (void **iter = r_devs->elems; iter && *iter; ++iter) {
-            r_device *r_dev = *iter;
+    for (unsigned i = 0; i < num_devs; ++i) {
+        r_device *r_dev = devs[i];
 
-            // Find next smallest priority
-            if (r_dev->priority > priority && r_dev->priority < next_priority)
-                next_priority = r_dev->priority;
-            // Run only current priority
-            if (r_dev->priority != priority)
-                continue;
+        if (!r_dev->stream_pulses || pulse_data->num_pulses < r_dev->stream_pulses
+                || stream_reported(r_dev, pulse_data))
+            continue;
 
-            switch (r_dev->modulation) {
-            // OOK decoders
-            case OOK_PULSE_PCM:
-            // case OOK_PULSE_RZ:
-            case OOK_PULSE_PPM:
-            case OOK_PULSE_PWM:
-            case OOK_PULSE_MANCHESTER_ZEROBIT:
-            case OOK_PULSE_PIWM_RAW:
-            case OOK_PULSE_PIWM_DC:
-            case OOK_PULSE_DMC:
-            case OOK_PULSE_PWM_OSV1:
-            case OOK_PULSE_NRZS:
-                break;
-            case FSK_PULSE_PCM:
-                p_events += pulse_slicer_pcm(fsk_pulse_data, r_dev);
-                break;
-            case FSK_PULSE_PWM:
-                p_events += pulse_slicer_pwm(fsk_pulse_data, r_dev);
-                break;
-            case FSK_PULSE_MANCHESTER_ZEROBIT:
-                p_events += pulse_slicer_manchester_zerobit(fsk_pulse_data, r_dev);
-                break;
-            default:
-                fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
-            }
+        r_dev->slice_cache = &slice_cache;
+        r_dev->scratch     = scratch;
+        int events = run_timed(r_dev, pulse_data, run_fn);
+        r_dev->slice_cache = NULL;
+        r_dev->scratch     = NULL;
+        if (events > 0) {
+            r_dev->stream_pulse_data = pulse_data;
+            r_dev->stream_offset     = pulse_data->offset;
+            p_events += events;
         }
     }
 
+    slice_cache_clear(&slice_cache);
+    data_cache_use(prev_cache);
     return p_events;
 }
 
-/* handlers */
+/// Run the decoders of a dispatch range by priority, stop if an event is produced.
+static int run_demods_sorted(decode_scratch_t *scratch, load_shed_t *shed, r_device **devs, unsigned const *priority, unsigned num_devs, pulse_data_t *pulse_data, int (*run_fn)(r_device *, pulse_data_t *))
+{
+    int p_events = 0;
+    int stream_events = 0; // decoders which already reported this package count as events
+    slice_cache_t slice_cache = {0};
+    data_cache_t *prev_cache = decode_scratch_use(scratch);
+
+    // the range is sorted by priority, run each priority group until one produces an event
+    unsigned i = 0;
+    while (i < num_devs && !p_events && !stream_events) {
+        unsigned group_priority = priority[i];
+        for (; i < num_devs && priority[i] == group_priority; ++i) {
+            r_device *r_dev = devs[i];
+            if (stream_reported(r_dev, pulse_data)) {
+                stream_events += 1;
+                continue;
+            }
+            if (shed_device(shed, r_dev))
+                continue;
+            r_dev->slice_cache = &slice_cache;
+            r_dev->scratch     = scratch;
+            p_events += run_timed(r_dev, pulse_data, run_fn);
+            r_dev->slice_cache = NULL;
+            r_dev->scratch     = NULL;
+        }
+    }
 
-static void log_handler(log_level_t level, char const *src, char const *msg, void *userdata)
+    slice_cache_clear(&slice_cache);
+    data_cache_use(prev_cache);
+    return p_events;
+}
+
+int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
 {
-    r_cfg_t *cfg = userdata;
+    return run_demods(r_devs, pulse_data, run_ook_device);
+}
 
-    if (cfg->verbosity < (int)level) {
+int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
+{
+    return run_demods(r_devs, fsk_pulse_data, run_fsk_device);
+}
+
+/// Output of a decoder on a pool thread, replayed in decoder order once the priority finished.
+typedef struct decode_output {
+    r_device *r_dev;
+    int level; ///< log level, -1 for decoded data
+    data_t *data;
+} decode_output_t;
+
+/// A slice of the decoder list for one pool task.
+typedef struct decode_task {
+    r_device **devs;
+    unsigned num_devs;
+    pulse_data_t *pulse_data;
+    int (*run_fn)(r_device *, pulse_data_t *);
+    int shed; ///< skip the sheddable decoders, the package was over the CPU budget when the priority started
+    int events;
+    list_t outputs; ///< decode_output_t in the order the decoders produced them
+    slice_cache_t slice_cache; ///< slices shared by the decoders of this task
+    decode_scratch_t *scratch; ///< scratch of the thread running this task
+} decode_task_t;
+
+/// Queue the output of a decoder running on a pool thread.
+static void defer_output(r_device *r_dev, int level, data_t *data)
+{
+    decode_task_t *task = r_dev->defer_ctx;
+    decode_output_t *output = malloc(sizeof(*output));
+    if (!output) {
+        WARN_MALLOC("defer_output()");
+        data_free(data);
+        return;
+    }
+    output->r_dev = r_dev;
+    output->level = level;
+    output->data  = data;
+    list_push(&task->outputs, output);
+}
+
+/// Output the queued outputs in order and free them.
+static void replay_outputs(list_t *outputs)
+{
+    for (void **iter = outputs->elems; iter && *iter; ++iter) {
+        decode_output_t *output = *iter;
+        if (output->level < 0)
+            output->r_dev->output_fn(output->r_dev, output->data);
+        else
+            output->r_dev->log_fn(output->r_dev, output->level, output->data);
+    }
+    list_free_elems(outputs, free);
+}
+
+static void run_demods_task(void *ctx, unsigned task_idx)
+{
+    decode_task_t *task = &((decode_task_t *)ctx)[task_idx];
+    data_cache_t *prev_cache = decode_scratch_use(task->scratch);
+    for (unsigned i = 0; i < task->num_devs; ++i) {
+        r_device *r_dev = task->devs[i];
+        if (stream_reported(r_dev, task->pulse_data))
+            continue;
+        if (task->shed && sheddable(r_dev)) {
+            stats_add(&r_dev->stats.shed_skips, 1);
+            continue;
+        }
+
+        r_dev->defer_ctx   = task;
+        r_dev->slice_cache = &task->slice_cache;
+        r_dev->scratch     = task->scratch;
+        task->events += run_timed(r_dev, task->pulse_data, task->run_fn);
+        r_dev->defer_ctx   = NULL;
+        r_dev->slice_cache = NULL;
+        r_dev->scratch     = NULL;
+    }
+    slice_cache_clear(&task->slice_cache);
+    data_cache_use(prev_cache);
+}
+
+/// Run the decoders of each priority group of a dispatch range on the pool, the outputs keep the order of the decoder list.
+static int run_demods_pool(worker_pool_t *pool, struct dm_state *demod, r_device **devs, unsigned const *priority, unsigned num_devs, pulse_data_t *pulse_data, int (*run_fn)(r_device *, pulse_data_t *))
+{
+    if (!pool || num_devs < 2)
+        return run_demods_sorted(demod_scratch(&demod->scratch), demod->load_shed, devs, priority, num_devs, pulse_data, run_fn);
+
+    load_shed_t *shed = demod->load_shed;
+
+    decode_task_t tasks[DECODE_POOL_TASKS];
+    int p_events = 0;
+    int stream_events = 0; // decoders which already reported this package count as events
+
+    // the range is sorted by priority, run each priority group until one produces an event
+    unsigned first = 0;
+    while (first < num_devs && !p_events && !stream_events) {
+        unsigned end = first;
+        unsigned num_run = 0;
+        unsigned num_sheddable = 0;
+        for (; end < num_devs && priority[end] == priority[first]; ++end) {
+            if (stream_reported(devs[end], pulse_data))
+                stream_events += 1;
+            else
+                num_run += 1;
+            num_sheddable += sheddable(devs[end]);
+        }
+        unsigned group_len = end - first;
+        // the tasks can't share the budget, the whole priority is checked once before it runs
+        int shed_group = shed && num_sheddable && load_shed_over(shed, cpu_stats_now());
+        if (num_run) {
+            unsigned num_tasks = MIN(DECODE_POOL_TASKS, group_len);
+            unsigned slice     = (group_len + num_tasks - 1) / num_tasks;
+            num_tasks          = (group_len + slice - 1) / slice;
+            for (unsigned i = 0; i < num_tasks; ++i) {
+                tasks[i] = (decode_task_t){
+                        .devs       = &devs[first + i * slice],
+                        .num_devs   = MIN(slice, group_len - i * slice),
+                        .pulse_data = pulse_data,
+                        .run_fn     = run_fn,
+                        .shed       = shed_group,
+                        .scratch    = demod_scratch(&demod->pool_scratch[i]),
+                };
+            }
+            worker_pool_run(pool, num_tasks, run_demods_task, tasks);
+
+            for (unsigned i = 0; i < num_tasks; ++i) {
+                p_events += tasks[i].events;
+                // the outputs free the events, the elements go back to the cache of their task
+                data_cache_t *prev_cache = decode_scratch_use(tasks[i].scratch);
+                replay_outputs(&tasks[i].outputs);
+                data_cache_use(prev_cache);
+            }
+        }
+        first = end;
+    }
+
+    return p_events;
+}
+
+int run_demods_pinned(struct dm_state *demod, pulse_data_t *pulse_data, uint64_t key, int fsk, int *tried)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    if (dispatch->stale)
+        r_update_dispatch(demod);
+    *tried = 0;
+    r_device *r_dev = decode_pin_begin(demod->decode_pin, key, dispatch->generation);
+    // the key has the modulation class, a pinned decoder only misses it on a collision
+    if (!r_dev || (r_dev->modulation >= FSK_DEMOD_MIN_VAL) != fsk || stream_reported(r_dev, pulse_data))
+        return 0;
+
+    *tried = 1;
+    slice_cache_t slice_cache = {0};
+    decode_scratch_t *scratch = demod_scratch(&demod->scratch);
+    data_cache_t *prev_cache  = decode_scratch_use(scratch);
+    r_dev->slice_cache = &slice_cache;
+    r_dev->scratch     = scratch;
+    int events = run_timed(r_dev, pulse_data, fsk ? run_fsk_device : run_ook_device);
+    r_dev->slice_cache = NULL;
+    r_dev->scratch     = NULL;
+    slice_cache_clear(&slice_cache);
+    data_cache_use(prev_cache);
+    return events;
+}
+
+int run_ook_demods_pool(worker_pool_t *pool, struct dm_state *demod, pulse_data_t *pulse_data)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    if (dispatch->stale)
+        r_update_dispatch(demod);
+    return run_demods_pool(pool, demod, dispatch->devs, dispatch->priority, dispatch->num_ook, pulse_data, run_ook_device);
+}
+
+int run_fsk_demods_pool(worker_pool_t *pool, struct dm_state *demod, pulse_data_t *fsk_pulse_data)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    if (dispatch->stale)
+        r_update_dispatch(demod);
+    unsigned num_ook = dispatch->num_ook;
+    return run_demods_pool(pool, demod, dispatch->devs + num_ook, dispatch->priority + num_ook, dispatch->len - num_ook, fsk_pulse_data, run_fsk_device);
+}
+
+int run_demods_reference(struct dm_state *demod, pulse_data_t *pulse_data, int fsk,
+        void (*event_fn)(void *ctx, r_device *r_dev, data_t *data), void *ctx)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    if (dispatch->stale)
+        r_update_dispatch(demod);
+    unsigned i   = fsk ? dispatch->num_ook : 0;
+    unsigned end = fsk ? dispatch->len : dispatch->num_ook;
+    int (*run_fn)(r_device *, pulse_data_t *) = fsk ? run_fsk_device : run_ook_device;
+
+    decode_task_t task = {.pulse_data = pulse_data, .run_fn = run_fn, .scratch = demod_scratch(&demod->scratch)};
+    data_cache_t *prev_cache = decode_scratch_use(task.scratch);
+    // without a fingerprint the prefilter passes every decoder
+    uint64_t pulse_bins    = pulse_data->pulse_bins;
+    uint64_t gap_bins      = pulse_data->gap_bins;
+    pulse_data->pulse_bins = 0;
+    pulse_data->gap_bins   = 0;
+    int p_events = 0;
+    int stream_events = 0; // decoders which already reported this package count as events
+
+    while (i < end && !p_events && !stream_events) {
+        unsigned group_priority = dispatch->priority[i];
+        for (; i < end && dispatch->priority[i] == group_priority; ++i) {
+            r_device *r_dev = dispatch->devs[i];
+            if (stream_reported(r_dev, pulse_data)) {
+                stream_events += 1;
+                continue;
+            }
+            decoder_stats_t stats = r_dev->stats;
+            cpu_stat_t cpu_slice  = r_dev->cpu_slice;
+            cpu_stat_t cpu_decode = r_dev->cpu_decode;
+            r_dev->defer_ctx = &task;
+            r_dev->scratch   = task.scratch;
+            p_events += run_fn(r_dev, pulse_data);
+            r_dev->defer_ctx  = NULL;
+            r_dev->scratch    = NULL;
+            r_dev->stats      = stats;
+            r_dev->cpu_slice  = cpu_slice;
+            r_dev->cpu_decode = cpu_decode;
+        }
+    }
+
+    pulse_data->pulse_bins = pulse_bins;
+    pulse_data->gap_bins   = gap_bins;
+    for (void **iter = task.outputs.elems; iter && *iter; ++iter) {
+        decode_output_t *output = *iter;
+        if (output->level < 0)
+            event_fn(ctx, output->r_dev, output->data);
+        data_free(output->data);
+    }
+    list_free_elems(&task.outputs, free);
+    data_cache_use(prev_cache);
+    return p_events;
+}
+
+// score of a successful package, the scores are halved every ADAPTIVE_DECAY_PACKAGES packages
+#define ADAPTIVE_HIT 256
+#define ADAPTIVE_DECAY_PACKAGES 64
+
+/// Order the OOK decoders first, then by priority, then by recent hits, then by list position.
+static int adaptive_cmp(void const *a, void const *b)
+{
+    r_device const *x = *(r_device *const *)a;
+    r_device const *y = *(r_device *const *)b;
+    int x_fsk = x->modulation >= FSK_DEMOD_MIN_VAL;
+    int y_fsk = y->modulation >= FSK_DEMOD_MIN_VAL;
+    if (x_fsk != y_fsk)
+        return x_fsk - y_fsk;
+    if (x->priority != y->priority)
+        return x->priority < y->priority ? -1 : 1;
+    if (x->hit_score != y->hit_score)
+        return x->hit_score > y->hit_score ? -1 : 1;
+    return x->list_index < y->list_index ? -1 : x->list_index > y->list_index;
+}
+
+/// Rebuild the adaptive order if the decoders changed, decay the scores and reorder periodically.
+static void adaptive_update(r_cfg_t *cfg)
+{
+    list_t *r_devs = &cfg->demod->r_devs;
+    list_t *order  = &cfg->adaptive_devs;
+    int rebuild    = !order->len;
+
+    if (!rebuild && ++cfg->adaptive_packages < ADAPTIVE_DECAY_PACKAGES)
+        return;
+    cfg->adaptive_packages = 0;
+
+    list_clear(order, NULL);
+    list_ensure_size(order, r_devs->len);
+    unsigned list_index = 0;
+    cfg->adaptive_num_ook = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        r_dev->list_index = list_index++;
+        if (!rebuild)
+            r_dev->hit_score /= 2;
+        if (r_dev->modulation < FSK_DEMOD_MIN_VAL)
+            cfg->adaptive_num_ook++;
+        list_push(order, r_dev);
+    }
+    qsort(order->elems, order->len, sizeof(*order->elems), adaptive_cmp);
+}
+
+/// Sort the queued outputs back to the decoder list order, stable for the outputs of one decoder.
+static void sort_outputs(list_t *outputs)
+{
+    for (size_t i = 1; i < outputs->len; ++i) {
+        void *elem = outputs->elems[i];
+        unsigned list_index = ((decode_output_t *)elem)->r_dev->list_index;
+        size_t j = i;
+        for (; j > 0 && ((decode_output_t *)outputs->elems[j - 1])->r_dev->list_index > list_index; --j)
+            outputs->elems[j] = outputs->elems[j - 1];
+        outputs->elems[j] = elem;
+    }
+}
+
+/// Run the decoders of each priority by recent hits, the outputs keep the order of the decoder list.
+static int run_demods_adaptive(r_cfg_t *cfg, int fsk, pulse_data_t *pulse_data, int (*run_fn)(r_device *, pulse_data_t *))
+{
+    adaptive_update(cfg);
+
+    list_t *order = &cfg->adaptive_devs;
+    int exclusive = cfg->adaptive_order > 1;
+    decode_task_t task = {.pulse_data = pulse_data, .run_fn = run_fn, .scratch = demod_scratch(&cfg->demod->scratch)};
+    data_cache_t *prev_cache = decode_scratch_use(task.scratch);
+    int p_events = 0;
+    int stream_events = 0; // decoders which already reported this package count as events
+
+    // the order of each modulation class is sorted by priority, stop if an event is produced
+    void **iter = order->elems + (fsk ? cfg->adaptive_num_ook : 0);
+    void **end  = fsk ? order->elems + order->len : order->elems + cfg->adaptive_num_ook;
+    while (iter < end && !p_events && !stream_events) {
+        unsigned priority = ((r_device *)*iter)->priority;
+        int stop = 0; // an exclusive decoder decoded the package
+        for (; iter < end && ((r_device *)*iter)->priority == priority; ++iter) {
+            r_device *r_dev = *iter;
+            if (stop)
+                continue;
+            if (stream_reported(r_dev, pulse_data)) {
+                stream_events += 1;
+                continue;
+            }
+            if (shed_device(cfg->demod->load_shed, r_dev))
+                continue;
+
+            r_dev->defer_ctx   = &task;
+            r_dev->slice_cache = &task.slice_cache;
+            r_dev->scratch     = task.scratch;
+            int events = run_timed(r_dev, pulse_data, run_fn);
+            r_dev->defer_ctx   = NULL;
+            r_dev->slice_cache = NULL;
+            r_dev->scratch     = NULL;
+
+            if (events > 0) {
+                r_dev->hit_score += ADAPTIVE_HIT;
+                p_events += events;
+                stop = exclusive && r_dev->exclusive;
+            }
+        }
+        sort_outputs(&task.outputs);
+        replay_outputs(&task.outputs);
+    }
+
+    slice_cache_clear(&task.slice_cache);
+    data_cache_use(prev_cache);
+    return p_events;
+}
+
+int run_ook_demods_adaptive(r_cfg_t *cfg, pulse_data_t *pulse_data)
+{
+    return run_demods_adaptive(cfg, 0, pulse_data, run_ook_device);
+}
+
+int run_fsk_demods_adaptive(r_cfg_t *cfg, pulse_data_t *fsk_pulse_data)
+{
+    return run_demods_adaptive(cfg, 1, fsk_pulse_data, run_fsk_device);
+}
+
+int run_ook_demods_partial(struct dm_state *demod, pulse_data_t *pulse_data)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    if (dispatch->stale)
+        r_update_dispatch(demod);
+    return run_demods_partial(demod_scratch(&demod->stream_scratch), dispatch->devs, dispatch->num_ook, pulse_data, run_ook_device);
+}
+
+int run_fsk_demods_partial(struct dm_state *demod, pulse_data_t *fsk_pulse_data)
+{
+    decoder_dispatch_t *dispatch = &demod->dispatch;
+    if (dispatch->stale)
+        r_update_dispatch(demod);
+    unsigned num_ook = dispatch->num_ook;
+    return run_demods_partial(demod_scratch(&demod->stream_scratch), dispatch->devs + num_ook, dispatch->len - num_ook, fsk_pulse_data, run_fsk_device);
+}
+
+unsigned stream_pulses_min(list_t *r_devs)
+{
+    unsigned stream_pulses = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->stream_pulses && (!stream_pulses || r_dev->stream_pulses < stream_pulses))
+            stream_pulses = r_dev->stream_pulses;
+    }
+    return stream_pulses;
+}
+
+/* handlers */
+
+/// Print to all outputs with a log level of at least @p level (0 for all), frees data afterwards.
+static void print_output_data(r_cfg_t *cfg, data_t *data, int level)
+{
+    // the outputs and the rendering belong to the first input
+    if (cfg->parent)
+        cfg = cfg->parent;
+
+    if (!cfg->output_render) {
+        cfg->output_render = calloc(1, sizeof(*cfg->output_render));
+        if (!cfg->output_render) {
+            WARN_CALLOC("print_output_data()"); // NOTE: the outputs format on their own on alloc failure.
+        }
+    }
+    if (cfg->output_render)
+        data_render_start(cfg->output_render, data);
+
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (!level || (output && output->log_level >= level)) {
+            uint64_t trace_start = trace_begin();
+            uint64_t start = cpu_stats_start();
+            data_output_print_shared(output, data, cfg->output_render);
+            if (output)
+                cpu_stats_end(&output->cpu_stat, start);
+            trace_end(TRACE_OUTPUT, "output", (uint32_t)i, trace_start);
+        }
+    }
+    if (cfg->output_render)
+        data_render_start(cfg->output_render, NULL);
+    data_free(data);
+}
+
+/// An output data collected by r_cfg.output_capture.
+typedef struct output_record {
+    data_t *data;
+    int level;
+} output_record_t;
+
+/// Outputs are owned by the event loop, other threads queue the data for `flush_output_queue()`.
+static void output_data(r_cfg_t *cfg, data_t *data, int level)
+{
+    if (cfg->output_capture) {
+        output_record_t *record = malloc(sizeof(*record));
+        if (!record) {
+            WARN_MALLOC("output_data()");
+            data_free(data);
+            return; // NOTE: drops the data on alloc failure.
+        }
+        record->data  = data;
+        record->level = level;
+        list_push(cfg->output_capture, record);
+        return;
+    }
+    if (cfg->dsp_thread && !dsp_thread_is_loop(cfg->dsp_thread)) {
+        dsp_thread_post_event(cfg->dsp_thread, data, level);
+        return;
+    }
+    print_output_data(cfg, data, level);
+}
+
+void flush_output_queue(r_cfg_t *cfg)
+{
+    flush_log_ring(cfg);
+
+    if (!cfg->dsp_thread)
         return;
+
+    data_t *data;
+    int level;
+    while (!dsp_thread_pop_event(cfg->dsp_thread, &data, &level)) {
+        print_output_data(cfg, data, level);
     }
+}
+
+void flush_output_capture(r_cfg_t *cfg, list_t *capture)
+{
+    for (void **iter = capture->elems; iter && *iter; ++iter) {
+        output_record_t *record = *iter;
+        print_output_data(cfg, record->data, record->level);
+    }
+    list_free_elems(capture, free);
+}
+
+void forward_output_capture(list_t *capture, void (*forward_fn)(void *ctx, data_t *data, int level), void *ctx)
+{
+    for (void **iter = capture->elems; iter && *iter; ++iter) {
+        output_record_t *record = *iter;
+        forward_fn(ctx, record->data, record->level);
+    }
+    list_clear(capture, free);
+}
+
+void output_remote_data(void *ctx, data_t *data, int level)
+{
+    output_data(ctx, data, level);
+}
+
+static void output_log(r_cfg_t *cfg, log_level_t level, char const *src, char const *msg, char const *time_str)
+{
     /* clang-format off */
     data_t *data = data_make(
             "src",     "",     DATA_STRING, src,
@@ -621,21 +2173,71 @@ static void log_handler(log_level_t level, char const *src, char const *msg, voi
     /* clang-format on */
 
     // prepend "time" if requested
-    if (cfg->report_time != REPORT_TIME_OFF) {
-        char time_str[LOCAL_TIME_BUFLEN];
-        time_pos_str(cfg, 0, time_str);
+    if (time_str) {
         data = data_prepend(data,
                 "time", "", DATA_STRING, time_str,
                 NULL);
     }
 
-    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_t *output = cfg->output_handler.elems[i];
-        if (output && output->log_level >= (int)level) {
-            data_output_print(output, data);
-        }
+    output_data(cfg, data, (int)level);
+}
+
+void flush_log_ring(r_cfg_t *cfg)
+{
+    if (!cfg->log_ring)
+        return;
+
+    log_rec_t rec;
+    while (!log_ring_pop(cfg->log_ring, &rec)) {
+        output_log(cfg, (log_level_t)rec.level, rec.src, rec.msg, rec.time[0] ? rec.time : NULL);
+    }
+
+    unsigned dropped = log_ring_dropped(cfg->log_ring);
+    if (dropped != cfg->log_ring_dropped) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%u log messages dropped, the log queue was full", dropped - cfg->log_ring_dropped);
+        cfg->log_ring_dropped = dropped;
+        output_log(cfg, LOG_WARNING, "Logger", msg, NULL);
     }
-    data_free(data);
+}
+
+static void log_handler(log_level_t level, char const *src, char const *msg, void *userdata)
+{
+    r_cfg_t *cfg = userdata;
+
+    if (cfg->verbosity < (int)level) {
+        return;
+    }
+
+    unsigned suppressed;
+    if (!log_rate_allow(src, &suppressed)) {
+        return;
+    }
+
+    char time_buf[LOCAL_TIME_BUFLEN];
+    char const *time_str = NULL;
+    if (cfg->report_time != REPORT_TIME_OFF) {
+        time_str = time_pos_str(cfg, 0, time_buf);
+    }
+
+    char notice[64];
+    if (suppressed) {
+        snprintf(notice, sizeof(notice), "%u messages suppressed by the rate limit", suppressed);
+    }
+
+    // the event loop outputs what other threads log, a full queue drops the message
+    if (cfg->log_ring && !cfg->output_capture && cfg->dsp_thread && !dsp_thread_is_loop(cfg->dsp_thread)) {
+        if (suppressed)
+            log_ring_push(cfg->log_ring, LOG_NOTICE, src, time_str, notice);
+        log_ring_push(cfg->log_ring, (int)level, src, time_str, msg);
+        return;
+    }
+
+    // keep the order with the messages queued before
+    flush_log_ring(cfg);
+    if (suppressed)
+        output_log(cfg, LOG_NOTICE, src, notice, time_str);
+    output_log(cfg, level, src, msg, time_str);
 }
 
 void r_redirect_logging(r_cfg_t *cfg)
@@ -643,6 +2245,30 @@ void r_redirect_logging(r_cfg_t *cfg)
     r_logger_set_log_handler(log_handler, cfg);
 }
 
+/** Convert a double field to the unit of a conversion, uses the prepared @p key_id if given. */
+static void convert_unit(data_t *d, unit_conversion_t const *conv, unsigned key_id)
+{
+    d->value.v_dbl = conv->convert(d->value.v_dbl);
+    if (key_id)
+        data_use_key(d, key_id);
+    else
+        data_replace_key(d, str_replace(d->key, conv->key_from, conv->key_to));
+
+    if (!d->format)
+        return;
+    if (conv->unit_last) {
+        char *pos = strrchr(d->format, *conv->unit_from);
+        if (pos)
+            *pos = *conv->unit_to;
+    }
+    else if (strlen(conv->unit_to) <= strlen(conv->unit_from)) {
+        str_replace_inplace(d->format, conv->unit_from, conv->unit_to);
+    }
+    else {
+        data_replace_format(d, str_replace(d->format, conv->unit_from, conv->unit_to));
+    }
+}
+
 /** Pass the data structure to all output handlers. Frees data afterwards. */
 void event_occurred_handler(r_cfg_t *cfg, data_t *data)
 {
@@ -655,11 +2281,28 @@ void event_occurred_handler(r_cfg_t *cfg, data_t *data)
                 NULL);
     }
 
-    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_t *output = cfg->output_handler.elems[i];
-        data_output_print(output, data);
-    }
-    data_free(data);
+    output_data(cfg, data, 0);
+}
+
+/// The OOK pulses of the package being decoded, a copy if the package was queued.
+static pulse_data_t const *package_pulses(r_cfg_t *cfg)
+{
+    return cfg->package ? &cfg->package->pulses : &cfg->demod_chan->pulse_data;
+}
+
+/// The FSK pulses of the package being decoded, a copy if the package was queued.
+static pulse_data_t const *package_fsk_pulses(r_cfg_t *cfg)
+{
+    return cfg->package ? &cfg->package->fsk_pulses : &cfg->demod_chan->fsk_pulse_data;
+}
+
+/// Check if the package decoded is in the output range, e.g. not in the overlap of a chunk of a file.
+static int package_in_output_range(r_cfg_t *cfg)
+{
+    if (cfg->output_from >= cfg->output_to)
+        return 1; // no range
+    double pos = cfg->demod_chan->sample_file_pos - (double)package_pulses(cfg)->start_ago / demod_samp_rate(cfg);
+    return pos >= cfg->output_from && pos < cfg->output_to;
 }
 
 /** Pass the data structure to all output handlers. Frees data afterwards. */
@@ -667,22 +2310,124 @@ void log_device_handler(r_device *r_dev, int level, data_t *data)
 {
     r_cfg_t *cfg = r_dev->output_ctx;
 
+    if (!package_in_output_range(cfg)) {
+        data_free(data);
+        return;
+    }
+
+    if (r_dev->defer_ctx) {
+        defer_output(r_dev, level, data);
+        return;
+    }
+
+    if (cfg->input_name) {
+        data = data_str(data, "input", "Input", NULL, cfg->input_name);
+    }
+
     // prepend "time" if requested
     if (cfg->report_time != REPORT_TIME_OFF) {
         char time_str[LOCAL_TIME_BUFLEN];
-        time_pos_str(cfg, cfg->demod->pulse_data.start_ago, time_str);
+        time_pos_str(cfg, package_pulses(cfg)->start_ago, time_str);
         data = data_prepend(data,
                 "time", "", DATA_STRING, time_str,
                 NULL);
     }
 
-    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_t *output = cfg->output_handler.elems[i];
-        if (output && output->log_level >= level) {
-            data_output_print(output, data);
+    output_data(cfg, data, level);
+}
+
+/// Count the latency from the end of the last pulse on air to the output, live inputs only.
+static void update_latency_stats(r_cfg_t *cfg)
+{
+    // an OOK package has pulses, otherwise this is an FSK package which ends with the carrier
+    pulse_data_t const *ook_pulses = package_pulses(cfg);
+    pulse_data_t const *pulses = ook_pulses->num_pulses ? ook_pulses : package_fsk_pulses(cfg);
+    if (!cfg->buf_time_us || !pulses->sample_rate)
+        return;
+
+    uint64_t end_ago = pulses->end_ago;
+    if (pulses == ook_pulses)
+        end_ago += pulses->gap[pulses->num_pulses - 1];
+
+    struct timeval now;
+    get_time_now(&now);
+    int64_t now_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    int64_t end_us = cfg->buf_time_us - (int64_t)(end_ago * 1000000 / pulses->sample_rate);
+    int64_t latency_ms = (now_us - end_us) / 1000;
+    cfg->latency_hist[MIN(MAX(latency_ms, 0), LATENCY_HIST_MS)] += 1;
+    metrics_hist_add(&cfg->hist_latency, MAX(latency_ms, 0) / 1000.0);
+}
+
+static uint32_t data_content_hash(uint32_t hash, data_t const *data);
+
+static uint32_t data_value_hash(uint32_t hash, data_type_t type, data_value_t value)
+{
+    hash = fnv1a(hash, &type, sizeof(type));
+    if (type == DATA_INT) {
+        hash = fnv1a(hash, &value.v_int, sizeof(value.v_int));
+    }
+    else if (type == DATA_DOUBLE) {
+        hash = fnv1a(hash, &value.v_dbl, sizeof(value.v_dbl));
+    }
+    else if (type == DATA_STRING) {
+        hash = fnv1a(hash, value.v_ptr, strlen(value.v_ptr));
+    }
+    else if (type == DATA_DATA) {
+        hash = data_content_hash(hash, value.v_ptr);
+    }
+    else if (type == DATA_ARRAY) {
+        data_array_t const *array = value.v_ptr;
+        hash = fnv1a(hash, &array->num_values, sizeof(array->num_values));
+        for (int i = 0; i < array->num_values; ++i) {
+            data_value_t v = {0};
+            if (array->type == DATA_INT)
+                v.v_int = ((int const *)array->values)[i];
+            else if (array->type == DATA_DOUBLE)
+                v.v_dbl = ((double const *)array->values)[i];
+            else
+                v.v_ptr = ((void *const *)array->values)[i]; // boxed
+            hash = data_value_hash(hash, array->type, v);
         }
     }
-    data_free(data);
+    return hash;
+}
+
+/// Get a hash of all keys and values of an event, the same for repeats of a message.
+static uint32_t data_content_hash(uint32_t hash, data_t const *data)
+{
+    for (; data; data = data->next) {
+        hash = fnv1a(hash, data->key, strlen(data->key) + 1);
+        hash = data_value_hash(hash, data->type, data->value);
+    }
+    return hash;
+}
+
+/// Get a hash of the decoder and the content of an event, never 0.
+static uint32_t data_event_hash(r_device *r_dev, data_t const *data)
+{
+    uint32_t hash = FNV1A_INIT;
+    hash = fnv1a(hash, &r_dev->protocol_num, sizeof(r_dev->protocol_num));
+    hash = data_content_hash(hash, data);
+    return hash ? hash : 1;
+}
+
+/// Check if an event repeats one output within the dedup window, the event is remembered otherwise.
+static int data_is_repeat(r_cfg_t *cfg, r_device *r_dev, data_t const *data)
+{
+    uint32_t hash = data_event_hash(r_dev, data); // 0 is an unused entry
+
+    double now    = cfg->samp_rate ? (double)cfg->input_pos / cfg->samp_rate : 0.0;
+    double window = cfg->dedup_ms / 1000.0;
+    for (unsigned i = 0; i < DEDUP_EVENTS; ++i) {
+        // the position restarts with each input file, a later entry is stale
+        if (cfg->dedup_hash[i] == hash && now >= cfg->dedup_time[i] && now - cfg->dedup_time[i] < window)
+            return 1;
+    }
+
+    cfg->dedup_hash[cfg->dedup_next] = hash;
+    cfg->dedup_time[cfg->dedup_next] = now;
+    cfg->dedup_next = (cfg->dedup_next + 1) % DEDUP_EVENTS;
+    return 0;
 }
 
 /** Pass the data structure to all output handlers. Frees data afterwards. */
@@ -690,6 +2435,33 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
 {
     r_cfg_t *cfg = r_dev->output_ctx;
 
+    if (!package_in_output_range(cfg)) {
+        data_free(data);
+        return;
+    }
+
+    if (r_dev->defer_ctx) {
+        defer_output(r_dev, -1, data);
+        return;
+    }
+    verify_event(cfg->verify, r_dev, data);
+
+    // note the decoder to pin, the events of other sensors are dropped before the conversions and outputs
+    decode_pin_t *pin = cfg->demod->decode_pin;
+    if (pin && !decode_pin_event(pin, r_dev, data) && cfg->pin_mode > 1) {
+        decode_pin_drop(pin);
+        data_free(data);
+        return;
+    }
+
+    // drop the repeats of a message before the conversions and outputs, the copies to merge are held by the same content
+    uint32_t merge_hash = cfg->event_merge ? data_event_hash(r_dev, data) : 0;
+    if (!cfg->event_merge && cfg->dedup_ms && data_is_repeat(cfg, r_dev, data)) {
+        stats_add(&r_dev->stats.dups, 1);
+        data_free(data);
+        return;
+    }
+
 #ifndef NDEBUG
     // check for undeclared csv fields
     for (data_t *d = data; d; d = d->next) {
@@ -706,133 +2478,49 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
     }
 #endif
 
-    if (cfg->conversion_mode == CONVERT_SI) {
+    pulse_data_t const *ook_pulses = package_pulses(cfg);
+    pulse_data_t const *fsk_pulses = package_fsk_pulses(cfg);
+    pulse_data_t const *level_data = fsk_pulses->fsk_f2_est ? fsk_pulses : ook_pulses;
+    if (level_data->num_pulses) { // not for codes from -y
+        metrics_hist_add(&cfg->hist_rssi, level_data->rssi_db);
+        metrics_hist_add(&cfg->hist_snr, level_data->snr_db);
+    }
+
+    if (cfg->hop_sched && cfg->samp_rate) {
+        hop_sched_event(cfg->hop_sched, (unsigned)cfg->frequency_index, data_sensor_key(data), (double)cfg->input_pos / cfg->samp_rate);
+    }
+    if (cfg->duty_sched) {
+        // the wall time of the package, the duty cycle sleeps in wall time
+        struct dm_state *demod = cfg->demod_chan ? cfg->demod_chan : cfg->demod;
+        duty_sched_event(cfg->duty_sched, data_sensor_key(data), demod->now.tv_sec + demod->now.tv_usec / 1e6);
+    }
+
+    // the model labels the annotation of the package in the SigMF dumpers
+    if (cfg->demod_chan && cfg->demod_chan->sigmf.len) {
         for (data_t *d = data; d; d = d->next) {
-            // Convert double type fields ending in _F to _C
-            if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_F")) {
-                d->value.v_dbl = fahrenheit2celsius(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_F", "_C");
-                free(d->key);
-                d->key = new_label;
-                char *pos;
-                if (d->format && (pos = strrchr(d->format, 'F'))) {
-                    *pos = 'C';
-                }
-            }
-            // Convert double type fields ending in _mi_h to _km_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mi_h")) {
-                d->value.v_dbl = mph2kmph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mi_h", "_km_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mi/h", "km/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _in to _mm
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_in")) {
-                d->value.v_dbl = inch2mm(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_in", "_mm");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "in", "mm");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _in_h to _mm_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_in_h")) {
-                d->value.v_dbl = inch2mm(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_in_h", "_mm_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "in/h", "mm/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _inHg to _hPa
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_inHg")) {
-                d->value.v_dbl = inhg2hpa(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_inHg", "_hPa");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "inHg", "hPa");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _PSI to _kPa
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_PSI")) {
-                d->value.v_dbl = psi2kpa(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_PSI", "_kPa");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "PSI", "kPa");
-                free(d->format);
-                d->format = new_format_label;
+            if (d->type == DATA_STRING && !strcmp(d->key, "model")) {
+                for (void **iter = cfg->demod_chan->sigmf.elems; iter && *iter; ++iter)
+                    sigmf_writer_label(*iter, d->value.v_ptr);
+                break;
             }
         }
     }
-    if (cfg->conversion_mode == CONVERT_CUSTOMARY) {
+
+    if (cfg->conversion_mode == CONVERT_SI || cfg->conversion_mode == CONVERT_CUSTOMARY) {
+        int mode = cfg->conversion_mode - CONVERT_SI;
         for (data_t *d = data; d; d = d->next) {
-            // Convert double type fields ending in _C to _F
-            if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_C")) {
-                d->value.v_dbl = celsius2fahrenheit(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_C", "_F");
-                free(d->key);
-                d->key = new_label;
-                char *pos;
-                if (d->format && (pos = strrchr(d->format, 'C'))) {
-                    *pos = 'F';
-                }
-            }
-            // Convert double type fields ending in _km_h to _mi_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_km_h")) {
-                d->value.v_dbl = kmph2mph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_km_h", "_mi_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "km/h", "mi/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _mm to _in
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mm")) {
-                d->value.v_dbl = mm2inch(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mm", "_in");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mm", "in");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _mm_h to _in_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mm_h")) {
-                d->value.v_dbl = mm2inch(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mm_h", "_in_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mm/h", "in/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _hPa to _inHg
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_hPa")) {
-                d->value.v_dbl = hpa2inhg(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_hPa", "_inHg");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "hPa", "inHg");
-                free(d->format);
-                d->format = new_format_label;
+            if (d->type != DATA_DOUBLE)
+                continue;
+            // registered fields have a prepared conversion, other keys need a lookup
+            if (d->key_id && d->key_id < cfg->key_conversions_len && cfg->key_conversions[d->key_id].prepared) {
+                key_conversion_t const *kc = &cfg->key_conversions[d->key_id];
+                if (kc->unit[mode])
+                    convert_unit(d, &unit_conversions[kc->unit[mode] - 1], kc->key_id[mode]);
             }
-            // Convert double type fields ending in _kPa to _PSI
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_kPa")) {
-                d->value.v_dbl = kpa2psi(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_kPa", "_PSI");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "kPa", "PSI");
-                free(d->format);
-                d->format = new_format_label;
+            else {
+                int unit = find_unit_conversion(cfg->conversion_mode, d->key);
+                if (unit >= 0)
+                    convert_unit(d, &unit_conversions[unit], 0);
             }
         }
     }
@@ -851,26 +2539,44 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
                 NULL);
     }
 
-    if (cfg->report_meta && cfg->demod->fsk_pulse_data.fsk_f2_est) {
+    if (cfg->report_meta && fsk_pulses->fsk_f2_est) {
         data = data_str(data, "mod",   "Modulation",  NULL,         "FSK");
-        data = data_dbl(data, "freq1", "Freq1",       "%.1f MHz",   cfg->demod->fsk_pulse_data.freq1_hz / 1000000.0);
-        data = data_dbl(data, "freq2", "Freq2",       "%.1f MHz",   cfg->demod->fsk_pulse_data.freq2_hz / 1000000.0);
-        data = data_dbl(data, "rssi",  "RSSI",        "%.1f dB",    cfg->demod->fsk_pulse_data.rssi_db);
-        data = data_dbl(data, "snr",   "SNR",         "%.1f dB",    cfg->demod->fsk_pulse_data.snr_db);
-        data = data_dbl(data, "noise", "Noise",       "%.1f dB",    cfg->demod->fsk_pulse_data.noise_db);
+        data = data_dbl(data, "freq1", "Freq1",       "%.1f MHz",   fsk_pulses->freq1_hz / 1000000.0);
+        data = data_dbl(data, "freq2", "Freq2",       "%.1f MHz",   fsk_pulses->freq2_hz / 1000000.0);
+        data = data_dbl(data, "rssi",  "RSSI",        "%.1f dB",    fsk_pulses->rssi_db);
+        data = data_dbl(data, "snr",   "SNR",         "%.1f dB",    fsk_pulses->snr_db);
+        data = data_dbl(data, "noise", "Noise",       "%.1f dB",    fsk_pulses->noise_db);
     }
     else if (cfg->report_meta) {
         data = data_str(data, "mod",   "Modulation",  NULL,         "ASK");
-        data = data_dbl(data, "freq",  "Freq",        "%.1f MHz",   cfg->demod->pulse_data.freq1_hz / 1000000.0);
-        data = data_dbl(data, "rssi",  "RSSI",        "%.1f dB",    cfg->demod->pulse_data.rssi_db);
-        data = data_dbl(data, "snr",   "SNR",         "%.1f dB",    cfg->demod->pulse_data.snr_db);
-        data = data_dbl(data, "noise", "Noise",       "%.1f dB",    cfg->demod->pulse_data.noise_db);
+        data = data_dbl(data, "freq",  "Freq",        "%.1f MHz",   ook_pulses->freq1_hz / 1000000.0);
+        data = data_dbl(data, "rssi",  "RSSI",        "%.1f dB",    ook_pulses->rssi_db);
+        data = data_dbl(data, "snr",   "SNR",         "%.1f dB",    ook_pulses->snr_db);
+        data = data_dbl(data, "noise", "Noise",       "%.1f dB",    ook_pulses->noise_db);
+    }
+    else if (cfg->demod_chan->frequency) {
+        // always tag the channel when channelizing
+        data = data_dbl(data, "freq",  "Freq",        "%.1f MHz",   cfg->demod_chan->frequency / 1000000.0);
+    }
+    // tag the RX channel, "channel" is taken by the sensors
+    if (cfg->mimo && cfg->channels.len) {
+        data = data_int(data, "rx_channel", "RX channel", NULL, (int)cfg->demod_chan->rx_channel);
+    }
+
+    // reference the IQ snippet of the package
+    if (level_data->iq_snippet) {
+        data = data_int(data, "iq", "IQ snippet", NULL, (int)level_data->iq_snippet);
+    }
+
+    // tag the input when there are several
+    if (cfg->input_name) {
+        data = data_str(data, "input", "Input", NULL, cfg->input_name);
     }
 
     // prepend "time" if requested
     if (cfg->report_time != REPORT_TIME_OFF) {
         char time_str[LOCAL_TIME_BUFLEN];
-        time_pos_str(cfg, cfg->demod->pulse_data.start_ago, time_str);
+        time_pos_str(cfg, package_pulses(cfg)->start_ago, time_str);
         data = data_prepend(data,
                 "time", "", DATA_STRING, time_str,
                 NULL);
@@ -882,69 +2588,513 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
         data            = data_tag_apply(tag, data, cfg->in_filename);
     }
 
-    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_t *output = cfg->output_handler.elems[i];
-        data_output_print(output, data);
+    if (cfg->event_merge) {
+        double now = cfg->demod->now.tv_sec + cfg->demod->now.tv_usec * 1e-6;
+        if (event_merge_add(cfg->event_merge, merge_hash, data, cfg->input_name, level_data->rssi_db, now))
+            stats_add(&r_dev->stats.dups, 1);
+    }
+    else {
+        output_data(cfg, data, 0);
+    }
+
+    update_latency_stats(cfg);
+}
+
+static void output_merged_event(void *ctx, data_t *data)
+{
+    output_data(ctx, data, 0);
+}
+
+void expire_merged_events(r_cfg_t *cfg, int all)
+{
+    if (!cfg->event_merge)
+        return;
+    double now = -1.0;
+    if (!all) {
+        struct timeval tv;
+        get_time_now(&tv);
+        now = tv.tv_sec + tv.tv_usec * 1e-6;
+    }
+    event_merge_expire(cfg->event_merge, now, output_merged_event, cfg);
+}
+
+/// Cumulative CPU time of the processing stages, summed over all channels, and of the outputs.
+static data_t *create_cpu_report_data(r_cfg_t *cfg)
+{
+    cpu_stat_t stages[CPU_STAGE_COUNT] = {{0}};
+    unsigned n_chans = cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+    for (unsigned i = 0; i < n_chans; ++i) {
+        struct dm_state *chan = cfg->channels.len ? cfg->channels.elems[i] : cfg->demod;
+        for (int s = 0; s < CPU_STAGE_COUNT; ++s) {
+            stages[s].ns += chan->cpu_stages[s].ns;
+            stages[s].calls += chan->cpu_stages[s].calls;
+        }
+    }
+
+    data_t *stage_data[CPU_STAGE_COUNT];
+    for (int s = 0; s < CPU_STAGE_COUNT; ++s) {
+        stage_data[s] = data_make(
+                "stage",            "", DATA_STRING, cpu_stage_name(s),
+                "ns",               "", DATA_DOUBLE, (double)stages[s].ns,
+                "calls",            "", DATA_INT, stages[s].calls,
+                NULL);
+    }
+
+    list_t output_list = {0};
+    list_ensure_size(&output_list, cfg->output_handler.len);
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (!output)
+            continue;
+        list_push(&output_list, data_make(
+                "output",           "", DATA_INT, (int)i,
+                "ns",               "", DATA_DOUBLE, (double)output->cpu_stat.ns,
+                "calls",            "", DATA_INT, output->cpu_stat.calls,
+                NULL));
+    }
+
+    data_t *data = data_make(
+            "stages",           "", DATA_ARRAY, data_array(CPU_STAGE_COUNT, DATA_DATA, stage_data),
+            "outputs",          "", DATA_ARRAY, data_array(output_list.len, DATA_DATA, output_list.elems),
+            NULL);
+    list_free_elems(&output_list, NULL);
+    return data;
+}
+
+/// Latency percentile in ms of the report interval.
+static int latency_percentile(r_cfg_t *cfg, unsigned count, unsigned percent)
+{
+    unsigned rank = (count * percent + 99) / 100; // nearest rank
+    unsigned sum  = 0;
+    for (int i = 0; i < LATENCY_HIST_MS; ++i) {
+        sum += cfg->latency_hist[i];
+        if (sum >= rank)
+            return i;
+    }
+    return LATENCY_HIST_MS;
+}
+
+// level 0: do not report (don't call this), 1: report successful devices, 2: report active devices, 3: report all
+data_t *create_report_data(r_cfg_t *cfg, int level)
+{
+    list_t *r_devs = &cfg->demod->r_devs;
+    data_t *data;
+    list_t dev_data_list = {0};
+    list_ensure_size(&dev_data_list, r_devs->len);
+    uint64_t slice_lookups   = 0;
+    uint64_t slice_hits      = 0;
+    uint64_t memo_hits       = 0;
+    uint64_t prefilter_skips = 0;
+
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        decoder_stats_t s; // counts of the report interval
+        stats_read_since(&s, &r_dev->stats, &r_dev->stats_base, sizeof(s));
+        slice_lookups += s.slice_lookups;
+        slice_hits += s.slice_hits;
+        memo_hits += s.memo_hits;
+        prefilter_skips += s.prefilter_skips;
+        if (level <= 2 && s.events == 0)
+            continue;
+        if (level <= 1 && s.ok == 0)
+            continue;
+        if (level <= 0)
+            continue;
+
+        data = data_make(
+                "device",       "", DATA_INT, r_dev->protocol_num,
+                "name",         "", DATA_STRING, r_dev->name,
+                "events",       "", DATA_INT, (int)s.events,
+                "ok",           "", DATA_INT, (int)s.ok,
+                "messages",     "", DATA_INT, (int)s.messages,
+                NULL);
+
+        if (s.fails[-DECODE_FAIL_OTHER])
+            data = data_int(data, "fail_other",   "", NULL, (int)s.fails[-DECODE_FAIL_OTHER]);
+        if (s.fails[-DECODE_ABORT_LENGTH])
+            data = data_int(data, "abort_length", "", NULL, (int)s.fails[-DECODE_ABORT_LENGTH]);
+        if (s.fails[-DECODE_ABORT_EARLY])
+            data = data_int(data, "abort_early",  "", NULL, (int)s.fails[-DECODE_ABORT_EARLY]);
+        if (s.fails[-DECODE_FAIL_MIC])
+            data = data_int(data, "fail_mic",     "", NULL, (int)s.fails[-DECODE_FAIL_MIC]);
+        if (s.fails[-DECODE_FAIL_SANITY])
+            data = data_int(data, "fail_sanity",  "", NULL, (int)s.fails[-DECODE_FAIL_SANITY]);
+        if (s.dups)
+            data = data_int(data, "duplicates",   "", NULL, (int)s.dups);
+
+        if (s.slice_hits)
+            data = data_int(data, "slice_hits",   "", NULL, (int)s.slice_hits);
+        if (s.memo_hits)
+            data = data_int(data, "memo_hits",    "", NULL, (int)s.memo_hits);
+        if (s.prefilter_skips)
+            data = data_int(data, "prefiltered",  "", NULL, (int)s.prefilter_skips);
+        if (s.shed_skips)
+            data = data_int(data, "shed",         "", NULL, (int)s.shed_skips);
+
+        if (cpu_stats_enabled()) {
+            // the slicer time excludes the decoder time
+            data = data_dbl(data, "slicer_ns",    "", NULL, (double)(r_dev->cpu_slice.ns - r_dev->cpu_decode.ns));
+            data = data_int(data, "slicer_calls", "", NULL, r_dev->cpu_slice.calls);
+            data = data_dbl(data, "decode_ns",    "", NULL, (double)r_dev->cpu_decode.ns);
+            data = data_int(data, "decode_calls", "", NULL, r_dev->cpu_decode.calls);
+        }
+
+        list_push(&dev_data_list, data);
+    }
+
+    input_stats_t is; // counts of the report interval
+    stats_read_since(&is, &cfg->stats, &cfg->stats_base, sizeof(is));
+
+    data = data_make(
+            "count",            "", DATA_INT, (int)is.frames_ook,
+            "fsk",              "", DATA_INT, (int)is.frames_fsk,
+            "events",           "", DATA_INT, (int)is.frames_events,
+            NULL);
+    if (is.frames_shed)
+        data = data_int(data, "shed",  "", NULL, (int)is.frames_shed);
+    if (is.frames_quiet)
+        data = data_int(data, "quiet", "", NULL, (int)is.frames_quiet);
+
+    char since_str[LOCAL_TIME_BUFLEN];
+    format_time_str(since_str, "%Y-%m-%dT%H:%M:%S", cfg->report_time_tz, cfg->frames_since);
+
+    data = data_make(
+            "enabled",          "", DATA_INT, r_devs->len,
+            "since",            "", DATA_STRING, since_str,
+            "frames",           "", DATA_DATA, data,
+            "stats",            "", DATA_ARRAY, data_array(dev_data_list.len, DATA_DATA, dev_data_list.elems),
+            NULL);
+
+    data_t *input_data = NULL;
+    if (cfg->input_name) {
+        input_data = data_str(input_data, "name", "", NULL, cfg->input_name);
+    }
+    if (is.drops) {
+        input_data = data_int(input_data, "drops",           "", NULL, (int)is.drops);
+        input_data = data_dbl(input_data, "dropped_samples", "", NULL, (double)is.samples_dropped);
+    }
+    if (is.hops) {
+        input_data = data_int(input_data, "hops",             "", NULL, (int)is.hops);
+        input_data = data_int(input_data, "hops_deferred",    "", NULL, (int)is.hops_deferred);
+        input_data = data_dbl(input_data, "settle_ms",        "", NULL, cfg->settle_ms >= 0 ? (double)cfg->settle_ms : cfg->samp_rate ? 1000.0 * cfg->settle_est / cfg->samp_rate : 0.0);
+        input_data = data_dbl(input_data, "settle_discarded", "", NULL, (double)is.settle_discarded);
+    }
+    if (cfg->agc) {
+        soft_agc_stats_t agc_stats;
+        soft_agc_get_stats(cfg->agc, &agc_stats);
+        data_t *agc_data = data_make(
+                "gain_db",    "", DATA_DOUBLE, (double)agc_stats.gain_db,
+                "raised",     "", DATA_INT, (int)agc_stats.raised,
+                "lowered",    "", DATA_INT, (int)agc_stats.lowered,
+                "clip_ratio", "", DATA_DOUBLE, (double)agc_stats.clip_ratio,
+                "peak_dbfs",  "", DATA_DOUBLE, (double)agc_stats.peak_dbfs,
+                NULL);
+        input_data = data_dat(input_data, "agc", "", NULL, agc_data);
+    }
+    sdr_stats_t sdr_stats;
+    if (!sdr_get_stats(cfg->dev, &sdr_stats)) {
+        input_data = data_int(input_data, "connects",   "", NULL, sdr_stats.connects);
+        input_data = data_dbl(input_data, "bytes",      "", NULL, (double)sdr_stats.bytes);
+        input_data = data_dbl(input_data, "iq_bytes",   "", NULL, (double)sdr_stats.iq_bytes);
+        input_data = data_int(input_data, "rate_kbps",  "", NULL, sdr_stats.rate_kbps);
+        input_data = data_int(input_data, "gap_max_ms", "", NULL, sdr_stats.gap_max_ms);
+        input_data = data_int(input_data, "jitter_us",  "", NULL, sdr_stats.jitter_us);
+        input_data = data_int(input_data, "lag_ms",     "", NULL, sdr_stats.lag_ms);
+        input_data = data_int(input_data, "lag_max_ms", "", NULL, sdr_stats.lag_max_ms);
+    }
+    if (input_data) {
+        data = data_dat(data, "input", "", NULL, input_data);
+    }
+
+    data_t *hop_data = create_hop_schedule_data(cfg);
+    if (hop_data) {
+        data = data_dat(data, "hop_schedule", "", NULL, hop_data);
+    }
+
+    data_t *band_data = create_band_scan_data(cfg);
+    if (band_data) {
+        data = data_dat(data, "band_scan", "", NULL, band_data);
+    }
+
+    if (cfg->duty_sched) {
+        struct timeval now;
+        get_time_now(&now);
+        duty_sched_stats_t duty;
+        duty_sched_get_stats(cfg->duty_sched, now.tv_sec + now.tv_usec / 1e6, &duty);
+        double total = duty.awake + duty.asleep;
+        data_t *duty_data = data_make(
+                "awake_s",          "", DATA_DOUBLE, duty.awake,
+                "asleep_s",         "", DATA_DOUBLE, duty.asleep,
+                "duty",             "", DATA_FORMAT, "%.3f", DATA_DOUBLE, total > 0 ? duty.awake / total : 1.0,
+                "learning",         "", DATA_INT, duty.learning,
+                "sensors",          "", DATA_INT, duty.sensors,
+                "sleeps",           "", DATA_INT, duty.sleeps,
+                "reports",          "", DATA_INT, duty.reports,
+                "missed",           "", DATA_INT, duty.missed,
+                NULL);
+        data = data_dat(data, "duty_cycle", "", NULL, duty_data);
+    }
+
+    if (cfg->verify) {
+        verify_stats_t verify;
+        verify_get_stats(cfg->verify, &verify);
+        data_t *verify_data = data_make(
+                "frames",           "", DATA_INT, verify.frames,
+                "frame_diffs",      "", DATA_INT, verify.frame_diffs,
+                "baseband_speedup", "", DATA_FORMAT, "%.2f", DATA_DOUBLE, verify.baseband_speedup,
+                "packages",         "", DATA_INT, verify.packages,
+                "package_diffs",    "", DATA_INT, verify.package_diffs,
+                "decode_speedup",   "", DATA_FORMAT, "%.2f", DATA_DOUBLE, verify.decode_speedup,
+                NULL);
+        data = data_dat(data, "verify", "", NULL, verify_data);
+    }
+
+    if (cfg->decode_farm) {
+        struct timeval now;
+        get_time_now(&now);
+        double now_s = now.tv_sec + now.tv_usec / 1e6;
+        decode_farm_stats_t farm;
+        decode_farm_get_stats(cfg->decode_farm, now_s, &farm);
+        data_t *worker_data[DECODE_FARM_WORKERS];
+        for (unsigned i = 0; i < farm.workers; ++i) {
+            decode_farm_worker_stats_t worker;
+            decode_farm_get_worker_stats(cfg->decode_farm, i, now_s, &worker);
+            worker_data[i] = data_make(
+                    "worker",           "", DATA_STRING, worker.spec,
+                    "healthy",          "", DATA_INT, worker.healthy,
+                    "in_flight",        "", DATA_INT, worker.in_flight,
+                    "sent",             "", DATA_INT, worker.sent,
+                    "spilled",          "", DATA_INT, worker.spilled,
+                    "results",          "", DATA_INT, worker.results,
+                    "events",           "", DATA_INT, worker.events,
+                    NULL);
+        }
+        data_t *farm_data = data_make(
+                "healthy",          "", DATA_INT, farm.healthy,
+                "pending",          "", DATA_INT, farm.pending,
+                "sent",             "", DATA_INT, farm.sent,
+                "dropped",          "", DATA_INT, farm.dropped,
+                "lost",             "", DATA_INT, farm.lost,
+                "late",             "", DATA_INT, farm.late,
+                "workers",          "", DATA_ARRAY, data_array((int)farm.workers, DATA_DATA, worker_data),
+                NULL);
+        data = data_dat(data, "farm", "", NULL, farm_data);
+    }
+
+    r_mem_usage_t mem;
+    r_get_mem_usage(cfg, &mem);
+    data_t *mem_data = data_make(
+            "sdr_kb",      "", DATA_INT, (int)(mem.sdr / 1024),
+            "demod_kb",    "", DATA_INT, (int)(mem.demod / 1024),
+            "pulses_kb",   "", DATA_INT, (int)(mem.pulses / 1024),
+            "decoders_kb", "", DATA_INT, (int)(mem.decoders / 1024),
+            "grabber_kb",  "", DATA_INT, (int)(mem.grabber / 1024),
+            "dumpers_kb",  "", DATA_INT, (int)(mem.dumpers / 1024),
+            NULL);
+    data = data_dat(data, "memory", "", NULL, mem_data);
+
+    if (cfg->dsp_thread) {
+        ring_queue_stats_t iq_stats;
+        ring_queue_stats_t event_stats;
+        dsp_thread_get_stats(cfg->dsp_thread, &iq_stats, &event_stats);
+        data_t *dsp_data = data_make(
+                "iq_queue",         "", DATA_INT, iq_stats.len,
+                "iq_queue_max",     "", DATA_INT, iq_stats.len_max,
+                "iq_queue_size",    "", DATA_INT, iq_stats.size,
+                "iq_dropped",       "", DATA_INT, iq_stats.dropped,
+                "event_queue",      "", DATA_INT, event_stats.len,
+                "event_queue_max",  "", DATA_INT, event_stats.len_max,
+                "event_queue_size", "", DATA_INT, event_stats.size,
+                "event_dropped",    "", DATA_INT, event_stats.dropped,
+                NULL);
+        data = data_dat(data, "dsp", "", NULL, dsp_data);
+    }
+
+    if (cfg->demod->dump_writer) {
+        dump_writer_stats_t dump_stats;
+        dump_writer_get_stats(cfg->demod->dump_writer, &dump_stats);
+        data_t *dump_data = data_make(
+                "queue",            "", DATA_INT, dump_stats.queued,
+                "queue_max",        "", DATA_INT, dump_stats.queued_max,
+                "queue_size",       "", DATA_INT, dump_stats.blocks,
+                "writes",           "", DATA_INT, dump_stats.writes,
+                "bytes",            "", DATA_DOUBLE, (double)dump_stats.bytes,
+                "dropped_bytes",    "", DATA_DOUBLE, (double)dump_stats.dropped,
+                "waits",            "", DATA_INT, dump_stats.waits,
+                "stall_max_ms",     "", DATA_INT, dump_stats.stall_max_ms,
+                "backlog_max_ms",   "", DATA_INT, dump_stats.backlog_max_ms,
+                NULL);
+        data = data_dat(data, "dumpers", "", NULL, dump_data);
+    }
+
+    if (cfg->iq_snippet) {
+        data_t *snippet_data = data_make(
+                "saved",            "", DATA_INT, (int)is.snippets,
+                "missed",           "", DATA_INT, (int)is.snippets_missed,
+                NULL);
+        data = data_dat(data, "snippets", "", NULL, snippet_data);
+    }
+
+    if (is.sched_buffers) {
+        data_t *sched_data = data_make(
+                "buffers",          "", DATA_INT, (int)is.sched_buffers,
+                "late",             "", DATA_INT, (int)is.sched_late,
+                "late_max_us",      "", DATA_INT, cfg->sched_late_max_us,
+                "wait_max_us",      "", DATA_INT, cfg->sched_wait_max_us,
+                NULL);
+        if (is.sched_merged)
+            sched_data = data_int(sched_data, "merged", "", NULL, (int)is.sched_merged);
+        if (cfg->lag_shed) {
+            sched_data = data_int(sched_data, "lag_ms",          "", NULL, (int)(cfg->sched_lag_us / 1000));
+            sched_data = data_int(sched_data, "lag_max_ms",      "", NULL, (int)(cfg->sched_lag_max_us / 1000));
+            sched_data = data_int(sched_data, "lag_skipped",     "", NULL, (int)is.lag_skips);
+            sched_data = data_dbl(sched_data, "lag_skipped_samples", "", NULL, (double)is.samples_lag_skipped);
+        }
+        data = data_dat(data, "sched", "", NULL, sched_data);
+    }
+
+    list_t output_list = {0};
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (!output || !output->output_stats)
+            continue;
+        data_t *output_data = output->output_stats(output);
+        if (output_data)
+            list_push(&output_list, data_prepend(output_data, "output", "", DATA_INT, (int)i, NULL));
+    }
+    if (output_list.len) {
+        data = data_ary(data, "outputs", "", NULL, data_array(output_list.len, DATA_DATA, output_list.elems));
+    }
+    list_free_elems(&output_list, NULL);
+
+    if (slice_lookups) {
+        data_t *slice_data = data_make(
+                "lookups",          "", DATA_INT, (int)slice_lookups,
+                "hits",             "", DATA_INT, (int)slice_hits,
+                "hit_rate",         "", DATA_FORMAT, "%.3f", DATA_DOUBLE, (double)slice_hits / slice_lookups,
+                NULL);
+        data = data_dat(data, "slice_cache", "", NULL, slice_data);
+    }
+
+    if (memo_hits) {
+        data = data_int(data, "memo_hits", "", NULL, (int)memo_hits);
     }
-    data_free(data);
-}
 
-// level 0: do not report (don't call this), 1: report successful devices, 2: report active devices, 3: report all
-data_t *create_report_data(r_cfg_t *cfg, int level)
-{
-    list_t *r_devs = &cfg->demod->r_devs;
-    data_t *data;
-    list_t dev_data_list = {0};
-    list_ensure_size(&dev_data_list, r_devs->len);
+    if (cfg->demod->decode_pin) {
+        decode_pin_stats_t ps;
+        decode_pin_get_stats(cfg->demod->decode_pin, &ps);
+        data_t *pin_data = data_make(
+                "sensors",          "", DATA_INT, (int)ps.sensors,
+                "fingerprints",     "", DATA_INT, (int)ps.entries,
+                "packages",         "", DATA_INT, (int)ps.packages,
+                "hits",             "", DATA_INT, (int)ps.hits,
+                "misses",           "", DATA_INT, (int)ps.misses,
+                "learned",          "", DATA_INT, (int)ps.learned,
+                "dropped",          "", DATA_INT, (int)ps.dropped,
+                NULL);
+        data = data_dat(data, "pin", "", NULL, pin_data);
+    }
 
-    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
-        r_device *r_dev = *iter;
-        if (level <= 2 && r_dev->decode_events == 0)
-            continue;
-        if (level <= 1 && r_dev->decode_ok == 0)
-            continue;
-        if (level <= 0)
-            continue;
+    if (prefilter_skips) {
+        data = data_int(data, "prefiltered", "", NULL, (int)prefilter_skips);
+    }
 
-        data = data_make(
-                "device",       "", DATA_INT, r_dev->protocol_num,
-                "name",         "", DATA_STRING, r_dev->name,
-                "events",       "", DATA_INT, r_dev->decode_events,
-                "ok",           "", DATA_INT, r_dev->decode_ok,
-                "messages",     "", DATA_INT, r_dev->decode_messages,
+    if (cpu_stats_enabled()) {
+        data = data_dat(data, "cpu", "", NULL, create_cpu_report_data(cfg));
+    }
+
+    unsigned latency_count = 0;
+    int latency_max        = 0;
+    for (int i = 0; i <= LATENCY_HIST_MS; ++i) {
+        latency_count += cfg->latency_hist[i];
+        if (cfg->latency_hist[i])
+            latency_max = i;
+    }
+    if (latency_count) {
+        data_t *latency_data = data_make(
+                "count",            "", DATA_INT, latency_count,
+                "p50_ms",           "", DATA_INT, latency_percentile(cfg, latency_count, 50),
+                "p90_ms",           "", DATA_INT, latency_percentile(cfg, latency_count, 90),
+                "p99_ms",           "", DATA_INT, latency_percentile(cfg, latency_count, 99),
+                "max_ms",           "", DATA_INT, latency_max,
                 NULL);
+        data = data_dat(data, "latency", "", NULL, latency_data);
+    }
 
-        if (r_dev->decode_fails[-DECODE_FAIL_OTHER])
-            data = data_int(data, "fail_other",   "", NULL, r_dev->decode_fails[-DECODE_FAIL_OTHER]);
-        if (r_dev->decode_fails[-DECODE_ABORT_LENGTH])
-            data = data_int(data, "abort_length", "", NULL, r_dev->decode_fails[-DECODE_ABORT_LENGTH]);
-        if (r_dev->decode_fails[-DECODE_ABORT_EARLY])
-            data = data_int(data, "abort_early",  "", NULL, r_dev->decode_fails[-DECODE_ABORT_EARLY]);
-        if (r_dev->decode_fails[-DECODE_FAIL_MIC])
-            data = data_int(data, "fail_mic",     "", NULL, r_dev->decode_fails[-DECODE_FAIL_MIC]);
-        if (r_dev->decode_fails[-DECODE_FAIL_SANITY])
-            data = data_int(data, "fail_sanity",  "", NULL, r_dev->decode_fails[-DECODE_FAIL_SANITY]);
+    list_free_elems(&dev_data_list, NULL);
+    return data;
+}
 
-        list_push(&dev_data_list, data);
+data_t *create_hop_schedule_data(r_cfg_t *cfg)
+{
+    if (!cfg->hop_sched || !cfg->samp_rate)
+        return NULL;
+
+    double now = (double)cfg->input_pos / cfg->samp_rate;
+    list_t freq_list = {0};
+    for (int i = 0; i < cfg->frequencies; ++i) {
+        hop_sched_stats_t stats;
+        hop_sched_get_stats(cfg->hop_sched, (unsigned)i, now, &stats);
+        data_t *data = data_make(
+                "frequency",        "", DATA_INT, cfg->frequency[i],
+                "listen_s",         "", DATA_DOUBLE, stats.listen,
+                "dwells",           "", DATA_INT, stats.dwells,
+                "packages",         "", DATA_INT, stats.packages,
+                "events",           "", DATA_INT, stats.events,
+                "package_rate",     "", DATA_DOUBLE, stats.package_rate,
+                "event_rate",       "", DATA_DOUBLE, stats.event_rate,
+                "sensors",          "", DATA_INT, stats.sensors,
+                NULL);
+        if (stats.next_due) {
+            data = data_dbl(data, "next_due_s", "", NULL, stats.next_due - now);
+        }
+        list_push(&freq_list, data);
     }
 
-    data = data_make(
-            "count",            "", DATA_INT, cfg->frames_ook,
-            "fsk",              "", DATA_INT, cfg->frames_fsk,
-            "events",           "", DATA_INT, cfg->frames_events,
+    data_t *data = data_make(
+            "frequency",        "", DATA_INT, cfg->frequency[cfg->frequency_index],
+            "dwell_s",          "", DATA_DOUBLE, (double)cfg->hop_dwell / cfg->samp_rate,
+            "frequencies",      "", DATA_ARRAY, data_array(freq_list.len, DATA_DATA, freq_list.elems),
             NULL);
+    list_free_elems(&freq_list, NULL);
+    return data;
+}
 
-    char since_str[LOCAL_TIME_BUFLEN];
-    format_time_str(since_str, "%Y-%m-%dT%H:%M:%S", cfg->report_time_tz, cfg->frames_since);
+data_t *create_band_scan_data(r_cfg_t *cfg)
+{
+    // the scanner reports for all inputs
+    if (!cfg->band_sched || cfg->band_listener >= 0)
+        return NULL;
+
+    struct timeval now;
+    get_time_now(&now);
+    list_t chan_list = {0};
+    for (int i = 0; i < cfg->frequencies; ++i) {
+        band_sched_stats_t stats;
+        band_sched_get_stats(cfg->band_sched, (unsigned)i, now.tv_sec + now.tv_usec / 1e6, &stats);
+        data_t *data = data_make(
+                "frequency",        "", DATA_INT, stats.frequency,
+                "score",            "", DATA_FORMAT, "%.3f", DATA_DOUBLE, stats.score,
+                "dwells",           "", DATA_INT, stats.dwells,
+                "active_dwells",    "", DATA_INT, stats.active_dwells,
+                "assigns",          "", DATA_INT, stats.assigns,
+                NULL);
+        if (stats.idle > 0) {
+            data = data_dbl(data, "idle_s", "", NULL, stats.idle);
+        }
+        if (stats.listener >= 0) {
+            data = data_int(data, "listener", "", NULL, stats.listener);
+        }
+        list_push(&chan_list, data);
+    }
 
-    data = data_make(
-            "enabled",          "", DATA_INT, r_devs->len,
-            "since",            "", DATA_STRING, since_str,
-            "frames",           "", DATA_DATA, data,
-            "stats",            "", DATA_ARRAY, data_array(dev_data_list.len, DATA_DATA, dev_data_list.elems),
+    data_t *data = data_make(
+            "frequency",        "", DATA_INT, cfg->frequency[cfg->frequency_index],
+            "listeners",        "", DATA_INT, (int)cfg->inputs.len,
+            "hold_s",           "", DATA_DOUBLE, cfg->band_scan,
+            "channels",         "", DATA_ARRAY, data_array(chan_list.len, DATA_DATA, chan_list.elems),
             NULL);
-
-    list_free_elems(&dev_data_list, NULL);
+    list_free_elems(&chan_list, NULL);
     return data;
 }
 
@@ -952,69 +3102,118 @@ void flush_report_data(r_cfg_t *cfg)
 {
     list_t *r_devs = &cfg->demod->r_devs;
 
+    // the counters are never reset, the next interval counts from here
     time(&cfg->frames_since);
-    cfg->frames_ook = 0;
-    cfg->frames_fsk = 0;
-    cfg->frames_events = 0;
+    stats_read(&cfg->stats_base, &cfg->stats, sizeof(cfg->stats));
+    memset(cfg->latency_hist, 0, sizeof(cfg->latency_hist));
+    cfg->sched_late_max_us = 0;
+    cfg->sched_wait_max_us = 0;
+    cfg->sched_lag_max_us  = 0;
 
     for (void **iter = r_devs->elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
-
-        r_dev->decode_events = 0;
-        r_dev->decode_ok = 0;
-        r_dev->decode_messages = 0;
-        r_dev->decode_fails[0] = 0;
-        r_dev->decode_fails[1] = 0;
-        r_dev->decode_fails[2] = 0;
-        r_dev->decode_fails[3] = 0;
-        r_dev->decode_fails[4] = 0;
+        stats_read(&r_dev->stats_base, &r_dev->stats, sizeof(r_dev->stats));
     }
 }
 
 /* setup */
 
-static int lvlarg_param(char **param, int default_verb)
+#define OUTPUT_ASYNC_QUEUE_DEFAULT 256
+
+/// Parses the options ",v=<level>", ",async[=<queue_size>]" (if @p async is not NULL), and ",sparse" / ",long" (if @p layout is not NULL) before the output path.
+static int outarg_param(char **param, int default_verb, unsigned *async, int *layout, file_sink_opts_t *sink)
 {
     if (!param || !*param) {
         return default_verb;
     }
-    // parse ", v = %d"
+    int val = default_verb;
     char *p = *param;
-    if (*p != ',') {
-        return default_verb;
-    }
-    p++;
-    while (*p == ' ' || *p == '\t')
+    while (*p == ',') {
         p++;
-    if (*p != 'v') {
-        fprintf(stderr, "Unknown output option \"%s\"\n", *param);
-        exit(1);
-    }
-    p++;
-    while (*p == ' ' || *p == '\t')
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (async && !strncmp(p, "async", 5)) {
+            p += 5;
+            while (*p == ' ' || *p == '\t')
+                p++;
+            *async = OUTPUT_ASYNC_QUEUE_DEFAULT;
+            if (*p == '=') {
+                p++;
+                char *endptr;
+                long size = strtol(p, &endptr, 10);
+                if (p == endptr || size < 1) {
+                    fprintf(stderr, "Invalid output option \"%s\"\n", *param);
+                    exit(1);
+                }
+                *async = (unsigned)size;
+                p = endptr;
+            }
+            continue;
+        }
+        if (sink) {
+            int ret = file_sink_parse_opt(sink, &p);
+            if (ret < 0) {
+                fprintf(stderr, "Invalid output option \"%s\"\n", *param);
+                exit(1);
+            }
+            if (ret > 0)
+                continue;
+        }
+        if (layout && !strncmp(p, "sparse", 6)) {
+            p += 6;
+            *layout = CSV_LAYOUT_SPARSE;
+            continue;
+        }
+        if (layout && !strncmp(p, "long", 4)) {
+            p += 4;
+            *layout = CSV_LAYOUT_LONG;
+            continue;
+        }
+        // parse "v = %d"
+        if (*p != 'v') {
+            fprintf(stderr, "Unknown output option \"%s\"\n", *param);
+            exit(1);
+        }
         p++;
-    if (*p != '=') {
-        fprintf(stderr, "Unknown output option \"%s\"\n", *param);
-        exit(1);
-    }
-    p++;
-    while (*p == ' ' || *p == '\t')
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p != '=') {
+            fprintf(stderr, "Unknown output option \"%s\"\n", *param);
+            exit(1);
+        }
         p++;
-    char *endptr;
-    int val = strtol(p, &endptr, 10);
-    if (p == endptr) {
-        fprintf(stderr, "Invalid output option \"%s\"\n", *param);
-        exit(1);
+        while (*p == ' ' || *p == '\t')
+            p++;
+        char *endptr;
+        val = strtol(p, &endptr, 10);
+        if (p == endptr) {
+            fprintf(stderr, "Invalid output option \"%s\"\n", *param);
+            exit(1);
+        }
+        p = endptr;
     }
-    *param = endptr;
+    *param = p;
     return val;
 }
 
-/// Opens the path @p param (or STDOUT if empty or `-`) for append writing, removes leading `,` and `:` from path name.
-static FILE *fopen_output(char const *param)
+static int lvlarg_param(char **param, int default_verb)
+{
+    return outarg_param(param, default_verb, NULL, NULL, NULL);
+}
+
+/// Wraps a file output to print from a worker thread if @p async gives a queue size.
+static data_output_t *async_output(data_output_t *output, unsigned async)
+{
+    if (!async)
+        return output;
+    return data_output_async_create(output, async);
+}
+
+/// Opens the path @p param (or STDOUT if empty or `-`) for append writing with @p mode and the policy @p sink, removes leading `,` and `:` from path name.
+static FILE *fopen_output_mode(char const *param, char const *mode, file_sink_opts_t const *sink)
 {
     if (!param || !*param) {
-        return stdout; // No path given
+        return file_sink_open(NULL, mode, sink); // No path given
     }
     while (*param == ',') {
         param++; // Skip all leading `,`
@@ -1023,9 +3222,9 @@ static FILE *fopen_output(char const *param)
         param++; // Skip one leading `:`
     }
     if (*param == '-' && param[1] == '\0') {
-        return stdout; // STDOUT requested
+        return file_sink_open(NULL, mode, sink); // STDOUT requested
     }
-    FILE *file = fopen(param, "a");
+    FILE *file = file_sink_open(param, mode, sink);
     if (!file) {
         fprintf(stderr, "rtl_433: failed to open output file\n");
         exit(1);
@@ -1033,16 +3232,264 @@ static FILE *fopen_output(char const *param)
     return file;
 }
 
+/// Opens the path @p param (or STDOUT if empty or `-`) for append writing, removes leading `,` and `:` from path name.
+static FILE *fopen_output(char const *param, file_sink_opts_t const *sink)
+{
+    return fopen_output_mode(param, "a", sink);
+}
+
 void add_json_output(r_cfg_t *cfg, char *param)
 {
-    int log_level = lvlarg_param(&param, 0);
-    list_push(&cfg->output_handler, data_output_json_create(log_level, fopen_output(param)));
+    unsigned async        = 0;
+    file_sink_opts_t sink = {0};
+    int log_level         = outarg_param(&param, 0, &async, NULL, &sink);
+    list_push(&cfg->output_handler, async_output(data_output_json_create(log_level, fopen_output(param, &sink)), async));
 }
 
 void add_csv_output(r_cfg_t *cfg, char *param)
 {
-    int log_level = lvlarg_param(&param, 0);
-    list_push(&cfg->output_handler, data_output_csv_create(log_level, fopen_output(param)));
+    unsigned async        = 0;
+    int layout            = CSV_LAYOUT_WIDE;
+    file_sink_opts_t sink = {0};
+    int log_level         = outarg_param(&param, 0, &async, &layout, &sink);
+    list_push(&cfg->output_handler, async_output(data_output_csv_create(log_level, fopen_output(param, &sink), layout), async));
+}
+
+void add_cbor_output(r_cfg_t *cfg, char *param)
+{
+    unsigned async        = 0;
+    file_sink_opts_t sink = {0};
+    int log_level         = outarg_param(&param, 0, &async, NULL, &sink);
+    FILE *file            = fopen_output_mode(param, "ab", &sink);
+#ifdef _WIN32
+    if (file == stdout) {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+    list_push(&cfg->output_handler, async_output(data_output_cbor_create(log_level, file), async));
+}
+
+void add_udp_output(r_cfg_t *cfg, char *param)
+{
+    int log_level = lvlarg_param(&param, LOG_WARNING);
+    char const *host = "localhost";
+    char const *port = "1433";
+    char *extra = hostport_param(param, &host, &port);
+    print_logf(LOG_CRITICAL, "CBOR UDP", "Sending datagrams to %s port %s", host, port);
+
+    list_push(&cfg->output_handler, data_output_udp_cbor_create(get_mgr(cfg), log_level, host, port, extra));
+}
+
+void add_shm_output(r_cfg_t *cfg, char *param)
+{
+    int log_level = lvlarg_param(&param, LOG_WARNING);
+    char *name = asepc(&param, ',');
+    if (!name || !*name)
+        name = SHM_DEFAULT_NAME;
+
+    data_output_t *output = data_output_shm_create(log_level, name, param);
+    if (!output) {
+        print_logf(LOG_FATAL, "SHM", "Creating the shared memory ring \"%s\" failed", name);
+        exit(1);
+    }
+    print_logf(LOG_CRITICAL, "SHM", "Writing events to the shared memory ring \"%s\"", name);
+    list_push(&cfg->output_handler, output);
+}
+
+void add_eventlog_output(r_cfg_t *cfg, char *param)
+{
+    int log_level = lvlarg_param(&param, LOG_WARNING);
+    char *dir = asepc(&param, ',');
+    if (!dir || !*dir)
+        dir = EVENTLOG_DEFAULT_DIR;
+
+    data_output_t *output = data_output_eventlog_create(log_level, dir, param);
+    if (!output) {
+        print_logf(LOG_FATAL, "Event log", "Opening the event log \"%s\" failed", dir);
+        exit(1);
+    }
+    print_logf(LOG_CRITICAL, "Event log", "Appending events to the event log \"%s\"", dir);
+    list_push(&cfg->output_handler, output);
+}
+
+/// Cut a ",<key>[=<value>]" option from an output argument, copies the value, returns 0 without the option.
+static int cut_output_option(char *arg, char const *key, char *val, size_t val_size)
+{
+    size_t key_len = strlen(key);
+    char *opt      = arg;
+    while ((opt = strchr(opt, ',')) != NULL) {
+        char *end = opt + 1 + key_len;
+        if (strncmp(opt + 1, key, key_len) == 0 && (*end == '=' || *end == ',' || *end == ':' || *end == '\0'))
+            break;
+        opt++;
+    }
+    if (!opt)
+        return 0;
+    // the value ends at the next option or the file name
+    char *end = opt + 1 + key_len;
+    char *v   = end;
+    if (*end == '=') {
+        v++;
+        end = v + strcspn(v, ",:");
+    }
+    snprintf(val, val_size, "%.*s", (int)(end - v), v);
+    memmove(opt, end, strlen(end) + 1);
+    return 1;
+}
+
+unsigned output_aggregate_param(char *arg)
+{
+    char val[32];
+    if (!arg || !cut_output_option(arg, "aggregate", val, sizeof(val)))
+        return 0;
+    double window = atod_time(val, "-F aggregate: ");
+    if (window < 1.0) {
+        fprintf(stderr, "Invalid output option \"aggregate=%s\", the window is at least 1 s\n", val);
+        exit(1);
+    }
+    return (unsigned)(window + 0.5);
+}
+
+int output_delta_param(char *arg, double *deadband, unsigned *heartbeat_s)
+{
+    char val[32];
+    *deadband    = 0.0;
+    *heartbeat_s = DELTA_HEARTBEAT_DEFAULT_S;
+    if (!arg || !cut_output_option(arg, "delta", val, sizeof(val))) {
+        if (arg && cut_output_option(arg, "heartbeat", val, sizeof(val))) {
+            fprintf(stderr, "Invalid output option \"heartbeat=%s\", heartbeat needs the delta option\n", val);
+            exit(1);
+        }
+        return 0;
+    }
+    if (*val) {
+        char *endptr;
+        *deadband = strtod(val, &endptr);
+        if (*endptr || *deadband < 0.0) {
+            fprintf(stderr, "Invalid output option \"delta=%s\", the deadband is a number of at least 0\n", val);
+            exit(1);
+        }
+    }
+    if (cut_output_option(arg, "heartbeat", val, sizeof(val))) {
+        double heartbeat = atod_time(val, "-F heartbeat: ");
+        if (heartbeat < 0.0) {
+            fprintf(stderr, "Invalid output option \"heartbeat=%s\", the heartbeat is a time of at least 0\n", val);
+            exit(1);
+        }
+        *heartbeat_s = (unsigned)(heartbeat + 0.5);
+    }
+    return 1;
+}
+
+void aggregate_outputs(r_cfg_t *cfg, size_t first, unsigned window_s)
+{
+    for (size_t i = first; i < cfg->output_handler.len; ++i)
+        cfg->output_handler.elems[i] = data_output_aggregate_create(cfg->output_handler.elems[i], window_s);
+}
+
+int output_filter_param(char *arg, char *expr, size_t expr_size)
+{
+    if (!arg || !cut_output_option(arg, "filter", expr, expr_size))
+        return 0;
+    char err[FILTER_EXPR_MAX + 64];
+    output_filter_t *filter = output_filter_compile(expr, err, sizeof(err));
+    if (!filter) {
+        fprintf(stderr, "Invalid output option \"filter=%s\", %s\n", expr, err);
+        exit(1);
+    }
+    output_filter_free(filter);
+    return 1;
+}
+
+void filter_outputs(r_cfg_t *cfg, size_t first, char const *expr)
+{
+    for (size_t i = first; i < cfg->output_handler.len; ++i) {
+        output_filter_t *filter = output_filter_compile(expr, NULL, 0);
+        if (!filter)
+            continue; // NOTE: prints all events on alloc failure.
+        cfg->output_handler.elems[i] = data_output_filter_create(cfg->output_handler.elems[i], filter);
+    }
+}
+
+/// Parse the projection options as "fields=<rule>,exclude=<rule>,...", returns NULL on a syntax error.
+static data_projection_t *parse_projection(char const *rules, char *bad, size_t bad_size)
+{
+    data_projection_t *projection = data_projection_create();
+    if (!projection)
+        return NULL;
+    char rule[OUTPUT_FIELDS_MAX + 1];
+    snprintf(rule, sizeof(rule), "%s", rules);
+    for (char *p = rule, *next; p; p = next) {
+        next = strchr(p, ',');
+        if (next)
+            *next++ = '\0';
+        int exclude = !strncmp(p, "exclude=", 8);
+        char *val   = p + (exclude ? 8 : 7); // "fields=" otherwise
+        if (data_projection_add(projection, val, exclude)) {
+            if (bad)
+                snprintf(bad, bad_size, "%s", p);
+            data_projection_free(projection);
+            return NULL;
+        }
+    }
+    return projection;
+}
+
+int output_fields_param(char *arg, char *rules, size_t rules_size)
+{
+    abuf_t buf;
+    abuf_init(&buf, rules, rules_size);
+    char val[OUTPUT_FIELDS_MAX + 1];
+    int found = 0;
+    while (arg) {
+        int exclude = 0;
+        if (!cut_output_option(arg, "fields", val, sizeof(val))) {
+            if (!cut_output_option(arg, "exclude", val, sizeof(val)))
+                break;
+            exclude = 1;
+        }
+        abuf_printf(&buf, "%s%s=%s", found ? "," : "", exclude ? "exclude" : "fields", val);
+        found = 1;
+        if (!buf.left) {
+            fprintf(stderr, "Invalid output options \"fields\", at most %d chars\n", OUTPUT_FIELDS_MAX);
+            exit(1);
+        }
+    }
+    if (!found)
+        return 0;
+    char bad[OUTPUT_FIELDS_MAX + 1];
+    data_projection_t *projection = parse_projection(rules, bad, sizeof(bad));
+    if (!projection) {
+        fprintf(stderr, "Invalid output option \"%s\", use [<model>/]<key>[+<key>...]\n", bad);
+        exit(1);
+    }
+    data_projection_free(projection);
+    return 1;
+}
+
+void project_outputs(r_cfg_t *cfg, size_t first, char const *rules)
+{
+    for (size_t i = first; i < cfg->output_handler.len; ++i) {
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (!output)
+            continue;
+        data_projection_free(output->projection);
+        output->projection = parse_projection(rules, NULL, 0); // NOTE: prints all fields on alloc failure.
+    }
+}
+
+void delta_outputs(r_cfg_t *cfg, size_t first, double deadband, unsigned heartbeat_s)
+{
+    for (size_t i = first; i < cfg->output_handler.len; ++i)
+        cfg->output_handler.elems[i] = data_output_delta_create(cfg->output_handler.elems[i], deadband, heartbeat_s);
+}
+
+void expire_aggregates(r_cfg_t *cfg)
+{
+    struct timeval tv;
+    get_time_now(&tv);
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) // list might contain NULLs
+        data_output_aggregate_expire(cfg->output_handler.elems[i], tv.tv_sec + tv.tv_usec * 1e-6);
 }
 
 void start_outputs(r_cfg_t *cfg, char const *const *well_known)
@@ -1060,14 +3507,18 @@ void start_outputs(r_cfg_t *cfg, char const *const *well_known)
 
 void add_log_output(r_cfg_t *cfg, char *param)
 {
-    int log_level = lvlarg_param(&param, LOG_TRACE);
-    list_push(&cfg->output_handler, data_output_log_create(log_level, fopen_output(param)));
+    unsigned async        = 0;
+    file_sink_opts_t sink = {0};
+    int log_level         = outarg_param(&param, LOG_TRACE, &async, NULL, &sink);
+    list_push(&cfg->output_handler, async_output(data_output_log_create(log_level, fopen_output(param, &sink)), async));
 }
 
 void add_kv_output(r_cfg_t *cfg, char *param)
 {
-    int log_level = lvlarg_param(&param, LOG_TRACE);
-    list_push(&cfg->output_handler, data_output_kv_create(log_level, fopen_output(param)));
+    unsigned async        = 0;
+    file_sink_opts_t sink = {.nonblock = 1}; // a slow terminal drops records instead of stalling the decoding
+    int log_level         = outarg_param(&param, LOG_TRACE, &async, NULL, &sink);
+    list_push(&cfg->output_handler, async_output(data_output_kv_create(log_level, fopen_output(param, &sink)), async));
 }
 
 void add_mqtt_output(r_cfg_t *cfg, char *param)
@@ -1085,13 +3536,10 @@ void add_syslog_output(r_cfg_t *cfg, char *param)
     int log_level = lvlarg_param(&param, LOG_WARNING);
     char const *host = "localhost";
     char const *port = "514";
-    char const *extra = hostport_param(param, &host, &port);
-    if (extra && *extra) {
-        print_logf(LOG_FATAL, "Syslog UDP", "Unknown parameters \"%s\"", extra);
-    }
+    char *extra = hostport_param(param, &host, &port);
     print_logf(LOG_CRITICAL, "Syslog UDP", "Sending datagrams to %s port %s", host, port);
 
-    list_push(&cfg->output_handler, data_output_syslog_create(log_level, host, port));
+    list_push(&cfg->output_handler, data_output_syslog_create(get_mgr(cfg), log_level, host, port, extra));
 }
 
 void add_http_output(r_cfg_t *cfg, char *param)
@@ -1099,19 +3547,16 @@ void add_http_output(r_cfg_t *cfg, char *param)
     // Note: no log_level, the HTTP-API consumes all log levels.
     char const *host = "0.0.0.0";
     char const *port = "8433";
-    char const *extra = hostport_param(param, &host, &port);
-    if (extra && *extra) {
-        print_logf(LOG_FATAL, "HTTP server", "Unknown parameters \"%s\"", extra);
-    }
+    char *extra = hostport_param(param, &host, &port);
     print_logf(LOG_CRITICAL, "HTTP server", "Starting HTTP server at %s port %s", host, port);
 
-    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, cfg));
+    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, extra, cfg));
 }
 
 void add_trigger_output(r_cfg_t *cfg, char *param)
 {
     // Note: no log_level, we never trigger on logs.
-    list_push(&cfg->output_handler, data_output_trigger_create(fopen_output(param)));
+    list_push(&cfg->output_handler, data_output_trigger_create(fopen_output(param, NULL)));
 }
 
 void add_null_output(r_cfg_t *cfg, char *param)
@@ -1124,23 +3569,94 @@ void add_rtltcp_output(r_cfg_t *cfg, char *param)
 {
     char const *host = "localhost";
     char const *port = "1234";
-    char const *extra = hostport_param(param, &host, &port);
-    if (extra && *extra) {
-        print_logf(LOG_FATAL, "rtl_tcp server", "Unknown parameters \"%s\"", extra);
-    }
+    char *extra = hostport_param(param, &host, &port);
     print_logf(LOG_CRITICAL, "rtl_tcp server", "Starting rtl_tcp server at %s port %s", host, port);
 
     list_push(&cfg->raw_handler, raw_output_rtltcp_create(host, port, extra, cfg));
 }
 
+void add_rfraw_output(r_cfg_t *cfg, char *param)
+{
+    if (cfg->raw_file) {
+        fprintf(stderr, "Only one rfraw output is supported\n");
+        exit(1);
+    }
+    // the raw mode comes first, e.g. "rfraw,unknown,flush=1s:raw.ook"
+    cfg->raw_mode = 1;
+    char *p = param;
+    if (p && *p == ',') {
+        char const *modes[] = {"all", "unknown", "known"};
+        for (int i = 0; i < 3; ++i) {
+            size_t len = strlen(modes[i]);
+            if (!strncmp(p + 1, modes[i], len) && (!p[len + 1] || p[len + 1] == ',' || p[len + 1] == ':')) {
+                cfg->raw_mode = i + 1;
+                param          = p + len + 1;
+                break;
+            }
+        }
+    }
+    file_sink_opts_t sink = {0};
+    outarg_param(&param, 0, NULL, NULL, &sink);
+    cfg->raw_file = fopen_output(param, &sink);
+}
+
+void add_pulse_output(r_cfg_t *cfg, char *param)
+{
+    if (cfg->pulse_sender) {
+        fprintf(stderr, "Only one pulse output is supported\n");
+        exit(1);
+    }
+    char const *host = "localhost";
+    char const *port = PULSE_UDP_PORT;
+    hostport_param(param, &host, &port);
+    print_logf(LOG_CRITICAL, "Pulse UDP", "Sending pulse packages to %s port %s", host, port);
+
+    cfg->pulse_sender = pulse_sender_create(host, port);
+    if (!cfg->pulse_sender)
+        exit(1);
+}
+
+/// Add a dumper to the list, the file is opened by the caller, the buffers of its format come with r_demod_reserve().
+static file_info_t *new_dumper(r_cfg_t *cfg, char const *spec)
+{
+    file_info_t *dumper = calloc(1, sizeof(*dumper));
+    if (!dumper)
+        FATAL_CALLOC("add_dumper()");
+    list_push(&cfg->demod->dumper, dumper);
+
+    file_info_parse_filename(dumper, spec);
+    return dumper;
+}
+
 void add_sr_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
 {
-    // create channels
-    add_dumper(cfg, "U8:LOGIC:logic-1-1", overwrite);
-    add_dumper(cfg, "F32:I:analog-1-4-1", overwrite);
-    add_dumper(cfg, "F32:Q:analog-1-5-1", overwrite);
-    add_dumper(cfg, "F32:AM:analog-1-6-1", overwrite);
-    add_dumper(cfg, "F32:FM:analog-1-7-1", overwrite);
+    static char const *labels[] = {
+            "FRAME", // probe1
+            "ASK", // probe2
+            "FSK", // probe3
+            "I", // analog4
+            "Q", // analog5
+            "AM", // analog6
+            "FM", // analog7
+    };
+    if (cfg->demod->sigrok) {
+        fprintf(stderr, "Only one Sigrok output is supported\n");
+        exit(1);
+    }
+    if (access(spec, F_OK) == 0 && !overwrite) {
+        fprintf(stderr, "Output file %s already exists, exiting\n", spec);
+        exit(1);
+    }
+    cfg->demod->sigrok = sigrok_writer_create(spec, 3, 4, labels);
+    if (!cfg->demod->sigrok)
+        exit(1);
+
+    // the channels are written to the archive, in this order of the analogs
+    new_dumper(cfg, "U8:LOGIC:logic-1-1");
+    new_dumper(cfg, "F32:I:analog-1-4-1");
+    new_dumper(cfg, "F32:Q:analog-1-5-1");
+    new_dumper(cfg, "F32:AM:analog-1-6-1");
+    new_dumper(cfg, "F32:FM:analog-1-7-1");
     cfg->sr_filename = spec;
     cfg->sr_execopen = overwrite;
 }
@@ -1166,21 +3682,42 @@ void reopen_dumpers(struct r_cfg *cfg)
             if (old_st.st_ino == new_st.st_ino) {
                 continue;
             }
+            // the metadata of a SigMF dataset needs the whole data file
+            if (find_sigmf_dumper(cfg->demod, dumper->file)) {
+                print_logf(LOG_WARNING, "Dumper", "Not reopening the SigMF dataset \"%s\"", dumper->path);
+                continue;
+            }
 
             // Reopen the file
             print_logf(LOG_INFO, "Dumper", "Reopening \"%s\"", dumper->path);
+            void **gated = find_gated_dumper(cfg->demod, dumper->file);
+            if (gated) {
+                gated_iq_writer_finish(*gated);
+                gated_iq_writer_free(*gated);
+            }
+            int async = !dump_writer_remove(cfg->demod->dump_writer, dumper->file);
             fclose(dumper->file);
             dumper->file = fopen(dumper->path, "wb");
             if (!dumper->file) {
                 fprintf(stderr, "Failed to open %s\n", dumper->path);
                 exit(1);
             }
+            if (gated) {
+                *gated = gated_iq_writer_create(dumper->file, dumper->format == GIQ_CU8 ? CU8_IQ : CS16_IQ, write_gated_dumper, cfg->demod);
+                if (!*gated)
+                    exit(1);
+            }
             if (dumper->format == VCD_LOGIC) {
                 pulse_data_print_vcd_header(dumper->file, cfg->samp_rate);
             }
             if (dumper->format == PULSE_OOK) {
                 pulse_data_print_pulse_header(dumper->file);
             }
+            if (dumper->format == PULSE_BIN) {
+                pulse_data_print_bin_header(dumper->file);
+            }
+            if (async)
+                dump_writer_add(cfg->demod->dump_writer, dumper->file, dumper->path);
         }
     }
 #endif
@@ -1188,6 +3725,11 @@ void reopen_dumpers(struct r_cfg *cfg)
 
 void close_dumpers(struct r_cfg *cfg)
 {
+    finish_gated_dumpers(cfg->demod);
+    finish_sigmf_dumpers(cfg->demod);
+    finish_sigrok_dumper(cfg);
+    dump_writer_free(cfg->demod->dump_writer);
+    cfg->demod->dump_writer = NULL;
     for (void **iter = cfg->demod->dumper.elems; iter && *iter; ++iter) {
         file_info_t *dumper = *iter;
         if (dumper->file && (dumper->file != stdout)) {
@@ -1195,24 +3737,32 @@ void close_dumpers(struct r_cfg *cfg)
             dumper->file = NULL;
         }
     }
-
-    char const *labels[] = {
-            "FRAME", // probe1
-            "ASK", // probe2
-            "FSK", // probe3
-            "I", // analog4
-            "Q", // analog5
-            "AM", // analog6
-            "FM", // analog7
-    };
-    if (cfg->sr_filename) {
-        write_sigrok(cfg->sr_filename, cfg->samp_rate, 3, 4, labels);
-    }
     if (cfg->sr_execopen) {
         open_pulseview(cfg->sr_filename);
     }
 }
 
+void start_dump_writer(r_cfg_t *cfg, int wait)
+{
+    struct dm_state *demod = cfg->demod;
+    if (demod->dump_writer)
+        return;
+    unsigned size_mb = cfg->dump_async ? cfg->dump_async : DEFAULT_DUMP_ASYNC_MB;
+    size_t size      = (size_t)size_mb * 1024 * 1024;
+    // at least two blocks for each file
+    if (size < demod->dumper.len * 2 * DUMP_WRITER_BLOCK)
+        size = demod->dumper.len * 2 * DUMP_WRITER_BLOCK;
+    demod->dump_writer = dump_writer_create(size, cfg->dump_flags | (wait ? DUMP_WRITER_WAIT : 0));
+
+    // the pulse dumpers write small amounts with stdio, stdout might be shared
+    for (void **iter = demod->dumper.elems; demod->dump_writer && iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        if (dumper->file && dumper->file != stdout
+                && dumper->format != VCD_LOGIC && dumper->format != PULSE_OOK && dumper->format != PULSE_BIN)
+            dump_writer_add(demod->dump_writer, dumper->file, dumper->path);
+    }
+}
+
 void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
 {
     size_t spec_len = strlen(spec);
@@ -1221,24 +3771,32 @@ void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
         return;
     }
 
-    file_info_t *dumper = calloc(1, sizeof(*dumper));
-    if (!dumper)
-        FATAL_CALLOC("add_dumper()");
-    list_push(&cfg->demod->dumper, dumper);
-
-    file_info_parse_filename(dumper, spec);
-    if (strcmp(dumper->path, "-") == 0) { /* Write samples to stdout */
+    file_info_t *dumper = new_dumper(cfg, spec);
+    sigmf_writer_t *sigmf = NULL;
+    char const *path      = dumper->path;
+    if ((dumper->format & 0xffff0000) == F_SIGMF) {
+        if (strcmp(dumper->path, "-") == 0) {
+            fprintf(stderr, "SigMF output needs a file name (%s)\n", spec);
+            exit(1);
+        }
+        sigmf = sigmf_writer_create(dumper->path, (dumper->format & 0xffff) | F_IQ, version_string());
+        if (!sigmf)
+            exit(1);
+        list_push(&cfg->demod->sigmf, sigmf);
+        path = sigmf_writer_data_path(sigmf);
+    }
+    if (strcmp(path, "-") == 0) { /* Write samples to stdout */
         dumper->file = stdout;
 #ifdef _WIN32
         _setmode(_fileno(stdin), _O_BINARY);
 #endif
     }
     else {
-        if (access(dumper->path, F_OK) == 0 && !overwrite) {
-            fprintf(stderr, "Output file %s already exists, exiting\n", spec);
+        if (access(path, F_OK) == 0 && !overwrite) {
+            fprintf(stderr, "Output file %s already exists, exiting\n", path);
             exit(1);
         }
-        dumper->file = fopen(dumper->path, "wb");
+        dumper->file = fopen(path, "wb");
         if (!dumper->file) {
             fprintf(stderr, "Failed to open %s\n", spec);
             exit(1);
@@ -1250,6 +3808,18 @@ void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
     if (dumper->format == PULSE_OOK) {
         pulse_data_print_pulse_header(dumper->file);
     }
+    if (dumper->format == PULSE_BIN) {
+        pulse_data_print_bin_header(dumper->file);
+    }
+    if (dumper->format == GIQ_CU8 || dumper->format == GIQ_CS16) {
+        gated_iq_writer_t *gated = gated_iq_writer_create(dumper->file, dumper->format == GIQ_CU8 ? CU8_IQ : CS16_IQ, write_gated_dumper, cfg->demod);
+        if (!gated)
+            exit(1);
+        list_push(&cfg->demod->gated_iq, gated);
+    }
+    if (sigmf) {
+        sigmf_writer_set_file(sigmf, dumper->file);
+    }
 }
 
 void add_infile(r_cfg_t *cfg, char *in_file)
@@ -0,0 +1,291 @@
+/** @file
+    Embeddable decoder pipeline, from IQ samples or pulses to the decoded events.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "r_pipeline.h"
+#include "r_api.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "rtl_433.h"
+#include "baseband.h"
+#include "pulse_detect.h"
+#include "pulse_data.h"
+#include "list.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct r_pipeline {
+    r_cfg_t cfg;   ///< a receiver of its own, without an SDR, threads, or an event loop
+    r_pipeline_event_fn event_cb;
+    void *ctx;
+    int stale;     ///< decoders were registered, the dispatch and FM demod need an update
+    int events;    ///< events of the current feed
+};
+
+/// The output of a pipeline, passes the events to the handler.
+typedef struct pipeline_output {
+    data_output_t output;
+    r_pipeline_t *pipeline;
+} pipeline_output_t;
+
+static void R_API_CALLCONV print_pipeline_event(data_output_t *output, data_t *data)
+{
+    r_pipeline_t *p = ((pipeline_output_t *)output)->pipeline;
+    p->events++;
+    p->event_cb(p->ctx, data);
+}
+
+static void R_API_CALLCONV print_pipeline_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    print_pipeline_event(output, data);
+}
+
+static void R_API_CALLCONV free_pipeline_output(data_output_t *output)
+{
+    free(output);
+}
+
+r_pipeline_t *r_pipeline_create(uint32_t samp_rate, int format, r_pipeline_event_fn event_cb, void *ctx)
+{
+    if (format != R_PIPELINE_CU8 && format != R_PIPELINE_CS16)
+        return NULL;
+
+    r_pipeline_t *p = calloc(1, sizeof(*p));
+    if (!p) {
+        WARN_CALLOC("r_pipeline_create()");
+        return NULL;
+    }
+    pipeline_output_t *out = calloc(1, sizeof(*out));
+    if (!out) {
+        WARN_CALLOC("r_pipeline_create()");
+        free(p);
+        return NULL;
+    }
+
+    r_cfg_t *cfg = &p->cfg;
+    r_init_cfg(cfg);
+    cfg->samp_rate   = samp_rate;
+    cfg->report_time = REPORT_TIME_DATE;
+
+    struct dm_state *demod = cfg->demod;
+    demod->sample_size = format;
+    pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level, demod->min_snr, demod->detect_verbosity);
+
+    // events only, the decoder log messages skip this output
+    out->output.print_data   = print_pipeline_data;
+    out->output.output_print = print_pipeline_event;
+    out->output.output_free  = free_pipeline_output;
+    out->output.log_level    = 0;
+    out->pipeline            = p;
+    list_push(&cfg->output_handler, out);
+
+    p->event_cb = event_cb;
+    p->ctx      = ctx;
+    p->stale    = 1;
+    return p;
+}
+
+void r_pipeline_free(r_pipeline_t *p)
+{
+    if (!p)
+        return;
+
+    // a flex decoder is the only user of its template, the other templates are the device list
+    r_cfg_t *cfg = &p->cfg;
+    list_t flex_templates = {0};
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *tmpl = ((r_device *)*iter)->create_template;
+        if (tmpl < cfg->devices || tmpl >= cfg->devices + cfg->num_r_devices)
+            list_push(&flex_templates, tmpl);
+    }
+
+    r_free_cfg_local(cfg);
+    list_free_elems(&flex_templates, free);
+    free(p);
+}
+
+void r_pipeline_register_all(r_pipeline_t *p)
+{
+    register_all_protocols(&p->cfg, 0);
+    p->stale = 1;
+}
+
+int r_pipeline_register(r_pipeline_t *p, unsigned protocol_num, char const *arg)
+{
+    r_cfg_t *cfg = &p->cfg;
+    if (protocol_num < 1 || protocol_num > cfg->num_r_devices)
+        return -1;
+
+    char *dup = NULL;
+    if (arg) {
+        dup = strdup(arg);
+        if (!dup) {
+            WARN_STRDUP("r_pipeline_register()");
+            return -1;
+        }
+    }
+    register_protocol(cfg, &cfg->devices[protocol_num - 1], dup);
+    free(dup);
+    p->stale = 1;
+    return 0;
+}
+
+int r_pipeline_register_flex(r_pipeline_t *p, char const *spec)
+{
+    char *dup = strdup(spec);
+    if (!dup) {
+        WARN_STRDUP("r_pipeline_register_flex()");
+        return -1;
+    }
+    register_flex_protocol(&p->cfg, dup);
+    free(dup);
+    p->stale = 1;
+    return 0;
+}
+
+void r_pipeline_set_frequency(r_pipeline_t *p, uint32_t frequency)
+{
+    r_cfg_t *cfg = &p->cfg;
+    cfg->frequencies      = 1;
+    cfg->frequency[0]     = frequency;
+    cfg->center_frequency = frequency;
+}
+
+void r_pipeline_set_report_meta(r_pipeline_t *p, int report_meta)
+{
+    p->cfg.report_meta = report_meta;
+}
+
+/// Set up the dispatch and the FM demod for the decoders registered.
+static void pipeline_prepare(r_pipeline_t *p)
+{
+    if (!p->stale)
+        return;
+    list_t retired = {0};
+    r_update_log_level(&p->cfg);
+    r_reload_protocols(&p->cfg, &retired);
+    p->stale = 0;
+}
+
+/// Decode a package detected in the IQ samples, as sdr_decode_package() of the receiver.
+static void pipeline_decode_package(r_pipeline_t *p, int package_type)
+{
+    r_cfg_t *cfg = &p->cfg;
+    struct dm_state *demod = cfg->demod;
+    int fsk = package_type == PULSE_DATA_FSK || package_type == PULSE_DATA_FSK_PARTIAL;
+    pulse_data_t *pulses = fsk ? &demod->fsk_pulse_data : &demod->pulse_data;
+
+    calc_rssi_snr(cfg, pulses);
+    if (demod->gate_snr > 0.0f && pulses->snr_db < demod->gate_snr)
+        return; // too weak for the decoders
+    if (demod->prefilter)
+        pulse_data_fingerprint(pulses);
+
+    if (package_type == PULSE_DATA_OOK_PARTIAL)
+        run_ook_demods_partial(demod, pulses);
+    else if (package_type == PULSE_DATA_FSK_PARTIAL)
+        run_fsk_demods_partial(demod, pulses);
+    else if (fsk)
+        run_fsk_demods_pool(NULL, demod, pulses);
+    else
+        run_ook_demods_pool(NULL, demod, pulses);
+}
+
+/// Demodulate at most a demod buffer of samples and decode the packages that ended.
+static void pipeline_feed_chunk(r_pipeline_t *p, uint8_t const *iq_buf, unsigned n_samples)
+{
+    r_cfg_t *cfg = &p->cfg;
+    struct dm_state *demod = cfg->demod;
+    uint32_t samp_rate = cfg->samp_rate;
+
+    unsigned fpdm = cfg->fsk_pulse_detect_mode;
+    if (fpdm == FSK_PULSE_DETECT_AUTO)
+        fpdm = cfg->frequency[0] > FSK_PULSE_DETECTOR_LIMIT ? FSK_PULSE_DETECT_NEW : FSK_PULSE_DETECT_OLD;
+    float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
+
+    // all frames are processed, as with the file inputs
+    int16_t *fm_buf = demod->enable_FM_demod ? demod->buf.fm : NULL;
+    if (demod->sample_size == R_PIPELINE_CU8) {
+        baseband_demod_fused_cu8(iq_buf, demod->am_buf, fm_buf, n_samples, demod->use_mag_est,
+                &demod->lowpass_filter_state, samp_rate, low_pass, &demod->demod_FM_state);
+    }
+    else {
+        baseband_demod_fused_cs16((int16_t const *)iq_buf, demod->am_buf, fm_buf, n_samples,
+                &demod->lowpass_filter_state, samp_rate, low_pass, &demod->demod_FM_state);
+    }
+
+    int package_type;
+    while ((package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, samp_rate,
+                    cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm))) {
+        pipeline_decode_package(p, package_type);
+    }
+    cfg->input_pos += n_samples;
+}
+
+int r_pipeline_feed_iq(r_pipeline_t *p, void const *buf, size_t len)
+{
+    struct dm_state *demod = p->cfg.demod;
+    pipeline_prepare(p);
+    p->events = 0;
+    get_time_now(&demod->now);
+
+    uint8_t const *iq_buf = buf;
+    size_t n_samples = len / (size_t)demod->sample_size;
+    while (n_samples) {
+        unsigned n = n_samples < MAXIMAL_BUF_LENGTH ? (unsigned)n_samples : MAXIMAL_BUF_LENGTH;
+        if (r_demod_reserve(demod, n))
+            return -1;
+        pipeline_feed_chunk(p, iq_buf, n);
+        iq_buf += (size_t)n * (size_t)demod->sample_size;
+        n_samples -= n;
+    }
+    return p->events;
+}
+
+int r_pipeline_feed_pulses(r_pipeline_t *p, pulse_data_t *pulses, int fsk)
+{
+    struct dm_state *demod = p->cfg.demod;
+    pipeline_prepare(p);
+    p->events = 0;
+    get_time_now(&demod->now);
+
+    if (!pulses->sample_rate)
+        pulses->sample_rate = p->cfg.samp_rate;
+    // the decoders and the meta data refer to the package of the demod, lend it the caller's package
+    pulse_data_t *slot = fsk ? &demod->fsk_pulse_data : &demod->pulse_data;
+    pulse_data_t own   = *slot;
+    *slot = *pulses;
+    if (demod->prefilter)
+        pulse_data_fingerprint(slot);
+    if (fsk)
+        run_fsk_demods_pool(NULL, demod, slot);
+    else
+        run_ook_demods_pool(NULL, demod, slot);
+    *slot = own;
+    return p->events;
+}
+
+unsigned r_pipeline_fields(data_t const *data, r_field_t *fields, unsigned size)
+{
+    unsigned n = 0;
+    for (data_t const *d = data; d; d = d->next, ++n) {
+        if (n >= size)
+            continue;
+        fields[n].key    = d->key;
+        fields[n].key_id = d->key_id;
+        fields[n].type   = d->type;
+        fields[n].value  = d->value;
+    }
+    return n;
+}
@@ -211,6 +211,27 @@ char *str_replace(char const *orig, char const *rep, char const *with)
     return result;
 }
 
+void str_replace_inplace(char *str, char const *rep, char const *with)
+{
+    size_t len_rep  = strlen(rep);
+    size_t len_with = strlen(with);
+    if (!len_rep || len_with > len_rep)
+        return;
+
+    // the output never overtakes the input as the replacement is not longer
+    char *dst       = str;
+    char const *src = str;
+    char const *ins;
+    while ((ins = strstr(src, rep))) {
+        memmove(dst, src, ins - src);
+        dst += ins - src;
+        memcpy(dst, with, len_with);
+        dst += len_with;
+        src = ins + len_rep;
+    }
+    memmove(dst, src, strlen(src) + 1);
+}
+
 // Make a more readable string for a frequency.
 char const *nice_freq (double freq)
 {
@@ -0,0 +1,216 @@
+/** @file
+    Pacing of file inputs to a speed factor of realtime or to a CPU bound.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "replay_pacer.h"
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef _TEST
+
+/// Monotonic clock in ns.
+static uint64_t monotonic_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/// Sleep until a monotonic time.
+static void sleep_until(uint64_t deadline_ns)
+{
+#if defined(_WIN32)
+    uint64_t now = monotonic_ns();
+    if (deadline_ns > now)
+        Sleep((DWORD)((deadline_ns - now + 999999) / 1000000));
+#elif defined(TIMER_ABSTIME) && !defined(__APPLE__)
+    struct timespec ts = {.tv_sec = (time_t)(deadline_ns / 1000000000), .tv_nsec = (long)(deadline_ns % 1000000000)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        // continue after a signal
+    }
+#else
+    // no absolute sleep, the deadline is still absolute
+    uint64_t now = monotonic_ns();
+    if (deadline_ns > now) {
+        uint64_t rel = deadline_ns - now;
+        struct timespec ts = {.tv_sec = (time_t)(rel / 1000000000), .tv_nsec = (long)(rel % 1000000000)};
+        while (nanosleep(&ts, &ts) && errno == EINTR) {
+            // continue after a signal
+        }
+    }
+#endif
+}
+
+#else
+
+// the test runs on a simulated clock, a sleep advances it to the deadline
+static uint64_t test_now_ns = 1000000000;
+static uint64_t test_slept_ns;
+static unsigned test_sleeps;
+
+static uint64_t monotonic_ns(void)
+{
+    return test_now_ns;
+}
+
+static void sleep_until(uint64_t deadline_ns)
+{
+    if (deadline_ns > test_now_ns) {
+        test_slept_ns += deadline_ns - test_now_ns;
+        test_now_ns = deadline_ns;
+    }
+    test_sleeps++;
+}
+
+#endif /* _TEST */
+
+void replay_pacer_start(replay_pacer_t *p, double speed, unsigned cpu_pct)
+{
+    *p = (replay_pacer_t){
+            .speed   = speed > 0.0 ? speed : 0.0,
+            .cpu_pct = cpu_pct < 100 ? cpu_pct : 0,
+    };
+    p->start_ns = monotonic_ns();
+    p->wake_ns  = p->start_ns;
+}
+
+void replay_pacer_wait(replay_pacer_t *p, uint64_t input_ns)
+{
+    uint64_t now = monotonic_ns();
+    p->busy_ns += now - p->wake_ns;
+    if (input_ns > p->input_ns)
+        p->input_ns = input_ns;
+
+    uint64_t deadline = 0;
+    if (p->speed > 0.0)
+        deadline = p->start_ns + (uint64_t)(p->input_ns / p->speed);
+    else if (p->cpu_pct)
+        deadline = p->start_ns + p->busy_ns * 100 / p->cpu_pct;
+
+    if (deadline > now)
+        sleep_until(deadline);
+    else if (deadline && now - deadline > p->late_ns)
+        p->late_ns = now - deadline;
+    p->wake_ns = monotonic_ns();
+}
+
+void replay_pacer_advance(replay_pacer_t *p, uint64_t n_samples, uint32_t sample_rate)
+{
+    if (!sample_rate)
+        return;
+    replay_pacer_wait(p, p->input_ns + n_samples * 1000000000 / sample_rate);
+}
+
+double replay_pacer_elapsed(replay_pacer_t const *p)
+{
+    return (monotonic_ns() - p->start_ns) * 1e-9;
+}
+
+double replay_pacer_rate(replay_pacer_t const *p)
+{
+    double elapsed = replay_pacer_elapsed(p);
+    return elapsed > 0.0 ? p->input_ns * 1e-9 / elapsed : 0.0;
+}
+
+#ifdef _TEST
+#include <stdio.h>
+
+#define ASSERT_TRUE(a) \
+    do { \
+        if (a) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s\n", #a); \
+        } \
+    } while (0)
+
+/// Spend a time processing.
+static void busy_for(uint64_t ns)
+{
+    test_now_ns += ns;
+}
+
+/// Restart the simulated clock counters.
+static void test_reset(void)
+{
+    test_slept_ns = 0;
+    test_sleeps   = 0;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    replay_pacer_t p;
+
+    fprintf(stderr, "replay_pacer:: 200 ms of input at 4x in 10 ms buffers with processing\n");
+    test_reset();
+    replay_pacer_start(&p, 4.0, 0);
+    for (int i = 0; i < 20; ++i) {
+        busy_for(1000000); // 1 ms of processing of a 2.5 ms budget
+        replay_pacer_advance(&p, 10000, 1000000);
+    }
+    ASSERT_TRUE(test_now_ns - p.start_ns == 50000000); // processing does not add up
+    ASSERT_TRUE(test_slept_ns == 30000000);
+    ASSERT_TRUE(test_sleeps == 20);
+    ASSERT_TRUE(p.late_ns == 0);
+    ASSERT_TRUE(replay_pacer_rate(&p) > 3.99 && replay_pacer_rate(&p) < 4.01);
+
+    fprintf(stderr, "replay_pacer:: a late buffer keeps the schedule\n");
+    test_reset();
+    replay_pacer_start(&p, 1.0, 0);
+    busy_for(30000000);
+    replay_pacer_advance(&p, 10000, 1000000); // 10 ms due, 30 ms late
+    ASSERT_TRUE(p.late_ns == 20000000);
+    ASSERT_TRUE(test_sleeps == 0);
+    replay_pacer_advance(&p, 40000, 1000000); // 50 ms due
+    ASSERT_TRUE(test_now_ns - p.start_ns == 50000000);
+    ASSERT_TRUE(test_slept_ns == 20000000);
+
+    fprintf(stderr, "replay_pacer:: unpaced with a 50%% CPU bound\n");
+    test_reset();
+    replay_pacer_start(&p, 0.0, 50);
+    for (int i = 0; i < 10; ++i) {
+        busy_for(3000000);
+        replay_pacer_advance(&p, 1000000, 1000000);
+    }
+    ASSERT_TRUE(test_now_ns - p.start_ns == 60000000); // 30 ms busy at 50%
+    ASSERT_TRUE(test_slept_ns == 30000000);
+    ASSERT_TRUE(p.busy_ns == 30000000);
+
+    fprintf(stderr, "replay_pacer:: unpaced\n");
+    test_reset();
+    replay_pacer_start(&p, 0.0, 0);
+    replay_pacer_advance(&p, 1000000, 1000000);
+    ASSERT_TRUE(test_sleeps == 0);
+    ASSERT_TRUE(replay_pacer_elapsed(&p) == 0.0);
+    ASSERT_TRUE(p.input_ns == 1000000000);
+
+    fprintf(stderr, "replay_pacer:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
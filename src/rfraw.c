@@ -11,6 +11,9 @@
 
 #include "rfraw.h"
 #include "fatal.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 static int hexstr_get_nibble(char const **p)
@@ -143,6 +146,7 @@ static bool parse_rfraw(pulse_data_t *data, char const **p)
         int w = hexstr_get_nibble(p);
         aligned = !aligned;
         if (w < 0) return false;
+        if (pulse_data_reserve(data, data->num_pulses + 1)) return false; // too many pulses
         if (w >= 8 || (oldfmt && !aligned)) { // pulse
             if (!pulse_needed) {
                 data->gap[data->num_pulses] = 0;
@@ -164,6 +168,7 @@ static bool parse_rfraw(pulse_data_t *data, char const **p)
 
     unsigned pkt_pulses = data->num_pulses - prev_pulses;
     for (int i = 1; i < repeats && data->num_pulses + pkt_pulses <= PD_MAX_PULSES; ++i) {
+        pulse_data_reserve(data, data->num_pulses + pkt_pulses);
         memcpy(&data->pulse[data->num_pulses], &data->pulse[prev_pulses], pkt_pulses * sizeof (*data->pulse));
         memcpy(&data->gap[data->num_pulses], &data->gap[prev_pulses], pkt_pulses * sizeof (*data->pulse));
         data->num_pulses += pkt_pulses;
@@ -193,3 +198,88 @@ bool rfraw_parse(pulse_data_t *data, char const *p)
     //pulse_data_print(data);
     return true;
 }
+
+#define RFRAW_TIMINGS 8
+
+/// Timings of an encoded package, a width joins a timing within 20% of its mean, as the analyzer groups.
+typedef struct {
+    unsigned count;
+    uint64_t sum[RFRAW_TIMINGS];
+    unsigned num[RFRAW_TIMINGS];
+} rfraw_timings_t;
+
+static int rfraw_timing(rfraw_timings_t *t, int width)
+{
+    if (width < 0)
+        width = 0;
+    for (unsigned i = 0; i < t->count; ++i) {
+        int mean = (int)(t->sum[i] / t->num[i]);
+        if (abs(width - mean) <= mean / 5) {
+            t->sum[i] += (unsigned)width;
+            t->num[i]++;
+            return (int)i;
+        }
+    }
+    if (t->count >= RFRAW_TIMINGS)
+        return -1;
+    t->sum[t->count] = (unsigned)width;
+    t->num[t->count] = 1;
+    return (int)t->count++;
+}
+
+static char *hexstr_put_byte(char *p, unsigned b)
+{
+    static char const hex[] = "0123456789ABCDEF";
+    *p++ = hex[(b >> 4) & 0xf];
+    *p++ = hex[b & 0xf];
+    return p;
+}
+
+size_t rfraw_encode(pulse_data_t const *data, char *buf, size_t size)
+{
+    // "AAB1", the timing count, a word per timing, a byte per pulse, "55"
+    if (!data->num_pulses || !data->sample_rate
+            || size < 6 + 4 * RFRAW_TIMINGS + 2 * (size_t)data->num_pulses + 3)
+        return 0;
+
+    // two passes, the timings first, then the codes with the final means
+    rfraw_timings_t t = {0};
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        if (rfraw_timing(&t, data->pulse[i]) < 0 || rfraw_timing(&t, data->gap[i]) < 0)
+            return 0;
+    }
+
+    double to_us = 1e6 / data->sample_rate;
+    char *p = buf;
+    p = hexstr_put_byte(p, 0xaa);
+    p = hexstr_put_byte(p, 0xb1);
+    p = hexstr_put_byte(p, t.count);
+    for (unsigned i = 0; i < t.count; ++i) {
+        double w = (double)t.sum[i] / t.num[i] * to_us;
+        unsigned us = w < USHRT_MAX ? (unsigned)(w + 0.5) : USHRT_MAX;
+        p = hexstr_put_byte(p, us >> 8);
+        p = hexstr_put_byte(p, us);
+    }
+    // the means moved while grouping, match each width to the nearest final mean
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        unsigned code = 0x80;
+        for (int k = 0; k < 2; ++k) {
+            int width = k ? data->gap[i] : data->pulse[i];
+            unsigned best = 0;
+            uint64_t best_diff = UINT64_MAX;
+            for (unsigned b = 0; b < t.count; ++b) {
+                int64_t diff = (int64_t)width * t.num[b] - (int64_t)t.sum[b];
+                uint64_t d = (uint64_t)(diff < 0 ? -diff : diff) / t.num[b];
+                if (d < best_diff) {
+                    best_diff = d;
+                    best      = b;
+                }
+            }
+            code |= k ? best : best << 4;
+        }
+        p = hexstr_put_byte(p, code);
+    }
+    p = hexstr_put_byte(p, 0x55);
+    *p = '\0';
+    return (size_t)(p - buf);
+}
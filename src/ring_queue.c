@@ -0,0 +1,148 @@
+/** @file
+    Bounded FIFO queue of fixed-size elements for passing data between threads.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "ring_queue.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ring_queue {
+    unsigned size;    ///< capacity in elements
+    size_t elem_size; ///< size of one element in bytes
+    unsigned head;    ///< next read position
+    unsigned len;     ///< number of queued elements
+    int closed;
+    ring_queue_stats_t stats;
+#ifdef THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t cond; ///< signaled on push and close
+#endif
+    unsigned char *elems;
+};
+
+#ifdef THREADS
+#define QUEUE_LOCK(q) pthread_mutex_lock(&(q)->lock)
+#define QUEUE_UNLOCK(q) pthread_mutex_unlock(&(q)->lock)
+#else
+#define QUEUE_LOCK(q)
+#define QUEUE_UNLOCK(q)
+#endif
+
+ring_queue_t *ring_queue_create(unsigned size, size_t elem_size)
+{
+    if (!size || !elem_size)
+        return NULL;
+
+    ring_queue_t *q = calloc(1, sizeof(*q));
+    if (!q) {
+        WARN_CALLOC("ring_queue_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    q->elems = calloc(size, elem_size);
+    if (!q->elems) {
+        WARN_CALLOC("ring_queue_create()");
+        free(q);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    q->size       = size;
+    q->elem_size  = elem_size;
+    q->stats.size = size;
+#ifdef THREADS
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+#endif
+    return q;
+}
+
+void ring_queue_free(ring_queue_t *q)
+{
+    if (!q)
+        return;
+#ifdef THREADS
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->cond);
+#endif
+    free(q->elems);
+    free(q);
+}
+
+int ring_queue_push(ring_queue_t *q, void const *elem)
+{
+    QUEUE_LOCK(q);
+    if (q->len >= q->size) {
+        q->stats.dropped++;
+        QUEUE_UNLOCK(q);
+        return -1;
+    }
+    unsigned pos = (q->head + q->len) % q->size;
+    memcpy(&q->elems[pos * q->elem_size], elem, q->elem_size);
+    int prev_len = q->len;
+    q->len++;
+    q->stats.pushed++;
+    if (q->len > q->stats.len_max)
+        q->stats.len_max = q->len;
+    QUEUE_UNLOCK(q);
+#ifdef THREADS
+    pthread_cond_signal(&q->cond);
+#endif
+    return prev_len;
+}
+
+int ring_queue_pop(ring_queue_t *q, void *elem, int wait)
+{
+    QUEUE_LOCK(q);
+#ifdef THREADS
+    while (wait && !q->len && !q->closed)
+        pthread_cond_wait(&q->cond, &q->lock);
+#else
+    (void)wait;
+#endif
+    if (!q->len) {
+        QUEUE_UNLOCK(q);
+        return -1;
+    }
+    memcpy(elem, &q->elems[q->head * q->elem_size], q->elem_size);
+    q->head = (q->head + 1) % q->size;
+    q->len--;
+    QUEUE_UNLOCK(q);
+    return 0;
+}
+
+unsigned ring_queue_clear(ring_queue_t *q)
+{
+    QUEUE_LOCK(q);
+    unsigned len = q->len;
+    q->head = 0;
+    q->len  = 0;
+    QUEUE_UNLOCK(q);
+    return len;
+}
+
+void ring_queue_close(ring_queue_t *q)
+{
+    QUEUE_LOCK(q);
+    q->closed = 1;
+    QUEUE_UNLOCK(q);
+#ifdef THREADS
+    pthread_cond_broadcast(&q->cond);
+#endif
+}
+
+void ring_queue_get_stats(ring_queue_t *q, ring_queue_stats_t *stats)
+{
+    QUEUE_LOCK(q);
+    *stats     = q->stats;
+    stats->len = q->len;
+    QUEUE_UNLOCK(q);
+}
@@ -27,6 +27,7 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <float.h>
 
 #include "rtl_433.h"
 #include "r_private.h"
@@ -39,20 +40,51 @@
 #include "pulse_detect_fsk.h"
 #include "pulse_slicer.h"
 #include "rfraw.h"
+#include "pulse_udp.h"
+#include "pulse_text.h"
+#include "event_merge.h"
 #include "data.h"
 #include "raw_output.h"
 #include "r_util.h"
 #include "optparse.h"
 #include "abuf.h"
 #include "fileformat.h"
+#include "file_input.h"
+#include "gated_iq.h"
+#include "sigmf.h"
 #include "samp_grab.h"
+#include "iq_snippet.h"
+#include "spectrum.h"
+#include "duty_sched.h"
+#include "decode_memo.h"
+#include "decode_pin.h"
+#include "decode_farm.h"
+#include "calibrate.h"
+#include "verify.h"
+#include "replay_pacer.h"
 #include "am_analyze.h"
 #include "confparse.h"
 #include "term_ctl.h"
 #include "compat_paths.h"
 #include "logger.h"
+#include "log_ring.h"
 #include "fatal.h"
 #include "write_sigrok.h"
+#include "dsp_thread.h"
+#include "worker_pool.h"
+#include "package_queue.h"
+#include "load_shed.h"
+#include "lag_shed.h"
+#include "cpu_stats.h"
+#include "trace.h"
+#include "file_sink.h"
+#include "hop_sched.h"
+#include "band_sched.h"
+#include "soft_agc.h"
+#include "thread_sched.h"
+#include "output_async.h"
+#include "output_filter.h"
+#include "dump_writer.h"
 #include "mongoose.h"
 
 #ifdef _WIN32
@@ -94,34 +126,6 @@
 #define usleep(us) Sleep((us) / 1000)
 #endif
 
-typedef struct timeval delay_timer_t;
-
-static void delay_timer_init(delay_timer_t *delay_timer)
-{
-    // set to current wall clock
-    get_time_now(delay_timer);
-}
-
-static void delay_timer_wait(delay_timer_t *delay_timer, unsigned delay_us)
-{
-    // sync to wall clock
-    struct timeval now_tv;
-    get_time_now(&now_tv);
-
-    time_t elapsed_s  = now_tv.tv_sec - delay_timer->tv_sec;
-    time_t elapsed_us = 1000000 * elapsed_s + now_tv.tv_usec - delay_timer->tv_usec;
-
-    // set next wanted start time
-    delay_timer->tv_usec += delay_us;
-    while (delay_timer->tv_usec > 1000000) {
-        delay_timer->tv_usec -= 1000000;
-        delay_timer->tv_sec += 1;
-    }
-
-    if ((time_t)delay_us > elapsed_us)
-        usleep(delay_us - elapsed_us);
-}
-
 r_device *flex_create_device(char *spec); // maybe put this in some header file?
 
 static void print_version(void)
@@ -151,15 +155,18 @@ static void usage(int exit_code)
             "  [-c <path>] Read config options from a file\n"
             "\t\t= Tuner options =\n"
             "  [-d <RTL-SDR USB device index> | :<RTL-SDR USB device serial> | <SoapySDR device query> | rtl_tcp | help]\n"
+            "       Repeat -d to add inputs, the -f, -H, -g, -p, -s, -t options following it apply to that input\n"
             "  [-g <gain> | help] (default: auto)\n"
             "  [-t <settings>] apply a list of keyword=value settings to the SDR device\n"
             "       e.g. for SoapySDR -t \"antenna=A,bandwidth=4.5M,rfnotch_ctrl=false\"\n"
             "       for RTL-SDR use \"direct_samp[=1]\", \"offset_tune[=1]\", \"digital_agc[=1]\", \"biastee[=1]\"\n"
             "  [-f <frequency>] Receive frequency(s) (default: %d Hz)\n"
-            "  [-H <seconds>] Hop interval for polling of multiple frequencies (default: %d seconds)\n"
+            "  [-H <seconds>] Hop interval for polling of multiple frequencies, e.g. 200ms (default: %d seconds)\n"
             "  [-p <ppm_error>] Correct rtl-sdr tuner frequency offset error (default: 0)\n"
             "  [-s <sample rate>] Set sample rate (default: %d Hz)\n"
-            "  [-D restart | pause | quit | manual] Input device run mode options.\n"
+            "  [-D restart | pause | quit | manual] Input device run mode options.\n",
+            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE);
+    term_help_fprintf(exit_code ? stderr : stdout,
             "\t\t= Demodulator options =\n"
             "  [-R <device> | help] Enable only the specified device decoding protocol (can be used multiple times)\n"
             "       Specify a negative number to disable a device decoding protocol (can be used multiple times)\n"
@@ -168,12 +175,61 @@ static void usage(int exit_code)
             "  [-Y level=<dB level>] Manual detection level used to determine pulses (-1.0 to -30.0) (0=auto).\n"
             "  [-Y minlevel=<dB level>] Manual minimum detection level used to determine pulses (-1.0 to -99.0).\n"
             "  [-Y minsnr=<dB level>] Minimum SNR to determine pulses (1.0 to 99.0).\n"
+            "  [-Y gatesnr=<dB level>] Skip the decoders on packages below this SNR (default: 0=off).\n"
+            "  [-Y prefilter] Skip the decoders whose pulse widths don't occur in the package.\n"
             "  [-Y autolevel] Set minlevel automatically based on average estimated noise.\n"
             "  [-Y squelch] Skip frames below estimated noise level to reduce cpu load.\n"
             "  [-Y ampest | magest] Choose amplitude or magnitude level estimator.\n"
+            "  [-Y fused] Demodulate AM and FM in a single pass (squelch then only skips clearly silent frames).\n"
+            "  [-Y fmpoly] Use a polynomial FM discriminator (more precise, faster with SIMD).\n"
+            "  [-Y decimate[=<n>]] Decimate high sample rates by n ahead of the demodulators (default: auto to 250 kHz).\n"
+            "  [-Y channelize] Demodulate all -f frequencies at once as channels of the capture instead of hopping.\n"
+            "  [-Y mimo] Stream an RX channel of the SoapySDR device for each -f frequency instead of hopping.\n");
+    term_help_fprintf(exit_code ? stderr : stdout,
+            "  [-Y latency=<ms>] Size the SDR buffers to hold <ms> of signal for lower latency (default: -b buffer size).\n"
+            "  [-Y mem_budget=<MB>] Shrink the SDR buffers until the sample buffers fit <MB>, for low memory devices.\n"
+            "  [-Y settle=<time>] Discard <time> of samples after a hop while the tuner settles (default: auto, measured).\n"
+            "  [-Y adaptive_hop] Hop to the frequencies by their activity and the learned report intervals of the sensors.\n"
+            "  [-Y band_scan[=<time>]] Scan the -f frequencies with the first input and tune the further inputs (-d)\n"
+            "       to the busy ones until quiet for <time> (default: 30 s, and 500 ms hops).\n"
+            "  [-Y fsktrack[=ppm]] Seed the FSK detectors from the offsets of recent packages, =ppm also corrects the tuner drift.\n"
+            "  [-Y decode_threads=<n>] Run the decoders of each package on <n> threads (default: 1).\n"
+            "  [-Y detect_ahead=<n>] Detect up to <n> packages ahead while a thread of its own decodes them (default: 0).\n"
+            "  [-Y package_budget=<ms>] [-Y second_budget=<ms>] Skip the fallback and flex decoders once a package,\n"
+            "       or a second of input, took this much decoder time (default: 0 for no limit).\n"
+            "  [-Y quiet_skip=<n>] Skip the decoders on packages of a source after <n> in a row decoded nothing.\n"
+            "  [-Y lag_skip=<ms>] Skip the quietest SDR buffers while the processing lags the input by more than <ms>.\n"
+            "  [-Y snippets[=<dir>]] Save the IQ samples of each package to a log in <dir> (default: rtl_433_iq),\n"
+            "       the events carry the snippet number as \"iq\", see \"/api/iq\" of the HTTP server.\n"
+            "  [-Y snippets_size=<MB>] [-Y snippet_margin=<ms>] Disk space of the snippet log (default: 64),\n"
+            "       and the samples saved before and after the pulses (default: 10).\n"
+            "  [-Y spectrum[=<bins>]] [-Y spectrum_interval=<time>] Compute an averaged spectrum of <bins> (default: 256)\n"
+            "       once per <time> of input (default: 1s), streamed to the HTTP server websocket, see \"spectrum\" RPC.\n"
+            "  [-Y duty[=<time>]] [-Y duty_margin=<time>] Learn the report intervals of the sensors for <time> (default: 10m),\n"
+            "       then stop the SDR between the expected reports, listening <time> before and after each (default: 0.5s).\n"
+            "  [-Y file_threads=<n>] Decode the -r files, or chunks of long files, on <n> threads in file order (default: 1).\n"
+            "  [-Y adaptive[=2]] Run the decoders by recent hits, =2 also stops after an exclusive decoder matched.\n"
+            "  [-Y memo[=<ms>]] Reuse the decode of a package repeating the bits of one within <ms> (default: 300).\n"
+            "  [-Y pin[=<model>:<id>]] Run the decoder that decoded a package fingerprint before alone, the others only if it fails,\n"
+            "       repeat for each known sensor to pin only their decoders, [-Y pin_only] drops the events of other sensors.\n"
+            "  [-Y farm=<host>[:<port>]] Decode the packages of -r udp:// on a worker reading -r farm:// (default port: 1436),\n"
+            "       repeat for each worker, the packages are sharded by fingerprint and the results output here in order.\n"
+            "  [-Y calibrate[=<file> | off]] Measure the fastest baseband kernels and block length, cache the choice in <file>\n"
+            "       (default: $XDG_CACHE_HOME/rtl_433/calibration), a live SDR input measures if none is cached, off keeps the defaults.\n"
+            "  [-Y sched_acquire | sched_dsp | sched_workers | sched_output=[<cpu>[-<cpu>]][:fifo|rr][:<prio>]]\n"
+            "       Pin the SDR acquire, DSP, worker, or async output threads to CPUs and set a real-time priority.\n"
+            "  [-Y mlock] Lock the sample buffers and the demod state into RAM.\n"
+            "  [-Y dump_async[=<MB>]] Write the -w/-W sample dumpers from a thread with a <MB> buffer (default: 32).\n"
+            "  [-Y dump_direct | dump_dontneed] Write the async dumpers with O_DIRECT, or drop the written data from the cache.\n");
+    // split in parts, C99 only guarantees 4095 chars per string literal
+    term_help_fprintf(exit_code ? stderr : stdout,
             "\t\t= Analyze/Debug options =\n"
             "  [-A] Pulse Analyzer. Enable pulse analysis and decode attempt.\n"
             "       Disable all decoders with -R 0 if you want analyzer output only.\n"
+            "  [-Y analyze_new] Pulse Analyzer on the first package of each new signal shape only, for busy live bands.\n"
+            "  [-Y verify[=<prefix>]] Run the scalar baseband and the reference decoding along, log the first divergence\n"
+            "       with a reproducer <prefix>_NNN.cu8 or .ook (default: verify), and report the speedup.\n"
+            "  [-Y discover] Cluster the packages no decoder takes by signal shape, see /api/discovery with -F http.\n"
             "  [-y <code>] Verify decoding of demodulated test data (e.g. \"{25}fb2dd58\") with enabled devices\n"
             "\t\t= File I/O options =\n"
             "  [-S none | all | unknown | known] Signal auto save. Creates one file per signal.\n"
@@ -182,18 +238,17 @@ static void usage(int exit_code)
             "  [-w <filename> | help] Save data stream to output file (a '-' dumps samples to stdout)\n"
             "  [-W <filename> | help] Save data stream to output file, overwrite existing file\n"
             "\t\t= Data output options =\n"
-            "  [-F log | kv | json | csv | mqtt | influx | syslog | trigger | null | help] Produce decoded output in given format.\n"
+            "  [-F log | kv | json | csv | cbor | mqtt | influx | syslog | udp | trigger | rfraw | pls | shm | eventlog | null | help] Produce decoded output in given format.\n"
             "       Append output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
             "       Specify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
-            "  [-M time[:<options>] | protocol | level | noise[:<secs>] | stats | bits | help] Add various meta data to each output.\n"
+            "  [-M time[:<options>] | protocol | level | noise[:<secs>] | stats | dedup[:<ms>] | bits | help] Add various meta data to each output.\n"
             "  [-K FILE | PATH | <tag> | <key>=<tag>] Add an expanded token or fixed tag to every output line.\n"
             "  [-C native | si | customary] Convert units in decoded output.\n"
             "  [-n <value>] Specify number of samples to take (each sample is an I/Q pair)\n"
             "  [-T <seconds>] Specify number of seconds to run, also 12:34 or 1h23m45s\n"
             "  [-E hop | quit] Hop/Quit after outputting successful event(s)\n"
             "  [-h] Output this usage help and exit\n"
-            "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n",
-            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE);
+            "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n");
     exit(exit_code);
 }
 
@@ -238,8 +293,17 @@ static void help_device_selection(void)
             "  [-d \"\"] Open default SoapySDR device\n"
             "  [-d driver=rtlsdr] Open e.g. specific SoapySDR device\n"
             "\tTo set gain for SoapySDR use -g ELEM=val,ELEM=val,... e.g. -g LNA=20,TIA=8,PGA=2 (for LimeSDR).\n"
-            "  [-d rtl_tcp[:[//]host[:port]] (default: localhost:1234)\n"
-            "\tSpecify host/port to connect to with e.g. -d rtl_tcp:127.0.0.1:1234\n");
+            "  [-d rtl_tcp[:[//]host[:port]][,rcvbuf=<bytes>][,readahead=<bytes>][,reconnect=<n>][,timeout=<s>][,compress[=lossless]] (default: localhost:1234)\n"
+            "\tSpecify host/port to connect to with e.g. -d rtl_tcp:127.0.0.1:1234\n"
+            "\tUse rcvbuf to set the socket receive buffer (default: system), readahead to read ahead\n"
+            "\tof the demodulation (default: 0), reconnect for the number of reconnect attempts (default: 5),\n"
+            "\ttimeout for the time without data until the connection is considered lost (default: 1 s),\n"
+            "\tand compress to ask a rtl_433 server for a squelched and coded stream, or a lossless coded stream only.\n"
+            "\tRepeat -d to run several inputs at once, e.g. -d 0 -f 433.92M -d 1 -f 868.3M -s 1024k\n"
+            "\tEach further input starts from the default tuner options, the -f, -H, -g, -p, -s, -t options\n"
+            "\tfollowing its -d apply to it. All inputs share the decoders and outputs, events are tagged\n"
+            "\twith the \"input\" they were received on. The dumpers, the analyzer, raw outputs, and the\n"
+            "\tHTTP API control only use the first input.\n");
     exit(0);
 }
 
@@ -251,7 +315,10 @@ static void help_gain(void)
             "  [-g <gain>] (default: auto)\n"
             "\tFor RTL-SDR: gain in dB (\"0\" is auto).\n"
             "\tFor SoapySDR: gain in dB for automatic distribution (\"\" is auto), or string of gain elements.\n"
-            "\tE.g. \"LNA=20,TIA=8,PGA=2\" for LimeSDR.\n");
+            "\tE.g. \"LNA=20,TIA=8,PGA=2\" for LimeSDR.\n"
+            "  [-g agc[=<gain>]] software gain control, starts at the gain or 20 dB.\n"
+            "\tLowers the gain 3 dB when samples clip, raises it 3 dB with 18 dB headroom.\n"
+            "\tThe gain only changes between packages.\n");
     exit(0);
 }
 
@@ -275,18 +342,27 @@ static void help_output(void)
 {
     term_help_fprintf(stdout,
             "\t\t= Output format option =\n"
-            "  [-F log|kv|json|csv|mqtt|influx|syslog|trigger|null] Produce decoded output in given format.\n"
+            "  [-F log|kv|json|csv|cbor|mqtt|influx|syslog|udp|trigger|rfraw|pls|null] Produce decoded output in given format.\n"
             "\tWithout this option the default is LOG and KV output. Use \"-F null\" to remove the default.\n"
             "\tAppend output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
+            "\tFile outputs (log, kv, json, csv, cbor) write from a worker thread with \",async[=<n>]\" (e.g. -F csv,async:log.csv),\n"
+            "\t  queuing up to n records (default 256), so a slow disk or terminal does not delay the decoding\n"
+            "\tFile outputs flush each record, \",flush=<size>|<time>\" groups records (e.g. -F json,flush=64k,flush=1s:log.json),\n"
+            "\t  \",sync=<time>\" adds an fdatasync(), \",rotate=daily|<size>\" renames the file to <filename>.<time opened>\n"
+            "\tThe CSV output writes a column per field of all decoders, add \",sparse\" to grow the header with the fields seen\n"
+            "\t  or \",long\" for a row per value (event, key, value), e.g. -F csv,long:log.csv\n"
             "\tSpecify MQTT server with e.g. -F mqtt://localhost:1883\n"
             "\tAdd MQTT options with e.g. -F \"mqtt://host:1883,opt=arg\"\n"
-            "\tMQTT options are: user=foo, pass=bar, retain[=0|1], <format>[=topic]\n"
+            "\tMQTT options are: user=foo, pass=bar, retain[=0|1], cbor[=0|1], <format>[=topic]\n"
+            "\t  batch[=<ms>], batch_size=<bytes>: coalesce the device info posts, only the latest value of a topic is sent\n"
+            "\t  queue_size=<bytes>: messages are queued while disconnected, default 4 MiB, see the \"outputs\" stats\n"
             "\tDefault user and password are read from MQTT_USERNAME and MQTT_PASSWORD env vars.\n"
             "\tA base topic can be set with base=<topic>, default is \"rtl_433/HOSTNAME\".\n"
             "\tSupported MQTT formats: (default is all)\n"
             "\t  events: posts JSON event data\n"
             "\t  states: posts JSON state data\n"
             "\t  devices: posts device and sensor info in nested topics\n"
+            "\t  sensors: posts the last event of each sensor retained, not in the default, sensors_max=<n> (default 256)\n"
             "\tAny topic string overrides the base topic and will expand keys like [/model]\n"
             "\tE.g. -F \"mqtt://localhost:1883,user=USERNAME,pass=PASSWORD,retain=0,devices=rtl_433[/id]\"\n"
             "\tWith MQTT each rtl_433 instance needs a distinct driver selection. The MQTT Client-ID is computed from the driver string.\n"
@@ -294,7 +370,33 @@ static void help_output(void)
             "\tSpecify InfluxDB 2.0 server with e.g. -F \"influx://localhost:9999/api/v2/write?org=<org>&bucket=<bucket>,token=<authtoken>\"\n"
             "\tSpecify InfluxDB 1.x server with e.g. -F \"influx://localhost:8086/write?db=<db>&p=<password>&u=<user>\"\n"
             "\t  Additional parameter -M time:unix:usec:utc for correct timestamps in InfluxDB recommended\n"
-            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n");
+            "\tInfluxDB options: batch[=<ms>] and batch_size=<bytes> to post at an interval or size, buffers=<n> (default 8),\n"
+            "\t  gzip to compress posts, precision=s|ms|us|ns for the timestamps (default ns)\n");
+    // split in parts, C99 only guarantees 4095 chars per string literal
+    term_help_fprintf(stdout,
+            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
+            "\tThe cbor format writes a CBOR sequence (RFC 8742) of one map per event, e.g. -F cbor:events.cbor\n"
+            "\tSpecify host/port for CBOR datagrams with e.g. -F udp:127.0.0.1:1433, one event per datagram\n"
+            "\tSyslog and UDP options: batch[=<ms>] (default 100) and batch_size=<n> (max 64) to send datagrams in batches,\n"
+            "\t  pack[=<bytes>] to pack events into datagrams up to that size (default 1472), newline separated for syslog\n"
+            "\tWith MQTT the cbor option posts CBOR instead of JSON to the events and states topics.\n"
+            "\tAny event output takes \",aggregate=<time>\" to print one record per sensor (model, id, channel) and window,\n"
+            "\t  with the last, min, max, and mean of each numeric field, e.g. -F \"influx://host:8086/write?db=<db>,aggregate=60s\"\n"
+            "\tAny event output takes \",delta[=<deadband>]\" to only print the events of a sensor that changed by more than\n"
+            "\t  the deadband, \",heartbeat=<time>\" prints unchanged sensors anyway (default 10m, 0 for never)\n"
+            "\tAny event output takes \",filter=<expr>\" to only print the matching events, e.g. -F \"json,filter=model~Acurite*&&rssi>-20\",\n"
+            "\t  compare fields with = != < <= > >=, globs with ~ !~, a key alone tests the field, combine with && || ! ( )\n"
+            "\tAny event output takes \",fields=[<model>/]<key>[+<key>...]\" to only print those fields, \",exclude=...\" to skip fields,\n"
+            "\t  repeat for more models, a trailing * on the model is a prefix, e.g. -F \"udp:host:1433,fields=model+id+temperature_C\"\n"
+            "\tThe rfraw output writes the raw pulses instead of the pulse data events, an RfRaw code per package\n"
+            "\t  with a comment header (the .ook pulse list if there are more than 8 timings), e.g. -F rfraw,unknown:raw.ook\n"
+            "\t  for the packages no decoder takes (all, unknown, or known, default all), read back with -r raw.ook\n"
+            "\tThe pls output sends every package in the binary pulse format to a remote rtl_433 that decodes,\n"
+            "\t  e.g. -F pls:192.168.1.10:1435 on the receiver and -r udp://0.0.0.0:1435 on the decoding host\n"
+            "\tThe shm output writes the events to a ring in POSIX shared memory for local readers, see shm_ring.h,\n"
+            "\t  e.g. -F shm:rtl_433,cbor,size=4M (default rtl_433, JSON, and 1M), readers see lost events as sequence gaps\n"
+            "\tThe eventlog output appends the events to memory-mapped segment files for replay, see event_log.h,\n"
+            "\t  e.g. -F eventlog:/var/lib/rtl_433,segment=64M,segments=16 (default rtl_433_events, 16M, and 8 segments)\n");
     exit(0);
 }
 
@@ -315,7 +417,11 @@ static void help_tags(void)
             "\tAlso <tag> can be a generic tcp address, e.g.\n"
             "\t\t\"-K foo=tcp:localhost:4000\" (read lines as TCP client)\n"
             "\t\t\"-K bar=tcp://127.0.0.1:3000,init='subscribe tags\\r\\n'\"\n"
-            "\t\t\"-K baz=tcp://127.0.0.1:5000,filter='a prefix to match'\"\n");
+            "\t\t\"-K baz=tcp://127.0.0.1:5000,filter='a prefix to match'\"\n"
+            "\tOr <tag> can be a map file of sensors, the columns or keys other than model, id, channel are added, e.g.\n"
+            "\t\t\"-K map:sensors.csv\" (a CSV with a header line, e.g. \"model,id,channel,room\")\n"
+            "\t\t\"-K loc=map:sensors.json\" (a JSON array of objects, in loc object)\n"
+            "\tA map entry without channel matches any channel, changes to the file are reloaded.\n");
     exit(0);
 }
 
@@ -324,7 +430,7 @@ static void help_meta(void)
 {
     term_help_fprintf(stdout,
             "\t\t= Meta information option =\n"
-            "  [-M time[:<options>]|protocol|level|noise[:<secs>]|stats|bits] Add various metadata to every output line.\n"
+            "  [-M time[:<options>]|protocol|level|noise[:<secs>]|stats|dedup[:<ms>]|bits] Add various metadata to every output line.\n"
             "\tUse \"time\" to add current date and time meta data (preset for live inputs).\n"
             "\tUse \"time:rel\" to add sample position meta data (preset for read-file and stdin).\n"
             "\tUse \"time:unix\" to show the seconds since unix epoch as time meta data. This is always UTC.\n"
@@ -335,12 +441,19 @@ static void help_meta(void)
             "\tUse \"time:utc\" to output time in UTC.\n"
             "\t\t(this may also be accomplished by invocation with TZ environment variable set).\n"
             "\t\t\"usec\" and \"utc\" can be combined with other options, eg. \"time:iso:utc\" or \"time:unix:usec\".\n"
-            "\tUse \"replay[:N]\" to replay file inputs at (N-times) realtime.\n"
+            "\tUse \"replay[:N]\" to replay file inputs at (N-times, fractions allowed) realtime.\n"
+            "\tUse \"replay:<P>%%\" to replay file inputs as fast as possible using at most P percent CPU time.\n"
             "\tUse \"protocol\" / \"noprotocol\" to output the decoder protocol number meta data.\n"
             "\tUse \"level\" to add Modulation, Frequency, RSSI, SNR, and Noise meta data.\n"
             "\tUse \"noise[:<secs>]\" to report estimated noise level at intervals (default: 10 seconds).\n"
             "\tUse \"stats[:[<level>][:<interval>]]\" to report statistics (default: 600 seconds).\n"
             "\t  level 0: no report, 1: report successful devices, 2: report active devices, 3: report all\n"
+            "\tUse \"dedup[:<ms>]\" to drop events repeating a recent event of the same decoder within a window (default: 1000 ms).\n"
+            "\t  The stats report the dropped repeats as \"duplicates\", use \"nodedup\" to output all events.\n"
+            "\tUse \"merge[:<ms>]\" to output the copies of an event heard by several receivers (-r udp://) once,\n"
+            "\t  with the best RSSI and a \"receivers\" list, after the window (default: 1000 ms). Replaces \"dedup\".\n"
+            "\tUse \"cputime\" to add the CPU time of the processing stages, decoders, and outputs to the statistics.\n"
+            "\tUse \"trace\" to record the hot path events, SIGUSR2 writes them to " TRACE_DUMP_FILE " (Chrome trace JSON).\n"
             "\tUse \"bits\" to add bit representation to code outputs (for debug).\n");
     exit(0);
 }
@@ -357,13 +470,22 @@ static void help_read(void)
             "\tA sample rate is detected as (fractional) number suffixed with 'k',\n"
             "\t'sps', 'ksps', 'Msps', or 'Gsps'.\n\n"
             "\tFile content and format are detected as parameters, possible options are:\n"
-            "\t'cu8', 'cs16', 'cf32' ('IQ' implied), and 'am.s16'.\n\n"
+            "\t'cu8', 'cs16', 'cf32' ('IQ' implied), 'am.s16', the gated 'giq',\n"
+            "\tthe pulse data 'ook' and 'pls', and a SigMF 'sigmf-meta' or 'sigmf-data'.\n\n"
             "\tParameters must be separated by non-alphanumeric chars and are case-insensitive.\n"
             "\tOverrides can be prefixed, separated by colon (':')\n\n"
             "\tE.g. default detection by extension: path/filename.am.s16\n"
             "\tforced overrides: am:s16:path/filename.ext\n\n"
             "\tReading from pipes also support format options.\n"
-            "\tE.g reading complex 32-bit float: CU32:-\n");
+            "\tE.g reading complex 32-bit float: CU32:-\n\n"
+            "\tThe pulse packages of remote receivers (-F pls) are read with udp://[<host>]:<port>,\n"
+            "\tthe events are tagged with the address of the sending receiver, stop with Ctrl-C.\n"
+            "\tE.g. listening on all interfaces: udp://0.0.0.0:1435\n\n"
+            "\tA decode worker reads the packages of its coordinator (-Y farm) with farm://[<host>]:<port>,\n"
+            "\tthe output is sent back to the coordinator, stop with Ctrl-C. E.g. farm://0.0.0.0:1436\n\n"
+            "\tThe text lines of gateways, pulse timings in us, RfRaw codes, or bit rows ({25}fb2dd58),\n"
+            "\tare read from a serial device or pipe with text:<path> or from a gateway with tcp://<host>:<port>.\n"
+            "\tE.g. text:- or text:/dev/ttyUSB0 (set the baud rate with stty), tcp://192.168.1.20:7072\n");
     exit(0);
 }
 
@@ -378,7 +500,11 @@ static void help_write(void)
             "\tFile content and format are detected as parameters, possible options are:\n"
             "\t'cu8', 'cs8', 'cs16', 'cf32' ('IQ' implied),\n"
             "\t'am.s16', 'am.f32', 'fm.s16', 'fm.f32',\n"
-            "\t'i.f32', 'q.f32', 'logic.u8', 'ook', and 'vcd'.\n\n"
+            "\t'i.f32', 'q.f32', 'logic.u8', 'ook', 'pls', and 'vcd'.\n"
+            "\tA 'giq' file keeps the 'cu8' or 'cs16' IQ buffers with a signal only.\n"
+            "\tA 'pls' file keeps the pulse data in a compact binary format.\n"
+            "\tA 'sigmf' dataset writes the 'cu8', 'cs8', 'cs16', or 'cf32' IQ samples\n"
+            "\tto '.sigmf-data' and the metadata with the decoded packages to '.sigmf-meta'.\n\n"
             "\tParameters must be separated by non-alphanumeric chars and are case-insensitive.\n"
             "\tOverrides can be prefixed, separated by colon (':')\n\n"
             "\tE.g. default detection by extension: path/filename.am.s16\n"
@@ -386,41 +512,81 @@ static void help_write(void)
     exit(0);
 }
 
-static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
+/// Pulse detector FM source, demodulates only the spans evaluated for packages.
+static unsigned fm_lazy_fill(void *ctx, unsigned end)
 {
-    //fprintf(stderr, "sdr_callback... %u\n", len);
-    r_cfg_t *cfg = ctx;
-    struct dm_state *demod = cfg->demod;
-    char time_str[LOCAL_TIME_BUFLEN];
-    unsigned long n_samples;
-
-    if (!demod) {
-        // might happen when the demod closed and we get a last data frame
-        return; // ignore the data
-    }
-
-    // do this here and not in sdr_handler so realtime replay can use rtl_tcp output
-    for (void **iter = cfg->raw_handler.elems; iter && *iter; ++iter) {
-        raw_output_t *output = *iter;
-        raw_output_frame(output, iq_buf, len);
-    }
-
-    if ((cfg->bytes_to_read > 0) && (cfg->bytes_to_read <= len)) {
-        len = cfg->bytes_to_read;
-        cfg->exit_async = 1;
-    }
+    return baseband_demod_FM_lazy(ctx, end);
+}
 
-    // save last frame time to see if a new second started
-    time_t last_frame_sec = demod->now.tv_sec;
-    get_time_now(&demod->now);
+/// One channel of one buffer, carried from demodulation to decoding.
+typedef struct demod_job {
+    r_cfg_t *cfg;
+    struct dm_state *demod;
+    unsigned char *iq_buf;   ///< input samples, the decimated samples after demodulation
+    uint32_t len;            ///< input length in bytes
+    unsigned long n_samples; ///< demodulated samples, 0 if there is nothing to decode
+    uint32_t samp_rate;      ///< demodulated sample rate
+    unsigned decim_factor;   ///< decimation factor, 0 if not decimated
+    unsigned fpdm;           ///< FSK pulse detector mode
+    db_level_t avg_db;       ///< average signal level
+    int noise_only;          ///< the buffer is noise only
+    int level_changed;       ///< the auto level adjusted the minimum detection level
+    int process_frame;       ///< the buffer is not squelched
+    int fm_lazy;             ///< FM is demodulated on demand
+    int decode;              ///< pulse detection and decoders are in use
+    int package_type;        ///< detected package waiting to be decoded, 0 if none
+    int d_events;            ///< sensor events successfully detected
+} demod_job_t;
+
+/// Detect the next package of a channel.
+static void sdr_detect(demod_job_t *job)
+{
+    struct dm_state *demod = job->demod;
+    uint64_t start = cpu_stats_start();
+    job->package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, job->n_samples, job->samp_rate,
+            job->cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, job->fpdm);
+    cpu_stats_end(&demod->cpu_stages[CPU_STAGE_DETECT], start);
+}
 
-    n_samples = len / demod->sample_size;
-    if (n_samples * demod->sample_size != len) {
-        print_log(LOG_WARNING, __func__, "Sample buffer length not aligned to sample size!");
-    }
-    if (!n_samples) {
-        print_log(LOG_WARNING, __func__, "Sample buffer too short!");
-        return; // keep the watchdog timer running
+/// Demodulate a channel and detect the first package, only touches this channel so channels can run in parallel.
+static void sdr_demod(demod_job_t *job)
+{
+    r_cfg_t *cfg = job->cfg;
+    struct dm_state *demod = job->demod;
+    unsigned char *iq_buf = job->iq_buf;
+    uint32_t len = job->len;
+    unsigned long n_samples = job->n_samples;
+    job->n_samples = 0;
+
+    // Decimate ahead of the demodulators, all sample positions from here on are decimated
+    unsigned decim_factor = demod->decimation < 0 ? cfg->samp_rate / DEFAULT_SAMPLE_RATE : (unsigned)demod->decimation;
+    if (decim_factor > DECIM_MAX_FACTOR)
+        decim_factor = DECIM_MAX_FACTOR;
+    // a channel is always mixed down to the center of a decimated band, an RX channel is tuned to it
+    if (demod->frequency && !cfg->mimo && decim_factor < 2)
+        decim_factor = 2;
+    // dumpers and analyzers want the full rate, demodulated input formats can't be decimated
+    if (decim_factor < 2 || demod->dumper.len || demod->am_analyze
+            || demod->load_info.format == S16_AM || demod->load_info.format == S16_FM)
+        decim_factor = 0;
+    if (decim_factor != demod->decimator.factor)
+        baseband_decimator_init(&demod->decimator, decim_factor);
+    if (demod->frequency && !cfg->mimo)
+        baseband_decimator_set_shift(&demod->decimator, (int32_t)(demod->frequency - cfg->center_frequency), cfg->samp_rate);
+    uint32_t samp_rate = cfg->samp_rate;
+    if (decim_factor) {
+        // channels keep the IQ buffer intact for the other channels
+        unsigned char *out_buf = demod->channel_buf ? demod->channel_buf : iq_buf;
+        uint64_t start = cpu_stats_start();
+        if (demod->sample_size == 2) // CU8
+            n_samples = baseband_decimate_cu8(iq_buf, out_buf, n_samples, &demod->decimator);
+        else // CS16
+            n_samples = baseband_decimate_cs16((int16_t *)iq_buf, (int16_t *)out_buf, n_samples, &demod->decimator);
+        cpu_stats_end(&demod->cpu_stages[CPU_STAGE_DECIMATE], start);
+        samp_rate = cfg->samp_rate / decim_factor;
+        iq_buf = out_buf;
+        if (!n_samples)
+            return; // nothing to demodulate, and nothing to decode
     }
 
     // age the frame position if there is one
@@ -429,171 +595,558 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
     if (demod->frame_end_ago)
         demod->frame_end_ago += n_samples;
 
-    cfg->watchdog++; // reset the frame acquire watchdog
+    // Select the correct fsk pulse detector
+    unsigned fpdm = cfg->fsk_pulse_detect_mode;
+    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO) {
+        uint32_t frequency = demod->frequency ? demod->frequency : cfg->frequency[cfg->frequency_index];
+        if (frequency > FSK_PULSE_DETECTOR_LIMIT)
+            fpdm = FSK_PULSE_DETECT_NEW;
+        else
+            fpdm = FSK_PULSE_DETECT_OLD;
+    }
+    float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
 
-    if (demod->samp_grab) {
-        samp_grab_push(demod->samp_grab, iq_buf, len);
+    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
+    int always_process = demod->squelch_offset <= 0 || demod->load_info.format || demod->analyze_pulses || cfg->discovery || demod->dumper.len || demod->samp_grab;
+
+    if (demod->min_level_auto == 0) {
+        demod->min_level_auto = DB_LEVEL(demod->min_level);
+    }
+    if (demod->noise_level == 0) {
+        demod->noise_level = demod->min_level_auto - DB_LEVEL(3.0f);
     }
 
+    // the verify mode compares the first channel with the scalar code
+    verify_t *verify = cfg->verify && demod == (cfg->channels.len ? cfg->channels.elems[0] : cfg->demod) ? cfg->verify : NULL;
+    if (verify)
+        verify_frame_begin(verify, &demod->lowpass_filter_state, &demod->demod_FM_state);
+
     // AM demodulation
-    float avg_db;
-    if (demod->sample_size == 2) { // CU8
+    db_level_t avg_db;
+    int prescan_squelch = 0;
+    uint64_t start = cpu_stats_start();
+    if (!always_process && !demod->am_analyze) {
+        // a cheap level estimate first, a clearly silent frame then skips all demodulation
+        if (demod->sample_size == 2) // CU8
+            avg_db = baseband_level_estimate_cu8(iq_buf, n_samples, demod->use_mag_est, SQUELCH_PRESCAN_STRIDE);
+        else // CS16
+            avg_db = baseband_level_estimate_cs16((int16_t *)iq_buf, n_samples, SQUELCH_PRESCAN_STRIDE);
+        prescan_squelch = avg_db < demod->noise_level + DB_LEVEL(3.0f) - DB_LEVEL(SQUELCH_PRESCAN_MARGIN);
+    }
+    if (prescan_squelch) {
+        // the filter and FM states carry over as on any squelched frame
+    } else if (demod->use_fused_demod) {
+        // AM, low pass, and FM in one pass, only the pre-scan can skip work on squelched frames
+        int16_t *fm_buf = demod->enable_FM_demod ? demod->buf.fm : NULL;
+        if (demod->sample_size == 2) { // CU8
+            avg_db = baseband_demod_fused_cu8(iq_buf, demod->am_buf, fm_buf, n_samples, demod->use_mag_est,
+                    &demod->lowpass_filter_state, samp_rate, low_pass, &demod->demod_FM_state);
+        } else { // CS16
+            avg_db = baseband_demod_fused_cs16((int16_t *)iq_buf, demod->am_buf, fm_buf, n_samples,
+                    &demod->lowpass_filter_state, samp_rate, low_pass, &demod->demod_FM_state);
+        }
+    } else if (always_process) {
+        // AM and low pass in cache sized tiles, FM stays on demand
+        if (demod->sample_size == 2) { // CU8
+            avg_db = baseband_demod_fused_cu8(iq_buf, demod->am_buf, NULL, n_samples, demod->use_mag_est,
+                    &demod->lowpass_filter_state, samp_rate, low_pass, &demod->demod_FM_state);
+        } else { // CS16
+            avg_db = baseband_demod_fused_cs16((int16_t *)iq_buf, demod->am_buf, NULL, n_samples,
+                    &demod->lowpass_filter_state, samp_rate, low_pass, &demod->demod_FM_state);
+        }
+    } else if (demod->sample_size == 2) { // CU8
+        // the envelope goes to am_buf, the low pass then runs in place unless the frame is squelched
+        uint16_t *env_buf = (uint16_t *)demod->am_buf;
         if (demod->use_mag_est) {
-            //magnitude_true_cu8(iq_buf, demod->buf.temp, n_samples);
-            avg_db = magnitude_est_cu8(iq_buf, demod->buf.temp, n_samples);
+            //magnitude_true_cu8(iq_buf, env_buf, n_samples);
+            avg_db = magnitude_est_cu8(iq_buf, env_buf, n_samples);
         }
         else { // amp est
-            avg_db = envelope_detect(iq_buf, demod->buf.temp, n_samples);
+            avg_db = envelope_detect(iq_buf, env_buf, n_samples);
         }
     } else { // CS16
-        //magnitude_true_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
-        avg_db = magnitude_est_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
+        //magnitude_true_cs16((int16_t *)iq_buf, (uint16_t *)demod->am_buf, n_samples);
+        avg_db = magnitude_est_cs16((int16_t *)iq_buf, (uint16_t *)demod->am_buf, n_samples);
     }
+    cpu_stats_end(&demod->cpu_stages[CPU_STAGE_ENVELOPE], start);
 
     //fprintf(stderr, "noise level: %.1f dB current: %.1f dB min level: %.1f dB\n", demod->noise_level, avg_db, demod->min_level_auto);
-    if (demod->min_level_auto == 0.0f) {
-        demod->min_level_auto = demod->min_level;
-    }
-    if (demod->noise_level == 0.0f) {
-        demod->noise_level = demod->min_level_auto - 3.0f;
-    }
-    int noise_only = avg_db < demod->noise_level + 3.0f; // or demod->min_level_auto?
-    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
-    int process_frame = demod->squelch_offset <= 0 || !noise_only || demod->load_info.format || demod->analyze_pulses || demod->dumper.len || demod->samp_grab;
-    cfg->total_frames_count += 1;
+    int noise_only = avg_db < demod->noise_level + DB_LEVEL(3.0f); // or demod->min_level_auto?
+    int process_frame = always_process || !noise_only;
     if (noise_only) {
-        cfg->total_frames_squelch += 1;
         demod->noise_level = (demod->noise_level * 7 + avg_db) / 8; // fast fall over 8 frames
         // If auto_level and noise level well below min_level and significant change in noise level
-        if (demod->auto_level > 0 && demod->noise_level < demod->min_level - 3.0f
-                && fabsf(demod->min_level_auto - demod->noise_level - 3.0f) > 1.0f) {
-            demod->min_level_auto = demod->noise_level + 3.0f;
-            print_logf(LOG_WARNING, "Auto Level", "Estimated noise level is %.1f dB, adjusting minimum detection level to %.1f dB",
-                    demod->noise_level, demod->min_level_auto);
-            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level_auto, demod->min_snr, demod->detect_verbosity);
+        db_level_t level_change = demod->min_level_auto - demod->noise_level - DB_LEVEL(3.0f);
+        if (demod->auto_level > 0 && demod->noise_level < DB_LEVEL(demod->min_level - 3.0f)
+                && (level_change > DB_LEVEL(1.0f) || level_change < DB_LEVEL(-1.0f))) {
+            demod->min_level_auto = demod->noise_level + DB_LEVEL(3.0f);
+            job->level_changed = 1;
+            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, DB_LEVEL_FLOAT(demod->min_level_auto), demod->min_snr, demod->detect_verbosity);
         }
     } else {
         demod->noise_level = (demod->noise_level * 31 + avg_db) / 32; // slow rise over 32 frames
     }
-    // Report noise every report_noise seconds, but only for the first frame that second
-    if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
-        print_logf(LOG_WARNING, "Auto Level", "Current %s level %.1f dB, estimated noise %.1f dB",
-                noise_only ? "noise" : "signal", avg_db, demod->noise_level);
-    }
 
-    if (process_frame) {
-        baseband_low_pass_filter(demod->buf.temp, demod->am_buf, n_samples, &demod->lowpass_filter_state);
+    if (process_frame && !demod->use_fused_demod && !always_process) {
+        start = cpu_stats_start();
+        baseband_low_pass_filter((uint16_t *)demod->am_buf, demod->am_buf, n_samples, &demod->lowpass_filter_state);
+        cpu_stats_end(&demod->cpu_stages[CPU_STAGE_LOWPASS], start);
     }
 
-    // FM demodulation
-    // Select the correct fsk pulse detector
-    unsigned fpdm = cfg->fsk_pulse_detect_mode;
-    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO) {
-        if (cfg->frequency[cfg->frequency_index] > FSK_PULSE_DETECTOR_LIMIT)
-            fpdm = FSK_PULSE_DETECT_NEW;
-        else
-            fpdm = FSK_PULSE_DETECT_OLD;
+    // FM demodulation, on demand unless the whole FM buffer is needed
+    int fm_demod = demod->enable_FM_demod && process_frame && !demod->use_fused_demod;
+    int fm_lazy  = fm_demod && demod->load_info.format != S16_FM;
+    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        if (dumper->format == S16_FM || dumper->format == F32_FM)
+            fm_lazy = 0;
     }
-
-    if (demod->enable_FM_demod && process_frame) {
-        float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
+    pulse_detect_set_fm_source(demod->pulse_detect, fm_lazy ? fm_lazy_fill : NULL, &demod->demod_FM_lazy);
+    if (fm_lazy) {
+        baseband_demod_FM_lazy_start(&demod->demod_FM_lazy, iq_buf, demod->sample_size == 4, demod->buf.fm, n_samples,
+                samp_rate, low_pass, &demod->demod_FM_state);
+    } else if (fm_demod) {
+        start = cpu_stats_start();
         if (demod->sample_size == 2) { // CU8
-            baseband_demod_FM(iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
+            baseband_demod_FM(iq_buf, demod->buf.fm, n_samples, samp_rate, low_pass, &demod->demod_FM_state);
         } else { // CS16
-            baseband_demod_FM_cs16((int16_t *)iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
+            baseband_demod_FM_cs16((int16_t *)iq_buf, demod->buf.fm, n_samples, samp_rate, low_pass, &demod->demod_FM_state);
         }
+        cpu_stats_end(&demod->cpu_stages[CPU_STAGE_FM], start);
+    }
+
+    if (verify && process_frame && demod->load_info.format != S16_AM && demod->load_info.format != S16_FM) {
+        // the FM buffer only if it is not filled on demand
+        int16_t const *fm_buf = demod->enable_FM_demod && !fm_lazy ? demod->buf.fm : NULL;
+        verify_frame_end(verify, iq_buf, (uint32_t)n_samples, (unsigned)demod->sample_size, demod->use_mag_est,
+                demod->frequency ? demod->frequency : cfg->center_frequency, samp_rate, low_pass, demod->am_buf, fm_buf);
     }
 
     // Handle special input formats
     if (demod->load_info.format == S16_AM) { // The IQ buffer is really AM demodulated data
-        if (len > sizeof(demod->am_buf))
+        if (len > demod->buf_samples * sizeof(*demod->am_buf))
             FATAL("Buffer too small");
         memcpy(demod->am_buf, iq_buf, len);
     } else if (demod->load_info.format == S16_FM) { // The IQ buffer is really FM demodulated data
         // we would need AM for the envelope too
-        if (len > sizeof(demod->buf.fm))
+        if (len > demod->buf_samples * sizeof(*demod->buf.fm))
             FATAL("Buffer too small");
         memcpy(demod->buf.fm, iq_buf, len);
     }
 
-    int d_events = 0; // Sensor events successfully detected
-    if (demod->r_devs.len || demod->analyze_pulses || demod->dumper.len || demod->samp_grab) {
-        // Detect a package and loop through demodulators with pulse data
-        int package_type = PULSE_DATA_OOK;  // Just to get us started
+    job->iq_buf        = iq_buf;
+    job->n_samples     = n_samples;
+    job->samp_rate     = samp_rate;
+    job->decim_factor  = decim_factor;
+    job->fpdm          = fpdm;
+    job->avg_db        = avg_db;
+    job->noise_only    = noise_only;
+    job->process_frame = process_frame;
+    job->fm_lazy       = fm_lazy;
+    job->decode        = cfg->demod->r_devs.len || demod->analyze_pulses || cfg->discovery || demod->dumper.len || demod->samp_grab || cfg->pulse_sender;
+
+    if (job->decode) {
         for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
             file_info_t const *dumper = *iter;
             if (dumper->format == U8_LOGIC) {
-                memset(demod->u8_buf, 0, n_samples);
+                // the rest of the buffer is still clear from the previous buffers
+                memset(demod->u8_buf + demod->u8_dirty[0], 0, demod->u8_dirty[1] - demod->u8_dirty[0]);
+                demod->u8_dirty[0] = demod->u8_dirty[1] = 0;
                 break;
             }
         }
-        while (package_type && process_frame) {
-            int p_events = 0; // Sensor events successfully detected per package
-            package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, cfg->samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
-            if (package_type) {
-                // new package: set a first frame start if we are not tracking one already
-                if (!demod->frame_start_ago)
-                    demod->frame_start_ago = demod->pulse_data.start_ago;
-                // always update the last frame end
-                demod->frame_end_ago = demod->pulse_data.end_ago;
-            }
-            if (package_type == PULSE_DATA_OOK) {
-                calc_rssi_snr(cfg, &demod->pulse_data);
-                if (demod->analyze_pulses) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, demod->pulse_data.start_ago, time_str));
-
-                p_events += run_ook_demods(&demod->r_devs, &demod->pulse_data);
-                cfg->total_frames_ook += 1;
-                cfg->total_frames_events += p_events > 0;
-                cfg->frames_ook +=1;
-                cfg->frames_events += p_events > 0;
-
-                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-                    file_info_t const *dumper = *iter;
-                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
-                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
-                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->pulse_data);
-                }
+        if (process_frame)
+            sdr_detect(job);
+    }
+}
 
-                if (cfg->verbosity >= LOG_TRACE) pulse_data_print(&demod->pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
-                    data_t *data = pulse_data_print_data(&demod->pulse_data);
-                    event_occurred_handler(cfg, data);
-                }
-                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0)) ) {
-                    r_device device = {.log_fn = log_device_handler, .output_ctx = cfg};
-                    pulse_analyzer(&demod->pulse_data, package_type, &device);
-                }
+/// Worker pool task, demodulates one channel.
+static void sdr_demod_task(void *ctx, unsigned task)
+{
+    demod_job_t *jobs = ctx;
+    sdr_demod(&jobs[task]);
+}
 
-            } else if (package_type == PULSE_DATA_FSK) {
-                calc_rssi_snr(cfg, &demod->fsk_pulse_data);
-                if (demod->analyze_pulses) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, demod->fsk_pulse_data.start_ago, time_str));
-
-                p_events += run_fsk_demods(&demod->r_devs, &demod->fsk_pulse_data);
-                cfg->total_frames_fsk +=1;
-                cfg->total_frames_events += p_events > 0;
-                cfg->frames_fsk += 1;
-                cfg->frames_events += p_events > 0;
-
-                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-                    file_info_t const *dumper = *iter;
-                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->fsk_pulse_data, '"');
-                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
-                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->fsk_pulse_data);
-                }
+/// Update the stats and report the levels of a demodulated channel.
+static void sdr_demod_levels(demod_job_t *job, time_t last_frame_sec)
+{
+    r_cfg_t *cfg = job->cfg;
+    struct dm_state *demod = job->demod;
 
-                if (cfg->verbosity >= LOG_TRACE) pulse_data_print(&demod->fsk_pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
-                    data_t *data = pulse_data_print_data(&demod->fsk_pulse_data);
-                    event_occurred_handler(cfg, data);
-                }
-                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
-                    r_device device = {.log_fn = log_device_handler, .output_ctx = cfg};
-                    pulse_analyzer(&demod->fsk_pulse_data, package_type, &device);
-                }
-            } // if (package_type == ...
-            d_events += p_events;
-        } // while (package_type)...
+    stats_add(&cfg->stats.frames, 1);
+    if (job->noise_only) {
+        stats_add(&cfg->stats.frames_squelch, 1);
+    }
+    if (job->level_changed) {
+        print_logf(LOG_WARNING, "Auto Level", "Estimated noise level is %.1f dB, adjusting minimum detection level to %.1f dB",
+                DB_LEVEL_FLOAT(demod->noise_level), DB_LEVEL_FLOAT(demod->min_level_auto));
+    }
+    // Report noise every report_noise seconds, but only for the first frame that second
+    if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
+        print_logf(LOG_WARNING, "Auto Level", "Current %s level %.1f dB, estimated noise %.1f dB",
+                job->noise_only ? "noise" : "signal", DB_LEVEL_FLOAT(job->avg_db), DB_LEVEL_FLOAT(demod->noise_level));
+    }
+}
+
+/// Annotate a decoded package in the SigMF dumpers, the package samples are not yet dumped.
+static void annotate_sigmf_dumpers(r_cfg_t *cfg, struct dm_state *demod, pulse_data_t const *pulses, int fsk)
+{
+    uint64_t count = 0;
+    for (unsigned i = 0; i < pulses->num_pulses; ++i)
+        count += pulses->pulse[i] + (i + 1 < pulses->num_pulses ? pulses->gap[i] : 0);
+    double f_lo = fsk ? MIN(pulses->freq1_hz, pulses->freq2_hz) : 0.0;
+    double f_hi = fsk ? MAX(pulses->freq1_hz, pulses->freq2_hz) : 0.0;
+    char comment[80];
+    snprintf(comment, sizeof(comment), "%s %u pulses, RSSI %.1f dB, SNR %.1f dB",
+            fsk ? "FSK" : "OOK", pulses->num_pulses, pulses->rssi_db, pulses->snr_db);
+
+    for (void **iter = demod->sigmf.elems; iter && *iter; ++iter) {
+        // the dumpers have all samples before the current buffer
+        int64_t start = (int64_t)pulses->offset - (int64_t)cfg->input_pos + (int64_t)sigmf_writer_position(*iter);
+        sigmf_writer_annotate(*iter, start > 0 ? (uint64_t)start : 0, count, f_lo, f_hi, comment);
+    }
+}
+
+/// Run the pulse analyzer on a package, in the streaming mode only on the first package of each signal shape.
+static void analyze_package(r_cfg_t *cfg, struct dm_state *demod, pulse_data_t *pulses, int package_type)
+{
+    if (demod->analyze_pulses == PULSE_ANALYZE_NEW) {
+        if (!demod->pulse_clusters)
+            demod->pulse_clusters = pulse_clusters_create(0);
+        if (!demod->pulse_clusters)
+            return;
+        int shape = pulse_clusters_add(demod->pulse_clusters, pulses, package_type);
+        if (!shape)
+            return; // a known shape
+        char time_str[LOCAL_TIME_BUFLEN];
+        fprintf(stderr, "New signal shape #%d in %s package\t%s\n", shape,
+                package_type == PULSE_DATA_FSK ? "FSK" : "OOK", time_pos_str(cfg, pulses->start_ago, time_str));
+    }
+    r_device device = {.log_fn = log_device_handler, .output_ctx = cfg, .log_level = cfg->output_log_level};
+    pulse_analyzer(pulses, package_type, &device);
+}
+
+/// Write a raw package to the rfraw output as an RfRaw code, or as the pulses of the .ook format if there are too many timings.
+static void output_raw_pulses(r_cfg_t *cfg, pulse_data_t const *pulses)
+{
+    // the header and at most two numbers in us per pulse, one record per write keeps the inputs apart
+    char stack_buf[4096];
+    size_t size = 160 + (size_t)pulses->num_pulses * 24;
+    char *buf = size <= sizeof(stack_buf) ? stack_buf : malloc(size);
+    if (!buf) {
+        WARN_MALLOC("output_raw_pulses()");
+        return;
+    }
+
+    char time_str[LOCAL_TIME_BUFLEN];
+    int len = snprintf(buf, size, ";received %s, %s %u pulses, freq1 %.0f Hz, rssi %.1f dB, snr %.1f dB%s%s\n",
+            usecs_time_str(time_str, NULL, 1, 0), pulses->fsk_f2_est ? "fsk" : "ook", pulses->num_pulses,
+            pulses->freq1_hz, pulses->rssi_db, pulses->snr_db,
+            cfg->input_name ? ", input " : "", cfg->input_name ? cfg->input_name : "");
+    len = MIN(len, (int)size - 1);
+    size_t code_len = rfraw_encode(pulses, buf + len, size - (size_t)len - 1);
+    if (code_len) {
+        len += (int)code_len;
+        buf[len++] = '\n';
+    }
+    else {
+        double to_us = 1e6 / pulses->sample_rate;
+        for (unsigned i = 0; i < pulses->num_pulses && len < (int)size; ++i) {
+            len += snprintf(buf + len, size - (size_t)len, "%.0f %.0f\n", pulses->pulse[i] * to_us, pulses->gap[i] * to_us);
+        }
+        len = MIN(len, (int)size - 1);
+    }
+    file_sink_write(cfg->raw_file, buf, (size_t)len);
+
+    if (buf != stack_buf)
+        free(buf);
+}
+
+/// Print the signal shapes of the streaming analyzer for each channel.
+static void print_pulse_clusters(r_cfg_t *cfg)
+{
+    if (cfg->discovery) {
+        fprintf(stderr, "Undecoded ");
+        pulse_clusters_print(cfg->discovery, stderr);
+    }
+    if (cfg->demod->analyze_pulses != PULSE_ANALYZE_NEW)
+        return;
+    if (cfg->demod->pulse_clusters)
+        pulse_clusters_print(cfg->demod->pulse_clusters, stderr);
+    // the first channel is the demod itself
+    for (size_t i = 1; i < cfg->channels.len; ++i) {
+        struct dm_state *chan = cfg->channels.elems[i];
+        if (chan->pulse_clusters) {
+            fprintf(stderr, "Channel %u Hz ", chan->frequency);
+            pulse_clusters_print(chan->pulse_clusters, stderr);
+        }
+    }
+}
+
+/// Track the FSK offset of a decoded package, with "-Y fsktrack=ppm" correct the tuner for a drift of the offset.
+static void track_fsk_offset(r_cfg_t *cfg, struct dm_state *demod, pulse_data_t const *fsk_pulses)
+{
+    pulse_detect_track_fsk(demod->pulse_detect, fsk_pulses);
+    // the ppm is only corrected on a single frequency, the drift of one offset is the drift of the tuner
+    if (cfg->fsk_track < 2 || !cfg->dev || cfg->frequencies > 1 || cfg->channels.len || !cfg->center_frequency)
+        return;
+    if (++cfg->fsk_ppm_packages < FSK_TRACK_LEN)
+        return; // the tracked offsets are from before the last correction
+    int hi_est, lo_est;
+    if (!pulse_detect_fsk_offset(demod->pulse_detect, &hi_est, &lo_est))
+        return;
+    double offset_hz = (hi_est + lo_est) / 2.0 / INT16_MAX * fsk_pulses->sample_rate / 2.0;
+    if (!cfg->fsk_ppm_based) {
+        cfg->fsk_ppm_based   = 1;
+        cfg->fsk_ppm_base_hz = offset_hz;
+        return;
+    }
+    double drift_ppm = (offset_hz - cfg->fsk_ppm_base_hz) / cfg->center_frequency * 1e6;
+    if (drift_ppm > -1.0 && drift_ppm < 1.0)
+        return;
+    // correct half the drift, a signal above the base means the tuner is low
+    int step = (int)(drift_ppm / 2);
+    if (!step)
+        step = drift_ppm > 0 ? 1 : -1;
+    int ppm = cfg->ppm_error - step;
+    print_logf(LOG_NOTICE, "Input", "FSK offset drifted %.1f ppm, frequency correction set to %d ppm", drift_ppm, ppm);
+    set_freq_correction(cfg, ppm);
+    cfg->fsk_ppm_packages = 0;
+}
+
+/// Decode a partial package of a channel with the streaming decoders, the package is counted and dumped once it ends.
+static void sdr_decode_partial(demod_job_t *job)
+{
+    r_cfg_t *cfg = job->cfg;
+    struct dm_state *demod = job->demod;
+    int fsk = job->package_type == PULSE_DATA_FSK_PARTIAL;
+    pulse_data_t *pulses = fsk ? &demod->fsk_pulse_data : &demod->pulse_data;
+    calc_rssi_snr(cfg, pulses);
+    if (demod->gate_snr > 0.0f && pulses->snr_db < demod->gate_snr)
+        return; // too weak for the decoders
+    if (demod->prefilter)
+        pulse_data_fingerprint(pulses);
+    if (fsk)
+        demod->stream_events += run_fsk_demods_partial(cfg->demod, pulses);
+    else
+        demod->stream_events += run_ook_demods_partial(cfg->demod, pulses);
+}
+
+/// Track the frame of a detected package, returns the events the streaming decoders reported while it was received.
+static int sdr_track_package(demod_job_t *job)
+{
+    struct dm_state *demod = job->demod;
+    int stream_events = demod->stream_events;
+    demod->stream_events = 0;
+    // new package: set a first frame start if we are not tracking one already
+    if (!demod->frame_start_ago)
+        demod->frame_start_ago = demod->pulse_data.start_ago;
+    // always update the last frame end
+    demod->frame_end_ago = demod->pulse_data.end_ago;
+    return stream_events;
+}
+
+/// Save the IQ snippet of a detected package while its samples are in the ring, the pulses carry the snippet number.
+static void save_iq_snippet(r_cfg_t *cfg, demod_job_t *job)
+{
+    struct dm_state *demod = job->demod;
+    uint64_t seq = 0;
+    if (job->package_type == PULSE_DATA_OOK || job->package_type == PULSE_DATA_FSK) {
+        pulse_data_t const *pulses = job->package_type == PULSE_DATA_FSK ? &demod->fsk_pulse_data : &demod->pulse_data;
+        unsigned factor = job->decim_factor ? job->decim_factor : 1; // the ring holds the full rate samples
+        unsigned margin = (unsigned)((uint64_t)cfg->samp_rate * cfg->snippet_margin_ms / 1000);
+        seq = iq_snippet_save(cfg->iq_snippet, pulses->start_ago * factor, pulses->end_ago * factor, margin);
+        stats_add(seq ? &cfg->stats.snippets : &cfg->stats.snippets_missed, 1);
+    }
+    // both, the events of a package take the meta data from either
+    demod->pulse_data.iq_snippet     = seq;
+    demod->fsk_pulse_data.iq_snippet = seq;
+}
+
+/// Key of the source of a package for the quiet skip, the width bins of its pulses and gaps.
+static uint64_t package_source_key(pulse_data_t const *pulses, int fsk)
+{
+    uint64_t pulse_bins = pulses->pulse_bins;
+    uint64_t gap_bins   = pulses->gap_bins;
+    if (!pulse_bins) {
+        // not fingerprinted, the prefilter is off and must not see the bins
+        for (unsigned n = 0; n < pulses->num_pulses; ++n) {
+            pulse_bins |= (uint64_t)1 << pulse_data_width_bin(pulses->pulse[n]);
+            gap_bins |= (uint64_t)1 << pulse_data_width_bin(pulses->gap[n]);
+        }
+    }
+    return (pulse_bins * 0x9e3779b97f4a7c15ULL) ^ gap_bins ^ ((uint64_t)fsk << 63);
+}
+
+/// Run the decoders on a package unless it is too weak or from a quiet source, the costly decoders give way over the CPU budget.
+static int sdr_run_decoders(r_cfg_t *cfg, struct dm_state *demod, pulse_data_t *pulses, int fsk, int stream_events)
+{
+    if (demod->prefilter)
+        pulse_data_fingerprint(pulses);
+    if (demod->gate_snr > 0.0f && pulses->snr_db < demod->gate_snr)
+        return 0; // too weak for the decoders
+
+    load_shed_t *shed = cfg->demod->load_shed;
+    uint64_t second = pulses->sample_rate ? pulses->offset / pulses->sample_rate : 0;
+    if (shed && load_shed_begin(shed, package_source_key(pulses, fsk), second, cpu_stats_now())) {
+        stats_add(&cfg->stats.frames_quiet, 1);
+        return 0;
+    }
+    uint64_t verify_start = 0;
+    if (cfg->verify) {
+        verify_decode_begin(cfg->verify);
+        verify_start = cpu_stats_now();
+    }
+    // the decoder pinned to the fingerprint runs alone, the cascade only if it decodes nothing
+    decode_pin_t *pin = cfg->demod->decode_pin;
+    uint64_t pin_key  = pin ? package_source_key(pulses, fsk) : 0;
+    int pin_tried     = 0;
+    int p_events      = pin ? run_demods_pinned(cfg->demod, pulses, pin_key, fsk, &pin_tried) : 0;
+    int pin_hit       = p_events > 0;
+    if (!pin_hit && fsk)
+        p_events = cfg->adaptive_order && !cfg->decode_pool
+                ? run_fsk_demods_adaptive(cfg, pulses)
+                : run_fsk_demods_pool(cfg->decode_pool, cfg->demod, pulses);
+    else if (!pin_hit)
+        p_events = cfg->adaptive_order && !cfg->decode_pool
+                ? run_ook_demods_adaptive(cfg, pulses)
+                : run_ook_demods_pool(cfg->decode_pool, cfg->demod, pulses);
+    if (pin)
+        decode_pin_end(pin, pin_key, pin_tried, pin_hit);
+    if (shed)
+        stats_add(&cfg->stats.frames_shed, load_shed_end(shed, stream_events + p_events, cpu_stats_now()) > 0);
+    if (cfg->verify)
+        verify_decode_end(cfg->verify, cfg->demod, pulses, fsk, verify_start);
+    return p_events;
+}
+
+/// Decode a detected package of a channel, the pulses are those of the channel or a queued copy.
+static void sdr_decode_package(demod_job_t *job, int package_type, pulse_data_t *pulses, pulse_data_t *fsk_pulses, int p_events)
+{
+    r_cfg_t *cfg = job->cfg;
+    struct dm_state *demod = job->demod;
+    unsigned long n_samples = job->n_samples;
+    char time_str[LOCAL_TIME_BUFLEN];
+
+    if (package_type == PULSE_DATA_OOK) {
+        calc_rssi_snr(cfg, pulses);
+        if (demod->analyze_pulses == 1) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, pulses->start_ago, time_str));
+
+        p_events += sdr_run_decoders(cfg, demod, pulses, 0, p_events);
+        stats_add(&cfg->stats.frames_ook, 1);
+        if (cfg->discovery && p_events == 0)
+            pulse_clusters_add(cfg->discovery, pulses, PULSE_DATA_OOK);
+        if (cfg->pulse_sender)
+            pulse_sender_send(cfg->pulse_sender, pulses);
+        stats_add(&cfg->stats.frames_events, p_events > 0);
+        if (cfg->hop_sched)
+            hop_sched_package(cfg->hop_sched, (unsigned)cfg->frequency_index);
+        if (p_events > 0 && demod->sigmf.len)
+            annotate_sigmf_dumpers(cfg, demod, pulses, 0);
+
+        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+            file_info_t const *dumper = *iter;
+            if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, pulses, '\'');
+            if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, pulses, 0x02, demod->u8_dirty);
+            if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, pulses);
+            if (dumper->format == PULSE_BIN) pulse_data_dump_bin(dumper->file, pulses);
+        }
+
+        if (cfg->verbosity >= LOG_TRACE) pulse_data_print(pulses);
+        if (cfg->raw_file && (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0))) {
+            output_raw_pulses(cfg, pulses);
+        }
+        else if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
+            data_t *data = pulse_data_print_data(pulses);
+            if (cfg->input_name)
+                data = data_str(data, "input", "Input", NULL, cfg->input_name);
+            event_occurred_handler(cfg, data);
+        }
+        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0)) ) {
+            analyze_package(cfg, demod, pulses, package_type);
+        }
+
+    } else if (package_type == PULSE_DATA_FSK) {
+        calc_rssi_snr(cfg, fsk_pulses);
+        if (demod->analyze_pulses == 1) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, fsk_pulses->start_ago, time_str));
+
+        p_events += sdr_run_decoders(cfg, demod, fsk_pulses, 1, p_events);
+        stats_add(&cfg->stats.frames_fsk, 1);
+        if (cfg->discovery && p_events == 0)
+            pulse_clusters_add(cfg->discovery, fsk_pulses, PULSE_DATA_FSK);
+        if (cfg->pulse_sender)
+            pulse_sender_send(cfg->pulse_sender, fsk_pulses);
+        stats_add(&cfg->stats.frames_events, p_events > 0);
+        if (cfg->hop_sched)
+            hop_sched_package(cfg->hop_sched, (unsigned)cfg->frequency_index);
+        if (p_events > 0)
+            track_fsk_offset(cfg, demod, fsk_pulses);
+        if (p_events > 0 && demod->sigmf.len)
+            annotate_sigmf_dumpers(cfg, demod, fsk_pulses, 1);
+
+        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+            file_info_t const *dumper = *iter;
+            if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, fsk_pulses, '"');
+            if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, fsk_pulses, 0x04, demod->u8_dirty);
+            if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, fsk_pulses);
+            if (dumper->format == PULSE_BIN) pulse_data_dump_bin(dumper->file, fsk_pulses);
+        }
+
+        if (cfg->verbosity >= LOG_TRACE) pulse_data_print(fsk_pulses);
+        if (cfg->raw_file && (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0))) {
+            output_raw_pulses(cfg, fsk_pulses);
+        }
+        else if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
+            data_t *data = pulse_data_print_data(fsk_pulses);
+            if (cfg->input_name)
+                data = data_str(data, "input", "Input", NULL, cfg->input_name);
+            event_occurred_handler(cfg, data);
+        }
+        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
+            analyze_package(cfg, demod, fsk_pulses, package_type);
+        }
+    } // if (package_type == ...
+
+    job->d_events += p_events;
+}
+
+/// Decode a detected or partial package of a channel, with the CPU stats and the trace.
+static void sdr_decode_timed(demod_job_t *job, int package_type, pulse_data_t *pulses, pulse_data_t *fsk_pulses, int p_events)
+{
+    int fsk = package_type == PULSE_DATA_FSK || package_type == PULSE_DATA_FSK_PARTIAL;
+    unsigned num_pulses = fsk ? fsk_pulses->num_pulses : pulses->num_pulses;
+    uint64_t trace_start = trace_begin();
+    uint64_t start = cpu_stats_start();
+    if (package_type == PULSE_DATA_OOK_PARTIAL || package_type == PULSE_DATA_FSK_PARTIAL)
+        sdr_decode_partial(job);
+    else
+        sdr_decode_package(job, package_type, pulses, fsk_pulses, p_events);
+    cpu_stats_end(&job->demod->cpu_stages[CPU_STAGE_DECODE], start);
+    trace_end(TRACE_PACKAGE, fsk ? "fsk package" : "ook package", num_pulses, trace_start);
+}
+
+/// Package queue task, decodes a package detected ahead on the decode thread.
+static void sdr_decode_task(void *ctx, package_slot_t *slot)
+{
+    r_cfg_t *cfg = ctx;
+    demod_job_t *job = slot->owner;
+    cfg->demod_chan = job->demod;
+    cfg->package    = slot;
+    sdr_decode_timed(job, slot->package_type, &slot->pulses, &slot->fsk_pulses, slot->events);
+    cfg->package    = NULL;
+}
 
+/// Finish the frame tracking, analyzers, and dumpers of a channel.
+static void sdr_demod_finish(demod_job_t *job)
+{
+    r_cfg_t *cfg = job->cfg;
+    struct dm_state *demod = job->demod;
+    unsigned char *iq_buf = job->iq_buf;
+    unsigned long n_samples = job->n_samples;
+    unsigned decim_factor = job->decim_factor;
+    int d_events = job->d_events;
+
+    if (job->decode) {
         // add event counter to the frames currently tracked
         demod->frame_event_count += d_events;
 
@@ -607,6 +1160,10 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
                     unsigned start_padded = demod->frame_start_ago + frame_pad;
                     unsigned end_padded = demod->frame_end_ago - frame_pad;
                     unsigned len_padded = start_padded - end_padded;
+                    if (decim_factor) { // the grabber holds the full rate samples
+                        len_padded *= decim_factor;
+                        end_padded *= decim_factor;
+                    }
                     samp_grab_write(demod->samp_grab, len_padded, end_padded);
                 }
             }
@@ -618,65 +1175,81 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
             file_info_t const *dumper = *iter;
             if (dumper->format == U8_LOGIC) {
-                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
-                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
+                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02, demod->u8_dirty);
+                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04, demod->u8_dirty);
                 break;
             }
         }
     }
 
+    if (job->fm_lazy) {
+        baseband_demod_FM_lazy_finish(&demod->demod_FM_lazy);
+    }
+
     if (demod->am_analyze) {
         am_analyze(demod->am_analyze, demod->am_buf, n_samples, cfg->verbosity >= LOG_INFO, NULL);
     }
 
+    unsigned converted = 0; // each format is converted once for all of its dumpers
     for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
         file_info_t const *dumper = *iter;
-        if (!dumper->file
+        if ((!dumper->file && !demod->sigrok)
                 || dumper->format == VCD_LOGIC
-                || dumper->format == PULSE_OOK)
+                || dumper->format == PULSE_OOK
+                || dumper->format == PULSE_BIN)
             continue;
         uint8_t *out_buf = iq_buf;  // Default is to dump IQ samples
         unsigned long out_len = n_samples * demod->sample_size;
-
-        if (dumper->format == CU8_IQ) {
-            if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((uint8_t *)demod->buf.temp)[n] = (((int16_t *)iq_buf)[n] / 256) + 128; // scale Q0.15 to Q0.7
-                out_buf = (uint8_t *)demod->buf.temp;
+        int conversion = dump_conversion(dumper->format);
+        // the gated dumpers record the IQ samples of the buffers with a signal, the SigMF dumpers all IQ samples
+        int format = dumper->format == GIQ_CU8 ? CU8_IQ : dumper->format == GIQ_CS16 ? CS16_IQ : (int)dumper->format;
+        if ((dumper->format & 0xffff0000) == F_SIGMF)
+            format = (dumper->format & 0xffff) | F_IQ;
+        int16_t const *cs16_buf = (int16_t const *)iq_buf;
+        int cu8 = demod->sample_size == 2;
+
+        if ((format == CU8_IQ && cu8) || (format == CS16_IQ && !cu8)) {
+            // dumped as is
+        }
+        else if (conversion >= 0) {
+            out_buf = demod->dump_buf[conversion];
+            int done = converted & (1u << conversion);
+            converted |= 1u << conversion;
+            if (format == CU8_IQ) {
+                if (!done)
+                    baseband_convert_cs16_cu8(cs16_buf, out_buf, n_samples * 2);
                 out_len = n_samples * 2 * sizeof(uint8_t);
             }
-        }
-        else if (dumper->format == CS16_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int16_t *)demod->buf.temp)[n] = (iq_buf[n] * 256) - 32768; // scale Q0.7 to Q0.15
-                out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
+            else if (format == CS16_IQ) {
+                if (!done)
+                    baseband_convert_cu8_cs16(iq_buf, (int16_t *)out_buf, n_samples * 2);
                 out_len = n_samples * 2 * sizeof(int16_t);
             }
-        }
-        else if (dumper->format == CS8_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int8_t *)demod->buf.temp)[n] = (iq_buf[n] - 128);
-            }
-            else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int8_t *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] >> 8;
+            else if (format == CS8_IQ) {
+                if (!done && cu8)
+                    baseband_convert_cu8_cs8(iq_buf, (int8_t *)out_buf, n_samples * 2);
+                else if (!done)
+                    baseband_convert_cs16_cs8(cs16_buf, (int8_t *)out_buf, n_samples * 2);
+                out_len = n_samples * 2 * sizeof(int8_t);
             }
-            out_buf = (uint8_t *)demod->buf.temp;
-            out_len = n_samples * 2 * sizeof(int8_t);
-        }
-        else if (dumper->format == CF32_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = (iq_buf[n] - 128) / 128.0f;
+            else if (format == CF32_IQ) {
+                if (!done && cu8)
+                    baseband_convert_cu8_f32(iq_buf, (float *)out_buf, n_samples * 2, 1);
+                else if (!done)
+                    baseband_convert_s16_f32(cs16_buf, (float *)out_buf, n_samples * 2, 1);
+                out_len = n_samples * 2 * sizeof(float);
             }
-            else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] / 32768.0f;
+            else {
+                if (!done && dumper->format == F32_AM)
+                    baseband_convert_s16_f32(demod->am_buf, (float *)out_buf, n_samples, 1);
+                else if (!done && dumper->format == F32_FM)
+                    baseband_convert_s16_f32(demod->buf.fm, (float *)out_buf, n_samples, 1);
+                else if (!done && cu8) // F32_I or F32_Q
+                    baseband_convert_cu8_f32(iq_buf + (dumper->format == F32_Q), (float *)out_buf, n_samples, 2);
+                else if (!done)
+                    baseband_convert_s16_f32(cs16_buf + (dumper->format == F32_Q), (float *)out_buf, n_samples, 2);
+                out_len = n_samples * sizeof(float);
             }
-            out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
-            out_len = n_samples * 2 * sizeof(float);
         }
         else if (dumper->format == S16_AM) {
             out_buf = (uint8_t *)demod->am_buf;
@@ -686,92 +1259,438 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
             out_buf = (uint8_t *)demod->buf.fm;
             out_len = n_samples * sizeof(int16_t);
         }
-        else if (dumper->format == F32_AM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->am_buf[n] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_FM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->buf.fm[n] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_I) {
-            if (demod->sample_size == 2)
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = (iq_buf[n * 2] - 128) * (1.0f / 0x80); // scale from Q0.7
-            else
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_Q) {
-            if (demod->sample_size == 2)
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = (iq_buf[n * 2 + 1] - 128) * (1.0f / 0x80); // scale from Q0.7
-            else
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2 + 1] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
         else if (dumper->format == U8_LOGIC) { // state data
             out_buf = demod->u8_buf;
             out_len = n_samples;
         }
 
-        if (fwrite(out_buf, 1, out_len, dumper->file) != out_len) {
+        void **gated = format != (int)dumper->format ? find_gated_dumper(demod, dumper->file) : NULL;
+        sigmf_writer_t *sigmf = format != (int)dumper->format && !gated ? find_sigmf_dumper(demod, dumper->file) : NULL;
+        if (!dumper->file) {
+            // a channel of the Sigrok archive, add_sr_dumper() adds the analogs I, Q, AM, FM
+            unsigned channel = dumper->format == U8_LOGIC ? 0
+                    : dumper->format == F32_I            ? 1
+                    : dumper->format == F32_Q            ? 2
+                    : dumper->format == F32_AM           ? 3
+                                                         : 4;
+            if (sigrok_writer_write(demod->sigrok, channel, out_buf, out_len)) {
+                print_log(LOG_ERROR, __func__, "Short write, samples lost, exiting!");
+                cfg->exit_async = 1;
+            }
+        }
+        else if (gated) {
+            gated_iq_segment_t rec = {
+                    .sample_offset    = cfg->input_pos,
+                    .time_us          = cfg->buf_time_ns ? cfg->buf_time_ns / 1000 : (int64_t)demod->now.tv_sec * 1000000 + demod->now.tv_usec,
+                    .center_frequency = demod->frequency ? demod->frequency : cfg->center_frequency,
+                    .sample_rate      = job->samp_rate,
+            };
+            // a package found below the squelch level, e.g. while the noise level settles, is kept too
+            int signal = !job->noise_only || demod->frame_start_ago;
+            if (gated_iq_writer_write(*gated, &rec, signal, out_buf, out_len)) {
+                print_log(LOG_ERROR, __func__, "Short write, samples lost, exiting!");
+                cfg->exit_async = 1;
+            }
+        }
+        else if (dump_writer_write(demod->dump_writer, dumper->file, out_buf, out_len) != out_len) {
             print_log(LOG_ERROR, __func__, "Short write, samples lost, exiting!");
             cfg->exit_async = 1;
         }
+        if (sigmf) {
+            int64_t time_us = cfg->buf_time_ns ? cfg->buf_time_ns / 1000 : (int64_t)demod->now.tv_sec * 1000000 + demod->now.tv_usec;
+            sigmf_writer_samples(sigmf, n_samples, job->samp_rate, demod->frequency ? demod->frequency : cfg->center_frequency, time_us);
+        }
     }
 
-    cfg->input_pos += n_samples;
-    if (cfg->bytes_to_read > 0)
-        cfg->bytes_to_read -= len;
+}
 
-    if (cfg->after_successful_events_flag && (d_events > 0)) {
-        if (cfg->after_successful_events_flag == 1) {
-            cfg->exit_async = 1;
+#define SETTLE_BLOCK 256       ///< samples per level block of the settle measurement
+#define SETTLE_BLOCKS 4        ///< consecutive blocks without a level step for a settled tuner
+#define SETTLE_STEP_DB 2.0f    ///< level change between blocks that counts as a step
+#define SETTLE_MAX_MS 50       ///< longest settle time to measure
+
+/// Discard the samples after a retune until the tuner settled to freq.
+static void settle_start(r_cfg_t *cfg, uint32_t freq)
+{
+    cfg->settle_freq    = freq;
+    cfg->settle_samples = 0;
+    cfg->settle_stable  = 0;
+    cfg->settle_level   = 0;
+    cfg->settle_target  = cfg->settle_ms >= 0 ? (uint64_t)cfg->settle_ms * cfg->samp_rate / 1000 : 0;
+}
+
+/// Get the number of samples at the start of an SDR buffer to discard while the tuner settles.
+static uint32_t settle_discard(r_cfg_t *cfg, sdr_event_t *ev, uint32_t n_samples)
+{
+    if (!cfg->settle_freq)
+        return 0;
+    // this buffer was acquired before the retune
+    if (ev->center_frequency != cfg->settle_freq)
+        return n_samples;
+
+    uint32_t skip = 0;
+    if (cfg->settle_ms < 0 && !cfg->settle_target) {
+        // measure: wait for a run of blocks without a level step
+        uint64_t max_samples = (uint64_t)SETTLE_MAX_MS * ev->sample_rate / 1000;
+        while (skip + SETTLE_BLOCK <= n_samples) {
+            float level = cfg->demod->sample_size == 2
+                    ? baseband_level_estimate_cu8((uint8_t const *)ev->buf + 2 * skip, SETTLE_BLOCK, 1, 4)
+                    : baseband_level_estimate_cs16((int16_t const *)ev->buf + 2 * skip, SETTLE_BLOCK, 4);
+            float step = level - cfg->settle_level;
+            if (cfg->settle_samples && step < SETTLE_STEP_DB && step > -SETTLE_STEP_DB)
+                cfg->settle_stable++;
+            else
+                cfg->settle_stable = 0;
+            cfg->settle_level = level;
+            skip += SETTLE_BLOCK;
+            cfg->settle_samples += SETTLE_BLOCK;
+            if (cfg->settle_stable >= SETTLE_BLOCKS || cfg->settle_samples >= max_samples) {
+                // discard at least the usual settle time of this device
+                uint64_t measured  = cfg->settle_samples - cfg->settle_stable * SETTLE_BLOCK;
+                cfg->settle_target = MAX(cfg->settle_samples, (uint64_t)cfg->settle_est);
+                cfg->settle_est    = cfg->settle_est ? 0.75f * cfg->settle_est + 0.25f * measured : measured;
+                break;
+            }
         }
-        else {
-            cfg->hop_now = 1;
+        if (!cfg->settle_target) {
+            cfg->settle_samples += n_samples - skip;
+            return n_samples;
         }
     }
 
-    time_t rawtime;
-    time(&rawtime);
-    // choose hop_index as frequency_index, if there are too few hop_times use the last one
-    int hop_index = cfg->hop_times > cfg->frequency_index ? cfg->frequency_index : cfg->hop_times - 1;
-    if (cfg->hop_times > 0 && cfg->frequencies > 1
-            && difftime(rawtime, cfg->hop_start_time) >= cfg->hop_time[hop_index]) {
-        cfg->hop_now = 1;
-    }
-    if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
-        cfg->exit_async = 1;
-        print_log(LOG_CRITICAL, __func__, "Time expired, exiting!");
+    if (cfg->settle_samples < cfg->settle_target) {
+        uint32_t more = (uint32_t)MIN(cfg->settle_target - cfg->settle_samples, n_samples - skip);
+        skip += more;
+        cfg->settle_samples += more;
     }
-    if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
-        event_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
-        flush_report_data(cfg);
-        if (rawtime >= cfg->stats_time)
-            cfg->stats_time += cfg->stats_interval;
-        if (cfg->stats_now)
-            cfg->stats_now--;
+    if (cfg->settle_samples >= cfg->settle_target) {
+        cfg->settle_freq   = 0;
+        cfg->hop_start_pos = cfg->input_pos + skip; // the dwell starts with the settled signal
     }
+    return skip;
+}
 
-    if (cfg->hop_now && !cfg->exit_async) {
-        cfg->hop_now = 0;
-        time(&cfg->hop_start_time);
-        cfg->frequency_index = (cfg->frequency_index + 1) % cfg->frequencies;
-        sdr_set_center_freq(cfg->dev, cfg->frequency[cfg->frequency_index], 1);
+/// Choose the next frequency with the adaptive scheduler and set the dwell on it.
+/// Keep the adaptive levels of the frequency hopped from, continue with those of the frequency hopped to.
+static void hop_levels_swap(struct dm_state *demod, int from, int to)
+{
+    hop_levels_t *save = &demod->hop_levels[from];
+    save->valid          = 1;
+    save->noise_level    = demod->noise_level;
+    save->min_level_auto = demod->min_level_auto;
+    pulse_detect_get_estimates(demod->pulse_detect, &save->estimates);
+
+    hop_levels_t const *restore = &demod->hop_levels[to];
+    if (!restore->valid) {
+        // the first visit starts from the levels of the last frequency, but not from its FSK offsets
+        pulse_detect_estimates_t estimates = save->estimates;
+        estimates.fsk_track = (fsk_track_t){0};
+        pulse_detect_set_estimates(demod->pulse_detect, &estimates);
+        return;
     }
+    demod->noise_level = restore->noise_level;
+    if (restore->min_level_auto != demod->min_level_auto) {
+        demod->min_level_auto = restore->min_level_auto;
+        if (demod->min_level_auto != 0) // not demodulated yet, the first frame sets the levels
+            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, DB_LEVEL_FLOAT(demod->min_level_auto), demod->min_snr, demod->detect_verbosity);
+    }
+    pulse_detect_set_estimates(demod->pulse_detect, &restore->estimates);
 }
 
-static int hasopt(int test, int argc, char *argv[], char const *optstring)
+/// End a dwell of the band scanner and choose the next channel.
+static int band_scan_next(r_cfg_t *cfg)
+{
+    double now = cfg->demod->now.tv_sec + cfg->demod->now.tv_usec / 1e6;
+    unsigned index = band_sched_scan(cfg->band_sched, (unsigned)cfg->frequency_index, cfg->band_active, now);
+    cfg->band_active = 0;
+    return (int)index;
+}
+
+/// Update a listener of the band scan, tune to a newly assigned channel.
+static void band_scan_listen(r_cfg_t *cfg)
+{
+    double now = cfg->demod->now.tv_sec + cfg->demod->now.tv_usec / 1e6;
+    int index = band_sched_listen(cfg->band_sched, (unsigned)cfg->band_listener, cfg->band_active, now);
+    cfg->band_active = 0;
+    if (index < 0)
+        return;
+    uint32_t freq = cfg->parent->frequency[index];
+    print_logf(LOG_NOTICE, "Input", "Band scan listener %d tunes to %u Hz", cfg->band_listener + 1, freq);
+    cfg->frequency[0] = freq;
+    sdr_event_t cmd = {.ev = SDR_EV_FREQ, .center_frequency = freq};
+    sdr_control(cfg->dev, &cmd, 1, 0);
+    if (cfg->dev) {
+        settle_start(cfg, freq);
+    }
+}
+
+static int adaptive_hop_next(r_cfg_t *cfg)
+{
+    double dwell[MAX_FREQS]; // in s
+    for (int i = 0; i < cfg->frequencies; ++i) {
+        int hop_index = cfg->hop_times > i ? i : cfg->hop_times - 1;
+        dwell[i] = cfg->hop_time_ms[hop_index] / 1000.0;
+    }
+    double next_dwell;
+    unsigned index = hop_sched_next(cfg->hop_sched, (double)cfg->input_pos / cfg->samp_rate, dwell, &next_dwell);
+    cfg->hop_dwell = (uint64_t)(next_dwell * cfg->samp_rate);
+    return (int)index;
+}
+
+/// Feed the software gain control, the gain only changes while no channel is in a package.
+static void soft_agc_step(r_cfg_t *cfg, unsigned char const *iq_buf, unsigned long n_samples, unsigned n_jobs, demod_job_t const *jobs)
+{
+    iq_stats_t stats = {0};
+    if (cfg->demod->sample_size == 2)
+        baseband_iq_stats_cu8(iq_buf, (uint32_t)n_samples, SOFT_AGC_STRIDE, &stats);
+    else
+        baseband_iq_stats_cs16((int16_t const *)iq_buf, (uint32_t)n_samples, SOFT_AGC_STRIDE, &stats);
+
+    int in_package = 0;
+    for (unsigned i = 0; i < n_jobs; ++i)
+        in_package |= pulse_detect_in_package(jobs[i].demod->pulse_detect);
+
+    if (soft_agc_update(cfg->agc, &stats, (uint32_t)n_samples, in_package)) {
+        char gain_str[16];
+        snprintf(gain_str, sizeof(gain_str), "%.1f", soft_agc_gain(cfg->agc));
+        print_logf(LOG_INFO, "Input", "Software gain control sets %s dB.", gain_str);
+        sdr_event_t cmd = {.ev = SDR_EV_GAIN, .gain_str = gain_str};
+        sdr_control(cfg->dev, &cmd, 0, 0);
+    }
+}
+
+/// Process a buffer of samples, with @p rx_channels buffers @p rx_stride bytes apart for -Y mimo.
+static void sdr_callback_rx(unsigned char *iq_buf, uint32_t len, unsigned rx_channels, size_t rx_stride, void *ctx)
+{
+    //fprintf(stderr, "sdr_callback... %u\n", len);
+    r_cfg_t *cfg = ctx;
+    struct dm_state *demod = cfg->demod;
+    unsigned long n_samples;
+
+    if (!demod) {
+        // might happen when the demod closed and we get a last data frame
+        return; // ignore the data
+    }
+
+    // do this here and not in sdr_handler so realtime replay can use rtl_tcp output
+    for (void **iter = cfg->raw_handler.elems; iter && *iter; ++iter) {
+        raw_output_t *output = *iter;
+        raw_output_frame(output, iq_buf, len);
+    }
+
+    if ((cfg->bytes_to_read > 0) && (cfg->bytes_to_read <= len)) {
+        len = cfg->bytes_to_read;
+        cfg->exit_async = 1;
+    }
+
+    // save last frame time to see if a new second started
+    time_t last_frame_sec = demod->now.tv_sec;
+    get_time_now(&demod->now);
+
+    n_samples = len / demod->sample_size;
+    if (n_samples * demod->sample_size != len) {
+        print_log(LOG_WARNING, __func__, "Sample buffer length not aligned to sample size!");
+    }
+    if (!n_samples) {
+        print_log(LOG_WARNING, __func__, "Sample buffer too short!");
+        return; // keep the watchdog timer running
+    }
+
+    cfg->watchdog++; // reset the frame acquire watchdog
+
+    if (demod->samp_grab) {
+        samp_grab_push(demod->samp_grab, iq_buf, len);
+    }
+    if (cfg->iq_snippet) {
+        iq_snippet_header_t format = {
+                .sample_size      = (uint32_t)demod->sample_size,
+                .sample_rate      = cfg->samp_rate,
+                .center_frequency = cfg->center_frequency,
+                .time_us          = (int64_t)demod->now.tv_sec * 1000000 + demod->now.tv_usec,
+        };
+        iq_snippet_push(cfg->iq_snippet, &format, iq_buf, len);
+    }
+    if (cfg->spectrum) {
+        spectrum_info_t info = {
+                .center_frequency = cfg->center_frequency,
+                .sample_rate      = cfg->samp_rate,
+                .time_us          = (int64_t)demod->now.tv_sec * 1000000 + demod->now.tv_usec,
+        };
+        spectrum_push(cfg->spectrum, iq_buf, len, (unsigned)demod->sample_size, &info);
+    }
+
+    // Demodulate all channels, on the worker threads if there are any
+    demod_job_t jobs[MAX_FREQS];
+    unsigned n_jobs = cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+    for (unsigned i = 0; i < n_jobs; ++i) {
+        struct dm_state *chan = cfg->channels.len ? cfg->channels.elems[i] : demod;
+        chan->sample_size = demod->sample_size;
+        chan->now = demod->now;
+        chan->sample_file_pos = demod->sample_file_pos;
+        chan->load_info.format = demod->load_info.format;
+        if (r_demod_reserve(chan, (unsigned)n_samples)) {
+            print_log(LOG_WARNING, __func__, "Out of memory for the sample buffers, dropping a buffer!");
+            return;
+        }
+        // each RX channel has a buffer of its own, the others share the first
+        unsigned char *chan_buf = iq_buf;
+        if (chan->rx_channel && chan->rx_channel < rx_channels)
+            chan_buf += chan->rx_channel * rx_stride;
+        jobs[i] = (demod_job_t){.cfg = cfg, .demod = chan, .iq_buf = chan_buf, .len = len, .n_samples = n_samples};
+    }
+    worker_pool_run(cfg->channel_pool, n_jobs, sdr_demod_task, jobs);
+
+    // Decode on this thread, decoders, meta data, and time stamps refer to demod_chan
+    for (unsigned i = 0; i < n_jobs; ++i) {
+        if (!jobs[i].n_samples)
+            continue;
+        cfg->demod_chan = jobs[i].demod;
+        sdr_demod_levels(&jobs[i], last_frame_sec);
+    }
+    // packages of all channels in the order they started, so the output is deterministic
+    for (;;) {
+        demod_job_t *next = NULL;
+        unsigned long next_ago = 0;
+        for (unsigned i = 0; i < n_jobs; ++i) {
+            demod_job_t *job = &jobs[i];
+            if (!job->package_type)
+                continue;
+            int fsk = job->package_type == PULSE_DATA_FSK || job->package_type == PULSE_DATA_FSK_PARTIAL;
+            pulse_data_t const *pulses = fsk ? &job->demod->fsk_pulse_data : &job->demod->pulse_data;
+            unsigned long ago = (unsigned long)pulses->start_ago * (job->decim_factor ? job->decim_factor : 1);
+            if (!next || ago > next_ago) {
+                next     = job;
+                next_ago = ago;
+            }
+        }
+        if (!next)
+            break;
+        if (cfg->iq_snippet)
+            save_iq_snippet(cfg, next);
+        if (next->package_type == PULSE_DATA_OOK_PARTIAL || next->package_type == PULSE_DATA_FSK_PARTIAL) {
+            // the streaming decoders continue after the queued packages, on this thread
+            package_queue_drain(cfg->package_queue);
+            cfg->demod_chan = next->demod;
+            sdr_decode_timed(next, next->package_type, &next->demod->pulse_data, &next->demod->fsk_pulse_data, 0);
+        }
+        else if (cfg->package_queue) {
+            // decode a copy on the decode thread while the next package is detected
+            package_slot_t *slot = package_queue_acquire(cfg->package_queue);
+            slot->package_type = next->package_type;
+            slot->events       = sdr_track_package(next);
+            slot->owner        = next;
+            pulse_data_copy(&slot->pulses, &next->demod->pulse_data);
+            pulse_data_copy(&slot->fsk_pulses, &next->demod->fsk_pulse_data);
+            package_queue_push(cfg->package_queue, slot);
+        }
+        else {
+            cfg->demod_chan = next->demod;
+            int p_events = sdr_track_package(next);
+            sdr_decode_timed(next, next->package_type, &next->demod->pulse_data, &next->demod->fsk_pulse_data, p_events);
+        }
+        sdr_detect(next);
+    }
+    package_queue_drain(cfg->package_queue);
+    int d_events = 0; // Sensor events successfully detected
+    for (unsigned i = 0; i < n_jobs; ++i) {
+        if (!jobs[i].n_samples)
+            continue;
+        cfg->demod_chan = jobs[i].demod;
+        sdr_demod_finish(&jobs[i]);
+        d_events += jobs[i].d_events;
+    }
+    cfg->demod_chan = demod;
+    expire_merged_events(cfg, 0);
+
+    // the pre-squelch level counts, a frame skipped by the level estimate is noise only
+    if (cfg->band_sched) {
+        for (unsigned i = 0; i < n_jobs; ++i) {
+            if (jobs[i].n_samples && !jobs[i].noise_only)
+                cfg->band_active = 1;
+        }
+        if (d_events > 0)
+            cfg->band_active = 1;
+        if (cfg->band_listener >= 0 && !cfg->settle_freq)
+            band_scan_listen(cfg);
+    }
+
+    cfg->input_pos += jobs[0].n_samples;
+    if (cfg->bytes_to_read > 0)
+        cfg->bytes_to_read -= len;
+
+    if (cfg->after_successful_events_flag && (d_events > 0)) {
+        if (cfg->after_successful_events_flag == 1) {
+            cfg->exit_async = 1;
+        }
+        else {
+            cfg->hop_now = 1;
+        }
+    }
+
+    if (cfg->agc && cfg->dev) {
+        soft_agc_step(cfg, iq_buf, n_samples, n_jobs, jobs);
+    }
+
+    time_t rawtime;
+    time(&rawtime);
+    // choose hop_index as frequency_index, if there are too few hop_times use the last one
+    int hop_index = cfg->hop_times > cfg->frequency_index ? cfg->frequency_index : cfg->hop_times - 1;
+    // count the dwell in samples, the buffers are too coarse for sub-second hops in wall clock time
+    uint64_t dwell = cfg->hop_sched ? cfg->hop_dwell
+            : cfg->hop_times > 0 ? (uint64_t)cfg->hop_time_ms[hop_index] * cfg->samp_rate / 1000 : 0;
+    if (cfg->hop_times > 0 && cfg->frequencies > 1 && !cfg->channels.len && !cfg->settle_freq
+            && cfg->input_pos - cfg->hop_start_pos >= dwell) {
+        // don't cut off a package in progress, but wait at most one more dwell
+        if (pulse_detect_in_package(demod->pulse_detect) && cfg->input_pos - cfg->hop_start_pos < 2 * dwell) {
+            if (!cfg->hop_deferred)
+                stats_add(&cfg->stats.hops_deferred, 1);
+            cfg->hop_deferred = 1;
+        }
+        else {
+            cfg->hop_now = 1;
+        }
+    }
+    if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
+        cfg->exit_async = 1;
+        print_log(LOG_CRITICAL, __func__, "Time expired, exiting!");
+    }
+    if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
+        event_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
+        flush_report_data(cfg);
+        if (rawtime >= cfg->stats_time)
+            cfg->stats_time += cfg->stats_interval;
+        if (cfg->stats_now)
+            cfg->stats_now--;
+    }
+
+    if (cfg->hop_now && cfg->channels.len) {
+        cfg->hop_now = 0; // all frequencies are demodulated at once
+    }
+    if (cfg->hop_now && !cfg->exit_async) {
+        cfg->hop_now       = 0;
+        cfg->hop_start_pos = cfg->input_pos;
+        cfg->hop_deferred  = 0;
+        int next_index = cfg->band_sched ? band_scan_next(cfg)
+                : cfg->hop_sched ? adaptive_hop_next(cfg) : (cfg->frequency_index + 1) % cfg->frequencies;
+        if (next_index != cfg->frequency_index) {
+            stats_add(&cfg->stats.hops, 1);
+            hop_levels_swap(cfg->demod, cfg->frequency_index, next_index);
+            cfg->frequency_index = next_index;
+            sdr_event_t cmd = {.ev = SDR_EV_FREQ, .center_frequency = cfg->frequency[cfg->frequency_index]};
+            sdr_control(cfg->dev, &cmd, 1, 0);
+            if (cfg->dev) {
+                settle_start(cfg, cfg->frequency[cfg->frequency_index]);
+            }
+        }
+    }
+}
+
+static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
+{
+    sdr_callback_rx(iq_buf, len, 1, 0, ctx);
+}
+
+static int hasopt(int test, int argc, char *argv[], char const *optstring)
 {
     int opt;
 
@@ -875,15 +1794,124 @@ static void parse_conf_args(r_cfg_t *cfg, int argc, char *argv[])
     }
 }
 
+static void parse_decoder_option(r_cfg_t *cfg, int opt, char *arg);
+
+/// Parse the decoder options of a conf file, these copy their args.
+static void parse_decoder_conf_file(r_cfg_t *cfg, char const *path)
+{
+    if (!path || !*path || !strcmp(path, "null") || !strcmp(path, "0"))
+        return;
+
+    char *conf = readconf(path);
+    char *p    = conf;
+    char *arg;
+    int opt;
+    while (conf && (opt = getconf(&p, conf_keywords, &arg)) != -1) {
+        parse_decoder_option(cfg, opt, arg);
+    }
+    free(conf);
+}
+
+/// Parse only the options which register decoders, for reload_decoders().
+static void parse_decoder_option(r_cfg_t *cfg, int opt, char *arg)
+{
+    if (opt == 'c')
+        parse_decoder_conf_file(cfg, arg);
+    else if (opt == 'R' || opt == 'X')
+        parse_conf_option(cfg, opt, arg);
+}
+
+/** Rebuild the decoders from the conf files and the command line, the inputs and outputs keep running.
+
+    The inputs are held between buffers while the decoders are replaced, the SDR
+    buffers queue meanwhile and no samples are dropped. A broken conf exits as on startup.
+*/
+static void reload_decoders(r_cfg_t *cfg, int argc, char *argv[])
+{
+    cfg->reload_now = 0;
+    print_log(LOG_NOTICE, "Protocols", "Reloading the decoders");
+
+    if (cfg->dsp_thread)
+        dsp_thread_pause(cfg->dsp_thread);
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        r_cfg_t *input = *iter;
+        if (input->dsp_thread)
+            dsp_thread_pause(input->dsp_thread);
+    }
+
+    list_t retired          = cfg->demod->r_devs;
+    cfg->demod->r_devs      = (list_t){0};
+    cfg->no_default_devices = 0;
+    list_clear(&cfg->adaptive_devs, NULL); // rebuilt with the next package
+
+    if (!hasopt('c', argc, argv, OPTSTRING)) {
+        char **paths = compat_get_default_conf_paths();
+        for (int a = 0; paths[a]; a++) {
+            if (hasconf(paths[a])) {
+                parse_decoder_conf_file(cfg, paths[a]);
+                break;
+            }
+        }
+    }
+    optind = 1; // reset getopt
+    int opt;
+    while ((opt = getopt(argc, argv, OPTSTRING)) != -1) {
+        parse_decoder_option(cfg, opt, optarg);
+    }
+    if (!cfg->no_default_devices) {
+        register_all_protocols(cfg, 0); // register all defaults
+    }
+    r_prepare_conversions(cfg);
+    r_prepare_decode_memo(cfg);
+    trace_clear(); // the trace refers to the names of the retired decoders
+    r_reload_protocols(cfg, &retired);
+
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        r_cfg_t *input = *iter;
+        if (input->dsp_thread)
+            dsp_thread_resume(input->dsp_thread);
+    }
+    if (cfg->dsp_thread)
+        dsp_thread_resume(cfg->dsp_thread);
+
+    print_logf(LOG_NOTICE, "Protocols", "Registered %zu out of %u device decoding protocols",
+            cfg->demod->r_devs.len, cfg->num_r_devices);
+}
+
+/// Parse the scheduling settings of a thread, exits on errors.
+static void parse_thread_sched(struct thread_sched **sched, char const *arg, char const *name)
+{
+    if (!*sched) {
+        *sched = calloc(1, sizeof(**sched));
+        if (!*sched)
+            FATAL_CALLOC("parse_thread_sched()");
+    }
+    if (thread_sched_parse(*sched, arg)) {
+        fprintf(stderr, "Invalid -Y %s setting, use [<cpu>[-<cpu>]][:fifo|rr][:<prio>]\n", name);
+        usage(1);
+    }
+}
+
 static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
 {
     int n;
-    r_device *flex_device;
+    unsigned aggregate;
+    int delta;
+    double deadband;
+    unsigned heartbeat;
+    int filter;
+    char filter_expr[FILTER_EXPR_MAX + 1];
+    int fields;
+    char fields_rules[OUTPUT_FIELDS_MAX + 1];
+    size_t outputs;
 
     if (arg && (!strcmp(arg, "help") || !strcmp(arg, "?"))) {
         arg = NULL; // remove the arg if it's a request for the usage help
     }
 
+    // the input settings following a further -d apply to that input
+    r_cfg_t *input = cfg->inputs.len ? cfg->inputs.elems[cfg->inputs.len - 1] : cfg;
+
     switch (opt) {
     case 'h':
         usage(0);
@@ -904,7 +1932,10 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         if (!arg)
             help_device_selection();
 
-        cfg->dev_query = arg;
+        if (cfg->dev_query)
+            r_add_input(cfg, arg);
+        else
+            cfg->dev_query = arg;
         break;
     case 'D':
         if (!arg)
@@ -933,23 +1964,23 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             fprintf(stderr, "test_mode (-t) is deprecated. Use -S none|all|unknown|known\n");
             exit(1);
         }
-        cfg->settings_str = arg;
+        input->settings_str = arg;
         break;
     case 'f':
-        if (cfg->frequencies < MAX_FREQS) {
+        if (input->frequencies < MAX_FREQS) {
             uint32_t sr = atouint32_metric(arg, "-f: ");
             /* If the frequency is above 800MHz sample at 1MS/s */
-            if ((sr > FSK_PULSE_DETECTOR_LIMIT) && (cfg->samp_rate == DEFAULT_SAMPLE_RATE)) {
-                cfg->samp_rate = 1000000;
+            if ((sr > FSK_PULSE_DETECTOR_LIMIT) && (input->samp_rate == DEFAULT_SAMPLE_RATE)) {
+                input->samp_rate = 1000000;
                 fprintf(stderr, "\nNew defaults active, use \"-Y classic -s 250k\" if you need the old defaults\n\n");
             }
-            cfg->frequency[cfg->frequencies++] = sr;
+            input->frequency[input->frequencies++] = sr;
         } else
             fprintf(stderr, "Max number of frequencies reached %d\n", MAX_FREQS);
         break;
     case 'H':
-        if (cfg->hop_times < MAX_FREQS)
-            cfg->hop_time[cfg->hop_times++] = atoi_time(arg, "-H: ");
+        if (input->hop_times < MAX_FREQS)
+            input->hop_time_ms[input->hop_times++] = (int)(atod_time(arg, "-H: ") * 1000 + 0.5);
         else
             fprintf(stderr, "Max number of hop times reached %d\n", MAX_FREQS);
         break;
@@ -957,9 +1988,9 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         if (!arg)
             help_gain();
 
-        free(cfg->gain_str);
-        cfg->gain_str = strdup(arg);
-        if (!cfg->gain_str)
+        free(input->gain_str);
+        input->gain_str = strdup(arg);
+        if (!input->gain_str)
             FATAL_STRDUP("parse_conf_option()");
         break;
     case 'G':
@@ -967,10 +1998,10 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         exit(1);
         break;
     case 'p':
-        cfg->ppm_error = atobv(arg, 0);
+        input->ppm_error = atobv(arg, 0);
         break;
     case 's':
-        cfg->samp_rate = atouint32_metric(arg, "-s: ");
+        input->samp_rate = atouint32_metric(arg, "-s: ");
         break;
     case 'b':
         cfg->out_block_size = atouint32_metric(arg, "-b: ");
@@ -1105,6 +2136,24 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             cfg->report_meta = 1;
         else if (!strncasecmp(arg, "noise", 5))
             cfg->report_noise = atoiv(arg_param(arg), 10); // atoi_time_default()
+        else if (!strncasecmp(arg, "dedup", 5)) {
+            int dedup_ms = atoiv(arg_param(arg), DEFAULT_DEDUP_MS);
+            if (dedup_ms < 0) {
+                fprintf(stderr, "-M dedup: window must not be negative (%d)\n", dedup_ms);
+                exit(1);
+            }
+            cfg->dedup_ms = (unsigned)dedup_ms;
+        }
+        else if (!strcasecmp(arg, "nodedup"))
+            cfg->dedup_ms = 0;
+        else if (!strncasecmp(arg, "merge", 5)) {
+            int merge_ms = atoiv(arg_param(arg), DEFAULT_DEDUP_MS);
+            if (merge_ms <= 0) {
+                fprintf(stderr, "-M merge: window must be positive (%d)\n", merge_ms);
+                exit(1);
+            }
+            cfg->merge_ms = (unsigned)merge_ms;
+        }
         else if (!strcasecmp(arg, "bits"))
             cfg->verbose_bits = 1;
         else if (!strcasecmp(arg, "description"))
@@ -1121,8 +2170,26 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             time(&cfg->stats_time);
             cfg->stats_time += cfg->stats_interval;
         }
-        else if (!strncasecmp(arg, "replay", 6))
-            cfg->in_replay = atobv(arg_param(arg), 1);
+        else if (!strncasecmp(arg, "replay", 6)) {
+            char *p = arg_param(arg);
+            cfg->in_replay     = 1.0;
+            cfg->in_replay_cpu = 0;
+            if (p && strchr(p, '%')) {
+                cfg->in_replay     = 0.0;
+                cfg->in_replay_cpu = atoiv(p, 0);
+                if (cfg->in_replay_cpu < 1 || cfg->in_replay_cpu > 99) {
+                    fprintf(stderr, "-M replay: CPU bound must be 1%% to 99%% (%s)\n", p);
+                    exit(1);
+                }
+            }
+            else if (p) {
+                cfg->in_replay = arg_float(p, "-M replay: ");
+            }
+        }
+        else if (!strcasecmp(arg, "cputime"))
+            cpu_stats_enable(1);
+        else if (!strcasecmp(arg, "trace"))
+            trace_enable(1);
         else
             cfg->report_meta = atobv(arg, 1);
         break;
@@ -1170,14 +2237,14 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else {
             fprintf(stderr, "Disabling all device decoders.\n");
             list_clear(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
+            cfg->demod->dispatch.stale = 1;
         }
         break;
     case 'X':
         if (!arg)
             flex_create_device(NULL);
 
-        flex_device = flex_create_device(arg);
-        register_protocol(cfg, flex_device, "");
+        register_flex_protocol(cfg, arg);
         break;
     case 'q':
         fprintf(stderr, "quiet option (-q) is default and deprecated. See -v to increase verbosity\n");
@@ -1186,12 +2253,20 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         if (!arg)
             help_output();
 
+        aggregate = output_aggregate_param(arg);
+        delta     = output_delta_param(arg, &deadband, &heartbeat);
+        filter    = output_filter_param(arg, filter_expr, sizeof(filter_expr));
+        fields    = output_fields_param(arg, fields_rules, sizeof(fields_rules));
+        outputs   = cfg->output_handler.len;
         if (strncmp(arg, "json", 4) == 0) {
             add_json_output(cfg, arg_param(arg));
         }
         else if (strncmp(arg, "csv", 3) == 0) {
             add_csv_output(cfg, arg_param(arg));
         }
+        else if (strncmp(arg, "cbor", 4) == 0) {
+            add_cbor_output(cfg, arg_param(arg));
+        }
         else if (strncmp(arg, "log", 3) == 0) {
             add_log_output(cfg, arg_param(arg));
             cfg->has_logout = 1;
@@ -1209,6 +2284,15 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else if (strncmp(arg, "syslog", 6) == 0) {
             add_syslog_output(cfg, arg_param(arg));
         }
+        else if (strncmp(arg, "udp", 3) == 0) {
+            add_udp_output(cfg, arg_param(arg));
+        }
+        else if (strncmp(arg, "shm", 3) == 0) {
+            add_shm_output(cfg, arg_param(arg));
+        }
+        else if (strncmp(arg, "eventlog", 8) == 0) {
+            add_eventlog_output(cfg, arg_param(arg));
+        }
         else if (strncmp(arg, "http", 4) == 0) {
             add_http_output(cfg, arg_param(arg));
         }
@@ -1221,10 +2305,24 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else if (strncmp(arg, "rtl_tcp", 7) == 0) {
             add_rtltcp_output(cfg, arg_param(arg));
         }
+        else if (strncmp(arg, "rfraw", 5) == 0) {
+            add_rfraw_output(cfg, arg_param(arg));
+        }
+        else if (strncmp(arg, "pls", 3) == 0) {
+            add_pulse_output(cfg, arg_param(arg));
+        }
         else {
             fprintf(stderr, "Invalid output format: %s\n", arg);
             usage(1);
         }
+        if (fields)
+            project_outputs(cfg, outputs, fields_rules); // on the printing outputs, not the wrappers
+        if (aggregate)
+            aggregate_outputs(cfg, outputs, aggregate);
+        if (delta)
+            delta_outputs(cfg, outputs, deadband, heartbeat);
+        if (filter)
+            filter_outputs(cfg, outputs, filter_expr); // outermost, the dropped events don't reach the state
         break;
     case 'K':
         if (!arg)
@@ -1283,14 +2381,153 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
                 cfg->demod->detect_verbosity++;
             else if (kwargs_match(p, "magest", &val))
                 cfg->demod->use_mag_est = 1;
+            else if (kwargs_match(p, "fused", &val))
+                cfg->demod->use_fused_demod = atoiv(val, 1);
+            else if (kwargs_match(p, "fmpoly", &val))
+                cfg->demod->demod_FM_state.poly = atoiv(val, 1);
+            else if (kwargs_match(p, "decimate", &val))
+                cfg->demod->decimation = atoiv(val, -1);
+            else if (kwargs_match(p, "channelize", &val))
+                cfg->channelize = atoiv(val, 1);
+            else if (kwargs_match(p, "mimo", &val))
+                cfg->mimo = atoiv(val, 1);
             else if (kwargs_match(p, "level", &val))
                 cfg->demod->level_limit = arg_float(val, "-Y level: ");
             else if (kwargs_match(p, "minlevel", &val))
                 cfg->demod->min_level = arg_float(val, "-Y minlevel: ");
             else if (kwargs_match(p, "minsnr", &val))
                 cfg->demod->min_snr = arg_float(val, "-Y minsnr: ");
+            else if (kwargs_match(p, "gatesnr", &val))
+                cfg->demod->gate_snr = arg_float(val, "-Y gatesnr: ");
+            else if (kwargs_match(p, "prefilter", &val))
+                cfg->demod->prefilter = atoiv(val, 1);
+            else if (kwargs_match(p, "analyze_new", &val))
+                cfg->demod->analyze_pulses = atoiv(val, 1) ? PULSE_ANALYZE_NEW : 0;
+            else if (kwargs_match(p, "discover", &val))
+                cfg->discover = atoiv(val, 1);
             else if (kwargs_match(p, "filter", &val))
                 cfg->demod->low_pass = arg_float(val, "-Y filter: ");
+            else if (kwargs_match(p, "latency", &val))
+                cfg->latency_ms = MAX(atoiv(val, 0), 0); // in ms, a "ms" suffix is ignored
+            else if (kwargs_match(p, "mem_budget", &val))
+                cfg->mem_budget = (unsigned)MAX(atoiv(val, 0), 0); // in MB
+            else if (kwargs_match(p, "fsktrack", &val))
+                cfg->fsk_track = val && !strcasecmp(val, "ppm") ? 2 : atoiv(val, 1);
+            else if (kwargs_match(p, "adaptive_hop", &val))
+                cfg->adaptive_hop = atoiv(val, 1);
+            else if (kwargs_match(p, "band_scan", &val))
+                cfg->band_scan = val ? atod_time(val, "-Y band_scan: ") : BAND_SCHED_HOLD_S;
+            else if (kwargs_match(p, "settle", &val))
+                cfg->settle_ms = !val || !strcasecmp(val, "auto") ? DEFAULT_SETTLE_MS : (int)(atod_time(val, "-Y settle: ") * 1000 + 0.5);
+            else if (kwargs_match(p, "decode_threads", &val))
+                cfg->decode_threads = MAX(atoiv(val, 0), 0);
+            else if (kwargs_match(p, "detect_ahead", &val))
+                cfg->package_queue_len = MAX(atoiv(val, 0), 0);
+            else if (kwargs_match(p, "package_budget", &val))
+                cfg->package_budget_ms = MAX(arg_float(val, "-Y package_budget: "), 0.0f); // in ms
+            else if (kwargs_match(p, "second_budget", &val))
+                cfg->second_budget_ms = MAX(arg_float(val, "-Y second_budget: "), 0.0f); // in ms
+            else if (kwargs_match(p, "quiet_skip", &val))
+                cfg->quiet_skip = (unsigned)MAX(atoiv(val, 0), 0);
+            else if (kwargs_match(p, "lag_skip", &val))
+                cfg->lag_skip_ms = MAX(atoiv(val, 0), 0); // in ms, a "ms" suffix is ignored
+            else if (kwargs_match(p, "snippets", &val)) {
+                free(cfg->snippet_dir);
+                cfg->snippet_dir = strdup(val && *val ? val : IQ_SNIPPET_DEFAULT_DIR);
+                if (!cfg->snippet_dir)
+                    FATAL_STRDUP("parse_conf_option()");
+            }
+            else if (kwargs_match(p, "snippets_size", &val))
+                cfg->snippet_mb = (unsigned)MAX(atoiv(val, IQ_SNIPPET_SIZE_DEFAULT), 1); // in MB
+            else if (kwargs_match(p, "snippet_margin", &val))
+                cfg->snippet_margin_ms = (unsigned)MAX(atoiv(val, IQ_SNIPPET_MARGIN_MS), 0); // in ms, a "ms" suffix is ignored
+            else if (kwargs_match(p, "spectrum", &val))
+                cfg->spectrum_bins = (unsigned)MAX(atoiv(val, SPECTRUM_BINS_DEFAULT), 0);
+            else if (kwargs_match(p, "spectrum_interval", &val))
+                cfg->spectrum_interval = !val ? 1.0 : atod_time(val, "-Y spectrum_interval: ");
+            else if (kwargs_match(p, "duty", &val))
+                cfg->duty_learn = !val ? DUTY_SCHED_LEARN_S : atod_time(val, "-Y duty: ");
+            else if (kwargs_match(p, "duty_margin", &val))
+                cfg->duty_margin = !val ? 0.5 : atod_time(val, "-Y duty_margin: ");
+            else if (kwargs_match(p, "verify", &val)) {
+                free(cfg->verify_prefix);
+                cfg->verify_prefix = strdup(val && *val ? val : VERIFY_PREFIX_DEFAULT);
+                if (!cfg->verify_prefix)
+                    FATAL_STRDUP("parse_conf_option()");
+            }
+            else if (kwargs_match(p, "file_threads", &val))
+                cfg->file_threads = MAX(atoiv(val, 0), 0);
+            else if (kwargs_match(p, "adaptive", &val))
+                cfg->adaptive_order = MAX(atoiv(val, 1), 0);
+            else if (kwargs_match(p, "memo", &val))
+                cfg->decode_memo_ms = (unsigned)MAX(atoiv(val, DECODE_MEMO_MS_DEFAULT), 0);
+            else if (kwargs_match(p, "pin", &val)) {
+                cfg->pin_mode = MAX(cfg->pin_mode, 1);
+                if (val && *val) {
+                    size_t len   = strcspn(val, ",");
+                    char *sensor = malloc(len + 1);
+                    if (!sensor)
+                        FATAL_MALLOC("parse_conf_option()");
+                    memcpy(sensor, val, len);
+                    sensor[len] = '\0';
+                    if (!decode_pin_valid_sensor(sensor)) {
+                        fprintf(stderr, "-Y pin: a sensor is given as <model>:<id>, not \"%s\"\n", sensor);
+                        free(sensor);
+                        usage(1);
+                    }
+                    list_push(&cfg->pin_sensors, sensor);
+                }
+            }
+            else if (kwargs_match(p, "pin_only", &val))
+                cfg->pin_mode = atoiv(val, 1) ? 2 : MIN(cfg->pin_mode, 1);
+            else if (kwargs_match(p, "farm", &val)) {
+                if (!val || !*val) {
+                    fprintf(stderr, "-Y farm: needs the <host>[:<port>] of a decode worker\n");
+                    usage(1);
+                }
+                // several workers can be given in one -Y
+                size_t len   = strcspn(val, ",");
+                char *worker = malloc(len + 1);
+                if (!worker)
+                    FATAL_MALLOC("parse_conf_option()");
+                memcpy(worker, val, len);
+                worker[len] = '\0';
+                list_push(&cfg->farm_workers, worker);
+            }
+            else if (kwargs_match(p, "calibrate", &val)) {
+                size_t len = val ? strcspn(val, ",") : 0;
+                free(cfg->calibration_path);
+                cfg->calibration_path = NULL;
+                if (len == 3 && !strncasecmp(val, "off", 3)) {
+                    cfg->calibrate = -1;
+                }
+                else {
+                    cfg->calibrate = 1;
+                    if (len) {
+                        cfg->calibration_path = malloc(len + 1);
+                        if (!cfg->calibration_path)
+                            FATAL_MALLOC("parse_conf_option()");
+                        memcpy(cfg->calibration_path, val, len);
+                        cfg->calibration_path[len] = '\0';
+                    }
+                }
+            }
+            else if (kwargs_match(p, "sched_acquire", &val))
+                parse_thread_sched(&cfg->sched_acquire, val, "sched_acquire");
+            else if (kwargs_match(p, "sched_dsp", &val))
+                parse_thread_sched(&cfg->sched_dsp, val, "sched_dsp");
+            else if (kwargs_match(p, "sched_workers", &val))
+                parse_thread_sched(&cfg->sched_workers, val, "sched_workers");
+            else if (kwargs_match(p, "sched_output", &val))
+                parse_thread_sched(&cfg->sched_output, val, "sched_output");
+            else if (kwargs_match(p, "mlock", &val))
+                cfg->lock_buffers = atobv(val, 1);
+            else if (kwargs_match(p, "dump_async", &val))
+                cfg->dump_async = MAX(atoiv(val, DEFAULT_DUMP_ASYNC_MB), 1);
+            else if (kwargs_match(p, "dump_direct", &val))
+                cfg->dump_flags |= DUMP_WRITER_DIRECT;
+            else if (kwargs_match(p, "dump_dontneed", &val))
+                cfg->dump_flags |= DUMP_WRITER_DONTNEED;
             else {
                 fprintf(stderr, "Unknown pulse detector setting: %s\n", p);
                 usage(1);
@@ -1357,14 +2594,23 @@ static void sighandler(int signum)
     }
     else if (signum == SIGHUP) {
         sig_hup = 1;
+        g_cfg.reload_now = 1;
         return;
     }
     else if (signum == SIGINFO/* TODO: maybe SIGUSR1 */) {
         g_cfg.stats_now++;
+        for (size_t i = 0; i < g_cfg.inputs.len; ++i)
+            ((r_cfg_t *)g_cfg.inputs.elems[i])->stats_now++;
         return;
     }
     else if (signum == SIGUSR1) {
         g_cfg.hop_now = 1;
+        for (size_t i = 0; i < g_cfg.inputs.len; ++i)
+            ((r_cfg_t *)g_cfg.inputs.elems[i])->hop_now = 1;
+        return;
+    }
+    else if (signum == SIGUSR2) {
+        g_cfg.trace_now = 1;
         return;
     }
     else {
@@ -1384,24 +2630,67 @@ static void sighandler(int signum)
 }
 #endif
 
-// NOTE: this handler might be called while already in `r_free_cfg()`.
-static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
+/// Count how late the SDR buffers arrive and how long they wait to be processed.
+static void update_sched_stats(r_cfg_t *cfg, sdr_event_t const *ev)
 {
-    //fprintf(stderr, "%s: %d, %d, %p, %p\n", __func__, nc->sock, ev_type, nc->user_data, ev_data);
-    // only process for the dummy nc
-    if (nc->sock != INVALID_SOCKET || ev_type != MG_EV_POLL)
+    if (!ev->time_us || !ev->sample_rate)
         return;
-    r_cfg_t *cfg     = nc->user_data;
-    sdr_event_t *ev = ev_data;
-    //fprintf(stderr, "sdr_handler...\n");
 
+    struct timeval now;
+    get_time_now(&now);
+    int64_t now_us  = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    int64_t wait_us = now_us - ev->time_us;
+    if (wait_us > (int64_t)cfg->sched_wait_max_us)
+        cfg->sched_wait_max_us = (unsigned)wait_us;
+
+    // a buffer arrives once its last sample is in, i.e. its duration after the previous one
+    uint64_t samples    = ev->len / cfg->demod->sample_size + ev->dropped;
+    int64_t duration_us = (int64_t)(samples * 1000000 / ev->sample_rate);
+    if (cfg->sched_last_us) {
+        int64_t late_us = ev->time_us - cfg->sched_last_us - duration_us;
+        if (late_us > (int64_t)cfg->sched_late_max_us)
+            cfg->sched_late_max_us = (unsigned)late_us;
+        if (late_us > duration_us)
+            stats_add(&cfg->stats.sched_late, 1);
+    }
+    cfg->sched_last_us = ev->time_us;
+    stats_add(&cfg->stats.sched_buffers, 1);
+}
+
+/// Check if the rest of a buffer is skipped as the processing lags the input by more than -Y lag_skip, the quietest first.
+static int lag_skip_buffer(r_cfg_t *cfg, sdr_event_t const *ev, uint32_t skip, uint32_t n_samples)
+{
+    if (!cfg->lag_shed || !ev->time_us || !ev->sample_rate)
+        return 0;
+
+    struct timeval now;
+    get_time_now(&now);
+    int64_t now_us    = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    int64_t sample_us = (int64_t)((double)(cfg->input_pos + n_samples) * 1000000.0 / ev->sample_rate);
+    int64_t lag_us    = lag_shed_update(cfg->lag_shed, now_us, sample_us);
+    cfg->sched_lag_us = (unsigned)MIN(lag_us, (int64_t)UINT32_MAX);
+    if (cfg->sched_lag_us > cfg->sched_lag_max_us)
+        cfg->sched_lag_max_us = cfg->sched_lag_us;
+
+    // the squelch pre-scan estimate, cheap enough for every buffer
+    uint8_t const *buf = (uint8_t const *)ev->buf + skip * cfg->demod->sample_size;
+    float level = cfg->demod->sample_size == 2
+            ? baseband_level_estimate_cu8(buf, n_samples - skip, cfg->demod->use_mag_est, SQUELCH_PRESCAN_STRIDE)
+            : baseband_level_estimate_cs16((int16_t const *)buf, n_samples - skip, SQUELCH_PRESCAN_STRIDE);
+    return lag_shed_skip(cfg->lag_shed, DB_LEVEL_FLOAT(level));
+}
+
+static void sdr_process_event(r_cfg_t *cfg, sdr_event_t *ev)
+{
     data_t *data = NULL;
     if (ev->ev & SDR_EV_RATE) {
         // cfg->samp_rate = ev->sample_rate;
+        if (cfg->lag_shed)
+            lag_shed_reset(cfg->lag_shed); // the sample time of the input position changes
         data = data_int(data, "sample_rate", "", NULL, ev->sample_rate);
     }
     if (ev->ev & SDR_EV_CORR) {
-        // cfg->ppm_error = ev->freq_correction;
+        cfg->ppm_error = ev->freq_correction; // e.g. the FSK tracking corrects from here
         data = data_int(data, "freq_correction", "", NULL, ev->freq_correction);
     }
     if (ev->ev & SDR_EV_FREQ) {
@@ -1409,21 +2698,91 @@ static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
         data = data_int(data, "center_frequency", "", NULL, ev->center_frequency);
         if (cfg->frequencies > 1) {
             data = data_ary(data, "frequencies", "", NULL, data_array(cfg->frequencies, DATA_INT, cfg->frequency));
-            data = data_ary(data, "hop_times", "", NULL, data_array(cfg->hop_times, DATA_INT, cfg->hop_time));
+            double hop_times[MAX_FREQS]; // in seconds
+            for (int i = 0; i < cfg->hop_times; ++i)
+                hop_times[i] = cfg->hop_time_ms[i] / 1000.0;
+            data = data_ary(data, "hop_times", "", NULL, data_array(cfg->hop_times, DATA_DOUBLE, hop_times));
         }
     }
     if (ev->ev & SDR_EV_GAIN) {
         data = data_str(data, "gain", "", NULL, ev->gain_str);
     }
+    if (ev->ev & SDR_EV_RETRY) {
+        cfg->watchdog++; // the input is reconnecting, not stalled
+        cfg->sched_last_us = 0; // the gap is no scheduling delay
+        if (cfg->lag_shed)
+            lag_shed_reset(cfg->lag_shed); // the gap is no lag
+        if (cfg->iq_snippet)
+            iq_snippet_reset(cfg->iq_snippet); // a snippet never spans a gap
+    }
+    if (ev->ev & SDR_EV_SKIP) {
+        cfg->watchdog++; // the input is squelched, not stalled
+        cfg->sched_last_us = 0; // the gap is no scheduling delay
+        cfg->input_pos += ev->skipped; // keep the sample offsets of pulses accurate
+        if (cfg->iq_snippet)
+            iq_snippet_reset(cfg->iq_snippet);
+    }
+    if (data && cfg->input_name) {
+        data = data_str(data, "input", "Input", NULL, cfg->input_name);
+    }
     if (data) {
         event_occurred_handler(cfg, data);
     }
 
     if (ev->ev == SDR_EV_DATA) {
+        update_sched_stats(cfg, ev);
         cfg->samp_rate        = ev->sample_rate;
         cfg->center_frequency = ev->center_frequency;
-        sdr_callback((unsigned char *)ev->buf, ev->len, cfg);
+        cfg->buf_time_us      = ev->time_us;
+        cfg->buf_time_ns      = ev->time_ns;
+        if (ev->dropped) {
+            // keep the sample offsets of pulses accurate
+            cfg->input_pos += ev->dropped;
+            stats_add(&cfg->stats.drops, 1);
+            stats_add(&cfg->stats.samples_dropped, ev->dropped);
+            print_logf(LOG_WARNING, "Input", "Dropped %llu samples", (unsigned long long)ev->dropped);
+        }
+        uint32_t sample_size = cfg->demod->sample_size;
+        uint32_t n_samples   = ev->len / sample_size;
+        uint32_t skip        = settle_discard(cfg, ev, n_samples);
+        if (skip) {
+            cfg->watchdog++; // the input is settling, not stalled
+            cfg->input_pos += skip; // keep the sample offsets of pulses accurate
+            stats_add(&cfg->stats.settle_discarded, skip);
+            if (cfg->buf_time_ns)
+                cfg->buf_time_ns += (int64_t)skip * 1000000000 / ev->sample_rate;
+        }
+        if (cfg->iq_snippet && (ev->dropped || skip))
+            iq_snippet_reset(cfg->iq_snippet);
+        if (skip < n_samples && lag_skip_buffer(cfg, ev, skip, n_samples)) {
+            cfg->watchdog++; // the input is lagging, not stalled
+            cfg->input_pos += n_samples - skip; // keep the sample offsets of pulses accurate
+            stats_add(&cfg->stats.lag_skips, 1);
+            stats_add(&cfg->stats.samples_lag_skipped, n_samples - skip);
+            if (cfg->iq_snippet)
+                iq_snippet_reset(cfg->iq_snippet);
+        }
+        else if (skip < n_samples) {
+            uint64_t start = trace_begin();
+            sdr_callback_rx((unsigned char *)ev->buf + skip * sample_size, ev->len - skip * sample_size,
+                    ev->rx_channels, (size_t)ev->len, cfg);
+            trace_end(TRACE_DSP, "dsp", ev->len, start);
+        }
     }
+}
+
+// NOTE: this handler might be called while already in `r_free_cfg()`.
+static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
+{
+    //fprintf(stderr, "%s: %d, %d, %p, %p\n", __func__, nc->sock, ev_type, nc->user_data, ev_data);
+    // only process for the dummy nc
+    if (nc->sock != INVALID_SOCKET || ev_type != MG_EV_POLL)
+        return;
+    r_cfg_t *cfg     = nc->user_data;
+    sdr_event_t *ev = ev_data;
+    //fprintf(stderr, "sdr_handler...\n");
+
+    sdr_process_event(cfg, ev);
 
     if (cfg->exit_async) {
         if (cfg->verbosity >= 2)
@@ -1440,31 +2799,244 @@ static void acquire_callback(sdr_event_t *ev, void *ctx)
     //get_time_now(&now);
     //fprintf(stderr, "%ld.%06ld acquire_callback...\n", (long)now.tv_sec, (long)now.tv_usec);
 
-    struct mg_mgr *mgr = ctx;
+    r_cfg_t *cfg = ctx;
 
-    // TODO: We should run the demod here to unblock the event loop
+    if (ev->ev & SDR_EV_DATA)
+        trace_instant(TRACE_BUFFER, "buffer", ev->len);
+
+    // stamp the arrival for the latency statistic, the event is copied on hand off
+    struct timeval now;
+    get_time_now(&now);
+    ev->time_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+
+    // hand off to the DSP thread, drop the buffer if demod can't keep up
+    if (cfg->dsp_thread) {
+        // pass on the samples of dropped buffers with the next one
+        ev->dropped += cfg->acquire_dropped;
+        cfg->acquire_dropped = 0;
+        if (dsp_thread_push(cfg->dsp_thread, ev) < 0) {
+            cfg->acquire_dropped = ev->dropped + ev->skipped + (unsigned)ev->len / cfg->demod->sample_size;
+            if (cfg->verbosity >= LOG_DEBUG)
+                print_log(LOG_DEBUG, "Input", "DSP queue full, dropping samples");
+        }
+        return;
+    }
 
     // thread-safe dispatch, ev_data is the iq buffer pointer and length
     //fprintf(stderr, "acquire_callback bc send...\n");
-    mg_broadcast(mgr, sdr_handler, (void *)ev, sizeof(*ev));
+    mg_broadcast(get_mgr(cfg), sdr_handler, (void *)ev, sizeof(*ev));
     //fprintf(stderr, "acquire_callback bc done...\n");
 }
 
-static int start_sdr(r_cfg_t *cfg)
+static void wakeup_handler(struct mg_connection *nc, int ev_type, void *ev_data)
 {
-    int r;
-    if (cfg->dev) {
-        r = sdr_close(cfg->dev);
-        cfg->dev = NULL;
-        if (r < 0) {
-            print_logf(LOG_ERROR, "Input", "Closing SDR failed (%d)", r);
-        }
-    }
-    r = sdr_open(&cfg->dev, cfg->dev_query, cfg->verbosity);
-    if (r < 0) {
-        return -1; // exit(2);
-    }
-    cfg->dev_info = sdr_get_dev_info(cfg->dev);
+    UNUSED(nc);
+    UNUSED(ev_type);
+    UNUSED(ev_data);
+    // nothing to do, the main loop drains the output queue after each poll
+}
+
+// note that this function is called in a different thread
+static void dsp_wakeup_callback(void *ctx)
+{
+    r_cfg_t *cfg = ctx;
+    mg_broadcast(get_mgr(cfg), wakeup_handler, NULL, 0);
+}
+
+/// Merge the queued plain data buffers following the first into one event, returns the number of buffers used.
+static unsigned merge_sdr_events(r_cfg_t *cfg, sdr_event_t const *evs, unsigned n, sdr_event_t *merged)
+{
+    size_t len = (size_t)evs[0].len;
+    unsigned run = 1;
+    if (evs[0].ev != SDR_EV_DATA || evs[0].rx_channels > 1)
+        return 1;
+    for (; run < n; ++run) {
+        sdr_event_t const *ev = &evs[run];
+        if (ev->ev != SDR_EV_DATA || ev->dropped || ev->sample_rate != evs[0].sample_rate
+                || ev->center_frequency != evs[0].center_frequency || len + (size_t)ev->len > DSP_MERGE_BYTES)
+            break;
+        len += (size_t)ev->len;
+    }
+    if (run < 2)
+        return 1;
+    if (cfg->merge_size < len) {
+        unsigned char *buf = realloc(cfg->merge_buf, DSP_MERGE_BYTES);
+        if (!buf) {
+            WARN_REALLOC("merge_sdr_events()");
+            return 1;
+        }
+        cfg->merge_buf  = buf;
+        cfg->merge_size = DSP_MERGE_BYTES;
+    }
+    size_t pos = 0;
+    for (unsigned i = 0; i < run; ++i) {
+        memcpy(cfg->merge_buf + pos, evs[i].buf, (size_t)evs[i].len);
+        pos += (size_t)evs[i].len;
+    }
+    // the first sample time of the first, the arrival of the last buffer
+    *merged         = evs[0];
+    merged->buf     = cfg->merge_buf;
+    merged->len     = (int)len;
+    merged->time_us = evs[run - 1].time_us;
+    merged->lease   = NULL;
+    return run;
+}
+
+// note that this function is called on the DSP thread
+static void dsp_process_callback(sdr_event_t *evs, unsigned n, void *ctx)
+{
+    r_cfg_t *cfg = ctx;
+
+    // a backlog of small buffers is demodulated as one, the per buffer work is done once
+    for (unsigned i = 0; i < n;) {
+        sdr_event_t merged;
+        unsigned run = merge_sdr_events(cfg, &evs[i], n - i, &merged);
+        if (run > 1) {
+            stats_add(&cfg->stats.sched_merged, run - 1);
+            sdr_process_event(cfg, &merged);
+        }
+        else {
+            sdr_process_event(cfg, &evs[i]);
+        }
+        i += run;
+    }
+
+    // sdr_stop() is left to the main loop, just make sure it wakes up
+    if (cfg->exit_async)
+        dsp_wakeup_callback(cfg);
+}
+
+/// Number of SDR buffers, keeps about LATENCY_QUEUE_MS queued for a latency target.
+static uint32_t latency_buf_num(unsigned latency_ms)
+{
+    if (!latency_ms)
+        return SDR_DEFAULT_BUF_NUMBER;
+    return MIN(MAX(LATENCY_QUEUE_MS / latency_ms, SDR_DEFAULT_BUF_NUMBER), LATENCY_MAX_BUF_NUMBER);
+}
+
+/// Length of the SDR buffers in bytes, holds latency_ms of signal if a latency target is set.
+static uint32_t latency_buf_len(r_cfg_t *cfg)
+{
+    if (!cfg->latency_ms)
+        return cfg->out_block_size;
+    uint64_t len = (uint64_t)cfg->samp_rate * cfg->demod->sample_size * cfg->latency_ms / 1000;
+    len -= len % MINIMAL_BUF_LENGTH; // USB transfers are multiples of 512 bytes
+    return (uint32_t)MIN(MAX(len, MINIMAL_BUF_LENGTH), MAXIMAL_BUF_LENGTH);
+}
+
+/// Use the cached choice of the baseband kernels, measure it for a live input or with -Y calibrate.
+static void startup_calibration(r_cfg_t *cfg)
+{
+    if (cfg->calibrate < 0)
+        return;
+
+    char path[1024];
+    int has_path = 1;
+    if (cfg->calibration_path)
+        snprintf(path, sizeof(path), "%s", cfg->calibration_path);
+    else
+        has_path = !calibrate_default_path(path, sizeof(path));
+    // the demodulators run on the SDR buffers, of CU8 samples
+    uint32_t n_samples = latency_buf_len(cfg) / 2;
+    char key[CALIBRATE_KEY_MAX];
+    calibrate_key(key, sizeof(key), version_string(), cfg->samp_rate, n_samples);
+
+    calibration_t cal;
+    if (!cfg->calibrate && has_path && !calibrate_load(path, key, &cal)) {
+        calibrate_apply(&cal);
+        cfg->calibration_source = cal.source;
+        print_logf(LOG_INFO, "Calibration", "Using the cached kernels %s, fused block %u",
+                baseband_simd_name(cal.simd), cal.fused_block);
+        return;
+    }
+    int live = !cfg->in_files.len && !cfg->test_data;
+    if (!cfg->calibrate && !live)
+        return;
+
+    if (calibrate_measure(cfg->samp_rate, n_samples, &cal))
+        return;
+    calibrate_apply(&cal);
+    cfg->calibration_source = cal.source;
+    print_logf(LOG_NOTICE, "Calibration", "Kernels %s, fused block %u: %.1f MS/s, the defaults %.1f MS/s",
+            baseband_simd_name(cal.simd), cal.fused_block, cal.msps, cal.msps_default);
+    if (has_path && calibrate_save(path, key, &cal))
+        print_logf(LOG_WARNING, "Calibration", "Failed to write \"%s\"", path);
+}
+
+/// Estimate of the memory use in bytes with SDR buffers of @p buf_num by @p buf_len bytes.
+static size_t mem_estimate(r_cfg_t *cfg, uint32_t buf_num, uint32_t buf_len)
+{
+    r_mem_usage_t mem;
+    r_get_mem_usage(cfg, &mem);
+    size_t n_samples = buf_len / cfg->demod->sample_size;
+    size_t bytes = (size_t)buf_num * buf_len + mem.pulses + mem.decoders + mem.grabber + mem.dumpers;
+    unsigned n_chans = cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+    for (unsigned i = 0; i < n_chans; ++i) {
+        struct dm_state *chan = cfg->channels.len ? cfg->channels.elems[i] : cfg->demod;
+        bytes += sizeof(*chan) + n_samples * r_demod_sample_bytes(chan);
+    }
+    return bytes;
+}
+
+/// Shrink the SDR buffers to the memory budget, the length first then the number.
+static void mem_budget_fit(r_cfg_t *cfg, uint32_t *buf_num, uint32_t *buf_len)
+{
+    if (!cfg->mem_budget)
+        return;
+    size_t budget = (size_t)cfg->mem_budget * 1024 * 1024;
+    if (!*buf_num)
+        *buf_num = SDR_DEFAULT_BUF_NUMBER;
+    while (mem_estimate(cfg, *buf_num, *buf_len) > budget) {
+        if (*buf_len > MEM_BUDGET_MIN_BUF_LENGTH)
+            *buf_len = MAX(*buf_len / 2 - *buf_len / 2 % MINIMAL_BUF_LENGTH, MEM_BUDGET_MIN_BUF_LENGTH);
+        else if (*buf_num > MEM_BUDGET_MIN_BUF_NUMBER)
+            *buf_num -= 1;
+        else
+            break;
+    }
+    size_t bytes = mem_estimate(cfg, *buf_num, *buf_len);
+    if (bytes > budget)
+        print_logf(LOG_WARNING, "Input", "Memory budget of %u MB exceeded, the smallest buffers need %.1f MB",
+                cfg->mem_budget, bytes / 1048576.0);
+    else
+        print_logf(LOG_NOTICE, "Input", "Memory budget of %u MB, using %u buffers of %u bytes",
+                cfg->mem_budget, *buf_num, *buf_len);
+}
+
+/// Log the memory use of the subsystems.
+static void mem_report(r_cfg_t *cfg)
+{
+    r_mem_usage_t mem;
+    r_get_mem_usage(cfg, &mem);
+    size_t total = mem.sdr + mem.demod + mem.pulses + mem.decoders + mem.grabber + mem.dumpers;
+    print_logf(LOG_NOTICE, "Input", "Memory %.1f kB: SDR %.1f kB, demod %.1f kB, pulses %.1f kB, decoders %.1f kB, grabber %.1f kB, dumpers %.1f kB",
+            total / 1024.0, mem.sdr / 1024.0, mem.demod / 1024.0, mem.pulses / 1024.0,
+            mem.decoders / 1024.0, mem.grabber / 1024.0, mem.dumpers / 1024.0);
+}
+
+static int start_sdr(r_cfg_t *cfg)
+{
+    int r;
+    if (cfg->dev) {
+        // the queued buffers are owned by the old device
+        if (cfg->dsp_thread)
+            dsp_thread_flush(cfg->dsp_thread);
+        r = sdr_close(cfg->dev);
+        cfg->dev = NULL;
+        if (r < 0) {
+            print_logf(LOG_ERROR, "Input", "Closing SDR failed (%d)", r);
+        }
+    }
+    r = sdr_open(&cfg->dev, cfg->dev_query, cfg->verbosity);
+    if (r < 0) {
+        return -1; // exit(2);
+    }
+    // each channel streams from an RX channel of its own, the settings then apply to all
+    unsigned rx_channels = cfg->mimo && cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+    if (rx_channels > 1 && sdr_set_rx_channels(cfg->dev, rx_channels, 1) < 0) { // always verbose
+        return -1;
+    }
+    cfg->dev_info = sdr_get_dev_info(cfg->dev);
     cfg->demod->sample_size = sdr_get_sample_size(cfg->dev);
     // cfg->demod->sample_signed = sdr_get_sample_signed(cfg->dev);
 
@@ -1476,8 +3048,8 @@ static int start_sdr(r_cfg_t *cfg)
 
     sdr_apply_settings(cfg->dev, cfg->settings_str, 1); // always verbose for soapy
 
-    /* Enable automatic gain if gain_str empty (or 0 for RTL-SDR), set manual gain otherwise */
-    sdr_set_tuner_gain(cfg->dev, cfg->gain_str, 1); // always verbose
+    /* Enable automatic gain if gain_str empty (or 0 for RTL-SDR), "agc" for the software control, set manual gain otherwise */
+    apply_tuner_gain(cfg, 1); // always verbose
 
     if (cfg->ppm_error) {
         sdr_set_freq_correction(cfg->dev, cfg->ppm_error, 1); // always verbose
@@ -1494,10 +3066,39 @@ static int start_sdr(r_cfg_t *cfg)
         print_log(LOG_NOTICE, "Input", "Reading samples in async mode...");
     }
 
-    sdr_set_center_freq(cfg->dev, cfg->center_frequency, 1); // always verbose
+    if (rx_channels > 1) {
+        for (unsigned i = 0; i < rx_channels; ++i) {
+            struct dm_state *chan = cfg->channels.elems[i];
+            sdr_set_channel_freq(cfg->dev, chan->rx_channel, chan->frequency, 1); // always verbose
+        }
+    }
+    else {
+        sdr_set_center_freq(cfg->dev, cfg->center_frequency, 1); // always verbose
+    }
 
-    r = sdr_start(cfg->dev, acquire_callback, (void *)get_mgr(cfg),
-            DEFAULT_ASYNC_BUF_NUMBER, cfg->out_block_size);
+    uint32_t buf_num = cfg->latency_ms ? latency_buf_num(cfg->latency_ms) : DEFAULT_ASYNC_BUF_NUMBER;
+    uint32_t buf_len = latency_buf_len(cfg);
+    if (cfg->latency_ms) {
+        print_logf(LOG_NOTICE, "Input", "Latency target %u ms, using %u buffers of %u bytes (%.1f ms)",
+                cfg->latency_ms, buf_num, buf_len, 1000.0 * buf_len / cfg->demod->sample_size / cfg->samp_rate);
+    }
+    mem_budget_fit(cfg, &buf_num, &buf_len);
+    cfg->sdr_buf_bytes = (size_t)(buf_num ? buf_num : SDR_DEFAULT_BUF_NUMBER) * buf_len * rx_channels;
+    // get the sample buffers now, not on the first buffer in the DSP thread
+    unsigned n_chans = cfg->channels.len ? (unsigned)cfg->channels.len : 1;
+    for (unsigned i = 0; i < n_chans; ++i) {
+        struct dm_state *chan = cfg->channels.len ? cfg->channels.elems[i] : cfg->demod;
+        chan->sample_size = cfg->demod->sample_size;
+        if (r_demod_reserve(chan, buf_len / cfg->demod->sample_size))
+            FATAL_MALLOC("start_sdr()");
+    }
+    if (cfg->verbosity || cfg->mem_budget)
+        mem_report(cfg);
+    // the DSP thread releases each buffer after demod, no need to copy them
+    sdr_lease_buffers(cfg->dev, cfg->dsp_thread != NULL);
+    sdr_set_sched(cfg->dev, cfg->sched_acquire, cfg->lock_buffers);
+    cfg->sched_last_us = 0;
+    r = sdr_start(cfg->dev, acquire_callback, (void *)cfg, buf_num, buf_len);
     if (r < 0) {
         print_logf(LOG_ERROR, "Input", "async start failed (%d).", r);
     }
@@ -1510,7 +3111,7 @@ static void timer_handler(struct mg_connection *nc, int ev, void *ev_data)
 {
     //fprintf(stderr, "%s: %d, %d, %p, %p\n", __func__, nc->sock, ev, nc->user_data, ev_data);
     r_cfg_t *cfg = (r_cfg_t *)nc->user_data;
-    if (sig_hup) {
+    if (sig_hup && !cfg->parent) {
         reopen_dumpers(cfg);
         sig_hup = 0;
     }
@@ -1522,6 +3123,11 @@ static void timer_handler(struct mg_connection *nc, int ev, void *ev_data)
         //fprintf(stderr, "timer event, current time: %.2lf, next timer: %.2lf\n", now, next);
         mg_set_timer(nc, next); // Send us timer event again after 1.5 seconds
 
+        // The duty cycle stopped the device on purpose
+        if (cfg->dev_state == DEVICE_STATE_SLEEPING) {
+            break;
+        }
+
         // Did we acquire data frames in the last interval?
         if (cfg->watchdog != 0) {
             if (cfg->dev_state == DEVICE_STATE_STARTING
@@ -1580,6 +3186,1216 @@ static void timer_handler(struct mg_connection *nc, int ev, void *ev_data)
     }
 }
 
+static void duty_handler(struct mg_connection *nc, int ev, void *ev_data)
+{
+    r_cfg_t *cfg = (r_cfg_t *)nc->user_data;
+    (void)ev_data;
+    if (ev != MG_EV_TIMER || cfg->exit_async) {
+        return;
+    }
+    double now = mg_time();
+    double next;
+    int awake = duty_sched_next(cfg->duty_sched, now, &next);
+    if (!awake && cfg->dev_state != DEVICE_STATE_SLEEPING && cfg->dev_state != DEVICE_STATE_STOPPED) {
+        print_logf(LOG_INFO, "Input", "Duty cycle sleeping for %.1f s", next - now);
+        sdr_stop(cfg->dev);
+        // the queued buffers are owned by the device
+        if (cfg->dsp_thread)
+            dsp_thread_flush(cfg->dsp_thread);
+        // closing powers down the tuner
+        int r = sdr_close(cfg->dev);
+        if (r < 0) {
+            print_logf(LOG_ERROR, "Input", "Closing SDR failed (%d)", r);
+        }
+        cfg->dev      = NULL;
+        cfg->dev_info = NULL;
+        cfg->dev_state = DEVICE_STATE_SLEEPING;
+    }
+    else if (awake && cfg->dev_state == DEVICE_STATE_SLEEPING) {
+        print_log(LOG_INFO, "Input", "Duty cycle waking");
+        if (start_sdr(cfg) < 0) {
+            // the watchdog retries or exits by the device mode
+            cfg->dev_state = DEVICE_STATE_GRACE;
+        }
+    }
+    mg_set_timer(nc, next);
+}
+
+/// Set up a channel for each frequency, centered in the capture or on an RX channel of its own, exits on errors.
+static void setup_channels(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+
+    if (demod->dumper.len || demod->am_analyze) {
+        print_log(LOG_ERROR, "Channelize", "Dumpers and the AM analyzer are not supported with channels");
+        exit(1);
+    }
+    if (cfg->mimo && (cfg->channelize || cfg->in_files.len || cfg->frequencies > SDR_RX_CHANNELS_MAX)) {
+        print_logf(LOG_ERROR, "Channelize", "RX channels need an SDR input, up to %d frequencies, and no -Y channelize", SDR_RX_CHANNELS_MAX);
+        exit(1);
+    }
+
+    // each RX channel is tuned to its frequency, the first is the center of the events
+    if (cfg->mimo)
+        cfg->center_frequency = cfg->frequency[0];
+
+    uint32_t f_min = cfg->frequency[0];
+    uint32_t f_max = cfg->frequency[0];
+    for (int i = 1; i < cfg->frequencies; ++i) {
+        if (cfg->frequency[i] < f_min)
+            f_min = cfg->frequency[i];
+        if (cfg->frequency[i] > f_max)
+            f_max = cfg->frequency[i];
+    }
+    if (!cfg->mimo)
+        cfg->center_frequency = f_min + (f_max - f_min) / 2;
+
+    // each channel needs its decimated band inside the capture, input files set the sample rate later
+    unsigned decim_factor = demod->decimation > 0 ? (unsigned)demod->decimation : cfg->samp_rate / DEFAULT_SAMPLE_RATE;
+    decim_factor = decim_factor < 2 ? 2 : decim_factor > DECIM_MAX_FACTOR ? DECIM_MAX_FACTOR : decim_factor;
+    uint32_t max_offset = cfg->samp_rate / 2 - cfg->samp_rate / decim_factor / 2;
+    if (!cfg->mimo && !cfg->in_files.len && (f_max - f_min) / 2 > max_offset) {
+        print_logf(LOG_ERROR, "Channelize", "Frequencies span %u Hz, but only %u Hz fit in the sample rate of %u Hz",
+                f_max - f_min, 2 * max_offset, cfg->samp_rate);
+        exit(1);
+    }
+
+    // channels always decimate, default to auto
+    if (!cfg->mimo && !demod->decimation)
+        demod->decimation = -1;
+
+    list_ensure_size(&cfg->channels, cfg->frequencies);
+    for (int i = 0; i < cfg->frequencies; ++i) {
+        struct dm_state *chan = demod;
+        if (i > 0) {
+            // only copy the settings, the decoders and outputs are kept by the demod
+            chan = calloc(1, sizeof(*chan));
+            if (!chan)
+                FATAL_CALLOC("setup_channels()");
+            chan->auto_level = demod->auto_level;
+            chan->squelch_offset = demod->squelch_offset;
+            chan->level_limit = demod->level_limit;
+            chan->min_level = demod->min_level;
+            chan->min_snr = demod->min_snr;
+            chan->gate_snr = demod->gate_snr;
+            chan->prefilter = demod->prefilter;
+            chan->low_pass = demod->low_pass;
+            chan->use_mag_est = demod->use_mag_est;
+            chan->use_fused_demod = demod->use_fused_demod;
+            chan->detect_verbosity = demod->detect_verbosity;
+            chan->sample_size = demod->sample_size;
+            chan->demod_FM_state.poly = demod->demod_FM_state.poly;
+            chan->decimation = demod->decimation;
+            chan->enable_FM_demod = demod->enable_FM_demod;
+            chan->analyze_pulses = demod->analyze_pulses;
+            chan->pulse_detect = pulse_detect_create();
+            if (!chan->pulse_detect)
+                FATAL_CALLOC("setup_channels()");
+            pulse_detect_set_levels(chan->pulse_detect, chan->use_mag_est, chan->level_limit, chan->min_level, chan->min_snr, chan->detect_verbosity);
+            pulse_detect_set_stream(chan->pulse_detect, stream_pulses_min(&demod->r_devs));
+        }
+        chan->frequency = cfg->frequency[i];
+        list_push(&cfg->channels, chan);
+        if (cfg->mimo) {
+            chan->rx_channel = (unsigned)i;
+            print_logf(LOG_NOTICE, "Channelize", "Channel %d at %u Hz on RX channel %d", i, chan->frequency, i);
+        }
+        else {
+            print_logf(LOG_NOTICE, "Channelize", "Channel %d at %u Hz, offset %d Hz",
+                    i, chan->frequency, (int)(chan->frequency - cfg->center_frequency));
+        }
+    }
+
+    // one channel runs on the DSP thread, decoding stays there too
+    cfg->channel_pool = worker_pool_start(cfg->frequencies - 1);
+}
+
+/// Seed the FSK detectors of the input from the tracked offsets if requested.
+static void setup_fsk_track(r_cfg_t *cfg)
+{
+    pulse_detect_set_fsk_track(cfg->demod->pulse_detect, cfg->fsk_track);
+    for (unsigned i = 0; i < cfg->channels.len; ++i) {
+        struct dm_state *chan = cfg->channels.elems[i];
+        pulse_detect_set_fsk_track(chan->pulse_detect, cfg->fsk_track);
+    }
+}
+
+/// Start the decode thread of the packages detected ahead if requested.
+static void setup_package_queue(r_cfg_t *cfg)
+{
+    if (!cfg->package_queue_len)
+        return;
+    if (cfg->fsk_track) {
+        // the detector is seeded from the packages just decoded
+        print_log(LOG_WARNING, "Decode", "FSK tracking needs each package decoded before the next is detected, not detecting ahead");
+        return;
+    }
+    cfg->package_queue = package_queue_start(cfg->package_queue_len, sdr_decode_task, cfg);
+    if (!cfg->package_queue)
+        print_log(LOG_WARNING, "Decode", "No decode thread available, decoding each package as detected");
+}
+
+/// Set up the load shedding of the decoders if a CPU budget or the quiet skip is requested.
+static void setup_load_shed(r_cfg_t *cfg)
+{
+    uint64_t package_ns = (uint64_t)(cfg->package_budget_ms * 1e6);
+    uint64_t second_ns  = (uint64_t)(cfg->second_budget_ms * 1e6);
+    if (!package_ns && !second_ns && !cfg->quiet_skip)
+        return;
+    cfg->demod->load_shed = load_shed_create(package_ns, second_ns, cfg->quiet_skip);
+    if (!cfg->demod->load_shed)
+        print_log(LOG_WARNING, "Decode", "No load shedding, running all decoders on all packages");
+}
+
+/// Set up the decoder pinning if requested.
+static void setup_decode_pin(r_cfg_t *cfg)
+{
+    if (!cfg->pin_mode)
+        return;
+    if (cfg->pin_mode > 1 && !cfg->pin_sensors.len) {
+        print_log(LOG_WARNING, "Decode", "-Y pin_only needs the sensors given with -Y pin=<model>:<id>, keeping all events");
+        cfg->pin_mode = 1;
+    }
+    cfg->demod->decode_pin = decode_pin_create((char const *const *)cfg->pin_sensors.elems, (unsigned)cfg->pin_sensors.len);
+    if (!cfg->demod->decode_pin) {
+        print_log(LOG_WARNING, "Decode", "No decoder pinning, running the decoders by priority");
+        cfg->pin_mode = 0;
+    }
+}
+
+/// Set up the buffer load shedding if a lag limit is requested.
+static void setup_lag_shed(r_cfg_t *cfg)
+{
+    if (!cfg->lag_skip_ms)
+        return;
+    cfg->lag_shed = lag_shed_create((int64_t)cfg->lag_skip_ms * 1000);
+    if (!cfg->lag_shed)
+        print_log(LOG_WARNING, "Input", "No lag skip, processing all SDR buffers");
+}
+
+/// Open the IQ snippet log if requested, the snippets are of the first input only.
+static void setup_iq_snippet(r_cfg_t *cfg)
+{
+    if (!cfg->snippet_dir)
+        return;
+    cfg->iq_snippet = iq_snippet_create(cfg->snippet_dir, (size_t)cfg->snippet_mb * 1024 * 1024, SIGNAL_GRABBER_BUFFER);
+    if (!cfg->iq_snippet)
+        print_logf(LOG_WARNING, "Input", "No IQ snippets, can't open the log in \"%s\"", cfg->snippet_dir);
+}
+
+/// Start the spectrum monitor if requested, the spectrum is of the first input only.
+static void setup_spectrum(r_cfg_t *cfg)
+{
+    if (!cfg->spectrum_bins)
+        return;
+    cfg->spectrum = spectrum_create(cfg->spectrum_bins, cfg->spectrum_interval);
+    if (!cfg->spectrum)
+        print_log(LOG_WARNING, "Input", "No spectrum monitor");
+    spectrum_set_sched(cfg->spectrum, cfg->sched_workers, "spectrum");
+}
+
+/// Set up the duty cycle if requested, for a single SDR input on one frequency.
+static void setup_duty_sched(r_cfg_t *cfg)
+{
+    if (!cfg->duty_learn)
+        return;
+    if (cfg->in_files.len || cfg->frequencies > 1 || cfg->channels.len || cfg->dev_mode == DEVICE_MODE_MANUAL) {
+        print_log(LOG_WARNING, "Input", "The duty cycle needs an SDR input on a single frequency, listening continuously");
+        return;
+    }
+    cfg->duty_sched = duty_sched_create(cfg->duty_learn, cfg->duty_margin);
+    if (!cfg->duty_sched)
+        print_log(LOG_WARNING, "Input", "No duty cycle");
+}
+
+/// Start the verify mode if requested, without load shedding as the reference runs every decoder.
+static void setup_verify(r_cfg_t *cfg)
+{
+    if (!cfg->verify_prefix)
+        return;
+    cfg->verify = verify_create(cfg->verify_prefix);
+    if (!cfg->verify) {
+        print_log(LOG_WARNING, "Verify", "No verify mode");
+        return;
+    }
+    if (cfg->demod->load_shed) {
+        print_log(LOG_WARNING, "Verify", "Load shedding is off while verifying");
+        load_shed_free(cfg->demod->load_shed);
+        cfg->demod->load_shed = NULL;
+    }
+    if (cfg->demod->decode_pin) {
+        print_log(LOG_WARNING, "Verify", "Decoder pinning is off while verifying");
+        decode_pin_free(cfg->demod->decode_pin);
+        cfg->demod->decode_pin = NULL;
+        cfg->pin_mode          = 0;
+    }
+    if (cfg->file_threads > 1)
+        print_log(LOG_WARNING, "Verify", "Only the input files decoded on the main thread are verified");
+}
+
+/// Set up the adaptive hop scheduler if requested.
+static void setup_hop_sched(r_cfg_t *cfg)
+{
+    if (!cfg->adaptive_hop || cfg->frequencies < 2 || cfg->channels.len || cfg->band_scan > 0)
+        return;
+    cfg->hop_sched = hop_sched_create((unsigned)cfg->frequencies);
+    if (!cfg->hop_sched) {
+        print_log(LOG_WARNING, "Input", "No adaptive hop scheduler, hopping round robin");
+        return;
+    }
+    int hop_index  = cfg->hop_times > cfg->frequency_index ? cfg->frequency_index : cfg->hop_times - 1;
+    cfg->hop_dwell = (uint64_t)cfg->hop_time_ms[hop_index] * cfg->samp_rate / 1000;
+}
+
+/// Apply the hop defaults and set the first frequency of an input.
+static void apply_hop_defaults(r_cfg_t *cfg)
+{
+    if (cfg->frequencies == 0) {
+        cfg->frequency[0] = DEFAULT_FREQUENCY;
+        cfg->frequencies  = 1;
+    }
+    cfg->center_frequency = cfg->frequency[cfg->frequency_index];
+    if (cfg->frequencies > 1 && cfg->hop_times == 0) {
+        cfg->hop_time_ms[cfg->hop_times++] = cfg->band_scan > 0 ? BAND_SCHED_DWELL_MS : DEFAULT_HOP_TIME * 1000;
+    }
+}
+
+/// Set up the band scan if requested, the first input scans for the further inputs.
+static void setup_band_scan(r_cfg_t *cfg)
+{
+    if (cfg->band_scan <= 0)
+        return;
+    if (!cfg->inputs.len || cfg->frequencies < 2 || cfg->in_files.len || cfg->channelize || cfg->mimo) {
+        print_log(LOG_WARNING, "Input", "The band scan needs several -f frequencies and further live inputs (-d), not scanning");
+        cfg->band_scan = 0;
+        return;
+    }
+    if (cfg->adaptive_hop)
+        print_log(LOG_WARNING, "Input", "The band scan hops round robin, ignoring -Y adaptive_hop");
+    cfg->band_sched = band_sched_create(cfg->frequency, (unsigned)cfg->frequencies, (unsigned)cfg->inputs.len, cfg->band_scan);
+    if (!cfg->band_sched) {
+        print_log(LOG_WARNING, "Input", "No band scan scheduler, not scanning");
+        cfg->band_scan = 0;
+        return;
+    }
+    cfg->band_listener = -1;
+}
+
+/// Apply the scheduling settings to the threads of an input and lock its demod state.
+static void setup_thread_sched(r_cfg_t *cfg)
+{
+    dsp_thread_set_sched(cfg->dsp_thread, cfg->sched_dsp);
+    worker_pool_set_sched(cfg->channel_pool, cfg->sched_workers, "channel");
+    worker_pool_set_sched(cfg->decode_pool, cfg->sched_workers, "decode");
+    package_queue_set_sched(cfg->package_queue, cfg->sched_workers, "decode ahead");
+
+    if (cfg->lock_buffers) {
+        // the sample buffers are locked as r_demod_reserve() gets them
+        cfg->demod->lock_buffers = 1;
+        thread_sched_lock_memory(cfg->demod, sizeof(*cfg->demod));
+        for (void **iter = cfg->channels.elems; iter && *iter; ++iter) {
+            struct dm_state *chan = *iter;
+            chan->lock_buffers = 1;
+            if (chan != cfg->demod)
+                thread_sched_lock_memory(chan, sizeof(*chan));
+        }
+    }
+}
+
+/// Set up a further input like the first one and start its DSP thread, exits on errors.
+static void setup_input(r_cfg_t *cfg, r_cfg_t *input)
+{
+    r_start_input(cfg, input);
+
+    if (cfg->band_sched) {
+        // listeners are tuned by the scanner
+        if (input->frequencies > 1)
+            print_logf(LOG_WARNING, "Input", "Band scan listener %s only waits on its first -f frequency", input->dev_query ? input->dev_query : "");
+        input->frequencies     = 1;
+        input->frequency_index = 0;
+        input->band_sched      = cfg->band_sched;
+        for (size_t i = 0; i < cfg->inputs.len; ++i) {
+            if (cfg->inputs.elems[i] == input)
+                input->band_listener = (int)i;
+        }
+    }
+    if ((input->channelize || input->mimo) && input->frequencies > 1) {
+        setup_channels(input);
+    }
+    setup_hop_sched(input);
+    setup_fsk_track(input);
+    if (input->decode_threads > 1) {
+        input->decode_pool = worker_pool_start(input->decode_threads - 1);
+    }
+    setup_package_queue(input);
+    setup_load_shed(input);
+    setup_lag_shed(input);
+
+    input->dsp_thread = dsp_thread_start(latency_buf_num(input->latency_ms) - 2, DSP_EVENT_QUEUE_SIZE,
+            dsp_process_callback, dsp_wakeup_callback, input);
+    if (!input->dsp_thread) {
+        print_log(LOG_ERROR, "Input", "Further inputs need a DSP thread each, exiting!");
+        exit(1);
+    }
+    setup_thread_sched(input);
+}
+
+/// Drain the output queues of all inputs, any input ending ends the main loop.
+static void flush_inputs(r_cfg_t *cfg)
+{
+    flush_output_queue(cfg);
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        r_cfg_t *input = *iter;
+        flush_output_queue(input);
+        if (input->exit_async && !cfg->exit_async) {
+            cfg->exit_code  = input->exit_code;
+            cfg->exit_async = input->exit_async;
+        }
+    }
+}
+
+/// Stop the device and DSP thread of an input and report the final statistics.
+static void stop_input(r_cfg_t *cfg)
+{
+    sdr_stop(cfg->dev);
+    if (cfg->dsp_thread) {
+        dsp_thread_flush(cfg->dsp_thread);
+        expire_merged_events(cfg, 1); // the DSP thread is idle
+        flush_output_queue(cfg);
+    }
+
+    if (cfg->report_stats > 0) {
+        event_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
+        flush_report_data(cfg);
+    }
+
+    dsp_thread_stop(cfg->dsp_thread);
+    cfg->dsp_thread = NULL;
+}
+
+/// Log the achieved against the requested replay rate.
+static void log_replay_rate(r_cfg_t *cfg, replay_pacer_t const *pacer)
+{
+    double input   = pacer->input_ns * 1e-9;
+    double elapsed = replay_pacer_elapsed(pacer);
+    double rate    = replay_pacer_rate(pacer);
+    if (cfg->in_replay_cpu)
+        print_logf(LOG_NOTICE, "Input", "Replayed %.3f s of input in %.3f s, %.2fx realtime (at most %d%% CPU requested)",
+                input, elapsed, rate, cfg->in_replay_cpu);
+    else
+        print_logf(LOG_NOTICE, "Input", "Replayed %.3f s of input in %.3f s, %.2fx realtime (%gx requested, late by up to %.1f ms)",
+                input, elapsed, rate, cfg->in_replay, pacer->late_ns * 1e-6);
+}
+
+/// Dump and decode the package of a pulse input, FSK packages carry the FSK estimates.
+static void decode_pulse_input(r_cfg_t *cfg, struct worker_pool *pool)
+{
+    struct dm_state *demod = cfg->demod;
+    for (void **iter2 = demod->dumper.elems; iter2 && *iter2; ++iter2) {
+        file_info_t const *dumper = *iter2;
+        if (dumper->format == VCD_LOGIC) {
+            pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
+        } else if (dumper->format == PULSE_OOK) {
+            pulse_data_dump(dumper->file, &demod->pulse_data);
+        } else if (dumper->format == PULSE_BIN) {
+            pulse_data_dump_bin(dumper->file, &demod->pulse_data);
+        } else {
+            print_logf(LOG_ERROR, "Input", "Dumper (%s) not supported on OOK input", dumper->spec);
+            exit(1);
+        }
+    }
+
+    if (demod->pulse_data.fsk_f2_est) {
+        run_fsk_demods_pool(pool, demod, &demod->pulse_data);
+    }
+    else {
+        int p_events = run_ook_demods_pool(pool, demod, &demod->pulse_data);
+        if (cfg->discovery && p_events == 0)
+            pulse_clusters_add(cfg->discovery, &demod->pulse_data, PULSE_DATA_OOK);
+        if (cfg->verbosity >= LOG_DEBUG)
+            pulse_data_print(&demod->pulse_data);
+        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
+            analyze_package(cfg, demod, &demod->pulse_data, PULSE_DATA_OOK);
+        }
+    }
+}
+
+#define FARM_POLL_MS 10 ///< wait for a package this long at most, to output the results of the decode workers
+
+/// Decode the packages sent by remote receivers to @p spec, `[host]:port`, until stopped, returns -1 if the socket can't be bound.
+static int64_t read_pulse_datagrams(r_cfg_t *cfg, char const *spec)
+{
+    struct dm_state *demod = cfg->demod;
+    char *param = strdup(spec);
+    if (!param)
+        FATAL_STRDUP("read_pulse_datagrams()");
+    char const *host = "0.0.0.0";
+    char const *port = PULSE_UDP_PORT;
+    hostport_param(param, &host, &port);
+    if (!*host)
+        host = "0.0.0.0";
+
+    pulse_receiver_t *receiver = pulse_receiver_create(host, port);
+    if (!receiver) {
+        print_logf(LOG_ERROR, "Input", "Binding pulse input to %s port %s failed!", host, port);
+        free(param);
+        return -1;
+    }
+    print_logf(LOG_CRITICAL, "Input", "Receiving pulse packages on %s port %s", host, port);
+    free(param);
+    cfg->in_filename = "<udp>";
+
+    // a live input, runs until stopped
+#ifndef _WIN32
+    struct sigaction sigact;
+    sigact.sa_handler = sighandler;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+#else
+    SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
+#endif
+
+    char const *input_name = cfg->input_name;
+    int64_t packages = 0;
+    // wake up often enough to output the merged events shortly after their window
+    int timeout_ms = cfg->merge_ms && cfg->merge_ms < 2000 ? (int)cfg->merge_ms / 4 + 1 : 500;
+    // the network outputs (MQTT, InfluxDB) are serviced between the packages
+    if (cfg->mgr && timeout_ms > 50)
+        timeout_ms = 50;
+    // the results of the decode workers are taken between the packages
+    if (cfg->decode_farm)
+        timeout_ms = FARM_POLL_MS;
+    while (!cfg->exit_async) {
+        int r = pulse_receiver_next(receiver, &demod->pulse_data, timeout_ms);
+        if (cfg->mgr)
+            mg_mgr_poll(cfg->mgr, 0);
+        expire_merged_events(cfg, 0);
+        get_time_now(&demod->now);
+        double now = demod->now.tv_sec + demod->now.tv_usec * 1e-6;
+        if (cfg->decode_farm)
+            decode_farm_poll(cfg->decode_farm, 0, now, output_remote_data, cfg);
+        if (r < 0)
+            break;
+        if (cfg->duration > 0 && time(NULL) >= cfg->stop_time)
+            break;
+        if (r == 0)
+            continue;
+
+        packages++;
+        cfg->samp_rate  = demod->pulse_data.sample_rate ? demod->pulse_data.sample_rate : cfg->samp_rate;
+        // the events are tagged with the sending receiver
+        cfg->input_name = pulse_receiver_peer(receiver);
+        if (cfg->decode_farm)
+            decode_farm_submit(cfg->decode_farm, &demod->pulse_data, cfg->input_name, now);
+        else
+            decode_pulse_input(cfg, cfg->decode_pool);
+    }
+    expire_merged_events(cfg, 1);
+    cfg->input_name = input_name;
+
+    // the last results, a package is given up after DECODE_FARM_RESULT_S
+    while (cfg->decode_farm && decode_farm_pending(cfg->decode_farm)) {
+        get_time_now(&demod->now);
+        decode_farm_poll(cfg->decode_farm, FARM_POLL_MS, demod->now.tv_sec + demod->now.tv_usec * 1e-6, output_remote_data, cfg);
+    }
+    if (cfg->decode_farm) {
+        decode_farm_stats_t farm;
+        decode_farm_get_stats(cfg->decode_farm, demod->now.tv_sec + demod->now.tv_usec * 1e-6, &farm);
+        print_logf(LOG_NOTICE, "Farm", "Sent %u packages to %u decode workers, %u dropped, %u results lost",
+                farm.sent, farm.workers, farm.dropped, farm.lost);
+    }
+
+    if (pulse_receiver_invalid(receiver))
+        print_logf(LOG_WARNING, "Input", "Dropped %u invalid datagrams", pulse_receiver_invalid(receiver));
+    print_logf(LOG_NOTICE, "Input", "Received %" PRId64 " pulse packages", packages);
+    pulse_receiver_free(receiver);
+    return 0;
+}
+
+/// Pass an output of the decoders to the result of a decode worker.
+static void forward_worker_output(void *ctx, data_t *data, int level)
+{
+    decode_worker_add(ctx, data, level);
+}
+
+/// Decode the packages a coordinator (-Y farm) sends to @p spec, `[host]:port`, and send the output back, until stopped, returns -1 if the socket can't be bound.
+static int64_t read_farm_packages(r_cfg_t *cfg, char const *spec)
+{
+    struct dm_state *demod = cfg->demod;
+    char *param = strdup(spec);
+    if (!param)
+        FATAL_STRDUP("read_farm_packages()");
+    char const *host = "0.0.0.0";
+    char const *port = DECODE_FARM_PORT;
+    hostport_param(param, &host, &port);
+    if (!*host)
+        host = "0.0.0.0";
+
+    decode_worker_t *worker = decode_worker_create(host, port);
+    if (!worker) {
+        print_logf(LOG_ERROR, "Input", "Binding decode worker to %s port %s failed!", host, port);
+        free(param);
+        return -1;
+    }
+    print_logf(LOG_CRITICAL, "Input", "Decoding farm packages on %s port %s", host, port);
+    free(param);
+    cfg->in_filename = "<farm>";
+
+    // a live input, runs until stopped
+#ifndef _WIN32
+    struct sigaction sigact;
+    sigact.sa_handler = sighandler;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+#else
+    SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
+#endif
+
+    // the output goes to the coordinator, one package is decoded at a time, more workers scale out
+    char const *input_name = cfg->input_name;
+    list_t *output_capture = cfg->output_capture;
+    list_t capture = {0};
+    cfg->output_capture = &capture;
+    int64_t packages = 0;
+    int timeout_ms = cfg->merge_ms && cfg->merge_ms < 2000 ? (int)cfg->merge_ms / 4 + 1 : 500;
+    if (cfg->mgr && timeout_ms > 50)
+        timeout_ms = 50;
+    while (!cfg->exit_async) {
+        int r = decode_worker_next(worker, &demod->pulse_data, timeout_ms);
+        if (cfg->mgr)
+            mg_mgr_poll(cfg->mgr, 0);
+        expire_merged_events(cfg, 0);
+        if (r < 0)
+            break;
+        if (cfg->duration > 0 && time(NULL) >= cfg->stop_time)
+            break;
+        if (r > 0) {
+            packages++;
+            // the time the coordinator received the package
+            double now = decode_worker_time(worker);
+            demod->now.tv_sec  = (time_t)now;
+            demod->now.tv_usec = (long)((now - (double)demod->now.tv_sec) * 1e6);
+            cfg->samp_rate     = demod->pulse_data.sample_rate ? demod->pulse_data.sample_rate : cfg->samp_rate;
+            // the events are tagged with the receiver of the package
+            cfg->input_name = decode_worker_source(worker);
+            decode_pulse_input(cfg, NULL);
+        }
+        forward_output_capture(&capture, forward_worker_output, worker);
+        decode_worker_reply(worker);
+    }
+    expire_merged_events(cfg, 1);
+    forward_output_capture(&capture, forward_worker_output, worker);
+    decode_worker_reply(worker);
+    list_free_elems(&capture, free);
+    cfg->output_capture = output_capture;
+    cfg->input_name     = input_name;
+
+    if (decode_worker_truncated(worker))
+        print_logf(LOG_WARNING, "Input", "Dropped %u outputs too large for a result", decode_worker_truncated(worker));
+    print_logf(LOG_NOTICE, "Input", "Decoded %" PRId64 " farm packages", packages);
+    decode_worker_free(worker);
+    return 0;
+}
+
+/// Decode the text packages of a gateway at @p spec, stdin, a device, or `tcp://host:port`, until stopped or the end, returns -1 if it can't be opened.
+static int64_t read_pulse_text(r_cfg_t *cfg, char const *spec)
+{
+    struct dm_state *demod = cfg->demod;
+    pulse_text_t *text = pulse_text_open(spec, cfg->samp_rate);
+    if (!text) {
+        print_logf(LOG_ERROR, "Input", "Opening text input %s failed!", spec);
+        return -1;
+    }
+    print_logf(LOG_CRITICAL, "Input", "Reading text packages from %s", spec);
+    cfg->in_filename = spec;
+
+    // a live input, runs until stopped or the end of the input
+#ifndef _WIN32
+    struct sigaction sigact;
+    sigact.sa_handler = sighandler;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+#else
+    SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
+#endif
+
+    int64_t packages = 0;
+    int timeout_ms = cfg->merge_ms && cfg->merge_ms < 2000 ? (int)cfg->merge_ms / 4 + 1 : 500;
+    // the network outputs (MQTT, InfluxDB) are serviced between the packages
+    if (cfg->mgr && timeout_ms > 50)
+        timeout_ms = 50;
+    while (!cfg->exit_async) {
+        int r = pulse_text_next(text, &demod->pulse_data, timeout_ms);
+        if (cfg->mgr)
+            mg_mgr_poll(cfg->mgr, 0);
+        expire_merged_events(cfg, 0);
+        if (r < 0)
+            break;
+        if (cfg->duration > 0 && time(NULL) >= cfg->stop_time)
+            break;
+        if (r == PULSE_TEXT_NONE)
+            continue;
+
+        packages++;
+        get_time_now(&demod->now);
+        if (r == PULSE_TEXT_BITS) {
+            for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+                r_device *r_dev = *iter;
+                pulse_slicer_string(pulse_text_bits(text), r_dev);
+            }
+            continue;
+        }
+        cfg->samp_rate = demod->pulse_data.sample_rate ? demod->pulse_data.sample_rate : cfg->samp_rate;
+        decode_pulse_input(cfg, cfg->decode_pool);
+    }
+    expire_merged_events(cfg, 1);
+
+    if (pulse_text_invalid(text))
+        print_logf(LOG_WARNING, "Input", "Skipped %u invalid lines", pulse_text_invalid(text));
+    print_logf(LOG_NOTICE, "Input", "Read %" PRId64 " text packages", packages);
+    pulse_text_free(text);
+    return 0;
+}
+
+/// Read and decode an input file from @p block_from to @p block_to (0 for the end), returns the number of samples read or -1 if the file can't be read.
+static int64_t read_input_file(r_cfg_t *cfg, char const *filename, uint32_t sample_rate_0, uint32_t center_frequency_0, unsigned char *test_mode_buf,
+        uint64_t block_from, uint64_t block_to)
+{
+    struct dm_state *demod = cfg->demod;
+    if (!strncmp(filename, "udp://", 6))
+        return read_pulse_datagrams(cfg, filename + 6);
+    if (!strncmp(filename, "farm://", 7))
+        return read_farm_packages(cfg, filename + 7);
+    if (!strncmp(filename, "text:", 5))
+        return read_pulse_text(cfg, filename + 5);
+    if (!strncmp(filename, "tcp://", 6))
+        return read_pulse_text(cfg, filename);
+    cfg->in_filename = filename;
+
+    file_info_clear(&demod->load_info); // reset all info
+    file_info_parse_filename(&demod->load_info, cfg->in_filename);
+    // apply file info or default
+    cfg->samp_rate        = demod->load_info.sample_rate ? demod->load_info.sample_rate : sample_rate_0;
+    cfg->center_frequency = demod->load_info.center_frequency ? demod->load_info.center_frequency : center_frequency_0;
+
+    FILE *in_file = NULL;
+    file_input_t *in_samples = NULL;
+    gated_iq_reader_t *in_gated = NULL;
+    if (strcmp(demod->load_info.path, "-") == 0) { // read samples from stdin
+        cfg->in_filename = "<stdin>";
+    }
+    int pulse_input = demod->load_info.format == PULSE_OOK || demod->load_info.format == PULSE_BIN;
+    if (pulse_input) {
+        in_file = strcmp(demod->load_info.path, "-") == 0 ? stdin : fopen(demod->load_info.path, "rb");
+    } else if (demod->load_info.format == GIQ_CU8 || demod->load_info.format == GIQ_CS16) {
+        in_gated = gated_iq_reader_open(demod->load_info.path);
+    } else if ((demod->load_info.format & 0xffff0000) == F_SIGMF) {
+        // the format, sample rate, and frequency are in the metadata
+        sigmf_info_t info;
+        if (strcmp(demod->load_info.path, "-") == 0) {
+            print_log(LOG_ERROR, "Input", "SigMF input needs a file name");
+            return -1;
+        }
+        if (sigmf_read_meta(demod->load_info.path, &info))
+            return -1;
+        demod->load_info.format = info.format;
+        if (info.sample_rate)
+            cfg->samp_rate = info.sample_rate;
+        if (info.center_frequency)
+            cfg->center_frequency = info.center_frequency;
+        print_logf(LOG_NOTICE, "Input", "SigMF dataset \"%s\" at %u Hz, %u sps", info.data_path, cfg->center_frequency, cfg->samp_rate);
+        in_samples = file_input_open(info.data_path, demod->load_info.format, DEFAULT_BUF_LENGTH);
+        free(info.data_path);
+    } else {
+        in_samples = file_input_open(demod->load_info.path, demod->load_info.format, DEFAULT_BUF_LENGTH);
+    }
+    if (!in_file && !in_samples && !in_gated) {
+        print_logf(LOG_ERROR, "Input", "Opening file \"%s\" failed!", cfg->in_filename);
+        return -1;
+    }
+    // the batch prints this with the captured output
+    if (!cfg->output_capture)
+        print_logf(LOG_CRITICAL, "Input", "Test mode active. Reading samples from file: %s", cfg->in_filename); // Essential information (not quiet)
+    if (in_gated) {
+        // the sample format is in the file header
+        demod->sample_size = gated_iq_reader_format(in_gated) == CU8_IQ ? sizeof(uint8_t) * 2 : sizeof(int16_t) * 2;
+        demod->load_info.format = demod->sample_size == 2 ? GIQ_CU8 : GIQ_CS16;
+    } else if (demod->load_info.format == CU8_IQ
+            || demod->load_info.format == CS8_IQ
+            || demod->load_info.format == S16_AM
+            || demod->load_info.format == S16_FM) {
+        demod->sample_size = sizeof(uint8_t) * 2; // CU8, AM, FM
+    } else if (demod->load_info.format == CS16_IQ
+            || demod->load_info.format == CF32_IQ) {
+        demod->sample_size = sizeof(int16_t) * 2; // CS16, CF32 (after conversion)
+    } else if (pulse_input) {
+        // ignore
+    } else {
+        print_logf(LOG_ERROR, "Input", "Input format invalid \"%s\"", file_info_string(&demod->load_info));
+        file_input_close(in_samples);
+        return -1;
+    }
+    if (cfg->verbosity >= LOG_NOTICE) {
+        print_logf(LOG_NOTICE, "Input", "Input format \"%s\"%s", file_info_string(&demod->load_info),
+                in_samples && file_input_is_mapped(in_samples) ? " (mapped)" : "");
+    }
+    if (in_gated && cfg->verbosity >= LOG_NOTICE && gated_iq_reader_segments(in_gated)) {
+        unsigned segments = gated_iq_reader_segments(in_gated);
+        double recorded   = 0.0;
+        for (unsigned i = 0; i < segments; ++i) {
+            gated_iq_segment_t const *seg = gated_iq_reader_segment(in_gated, i);
+            recorded += seg->sample_rate ? (double)seg->n_samples / seg->sample_rate : 0.0;
+        }
+        print_logf(LOG_NOTICE, "Input", "Gated recording of %u segments with %.3f s of samples", segments, recorded);
+    }
+    demod->sample_file_pos = 0.0;
+
+    replay_pacer_t pacer;
+    int replay = cfg->in_replay > 0.0 || cfg->in_replay_cpu;
+    if (replay)
+        replay_pacer_start(&pacer, cfg->in_replay, (unsigned)cfg->in_replay_cpu);
+
+    // special case for pulse data file-inputs
+    if (pulse_input) {
+        int binary = demod->load_info.format == PULSE_BIN;
+#ifdef _WIN32
+        if (binary && in_file == stdin)
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        if (binary && pulse_data_load_bin_header(in_file)) {
+            print_logf(LOG_ERROR, "Input", "Reading pulse data from \"%s\" failed!", cfg->in_filename);
+            if (in_file != stdin)
+                fclose(in_file);
+            return -1;
+        }
+        while (!cfg->exit_async) {
+            if (binary)
+                pulse_data_load_bin(in_file, &demod->pulse_data);
+            else
+                pulse_data_load(in_file, &demod->pulse_data, cfg->samp_rate);
+            if (!demod->pulse_data.num_pulses)
+                break;
+            // only the binary format has the package offsets, the text format is not paced
+            if (replay && demod->pulse_data.sample_rate)
+                replay_pacer_wait(&pacer, (uint64_t)(demod->pulse_data.offset * 1e9 / demod->pulse_data.sample_rate));
+
+            decode_pulse_input(cfg, NULL);
+        }
+
+        if (in_file != stdin) {
+            fclose(in_file);
+        }
+        if (replay)
+            log_replay_rate(cfg, &pacer);
+
+        return 0;
+    }
+
+    // default case for file-inputs
+    int64_t n_samples = 0;
+    uint64_t n_blocks = block_from; // the positions count from the start of the file
+    unsigned long n_read;
+
+    // gated recordings replay their records, the squelched gaps only advance the input position
+    if (in_gated) {
+        uint64_t end_offset = 0; // sample offset of the input position
+        gated_iq_segment_t rec;
+        uint8_t *block;
+        size_t len;
+        while (!cfg->exit_async && (len = gated_iq_reader_read(in_gated, &block, &rec)) > 0) {
+            if (rec.sample_offset > end_offset) {
+                // keep the sample offsets of pulses accurate, as with a skipping SDR
+                cfg->input_pos += rec.sample_offset - end_offset;
+                if (replay)
+                    replay_pacer_advance(&pacer, rec.sample_offset - end_offset, rec.sample_rate);
+            }
+            end_offset = rec.sample_offset + rec.n_samples;
+            cfg->samp_rate        = rec.sample_rate ? rec.sample_rate : cfg->samp_rate;
+            cfg->center_frequency = rec.center_frequency;
+            for (size_t pos = 0; pos < len && !cfg->exit_async; pos += n_read) {
+                n_read = MIN(len - pos, DEFAULT_BUF_LENGTH);
+                if (replay)
+                    replay_pacer_advance(&pacer, n_read / demod->sample_size, cfg->samp_rate);
+                demod->sample_file_pos = (double)(rec.sample_offset + (pos + n_read) / demod->sample_size) / cfg->samp_rate;
+                n_blocks++;
+                n_samples += n_read / demod->sample_size;
+                sdr_callback(block + pos, n_read, cfg);
+            }
+        }
+        demod->sample_file_pos = (double)end_offset / cfg->samp_rate;
+    }
+    else if (block_from && file_input_seek_block(in_samples, block_from)) {
+        print_logf(LOG_ERROR, "Input", "Seeking in file \"%s\" failed!", cfg->in_filename);
+        file_input_close(in_samples);
+        return -1;
+    }
+    while (in_samples) {
+        // CF32 is converted to CS16 and CS8 to CU8, other formats are read in place if mapped
+        uint8_t *block;
+        n_read = block_to && n_blocks >= block_to ? 0 : file_input_read(in_samples, &block);
+        if (n_read == 0) break;  // sdr_callback() will Segmentation Fault with len=0
+        // Replay in realtime if requested, the samples are due once their time has passed
+        if (replay)
+            replay_pacer_advance(&pacer, n_read / demod->sample_size, cfg->samp_rate);
+        demod->sample_file_pos = ((float)n_blocks * DEFAULT_BUF_LENGTH + n_read) / cfg->samp_rate / demod->sample_size;
+        n_blocks++; // this assumes n_read == DEFAULT_BUF_LENGTH
+        n_samples += n_read / demod->sample_size;
+        sdr_callback(block, n_read, cfg);
+        if (cfg->exit_async)
+            break;
+    }
+
+    // Call a last time with cleared samples to ensure EOP detection
+    if (demod->sample_size == 2) { // CU8
+        memset(test_mode_buf, 128, DEFAULT_BUF_LENGTH); // 128 is 0 in unsigned data
+        // or is 127.5 a better 0 in cu8 data?
+        //for (unsigned long n = 0; n < DEFAULT_BUF_LENGTH/2; n++)
+        //    ((uint16_t *)test_mode_buf)[n] = 0x807f;
+    }
+    else { // CF32, CS16
+            memset(test_mode_buf, 0, DEFAULT_BUF_LENGTH);
+    }
+    if (in_gated)
+        demod->sample_file_pos += (double)DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size;
+    else
+        demod->sample_file_pos = ((float)n_blocks + 1) * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size;
+    sdr_callback(test_mode_buf, DEFAULT_BUF_LENGTH, cfg);
+
+    //Always classify a signal at the end of the file
+    if (demod->am_analyze)
+        am_analyze_classify(demod->am_analyze);
+    if (cfg->verbosity >= LOG_NOTICE) {
+        print_logf(LOG_NOTICE, "Input", "Test mode file issued %d packets", (int)(n_blocks - block_from));
+    }
+    if (replay)
+        log_replay_rate(cfg, &pacer);
+
+    file_input_close(in_samples);
+    gated_iq_reader_close(in_gated);
+    return n_samples;
+}
+
+/// Check if the input files can be decoded on several threads, returns the reason if not.
+static char const *file_batch_unsupported(r_cfg_t *cfg)
+{
+#ifndef THREADS
+    (void)cfg;
+    return "built without threads";
+#else
+    struct dm_state *demod = cfg->demod;
+    if (demod->dumper.len || demod->samp_grab || cfg->iq_snippet || demod->am_analyze || demod->analyze_pulses)
+        return "dumpers, the grabber, the IQ snippets, and the analyzers need the first input";
+    if (cfg->raw_handler.len)
+        return "the raw outputs need the first input";
+    if (cfg->channels.len)
+        return "channels are not supported";
+    if (cfg->after_successful_events_flag || cfg->bytes_to_read)
+        return "-E and -n stop after the first files";
+    for (void **iter = cfg->in_files.elems; iter && *iter; ++iter) {
+        file_info_t info = {0};
+        file_info_parse_filename(&info, *iter);
+        if (!strcmp(info.path, "-"))
+            return "stdin can't be read in parallel";
+        if (!strncmp(*iter, "udp://", 6) || !strncmp(*iter, "farm://", 7))
+            return "the UDP pulse input runs until stopped";
+        if (!strncmp(*iter, "text:", 5) || !strncmp(*iter, "tcp://", 6))
+            return "the text input is read live";
+    }
+    return NULL;
+#endif
+}
+
+#ifdef THREADS
+#define FILE_CHUNK_PACKAGE_MS 2000 ///< longest package expected across a chunk boundary
+#define FILE_CHUNK_OVERLAP_MS (PD_MAX_GAP_MS + FILE_CHUNK_PACKAGE_MS) ///< a chunk is read this much before and after its range
+#define FILE_CHUNK_SEARCH_MS  1000 ///< a chunk boundary is placed this much around the even split
+#define FILE_CHUNK_WINDOW_MS  1    ///< length of the noise level windows to place a chunk boundary in
+
+/// An input file or a chunk of a file of a batch, decoded by an input of its own.
+typedef struct file_job {
+    char const *filename;
+    unsigned chunk;       ///< index of the chunk, 0 for the first chunk or the whole file
+    uint64_t block_from;  ///< first block to read
+    uint64_t block_to;    ///< block to stop reading at, 0 for the end of the file
+    uint64_t sample_from; ///< first sample of the range to output
+    uint64_t sample_to;   ///< sample to end the range to output at
+    double output_from;   ///< the range to output in seconds, see r_cfg.output_from
+    double output_to;
+    list_t records;       ///< the captured output, printed in file order
+    int64_t n_samples;    ///< samples of the output range read, -1 if the file can't be read
+    int done;             ///< decoded and waiting to be printed
+} file_job_t;
+
+/// Input files decoded on several threads, see read_input_files().
+typedef struct file_batch {
+    r_cfg_t *cfg;
+    uint32_t sample_rate_0;
+    uint32_t center_frequency_0;
+    file_job_t *jobs;
+    unsigned jobs_len;
+    unsigned next_print;          ///< index of the next job to print
+    int printing;                 ///< a thread prints the done jobs
+    r_logger_handler log_handler; ///< the wrapped log handler
+    void *log_userdata;
+    pthread_mutex_t lock;       ///< lock for the jobs and to set up the inputs
+    pthread_mutex_t print_lock; ///< lock for the outputs, taken after the lock
+} file_batch_t;
+
+/// Find the quietest window around a sample position of a file, returns the position in the middle of the window.
+static uint64_t find_quiet_position(file_input_t *in, unsigned sample_size, uint64_t pos, uint64_t search, unsigned window)
+{
+    uint64_t block_samples = DEFAULT_BUF_LENGTH / sample_size;
+    uint64_t from          = pos > search ? pos - search : 0;
+    uint64_t to            = pos + search;
+    uint64_t sample        = from / block_samples * block_samples;
+    if (file_input_seek_block(in, from / block_samples))
+        return pos;
+
+    uint64_t best_pos   = pos;
+    uint64_t best_level = UINT64_MAX;
+    uint64_t level      = 0;
+    unsigned n          = 0;
+    uint8_t *buf;
+    size_t len;
+    while (sample < to && (len = file_input_read(in, &buf)) > 0) {
+        size_t count = len / sample_size;
+        for (size_t i = 0; i < count && sample < to; ++i, ++sample) {
+            if (sample < from)
+                continue;
+            if (sample_size == 2) {
+                level += (unsigned)abs(buf[2 * i] - 128) + (unsigned)abs(buf[2 * i + 1] - 128);
+            }
+            else {
+                int16_t const *iq = (int16_t const *)buf;
+                level += (unsigned)abs(iq[2 * i]) + (unsigned)abs(iq[2 * i + 1]);
+            }
+            if (++n == window) {
+                if (level < best_level) {
+                    best_level = level;
+                    best_pos   = sample - window / 2;
+                }
+                level = 0;
+                n     = 0;
+            }
+        }
+    }
+    return best_pos;
+}
+
+/** Split an input file into chunks at quiet positions, returns the number of jobs set up.
+
+    Each chunk outputs the packages starting in its range and reads the overlap
+    before and after, to settle the levels and to finish the packages in progress.
+*/
+static unsigned plan_file_chunks(char const *filename, uint32_t sample_rate_0, unsigned chunks, file_job_t *jobs)
+{
+    jobs[0] = (file_job_t){.filename = filename, .sample_to = UINT64_MAX};
+
+    file_info_t info = {0};
+    file_info_parse_filename(&info, filename);
+    uint32_t samp_rate = info.sample_rate ? info.sample_rate : sample_rate_0;
+    unsigned sample_size;
+    if (info.format == CU8_IQ || info.format == CS8_IQ)
+        sample_size = sizeof(uint8_t) * 2;
+    else if (info.format == CS16_IQ || info.format == CF32_IQ)
+        sample_size = sizeof(int16_t) * 2; // CF32 is converted to CS16
+    else
+        return 1; // other formats are read as a whole
+    file_input_t *in = file_input_open(info.path, info.format, DEFAULT_BUF_LENGTH);
+    if (!in)
+        return 1; // the error is logged when reading
+
+    uint64_t block_samples = DEFAULT_BUF_LENGTH / sample_size;
+    uint64_t samples       = file_input_blocks(in) * block_samples;
+    uint64_t overlap       = (uint64_t)samp_rate * FILE_CHUNK_OVERLAP_MS / 1000;
+    // each chunk should be much longer than its overlap
+    uint64_t max_chunks = overlap ? samples / (10 * overlap) : 0;
+    if (chunks > max_chunks)
+        chunks = (unsigned)max_chunks;
+    if (chunks < 2) {
+        file_input_close(in);
+        return 1;
+    }
+
+    uint64_t search = (uint64_t)samp_rate * FILE_CHUNK_SEARCH_MS / 1000;
+    unsigned window = samp_rate * FILE_CHUNK_WINDOW_MS / 1000;
+    uint64_t from   = 0;
+    for (unsigned i = 0; i < chunks; ++i) {
+        int last    = i == chunks - 1;
+        uint64_t to = last ? UINT64_MAX : find_quiet_position(in, sample_size, samples * (i + 1) / chunks, search, window ? window : 1);
+        jobs[i] = (file_job_t){
+                .filename    = filename,
+                .chunk       = i,
+                .block_from  = from > overlap ? (from - overlap) / block_samples : 0,
+                .block_to    = last ? 0 : (to + overlap + block_samples - 1) / block_samples,
+                .sample_from = from,
+                .sample_to   = to,
+                .output_from = i == 0 ? -DBL_MAX : (double)from / samp_rate,
+                .output_to   = last ? DBL_MAX : (double)to / samp_rate,
+        };
+        print_logf(LOG_INFO, "Input", "Chunk %u of \"%s\" from %.3f s", i, filename, (double)from / samp_rate);
+        from = to;
+    }
+    file_input_close(in);
+    return chunks;
+}
+
+/// Log from any thread of the batch, the log is not kept in file order.
+static void file_batch_log_handler(log_level_t level, char const *src, char const *msg, void *userdata)
+{
+    file_batch_t *batch = userdata;
+
+    pthread_mutex_lock(&batch->print_lock);
+    if (batch->log_handler)
+        batch->log_handler(level, src, msg, batch->log_userdata);
+    else
+        fprintf(stderr, "%s: %s\n", src, msg);
+    pthread_mutex_unlock(&batch->print_lock);
+}
+
+/// Print the done jobs in file order, call with the lock held.
+static void file_batch_print(file_batch_t *batch)
+{
+    // only one thread prints, the others leave their jobs to it
+    if (batch->printing)
+        return;
+    batch->printing = 1;
+    while (batch->next_print < batch->jobs_len && batch->jobs[batch->next_print].done) {
+        file_job_t *job = &batch->jobs[batch->next_print];
+        if (job->n_samples >= 0 && job->chunk == 0)
+            print_logf(LOG_CRITICAL, "Input", "Test mode active. Reading samples from file: %s", job->filename); // Essential information (not quiet)
+        pthread_mutex_lock(&batch->print_lock);
+        flush_output_capture(batch->cfg, &job->records);
+        pthread_mutex_unlock(&batch->print_lock);
+        batch->next_print++;
+    }
+    batch->printing = 0;
+}
+
+static void read_input_file_task(void *ctx, unsigned task)
+{
+    file_batch_t *batch = ctx;
+    r_cfg_t *cfg        = batch->cfg;
+    file_job_t *job     = &batch->jobs[task];
+
+    pthread_mutex_lock(&batch->lock);
+    r_cfg_t *input = NULL;
+    if (!cfg->exit_async) {
+        // a fresh input with the settings of the first one
+        input = calloc(1, sizeof(*input));
+        if (!input)
+            FATAL_CALLOC("read_input_file_task()");
+        input->ppm_error        = cfg->ppm_error;
+        input->frequencies      = cfg->frequencies;
+        input->frequency_index  = cfg->frequency_index;
+        input->center_frequency = cfg->center_frequency;
+        input->hop_times        = cfg->hop_times;
+        input->samp_rate        = cfg->samp_rate;
+        memcpy(input->frequency, cfg->frequency, sizeof(input->frequency));
+        memcpy(input->hop_time_ms, cfg->hop_time_ms, sizeof(input->hop_time_ms));
+        r_start_input(cfg, input);
+        setup_hop_sched(input);
+        setup_fsk_track(input);
+        input->output_capture = &job->records;
+        input->output_from    = job->output_from;
+        input->output_to      = job->output_to;
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    job->n_samples = -1;
+    if (input) {
+        unsigned char *test_mode_buf = malloc(DEFAULT_BUF_LENGTH * sizeof(unsigned char));
+        if (!test_mode_buf)
+            FATAL_MALLOC("test_mode_buf");
+        int64_t n_read = read_input_file(input, job->filename, batch->sample_rate_0, batch->center_frequency_0, test_mode_buf,
+                job->block_from, job->block_to);
+        free(test_mode_buf);
+        if (n_read >= 0) {
+            // count the output range only, the overlap of the chunks is read twice
+            uint64_t read_from = job->block_from ? job->block_from * (DEFAULT_BUF_LENGTH / input->demod->sample_size) : 0;
+            uint64_t read_to   = read_from + (uint64_t)n_read;
+            uint64_t to        = MIN(read_to, job->sample_to);
+            job->n_samples     = to > job->sample_from ? (int64_t)(to - job->sample_from) : 0;
+        }
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    if (input) {
+        // e.g. the time expired, skip the remaining files
+        if (input->exit_async)
+            cfg->exit_async = input->exit_async;
+        r_free_input(input);
+    }
+    job->done = 1;
+    file_batch_print(batch);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/// Decode the input files on several threads, each file or chunk of a file with an input of its own, the output keeps the file order.
+static void read_input_files(r_cfg_t *cfg, unsigned threads, uint32_t sample_rate_0, uint32_t center_frequency_0)
+{
+    file_batch_t batch = {
+            .cfg                = cfg,
+            .sample_rate_0      = sample_rate_0,
+            .center_frequency_0 = center_frequency_0,
+    };
+    // split the files into chunks if there are fewer files than threads
+    unsigned files  = (unsigned)cfg->in_files.len;
+    unsigned chunks = files < threads ? (threads + files - 1) / files : 1;
+    batch.jobs      = calloc(files * chunks, sizeof(*batch.jobs));
+    if (!batch.jobs)
+        FATAL_CALLOC("read_input_files()");
+    for (unsigned i = 0; i < files; ++i)
+        batch.jobs_len += plan_file_chunks(cfg->in_files.elems[i], sample_rate_0, chunks, &batch.jobs[batch.jobs_len]);
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_mutex_init(&batch.print_lock, NULL);
+
+    // the inputs share the outputs and the mongoose manager of the first input
+    get_mgr(cfg);
+    // the pool threads log too, wrap the handler before they start
+    r_logger_get_log_handler(&batch.log_handler, &batch.log_userdata);
+    r_logger_set_log_handler(file_batch_log_handler, &batch);
+
+    worker_pool_t *pool = worker_pool_start(MIN(threads, batch.jobs_len) - 1);
+    if (!pool)
+        print_log(LOG_WARNING, "Input", "No file threads available, decoding the files on one thread");
+    unsigned n_threads = pool ? MIN(threads, batch.jobs_len) : 1;
+    worker_pool_set_sched(pool, cfg->sched_workers, "file");
+
+    struct timeval start;
+    get_time_now(&start);
+    worker_pool_run(pool, batch.jobs_len, read_input_file_task, &batch);
+    struct timeval end;
+    get_time_now(&end);
+
+    worker_pool_stop(pool);
+    r_logger_set_log_handler(batch.log_handler, batch.log_userdata);
+
+    int64_t n_samples = 0;
+    unsigned n_files  = 0;
+    for (unsigned i = 0; i < batch.jobs_len; ++i) {
+        if (batch.jobs[i].n_samples < 0)
+            continue;
+        n_samples += batch.jobs[i].n_samples;
+        if (batch.jobs[i].chunk == 0)
+            n_files++;
+    }
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    print_logf(LOG_CRITICAL, "Input", "Decoded %u files, %llu samples in %.3f s, %.0f samples/s on %u threads",
+            n_files, (unsigned long long)n_samples, elapsed, elapsed > 0 ? n_samples / elapsed : 0.0, n_threads);
+
+    pthread_mutex_destroy(&batch.print_lock);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.jobs);
+}
+#endif
+
 int main(int argc, char **argv) {
     int r = 0;
     struct dm_state *demod;
@@ -1601,14 +4417,9 @@ int main(int argc, char **argv) {
     }
 
     parse_conf_args(cfg, argc, argv);
-    // apply hop defaults and set first frequency
-    if (cfg->frequencies == 0) {
-        cfg->frequency[0] = DEFAULT_FREQUENCY;
-        cfg->frequencies  = 1;
-    }
-    cfg->center_frequency = cfg->frequency[cfg->frequency_index];
-    if (cfg->frequencies > 1 && cfg->hop_times == 0) {
-        cfg->hop_time[cfg->hop_times++] = DEFAULT_HOP_TIME;
+    apply_hop_defaults(cfg);
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        apply_hop_defaults(*iter);
     }
     // save sample rate, this should be a hop config too
     uint32_t sample_rate_0 = cfg->samp_rate;
@@ -1634,7 +4445,11 @@ int main(int argc, char **argv) {
     }
 
     if (cfg->report_time == REPORT_TIME_DEFAULT) {
-        if (cfg->in_files.len)
+        // the packages of a UDP pulse input arrive live, the local time is their receive time
+        int live_pulses = 0;
+        for (void **iter = cfg->in_files.elems; iter && *iter; ++iter)
+            live_pulses |= !strncmp(*iter, "udp://", 6) || !strncmp(*iter, "farm://", 7) || !strncmp(*iter, "text:", 5) || !strncmp(*iter, "tcp://", 6);
+        if (cfg->in_files.len && !live_pulses)
             cfg->report_time = REPORT_TIME_SAMPLES;
         else
             cfg->report_time = REPORT_TIME_DATE;
@@ -1650,6 +4465,11 @@ int main(int argc, char **argv) {
 #endif
     }
 
+    // tag the events with the input when there are several
+    if (cfg->inputs.len) {
+        cfg->input_name = cfg->dev_query;
+    }
+
     if (!cfg->output_handler.len) {
         add_kv_output(cfg, NULL);
     }
@@ -1664,19 +4484,78 @@ int main(int argc, char **argv) {
     if (!cfg->no_default_devices) {
         register_all_protocols(cfg, 0); // register all defaults
     }
-
-    // check if we need FM demod
-    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
-        r_device *r_dev = *iter;
-        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL) {
-            demod->enable_FM_demod = 1;
-            break;
+    r_prepare_conversions(cfg);
+    r_prepare_decode_memo(cfg);
+    // the decoders skip formatting messages no output takes
+    r_update_log_level(cfg);
+    // the further inputs start later and share the signal shapes
+    if (cfg->discover)
+        cfg->discovery = pulse_clusters_create(1);
+    if (cfg->merge_ms) {
+        cfg->event_merge = event_merge_create(cfg->merge_ms);
+        if (!cfg->event_merge)
+            FATAL_CALLOC("event_merge_create()");
+    }
+    if (cfg->farm_workers.len) {
+        struct timeval now;
+        get_time_now(&now);
+        cfg->decode_farm = decode_farm_create();
+        if (!cfg->decode_farm)
+            FATAL_CALLOC("decode_farm_create()");
+        for (void **iter = cfg->farm_workers.elems; iter && *iter; ++iter) {
+            char *param = strdup(*iter);
+            if (!param)
+                FATAL_STRDUP("main()");
+            char const *host = "localhost";
+            char const *port = DECODE_FARM_PORT;
+            hostport_param(param, &host, &port);
+            if (decode_farm_add_worker(cfg->decode_farm, *host ? host : "localhost", port, now.tv_sec + now.tv_usec * 1e-6))
+                exit(1);
+            free(param);
         }
     }
-    // if any dumpers are requested the FM demod might be needed
-    if (cfg->demod->dumper.len) {
+    // the channels decode on several threads with the decoders of the first
+    r_update_dispatch(demod);
+
+    // the FSK decoders need the FM demod
+    if (demod->dispatch.len > demod->dispatch.num_ook) {
+        demod->enable_FM_demod = 1;
+    }
+    // if any dumpers are requested or the packages are sent the FM demod might be needed
+    if (cfg->demod->dumper.len || cfg->pulse_sender) {
         demod->enable_FM_demod = 1;
     }
+    // the files are read as fast as the dumpers are written, a live input drops the data the writer can't keep up with
+    if (cfg->demod->dumper.len && (cfg->dump_async || cfg->dump_flags)) {
+        start_dump_writer(cfg, cfg->in_files.len > 0);
+    }
+
+    // decode packages while they are received if any decoder streams
+    pulse_detect_set_stream(demod->pulse_detect, stream_pulses_min(&demod->r_devs));
+
+    if ((cfg->channelize || cfg->mimo) && cfg->frequencies > 1) {
+        setup_channels(cfg);
+    }
+    setup_band_scan(cfg);
+    setup_hop_sched(cfg);
+    setup_fsk_track(cfg);
+    // the DSP thread takes its share of the decoders
+    if (cfg->decode_threads > 1) {
+        cfg->decode_pool = worker_pool_start(cfg->decode_threads - 1);
+        if (!cfg->decode_pool)
+            print_log(LOG_WARNING, "Decode", "No decode threads available, decoding on one thread");
+    }
+    if (cfg->adaptive_order && cfg->decode_pool)
+        print_log(LOG_WARNING, "Decode", "The adaptive decoder order needs a single decode thread, using the list order");
+    setup_package_queue(cfg);
+    setup_load_shed(cfg);
+    setup_decode_pin(cfg);
+    setup_lag_shed(cfg);
+    setup_iq_snippet(cfg);
+    setup_spectrum(cfg);
+    setup_duty_sched(cfg);
+    setup_verify(cfg);
+    uint32_t center_frequency_0 = cfg->center_frequency;
 
     {
         char decoders_str[1024];
@@ -1708,6 +4587,10 @@ int main(int argc, char **argv) {
     char const **well_known = well_known_output_fields(cfg);
     start_outputs(cfg, well_known);
     free((void *)well_known);
+    if (cfg->sched_output) {
+        for (size_t i = 0; i < cfg->output_handler.len; ++i) // list might contain NULLs
+            data_output_async_set_sched(cfg->output_handler.elems[i], cfg->sched_output);
+    }
 
     if (cfg->out_block_size < MINIMAL_BUF_LENGTH ||
             cfg->out_block_size > MAXIMAL_BUF_LENGTH) {
@@ -1720,6 +4603,8 @@ int main(int argc, char **argv) {
         cfg->out_block_size = DEFAULT_BUF_LENGTH;
     }
 
+    startup_calibration(cfg);
+
     // Special case for streaming test data
     if (cfg->test_data && (!strcasecmp(cfg->test_data, "-") || *cfg->test_data == '@')) {
         FILE *fp;
@@ -1773,6 +4658,7 @@ int main(int argc, char **argv) {
                         r += run_ook_demods(&single_dev, &pulse_data);
                     else
                         r += run_fsk_demods(&single_dev, &pulse_data);
+                    pulse_data_free(&pulse_data);
                     list_free_elems(&single_dev, NULL);
                 } else
                 r += pulse_slicer_string(e, r_dev);
@@ -1783,9 +4669,10 @@ int main(int argc, char **argv) {
                 pulse_data_t pulse_data = {0};
                 rfraw_parse(&pulse_data, line);
                 if (!pulse_data.fsk_f2_est)
-                    r += run_ook_demods(&demod->r_devs, &pulse_data);
+                    r += run_ook_demods_pool(NULL, demod, &pulse_data);
                 else
-                    r += run_fsk_demods(&demod->r_devs, &pulse_data);
+                    r += run_fsk_demods_pool(NULL, demod, &pulse_data);
+                pulse_data_free(&pulse_data);
             } else
             for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
                 r_device *r_dev = *iter;
@@ -1809,9 +4696,10 @@ int main(int argc, char **argv) {
             pulse_data_t pulse_data = {0};
             rfraw_parse(&pulse_data, cfg->test_data);
             if (!pulse_data.fsk_f2_est)
-                r += run_ook_demods(&demod->r_devs, &pulse_data);
+                r += run_ook_demods_pool(NULL, demod, &pulse_data);
             else
-                r += run_fsk_demods(&demod->r_devs, &pulse_data);
+                r += run_fsk_demods_pool(NULL, demod, &pulse_data);
+            pulse_data_free(&pulse_data);
         } else
         for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
             r_device *r_dev = *iter;
@@ -1828,166 +4716,37 @@ int main(int argc, char **argv) {
         unsigned char *test_mode_buf = malloc(DEFAULT_BUF_LENGTH * sizeof(unsigned char));
         if (!test_mode_buf)
             FATAL_MALLOC("test_mode_buf");
-        float *test_mode_float_buf = malloc(DEFAULT_BUF_LENGTH / sizeof(int16_t) * sizeof(float));
-        if (!test_mode_float_buf)
-            FATAL_MALLOC("test_mode_float_buf");
 
         if (cfg->duration > 0) {
             time(&cfg->stop_time);
             cfg->stop_time += cfg->duration;
         }
 
-        for (void **iter = cfg->in_files.elems; iter && *iter; ++iter) {
-            cfg->in_filename = *iter;
-
-            file_info_clear(&demod->load_info); // reset all info
-            file_info_parse_filename(&demod->load_info, cfg->in_filename);
-            // apply file info or default
-            cfg->samp_rate        = demod->load_info.sample_rate ? demod->load_info.sample_rate : sample_rate_0;
-            cfg->center_frequency = demod->load_info.center_frequency ? demod->load_info.center_frequency : cfg->frequency[0];
-
-            FILE *in_file;
-            if (strcmp(demod->load_info.path, "-") == 0) { // read samples from stdin
-                in_file = stdin;
-                cfg->in_filename = "<stdin>";
-            } else {
-                in_file = fopen(demod->load_info.path, "rb");
-                if (!in_file) {
-                    print_logf(LOG_ERROR, "Input", "Opening file \"%s\" failed!", cfg->in_filename);
-                    break;
-                }
-            }
-            print_logf(LOG_CRITICAL, "Input", "Test mode active. Reading samples from file: %s", cfg->in_filename); // Essential information (not quiet)
-            if (demod->load_info.format == CU8_IQ
-                    || demod->load_info.format == CS8_IQ
-                    || demod->load_info.format == S16_AM
-                    || demod->load_info.format == S16_FM) {
-                demod->sample_size = sizeof(uint8_t) * 2; // CU8, AM, FM
-            } else if (demod->load_info.format == CS16_IQ
-                    || demod->load_info.format == CF32_IQ) {
-                demod->sample_size = sizeof(int16_t) * 2; // CS16, CF32 (after conversion)
-            } else if (demod->load_info.format == PULSE_OOK) {
-                // ignore
-            } else {
-                print_logf(LOG_ERROR, "Input", "Input format invalid \"%s\"", file_info_string(&demod->load_info));
+        // decode each file with an input of its own on the file threads
+        int batch = cfg->file_threads > 1;
+        char const *reason = batch ? file_batch_unsupported(cfg) : NULL;
+        if (reason) {
+            print_logf(LOG_WARNING, "Input", "Decoding the files one after the other, %s", reason);
+            batch = 0;
+        }
+#ifdef THREADS
+        if (batch)
+            read_input_files(cfg, cfg->file_threads, sample_rate_0, center_frequency_0);
+#endif
+        for (void **iter = cfg->in_files.elems; !batch && iter && *iter; ++iter) {
+            if (read_input_file(cfg, *iter, sample_rate_0, center_frequency_0, test_mode_buf, 0, 0) < 0)
                 break;
-            }
-            if (cfg->verbosity >= LOG_NOTICE) {
-                print_logf(LOG_NOTICE, "Input", "Input format \"%s\"", file_info_string(&demod->load_info));
-            }
-            demod->sample_file_pos = 0.0;
-
-            // special case for pulse data file-inputs
-            if (demod->load_info.format == PULSE_OOK) {
-                while (!cfg->exit_async) {
-                    pulse_data_load(in_file, &demod->pulse_data, cfg->samp_rate);
-                    if (!demod->pulse_data.num_pulses)
-                        break;
-
-                    for (void **iter2 = demod->dumper.elems; iter2 && *iter2; ++iter2) {
-                        file_info_t const *dumper = *iter2;
-                        if (dumper->format == VCD_LOGIC) {
-                            pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
-                        } else if (dumper->format == PULSE_OOK) {
-                            pulse_data_dump(dumper->file, &demod->pulse_data);
-                        } else {
-                            print_logf(LOG_ERROR, "Input", "Dumper (%s) not supported on OOK input", dumper->spec);
-                            exit(1);
-                        }
-                    }
-
-                    if (demod->pulse_data.fsk_f2_est) {
-                        run_fsk_demods(&demod->r_devs, &demod->pulse_data);
-                    }
-                    else {
-                        int p_events = run_ook_demods(&demod->r_devs, &demod->pulse_data);
-                        if (cfg->verbosity >= LOG_DEBUG)
-                            pulse_data_print(&demod->pulse_data);
-                        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
-                            r_device device = {.log_fn = log_device_handler, .output_ctx = cfg};
-                            pulse_analyzer(&demod->pulse_data, PULSE_DATA_OOK, &device);
-                        }
-                    }
-                }
-
-                if (in_file != stdin) {
-                    fclose(in_file);
-                }
-
-                continue;
-            }
-
-            // default case for file-inputs
-            int n_blocks = 0;
-            unsigned long n_read;
-            delay_timer_t delay_timer;
-            delay_timer_init(&delay_timer);
-            do {
-                // Replay in realtime if requested
-                if (cfg->in_replay) {
-                    // per block delay
-                    unsigned delay_us = (unsigned)(1000000llu * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size / cfg->in_replay);
-                    if (demod->load_info.format == CF32_IQ)
-                        delay_us /= 2; // adjust for float only reading half as many samples
-                    delay_timer_wait(&delay_timer, delay_us);
-                }
-                // Convert CF32 file to CS16 buffer
-                if (demod->load_info.format == CF32_IQ) {
-                    n_read = fread(test_mode_float_buf, sizeof(float), DEFAULT_BUF_LENGTH / 2, in_file);
-                    // clamp float to [-1,1] and scale to Q0.15
-                    for (unsigned long n = 0; n < n_read; n++) {
-                        int s_tmp = test_mode_float_buf[n] * INT16_MAX;
-                        if (s_tmp < -INT16_MAX)
-                            s_tmp = -INT16_MAX;
-                        else if (s_tmp > INT16_MAX)
-                            s_tmp = INT16_MAX;
-                        ((int16_t *)test_mode_buf)[n] = s_tmp;
-                    }
-                    n_read *= 2; // convert to byte count
-                } else {
-                    n_read = fread(test_mode_buf, 1, DEFAULT_BUF_LENGTH, in_file);
-
-                    // Convert CS8 file to CU8 buffer
-                    if (demod->load_info.format == CS8_IQ) {
-                        for (unsigned long n = 0; n < n_read; n++) {
-                            test_mode_buf[n] = ((int8_t)test_mode_buf[n]) + 128;
-                        }
-                    }
-                }
-                if (n_read == 0) break;  // sdr_callback() will Segmentation Fault with len=0
-                demod->sample_file_pos = ((float)n_blocks * DEFAULT_BUF_LENGTH + n_read) / cfg->samp_rate / demod->sample_size;
-                n_blocks++; // this assumes n_read == DEFAULT_BUF_LENGTH
-                sdr_callback(test_mode_buf, n_read, cfg);
-            } while (n_read != 0 && !cfg->exit_async);
-
-            // Call a last time with cleared samples to ensure EOP detection
-            if (demod->sample_size == 2) { // CU8
-                memset(test_mode_buf, 128, DEFAULT_BUF_LENGTH); // 128 is 0 in unsigned data
-                // or is 127.5 a better 0 in cu8 data?
-                //for (unsigned long n = 0; n < DEFAULT_BUF_LENGTH/2; n++)
-                //    ((uint16_t *)test_mode_buf)[n] = 0x807f;
-            }
-            else { // CF32, CS16
-                    memset(test_mode_buf, 0, DEFAULT_BUF_LENGTH);
-            }
-            demod->sample_file_pos = ((float)n_blocks + 1) * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size;
-            sdr_callback(test_mode_buf, DEFAULT_BUF_LENGTH, cfg);
-
-            //Always classify a signal at the end of the file
-            if (demod->am_analyze)
-                am_analyze_classify(demod->am_analyze);
-            if (cfg->verbosity >= LOG_NOTICE) {
-                print_logf(LOG_NOTICE, "Input", "Test mode file issued %d packets", n_blocks);
-            }
-
-            if (in_file != stdin) {
-                fclose(in_file);
-            }
+        }
+        expire_merged_events(cfg, 1);
+        // the final statistics of the files, as at the end of a live input
+        if (!batch && cfg->report_stats > 0) {
+            event_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
+            flush_report_data(cfg);
         }
 
         close_dumpers(cfg);
         free(test_mode_buf);
-        free(test_mode_float_buf);
+        print_pulse_clusters(cfg);
         r_free_cfg(cfg);
         exit(0);
     }
@@ -2009,6 +4768,7 @@ int main(int argc, char **argv) {
     sigaction(SIGQUIT, &sigact, NULL);
     sigaction(SIGPIPE, &sigact, NULL);
     sigaction(SIGUSR1, &sigact, NULL);
+    sigaction(SIGUSR2, &sigact, NULL);
     sigaction(SIGINFO, &sigact, NULL);
 #else
     SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
@@ -2017,28 +4777,66 @@ int main(int argc, char **argv) {
     // TODO: remove this before next release
     print_log(LOG_NOTICE, "Input", "The internals of input handling changed, read about and report problems on PR #1978");
 
-    if (cfg->dev_mode != DEVICE_MODE_MANUAL) {
-        r = start_sdr(cfg);
-        if (r < 0) {
-            exit(2);
-        }
-    }
+    // the other threads queue their log messages for the event loop, a flood of messages is cut short
+    cfg->log_ring = log_ring_create(LOG_RING_SIZE, dsp_wakeup_callback, cfg);
+    log_rate_set_limit(LOG_RATE_LIMIT);
+
+    // demod runs on a separate thread, the event loop keeps serving outputs and the API
+    cfg->dsp_thread = dsp_thread_start(latency_buf_num(cfg->latency_ms) - 2, DSP_EVENT_QUEUE_SIZE,
+            dsp_process_callback, dsp_wakeup_callback, cfg);
+    setup_thread_sched(cfg);
 
     if (cfg->duration > 0) {
         time(&cfg->stop_time);
         cfg->stop_time += cfg->duration;
     }
 
-    time(&cfg->hop_start_time);
+    // further inputs clone the started outputs and the timing
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        setup_input(cfg, *iter);
+    }
+
+    if (cfg->dev_mode != DEVICE_MODE_MANUAL) {
+        r = start_sdr(cfg);
+        if (r < 0) {
+            exit(2);
+        }
+        for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+            if (start_sdr(*iter) < 0) {
+                exit(2);
+            }
+        }
+    }
 
     // add dummy socket to receive broadcasts
     struct mg_add_sock_opts opts = {.user_data = cfg};
     struct mg_connection *nc = mg_add_sock_opt(get_mgr(cfg), INVALID_SOCKET, timer_handler, opts);
     // Send us MG_EV_TIMER event after 2.5 seconds
     mg_set_timer(nc, mg_time() + 2.5);
+    // each further input has its own watchdog
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        struct mg_add_sock_opts input_opts = {.user_data = *iter};
+        struct mg_connection *input_nc = mg_add_sock_opt(get_mgr(cfg), INVALID_SOCKET, timer_handler, input_opts);
+        mg_set_timer(input_nc, mg_time() + 2.5);
+    }
+    if (cfg->duty_sched) {
+        struct mg_connection *duty_nc = mg_add_sock_opt(get_mgr(cfg), INVALID_SOCKET, duty_handler, opts);
+        mg_set_timer(duty_nc, mg_time() + 1.0);
+    }
 
+    trace_thread_name("event_loop");
     while (!cfg->exit_async) {
         mg_mgr_poll(cfg->mgr, 500);
+        flush_inputs(cfg);
+        expire_aggregates(cfg);
+        file_sink_poll();
+        if (cfg->reload_now)
+            reload_decoders(cfg, argc, argv);
+        if (cfg->trace_now) {
+            cfg->trace_now = 0;
+            if (!trace_write_file(TRACE_DUMP_FILE))
+                print_log(LOG_NOTICE, "Trace", "Wrote the trace to " TRACE_DUMP_FILE);
+        }
     }
     if (cfg->verbosity >= LOG_INFO)
         print_log(LOG_INFO, "rtl_433", "stopping...");
@@ -2046,13 +4844,11 @@ int main(int argc, char **argv) {
     //while (cfg->exit_async < 2) {
     //    mg_mgr_poll(cfg->mgr, 100);
     //}
-    sdr_stop(cfg->dev);
-    //print_log(LOG_INFO, "rtl_433", "stopped.");
-
-    if (cfg->report_stats > 0) {
-        event_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
-        flush_report_data(cfg);
+    stop_input(cfg);
+    for (void **iter = cfg->inputs.elems; iter && *iter; ++iter) {
+        stop_input(*iter);
     }
+    //print_log(LOG_INFO, "rtl_433", "stopped.");
 
     if (!cfg->exit_async) {
         print_logf(LOG_ERROR, "rtl_433", "Library error %d, exiting...", r);
@@ -2061,6 +4857,7 @@ int main(int argc, char **argv) {
 
     if (cfg->exit_code >= 0)
         r = cfg->exit_code;
+    print_pulse_clusters(cfg);
     r_free_cfg(cfg);
 
     return r >= 0 ? r : -r;
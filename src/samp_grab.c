@@ -12,21 +12,143 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #ifdef _WIN32
 #include <io.h>
-#include <fcntl.h>
-#ifdef _MSC_VER
-#define F_OK 0
-#endif
 #endif
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#ifndef _WIN32
+#include <signal.h>
+#endif
 
 #include "samp_grab.h"
+#include "ring_queue.h"
+#include "compat_pthread.h"
 #include "fatal.h"
 
+#define BLOCK_SIZE (128 * 1024) /* bytes */
+
+// A grab copies the signal out of the ring and queues it to the writer
+// thread, the demod only pays for that copy. The writer owns the file
+// counter once started and opens the names exclusively, an existing file
+// just moves the counter on instead of probing each name up front.
+
+/// A grabbed signal, the data is owned by the job.
+typedef struct {
+    char *data;
+    unsigned len;
+    unsigned samples;
+    char const *format;
+    double freq_mhz;
+    double rate_khz;
+} grab_job_t;
+
+#ifdef THREADS
+struct samp_grab_thread {
+    ring_queue_t *jobs;
+    pthread_t thread;
+};
+#endif
+
+/// Create a new file and open it for writing, fails if it exists.
+static FILE *open_new(char const *name)
+{
+#ifdef _WIN32
+    int fd = _open(name, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+    FILE *fp = fd < 0 ? NULL : _fdopen(fd, "wb");
+    if (fd >= 0 && !fp)
+        _close(fd);
+#else
+    int fd = open(name, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (fd >= 0 && !fp)
+        close(fd);
+#endif
+    return fp;
+}
+
+static void write_job(samp_grab_t *g, grab_job_t *job)
+{
+    char f_name[64] = {0};
+    FILE *fp;
+
+    for (;;) {
+        snprintf(f_name, sizeof(f_name), "g%03u_%gM_%gk.%s", g->sg_counter, job->freq_mhz, job->rate_khz, job->format);
+        g->sg_counter++;
+        fp = open_new(f_name);
+        if (fp || errno != EEXIST) {
+            break;
+        }
+    }
+
+    fprintf(stderr, "*** Saving signal to file %s (%u samples, %u bytes)\n", f_name, job->samples, job->len);
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", f_name);
+        return;
+    }
+
+    if (fwrite(job->data, 1, job->len, fp) != job->len) {
+        fprintf(stderr, "Failed to write %s\n", f_name);
+    }
+
+    fclose(fp);
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL samp_grab_loop(void *arg)
+{
+    samp_grab_t *g = arg;
+    grab_job_t job;
+
+    // returns -1 only once the queue is closed and drained
+    while (!ring_queue_pop(g->thread->jobs, &job, 1)) {
+        write_job(g, &job);
+        free(job.data);
+    }
+
+    return (THREAD_RETURN)0;
+}
+
+/// Start the writer thread, the grabs are written synchronously if this fails.
+static void start_thread(samp_grab_t *g)
+{
+    struct samp_grab_thread *t = calloc(1, sizeof(*t));
+    if (!t) {
+        WARN_CALLOC("samp_grab_create()");
+        return;
+    }
+    t->jobs = ring_queue_create(SAMP_GRAB_QUEUE, sizeof(grab_job_t));
+    if (!t->jobs) {
+        free(t);
+        return;
+    }
+    g->thread = t;
+
+#ifndef _WIN32
+    // Block all signals from the writer thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&t->thread, NULL, samp_grab_loop, g);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        ring_queue_free(t->jobs);
+        free(t);
+        g->thread = NULL;
+    }
+}
+#endif
+
 samp_grab_t *samp_grab_create(unsigned size)
 {
     samp_grab_t *g;
@@ -46,11 +168,27 @@ samp_grab_t *samp_grab_create(unsigned size)
         return NULL; // NOTE: returns NULL on alloc failure.
     }
 
+#ifdef THREADS
+    start_thread(g);
+#endif
+
     return g;
 }
 
 void samp_grab_free(samp_grab_t *g)
 {
+#ifdef THREADS
+    if (g->thread) {
+        // the writer drains the queued grabs before it exits
+        ring_queue_close(g->thread->jobs);
+        int r = pthread_join(g->thread->thread, NULL);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+        }
+        ring_queue_free(g->thread->jobs);
+        free(g->thread);
+    }
+#endif
     if (g->sg_buf)
         free(g->sg_buf);
     free(g);
@@ -86,27 +224,12 @@ void samp_grab_reset(samp_grab_t *g)
     g->sg_index = 0;
 }
 
-#define BLOCK_SIZE (128 * 1024) /* bytes */
-
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
 {
     if (!g->sg_buf)
         return;
 
     unsigned end_pos, start_pos, signal_bsize, wlen, wrest;
-    char f_name[64] = {0};
-    FILE *fp;
-
-    char *format = *g->sample_size == 2 ? "cu8" : "cs16";
-    double freq_mhz = *g->frequency / 1000000.0;
-    double rate_khz = *g->samp_rate / 1000.0;
-    while (1) {
-        snprintf(f_name, sizeof(f_name), "g%03u_%gM_%gk.%s", g->sg_counter, freq_mhz, rate_khz, format);
-        g->sg_counter++;
-        if (access(f_name, F_OK) == -1) {
-            break;
-        }
-    }
 
     signal_bsize = *g->sample_size * grab_len;
     signal_bsize += BLOCK_SIZE - (signal_bsize % BLOCK_SIZE);
@@ -132,10 +255,16 @@ void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
     //fprintf(stderr, "signal_bsize = %d  -      sg_index = %d\n", signal_bsize, g->sg_index);
     //fprintf(stderr, "start_pos    = %d  -   buffer_size = %d\n", start_pos, g->sg_size);
 
-    fprintf(stderr, "*** Saving signal to file %s (%u samples, %u bytes)\n", f_name, grab_len, signal_bsize);
-    fp = fopen(f_name, "wb");
-    if (!fp) {
-        fprintf(stderr, "Failed to open %s\n", f_name);
+    grab_job_t job = {
+            .len      = signal_bsize,
+            .samples  = grab_len,
+            .format   = *g->sample_size == 2 ? "cu8" : "cs16",
+            .freq_mhz = *g->frequency / 1000000.0,
+            .rate_khz = *g->samp_rate / 1000.0,
+    };
+    job.data = malloc(signal_bsize ? signal_bsize : 1);
+    if (!job.data) {
+        WARN_MALLOC("samp_grab_write()");
         return;
     }
 
@@ -145,13 +274,20 @@ void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
         wlen  = g->sg_size - start_pos;
         wrest = signal_bsize - wlen;
     }
-    //fprintf(stderr, "*** Writing data from %d, len %d\n", start_pos, wlen);
-    fwrite(&g->sg_buf[start_pos], 1, wlen, fp);
-
+    memcpy(job.data, &g->sg_buf[start_pos], wlen);
     if (wrest) {
-        //fprintf(stderr, "*** Writing data from %d, len %d\n", 0, wrest);
-        fwrite(&g->sg_buf[0], 1, wrest, fp);
+        memcpy(&job.data[wlen], &g->sg_buf[0], wrest);
     }
 
-    fclose(fp);
+#ifdef THREADS
+    if (g->thread) {
+        if (ring_queue_push(g->thread->jobs, &job) < 0) {
+            fprintf(stderr, "Grabber is behind, dropping signal (%u samples, %u bytes)\n", grab_len, signal_bsize);
+            free(job.data);
+        }
+        return;
+    }
+#endif
+    write_job(g, &job);
+    free(job.data);
 }
@@ -17,12 +17,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <math.h>
 #include "sdr.h"
 #include "r_util.h"
+#include "c_util.h"
 #include "optparse.h"
 #include "logger.h"
+#include "trace.h"
 #include "fatal.h"
+#include "compat_atomic.h"
 #include "compat_pthread.h"
+#include "iq_codec.h"
+#include "rtltcp_compress.h"
+#include "thread_sched.h"
 #ifdef RTLSDR
 #include <rtl-sdr.h>
 #if defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
@@ -56,6 +63,7 @@ int __attribute__((weak)) rtlsdr_set_bias_tee(rtlsdr_dev_t *dev, int on);
     #include <winsock2.h>
     #include <ws2tcpip.h>
     #define SHUT_RDWR SD_BOTH
+    #define usleep(us) Sleep((us) / 1000)
     #define perror(str)  ws2_perror(str)
 
     static void ws2_perror (const char *str)
@@ -67,8 +75,11 @@ int __attribute__((weak)) rtlsdr_set_bias_tee(rtlsdr_dev_t *dev, int on);
 #else
     #include <sys/types.h>
     #include <sys/socket.h>
+    #include <sys/select.h>
     #include <netdb.h>
     #include <netinet/in.h>
+    #include <fcntl.h>
+    #include <errno.h>
 
     #define SOCKET          int
     #define INVALID_SOCKET  (-1)
@@ -77,15 +88,45 @@ int __attribute__((weak)) rtlsdr_set_bias_tee(rtlsdr_dev_t *dev, int on);
 
 #define GAIN_STR_MAX_SIZE 64
 
+#define RTLTCP_CMD_COUNT 16 ///< rtl_tcp command codes are below this
+
+#define SDR_LEASE_DMA_MAX 8 ///< SoapySDR DMA buffers held for leased frames at most
+
+#ifdef SOAPYSDR
+/// A DMA buffer held back from the driver until its leased frames are released.
+typedef struct sdr_dma_lease {
+    size_t handle;
+    uint8_t const *buf; ///< NULL if the slot is free
+    size_t len;
+    unsigned frames; ///< frames not yet released, and 1 while the frames are delivered
+} sdr_dma_lease_t;
+#endif
+
 struct sdr_dev {
     SOCKET rtl_tcp;
     uint32_t rtl_tcp_freq; ///< last known center frequency, rtl_tcp only.
     uint32_t rtl_tcp_rate; ///< last known sample rate, rtl_tcp only.
+    char *rtl_tcp_host; ///< host to reconnect to, rtl_tcp only.
+    char *rtl_tcp_port; ///< port to reconnect to, rtl_tcp only.
+    int rtl_tcp_rcvbuf; ///< socket receive buffer size, 0 for the system default, rtl_tcp only.
+    uint32_t rtl_tcp_readahead; ///< bytes to read ahead of the buffers handed out, rtl_tcp only.
+    int rtl_tcp_reconnect; ///< number of reconnect attempts, rtl_tcp only.
+    int rtl_tcp_timeout_ms; ///< time without data until the connection is considered lost, rtl_tcp only.
+    unsigned rtl_tcp_compress; ///< compression flags to request, rtl_tcp only.
+    uint32_t rtl_tcp_cmds[RTLTCP_CMD_COUNT]; ///< last parameter of each command sent, rtl_tcp only.
+    unsigned rtl_tcp_cmds_set; ///< bit mask of the commands sent, rtl_tcp only.
+    sdr_stats_t rtl_tcp_stats; ///< connection statistics, rtl_tcp only.
+    uint32_t rtl_tcp_stats_seq; ///< odd while the acquire thread changes the statistics, rtl_tcp only.
+    int64_t rtl_tcp_since_ns; ///< connect time for the throughput, rtl_tcp only.
+    int64_t rtl_tcp_last_ns; ///< arrival of the last buffer for the jitter, rtl_tcp only.
+    double rtl_tcp_jitter_ns; ///< running interarrival jitter, rtl_tcp only.
 
 #ifdef SOAPYSDR
     SoapySDRDevice *soapy_dev;
     SoapySDRStream *soapy_stream;
     double fullScale;
+    char const *stream_format; ///< the SoapySDR format of the stream, to set it up again
+    size_t rx_channels;        ///< RX channels of the stream, 0 for channel 0 only
 #endif
 
 #ifdef RTLSDR
@@ -96,30 +137,182 @@ struct sdr_dev {
 
     char *dev_info;
 
-    int running;
+    uint32_t running; ///< published with param_set(), read with param_get()
     uint8_t *buffer; ///< sdr data buffer current and past frames
     size_t buffer_size; ///< sdr data buffer overall size (num * len)
     size_t buffer_pos; ///< sdr data buffer next write position
+    int lock_buffers; ///< lock the sample buffers into RAM
 
     int sample_size;
     int sample_signed;
 
-    uint32_t sample_rate;
-    uint32_t center_frequency;
+    uint32_t sample_rate;      ///< published with param_set(), read with param_get()
+    uint32_t center_frequency; ///< published with param_set(), read with param_get()
+
+    // stream time keeping, acquire thread only
+    uint32_t stream_rate;    ///< sample rate of the current time anchor
+    int64_t stream_time_ns;  ///< time of the sample at stream_anchor, 0 if not anchored
+    uint64_t stream_anchor;  ///< sample position of the time anchor
+    uint64_t stream_pos;     ///< sample position of the next buffer, counting dropped samples
+    uint64_t stream_capacity; ///< samples the device side can buffer before dropping
+    int64_t stream_lag_ns;   ///< arrival delay of the last buffer behind the sample clock
+    int stream_overflow;     ///< the device reported an overflow since the last buffer
+    int stream_cs8;          ///< the SoapySDR stream is CS8 and needs a flip to CU8
+    int stream_native;       ///< the SoapySDR stream is in the native format, the DMA buffers are in the stream format
 
 #ifdef THREADS
     pthread_t thread;
-    pthread_mutex_t lock; ///< lock for exit_acquire
-    int exit_acquire;
+    thread_sched_t sched; ///< scheduling of the acquire thread
+    pthread_mutex_t lock; ///< lock for the leases and the rtl_tcp socket
+    uint32_t exit_acquire; ///< published with param_set(), read with param_get()
+    pthread_cond_t lease_cond; ///< signaled when all leases are released
+    unsigned leases; ///< number of leased buffers not yet released
+    unsigned lease_max; ///< leases out at most, further buffers are copied, acquire thread only
+    uint32_t lease_buffers; ///< hand out the USB buffers instead of copying, published with param_set()
+#ifdef SOAPYSDR
+    sdr_dma_lease_t dma_leases[SDR_LEASE_DMA_MAX]; ///< the DMA buffers of leased frames, under the lock
+#endif
 
     // acquire thread args
     sdr_event_cb_t async_cb;
     void *async_ctx;
     uint32_t buf_num;
     uint32_t buf_len;
+
+    // control thread, see sdr_control()
+    pthread_t ctl_thread;
+    pthread_mutex_t ctl_lock; ///< lock for the queued and the applied control commands
+    pthread_cond_t ctl_cond;  ///< signaled when a command is queued or the control thread should exit
+    uint32_t ctl_running;     ///< the control thread is started, published with param_set()
+    int ctl_exit;             ///< the control thread should exit once the queue is applied
+    unsigned ctl_pending;     ///< SDR_CTL_FLAGS of the queued commands
+    unsigned ctl_verbose;     ///< SDR_CTL_FLAGS of the queued commands to log
+    unsigned ctl_report;      ///< SDR_CTL_FLAGS of the queued commands to report
+    sdr_event_t ctl_cmd;      ///< the settings of the queued commands
+    char ctl_gain[GAIN_STR_MAX_SIZE];         ///< the queued gain, empty for auto gain
+    uint32_t ctl_events;      ///< SDR_CTL_FLAGS of the applied commands to report, published with param_set()
+    sdr_event_t ctl_applied;  ///< the settings of the applied commands
+    char ctl_applied_gain[GAIN_STR_MAX_SIZE]; ///< the applied gain, "auto" for auto gain
+    char ctl_report_gain[GAIN_STR_MAX_SIZE];  ///< the gain of the last report, acquire thread only
 #endif
 };
 
+/* stream time keeping */
+
+/* lock free parameters and statistics */
+
+// The acquire thread reads the parameters on every buffer, they change rarely.
+// Plain atomic loads there keep the control path from contending for the lock.
+
+static uint32_t param_get(uint32_t const *p)
+{
+    return atomic_get(p);
+}
+
+static void param_set(uint32_t *p, uint32_t value)
+{
+    atomic_set(p, value);
+}
+
+// The statistics have a single writer, readers retry while the sequence is odd or changed.
+
+static void seq_write_begin(uint32_t *seq)
+{
+    atomic_set_relaxed(seq, *seq + 1);
+    atomic_fence_release();
+}
+
+static void seq_write_end(uint32_t *seq)
+{
+    atomic_set(seq, *seq + 1);
+}
+
+/// Wait for a writer to finish, returns the sequence to check with seq_read_retry().
+static uint32_t seq_read_begin(uint32_t const *seq)
+{
+    uint32_t start;
+    while ((start = param_get(seq)) & 1)
+        ; // the writer is done in a moment
+    return start;
+}
+
+/// Check if the data read since seq_read_begin() might be torn.
+static int seq_read_retry(uint32_t const *seq, uint32_t start)
+{
+    atomic_fence_acquire();
+    return atomic_get_relaxed(seq) != start;
+}
+
+/// Assumed buffering of a rtl_tcp server, 500 buffers of 256 kB.
+#define RTLTCP_SERVER_BUFFER_SIZE (500 * 16 * 16384)
+
+static void stream_reset(sdr_dev_t *dev, uint64_t capacity)
+{
+    dev->stream_rate     = 0;
+    dev->stream_time_ns  = 0;
+    dev->stream_anchor   = 0;
+    dev->stream_pos      = 0;
+    dev->stream_capacity = capacity;
+    dev->stream_lag_ns   = 0;
+    dev->stream_overflow = 0;
+}
+
+/** Time stamp a data event and count the samples dropped right before it.
+
+    With a hardware time the drop count is sample-accurate. Otherwise the arrival
+    time is checked against the sample count and a lag beyond the stream capacity
+    is counted as dropped, in whole buffers. After a reported overflow all of the
+    lag is counted.
+*/
+static void stream_stamp(sdr_dev_t *dev, sdr_event_t *ev, int64_t hw_time_ns)
+{
+    uint32_t rate      = ev->sample_rate;
+    uint64_t n_samples = (unsigned)ev->len / dev->sample_size;
+    if (!rate || !n_samples)
+        return;
+
+    if (rate != dev->stream_rate) {
+        dev->stream_rate    = rate; // re-anchor on rate changes
+        dev->stream_time_ns = 0;
+    }
+    uint64_t capacity = dev->stream_overflow ? 0 : dev->stream_capacity;
+    uint64_t dropped  = 0;
+    if (hw_time_ns) {
+        if (dev->stream_time_ns) {
+            double expected_ns = dev->stream_time_ns + (dev->stream_pos - dev->stream_anchor) * 1e9 / rate;
+            double lag         = (hw_time_ns - expected_ns) * rate / 1e9;
+            if (lag >= 1.0)
+                dropped = (uint64_t)(lag + 0.5);
+        }
+        dev->stream_time_ns = hw_time_ns;
+        dev->stream_anchor  = dev->stream_pos + dropped;
+    }
+    else {
+        struct timeval now;
+        get_time_now(&now);
+        // the buffer arrives with its last sample
+        int64_t start_ns = (int64_t)now.tv_sec * 1000000000 + now.tv_usec * 1000 - (int64_t)(n_samples * 1e9 / rate);
+        if (!dev->stream_time_ns) {
+            dev->stream_time_ns = start_ns;
+            dev->stream_anchor  = dev->stream_pos;
+        }
+        else {
+            double expected_ns = dev->stream_time_ns + (dev->stream_pos - dev->stream_anchor) * 1e9 / rate;
+            double lag         = (start_ns - expected_ns) * rate / 1e9;
+            if (lag < 0.0)
+                dev->stream_time_ns += (int64_t)(lag * 1e9 / rate); // arrived early, the anchor was late
+            else if (lag >= (double)capacity + n_samples)
+                dropped = ((uint64_t)lag - capacity) / n_samples * n_samples;
+            dev->stream_lag_ns = lag > 0.0 ? (int64_t)((lag - dropped) * 1e9 / rate) : 0;
+        }
+    }
+    dev->stream_overflow = 0;
+
+    ev->time_ns = dev->stream_time_ns + (int64_t)((dev->stream_pos + dropped - dev->stream_anchor) * 1e9 / rate);
+    ev->dropped = dropped;
+    dev->stream_pos += dropped + n_samples;
+}
+
 /* rtl_tcp helpers */
 
 #pragma pack(push, 1)
@@ -130,31 +323,117 @@ struct rtl_tcp_info {
 };
 #pragma pack(pop)
 
-static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
+#pragma pack(push, 1)
+struct command {
+    unsigned char cmd;
+    unsigned int param;
+};
+#pragma pack(pop)
+
+// rtl_tcp API
+#define RTLTCP_SET_FREQ 0x01
+#define RTLTCP_SET_SAMPLE_RATE 0x02
+#define RTLTCP_SET_GAIN_MODE 0x03
+#define RTLTCP_SET_GAIN 0x04
+#define RTLTCP_SET_FREQ_CORRECTION 0x05
+#define RTLTCP_SET_IF_TUNER_GAIN 0x06
+#define RTLTCP_SET_TEST_MODE 0x07
+#define RTLTCP_SET_AGC_MODE 0x08
+#define RTLTCP_SET_DIRECT_SAMPLING 0x09
+#define RTLTCP_SET_OFFSET_TUNING 0x0a
+#define RTLTCP_SET_RTL_XTAL 0x0b
+#define RTLTCP_SET_TUNER_XTAL 0x0c
+#define RTLTCP_SET_TUNER_GAIN_BY_ID 0x0d
+#define RTLTCP_SET_BIAS_TEE 0x0e
+
+#define RTLTCP_TIMEOUT_MS 1000 ///< default time without data until the connection is considered lost
+#define RTLTCP_RECONNECT 5     ///< default number of reconnect attempts
+#define RTLTCP_POLL_MS 250     ///< interval to check for exit while waiting
+#define RTLTCP_SYNC_TIMEOUT_MS 2000 ///< time to wait for the compressed stream before using the plain stream
+
+static int64_t rtltcp_now_ns(void)
 {
-    UNUSED(verbose);
-    char const *host = "localhost";
-    char const *port = "1234";
-    char hostport[280]; // 253 chars DNS name plus extra chars
+    struct timeval now;
+    get_time_now(&now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_usec * 1000;
+}
 
-    char *param = arg_param(dev_query); // strip scheme
-    hostport[0] = '\0';
-    if (param) {
-        snprintf(hostport, sizeof(hostport), "%s", param);
-    }
-    hostport_param(hostport, &host, &port);
+static int acquire_exiting(sdr_dev_t *dev)
+{
+#ifdef THREADS
+    return param_get(&dev->exit_acquire) != 0;
+#else
+    UNUSED(dev);
+    return 0;
+#endif
+}
 
-    print_logf(LOG_CRITICAL, "SDR", "rtl_tcp input from %s port %s", host, port);
+/// Report the control commands applied since the last buffer, acquire thread only.
+static void control_report(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx)
+{
+#ifdef THREADS
+    if (!param_get(&dev->ctl_events))
+        return;
+    pthread_mutex_lock(&dev->ctl_lock);
+    sdr_event_t ev = dev->ctl_applied;
+    ev.ev = (sdr_event_flags_t)dev->ctl_events;
+    // the event is copied on hand off, the gain stays until the next gain report
+    memcpy(dev->ctl_report_gain, dev->ctl_applied_gain, sizeof(dev->ctl_report_gain));
+    ev.gain_str = dev->ctl_report_gain;
+    param_set(&dev->ctl_events, 0);
+    pthread_mutex_unlock(&dev->ctl_lock);
+    cb(&ev, ctx);
+#else
+    UNUSED(dev);
+    UNUSED(cb);
+    UNUSED(ctx);
+#endif
+}
 
+static void rtltcp_set_nonblocking(SOCKET sock, int enable)
+{
 #ifdef _WIN32
-    WSADATA wsa;
+    u_long mode = enable;
+    ioctlsocket(sock, FIONBIO, &mode);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, enable ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+#endif
+}
 
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        perror("WSAStartup()");
-        return -1;
-    }
+/// Wait until the socket is readable (or writable), returns 1 if ready, 0 on timeout, -1 on error.
+static int rtltcp_wait(SOCKET sock, int writable, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+    return select((int)sock + 1, writable ? NULL : &fds, writable ? &fds : NULL, NULL, &tv);
+}
+
+/// Connect with a timeout, returns 0 on success.
+static int rtltcp_connect_addr(SOCKET sock, struct addrinfo const *res, int timeout_ms)
+{
+    rtltcp_set_nonblocking(sock, 1);
+    int ret = connect(sock, res->ai_addr, res->ai_addrlen);
+#ifdef _WIN32
+    int pending = ret == -1 && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    int pending = ret == -1 && errno == EINPROGRESS;
 #endif
+    if (pending && rtltcp_wait(sock, 1, timeout_ms) == 1) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&err, &len);
+        ret = err ? -1 : 0;
+    }
+    rtltcp_set_nonblocking(sock, 0);
+    return ret;
+}
 
+/// Connect to a rtl_tcp server and check the header, returns the socket or INVALID_SOCKET.
+static SOCKET rtltcp_connect(char const *host, char const *port, int rcvbuf, int timeout_ms, unsigned *tuner_number)
+{
     struct addrinfo hints, *res, *res0;
     int ret;
     SOCKET sock;
@@ -168,15 +447,18 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     ret = getaddrinfo(host, port, &hints, &res0);
     if (ret) {
         print_log(LOG_ERROR, __func__, gai_strerror(ret));
-        return -1;
+        return INVALID_SOCKET;
     }
     sock = INVALID_SOCKET;
     for (res = res0; res; res = res->ai_next) {
         sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (sock >= 0) {
-            ret = connect(sock, res->ai_addr, res->ai_addrlen);
+        if (sock != INVALID_SOCKET) {
+            // the receive buffer needs to be set before connect to get a matching TCP window
+            if (rcvbuf > 0 && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char const *)&rcvbuf, sizeof(rcvbuf)) == -1)
+                perror("rtl_tcp SO_RCVBUF");
+            ret = rtltcp_connect_addr(sock, res, timeout_ms);
             if (ret == -1) {
-                perror("connect");
+                print_logf(LOG_WARNING, __func__, "Connecting to %s:%s failed", host, port);
                 closesocket(sock);
                 sock = INVALID_SOCKET;
             }
@@ -187,7 +469,7 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     freeaddrinfo(res0);
     if (sock == INVALID_SOCKET) {
         perror("socket");
-        return -1;
+        return INVALID_SOCKET;
     }
 
     //int const value_one = 1;
@@ -196,35 +478,228 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     //    fprintf(stderr, "rtl_tcp TCP_NODELAY failed\n");
 
     struct rtl_tcp_info info;
-    ret = recv(sock, (char *)&info, sizeof (info), 0);
+    ret = rtltcp_wait(sock, 0, timeout_ms) == 1 ? recv(sock, (char *)&info, sizeof (info), 0) : -1;
     if (ret != 12) {
         print_logf(LOG_ERROR, __func__, "Bad rtl_tcp header (%d)", ret);
-        return -1;
+        closesocket(sock);
+        return INVALID_SOCKET;
     }
     if (strncmp(info.magic, "RTL0", 4)) {
         info.tuner_number = 0; // terminate magic
         print_logf(LOG_ERROR, __func__, "Bad rtl_tcp header magic \"%s\"", info.magic);
-        return -1;
+        closesocket(sock);
+        return INVALID_SOCKET;
     }
 
-    unsigned tuner_number = ntohl(info.tuner_number);
+    if (tuner_number)
+        *tuner_number = ntohl(info.tuner_number);
     //int tuner_gain_count  = ntohl(info.tuner_gain_count);
 
+    return sock;
+}
+
+static int rtltcp_send_command(SOCKET sock, char cmd, int param)
+{
+    struct command command;
+    command.cmd   = cmd;
+    command.param = htonl(param);
+
+    return sizeof(command) == send(sock, (const char*) &command, sizeof(command), 0) ? 0 : -1;
+}
+
+static int rtltcp_command(sdr_dev_t *dev, char cmd, int param)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&dev->lock);
+#endif
+    // remember the settings to re-apply them on reconnect
+    dev->rtl_tcp_cmds[cmd & (RTLTCP_CMD_COUNT - 1)] = param;
+    dev->rtl_tcp_cmds_set |= 1u << (cmd & (RTLTCP_CMD_COUNT - 1));
+    // while reconnecting the setting is applied on connect
+    int r = dev->rtl_tcp == INVALID_SOCKET ? 0 : rtltcp_send_command(dev->rtl_tcp, cmd, param);
+#ifdef THREADS
+    pthread_mutex_unlock(&dev->lock);
+#endif
+    return r;
+}
+
+/// Start the per connection statistics, acquire thread only.
+static void rtltcp_stats_reset(sdr_dev_t *dev)
+{
+    seq_write_begin(&dev->rtl_tcp_stats_seq);
+    unsigned connects = dev->rtl_tcp_stats.connects;
+    dev->rtl_tcp_stats = (sdr_stats_t){.connects = connects + 1};
+    dev->rtl_tcp_since_ns  = rtltcp_now_ns();
+    seq_write_end(&dev->rtl_tcp_stats_seq);
+    dev->rtl_tcp_last_ns   = 0;
+    dev->rtl_tcp_jitter_ns = 0.0;
+}
+
+/// Reconnect after a lost connection and re-apply the settings, returns 0 on success.
+static int rtltcp_reconnect(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&dev->lock);
+#endif
+    SOCKET old = dev->rtl_tcp;
+    dev->rtl_tcp = INVALID_SOCKET;
+#ifdef THREADS
+    pthread_mutex_unlock(&dev->lock);
+#endif
+    if (old != INVALID_SOCKET)
+        closesocket(old);
+
+    for (int attempt = 1; attempt <= dev->rtl_tcp_reconnect; ++attempt) {
+        // tell the consumer we are still trying, this keeps the stall watchdog at bay
+        sdr_event_t ev = {
+                .ev = SDR_EV_RETRY,
+        };
+        cb(&ev, ctx);
+
+        // back off, but keep checking for exit
+        for (int ms = 0; ms < MIN(attempt, 4) * RTLTCP_POLL_MS; ms += RTLTCP_POLL_MS) {
+            if (acquire_exiting(dev))
+                return -1;
+            usleep(RTLTCP_POLL_MS * 1000);
+        }
+
+        print_logf(LOG_WARNING, "SDR", "rtl_tcp reconnecting to %s:%s (%d/%d)", dev->rtl_tcp_host, dev->rtl_tcp_port, attempt, dev->rtl_tcp_reconnect);
+        SOCKET sock = rtltcp_connect(dev->rtl_tcp_host, dev->rtl_tcp_port, dev->rtl_tcp_rcvbuf, dev->rtl_tcp_timeout_ms, NULL);
+        if (sock == INVALID_SOCKET)
+            continue;
+
+#ifdef THREADS
+        pthread_mutex_lock(&dev->lock);
+#endif
+        dev->rtl_tcp = sock;
+        // re-apply the settings, the frequency last as others might change the tuning
+        for (int cmd = RTLTCP_SET_SAMPLE_RATE; cmd < RTLTCP_CMD_COUNT; ++cmd) {
+            if (dev->rtl_tcp_cmds_set & (1u << cmd))
+                rtltcp_send_command(sock, cmd, dev->rtl_tcp_cmds[cmd]);
+        }
+        if (dev->rtl_tcp_cmds_set & (1u << RTLTCP_SET_FREQ))
+            rtltcp_send_command(sock, RTLTCP_SET_FREQ, dev->rtl_tcp_cmds[RTLTCP_SET_FREQ]);
+        rtltcp_stats_reset(dev);
+#ifdef THREADS
+        pthread_mutex_unlock(&dev->lock);
+#endif
+        print_logf(LOG_NOTICE, "SDR", "rtl_tcp reconnected to %s:%s", dev->rtl_tcp_host, dev->rtl_tcp_port);
+        return 0;
+    }
+    return -1;
+}
+
+static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
+{
+    UNUSED(verbose);
+    char const *host = "localhost";
+    char const *port = "1234";
+    char hostport[400]; // 253 chars DNS name plus extra chars and options
+
+    char *param = arg_param(dev_query); // strip scheme
+    hostport[0] = '\0';
+    if (param) {
+        snprintf(hostport, sizeof(hostport), "%s", param);
+    }
+    char *opts = hostport_param(hostport, &host, &port);
+
+    int rcvbuf         = 0;
+    uint32_t readahead = 0;
+    int reconnect      = RTLTCP_RECONNECT;
+    int timeout_ms     = RTLTCP_TIMEOUT_MS;
+    unsigned compress  = 0;
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "rcvbuf"))
+            rcvbuf = (int)atouint32_metric(val, "rtl_tcp rcvbuf= ");
+        else if (!strcasecmp(key, "readahead"))
+            readahead = atouint32_metric(val, "rtl_tcp readahead= ");
+        else if (!strcasecmp(key, "reconnect"))
+            reconnect = atoiv(val, RTLTCP_RECONNECT);
+        else if (!strcasecmp(key, "timeout"))
+            timeout_ms = (int)(arg_float(val, "rtl_tcp timeout= ") * 1000);
+        else if (!strcasecmp(key, "compress") && val && !strcasecmp(val, "lossless"))
+            compress = RTLTCP_COMPRESS_LOSSLESS;
+        else if (!strcasecmp(key, "compress"))
+            compress = atobv(val, 1) ? RTLTCP_COMPRESS_LOSSLESS | RTLTCP_COMPRESS_SQUELCH : 0;
+        else {
+            print_logf(LOG_FATAL, __func__, "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+    if (rcvbuf < 0 || reconnect < 0 || timeout_ms < RTLTCP_POLL_MS) {
+        print_logf(LOG_FATAL, __func__, "Invalid rcvbuf=%d, reconnect=%d, or timeout=%d ms option.", rcvbuf, reconnect, timeout_ms);
+        exit(1);
+    }
+
+    print_logf(LOG_CRITICAL, "SDR", "rtl_tcp input from %s port %s", host, port);
+
+#ifdef _WIN32
+    WSADATA wsa;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        return -1;
+    }
+#endif
+
+    unsigned tuner_number = 0;
+    SOCKET sock = rtltcp_connect(host, port, rcvbuf, timeout_ms, &tuner_number);
+    if (sock == INVALID_SOCKET) {
+        return -1;
+    }
+
     char const *tuner_names[] = { "Unknown", "E4000", "FC0012", "FC0013", "FC2580", "R820T", "R828D" };
     char const *tuner_name = tuner_number > sizeof (tuner_names) ? "Invalid" : tuner_names[tuner_number];
 
     print_logf(LOG_CRITICAL, "SDR", "rtl_tcp connected to %s:%s (Tuner: %s)", host, port, tuner_name);
 
+    if (rcvbuf > 0) {
+        int actual = 0;
+        socklen_t len = sizeof(actual);
+        getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&actual, &len);
+        print_logf(LOG_NOTICE, "SDR", "rtl_tcp receive buffer %d bytes (requested %d)", actual, rcvbuf);
+    }
+
     sdr_dev_t *dev = calloc(1, sizeof(sdr_dev_t));
     if (!dev) {
         WARN_CALLOC("rtltcp_open()");
+        closesocket(sock);
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->rtl_tcp_host = strdup(host);
+    if (!dev->rtl_tcp_host) {
+        WARN_STRDUP("rtltcp_open()");
+        closesocket(sock);
+        free(dev);
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->rtl_tcp_port = strdup(port);
+    if (!dev->rtl_tcp_port) {
+        WARN_STRDUP("rtltcp_open()");
+        closesocket(sock);
+        free(dev->rtl_tcp_host);
+        free(dev);
         return -1; // NOTE: returns error on alloc failure.
     }
 #ifdef THREADS
     pthread_mutex_init(&dev->lock, NULL);
+    pthread_cond_init(&dev->lease_cond, NULL);
+    pthread_mutex_init(&dev->ctl_lock, NULL);
+    pthread_cond_init(&dev->ctl_cond, NULL);
 #endif
 
     dev->rtl_tcp = sock;
+    dev->rtl_tcp_rcvbuf     = rcvbuf;
+    dev->rtl_tcp_readahead  = readahead;
+    dev->rtl_tcp_reconnect  = reconnect;
+    dev->rtl_tcp_timeout_ms = timeout_ms;
+    dev->rtl_tcp_compress   = compress;
+    rtltcp_stats_reset(dev);
     dev->sample_size = sizeof(uint8_t) * 2; // CU8
     dev->sample_signed = 0;
 
@@ -249,9 +724,234 @@ static int rtltcp_close(SOCKET sock)
     return 0;
 }
 
+/// Account a handed out buffer in the connection statistics, acquire thread only.
+static void rtltcp_stats_buffer(sdr_dev_t *dev, int64_t arrival_ns, uint32_t len, uint32_t sample_rate)
+{
+    unsigned n_samples = len / dev->sample_size;
+    sdr_stats_t *stats = &dev->rtl_tcp_stats;
+    seq_write_begin(&dev->rtl_tcp_stats_seq);
+    if (dev->rtl_tcp_last_ns && sample_rate) {
+        // interarrival jitter as in RFC 3550
+        double d = (double)(arrival_ns - dev->rtl_tcp_last_ns) - n_samples * 1e9 / sample_rate;
+        dev->rtl_tcp_jitter_ns += (fabs(d) - dev->rtl_tcp_jitter_ns) / 16.0;
+        stats->jitter_us = (unsigned)(dev->rtl_tcp_jitter_ns / 1000);
+    }
+    dev->rtl_tcp_last_ns = arrival_ns;
+    stats->lag_ms = (unsigned)(dev->stream_lag_ns / 1000000);
+    if (stats->lag_ms > stats->lag_max_ms)
+        stats->lag_max_ms = stats->lag_ms;
+    stats->iq_bytes += len;
+    seq_write_end(&dev->rtl_tcp_stats_seq);
+}
+
+/// Buffers and state of the rtl_tcp read loop.
+typedef struct rtltcp_stream {
+    uint8_t *buf;       ///< ring of buffers to hand out
+    size_t size;        ///< ring size in bytes, a whole number of buffers
+    uint32_t buf_len;   ///< length of a buffer
+    size_t read_pos;    ///< next byte to fill
+    size_t deliver_pos; ///< start of the next buffer to hand out
+    int mode;           ///< plain, waiting for the sync, or chunked
+    int64_t sync_since_ns; ///< arrival of the first data after the request, 0 if none yet
+    uint8_t *zbuf;      ///< received data of the compressed stream
+    size_t zbuf_size;   ///< size of the receive part of zbuf
+    size_t zlen;        ///< bytes in zbuf not yet used
+    uint8_t *decoded;   ///< decoded chunk data, after the receive part of zbuf
+} rtltcp_stream_t;
+
+enum rtltcp_stream_mode {
+    RTLTCP_STREAM_PLAIN,
+    RTLTCP_STREAM_SYNCING,
+    RTLTCP_STREAM_CHUNKED,
+};
+
+static uint32_t get_be32(uint8_t const *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/// Ask for the compressed stream, the server switches at the next frame.
+static void rtltcp_request_compression(sdr_dev_t *dev, rtltcp_stream_t *st)
+{
+    if (!dev->rtl_tcp_compress)
+        return;
+#ifdef THREADS
+    pthread_mutex_lock(&dev->lock);
+#endif
+    rtltcp_send_command(dev->rtl_tcp, RTLTCP_SET_COMPRESSION, dev->rtl_tcp_compress);
+#ifdef THREADS
+    pthread_mutex_unlock(&dev->lock);
+#endif
+    st->mode          = RTLTCP_STREAM_SYNCING;
+    st->sync_since_ns = 0;
+    st->zlen          = 0;
+}
+
+/// Hand out the next len bytes of the ring as a buffer.
+static void rtltcp_deliver(sdr_dev_t *dev, rtltcp_stream_t *st, uint32_t len, int64_t arrival_ns, sdr_event_cb_t cb, void *ctx)
+{
+    sdr_event_t ev = {
+            .ev               = SDR_EV_DATA,
+            .sample_rate      = param_get(&dev->sample_rate),
+            .center_frequency = param_get(&dev->center_frequency),
+            .buf              = &st->buf[st->deliver_pos],
+            .len              = len,
+    };
+    stream_stamp(dev, &ev, 0);
+    rtltcp_stats_buffer(dev, arrival_ns, len, ev.sample_rate);
+    st->deliver_pos += len;
+    control_report(dev, cb, ctx);
+    cb(&ev, ctx);
+}
+
+/// Hand out all filled buffers.
+static void rtltcp_deliver_full(sdr_dev_t *dev, rtltcp_stream_t *st, int64_t arrival_ns, sdr_event_cb_t cb, void *ctx)
+{
+    while (st->read_pos - st->deliver_pos >= st->buf_len && !acquire_exiting(dev)) {
+        rtltcp_deliver(dev, st, st->buf_len, arrival_ns, cb, ctx);
+    }
+    if (st->deliver_pos == st->size) {
+        st->read_pos    = 0;
+        st->deliver_pos = 0;
+    }
+}
+
+/// Copy data into the ring, hands out each buffer filled.
+static void rtltcp_put(sdr_dev_t *dev, rtltcp_stream_t *st, uint8_t const *data, size_t len, int64_t arrival_ns, sdr_event_cb_t cb, void *ctx)
+{
+    while (len && !acquire_exiting(dev)) {
+        size_t n = MIN(len, st->buf_len - (st->read_pos - st->deliver_pos));
+        memcpy(&st->buf[st->read_pos], data, n);
+        st->read_pos += n;
+        data += n;
+        len -= n;
+        rtltcp_deliver_full(dev, st, arrival_ns, cb, ctx);
+    }
+}
+
+/// Account samples the server left out, a partial buffer is handed out first to keep the order.
+static void rtltcp_skip(sdr_dev_t *dev, rtltcp_stream_t *st, uint32_t n_samples, int64_t arrival_ns, sdr_event_cb_t cb, void *ctx)
+{
+    size_t partial = st->read_pos - st->deliver_pos;
+    if (partial) {
+        // the next buffer starts at the next slot
+        size_t next = st->deliver_pos + st->buf_len;
+        rtltcp_deliver(dev, st, (uint32_t)partial, arrival_ns, cb, ctx);
+        st->read_pos    = next == st->size ? 0 : next;
+        st->deliver_pos = st->read_pos;
+    }
+
+    dev->stream_pos += n_samples;
+    seq_write_begin(&dev->rtl_tcp_stats_seq);
+    dev->rtl_tcp_stats.iq_bytes += (uint64_t)n_samples * dev->sample_size;
+    seq_write_end(&dev->rtl_tcp_stats_seq);
+    sdr_event_t ev = {
+            .ev      = SDR_EV_SKIP,
+            .skipped = n_samples,
+    };
+    cb(&ev, ctx);
+}
+
+/// Find the sync, returns the offset or -1 and the length of a partial sync at the end.
+static long rtltcp_find_sync(uint8_t const *buf, size_t len, size_t *partial)
+{
+    static uint8_t const magic[RTLTCP_SYNC_MAGIC_LEN] = RTLTCP_SYNC_MAGIC;
+    *partial = 0;
+    for (uint8_t const *p = buf; (p = memchr(p, magic[0], len - (size_t)(p - buf))); ++p) {
+        size_t avail = len - (size_t)(p - buf);
+        if (!memcmp(p, magic, MIN(avail, sizeof(magic)))) {
+            if (avail >= RTLTCP_SYNC_LEN)
+                return (long)(p - buf);
+            *partial = avail; // the first byte does not repeat, this is the only candidate
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/// Use the chunks in zbuf, returns the bytes used or -1 on a broken stream.
+static long rtltcp_chunks(sdr_dev_t *dev, rtltcp_stream_t *st, uint8_t const *buf, size_t len, int64_t arrival_ns, sdr_event_cb_t cb, void *ctx)
+{
+    size_t pos = 0;
+    while (len - pos >= RTLTCP_CHUNK_HEADER_LEN && !acquire_exiting(dev)) {
+        uint8_t const *chunk = &buf[pos];
+        int type             = chunk[0];
+        uint32_t samples     = get_be32(&chunk[4]);
+        uint32_t payload_len = get_be32(&chunk[8]);
+        int bad = type > RTLTCP_CHUNK_SKIP
+                || (type == RTLTCP_CHUNK_SKIP && payload_len)
+                || (type == RTLTCP_CHUNK_RAW && payload_len != samples * 2)
+                || (type != RTLTCP_CHUNK_SKIP && (samples > RTLTCP_CHUNK_SAMPLES || payload_len > iq_codec_bound(samples * 2)));
+        if (bad) {
+            print_logf(LOG_ERROR, "SDR", "rtl_tcp bad chunk type %d with %u samples", type, samples);
+            return -1;
+        }
+        if (len - pos < RTLTCP_CHUNK_HEADER_LEN + payload_len)
+            break; // wait for the rest
+        uint8_t const *payload = &chunk[RTLTCP_CHUNK_HEADER_LEN];
+        if (type == RTLTCP_CHUNK_RAW) {
+            rtltcp_put(dev, st, payload, payload_len, arrival_ns, cb, ctx);
+        }
+        else if (type == RTLTCP_CHUNK_CODED) {
+            if (iq_codec_decode(payload, payload_len, st->decoded, samples * 2)) {
+                print_logf(LOG_ERROR, "SDR", "rtl_tcp corrupt chunk with %u samples", samples);
+                return -1;
+            }
+            rtltcp_put(dev, st, st->decoded, samples * 2, arrival_ns, cb, ctx);
+        }
+        else {
+            rtltcp_skip(dev, st, samples, arrival_ns, cb, ctx);
+        }
+        pos += RTLTCP_CHUNK_HEADER_LEN + payload_len;
+    }
+    return (long)pos;
+}
+
+/// Use the data received into zbuf, returns 0 on success or -1 on a broken stream.
+static int rtltcp_receive_compressed(sdr_dev_t *dev, rtltcp_stream_t *st, int64_t arrival_ns, sdr_event_cb_t cb, void *ctx)
+{
+    size_t used = 0;
+    if (st->mode == RTLTCP_STREAM_SYNCING) {
+        // until the sync the server sends plain data, the server only reads commands with data to send
+        if (!st->sync_since_ns)
+            st->sync_since_ns = arrival_ns;
+        size_t partial;
+        long at = rtltcp_find_sync(st->zbuf, st->zlen, &partial);
+        if (at >= 0) {
+            unsigned flags = get_be32(&st->zbuf[at + RTLTCP_SYNC_MAGIC_LEN]);
+            print_logf(LOG_NOTICE, "SDR", "rtl_tcp compression%s%s", flags & RTLTCP_COMPRESS_LOSSLESS ? " lossless" : "",
+                    flags & RTLTCP_COMPRESS_SQUELCH ? " squelch" : "");
+            rtltcp_put(dev, st, st->zbuf, (size_t)at, arrival_ns, cb, ctx);
+            used     = (size_t)at + RTLTCP_SYNC_LEN;
+            st->mode = RTLTCP_STREAM_CHUNKED;
+        }
+        else if (arrival_ns - st->sync_since_ns > (int64_t)RTLTCP_SYNC_TIMEOUT_MS * 1000000) {
+            print_log(LOG_WARNING, "SDR", "rtl_tcp server does not support compression, using the plain stream");
+            used     = st->zlen;
+            st->mode = RTLTCP_STREAM_PLAIN;
+            rtltcp_put(dev, st, st->zbuf, used, arrival_ns, cb, ctx);
+        }
+        else {
+            used = st->zlen - partial;
+            rtltcp_put(dev, st, st->zbuf, used, arrival_ns, cb, ctx);
+        }
+    }
+    if (st->mode == RTLTCP_STREAM_CHUNKED) {
+        long n = rtltcp_chunks(dev, st, &st->zbuf[used], st->zlen - used, arrival_ns, cb, ctx);
+        if (n < 0)
+            return -1;
+        used += (size_t)n;
+    }
+    memmove(st->zbuf, &st->zbuf[used], st->zlen - used);
+    st->zlen -= used;
+    return 0;
+}
+
 static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
-    size_t buffer_size = (size_t)buf_num * buf_len;
+    // the ring holds the buffers handed out plus the readahead, in whole buffers
+    uint32_t ring_num  = buf_num + (dev->rtl_tcp_readahead + buf_len - 1) / buf_len;
+    size_t buffer_size = (size_t)ring_num * buf_len;
     if (dev->buffer_size != buffer_size) {
         free(dev->buffer);
         dev->buffer = malloc(buffer_size);
@@ -261,98 +961,99 @@ static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
         }
         dev->buffer_size = buffer_size;
         dev->buffer_pos = 0;
-    }
-
-    dev->running = 1;
-    do {
-        if (dev->buffer_pos + buf_len > buffer_size)
-            dev->buffer_pos = 0;
-        uint8_t *buffer = &dev->buffer[dev->buffer_pos];
-        dev->buffer_pos += buf_len;
-
-        unsigned n_read = 0;
-        int r;
-
-        do {
-            r = recv(dev->rtl_tcp, &buffer[n_read], buf_len - n_read, MSG_WAITALL);
-            if (r <= 0)
-                break;
-            n_read += r;
-            //fprintf(stderr, "readStream ret=%d (of %u)\n", r, n_read);
-        } while (n_read < buf_len);
-        //fprintf(stderr, "readStream ret=%d (read %u)\n", r, n_read);
+        if (dev->lock_buffers)
+            thread_sched_lock_memory(dev->buffer, buffer_size);
+    }
+    // up to buf_num - 1 buffers handed out might still be in use, the others can be filled ahead
+    size_t fill_max = (size_t)(ring_num - buf_num + 1) * buf_len;
+    rtltcp_stream_t st = {
+            .buf     = dev->buffer,
+            .size    = buffer_size,
+            .buf_len = buf_len,
+    };
 
-        if (r < 0) {
-            print_logf(LOG_WARNING, __func__, "sync read failed. %d", r);
+    // the compressed stream is received into a buffer of two chunks and decoded into the ring
+    if (dev->rtl_tcp_compress) {
+        st.zbuf_size = 2 * (RTLTCP_CHUNK_HEADER_LEN + iq_codec_bound(RTLTCP_CHUNK_SAMPLES * 2));
+        st.zbuf = malloc(st.zbuf_size + RTLTCP_CHUNK_SAMPLES * 2);
+        if (!st.zbuf) {
+            WARN_MALLOC("rtltcp_read_loop()");
+            return -1; // NOTE: returns error on alloc failure.
+        }
+        st.decoded = &st.zbuf[st.zbuf_size];
+        if (dev->lock_buffers)
+            thread_sched_lock_memory(st.zbuf, st.zbuf_size + RTLTCP_CHUNK_SAMPLES * 2);
+    }
+
+    // the server drops buffers silently when we fall behind
+    stream_reset(dev, RTLTCP_SERVER_BUFFER_SIZE / dev->sample_size);
+    int64_t last_data_ns = rtltcp_now_ns();
+    rtltcp_request_compression(dev, &st);
+
+    param_set(&dev->running, 1);
+    while (param_get(&dev->running) && !acquire_exiting(dev)) {
+        // only this thread changes the socket
+        SOCKET sock = dev->rtl_tcp;
+        int r = rtltcp_wait(sock, 0, RTLTCP_POLL_MS);
+        int64_t now_ns = rtltcp_now_ns();
+        if (r == 0) {
+            if (now_ns - last_data_ns < (int64_t)dev->rtl_tcp_timeout_ms * 1000000)
+                continue; // keep waiting
+            print_logf(LOG_WARNING, __func__, "no data for %d ms", dev->rtl_tcp_timeout_ms);
+        }
+        else if (r > 0) {
+            if (st.mode == RTLTCP_STREAM_PLAIN) {
+                // read what is available, but never into buffers that might be in use
+                size_t limit = MIN(buffer_size, st.deliver_pos + fill_max);
+                r = recv(sock, (char *)&st.buf[st.read_pos], (int)(limit - st.read_pos), 0);
+            }
+            else {
+                r = recv(sock, (char *)&st.zbuf[st.zlen], (int)(st.zbuf_size - st.zlen), 0);
+            }
+            if (r > 0) {
+                seq_write_begin(&dev->rtl_tcp_stats_seq);
+                dev->rtl_tcp_stats.bytes += r;
+                unsigned gap_ms = (unsigned)((now_ns - last_data_ns) / 1000000);
+                if (gap_ms > dev->rtl_tcp_stats.gap_max_ms)
+                    dev->rtl_tcp_stats.gap_max_ms = gap_ms;
+                seq_write_end(&dev->rtl_tcp_stats_seq);
+                last_data_ns = now_ns;
+
+                if (st.mode == RTLTCP_STREAM_PLAIN) {
+                    st.read_pos += r;
+                    rtltcp_deliver_full(dev, &st, now_ns, cb, ctx);
+                    continue;
+                }
+                st.zlen += r;
+                if (!rtltcp_receive_compressed(dev, &st, now_ns, cb, ctx))
+                    continue;
+                // the stream is broken, start over
+            }
+            else if (r == 0)
+                print_log(LOG_WARNING, __func__, "connection closed");
+            else
+                perror("rtl_tcp");
         }
-        if (n_read == 0) {
+        else {
             perror("rtl_tcp");
-            dev->running = 0;
         }
 
-#ifdef THREADS
-        pthread_mutex_lock(&dev->lock);
-#endif
-        uint32_t sample_rate      = dev->sample_rate;
-        uint32_t center_frequency = dev->center_frequency;
-#ifdef THREADS
-        pthread_mutex_unlock(&dev->lock);
-#endif
-        sdr_event_t ev = {
-                .ev               = SDR_EV_DATA,
-                .sample_rate      = sample_rate,
-                .center_frequency = center_frequency,
-                .buf              = buffer,
-                .len              = n_read,
-        };
-#ifdef THREADS
-        pthread_mutex_lock(&dev->lock);
-        int exit_acquire = dev->exit_acquire;
-        pthread_mutex_unlock(&dev->lock);
-        if (exit_acquire) {
-            break; // do not deliver any more events
+        // the connection is lost
+        if (acquire_exiting(dev) || rtltcp_reconnect(dev, cb, ctx) < 0) {
+            param_set(&dev->running, 0);
+            break;
         }
-#endif
-        if (n_read > 0) // prevent a crash in callback
-            cb(&ev, ctx);
-
-    } while (dev->running);
+        // a partial buffer is lost with the connection, count the gap as dropped
+        st.read_pos          = st.deliver_pos;
+        dev->stream_overflow = 1;
+        last_data_ns         = rtltcp_now_ns();
+        rtltcp_request_compression(dev, &st);
+    }
 
+    free(st.zbuf);
     return 0;
 }
 
-#pragma pack(push, 1)
-struct command {
-    unsigned char cmd;
-    unsigned int param;
-};
-#pragma pack(pop)
-
-// rtl_tcp API
-#define RTLTCP_SET_FREQ 0x01
-#define RTLTCP_SET_SAMPLE_RATE 0x02
-#define RTLTCP_SET_GAIN_MODE 0x03
-#define RTLTCP_SET_GAIN 0x04
-#define RTLTCP_SET_FREQ_CORRECTION 0x05
-#define RTLTCP_SET_IF_TUNER_GAIN 0x06
-#define RTLTCP_SET_TEST_MODE 0x07
-#define RTLTCP_SET_AGC_MODE 0x08
-#define RTLTCP_SET_DIRECT_SAMPLING 0x09
-#define RTLTCP_SET_OFFSET_TUNING 0x0a
-#define RTLTCP_SET_RTL_XTAL 0x0b
-#define RTLTCP_SET_TUNER_XTAL 0x0c
-#define RTLTCP_SET_TUNER_GAIN_BY_ID 0x0d
-#define RTLTCP_SET_BIAS_TEE 0x0e
-
-static int rtltcp_command(sdr_dev_t *dev, char cmd, int param)
-{
-    struct command command;
-    command.cmd   = cmd;
-    command.param = htonl(param);
-
-    return sizeof(command) == send(dev->rtl_tcp, (const char*) &command, sizeof(command), 0) ? 0 : -1;
-}
-
 /* RTL-SDR helpers */
 
 #ifdef RTLSDR
@@ -400,6 +1101,9 @@ static int sdr_open_rtl(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     }
 #ifdef THREADS
     pthread_mutex_init(&dev->lock, NULL);
+    pthread_cond_init(&dev->lease_cond, NULL);
+    pthread_mutex_init(&dev->ctl_lock, NULL);
+    pthread_cond_init(&dev->ctl_cond, NULL);
 #endif
 
     for (uint32_t i = dev_query ? dev_index : 0;
@@ -487,9 +1191,32 @@ static void rtlsdr_read_cb(unsigned char *iq_buf, uint32_t len, void *ctx)
 
     //fprintf(stderr, "rtlsdr_read_cb enter...\n");
 #ifdef THREADS
-    pthread_mutex_lock(&dev->lock);
-    int exit_acquire = dev->exit_acquire;
-    pthread_mutex_unlock(&dev->lock);
+    int exit_acquire = acquire_exiting(dev);
+    int lease        = 0;
+    if (!exit_acquire && param_get(&dev->lease_buffers) && len > 0) {
+        // librtlsdr resubmits the transfer once we return, it is refilled after the other transfers,
+        // with at most half of them leased a lease stays valid as long as a slot of the copy ring
+        pthread_mutex_lock(&dev->lock);
+        lease = !acquire_exiting(dev) && dev->leases < dev->lease_max;
+        if (lease)
+            dev->leases++;
+        pthread_mutex_unlock(&dev->lock);
+    }
+    if (lease) {
+        sdr_event_t ev = {
+                .ev               = SDR_EV_DATA,
+                .sample_rate      = param_get(&dev->sample_rate),
+                .center_frequency = param_get(&dev->center_frequency),
+                .buf              = iq_buf,
+                .len              = len,
+                .lease            = dev,
+        };
+        stream_stamp(dev, &ev, 0);
+
+        control_report(dev, dev->rtlsdr_cb, dev->rtlsdr_cb_ctx);
+        dev->rtlsdr_cb(&ev, dev->rtlsdr_cb_ctx);
+        return; // never wait for the consumer, the queue behind it drops what it can't take
+    }
     if (exit_acquire) {
         // we get one more call after rtlsdr_cancel_async(),
         // it then takes a full second until rtlsdr_read_async() ends.
@@ -506,22 +1233,16 @@ static void rtlsdr_read_cb(unsigned char *iq_buf, uint32_t len, void *ctx)
     // NOTE: we need to copy the buffer, it might go away on cancel_async
     memcpy(buffer, iq_buf, len);
 
-#ifdef THREADS
-    pthread_mutex_lock(&dev->lock);
-#endif
-    uint32_t sample_rate      = dev->sample_rate;
-    uint32_t center_frequency = dev->center_frequency;
-#ifdef THREADS
-    pthread_mutex_unlock(&dev->lock);
-#endif
     sdr_event_t ev = {
             .ev               = SDR_EV_DATA,
-            .sample_rate      = sample_rate,
-            .center_frequency = center_frequency,
+            .sample_rate      = param_get(&dev->sample_rate),
+            .center_frequency = param_get(&dev->center_frequency),
             .buf              = buffer,
             .len              = len,
     };
+    stream_stamp(dev, &ev, 0);
     //fprintf(stderr, "rtlsdr_read_cb cb...\n");
+    control_report(dev, dev->rtlsdr_cb, dev->rtlsdr_cb_ctx);
     if (len > 0) // prevent a crash in callback
         dev->rtlsdr_cb(&ev, dev->rtlsdr_cb_ctx);
     //fprintf(stderr, "rtlsdr_read_cb cb done.\n");
@@ -530,7 +1251,11 @@ static void rtlsdr_read_cb(unsigned char *iq_buf, uint32_t len, void *ctx)
 
 static int rtlsdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
+    // the buffers are copied while too many are leased, the ring is needed with leases too
     size_t buffer_size = (size_t)buf_num * buf_len;
+#ifdef THREADS
+    dev->lease_max = MAX(buf_num / 2, 1);
+#endif
     if (dev->buffer_size != buffer_size) {
         free(dev->buffer);
         dev->buffer = malloc(buffer_size);
@@ -540,6 +1265,8 @@ static int rtlsdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
         }
         dev->buffer_size = buffer_size;
         dev->buffer_pos = 0;
+        if (dev->lock_buffers)
+            thread_sched_lock_memory(dev->buffer, buffer_size);
     }
 
     int r = 0;
@@ -547,7 +1274,10 @@ static int rtlsdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
     dev->rtlsdr_cb = cb;
     dev->rtlsdr_cb_ctx = ctx;
 
-    dev->running = 1;
+    // librtlsdr drops transfers silently once all buffers are filled
+    stream_reset(dev, (uint64_t)buf_num * buf_len / dev->sample_size);
+
+    param_set(&dev->running, 1);
 
         r = rtlsdr_read_async(dev->rtlsdr_dev, rtlsdr_read_cb, dev, buf_num, buf_len);
         // rtlsdr_read_async() returns possible error codes from:
@@ -567,7 +1297,7 @@ static int rtlsdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
                             "Check your RTL-SDR dongle, USB cables, and power supply.",
                     r);
 #endif
-            dev->running = 0;
+            param_set(&dev->running, 0);
         }
     print_log(LOG_DEBUG, __func__, "rtlsdr_read_async done");
 
@@ -656,13 +1386,19 @@ static int soapysdr_offset_tuning(SoapySDRDevice *dev)
     return r;
 }
 
-static int soapysdr_auto_gain(SoapySDRDevice *dev, int verbose)
+/// Get the number of RX channels of the stream, the settings apply to each.
+static size_t soapysdr_channels(sdr_dev_t const *dev)
+{
+    return dev->rx_channels ? dev->rx_channels : 1;
+}
+
+static int soapysdr_auto_gain(SoapySDRDevice *dev, size_t channel, int verbose)
 {
     int r = 0;
 
-    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, 0);
+    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, channel);
     if (r) {
-        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, 0, 1);
+        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, channel, 1);
         if (r != 0) {
             print_log(LOG_WARNING, __func__, "Failed to enable automatic gain.");
         }
@@ -679,15 +1415,15 @@ static int soapysdr_auto_gain(SoapySDRDevice *dev, int verbose)
         // even though it logs HACKRF_ERROR_INVALID_PARAM? https://github.com/rxseger/rx_tools/issues/9
         // Total gain is distributed amongst all gains, 116 = 37,65,1; the LNA is OK (<40) but VGA is out of range (65 > 62)
         // TODO: generic means to set all gains, of any SDR? string parsing LNA=#,VGA=#,AMP=#?
-        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, "LNA", 40.); // max 40
+        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, "LNA", 40.); // max 40
         if (r != 0) {
             print_log(LOG_WARNING, __func__, "Failed to set LNA tuner gain.");
         }
-        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, "VGA", 20.); // max 65
+        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, "VGA", 20.); // max 65
         if (r != 0) {
             print_log(LOG_WARNING, __func__, "Failed to set VGA tuner gain.");
         }
-        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, "AMP", 0.); // on or off
+        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, "AMP", 0.); // on or off
         if (r != 0) {
             print_log(LOG_WARNING, __func__, "Failed to set AMP tuner gain.");
         }
@@ -699,7 +1435,7 @@ static int soapysdr_auto_gain(SoapySDRDevice *dev, int verbose)
     return r;
 }
 
-static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int verbose)
+static int soapysdr_gain_str_set(SoapySDRDevice *dev, size_t channel, char const *gain_str, int verbose)
 {
     if (!gain_str || !*gain_str || strlen(gain_str) >= GAIN_STR_MAX_SIZE)
         return -1;
@@ -707,9 +1443,9 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
     int r = 0;
 
     // Disable automatic gain
-    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, 0);
+    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, channel);
     if (r) {
-        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, 0, 0);
+        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, channel, 0);
         if (r != 0) {
             print_log(LOG_WARNING, __func__, "Failed to disable automatic gain.");
         }
@@ -730,7 +1466,7 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
             double num = atof(value);
             if (verbose)
                 print_logf(LOG_NOTICE, "SDR", "Setting gain element %s: %f dB", name, num);
-            r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, name, num);
+            r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, name, num);
             if (r != 0) {
                 print_logf(LOG_WARNING, __func__, "setGainElement(%s, %f) failed: %d", name, num, r);
             }
@@ -739,7 +1475,7 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
     else {
         // Set overall gain and let SoapySDR distribute amongst components
         double value = atof(gain_str);
-        r = SoapySDRDevice_setGain(dev, SOAPY_SDR_RX, 0, value);
+        r = SoapySDRDevice_setGain(dev, SOAPY_SDR_RX, channel, value);
         if (r != 0) {
             print_log(LOG_WARNING, __func__, "Failed to set tuner gain.");
         }
@@ -750,10 +1486,10 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
         // read back and print each individual gain element
         if (verbose) {
             size_t len = 0;
-            char **gains = SoapySDRDevice_listGains(dev, SOAPY_SDR_RX, 0, &len);
+            char **gains = SoapySDRDevice_listGains(dev, SOAPY_SDR_RX, channel, &len);
             fprintf(stderr, "Gain elements: ");
             for (size_t i = 0; i < len; ++i) {
-                double gain = SoapySDRDevice_getGain(dev, SOAPY_SDR_RX, 0);
+                double gain = SoapySDRDevice_getGain(dev, SOAPY_SDR_RX, channel);
                 fprintf(stderr, "%s=%g ", gains[i], gain);
             }
             fprintf(stderr, "\n");
@@ -861,6 +1597,26 @@ static void soapysdr_show_device_info(SoapySDRDevice *dev)
     SoapySDR_free(native_stream_format);
 }
 
+/// Set up the RX stream on the first @p num channels, 0 for the default channel.
+static int soapysdr_setup_stream(sdr_dev_t *dev, size_t num)
+{
+    size_t channels[SDR_RX_CHANNELS_MAX];
+    for (size_t c = 0; c < num; ++c)
+        channels[c] = c;
+    SoapySDRKwargs stream_args = {0};
+    int r;
+#if SOAPY_SDR_API_VERSION >= 0x00080000
+    // API version 0.8
+#undef SoapySDRDevice_setupStream
+    dev->soapy_stream = SoapySDRDevice_setupStream(dev->soapy_dev, SOAPY_SDR_RX, dev->stream_format, num ? channels : NULL, num, &stream_args);
+    r = dev->soapy_stream == NULL;
+#else
+    // API version 0.7
+    r = SoapySDRDevice_setupStream(dev->soapy_dev, &dev->soapy_stream, SOAPY_SDR_RX, dev->stream_format, num ? channels : NULL, num, &stream_args);
+#endif
+    return r;
+}
+
 static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbose)
 {
     if (verbose)
@@ -873,6 +1629,9 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
     }
 #ifdef THREADS
     pthread_mutex_init(&dev->lock, NULL);
+    pthread_cond_init(&dev->lease_cond, NULL);
+    pthread_mutex_init(&dev->ctl_lock, NULL);
+    pthread_cond_init(&dev->ctl_cond, NULL);
 #endif
 
     dev->soapy_dev = SoapySDRDevice_makeStrArgs(dev_query);
@@ -893,22 +1652,26 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
     if (!strcmp(SOAPY_SDR_CU8, native_format)) {
         // actually not supported by SoapySDR
         selected_format = SOAPY_SDR_CU8;
-        dev->sample_size = sizeof(uint8_t); // CU8
+        dev->sample_size = sizeof(uint8_t) * 2; // CU8
+        dev->sample_signed = 0;
+        dev->stream_native = 1;
+    }
+    else if (!strcmp(SOAPY_SDR_CS8, native_format)) {
+        // e.g. HackRF, RTL-SDR (8 bit), scale is 128.0
+        // stream at half the bandwidth of CS16, the read loop flips it to CU8
+        selected_format = SOAPY_SDR_CS8;
+        dev->sample_size = sizeof(int8_t) * 2; // CS8, delivered as CU8
         dev->sample_signed = 0;
+        dev->stream_cs8 = 1;
+        dev->stream_native = 1;
     }
-//    else if (!strcmp(SOAPY_SDR_CS8, native_format)) {
-//        // TODO: CS8 needs conversion to CU8
-//        // e.g. RTL-SDR (8 bit), scale is 128.0
-//        selected_format = SOAPY_SDR_CS8;
-//        dev->sample_size = sizeof(int8_t) * 2; // CS8
-//        dev->sample_signed = 1;
-//    }
     else if (!strcmp(SOAPY_SDR_CS16, native_format)) {
         // e.g. LimeSDR-mini (12 bit), native scale is 2048.0
         // e.g. SDRplay RSP1A (14 bit), native scale is 32767.0
         selected_format = SOAPY_SDR_CS16;
         dev->sample_size = sizeof(int16_t) * 2; // CS16
         dev->sample_signed = 1;
+        dev->stream_native = 1;
     }
     else {
         // force CS16
@@ -918,6 +1681,7 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
         dev->fullScale = 32768.0; // assume max for SOAPY_SDR_CS16
     }
     SoapySDR_free(native_format);
+    dev->stream_format = selected_format;
 
     SoapySDRKwargs args = SoapySDRDevice_getHardwareInfo(dev->soapy_dev);
     size_t info_len     = 2;
@@ -933,17 +1697,7 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
     sprintf(p, "}");
     SoapySDRKwargs_clear(&args);
 
-    SoapySDRKwargs stream_args = {0};
-    int r;
-#if SOAPY_SDR_API_VERSION >= 0x00080000
-    // API version 0.8
-#undef SoapySDRDevice_setupStream
-    dev->soapy_stream = SoapySDRDevice_setupStream(dev->soapy_dev, SOAPY_SDR_RX, selected_format, NULL, 0, &stream_args);
-    r = dev->soapy_stream == NULL;
-#else
-    // API version 0.7
-    r = SoapySDRDevice_setupStream(dev->soapy_dev, &dev->soapy_stream, SOAPY_SDR_RX, selected_format, NULL, 0, &stream_args);
-#endif
+    int r = soapysdr_setup_stream(dev, 0);
     if (r != 0) {
         if (verbose)
             print_log(LOG_ERROR, __func__, "Failed to setup sdr device");
@@ -960,9 +1714,212 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
 #pragma GCC diagnostic ignored "-Wunknown-warning-option"
 #pragma GCC diagnostic ignored "-Wanalyzer-allocation-size"
 
+/// Get the factor to scale the CS16 stream to full scale, 1 if already at full scale.
+static int soapysdr_upscale(sdr_dev_t const *dev)
+{
+    if (dev->sample_size != sizeof(int16_t) * 2)
+        return 1;
+    if (dev->fullScale >= 2047.0 && dev->fullScale <= 2048.0)
+        return 16;
+    if (dev->fullScale < 32767.0)
+        return (int)(32768 / dev->fullScale);
+    return 1;
+}
+
+/// Convert @p n samples of the stream to CU8 or full scale CS16, @p dst may be @p src -- vectorized with -O3.
+static void soapysdr_convert(sdr_dev_t const *dev, void const *src, void *dst, size_t n)
+{
+    int upscale = soapysdr_upscale(dev);
+    if (dev->stream_cs8) {
+        // convert CS8 to CU8, the offset by 128 is a flip of the sign bit
+        uint8_t const *s8 = src;
+        uint8_t *d8 = dst;
+        for (size_t i = 0; i < n * 2; ++i)
+            d8[i] = s8[i] ^ 0x80;
+    }
+    else if (upscale != 1) {
+        int16_t const *s16 = src;
+        int16_t *d16 = dst;
+        for (size_t i = 0; i < n * 2; ++i)
+            d16[i] = (int16_t)(s16[i] * upscale); // prevent left shift of negative value
+    }
+    else if (dst != src) {
+        memcpy(dst, src, n * dev->sample_size);
+    }
+}
+
+/// Check if the stream hands out its DMA buffers, in frames of at least a quarter buffer.
+static int soapysdr_direct_access(sdr_dev_t *dev, size_t buf_elems)
+{
+    if (!dev->stream_native || SoapySDRDevice_getNumDirectAccessBuffers(dev->soapy_dev, dev->soapy_stream) == 0)
+        return 0;
+    // the per frame work would outweigh the saved copy on small DMA buffers
+    return SoapySDRDevice_getStreamMTU(dev->soapy_dev, dev->soapy_stream) * 4 >= buf_elems;
+}
+
+#ifdef THREADS
+/// Hold a DMA buffer for leased frames, returns NULL if too many are held.
+static sdr_dma_lease_t *soapysdr_hold_dma(sdr_dev_t *dev, size_t handle, uint8_t const *buf, size_t len)
+{
+    sdr_dma_lease_t *held = NULL;
+    pthread_mutex_lock(&dev->lock);
+    for (unsigned i = 0; i < dev->lease_max && !held; ++i) {
+        if (!dev->dma_leases[i].buf)
+            held = &dev->dma_leases[i];
+    }
+    if (held && !acquire_exiting(dev)) {
+        held->handle = handle;
+        held->buf    = buf;
+        held->len    = len;
+        held->frames = 1; // until the frames are delivered
+    }
+    else {
+        held = NULL;
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return held;
+}
+
+/// Give the DMA buffers without leased frames back to the driver, with @p wait all once the leases are released.
+static void soapysdr_release_dma(sdr_dev_t *dev, int wait)
+{
+    size_t handles[SDR_LEASE_DMA_MAX];
+    unsigned n = 0;
+    pthread_mutex_lock(&dev->lock);
+    while (wait && dev->leases)
+        pthread_cond_wait(&dev->lease_cond, &dev->lock);
+    for (unsigned i = 0; i < SDR_LEASE_DMA_MAX; ++i) {
+        sdr_dma_lease_t *held = &dev->dma_leases[i];
+        if (held->buf && !held->frames) {
+            handles[n++] = held->handle;
+            held->buf    = NULL;
+        }
+    }
+    pthread_mutex_unlock(&dev->lock);
+    for (unsigned i = 0; i < n; ++i)
+        SoapySDRDevice_releaseReadBuffer(dev->soapy_dev, dev->soapy_stream, handles[i]);
+}
+#endif
+
+/** Read the DMA buffers of the driver directly, saves the copy of readStream().
+
+    The samples are delivered in frames of at most @p buf_elems.
+    With leases the frames that need no conversion are the DMA buffer itself,
+    the DMA buffer goes back to the driver once the frames are released. While
+    too many DMA buffers are held that way, or without leases, each frame is
+    converted into the ring in one pass.
+*/
+static int soapysdr_read_direct(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, size_t buf_elems, int lease)
+{
+    size_t buf_len = buf_elems * dev->sample_size;
+    int exiting    = 0;
+    do {
+        size_t handle       = 0;
+        void const *buffs[] = {NULL};
+        int flags           = 0;
+        long long timeNs    = 0;
+        long timeoutUs      = 1000000; // 1 second
+
+        int r = SoapySDRDevice_acquireReadBuffer(dev->soapy_dev, dev->soapy_stream, &handle, buffs, &flags, &timeNs, timeoutUs);
+        if (r == SOAPY_SDR_OVERFLOW) {
+            fprintf(stderr, "O");
+            fflush(stderr);
+            dev->stream_overflow = 1; // the next time stamp tells how much was lost
+            continue;
+        }
+        if (r < 0) {
+            print_logf(LOG_WARNING, __func__, "direct read failed. %d", r);
+            continue;
+        }
+        long long hwTimeNs = (flags & SOAPY_SDR_HAS_TIME) ? timeNs : 0; // time of the first sample, 0 if not known
+
+        uint8_t const *dma = buffs[0];
+        sdr_dma_lease_t *held = NULL;
+#ifdef THREADS
+        if (lease) {
+            soapysdr_release_dma(dev, 0);
+            held = soapysdr_hold_dma(dev, handle, dma, (size_t)r * dev->sample_size);
+        }
+#endif
+        for (size_t pos = 0; pos < (size_t)r; pos += buf_elems) {
+            size_t n_read = MIN(buf_elems, (size_t)r - pos);
+            if (acquire_exiting(dev)) {
+                exiting = 1;
+                break; // do not deliver any more events
+            }
+
+            void *buffer;
+            if (held) {
+                buffer = (void *)&dma[pos * dev->sample_size]; // the consumer only reads the frame
+            }
+            else {
+                if (dev->buffer_pos + buf_len > dev->buffer_size)
+                    dev->buffer_pos = 0;
+                buffer = &dev->buffer[dev->buffer_pos];
+                dev->buffer_pos += buf_len;
+                soapysdr_convert(dev, &dma[pos * dev->sample_size], buffer, n_read);
+            }
+
+            sdr_event_t ev = {
+                    .ev               = SDR_EV_DATA,
+                    .sample_rate      = param_get(&dev->sample_rate),
+                    .center_frequency = param_get(&dev->center_frequency),
+                    .buf              = buffer,
+                    .len              = (int)(n_read * dev->sample_size),
+            };
+            stream_stamp(dev, &ev, pos ? 0 : hwTimeNs);
+            control_report(dev, cb, ctx);
+#ifdef THREADS
+            if (held) {
+                pthread_mutex_lock(&dev->lock);
+                dev->leases++;
+                held->frames++;
+                pthread_mutex_unlock(&dev->lock);
+                ev.lease = dev;
+            }
+#endif
+            cb(&ev, ctx);
+        }
+#ifdef THREADS
+        if (held) {
+            // the driver keeps filling its other DMA buffers, this one goes back once its frames are released
+            pthread_mutex_lock(&dev->lock);
+            held->frames--;
+            pthread_mutex_unlock(&dev->lock);
+            continue;
+        }
+#endif
+        SoapySDRDevice_releaseReadBuffer(dev->soapy_dev, dev->soapy_stream, handle);
+    } while (!exiting && param_get(&dev->running));
+
+#ifdef THREADS
+    if (lease)
+        soapysdr_release_dma(dev, 1); // before the stream is deactivated
+#endif
+    return 0;
+}
+
 static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
-    size_t buffer_size = (size_t)buf_num * buf_len;
+    size_t buf_elems = buf_len / dev->sample_size;
+    size_t n_chans   = soapysdr_channels(dev);
+    // the DMA buffers are read one channel at a time, several channels use readStream()
+    int direct       = n_chans == 1 && soapysdr_direct_access(dev, buf_elems);
+    int lease        = 0;
+#ifdef THREADS
+    // frames that need no conversion are handed out as they are in the DMA buffer
+    lease = direct && param_get(&dev->lease_buffers) && !dev->stream_cs8 && soapysdr_upscale(dev) == 1;
+#endif
+    print_logf(LOG_DEBUG, __func__, "%s", lease ? "Leasing the DMA buffers" : direct ? "Reading the DMA buffers" : "Reading the stream");
+
+    // a ring slot holds the buffer of each channel, one after the other,
+    // the frames are converted into it while too many DMA buffers are held for leases
+    size_t slot_len    = n_chans * buf_len;
+    size_t buffer_size = (size_t)buf_num * slot_len;
+#ifdef THREADS
+    if (lease)
+        dev->lease_max = MIN(SDR_LEASE_DMA_MAX, MAX(SoapySDRDevice_getNumDirectAccessBuffers(dev->soapy_dev, dev->soapy_stream) / 2, 1));
+#endif
     if (dev->buffer_size != buffer_size) {
         free(dev->buffer);
         dev->buffer = malloc(buffer_size);
@@ -972,29 +1929,37 @@ static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint
         }
         dev->buffer_size = buffer_size;
         dev->buffer_pos = 0;
+        if (dev->lock_buffers)
+            thread_sched_lock_memory(dev->buffer, buffer_size);
     }
 
-    size_t buf_elems = buf_len / dev->sample_size;
-
-    dev->running = 1;
+    // overflows are reported, no need to guess from arrival times
+    stream_reset(dev, UINT64_MAX);
+    param_set(&dev->running, 1);
+    if (direct)
+        return soapysdr_read_direct(dev, cb, ctx, buf_elems, lease);
     do {
-        if (dev->buffer_pos + buf_len > buffer_size)
+        if (dev->buffer_pos + slot_len > buffer_size)
             dev->buffer_pos = 0;
-        int16_t *buffer = (void *)&dev->buffer[dev->buffer_pos];
-        dev->buffer_pos += buf_len;
+        uint8_t *buffer = &dev->buffer[dev->buffer_pos];
+        dev->buffer_pos += slot_len;
 
-        void *buffs[]    = {buffer};
+        void *buffs[SDR_RX_CHANNELS_MAX];
         int flags        = 0;
         long long timeNs = 0;
+        long long hwTimeNs = 0; // time of the first sample, 0 if not known
         long timeoutUs   = 1000000; // 1 second
-        unsigned n_read  = 0, i;
+        unsigned n_read  = 0;
         int r;
 
         do {
-            buffs[0] = &buffer[n_read * 2];
+            for (size_t c = 0; c < n_chans; ++c)
+                buffs[c] = buffer + c * buf_len + n_read * dev->sample_size;
             r  = SoapySDRDevice_readStream(dev->soapy_dev, dev->soapy_stream, buffs, buf_elems - n_read, &flags, &timeNs, timeoutUs);
             if (r < 0)
                 break;
+            if (n_read == 0 && (flags & SOAPY_SDR_HAS_TIME))
+                hwTimeNs = timeNs;
             n_read += r; // r is number of elements read, elements=complex pairs, so buffer length is twice
             //fprintf(stderr, "readStream ret=%d, flags=%d, timeNs=%lld (%zu - %u)\n", r, flags, timeNs, buf_elems, n_read);
         } while (n_read < buf_elems);
@@ -1003,55 +1968,37 @@ static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint
             if (r == SOAPY_SDR_OVERFLOW) {
                 fprintf(stderr, "O");
                 fflush(stderr);
+                dev->stream_overflow = 1; // the next time stamp tells how much was lost
                 continue;
             }
             print_logf(LOG_WARNING, __func__, "sync read failed. %d", r);
         }
 
-        // convert to CS16 or CU8 if needed
-        // if converting CS8 to CU8 -- vectorized with -O3
-        //for (i = 0; i < n_read * 2; ++i)
-        //    cu8buf[i] = (int8_t)cu8buf[i] + 128;
-
-        // TODO: SoapyRemote doesn't scale properly when reading (local) CS16 from (remote) CS8
-        // rescale cs16 buffer
-        if (dev->fullScale >= 2047.0 && dev->fullScale <= 2048.0) {
-            for (i = 0; i < n_read * 2; ++i)
-                buffer[i] *= 16; // prevent left shift of negative value
-        }
-        else if (dev->fullScale < 32767.0) {
-            int upscale = 32768 / dev->fullScale;
-            for (i = 0; i < n_read * 2; ++i)
-                buffer[i] *= upscale;
+        size_t len = n_read * dev->sample_size;
+        for (size_t c = 0; c < n_chans; ++c) {
+            soapysdr_convert(dev, &buffer[c * buf_len], &buffer[c * buf_len], n_read);
+            // close the gap after a short read, the channels follow each other
+            if (c && len < buf_len)
+                memmove(&buffer[c * len], &buffer[c * buf_len], len);
         }
 
-#ifdef THREADS
-        pthread_mutex_lock(&dev->lock);
-#endif
-        uint32_t sample_rate      = dev->sample_rate;
-        uint32_t center_frequency = dev->center_frequency;
-#ifdef THREADS
-        pthread_mutex_unlock(&dev->lock);
-#endif
         sdr_event_t ev = {
                 .ev               = SDR_EV_DATA,
-                .sample_rate      = sample_rate,
-                .center_frequency = center_frequency,
+                .sample_rate      = param_get(&dev->sample_rate),
+                .center_frequency = param_get(&dev->center_frequency),
                 .buf              = buffer,
-                .len              = n_read * dev->sample_size,
+                .len              = (int)len,
+                .rx_channels      = (unsigned)n_chans,
         };
-#ifdef THREADS
-        pthread_mutex_lock(&dev->lock);
-        int exit_acquire = dev->exit_acquire;
-        pthread_mutex_unlock(&dev->lock);
-        if (exit_acquire) {
+        stream_stamp(dev, &ev, hwTimeNs);
+        if (acquire_exiting(dev)) {
             break; // do not deliver any more events
         }
-#endif
+        control_report(dev, cb, ctx);
         if (n_read > 0) // prevent a crash in callback
             cb(&ev, ctx);
 
-    } while (dev->running);
+    } while (param_get(&dev->running));
 
     return 0;
 }
@@ -1103,8 +2050,10 @@ int sdr_close(sdr_dev_t *dev)
 
     int ret = sdr_stop(dev);
 
-    if (dev->rtl_tcp)
+    if (dev->rtl_tcp && dev->rtl_tcp != INVALID_SOCKET)
         ret = rtltcp_close(dev->rtl_tcp);
+    free(dev->rtl_tcp_host);
+    free(dev->rtl_tcp_port);
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
@@ -1118,6 +2067,9 @@ int sdr_close(sdr_dev_t *dev)
 
 #ifdef THREADS
     pthread_mutex_destroy(&dev->lock);
+    pthread_cond_destroy(&dev->lease_cond);
+    pthread_mutex_destroy(&dev->ctl_lock);
+    pthread_cond_destroy(&dev->ctl_cond);
 #endif
 
     free(dev->dev_info);
@@ -1134,6 +2086,24 @@ char const *sdr_get_dev_info(sdr_dev_t *dev)
     return dev->dev_info;
 }
 
+int sdr_get_stats(sdr_dev_t *dev, sdr_stats_t *stats)
+{
+    if (!dev || !dev->rtl_tcp)
+        return -1;
+
+    int64_t since_ns;
+    uint32_t seq;
+    do {
+        seq      = seq_read_begin(&dev->rtl_tcp_stats_seq);
+        *stats   = dev->rtl_tcp_stats;
+        since_ns = dev->rtl_tcp_since_ns;
+    } while (seq_read_retry(&dev->rtl_tcp_stats_seq, seq));
+    int64_t elapsed_ns = rtltcp_now_ns() - since_ns;
+    if (elapsed_ns > 0)
+        stats->rate_kbps = (unsigned)(stats->bytes * 8e6 / elapsed_ns);
+    return 0;
+}
+
 int sdr_get_sample_size(sdr_dev_t *dev)
 {
     if (!dev)
@@ -1190,13 +2160,7 @@ int sdr_set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose)
             print_logf(LOG_NOTICE, "SDR", "Tuned to %s.", nice_freq(sdr_get_center_freq(dev)));
     }
 
-#ifdef THREADS
-    pthread_mutex_lock(&dev->lock);
-#endif
-    dev->center_frequency = freq;
-#ifdef THREADS
-    pthread_mutex_unlock(&dev->lock);
-#endif
+    param_set(&dev->center_frequency, freq);
 
     return r;
 }
@@ -1222,6 +2186,73 @@ uint32_t sdr_get_center_freq(sdr_dev_t *dev)
     return 0;
 }
 
+int sdr_set_rx_channels(sdr_dev_t *dev, unsigned num, int verbose)
+{
+    if (!dev)
+        return -1;
+
+    if (num <= 1)
+        return 0;
+    if (num > SDR_RX_CHANNELS_MAX) {
+        print_logf(LOG_ERROR, __func__, "At most %d RX channels are supported.", SDR_RX_CHANNELS_MAX);
+        return -1;
+    }
+
+#ifdef SOAPYSDR
+    if (dev->soapy_dev) {
+        size_t avail = SoapySDRDevice_getNumChannels(dev->soapy_dev, SOAPY_SDR_RX);
+        if (num > avail) {
+            print_logf(LOG_ERROR, __func__, "The device has %u RX channels, %u requested.", (unsigned)avail, num);
+            return -1;
+        }
+        // the stream is set up again on the channels, before it is activated
+        SoapySDRDevice_closeStream(dev->soapy_dev, dev->soapy_stream);
+        dev->soapy_stream = NULL;
+        if (soapysdr_setup_stream(dev, num) != 0) {
+            print_logf(LOG_ERROR, __func__, "Failed to setup a stream of %u RX channels.", num);
+            return -1;
+        }
+        dev->rx_channels = num;
+        if (verbose)
+            print_logf(LOG_NOTICE, "SDR", "Streaming %u RX channels.", num);
+        return 0;
+    }
+#endif
+
+    POSSIBLY_UNUSED(verbose);
+    print_log(LOG_ERROR, __func__, "Several RX channels are only available for SoapySDR devices");
+    return -1;
+}
+
+int sdr_set_channel_freq(sdr_dev_t *dev, unsigned channel, uint32_t freq, int verbose)
+{
+    if (!dev)
+        return -1;
+
+    // the first channel is the center frequency of the events
+    if (channel == 0)
+        return sdr_set_center_freq(dev, freq, verbose);
+
+    int r = -1;
+
+#ifdef SOAPYSDR
+    SoapySDRKwargs args = {0};
+    if (dev->soapy_dev && channel < dev->rx_channels) {
+        r = SoapySDRDevice_setFrequency(dev->soapy_dev, SOAPY_SDR_RX, channel, (double)freq, &args);
+        if (verbose) {
+            if (r < 0)
+                print_logf(LOG_WARNING, __func__, "Failed to set the freq of RX channel %u.", channel);
+            else
+                print_logf(LOG_NOTICE, "SDR", "RX channel %u tuned to %s.", channel,
+                        nice_freq(SoapySDRDevice_getFrequency(dev->soapy_dev, SOAPY_SDR_RX, channel)));
+        }
+    }
+#endif
+
+    POSSIBLY_UNUSED(verbose);
+    return r;
+}
+
 int sdr_set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
 {
     if (!dev)
@@ -1240,8 +2271,10 @@ int sdr_set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
         r = rtltcp_command(dev, RTLTCP_SET_FREQ_CORRECTION, ppm);
 
 #ifdef SOAPYSDR
-    if (dev->soapy_dev)
-        r = SoapySDRDevice_setFrequencyComponent(dev->soapy_dev, SOAPY_SDR_RX, 0, "CORR", (double)ppm, NULL);
+    if (dev->soapy_dev) {
+        for (size_t c = 0; c < soapysdr_channels(dev); ++c)
+            r = SoapySDRDevice_setFrequencyComponent(dev->soapy_dev, SOAPY_SDR_RX, c, "CORR", (double)ppm, NULL);
+    }
 #endif
 
 #ifdef RTLSDR
@@ -1279,8 +2312,10 @@ int sdr_set_auto_gain(sdr_dev_t *dev, int verbose)
         r = rtltcp_command(dev, RTLTCP_SET_GAIN_MODE, 0);
 
 #ifdef SOAPYSDR
-    if (dev->soapy_dev)
-        r = soapysdr_auto_gain(dev->soapy_dev, verbose);
+    if (dev->soapy_dev) {
+        for (size_t c = 0; c < soapysdr_channels(dev); ++c)
+            r = soapysdr_auto_gain(dev->soapy_dev, c, verbose && !c);
+    }
 #endif
 
 #ifdef RTLSDR
@@ -1318,8 +2353,11 @@ int sdr_set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose)
 
 #ifdef SOAPYSDR
     /* Enable manual gain */
-    if (dev->soapy_dev)
-        return soapysdr_gain_str_set(dev->soapy_dev, gain_str, verbose);
+    if (dev->soapy_dev) {
+        for (size_t c = 0; c < soapysdr_channels(dev); ++c)
+            r = soapysdr_gain_str_set(dev->soapy_dev, c, gain_str, verbose && !c);
+        return r;
+    }
 #endif
 
     int gain = (int)(atof(gain_str) * 10); /* tenths of a dB */
@@ -1423,8 +2461,10 @@ int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
     }
 
 #ifdef SOAPYSDR
-    if (dev->soapy_dev)
-        r = SoapySDRDevice_setSampleRate(dev->soapy_dev, SOAPY_SDR_RX, 0, (double)rate);
+    if (dev->soapy_dev) {
+        for (size_t c = 0; c < soapysdr_channels(dev); ++c)
+            r = SoapySDRDevice_setSampleRate(dev->soapy_dev, SOAPY_SDR_RX, c, (double)rate);
+    }
 #endif
 
 #ifdef RTLSDR
@@ -1439,13 +2479,7 @@ int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
             print_logf(LOG_NOTICE, "SDR", "Sample rate set to %u S/s.", sdr_get_sample_rate(dev)); // Unfortunately, doesn't return real rate
     }
 
-#ifdef THREADS
-    pthread_mutex_lock(&dev->lock);
-#endif
-    dev->sample_rate = rate;
-#ifdef THREADS
-    pthread_mutex_unlock(&dev->lock);
-#endif
+    param_set(&dev->sample_rate, rate);
 
     return r;
 }
@@ -1642,6 +2676,53 @@ int sdr_reset(sdr_dev_t *dev, int verbose)
     return r;
 }
 
+/// Apply control commands, the sample rate first and the gain last, returns the SDR_CTL_FLAGS applied.
+static unsigned control_apply(sdr_dev_t *dev, sdr_event_t const *cmd, unsigned verbose)
+{
+    unsigned applied = 0;
+    if ((cmd->ev & SDR_EV_RATE) && sdr_set_sample_rate(dev, cmd->sample_rate, (verbose & SDR_EV_RATE) != 0) >= 0)
+        applied |= SDR_EV_RATE;
+    if ((cmd->ev & SDR_EV_CORR) && sdr_set_freq_correction(dev, cmd->freq_correction, (verbose & SDR_EV_CORR) != 0) >= 0)
+        applied |= SDR_EV_CORR;
+    if ((cmd->ev & SDR_EV_FREQ) && sdr_set_center_freq(dev, cmd->center_frequency, (verbose & SDR_EV_FREQ) != 0) >= 0)
+        applied |= SDR_EV_FREQ;
+    if ((cmd->ev & SDR_EV_GAIN) && sdr_set_tuner_gain(dev, cmd->gain_str, (verbose & SDR_EV_GAIN) != 0) >= 0)
+        applied |= SDR_EV_GAIN;
+    return applied;
+}
+
+int sdr_control(sdr_dev_t *dev, sdr_event_t const *cmd, int verbose, int report)
+{
+    if (!dev)
+        return -1;
+
+    unsigned flags = cmd->ev & SDR_CTL_FLAGS;
+#ifdef THREADS
+    if (param_get(&dev->ctl_running)) {
+        pthread_mutex_lock(&dev->ctl_lock);
+        // a newer command replaces a queued one of the same kind
+        if (flags & SDR_EV_RATE)
+            dev->ctl_cmd.sample_rate = cmd->sample_rate;
+        if (flags & SDR_EV_CORR)
+            dev->ctl_cmd.freq_correction = cmd->freq_correction;
+        if (flags & SDR_EV_FREQ)
+            dev->ctl_cmd.center_frequency = cmd->center_frequency;
+        if (flags & SDR_EV_GAIN)
+            snprintf(dev->ctl_gain, sizeof(dev->ctl_gain), "%s", cmd->gain_str ? cmd->gain_str : "");
+        dev->ctl_pending |= flags;
+        dev->ctl_verbose = verbose ? dev->ctl_verbose | flags : dev->ctl_verbose & ~flags;
+        dev->ctl_report  = report ? dev->ctl_report | flags : dev->ctl_report & ~flags;
+        pthread_cond_signal(&dev->ctl_cond);
+        pthread_mutex_unlock(&dev->ctl_lock);
+        return 0;
+    }
+#else
+    UNUSED(report);
+#endif
+    // nothing streams, apply right away
+    return control_apply(dev, cmd, verbose ? flags : 0) == flags ? 0 : -1;
+}
+
 int sdr_start_sync(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
     if (!dev)
@@ -1674,20 +2755,20 @@ int sdr_stop_sync(sdr_dev_t *dev)
         return -1;
 
     if (dev->rtl_tcp) {
-        dev->running = 0;
+        param_set(&dev->running, 0);
         return 0;
     }
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev) {
-        dev->running = 0;
+        param_set(&dev->running, 0);
         return 0;
     }
 #endif
 
 #ifdef RTLSDR
     if (dev->rtlsdr_dev) {
-        dev->running = 0;
+        param_set(&dev->running, 0);
         return rtlsdr_cancel_async(dev->rtlsdr_dev);
     }
 #endif
@@ -1713,10 +2794,88 @@ void sdr_redirect_logging(void)
 /* threading */
 
 #ifdef THREADS
+void sdr_lease_buffers(sdr_dev_t *dev, int enable)
+{
+    if (!dev)
+        return;
+
+    param_set(&dev->lease_buffers, enable != 0);
+}
+
+void sdr_release(sdr_event_t *ev)
+{
+    sdr_dev_t *dev = ev->lease;
+    if (!dev)
+        return;
+
+    ev->lease = NULL;
+    pthread_mutex_lock(&dev->lock);
+#ifdef SOAPYSDR
+    uint8_t const *buf = ev->buf;
+    for (unsigned i = 0; i < SDR_LEASE_DMA_MAX; ++i) {
+        sdr_dma_lease_t *held = &dev->dma_leases[i];
+        if (held->buf && buf >= held->buf && buf < held->buf + held->len) {
+            held->frames--; // the acquire thread gives the DMA buffer back
+            break;
+        }
+    }
+#endif
+    if (dev->leases && !--dev->leases)
+        pthread_cond_broadcast(&dev->lease_cond);
+    pthread_mutex_unlock(&dev->lock);
+}
+
+static THREAD_RETURN THREAD_CALL control_thread(void *arg)
+{
+    sdr_dev_t *dev = arg;
+    print_log(LOG_DEBUG, __func__, "control_thread enter...");
+    trace_thread_name("sdr_control");
+
+    pthread_mutex_lock(&dev->ctl_lock);
+    for (;;) {
+        while (!dev->ctl_pending && !dev->ctl_exit)
+            pthread_cond_wait(&dev->ctl_cond, &dev->ctl_lock);
+        if (!dev->ctl_pending)
+            break; // nothing left to apply
+
+        sdr_event_t cmd = dev->ctl_cmd;
+        char gain[GAIN_STR_MAX_SIZE];
+        memcpy(gain, dev->ctl_gain, sizeof(gain));
+        cmd.ev           = (sdr_event_flags_t)dev->ctl_pending;
+        cmd.gain_str     = *gain ? gain : NULL;
+        unsigned verbose = dev->ctl_verbose;
+        unsigned report  = dev->ctl_report;
+        dev->ctl_pending = 0;
+        dev->ctl_verbose = 0;
+        dev->ctl_report  = 0;
+        pthread_mutex_unlock(&dev->ctl_lock);
+
+        // the transfers or round trips take a while, the queue stays open meanwhile
+        unsigned applied = control_apply(dev, &cmd, verbose) & report;
+
+        pthread_mutex_lock(&dev->ctl_lock);
+        if (applied & SDR_EV_RATE)
+            dev->ctl_applied.sample_rate = param_get(&dev->sample_rate);
+        if (applied & SDR_EV_CORR)
+            dev->ctl_applied.freq_correction = cmd.freq_correction;
+        if (applied & SDR_EV_FREQ)
+            dev->ctl_applied.center_frequency = param_get(&dev->center_frequency);
+        if (applied & SDR_EV_GAIN)
+            snprintf(dev->ctl_applied_gain, sizeof(dev->ctl_applied_gain), "%s", *gain ? gain : "auto");
+        if (applied)
+            param_set(&dev->ctl_events, param_get(&dev->ctl_events) | applied);
+    }
+    pthread_mutex_unlock(&dev->ctl_lock);
+
+    print_log(LOG_DEBUG, __func__, "control_thread done...");
+    return (THREAD_RETURN)0;
+}
+
 static THREAD_RETURN THREAD_CALL acquire_thread(void *arg)
 {
     sdr_dev_t *dev = arg;
     print_log(LOG_DEBUG, __func__, "acquire_thread enter...");
+    trace_thread_name("sdr");
 
     int r = sdr_start_sync(dev, dev->async_cb, dev->async_ctx, dev->buf_num, dev->buf_len);
     // if (cfg->verbosity > 1)
@@ -1758,10 +2917,36 @@ int sdr_start(sdr_dev_t *dev, sdr_event_cb_t async_cb, void *async_ctx, uint32_t
 #endif
     if (r) {
         fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        return r;
     }
+    thread_sched_apply(dev->thread, &dev->sched, "acquire");
+
+    // the control commands are applied off the caller's thread while the input streams
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    dev->ctl_exit = 0;
+    int rc = pthread_create(&dev->ctl_thread, NULL, control_thread, dev);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (rc)
+        print_logf(LOG_WARNING, "SDR", "No control thread (%d), applying the control commands right away", rc);
+    else
+        param_set(&dev->ctl_running, 1);
     return r;
 }
 
+void sdr_set_sched(sdr_dev_t *dev, thread_sched_t const *sched, int lock_buffers)
+{
+    if (!dev)
+        return;
+
+    if (sched)
+        dev->sched = *sched;
+    dev->lock_buffers = lock_buffers;
+}
+
 int sdr_stop(sdr_dev_t *dev)
 {
     if (!dev)
@@ -1779,7 +2964,10 @@ int sdr_stop(sdr_dev_t *dev)
         print_log(LOG_DEBUG, __func__, "Already exiting.");
         return 0;
     }
-    dev->exit_acquire = 1; // for rtl_tcp and SoapySDR
+    param_set(&dev->exit_acquire, 1); // for rtl_tcp and SoapySDR
+    // no more leases now, librtlsdr frees the leased USB buffers once cancelled
+    while (dev->leases)
+        pthread_cond_wait(&dev->lease_cond, &dev->lock);
     sdr_stop_sync(dev); // for rtlsdr
     pthread_mutex_unlock(&dev->lock);
 
@@ -1789,10 +2977,37 @@ int sdr_stop(sdr_dev_t *dev)
         fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
     }
 
+    if (param_get(&dev->ctl_running)) {
+        pthread_mutex_lock(&dev->ctl_lock);
+        dev->ctl_exit = 1;
+        pthread_cond_signal(&dev->ctl_cond);
+        pthread_mutex_unlock(&dev->ctl_lock);
+        pthread_join(dev->ctl_thread, NULL);
+        param_set(&dev->ctl_running, 0);
+    }
+
     print_log(LOG_DEBUG, __func__, "EXITED.");
     return r;
 }
 #else
+void sdr_lease_buffers(sdr_dev_t *dev, int enable)
+{
+    UNUSED(dev);
+    UNUSED(enable);
+}
+
+void sdr_release(sdr_event_t *ev)
+{
+    ev->lease = NULL;
+}
+
+void sdr_set_sched(sdr_dev_t *dev, thread_sched_t const *sched, int lock_buffers)
+{
+    UNUSED(sched);
+    if (dev)
+        dev->lock_buffers = lock_buffers;
+}
+
 int sdr_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
     UNUSED(dev);
@@ -0,0 +1,398 @@
+/** @file
+    Table of the last event of each sensor, with LRU eviction.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "sensor_table.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int sensor_table_init(sensor_table_t *table, unsigned capacity)
+{
+    *table = (sensor_table_t){0};
+    if (capacity < 1)
+        capacity = 1;
+
+    // at least twice the buckets for short chains
+    unsigned buckets = 2;
+    while (buckets < 2 * capacity)
+        buckets *= 2;
+
+    table->entries = calloc(capacity, sizeof(*table->entries));
+    if (!table->entries) {
+        WARN_CALLOC("sensor_table_init()");
+        return -1;
+    }
+    table->buckets = calloc(buckets, sizeof(*table->buckets));
+    if (!table->buckets) {
+        WARN_CALLOC("sensor_table_init()");
+        free(table->entries);
+        table->entries = NULL;
+        return -1;
+    }
+    table->capacity = capacity;
+    table->mask     = buckets - 1;
+    return 0;
+}
+
+void sensor_table_free(sensor_table_t *table)
+{
+    for (unsigned i = 0; i < table->len; ++i)
+        data_free(table->entries[i].data);
+    free(table->entries);
+    free(table->buckets);
+    *table = (sensor_table_t){0};
+}
+
+sensor_entry_t const *sensor_table_find(sensor_table_t const *table, uint32_t key)
+{
+    if (!key || !table->capacity)
+        return NULL;
+    for (unsigned i = table->buckets[key & table->mask]; i; i = table->entries[i - 1].hash_next) {
+        if (table->entries[i - 1].key == key)
+            return &table->entries[i - 1];
+    }
+    return NULL;
+}
+
+static void lru_unlink(sensor_table_t *table, unsigned idx)
+{
+    sensor_entry_t *e = &table->entries[idx - 1];
+    if (e->lru_prev)
+        table->entries[e->lru_prev - 1].lru_next = e->lru_next;
+    else
+        table->lru_first = e->lru_next;
+    if (e->lru_next)
+        table->entries[e->lru_next - 1].lru_prev = e->lru_prev;
+    else
+        table->lru_last = e->lru_prev;
+    e->lru_prev = 0;
+    e->lru_next = 0;
+}
+
+static void lru_push(sensor_table_t *table, unsigned idx)
+{
+    sensor_entry_t *e = &table->entries[idx - 1];
+    e->lru_prev       = 0;
+    e->lru_next       = table->lru_first;
+    if (table->lru_first)
+        table->entries[table->lru_first - 1].lru_prev = idx;
+    else
+        table->lru_last = idx;
+    table->lru_first = idx;
+}
+
+static void bucket_unlink(sensor_table_t *table, unsigned idx)
+{
+    sensor_entry_t *e = &table->entries[idx - 1];
+    unsigned *p       = &table->buckets[e->key & table->mask];
+    while (*p != idx)
+        p = &table->entries[*p - 1].hash_next;
+    *p           = e->hash_next;
+    e->hash_next = 0;
+}
+
+sensor_entry_t const *sensor_table_update(sensor_table_t *table, data_t *data, double now, data_t **evicted)
+{
+    if (evicted)
+        *evicted = NULL;
+    uint32_t key = data_sensor_key(data);
+    if (!key || !table->capacity)
+        return NULL;
+
+    sensor_entry_t *e = (sensor_entry_t *)sensor_table_find(table, key);
+    unsigned idx;
+    if (e) {
+        idx = (unsigned)(e - table->entries) + 1;
+        lru_unlink(table, idx);
+        data_free(e->data);
+    }
+    else {
+        if (table->len < table->capacity) {
+            idx = ++table->len;
+        }
+        else {
+            // take the entry of the sensor heard least recently
+            idx = table->lru_last;
+            lru_unlink(table, idx);
+            bucket_unlink(table, idx);
+            if (evicted)
+                *evicted = table->entries[idx - 1].data;
+            else
+                data_free(table->entries[idx - 1].data);
+            table->evicted++;
+        }
+        e  = &table->entries[idx - 1];
+        *e = (sensor_entry_t){0};
+        e->key        = key;
+        e->first_seen = now;
+        e->hash_next  = table->buckets[key & table->mask];
+        table->buckets[key & table->mask] = idx;
+    }
+    lru_push(table, idx);
+
+    e->data      = data_retain(data);
+    e->last_seen = now;
+    e->count++;
+    e->has_rssi = 0;
+    for (data_t *d = data; d; d = d->next) {
+        if (d->key_id != DATA_KEY_RSSI)
+            continue;
+        e->has_rssi = d->type == DATA_DOUBLE || d->type == DATA_INT;
+        e->rssi     = d->type == DATA_DOUBLE ? d->value.v_dbl : d->value.v_int;
+        break;
+    }
+    table->updates++;
+    return e;
+}
+
+data_t *sensor_entry_data(sensor_entry_t const *entry)
+{
+    /* clang-format off */
+    data_t *data = data_make(
+            "last_seen",    "", DATA_INT,    (int)entry->last_seen,
+            "first_seen",   "", DATA_INT,    (int)entry->first_seen,
+            "count",        "", DATA_INT,    (int)entry->count,
+            NULL);
+    /* clang-format on */
+    if (entry->has_rssi)
+        data = data_dbl(data, "rssi", "", NULL, entry->rssi);
+    return data_dat(data, "event", "", NULL, data_retain(entry->data));
+}
+
+/// Returns the field of @p data with the key of @p field, NULL if none.
+static data_t const *field_find(data_t const *data, data_t const *field)
+{
+    for (; data; data = data->next) {
+        if (!strcmp(data->key, field->key))
+            return data;
+    }
+    return NULL;
+}
+
+/// Returns 1 if two scalar fields print the same.
+static int field_equals(data_t const *a, data_t const *b)
+{
+    if (a->type != b->type)
+        return 0;
+    if ((a->format || b->format) && (!a->format || !b->format || strcmp(a->format, b->format)))
+        return 0;
+    switch (a->type) {
+    case DATA_INT:
+        return a->value.v_int == b->value.v_int;
+    case DATA_DOUBLE:
+        return a->value.v_dbl == b->value.v_dbl;
+    case DATA_STRING:
+        return !strcmp(a->value.v_ptr, b->value.v_ptr);
+    default:
+        return 0;
+    }
+}
+
+/// The sensor key and the time are in each delta.
+static int is_delta_key(data_t const *d)
+{
+    switch (d->key_id) {
+    case DATA_KEY_MODEL:
+    case DATA_KEY_ID:
+    case DATA_KEY_CHANNEL:
+    case DATA_KEY_TIME:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+data_t *sensor_entry_delta(sensor_entry_t const *entry, data_t const *data, data_skip_t const *skip)
+{
+    if (!entry || !entry->data)
+        return NULL;
+    // a field gone since the last event only shows in the whole event
+    for (data_t const *d = entry->data; d; d = d->next) {
+        if (!data_skip(skip, d) && !field_find(data, d))
+            return NULL;
+    }
+
+    data_t *delta = NULL;
+    for (data_t const *d = data; d; d = d->next) {
+        if (data_skip(skip, d))
+            continue;
+        if (d->type != DATA_INT && d->type != DATA_DOUBLE && d->type != DATA_STRING) {
+            data_free(delta);
+            return NULL;
+        }
+        data_t const *last = field_find(entry->data, d);
+        if (!is_delta_key(d) && last && field_equals(d, last))
+            continue;
+        if (d->type == DATA_INT)
+            delta = data_int(delta, d->key, d->pretty_key, d->format, d->value.v_int);
+        else if (d->type == DATA_DOUBLE)
+            delta = data_dbl(delta, d->key, d->pretty_key, d->format, d->value.v_dbl);
+        else
+            delta = data_str(delta, d->key, d->pretty_key, d->format, d->value.v_ptr);
+        if (!delta)
+            return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    return data_int(delta, "delta", "", NULL, 1);
+}
+
+data_t *sensor_table_page(sensor_table_t const *table, unsigned cursor, unsigned limit)
+{
+    if (limit > SENSOR_TABLE_PAGE_MAX)
+        limit = SENSOR_TABLE_PAGE_MAX;
+    data_t **page = calloc(limit ? limit : 1, sizeof(*page));
+    if (!page) {
+        WARN_CALLOC("sensor_table_page()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    // the pool is filled from the start, unused entries only follow the used
+    unsigned num = 0;
+    unsigned i   = cursor;
+    for (; i < table->len && num < limit; ++i)
+        page[num++] = sensor_entry_data(&table->entries[i]);
+
+    /* clang-format off */
+    data_t *data = data_make(
+            "total",        "", DATA_INT,   (int)table->len,
+            "count",        "", DATA_INT,   (int)num,
+            "sensors",      "", DATA_ARRAY, data_array(num, DATA_DATA, page),
+            NULL);
+    /* clang-format on */
+    if (i < table->len)
+        data = data_int(data, "next", "", NULL, (int)i);
+    free(page);
+    return data;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+static data_t *test_event(int id, double rssi)
+{
+    /* clang-format off */
+    return data_make(
+            "model",        "", DATA_STRING, "Test-Sensor",
+            "id",           "", DATA_INT,    id,
+            "rssi",         "", DATA_DOUBLE, rssi,
+            NULL);
+    /* clang-format on */
+}
+
+static int page_int(data_t *page, char const *key)
+{
+    for (data_t *d = page; d; d = d->next)
+        if (!strcmp(d->key, key))
+            return d->value.v_int;
+    return -1;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    sensor_table_t table;
+    data_t *evicted;
+
+    fprintf(stderr, "sensor_table:: update and find\n");
+    ASSERT_EQUALS(sensor_table_init(&table, 3), 0);
+    for (int id = 1; id <= 3; ++id) {
+        data_t *data = test_event(id, -10.0 * id);
+        sensor_table_update(&table, data, id, &evicted);
+        data_free(data);
+        ASSERT_EQUALS(evicted == NULL, 1);
+    }
+    data_t *data = test_event(2, -5.0);
+    sensor_entry_t const *e = sensor_table_update(&table, data, 4, NULL);
+    data_free(data);
+    ASSERT_EQUALS(e == sensor_table_find(&table, e->key), 1);
+    ASSERT_EQUALS(e->count, 2);
+    ASSERT_EQUALS(e->first_seen, 2);
+    ASSERT_EQUALS(e->last_seen, 4);
+    ASSERT_EQUALS(e->rssi, -5);
+    ASSERT_EQUALS(table.len, 3);
+
+    fprintf(stderr, "sensor_table:: records without a model are not kept\n");
+    data = data_make("count", "", DATA_INT, 1, NULL);
+    ASSERT_EQUALS(sensor_table_update(&table, data, 5, NULL) == NULL, 1);
+    data_free(data);
+
+    fprintf(stderr, "sensor_table:: evict the sensor heard least recently\n");
+    data_t *first = test_event(1, 0.0);
+    uint32_t key1   = data_sensor_key(first);
+    data = test_event(4, 0.0);
+    uint32_t key4 = data_sensor_key(data);
+    sensor_table_update(&table, data, 6, &evicted);
+    data_free(data);
+    ASSERT_EQUALS(evicted != NULL, 1);
+    ASSERT_EQUALS(data_sensor_key(evicted), key1);
+    data_free(evicted);
+    ASSERT_EQUALS(sensor_table_find(&table, key1) == NULL, 1);
+    ASSERT_EQUALS(sensor_table_find(&table, key4) != NULL, 1);
+    ASSERT_EQUALS(table.evicted, 1);
+    ASSERT_EQUALS(table.len, 3);
+    sensor_table_update(&table, first, 7, &evicted); // sensor 3 now is the oldest
+    data_free(first);
+    ASSERT_EQUALS(page_int(evicted, "id"), 3);
+    data_free(evicted);
+
+    fprintf(stderr, "sensor_table:: pages\n");
+    data_t *page = sensor_table_page(&table, 0, 2);
+    ASSERT_EQUALS(page_int(page, "total"), 3);
+    ASSERT_EQUALS(page_int(page, "count"), 2);
+    int next = page_int(page, "next");
+    data_free(page);
+    ASSERT_EQUALS(next, 2);
+    page = sensor_table_page(&table, (unsigned)next, 2);
+    ASSERT_EQUALS(page_int(page, "count"), 1);
+    ASSERT_EQUALS(page_int(page, "next"), -1);
+    char buf[1024];
+    data_print_jsons(page, buf, sizeof(buf));
+    ASSERT_EQUALS(strstr(buf, "\"event\":{\"model\":\"Test-Sensor\",\"id\":1,") != NULL, 1);
+    data_free(page);
+
+    fprintf(stderr, "sensor_table:: deltas\n");
+    e    = sensor_table_find(&table, key1);
+    data = test_event(1, -3.0);
+    data = data_str(data, "battery", "", NULL, "OK");
+    data_t *delta = sensor_entry_delta(e, data, NULL);
+    data_print_jsons(delta, buf, sizeof(buf));
+    ASSERT_EQUALS(strcmp(buf, "{\"model\":\"Test-Sensor\",\"id\":1,\"rssi\":-3,\"battery\":\"OK\",\"delta\":1}"), 0);
+    data_free(delta);
+    sensor_table_update(&table, data, 8, NULL);
+    data_free(data);
+    data = test_event(1, -3.0);
+    ASSERT_EQUALS(sensor_entry_delta(e, data, NULL) == NULL, 1); // the battery is gone
+    data = data_str(data, "battery", "", NULL, "OK");
+    delta = sensor_entry_delta(e, data, NULL);
+    data_print_jsons(delta, buf, sizeof(buf));
+    ASSERT_EQUALS(strcmp(buf, "{\"model\":\"Test-Sensor\",\"id\":1,\"delta\":1}"), 0);
+    data_free(delta);
+    data = data_dat(data, "nested", "", NULL, data_make("a", "", DATA_INT, 1, NULL));
+    ASSERT_EQUALS(sensor_entry_delta(e, data, NULL) == NULL, 1);
+    data_free(data);
+
+    sensor_table_free(&table);
+    fprintf(stderr, "sensor_table:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,416 @@
+/** @file
+    Ring of records in POSIX shared memory, one writer and any number of readers.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "shm_ring.h"
+#include "compat_atomic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_RING_SIZE_MIN 4096
+#define SHM_RING_SIZE_MAX (1u << 30)
+#define RECORD_HEADER_LEN 16
+
+/// The header of each record in the data area.
+typedef struct record_header {
+    uint64_t seq;
+    uint32_t len;
+    uint32_t pad;
+} record_header_t;
+
+/// The object name with a leading "/", NULL on alloc failure.
+static char *object_name(char const *name)
+{
+    size_t len = strlen(name);
+    char *path = malloc(len + 2);
+    if (!path) {
+        fprintf(stderr, "shm_ring: malloc() failed\n");
+        return NULL;
+    }
+    path[0] = '/';
+    memcpy(name[0] == '/' ? path : path + 1, name, len + 1);
+    return path;
+}
+
+static void copy_in(uint8_t *data, uint64_t mask, uint64_t pos, void const *src, size_t len)
+{
+    size_t off   = (size_t)(pos & mask);
+    size_t first = len < mask + 1 - off ? len : (size_t)(mask + 1 - off);
+    memcpy(data + off, src, first);
+    memcpy(data, (uint8_t const *)src + first, len - first);
+}
+
+static void copy_out(void *dst, uint8_t const *data, uint64_t mask, uint64_t pos, size_t len)
+{
+    size_t off   = (size_t)(pos & mask);
+    size_t first = len < mask + 1 - off ? len : (size_t)(mask + 1 - off);
+    memcpy(dst, data + off, first);
+    memcpy((uint8_t *)dst + first, data, len - first);
+}
+
+/* Writer */
+
+struct shm_ring_writer {
+    shm_ring_header_t *header;
+    uint8_t *data;
+    size_t map_len;
+    uint64_t mask;
+    uint64_t pos;
+    uint64_t seq;
+    char *name;
+};
+
+/// Mark the ring of a previous writer closed, its readers would wait forever otherwise.
+static void close_stale_ring(char const *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(shm_ring_header_t)) {
+        shm_ring_header_t *header = mmap(NULL, sizeof(*header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (header != MAP_FAILED) {
+            atomic_set(&header->closed, 1);
+            munmap(header, sizeof(*header));
+        }
+    }
+    close(fd);
+}
+
+shm_ring_writer_t *shm_ring_writer_create(char const *name, size_t size, int format)
+{
+    uint64_t ring_size = SHM_RING_SIZE_MIN;
+    while (ring_size < size && ring_size < SHM_RING_SIZE_MAX)
+        ring_size <<= 1;
+
+    shm_ring_writer_t *writer = calloc(1, sizeof(*writer));
+    if (!writer) {
+        fprintf(stderr, "shm_ring: calloc() failed\n");
+        return NULL;
+    }
+    writer->name = object_name(name);
+    if (!writer->name) {
+        free(writer);
+        return NULL;
+    }
+
+    close_stale_ring(writer->name);
+    shm_unlink(writer->name);
+    int fd = shm_open(writer->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        free(writer->name);
+        free(writer);
+        return NULL;
+    }
+    writer->map_len = sizeof(shm_ring_header_t) + (size_t)ring_size;
+    void *map = MAP_FAILED;
+    if (!ftruncate(fd, (off_t)writer->map_len))
+        map = mmap(NULL, writer->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("shm_ring");
+        shm_unlink(writer->name);
+        free(writer->name);
+        free(writer);
+        return NULL;
+    }
+
+    writer->header = map;
+    writer->data   = (uint8_t *)map + sizeof(shm_ring_header_t);
+    writer->mask   = ring_size - 1;
+
+    shm_ring_header_t *header = writer->header;
+    header->version     = SHM_RING_VERSION;
+    header->format      = (uint32_t)format;
+    header->header_size = sizeof(shm_ring_header_t);
+    header->size        = ring_size;
+    // the readers check the magic first, the other fields are set before
+    atomic_set(&header->magic, SHM_RING_MAGIC);
+    return writer;
+}
+
+uint64_t shm_ring_write(shm_ring_writer_t *writer, void const *buf, size_t len)
+{
+    if (len > (writer->mask + 1) / 4)
+        return 0;
+
+    uint64_t total = RECORD_HEADER_LEN + ((len + 7) & ~(uint64_t)7);
+    record_header_t rec = {.seq = writer->seq + 1, .len = (uint32_t)len};
+
+    // announce the bytes about to be overwritten before touching them
+    atomic_set_relaxed(&writer->header->reserve, writer->pos + total);
+    atomic_fence_release();
+    copy_in(writer->data, writer->mask, writer->pos, &rec, sizeof(rec));
+    copy_in(writer->data, writer->mask, writer->pos + RECORD_HEADER_LEN, buf, len);
+
+    writer->pos += total;
+    writer->seq = rec.seq;
+    atomic_set_relaxed(&writer->header->seq, writer->seq);
+    atomic_set(&writer->header->head, writer->pos);
+    return writer->seq;
+}
+
+void shm_ring_writer_free(shm_ring_writer_t *writer)
+{
+    if (!writer)
+        return;
+    atomic_set(&writer->header->closed, 1);
+    munmap(writer->header, writer->map_len);
+    shm_unlink(writer->name);
+    free(writer->name);
+    free(writer);
+}
+
+/* Reader */
+
+struct shm_ring_reader {
+    shm_ring_header_t const *header;
+    uint8_t const *data;
+    size_t map_len;
+    uint64_t mask;
+    uint64_t pos;  ///< position of the next record
+    uint64_t seq;  ///< sequence number of the last record read, 0 if none
+    uint64_t lost;
+};
+
+shm_ring_reader_t *shm_ring_reader_open(char const *name)
+{
+    char *path = object_name(name);
+    if (!path)
+        return NULL;
+    int fd = shm_open(path, O_RDONLY, 0);
+    free(path);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (!fstat(fd, &st) && (size_t)st.st_size > sizeof(shm_ring_header_t))
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    shm_ring_header_t const *header = map;
+    uint32_t magic = atomic_get(&header->magic);
+    uint64_t size  = header->size;
+    if (magic != SHM_RING_MAGIC
+            || header->version != SHM_RING_VERSION
+            || size < SHM_RING_SIZE_MIN || (size & (size - 1))
+            || header->header_size + size > (uint64_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    shm_ring_reader_t *reader = calloc(1, sizeof(*reader));
+    if (!reader) {
+        fprintf(stderr, "shm_ring: calloc() failed\n");
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    reader->header  = header;
+    reader->data    = (uint8_t const *)map + header->header_size;
+    reader->map_len = (size_t)st.st_size;
+    reader->mask    = size - 1;
+    reader->pos     = atomic_get(&header->head);
+    return reader;
+}
+
+long shm_ring_read(shm_ring_reader_t *reader, void *buf, size_t size, uint64_t *seq)
+{
+    shm_ring_header_t const *header = reader->header;
+    uint64_t ring_size = reader->mask + 1;
+
+    uint64_t head = atomic_get(&header->head);
+    if (head == reader->pos)
+        return atomic_get(&header->closed) ? SHM_RING_CLOSED : SHM_RING_EMPTY;
+
+    record_header_t rec = {0};
+    int valid = head - reader->pos <= ring_size;
+    if (valid) {
+        copy_out(&rec, reader->data, reader->mask, reader->pos, sizeof(rec));
+        valid = rec.len <= ring_size / 4;
+    }
+    if (valid && rec.len <= size)
+        copy_out(buf, reader->data, reader->mask, reader->pos + RECORD_HEADER_LEN, rec.len);
+    // the copy is only good if the writer did not reach it meanwhile
+    atomic_fence_acquire();
+    uint64_t reserve = atomic_get_relaxed(&header->reserve);
+    if (!valid || reserve - reader->pos > ring_size) {
+        // the lost records show as a gap in the sequence numbers of the next record
+        reader->pos = atomic_get(&header->head);
+        return SHM_RING_OVERRUN;
+    }
+
+    reader->pos += RECORD_HEADER_LEN + ((rec.len + 7) & ~(uint64_t)7);
+    if (reader->seq && rec.seq > reader->seq + 1)
+        reader->lost += rec.seq - reader->seq - 1;
+    reader->seq = rec.seq;
+    if (seq)
+        *seq = rec.seq;
+    return rec.len <= size ? (long)rec.len : SHM_RING_SHORT;
+}
+
+void shm_ring_reader_close(shm_ring_reader_t *reader)
+{
+    if (!reader)
+        return;
+    munmap((void *)reader->header, reader->map_len);
+    free(reader);
+}
+
+#else /* _WIN32 */
+
+struct shm_ring_writer {
+    int unused;
+};
+
+struct shm_ring_reader {
+    shm_ring_header_t const *header;
+    uint64_t lost;
+};
+
+shm_ring_writer_t *shm_ring_writer_create(char const *name, size_t size, int format)
+{
+    (void)name;
+    (void)size;
+    (void)format;
+    fprintf(stderr, "shm_ring: POSIX shared memory is not supported on this platform\n");
+    return NULL;
+}
+
+uint64_t shm_ring_write(shm_ring_writer_t *writer, void const *buf, size_t len)
+{
+    (void)writer;
+    (void)buf;
+    (void)len;
+    return 0;
+}
+
+void shm_ring_writer_free(shm_ring_writer_t *writer)
+{
+    (void)writer;
+}
+
+shm_ring_reader_t *shm_ring_reader_open(char const *name)
+{
+    (void)name;
+    return NULL;
+}
+
+long shm_ring_read(shm_ring_reader_t *reader, void *buf, size_t size, uint64_t *seq)
+{
+    (void)reader;
+    (void)buf;
+    (void)size;
+    (void)seq;
+    return SHM_RING_CLOSED;
+}
+
+void shm_ring_reader_close(shm_ring_reader_t *reader)
+{
+    (void)reader;
+}
+
+#endif /* _WIN32 */
+
+int shm_ring_reader_format(shm_ring_reader_t const *reader)
+{
+    return (int)reader->header->format;
+}
+
+uint64_t shm_ring_reader_lost(shm_ring_reader_t const *reader)
+{
+    return reader->lost;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+#ifndef _WIN32
+    char name[64];
+    snprintf(name, sizeof(name), "rtl_433_test_%d", (int)getpid());
+    char buf[2048];
+    uint64_t seq = 0;
+
+    fprintf(stderr, "shm_ring:: read what was written\n");
+    shm_ring_writer_t *writer = shm_ring_writer_create(name, 4096, SHM_RING_JSON);
+    ASSERT_EQUALS(writer != NULL, 1);
+    if (!writer)
+        return 1;
+    shm_ring_write(writer, "{\"before\":1}", 12);
+    shm_ring_reader_t *reader = shm_ring_reader_open(name);
+    ASSERT_EQUALS(reader != NULL, 1);
+    if (!reader)
+        return 1;
+    ASSERT_EQUALS(shm_ring_reader_format(reader), SHM_RING_JSON);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), SHM_RING_EMPTY);
+    ASSERT_EQUALS(shm_ring_write(writer, "{\"a\":1}", 7), 2);
+    ASSERT_EQUALS(shm_ring_write(writer, "{\"bb\":22}", 9), 3);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), 7);
+    ASSERT_EQUALS(seq, 2);
+    ASSERT_EQUALS(memcmp(buf, "{\"a\":1}", 7), 0);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, 4, &seq), SHM_RING_SHORT);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), SHM_RING_EMPTY);
+
+    fprintf(stderr, "shm_ring:: records wrap around the end\n");
+    memset(buf, 'x', sizeof(buf));
+    for (int i = 0; i < 100; ++i) {
+        shm_ring_write(writer, buf, 100 + i);
+        ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), 100 + i);
+    }
+    ASSERT_EQUALS(seq, 103);
+    ASSERT_EQUALS(shm_ring_write(writer, buf, 1025), 0);
+
+    fprintf(stderr, "shm_ring:: a reader a ring behind loses records\n");
+    for (int i = 0; i < 40; ++i)
+        shm_ring_write(writer, buf, 200);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), SHM_RING_OVERRUN);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), SHM_RING_EMPTY);
+    shm_ring_write(writer, buf, 200);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), 200);
+    ASSERT_EQUALS(seq, 144);
+    ASSERT_EQUALS(shm_ring_reader_lost(reader), 40);
+
+    fprintf(stderr, "shm_ring:: the readers see the writer close\n");
+    shm_ring_writer_free(writer);
+    ASSERT_EQUALS(shm_ring_read(reader, buf, sizeof(buf), &seq), SHM_RING_CLOSED);
+    shm_ring_reader_close(reader);
+    ASSERT_EQUALS(shm_ring_reader_open(name) == NULL, 1);
+#endif
+
+    fprintf(stderr, "shm_ring:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,613 @@
+/** @file
+    SigMF recordings, a JSON metadata file next to the raw samples.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "sigmf.h"
+#include "fileformat.h"
+#include "list.h"
+#include "jsmn.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _MSC_VER
+#ifndef strcasecmp // Microsoft Visual Studio
+#define strcasecmp  _stricmp
+#endif
+#else
+#include <strings.h>
+#endif
+
+#define SIGMF_VERSION  "1.0.0"
+#define SIGMF_META_MAX (64 * 1024 * 1024) ///< largest metadata file read
+
+/// Replace the SigMF extension of a path, any other path is taken as the base.
+static char *dataset_path(char const *path, char const *ext)
+{
+    static char const *const exts[] = {".sigmf-meta", ".sigmf-data", ".sigmf"};
+    size_t len = strlen(path);
+    for (size_t i = 0; i < sizeof(exts) / sizeof(*exts); ++i) {
+        size_t n = strlen(exts[i]);
+        if (len >= n && !strcasecmp(path + len - n, exts[i])) {
+            len -= n;
+            break;
+        }
+    }
+    char *p = malloc(len + strlen(ext) + 1);
+    if (!p) {
+        WARN_MALLOC("dataset_path()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    memcpy(p, path, len);
+    strcpy(p + len, ext);
+    return p;
+}
+
+char *sigmf_meta_path(char const *path)
+{
+    return dataset_path(path, ".sigmf-meta");
+}
+
+char *sigmf_data_path(char const *path)
+{
+    return dataset_path(path, ".sigmf-data");
+}
+
+char const *sigmf_datatype(int format)
+{
+    switch (format) {
+    case CU8_IQ: return "cu8";
+    case CS8_IQ: return "ci8";
+    case CS16_IQ: return "ci16_le";
+    case CF32_IQ: return "cf32_le";
+    default: return NULL;
+    }
+}
+
+/* Reading */
+
+/// Index of the token after a value and all of its children.
+static int json_skip(jsmntok_t const *tok, int i)
+{
+    int pending = 1;
+    while (pending--)
+        pending += tok[i++].size;
+    return i;
+}
+
+static int json_eq(char const *json, jsmntok_t const *tok, char const *s)
+{
+    int len = tok->end - tok->start;
+    return tok->type == JSMN_STRING && (int)strlen(s) == len && !strncmp(json + tok->start, s, len);
+}
+
+/// Find the value of a key of an object, returns its token index or -1.
+static int json_find(char const *json, jsmntok_t const *tok, int obj, char const *key)
+{
+    if (obj < 0 || tok[obj].type != JSMN_OBJECT)
+        return -1;
+    int i = obj + 1;
+    for (int k = 0; k < tok[obj].size; ++k) {
+        if (json_eq(json, &tok[i], key))
+            return i + 1;
+        i = json_skip(tok, i + 1);
+    }
+    return -1;
+}
+
+/// Get a primitive as number, returns @p def if missing.
+static double json_number(char const *json, jsmntok_t const *tok, int i, double def)
+{
+    if (i < 0 || tok[i].type != JSMN_PRIMITIVE)
+        return def;
+    char buf[32];
+    int len = tok[i].end - tok[i].start;
+    if (len >= (int)sizeof(buf))
+        return def;
+    memcpy(buf, json + tok[i].start, len);
+    buf[len] = '\0';
+    char *end;
+    double val = strtod(buf, &end);
+    return end == buf ? def : val;
+}
+
+/// Map a SigMF datatype to a sample format, returns 0 if not supported.
+static int datatype_format(char const *json, jsmntok_t const *tok, int i)
+{
+    if (i < 0)
+        return 0;
+    if (json_eq(json, &tok[i], "cu8"))
+        return CU8_IQ;
+    if (json_eq(json, &tok[i], "ci8"))
+        return CS8_IQ;
+    if (json_eq(json, &tok[i], "ci16_le"))
+        return CS16_IQ;
+    if (json_eq(json, &tok[i], "cf32_le"))
+        return CF32_IQ;
+    return 0;
+}
+
+/// Read a whole file, returns the NUL terminated content or NULL.
+static char *read_file(char const *path, size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        print_logf(LOG_ERROR, "SigMF", "Opening \"%s\" failed", path);
+        return NULL;
+    }
+    char *buf   = NULL;
+    size_t size = 0;
+    size_t n    = 0;
+    for (;;) {
+        if (n + 1 >= size) {
+            size = size ? size * 2 : 16384;
+            if (size > SIGMF_META_MAX) {
+                print_logf(LOG_ERROR, "SigMF", "Metadata \"%s\" too large", path);
+                break;
+            }
+            char *next = realloc(buf, size);
+            if (!next) {
+                WARN_REALLOC("read_file()");
+                break;
+            }
+            buf = next;
+        }
+        size_t r = fread(buf + n, 1, size - n - 1, file);
+        n += r;
+        if (r == 0) {
+            fclose(file);
+            buf[n] = '\0';
+            *len   = n;
+            return buf;
+        }
+    }
+    fclose(file);
+    free(buf);
+    return NULL;
+}
+
+int sigmf_read_meta(char const *path, sigmf_info_t *info)
+{
+    *info = (sigmf_info_t){0};
+    char *meta_path = sigmf_meta_path(path);
+    if (!meta_path)
+        return -1;
+    size_t len = 0;
+    char *json = read_file(meta_path, &len);
+    if (!json) {
+        free(meta_path);
+        return -1;
+    }
+
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    int toks = jsmn_parse(&parser, json, len, NULL, 0);
+    jsmntok_t *tok = toks > 0 ? calloc(toks, sizeof(*tok)) : NULL;
+    if (!tok) {
+        print_logf(LOG_ERROR, "SigMF", "Invalid metadata \"%s\"", meta_path);
+        free(json);
+        free(meta_path);
+        return -1;
+    }
+    jsmn_init(&parser);
+    toks = jsmn_parse(&parser, json, len, tok, toks);
+
+    int ret = -1;
+    int global = toks > 0 ? json_find(json, tok, 0, "global") : -1;
+    if (global < 0) {
+        print_logf(LOG_ERROR, "SigMF", "No global object in \"%s\"", meta_path);
+        goto out;
+    }
+    info->format = datatype_format(json, tok, json_find(json, tok, global, "core:datatype"));
+    if (!info->format) {
+        print_logf(LOG_ERROR, "SigMF", "Datatype of \"%s\" not supported, use cu8, ci8, ci16_le, or cf32_le", meta_path);
+        goto out;
+    }
+    info->sample_rate = (uint32_t)json_number(json, tok, json_find(json, tok, global, "core:sample_rate"), 0.0);
+
+    int captures = json_find(json, tok, 0, "captures");
+    if (captures >= 0 && tok[captures].type == JSMN_ARRAY && tok[captures].size > 0) {
+        // the first capture starts the data
+        info->center_frequency = (uint32_t)json_number(json, tok, json_find(json, tok, captures + 1, "core:frequency"), 0.0);
+        if (tok[captures].size > 1)
+            print_logf(LOG_NOTICE, "SigMF", "Using the frequency of the first of %d captures", tok[captures].size);
+    }
+
+    info->data_path = sigmf_data_path(path);
+    ret = info->data_path ? 0 : -1;
+
+out:
+    free(tok);
+    free(json);
+    free(meta_path);
+    return ret;
+}
+
+/* Writing */
+
+typedef struct {
+    uint64_t sample_start;
+    uint32_t frequency;
+    int64_t time_us;
+} sigmf_capture_t;
+
+typedef struct {
+    uint64_t sample_start;
+    uint64_t sample_count;
+    double freq_lower;
+    double freq_upper;
+    char label[SIGMF_LABEL_MAX];
+    char *comment;
+} sigmf_annotation_t;
+
+struct sigmf_writer {
+    char *meta_path;
+    char *data_path;
+    char *temp_path;
+    FILE *file;
+    int format;
+    char const *recorder;
+    uint32_t sample_rate;
+    int rate_changed;        ///< the sample rate changed, warned once
+    uint64_t samples;        ///< samples in the data file
+    list_t captures;         ///< sigmf_capture_t in sample order
+    list_t annotations;      ///< sigmf_annotation_t
+    char label[SIGMF_LABEL_MAX]; ///< labels of the next annotation
+    int dirty;               ///< the metadata changed since written
+    time_t written;          ///< time the metadata was last written
+};
+
+sigmf_writer_t *sigmf_writer_create(char const *path, int format, char const *recorder)
+{
+    if (!sigmf_datatype(format)) {
+        print_log(LOG_ERROR, "SigMF", "Sample format not supported, use cu8, cs8, cs16, or cf32");
+        return NULL;
+    }
+    sigmf_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("sigmf_writer_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    w->format    = format;
+    w->recorder  = recorder;
+    w->meta_path = sigmf_meta_path(path);
+    w->data_path = sigmf_data_path(path);
+    w->temp_path = dataset_path(path, ".sigmf-meta.tmp");
+    if (!w->meta_path || !w->data_path || !w->temp_path) {
+        sigmf_writer_free(w);
+        return NULL;
+    }
+    w->dirty = 1;
+    return w;
+}
+
+char const *sigmf_writer_data_path(sigmf_writer_t const *w)
+{
+    return w->data_path;
+}
+
+void sigmf_writer_set_file(sigmf_writer_t *w, FILE *file)
+{
+    w->file = file;
+}
+
+FILE *sigmf_writer_file(sigmf_writer_t const *w)
+{
+    return w->file;
+}
+
+/// Write a JSON string with quotes.
+static void put_json_str(FILE *file, char const *s)
+{
+    fputc('"', file);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+/// Write an ISO-8601 UTC time with microseconds.
+static void put_datetime(FILE *file, int64_t time_us)
+{
+    time_t secs = (time_t)(time_us / 1000000);
+    struct tm tm_info;
+#ifdef _WIN32
+    gmtime_s(&tm_info, &secs);
+#else
+    gmtime_r(&secs, &tm_info);
+#endif
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm_info);
+    fprintf(file, "\"%s.%06dZ\"", buf, (int)(time_us % 1000000));
+}
+
+static int compare_annotations(void const *a, void const *b)
+{
+    sigmf_annotation_t const *x = *(sigmf_annotation_t *const *)a;
+    sigmf_annotation_t const *y = *(sigmf_annotation_t *const *)b;
+    return x->sample_start < y->sample_start ? -1 : x->sample_start > y->sample_start;
+}
+
+/// Write the metadata to the temporary file and rename it.
+static int write_meta(sigmf_writer_t *w)
+{
+    FILE *file = fopen(w->temp_path, "wb");
+    if (!file) {
+        print_logf(LOG_ERROR, "SigMF", "Opening \"%s\" failed", w->temp_path);
+        return -1;
+    }
+
+    // the packages of the channels might arrive slightly out of order
+    if (w->annotations.len)
+        qsort(w->annotations.elems, w->annotations.len, sizeof(*w->annotations.elems), compare_annotations);
+
+    fprintf(file, "{\n    \"global\": {\n");
+    fprintf(file, "        \"core:datatype\": \"%s\",\n", sigmf_datatype(w->format));
+    fprintf(file, "        \"core:sample_rate\": %u,\n", w->sample_rate);
+    if (w->recorder) {
+        fprintf(file, "        \"core:recorder\": ");
+        put_json_str(file, w->recorder);
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "        \"core:version\": \"%s\"\n    },\n", SIGMF_VERSION);
+
+    fprintf(file, "    \"captures\": [");
+    for (size_t i = 0; i < w->captures.len; ++i) {
+        sigmf_capture_t const *c = w->captures.elems[i];
+        fprintf(file, "%s\n        {\n", i ? "," : "");
+        fprintf(file, "            \"core:sample_start\": %llu", (unsigned long long)c->sample_start);
+        if (c->frequency)
+            fprintf(file, ",\n            \"core:frequency\": %u", c->frequency);
+        if (c->time_us) {
+            fprintf(file, ",\n            \"core:datetime\": ");
+            put_datetime(file, c->time_us);
+        }
+        fprintf(file, "\n        }");
+    }
+    fprintf(file, "%s],\n", w->captures.len ? "\n    " : "");
+
+    fprintf(file, "    \"annotations\": [");
+    for (size_t i = 0; i < w->annotations.len; ++i) {
+        sigmf_annotation_t const *a = w->annotations.elems[i];
+        fprintf(file, "%s\n        {\n", i ? "," : "");
+        fprintf(file, "            \"core:sample_start\": %llu,\n", (unsigned long long)a->sample_start);
+        fprintf(file, "            \"core:sample_count\": %llu", (unsigned long long)a->sample_count);
+        if (a->freq_lower > 0.0 && a->freq_upper > 0.0) {
+            fprintf(file, ",\n            \"core:freq_lower_edge\": %.0f", a->freq_lower);
+            fprintf(file, ",\n            \"core:freq_upper_edge\": %.0f", a->freq_upper);
+        }
+        if (*a->label) {
+            fprintf(file, ",\n            \"core:label\": ");
+            put_json_str(file, a->label);
+        }
+        if (a->comment) {
+            fprintf(file, ",\n            \"core:comment\": ");
+            put_json_str(file, a->comment);
+        }
+        fprintf(file, "\n        }");
+    }
+    fprintf(file, "%s]\n}\n", w->annotations.len ? "\n    " : "");
+
+    if (ferror(file) || fclose(file)) {
+        print_logf(LOG_ERROR, "SigMF", "Writing \"%s\" failed", w->temp_path);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(w->meta_path); // rename() does not replace on Windows
+#endif
+    if (rename(w->temp_path, w->meta_path)) {
+        print_logf(LOG_ERROR, "SigMF", "Renaming \"%s\" failed", w->temp_path);
+        return -1;
+    }
+    w->dirty   = 0;
+    w->written = time(NULL);
+    return 0;
+}
+
+void sigmf_writer_samples(sigmf_writer_t *w, uint64_t n_samples, uint32_t sample_rate, uint32_t center_frequency, int64_t time_us)
+{
+    if (!w->sample_rate) {
+        w->sample_rate = sample_rate;
+        w->dirty       = 1;
+    }
+    else if (sample_rate != w->sample_rate && !w->rate_changed) {
+        print_logf(LOG_WARNING, "SigMF", "The sample rate changed to %u, the metadata of \"%s\" keeps %u",
+                sample_rate, w->meta_path, w->sample_rate);
+        w->rate_changed = 1;
+    }
+
+    sigmf_capture_t const *last = w->captures.len ? w->captures.elems[w->captures.len - 1] : NULL;
+    if (!last || last->frequency != center_frequency) {
+        sigmf_capture_t *c = calloc(1, sizeof(*c));
+        if (!c) {
+            WARN_CALLOC("sigmf_writer_samples()");
+        }
+        else {
+            c->sample_start = w->samples;
+            c->frequency    = center_frequency;
+            c->time_us      = time_us;
+            list_push(&w->captures, c);
+            w->dirty = 1;
+        }
+    }
+    w->samples += n_samples;
+
+    if (w->dirty && time(NULL) - w->written >= SIGMF_META_INTERVAL_S)
+        write_meta(w);
+}
+
+uint64_t sigmf_writer_position(sigmf_writer_t const *w)
+{
+    return w->samples;
+}
+
+void sigmf_writer_label(sigmf_writer_t *w, char const *label)
+{
+    size_t len = strlen(label);
+    // skip a repeated label
+    for (char const *p = w->label; (p = strstr(p, label)); p += len) {
+        if ((p == w->label || p[-1] == ' ') && (p[len] == ',' || p[len] == '\0'))
+            return;
+    }
+    size_t used = strlen(w->label);
+    if (used + len + 3 > sizeof(w->label))
+        return; // the label is full
+    snprintf(w->label + used, sizeof(w->label) - used, "%s%s", used ? ", " : "", label);
+}
+
+void sigmf_writer_annotate(sigmf_writer_t *w, uint64_t sample_start, uint64_t sample_count, double freq_lower, double freq_upper, char const *comment)
+{
+    sigmf_annotation_t *a = calloc(1, sizeof(*a));
+    if (!a) {
+        WARN_CALLOC("sigmf_writer_annotate()");
+        return;
+    }
+    a->sample_start = sample_start;
+    a->sample_count = sample_count;
+    a->freq_lower   = freq_lower;
+    a->freq_upper   = freq_upper;
+    memcpy(a->label, w->label, sizeof(a->label));
+    *w->label = '\0';
+    if (comment) {
+        a->comment = strdup(comment);
+        if (!a->comment)
+            WARN_STRDUP("sigmf_writer_annotate()");
+    }
+    list_push(&w->annotations, a);
+    w->dirty = 1;
+}
+
+int sigmf_writer_finish(sigmf_writer_t *w)
+{
+    return write_meta(w);
+}
+
+static void free_annotation(void *p)
+{
+    sigmf_annotation_t *a = p;
+    free(a->comment);
+    free(a);
+}
+
+void sigmf_writer_free(sigmf_writer_t *w)
+{
+    if (!w)
+        return;
+    list_free_elems(&w->captures, free);
+    list_free_elems(&w->annotations, free_annotation);
+    free(w->meta_path);
+    free(w->data_path);
+    free(w->temp_path);
+    free(w);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define ASSERT_STR_EQUALS(a, b) \
+    do { \
+        if ((a) && (b) && !strcmp((a), (b))) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: \"%s\" <> \"%s\"\n", (a) ? (a) : "(null)", (b) ? (b) : "(null)"); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "sigmf:: dataset paths\n");
+    char *p = sigmf_meta_path("dir/rec.sigmf-data");
+    ASSERT_STR_EQUALS(p, "dir/rec.sigmf-meta");
+    free(p);
+    p = sigmf_data_path("dir/rec.SigMF-Meta");
+    ASSERT_STR_EQUALS(p, "dir/rec.sigmf-data");
+    free(p);
+    p = sigmf_data_path("rec.cs16.sigmf");
+    ASSERT_STR_EQUALS(p, "rec.cs16.sigmf-data");
+    free(p);
+    p = sigmf_meta_path("rec");
+    ASSERT_STR_EQUALS(p, "rec.sigmf-meta");
+    free(p);
+
+    fprintf(stderr, "sigmf:: write and read back the metadata\n");
+    sigmf_writer_t *w = sigmf_writer_create("sigmf_test.sigmf", CS16_IQ, "rtl_433 \"test\"");
+    ASSERT_EQUALS(w != NULL, 1);
+    sigmf_writer_samples(w, 1000, 250000, 433920000, 1700000000123456);
+    sigmf_writer_samples(w, 1000, 250000, 433920000, 0);
+    sigmf_writer_samples(w, 500, 250000, 868300000, 0);
+    ASSERT_EQUALS(sigmf_writer_position(w), 2500);
+    ASSERT_EQUALS(w->captures.len, 2);
+    sigmf_writer_label(w, "Model-A");
+    sigmf_writer_label(w, "Model-B");
+    sigmf_writer_label(w, "Model-A");
+    sigmf_writer_label(w, "Model");
+    ASSERT_STR_EQUALS(w->label, "Model-A, Model-B, Model");
+    sigmf_writer_annotate(w, 1500, 300, 0.0, 0.0, "OOK");
+    ASSERT_EQUALS(*w->label, '\0');
+    sigmf_writer_annotate(w, 200, 100, 433900000.0, 433950000.0, NULL);
+    ASSERT_EQUALS(sigmf_writer_finish(w), 0);
+    // sorted on write
+    ASSERT_EQUALS(((sigmf_annotation_t *)w->annotations.elems[0])->sample_start, 200);
+    sigmf_writer_free(w);
+
+    sigmf_info_t info;
+    ASSERT_EQUALS(sigmf_read_meta("sigmf_test.sigmf-data", &info), 0);
+    ASSERT_EQUALS(info.format, CS16_IQ);
+    ASSERT_EQUALS(info.sample_rate, 250000);
+    ASSERT_EQUALS(info.center_frequency, 433920000);
+    ASSERT_STR_EQUALS(info.data_path, "sigmf_test.sigmf-data");
+    free(info.data_path);
+    remove("sigmf_test.sigmf-meta");
+
+    fprintf(stderr, "sigmf:: unsupported metadata\n");
+    FILE *file = fopen("sigmf_test.sigmf-meta", "wb");
+    if (file) {
+        fputs("{\"global\": {\"core:datatype\": \"rf32_be\", \"core:sample_rate\": 1e6}, \"captures\": []}", file);
+        fclose(file);
+    }
+    ASSERT_EQUALS(sigmf_read_meta("sigmf_test.sigmf-meta", &info), -1);
+    file = fopen("sigmf_test.sigmf-meta", "wb");
+    if (file) {
+        fputs("{\"global\": {\"x\": {\"a\": [1, {\"b\": 2}]}, \"core:datatype\": \"cu8\", \"core:sample_rate\": 1e6}, \"captures\": []}", file);
+        fclose(file);
+    }
+    ASSERT_EQUALS(sigmf_read_meta("sigmf_test.sigmf-meta", &info), 0);
+    ASSERT_EQUALS(info.format, CU8_IQ);
+    ASSERT_EQUALS(info.sample_rate, 1000000);
+    ASSERT_EQUALS(info.center_frequency, 0);
+    free(info.data_path);
+    remove("sigmf_test.sigmf-meta");
+    ASSERT_EQUALS(sigmf_read_meta("sigmf_test.sigmf-meta", &info), -1);
+
+    fprintf(stderr, "sigmf:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,209 @@
+/** @file
+    Software gain control from the statistics of the raw samples.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "soft_agc.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct soft_agc {
+    float gain;
+    float min_gain;
+    float max_gain;
+    uint32_t window;    ///< samples per decision
+    uint32_t hold;      ///< samples to discard after a change
+    uint64_t pos;       ///< samples in the current window
+    uint64_t hold_left; ///< samples left to discard
+    iq_stats_t iq;      ///< statistics of the current window
+    soft_agc_stats_t stats;
+};
+
+int soft_agc_parse(char const *gain_str, float *gain)
+{
+    if (!gain_str || strncmp(gain_str, "agc", 3) || (gain_str[3] && gain_str[3] != '='))
+        return 0;
+    if (gain_str[3] == '=')
+        *gain = (float)atof(&gain_str[4]);
+    return 1;
+}
+
+soft_agc_t *soft_agc_create(float gain, float min_gain, float max_gain, uint32_t sample_rate)
+{
+    soft_agc_t *agc = calloc(1, sizeof(*agc));
+    if (!agc) {
+        WARN_CALLOC("soft_agc_create()");
+        return NULL;
+    }
+    agc->min_gain  = min_gain;
+    agc->max_gain  = max_gain;
+    agc->gain      = gain < min_gain ? min_gain : gain > max_gain ? max_gain : gain;
+    agc->window    = sample_rate / 2;
+    agc->hold      = sample_rate / 4;
+    agc->hold_left = agc->hold; // the start gain settles too
+    agc->stats.gain_db = agc->gain;
+    return agc;
+}
+
+void soft_agc_free(soft_agc_t *agc)
+{
+    free(agc);
+}
+
+/// The upper bound of the strongest 0.1% of the samples in dBFS.
+static int peak_dbfs(iq_stats_t const *iq)
+{
+    uint64_t count = 0;
+    unsigned bin   = 0;
+    for (; bin < IQ_STATS_BINS - 1; ++bin) {
+        count += iq->bins[bin];
+        if (count * 1000 > iq->samples)
+            break;
+    }
+    return -6 * (int)bin;
+}
+
+int soft_agc_update(soft_agc_t *agc, iq_stats_t const *stats, uint32_t n_samples, int in_package)
+{
+    if (agc->hold_left) {
+        agc->hold_left -= agc->hold_left < n_samples ? agc->hold_left : n_samples;
+        return 0;
+    }
+    agc->pos += n_samples;
+    agc->iq.samples += stats->samples;
+    agc->iq.clipped += stats->clipped;
+    for (unsigned i = 0; i < IQ_STATS_BINS; ++i)
+        agc->iq.bins[i] += stats->bins[i];
+    if (agc->pos < agc->window || in_package || !agc->iq.samples)
+        return 0;
+
+    agc->stats.windows++;
+    agc->stats.clip_ratio = (float)agc->iq.clipped / agc->iq.samples;
+    agc->stats.peak_dbfs  = (float)peak_dbfs(&agc->iq);
+    float gain = agc->gain;
+    if (agc->stats.clip_ratio > SOFT_AGC_CLIP_LIMIT) {
+        gain -= SOFT_AGC_STEP_DB;
+        if (gain < agc->min_gain)
+            gain = agc->min_gain;
+    }
+    else if (!agc->iq.clipped && agc->stats.peak_dbfs <= -SOFT_AGC_HEADROOM_DB) {
+        gain += SOFT_AGC_STEP_DB;
+        if (gain > agc->max_gain)
+            gain = agc->max_gain;
+    }
+    agc->pos = 0;
+    agc->iq  = (iq_stats_t){0};
+    if (gain == agc->gain)
+        return 0;
+
+    if (gain < agc->gain)
+        agc->stats.lowered++;
+    else
+        agc->stats.raised++;
+    agc->gain          = gain;
+    agc->stats.gain_db = gain;
+    agc->hold_left     = agc->hold;
+    return 1;
+}
+
+float soft_agc_gain(soft_agc_t const *agc)
+{
+    return agc->gain;
+}
+
+void soft_agc_get_stats(soft_agc_t const *agc, soft_agc_stats_t *stats)
+{
+    *stats = agc->stats;
+}
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Statistics of a buffer of 1000 samples with the strongest samples in a bin.
+static iq_stats_t test_stats(unsigned peak_bin, unsigned clipped)
+{
+    iq_stats_t iq = {0};
+    iq.samples             = 1000 / SOFT_AGC_STRIDE;
+    iq.clipped             = clipped;
+    iq.bins[peak_bin]      = 2;
+    iq.bins[IQ_STATS_BINS - 1] += iq.samples - 2;
+    return iq;
+}
+
+/// Run buffers of 1000 samples for a time in s at 10k samples/s, returns the number of gain changes.
+static int run(soft_agc_t *agc, unsigned peak_bin, unsigned clipped, unsigned seconds, int in_package)
+{
+    iq_stats_t iq = test_stats(peak_bin, clipped);
+    int changes   = 0;
+    for (unsigned i = 0; i < seconds * 10; ++i)
+        changes += soft_agc_update(agc, &iq, 1000, in_package);
+    return changes;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    float gain      = 20.0f;
+
+    fprintf(stderr, "soft_agc:: parse the gain option\n");
+    ASSERT_EQUALS(soft_agc_parse("agc", &gain), 1);
+    ASSERT_EQUALS((int)gain, 20);
+    ASSERT_EQUALS(soft_agc_parse("agc=32.8", &gain), 1);
+    ASSERT_EQUALS((int)(gain * 10), 328);
+    ASSERT_EQUALS(soft_agc_parse("agcx", &gain), 0);
+    ASSERT_EQUALS(soft_agc_parse("40", &gain), 0);
+    ASSERT_EQUALS(soft_agc_parse(NULL, &gain), 0);
+
+    soft_agc_t *agc = soft_agc_create(20.0f, 1.0f, 49.6f, 10000);
+    ASSERT_EQUALS(agc != NULL, 1);
+    soft_agc_stats_t stats;
+
+    fprintf(stderr, "soft_agc:: steady within the dead band\n");
+    ASSERT_EQUALS(run(agc, 1, 0, 10, 0), 0);
+    ASSERT_EQUALS(run(agc, 2, 0, 10, 0), 0);
+    soft_agc_get_stats(agc, &stats);
+    ASSERT_EQUALS((int)stats.peak_dbfs, -12);
+
+    fprintf(stderr, "soft_agc:: lower on clipping, with hold time\n");
+    // 2 buffers of hold, then a window of 5 buffers
+    ASSERT_EQUALS(run(agc, 0, 1, 1, 0), 1);
+    ASSERT_EQUALS((int)soft_agc_gain(agc), 17);
+    ASSERT_EQUALS(run(agc, 0, 1, 5, 0), 6);
+    ASSERT_EQUALS((int)soft_agc_gain(agc), 1);
+    ASSERT_EQUALS(run(agc, 0, 1, 5, 0), 0);
+
+    fprintf(stderr, "soft_agc:: raise on headroom, never in a package\n");
+    ASSERT_EQUALS(run(agc, 3, 0, 10, 1), 0);
+    ASSERT_EQUALS(run(agc, 3, 0, 1, 0), 1);
+    ASSERT_EQUALS((int)soft_agc_gain(agc), 4);
+    ASSERT_EQUALS(run(agc, 3, 0, 100, 0), 16);
+    ASSERT_EQUALS((int)(soft_agc_gain(agc) * 10), 496);
+    soft_agc_get_stats(agc, &stats);
+    ASSERT_EQUALS(stats.raised, 17);
+    ASSERT_EQUALS(stats.lowered, 7);
+    soft_agc_free(agc);
+
+    fprintf(stderr, "soft_agc:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
@@ -0,0 +1,445 @@
+/** @file
+    Spectrum monitor, an averaged FFT of one SDR buffer per interval on a low priority thread.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "spectrum.h"
+#include "thread_sched.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SPECTRUM_IN_SIZE (SPECTRUM_FFT_SIZE * SPECTRUM_AVERAGES * 4) ///< bytes of the windows at the largest sample size
+
+struct spectrum {
+    unsigned bins;
+    double interval_s;
+    uint64_t samples_left; ///< samples until the next snapshot is due
+
+    // the input, written by the DSP thread while no snapshot is pending
+    unsigned char in[SPECTRUM_IN_SIZE];
+    unsigned in_sample_size;
+    spectrum_info_t in_info;
+
+    // the work of the spectrum thread
+    float window[SPECTRUM_FFT_SIZE];
+    float window_power;               ///< squared sum of the window
+    float cos_tab[SPECTRUM_FFT_SIZE / 2];
+    float sin_tab[SPECTRUM_FFT_SIZE / 2];
+    float re[SPECTRUM_FFT_SIZE];
+    float im[SPECTRUM_FFT_SIZE];
+    float power[SPECTRUM_FFT_SIZE];
+    float db[SPECTRUM_FFT_SIZE];
+
+    // the last snapshot, under the lock
+    float out_db[SPECTRUM_FFT_SIZE];
+    spectrum_info_t out_info;
+    unsigned seq;
+
+#ifdef THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running; ///< the thread was started
+    int pending; ///< the input waits for the thread
+    int stop;
+#endif
+};
+
+/// In-place radix-2 FFT of SPECTRUM_FFT_SIZE samples.
+static void fft(spectrum_t *spec)
+{
+    unsigned n = SPECTRUM_FFT_SIZE;
+    float *re  = spec->re;
+    float *im  = spec->im;
+
+    for (unsigned i = 1, j = 0; i < n; ++i) {
+        unsigned bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i];
+            re[i]   = re[j];
+            re[j]   = t;
+            t       = im[i];
+            im[i]   = im[j];
+            im[j]   = t;
+        }
+    }
+
+    for (unsigned len = 2; len <= n; len <<= 1) {
+        unsigned half = len / 2;
+        unsigned step = n / len;
+        for (unsigned i = 0; i < n; i += len) {
+            for (unsigned k = 0; k < half; ++k) {
+                float wr    = spec->cos_tab[k * step];
+                float wi    = -spec->sin_tab[k * step];
+                unsigned a  = i + k;
+                unsigned b  = a + half;
+                float tr    = re[b] * wr - im[b] * wi;
+                float ti    = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/// Compute a snapshot from the input and store it.
+static void compute(spectrum_t *spec)
+{
+    unsigned n        = SPECTRUM_FFT_SIZE;
+    unsigned averages = spec->in_info.averages;
+
+    memset(spec->power, 0, sizeof(spec->power));
+    for (unsigned a = 0; a < averages; ++a) {
+        if (spec->in_sample_size == 2) {
+            uint8_t const *p = spec->in + (size_t)a * n * 2;
+            for (unsigned i = 0; i < n; ++i) {
+                spec->re[i] = (p[2 * i] - 127.5f) / 128.0f * spec->window[i];
+                spec->im[i] = (p[2 * i + 1] - 127.5f) / 128.0f * spec->window[i];
+            }
+        }
+        else {
+            int16_t const *p = (int16_t const *)spec->in + (size_t)a * n * 2;
+            for (unsigned i = 0; i < n; ++i) {
+                spec->re[i] = p[2 * i] / 32768.0f * spec->window[i];
+                spec->im[i] = p[2 * i + 1] / 32768.0f * spec->window[i];
+            }
+        }
+        fft(spec);
+        for (unsigned i = 0; i < n; ++i)
+            spec->power[i] += spec->re[i] * spec->re[i] + spec->im[i] * spec->im[i];
+    }
+
+    // fold the FFT bins, negative frequencies first, into the output bins by their mean
+    unsigned fold = n / spec->bins;
+    float scale   = 1.0f / (averages * spec->window_power * fold);
+    for (unsigned b = 0; b < spec->bins; ++b) {
+        float sum = 0.0f;
+        for (unsigned k = 0; k < fold; ++k)
+            sum += spec->power[(b * fold + k + n / 2) % n];
+        spec->db[b] = 10.0f * log10f(sum * scale + 1e-20f);
+    }
+
+#ifdef THREADS
+    if (spec->running)
+        pthread_mutex_lock(&spec->lock);
+#endif
+    memcpy(spec->out_db, spec->db, spec->bins * sizeof(*spec->db));
+    spec->out_info      = spec->in_info;
+    spec->out_info.bins = spec->bins;
+    spec->seq++;
+#ifdef THREADS
+    // with the snapshot published, a reader of the new seq may push the next input
+    spec->pending = 0;
+    if (spec->running)
+        pthread_mutex_unlock(&spec->lock);
+#endif
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL spectrum_loop(void *arg)
+{
+    spectrum_t *spec = arg;
+
+    pthread_mutex_lock(&spec->lock);
+    for (;;) {
+        while (!spec->pending && !spec->stop)
+            pthread_cond_wait(&spec->cond, &spec->lock);
+        if (spec->stop)
+            break;
+        pthread_mutex_unlock(&spec->lock);
+        compute(spec); // clears pending
+        pthread_mutex_lock(&spec->lock);
+    }
+    pthread_mutex_unlock(&spec->lock);
+
+    return (THREAD_RETURN)0;
+}
+#endif
+
+spectrum_t *spectrum_create(unsigned bins, double interval_s)
+{
+    spectrum_t *spec = calloc(1, sizeof(*spec));
+    if (!spec) {
+        WARN_CALLOC("spectrum_create()");
+        return NULL;
+    }
+
+    unsigned pow2 = SPECTRUM_BINS_MIN;
+    while (pow2 * 2 <= bins && pow2 < SPECTRUM_FFT_SIZE)
+        pow2 *= 2;
+    spec->bins       = pow2;
+    spec->interval_s = interval_s > 0.0 ? interval_s : 1.0;
+
+    unsigned n = SPECTRUM_FFT_SIZE;
+    float sum  = 0.0f;
+    for (unsigned i = 0; i < n; ++i) {
+        spec->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / n));
+        sum += spec->window[i];
+    }
+    spec->window_power = sum * sum;
+    for (unsigned k = 0; k < n / 2; ++k) {
+        spec->cos_tab[k] = (float)cos(2.0 * M_PI * k / n);
+        spec->sin_tab[k] = (float)sin(2.0 * M_PI * k / n);
+    }
+
+#ifdef THREADS
+    pthread_mutex_init(&spec->lock, NULL);
+    pthread_cond_init(&spec->cond, NULL);
+#ifndef _WIN32
+    // Block all signals from the spectrum thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&spec->thread, NULL, spectrum_loop, spec);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        // the snapshots are computed on the DSP thread
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        pthread_cond_destroy(&spec->cond);
+        pthread_mutex_destroy(&spec->lock);
+    }
+    else {
+        spec->running = 1;
+    }
+#endif
+
+    return spec;
+}
+
+void spectrum_set_sched(spectrum_t *spec, thread_sched_t const *sched, char const *name)
+{
+    if (!spec)
+        return;
+#ifdef THREADS
+    if (spec->running)
+        thread_sched_apply(spec->thread, sched, name);
+#else
+    (void)sched;
+    (void)name;
+#endif
+}
+
+void spectrum_free(spectrum_t *spec)
+{
+    if (!spec)
+        return;
+#ifdef THREADS
+    if (spec->running) {
+        pthread_mutex_lock(&spec->lock);
+        spec->stop = 1;
+        pthread_cond_signal(&spec->cond);
+        pthread_mutex_unlock(&spec->lock);
+        pthread_join(spec->thread, NULL);
+        pthread_cond_destroy(&spec->cond);
+        pthread_mutex_destroy(&spec->lock);
+    }
+#endif
+    free(spec);
+}
+
+void spectrum_push(spectrum_t *spec, void const *iq_buf, uint32_t len, unsigned sample_size, spectrum_info_t const *info)
+{
+    unsigned n_samples = len / sample_size;
+    if (spec->samples_left > n_samples) {
+        spec->samples_left -= n_samples;
+        return;
+    }
+    unsigned averages = n_samples / SPECTRUM_FFT_SIZE;
+    if (averages > SPECTRUM_AVERAGES)
+        averages = SPECTRUM_AVERAGES;
+    if (!averages || (sample_size != 2 && sample_size != 4))
+        return; // stays due for the next buffer
+
+#ifdef THREADS
+    if (spec->running) {
+        pthread_mutex_lock(&spec->lock);
+        int busy = spec->pending;
+        pthread_mutex_unlock(&spec->lock);
+        if (busy)
+            return; // stays due for the next buffer
+    }
+#endif
+
+    memcpy(spec->in, iq_buf, (size_t)averages * SPECTRUM_FFT_SIZE * sample_size);
+    spec->in_sample_size    = sample_size;
+    spec->in_info           = *info;
+    spec->in_info.averages  = averages;
+    spec->samples_left      = (uint64_t)(spec->interval_s * info->sample_rate);
+
+#ifdef THREADS
+    if (spec->running) {
+        pthread_mutex_lock(&spec->lock);
+        spec->pending = 1;
+        pthread_cond_signal(&spec->cond);
+        pthread_mutex_unlock(&spec->lock);
+        return;
+    }
+#endif
+    compute(spec);
+}
+
+unsigned spectrum_seq(spectrum_t *spec)
+{
+    unsigned seq;
+#ifdef THREADS
+    if (spec->running)
+        pthread_mutex_lock(&spec->lock);
+#endif
+    seq = spec->seq;
+#ifdef THREADS
+    if (spec->running)
+        pthread_mutex_unlock(&spec->lock);
+#endif
+    return seq;
+}
+
+unsigned spectrum_read(spectrum_t *spec, spectrum_info_t *info, float *db)
+{
+    unsigned seq;
+#ifdef THREADS
+    if (spec->running)
+        pthread_mutex_lock(&spec->lock);
+#endif
+    seq   = spec->seq;
+    *info = spec->out_info;
+    if (seq)
+        memcpy(db, spec->out_db, spec->out_info.bins * sizeof(*db));
+#ifdef THREADS
+    if (spec->running)
+        pthread_mutex_unlock(&spec->lock);
+#endif
+    return seq;
+}
+
+#ifdef _TEST
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Wait for the snapshot after @p seq, at most ten seconds on a loaded machine.
+static unsigned wait_seq(spectrum_t *spec, unsigned seq)
+{
+    for (int i = 0; i < 10000 && spectrum_seq(spec) <= seq; ++i) {
+#ifdef _WIN32
+        Sleep(1);
+#else
+        usleep(1000);
+#endif
+    }
+    return spectrum_seq(spec);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    // a tone at +1/8 of the sample rate, with a little noise
+    enum { BUF_SAMPLES = 16384 };
+    static uint8_t buf[BUF_SAMPLES * 2];
+    unsigned rnd = 1;
+    for (unsigned i = 0; i < BUF_SAMPLES; ++i) {
+        rnd = rnd * 1103515245 + 12345;
+        double noise = ((rnd >> 16) % 5) - 2.0;
+        buf[2 * i]     = (uint8_t)(127.5 + 60.0 * cos(2.0 * M_PI * i / 8) + noise);
+        buf[2 * i + 1] = (uint8_t)(127.5 + 60.0 * sin(2.0 * M_PI * i / 8) + noise);
+    }
+    spectrum_info_t info = {.center_frequency = 433920000, .sample_rate = 250000, .time_us = 1};
+    float db[SPECTRUM_FFT_SIZE];
+
+    fprintf(stderr, "spectrum:: the tone is in its bin\n");
+    spectrum_t *spec = spectrum_create(256, 1.0);
+    ASSERT_EQUALS(spec != NULL, 1);
+    if (!spec)
+        return 1;
+    ASSERT_EQUALS(spectrum_seq(spec), 0);
+    spectrum_push(spec, buf, sizeof(buf), 2, &info);
+    ASSERT_EQUALS(wait_seq(spec, 0), 1);
+    spectrum_info_t got;
+    ASSERT_EQUALS(spectrum_read(spec, &got, db), 1);
+    ASSERT_EQUALS(got.bins, 256);
+    ASSERT_EQUALS(got.averages, SPECTRUM_AVERAGES);
+    ASSERT_EQUALS(got.center_frequency, 433920000);
+    unsigned peak = 0;
+    for (unsigned b = 1; b < got.bins; ++b) {
+        if (db[b] > db[peak])
+            peak = b;
+    }
+    // +rate/8 is 1/8 of the bins above the center bin
+    ASSERT_EQUALS(peak, 128 + 32);
+    ASSERT_EQUALS(db[peak] > db[16] + 30.0f, 1);
+    ASSERT_EQUALS(db[peak] > -20.0f && db[peak] < 0.0f, 1);
+
+    fprintf(stderr, "spectrum:: one snapshot per interval\n");
+    // 250000 samples a second, 16384 per buffer, about 15 buffers to the next snapshot
+    unsigned seq = 1;
+    for (int i = 0; i < 14; ++i) {
+        spectrum_push(spec, buf, sizeof(buf), 2, &info);
+    }
+    ASSERT_EQUALS(spectrum_seq(spec), 1);
+    spectrum_push(spec, buf, sizeof(buf), 2, &info);
+    spectrum_push(spec, buf, sizeof(buf), 2, &info);
+    seq = wait_seq(spec, seq);
+    ASSERT_EQUALS(seq, 2);
+
+    spectrum_free(spec);
+
+    fprintf(stderr, "spectrum:: a short buffer averages fewer FFTs, the bins are a power of two\n");
+    spec = spectrum_create(300, 1.0);
+    ASSERT_EQUALS(spec != NULL, 1);
+    if (!spec)
+        return 1;
+    spectrum_push(spec, buf, SPECTRUM_FFT_SIZE / 2 * 2, 2, &info); // too short for an FFT
+    spectrum_push(spec, buf, SPECTRUM_FFT_SIZE * 2 * 2, 2, &info);
+    ASSERT_EQUALS(wait_seq(spec, 0), 1);
+    spectrum_read(spec, &got, db);
+    ASSERT_EQUALS(got.averages, 2);
+    ASSERT_EQUALS(got.bins, 256);
+    spectrum_free(spec);
+
+    fprintf(stderr, "spectrum:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
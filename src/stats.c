@@ -0,0 +1,31 @@
+/** @file
+    Lock free statistics counters.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "stats.h"
+
+// the blocks are structs of uint64_t counters only
+
+void stats_read(void *dst, void const *src, size_t size)
+{
+    uint64_t *d       = dst;
+    uint64_t const *s = src;
+    for (size_t i = 0; i < size / sizeof(*s); ++i)
+        d[i] = stats_get(&s[i]);
+}
+
+void stats_read_since(void *dst, void const *src, void const *base, size_t size)
+{
+    uint64_t *d       = dst;
+    uint64_t const *s = src;
+    uint64_t const *b = base;
+    for (size_t i = 0; i < size / sizeof(*s); ++i)
+        d[i] = stats_get(&s[i]) - b[i];
+}
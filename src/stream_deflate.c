@@ -0,0 +1,286 @@
+/** @file
+    Streaming compression of messages, permessage-deflate and gzip.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "stream_deflate.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ZLIB
+
+struct stream_deflate {
+    z_stream zs;
+    int format;
+    int no_context_takeover;
+    uint8_t *buf; ///< the compressed message
+    size_t size;
+    size_t len;
+};
+
+int stream_deflate_available(void)
+{
+    return 1;
+}
+
+stream_deflate_t *stream_deflate_create(int format, int window_bits, int no_context_takeover)
+{
+    if (window_bits < 9 || window_bits > 15)
+        return NULL;
+    stream_deflate_t *z = calloc(1, sizeof(*z));
+    if (!z) {
+        WARN_CALLOC("stream_deflate_create()");
+        return NULL;
+    }
+    int bits = format == STREAM_DEFLATE_GZIP ? window_bits + 16 : -window_bits;
+    // the fastest level, each message is compressed while serving all clients
+    if (deflateInit2(&z->zs, Z_BEST_SPEED, Z_DEFLATED, bits, STREAM_DEFLATE_MEMLEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(z);
+        return NULL;
+    }
+    z->format              = format;
+    z->no_context_takeover = no_context_takeover;
+    return z;
+}
+
+void stream_deflate_free(stream_deflate_t *z)
+{
+    if (!z)
+        return;
+    deflateEnd(&z->zs);
+    free(z->buf);
+    free(z);
+}
+
+/// Deflate a part into buf, grows buf as needed, returns -1 on error.
+static int deflate_part(stream_deflate_t *z, void const *data, size_t len, int flush)
+{
+    z->zs.next_in  = (Bytef *)data;
+    z->zs.avail_in = (uInt)len;
+    do {
+        if (z->len == z->size) {
+            size_t size  = z->size ? z->size * 2 : 4096;
+            uint8_t *buf = realloc(z->buf, size);
+            if (!buf) {
+                WARN_REALLOC("stream_deflate_write()");
+                return -1;
+            }
+            z->buf  = buf;
+            z->size = size;
+        }
+        z->zs.next_out  = z->buf + z->len;
+        z->zs.avail_out = (uInt)(z->size - z->len);
+        int ret         = deflate(&z->zs, flush);
+        z->len          = z->size - z->zs.avail_out;
+        if (ret == Z_STREAM_ERROR)
+            return -1;
+    } while (z->zs.avail_out == 0 || z->zs.avail_in);
+    return 0;
+}
+
+size_t stream_deflate_write(stream_deflate_t *z, void const *const *bufs, size_t const *lens, unsigned n, int finish, uint8_t const **out)
+{
+    z->len = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        int flush = i + 1 < n ? Z_NO_FLUSH : finish && z->format == STREAM_DEFLATE_GZIP ? Z_FINISH : Z_SYNC_FLUSH;
+        if (deflate_part(z, bufs[i], lens[i], flush))
+            return 0;
+    }
+    if (!n && deflate_part(z, "", 0, finish && z->format == STREAM_DEFLATE_GZIP ? Z_FINISH : Z_SYNC_FLUSH))
+        return 0;
+
+    if (z->format == STREAM_DEFLATE_RAW) {
+        // the receiver appends the 00 00 ff ff tail of the sync flush
+        if (z->len < 4 || memcmp(z->buf + z->len - 4, "\x00\x00\xff\xff", 4))
+            return 0;
+        z->len -= 4;
+        if (z->no_context_takeover && deflateReset(&z->zs) != Z_OK)
+            return 0;
+    }
+    *out = z->buf;
+    return z->len;
+}
+
+long stream_inflate_message(void const *buf, size_t len, char *dst, size_t dst_size)
+{
+    z_stream zs = {0};
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+        return -1;
+    static unsigned char const tail[4] = {0x00, 0x00, 0xff, 0xff};
+    zs.next_out  = (Bytef *)dst;
+    zs.avail_out = (uInt)dst_size;
+    zs.next_in   = (Bytef *)buf;
+    zs.avail_in  = (uInt)len;
+    int ret      = inflate(&zs, Z_NO_FLUSH);
+    if (ret == Z_OK || ret == Z_BUF_ERROR) {
+        zs.next_in  = (Bytef *)tail;
+        zs.avail_in = sizeof(tail);
+        ret         = inflate(&zs, Z_SYNC_FLUSH);
+    }
+    // a full dst may have cut the message
+    long out = (ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR) && zs.avail_out && !zs.avail_in ? (long)zs.total_out : -1;
+    inflateEnd(&zs);
+    return out;
+}
+
+#else
+
+int stream_deflate_available(void)
+{
+    return 0;
+}
+
+stream_deflate_t *stream_deflate_create(int format, int window_bits, int no_context_takeover)
+{
+    (void)format;
+    (void)window_bits;
+    (void)no_context_takeover;
+    return NULL;
+}
+
+void stream_deflate_free(stream_deflate_t *z)
+{
+    (void)z;
+}
+
+size_t stream_deflate_write(stream_deflate_t *z, void const *const *bufs, size_t const *lens, unsigned n, int finish, uint8_t const **out)
+{
+    (void)z;
+    (void)bufs;
+    (void)lens;
+    (void)n;
+    (void)finish;
+    (void)out;
+    return 0;
+}
+
+long stream_inflate_message(void const *buf, size_t len, char *dst, size_t dst_size)
+{
+    (void)buf;
+    (void)len;
+    (void)dst;
+    (void)dst_size;
+    return -1;
+}
+
+#endif /* ZLIB */
+
+// Unit testing
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d (line %d)\n", (a), (b), __LINE__); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    if (!stream_deflate_available()) {
+        fprintf(stderr, "stream_deflate:: no zlib, no streams\n");
+        ASSERT_EQUALS(stream_deflate_create(STREAM_DEFLATE_RAW, STREAM_DEFLATE_WBITS, 0) == NULL, 1);
+        fprintf(stderr, "stream_deflate:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+        return failed > 0;
+    }
+
+#ifdef ZLIB
+    char const *event = "{\"time\":\"2024-01-01 12:00:00\",\"model\":\"Acurite-Tower\",\"id\":1234,\"channel\":\"A\",\"battery_ok\":1,\"temperature_C\":21.5,\"humidity\":48}";
+    size_t event_len  = strlen(event);
+    char dst[STREAM_INFLATE_MAX];
+    uint8_t const *out;
+
+    fprintf(stderr, "stream_deflate:: a message in parts inflates to the whole message\n");
+    stream_deflate_t *z = stream_deflate_create(STREAM_DEFLATE_RAW, STREAM_DEFLATE_WBITS, 1);
+    ASSERT_EQUALS(z != NULL, 1);
+    void const *parts[2] = {event, event + 10};
+    size_t lens[2]       = {10, event_len - 10};
+    size_t len           = stream_deflate_write(z, parts, lens, 2, 0, &out);
+    ASSERT_EQUALS(len > 0 && len < event_len, 1);
+    long n = stream_inflate_message(out, len, dst, sizeof(dst));
+    ASSERT_EQUALS((int)n, (int)event_len);
+    ASSERT_EQUALS(n > 0 && !memcmp(dst, event, event_len), 1);
+
+    fprintf(stderr, "stream_deflate:: without context takeover each message stands alone\n");
+    size_t len2 = stream_deflate_write(z, (void const *const *)&event, &event_len, 1, 0, &out);
+    ASSERT_EQUALS((int)len2, (int)len);
+    ASSERT_EQUALS((int)stream_inflate_message(out, len2, dst, sizeof(dst)), (int)event_len);
+    ASSERT_EQUALS((int)stream_inflate_message(out, len2, dst, 10), -1);
+    stream_deflate_free(z);
+
+    fprintf(stderr, "stream_deflate:: with context takeover a repeated message shrinks\n");
+    z = stream_deflate_create(STREAM_DEFLATE_RAW, STREAM_DEFLATE_WBITS, 0);
+    z_stream zs = {0};
+    inflateInit2(&zs, -MAX_WBITS);
+    size_t first = 0;
+    for (int i = 0; i < 2; ++i) {
+        len = stream_deflate_write(z, (void const *const *)&event, &event_len, 1, 0, &out);
+        if (!i)
+            first = len;
+        // the peer inflates the messages with one context, the tail appended
+        uint8_t msg[512];
+        memcpy(msg, out, len);
+        memcpy(msg + len, "\x00\x00\xff\xff", 4);
+        zs.next_in   = msg;
+        zs.avail_in  = (uInt)len + 4;
+        zs.next_out  = (Bytef *)dst;
+        zs.avail_out = sizeof(dst);
+        ASSERT_EQUALS(inflate(&zs, Z_SYNC_FLUSH), Z_OK);
+        ASSERT_EQUALS((int)(sizeof(dst) - zs.avail_out), (int)event_len);
+        ASSERT_EQUALS(!memcmp(dst, event, event_len), 1);
+    }
+    ASSERT_EQUALS(len < first / 4, 1);
+    inflateEnd(&zs);
+    stream_deflate_free(z);
+
+    fprintf(stderr, "stream_deflate:: a gzip stream decodes to the messages\n");
+    z = stream_deflate_create(STREAM_DEFLATE_GZIP, STREAM_DEFLATE_WBITS, 0);
+    uint8_t gz[1024];
+    size_t gz_len = 0;
+    for (int i = 0; i < 3; ++i) {
+        len = stream_deflate_write(z, (void const *const *)&event, &event_len, 1, i == 2, &out);
+        ASSERT_EQUALS(len > 0, 1);
+        memcpy(gz + gz_len, out, len);
+        gz_len += len;
+    }
+    ASSERT_EQUALS(gz[0] == 0x1f && gz[1] == 0x8b, 1);
+    zs = (z_stream){0};
+    inflateInit2(&zs, 16 + MAX_WBITS);
+    zs.next_in   = gz;
+    zs.avail_in  = (uInt)gz_len;
+    zs.next_out  = (Bytef *)dst;
+    zs.avail_out = sizeof(dst);
+    ASSERT_EQUALS(inflate(&zs, Z_FINISH), Z_STREAM_END);
+    ASSERT_EQUALS((int)zs.total_out, (int)event_len * 3);
+    ASSERT_EQUALS(!memcmp(dst + 2 * event_len, event, event_len), 1);
+    inflateEnd(&zs);
+    stream_deflate_free(z);
+
+    fprintf(stderr, "stream_deflate:: invalid input does not inflate\n");
+    ASSERT_EQUALS((int)stream_inflate_message("\xff\xff\xff\xff", 4, dst, sizeof(dst)), -1);
+    ASSERT_EQUALS(stream_deflate_create(STREAM_DEFLATE_RAW, 8, 0) == NULL, 1);
+#endif
+
+    fprintf(stderr, "stream_deflate:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed > 0;
+}
+
+#endif /* _TEST */
@@ -217,8 +217,10 @@ int term_get_columns(void *ctx)
     return (c_info.srWindow.Right - c_info.srWindow.Left + 1);
 #else
     FILE *fp = (FILE *)ctx;
-    struct winsize w;
-    ioctl(fileno(fp), TIOCGWINSZ, &w);
+    struct winsize w = {0};
+    // not a terminal, e.g. a file
+    if (ioctl(fileno(fp), TIOCGWINSZ, &w) || !w.ws_col)
+        return (80);
     return w.ws_col;
 #endif
 }
@@ -311,7 +313,7 @@ void term_ring_bell(void *ctx)
 #endif
 }
 
-void term_set_fg(void *ctx, term_color_t color)
+int term_fg_escape(void *ctx, term_color_t color, char *buf, size_t size)
 {
     // Cache the detected terminal background color
     static int light_bg = -1;
@@ -322,65 +324,104 @@ void term_set_fg(void *ctx, term_color_t color)
 #ifdef _WIN32
     console_t *console = (console_t *)ctx;
     if (!console->ansi) {
-        _term_set_color(ctx, TRUE, color);
-        return;
+        return -1;
     }
-    FILE *fp = console->file;
 #else
-    FILE *fp = (FILE *)ctx;
+    (void)ctx;
 #endif
     if (color == TERM_COLOR_RESET) {
-        fprintf(fp, "\033[0m");
+        return snprintf(buf, size, "\033[0m");
     }
     else if (light_bg) {
-        fprintf(fp, "\033[%dm", color); // normal colors on light backgrounds
+        return snprintf(buf, size, "\033[%dm", color); // normal colors on light backgrounds
     }
     else {
-        fprintf(fp, "\033[%d;1m", color); // bright/bold colors on dark backgrounds
+        return snprintf(buf, size, "\033[%d;1m", color); // bright/bold colors on dark backgrounds
     }
 }
 
-void term_set_bg(void *ctx, term_color_t bg, term_color_t fg)
+void term_set_fg(void *ctx, term_color_t color)
+{
+    char buf[TERM_ESCAPE_MAX];
+    if (term_fg_escape(ctx, color, buf, sizeof(buf)) < 0) {
+#ifdef _WIN32
+        _term_set_color(ctx, TRUE, color);
+#endif
+        return;
+    }
+#ifdef _WIN32
+    FILE *fp = ((console_t *)ctx)->file;
+#else
+    FILE *fp = (FILE *)ctx;
+#endif
+    fputs(buf, fp);
+}
+
+/// Adjust the colors of term_set_bg() to the terminal background, drop invalid colors.
+static void term_bg_adjust(term_color_t *bg, term_color_t *fg)
 {
     // Cache the detected terminal background color
     static int light_bg = -1;
     if (light_bg == -1) {
         light_bg = term_get_bg();
     }
-    if (light_bg && fg >= TERM_COLOR_BRIGHT_BLACK && fg <= TERM_COLOR_BRIGHT_WHITE) {
-        fg -= 60; // remove bright/bold foreground on light backgrounds
+    if (light_bg && *fg >= TERM_COLOR_BRIGHT_BLACK && *fg <= TERM_COLOR_BRIGHT_WHITE) {
+        *fg -= 60; // remove bright/bold foreground on light backgrounds
     }
 
-    if (bg < TERM_COLOR_BLACK
-            || (bg > TERM_COLOR_WHITE && bg < TERM_COLOR_BRIGHT_BLACK)
-            || bg > TERM_COLOR_BRIGHT_WHITE) {
-        bg = 0;
+    if (*bg < TERM_COLOR_BLACK
+            || (*bg > TERM_COLOR_WHITE && *bg < TERM_COLOR_BRIGHT_BLACK)
+            || *bg > TERM_COLOR_BRIGHT_WHITE) {
+        *bg = 0;
     }
-    if (fg < TERM_COLOR_BLACK
-            || (fg > TERM_COLOR_WHITE && fg < TERM_COLOR_BRIGHT_BLACK)
-            || fg > TERM_COLOR_BRIGHT_WHITE) {
-        fg = 0;
+    if (*fg < TERM_COLOR_BLACK
+            || (*fg > TERM_COLOR_WHITE && *fg < TERM_COLOR_BRIGHT_BLACK)
+            || *fg > TERM_COLOR_BRIGHT_WHITE) {
+        *fg = 0;
     }
+}
 
+int term_bg_escape(void *ctx, term_color_t bg, term_color_t fg, char *buf, size_t size)
+{
 #ifdef _WIN32
     console_t *console = (console_t *)ctx;
     if (!console->ansi) {
+        return -1;
+    }
+#else
+    (void)ctx;
+#endif
+    term_bg_adjust(&bg, &fg);
+    if (bg && fg)
+        return snprintf(buf, size, "\033[%d;%dm", bg + 10, fg);
+    else if (bg)
+        return snprintf(buf, size, "\033[%dm", bg + 10);
+    else if (fg)
+        return snprintf(buf, size, "\033[%dm", fg);
+    if (size)
+        *buf = '\0';
+    return 0;
+}
+
+void term_set_bg(void *ctx, term_color_t bg, term_color_t fg)
+{
+    char buf[TERM_ESCAPE_MAX];
+    if (term_bg_escape(ctx, bg, fg, buf, sizeof(buf)) < 0) {
+#ifdef _WIN32
+        term_bg_adjust(&bg, &fg);
         if (bg)
             _term_set_color(ctx, FALSE, bg);
         if (fg)
             _term_set_color(ctx, TRUE, fg);
+#endif
         return;
     }
-    FILE *fp = console->file;
+#ifdef _WIN32
+    FILE *fp = ((console_t *)ctx)->file;
 #else
     FILE *fp = (FILE *)ctx;
 #endif
-    if (bg && fg)
-        fprintf(fp, "\033[%d;%dm", bg + 10, fg);
-    else if (bg)
-        fprintf(fp, "\033[%dm", bg + 10);
-    else if (fg)
-        fprintf(fp, "\033[%dm", fg);
+    fputs(buf, fp);
 }
 
 #define DIM(array) (int) (sizeof(array) / sizeof(array[0]))
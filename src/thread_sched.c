@@ -0,0 +1,201 @@
+/** @file
+    CPU affinity, real-time priority, and memory locking of the worker threads.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "thread_sched.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#define THREAD_SCHED_CPU_MAX 1023
+
+/// Parse a number, returns the position after it or NULL on error.
+static char const *parse_num(char const *p, int max, int *num)
+{
+    char *end;
+    long val = strtol(p, &end, 10);
+    if (end == p || val < 0 || val > max)
+        return NULL;
+    *num = (int)val;
+    return end;
+}
+
+int thread_sched_parse(thread_sched_t *sched, char const *arg)
+{
+    thread_sched_t s = {.set = 1, .cpu_first = -1, .cpu_last = -1};
+
+    char const *p = arg ? arg : "";
+    // the CPUs
+    if (*p >= '0' && *p <= '9') {
+        p = parse_num(p, THREAD_SCHED_CPU_MAX, &s.cpu_first);
+        if (p && *p == '-')
+            p = parse_num(p + 1, THREAD_SCHED_CPU_MAX, &s.cpu_last);
+        else
+            s.cpu_last = s.cpu_first;
+        if (!p || s.cpu_last < s.cpu_first)
+            return -1;
+    }
+    // the policy
+    if (*p == ':' && (p[1] < '0' || p[1] > '9')) {
+        ++p;
+        size_t len = strcspn(p, ":,");
+        if (len == 4 && !strncmp(p, "fifo", len))
+            s.policy = THREAD_SCHED_FIFO;
+        else if (len == 2 && !strncmp(p, "rr", len))
+            s.policy = THREAD_SCHED_RR;
+        else if (len == 5 && !strncmp(p, "other", len))
+            s.policy = THREAD_SCHED_OTHER;
+        else
+            return -1;
+        p += len;
+        if (s.policy != THREAD_SCHED_OTHER)
+            s.priority = THREAD_SCHED_DEFAULT_PRIORITY;
+    }
+    // the priority
+    if (*p == ':') {
+        if (s.policy == THREAD_SCHED_OTHER)
+            s.policy = THREAD_SCHED_FIFO;
+        p = parse_num(p + 1, 99, &s.priority);
+        if (!p || s.priority < 1)
+            return -1;
+    }
+    if (*p && *p != ',')
+        return -1;
+
+    *sched = s;
+    return 0;
+}
+
+#ifdef THREADS
+
+static void log_applied(thread_sched_t const *sched, char const *name)
+{
+    char cpus[32] = "any CPU";
+    if (sched->cpu_first >= 0 && sched->cpu_first == sched->cpu_last)
+        snprintf(cpus, sizeof(cpus), "CPU %d", sched->cpu_first);
+    else if (sched->cpu_first >= 0)
+        snprintf(cpus, sizeof(cpus), "CPUs %d-%d", sched->cpu_first, sched->cpu_last);
+    char const *policy = sched->policy == THREAD_SCHED_RR ? "RR" : sched->policy == THREAD_SCHED_FIFO ? "FIFO" : NULL;
+    if (policy)
+        print_logf(LOG_INFO, "Sched", "The %s thread runs on %s with %s priority %d", name, cpus, policy, sched->priority);
+    else
+        print_logf(LOG_INFO, "Sched", "The %s thread runs on %s", name, cpus);
+}
+
+#ifdef _WIN32
+
+int thread_sched_apply(pthread_t thread, thread_sched_t const *sched, char const *name)
+{
+    if (!sched || !sched->set)
+        return 0;
+
+    int ret = 0;
+    if (sched->cpu_first >= 0) {
+        DWORD_PTR mask = 0;
+        for (int i = sched->cpu_first; i <= sched->cpu_last && i < (int)sizeof(mask) * 8; ++i)
+            mask |= (DWORD_PTR)1 << i;
+        if (!mask || !SetThreadAffinityMask(thread, mask)) {
+            print_logf(LOG_WARNING, "Sched", "Can't set the CPU affinity of the %s thread (%lu)", name, (unsigned long)GetLastError());
+            ret = -1;
+        }
+    }
+    if (sched->policy != THREAD_SCHED_OTHER) {
+        // there are no real-time policies, the highest priorities come closest
+        int priority = sched->priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+        if (!SetThreadPriority(thread, priority)) {
+            print_logf(LOG_WARNING, "Sched", "Can't set the priority of the %s thread (%lu)", name, (unsigned long)GetLastError());
+            ret = -1;
+        }
+    }
+    if (!ret)
+        log_applied(sched, name);
+    return ret;
+}
+
+#else
+
+int thread_sched_apply(pthread_t thread, thread_sched_t const *sched, char const *name)
+{
+    if (!sched || !sched->set)
+        return 0;
+
+    int ret = 0;
+    if (sched->cpu_first >= 0) {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int i = sched->cpu_first; i <= sched->cpu_last && i < CPU_SETSIZE; ++i)
+            CPU_SET(i, &cpus);
+        int r = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+        if (r) {
+            print_logf(LOG_WARNING, "Sched", "Can't set the CPU affinity of the %s thread: %s%s", name, strerror(r),
+                    r == EINVAL ? " (no such CPU online)" : "");
+            ret = -1;
+        }
+#else
+        print_logf(LOG_WARNING, "Sched", "CPU affinity is not supported on this system, the %s thread runs on any CPU", name);
+        ret = -1;
+#endif
+    }
+    if (sched->policy != THREAD_SCHED_OTHER) {
+        int policy = sched->policy == THREAD_SCHED_RR ? SCHED_RR : SCHED_FIFO;
+        struct sched_param param = {0};
+        param.sched_priority = sched->priority;
+        int min = sched_get_priority_min(policy);
+        int max = sched_get_priority_max(policy);
+        if (param.sched_priority < min)
+            param.sched_priority = min;
+        if (param.sched_priority > max)
+            param.sched_priority = max;
+        int r = pthread_setschedparam(thread, policy, &param);
+        if (r) {
+            print_logf(LOG_WARNING, "Sched", "Can't set the real-time priority of the %s thread: %s%s", name, strerror(r),
+                    r == EPERM ? " (needs CAP_SYS_NICE or an rtprio limit)" : "");
+            ret = -1;
+        }
+    }
+    if (!ret)
+        log_applied(sched, name);
+    return ret;
+}
+
+#endif /* _WIN32 */
+
+#endif /* THREADS */
+
+int thread_sched_lock_memory(void const *addr, size_t len)
+{
+    if (!addr || !len)
+        return 0;
+
+#ifdef _WIN32
+    if (!VirtualLock((LPVOID)addr, len)) {
+        print_logf(LOG_WARNING, "Sched", "Can't lock %zu bytes of buffers (%lu), raise the working set size", len, (unsigned long)GetLastError());
+        return -1;
+    }
+#else
+    if (mlock(addr, len)) {
+        print_logf(LOG_WARNING, "Sched", "Can't lock %zu bytes of buffers: %s%s", len, strerror(errno),
+                errno == ENOMEM || errno == EPERM ? " (raise the memlock limit, see ulimit -l)" : "");
+        return -1;
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,154 @@
+/** @file
+    TLS session resumption and handshake stats for the client outputs.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "tls_session.h"
+#include "logger.h"
+
+#include <string.h>
+
+#include "mongoose.h"
+
+#if MG_ENABLE_SSL && defined(OPENSSL)
+#include <openssl/ssl.h>
+
+/// Note the start of the handshake, TLS 1.3 also calls this for the tickets after the handshake.
+static void tls_session_info(SSL const *ssl, int where, int ret)
+{
+    (void)ret;
+    if (!(where & SSL_CB_HANDSHAKE_START))
+        return;
+    tls_session_t *ts = SSL_get_app_data(ssl);
+    if (ts && ts->pending && ts->start == 0.0)
+        ts->start = mg_time();
+}
+
+void tls_session_connect(tls_session_t *ts, struct mg_connection *nc)
+{
+    SSL *ssl = nc ? mg_ssl_if_get_ssl(nc) : NULL;
+    if (!ssl)
+        return;
+    ts->enabled = 1;
+    ts->pending = 1;
+    ts->start   = 0.0;
+    SSL_set_app_data(ssl, ts);
+    SSL_set_info_callback(ssl, tls_session_info);
+    if (ts->session && SSL_set_session(ssl, ts->session) != 1)
+        print_log(LOG_DEBUG, __func__, "Cached TLS session not accepted");
+}
+
+void tls_session_connected(tls_session_t *ts, struct mg_connection *nc, int status)
+{
+    SSL *ssl = mg_ssl_if_get_ssl(nc);
+    if (!ssl || !ts->pending)
+        return;
+    ts->pending = 0;
+    if (status != 0) {
+        if (ts->start == 0.0)
+            return; // the TCP connect failed
+        ts->failed++;
+        // the server may have rejected the session, don't offer it again
+        SSL_SESSION_free(ts->session);
+        ts->session = NULL;
+        return;
+    }
+    double ms = ts->start > 0.0 ? (mg_time() - ts->start) * 1000.0 : 0.0;
+    ts->handshakes++;
+    ts->total_ms += ms;
+    ts->last_ms = ms;
+    if (SSL_session_reused(ssl))
+        ts->resumed++;
+    print_logf(LOG_DEBUG, __func__, "TLS handshake %s in %.1f ms", SSL_session_reused(ssl) ? "resumed" : "full", ms);
+}
+
+void tls_session_keep(tls_session_t *ts, struct mg_connection *nc)
+{
+    SSL *ssl = mg_ssl_if_get_ssl(nc);
+    if (!ssl || !(nc->flags & MG_F_SSL_HANDSHAKE_DONE))
+        return;
+    SSL_SESSION *session = SSL_get1_session(ssl);
+    if (!session)
+        return;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    // a copy, an error on the connection marks its session not resumable
+    SSL_SESSION *copy = SSL_SESSION_is_resumable(session) ? SSL_SESSION_dup(session) : NULL;
+    SSL_SESSION_free(session);
+    if (!copy)
+        return; // keep the previous session
+    session = copy;
+#endif
+    SSL_SESSION_free(ts->session);
+    ts->session = session;
+}
+
+void tls_session_closed(tls_session_t *ts, struct mg_connection *nc)
+{
+    SSL *ssl = mg_ssl_if_get_ssl(nc);
+    if (!ssl)
+        return;
+    tls_session_keep(ts, nc);
+    SSL_set_app_data(ssl, NULL);
+}
+
+void tls_session_clear(tls_session_t *ts, struct mg_connection *nc)
+{
+    SSL *ssl = nc ? mg_ssl_if_get_ssl(nc) : NULL;
+    if (ssl)
+        SSL_set_app_data(ssl, NULL);
+    SSL_SESSION_free(ts->session);
+    ts->session = NULL;
+}
+
+#else
+
+void tls_session_connect(tls_session_t *ts, struct mg_connection *nc)
+{
+    (void)ts;
+    (void)nc;
+}
+
+void tls_session_connected(tls_session_t *ts, struct mg_connection *nc, int status)
+{
+    (void)ts;
+    (void)nc;
+    (void)status;
+}
+
+void tls_session_keep(tls_session_t *ts, struct mg_connection *nc)
+{
+    (void)ts;
+    (void)nc;
+}
+
+void tls_session_closed(tls_session_t *ts, struct mg_connection *nc)
+{
+    (void)ts;
+    (void)nc;
+}
+
+void tls_session_clear(tls_session_t *ts, struct mg_connection *nc)
+{
+    (void)ts;
+    (void)nc;
+}
+
+#endif
+
+data_t *tls_session_stats(tls_session_t const *ts, data_t *data)
+{
+    if (!ts->enabled)
+        return data;
+    data = data_int(data, "tls_handshakes", "", NULL, (int)ts->handshakes);
+    data = data_int(data, "tls_resumed", "", NULL, (int)ts->resumed);
+    data = data_int(data, "tls_failed", "", NULL, (int)ts->failed);
+    data = data_dbl(data, "tls_handshake_ms", "", "%.1f", ts->handshakes ? ts->total_ms / ts->handshakes : 0.0);
+    data = data_dbl(data, "tls_last_handshake_ms", "", "%.1f", ts->last_ms);
+    return data;
+}
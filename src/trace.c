@@ -0,0 +1,223 @@
+/** @file
+    Trace of the hot path events, exported as Chrome trace JSON.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "trace.h"
+#include "compat_atomic.h"
+#include "cpu_stats.h"
+#include "abuf.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// A recorded event, a duration of 0 is an instant event.
+typedef struct trace_rec {
+    uint64_t ts;      ///< start time in ns
+    char const *name;
+    uint32_t dur;     ///< duration in ns, saturates at about 4 s
+    uint32_t arg;
+    uint32_t event;
+} trace_rec_t;
+
+#define TRACE_RING_EVENTS (TRACE_BUFFER_SIZE / TRACE_MAX_THREADS / sizeof(trace_rec_t))
+
+/// The events of one thread, written only by that thread.
+typedef struct trace_ring {
+    trace_rec_t recs[TRACE_RING_EVENTS];
+    uint64_t pos;       ///< records written, published after a record is complete
+    uint64_t clear_pos; ///< records before this are dropped, see trace_clear()
+    char const *name;
+    unsigned tid;
+} trace_ring_t;
+
+int volatile trace_on;
+
+static trace_ring_t trace_rings[TRACE_MAX_THREADS];
+static long trace_num_rings; ///< rings claimed, may exceed TRACE_MAX_THREADS
+
+static COMPAT_TLS trace_ring_t *trace_ring;    ///< the ring of this thread
+static COMPAT_TLS int trace_untraced;          ///< no ring was left for this thread
+static COMPAT_TLS char const *trace_name;      ///< the name of this thread
+
+static long claim_ring(void)
+{
+    return (long)atomic_add(&trace_num_rings, 1) - 1;
+}
+
+void trace_enable(int enable)
+{
+    trace_on = enable;
+}
+
+void trace_thread_name(char const *name)
+{
+    trace_name = name;
+    if (trace_ring)
+        trace_ring->name = name;
+}
+
+void trace_record(enum trace_event event, char const *name, uint32_t arg, uint64_t start, uint64_t end)
+{
+    trace_ring_t *ring = trace_ring;
+    if (!ring) {
+        if (trace_untraced)
+            return;
+        long idx = claim_ring();
+        if (idx >= TRACE_MAX_THREADS) {
+            trace_untraced = 1;
+            return;
+        }
+        ring       = &trace_rings[idx];
+        ring->name = trace_name;
+        ring->tid  = (unsigned)idx + 1;
+        trace_ring = ring;
+    }
+
+    if (!start)
+        start = end = cpu_stats_now();
+    uint64_t dur = end - start;
+
+    uint64_t pos     = ring->pos;
+    trace_rec_t *rec = &ring->recs[pos % TRACE_RING_EVENTS];
+    rec->ts    = start;
+    rec->name  = name;
+    rec->dur   = dur > UINT32_MAX ? UINT32_MAX : (uint32_t)dur;
+    rec->arg   = arg;
+    rec->event = event;
+    atomic_set64(&ring->pos, pos + 1);
+}
+
+void trace_clear(void)
+{
+    for (long i = 0; i < trace_num_rings && i < TRACE_MAX_THREADS; ++i)
+        trace_rings[i].clear_pos = atomic_get64(&trace_rings[i].pos);
+}
+
+static char const *trace_category(uint32_t event)
+{
+    switch (event) {
+    case TRACE_BUFFER: return "sdr";
+    case TRACE_DSP: return "dsp";
+    case TRACE_PACKAGE: return "package";
+    case TRACE_DECODER: return "decoder";
+    case TRACE_OUTPUT: return "output";
+    default: return "";
+    }
+}
+
+/// Print a string as JSON string content, the names are printable text.
+static void print_json_name(abuf_t *buf, char const *name)
+{
+    for (char const *p = name ? name : ""; *p && buf->left > 2; ++p) {
+        if (*p == '"' || *p == '\\')
+            abuf_printf(buf, "\\%c", *p);
+        else if ((unsigned char)*p >= ' ')
+            abuf_printf(buf, "%c", *p);
+    }
+}
+
+/// Copy the valid records of a ring, returns the number copied.
+static size_t read_ring(trace_ring_t *ring, trace_rec_t *dst)
+{
+    uint64_t pos   = atomic_get64(&ring->pos);
+    uint64_t first = pos > TRACE_RING_EVENTS ? pos - TRACE_RING_EVENTS : 0;
+    if (first < ring->clear_pos)
+        first = ring->clear_pos;
+    for (uint64_t i = first; i < pos; ++i)
+        dst[i - first] = ring->recs[i % TRACE_RING_EVENTS];
+
+    // the writer went on meanwhile, drop the records it may have overwritten
+    atomic_fence_acquire();
+    uint64_t now_pos = atomic_get64(&ring->pos);
+    uint64_t valid = now_pos >= TRACE_RING_EVENTS ? now_pos - TRACE_RING_EVENTS + 1 : 0;
+    if (valid <= first)
+        return pos - first;
+    if (valid >= pos)
+        return 0;
+    memmove(dst, dst + (valid - first), (pos - valid) * sizeof(*dst));
+    return pos - valid;
+}
+
+#define TRACE_JSON_REC_MAX 240 ///< room for a record with a long decoder name
+
+char *trace_export_json(size_t *len)
+{
+    long num_rings = trace_num_rings < TRACE_MAX_THREADS ? trace_num_rings : TRACE_MAX_THREADS;
+    size_t size    = 64 + (size_t)num_rings * (200 + TRACE_RING_EVENTS * TRACE_JSON_REC_MAX);
+    char *text = malloc(size);
+    if (!text) {
+        WARN_MALLOC("trace_export_json()");
+        return NULL;
+    }
+    trace_rec_t *recs = malloc(TRACE_RING_EVENTS * sizeof(*recs));
+    if (!recs) {
+        WARN_MALLOC("trace_export_json()");
+        free(text);
+        return NULL;
+    }
+
+    abuf_t buf;
+    abuf_init(&buf, text, size);
+    abuf_cat(&buf, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    char const *sep = "";
+    for (long i = 0; i < num_rings; ++i) {
+        trace_ring_t *ring = &trace_rings[i];
+        abuf_printf(&buf, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                sep, ring->tid);
+        print_json_name(&buf, ring->name ? ring->name : "thread");
+        abuf_cat(&buf, "\"}}");
+        sep = ",\n";
+
+        size_t num_recs = read_ring(ring, recs);
+        for (size_t r = 0; r < num_recs; ++r) {
+            trace_rec_t const *rec = &recs[r];
+            abuf_cat(&buf, ",\n{\"name\":\"");
+            print_json_name(&buf, rec->name);
+            abuf_printf(&buf, "\",\"cat\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u",
+                    trace_category(rec->event), ring->tid,
+                    (unsigned long long)(rec->ts / 1000), (unsigned)(rec->ts % 1000));
+            if (rec->dur)
+                abuf_printf(&buf, ",\"ph\":\"X\",\"dur\":%u.%03u", rec->dur / 1000, rec->dur % 1000);
+            else
+                abuf_cat(&buf, ",\"ph\":\"i\",\"s\":\"t\"");
+            abuf_printf(&buf, ",\"args\":{\"arg\":%u}}", rec->arg);
+        }
+    }
+    abuf_cat(&buf, "]}\n");
+    free(recs);
+
+    *len = size - buf.left;
+    return text;
+}
+
+int trace_write_file(char const *path)
+{
+    size_t len;
+    char *text = trace_export_json(&len);
+    if (!text)
+        return -1;
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        print_logf(LOG_ERROR, "Trace", "Failed to open \"%s\"", path);
+        free(text);
+        return -1;
+    }
+    int ret = fwrite(text, 1, len, file) == len ? 0 : -1;
+    if (fclose(file))
+        ret = -1;
+    free(text);
+    if (ret)
+        print_logf(LOG_ERROR, "Trace", "Failed to write \"%s\"", path);
+    return ret;
+}
@@ -0,0 +1,301 @@
+/** @file
+    Differential verify mode, the optimized paths against the reference paths on the same input.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "verify.h"
+#include "r_api.h"
+#include "r_device.h"
+#include "pulse_data.h"
+#include "cpu_stats.h"
+#include "data.h"
+#include "list.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVENT_JSON_MAX 4096 ///< longer events are compared truncated
+
+struct verify {
+    char *prefix;
+    unsigned reproducers; ///< files written, numbers the next one
+
+    // baseband
+    filter_state_t lp_state;  ///< the low pass state the optimized run started with
+    demodfm_state_t fm_state; ///< the FM state the optimized run started with
+    uint64_t frame_start;
+    uint16_t *env_buf;
+    int16_t *am_buf;
+    int16_t *fm_buf;
+    uint32_t buf_len;
+    unsigned frames;
+    unsigned frame_diffs;
+    int am_reported;
+    int fm_reported;
+    uint64_t frame_ns;     ///< time of the optimized demodulation
+    uint64_t frame_ref_ns; ///< time of the scalar demodulation
+
+    // decoding
+    int capturing;
+    list_t events;     ///< the events of the optimized run as "name json"
+    list_t ref_events; ///< the events of the reference run as "name json"
+    unsigned packages;
+    unsigned package_diffs;
+    int decode_reported;
+    uint64_t decode_ns;     ///< time of the optimized decoding
+    uint64_t decode_ref_ns; ///< time of the reference decoding
+};
+
+verify_t *verify_create(char const *prefix)
+{
+    verify_t *v = calloc(1, sizeof(*v));
+    if (!v) {
+        WARN_CALLOC("verify_create()");
+        return NULL;
+    }
+    v->prefix = strdup(prefix ? prefix : VERIFY_PREFIX_DEFAULT);
+    if (!v->prefix) {
+        WARN_STRDUP("verify_create()");
+        free(v);
+        return NULL;
+    }
+    return v;
+}
+
+void verify_free(verify_t *v)
+{
+    if (!v)
+        return;
+    verify_stats_t stats;
+    verify_get_stats(v, &stats);
+    print_logf(LOG_WARNING, "Verify", "%u frames compared, %u differ, scalar baseband %.2fx the time of the optimized",
+            stats.frames, stats.frame_diffs, stats.baseband_speedup);
+    print_logf(LOG_WARNING, "Verify", "%u packages compared, %u differ, reference decoding %.2fx the time of the optimized",
+            stats.packages, stats.package_diffs, stats.decode_speedup);
+
+    list_free_elems(&v->events, free);
+    list_free_elems(&v->ref_events, free);
+    free(v->env_buf);
+    free(v->am_buf);
+    free(v->fm_buf);
+    free(v->prefix);
+    free(v);
+}
+
+/// Open the next reproducer file, NULL on error.
+static FILE *open_reproducer(verify_t *v, char const *suffix, char *path, size_t path_len)
+{
+    snprintf(path, path_len, "%s_%03u%s", v->prefix, v->reproducers++, suffix);
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        print_logf(LOG_ERROR, "Verify", "Failed to open \"%s\"", path);
+    return file;
+}
+
+static int reserve_buffers(verify_t *v, uint32_t n_samples)
+{
+    if (n_samples <= v->buf_len)
+        return 0;
+    free(v->env_buf);
+    free(v->am_buf);
+    free(v->fm_buf);
+    v->am_buf  = NULL;
+    v->fm_buf  = NULL;
+    v->buf_len = 0;
+    v->env_buf = malloc(n_samples * sizeof(*v->env_buf));
+    if (!v->env_buf) {
+        WARN_MALLOC("verify_frame_end()");
+        return -1;
+    }
+    v->am_buf = malloc(n_samples * sizeof(*v->am_buf));
+    if (!v->am_buf) {
+        WARN_MALLOC("verify_frame_end()");
+        return -1;
+    }
+    v->fm_buf = malloc(n_samples * sizeof(*v->fm_buf));
+    if (!v->fm_buf) {
+        WARN_MALLOC("verify_frame_end()");
+        return -1;
+    }
+    v->buf_len = n_samples;
+    return 0;
+}
+
+void verify_frame_begin(verify_t *v, filter_state_t const *lp_state, demodfm_state_t const *fm_state)
+{
+    v->lp_state    = *lp_state;
+    v->fm_state    = *fm_state;
+    v->frame_start = cpu_stats_now();
+}
+
+/// Compare a buffer, returns the number of different samples, the first one, and the largest difference.
+static unsigned compare_buf(int16_t const *buf, int16_t const *ref, uint32_t n_samples, uint32_t *first, int *max_diff)
+{
+    unsigned diffs = 0;
+    *max_diff = 0;
+    for (uint32_t i = 0; i < n_samples; ++i) {
+        if (buf[i] == ref[i])
+            continue;
+        if (!diffs++)
+            *first = i;
+        int diff = abs(buf[i] - ref[i]);
+        if (diff > *max_diff)
+            *max_diff = diff;
+    }
+    return diffs;
+}
+
+void verify_frame_end(verify_t *v, uint8_t const *iq_buf, uint32_t n_samples, unsigned sample_size, int use_mag_est,
+        uint32_t center_frequency, uint32_t samp_rate, float low_pass, int16_t const *am_buf, int16_t const *fm_buf)
+{
+    uint64_t start = cpu_stats_now();
+    if (reserve_buffers(v, n_samples))
+        return;
+
+    int prev = baseband_set_scalar(1);
+    if (sample_size == 2) { // CU8
+        if (use_mag_est)
+            magnitude_est_cu8(iq_buf, v->env_buf, n_samples);
+        else
+            envelope_detect(iq_buf, v->env_buf, n_samples);
+    }
+    else { // CS16
+        magnitude_est_cs16((int16_t const *)iq_buf, v->env_buf, n_samples);
+    }
+    baseband_low_pass_filter(v->env_buf, v->am_buf, n_samples, &v->lp_state);
+    if (fm_buf && sample_size == 2)
+        baseband_demod_FM(iq_buf, v->fm_buf, n_samples, samp_rate, low_pass, &v->fm_state);
+    else if (fm_buf)
+        baseband_demod_FM_cs16((int16_t const *)iq_buf, v->fm_buf, n_samples, samp_rate, low_pass, &v->fm_state);
+    baseband_set_scalar(prev);
+
+    v->frame_ns += start - v->frame_start;
+    v->frame_ref_ns += cpu_stats_now() - start;
+    v->frames++;
+
+    uint32_t am_first = 0;
+    uint32_t fm_first = 0;
+    int am_max = 0;
+    int fm_max = 0;
+    unsigned am_diffs = compare_buf(am_buf, v->am_buf, n_samples, &am_first, &am_max);
+    unsigned fm_diffs = fm_buf ? compare_buf(fm_buf, v->fm_buf, n_samples, &fm_first, &fm_max) : 0;
+    if (!am_diffs && !fm_diffs)
+        return;
+    v->frame_diffs++;
+
+    int report_am = am_diffs && !v->am_reported;
+    int report_fm = fm_diffs && !v->fm_reported;
+    if (!report_am && !report_fm)
+        return;
+    v->am_reported |= report_am;
+    v->fm_reported |= report_fm;
+
+    char path[256];
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), "_%gM_%gk.%s", center_frequency / 1e6, samp_rate / 1e3, sample_size == 2 ? "cu8" : "cs16");
+    FILE *file = open_reproducer(v, suffix, path, sizeof(path));
+    if (file) {
+        if (fwrite(iq_buf, sample_size, n_samples, file) != n_samples)
+            print_logf(LOG_ERROR, "Verify", "Failed to write \"%s\"", path);
+        fclose(file);
+    }
+    if (report_am)
+        print_logf(LOG_WARNING, "Verify", "AM differs in %u of %u samples of frame %u by up to %d, first at %u: %d, scalar %d, frame saved to \"%s\"",
+                am_diffs, n_samples, v->frames, am_max, am_first, am_buf[am_first], v->am_buf[am_first], path);
+    if (report_fm)
+        print_logf(LOG_WARNING, "Verify", "FM differs in %u of %u samples of frame %u by up to %d, first at %u: %d, scalar %d, frame saved to \"%s\"",
+                fm_diffs, n_samples, v->frames, fm_max, fm_first, fm_buf[fm_first], v->fm_buf[fm_first], path);
+    print_log(LOG_WARNING, "Verify", "The filter states of the earlier frames are not in the saved frame");
+}
+
+void verify_decode_begin(verify_t *v)
+{
+    list_clear(&v->events, free);
+    v->capturing = 1;
+}
+
+/// Append an event as "name json" to a list.
+static void capture_event(list_t *events, r_device const *r_dev, data_t *data)
+{
+    char json[EVENT_JSON_MAX];
+    data_print_jsons(data, json, sizeof(json));
+    size_t len = strlen(r_dev->name) + 1 + strlen(json) + 1;
+    char *event = malloc(len);
+    if (!event) {
+        WARN_MALLOC("verify_event()");
+        return;
+    }
+    snprintf(event, len, "%s %s", r_dev->name, json);
+    list_push(events, event);
+}
+
+void verify_event(verify_t *v, r_device *r_dev, data_t *data)
+{
+    if (v && v->capturing)
+        capture_event(&v->events, r_dev, data);
+}
+
+static void reference_event(void *ctx, r_device *r_dev, data_t *data)
+{
+    verify_t *v = ctx;
+    capture_event(&v->ref_events, r_dev, data);
+}
+
+void verify_decode_end(verify_t *v, struct dm_state *demod, pulse_data_t *pulses, int fsk, uint64_t start)
+{
+    v->capturing = 0;
+    uint64_t ref_start = cpu_stats_now();
+    list_clear(&v->ref_events, free);
+    run_demods_reference(demod, pulses, fsk, reference_event, v);
+    v->decode_ns += ref_start - start;
+    v->decode_ref_ns += cpu_stats_now() - ref_start;
+    v->packages++;
+
+    size_t n = v->events.len > v->ref_events.len ? v->events.len : v->ref_events.len;
+    size_t i = 0;
+    for (; i < n; ++i) {
+        if (i >= v->events.len || i >= v->ref_events.len || strcmp(v->events.elems[i], v->ref_events.elems[i]))
+            break;
+    }
+    if (i == n)
+        return;
+    v->package_diffs++;
+    if (v->decode_reported)
+        return;
+    v->decode_reported = 1;
+
+    char path[256];
+    FILE *file = open_reproducer(v, ".ook", path, sizeof(path));
+    if (file) {
+        pulse_data_print_pulse_header(file);
+        pulse_data_dump(file, pulses);
+        fclose(file);
+    }
+    print_logf(LOG_WARNING, "Verify", "%s package %u decodes to %u events, reference %u, package saved to \"%s\"",
+            fsk ? "FSK" : "OOK", v->packages, (unsigned)v->events.len, (unsigned)v->ref_events.len, path);
+    print_logf(LOG_WARNING, "Verify", "First difference at event %u: %s", (unsigned)i,
+            i < v->events.len ? (char const *)v->events.elems[i] : "(none)");
+    print_logf(LOG_WARNING, "Verify", "Reference event %u: %s", (unsigned)i,
+            i < v->ref_events.len ? (char const *)v->ref_events.elems[i] : "(none)");
+}
+
+void verify_get_stats(verify_t const *v, verify_stats_t *stats)
+{
+    *stats = (verify_stats_t){
+            .frames           = v->frames,
+            .frame_diffs      = v->frame_diffs,
+            .packages         = v->packages,
+            .package_diffs    = v->package_diffs,
+            .baseband_speedup = v->frame_ns ? (double)v->frame_ref_ns / v->frame_ns : 0.0,
+            .decode_speedup   = v->decode_ns ? (double)v->decode_ref_ns / v->decode_ns : 0.0,
+    };
+}
@@ -0,0 +1,203 @@
+/** @file
+    Fixed pool of worker threads to run a batch of independent tasks.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "worker_pool.h"
+#include "r_util.h"
+#include "logger.h"
+#include "trace.h"
+#include "fatal.h"
+#include "thread_sched.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#ifdef THREADS
+
+struct worker_pool {
+    unsigned threads;
+    pthread_t *thread;
+    pthread_mutex_t lock; ///< lock for the batch and exit_thread
+    pthread_cond_t work;  ///< signaled on a new batch and exit
+    pthread_cond_t done;  ///< signaled when the last task of a batch finished
+    worker_pool_fn task_fn;
+    void *ctx;
+    unsigned tasks;   ///< number of tasks in the batch
+    unsigned next;    ///< next task to take
+    unsigned pending; ///< tasks not yet finished
+    int exit_thread;
+};
+
+/// Take and run tasks until the batch is exhausted, the lock must be held.
+static void worker_pool_drain(worker_pool_t *pool)
+{
+    while (pool->next < pool->tasks) {
+        unsigned task = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->task_fn(pool->ctx, task);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->done);
+    }
+}
+
+static THREAD_RETURN THREAD_CALL worker_pool_loop(void *arg)
+{
+    worker_pool_t *pool = arg;
+    print_log(LOG_DEBUG, __func__, "worker enter...");
+    trace_thread_name("worker");
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->exit_thread) {
+        if (pool->next >= pool->tasks) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+            continue;
+        }
+        worker_pool_drain(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    print_log(LOG_DEBUG, __func__, "worker done...");
+    return (THREAD_RETURN)0;
+}
+
+worker_pool_t *worker_pool_start(unsigned threads)
+{
+    if (!threads)
+        return NULL;
+
+    worker_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        WARN_CALLOC("worker_pool_start()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    pool->thread = calloc(threads, sizeof(*pool->thread));
+    if (!pool->thread) {
+        WARN_CALLOC("worker_pool_start()");
+        free(pool);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+#ifndef _WIN32
+    // Block all signals from the worker threads
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    for (; pool->threads < threads; ++pool->threads) {
+        int r = pthread_create(&pool->thread[pool->threads], NULL, worker_pool_loop, pool);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+            break;
+        }
+    }
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (!pool->threads) {
+        worker_pool_stop(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void worker_pool_stop(worker_pool_t *pool)
+{
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->exit_thread = 1;
+    pthread_mutex_unlock(&pool->lock);
+    pthread_cond_broadcast(&pool->work);
+
+    for (unsigned i = 0; i < pool->threads; ++i) {
+        int r = pthread_join(pool->thread[i], NULL);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
+        }
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    free(pool->thread);
+    free(pool);
+}
+
+void worker_pool_set_sched(worker_pool_t *pool, thread_sched_t const *sched, char const *name)
+{
+    if (!pool)
+        return;
+
+    for (unsigned i = 0; i < pool->threads; ++i)
+        thread_sched_apply(pool->thread[i], sched, name);
+}
+
+void worker_pool_run(worker_pool_t *pool, unsigned tasks, worker_pool_fn task_fn, void *ctx)
+{
+    if (!pool || tasks < 2) {
+        for (unsigned task = 0; task < tasks; ++task)
+            task_fn(ctx, task);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task_fn = task_fn;
+    pool->ctx     = ctx;
+    pool->tasks   = tasks;
+    pool->next    = 0;
+    pool->pending = tasks;
+    pthread_cond_broadcast(&pool->work);
+
+    worker_pool_drain(pool);
+    while (pool->pending)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+#else
+
+worker_pool_t *worker_pool_start(unsigned threads)
+{
+    UNUSED(threads);
+    return NULL;
+}
+
+void worker_pool_stop(worker_pool_t *pool)
+{
+    UNUSED(pool);
+}
+
+void worker_pool_set_sched(worker_pool_t *pool, thread_sched_t const *sched, char const *name)
+{
+    UNUSED(pool);
+    UNUSED(sched);
+    UNUSED(name);
+}
+
+void worker_pool_run(worker_pool_t *pool, unsigned tasks, worker_pool_fn task_fn, void *ctx)
+{
+    UNUSED(pool);
+    for (unsigned task = 0; task < tasks; ++task)
+        task_fn(ctx, task);
+}
+
+#endif
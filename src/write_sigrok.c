@@ -11,7 +11,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
@@ -22,204 +24,441 @@
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#ifdef ZLIB
+#include <zlib.h>
+#endif
 
+#include "logger.h"
 #include "fatal.h"
 #include "write_sigrok.h"
 
-void write_sigrok(char const *filename, unsigned samplerate, unsigned probes, unsigned analogs, char const *labels[])
-{
-    // e.g. uses channels
-    // U8:LOGIC:logic-1-1
-    // F32:I:analog-1-4-1
-    // F32:Q:analog-1-5-1
-    // F32:AM:analog-1-6-1
-    // F32:FM:analog-1-7-1
+#define ZIP_STORE   0
+#define ZIP_DEFLATE 8
+#define ZIP_MAX16   0xffffu     ///< entry counts at or above need the Zip64 records
+#define ZIP_MAX32   0xffffffffu ///< sizes and offsets at or above need the Zip64 records
 
-    // probe1=FRAME
-    // probe2=ASK
-    // probe3=FSK
-    // analog4=I
-    // analog5=Q
-    // analog6=AM
-    // analog7=FM
+/// An entry of the central directory, the chunks are below 4 GB but the archive may not be.
+typedef struct zip_entry {
+    char name[24];
+    uint32_t crc;
+    uint32_t csize;  ///< compressed size
+    uint32_t usize;  ///< uncompressed size
+    uint64_t offset; ///< position of the local header
+    uint16_t method;
+} zip_entry_t;
+
+/// The chunk of a channel being filled.
+typedef struct sigrok_channel {
+    uint8_t *buf;    ///< SIGROK_CHUNK_SIZE bytes, allocated on the first samples
+    size_t len;
+    unsigned chunks; ///< number of chunks written
+} sigrok_channel_t;
+
+struct sigrok_writer {
+    FILE *file;
+    uint64_t pos; ///< bytes written to the file
+    int failed;
+    uint16_t dos_time;
+    uint16_t dos_date;
+    unsigned probes;
+    unsigned analogs;
+    char *labels;               ///< the probe and analog lines of the metadata
+    sigrok_channel_t *channels; ///< the logic data, then the analog channels
+    zip_entry_t *entries;
+    size_t entries_len;
+    size_t entries_size;
+#ifdef ZLIB
+    z_stream zs;
+    int zs_ready;
+    uint8_t *zbuf;
+    size_t zbuf_size;
+#endif
+};
+
+static uint32_t crc_table[256];
 
-    // create version tag
-    FILE *fp = fopen("version", "w");
-    if (!fp) {
-        perror("creating Sigrok \"version\" file");
+static void crc_table_init(void)
+{
+    if (crc_table[1])
         return;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
     }
-    fprintf(fp, "2");
-    fclose(fp);
+}
 
-    // create meta data
-    fp = fopen("metadata", "w");
-    if (!fp) {
-        perror("creating Sigrok \"metadata\" file");
-        return;
+static uint32_t zip_crc32(uint32_t crc, uint8_t const *buf, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+        crc = crc_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint8_t *put16(uint8_t *p, unsigned v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p = put16(p, v & 0xffff);
+    return put16(p, v >> 16);
+}
+
+static uint8_t *put64(uint8_t *p, uint64_t v)
+{
+    p = put32(p, (uint32_t)v);
+    return put32(p, (uint32_t)(v >> 32));
+}
+
+static int write_bytes(sigrok_writer_t *sr, void const *buf, size_t len)
+{
+    if (sr->failed)
+        return -1;
+    if (len && fwrite(buf, 1, len, sr->file) != len) {
+        print_log(LOG_ERROR, "Sigrok", "Writing the Sigrok file failed");
+        sr->failed = 1;
+        return -1;
+    }
+    sr->pos += len;
+    return 0;
+}
+
+#ifdef ZLIB
+/// Deflate a chunk into the zlib buffer, returns the length or 0 to store the chunk.
+static size_t deflate_chunk(sigrok_writer_t *sr, uint8_t const *data, size_t len)
+{
+    if (!sr->zs_ready) {
+        // raw deflate as ZIP wants it, the fastest level as the chunks are written while demodulating
+        if (deflateInit2(&sr->zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return 0;
+        sr->zs_ready = 1;
     }
-    fprintf(fp,
-            "[device 1]\n"
-            "samplerate=%u kHz\n"
-            "capturefile=logic-1\n"
-            "unitsize=1\n"
-            "total probes=%u\n"
-            "total analog=%u\n",
-            samplerate / 1000, probes, analogs);
-    if (labels) {
-        char const **label = labels;
-        for (unsigned i = 1; i <= probes; ++i)
-            fprintf(fp, "probe%u=%s\n", i, *label++);
-        for (unsigned i = probes + 1; i <= probes + analogs; ++i)
-            fprintf(fp, "analog%u=%s\n", i, *label++);
+    else if (deflateReset(&sr->zs) != Z_OK) {
+        return 0;
     }
-    else {
-        for (unsigned i = 1; i <= probes; ++i)
-            fprintf(fp, "probe%u=L%u\n", i, i);
-        for (unsigned i = probes + 1; i <= probes + analogs; ++i)
-            fprintf(fp, "analog%u=A%u\n", i, i);
+    size_t bound = deflateBound(&sr->zs, (uLong)len);
+    if (sr->zbuf_size < bound) {
+        free(sr->zbuf);
+        sr->zbuf_size = 0;
+        sr->zbuf = malloc(bound);
+        if (!sr->zbuf) {
+            WARN_MALLOC("sigrok_writer_write()");
+            return 0;
+        }
+        sr->zbuf_size = bound;
     }
+    sr->zs.next_in   = (Bytef *)data;
+    sr->zs.avail_in  = (uInt)len;
+    sr->zs.next_out  = sr->zbuf;
+    sr->zs.avail_out = (uInt)sr->zbuf_size;
+    if (deflate(&sr->zs, Z_FINISH) != Z_STREAM_END)
+        return 0;
+    return sr->zs.total_out;
+}
+#endif
 
-    // EOF
-    fclose(fp);
-
-#ifdef _WIN32
-    STARTUPINFO si;
-    PROCESS_INFORMATION pi;
-
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    ZeroMemory(&pi, sizeof(pi));
-
-    char cmd_line[MAX_PATH] = "";
-    strcat_s(cmd_line, MAX_PATH, "7z.exe");
-    strcat_s(cmd_line, MAX_PATH, " a");
-    strcat_s(cmd_line, MAX_PATH, " -bb0 ");
-    strcat_s(cmd_line, MAX_PATH, " -sdel ");
-    strcat_s(cmd_line, MAX_PATH, " -tzip ");
-    strcat_s(cmd_line, MAX_PATH, filename);
-    strcat_s(cmd_line, MAX_PATH, " version");
-    strcat_s(cmd_line, MAX_PATH, " metadata");
-
-    if (probes) {
-        strcat_s(cmd_line, MAX_PATH, " logic-1-1");
+/// Append a file to the archive, its size and CRC are known so the local header is final.
+static int write_entry(sigrok_writer_t *sr, char const *name, uint8_t const *data, size_t len)
+{
+    if (sr->entries_len == sr->entries_size) {
+        size_t size = sr->entries_size ? sr->entries_size * 2 : 64;
+        zip_entry_t *entries = realloc(sr->entries, size * sizeof(*entries));
+        if (!entries) {
+            WARN_REALLOC("sigrok_writer_write()");
+            sr->failed = 1;
+            return -1;
+        }
+        sr->entries      = entries;
+        sr->entries_size = size;
     }
+    zip_entry_t *e = &sr->entries[sr->entries_len];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->crc    = zip_crc32(0, data, len);
+    e->csize  = (uint32_t)len;
+    e->usize  = (uint32_t)len;
+    e->offset = sr->pos;
+    e->method = ZIP_STORE;
 
-    char str_buf[64];
-    for (unsigned i = probes + 1; i <= probes + analogs; ++i) {
-        snprintf(str_buf, sizeof(str_buf), " analog-1-%u-1", i);
-        strcat_s(cmd_line, MAX_PATH, str_buf);
+    uint8_t const *out = data;
+#ifdef ZLIB
+    size_t zlen = deflate_chunk(sr, data, len);
+    if (zlen && zlen < len) {
+        out      = sr->zbuf;
+        e->csize = (uint32_t)zlen;
+        e->method = ZIP_DEFLATE;
     }
+#endif
 
-    // Start the child process.
-    if (CreateProcess(NULL,  // No module name (use command line)
-                cmd_line,     // Command line
-                NULL,        // Process handle not inheritable
-                NULL,        // Thread handle not inheritable
-                FALSE,       // Set handle inheritance to FALSE
-                0,           // No creation flags
-                NULL,        // Use parent's environment block
-                NULL,        // Use parent's starting directory
-                &si,         // Pointer to STARTUPINFO structure
-                &pi)         // Pointer to PROCESS_INFORMATION structure
-    ) {
-        // Wait until child process exits.
-        WaitForSingleObject(pi.hProcess, INFINITE);
-
-        DWORD exit_code;
-
-        if (FALSE == GetExitCodeProcess(pi.hProcess, &exit_code)) {
-            perror("GetExitCodeProcess() failure");
-        }
+    size_t name_len = strlen(e->name);
+    uint8_t hdr[30];
+    uint8_t *p = hdr;
+    p = put32(p, 0x04034b50); // local file header
+    p = put16(p, 20);         // version needed, 2.0
+    p = put16(p, 0);          // flags
+    p = put16(p, e->method);
+    p = put16(p, sr->dos_time);
+    p = put16(p, sr->dos_date);
+    p = put32(p, e->crc);
+    p = put32(p, e->csize);
+    p = put32(p, e->usize);
+    p = put16(p, (unsigned)name_len);
+    put16(p, 0);              // extra field length
+    if (write_bytes(sr, hdr, sizeof(hdr))
+            || write_bytes(sr, e->name, name_len)
+            || write_bytes(sr, out, e->csize))
+        return -1;
+    sr->entries_len++;
+    return 0;
+}
 
-        // Close process and thread handles.
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
+static int flush_channel(sigrok_writer_t *sr, unsigned channel)
+{
+    sigrok_channel_t *ch = &sr->channels[channel];
+    char name[24];
+    if (channel == 0)
+        snprintf(name, sizeof(name), "logic-1-%u", ch->chunks + 1);
+    else
+        snprintf(name, sizeof(name), "analog-1-%u-%u", sr->probes + channel, ch->chunks + 1);
+    ch->chunks++;
+    int r   = write_entry(sr, name, ch->buf, ch->len);
+    ch->len = 0;
+    return r;
+}
 
-        if (exit_code != 0) {
-            perror("7z.exe execution failed");
-            return;
-        }
+sigrok_writer_t *sigrok_writer_create(char const *filename, unsigned probes, unsigned analogs, char const *labels[])
+{
+    // e.g. uses channels
+    // probe1=FRAME
+    // probe2=ASK
+    // probe3=FSK
+    // analog4=I
+    // analog5=Q
+    // analog6=AM
+    // analog7=FM
+
+    sigrok_writer_t *sr = calloc(1, sizeof(*sr));
+    if (!sr) {
+        WARN_CALLOC("sigrok_writer_create()");
+        return NULL;
     }
-    else {
-        perror("CreateProcess for 7z.exe failed.");
-        return;
+    sr->probes  = probes;
+    sr->analogs = analogs;
+    sr->channels = calloc(1 + analogs, sizeof(*sr->channels));
+    if (!sr->channels) {
+        WARN_CALLOC("sigrok_writer_create()");
+        sigrok_writer_free(sr);
+        return NULL;
     }
 
-#else
-    char *argv[30] = {0};
-    int arg        = 0;
-    argv[arg++]    = "zip";
-    argv[arg++]    = (char *)filename; // "out.sr"
-    argv[arg++]    = "version";
-    argv[arg++]    = "metadata";
-
-    if (probes) {
-        argv[arg++] = "logic-1-1";
+    size_t size = 1;
+    for (unsigned i = 0; i < probes + analogs; ++i)
+        size += 24 + (labels ? strlen(labels[i]) : 0);
+    sr->labels = malloc(size);
+    if (!sr->labels) {
+        WARN_MALLOC("sigrok_writer_create()");
+        sigrok_writer_free(sr);
+        return NULL;
     }
-
-    char *argv_dups[30] = {0}; // store only dups to help the checker match the free()
-    char **argv_analog = &argv[arg];
-    char str_buf[64];
-    for (unsigned i = probes + 1; i <= probes + analogs; ++i) {
-        snprintf(str_buf, sizeof(str_buf), "analog-1-%u-1", i);
-        char* dup = strdup(str_buf);
-        if (!dup) {
-            FATAL_STRDUP("write_sigrok()");
-        }
-        argv[arg++] = dup;
-        argv_dups[arg++] = dup;
+    size_t len    = 0;
+    sr->labels[0] = '\0';
+    for (unsigned i = 1; i <= probes + analogs; ++i) {
+        char const *kind = i <= probes ? "probe" : "analog";
+        if (labels)
+            len += snprintf(sr->labels + len, size - len, "%s%u=%s\n", kind, i, labels[i - 1]);
+        else
+            len += snprintf(sr->labels + len, size - len, "%s%u=%c%u\n", kind, i, i <= probes ? 'L' : 'A', i);
     }
 
-    int status = 0;
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("forking zip");
+    time_t now = time(NULL);
+    struct tm tm_info;
+#ifdef _WIN32
+    localtime_s(&tm_info, &now);
+#else
+    localtime_r(&now, &tm_info);
+#endif
+    sr->dos_time = (uint16_t)(tm_info.tm_hour << 11 | tm_info.tm_min << 5 | tm_info.tm_sec / 2);
+    sr->dos_date = (uint16_t)((tm_info.tm_year - 80) << 9 | (tm_info.tm_mon + 1) << 5 | tm_info.tm_mday);
+
+    crc_table_init();
+
+    sr->file = fopen(filename, "wb");
+    if (!sr->file) {
+        perror("creating Sigrok file");
+        sigrok_writer_free(sr);
+        return NULL;
     }
-    else if (pid == 0) {
-        // child process because return value zero
-        execvp(argv[0], argv);
-        // execvp() returns only on error
-        for (int i = 0; i < arg; ++i) {
-            fprintf(stderr, "%s ", argv[i]);
-        }
-        fprintf(stderr, "\n");
-        perror("execvp");
-        exit(1);
+    if (write_entry(sr, "version", (uint8_t const *)"2", 1)) {
+        sigrok_writer_free(sr);
+        return NULL;
     }
-    else {
-        // parent process because return value non-zero
-        wait(&status);
-        if (WIFEXITED(status)) {
-            if (WEXITSTATUS(status)) {
-                fprintf(stderr, "zip exited with status: %d\n", WEXITSTATUS(status));
+    return sr;
+}
+
+int sigrok_writer_write(sigrok_writer_t *sr, unsigned channel, void const *buf, size_t len)
+{
+    if (channel > sr->analogs || (channel == 0 && !sr->probes))
+        return -1;
+    sigrok_channel_t *ch = &sr->channels[channel];
+    uint8_t const *p     = buf;
+    while (len) {
+        if (!ch->buf) {
+            ch->buf = malloc(SIGROK_CHUNK_SIZE);
+            if (!ch->buf) {
+                WARN_MALLOC("sigrok_writer_write()");
+                return -1;
             }
         }
+        size_t n = SIGROK_CHUNK_SIZE - ch->len;
+        if (n > len)
+            n = len;
+        memcpy(ch->buf + ch->len, p, n);
+        ch->len += n;
+        p += n;
+        len -= n;
+        if (ch->len == SIGROK_CHUNK_SIZE && flush_channel(sr, channel))
+            return -1;
     }
+    return sr->failed ? -1 : 0;
+}
 
-    // rm version metadata logic-1-1 analog-1-4-1 analog-1-5-1 analog-1-6-1 analog-1-7-1
-    if (unlink("version")) {
-        perror("unlinking Sigrok \"version\" file");
+/// Write the central directory and its end record, with the Zip64 records if needed.
+static int write_directory(sigrok_writer_t *sr)
+{
+    uint64_t cd_offset = sr->pos;
+    for (size_t i = 0; i < sr->entries_len; ++i) {
+        zip_entry_t const *e = &sr->entries[i];
+        int zip64       = e->offset >= ZIP_MAX32;
+        size_t name_len = strlen(e->name);
+        uint8_t hdr[46 + 12];
+        uint8_t *p = hdr;
+        p = put32(p, 0x02014b50); // central directory header
+        p = put16(p, 45);         // version made by, 4.5 with MS-DOS attributes
+        p = put16(p, zip64 ? 45 : 20);
+        p = put16(p, 0);          // flags
+        p = put16(p, e->method);
+        p = put16(p, sr->dos_time);
+        p = put16(p, sr->dos_date);
+        p = put32(p, e->crc);
+        p = put32(p, e->csize);
+        p = put32(p, e->usize);
+        p = put16(p, (unsigned)name_len);
+        p = put16(p, zip64 ? 12 : 0); // extra field length
+        p = put16(p, 0);          // comment length
+        p = put16(p, 0);          // disk number
+        p = put16(p, 0);          // internal attributes
+        p = put32(p, 0);          // external attributes
+        p = put32(p, zip64 ? ZIP_MAX32 : (uint32_t)e->offset);
+        if (write_bytes(sr, hdr, 46) || write_bytes(sr, e->name, name_len))
+            return -1;
+        if (zip64) {
+            p = put16(p, 0x0001); // Zip64 extended information
+            p = put16(p, 8);
+            put64(p, e->offset);
+            if (write_bytes(sr, hdr + 46, 12))
+                return -1;
+        }
     }
-    if (unlink("metadata")) {
-        perror("unlinking Sigrok \"metadata\" file");
+    uint64_t cd_size = sr->pos - cd_offset;
+    uint64_t count   = sr->entries_len;
+
+    if (count >= ZIP_MAX16 || cd_offset >= ZIP_MAX32 || cd_size >= ZIP_MAX32) {
+        uint64_t eocd64_offset = sr->pos;
+        uint8_t rec[56 + 20];
+        uint8_t *p = rec;
+        p = put32(p, 0x06064b50); // Zip64 end of central directory record
+        p = put64(p, 44);         // size of the remaining record
+        p = put16(p, 45);
+        p = put16(p, 45);
+        p = put32(p, 0);
+        p = put32(p, 0);
+        p = put64(p, count);
+        p = put64(p, count);
+        p = put64(p, cd_size);
+        p = put64(p, cd_offset);
+        p = put32(p, 0x07064b50); // Zip64 end of central directory locator
+        p = put32(p, 0);
+        p = put64(p, eocd64_offset);
+        put32(p, 1);              // total number of disks
+        if (write_bytes(sr, rec, sizeof(rec)))
+            return -1;
     }
 
-    if (probes) {
-        if (unlink("logic-1-1")) {
-            perror("unlinking Sigrok \"logic-1-1\" file");
-        }
+    uint8_t eocd[22];
+    uint8_t *p = eocd;
+    p = put32(p, 0x06054b50); // end of central directory record
+    p = put16(p, 0);
+    p = put16(p, 0);
+    p = put16(p, count >= ZIP_MAX16 ? ZIP_MAX16 : (unsigned)count);
+    p = put16(p, count >= ZIP_MAX16 ? ZIP_MAX16 : (unsigned)count);
+    p = put32(p, cd_size >= ZIP_MAX32 ? ZIP_MAX32 : (uint32_t)cd_size);
+    p = put32(p, cd_offset >= ZIP_MAX32 ? ZIP_MAX32 : (uint32_t)cd_offset);
+    put16(p, 0);              // comment length
+    return write_bytes(sr, eocd, sizeof(eocd));
+}
+
+int sigrok_writer_finish(sigrok_writer_t *sr, unsigned samplerate)
+{
+    if (!sr->file)
+        return -1;
+
+    // each channel has at least one chunk, even if empty
+    for (unsigned c = sr->probes ? 0 : 1; c <= sr->analogs; ++c) {
+        if (sr->channels[c].len || !sr->channels[c].chunks)
+            flush_channel(sr, c);
     }
-    for (unsigned i = 0; i < analogs && argv_analog[i]; ++i) {
-        if (unlink(argv_analog[i])) {
-            perror("unlinking Sigrok \"analog-1-N-1\" file");
-        }
+
+    size_t size = strlen(sr->labels) + 160;
+    char *metadata = malloc(size);
+    if (!metadata) {
+        WARN_MALLOC("sigrok_writer_finish()");
+        sr->failed = 1;
+    }
+    else {
+        int len = snprintf(metadata, size,
+                "[device 1]\n"
+                "samplerate=%u kHz\n"
+                "capturefile=logic-1\n"
+                "unitsize=1\n"
+                "total probes=%u\n"
+                "total analog=%u\n"
+                "%s",
+                samplerate / 1000, sr->probes, sr->analogs, sr->labels);
+        write_entry(sr, "metadata", (uint8_t const *)metadata, (size_t)len);
+        free(metadata);
     }
-    for (int i = 0; i < arg; ++i) {
-        free(argv_dups[i]);
+
+    write_directory(sr);
+    if (fclose(sr->file) && !sr->failed) {
+        perror("closing Sigrok file");
+        sr->failed = 1;
     }
+    sr->file = NULL;
+    return sr->failed ? -1 : 0;
+}
 
-#endif // !_WIN32
+void sigrok_writer_free(sigrok_writer_t *sr)
+{
+    if (!sr)
+        return;
+    if (sr->file)
+        fclose(sr->file);
+    for (unsigned c = 0; sr->channels && c <= sr->analogs; ++c)
+        free(sr->channels[c].buf);
+    free(sr->channels);
+    free(sr->entries);
+    free(sr->labels);
+#ifdef ZLIB
+    if (sr->zs_ready)
+        deflateEnd(&sr->zs);
+    free(sr->zbuf);
+#endif
+    free(sr);
 }
 
 void open_pulseview(char const *filename)
@@ -274,3 +513,88 @@ void open_pulseview(char const *filename)
     free(abspath);
 #endif
 }
+
+#ifdef _TEST
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %u <> %u\n", (unsigned)(a), (unsigned)(b)); \
+        } \
+    } while (0)
+
+static unsigned get16(uint8_t const *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(uint8_t const *p)
+{
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "write_sigrok:: crc32\n");
+    crc_table_init();
+    ASSERT_EQUALS(zip_crc32(0, (uint8_t const *)"123456789", 9), 0xcbf43926u);
+
+    fprintf(stderr, "write_sigrok:: write chunks\n");
+    char const *path = "test_write_sigrok.sr";
+    sigrok_writer_t *sr = sigrok_writer_create(path, 3, 1, NULL);
+    ASSERT_EQUALS(sr != NULL, 1);
+    static uint8_t logic[SIGROK_CHUNK_SIZE / 2];
+    for (size_t i = 0; i < sizeof(logic); ++i)
+        logic[i] = (i / 100) & 0x7;
+    float analog[100] = {0.5f};
+    ASSERT_EQUALS(sigrok_writer_write(sr, 0, logic, sizeof(logic)), 0);
+    ASSERT_EQUALS(sigrok_writer_write(sr, 0, logic, sizeof(logic)), 0);
+    ASSERT_EQUALS(sigrok_writer_write(sr, 0, logic, 10), 0);
+    ASSERT_EQUALS(sigrok_writer_write(sr, 1, analog, sizeof(analog)), 0);
+    ASSERT_EQUALS(sigrok_writer_write(sr, 2, analog, sizeof(analog)), -1);
+    ASSERT_EQUALS(sigrok_writer_finish(sr, 250000), 0);
+    sigrok_writer_free(sr);
+
+    fprintf(stderr, "write_sigrok:: read the directory\n");
+    FILE *fp = fopen(path, "rb");
+    ASSERT_EQUALS(fp != NULL, 1);
+    static uint8_t buf[2 * SIGROK_CHUNK_SIZE];
+    size_t len = fp ? fread(buf, 1, sizeof(buf), fp) : 0;
+    if (fp)
+        fclose(fp);
+    remove(path);
+    ASSERT_EQUALS(len > 22, 1);
+    if (len > 22) {
+        uint8_t const *eocd = buf + len - 22;
+        ASSERT_EQUALS(get32(buf), 0x04034b50u);
+        ASSERT_EQUALS(get32(eocd), 0x06054b50u);
+        // version, logic-1-1, logic-1-2, analog-1-4-1, metadata
+        ASSERT_EQUALS(get16(eocd + 10), 5);
+        uint8_t const *cd = buf + get32(eocd + 16);
+        char const *names[] = {"version", "logic-1-1", "logic-1-2", "analog-1-4-1", "metadata"};
+        uint32_t sizes[]    = {1, SIGROK_CHUNK_SIZE, 10, sizeof(analog), 0};
+        for (int i = 0; i < 5 && cd + 46 <= eocd; ++i) {
+            unsigned name_len = get16(cd + 28);
+            ASSERT_EQUALS(get32(cd), 0x02014b50u);
+            ASSERT_EQUALS(name_len == strlen(names[i]) && !memcmp(cd + 46, names[i], name_len), 1);
+            if (sizes[i])
+                ASSERT_EQUALS(get32(cd + 24), sizes[i]);
+            // the local header repeats the name in front of the data
+            uint8_t const *local = buf + get32(cd + 42);
+            ASSERT_EQUALS(get32(local), 0x04034b50u);
+            ASSERT_EQUALS(!memcmp(local + 30, names[i], name_len), 1);
+            cd += 46 + name_len + get16(cd + 30) + get16(cd + 32);
+        }
+    }
+
+    fprintf(stderr, "write_sigrok:: %u passed, %u failed\n", passed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
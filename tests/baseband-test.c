@@ -3,6 +3,10 @@
  *
  * Functional and speed test for various baseband functions.
  *
+ * Without arguments only the SIMD kernels are checked against the scalar
+ * code, as run by ctest. With "-b" the kernels are also benchmarked, with
+ * an input file the kernels are checked, benchmarked, and timed on it.
+ *
  * Copyright (C) 2018 by Christian Zuckschwerdt <zany@triq.net>
  *
  * This program is free software; you can redistribute it and/or modify
@@ -32,7 +36,9 @@ typedef SSIZE_T ssize_t;
 #include <unistd.h>
 #endif
 
+#include <string.h>
 #include <time.h>
+#include <math.h>
 
 #include "fatal.h"
 #include "baseband.h"
@@ -46,6 +52,335 @@ typedef SSIZE_T ssize_t;
         printf("Time elapsed in ms: %f for: %s\n", elapsed, label);        \
     } while (0)
 
+/// Run a kernel @p reps times over @p n_samples and print the throughput in MSps.
+#define BENCHMARK(label, n_samples, reps, block)                                    \
+    do {                                                                            \
+        clock_t start = clock();                                                    \
+        for (int rep = 0; rep < (reps); ++rep) {                                    \
+            block;                                                                  \
+        }                                                                           \
+        clock_t stop   = clock();                                                   \
+        double elapsed = (double)(stop - start) / CLOCKS_PER_SEC;                   \
+        double msps    = elapsed > 0 ? (double)(n_samples) * (reps) / elapsed / 1e6 : 0; \
+        printf("%-20s %-6s %10.1f MSps\n", label, baseband_simd_name(baseband_get_simd()), msps); \
+    } while (0)
+
+/// Compare all SIMD kernels against the scalar code, report the throughput if @p bench is set.
+static int check_simd_kernels(uint8_t const *cu8_buf, int16_t const *cs16_buf, unsigned long n_samples, int bench)
+{
+    int failed = 0;
+    int reps = n_samples ? (int)(16000000 / n_samples) + 1 : 1;
+    uint16_t *ref_buf = malloc(sizeof(uint16_t) * 3 * n_samples);
+    if (!ref_buf) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+    uint16_t *out_buf = malloc(sizeof(uint16_t) * n_samples);
+    if (!out_buf) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+
+    baseband_set_simd(BASEBAND_SIMD_NONE);
+    float ref_db[3];
+    ref_db[0] = envelope_detect(cu8_buf, &ref_buf[0 * n_samples], n_samples);
+    ref_db[1] = magnitude_est_cu8(cu8_buf, &ref_buf[1 * n_samples], n_samples);
+    ref_db[2] = magnitude_est_cs16(cs16_buf, &ref_buf[2 * n_samples], n_samples);
+    filter_state_t lp_ref_state = {{0}, {0}};
+    uint16_t *lp_ref = malloc(sizeof(uint16_t) * n_samples);
+    if (!lp_ref) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+    baseband_low_pass_filter(&ref_buf[0], (int16_t *)lp_ref, n_samples, &lp_ref_state);
+    demodfm_state_t fm_ref_state = {0};
+    fm_ref_state.poly = 1;
+    int16_t *fm_ref = malloc(sizeof(int16_t) * n_samples);
+    if (!fm_ref) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+    baseband_demod_FM(cu8_buf, fm_ref, n_samples, 250000, 0.1f, &fm_ref_state);
+    decimator_state_t decim_ref_state;
+    baseband_decimator_init(&decim_ref_state, 5);
+    int16_t *decim_ref = malloc(sizeof(int16_t) * 2 * n_samples);
+    if (!decim_ref) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+    uint32_t decim_ref_len = baseband_decimate_cs16(cs16_buf, decim_ref, n_samples, &decim_ref_state);
+    // a channel is mixed to DC ahead of the decimator
+    int16_t *mix_ref = malloc(sizeof(int16_t) * 2 * n_samples);
+    if (!mix_ref) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+    uint8_t *mix_ref_cu8 = malloc(sizeof(uint8_t) * 2 * n_samples);
+    if (!mix_ref_cu8) {
+        FATAL_MALLOC("check_simd_kernels()");
+    }
+    baseband_decimator_init(&decim_ref_state, 4);
+    baseband_decimator_set_shift(&decim_ref_state, -123457, 1000000);
+    uint32_t mix_ref_len = baseband_decimate_cs16(cs16_buf, mix_ref, n_samples, &decim_ref_state);
+    baseband_decimator_init(&decim_ref_state, 4);
+    baseband_decimator_set_shift(&decim_ref_state, 123457, 1000000);
+    uint32_t mix_ref_cu8_len = baseband_decimate_cu8(cu8_buf, mix_ref_cu8, n_samples, &decim_ref_state);
+
+    // unity DC gain, the output settles to the input
+    for (int16_t dc = -32768; dc < 32767 - 4096; dc += 4096) {
+        int16_t dc_buf[2 * 512];
+        for (int k = 0; k < 2 * 512; ++k)
+            dc_buf[k] = dc;
+        decimator_state_t dc_state;
+        baseband_decimator_init(&dc_state, 4);
+        uint32_t m = baseband_decimate_cs16(dc_buf, dc_buf, 512, &dc_state);
+        if (m != 128 || dc_buf[2 * m - 2] != dc || dc_buf[2 * m - 1] != dc) {
+            fprintf(stderr, "decimator DC gain mismatch at %d: %d\n", dc, dc_buf[2 * m - 2]);
+            failed = 1;
+        }
+    }
+
+    // the mixer moves a tone at the channel offset to DC
+    {
+        uint8_t tone_buf[2 * 2048];
+        for (int k = 0; k < 2048; ++k) {
+            double phi = 2.0 * M_PI * 100000.0 * k / 1000000.0;
+            tone_buf[2 * k]     = (uint8_t)lrint(128.0 + 100.0 * cos(phi));
+            tone_buf[2 * k + 1] = (uint8_t)lrint(128.0 + 100.0 * sin(phi));
+        }
+        decimator_state_t tone_state;
+        baseband_decimator_init(&tone_state, 4);
+        baseband_decimator_set_shift(&tone_state, 100000, 1000000);
+        uint32_t m = baseband_decimate_cu8(tone_buf, tone_buf, 2048, &tone_state);
+        int i = tone_buf[2 * m - 2] - 128;
+        int q = tone_buf[2 * m - 1] - 128;
+        if (m != 512 || abs(i - 100) > 2 || abs(q) > 2) {
+            fprintf(stderr, "decimator mixer mismatch: %d %d\n", i, q);
+            failed = 1;
+        }
+    }
+
+    for (int simd = BASEBAND_SIMD_NONE; simd <= BASEBAND_SIMD_NEON; ++simd) {
+        if (baseband_set_simd((baseband_simd_t)simd) < 0)
+            continue;
+        // odd lengths exercise the scalar tail
+        for (unsigned long len = n_samples < 37 ? n_samples : n_samples - 37; len <= n_samples; len += 37) {
+            for (int k = 0; k < 3; ++k) {
+                float db = k == 0 ? envelope_detect(cu8_buf, out_buf, len)
+                        : k == 1  ? magnitude_est_cu8(cu8_buf, out_buf, len)
+                                  : magnitude_est_cs16(cs16_buf, out_buf, len);
+                if (memcmp(out_buf, &ref_buf[k * n_samples], sizeof(uint16_t) * len)
+                        || (len == n_samples && db != ref_db[k])) {
+                    fprintf(stderr, "%s kernel %d mismatch at length %lu\n", baseband_simd_name((baseband_simd_t)simd), k, len);
+                    failed = 1;
+                }
+            }
+            if (len == n_samples)
+                break;
+        }
+        // the block low pass may differ by 1 LSB at the segment starts
+        filter_state_t state = {{0}, {0}};
+        int16_t *lp_buf = (int16_t *)out_buf;
+        uint16_t const *am_buf = &ref_buf[0 * n_samples];
+        baseband_low_pass_filter(am_buf, lp_buf, n_samples, &state);
+        for (unsigned long i = 0; i < n_samples; ++i) {
+            if (abs(lp_buf[i] - (int16_t)lp_ref[i]) > 1) {
+                fprintf(stderr, "%s low pass mismatch at %lu: %d %d\n", baseband_simd_name((baseband_simd_t)simd), i, lp_buf[i], (int16_t)lp_ref[i]);
+                failed = 1;
+                break;
+            }
+        }
+        if (state.x[0] != lp_ref_state.x[0] || abs(state.y[0] - lp_ref_state.y[0]) > 1) {
+            fprintf(stderr, "%s low pass state mismatch\n", baseband_simd_name((baseband_simd_t)simd));
+            failed = 1;
+        }
+        // filtering in place gives the same output and state, also on a short scalar tail
+        {
+            uint16_t *inplace_buf = malloc(sizeof(uint16_t) * n_samples);
+            if (!inplace_buf) {
+                FATAL_MALLOC("check_simd_kernels()");
+            }
+            memcpy(inplace_buf, am_buf, sizeof(uint16_t) * n_samples);
+            filter_state_t inplace_state = {{0}, {0}};
+            unsigned long head = n_samples > 100 ? n_samples - 100 : n_samples;
+            baseband_low_pass_filter(inplace_buf, (int16_t *)inplace_buf, head, &inplace_state);
+            baseband_low_pass_filter(&inplace_buf[head], (int16_t *)&inplace_buf[head], n_samples - head, &inplace_state);
+            state = (filter_state_t){{0}, {0}};
+            baseband_low_pass_filter(am_buf, lp_buf, head, &state);
+            baseband_low_pass_filter(&am_buf[head], &lp_buf[head], n_samples - head, &state);
+            if (memcmp(inplace_buf, lp_buf, sizeof(int16_t) * n_samples)
+                    || inplace_state.x[0] != state.x[0] || inplace_state.y[0] != state.y[0]) {
+                fprintf(stderr, "%s low pass in place mismatch\n", baseband_simd_name((baseband_simd_t)simd));
+                failed = 1;
+            }
+            free(inplace_buf);
+        }
+
+        // the polynomial discriminator is exact, also across buffers of odd length
+        demodfm_state_t fm_state = {0};
+        fm_state.poly = 1;
+        int16_t *fm_buf = (int16_t *)out_buf;
+        unsigned long split = n_samples / 3 | 1;
+        baseband_demod_FM(cu8_buf, fm_buf, split, 250000, 0.1f, &fm_state);
+        baseband_demod_FM(&cu8_buf[2 * split], &fm_buf[split], n_samples - split, 250000, 0.1f, &fm_state);
+        if (memcmp(fm_buf, fm_ref, sizeof(int16_t) * n_samples) || fm_state.yf != fm_ref_state.yf) {
+            fprintf(stderr, "%s FM poly mismatch\n", baseband_simd_name((baseband_simd_t)simd));
+            failed = 1;
+        }
+
+        // the decimator is exact, also across buffers of odd length and in place
+        decimator_state_t decim_state;
+        baseband_decimator_init(&decim_state, 5);
+        int16_t *decim_buf = malloc(sizeof(int16_t) * 2 * n_samples);
+        if (!decim_buf) {
+            FATAL_MALLOC("check_simd_kernels()");
+        }
+        memcpy(decim_buf, cs16_buf, sizeof(int16_t) * 2 * n_samples);
+        uint32_t decim_len = baseband_decimate_cs16(decim_buf, decim_buf, split, &decim_state);
+        decim_len += baseband_decimate_cs16(&cs16_buf[2 * split], &decim_buf[2 * decim_len], n_samples - split, &decim_state);
+        if (decim_len != decim_ref_len || memcmp(decim_buf, decim_ref, sizeof(int16_t) * 2 * decim_len)) {
+            fprintf(stderr, "%s decimator mismatch\n", baseband_simd_name((baseband_simd_t)simd));
+            failed = 1;
+        }
+
+        // the mixer is exact, also across buffers of odd length
+        baseband_decimator_init(&decim_state, 4);
+        baseband_decimator_set_shift(&decim_state, -123457, 1000000);
+        decim_len = baseband_decimate_cs16(cs16_buf, decim_buf, split, &decim_state);
+        decim_len += baseband_decimate_cs16(&cs16_buf[2 * split], &decim_buf[2 * decim_len], n_samples - split, &decim_state);
+        if (decim_len != mix_ref_len || memcmp(decim_buf, mix_ref, sizeof(int16_t) * 2 * decim_len)) {
+            fprintf(stderr, "%s mixer cs16 mismatch\n", baseband_simd_name((baseband_simd_t)simd));
+            failed = 1;
+        }
+        uint8_t *mix_cu8 = (uint8_t *)decim_buf;
+        baseband_decimator_init(&decim_state, 4);
+        baseband_decimator_set_shift(&decim_state, 123457, 1000000);
+        decim_len = baseband_decimate_cu8(cu8_buf, mix_cu8, split, &decim_state);
+        decim_len += baseband_decimate_cu8(&cu8_buf[2 * split], &mix_cu8[2 * decim_len], n_samples - split, &decim_state);
+        if (decim_len != mix_ref_cu8_len || memcmp(mix_cu8, mix_ref_cu8, 2 * decim_len)) {
+            fprintf(stderr, "%s mixer cu8 mismatch\n", baseband_simd_name((baseband_simd_t)simd));
+            failed = 1;
+        }
+        free(decim_buf);
+
+        // the fused demod runs the same kernels block-wise
+        filter_state_t lp_sep = {{0}, {0}};
+        filter_state_t lp_fused = {{0}, {0}};
+        demodfm_state_t fm_sep = {0};
+        demodfm_state_t fm_fused = {0};
+        int16_t *am_sep = malloc(sizeof(int16_t) * n_samples);
+        if (!am_sep) {
+            FATAL_MALLOC("check_simd_kernels()");
+        }
+        int16_t *fm_sep_buf = malloc(sizeof(int16_t) * n_samples);
+        if (!fm_sep_buf) {
+            FATAL_MALLOC("check_simd_kernels()");
+        }
+        int16_t *fm_fused_buf = malloc(sizeof(int16_t) * n_samples);
+        if (!fm_fused_buf) {
+            FATAL_MALLOC("check_simd_kernels()");
+        }
+        envelope_detect(cu8_buf, out_buf, n_samples);
+        baseband_low_pass_filter(out_buf, am_sep, n_samples, &lp_sep);
+        baseband_demod_FM(cu8_buf, fm_sep_buf, n_samples, 250000, 0.1f, &fm_sep);
+        baseband_demod_fused_cu8(cu8_buf, lp_buf, fm_fused_buf, n_samples, 0, &lp_fused, 250000, 0.1f, &fm_fused);
+        for (unsigned long i = 0; i < n_samples; ++i) {
+            if (abs(lp_buf[i] - am_sep[i]) > 1 || fm_fused_buf[i] != fm_sep_buf[i]) {
+                fprintf(stderr, "%s fused demod mismatch at %lu\n", baseband_simd_name((baseband_simd_t)simd), i);
+                failed = 1;
+                break;
+            }
+        }
+
+        // the float conversions are exact, also on the scalar tail and strided
+        float *f32_buf = malloc(sizeof(float) * 2 * n_samples);
+        if (!f32_buf) {
+            FATAL_MALLOC("check_simd_kernels()");
+        }
+        unsigned long odd = n_samples * 2 - 3;
+        baseband_convert_cu8_f32(cu8_buf, f32_buf, odd, 1);
+        for (unsigned long i = 0; i < odd; ++i) {
+            if (f32_buf[i] != (cu8_buf[i] - 128) / 128.0f) {
+                fprintf(stderr, "%s convert_cu8_f32 mismatch at %lu\n", baseband_simd_name((baseband_simd_t)simd), i);
+                failed = 1;
+                break;
+            }
+        }
+        baseband_convert_s16_f32(cs16_buf, f32_buf, odd, 1);
+        for (unsigned long i = 0; i < odd; ++i) {
+            if (f32_buf[i] != cs16_buf[i] / 32768.0f) {
+                fprintf(stderr, "%s convert_s16_f32 mismatch at %lu\n", baseband_simd_name((baseband_simd_t)simd), i);
+                failed = 1;
+                break;
+            }
+        }
+        baseband_convert_s16_f32(cs16_buf + 1, f32_buf, n_samples, 2);
+        for (unsigned long i = 0; i < n_samples; ++i) {
+            if (f32_buf[i] != cs16_buf[i * 2 + 1] / 32768.0f) {
+                fprintf(stderr, "%s convert_s16_f32 stride mismatch at %lu\n", baseband_simd_name((baseband_simd_t)simd), i);
+                failed = 1;
+                break;
+            }
+        }
+
+        if (bench) {
+            BENCHMARK("envelope_detect", n_samples, reps,
+                envelope_detect(cu8_buf, out_buf, n_samples);
+            );
+            BENCHMARK("magnitude_est_cu8", n_samples, reps,
+                magnitude_est_cu8(cu8_buf, out_buf, n_samples);
+            );
+            BENCHMARK("magnitude_est_cs16", n_samples, reps,
+                magnitude_est_cs16(cs16_buf, out_buf, n_samples);
+            );
+            BENCHMARK("low_pass_filter", n_samples, reps,
+                baseband_low_pass_filter(am_buf, lp_buf, n_samples, &state);
+            );
+            BENCHMARK("demod_FM_cu8", n_samples, reps,
+                baseband_demod_FM(cu8_buf, fm_sep_buf, n_samples, 250000, 0.1f, &fm_sep);
+            );
+            BENCHMARK("demod_FM_poly_cu8", n_samples, reps,
+                baseband_demod_FM(cu8_buf, fm_sep_buf, n_samples, 250000, 0.1f, &fm_state);
+            );
+            baseband_decimator_init(&decim_state, 4);
+            BENCHMARK("decimate_4_cu8", n_samples, reps,
+                baseband_decimate_cu8(cu8_buf, (uint8_t *)fm_sep_buf, n_samples, &decim_state);
+            );
+            baseband_decimator_set_shift(&decim_state, 123457, 1000000);
+            BENCHMARK("decimate_4_mix_cu8", n_samples, reps,
+                baseband_decimate_cu8(cu8_buf, (uint8_t *)fm_sep_buf, n_samples, &decim_state);
+            );
+            BENCHMARK("separate_am_fm_cu8", n_samples, reps,
+                envelope_detect(cu8_buf, out_buf, n_samples);
+                baseband_low_pass_filter(out_buf, am_sep, n_samples, &lp_sep);
+                baseband_demod_FM(cu8_buf, fm_sep_buf, n_samples, 250000, 0.1f, &fm_sep);
+            );
+            BENCHMARK("fused_am_fm_cu8", n_samples, reps,
+                baseband_demod_fused_cu8(cu8_buf, lp_buf, fm_fused_buf, n_samples, 0, &lp_fused, 250000, 0.1f, &fm_fused);
+            );
+            BENCHMARK("convert_cu8_cf32", n_samples, reps,
+                baseband_convert_cu8_f32(cu8_buf, f32_buf, n_samples * 2, 1);
+            );
+            BENCHMARK("convert_cs16_cf32", n_samples, reps,
+                baseband_convert_s16_f32(cs16_buf, f32_buf, n_samples * 2, 1);
+            );
+            BENCHMARK("convert_cu8_cs16", n_samples, reps,
+                baseband_convert_cu8_cs16(cu8_buf, (int16_t *)f32_buf, n_samples * 2);
+            );
+        }
+        free(f32_buf);
+        free(am_sep);
+        free(fm_sep_buf);
+        free(fm_fused_buf);
+    }
+
+    baseband_set_simd(BASEBAND_SIMD_NONE);
+    baseband_init(); // restore the default kernels
+
+    free(decim_ref);
+    free(mix_ref);
+    free(mix_ref_cu8);
+    free(fm_ref);
+    free(lp_ref);
+    free(ref_buf);
+    free(out_buf);
+    return failed;
+}
+
 static int read_buf(const char *filename, void *buf, size_t nbyte)
 {
     int fd = open(filename, O_RDONLY);
@@ -89,8 +424,36 @@ int main(int argc, char *argv[])
     filter_state_t state;
     demodfm_state_t fm_state;
 
-    if (argc <= 1) {
-        return 1;
+    int bench = argc > 1 && !strcmp(argv[1], "-b");
+    if (argc <= 1 || bench) {
+        // no input file, check and maybe benchmark the SIMD kernels on synthetic data
+        n_samples = 1 << 18;
+        cu8_buf  = malloc(sizeof(uint8_t) * 2 * n_samples);
+        if (!cu8_buf) {
+            FATAL_MALLOC("main()");
+        }
+        cs16_buf = malloc(sizeof(int16_t) * 2 * n_samples);
+        if (!cs16_buf) {
+            FATAL_MALLOC("main()");
+        }
+        srand(1);
+        for (unsigned long i = 0; i < n_samples * 2; i++) {
+            cu8_buf[i]  = (uint8_t)rand();
+            cs16_buf[i] = (int16_t)(rand() ^ (rand() << 8));
+        }
+        // include the extreme values
+        cu8_buf[0]  = 0;
+        cu8_buf[1]  = 255;
+        cu8_buf[2]  = 255;
+        cu8_buf[3]  = 0;
+        cs16_buf[0] = -32768;
+        cs16_buf[1] = 32767;
+        cs16_buf[2] = -32768;
+        cs16_buf[3] = -32768;
+        int failed = check_simd_kernels(cu8_buf, cs16_buf, n_samples, bench);
+        free(cu8_buf);
+        free(cs16_buf);
+        return failed;
     }
     filename = argv[1];
 
@@ -142,6 +505,8 @@ int main(int argc, char *argv[])
         //cs16_buf[i] = (int16_t)cu8_buf[i] * 256 - 32640;
     }
 
+    check_simd_kernels(cu8_buf, cs16_buf, n_samples, 1);
+
     MEASURE("envelope_detect",
         envelope_detect(cu8_buf, y16_buf, n_samples);
     );
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+
+"""Benchmark the decoding of a corpus of reference signals and check the results.
+
+Replays every sample file (.cu8, .cs16, .ook) with a reference .json next to it,
+in the layout of the rtl_433_tests repository, through rtl_433 and compares the
+decoded events with the reference. A directory with an "ignore" file is skipped,
+a "protocol" file lists the -R decoders to use for the directory.
+
+Reports the samples/s and packages/s of the processing stages and the ns/package
+of each decoder as JSON on stdout, exits non-zero if a decode result changed.
+
+With --negative the corpus is noise and interference recorded in the field that
+no decoder should accept, every sample file is replayed, no reference is needed.
+All decoder time is then spent rejecting packages, the report lists the ns/package
+and the abort and fail counts of each decoder, and every decoded event is a false
+positive. Exits non-zero if there is a false positive.
+
+Usage: bench.py [--negative] [--ignore <key>]... [--output <file>] <rtl_433> <corpus dir>...
+"""
+
+import sys
+import os
+import json
+import subprocess
+import time
+
+errout = sys.stderr
+
+SAMPLE_SIZES = {
+    '.cu8': 2,
+    '.cs16': 4,
+    '.ook': 0,  # pulse data, no samples
+}
+
+
+def log(s):
+    print(s, file=errout)
+
+
+# the reject reasons in the stats report
+FAIL_KEYS = ['abort_length', 'abort_early', 'fail_mic', 'fail_sanity', 'fail_other']
+
+
+def find_samples(root, negative=False):
+    """List all sample files with a reference json below root, or all sample files if negative."""
+    samples = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        if 'ignore' in filenames:
+            dirnames.clear()
+            continue
+        for f in sorted(filenames):
+            base, ext = os.path.splitext(f)
+            if ext in SAMPLE_SIZES and (negative or base + '.json' in filenames):
+                samples.append(os.path.join(dirpath, f))
+    return samples
+
+
+def read_protocols(path):
+    """Read the -R arguments of a "protocol" file next to a sample."""
+    protocol_fn = os.path.join(os.path.dirname(path), 'protocol')
+    if not os.path.isfile(protocol_fn):
+        return []
+    args = []
+    with open(protocol_fn) as f:
+        for p in f.read().split():
+            args += ['-R', p]
+    return args
+
+
+def read_events(lines, ignore):
+    """Parse json lines into the events and the stats report."""
+    events = []
+    report = None
+    for line in lines:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            d = json.loads(line)
+        except ValueError:
+            continue
+        if 'enabled' in d and 'frames' in d:
+            report = d
+            continue
+        for key in ignore:
+            d.pop(key, None)
+        events.append(d)
+    return events, report
+
+
+def run_sample(rtl_433, path, ignore):
+    """Decode a sample, return the events, the stats report, and the wall time."""
+    cmd = [rtl_433, '-c', '0', '-F', 'json', '-M', 'cputime', '-M', 'stats:2:0']
+    cmd += read_protocols(path)
+    cmd += ['-r', path]
+    start = time.perf_counter()
+    proc = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, universal_newlines=True)
+    wall = time.perf_counter() - start
+    if proc.returncode:
+        log(f"{path}: rtl_433 failed with exit code {proc.returncode}")
+    events, report = read_events(proc.stdout.splitlines(), ignore)
+    return proc.returncode, events, report, wall
+
+
+def main(args):
+    """Benchmark all samples of the corpus directories."""
+
+    ignore = ['time']
+    output = None
+    negative = False
+    while args and args[0].startswith('--'):
+        opt = args.pop(0)
+        if opt == '--negative':
+            negative = True
+        elif opt == '--ignore' and args:
+            ignore.append(args.pop(0))
+        elif opt == '--output' and args:
+            output = args.pop(0)
+        else:
+            log(__doc__)
+            return 2
+    if len(args) < 2:
+        log(__doc__)
+        return 2
+    rtl_433 = args[0]
+
+    samples = []
+    for root in args[1:]:
+        samples += find_samples(root, negative)
+    if not samples:
+        log("No samples found" if negative else "No samples with a reference json found")
+        return 2
+
+    totals = {'samples': 0, 'packages': 0, 'events': 0, 'pipeline_ns': 0.0, 'wall_s': 0.0}
+    decoders = {}
+    failed = []
+    false_positives = []
+    for path in samples:
+        expected = []
+        if not negative:
+            with open(os.path.splitext(path)[0] + '.json') as f:
+                expected, _ = read_events(f.readlines(), ignore)
+        code, events, report, wall = run_sample(rtl_433, path, ignore)
+        if negative and events:
+            for got in events:
+                false_positives.append({'file': path, 'model': got.get('model', ''), 'event': got})
+            log(f"{path}: {len(events)} false positives, first: {json.dumps(events[0])}")
+        if code or (events != expected and not negative):
+            failed.append(path)
+            log(f"{path}: decode results changed, {len(events)} events, expected {len(expected)}")
+            for got, want in zip(events, expected):
+                if got != want:
+                    log(f"  got:      {json.dumps(got)}")
+                    log(f"  expected: {json.dumps(want)}")
+                    break
+
+        size = SAMPLE_SIZES[os.path.splitext(path)[1]]
+        if size:
+            totals['samples'] += os.path.getsize(path) // size
+        totals['events'] += len(events)
+        totals['wall_s'] += wall
+        if not report:
+            continue
+        frames = report.get('frames', {})
+        totals['packages'] += frames.get('count', 0) + frames.get('fsk', 0)
+        for stage in report.get('cpu', {}).get('stages', []):
+            totals['pipeline_ns'] += stage['ns']
+
+        for s in report.get('stats', []):
+            d = decoders.setdefault(s['name'], {'ns': 0.0, 'packages': 0, 'messages': 0, 'fails': {}})
+            d['ns'] += s.get('slicer_ns', 0.0) + s.get('decode_ns', 0.0)
+            d['packages'] += s.get('slicer_calls', 0)
+            d['messages'] += s.get('messages', 0)
+            for key in FAIL_KEYS:
+                if key in s:
+                    d['fails'][key] = d['fails'].get(key, 0) + s[key]
+
+    pipeline_s = totals['pipeline_ns'] * 1e-9
+    result = {
+        'files': len(samples),
+        'failed': failed,
+        'samples': totals['samples'],
+        'packages': totals['packages'],
+        'events': totals['events'],
+        'pipeline_s': round(pipeline_s, 6),
+        'wall_s': round(totals['wall_s'], 6),
+        'samples_per_s': round(totals['samples'] / pipeline_s) if pipeline_s else 0,
+        'packages_per_s': round(totals['packages'] / pipeline_s, 1) if pipeline_s else 0,
+        'decoders': [
+            {
+                'name': name,
+                'packages': d['packages'],
+                'messages': d['messages'],
+                'ns_per_package': round(d['ns'] / d['packages'], 1) if d['packages'] else 0,
+                **({'reject_ns': round(d['ns']), **d['fails']} if negative else {}),
+            }
+            for name, d in sorted(decoders.items(), key=lambda kv: -kv[1]['ns'])
+        ],
+    }
+    if negative:
+        result['false_positives'] = false_positives
+
+    if output:
+        with open(output, 'w') as f:
+            json.dump(result, f, indent=2)
+            f.write('\n')
+    print(json.dumps(result, indent=2))
+
+    log(f"{len(samples)} files, {len(failed)} failed, {result['samples_per_s']} samples/s, {result['packages_per_s']} packages/s")
+    if negative:
+        log(f"{len(false_positives)} false positives")
+    return 1 if failed or false_positives else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
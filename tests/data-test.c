@@ -19,6 +19,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "data.h"
 #include "output_file.h"
@@ -42,7 +43,7 @@ int main(void)
 
     void *json_output = data_output_json_create(0, stdout);
     void *kv_output = data_output_kv_create(0, stdout);
-    void *csv_output = data_output_csv_create(0, stdout);
+    void *csv_output = data_output_csv_create(0, stdout, CSV_LAYOUT_WIDE);
     data_output_start(csv_output, fields, sizeof fields / sizeof *fields);
 
     data_output_print(json_output, data); fprintf(stdout, "\n");
@@ -54,4 +55,87 @@ int main(void)
     data_output_free(csv_output);
 
     data_free(data);
+
+    // a projection skips fields while rendering, the record stays as is
+    data_projection_t *projection = data_projection_create();
+    int failed = !projection
+            || data_projection_add(projection, "model+id+temperature_C", 0)
+            || data_projection_add(projection, "Test-*/id", 1)
+            || !data_projection_add(projection, "a++b", 0);
+    /* clang-format off */
+    data = data_make(
+            "model",            "", DATA_STRING, "Test-Sensor",
+            "id",               "", DATA_INT,    42,
+            "temperature_C",    "", DATA_DOUBLE, 21.5,
+            "data",             "", DATA_DATA,   data_make("id", "", DATA_INT, 1, NULL),
+            NULL);
+    /* clang-format on */
+    data_render_t render = {0};
+    data_render_start(&render, data);
+    render.skip      = data_projection_skip(projection, data);
+    char const *json = data_render_jsons(&render, data, NULL);
+    fprintf(stdout, "%s\n", json ? json : "(null)");
+    failed |= !json || strcmp(json, "{\"model\":\"Test-Sensor\",\"temperature_C\":21.5}");
+    data_render_free(&render);
+    data_free(data);
+
+    data = data_make("msg", "", DATA_STRING, "a log record prints all fields", NULL);
+    failed |= data_projection_skip(projection, data) != NULL;
+    data_free(data);
+    data_projection_free(projection);
+
+    // a cache reuses the freed elements, an element too long for a block is allocated as usual
+    data_cache_t cache = {0};
+    data_cache_t *prev = data_cache_use(&cache);
+    data = data_make("model", "", DATA_STRING, "Test-Sensor", "id", "", DATA_INT, 42, NULL);
+    data_free(data);
+    failed |= cache.len != 2 || cache.misses != 2;
+    char long_str[DATA_CACHE_BLOCK] = {0};
+    memset(long_str, 'x', sizeof(long_str) - 1);
+    data = data_make("model", "", DATA_STRING, "Test-Sensor", "note", "", DATA_STRING, long_str, NULL);
+    failed |= cache.len != 1 || cache.hits != 1 || strcmp(data->next->value.v_ptr, long_str);
+    data_free(data);
+    failed |= cache.len != 2;
+    data_cache_use(prev);
+    data_cache_clear(&cache);
+    failed |= cache.len != 0 || cache.free_list != NULL;
+
+    // a schema record formats the same as the data it makes
+    /* clang-format off */
+    data_schema_field_t const schema_fields[] = {
+            {"model",           "",             DATA_STRING, NULL},
+            {"id",              "Id",           DATA_INT,    NULL},
+            {"battery_ok",      "Battery",      DATA_INT,    NULL},
+            {"temperature_C",   "Temperature",  DATA_DOUBLE, "%.1f C"},
+            {"mic",             "Integrity",    DATA_STRING, "%s"},
+            {NULL},
+    };
+    /* clang-format on */
+    data_schema_t *schema = data_schema_create(schema_fields);
+    failed |= !schema;
+    if (schema) {
+        data_record_t record = {0};
+        data_record_str(&record, 0, "Test-Sensor");
+        data_record_int(&record, 1, -42);
+        data_record_dbl(&record, 3, 21.5);
+        data_record_str(&record, 4, "CRC");
+        data = data_schema_make(schema, &record);
+        char record_json[256];
+        char schema_json[256];
+        data_print_jsons(data, record_json, sizeof(record_json));
+        data_schema_print_jsons(schema, &record, schema_json, sizeof(schema_json));
+        fprintf(stdout, "%s\n", schema_json);
+        failed |= strcmp(schema_json, "{\"model\":\"Test-Sensor\",\"id\":-42,\"temperature_C\":21.5,\"mic\":\"CRC\"}") || strcmp(record_json, schema_json);
+        failed |= !data || !data->next || data->next->key_id != data_key_id("id") || strcmp(data->next->next->format, "%.1f C");
+        uint8_t cbor[256];
+        uint8_t schema_cbor[256];
+        size_t cbor_len        = data_print_cbor(data, cbor, sizeof(cbor));
+        size_t schema_cbor_len = data_schema_print_cbor(schema, &record, schema_cbor, sizeof(schema_cbor));
+        failed |= !cbor_len || cbor_len != schema_cbor_len || memcmp(cbor, schema_cbor, cbor_len);
+        failed |= data_schema_print_cbor(schema, &record, schema_cbor, 8) != 0;
+        data_free(data);
+        data_schema_free(schema);
+    }
+
+    return failed;
 }
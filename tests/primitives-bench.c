@@ -0,0 +1,612 @@
+/** @file
+    Primitives Benchmark.
+
+    Speed test for the bitbuffer, CRC/LFSR, and pulse slicer functions
+    on synthetic packages and on recorded OOK pulse data.
+
+    Copyright (C) 2024 rtl_433 contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+// primitives-bench [-n iterations] [-p] [-s sample_rate] [FILE.ook ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "bitbuffer.h"
+#include "bit_util.h"
+#include "pulse_data.h"
+#include "pulse_slicer.h"
+#include "r_device.h"
+#include "rtl_433_devices.h"
+#include "fatal.h"
+
+/* Hardware counters, the cycles lead a group of all counters */
+
+#define PERF_COUNTERS 3
+
+static char const *const perf_names[PERF_COUNTERS] = {"cycles", "instr", "br-miss"};
+static int perf_fd[PERF_COUNTERS] = {-1, -1, -1};
+
+static void perf_close(void)
+{
+#ifdef __linux__
+    for (int i = PERF_COUNTERS - 1; i >= 0; --i) {
+        if (perf_fd[i] >= 0)
+            close(perf_fd[i]);
+        perf_fd[i] = -1;
+    }
+#endif
+}
+
+/// Open the cycles, instructions, and branch misses counters of this thread, returns -1 if not available.
+static int perf_open(void)
+{
+#ifdef __linux__
+    static uint64_t const configs[PERF_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        struct perf_event_attr attr = {0};
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.size           = sizeof(attr);
+        attr.config         = configs[i];
+        attr.disabled       = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_GROUP;
+        perf_fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i ? perf_fd[0] : -1, 0);
+        if (perf_fd[i] < 0) {
+            perf_close();
+            return -1;
+        }
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+static void perf_start(void)
+{
+#ifdef __linux__
+    if (perf_fd[0] < 0)
+        return;
+    ioctl(perf_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/// Stop the counters, returns 0 and the counts or -1 if the counters are not open.
+static int perf_stop(uint64_t counts[PERF_COUNTERS])
+{
+#ifdef __linux__
+    if (perf_fd[0] < 0)
+        return -1;
+    ioctl(perf_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t buf[1 + PERF_COUNTERS];
+    if (read(perf_fd[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf) || buf[0] != PERF_COUNTERS)
+        return -1;
+    memcpy(counts, &buf[1], sizeof(*counts) * PERF_COUNTERS);
+    return 0;
+#else
+    (void)counts;
+    return -1;
+#endif
+}
+
+/* Timing */
+
+static uint64_t now_ns(void)
+{
+#ifdef _WIN32
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+typedef void (*bench_fn)(void *ctx);
+
+static unsigned volatile bench_sink; ///< results are added here to keep the calls from being optimized out
+
+/// Run a function for some iterations and print the time and counters per call.
+static void bench_run(char const *label, unsigned iterations, bench_fn fn, void *ctx)
+{
+    fn(ctx); // warm up the caches
+
+    uint64_t counts[PERF_COUNTERS];
+    perf_start();
+    uint64_t start = now_ns();
+    for (unsigned i = 0; i < iterations; ++i)
+        fn(ctx);
+    uint64_t elapsed = now_ns() - start;
+    int counted = perf_stop(counts) == 0;
+
+    printf("%-48s %10.1f ns", label, (double)elapsed / iterations);
+    for (int i = 0; counted && i < PERF_COUNTERS; ++i)
+        printf(" %10.1f %s", (double)counts[i] / iterations, perf_names[i]);
+    printf("\n");
+}
+
+/* Bitbuffer and bit_util functions */
+
+static uint32_t rand_state = 0x12345678;
+
+/// xorshift32, the same numbers on every platform.
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+typedef struct bits_ctx {
+    bitbuffer_t bits;
+    bitbuffer_t out;
+    uint8_t const *pattern;
+    unsigned pattern_bits;
+} bits_ctx_t;
+
+static void bench_search(void *ctx)
+{
+    bits_ctx_t *c = ctx;
+    bench_sink += bitbuffer_search(&c->bits, 0, 0, c->pattern, c->pattern_bits);
+}
+
+static void bench_manchester(void *ctx)
+{
+    bits_ctx_t *c = ctx;
+    bitbuffer_clear(&c->out);
+    bench_sink += bitbuffer_manchester_decode(&c->bits, 0, 0, &c->out, 0);
+}
+
+static void bench_repeated_row(void *ctx)
+{
+    bits_ctx_t *c = ctx;
+    bench_sink += (unsigned)bitbuffer_find_repeated_row(&c->bits, 3, 60);
+}
+
+static uint8_t msg[32]; ///< message of the CRC and LFSR functions
+
+static void bench_crc8(void *ctx)
+{
+    bench_sink += crc8(msg, *(unsigned *)ctx, 0x31, 0x00);
+}
+
+static void bench_crc8le(void *ctx)
+{
+    bench_sink += crc8le(msg, *(unsigned *)ctx, 0x31, 0x00);
+}
+
+static void bench_crc16(void *ctx)
+{
+    bench_sink += crc16(msg, *(unsigned *)ctx, 0x1021, 0x0000);
+}
+
+static void bench_crc16lsb(void *ctx)
+{
+    bench_sink += crc16lsb(msg, *(unsigned *)ctx, 0x8408, 0x0000);
+}
+
+static void bench_lfsr_digest8(void *ctx)
+{
+    bench_sink += lfsr_digest8(msg, *(unsigned *)ctx, 0x98, 0x3e);
+}
+
+static void bench_lfsr_digest8_reflect(void *ctx)
+{
+    bench_sink += lfsr_digest8_reflect(msg, (int)*(unsigned *)ctx, 0x31, 0xf4);
+}
+
+static void bench_lfsr_digest16(void *ctx)
+{
+    bench_sink += lfsr_digest16(msg, *(unsigned *)ctx, 0x8810, 0x5412);
+}
+
+static void bench_bits(unsigned iterations)
+{
+    bits_ctx_t c = {0};
+
+    // a long row without the pattern is the worst case of the search
+    uint8_t const preamble[] = {0xaa, 0x2d, 0xd4};
+    c.pattern      = preamble;
+    c.pattern_bits = 24;
+    for (unsigned i = 0; i < 800; ++i)
+        bitbuffer_add_bit(&c.bits, i & 1);
+    bench_run("bitbuffer_search (800 bits, miss)", iterations, bench_search, &c);
+
+    bitbuffer_clear(&c.bits);
+    for (unsigned i = 0; i < 400; ++i) {
+        unsigned bit = rand_next() & 1;
+        bitbuffer_add_bit(&c.bits, bit);
+        bitbuffer_add_bit(&c.bits, !bit);
+    }
+    bench_run("bitbuffer_manchester_decode (400 bits)", iterations, bench_manchester, &c);
+
+    // a few noise rows, then the repeats of a message
+    bitbuffer_clear(&c.bits);
+    for (unsigned row = 0; row < 10; ++row) {
+        if (row)
+            bitbuffer_add_row(&c.bits);
+        rand_state = row < 4 ? 0x1000 + row : 0x4242;
+        for (unsigned i = 0; i < 80; ++i)
+            bitbuffer_add_bit(&c.bits, rand_next() & 1);
+    }
+    bench_run("bitbuffer_find_repeated_row (10 rows)", iterations, bench_repeated_row, &c);
+
+    for (unsigned i = 0; i < sizeof(msg); ++i)
+        msg[i] = (uint8_t)rand_next();
+    unsigned len = 10; // a common message length
+    bench_run("crc8 (10 bytes)", iterations, bench_crc8, &len);
+    bench_run("crc8le (10 bytes)", iterations, bench_crc8le, &len);
+    bench_run("crc16 (10 bytes)", iterations, bench_crc16, &len);
+    bench_run("crc16lsb (10 bytes)", iterations, bench_crc16lsb, &len);
+    bench_run("lfsr_digest8 (10 bytes)", iterations, bench_lfsr_digest8, &len);
+    bench_run("lfsr_digest8_reflect (10 bytes)", iterations, bench_lfsr_digest8_reflect, &len);
+    bench_run("lfsr_digest16 (10 bytes)", iterations, bench_lfsr_digest16, &len);
+}
+
+/* Pulse slicers */
+
+typedef int (*slicer_fn)(pulse_data_t const *pulses, r_device *device);
+
+/// The slicer of a modulation, NULL if unknown.
+static slicer_fn modulation_slicer(unsigned modulation)
+{
+    switch (modulation) {
+    case OOK_PULSE_PCM:
+    case FSK_PULSE_PCM:
+        return pulse_slicer_pcm;
+    case OOK_PULSE_PPM:
+        return pulse_slicer_ppm;
+    case OOK_PULSE_PWM:
+    case FSK_PULSE_PWM:
+        return pulse_slicer_pwm;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        return pulse_slicer_manchester_zerobit;
+    case OOK_PULSE_PIWM_RAW:
+        return pulse_slicer_piwm_raw;
+    case OOK_PULSE_PIWM_DC:
+        return pulse_slicer_piwm_dc;
+    case OOK_PULSE_DMC:
+        return pulse_slicer_dmc;
+    case OOK_PULSE_PWM_OSV1:
+        return pulse_slicer_osv1;
+    case OOK_PULSE_NRZS:
+        return pulse_slicer_nrzs;
+    default:
+        return NULL;
+    }
+}
+
+/// Count the sliced bits instead of decoding them.
+static int bench_decode(r_device *decoder, bitbuffer_t *bitbuffer)
+{
+    (void)decoder;
+    bench_sink += bitbuffer->num_rows;
+    return DECODE_ABORT_EARLY;
+}
+
+/// Append a level of some us to the pulses, which start with a pulse.
+static void add_level(pulse_data_t *pulses, int high, unsigned us)
+{
+    int width = (int)((uint64_t)us * pulses->sample_rate / 1000000);
+    if (pulse_data_reserve(pulses, pulses->num_pulses + 2))
+        return;
+    if (high) {
+        if (pulses->gap[pulses->num_pulses])
+            pulses->num_pulses++;
+        pulses->pulse[pulses->num_pulses] += width;
+    }
+    else if (pulses->pulse[pulses->num_pulses]) {
+        pulses->gap[pulses->num_pulses] += width;
+    }
+}
+
+/// End the package with a reset gap.
+static void add_reset(pulse_data_t *pulses, unsigned us)
+{
+    add_level(pulses, 0, us);
+    if (pulses->pulse[pulses->num_pulses])
+        pulses->num_pulses++;
+}
+
+/// Synthesize a package of random bits in the coding of a modulation.
+static void synth_package(pulse_data_t *pulses, r_device const *dev, unsigned num_bits, unsigned repeats)
+{
+    unsigned s = (unsigned)dev->short_width;
+    unsigned l = (unsigned)dev->long_width;
+    for (unsigned r = 0; r < repeats; ++r) {
+        rand_state = 0x2468ace;
+        int level = 1;
+        if (dev->modulation == OOK_PULSE_PWM_OSV1) {
+            // preamble, the last half bit is longer, and the sync
+            for (unsigned i = 0; i < 12; ++i) {
+                add_level(pulses, 1, s);
+                add_level(pulses, 0, i < 11 ? s : 2 * s);
+            }
+            add_level(pulses, 1, 4 * s);
+            add_level(pulses, 0, 4 * s);
+        }
+        for (unsigned i = 0; i < num_bits; ++i) {
+            int bit = rand_next() & 1;
+            switch (dev->modulation) {
+            case OOK_PULSE_PCM:
+            case OOK_PULSE_NRZS:
+            case OOK_PULSE_PIWM_RAW:
+                add_level(pulses, bit || i == 0, s); // NRZ, the package starts with a pulse
+                break;
+            case OOK_PULSE_PPM:
+                add_level(pulses, 1, s / 2);
+                add_level(pulses, 0, bit ? l : s);
+                break;
+            case OOK_PULSE_PWM:
+                add_level(pulses, 1, bit ? s : l);
+                add_level(pulses, 0, bit ? l : s);
+                break;
+            case OOK_PULSE_MANCHESTER_ZEROBIT:
+            case OOK_PULSE_PWM_OSV1: // rising edge is 0
+                add_level(pulses, bit, s);
+                add_level(pulses, !bit, s);
+                break;
+            case OOK_PULSE_DMC: // a level shift at each bit, another one in a 0
+                if (bit) {
+                    add_level(pulses, level, l);
+                }
+                else {
+                    add_level(pulses, level, s);
+                    add_level(pulses, !level, s);
+                }
+                level = bit ? !level : level;
+                break;
+            case OOK_PULSE_PIWM_DC: // a level shift after each bit
+                add_level(pulses, level, bit ? s : l);
+                level = !level;
+                break;
+            default:
+                break;
+            }
+        }
+        add_level(pulses, 0, dev->gap_limit > 0 ? (unsigned)dev->gap_limit + s : 0);
+    }
+    add_reset(pulses, (unsigned)dev->reset_limit + s);
+}
+
+typedef struct slicer_ctx {
+    pulse_data_t *pulses;
+    unsigned num_packages;
+    r_device *devs;
+    unsigned num_devs;
+} slicer_ctx_t;
+
+static void bench_slicers(void *ctx)
+{
+    slicer_ctx_t *c = ctx;
+    for (unsigned p = 0; p < c->num_packages; ++p) {
+        for (unsigned d = 0; d < c->num_devs; ++d) {
+            r_device *dev = &c->devs[d];
+            bench_sink += (unsigned)modulation_slicer(dev->modulation)(&c->pulses[p], dev);
+        }
+    }
+}
+
+static void bench_prefilter(void *ctx)
+{
+    slicer_ctx_t *c = ctx;
+    for (unsigned p = 0; p < c->num_packages; ++p) {
+        for (unsigned d = 0; d < c->num_devs; ++d)
+            bench_sink += (unsigned)pulse_slicer_prefilter(&c->pulses[p], &c->devs[d]);
+    }
+}
+
+static void free_devices(r_device *devs, unsigned num_devs)
+{
+    for (unsigned d = 0; d < num_devs; ++d)
+        free(devs[d].slice_bits);
+}
+
+/// Slice packages synthesized for a typical timing of each slicer.
+static void bench_synth_slicers(unsigned iterations, uint32_t sample_rate)
+{
+    r_device devs[] = {
+            {.name = "pulse_slicer_pcm", .modulation = OOK_PULSE_PCM, .short_width = 250, .long_width = 250, .gap_limit = 2000, .reset_limit = 4000},
+            {.name = "pulse_slicer_ppm", .modulation = OOK_PULSE_PPM, .short_width = 1000, .long_width = 2000, .gap_limit = 3000, .reset_limit = 8000},
+            {.name = "pulse_slicer_pwm", .modulation = OOK_PULSE_PWM, .short_width = 250, .long_width = 500, .gap_limit = 1000, .reset_limit = 2000},
+            {.name = "pulse_slicer_manchester_zerobit", .modulation = OOK_PULSE_MANCHESTER_ZEROBIT, .short_width = 250, .long_width = 0, .gap_limit = 1000, .reset_limit = 2000},
+            {.name = "pulse_slicer_dmc", .modulation = OOK_PULSE_DMC, .short_width = 250, .long_width = 500, .tolerance = 100, .reset_limit = 2000},
+            {.name = "pulse_slicer_piwm_raw", .modulation = OOK_PULSE_PIWM_RAW, .short_width = 250, .long_width = 2000, .tolerance = 100, .reset_limit = 5000},
+            {.name = "pulse_slicer_piwm_dc", .modulation = OOK_PULSE_PIWM_DC, .short_width = 250, .long_width = 500, .tolerance = 100, .reset_limit = 2000},
+            {.name = "pulse_slicer_nrzs", .modulation = OOK_PULSE_NRZS, .short_width = 250, .long_width = 250, .reset_limit = 2000},
+            {.name = "pulse_slicer_osv1", .modulation = OOK_PULSE_PWM_OSV1, .short_width = 1465, .long_width = 0, .reset_limit = 10000},
+    };
+    unsigned num_devs = sizeof(devs) / sizeof(*devs);
+
+    for (unsigned d = 0; d < num_devs; ++d) {
+        r_device *dev = &devs[d];
+        dev->decode_fn = bench_decode;
+        pulse_slicer_set_timing(dev, sample_rate);
+
+        pulse_data_t pulses = {0};
+        pulses.sample_rate = sample_rate;
+        synth_package(&pulses, dev, 72, dev->modulation == OOK_PULSE_PWM_OSV1 ? 1 : 3);
+        pulse_data_fingerprint(&pulses);
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s (%u pulses)", dev->name, pulses.num_pulses);
+        slicer_ctx_t c = {.pulses = &pulses, .num_packages = 1, .devs = dev, .num_devs = 1};
+        bench_run(label, iterations, bench_slicers, &c);
+        pulse_data_free(&pulses);
+    }
+    free_devices(devs, num_devs);
+}
+
+/// Slice recorded packages with the timing of all decoders, grouped by slicer.
+static void bench_recorded_slicers(unsigned iterations, pulse_data_t *packages, unsigned num_packages)
+{
+    r_device const *builtin[] = {
+#define DECL(name) &name,
+            DEVICES
+#undef DECL
+    };
+    unsigned num_builtin = sizeof(builtin) / sizeof(*builtin);
+
+    // the decoders of each modulation, the FSK ones are sliced by the OOK slicers of the same coding
+    struct {
+        unsigned modulation;
+        char const *name;
+    } const modulations[] = {
+            {OOK_PULSE_PCM, "pcm"},
+            {OOK_PULSE_PPM, "ppm"},
+            {OOK_PULSE_PWM, "pwm"},
+            {OOK_PULSE_MANCHESTER_ZEROBIT, "manchester_zerobit"},
+            {OOK_PULSE_DMC, "dmc"},
+            {OOK_PULSE_PIWM_RAW, "piwm_raw"},
+            {OOK_PULSE_PIWM_DC, "piwm_dc"},
+            {OOK_PULSE_NRZS, "nrzs"},
+            {OOK_PULSE_PWM_OSV1, "osv1"},
+            {FSK_PULSE_PCM, "pcm (FSK)"},
+            {FSK_PULSE_PWM, "pwm (FSK)"},
+            {FSK_PULSE_MANCHESTER_ZEROBIT, "manchester_zerobit (FSK)"},
+    };
+    r_device *devs = calloc(num_builtin, sizeof(*devs));
+    if (!devs)
+        FATAL_CALLOC("bench_recorded_slicers()");
+
+    unsigned num_all = 0;
+    for (unsigned m = 0; m < sizeof(modulations) / sizeof(*modulations); ++m) {
+        unsigned first = num_all;
+        for (unsigned i = 0; i < num_builtin; ++i) {
+            if (builtin[i]->modulation != modulations[m].modulation)
+                continue;
+            devs[num_all]            = *builtin[i];
+            devs[num_all].decode_fn  = bench_decode;
+            devs[num_all].verbose    = 0;
+            devs[num_all].slice_bits = NULL;
+            // skip the decoders which need a higher sample rate, as rtl_433 does
+            pulse_slicer_set_timing(&devs[num_all], packages[0].sample_rate);
+            if (devs[num_all].timing.valid)
+                num_all++;
+        }
+        if (num_all == first)
+            continue;
+
+        char label[64];
+        snprintf(label, sizeof(label), "recorded %s, %u decoders", modulations[m].name, num_all - first);
+        slicer_ctx_t c = {.pulses = packages, .num_packages = num_packages, .devs = &devs[first], .num_devs = num_all - first};
+        bench_run(label, iterations, bench_slicers, &c);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "recorded prefilter, %u decoders", num_all);
+    slicer_ctx_t c = {.pulses = packages, .num_packages = num_packages, .devs = devs, .num_devs = num_all};
+    bench_run(label, iterations, bench_prefilter, &c);
+
+    free_devices(devs, num_all);
+    free(devs);
+}
+
+/// Read all packages of OOK pulse data files.
+static unsigned load_packages(char **files, unsigned num_files, uint32_t sample_rate, pulse_data_t **packages)
+{
+    unsigned num_packages = 0;
+    unsigned max_packages = 0;
+    for (unsigned f = 0; f < num_files; ++f) {
+        FILE *file = fopen(files[f], "r");
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", files[f]);
+            continue;
+        }
+        for (;;) {
+            if (num_packages == max_packages) {
+                max_packages = max_packages ? 2 * max_packages : 64;
+                pulse_data_t *grown = realloc(*packages, max_packages * sizeof(**packages));
+                if (!grown)
+                    FATAL_REALLOC("load_packages()");
+                *packages = grown;
+            }
+            pulse_data_t *pulses = &(*packages)[num_packages];
+            *pulses = (pulse_data_t){0};
+            pulse_data_load(file, pulses, sample_rate);
+            if (!pulses->num_pulses) {
+                pulse_data_free(pulses);
+                break;
+            }
+            pulse_data_fingerprint(pulses);
+            num_packages++;
+        }
+        fclose(file);
+    }
+    return num_packages;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "primitives-bench [-n iterations] [-p] [-s sample_rate] [FILE.ook ...]\n"
+                    "\t-n iterations of each benchmark (default: 100000, a tenth for the recorded packages)\n"
+                    "\t-p add the CPU cycles, instructions, and branch misses per call (Linux perf events)\n"
+                    "\t-s sample rate of the synthetic packages and the OOK files (default: 250000)\n"
+                    "\tFILE.ook recorded pulse data, e.g. from \"rtl_433 -w FILE.ook\"\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned iterations  = 100000;
+    uint32_t sample_rate = 250000;
+    int perf             = 0;
+
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; ++argi) {
+        if (!strcmp(argv[argi], "-n") && argi + 1 < argc)
+            iterations = (unsigned)strtoul(argv[++argi], NULL, 10);
+        else if (!strcmp(argv[argi], "-s") && argi + 1 < argc)
+            sample_rate = (uint32_t)strtoul(argv[++argi], NULL, 10);
+        else if (!strcmp(argv[argi], "-p"))
+            perf = 1;
+        else
+            usage();
+    }
+    if (!iterations || !sample_rate)
+        usage();
+
+    if (perf && perf_open())
+        fprintf(stderr, "Perf counters not available, check /proc/sys/kernel/perf_event_paranoid\n");
+
+    bench_bits(iterations);
+    bench_synth_slicers(iterations, sample_rate);
+
+    if (argi < argc) {
+        pulse_data_t *packages = NULL;
+        unsigned num_packages  = load_packages(&argv[argi], (unsigned)(argc - argi), sample_rate, &packages);
+        printf("%u recorded packages\n", num_packages);
+        if (num_packages)
+            bench_recorded_slicers(iterations / 10 ? iterations / 10 : 1, packages, num_packages);
+        for (unsigned p = 0; p < num_packages; ++p)
+            pulse_data_free(&packages[p]);
+        free(packages);
+    }
+
+    perf_close();
+    return 0;
+}